@@ -11,6 +11,9 @@
   #define ATOMIC_ADD32(mem, val) atomic_add_32_nv(&mem, val)
   #define ATOMIC_ADD64(mem, val) atomic_add_64_nv(&mem, val)
   #define ATOMIC_ADD32_PTR(mem, val) atomic_add_32_nv(mem, val)
+  #define CASPTR(mem, oldv, newv) (atomic_cas_ptr(&mem, oldv, newv) == oldv)
+  #define XCHANGEPTR(mem, newv) atomic_swap_ptr(&mem, newv)
+  #define ATOMIC_LOADPTR(mem) atomic_cas_ptr(&mem, NULL, NULL)
 #elif defined(_LINUX_SOURCE)
   #define CAS32(mem, oldv, newv) __atomic_compare_exchange_n(&mem, &oldv, newv, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
   #define XCHANGE32(mem, newv) __atomic_exchange_n(&mem, newv, __ATOMIC_SEQ_CST)
@@ -20,6 +23,9 @@
   #define ATOMIC_ADD32(mem, val) __atomic_add_fetch(&mem, val, __ATOMIC_SEQ_CST)
   #define ATOMIC_ADD64(mem, val) __atomic_add_fetch(&mem, val, __ATOMIC_SEQ_CST)
   #define ATOMIC_ADD32_PTR(mem, val) __atomic_add_fetch(mem, val, __ATOMIC_SEQ_CST)
+  #define CASPTR(mem, oldv, newv) __atomic_compare_exchange_n(&mem, &oldv, newv, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+  #define XCHANGEPTR(mem, newv) __atomic_exchange_n(&mem, newv, __ATOMIC_SEQ_CST)
+  #define ATOMIC_LOADPTR(mem) __atomic_load_n(&mem, __ATOMIC_SEQ_CST)
 #elif defined(_IBM_SOURCE)
   #define CAS32(mem, oldv, newv) __compare_and_swap(&mem, &oldv, newv)
   #define XCHANGE32(mem, newv) __fetch_and_swap(&mem, newv)
@@ -29,6 +35,9 @@
   #define ATOMIC_ADD32(mem, val) __sync_add_and_fetch(&mem, val)
   #define ATOMIC_ADD64(mem, val) __sync_add_and_fetch(&mem, val)
   #define ATOMIC_ADD32_PTR(mem, val) __sync_add_and_fetch(mem, val)
+  #define CASPTR(mem, oldv, newv) __sync_bool_compare_and_swap(&mem, oldv, newv)
+  #define XCHANGEPTR(mem, newv) __fetch_and_swaplp((volatile long *)&mem, (long)newv)
+  #define ATOMIC_LOADPTR(mem) __sync_val_compare_and_swap(&mem, NULL, NULL)
 #else
   #error "Missing atomic primitives"
 #endif
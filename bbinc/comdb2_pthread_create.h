@@ -34,4 +34,39 @@ int comdb2_pthread_create(pthread_t *thread, pthread_attr_t *attr,
                           void *(*start_routine)(void *), void *arg,
                           comdb2ma allocator, size_t stacksz);
 
+/*
+** CPU affinity.
+**
+** A cpu list is a comma separated list of cpus and ranges ("0-3,8"),
+** "node<N>" for the cpus of numa node N, or "local" for the cpus of the
+** numa node the thread is running on when it starts.  Threads of a class
+** are bound to the class's list when they start; a thread pool's own list,
+** if set, takes the place of its class's.  Unset lists leave threads where
+** the scheduler puts them.
+*/
+enum comdb2_thread_class {
+    COMDB2_THR_CLASS_NONE = 0,
+    COMDB2_THR_CLASS_SQL = 1,    /* sql engine threads */
+    COMDB2_THR_CLASS_COMMIT = 2, /* block processors (writes and commits) */
+    COMDB2_THR_CLASS_REP = 3,    /* replication apply */
+    COMDB2_THR_CLASS_NET = 4,    /* net readers and writers */
+    COMDB2_THR_CLASS_BDB = 5,    /* berkdb trickle, sync and checkpoint */
+    COMDB2_THR_CLASS_MAX = 6
+};
+
+extern char *gbl_sql_thread_cpus;
+extern char *gbl_commit_thread_cpus;
+extern char *gbl_rep_thread_cpus;
+extern char *gbl_net_thread_cpus;
+extern char *gbl_bdb_thread_cpus;
+
+const char *comdb2_thread_class_name(int cls);
+
+/* Check that cpus is a cpu list this machine can run on; 0 if it is */
+int comdb2_cpus_verify(const char *cpus);
+
+/* Bind the calling thread to cpus, or to its class's list when cpus is
+** NULL.  Returns 0 when bound or when there is nothing to bind to. */
+int comdb2_thread_set_affinity(int cls, const char *cpus);
+
 #endif
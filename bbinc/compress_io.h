@@ -0,0 +1,82 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef _INCLUDED_COMPRESS_IO_H_
+#define _INCLUDED_COMPRESS_IO_H_
+
+#include <stdint.h>
+
+/* Compressed framing for an SBUF2 stream.  Once both ends have switched
+   over, every flush goes on the wire as one frame:
+
+       uint32 length of the payload on the wire
+       uint32 uncompressed length, or 0 if the payload is not compressed
+
+   in network byte order, followed by the payload.  A frame with both
+   lengths 0 switches the stream back to plain bytes.  The framing sits
+   under the SBUF2 buffers and above the read/write routines, so it
+   composes with SSL. */
+
+/* Algorithms, as a bitmask when negotiating. */
+enum {
+    COMPIO_NONE = 0,
+    COMPIO_LZ4 = 1,
+    COMPIO_ZSTD = 2
+};
+
+struct compio_stats {
+    int algo;         /* in use, or COMPIO_NONE */
+    int64_t raw_out;  /* bytes handed to the framing */
+    int64_t wire_out; /* bytes it put on the wire */
+    int64_t raw_in;
+    int64_t wire_in;
+};
+
+/* Return the bitmask of algorithms this build can do. */
+int SBUF2_FUNC(compio_supported)(void);
+#define compio_supported SBUF2_FUNC(compio_supported)
+
+/* Return the algorithm to use given the peer's bitmask, or COMPIO_NONE. */
+int SBUF2_FUNC(compio_choose)(int peer_algos);
+#define compio_choose SBUF2_FUNC(compio_choose)
+
+const char *SBUF2_FUNC(compio_name)(int algo);
+#define compio_name SBUF2_FUNC(compio_name)
+
+/* Switch to compressed framing.  Both ends must do this at the same point in
+   the stream, with nothing buffered in either direction.  Flushes shorter
+   than `threshold' bytes go out uncompressed.  Return 0 upon success. */
+int SBUF2_FUNC(compio_start)(SBUF2 *, int algo, int threshold);
+#define compio_start SBUF2_FUNC(compio_start)
+
+/* Switch back to plain bytes.  If `reuse' is set, tell the peer so that the
+   fd can be handed on (to sockpool).  Return 0 upon success. */
+int SBUF2_FUNC(compio_close)(SBUF2 *, int reuse);
+#define compio_close SBUF2_FUNC(compio_close)
+
+int SBUF2_FUNC(compio_read)(SBUF2 *, char *cc, int len);
+#define compio_read SBUF2_FUNC(compio_read)
+int SBUF2_FUNC(compio_write)(SBUF2 *, const char *cc, int len);
+#define compio_write SBUF2_FUNC(compio_write)
+
+/* Return the algorithm in use, or COMPIO_NONE. */
+int SBUF2_FUNC(compio_algo)(SBUF2 *);
+#define compio_algo SBUF2_FUNC(compio_algo)
+
+/* Byte counts since the connection was opened. */
+void SBUF2_FUNC(compio_get_stats)(SBUF2 *, struct compio_stats *);
+#define compio_get_stats SBUF2_FUNC(compio_get_stats)
+#endif
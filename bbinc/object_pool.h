@@ -77,6 +77,10 @@
 ** A FIFO pool returns the least recently returned object from the pool.
 ** A RANDOM pool randomly returns an object from the pool.
 **
+** A LIFO pool keeps a few idle objects per thread in a magazine, which the
+** thread borrows from and returns to without taking the pool's lock. The
+** pool takes them back before evicting, resizing, or making a borrower wait.
+**
 ** A generic object pool can be configured to evict objects due to idle time.
 ** However caution should be used when enabling auto-eviction. If the eviction
 ** thread runs too frequently, performance issues may result. When the eviction
@@ -152,6 +156,9 @@ typedef int (*obj_not_fn)(void **, void *);
 **
 ** OP_IDLE_TIME      - minimum amout of time an object can sit idle in the pool.
 **                     the default setting is 300000 ms (5 min)
+**
+** OP_MAGAZINE_SIZE  - maximum number of idle objects a thread keeps for itself.
+**                     lifo pools only. the default setting is 4, 0 disables
 */
 enum comdb2_objpool_option {
     OP_CAPACITY,
@@ -161,7 +168,8 @@ enum comdb2_objpool_option {
     OP_EVICT_RATIO,
     OP_MIN_IDLES,
     OP_MIN_IDLE_RATIO,
-    OP_IDLE_TIME
+    OP_IDLE_TIME,
+    OP_MAGAZINE_SIZE
 };
 
 /*
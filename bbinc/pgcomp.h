@@ -0,0 +1,80 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef INCLUDED_PGCOMP_H
+#define INCLUDED_PGCOMP_H
+
+/* On-disk form of a compressed database page.  While page_compress is on,
+   a page whose LZ4 image saves at least one filesystem block is written as
+   this header and the image, padded to a whole block, and the rest of the
+   page's slot in the file is punched out.  The header keeps the page's own
+   LSN, page number and type where a page has them, so anything that reads
+   just those off the disk still finds them.
+
+   Whoever includes this must have declared crc32c() first. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <lz4.h>
+
+#define PGCOMP_MAGIC 0x50474331 /* "PGC1" */
+#define PGCOMP_HDRSZ 32
+#define PGCOMP_BLOCK 4096
+
+struct pgcomp_hdr {
+    uint8_t lsn[8];  /* copied from the page */
+    uint8_t pgno[4]; /* copied from the page */
+    uint32_t magic;  /* the rest big-endian */
+    uint32_t clen;   /* bytes of LZ4 image after the header */
+    uint32_t crc;    /* crc32c of the image */
+    uint8_t unused1;
+    uint8_t type; /* copied from the page */
+    uint8_t unused2[6];
+};
+
+static inline int pgcomp_is_compressed(const uint8_t *page)
+{
+    const struct pgcomp_hdr *h = (const struct pgcomp_hdr *)page;
+    return ntohl(h->magic) == PGCOMP_MAGIC;
+}
+
+/* Turn a compressed page back into the page, in place; scratch holds
+   pagesize bytes.  Returns 0, or -1 if the image is damaged and the page is
+   left as it was read. */
+static inline int pgcomp_inflate(uint8_t *page, size_t pagesize,
+                                 uint8_t *scratch)
+{
+    const struct pgcomp_hdr *h = (const struct pgcomp_hdr *)page;
+    uint32_t clen = ntohl(h->clen);
+
+    if (clen == 0 || clen > pagesize - PGCOMP_HDRSZ)
+        return -1;
+    if (crc32c(page + PGCOMP_HDRSZ, clen) != ntohl(h->crc))
+        return -1;
+    if (LZ4_decompress_safe((const char *)page + PGCOMP_HDRSZ,
+                            (char *)scratch, (int)clen,
+                            (int)pagesize) != (int)pagesize)
+        return -1;
+    /* the page must be the one its header says it is */
+    if (memcmp(scratch, page, sizeof(h->lsn) + sizeof(h->pgno)) != 0)
+        return -1;
+    memcpy(page, scratch, pagesize);
+    return 0;
+}
+
+#endif
@@ -103,6 +103,13 @@ hash_t *hash_init_jenkins_o(
     int keyoff, int keylen); /* Bob Jenkins hash, power of 2 sized hash table */
 hash_t *hash_init_user(hashfunc_t *hashfunc, cmpfunc_t *cmpfunc, int keyoff,
                        int keyl);
+/* Open addressing instead of chaining: no allocation per entry, and
+ * hash_find() writes nothing but the stats.  Same API otherwise.  See the
+ * benchmark in plhash.c: it beats hash_init_o() everywhere, but not
+ * hash_init_i4() on i4 keys. */
+hash_t *hash_init_open_o(int keyoff, int keylen); /* fixed len key at keyoff */
+hash_t *hash_init_user_open(hashfunc_t *hashfunc, cmpfunc_t *cmpfunc,
+                            int keyoff, int keyl);
 hash_t *hash_setalloc_init(hashmalloc_t *hashmalloc, hashfree_t *hashfree,
                            int keyoff, int keysz);
 hash_t *hash_setalloc_init_user(hashfunc_t *hashfunc, cmpfunc_t *cmpfunc,
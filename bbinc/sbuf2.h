@@ -64,6 +64,10 @@ typedef int (*sbuf2writefn)(SBUF2 *sb, const char *buf, int nbytes);
 int SBUF2_FUNC(sbuf2fileno)(SBUF2 *sb);
 #define sbuf2fileno SBUF2_FUNC(sbuf2fileno)
 
+/* number of bytes read from the fd but not consumed yet */
+int SBUF2_FUNC(sbuf2pending)(SBUF2 *sb);
+#define sbuf2pending SBUF2_FUNC(sbuf2pending)
+
 /* set flags on an SBUF2 after opening */
 void SBUF2_FUNC(sbuf2setflags)(SBUF2 *sb, int flags);
 #define sbuf2setflags SBUF2_FUNC(sbuf2setflags)
@@ -222,6 +226,9 @@ void SBUF2_FUNC(cleanup_peer_hash)();
 #  include <ssl_io.h>
 #endif
 
+/* Compressed framing. */
+#include <compress_io.h>
+
 #if defined __cplusplus
 }
 #endif
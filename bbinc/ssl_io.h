@@ -46,6 +46,17 @@ int SBUF2_FUNC(sslio_has_ssl)(SBUF2 *);
 int SBUF2_FUNC(sslio_has_x509)(SBUF2 *);
 #define sslio_has_x509 SBUF2_FUNC(sslio_has_x509)
 
+/* Ask for kernel TLS on the next handshake.  OpenSSL falls back to doing
+   the crypto itself if the kernel or the negotiated cipher can't.  Once the
+   kernel has the keys the fd can't go back to plaintext, so a kTLS
+   connection must not be donated to sockpool. */
+void SBUF2_FUNC(sslio_set_ktls)(SBUF2 *, int);
+#define sslio_set_ktls SBUF2_FUNC(sslio_set_ktls)
+
+/* Return 1 if the kernel is doing the crypto in either direction. */
+int SBUF2_FUNC(sslio_has_ktls)(SBUF2 *);
+#define sslio_has_ktls SBUF2_FUNC(sslio_has_ktls)
+
 /* Perform an SSL handshake.
    Return 1 upon success. */
 #if SBUF2_SERVER
@@ -56,6 +56,15 @@
 #define SSL_CRL_OPT "ssl_crl"
 #endif
 #define SSL_MIN_TLS_VER_OPT "ssl_min_tls_ver"
+#define SSL_KTLS_OPT "ssl_ktls"
+#define SSL_TICKET_KEY_OPT "ssl_ticket_key_file"
+
+/* Kernel TLS needs OpenSSL 3.0 built with it. */
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+#define HAVE_KTLS 1
+#else
+#define HAVE_KTLS 0
+#endif
 
 #define SSL_MODE_ALLOW          "ALLOW"
 #define SSL_MODE_REQUIRE        "REQUIRE"
@@ -195,4 +204,23 @@ int SBUF2_FUNC(ssl_new_ctx)(SSL_CTX **pctx, ssl_mode mode, const char *dir,
                             char *err, size_t n);
 #define ssl_new_ctx SBUF2_FUNC(ssl_new_ctx)
 
+#if SBUF2_SERVER
+/*
+ * Use the session ticket keys in a file instead of ones OpenSSL makes up,
+ * so tickets survive a restart and are good on every node given the file.
+ *
+ * PARAMETERS
+ * ctx         - the server SSL context
+ * file        - holds the keys, as random bytes. the first bytes as many
+ *               as OpenSSL wants (80 at most) are used. the file must not
+ *               be open to group or others.
+ * err         - set to NULL to print to stderr
+ * n           - length of the error string buffer
+ *
+ * RETURN VALUES
+ * 0 upon success
+ */
+int ssl_set_ticket_keys(SSL_CTX *ctx, const char *file, char *err, size_t n);
+#endif
+
 #endif
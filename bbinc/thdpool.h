@@ -32,6 +32,7 @@ extern "C" {
 #include "list.h"
 
 struct thdpool;
+struct thdpool_class;
 
 enum thdpool_ioctl_op { THD_RUN, THD_FREE };
 
@@ -65,6 +66,10 @@ struct workitem {
     LINKC_T(struct workitem) linkv;
     int available;
     char *persistent_info;
+    /* fair queueing: owning class and priority within it */
+    struct thdpool_class *cls;
+    int priority;
+    LINKC_T(struct workitem) clslinkv;
 };
 
 typedef void (*thdpool_thdinit_fn)(struct thdpool *pool, void *thddata);
@@ -103,6 +108,30 @@ enum {
 };
 int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
                     int queue_override, char *persistent_info, uint32_t flags);
+/* Like thdpool_enqueue, but when the pool has fair queueing enabled the item is
+ * queued under classkey (NULL for the default class).  Classes are served
+ * weighted round robin; higher priority items run first within a class. */
+int thdpool_enqueue_class(struct thdpool *pool, thdpool_work_fn work_fn,
+                          void *work, int queue_override,
+                          char *persistent_info, uint32_t flags,
+                          const char *classkey, int priority);
+/* Queue work on per thread deques that idle threads steal from, instead of
+ * the shared queue.  Fair queueing, if on, takes precedence. */
+void thdpool_set_work_stealing(struct thdpool *pool, int onoff);
+int thdpool_get_work_stealing(struct thdpool *pool);
+/* CPU affinity of threads started from now on: the pool's own cpu list (see
+ * comdb2_pthread_create.h), or when it has none the list of its thread class
+ * (a COMDB2_THR_CLASS_*).  A NULL or empty list clears the pool's own. */
+void thdpool_set_affinity_class(struct thdpool *pool, int cls);
+int thdpool_set_cpus(struct thdpool *pool, const char *cpus);
+void thdpool_set_fairq(struct thdpool *pool, int onoff);
+int thdpool_get_fairq(struct thdpool *pool);
+int thdpool_set_class_weight(struct thdpool *pool, const char *classkey,
+                             unsigned weight);
+/* Aggregate fair queue stats: number of classes, items refused by admission
+ * control, and the longest time the head of any class queue has waited. */
+void thdpool_get_class_stats(struct thdpool *pool, int *nclasses,
+                             int *nrejected, int *maxwaitms);
 void thdpool_stop(struct thdpool *pool);
 void thdpool_resume(struct thdpool *pool);
 void thdpool_set_exit(struct thdpool *pool);
@@ -68,6 +68,8 @@ void thrman_setid(struct thr_handle *thr, const char *idstr);
 void thrman_setfd(struct thr_handle *thr, int fd);
 void thrman_setsqlthd(struct thr_handle *thr);
 enum thrtype thrman_get_type(struct thr_handle *thr);
+/* Safe to call from a signal handler */
+enum thrtype thrman_self_type(void);
 const char *thrman_type2a(enum thrtype type);
 char *thrman_describe(struct thr_handle *thr, char *buf, size_t szbuf);
 void thrman_dump(void);
@@ -209,6 +209,27 @@ int bdb_prim_addkey_genid(bdb_state_type *bdb_state, tran_type *tran,
     return rc;
 }
 
+/* a genid for a new record, on the stripe the next add goes to */
+static unsigned long long new_dta_genid(bdb_state_type *bdb_state,
+                                        int participantstripid, int *dtafile)
+{
+    bdb_state_type *parent;
+    unsigned long long genid;
+
+    if (bdb_state->parent)
+        parent = bdb_state->parent;
+    else
+        parent = bdb_state;
+
+    *dtafile = bdb_get_active_stripe_int(bdb_state);
+    genid = get_genid(bdb_state, *dtafile);
+
+    if (parent->attr->updategenids && participantstripid > 0) {
+        genid = set_participant_stripeid(bdb_state, participantstripid, genid);
+    }
+    return genid;
+}
+
 static int bdb_prim_allocdta_int(bdb_state_type *bdb_state, tran_type *tran,
                                  void *dta, int dtalen,
                                  unsigned long long *genid,
@@ -218,18 +239,12 @@ static int bdb_prim_allocdta_int(bdb_state_type *bdb_state, tran_type *tran,
     int rc;
     int rrn;
     int dtafile;
-    bdb_state_type *parent;
     int *genid_dta;
     DB *dbp;
 
     if (bdb_write_preamble(bdb_state, bdberr))
         return -1;
 
-    if (bdb_state->parent)
-        parent = bdb_state->parent;
-    else
-        parent = bdb_state;
-
 #ifdef FOO
     /* we DO NOT support variable length dta.  (for dta[0], blobs are above
        that).  therefore, we place a sanity check here to enforce this */
@@ -245,18 +260,9 @@ static int bdb_prim_allocdta_int(bdb_state_type *bdb_state, tran_type *tran,
 
     rrn = 2; /* ALWAYS RETURN RRN 2!  HAHAHAHAHAAA! */
 
-    dtafile = bdb_get_active_stripe_int(bdb_state);
-
-    /*fprintf(stderr, "tid=%d rrn=%d dtafile=%d\n", tid, rrn, dtafile);*/
-
     /* get a genid and formulate a data buffer
        with the genid as the first 8 bytes and the data payload after it */
-    *genid = get_genid(bdb_state, dtafile);
-
-    if (parent->attr->updategenids && participantstripid > 0) {
-        *genid =
-            set_participant_stripeid(bdb_state, participantstripid, *genid);
-    }
+    *genid = new_dta_genid(bdb_state, participantstripid, &dtafile);
 
     if (gbl_debug_omit_dta_write) {
         //needs to be done here intstead of glue.c because need genid to be created because it is used to insert blob and idx
@@ -326,6 +332,14 @@ int bdb_prim_allocdta_genid(bdb_state_type *bdb_state, tran_type *tran,
     return rc;
 }
 
+unsigned long long bdb_prim_newgenid(bdb_state_type *bdb_state,
+                                     int participantstripid)
+{
+    int dtafile;
+
+    return new_dta_genid(bdb_state, participantstripid, &dtafile);
+}
+
 static int bdb_prim_adddta_n_genid_int(bdb_state_type *bdb_state,
                                        tran_type *tran, int dtanum,
                                        void *dtaptr, size_t dtalen, int rrn,
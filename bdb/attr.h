@@ -147,6 +147,31 @@ DEF_ATTR(
     ZLIBLEVEL, zlib_level, QUANTITY, 6,
     "If zlib compression is enabled, this determines the compression level.")
 DEF_ATTR(ZTRACE, ztrace, BOOLEAN, 0, NULL)
+DEF_ATTR(ZSTDLEVEL, zstd_level, QUANTITY, 3,
+         "If zstd compression is enabled, this determines the compression "
+         "level.")
+DEF_ATTR(ZSTD_DICT_SIZE, zstd_dict_size, BYTES, 16384,
+         "Size of the per-table zstd dictionaries trained during analyze. 0 "
+         "disables training.")
+DEF_ATTR(ZSTD_DICT_SAMPLE, zstd_dict_sample, BYTES, 1048576,
+         "Bytes of records sampled from a table to train its zstd "
+         "dictionary.")
+DEF_ATTR(ZSTD_DICT_MAX, zstd_dict_max, QUANTITY, 8,
+         "Most zstd dictionaries kept for a table.  Once it has this many, "
+         "analyze drops the ones no record uses before training another, "
+         "and doesn't train if none can go.")
+DEF_ATTR(IX_BLOOM_BITS, ix_bloom_bits, QUANTITY, 0,
+         "Bits per key of the bloom filters analyze builds for unique "
+         "indexes on the master, to skip unique checks for new keys. 0 "
+         "disables the filters.")
+DEF_ATTR(IX_BLOOM_MEMORY, ix_bloom_memory, MBYTES, 256,
+         "Most memory the bloom filters of unique indexes take between them, "
+         "replaced ones included.  A filter that doesn't fit in what is left "
+         "is built smaller, or not at all.")
+DEF_ATTR(SNAPISOL_VERSION_STORE_SIZE, snapisol_version_store_size, BYTES, 0,
+         "Memory for row versions that snapshot readers rebuilt from the "
+         "log, shared so that other readers do not rebuild them. 0 "
+         "disables the store.")
 DEF_ATTR(PANICLOGSNAP, paniclogsnap, BOOLEAN, 1, NULL)
 DEF_ATTR(UPDATEGENIDS, updategenids, BOOLEAN, 0, NULL)
 DEF_ATTR(ROUND_ROBIN_STRIPES, round_robin_stripes, BOOLEAN, 0,
@@ -248,6 +273,9 @@ DEF_ATTR(TEMPTABLE_MEM_THRESHOLD, temptable_mem_threshold, QUANTITY, 512,
 DEF_ATTR(TEMPTABLE_CACHESZ, temptable_cachesz, BYTES, 262144,
          "Cache size for temporary tables. Temp tables do not share the "
          "database's main buffer pool.")
+DEF_ATTR(TEMPTABLE_INMEM_SZ, temptable_inmem_sz, BYTES, 0,
+         "Keep btree temp tables in memory until they use this many bytes, "
+         "then spill them to disk. 0 disables in-memory btree temp tables.")
 DEF_ATTR(PARTICIPANTID_BITS, participantid_bits, QUANTITY, 0,
          "Number of bits allocated for the participant stripe ID (remaining "
          "bits are used for the update ID).")
@@ -523,6 +551,9 @@ DEF_ATTR(RCACHE_COUNT, rcache_count, QUANTITY, 257,
          "Number of entries in root page cache.")
 DEF_ATTR(RCACHE_PGSZ, rcache_pgsz, BYTES, 4096,
          "Size of pages in root page cache.")
+DEF_ATTR(RCACHE_LEVELS, rcache_levels, QUANTITY, 1,
+         "Number of btree levels, counting from the root, kept in the root "
+         "page cache.")
 DEF_ATTR(DEADLK_PRIORITY_BUMP_ON_FSTBLK, deadlk_priority_bump_on_fstblk,
          QUANTITY, 5, NULL)
 DEF_ATTR(FSTBLK_MINQ, fstblk_minq, QUANTITY, 262144, NULL)
@@ -541,6 +572,9 @@ DEF_ATTR_2(PRIVATE_BLKSEQ_STRIPES, private_blkseq_stripes, QUANTITY, 8,
            "Number of stripes for the blkseq table.", 0, dtastripe_verify, 0)
 DEF_ATTR(PRIVATE_BLKSEQ_ENABLED, private_blkseq_enabled, BOOLEAN, 1,
          "Sets whether dupe detection is enabled.")
+DEF_ATTR(PRIVATE_BLKSEQ_INMEM, private_blkseq_inmem, BOOLEAN, 0,
+         "Keep blkseqs in memory hashes instead of private btrees.  They are "
+         "still logged, and rebuilt from the log on startup.")
 DEF_ATTR(PRIVATE_BLKSEQ_CLOSE_WARN_TIME, private_blkseq_close_warn_time,
          BOOLEAN, 100,
          "Warn when it takes longer than this many MS to roll a blkseq table.")
@@ -580,6 +614,10 @@ DEF_ATTR(RLLIST_STEP, rllist_step, QUANTITY, 10,
          "Reallocate rowlock lists in steps of this size.")
 DEF_ATTR(GENID48_WARN_THRESHOLD, genid48_warn_threshold, QUANTITY, 500000000,
          "Print a warning when there are only as few genids remaining.")
+DEF_ATTR(GENID48_BLOCK_SIZE, genid48_block_size, QUANTITY, 0,
+         "Let each thread reserve this many 48-bit genids at a time and hand "
+         "them out without the global lock.  Genids from different threads "
+         "are then not ordered by allocation time.  0 or 1 disables this.")
 DEF_ATTR(DISABLE_SELECTVONLY_TRAN_NOP, disable_selectvonly_tran_nop, BOOLEAN, 0,
          "Disable verifying rows selected via SELECTV if there's no other "
          "action done by the same transaction.")
@@ -674,6 +712,24 @@ DEF_ATTR(
     "Print a message to stdout instead of performing auto-analyze ourselves")
 DEF_ATTR(TEST_IO_TIME, test_io_time, SECS, 10,
          "Check I/O in watchdog this often")
+DEF_ATTR(FUZZY_CHECKPOINT, fuzzy_checkpoint, BOOLEAN, 0,
+         "Write dirty pages out steadily between checkpoints, oldest "
+         "first-dirtied first, instead of all at once at the checkpoint.")
+DEF_ATTR(PAGE_COMPACT_SWEEP_RATE, page_compact_sweep_rate, QUANTITY, 0,
+         "On the master, read this many btree pages a second, file after "
+         "file, and hand the sparse ones to page compaction. Needs "
+         "page_compact_thresh_ff. 0 turns the sweep off.")
+DEF_ATTR(FSTDUMP_DISCARD_PAGES, fstdump_discard_pages, BOOLEAN, 1,
+         "Read fstdump pages at low buffer pool priority, so a table dump "
+         "doesn't evict the pages other requests are using.")
+DEF_ATTR(REP_ACK_FASTEST_FIRST, rep_ack_fastest_first, BOOLEAN, 1,
+         "When waiting for the first replication ack, try replicants in "
+         "order of their recent replication times, quickest first. Needs "
+         "track_replication_times.")
+DEF_ATTR(DURABLE_MAJORITY_WAITMS, durable_majority_waitms, MSECS, 0,
+         "With durable_lsns, once a majority of the cluster has acked a "
+         "commit, wait at most this long for the other replicants before "
+         "making them incoherent. 0 waits the usual replication timeout.")
 
 /*
   BDB_ATTR_REPTIMEOUT
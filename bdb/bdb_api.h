@@ -274,7 +274,8 @@ enum COMPRESS {
     BDB_COMPRESS_ZLIB = 1,
     BDB_COMPRESS_RLE8 = 2,
     BDB_COMPRESS_CRLE = 3,
-    BDB_COMPRESS_LZ4 = 4
+    BDB_COMPRESS_LZ4 = 4,
+    BDB_COMPRESS_ZSTD = 5
 };
 
 int bdb_compr2algo(const char *a);
@@ -683,6 +684,9 @@ int bdb_tran_abort_logical(bdb_state_type *bdb_handle, tran_type *tran,
 int bdb_prim_allocdta_genid(bdb_state_type *bdb_handle, tran_type *tran,
                             void *dtaptr, int dtalen, unsigned long long *genid,
                             int updateid, int *bdberr);
+/* The genid bdb_prim_allocdta_genid would give a record, for a record added
+   with bdb_prim_adddta_n_genid after something that has to know its genid */
+unsigned long long bdb_prim_newgenid(bdb_state_type *bdb_handle, int updateid);
 int bdb_prim_adddta_n_genid(bdb_state_type *bdb_state, tran_type *tran,
                             int dtanum, void *dtaptr, size_t dtalen, int rrn,
                             unsigned long long genid, int *bdberr,
@@ -1045,6 +1049,7 @@ int bdb_load_cache(bdb_state_type *bdb_state, const char *file);
 
 /* Load default cache */
 int bdb_load_cache_default(bdb_state_type *bdb_state);
+void create_load_cache_thread(bdb_state_type *bdb_state);
 
 /* Flush default cache */
 int bdb_dump_cache_default(bdb_state_type *bdb_state);
@@ -1152,6 +1157,8 @@ int bdb_temp_table_close(bdb_state_type *bdb_state, struct temp_table *table,
 
 int bdb_temp_table_truncate(bdb_state_type *bdb_state, struct temp_table *tbl,
                             int *bdberr);
+int bdb_temp_table_reset(bdb_state_type *bdb_state, struct temp_table *tbl,
+                         int *bdberr);
 
 struct temp_cursor *bdb_temp_table_cursor(bdb_state_type *bdb_state,
                                           struct temp_table *table,
@@ -1214,6 +1221,10 @@ void bdb_stripe_done(bdb_state_type *bdb_state);
 
 int bdb_count(bdb_state_type *bdb_state, int *bdberr);
 
+/* count the rows of a table walking its data stripes, or reusing the counts
+   of the unchanged ones if direct_count_cache is on */
+int bdb_table_direct_count(bdb_state_type *bdb_state, int64_t *count);
+
 struct bdb_temp_hash *bdb_temp_hash_create(bdb_state_type *bdb_state,
                                            char *tmpname, int *bdberr);
 struct bdb_temp_hash *bdb_temp_hash_create_cache(bdb_state_type *bdb_state,
@@ -1374,6 +1385,61 @@ int bdb_get_view(tran_type *t, const char *view_name, char **view_def);
 int bdb_put_view(tran_type *t, const char *view_name, char *view_def);
 int bdb_del_view(tran_type *t, const char *view_name);
 
+int bdb_get_zstd_dict(tran_type *t, const char *table, unsigned int dictid,
+                      void **dict, int *len);
+int bdb_put_zstd_dict(tran_type *t, const char *table, unsigned int dictid,
+                      void *dict, int len);
+int bdb_get_zstd_dict_ids(tran_type *t, const char *table, unsigned int **ids,
+                          int *n);
+int bdb_del_zstd_dicts(tran_type *t, const char *table, unsigned int *ids,
+                       int n);
+int bdb_zstd_train_dict(bdb_state_type *bdb_state);
+void bdb_zstd_dict_report(bdb_state_type *bdb_state);
+
+int bdb_get_cdc_lsn(const char *name, unsigned int *file,
+                    unsigned int *offset);
+int bdb_set_cdc_lsn(const char *name, unsigned int file, unsigned int offset);
+int bdb_ixbloom_build(bdb_state_type *bdb_state);
+int bdb_ixbloom_absent(bdb_state_type *bdb_state, int ixnum, const void *key,
+                       int keylen);
+void bdb_row_cache_report(void);
+void bdb_llmeta_cache_report(void);
+
+/* Cache figures for one table's files of a kind, summed over its stripes */
+struct bdb_cache_stats {
+    uint64_t pages; /* pages in the cache */
+    uint64_t bytes;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t pages_in;
+    uint64_t pages_out;
+    uint64_t evictions;
+};
+/* ixnum is an index, or BDB_CACHE_STATS_DATA / BDB_CACHE_STATS_BLOBS */
+#define BDB_CACHE_STATS_DATA -1
+#define BDB_CACHE_STATS_BLOBS -2
+void bdb_get_file_cache_stats(bdb_state_type *bdb_state, int ixnum,
+                              struct bdb_cache_stats *st);
+
+/* Stages of a commit's replication, each timed per peer, see rep_stages.c */
+enum {
+    BDB_REP_STAGE_LOG_PUT = 0,
+    BDB_REP_STAGE_NET_ENQUEUE = 1,
+    BDB_REP_STAGE_WRITER_SEND = 2,
+    BDB_REP_STAGE_REPLICANT_RECEIVE = 3,
+    BDB_REP_STAGE_APPLY = 4,
+    BDB_REP_STAGE_ACK_SEND = 5,
+    BDB_REP_STAGE_ACK_RECEIVE = 6,
+    BDB_REP_STAGE_MAX = 7
+};
+struct hdrhist;
+const char *bdb_rep_stage_name(int stage);
+/* A stage's histograms merged over all peers */
+void bdb_rep_stage_get(int stage, struct hdrhist *out);
+typedef int (*bdb_rep_stage_collect_f)(void *arg, const char *host, int stage,
+                                       const struct hdrhist *h);
+int bdb_rep_stages_collect(bdb_rep_stage_collect_f func, void *arg);
+
 int bdb_append_file_version(char *str_buf, size_t buflen,
                             unsigned long long version_num, int *bdberr);
 int bdb_unappend_file_version(bdb_state_type *bdb_state, int *bdberr);
@@ -1696,6 +1762,7 @@ void bdb_set_csc2_version(bdb_state_type *bdb_state, uint8_t version);
 int bdb_get_active_stripe(bdb_state_type *bdb_state);
 
 void bdb_set_datacopy_odh(bdb_state_type *, int);
+void bdb_set_partial_datacopy(bdb_state_type *, int ixnum, int dtalen);
 
 extern void bdb_dump_active_locks(bdb_state_type *bdb_state, FILE *out);
 
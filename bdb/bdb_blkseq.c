@@ -42,6 +42,122 @@ static int bdb_blkseq_update_lsn_locked(bdb_state_type *bdb_state,
 
 extern int gbl_is_physical_replicant;
 
+/* In-memory blkseqs (private_blkseq_inmem).  Each stripe has two hashes in
+ * place of the two btrees, and they roll the same way.  A find or insert is
+ * a hash probe under the stripe lock, with no mpool pages to latch or
+ * write.  Durability doesn't change: the insert is logged with the
+ * transaction and bdb_recover_blkseq rebuilds the hashes from the log. */
+struct blkseq_mem_key {
+    int len;
+    const void *data;
+};
+
+struct blkseq_mem {
+    struct blkseq_mem_key key; /* first, for the hash */
+    int datalen;
+    uint8_t *data;
+    uint8_t mem[]; /* key, then data */
+};
+
+static unsigned int blkseq_mem_hashfunc(const void *k, int len)
+{
+    const struct blkseq_mem_key *key = k;
+    const uint8_t *p = key->data;
+    unsigned int h = 2166136261U;
+    for (int i = 0; i < key->len; i++)
+        h = (h ^ p[i]) * 16777619U;
+    return h;
+}
+
+static int blkseq_mem_cmpfunc(const void *k1, const void *k2, int len)
+{
+    const struct blkseq_mem_key *l = k1, *r = k2;
+    if (l->len != r->len)
+        return l->len - r->len;
+    return memcmp(l->data, r->data, l->len);
+}
+
+static hash_t *blkseq_mem_create(void)
+{
+    return hash_init_user(blkseq_mem_hashfunc, blkseq_mem_cmpfunc, 0,
+                          sizeof(struct blkseq_mem_key));
+}
+
+static int blkseq_mem_free_ent(void *obj, void *arg)
+{
+    free(obj);
+    return 0;
+}
+
+static void blkseq_mem_destroy(hash_t *h)
+{
+    if (h == NULL)
+        return;
+    hash_for(h, blkseq_mem_free_ent, NULL);
+    hash_clear(h);
+    hash_free(h);
+}
+
+/* These mirror the btree get/put/del calls below, lock held by caller */
+static int blkseq_get(bdb_state_type *bdb_state, int i, int stripe, DBT *dkey,
+                      DBT *ddata)
+{
+    struct blkseq_mem_key key = {.len = dkey->size, .data = dkey->data};
+    struct blkseq_mem *ent;
+
+    if (!bdb_state->pvt_blkseq_inmem)
+        return bdb_state->blkseq[i][stripe]->get(bdb_state->blkseq[i][stripe],
+                                                 NULL, dkey, ddata, 0);
+    if ((ent = hash_find(bdb_state->blkseq_mem[i][stripe], &key)) == NULL)
+        return DB_NOTFOUND;
+    /* always a fresh buffer, the caller frees it */
+    if ((ddata->data = malloc(ent->datalen)) == NULL)
+        return ENOMEM;
+    memcpy(ddata->data, ent->data, ent->datalen);
+    ddata->size = ent->datalen;
+    return 0;
+}
+
+static int blkseq_put(bdb_state_type *bdb_state, int stripe, DBT *dkey,
+                      DBT *ddata)
+{
+    struct blkseq_mem_key key = {.len = dkey->size, .data = dkey->data};
+    struct blkseq_mem *ent;
+
+    if (!bdb_state->pvt_blkseq_inmem)
+        return bdb_state->blkseq[0][stripe]->put(bdb_state->blkseq[0][stripe],
+                                                 NULL, dkey, ddata,
+                                                 DB_NOOVERWRITE);
+    if (hash_find(bdb_state->blkseq_mem[0][stripe], &key) != NULL)
+        return DB_KEYEXIST;
+    ent = malloc(sizeof(struct blkseq_mem) + dkey->size + ddata->size);
+    if (ent == NULL)
+        return ENOMEM;
+    memcpy(ent->mem, dkey->data, dkey->size);
+    ent->key.len = dkey->size;
+    ent->key.data = ent->mem;
+    ent->data = ent->mem + dkey->size;
+    ent->datalen = ddata->size;
+    memcpy(ent->data, ddata->data, ddata->size);
+    hash_add(bdb_state->blkseq_mem[0][stripe], ent);
+    return 0;
+}
+
+static int blkseq_del(bdb_state_type *bdb_state, int i, int stripe, DBT *dkey)
+{
+    struct blkseq_mem_key key = {.len = dkey->size, .data = dkey->data};
+    struct blkseq_mem *ent;
+
+    if (!bdb_state->pvt_blkseq_inmem)
+        return bdb_state->blkseq[i][stripe]->del(bdb_state->blkseq[i][stripe],
+                                                 NULL, dkey, 0);
+    if ((ent = hash_find(bdb_state->blkseq_mem[i][stripe], &key)) == NULL)
+        return DB_NOTFOUND;
+    hash_del(bdb_state->blkseq_mem[i][stripe], ent);
+    free(ent);
+    return 0;
+}
+
 static DB *create_blkseq(bdb_state_type *bdb_state, int stripe, int num)
 {
     char fname[1024];
@@ -86,8 +202,21 @@ void bdb_cleanup_private_blkseq(bdb_state_type *bdb_state)
 {
     if (!bdb_state) 
         return;
+    if (bdb_state->pvt_blkseq_inmem) {
+        for (int stripe = 0; stripe < bdb_state->pvt_blkseq_stripes;
+             stripe++) {
+            Pthread_mutex_destroy(&bdb_state->blkseq_lk[stripe]);
+            for (int i = 0; i < 2; i++)
+                blkseq_mem_destroy(bdb_state->blkseq_mem[i][stripe]);
+        }
+        for (int i = 0; i < 2; i++) {
+            free(bdb_state->blkseq_mem[i]);
+            bdb_state->blkseq_mem[i] = NULL;
+        }
+    }
     for (int stripe = 0; stripe < bdb_state->pvt_blkseq_stripes; stripe++) {
-        DB_ENV *env = bdb_state->blkseq_env[stripe];
+        DB_ENV *env = bdb_state->blkseq_env ? bdb_state->blkseq_env[stripe]
+                                            : NULL;
         if (env) {
             Pthread_mutex_destroy(&bdb_state->blkseq_lk[stripe]);
             for (int i = 0; i < 2; i++) {
@@ -144,6 +273,25 @@ int bdb_create_private_blkseq(bdb_state_type *bdb_state)
 
     bdb_state->blkseq_log_list = malloc(nstripes * sizeof(listc_t));
 
+    bdb_state->pvt_blkseq_inmem = bdb_state->attr->private_blkseq_inmem;
+    if (bdb_state->pvt_blkseq_inmem) {
+        bdb_state->blkseq_mem[0] = malloc(nstripes * sizeof(hash_t *));
+        bdb_state->blkseq_mem[1] = malloc(nstripes * sizeof(hash_t *));
+        for (int stripe = 0; stripe < nstripes; stripe++) {
+            bdb_state->blkseq_env[stripe] = NULL;
+            Pthread_mutex_init(&bdb_state->blkseq_lk[stripe], NULL);
+            for (int i = 0; i < 2; i++) {
+                bdb_state->blkseq[i][stripe] = NULL;
+                bdb_state->blkseq_mem[i][stripe] = blkseq_mem_create();
+                bzero(&bdb_state->blkseq_last_lsn[i][stripe], sizeof(DB_LSN));
+            }
+            listc_init(&bdb_state->blkseq_log_list[stripe],
+                       offsetof(struct seen_blkseq, lnk));
+        }
+        bdb_state->blkseq_last_roll_time = comdb2_time_epoch();
+        return 0;
+    }
+
     for (int stripe = 0; stripe < nstripes; stripe++) {
         rc = db_env_create(&env, 0);
         if (rc) {
@@ -232,9 +380,7 @@ int bdb_blkseq_recover(DB_ENV *dbenv, u_int32_t rectype, llog_blkseq_args *args,
         // printf("%d seconds old %x %x %x ", now - args->time, p[0], p[1],
         // p[2]);
         Pthread_mutex_lock(&bdb_state->blkseq_lk[stripe]);
-        rc = bdb_state->blkseq[0][stripe]->put(bdb_state->blkseq[0][stripe],
-                NULL, &args->key,
-                &args->data, DB_NOOVERWRITE);
+        rc = blkseq_put(bdb_state, stripe, &args->key, &args->data);
         if (rc == 0) {
             bdb_state->blkseq_last_lsn[0][stripe] = *lsn;
             rc = bdb_blkseq_update_lsn_locked(bdb_state, args->time, *lsn,
@@ -253,11 +399,9 @@ int bdb_blkseq_recover(DB_ENV *dbenv, u_int32_t rectype, llog_blkseq_args *args,
         stripe =
             get_stripe(bdb_state, (uint8_t *)args->key.data, args->key.size);
         Pthread_mutex_lock(&bdb_state->blkseq_lk[stripe]);
-        rc = bdb_state->blkseq[0][stripe]->del(bdb_state->blkseq[0][stripe],
-                                               NULL, &args->key, 0);
+        rc = blkseq_del(bdb_state, 0, stripe, &args->key);
         if (rc == 0 || rc == DB_NOTFOUND) {
-            rc = bdb_state->blkseq[1][stripe]->del(bdb_state->blkseq[1][stripe],
-                                                   NULL, &args->key, 0);
+            rc = blkseq_del(bdb_state, 1, stripe, &args->key);
             if (rc == DB_NOTFOUND)
                 rc = 0;
         }
@@ -319,8 +463,7 @@ int bdb_blkseq_find(bdb_state_type *bdb_state, tran_type *tran, void *key,
     dkey.data = key;
     dkey.size = klen;
     for (int i = 0; i < 2; i++) {
-        rc = bdb_state->blkseq[i][stripe]->get(bdb_state->blkseq[i][stripe],
-                                               NULL, &dkey, &ddata, 0);
+        rc = blkseq_get(bdb_state, i, stripe, &dkey, &ddata);
         if (rc == 0) {
             if (dtaout)
                 *dtaout = ddata.data;
@@ -366,8 +509,7 @@ int bdb_blkseq_insert(bdb_state_type *bdb_state, tran_type *tran, void *key,
     now = comdb2_time_epoch();
 
     for (int i = 0; i < 2; i++) {
-        rc = bdb_state->blkseq[i][stripe]->get(bdb_state->blkseq[i][stripe],
-                                               NULL, &dkey, &ddata, 0);
+        rc = blkseq_get(bdb_state, i, stripe, &dkey, &ddata);
         if (rc == 0) {
             if (dtaout)
                 *dtaout = ddata.data;
@@ -385,8 +527,7 @@ int bdb_blkseq_insert(bdb_state_type *bdb_state, tran_type *tran, void *key,
 
     /* not found in either tree - put it in the first */
 
-    rc = bdb_state->blkseq[0][stripe]->put(bdb_state->blkseq[0][stripe], NULL,
-                                           &dkey, &ddata, DB_NOOVERWRITE);
+    rc = blkseq_put(bdb_state, stripe, &dkey, &ddata);
     if (rc) {
         logmsg(LOGMSG_ERROR, "blkseq put stripe %d error %d\n", stripe, rc);
         Pthread_mutex_unlock(&bdb_state->blkseq_lk[stripe]);
@@ -466,6 +607,18 @@ int bdb_blkseq_clean(bdb_state_type *bdb_state, uint8_t stripe)
             goto done;
     }
 
+    if (bdb_state->pvt_blkseq_inmem) {
+        hash_t *newh = blkseq_mem_create();
+        hash_t *oldh = bdb_state->blkseq_mem[1][stripe];
+        bdb_state->blkseq_mem[1][stripe] = bdb_state->blkseq_mem[0][stripe];
+        bdb_state->blkseq_mem[0][stripe] = newh;
+        bdb_state->blkseq_last_lsn[1][stripe] =
+            bdb_state->blkseq_last_lsn[0][stripe];
+        bdb_state->blkseq_last_roll_time = now;
+        blkseq_mem_destroy(oldh);
+        goto done;
+    }
+
     /* create a new db first */
     newdb = create_blkseq(bdb_state, stripe, 0);
     if (newdb == NULL) {
@@ -526,6 +679,28 @@ done:
     return rc;
 }
 
+struct blkseq_mem_iter {
+    int stripe;
+    int ix;
+    DB_LSN *lsn;
+    void (*func)(int, int, void *, void *, void *, void *);
+    void *arg;
+};
+
+static int blkseq_mem_for_each(void *obj, void *arg)
+{
+    struct blkseq_mem *ent = obj;
+    struct blkseq_mem_iter *iter = arg;
+    DBT dkey = {0}, ddata = {0};
+
+    dkey.data = (void *)ent->key.data;
+    dkey.size = ent->key.len;
+    ddata.data = ent->data;
+    ddata.size = ent->datalen;
+    iter->func(iter->stripe, iter->ix, iter->lsn, &dkey, &ddata, iter->arg);
+    return 0;
+}
+
 static int bdb_blkseq_stripe_for_each(bdb_state_type *bdb_state, uint8_t stripe,
                                       void *arg,
                                       void (*func)(int, int, void *, void *,
@@ -538,6 +713,19 @@ static int bdb_blkseq_stripe_for_each(bdb_state_type *bdb_state, uint8_t stripe,
     dkey.flags = ddata.flags = DB_DBT_REALLOC;
     Pthread_mutex_lock(&bdb_state->blkseq_lk[stripe]);
 
+    if (bdb_state->pvt_blkseq_inmem) {
+        struct blkseq_mem_iter iter = {
+            .stripe = stripe, .func = func, .arg = arg};
+        for (int i = 0; i < 2; i++) {
+            iter.ix = i;
+            iter.lsn = &(bdb_state->blkseq_last_lsn[i][stripe]);
+            hash_for(bdb_state->blkseq_mem[i][stripe], blkseq_mem_for_each,
+                     &iter);
+        }
+        rc = 0;
+        goto done;
+    }
+
     for (int i = 0; i < 2; i++) {
         rc = bdb_state->blkseq[i][stripe]->cursor(bdb_state->blkseq[i][stripe],
                                                   NULL, &dbc, 0);
@@ -98,6 +98,9 @@ typedef struct bdb_cursor_ifn {
     /* Get pageorder information. */
     int (*getpageorder)(struct bdb_cursor_ifn *cur);
 
+    /* Restrict a data cursor to one stripe. */
+    int (*setstripe)(struct bdb_cursor_ifn *cur, int stripe);
+
     /* Update my shadows. */
     int (*updateshadows)(struct bdb_cursor_ifn *cur, int *bdberr);
     int (*updateshadows_pglogs)(struct bdb_cursor_ifn *cur, unsigned *inpgno,
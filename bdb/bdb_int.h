@@ -598,6 +598,7 @@ struct bdb_cursor_impl_tag {
 
     /* page-order flags */
     int pageorder;       /* mark if the cursor is in page-order */
+    int onestripe;       /* if >= 0, moves stay inside this data stripe */
     int discardpages;    /* mark if the pages should be discarded immediately */
     tmptable_t *vs_stab; /* Table of records to skip in the virtual stripe. */
     tmpcursor_t *vs_skip; /* Cursor for vs_stab. */
@@ -814,6 +815,14 @@ struct bdb_state_tag {
                                      they are not. */
     DB *dbp_ix[MAXINDEX];                    /* handle for the ixN files */
 
+    /* row count of each data stripe, good while its mpool file is unchanged,
+       see bdb_direct_count */
+    struct bdb_stripe_count {
+        u_int8_t fileid[DB_FILE_ID_LEN];
+        u_int64_t dirty_gen;
+        int64_t count;
+    } stripe_count[MAXDTASTRIPE];
+
     pthread_key_t tid_key;
 
     int numthreads;
@@ -827,6 +836,8 @@ struct bdb_state_tag {
     short numix;        /* number of indexes */
     short ixlen[MAXINDEX];            /* size of each index */
     signed char ixdta[MAXINDEX];      /* does this index contain the dta? */
+    int ixdtalen[MAXINDEX]; /* for partial datacopy, length of the copied
+                               columns; 0 if the index contains all of it */
     signed char ixcollattr[MAXINDEX]; /* does this index contain the column
                                          attributes? */
     signed char ixnulls[MAXINDEX];    /*does this index contain any columns that
@@ -857,6 +868,8 @@ struct bdb_state_tag {
     signed char bdb_lock_desired; /* signal that long running operations like
                                      fast dump should GET OUT! so that we can
                                      upgrade/downgrade */
+    int bdb_lock_rbias; /* readers may skip bdb_lock, see bdblock.c */
+    int64_t bdb_lock_inhibit_until; /* no reader bias before this (us) */
 
     void *usr_ptr;
 
@@ -924,6 +937,7 @@ struct bdb_state_tag {
     pthread_mutex_t id_lock;
     unsigned int id;
     pthread_mutex_t gblcontext_lock;
+    int genid_block_epoch; /* bumped to retire per-thread genid blocks */
     pthread_mutex_t children_lock;
     signed char have_children_lock;
 
@@ -1022,6 +1036,8 @@ struct bdb_state_tag {
     DB_LSN *blkseq_last_lsn[2];
     listc_t *blkseq_log_list;
     int pvt_blkseq_stripes;
+    int pvt_blkseq_inmem;
+    hash_t **blkseq_mem[2];
     uint32_t genid_format;
 
     /* we keep a per bdb_state copy to enhance locality */
@@ -1030,6 +1046,9 @@ struct bdb_state_tag {
 
     pthread_mutex_t durable_lsn_lk;
     uint16_t *fld_hints;
+    struct zstd_dicts *zstd_dicts; /* trained zstd dictionaries, see odh.c */
+    struct ix_bloom *ix_bloom[MAXINDEX]; /* unique index key filters, see
+                                            ixbloom.c */
 
     int hellofd;
 
@@ -1169,6 +1188,11 @@ extern pthread_key_t bdb_key;
 char *bdb_strerror(int error);
 char *bdb_trans(const char infile[], char outfile[]);
 
+/* Set up a bare DB handle for reading a btree file's pages from its meta
+ * page; NULL if it isn't a btree */
+struct _dbmeta33;
+DB *dbp_from_meta(DB *dbp, struct _dbmeta33 *meta);
+
 void *mymalloc(size_t size);
 void myfree(void *ptr);
 void *myrealloc(void *ptr, size_t size);
@@ -1179,6 +1203,9 @@ int bdb_downgrade_noelect(bdb_state_type *bdb_state);
 int get_seqnum(bdb_state_type *bdb_state, const char *host);
 void bdb_set_key(bdb_state_type *bdb_state);
 
+/* forget the cached row count of a data stripe */
+void bdb_stripe_count_reset(bdb_state_type *bdb_state, int stripe);
+
 uint64_t subtract_lsn(bdb_state_type *bdb_state, DB_LSN *lsn1, DB_LSN *lsn2);
 void get_my_lsn(bdb_state_type *bdb_state, DB_LSN *lsnout);
 void rep_all_req(bdb_state_type *bdb_state);
@@ -1625,6 +1652,10 @@ int bdb_temp_table_clear_cache(bdb_state_type *bdb_state);
 int bdb_temp_table_create_pool_wrapper(void **tblp, void *bdb_state_arg);
 int bdb_temp_table_destroy_pool_wrapper(void *tbl, void *bdb_state_arg);
 int bdb_temp_table_notify_pool_wrapper(void **tblp, void *bdb_state_arg);
+extern int gbl_temptable_prewarm;
+extern int gbl_temptable_async_cleanup;
+void *bdb_temp_table_prewarm_thread(void *arg);
+void bdb_temp_table_prewarm_report(void);
 int bdb_temp_table_move(bdb_state_type *bdb_state, struct temp_cursor *cursor,
                         int how, int *bdberr);
 int bdb_temp_table_keysize(struct temp_cursor *cursor);
@@ -1785,6 +1816,25 @@ void start_udp_reader(bdb_state_type *bdb_state);
 void *udpbackup_and_autoanalyze_thd(void *arg);
 
 int do_ack(bdb_state_type *bdb_state, DB_LSN permlsn, uint32_t generation);
+void bdb_zstd_free(bdb_state_type *bdb_state);
+void bdb_ixbloom_free(bdb_state_type *bdb_state);
+void bdb_ixbloom_add(bdb_state_type *bdb_state, int ixnum, const void *key,
+                     int keylen, int count);
+int bdb_verstore_find(bdb_state_type *bdb_state, DB_LSN *lsn,
+                      unsigned long long genid, void *buf, int buflen);
+void bdb_verstore_add(bdb_state_type *bdb_state, DB_LSN *lsn,
+                      unsigned long long genid, const void *row, int len);
+int bdb_row_cache_gen(DB *dbp, u_int64_t *gen);
+int bdb_row_cache_get(DB *dbp, unsigned long long genid, u_int64_t gen,
+                      void *dta, int dtalen, int *reqdtalen, uint8_t *ver);
+void bdb_row_cache_put(DB *dbp, unsigned long long genid, u_int64_t gen,
+                       const void *dta, int len, uint8_t ver);
+int bdb_llmeta_cache_gen(bdb_state_type *bdb_state, DB_TXN *tid, int keylen,
+                         u_int64_t *gen);
+int bdb_llmeta_cache_get(const void *key, u_int64_t gen, DBT *data, int *rc);
+void bdb_llmeta_cache_put(bdb_state_type *bdb_state, const void *key,
+                          u_int64_t gen, const DBT *data, int rc);
+void bdb_verstore_stat(void);
 void berkdb_receive_rtn(void *ack_handle, void *usr_ptr, char *from_host,
                         int usertype, void *dta, int dtalen, uint8_t is_tcp);
 void berkdb_receive_msg(void *ack_handle, void *usr_ptr, char *from_host,
@@ -1898,4 +1948,13 @@ int bdb_list_all_fileids_for_newsi(bdb_state_type *, hash_t *);
 int bdb_prepare_put_pack_updateid(bdb_state_type *bdb_state, int is_blob,
                                   DBT *data, DBT *data2, int updateid,
                                   void **freeptr, void *stackbuf, int odhready);
+extern int gbl_rep_stage_sample;
+int bdb_rep_stage_sampled(const DB_LSN *lsn);
+void bdb_rep_stage_record(const char *host, int stage, uint64_t us);
+/* A timed commit was sent to host; the time to its ack is taken from now */
+void bdb_rep_stage_sent(const char *host, const DB_LSN *lsn, uint64_t now_us);
+void bdb_rep_stage_acked(const char *host, const DB_LSN *lsn);
+void bdb_rep_stage_net_latency(netinfo_type *netinfo, const char *host,
+                               uint64_t us);
+
 #endif /* __bdb_int_h__ */
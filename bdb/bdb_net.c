@@ -26,6 +26,8 @@
 #include <sys/time.h>
 #include <errno.h>
 #include <ctype.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "bdb_api.h"
 #include "bdb_int.h"
@@ -140,7 +142,8 @@ void disable_ack_trace(void)
     gbl_ack_trace = 0;
 }
 
-int do_ack(bdb_state_type *bdb_state, DB_LSN permlsn, uint32_t generation)
+static int send_ack(bdb_state_type *bdb_state, DB_LSN permlsn,
+                    uint32_t generation)
 {
     int rc;
     char *master;
@@ -198,6 +201,107 @@ int do_ack(bdb_state_type *bdb_state, DB_LSN permlsn, uint32_t generation)
     return rc;
 }
 
+/* Ack batching: acks are cumulative (the master takes a node's latest lsn as
+ * covering everything before it), so with rep_ack_batch_usec set, commits
+ * hand their lsn to an ack thread instead of sending it themselves.  The
+ * thread sends at most one ack per interval, always the latest lsn; an ack
+ * that arrives after a quiet interval goes out right away. */
+int gbl_rep_ack_batch_usec = 0;
+int64_t gbl_rep_acks_sent = 0;
+int64_t gbl_rep_acks_coalesced = 0;
+
+static pthread_mutex_t ack_lk = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ack_cd = PTHREAD_COND_INITIALIZER;
+static int ack_thread_running = 0;
+static int ack_pending = 0;
+static DB_LSN ack_lsn;
+static uint32_t ack_generation;
+
+static void *ack_thread(void *arg)
+{
+    bdb_state_type *bdb_state = arg;
+    struct timespec ts;
+    uint64_t last_us = 0, now_us, wait_us;
+    struct timeval tv;
+    DB_LSN lsn;
+    uint32_t generation;
+
+    bdb_thread_event(bdb_state, BDBTHR_EVENT_START_RDONLY);
+
+    Pthread_mutex_lock(&ack_lk);
+    while (!db_is_stopped()) {
+        if (!ack_pending) {
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec++;
+            pthread_cond_timedwait(&ack_cd, &ack_lk, &ts);
+            continue;
+        }
+
+        gettimeofday(&tv, NULL);
+        now_us = tv.tv_sec * 1000000ULL + tv.tv_usec;
+        wait_us = last_us + gbl_rep_ack_batch_usec;
+        if (now_us < wait_us) {
+            /* acks that come in meanwhile replace the pending one */
+            Pthread_mutex_unlock(&ack_lk);
+            usleep(wait_us - now_us);
+            Pthread_mutex_lock(&ack_lk);
+            gettimeofday(&tv, NULL);
+            now_us = tv.tv_sec * 1000000ULL + tv.tv_usec;
+        }
+
+        lsn = ack_lsn;
+        generation = ack_generation;
+        ack_pending = 0;
+        Pthread_mutex_unlock(&ack_lk);
+
+        send_ack(bdb_state, lsn, generation);
+        last_us = now_us;
+        gbl_rep_acks_sent++;
+
+        Pthread_mutex_lock(&ack_lk);
+    }
+    ack_thread_running = 0;
+    Pthread_mutex_unlock(&ack_lk);
+
+    bdb_thread_event(bdb_state, BDBTHR_EVENT_DONE_RDONLY);
+    return NULL;
+}
+
+int do_ack(bdb_state_type *bdb_state, DB_LSN permlsn, uint32_t generation)
+{
+    pthread_t tid;
+    int rc;
+
+    if (gbl_rep_ack_batch_usec <= 0)
+        return send_ack(bdb_state, permlsn, generation);
+
+    if (permlsn.file == 0)
+        abort();
+
+    Pthread_mutex_lock(&ack_lk);
+    if (!ack_thread_running) {
+        extern pthread_attr_t gbl_pthread_attr_detached;
+        rc = pthread_create(&tid, &gbl_pthread_attr_detached, ack_thread,
+                            bdb_state);
+        if (rc != 0) {
+            Pthread_mutex_unlock(&ack_lk);
+            logmsg(LOGMSG_ERROR, "%s: pthread_create ack_thread: %s\n",
+                   __func__, strerror(rc));
+            return send_ack(bdb_state, permlsn, generation);
+        }
+        ack_thread_running = 1;
+    }
+    if (ack_pending)
+        gbl_rep_acks_coalesced++;
+    ack_lsn = permlsn;
+    ack_generation = generation;
+    ack_pending = 1;
+    Pthread_cond_signal(&ack_cd);
+    Pthread_mutex_unlock(&ack_lk);
+
+    return 0;
+}
+
 void comdb2_early_ack(DB_ENV *dbenv, DB_LSN permlsn, uint32_t generation)
 {
     bdb_state_type *bdb_state = (bdb_state_type *)dbenv->app_private;
@@ -381,6 +485,7 @@ int udppfault_thdpool_init(void)
     thdpool_set_maxqueue(gbl_udppfault_thdpool, 1000);
     thdpool_set_linger(gbl_udppfault_thdpool, 10);
     thdpool_set_longwaitms(gbl_udppfault_thdpool, 10000);
+    thdpool_set_work_stealing(gbl_udppfault_thdpool, 1);
 
     return 0;
 }
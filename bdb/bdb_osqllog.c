@@ -4129,9 +4129,17 @@ static int bdb_osql_log_get_optim_data_int(bdb_state_type *bdb_state,
             ptr = dtabuf;
         }
 
-        rc =
-            bdb_reconstruct_delete(bdb_state, lsn, NULL, NULL, NULL,
-                                   sizeof(genid_t), ptr, del_dta->dtalen, NULL);
+        if (bdb_verstore_find(bdb_state, lsn, del_dta->genid, ptr,
+                              del_dta->dtalen) == 0) {
+            rc = 0;
+        } else {
+            rc = bdb_reconstruct_delete(bdb_state, lsn, NULL, NULL, NULL,
+                                        sizeof(genid_t), ptr, del_dta->dtalen,
+                                        NULL);
+            if (rc == 0)
+                bdb_verstore_add(bdb_state, lsn, del_dta->genid, ptr,
+                                 del_dta->dtalen);
+        }
         if (rc) {
             if (gbl_abort_on_reconstruct_failure)
                 abort();
@@ -4177,15 +4185,24 @@ static int bdb_osql_log_get_optim_data_int(bdb_state_type *bdb_state,
             ptr = dtabuf;
         }
 
-        if (inplace) {
-            updlen = upd_dta->old_dta_len;
-            rc = bdb_reconstruct_inplace_update(
-                bdb_state, lsn, ptr, &updlen, NULL, NULL, &offset, NULL, NULL);
-
+        if (bdb_verstore_find(bdb_state, lsn, upd_dta->oldgenid, ptr,
+                              upd_dta->old_dta_len) == 0) {
+            rc = 0;
         } else {
-            rc = bdb_reconstruct_delete(bdb_state, lsn, NULL, NULL, NULL,
-                                        sizeof(genid_t), ptr,
-                                        upd_dta->old_dta_len, NULL);
+            if (inplace) {
+                updlen = upd_dta->old_dta_len;
+                rc = bdb_reconstruct_inplace_update(bdb_state, lsn, ptr,
+                                                    &updlen, NULL, NULL,
+                                                    &offset, NULL, NULL);
+
+            } else {
+                rc = bdb_reconstruct_delete(bdb_state, lsn, NULL, NULL, NULL,
+                                            sizeof(genid_t), ptr,
+                                            upd_dta->old_dta_len, NULL);
+            }
+            if (rc == 0)
+                bdb_verstore_add(bdb_state, lsn, upd_dta->oldgenid, ptr,
+                                 upd_dta->old_dta_len);
         }
         if (rc) {
             if (gbl_abort_on_reconstruct_failure)
@@ -206,6 +206,15 @@ DB_LSN bdb_gbl_recoverable_lsn;
 int32_t bdb_gbl_recoverable_timestamp = 0;
 pthread_mutex_t bdb_gbl_recoverable_lsn_mutex;
 
+/* Snapshot transactions registered or registering.  Counted before the birth
+   lsn is picked, so a commit that sees 0 here can't be needed by anyone. */
+static int trn_repo_readers;
+
+int bdb_osql_trn_active_readers(void)
+{
+    return __atomic_load_n(&trn_repo_readers, __ATOMIC_SEQ_CST);
+}
+
 DB_LSN bdb_asof_current_lsn = {0};
 DB_LSN bdb_latest_commit_lsn = {0};
 uint32_t bdb_latest_commit_gen = 0;
@@ -341,6 +350,7 @@ bdb_osql_trn_t *bdb_osql_trn_register(bdb_state_type *bdb_state,
     }
 
     Pthread_mutex_init(&trn->log_mtx, NULL);
+    __atomic_add_fetch(&trn_repo_readers, 1, __ATOMIC_SEQ_CST);
 
     trn->shadow_tran = shadow_tran;
     trn->trak = (trak & SQL_DBG_BDBTRN) || (trn_repo->trak);
@@ -377,6 +387,7 @@ bdb_osql_trn_t *bdb_osql_trn_register(bdb_state_type *bdb_state,
             logmsg(LOGMSG_ERROR, 
                     "%s:%d failed to create backfill active trans, rc %d\n",
                     __func__, __LINE__, rc);
+            __atomic_sub_fetch(&trn_repo_readers, 1, __ATOMIC_SEQ_CST);
             free(trn);
             trn = NULL;
             goto done;
@@ -517,6 +528,7 @@ done:
             logmsg(LOGMSG_ERROR, "fail to backfill %d %d\n", rc, *bdberr);
             Pthread_mutex_lock(&trn_repo_mtx);
             listc_rfl(&trn_repo->trns, trn);
+            __atomic_sub_fetch(&trn_repo_readers, 1, __ATOMIC_SEQ_CST);
             Pthread_mutex_destroy(&trn->log_mtx);
             free(trn);
             Pthread_mutex_unlock(&trn_repo_mtx);
@@ -541,9 +553,10 @@ int bdb_osql_trn_unregister(bdb_osql_trn_t *trn, int *bdberr)
 
     Pthread_mutex_lock(&trn_repo_mtx);
 
-    if (trn_repo)
+    if (trn_repo) {
         listc_rfl(&trn_repo->trns, trn);
-    else
+        __atomic_sub_fetch(&trn_repo_readers, 1, __ATOMIC_SEQ_CST);
+    } else
         exit = 1;
 
     /*
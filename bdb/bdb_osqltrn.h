@@ -139,6 +139,9 @@ int bdb_osql_trn_cancel_clients(struct bdb_osql_log *log, int lock_repo,
                                 int *bdberr);
 
 int bdb_oldest_active_lsn(bdb_state_type *bdb_state, void *plsn);
+
+/* Number of snapshot transactions registered, or being registered */
+int bdb_osql_trn_active_readers(void);
 /**
  * Returns 1 if the transaction was cancelled due to resource limitations
  *
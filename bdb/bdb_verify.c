@@ -23,6 +23,8 @@
 #include <alloca.h>
 #include <sys/poll.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <bdb_api.h>
 #include <bdb_verify.h>
 
@@ -34,11 +36,19 @@
 #include "locks.h"
 #include "endian_core.h"
 
+/* the checksum only mode reads pages itself */
+#include <build/db_int.h>
+#include <dbinc/db_page.h>
+#include <dbinc/btree.h>
+#include "dbinc/db_swap.h"
+#include "dbinc/hmac.h"
+
 #include "genid.h"
 #include "logmsg.h"
 #include "tohex.h"
 #include "blob_buffer.h"
 #include "comdb2_atomic.h"
+#include <locks_wrap.h>
 
 /* NOTE: This is from "comdb2.h". */
 extern int gbl_expressions_indexes;
@@ -288,6 +298,9 @@ static int bdb_verify_data_stripe(verify_common_t *par, int dtastripe,
     dbt_key.ulen = sizeof(keybuf);
     dbt_key.data = keybuf;
 
+    /* the next count of the stripe walks it again */
+    bdb_stripe_count_reset(bdb_state, dtastripe);
+
     db = bdb_state->dbp_data[0][dtastripe];
     rc = db->paired_cursor_from_lid(db, lid, &cdata, 0);
     if (rc) {
@@ -840,32 +853,42 @@ static int bdb_verify_key(verify_common_t *par, int ix, unsigned int lid)
             int expected_size;
             uint8_t *expected_data;
             uint8_t datacopy_buffer[bdb_state->lrl];
+            /* a partial datacopy holds some columns of the dta */
+            int dtalen = bdb_state->ixdtalen[ix] ? bdb_state->ixdtalen[ix]
+                                                 : bdb_state->lrl;
+            uint8_t partial_buffer[dtalen];
+            uint8_t *dta = dbt_dta_check_data.data;
             if (bdb_state->datacopy_odh) {
                 int odhlen;
                 unpack_index_odh(bdb_state, &dbt_data, &genid_right,
                                  datacopy_buffer, sizeof(datacopy_buffer),
                                  &odhlen, &ver);
                 expected_size = odhlen;
-                par->vtag_callback(par->db_table, datacopy_buffer,
-                                   &expected_size, ver);
+                if (!bdb_state->ixdtalen[ix])
+                    par->vtag_callback(par->db_table, datacopy_buffer,
+                                       &expected_size, ver);
                 expected_data = datacopy_buffer;
             } else {
                 expected_size = dbt_data.size - sizeof(genid);
                 expected_data = (uint8_t *)dbt_data.data + sizeof(genid);
                 memcpy(&genid_right, (uint8_t *)dbt_data.data, sizeof(genid));
             }
+            if (bdb_state->ixdtalen[ix]) {
+                par->partial_datacopy_callback(par->db_table, ix, dta,
+                                               partial_buffer);
+                dta = partial_buffer;
+            }
 
-            if (expected_size != bdb_state->lrl) {
+            if (expected_size != dtalen) {
                 par->verify_status = 1;
                 locprint(par->sb, par->lua_callback, par->lua_params,
                          "!%016llx ix %d dtacpy payload wrong size "
                          "expected %d got %d\n",
-                         genid_flipped, ix, bdb_state->lrl, expected_size);
+                         genid_flipped, ix, dtalen, expected_size);
                 goto next_key;
             }
 
-            if (memcmp(expected_data, dbt_dta_check_data.data,
-                       bdb_state->lrl)) {
+            if (memcmp(expected_data, dta, dtalen)) {
                 par->verify_status = 1;
                 locprint(par->sb, par->lua_callback, par->lua_params,
                          "!%016llx ix %d dtacpy data mismatch\n", genid_flipped,
@@ -1063,6 +1086,636 @@ static void bdb_verify_blob(verify_common_t *par, int blobno, int dtastripe,
            (void *)pthread_self(), __func__, blobno, dtastripe, now - atstart);
 }
 
+/* Page order verify.  Every data, index and blob file is read in physical
+ * page order by its own thread.  The data pass puts the index key and blob
+ * every record should have into an "expected" temp table per index and
+ * blob, and the index and blob passes put what they find into a "found"
+ * one.  Once all the scans are done, each pair is merge joined; anything on
+ * one side only is a missing or an orphaned entry.  Temp tables are btrees,
+ * so both sides come out sorted, and spill to disk for big tables. */
+struct verify_keyset {
+    pthread_mutex_t lk;
+    struct temp_table *expected;
+    struct temp_table *found;
+};
+
+static int keyset_count(verify_common_t *par)
+{
+    return par->bdb_state->numix + get_numblobs(par->db_table);
+}
+
+static void keysets_free(verify_common_t *par)
+{
+    bdb_state_type *parent = par->bdb_state->parent;
+    int bdberr;
+
+    if (par->keysets == NULL)
+        return;
+    for (int i = 0; i < keyset_count(par); i++) {
+        struct verify_keyset *set = &par->keysets[i];
+        if (set->expected)
+            bdb_temp_table_close(parent, set->expected, &bdberr);
+        if (set->found)
+            bdb_temp_table_close(parent, set->found, &bdberr);
+        Pthread_mutex_destroy(&set->lk);
+    }
+    free(par->keysets);
+    par->keysets = NULL;
+}
+
+static int keysets_init(verify_common_t *par)
+{
+    bdb_state_type *parent = par->bdb_state->parent;
+    int nsets = keyset_count(par);
+    int bdberr;
+
+    par->keysets = calloc(nsets ? nsets : 1, sizeof(struct verify_keyset));
+    if (par->keysets == NULL)
+        return -1;
+    for (int i = 0; i < nsets; i++) {
+        struct verify_keyset *set = &par->keysets[i];
+        Pthread_mutex_init(&set->lk, NULL);
+        set->expected = bdb_temp_table_create(parent, &bdberr);
+        set->found = bdb_temp_table_create(parent, &bdberr);
+        if (set->expected == NULL || set->found == NULL) {
+            logmsg(LOGMSG_ERROR, "%s: can't create temp table bdberr %d\n",
+                   __func__, bdberr);
+            keysets_free(par);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int keyset_put(verify_common_t *par, int setno, int found, void *key,
+                      int keylen, void *data, int datalen)
+{
+    struct verify_keyset *set = &par->keysets[setno];
+    int rc, bdberr;
+
+    Pthread_mutex_lock(&set->lk);
+    rc = bdb_temp_table_put(par->bdb_state->parent,
+                            found ? set->found : set->expected, key, keylen,
+                            data, datalen, NULL, &bdberr);
+    Pthread_mutex_unlock(&set->lk);
+    if (rc) {
+        par->verify_status = 1;
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "!temp table put rc %d bdberr %d\n", rc, bdberr);
+    }
+    return rc;
+}
+
+static unsigned long long flip_genid(unsigned long long genid)
+{
+    unsigned long long genid_flipped;
+#ifdef _LINUX_SOURCE
+    buf_put(&genid, sizeof(unsigned long long), (uint8_t *)&genid_flipped,
+            (uint8_t *)&genid_flipped + sizeof(unsigned long long));
+#else
+    genid_flipped = genid;
+#endif
+    return genid_flipped;
+}
+
+/* fetch the blobs an expression index needs to form its key */
+static int load_blobs(verify_common_t *par, unsigned long long genid,
+                      int nblobs, int *blobsizes, blob_buffer_t *blob_buf,
+                      unsigned int lid)
+{
+    bdb_state_type *bdb_state = par->bdb_state;
+    uint8_t ver;
+    int rc = 0;
+
+    for (int blobno = 0; blobno < nblobs && rc == 0; blobno++) {
+        unsigned long long blob_genid = genid;
+        DBC *cblob;
+        DB *blobdb;
+
+        if (blobsizes[blobno] < 0)
+            continue;
+        blobdb = get_dbp_from_genid(bdb_state, blobno + 1, genid, NULL);
+        if ((rc = blobdb->paired_cursor_from_lid(blobdb, lid, &cblob, 0)))
+            break;
+
+        DBT dbt_blob_key = {0};
+        dbt_blob_key.data = &blob_genid;
+        dbt_blob_key.size = sizeof(unsigned long long);
+
+        DBT dbt_blob_data = {0};
+        dbt_blob_data.flags = DB_DBT_MALLOC;
+
+        rc = bdb_cget_unpack_blob(bdb_state, cblob, &dbt_blob_key,
+                                  &dbt_blob_data, &ver, DB_SET);
+        if (rc == 0) {
+            rc = par->add_blob_buffer_callback(blob_buf, dbt_blob_data.data,
+                                               dbt_blob_data.size, blobno);
+            free(dbt_blob_data.data);
+        } else if (rc == DB_NOTFOUND) {
+            /* the merge reports it */
+            rc = 0;
+        }
+        cblob->c_close(cblob);
+    }
+    return rc;
+}
+
+static int bdb_verify_data_pageorder(verify_common_t *par, int dtastripe,
+                                     unsigned int lid)
+{
+    DBC *cdata = NULL;
+    DB *db;
+    unsigned char databuf[17 * 1024];
+    unsigned char keybuf[18 * 1024];
+    unsigned char expected_keybuf[18 * 1024 + 2 * sizeof(unsigned long long)];
+    int rc = 0;
+    int blobsizes[16];
+    int bloboffs[16];
+    int nblobs = 0;
+    blob_buffer_t blob_buf[MAXBLOBS] = {{0}};
+
+    bdb_state_type *bdb_state = par->bdb_state;
+    int need_blobs =
+        gbl_expressions_indexes && is_comdb2_index_expression(bdb_state->name);
+
+    DBT dbt_data = {0};
+    dbt_data.flags = DB_DBT_USERMEM;
+    dbt_data.ulen = sizeof(databuf);
+    dbt_data.data = databuf;
+
+    DBT dbt_key = {0};
+    dbt_key.flags = DB_DBT_USERMEM;
+    dbt_key.ulen = sizeof(keybuf);
+    dbt_key.data = keybuf;
+
+    db = bdb_state->dbp_data[0][dtastripe];
+    rc = db->paired_cursor_from_lid(db, lid, &cdata, DB_PAGE_ORDER);
+    if (rc) {
+        par->verify_status = 1;
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "!dtastripe %d cursor rc %d\n", dtastripe, rc);
+        return rc;
+    }
+    uint8_t ver;
+    rc = bdb_cget_unpack(bdb_state, cdata, &dbt_key, &dbt_data, &ver, DB_FIRST);
+    while (rc == 0 && !par->client_dropped_connection) {
+        ATOMIC_ADD64(par->items_processed, 1);
+        if (print_verify_progress(par, comdb2_time_epochms()))
+            break;
+
+        unsigned long long genid;
+        if (dbt_key.size != sizeof(genid)) {
+            par->verify_status = 1;
+            locprint(par->sb, par->lua_callback, par->lua_params,
+                     "!bad genid sz %d\n", dbt_key.size);
+            goto next_record;
+        }
+        memcpy(&genid, dbt_key.data, sizeof(genid));
+
+        par->vtag_callback(par->db_table, dbt_data.data, (int *)&dbt_data.size,
+                           ver);
+        rc = par->get_blob_sizes_callback(par->db_table, dbt_data.data,
+                                          blobsizes, bloboffs, &nblobs);
+        if (rc) {
+            par->verify_status = 1;
+            locprint(par->sb, par->lua_callback, par->lua_params,
+                     "!%016llx blob size rc %d\n", flip_genid(genid), rc);
+            rc = 0;
+            goto next_record;
+        }
+
+        /* blob files are keyed on the genid without the updateid */
+        unsigned long long blob_genid = get_search_genid(bdb_state, genid);
+        for (int blobno = 0; blobno < nblobs; blobno++) {
+            if (blobsizes[blobno] < 0)
+                continue;
+            if (keyset_put(par, bdb_state->numix + blobno, 0, &blob_genid,
+                           sizeof(blob_genid), &blobsizes[blobno],
+                           sizeof(int)))
+                goto err;
+        }
+        if (need_blobs && (rc = load_blobs(par, genid, nblobs, blobsizes,
+                                           blob_buf, lid)) != 0) {
+            par->verify_status = 1;
+            locprint(par->sb, par->lua_callback, par->lua_params,
+                     "!%016llx blob fetch rc %d\n", flip_genid(genid), rc);
+            par->free_blob_buffer_callback(blob_buf);
+            rc = 0;
+            goto next_record;
+        }
+
+        unsigned long long has_keys;
+        has_keys = par->verify_indexes_callback(par->db_table, dbt_data.data,
+                                                blob_buf);
+        for (int ix = 0; ix < bdb_state->numix; ix++) {
+            int keylen;
+
+            if (!(has_keys & (1ULL << ix)))
+                continue;
+            rc = par->formkey_callback(par->db_table, databuf, blob_buf, ix,
+                                       expected_keybuf, &keylen);
+            if (rc) {
+                par->verify_status = 1;
+                locprint(par->sb, par->lua_callback, par->lua_params,
+                         "!%016llx ix %d formkey rc %d\n", flip_genid(genid),
+                         ix, rc);
+                rc = 0;
+                continue;
+            }
+            if (bdb_keycontainsgenid(bdb_state, ix)) {
+                unsigned long long masked_genid =
+                    get_search_genid(bdb_state, genid);
+
+                /* use 0 as the genid if no null values to keep it unique */
+                if (bdb_state->ixnulls[ix] &&
+                    !ix_isnullk(par->db_table, expected_keybuf, ix))
+                    masked_genid = 0;
+
+                memcpy(expected_keybuf + keylen, &masked_genid,
+                       sizeof(unsigned long long));
+                keylen += sizeof(unsigned long long);
+            }
+            /* the genid the index entry points to, so duplicate keys sort */
+            memcpy(expected_keybuf + keylen, &genid, sizeof(genid));
+            keylen += sizeof(genid);
+            if (keyset_put(par, ix, 0, expected_keybuf, keylen, &genid,
+                           sizeof(genid))) {
+                par->free_blob_buffer_callback(blob_buf);
+                goto err;
+            }
+        }
+        par->free_blob_buffer_callback(blob_buf);
+
+    next_record:
+        dbt_data.flags = DB_DBT_USERMEM;
+        dbt_data.ulen = sizeof(databuf);
+        dbt_data.data = databuf;
+        dbt_key.flags = DB_DBT_USERMEM;
+        dbt_key.ulen = sizeof(keybuf);
+        dbt_key.data = keybuf;
+
+        rc = bdb_cget_unpack(bdb_state, cdata, &dbt_key, &dbt_data, &ver,
+                             DB_NEXT);
+    }
+    if (rc == DB_NOTFOUND) {
+        rc = 0;
+    } else if (rc) {
+        par->verify_status = 1;
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "!dtastripe %d c_get unexpected rc %d\n", dtastripe, rc);
+    }
+err:
+    cdata->c_close(cdata);
+    return rc;
+}
+
+static int bdb_verify_key_pageorder(verify_common_t *par, int ix,
+                                    unsigned int lid)
+{
+    DBC *ckey = NULL;
+    unsigned char keybuf[18 * 1024 + sizeof(unsigned long long)];
+    unsigned long long genid;
+    int rc;
+
+    bdb_state_type *bdb_state = par->bdb_state;
+
+    DBT dbt_key = {0};
+    dbt_key.data = keybuf;
+    dbt_key.ulen = sizeof(keybuf) - sizeof(genid);
+    dbt_key.flags = DB_DBT_USERMEM;
+
+    /* just the genid; dtacopy isn't checked in this mode */
+    DBT dbt_data = {0};
+    dbt_data.data = &genid;
+    dbt_data.ulen = sizeof(genid);
+    dbt_data.flags = DB_DBT_USERMEM | DB_DBT_PARTIAL;
+    dbt_data.doff = 0;
+    dbt_data.dlen = sizeof(genid);
+
+    rc = bdb_state->dbp_ix[ix]->paired_cursor_from_lid(
+        bdb_state->dbp_ix[ix], lid, &ckey, DB_PAGE_ORDER);
+    if (rc) {
+        par->verify_status = 1;
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "!ix %d cursor rc %d\n", ix, rc);
+        return rc;
+    }
+    rc = ckey->c_get(ckey, &dbt_key, &dbt_data, DB_FIRST);
+    while (rc == 0 && !par->client_dropped_connection) {
+        ATOMIC_ADD64(par->items_processed, 1);
+        if (print_verify_progress(par, comdb2_time_epochms()))
+            break;
+
+        if (dbt_data.size < sizeof(genid)) {
+            par->verify_status = 1;
+            locprint(par->sb, par->lua_callback, par->lua_params,
+                     "!ix %d unexpected length %d\n", ix, dbt_data.size);
+        } else {
+            memcpy(keybuf + dbt_key.size, &genid, sizeof(genid));
+            if (keyset_put(par, ix, 1, keybuf, dbt_key.size + sizeof(genid),
+                           &genid, sizeof(genid)))
+                break;
+        }
+        rc = ckey->c_get(ckey, &dbt_key, &dbt_data, DB_NEXT);
+    }
+    if (rc == DB_NOTFOUND) {
+        rc = 0;
+    } else if (rc) {
+        par->verify_status = 1;
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "!ix %d c_get unexpected rc %d\n", ix, rc);
+    }
+    ckey->c_close(ckey);
+    return rc;
+}
+
+static int bdb_verify_blob_pageorder(verify_common_t *par, int blobno,
+                                     int dtastripe, unsigned int lid)
+{
+    DBC *cblob = NULL;
+    unsigned long long genid;
+    int rc;
+
+    bdb_state_type *bdb_state = par->bdb_state;
+    DB *db = bdb_state->dbp_data[blobno + 1][dtastripe];
+
+    if (!db) {
+        par->verify_status = 1;
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "incorrect number of blobs? blob index %d "
+                 "stripe %d has no DB\n",
+                 blobno, dtastripe);
+        return -1;
+    }
+    rc = db->paired_cursor_from_lid(db, lid, &cblob, DB_PAGE_ORDER);
+    if (rc) {
+        par->verify_status = 1;
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "!dtastripe %d blobno %d cursor rc %d\n", dtastripe, blobno,
+                 rc);
+        return rc;
+    }
+
+    DBT dbt_key = {0};
+    dbt_key.data = &genid;
+    dbt_key.ulen = sizeof(genid);
+    dbt_key.flags = DB_DBT_USERMEM;
+
+    /* the whole blob: compression and ondisk headers change its size */
+    DBT dbt_data = {0};
+    dbt_data.flags = DB_DBT_MALLOC;
+
+    uint8_t ver;
+    rc = bdb_cget_unpack_blob(bdb_state, cblob, &dbt_key, &dbt_data, &ver,
+                              DB_FIRST);
+    while (rc == 0 && !par->client_dropped_connection) {
+        ATOMIC_ADD64(par->items_processed, 1);
+        int size = dbt_data.size;
+        free(dbt_data.data);
+        dbt_data.data = NULL;
+        if (print_verify_progress(par, comdb2_time_epochms()))
+            break;
+
+        unsigned long long blob_genid = get_search_genid(bdb_state, genid);
+        if (keyset_put(par, bdb_state->numix + blobno, 1, &blob_genid,
+                       sizeof(blob_genid), &size, sizeof(size)))
+            break;
+        rc = bdb_cget_unpack_blob(bdb_state, cblob, &dbt_key, &dbt_data, &ver,
+                                  DB_NEXT);
+    }
+    if (rc == DB_NOTFOUND) {
+        rc = 0;
+    } else if (rc) {
+        par->verify_status = 1;
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "!blob %d stripe %d c_get unexpected rc %d\n", blobno,
+                 dtastripe, rc);
+    }
+    cblob->c_close(cblob);
+    return rc;
+}
+
+static int keyset_cmp(struct temp_cursor *a, struct temp_cursor *b)
+{
+    int alen = bdb_temp_table_keysize(a);
+    int blen = bdb_temp_table_keysize(b);
+    int rc = memcmp(bdb_temp_table_key(a), bdb_temp_table_key(b),
+                    alen < blen ? alen : blen);
+    if (rc)
+        return rc;
+    return alen - blen;
+}
+
+static void bdb_verify_merge(verify_common_t *par, int setno)
+{
+    struct verify_keyset *set = &par->keysets[setno];
+    bdb_state_type *parent = par->bdb_state->parent;
+    int ix = setno < par->bdb_state->numix ? setno : -1;
+    int blobno = setno - par->bdb_state->numix;
+    struct temp_cursor *cexp, *cfnd;
+    int rexp, rfnd, bdberr;
+
+    cexp = bdb_temp_table_cursor(parent, set->expected, NULL, &bdberr);
+    cfnd = bdb_temp_table_cursor(parent, set->found, NULL, &bdberr);
+    if (cexp == NULL || cfnd == NULL) {
+        par->verify_status = 1;
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "!temp table cursor bdberr %d\n", bdberr);
+        goto done;
+    }
+
+    rexp = bdb_temp_table_first(parent, cexp, &bdberr);
+    rfnd = bdb_temp_table_first(parent, cfnd, &bdberr);
+    while ((rexp == 0 || rfnd == 0) && !par->client_dropped_connection) {
+        unsigned long long genid;
+        int cmp;
+
+        ATOMIC_ADD64(par->items_processed, 1);
+        if (print_verify_progress(par, comdb2_time_epochms()))
+            break;
+
+        if (rexp)
+            cmp = 1;
+        else if (rfnd)
+            cmp = -1;
+        else
+            cmp = keyset_cmp(cexp, cfnd);
+
+        struct temp_cursor *cur = cmp > 0 ? cfnd : cexp;
+        int keylen = bdb_temp_table_keysize(cur);
+        uint8_t *key = bdb_temp_table_key(cur);
+        memcpy(&genid, key + keylen - sizeof(genid), sizeof(genid));
+
+        if (cmp == 0) {
+            if (ix < 0) {
+                int want = *(int *)bdb_temp_table_data(cexp);
+                int got = *(int *)bdb_temp_table_data(cfnd);
+                if (want != got) {
+                    par->verify_status = 1;
+                    locprint(par->sb, par->lua_callback, par->lua_params,
+                             "!%016llx blob %d size mismatch "
+                             "got %d expected %d\n",
+                             flip_genid(genid), blobno, got, want);
+                }
+            }
+        } else if (cmp < 0) {
+            par->verify_status = 1;
+            if (ix >= 0)
+                locprint(par->sb, par->lua_callback, par->lua_params,
+                         "!%016llx ix %d missing key\n", flip_genid(genid),
+                         ix);
+            else
+                locprint(par->sb, par->lua_callback, par->lua_params,
+                         "!%016llx no blob %d found expected sz %d\n",
+                         flip_genid(genid), blobno,
+                         *(int *)bdb_temp_table_data(cexp));
+        } else {
+            par->verify_status = 1;
+            if (ix >= 0) {
+                locprint(par->sb, par->lua_callback, par->lua_params,
+                         "!%016llx ix %d orphaned ", flip_genid(genid), ix);
+                printhex(par->sb, par->lua_callback, par->lua_params, key,
+                         keylen - sizeof(genid));
+                locprint(par->sb, par->lua_callback, par->lua_params, "\n");
+            } else
+                locprint(par->sb, par->lua_callback, par->lua_params,
+                         "!%016llx orphaned blob %d\n", flip_genid(genid),
+                         blobno);
+        }
+
+        if (cmp <= 0)
+            rexp = bdb_temp_table_next(parent, cexp, &bdberr);
+        if (cmp >= 0)
+            rfnd = bdb_temp_table_next(parent, cfnd, &bdberr);
+    }
+    if ((rexp && rexp != IX_EMPTY && rexp != IX_PASTEOF) ||
+        (rfnd && rfnd != IX_EMPTY && rfnd != IX_PASTEOF)) {
+        par->verify_status = 1;
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "!temp table rc %d %d bdberr %d\n", rexp, rfnd, bdberr);
+    }
+
+done:
+    if (cexp)
+        bdb_temp_table_close_cursor(parent, cexp, &bdberr);
+    if (cfnd)
+        bdb_temp_table_close_cursor(parent, cfnd, &bdberr);
+}
+
+/* Checksum only verify: read a file's pages straight from disk, in order,
+ * and check each one's checksum.  Nothing is decrypted or parsed. */
+static int page_checksum_ok(DB_ENV *dbenv, DB *dbp, PAGE *page, int pgsz)
+{
+    uint8_t *chksum;
+    size_t sumlen;
+    int is_hmac = 0;
+
+    switch (TYPE(page)) {
+    case P_HASHMETA:
+    case P_BTREEMETA:
+    case P_QAMMETA:
+        chksum = ((BTMETA *)page)->chksum;
+        sumlen = DBMETASIZE;
+        is_hmac = ((DBMETA *)page)->encrypt_alg != 0;
+        break;
+    case P_INVALID:
+        /* a hole in the file; see __db_pgin */
+        if (IS_ZERO_LSN(LSN(page)) && page->pgno == PGNO_INVALID)
+            return 1;
+        /* FALLTHROUGH */
+    default:
+        chksum = P_CHKSUM(dbp, page);
+        sumlen = pgsz;
+        is_hmac = CRYPTO_ON(dbenv) ? 1 : 0;
+        break;
+    }
+    if (F_ISSET(dbp, DB_AM_SWAP))
+        P_32_SWAP(chksum);
+    chksum_t algo = IS_CRC32C(page) ? algo_crc32c : algo_hash4;
+    return __db_check_chksum_algo(dbenv, dbenv->crypto_handle, chksum, page,
+                                  sumlen, is_hmac, algo) == 0;
+}
+
+static void bdb_verify_checksums(verify_common_t *par, int dtanum, int ix,
+                                 int stripe)
+{
+    bdb_state_type *bdb_state = par->bdb_state;
+    DB_ENV *dbenv = bdb_state->dbenv;
+    char name[PATH_MAX], path[PATH_MAX];
+    unsigned char metabuf[512];
+    DB dbp_ = {0}, *dbp;
+    PAGE *page = NULL;
+    int fd = -1, pgsz, rc, bdberr;
+    db_pgno_t pgno;
+
+    if (ix >= 0)
+        rc = bdb_get_index_filename(bdb_state, ix, name, sizeof(name), &bdberr);
+    else
+        rc = bdb_get_data_filename(bdb_state, stripe, dtanum, name,
+                                   sizeof(name), &bdberr);
+    if (rc) {
+        par->verify_status = 1;
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "!can't get file name rc %d bdberr %d\n", rc, bdberr);
+        return;
+    }
+    bdb_trans(name, path);
+
+    if ((fd = open(path, O_RDONLY)) == -1) {
+        par->verify_status = 1;
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "!%s open %s\n", name, strerror(errno));
+        return;
+    }
+    if (pread(fd, metabuf, sizeof(metabuf), 0) != sizeof(metabuf) ||
+        (dbp = dbp_from_meta(&dbp_, (DBMETA *)metabuf)) == NULL) {
+        par->verify_status = 1;
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "!%s can't read meta page\n", name);
+        goto done;
+    }
+    if (!F_ISSET(dbp, DB_AM_CHKSUM)) {
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "!%s has no page checksums\n", name);
+        goto done;
+    }
+    pgsz = dbp->pgsize;
+    if ((page = malloc(pgsz)) == NULL) {
+        par->verify_status = 1;
+        goto done;
+    }
+
+#if defined(_IBM_SOURCE) || defined(__linux__)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    for (pgno = 0; (rc = pread(fd, page, pgsz, (off_t)pgno * pgsz)) == pgsz;
+         pgno++) {
+        ATOMIC_ADD64(par->items_processed, 1);
+        if (print_verify_progress(par, comdb2_time_epochms()))
+            break;
+        if (page_checksum_ok(dbenv, dbp, page, pgsz))
+            continue;
+        /* we may have caught the page while mpool was writing it */
+        poll(NULL, 0, 10);
+        if (pread(fd, page, pgsz, (off_t)pgno * pgsz) == pgsz &&
+            page_checksum_ok(dbenv, dbp, page, pgsz))
+            continue;
+        par->verify_status = 1;
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "!%s pgno %u bad checksum\n", name, pgno);
+    }
+    if (rc < 0) {
+        par->verify_status = 1;
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "!%s pgno %u read %s\n", name, pgno, strerror(errno));
+    }
+
+done:
+    free(page);
+    close(fd);
+}
+
 /* sequential processing of the stripes, keys, blobs
  */
 static int bdb_verify_sequential(verify_common_t *par, unsigned int lid)
@@ -1141,6 +1794,21 @@ void bdb_verify_handler(td_processing_info_t *info)
     case PROCESS_BLOB:
         bdb_verify_blob(par, info->blobno, info->dtastripe, lid);
         break;
+    case PROCESS_DATA_PAGEORDER:
+        bdb_verify_data_pageorder(par, info->dtastripe, lid);
+        break;
+    case PROCESS_KEY_PAGEORDER:
+        bdb_verify_key_pageorder(par, info->index, lid);
+        break;
+    case PROCESS_BLOB_PAGEORDER:
+        bdb_verify_blob_pageorder(par, info->blobno, info->dtastripe, lid);
+        break;
+    case PROCESS_MERGE:
+        bdb_verify_merge(par, info->keyset);
+        break;
+    case PROCESS_CHECKSUM:
+        bdb_verify_checksums(par, info->blobno, info->index, info->dtastripe);
+        break;
     }
 
     BDB_RELLOCK();
@@ -1182,6 +1850,91 @@ static inline void enqueue_work(td_processing_info_t *work,
     }
 }
 
+static void enqueue_new_work(td_processing_info_t *info,
+                             thdpool *verify_thdpool, processing_type type,
+                             int dtastripe, int index, int blobno, int keyset)
+{
+    td_processing_info_t *work = malloc(sizeof(*work));
+    memcpy(work, info, sizeof(*work));
+    work->type = type;
+    work->dtastripe = dtastripe;
+    work->index = index;
+    work->blobno = blobno;
+    work->keyset = keyset;
+    enqueue_work(work, verify_thdpool);
+}
+
+static void wait_for_work(verify_common_t *par)
+{
+    while (par->threads_spawned > par->threads_completed)
+        poll(NULL, 0, 100);
+}
+
+static int nblobstripes(bdb_state_type *bdb_state)
+{
+    return bdb_state->attr->blobstripe ? bdb_state->attr->blobstripe : 1;
+}
+
+/* Scan all the files in page order, then merge each index's and blob's
+ * keysets.  Returns once everything is done. */
+static int bdb_verify_enqueue_pageorder(td_processing_info_t *info,
+                                        thdpool *verify_thdpool)
+{
+    verify_common_t *par = info->common_params;
+    bdb_state_type *bdb_state = par->bdb_state;
+    int nblobs = get_numblobs(par->db_table);
+
+    if (keysets_init(par)) {
+        par->verify_status = 1;
+        locprint(par->sb, par->lua_callback, par->lua_params,
+                 "!can't create temp tables for verify\n");
+        return par->verify_status;
+    }
+
+    for (int dtastripe = 0; dtastripe < bdb_state->attr->dtastripe;
+         dtastripe++)
+        enqueue_new_work(info, verify_thdpool, PROCESS_DATA_PAGEORDER,
+                         dtastripe, 0, 0, 0);
+    for (int ix = 0; ix < bdb_state->numix; ix++)
+        enqueue_new_work(info, verify_thdpool, PROCESS_KEY_PAGEORDER, 0, ix, 0,
+                         0);
+    for (int blobno = 0; blobno < nblobs; blobno++)
+        for (int stripe = 0; stripe < nblobstripes(bdb_state); stripe++)
+            enqueue_new_work(info, verify_thdpool, PROCESS_BLOB_PAGEORDER,
+                             stripe, 0, blobno, 0);
+    wait_for_work(par);
+
+    if (!par->client_dropped_connection) {
+        for (int i = 0; i < keyset_count(par); i++)
+            enqueue_new_work(info, verify_thdpool, PROCESS_MERGE, 0, 0, 0, i);
+        wait_for_work(par);
+    }
+
+    keysets_free(par);
+    return par->verify_status;
+}
+
+/* Check the page checksums of every data, index and blob file */
+static int bdb_verify_enqueue_checksum(td_processing_info_t *info,
+                                       thdpool *verify_thdpool)
+{
+    verify_common_t *par = info->common_params;
+    bdb_state_type *bdb_state = par->bdb_state;
+    int nblobs = get_numblobs(par->db_table);
+
+    for (int dtastripe = 0; dtastripe < bdb_state->attr->dtastripe;
+         dtastripe++)
+        enqueue_new_work(info, verify_thdpool, PROCESS_CHECKSUM, dtastripe, -1,
+                         0, 0);
+    for (int ix = 0; ix < bdb_state->numix; ix++)
+        enqueue_new_work(info, verify_thdpool, PROCESS_CHECKSUM, 0, ix, 0, 0);
+    for (int blobno = 0; blobno < nblobs; blobno++)
+        for (int stripe = 0; stripe < nblobstripes(bdb_state); stripe++)
+            enqueue_new_work(info, verify_thdpool, PROCESS_CHECKSUM, stripe, -1,
+                             blobno + 1, 0);
+    return par->verify_status;
+}
+
 /* Enqueue onto verify_thdpool for processing all data stripes,
  * all keys, and all blobs.
  * If verify_thdpool is null, processing will be performed serially.
@@ -1203,6 +1956,12 @@ int bdb_verify_enqueue(td_processing_info_t *info, thdpool *verify_thdpool)
     case VERIFY_BLOBS:
         tp = "BLOBS";
         break;
+    case VERIFY_PAGEORDER:
+        tp = "PAGEORDER";
+        break;
+    case VERIFY_CHECKSUM:
+        tp = "CHECKSUM";
+        break;
     default:
         abort();
     };
@@ -1210,6 +1969,11 @@ int bdb_verify_enqueue(td_processing_info_t *info, thdpool *verify_thdpool)
 #endif
     par->last_reported = comdb2_time_epochms(); // initialize
 
+    if (par->verify_mode == VERIFY_PAGEORDER)
+        return bdb_verify_enqueue_pageorder(info, verify_thdpool);
+    if (par->verify_mode == VERIFY_CHECKSUM)
+        return bdb_verify_enqueue_checksum(info, verify_thdpool);
+
     if (par->verify_mode == VERIFY_PARALLEL ||
         par->verify_mode == VERIFY_DATA) {
         /* scan 1 - run through data, verify all the keys and blobs */
@@ -23,7 +23,18 @@ struct SBUF2;
 struct bdb_state_type;
 typedef struct thdpool thdpool;
 
-typedef enum { PROCESS_DATA, PROCESS_KEY, PROCESS_BLOB } processing_type;
+typedef enum {
+    PROCESS_DATA,
+    PROCESS_KEY,
+    PROCESS_BLOB,
+    PROCESS_DATA_PAGEORDER, /* expected keys and blobs for each record */
+    PROCESS_KEY_PAGEORDER,  /* keys found in an index */
+    PROCESS_BLOB_PAGEORDER, /* blobs found in a blob file */
+    PROCESS_MERGE,          /* compare expected and found for one keyset */
+    PROCESS_CHECKSUM        /* page checksums of one file */
+} processing_type;
+
+struct verify_keyset;
 
 // common data for all verify threads
 typedef struct {
@@ -35,6 +46,8 @@ typedef struct {
     int (*get_blob_sizes_callback)(const dbtable *tbl, void *dta, int blobs[16],
                                    int bloboffs[16], int *nblobs);
     int (*vtag_callback)(void *parm, void *dta, int *dtasz, uint8_t ver);
+    int (*partial_datacopy_callback)(const dbtable *tbl, int ix, void *dta,
+                                     void *out);
     int (*add_blob_buffer_callback)(void *parm, void *dta, int dtasz,
                                     int blobno);
     void (*free_blob_buffer_callback)(void *parm);
@@ -42,6 +55,7 @@ typedef struct {
                                                   void *blob_parm);
     int (*lua_callback)(void *, const char *);
     void *lua_params;
+    struct verify_keyset *keysets; // VERIFY_PAGEORDER: nix + nblobs of them
     char *header; // header string for printing for prog rep in default mode
     unsigned long long items_processed;   // atomic inc: for progres report
     unsigned long long records_processed; // progress report in default mode
@@ -64,6 +78,7 @@ typedef struct td_processing_info {
     int8_t blobno;
     int8_t dtastripe;
     int8_t index;
+    int8_t keyset;
 } td_processing_info_t;
 
 int bdb_verify(verify_common_t *par);
@@ -23,6 +23,8 @@
 #include <string.h>
 #include <strings.h>
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <list.h>
@@ -40,6 +42,8 @@ extern int gbl_rowlocks;
 extern pthread_t gbl_invalid_tid;
 extern int gbl_exit;
 
+void __berkdb_lock_heat_named(const char *name, u_int64_t wait_us);
+
 int gbl_bdblock_debug = 0;
 
 void comdb2_cheap_stack_trace_file(FILE *f);
@@ -200,6 +204,8 @@ struct thread_lock_info_tag {
     unsigned lockref;            /* how many people have this lock already */
     const char *ident;           /* who in this thread locked it */
     enum bdb_lock_type locktype; /* type of lock currently held */
+    int biased; /* read lock is held through our reader slot, not the
+                   rwlock */
 
     /* If we hold the write lock, this records whether or not we previously
      * held the read lock.  If this is non-zero then when we release the
@@ -352,6 +358,121 @@ extern int __rep_block_on_inflight_transactions(DB_ENV *dbenv);
 
 int gbl_force_serial_on_writelock = 1;
 
+/* Reader bias.  Every request thread read locks the bdb lock and it is
+ * write locked only on master changes and the like, so while
+ * bdb_lock_rbias is set a reader doesn't touch the rwlock at all: it
+ * publishes itself in its slot of bdb_lock_readers[] and that is its read
+ * lock.  A writer takes the rwlock, which holds off the slow readers,
+ * clears the bias and waits for the published readers to leave.  The bias
+ * is then held off for BDB_LOCK_INHIBIT times as long as that took, and
+ * turned back on by the next slow reader after that.  A reader whose slot
+ * is taken by another thread just uses the rwlock. */
+#define BDB_LOCK_READERS_BITS 12
+#define BDB_LOCK_READERS (1 << BDB_LOCK_READERS_BITS)
+#define BDB_LOCK_INHIBIT 9
+
+int gbl_bdblock_reader_bias = 0;
+
+static bdb_state_type *bdb_lock_readers[BDB_LOCK_READERS];
+
+static inline int reader_slot(thread_lock_info_type *lk)
+{
+    uint64_t h = (uintptr_t)lk;
+    return (h * 0x9e3779b97f4a7c15ULL) >> (64 - BDB_LOCK_READERS_BITS);
+}
+
+static int64_t bdblock_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int get_biased_readlock(bdb_state_type *lock_handle,
+                               thread_lock_info_type *lk)
+{
+    bdb_state_type *none = NULL;
+    int slot;
+
+    if (!gbl_bdblock_reader_bias ||
+        !__atomic_load_n(&lock_handle->bdb_lock_rbias, __ATOMIC_RELAXED))
+        return 0;
+    slot = reader_slot(lk);
+    if (!__atomic_compare_exchange_n(&bdb_lock_readers[slot], &none,
+                                     lock_handle, 0, __ATOMIC_SEQ_CST,
+                                     __ATOMIC_RELAXED))
+        return 0;
+    /* a writer clears the bias before it looks at the slots */
+    if (__atomic_load_n(&lock_handle->bdb_lock_rbias, __ATOMIC_SEQ_CST)) {
+        lk->biased = 1;
+        return 1;
+    }
+    __atomic_store_n(&bdb_lock_readers[slot], NULL, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static void release_lock(bdb_state_type *lock_handle,
+                         thread_lock_info_type *lk)
+{
+    if (lk->biased) {
+        __atomic_store_n(&bdb_lock_readers[reader_slot(lk)], NULL,
+                         __ATOMIC_RELEASE);
+        lk->biased = 0;
+    } else {
+        Pthread_rwlock_unlock(lock_handle->bdb_lock);
+    }
+}
+
+static void abort_logical_waiters(bdb_state_type *lock_handle,
+                                  int abort_waiters)
+{
+    /*
+     * Abort threads waiting on logical locks.
+     * This only looks racy: while bdb_lock_desired is set, the lock
+     * code
+     * returns 'deadlock' for any thread attempting to get a rowlock.
+     */
+    if (gbl_rowlocks &&
+        lock_handle->repinfo->master_host != lock_handle->repinfo->myhost &&
+        abort_waiters) {
+        bdb_abort_logical_waiters(lock_handle);
+    }
+}
+
+/* Called with the rwlock write locked: wait out the biased readers */
+static void revoke_reader_bias(bdb_state_type *lock_handle, const char *idstr,
+                               int abort_waiters)
+{
+    int64_t start, end;
+    int waited = 0;
+
+    if (!__atomic_load_n(&lock_handle->bdb_lock_rbias, __ATOMIC_RELAXED))
+        return;
+
+    start = bdblock_now_us();
+    __atomic_store_n(&lock_handle->bdb_lock_rbias, 0, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < BDB_LOCK_READERS; i++) {
+        int spins = 0;
+        while (__atomic_load_n(&bdb_lock_readers[i], __ATOMIC_SEQ_CST) ==
+               lock_handle) {
+            if (!waited) {
+                logmsg(LOGMSG_ERROR,
+                       "trying writelock (%s %lu), waiting on biased "
+                       "readers\n",
+                       idstr, pthread_self());
+                abort_logical_waiters(lock_handle, abort_waiters);
+                waited = 1;
+            }
+            if (spins++ < 100)
+                sched_yield();
+            else
+                poll(NULL, 0, 1);
+        }
+    }
+    end = bdblock_now_us();
+    lock_handle->bdb_lock_inhibit_until = end + BDB_LOCK_INHIBIT * (end - start);
+}
+
 /* Acquire the write lock.  If the current thread already holds the bdb read
  * lock then it is upgraded to a write lock.  If it already holds the write
  * lock then we just increase our reference count. */
@@ -386,7 +507,7 @@ static inline void bdb_get_writelock_int(bdb_state_type *bdb_state,
            */
         lk->readlockref = lk->lockref;
         lk->readident = lk->ident;
-        Pthread_rwlock_unlock(lock_handle->bdb_lock);
+        release_lock(lock_handle, lk);
 
         if (gbl_bdblock_debug)
             rel_lock_log(bdb_state);
@@ -422,20 +543,11 @@ static inline void bdb_get_writelock_int(bdb_state_type *bdb_state,
                    idstr, pthread_self(), lock_handle->bdb_lock_write_idstr,
                    lock_handle->bdb_lock_write_holder);
 
-            /*
-             * Abort threads waiting on logical locks.
-             * This only looks racy: while bdb_lock_desired is set, the lock
-             * code
-             * returns 'deadlock' for any thread attempting to get a rowlock.
-             */
-            if (gbl_rowlocks &&
-                lock_handle->repinfo->master_host !=
-                    lock_handle->repinfo->myhost &&
-                abort_waiters) {
-                bdb_abort_logical_waiters(lock_handle);
-            }
+            abort_logical_waiters(lock_handle, abort_waiters);
 
+            int64_t start = bdblock_now_us();
             Pthread_rwlock_wrlock(lock_handle->bdb_lock);
+            __berkdb_lock_heat_named("bdblock", bdblock_now_us() - start);
         } else if (rc != 0) {
             logmsg(LOGMSG_FATAL,
                    "%s/%s(%s): pthread_rwlock_trywrlock error %d %s\n", idstr,
@@ -443,6 +555,8 @@ static inline void bdb_get_writelock_int(bdb_state_type *bdb_state,
             abort();
         }
 
+        revoke_reader_bias(lock_handle, idstr, abort_waiters);
+
         /* Wait on rep_processor threads while we have the writelock lock */
         if (gbl_force_serial_on_writelock && lock_handle->passed_dbenv_open)
             __rep_block_on_inflight_transactions(lock_handle->dbenv);
@@ -523,14 +637,18 @@ void bdb_get_readlock(bdb_state_type *bdb_state, const char *idstr,
         }
 #endif
 
-        rc = pthread_rwlock_tryrdlock(lock_handle->bdb_lock);
-        if (rc == EBUSY) {
+        if (get_biased_readlock(lock_handle, lk))
+            rc = 0;
+        else if ((rc = pthread_rwlock_tryrdlock(lock_handle->bdb_lock)) ==
+                 EBUSY) {
             logmsg(LOGMSG_INFO,
                    "trying readlock (%s %lu), last writelock is %s %lu\n",
                    idstr, pthread_self(), lock_handle->bdb_lock_write_idstr,
                    lock_handle->bdb_lock_write_holder);
 
+            int64_t start = bdblock_now_us();
             Pthread_rwlock_rdlock(lock_handle->bdb_lock);
+            __berkdb_lock_heat_named("bdblock", bdblock_now_us() - start);
         } else if (rc != 0) {
             logmsg(LOGMSG_FATAL,
                    "%s/%s(%s): pthread_rwlock_tryrdlock error %d %s\n", idstr,
@@ -538,6 +656,13 @@ void bdb_get_readlock(bdb_state_type *bdb_state, const char *idstr,
             abort();
         }
 
+        /* writers are held off while we have the rwlock, so it is safe to
+         * turn the bias back on */
+        if (!lk->biased && gbl_bdblock_reader_bias &&
+            !__atomic_load_n(&lock_handle->bdb_lock_rbias, __ATOMIC_RELAXED) &&
+            bdblock_now_us() >= lock_handle->bdb_lock_inhibit_until)
+            __atomic_store_n(&lock_handle->bdb_lock_rbias, 1, __ATOMIC_SEQ_CST);
+
         if (gbl_bdblock_debug)
             get_read_lock_log(bdb_state);
 
@@ -601,7 +726,7 @@ void bdb_rellock(bdb_state_type *bdb_state, const char *funcname, int line)
             lock_handle->bdb_lock_write_holder = 0;
         }
 
-        Pthread_rwlock_unlock(lock_handle->bdb_lock);
+        release_lock(lock_handle, lk);
 
         if (gbl_bdblock_debug)
             rel_lock_log(bdb_state);
@@ -892,6 +1017,8 @@ static void dump_int(thread_lock_info_type *lk, FILE *out)
     logmsgf(LOGMSG_USER, out, "thr %u (0x%x)  lk %9s %u", (int)lk->threadid,
             (int)lk->threadid, locktype2str(lk->locktype), lk->lockref);
 #endif
+    if (lk->biased)
+        logmsgf(LOGMSG_USER, out, " biased");
     if (lk->lockref > 0) {
         logmsgf(LOGMSG_USER, out, " locker:'%s'", lk->ident ? lk->ident : "?");
         if (lk->readlockref) {
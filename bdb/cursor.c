@@ -208,6 +208,7 @@ static int bdb_cursor_find_last_dup(bdb_cursor_ifn_t *, void *key, int keylen,
                                     int keymax, bias_info *, int *bdberr);
 static int bdb_cursor_close(bdb_cursor_ifn_t *cur, int *bdberr);
 static int bdb_cursor_getpageorder(bdb_cursor_ifn_t *pcur_ifn);
+static int bdb_cursor_setstripe(bdb_cursor_ifn_t *pcur_ifn, int stripe);
 static int bdb_cursor_update_shadows(bdb_cursor_ifn_t *pcur_ifn, int *bdberr);
 static void *bdb_cursor_get_shadowtran(bdb_cursor_ifn_t *pcur_ifn);
 static int bdb_cursor_update_shadows_with_pglogs(bdb_cursor_ifn_t *pcur_ifn,
@@ -607,6 +608,7 @@ bdb_cursor_ifn_t *bdb_cursor_open(
     cur->used_sd = 1;
     cur->pagelockflag = holding_pagelocks_flag;
     cur->laststripe = cur->lastpage = cur->lastindex = -1;
+    cur->onestripe = -1;
 
     rowlocks = cur->rowlocks = 0;
 
@@ -629,6 +631,8 @@ bdb_cursor_ifn_t *bdb_cursor_open(
     if (ixnum >= 0) {
         cur->idx = ixnum;
         cur->type = BDBC_IX;
+        /* a partial datacopy payload is shorter than the row, so this
+         * fits either kind */
         if (bdb_state->ixdta[ixnum]) {
             cur->datacopy =
                 malloc(bdb_state->lrl + 2 * sizeof(unsigned long long));
@@ -681,6 +685,7 @@ bdb_cursor_ifn_t *bdb_cursor_open(
     pcur_ifn->lock = bdb_cursor_lock;
     pcur_ifn->set_curtran = bdb_cursor_set_curtran;
     pcur_ifn->getpageorder = bdb_cursor_getpageorder;
+    pcur_ifn->setstripe = bdb_cursor_setstripe;
 
     pcur_ifn->updateshadows = bdb_cursor_update_shadows;
     pcur_ifn->updateshadows_pglogs = bdb_cursor_update_shadows_with_pglogs;
@@ -1039,6 +1044,20 @@ static struct pglogs_queue_key *allocate_pglogs_queue_key(void)
     return q;
 }
 
+/* Fill qe with n keys, taking the pool lock once */
+static void allocate_pglogs_queue_keys(struct pglogs_queue_key **qe, int n)
+{
+    int i;
+    Pthread_mutex_lock(&pglogs_queue_key_pool_lk);
+    for (i = 0; i < n; i++) {
+        qe[i] = pool_getablk(pglogs_queue_key_pool);
+#ifdef NEWSI_DEBUG_POOL
+        qe[i]->pool = pglogs_queue_key_pool;
+#endif
+    }
+    Pthread_mutex_unlock(&pglogs_queue_key_pool_lk);
+}
+
 static void return_pglogs_queue_key(struct pglogs_queue_key *qk)
 {
     Pthread_mutex_lock(&pglogs_queue_key_pool_lk);
@@ -2821,6 +2840,17 @@ int bdb_add_pglogs_key_list(int i, void **listp, db_pgno_t pgno,
     return 0;
 }
 
+int bdb_get_pglogs_key_list(int i, void *list, db_pgno_t *pgno,
+                            unsigned char **fileid, DB_LSN *lsn)
+{
+    struct page_logical_lsn_key *keylist =
+        (struct page_logical_lsn_key *)list;
+    *pgno = keylist[i].pgno;
+    *fileid = keylist[i].fileid;
+    *lsn = keylist[i].lsn;
+    return 0;
+}
+
 int bdb_update_ltran_pglogs_hash(void *bdb_state, void *pglogs,
                                  unsigned int nkeys,
                                  unsigned long long logical_tranid,
@@ -3174,9 +3204,10 @@ static int bdb_update_pglogs_fileid_queues(void *bdb_state,
         qearray = (struct pglogs_queue_key **)malloc(
             nkeys * sizeof(struct pglogs_queue_key *));
 
+    allocate_pglogs_queue_keys(qearray, nkeys);
     for (j = 0; j < nkeys; j++) {
         key = &keylist[j];
-        qearray[j] = qe = allocate_pglogs_queue_key();
+        qe = qearray[j];
         qe->logical_tranid = logical_tranid;
         qe->type = PGLOGS_QUEUE_PAGE;
         qe->prev_pgno = qe->next_pgno = 0;
@@ -3332,14 +3363,31 @@ static int transfer_txn_pglogs_to_queues(void *bdb_state,
     struct fileid_pglogs_queue *fileid_queue = NULL;
     struct pglogs_key *pglogs_ent = NULL;
     struct pglogs_queue_key *qe, *chk;
+    struct pglogs_queue_key **qearray;
     struct lsn_list *lsnent = NULL;
     unsigned int hash_cur_buk;
+    int nkeys = 0, j = 0;
 
 #ifdef NEWSI_STAT
     struct timeval before, after, diff;
     gettimeofday(&before, NULL);
 #endif
 
+    /* allocate all the queue keys up front rather than one at a time while
+       holding the fileid queue */
+    pglogs_ent = hash_first(pglogs_hashtbl, &hash_cur, &hash_cur_buk);
+    while (pglogs_ent) {
+        nkeys += listc_size(&pglogs_ent->lsns);
+        pglogs_ent = hash_next(pglogs_hashtbl, &hash_cur, &hash_cur_buk);
+    }
+    if (nkeys <= 256)
+        qearray = (struct pglogs_queue_key **)alloca(
+            (nkeys + 1) * sizeof(struct pglogs_queue_key *));
+    else
+        qearray = (struct pglogs_queue_key **)malloc(
+            nkeys * sizeof(struct pglogs_queue_key *));
+    allocate_pglogs_queue_keys(qearray, nkeys);
+
     pglogs_ent = hash_first(pglogs_hashtbl, &hash_cur, &hash_cur_buk);
     while (pglogs_ent) {
         if (!fileid_queue ||
@@ -3352,7 +3400,7 @@ static int transfer_txn_pglogs_to_queues(void *bdb_state,
 
         LISTC_FOR_EACH(&pglogs_ent->lsns, lsnent, lnk)
         {
-            qe = allocate_pglogs_queue_key();
+            qe = qearray[j++];
             qe->logical_tranid = logical_tranid;
             qe->type = PGLOGS_QUEUE_PAGE;
             qe->prev_pgno = qe->next_pgno = 0;
@@ -3371,6 +3419,10 @@ static int transfer_txn_pglogs_to_queues(void *bdb_state,
     if (fileid_queue)
         Pthread_rwlock_unlock(&fileid_queue->queue_lk);
 
+    assert(j == nkeys);
+    if (nkeys > 256)
+        free(qearray);
+
 #ifdef NEWSI_STAT
     gettimeofday(&after, NULL);
     timeval_diff(&before, &after, &diff);
@@ -3709,7 +3761,8 @@ int bdb_latest_commit_is_durable(void *in_bdb_state)
 int bdb_transfer_txn_pglogs(void *bdb_state, void *pglogs_hashtbl,
                             pthread_mutex_t *mutexp, DB_LSN commit_lsn,
                             uint32_t flags, unsigned long long logical_tranid,
-                            int32_t timestamp, unsigned long long context)
+                            int32_t timestamp, unsigned long long context,
+                            int child)
 {
     int rc;
 
@@ -3719,6 +3772,19 @@ int bdb_transfer_txn_pglogs(void *bdb_state, void *pglogs_hashtbl,
     if (gbl_disable_new_snapisol_overhead)
         return 0;
 
+    /* A snapshot only needs the pages of commits after its birth lsn.  Our
+     * commit lsn was published when the commit record went out, and readers
+     * are counted before they pick a birth lsn, so if there are none now no
+     * snapshot can need this one.  That doesn't hold for a child, or for a
+     * piece of a logical transaction, whose commit is still to come; nor for
+     * as-of readers, which go back in time. */
+    if (!gbl_new_snapisol_asof && !child &&
+        (!logical_tranid || (flags & DB_TXN_LOGICAL_COMMIT))) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (bdb_osql_trn_active_readers() == 0)
+            goto skip_queues;
+    }
+
     if (context) {
         rc =
             bdb_update_timestamp_lsn(bdb_state, timestamp, commit_lsn, context);
@@ -3734,6 +3800,12 @@ int bdb_transfer_txn_pglogs(void *bdb_state, void *pglogs_hashtbl,
         abort();
 
     return 0;
+
+skip_queues:
+    if (context)
+        return bdb_update_timestamp_lsn(bdb_state, timestamp, commit_lsn,
+                                        context);
+    return 0;
 }
 
 int bdb_get_lsn_context_from_timestamp(bdb_state_type *bdb_state,
@@ -3890,6 +3962,22 @@ static int bdb_cursor_getpageorder(bdb_cursor_ifn_t *pcur_ifn)
     return cur->pageorder;
 }
 
+/*
+ * Make first/last/next/prev traverse only one data stripe; the virtual
+ * stripe is not visited either, so this is for read-only cursors without
+ * shadows.
+ */
+static int bdb_cursor_setstripe(bdb_cursor_ifn_t *pcur_ifn, int stripe)
+{
+    bdb_cursor_impl_t *cur = pcur_ifn->impl;
+
+    if (cur->type != BDBC_DT || stripe < 0 ||
+        stripe >= cur->state->attr->dtastripe)
+        return -1;
+    cur->onestripe = stripe;
+    return 0;
+}
+
 static int bdb_cursor_first(bdb_cursor_ifn_t *pcur_ifn, int *bdberr)
 {
     bdb_cursor_impl_t *cur = pcur_ifn->impl;
@@ -4281,7 +4369,7 @@ static int berkdb_get_genid(bdb_cursor_impl_t *cur, bdb_berkdb_t *berkdb,
             return rc;
         rc = berkdb->dtasize(berkdb, &vallen, bdberr);
         if (cur->state->ixdta[cur->idx]) {
-            /* datacopy */
+            /* datacopy, whole or partial: the genid leads the payload */
             assert(vallen >= sizeof(*genid));
             vallen = sizeof(*genid);
         }
@@ -6151,6 +6239,8 @@ static int bdb_cursor_move_int(bdb_cursor_impl_t *cur, int how, int *bdberr)
         int dtafile =
             (how == DB_FIRST) ? 0 : (cur->state->attr->dtastripe -
                                      ((cur->addcur) ? 0 : 1)); /* last stripe */
+        if (cur->onestripe >= 0)
+            dtafile = cur->onestripe;
 
         if (cur->data) {
             /* cursor is positioned */
@@ -6224,6 +6314,9 @@ static int bdb_cursor_move_int(bdb_cursor_impl_t *cur, int how, int *bdberr)
         }
 
         if (rc == IX_PASTEOF || rc == IX_EMPTY || rc == IX_NOTFND) {
+            if (cur->onestripe >= 0)
+                return (how == DB_FIRST || how == DB_LAST) ? IX_EMPTY
+                                                           : IX_PASTEOF;
             switch (how) {
             case DB_FIRST:
                 nextstripe++;
@@ -7017,6 +7110,8 @@ static int bdb_cursor_insert(bdb_cursor_ifn_t *pcur_ifn,
     memcpy(newkey, data, datalen);
     memcpy(&newkey[datalen], &genid, sizeof(genid));
 
+    /* datacopy is the payload as the caller built it: the whole row, or just
+     * the copied columns for a partial datacopy index */
     if (cur->state->ixdta[cur->idx]) {
         assert(datacopy != NULL && datacopylen > 0);
         assert(sizeof(genid) + datacopylen <= MAXRECSZ);
@@ -8629,10 +8724,55 @@ static int bdb_cursor_collattrlen(bdb_cursor_ifn_t *cur)
 
 struct count_arg {
     DB *db;
+    struct bdb_stripe_count *cache; /* data stripes only */
     int64_t count;
     int rc;
 };
 
+int gbl_direct_count_cache = 0;
+static pthread_mutex_t stripe_count_lk = PTHREAD_MUTEX_INITIALIZER;
+
+/* Is the count of stripe db still good?  Every page change, including
+ * those replayed from the master, moves the mpool dirty generation. */
+static int stripe_count_get(struct count_arg *arg, u_int64_t gen)
+{
+    struct bdb_stripe_count *c = arg->cache;
+    int found;
+
+    Pthread_mutex_lock(&stripe_count_lk);
+    found = c->dirty_gen == gen &&
+            memcmp(c->fileid, arg->db->fileid, DB_FILE_ID_LEN) == 0;
+    if (found)
+        arg->count = c->count;
+    Pthread_mutex_unlock(&stripe_count_lk);
+
+    return found;
+}
+
+static void stripe_count_put(struct count_arg *arg, u_int64_t gen)
+{
+    struct bdb_stripe_count *c = arg->cache;
+    u_int64_t now;
+
+    /* a page changed under the walk; the count may be a mix */
+    if (arg->db->mpf->get_dirty_gen(arg->db->mpf, &now) || now != gen)
+        return;
+
+    Pthread_mutex_lock(&stripe_count_lk);
+    memcpy(c->fileid, arg->db->fileid, DB_FILE_ID_LEN);
+    c->dirty_gen = gen;
+    c->count = arg->count;
+    Pthread_mutex_unlock(&stripe_count_lk);
+}
+
+void bdb_stripe_count_reset(bdb_state_type *bdb_state, int stripe)
+{
+    Pthread_mutex_lock(&stripe_count_lk);
+    memset(&bdb_state->stripe_count[stripe], 0,
+           sizeof(bdb_state->stripe_count[stripe]));
+    Pthread_mutex_unlock(&stripe_count_lk);
+}
+
 #define UNUSED(x) ((void)(x))
 static void *db_count(void *varg)
 {
@@ -8650,6 +8790,14 @@ static void *db_count(void *varg)
     v.flags = DB_DBT_USERMEM;
 
     DB *db = arg->db;
+    u_int64_t gen = 0;
+    int cache = arg->cache && gbl_direct_count_cache &&
+                db->mpf->get_dirty_gen(db->mpf, &gen) == 0;
+    if (cache && stripe_count_get(arg, gen)) {
+        arg->rc = DB_NOTFOUND;
+        return NULL;
+    }
+
     DBC *dbc;
     if ((rc = db->cursor(db, NULL, &dbc, 0)) != 0) {
         arg->rc = rc;
@@ -8674,15 +8822,16 @@ static void *db_count(void *varg)
     dbc->c_close(dbc);
     arg->rc = rc;
     arg->count = count;
+    if (cache && rc == DB_NOTFOUND)
+        stripe_count_put(arg, gen);
     return NULL;
 }
 
 int gbl_parallel_count = 0;
-int bdb_direct_count(bdb_cursor_ifn_t *cur, int ixnum, int64_t *rcnt)
+static int direct_count_int(bdb_state_type *state, int ixnum, int64_t *rcnt)
 {
     int64_t count = 0;
     int parallel_count;
-    bdb_state_type *state = cur->impl->state;
     DB **db;
     int stripes;
     pthread_attr_t attr;
@@ -8703,6 +8852,7 @@ int bdb_direct_count(bdb_cursor_ifn_t *cur, int ixnum, int64_t *rcnt)
     pthread_t thds[stripes];
     for (int i = 0; i < stripes; ++i) {
         args[i].db = db[i];
+        args[i].cache = ixnum < 0 ? &state->stripe_count[i] : NULL;
         if (parallel_count) {
             pthread_create(&thds[i], &attr, db_count, &args[i]);
         } else {
@@ -8731,3 +8881,19 @@ int bdb_direct_count(bdb_cursor_ifn_t *cur, int ixnum, int64_t *rcnt)
     if (rc == 0) *rcnt = count;
     return rc;
 }
+
+int bdb_direct_count(bdb_cursor_ifn_t *cur, int ixnum, int64_t *rcnt)
+{
+    return direct_count_int(cur->impl->state, ixnum, rcnt);
+}
+
+int bdb_table_direct_count(bdb_state_type *bdb_state, int64_t *rcnt)
+{
+    int rc;
+
+    BDB_READLOCK("bdb_table_direct_count");
+    rc = direct_count_int(bdb_state, -1, rcnt);
+    BDB_RELLOCK();
+
+    return rc;
+}
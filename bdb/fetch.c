@@ -575,6 +575,14 @@ void bdb_cursor_ser_invalidate(bdb_cursor_ser_t *cur_ser)
     ((bdb_cursor_ser_int_t *)cur_ser)->is_valid = 0;
 }
 
+/* Does the index payload hold the whole row?  A partial datacopy payload has
+ * only some of the columns, so it is never handed back as the row; the row is
+ * fetched from the data file instead */
+static inline int ixdta_is_row(bdb_state_type *bdb_state, int ixnum)
+{
+    return bdb_state->ixdta[ixnum] && !bdb_state->ixdtalen[ixnum];
+}
+
 #define SAVEGENID                                                              \
     memcpy(&foundgenid, dbt_data.data, sizeof(unsigned long long));            \
     if (havedta) {                                                             \
@@ -662,7 +670,7 @@ static int bdb_fetch_int_ll(
         dbp = NULL; /* will be set later */
     } else {
         /* we are using an actual index */
-        if ((bdb_state->ixdta[ixnum]) && (return_dta == 1))
+        if (ixdta_is_row(bdb_state, ixnum) && (return_dta == 1))
             havedta = 1;
 
         ixlen_full = bdb_state->ixlen[ixnum];
@@ -924,7 +932,7 @@ before_first_lookup:
             if ((!(keycontainsgenid)) && (ixlen_full == ixlen))
                 goto fetch_int_cur;
 
-            if (bdb_state->ondisk_header && bdb_state->ixdta[ixnum] &&
+            if (bdb_state->ondisk_header && ixdta_is_row(bdb_state, ixnum) &&
                 bdb_state->datacopy_odh) {
                 unpack_index_odh(bdb_state, &dbt_data, &foundgenid, dta, dtalen,
                                  reqdtalen, ver);
@@ -963,7 +971,8 @@ before_first_lookup:
                 }
 
                 if (rc == 0) {
-                    if (bdb_state->ondisk_header && bdb_state->ixdta[ixnum] &&
+                    if (bdb_state->ondisk_header &&
+                        ixdta_is_row(bdb_state, ixnum) &&
                         bdb_state->datacopy_odh) {
                         unpack_index_odh(bdb_state, &dbt_data, &foundgenid, dta,
                                          dtalen, reqdtalen, ver);
@@ -978,7 +987,8 @@ before_first_lookup:
                     outrc = 3;
                 }
             } else if (rc == 0) {
-                if (bdb_state->ondisk_header && bdb_state->ixdta[ixnum] &&
+                if (bdb_state->ondisk_header &&
+                    ixdta_is_row(bdb_state, ixnum) &&
                     bdb_state->datacopy_odh) {
                     unpack_index_odh(bdb_state, &dbt_data, &foundgenid, dta,
                                      dtalen, reqdtalen, ver);
@@ -1090,7 +1100,8 @@ before_first_lookup:
                     goto err;
                 }
 
-                if (bdb_state->ondisk_header && bdb_state->ixdta[ixnum] &&
+                if (bdb_state->ondisk_header &&
+                    ixdta_is_row(bdb_state, ixnum) &&
                     bdb_state->datacopy_odh) {
                     unpack_index_odh(bdb_state, &dbt_data, &foundgenid, dta,
                                      dtalen, reqdtalen, ver);
@@ -1135,7 +1146,8 @@ before_first_lookup:
                     *reqdtalen = odh.length;
                     *ver = odh.csc2vers;
                 }
-            } else if (bdb_state->ondisk_header && bdb_state->ixdta[ixnum] &&
+            } else if (bdb_state->ondisk_header &&
+                       ixdta_is_row(bdb_state, ixnum) &&
                        bdb_state->datacopy_odh) {
                 unpack_index_odh(bdb_state, &dbt_data, &foundgenid, dta, dtalen,
                                  reqdtalen, ver);
@@ -1182,7 +1194,8 @@ before_first_lookup:
                         *ver = odh.csc2vers;
                     }
                 } else if (bdb_state->ondisk_header &&
-                           bdb_state->ixdta[ixnum] && bdb_state->datacopy_odh) {
+                           ixdta_is_row(bdb_state, ixnum) &&
+                           bdb_state->datacopy_odh) {
                     unpack_index_odh(bdb_state, &dbt_data, &foundgenid, dta,
                                      dtalen, reqdtalen, ver);
                 }
@@ -1243,7 +1256,7 @@ before_first_lookup:
                             *ver = odh.csc2vers;
                         }
                     } else if (bdb_state->ondisk_header &&
-                               bdb_state->ixdta[ixnum] &&
+                               ixdta_is_row(bdb_state, ixnum) &&
                                bdb_state->datacopy_odh) {
                         unpack_index_odh(bdb_state, &dbt_data, &foundgenid, dta,
                                          dtalen, reqdtalen, ver);
@@ -1319,7 +1332,7 @@ before_first_lookup:
                                 *ver = odh.csc2vers;
                             }
                         } else if (bdb_state->ondisk_header &&
-                                   bdb_state->ixdta[ixnum] &&
+                                   ixdta_is_row(bdb_state, ixnum) &&
                                    bdb_state->datacopy_odh) {
                             unpack_index_odh(bdb_state, &dbt_data, &foundgenid,
                                              dta, dtalen, reqdtalen, ver);
@@ -1403,7 +1416,7 @@ before_first_lookup:
                             /* save the genid we found */
 
                             if (bdb_state->ondisk_header &&
-                                bdb_state->ixdta[ixnum] &&
+                                ixdta_is_row(bdb_state, ixnum) &&
                                 bdb_state->datacopy_odh) {
                                 unpack_index_odh(bdb_state, &dbt_data,
                                                  &foundgenid, dta, dtalen,
@@ -1447,7 +1460,7 @@ before_first_lookup:
                             /* save the genid we found */
 
                             if (bdb_state->ondisk_header &&
-                                bdb_state->ixdta[ixnum] &&
+                                ixdta_is_row(bdb_state, ixnum) &&
                                 bdb_state->datacopy_odh) {
                                 unpack_index_odh(bdb_state, &dbt_data,
                                                  &foundgenid, dta, dtalen,
@@ -1499,7 +1512,8 @@ before_first_lookup:
                 }
 
                 if (rc == 0) {
-                    if (bdb_state->ondisk_header && bdb_state->ixdta[ixnum] &&
+                    if (bdb_state->ondisk_header &&
+                        ixdta_is_row(bdb_state, ixnum) &&
                         bdb_state->datacopy_odh) {
                         unpack_index_odh(bdb_state, &dbt_data, &foundgenid, dta,
                                          dtalen, reqdtalen, ver);
@@ -1537,7 +1551,7 @@ before_first_lookup:
 
                     if (rc == 0) {
                         if (bdb_state->ondisk_header &&
-                            bdb_state->ixdta[ixnum] &&
+                            ixdta_is_row(bdb_state, ixnum) &&
                             bdb_state->datacopy_odh) {
                             unpack_index_odh(bdb_state, &dbt_data, &foundgenid,
                                              dta, dtalen, reqdtalen, ver);
@@ -1703,7 +1717,8 @@ before_first_lookup:
                     *reqdtalen = odh.length;
                     *ver = odh.csc2vers;
                 }
-            } else if (bdb_state->ondisk_header && bdb_state->ixdta[ixnum] &&
+            } else if (bdb_state->ondisk_header &&
+                       ixdta_is_row(bdb_state, ixnum) &&
                        bdb_state->datacopy_odh) {
                 unpack_index_odh(bdb_state, &dbt_data, &foundgenid, dta, dtalen,
                                  reqdtalen, ver);
@@ -1781,7 +1796,8 @@ before_first_lookup:
                         *ver = odh.csc2vers;
                     }
                 } else if (bdb_state->ondisk_header &&
-                           bdb_state->ixdta[ixnum] && bdb_state->datacopy_odh) {
+                           ixdta_is_row(bdb_state, ixnum) &&
+                           bdb_state->datacopy_odh) {
                     unpack_index_odh(bdb_state, &dbt_data, &foundgenid, dta,
                                      dtalen, reqdtalen, ver);
                 }
@@ -1865,7 +1881,8 @@ before_first_lookup:
                         *ver = odh.csc2vers;
                     }
                 } else if (bdb_state->ondisk_header &&
-                           bdb_state->ixdta[ixnum] && bdb_state->datacopy_odh) {
+                           ixdta_is_row(bdb_state, ixnum) &&
+                           bdb_state->datacopy_odh) {
                     unpack_index_odh(bdb_state, &dbt_data, &foundgenid, dta,
                                      dtalen, reqdtalen, ver);
                 }
@@ -2104,9 +2121,26 @@ err:
             if (dirty)
                 get_flags |= DB_DIRTY_READ;
 
+            DB *dtadb = bdb_state->dbp_data[0][dtafile];
+            unsigned long long rcgenid = foundgenid;
+            u_int64_t rcgen;
+            int rowcache =
+                !tid && !dirty && bdb_row_cache_gen(dtadb, &rcgen) == 0;
+
+            if (rowcache && bdb_row_cache_get(dtadb, rcgenid, rcgen, dta,
+                                              dtalen, reqdtalen, ver)) {
+                *genid = foundgenid;
+                *rrn = 2;
+                goto endofbigif;
+            }
+
             /* now get the data */
-            rc = bdb_get_unpack(bdb_state, bdb_state->dbp_data[0][dtafile], tid,
-                                &dbt_key, &dbt_data, ver, get_flags);
+            rc = bdb_get_unpack(bdb_state, dtadb, tid, &dbt_key, &dbt_data, ver,
+                                get_flags);
+
+            if (rc == 0 && rowcache)
+                bdb_row_cache_put(dtadb, rcgenid, rcgen, dbt_data.data,
+                                  dbt_data.size, *ver);
 
             if (rc == 0) {
                 *genid = foundgenid;
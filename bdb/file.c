@@ -1784,6 +1784,8 @@ void *watcher_thread(void *arg);
 void *checkpoint_thread(void *arg);
 void *logdelete_thread(void *arg);
 void *memp_trickle_thread(void *arg);
+void *pgcompact_sweep_thread(void *arg);
+void *log_prealloc_thread(void *arg);
 void *deadlockdetect_thread(void *arg);
 
 void make_lsn(DB_LSN *logseqnum, unsigned int filenum, unsigned int offsetnum)
@@ -2479,6 +2481,11 @@ static DB_ENV *dbenv_open(bdb_state_type *bdb_state)
     net_register_handler(bdb_state->repinfo->netinfo, USER_TYPE_BERKDB_REP,
                          "berkdb_replication", berkdb_receive_rtn);
 
+    /* time the replication stream's wait in each replicant's queue */
+    net_register_send_latency(bdb_state->repinfo->netinfo,
+                              bdb_rep_stage_net_latency,
+                              &gbl_rep_stage_sample);
+
     net_register_handler(bdb_state->repinfo->netinfo, USER_TYPE_BERKDB_NEWSEQ,
                          "berkdb_newseq", berkdb_receive_rtn);
 
@@ -5772,6 +5779,36 @@ static bdb_state_type *bdb_open_int(
                 return NULL;
             }
 
+            rc = pthread_create(&dummy_tid, &attr, log_prealloc_thread,
+                                bdb_state);
+            if (rc != 0) {
+                logmsg(LOGMSG_ERROR, "unable to create log prealloc thread "
+                                "- rc=%d errno=%d %s\n",
+                        rc, errno, strerror(errno));
+                *bdberr = BDBERR_MISC;
+                return NULL;
+            }
+
+            rc = pthread_create(&dummy_tid, &attr, pgcompact_sweep_thread,
+                                bdb_state);
+            if (rc != 0) {
+                logmsg(LOGMSG_ERROR, "unable to create pgcompact sweep thread "
+                                "- rc=%d errno=%d %s\n",
+                        rc, errno, strerror(errno));
+                *bdberr = BDBERR_MISC;
+                return NULL;
+            }
+
+            rc = pthread_create(&dummy_tid, &attr,
+                                bdb_temp_table_prewarm_thread, bdb_state);
+            if (rc != 0) {
+                logmsg(LOGMSG_ERROR, "unable to create temptable prewarm thread "
+                                "- rc=%d errno=%d %s\n",
+                        rc, errno, strerror(errno));
+                *bdberr = BDBERR_MISC;
+                return NULL;
+            }
+
             /* create the deadlock detect thread if we arent doing auto
                deadlock detection */
             if (!bdb_state->attr->autodeadlockdetect) {
@@ -6861,6 +6898,8 @@ static int bdb_free_int(bdb_state_type *bdb_state, bdb_state_type *replace,
         free(child->txndir);
         free(child->tmpdir);
         free(child->fld_hints);
+        bdb_zstd_free(child);
+        bdb_ixbloom_free(child);
         // free bthash
         bdb_handle_dbp_drop_hash(child);
         memset(child, 0xff, sizeof(bdb_state_type));
@@ -1285,7 +1285,12 @@ static int open_retry(DBC **dbcp, fstdump_per_thread_t *fstdump,
     int rc = 0;
 
     while (retries < gbl_maxretries) {
-        if ((rc = fstdump->dbp->cursor(fstdump->dbp, NULL, dbcp, 0)) == 0) {
+        u_int32_t flags = 0;
+        /* a dump reads every page once; don't push the working set out */
+        if (common->bdb_parent_state->attr->fstdump_discard_pages)
+            flags |= DB_DISCARD_PAGES;
+        if ((rc = fstdump->dbp->cursor(fstdump->dbp, NULL, dbcp, flags)) ==
+            0) {
             return 0;
         }
 
@@ -64,6 +64,7 @@
 
 #include "genid.h"
 #include "logmsg.h"
+#include "comdb2_atomic.h"
 
 int gbl_block_set_commit_genid_trace = 0;
 static unsigned long long commit_genid;
@@ -321,6 +322,7 @@ void set_gblcontext(bdb_state_type *bdb_state, unsigned long long gblcontext)
     Pthread_mutex_lock(&(bdb_state->gblcontext_lock));
 
     set_gblcontext_int(bdb_state, gblcontext);
+    ATOMIC_ADD32(bdb_state->genid_block_epoch, 1);
 
     Pthread_mutex_unlock(&(bdb_state->gblcontext_lock));
 }
@@ -350,10 +352,7 @@ unsigned long long get_id(bdb_state_type *bdb_state)
 
     iptr = (unsigned int *)&id;
 
-    Pthread_mutex_lock(&(bdb_state->id_lock));
-    bdb_state->id++;
-    dupcount = bdb_state->id;
-    Pthread_mutex_unlock(&(bdb_state->id_lock));
+    dupcount = ATOMIC_ADD32(bdb_state->id, 1);
 
     iptr[0] = htonl(comdb2_time_epoch());
     iptr[1] = htonl(dupcount);
@@ -396,17 +395,39 @@ static inline void set_commit_genid_lsn_gen(bdb_state_type *bdb_state,
     set_gblcontext_int(bdb_state, genid);
 }
 
+static unsigned long long genid48_pack(unsigned long long seed48,
+                                       unsigned int dtafile)
+{
+    unsigned long long genid;
+    unsigned int *iptr;
+    uint32_t highorder = 0, loworder = 0;
+    uint16_t *s48ptr;
+
+    s48ptr = (uint16_t *)&seed48;
+    iptr = (unsigned int *)&genid;
+
+#if defined(_LINUX_SOURCE)
+    memcpy(&highorder, &s48ptr[1], 4);
+    loworder = s48ptr[0] << 16;
+#else
+    memcpy(&highorder, &s48ptr[1], 4);
+    memcpy(&loworder, &s48ptr[3], 2);
+#endif
+    loworder |= (dtafile & 0x0000000f);
+    iptr[0] = htonl(highorder);
+    iptr[1] = htonl(loworder);
+
+    return genid;
+}
+
 static unsigned long long get_genid_48bit(bdb_state_type *bdb_state,
                                           unsigned int dtafile, DB_LSN *lsn,
                                           uint32_t generation, uint64_t seed)
 {
-    unsigned int *iptr;
     unsigned long long genid;
     unsigned long long seed48;
     static time_t lastwarn = 0;
     time_t now;
-    uint32_t highorder = 0, loworder = 0;
-    uint16_t *s48ptr;
     int prwarn = 0;
 
     Pthread_mutex_lock(&(bdb_state->gblcontext_lock));
@@ -430,22 +451,15 @@ static unsigned long long get_genid_48bit(bdb_state_type *bdb_state,
             bdb_state->attr->genid48_warn_threshold)
         prwarn = 1;
 
-    s48ptr = (uint16_t *)&seed48;
-    iptr = (unsigned int *)&genid;
-
-#if defined(_LINUX_SOURCE)
-    memcpy(&highorder, &s48ptr[1], 4);
-    loworder = s48ptr[0] << 16;
-#else
-    memcpy(&highorder, &s48ptr[1], 4);
-    memcpy(&loworder, &s48ptr[3], 2);
-#endif
-    loworder |= (dtafile & 0x0000000f);
-    iptr[0] = htonl(highorder);
-    iptr[1] = htonl(loworder);
-
+    genid = genid48_pack(seed48, dtafile);
     bdb_state->gblcontext = genid;
 
+    /* a genid taken from the counter itself is a compare context (or a
+       seed): nothing handed out after it may be older, so retire the
+       per-thread blocks, which all lie below it */
+    if (!lsn)
+        ATOMIC_ADD32(bdb_state->genid_block_epoch, 1);
+
     if (lsn) {
         set_commit_genid_lsn_gen(bdb_state, genid, lsn, &generation);
     }
@@ -465,6 +479,57 @@ void seed_genid48(bdb_state_type *bdb_state, uint64_t seed)
     get_genid_48bit(bdb_state, 0, NULL, 0, seed);
 }
 
+/* Counter space reserved by this thread (genid48_block_size) */
+struct genid_block {
+    bdb_state_type *bdb_state;
+    int epoch;
+    unsigned long long next;
+    unsigned long long end; /* last seed in the block */
+};
+static __thread struct genid_block genid_block;
+
+/* Hand out a 48-bit genid from this thread's block, reserving a new one from
+ * the global counter when it runs out or has been retired.  Genids are still
+ * unique and increase within a thread, but not across threads.  A compare
+ * context bumps genid_block_epoch under gblcontext_lock, and the second load
+ * below makes sure no thread hands out a genid from an older block after
+ * that; commit genids are always taken from the counter, above the blocks. */
+static unsigned long long get_genid_48bit_block(bdb_state_type *bdb_state,
+                                                unsigned int dtafile,
+                                                int blocksize)
+{
+    struct genid_block *b = &genid_block;
+    unsigned long long seed48;
+    int epoch;
+
+    epoch = ATOMIC_LOAD32(bdb_state->genid_block_epoch);
+    if (b->bdb_state == bdb_state && b->epoch == epoch && b->next <= b->end) {
+        seed48 = b->next++;
+        if (ATOMIC_LOAD32(bdb_state->genid_block_epoch) == epoch)
+            return genid48_pack(seed48, dtafile);
+    }
+
+    Pthread_mutex_lock(&(bdb_state->gblcontext_lock));
+    seed48 = get_genid_counter48(bdb_state->gblcontext);
+    if (seed48 + blocksize >= 0x0000ffffffffffffULL ||
+        (bdb_state->attr->genid48_warn_threshold &&
+         (0x0000ffffffffffffULL - seed48 - blocksize) <=
+             bdb_state->attr->genid48_warn_threshold)) {
+        /* nearly out: let get_genid_48bit warn and stall */
+        Pthread_mutex_unlock(&(bdb_state->gblcontext_lock));
+        b->bdb_state = NULL;
+        return get_genid_48bit(bdb_state, dtafile, NULL, 0, 0);
+    }
+    b->bdb_state = bdb_state;
+    b->epoch = bdb_state->genid_block_epoch;
+    b->next = seed48 + 2;
+    b->end = seed48 + blocksize;
+    bdb_state->gblcontext = genid48_pack(b->end, 0);
+    Pthread_mutex_unlock(&(bdb_state->gblcontext_lock));
+
+    return genid48_pack(seed48 + 1, dtafile);
+}
+
 static unsigned long long get_genid_timebased(bdb_state_type *bdb_state,
                                       unsigned int dtafile, DB_LSN *lsn,
                                       uint32_t generation)
@@ -583,6 +648,13 @@ unsigned long long get_genid_int(bdb_state_type *bdb_state,
 
 unsigned long long get_genid(bdb_state_type *bdb_state, unsigned int dtafile)
 {
+    extern int gbl_llmeta_open;
+    bdb_state_type *parent = bdb_state->parent ? bdb_state->parent : bdb_state;
+    int blocksize = parent->attr->genid48_block_size;
+
+    if (blocksize > 1 && gbl_llmeta_open &&
+        parent->genid_format == LLMETA_GENID_48BIT)
+        return get_genid_48bit_block(parent, dtafile, blocksize);
     return get_genid_int(bdb_state, dtafile, NULL, 0);
 }
 
@@ -806,7 +878,8 @@ unsigned long long bdb_get_cmp_context_int(bdb_state_type *bdb_state)
        recieved from the master */
     if (bdb_state->repinfo->master_host ==
         net_get_mynode(bdb_state->repinfo->netinfo)) {
-        return get_genid(bdb_state, 0);
+        /* from the counter, never from a per-thread block */
+        return get_genid_int(bdb_state, 0, NULL, 0);
     } else {
         return get_gblcontext(bdb_state);
     }
@@ -1064,6 +1137,9 @@ void bdb_set_commit_genid( bdb_state_type *bdb_state, unsigned long long context
 
     set_commit_genid_lsn_gen(bdb_state, context, (const DB_LSN *)plsn,
                              (const uint32_t *)generation);
+    /* the master moved the counter: blocks from our own time as master are
+       stale */
+    ATOMIC_ADD32(bdb_state->genid_block_epoch, 1);
 
     Pthread_mutex_unlock(&(bdb_state->gblcontext_lock));
 }
@@ -172,6 +172,11 @@ static void log_stats(FILE *out, bdb_state_type *bdb_state)
     prn_stat(st_disk_offset);
     prn_stat(st_maxcommitperflush);
     prn_stat(st_mincommitperflush);
+    prn_stat(st_commitsflushed);
+    prn_stat(st_gc_waits);
+    prn_stat(st_gc_window_usec);
+    prn_stat(st_gc_arrival_usec);
+    prn_stat(st_gc_fsync_usec);
     prn_stat(st_regsize);
     prn_stat(st_region_wait);
     prn_stat(st_region_nowait);
@@ -351,7 +356,8 @@ static void rep_stats(FILE *out, bdb_state_type *bdb_state)
     char str[80];
     extern int64_t gbl_rep_trans_parallel, gbl_rep_trans_serial,
         gbl_rep_trans_deadlocked, gbl_rep_trans_inline,
-        gbl_rep_rowlocks_multifile;
+        gbl_rep_rowlocks_multifile, gbl_rep_trans_page_queues;
+    extern int64_t gbl_rep_acks_sent, gbl_rep_acks_coalesced;
 
     bdb_state->dbenv->rep_stat(bdb_state->dbenv, &stats, 0);
 
@@ -404,8 +410,13 @@ static void rep_stats(FILE *out, bdb_state_type *bdb_state)
     logmsgf(LOGMSG_USER, out, "txn inline: %ld\n", gbl_rep_trans_inline);
     logmsgf(LOGMSG_USER, out, "txn multifile rowlocks: %ld\n",
             gbl_rep_rowlocks_multifile);
+    logmsgf(LOGMSG_USER, out, "txn page queues: %ld\n",
+            gbl_rep_trans_page_queues);
     logmsgf(LOGMSG_USER, out, "txn deadlocked: %ld\n",
             gbl_rep_trans_deadlocked);
+    logmsgf(LOGMSG_USER, out, "batched acks sent: %ld\n", gbl_rep_acks_sent);
+    logmsgf(LOGMSG_USER, out, "acks coalesced: %ld\n",
+            gbl_rep_acks_coalesced);
     prn_lstat(lc_cache_hits);
     prn_lstat(lc_cache_misses);
     prn_stat(lc_cache_size);
@@ -574,6 +585,9 @@ static void cache_stats(FILE *out, bdb_state_type *bdb_state, int extra)
     prn_lstat(st_alloc_max_pages);
     prn_lstat(st_ckp_pages_sync);
     prn_lstat(st_ckp_pages_skip);
+    prn_lstat(st_numa_local_hit);
+    prn_lstat(st_numa_remote_hit);
+    prn_lstat(st_2q_promote);
 
     if (extra) {
         bdb_state->dbenv->memp_dump_region(bdb_state->dbenv, "A", out);
@@ -591,6 +605,8 @@ static void cache_stats(FILE *out, bdb_state_type *bdb_state, int extra)
             logmsgf(LOGMSG_USER, out, "  st_page_create: %"PRId64"\n", (*i)->st_page_create);
             logmsgf(LOGMSG_USER, out, "  st_page_in    : %"PRId64"\n", (*i)->st_page_in);
             logmsgf(LOGMSG_USER, out, "  st_page_out   : %"PRId64"\n", (*i)->st_page_out);
+            logmsgf(LOGMSG_USER, out, "  st_evict      : %"PRId64"\n", (*i)->st_evict);
+            logmsgf(LOGMSG_USER, out, "  st_pages      : %"PRId64"\n", (*i)->st_pages);
         }
 
         free(fsp);
@@ -599,6 +615,43 @@ static void cache_stats(FILE *out, bdb_state_type *bdb_state, int extra)
     free(stats);
 }
 
+static void add_cache_stats(DB *dbp, struct bdb_cache_stats *st)
+{
+    DB_MPOOL_FSTAT fs;
+
+    if (dbp == NULL || dbp->mpf == NULL ||
+        dbp->mpf->get_stat(dbp->mpf, &fs) != 0)
+        return;
+    st->pages += fs.st_pages;
+    st->bytes += fs.st_pages * fs.st_pagesize;
+    st->hits += fs.st_cache_hit;
+    st->misses += fs.st_cache_miss;
+    st->pages_in += fs.st_page_in;
+    st->pages_out += fs.st_page_out;
+    st->evictions += fs.st_evict;
+}
+
+void bdb_get_file_cache_stats(bdb_state_type *bdb_state, int ixnum,
+                              struct bdb_cache_stats *st)
+{
+    int dtanum, strnum;
+
+    memset(st, 0, sizeof(*st));
+    if (ixnum >= 0) {
+        if (ixnum < bdb_state->numix)
+            add_cache_stats(bdb_state->dbp_ix[ixnum], st);
+        return;
+    }
+    for (dtanum = ixnum == BDB_CACHE_STATS_DATA ? 0 : 1;
+         dtanum < bdb_state->numdtafiles; dtanum++) {
+        for (strnum = bdb_get_datafile_num_files(bdb_state, dtanum) - 1;
+             strnum >= 0; strnum--)
+            add_cache_stats(bdb_state->dbp_data[dtanum][strnum], st);
+        if (ixnum == BDB_CACHE_STATS_DATA)
+            break;
+    }
+}
+
 static void temp_cache_stats(FILE *out, bdb_state_type *bdb_state)
 {
     DB_MPOOL_STAT *stats;
@@ -1448,14 +1501,16 @@ void bdb_process_user_command(bdb_state_type *bdb_state, char *line, int lline,
         test_send(bdb_state);
     else if (tokcmp(tok, ltok, "temptable") == 0) {
         if (gbl_temptable_pool_capacity == 0) {
+            bdb_temp_table_prewarm_report();
             logmsg(LOGMSG_USER, "Temptable pool not enabled.\n");
             return;
         }
 
         tok = segtok(line, lline, &st, &ltok);
-        if (ltok <= 0)
+        if (ltok <= 0) {
             comdb2_objpool_stats(bdb_state->temp_table_pool);
-        else if (tokcmp(tok, ltok, "capacity") == 0) {
+            bdb_temp_table_prewarm_report();
+        } else if (tokcmp(tok, ltok, "capacity") == 0) {
             tok = segtok(line, lline, &st, &ltok);
             if (ltok <= 0)
                 logmsg(LOGMSG_ERROR, "Expected # for temptable pool capacity.\n");
@@ -0,0 +1,365 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/* Bloom filters of the keys in a table's unique indexes, so the master can
+ * answer "definitely not there" for a key without descending the btree.
+ *
+ * A filter is built by analyze (bdb_ixbloom_build) from a scan of the index
+ * and then kept up to date by ll_key_add.  Keys are never taken out, so
+ * deletes and aborted inserts only cost false positives.  A filter must
+ * never miss a key that is in the index, so it is only trusted while:
+ *
+ *   - it is complete: it was published before the scan started, and every
+ *     key added after that went through ll_key_add,
+ *   - this node has been master since it was built: replicants apply keys
+ *     from the log, which doesn't go through ll_key_add, so a change of
+ *     replication generation retires it,
+ *   - the index file is the one it was built from, and
+ *   - it hasn't taken in more keys than it was sized for.
+ *
+ * Filters that are replaced stay allocated until the table is closed, as a
+ * reader may still be probing them.  All the filters, retired ones
+ * included, share the ix_bloom_memory budget; an index that doesn't fit in
+ * what is left gets a smaller filter, or none.
+ *
+ * The build scan holds the bdb lock one batch of keys at a time, so that
+ * it doesn't hold up a schema change or a master swing for the whole
+ * index; it gives up if the index or the master changed in between. */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <build/db.h>
+#include <logmsg.h>
+#include "crc32c.h"
+#include "bdb_int.h"
+#include "locks.h"
+
+#define IX_BLOOM_HASHES 7
+#define IX_BLOOM_MINBITS (1ULL << 16)
+#define IX_BLOOM_MAXBITS (1ULL << 32)
+#define IX_BLOOM_BATCH 10000 /* keys scanned per hold of the bdb lock */
+
+struct ix_bloom {
+    u_int8_t fileid[DB_FILE_ID_LEN]; /* index file the filter describes */
+    uint32_t gen;                    /* replication generation at build */
+    int ready;                       /* the build scan completed */
+    uint64_t mask;                   /* number of bits - 1 */
+    uint64_t maxkeys;                /* sized for this many keys */
+    uint64_t nkeys;                  /* keys added since publishing */
+    struct ix_bloom *retired;        /* filters this one replaced */
+    uint64_t bits[];
+};
+
+static uint64_t ix_bloom_bytes; /* taken by all filters */
+
+/* Allocate a filter of up to nbits bits, fewer if the ix_bloom_memory left
+ * can't take that many; NULL if not even IX_BLOOM_MINBITS fit */
+static struct ix_bloom *ix_bloom_alloc(bdb_state_type *bdb_state,
+                                       uint64_t nbits)
+{
+    uint64_t max = (uint64_t)bdb_state->attr->ix_bloom_memory << 20;
+    uint64_t cur = __atomic_load_n(&ix_bloom_bytes, __ATOMIC_RELAXED);
+    uint64_t len;
+    struct ix_bloom *b;
+
+    do {
+        for (; nbits >= IX_BLOOM_MINBITS; nbits >>= 1) {
+            len = sizeof(*b) + nbits / 8;
+            if (cur + len <= max)
+                break;
+        }
+        if (nbits < IX_BLOOM_MINBITS)
+            return NULL;
+    } while (!__atomic_compare_exchange_n(&ix_bloom_bytes, &cur, cur + len, 0,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    if ((b = calloc(1, len)) == NULL) {
+        __atomic_sub_fetch(&ix_bloom_bytes, len, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    b->mask = nbits - 1;
+    return b;
+}
+
+static void ix_bloom_release(struct ix_bloom *b)
+{
+    __atomic_sub_fetch(&ix_bloom_bytes, sizeof(*b) + (b->mask + 1) / 8,
+                       __ATOMIC_RELAXED);
+    free(b);
+}
+
+static inline void ix_bloom_hash(bdb_state_type *bdb_state, int ixnum,
+                                 const void *key, int keylen, uint32_t *h1,
+                                 uint32_t *h2)
+{
+    /* dup and null-allowing indexes tack a genid onto the key */
+    if (keylen > bdb_state->ixlen[ixnum])
+        keylen = bdb_state->ixlen[ixnum];
+    *h1 = crc32c((const uint8_t *)key, keylen);
+    *h2 = ((*h1 >> 17) | (*h1 << 15)) * 0x9e3779b1U | 1;
+}
+
+static void ix_bloom_set(struct ix_bloom *b, uint32_t h1, uint32_t h2)
+{
+    for (int i = 0; i < IX_BLOOM_HASHES; ++i) {
+        uint64_t bit = (h1 + (uint64_t)i * h2) & b->mask;
+        __atomic_fetch_or(&b->bits[bit >> 6], 1ULL << (bit & 63),
+                          __ATOMIC_RELAXED);
+    }
+}
+
+/* Record a key added to index ixnum.  Called both before and after the put:
+ * before, so that a probe that misses the key can't have found it in the
+ * tree either, and after, so that a key put while a build was being
+ * published lands in the new filter.  Only the second call counts it. */
+void bdb_ixbloom_add(bdb_state_type *bdb_state, int ixnum, const void *key,
+                     int keylen, int count)
+{
+    struct ix_bloom *b;
+    uint32_t h1, h2;
+
+    if ((b = __atomic_load_n(&bdb_state->ix_bloom[ixnum], __ATOMIC_SEQ_CST)) ==
+        NULL)
+        return;
+    ix_bloom_hash(bdb_state, ixnum, key, keylen, &h1, &h2);
+    ix_bloom_set(b, h1, h2);
+    if (count)
+        __atomic_add_fetch(&b->nkeys, 1, __ATOMIC_RELAXED);
+}
+
+/* Returns 1 if key is definitely not in index ixnum, 0 if it may be. */
+int bdb_ixbloom_absent(bdb_state_type *bdb_state, int ixnum, const void *key,
+                       int keylen)
+{
+    struct ix_bloom *b;
+    uint32_t h1, h2;
+
+    if ((b = __atomic_load_n(&bdb_state->ix_bloom[ixnum], __ATOMIC_SEQ_CST)) ==
+            NULL ||
+        !__atomic_load_n(&b->ready, __ATOMIC_ACQUIRE))
+        return 0;
+    if (__atomic_load_n(&b->nkeys, __ATOMIC_RELAXED) > b->maxkeys ||
+        !bdb_amimaster(bdb_state) || bdb_get_rep_gen(bdb_state) != b->gen ||
+        memcmp(b->fileid, bdb_state->dbp_ix[ixnum]->fileid, DB_FILE_ID_LEN))
+        return 0;
+
+    ix_bloom_hash(bdb_state, ixnum, key, keylen, &h1, &h2);
+    for (int i = 0; i < IX_BLOOM_HASHES; ++i) {
+        uint64_t bit = (h1 + (uint64_t)i * h2) & b->mask;
+        if (!(__atomic_load_n(&b->bits[bit >> 6], __ATOMIC_RELAXED) &
+              (1ULL << (bit & 63))))
+            return 1;
+    }
+    return 0;
+}
+
+static int ix_bloom_usable(bdb_state_type *bdb_state, int ixnum, uint32_t gen)
+{
+    struct ix_bloom *b = bdb_state->ix_bloom[ixnum];
+    return b && b->ready && b->gen == gen && b->nkeys <= b->maxkeys &&
+           memcmp(b->fileid, bdb_state->dbp_ix[ixnum]->fileid,
+                  DB_FILE_ID_LEN) == 0;
+}
+
+/* The filter is still the one published for an index that hasn't changed
+ * hands since.  Called under the bdb lock. */
+static int ix_bloom_current(bdb_state_type *bdb_state, int ixnum,
+                            struct ix_bloom *b)
+{
+    return bdb_state->ix_bloom[ixnum] == b && bdb_state->dbp_ix[ixnum] &&
+           bdb_amimaster(bdb_state) && bdb_get_rep_gen(bdb_state) == b->gen &&
+           memcmp(b->fileid, bdb_state->dbp_ix[ixnum]->fileid,
+                  DB_FILE_ID_LEN) == 0;
+}
+
+/* Add IX_BLOOM_BATCH or so keys of the index to the filter, starting after
+ * the key in last (the first key if *lastlen is 0), and leave the last key
+ * added in last.  Returns DB_NOTFOUND at the end of the index. */
+static int ix_bloom_scan_batch(bdb_state_type *bdb_state, int ixnum,
+                               struct ix_bloom *b, DBT *v, uint8_t *last,
+                               uint32_t *lastlen, uint64_t *nscanned)
+{
+    DB *db = bdb_state->dbp_ix[ixnum];
+    uint8_t *kk = NULL, *vv;
+    uint32_t ks = 0, vs, h1, h2;
+    uint64_t n = 0;
+    DBC *dbc;
+    void *bulk;
+    int rc;
+
+    DBT k = {0};
+    k.data = last;
+    k.ulen = BDB_KEY_MAX + sizeof(unsigned long long);
+    k.flags = DB_DBT_USERMEM;
+
+    if ((rc = db->cursor(db, NULL, &dbc, 0)) != 0)
+        return rc;
+
+    if (*lastlen) {
+        /* back to where the last batch stopped */
+        DBT d = {0};
+        d.flags = DB_DBT_PARTIAL;
+        k.size = *lastlen;
+        rc = dbc->c_get(dbc, &k, &d, DB_SET_RANGE);
+        if (rc == 0 && (k.size != *lastlen || memcmp(k.data, last, k.size))) {
+            ix_bloom_hash(bdb_state, ixnum, k.data, k.size, &h1, &h2);
+            ix_bloom_set(b, h1, h2);
+            ++n;
+        }
+    }
+
+    while (rc == 0 && n < IX_BLOOM_BATCH &&
+           (rc = dbc->c_get(dbc, &k, v,
+                            (*lastlen || n ? DB_NEXT : DB_FIRST) |
+                                DB_MULTIPLE_KEY)) == 0) {
+        DB_MULTIPLE_INIT(bulk, v);
+        DB_MULTIPLE_KEY_NEXT(bulk, v, kk, ks, vv, vs);
+        while (bulk) {
+            ix_bloom_hash(bdb_state, ixnum, kk, ks, &h1, &h2);
+            ix_bloom_set(b, h1, h2);
+            ++n;
+            memcpy(last, kk, ks);
+            *lastlen = ks;
+            DB_MULTIPLE_KEY_NEXT(bulk, v, kk, ks, vv, vs);
+        }
+        (void)vv;
+        (void)vs;
+    }
+    dbc->c_close(dbc);
+    *nscanned += n;
+    return rc;
+}
+
+/* Scan the whole index into the filter, letting go of the bdb lock between
+ * batches, and mark it ready.  Returns EAGAIN if the index changed hands
+ * meanwhile; the filter may be gone then. */
+static int ix_bloom_scan(bdb_state_type *bdb_state, int ixnum,
+                         struct ix_bloom *b, uint64_t *nscanned)
+{
+    uint8_t last[BDB_KEY_MAX + sizeof(unsigned long long)];
+    uint32_t lastlen = 0;
+    int rc;
+
+    DBT v = {0};
+    v.data = malloc(128 * 1024);
+    v.ulen = 128 * 1024;
+    v.flags = DB_DBT_USERMEM;
+    if (v.data == NULL)
+        return ENOMEM;
+
+    do {
+        BDB_READLOCK("ixbloom_scan");
+        if (ix_bloom_current(bdb_state, ixnum, b))
+            rc = ix_bloom_scan_batch(bdb_state, ixnum, b, &v, last, &lastlen,
+                                     nscanned);
+        else
+            rc = EAGAIN;
+        if (rc == DB_NOTFOUND)
+            __atomic_store_n(&b->ready, 1, __ATOMIC_RELEASE);
+        BDB_RELLOCK();
+    } while (rc == 0);
+
+    free(v.data);
+    return rc == DB_NOTFOUND ? 0 : rc;
+}
+
+/* Build filters for the table's unique indexes that don't have a usable one.
+ * Only the master builds (and uses) them. */
+int bdb_ixbloom_build(bdb_state_type *bdb_state)
+{
+    int bits_per_key = bdb_state->attr->ix_bloom_bits;
+    uint32_t gen;
+    int rc = 0;
+
+    if (bits_per_key <= 0 || bdb_state->parent == NULL ||
+        !bdb_amimaster(bdb_state))
+        return 0;
+
+    for (int ixnum = 0; ixnum < bdb_state->numix; ++ixnum) {
+        struct ix_bloom *b, *old;
+        uint64_t est, maxkeys, nbits, nscanned = 0;
+        int entry;
+
+        BDB_READLOCK("ixbloom_build");
+        gen = bdb_get_rep_gen(bdb_state);
+        if (bdb_state->ixdups[ixnum] || bdb_state->dbp_ix[ixnum] == NULL ||
+            ix_bloom_usable(bdb_state, ixnum, gen)) {
+            BDB_RELLOCK();
+            continue;
+        }
+
+        /* size for twice the keys the file could hold, to leave room for
+         * inserts until the next analyze */
+        entry = bdb_state->ixlen[ixnum] + sizeof(unsigned long long) + 16;
+        est = bdb_index_size(bdb_state, ixnum) / entry;
+        maxkeys = 2 * est + 1024;
+        for (nbits = IX_BLOOM_MINBITS;
+             nbits < maxkeys * bits_per_key && nbits < IX_BLOOM_MAXBITS;
+             nbits <<= 1)
+            ;
+        if ((b = ix_bloom_alloc(bdb_state, nbits)) == NULL) {
+            BDB_RELLOCK();
+            logmsg(LOGMSG_WARN,
+                   "%s: no memory left for a bloom filter for %s ix %d\n",
+                   __func__, bdb_state->name, ixnum);
+            break;
+        }
+        nbits = b->mask + 1;
+        memcpy(b->fileid, bdb_state->dbp_ix[ixnum]->fileid, DB_FILE_ID_LEN);
+        b->gen = gen;
+        b->maxkeys = nbits / bits_per_key;
+        old = b->retired = bdb_state->ix_bloom[ixnum];
+
+        /* publish before scanning; ll_key_add fills in what the scan misses.
+         * Another analyze of the table may have got there first. */
+        if (!__atomic_compare_exchange_n(&bdb_state->ix_bloom[ixnum], &old, b,
+                                         0, __ATOMIC_SEQ_CST,
+                                         __ATOMIC_SEQ_CST)) {
+            BDB_RELLOCK();
+            ix_bloom_release(b);
+            continue;
+        }
+        BDB_RELLOCK();
+
+        if ((rc = ix_bloom_scan(bdb_state, ixnum, b, &nscanned)) != 0) {
+            logmsg(LOGMSG_WARN, "%s: scanning %s ix %d rc %d\n", __func__,
+                   bdb_state->name, ixnum, rc);
+            break;
+        }
+        logmsg(LOGMSG_INFO,
+               "%s: built %" PRIu64 " bit bloom filter for %s ix %d from "
+               "%" PRIu64 " keys\n",
+               __func__, nbits, bdb_state->name, ixnum, nscanned);
+    }
+
+    return rc;
+}
+
+void bdb_ixbloom_free(bdb_state_type *bdb_state)
+{
+    for (int ixnum = 0; ixnum < MAXINDEX; ++ixnum) {
+        struct ix_bloom *b = bdb_state->ix_bloom[ixnum];
+        while (b) {
+            struct ix_bloom *next = b->retired;
+            ix_bloom_release(b);
+            b = next;
+        }
+        bdb_state->ix_bloom[ixnum] = NULL;
+    }
+}
@@ -50,6 +50,26 @@
 #include "locks.h"
 #include <logmsg.h>
 
+/* An exact fetch of the lite table; non-transactional reads of llmeta are
+   answered from the llmeta cache when they can be */
+static int lite_exact_get(bdb_state_type *bdb_state, DB_TXN *tid, DBT *key,
+                          DBT *data)
+{
+    DB *dbp = bdb_state->dbp_data[0][0];
+    u_int64_t gen;
+    int rc, cache;
+
+    cache = bdb_llmeta_cache_gen(bdb_state, tid, key->size, &gen) == 0;
+    if (cache && bdb_llmeta_cache_get(key->data, gen, data, &rc))
+        return rc;
+
+    rc = dbp->get(dbp, tid, key, data, 0);
+
+    if (cache)
+        bdb_llmeta_cache_put(bdb_state, key->data, gen, data, rc);
+    return rc;
+}
+
 int bdb_lite_exact_fetch_int(bdb_state_type *bdb_state, tran_type *tran,
                              void *key, void *fnddta, int maxlen, int *fndlen,
                              int *bdberr)
@@ -77,8 +97,7 @@ int bdb_lite_exact_fetch_int(bdb_state_type *bdb_state, tran_type *tran,
     dbt_data.ulen = maxlen;
     dbt_data.flags |= DB_DBT_USERMEM;
 
-    rc = bdb_state->dbp_data[0][0]->get(bdb_state->dbp_data[0][0], tid,
-                                        &dbt_key, &dbt_data, 0);
+    rc = lite_exact_get(bdb_state, tid, &dbt_key, &dbt_data);
 
     if (rc == 0) {
         *fndlen = dbt_data.size;
@@ -144,8 +163,7 @@ int bdb_lite_exact_fetch_alloc_int(bdb_state_type *bdb_state, tran_type *tran,
     if (tran) {
         tid = tran->tid;
     }
-    rc = bdb_state->dbp_data[0][0]->get(bdb_state->dbp_data[0][0], tid,
-                                        &dbt_key, &dbt_data, 0);
+    rc = lite_exact_get(bdb_state, tid, &dbt_key, &dbt_data);
     if (rc == 0) {
         *fndlen = dbt_data.size;
         *fnddta = dbt_data.data;
@@ -198,8 +216,7 @@ static int bdb_lite_exact_var_fetch_int(bdb_state_type *bdb_state,
 
     dbt_data.flags = DB_DBT_MALLOC;
 
-    rc = bdb_state->dbp_data[0][0]->get(bdb_state->dbp_data[0][0], tid,
-                                        &dbt_key, &dbt_data, 0);
+    rc = lite_exact_get(bdb_state, tid, &dbt_key, &dbt_data);
 
     if (rc == 0) {
         *fndlen = dbt_data.size;
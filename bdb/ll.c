@@ -861,11 +861,13 @@ int ll_key_add(bdb_state_type *bdb_state, unsigned long long ingenid,
             }
         }
 
+        bdb_ixbloom_add(bdb_state, ixnum, dbt_key->data, dbt_key->size, 0);
         rc = bdb_state->dbp_ix[ixnum]->put(bdb_state->dbp_ix[ixnum], tran->tid,
                                            dbt_key, dbt_data, DB_NOOVERWRITE);
         if (rc) {
             return rc;
         }
+        bdb_ixbloom_add(bdb_state, ixnum, dbt_key->data, dbt_key->size, 1);
 
         if (!rc && add_snapisol_logging(bdb_state, tran)) {
             tran_type *parent = (tran->parent) ? tran->parent : tran;
@@ -17,6 +17,7 @@
 #include <string.h>
 #include <strings.h>
 #include <limits.h>
+#include <stddef.h>
 #include <alloca.h>
 #include <compile_time_assert.h>
 #include <flibc.h>
@@ -169,6 +170,11 @@ typedef enum {
     LLMETA_SC_START_LSN = 49,
     LLMETA_SCHEMACHANGE_STATUS = 50,
     LLMETA_VIEW = 51, /* User defined views */
+    LLMETA_ZSTD_DICT = 52, /* key = 52 + TABLENAME[32] + DICTID
+                              data = trained zstd dictionary; DICTID 0 holds
+                              the id of the table's current dictionary */
+    LLMETA_CDC_LSN = 53, /* key = 53 + CONSUMER[32]
+                            data = last commit lsn the consumer delivered */
 } llmetakey_t;
 
 struct llmeta_file_type_key {
@@ -9906,3 +9912,186 @@ int bdb_del_view(tran_type *t, const char *view_name)
     }
     return rc;
 }
+
+/* zstd dictionary key */
+struct llmeta_zstd_dict_key {
+    int file_type;
+    char table_name[LLMETA_TBLLEN];
+    unsigned int dictid;
+};
+
+/* Fetch a table's zstd dictionary; dictid 0 fetches the 4 byte id of the
+ * current one.  Returns 1 if there is no such dictionary. */
+int bdb_get_zstd_dict(tran_type *t, const char *table, unsigned int dictid,
+                      void **dict, int *len)
+{
+    union {
+        struct llmeta_zstd_dict_key key;
+        uint8_t buf[LLMETA_IXLEN];
+    } u = {{0}};
+    int rc, bdberr;
+
+    u.key.file_type = htonl(LLMETA_ZSTD_DICT);
+    strncpy0(u.key.table_name, table, sizeof(u.key.table_name));
+    u.key.dictid = htonl(dictid);
+
+    *dict = NULL;
+    *len = 0;
+    rc = bdb_lite_exact_var_fetch_tran(llmeta_bdb_state, t, &u, dict, len,
+                                       &bdberr);
+    if (rc && bdberr == BDBERR_FETCH_DTA)
+        return 1;
+    return rc;
+}
+
+/* Store a table's zstd dictionary and make it the current one */
+int bdb_put_zstd_dict(tran_type *t, const char *table, unsigned int dictid,
+                      void *dict, int len)
+{
+    union {
+        struct llmeta_zstd_dict_key key;
+        uint8_t buf[LLMETA_IXLEN];
+    } u = {{0}};
+    int rc, bdberr, started = 0;
+    unsigned int cur = htonl(dictid);
+
+    if (dictid == 0)
+        return -1;
+
+    if (t == NULL) {
+        t = bdb_tran_begin(llmeta_bdb_state, NULL, &bdberr);
+        if (t == NULL)
+            return -1;
+        started = 1;
+    }
+
+    u.key.file_type = htonl(LLMETA_ZSTD_DICT);
+    strncpy0(u.key.table_name, table, sizeof(u.key.table_name));
+    u.key.dictid = htonl(dictid);
+    rc = kv_put_int(t, &u, dict, len, &bdberr);
+
+    if (rc == 0) {
+        u.key.dictid = 0;
+        rc = kv_put_int(t, &u, &cur, sizeof(cur), &bdberr);
+    }
+
+    if (started) {
+        if (rc == 0)
+            rc = bdb_tran_commit(llmeta_bdb_state, t, &bdberr);
+        else
+            bdb_tran_abort(llmeta_bdb_state, t, &bdberr);
+    }
+    if (rc == 0) {
+        logmsg(LOGMSG_INFO, "zstd dictionary %u (%d bytes) saved for '%s'\n",
+               dictid, len, table);
+    }
+    return rc;
+}
+
+/* change data consumer checkpoint key */
+struct llmeta_cdc_lsn_key {
+    int file_type;
+    char name[LLMETA_TBLLEN];
+};
+
+/* The last commit a change data consumer has delivered.  Returns 1 if the
+ * consumer has never saved one. */
+int bdb_get_cdc_lsn(const char *name, unsigned int *file,
+                    unsigned int *offset)
+{
+    union {
+        struct llmeta_cdc_lsn_key key;
+        uint8_t buf[LLMETA_IXLEN];
+    } u = {{0}};
+    unsigned int lsn[2];
+    int rc, bdberr, fndlen;
+
+    u.key.file_type = htonl(LLMETA_CDC_LSN);
+    strncpy0(u.key.name, name, sizeof(u.key.name));
+    rc = bdb_lite_exact_fetch_tran(llmeta_bdb_state, NULL, &u, lsn,
+                                   sizeof(lsn), &fndlen, &bdberr);
+    if (rc && bdberr == BDBERR_FETCH_DTA)
+        return 1;
+    if (rc || fndlen != sizeof(lsn))
+        return -1;
+    *file = ntohl(lsn[0]);
+    *offset = ntohl(lsn[1]);
+    return 0;
+}
+
+int bdb_set_cdc_lsn(const char *name, unsigned int file, unsigned int offset)
+{
+    union {
+        struct llmeta_cdc_lsn_key key;
+        uint8_t buf[LLMETA_IXLEN];
+    } u = {{0}};
+    unsigned int lsn[2] = {htonl(file), htonl(offset)};
+    int bdberr;
+
+    u.key.file_type = htonl(LLMETA_CDC_LSN);
+    strncpy0(u.key.name, name, sizeof(u.key.name));
+    return kv_put(NULL, &u, lsn, sizeof(lsn), &bdberr);
+}
+
+/* List the ids of a table's zstd dictionaries, current or not */
+int bdb_get_zstd_dict_ids(tran_type *t, const char *table, unsigned int **ids,
+                          int *n)
+{
+    struct llmeta_zstd_dict_key k = {0};
+    void **keys = NULL;
+    int rc, bdberr, nkeys = 0;
+
+    k.file_type = htonl(LLMETA_ZSTD_DICT);
+    strncpy0(k.table_name, table, sizeof(k.table_name));
+
+    *ids = NULL;
+    *n = 0;
+    rc = kv_get_keys(t, &k, offsetof(struct llmeta_zstd_dict_key, dictid),
+                     &keys, &nkeys, &bdberr);
+    if (rc == 0 && nkeys > 0 && (*ids = malloc(nkeys * sizeof(**ids))) == NULL)
+        rc = ENOMEM;
+    for (int i = 0; i < nkeys; ++i) {
+        struct llmeta_zstd_dict_key *fnd = keys[i];
+        unsigned int id = ntohl(fnd->dictid);
+        if (rc == 0 && id != 0)
+            (*ids)[(*n)++] = id;
+        free(keys[i]);
+    }
+    free(keys);
+    return rc;
+}
+
+/* Delete some of a table's zstd dictionaries */
+int bdb_del_zstd_dicts(tran_type *t, const char *table, unsigned int *ids,
+                       int n)
+{
+    union {
+        struct llmeta_zstd_dict_key key;
+        uint8_t buf[LLMETA_IXLEN];
+    } u = {{0}};
+    int rc = 0, bdberr, started = 0;
+
+    if (t == NULL) {
+        t = bdb_tran_begin(llmeta_bdb_state, NULL, &bdberr);
+        if (t == NULL)
+            return -1;
+        started = 1;
+    }
+
+    u.key.file_type = htonl(LLMETA_ZSTD_DICT);
+    strncpy0(u.key.table_name, table, sizeof(u.key.table_name));
+    for (int i = 0; i < n && rc == 0; ++i) {
+        u.key.dictid = htonl(ids[i]);
+        rc = kv_del(t, &u, &bdberr);
+        if (rc && bdberr == BDBERR_DEL_DTA)
+            rc = 0;
+    }
+
+    if (started) {
+        if (rc == 0)
+            rc = bdb_tran_commit(llmeta_bdb_state, t, &bdberr);
+        else
+            bdb_tran_abort(llmeta_bdb_state, t, &bdberr);
+    }
+    return rc;
+}
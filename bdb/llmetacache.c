@@ -0,0 +1,216 @@
+/*
+   Copyright 2024 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/* Llmeta cache: what exact fetches of llmeta keys found, the record or that
+ * there was none, so table and file versions, schemas, sp versions and the
+ * like are looked up again without a descent of the llmeta btree or its page
+ * locks.
+ *
+ * As in the row cache, an entry is stamped with the dirty generation of the
+ * llmeta file, which moves for every page of it made dirty: by this node's
+ * transactions when they write llmeta, by their aborts, and by the log
+ * replayed from the master.  Any llmeta write drops every entry, which is
+ * cheap as llmeta is written by schema changes and little else.  A lookup is
+ * stamped with the generation read before the btree is, and only kept if the
+ * generation is still the same after.  Reads in a transaction, which can see
+ * its own writes, go to the btree. */
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <build/db.h>
+#include <logmsg.h>
+#include <list.h>
+#include <plhash.h>
+#include <locks_wrap.h>
+#include "bdb_int.h"
+
+int gbl_llmeta_cache_mb = 2;
+
+#define LLMETA_CACHE_SHARDS 16
+#define LLMETA_CACHE_KEYLEN 120 /* LLMETA_IXLEN */
+
+struct llmeta_cache_ent {
+    u_int8_t key[LLMETA_CACHE_KEYLEN];
+    u_int64_t dirty_gen;
+    int len; /* -1 for a key that isn't there */
+    LINKC_T(struct llmeta_cache_ent) lnk;
+    char dta[];
+};
+
+struct llmeta_cache_shard {
+    pthread_mutex_t lk;
+    hash_t *h;
+    LISTC_T(struct llmeta_cache_ent) lru; /* oldest first */
+    size_t bytes;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+static struct llmeta_cache_shard shards[LLMETA_CACHE_SHARDS];
+static pthread_once_t llmeta_cache_once = PTHREAD_ONCE_INIT;
+
+static void llmeta_cache_init(void)
+{
+    for (int i = 0; i < LLMETA_CACHE_SHARDS; i++) {
+        struct llmeta_cache_shard *s = &shards[i];
+        Pthread_mutex_init(&s->lk, NULL);
+        s->h = hash_init_o(offsetof(struct llmeta_cache_ent, key),
+                           LLMETA_CACHE_KEYLEN);
+        listc_init(&s->lru, offsetof(struct llmeta_cache_ent, lnk));
+    }
+}
+
+static struct llmeta_cache_shard *llmeta_cache_shard(const u_int8_t *key)
+{
+    uint32_t h = 2166136261U;
+    for (int i = 0; i < LLMETA_CACHE_KEYLEN; i++)
+        h = (h ^ key[i]) * 16777619U;
+    return &shards[h % LLMETA_CACHE_SHARDS];
+}
+
+static void llmeta_cache_remove(struct llmeta_cache_shard *s,
+                                struct llmeta_cache_ent *e)
+{
+    hash_del(s->h, e);
+    listc_rfl(&s->lru, e);
+    s->bytes -= sizeof(*e) + (e->len > 0 ? e->len : 0);
+    free(e);
+}
+
+int bdb_llmeta_cache_gen(bdb_state_type *bdb_state, DB_TXN *tid, int keylen,
+                         u_int64_t *gen)
+{
+    DB *dbp;
+
+    if (gbl_llmeta_cache_mb <= 0 || tid != NULL ||
+        keylen != LLMETA_CACHE_KEYLEN || bdb_state != bdb_llmeta_bdb_state())
+        return -1;
+    pthread_once(&llmeta_cache_once, llmeta_cache_init);
+    dbp = bdb_state->dbp_data[0][0];
+    return dbp->mpf->get_dirty_gen(dbp->mpf, gen);
+}
+
+int bdb_llmeta_cache_get(const void *key, u_int64_t gen, DBT *data, int *rc)
+{
+    struct llmeta_cache_shard *s;
+    struct llmeta_cache_ent *e;
+    int found = 0;
+
+    s = llmeta_cache_shard(key);
+
+    Pthread_mutex_lock(&s->lk);
+    if ((e = hash_find(s->h, key)) != NULL) {
+        if (e->dirty_gen != gen) {
+            llmeta_cache_remove(s, e);
+        } else if (e->len < 0) {
+            *rc = DB_NOTFOUND;
+            found = 1;
+        } else if (data->flags & DB_DBT_MALLOC) {
+            if ((data->data = malloc(e->len ? e->len : 1)) != NULL) {
+                memcpy(data->data, e->dta, e->len);
+                data->size = e->len;
+                *rc = 0;
+                found = 1;
+            }
+        } else if ((data->flags & DB_DBT_USERMEM) && e->len <= data->ulen) {
+            memcpy(data->data, e->dta, e->len);
+            data->size = e->len;
+            *rc = 0;
+            found = 1;
+        }
+        if (found) {
+            listc_rfl(&s->lru, e);
+            listc_abl(&s->lru, e);
+        }
+    }
+    if (found)
+        s->hits++;
+    else
+        s->misses++;
+    Pthread_mutex_unlock(&s->lk);
+
+    return found;
+}
+
+void bdb_llmeta_cache_put(bdb_state_type *bdb_state, const void *key,
+                          u_int64_t gen, const DBT *data, int rc)
+{
+    struct llmeta_cache_shard *s;
+    struct llmeta_cache_ent *e, *old;
+    size_t maxbytes =
+        (size_t)gbl_llmeta_cache_mb * 1024 * 1024 / LLMETA_CACHE_SHARDS;
+    DB *dbp = bdb_state->dbp_data[0][0];
+    int len = (rc == 0) ? data->size : 0;
+    u_int64_t now;
+
+    if (rc != 0 && rc != DB_NOTFOUND)
+        return;
+    if (sizeof(*e) + len > maxbytes / 16)
+        return;
+    /* a page changed under the read; what it found may be stale already */
+    if (dbp->mpf->get_dirty_gen(dbp->mpf, &now) || now != gen)
+        return;
+    if ((e = malloc(sizeof(*e) + len)) == NULL)
+        return;
+    memcpy(e->key, key, LLMETA_CACHE_KEYLEN);
+    e->dirty_gen = gen;
+    e->len = (rc == 0) ? len : -1;
+    if (len)
+        memcpy(e->dta, data->data, len);
+    s = llmeta_cache_shard(e->key);
+
+    Pthread_mutex_lock(&s->lk);
+    if ((old = hash_find(s->h, e->key)) != NULL)
+        llmeta_cache_remove(s, old);
+    hash_add(s->h, e);
+    listc_abl(&s->lru, e);
+    s->bytes += sizeof(*e) + len;
+    while (s->bytes > maxbytes && (old = s->lru.top) != NULL)
+        llmeta_cache_remove(s, old);
+    Pthread_mutex_unlock(&s->lk);
+}
+
+void bdb_llmeta_cache_report(void)
+{
+    uint64_t hits = 0, misses = 0;
+    size_t bytes = 0;
+    int nents = 0;
+
+    if (gbl_llmeta_cache_mb <= 0) {
+        logmsg(LOGMSG_USER, "llmeta cache is off (llmeta_cache_mb 0)\n");
+        return;
+    }
+    pthread_once(&llmeta_cache_once, llmeta_cache_init);
+    for (int i = 0; i < LLMETA_CACHE_SHARDS; i++) {
+        struct llmeta_cache_shard *s = &shards[i];
+        Pthread_mutex_lock(&s->lk);
+        hits += s->hits;
+        misses += s->misses;
+        bytes += s->bytes;
+        nents += s->lru.count;
+        Pthread_mutex_unlock(&s->lk);
+    }
+    logmsg(LOGMSG_USER,
+           "llmeta cache: %d keys, %zu bytes of %d MB, hits %" PRIu64
+           " misses %" PRIu64 " (%.1f%%)\n",
+           nents, bytes, gbl_llmeta_cache_mb, hits, misses,
+           hits + misses ? 100.0 * hits / (hits + misses) : 0.0);
+}
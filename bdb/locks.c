@@ -510,6 +510,15 @@ static int bdb_lock_table_int(DB_ENV *dbenv, const char *tblname, int lid,
         return BDBERR_BADARGS;
     }
 
+    /* a read lock paying no visit to berkdb while no writer is about; a
+     * writer first makes all of those real */
+    if (lockmode == DB_LOCK_READ &&
+        bdb_tablelock_fast_read(dbenv, lid, name) == 0)
+        return 0;
+    if (lockmode == DB_LOCK_WRITE &&
+        (rc = bdb_tablelock_fast_exclusive(dbenv, lid, name)) != 0)
+        return rc;
+
     rc = berkdb_lock(dbenv, lid, 0, &lk, lockmode, &dblk);
 
 #ifdef DEBUG_LOCKS
@@ -86,6 +86,17 @@ void bdb_checklock(bdb_state_type *bdb_state);
 int bdb_lock_table_read(bdb_state_type *, tran_type *);
 
 int bdb_lock_table_read_fromlid(bdb_state_type *, int lid);
+/* Table locks kept out of berkdb while there are only readers; see
+ * tablelocks.c */
+struct __db_env;
+int bdb_tablelock_fast_read(struct __db_env *dbenv, u_int32_t lid,
+                            const void *name);
+int bdb_tablelock_fast_exclusive(struct __db_env *dbenv, u_int32_t lid,
+                                 const void *name);
+int bdb_tablelock_fast_held(u_int32_t lid);
+void bdb_tablelock_fast_release(u_int32_t lid, int readonly);
+void bdb_tablelock_fast_inherit(u_int32_t child, u_int32_t parent);
+
 int berkdb_lock_random_rowlock(bdb_state_type *bdb_state, int lid, int flags,
                                void *lkname, int mode, void *lk);
 int berkdb_lock_rowlock(bdb_state_type *bdb_state, int lid, int flags,
@@ -52,10 +52,540 @@
 #define LZ4_compress_default LZ4_compress_limitedOutput
 #endif
 
-
 static void read_odh(const void *buf, struct odh *odh);
 static void write_odh(void *buf, const struct odh *odh, uint8_t flags);
 
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+
+/* A table's zstd dictionaries.  Every frame names the dictionary it was
+ * compressed with, so each dictionary we have loaded stays around for
+ * decompressing, while new records use the current one.  Dictionaries are
+ * trained by analyze on the master (bdb_zstd_train_dict) and kept in llmeta,
+ * where other nodes find them by id.  llmeta is only read with d->lk
+ * released. */
+struct zstd_dict {
+    unsigned id;
+    ZSTD_CDict *cdict; /* only built once the dictionary is current */
+    ZSTD_DDict *ddict;
+    struct zstd_dict *next;
+};
+
+struct zstd_dicts {
+    pthread_mutex_t lk;
+    int loaded;   /* looked up the current dictionary in llmeta */
+    uint32_t gen; /* in this generation; a new master looks it up again */
+    struct zstd_dict *cur;
+    struct zstd_dict *all;
+};
+
+static pthread_once_t zstd_once = PTHREAD_ONCE_INIT;
+static pthread_key_t zstd_cctx_key, zstd_dctx_key;
+static pthread_mutex_t zstd_dicts_lk = PTHREAD_MUTEX_INITIALIZER;
+
+static void zstd_free_cctx(void *p) { ZSTD_freeCCtx(p); }
+static void zstd_free_dctx(void *p) { ZSTD_freeDCtx(p); }
+
+static void zstd_init_keys(void)
+{
+    Pthread_key_create(&zstd_cctx_key, zstd_free_cctx);
+    Pthread_key_create(&zstd_dctx_key, zstd_free_dctx);
+}
+
+static ZSTD_CCtx *zstd_cctx(void)
+{
+    ZSTD_CCtx *c;
+    pthread_once(&zstd_once, zstd_init_keys);
+    if ((c = pthread_getspecific(zstd_cctx_key)) == NULL &&
+        (c = ZSTD_createCCtx()) != NULL)
+        Pthread_setspecific(zstd_cctx_key, c);
+    return c;
+}
+
+static ZSTD_DCtx *zstd_dctx(void)
+{
+    ZSTD_DCtx *c;
+    pthread_once(&zstd_once, zstd_init_keys);
+    if ((c = pthread_getspecific(zstd_dctx_key)) == NULL &&
+        (c = ZSTD_createDCtx()) != NULL)
+        Pthread_setspecific(zstd_dctx_key, c);
+    return c;
+}
+
+static struct zstd_dicts *zstd_get_dicts(bdb_state_type *bdb_state)
+{
+    struct zstd_dicts *d;
+    if ((d = bdb_state->zstd_dicts) != NULL)
+        return d;
+    Pthread_mutex_lock(&zstd_dicts_lk);
+    if ((d = bdb_state->zstd_dicts) == NULL &&
+        (d = calloc(1, sizeof(*d))) != NULL) {
+        Pthread_mutex_init(&d->lk, NULL);
+        bdb_state->zstd_dicts = d;
+    }
+    Pthread_mutex_unlock(&zstd_dicts_lk);
+    return d;
+}
+
+static void zstd_free_dict(struct zstd_dict *e)
+{
+    ZSTD_freeCDict(e->cdict);
+    ZSTD_freeDDict(e->ddict);
+    free(e);
+}
+
+/* Build an entry for dictionary id from its bytes; the CDict too if it is
+ * going to be the current one */
+static struct zstd_dict *zstd_new_dict(bdb_state_type *bdb_state, unsigned id,
+                                       void *buf, int len, int current)
+{
+    struct zstd_dict *e;
+
+    if ((e = calloc(1, sizeof(*e))) == NULL)
+        return NULL;
+    e->id = id;
+    if ((e->ddict = ZSTD_createDDict(buf, len)) == NULL ||
+        (current && (e->cdict = ZSTD_createCDict(
+                         buf, len, bdb_state->attr->zstd_level)) == NULL)) {
+        zstd_free_dict(e);
+        return NULL;
+    }
+    return e;
+}
+
+static struct zstd_dict *zstd_lookup_ll(struct zstd_dicts *d, unsigned id)
+{
+    struct zstd_dict *e;
+    for (e = d->all; e; e = e->next)
+        if (e->id == id)
+            return e;
+    return NULL;
+}
+
+/* Add entry n, unless another thread got there first, in which case keep
+ * theirs.  Called with d->lk held; returns the entry to use. */
+static struct zstd_dict *zstd_add_ll(struct zstd_dicts *d,
+                                     struct zstd_dict *n)
+{
+    struct zstd_dict *e;
+
+    if ((e = zstd_lookup_ll(d, n->id)) == NULL) {
+        n->next = d->all;
+        d->all = n;
+        return n;
+    }
+    if (e->cdict == NULL) {
+        e->cdict = n->cdict;
+        n->cdict = NULL;
+    }
+    zstd_free_dict(n);
+    return e;
+}
+
+/* Find dictionary id, loading it from llmeta if we haven't seen it */
+static struct zstd_dict *zstd_find_dict(bdb_state_type *bdb_state,
+                                        struct zstd_dicts *d, unsigned id)
+{
+    struct zstd_dict *e;
+    void *buf;
+    int len;
+
+    Pthread_mutex_lock(&d->lk);
+    e = zstd_lookup_ll(d, id);
+    Pthread_mutex_unlock(&d->lk);
+    if (e)
+        return e;
+
+    if (bdb_get_zstd_dict(NULL, bdb_state->name, id, &buf, &len)) {
+        logmsg(LOGMSG_ERROR, "%s: no zstd dictionary %u for %s\n", __func__,
+               id, bdb_state->name);
+        return NULL;
+    }
+    e = zstd_new_dict(bdb_state, id, buf, len, 0);
+    free(buf);
+    if (e == NULL)
+        return NULL;
+
+    Pthread_mutex_lock(&d->lk);
+    e = zstd_add_ll(d, e);
+    Pthread_mutex_unlock(&d->lk);
+    return e;
+}
+
+/* Make dictionary id, whose bytes are in buf, the one new records are
+ * compressed with */
+static void zstd_set_current(bdb_state_type *bdb_state, struct zstd_dicts *d,
+                             unsigned id, void *buf, int len, uint32_t gen)
+{
+    struct zstd_dict *e = zstd_new_dict(bdb_state, id, buf, len, 1);
+
+    Pthread_mutex_lock(&d->lk);
+    if (e && (e = zstd_add_ll(d, e))->cdict)
+        d->cur = e;
+    d->gen = gen;
+    d->loaded = 1;
+    Pthread_mutex_unlock(&d->lk);
+}
+
+static struct zstd_dict *zstd_current(bdb_state_type *bdb_state)
+{
+    struct zstd_dicts *d;
+    void *buf = NULL, *dict = NULL;
+    int len, dlen;
+    unsigned id = 0;
+    uint32_t gen;
+
+    if ((d = zstd_get_dicts(bdb_state)) == NULL)
+        return NULL;
+    gen = bdb_get_rep_gen(bdb_state);
+    if (d->loaded && d->gen == gen)
+        return d->cur;
+
+    if (bdb_get_zstd_dict(NULL, bdb_state->name, 0, &buf, &len) == 0) {
+        if (len == sizeof(id)) {
+            memcpy(&id, buf, sizeof(id));
+            id = ntohl(id);
+        }
+        free(buf);
+    }
+    if (id && bdb_get_zstd_dict(NULL, bdb_state->name, id, &dict, &dlen)) {
+        dict = NULL;
+        id = 0;
+    }
+
+    if (id) {
+        zstd_set_current(bdb_state, d, id, dict, dlen, gen);
+    } else {
+        Pthread_mutex_lock(&d->lk);
+        d->gen = gen;
+        d->loaded = 1;
+        Pthread_mutex_unlock(&d->lk);
+    }
+    free(dict);
+    return d->cur;
+}
+
+static int zstd_compress(bdb_state_type *bdb_state, const void *in,
+                         size_t inlen, void *out, size_t outlen)
+{
+    ZSTD_CCtx *cctx;
+    struct zstd_dict *cur;
+    size_t rc;
+
+    if ((cctx = zstd_cctx()) == NULL)
+        return 0;
+    if ((cur = zstd_current(bdb_state)) != NULL)
+        rc = ZSTD_compress_usingCDict(cctx, out, outlen, in, inlen,
+                                      cur->cdict);
+    else
+        rc = ZSTD_compressCCtx(cctx, out, outlen, in, inlen,
+                               bdb_state->attr->zstd_level);
+    return ZSTD_isError(rc) ? 0 : (int)rc;
+}
+
+static int zstd_decompress(bdb_state_type *bdb_state, const void *in,
+                           size_t inlen, void *out, size_t outlen)
+{
+    ZSTD_DCtx *dctx;
+    struct zstd_dicts *d;
+    struct zstd_dict *e = NULL;
+    unsigned id;
+    size_t rc;
+
+    if ((dctx = zstd_dctx()) == NULL)
+        return -1;
+    if ((id = ZSTD_getDictID_fromFrame(in, inlen)) != 0) {
+        if ((d = zstd_get_dicts(bdb_state)) == NULL)
+            return -1;
+        if ((e = zstd_find_dict(bdb_state, d, id)) == NULL)
+            return -1;
+        rc = ZSTD_decompress_usingDDict(dctx, out, outlen, in, inlen,
+                                        e->ddict);
+    } else {
+        rc = ZSTD_decompressDCtx(dctx, out, outlen, in, inlen);
+    }
+    return ZSTD_isError(rc) ? -1 : (int)rc;
+}
+
+void bdb_zstd_free(bdb_state_type *bdb_state)
+{
+    struct zstd_dicts *d = bdb_state->zstd_dicts;
+    struct zstd_dict *e;
+
+    if (d == NULL)
+        return;
+    while ((e = d->all) != NULL) {
+        d->all = e->next;
+        zstd_free_dict(e);
+    }
+    Pthread_mutex_destroy(&d->lk);
+    free(d);
+    bdb_state->zstd_dicts = NULL;
+}
+
+static unsigned zstd_current_id(bdb_state_type *bdb_state)
+{
+    unsigned id = 0;
+    void *buf;
+    int len;
+
+    if (bdb_get_zstd_dict(NULL, bdb_state->name, 0, &buf, &len) == 0) {
+        if (len == sizeof(id)) {
+            memcpy(&id, buf, sizeof(id));
+            id = ntohl(id);
+        }
+        free(buf);
+    }
+    return id;
+}
+
+/* Mark which of the dictionaries in ids[] some record or blob of the table
+ * was compressed with.  Only the start of each record is read, as far as the
+ * frame header. */
+static int zstd_mark_referenced(bdb_state_type *bdb_state, unsigned *ids,
+                                char *refd, int n)
+{
+    int nrefd = 0;
+
+    for (int dtanum = 0; dtanum < bdb_state->numdtafiles && nrefd < n;
+         dtanum++) {
+        int nstripes = bdb_get_datafile_num_files(bdb_state, dtanum);
+        for (int stripe = 0; stripe < nstripes && nrefd < n; stripe++) {
+            DB *dbp = bdb_state->dbp_data[dtanum][stripe];
+            uint8_t hdr[ODH_SIZE + 32];
+            DBT key = {0}, data = {0};
+            DBC *dbcp;
+            int rc;
+
+            if (dbp == NULL || dbp->cursor(dbp, NULL, &dbcp, 0) != 0)
+                return -1;
+            key.flags = DB_DBT_REALLOC;
+            data.flags = DB_DBT_USERMEM | DB_DBT_PARTIAL;
+            data.data = hdr;
+            data.ulen = data.dlen = sizeof(hdr);
+            while (nrefd < n &&
+                   (rc = dbcp->c_get(dbcp, &key, &data, DB_NEXT)) == 0) {
+                struct odh odh;
+                unsigned id;
+                if (data.size <= ODH_SIZE)
+                    continue;
+                read_odh(data.data, &odh);
+                if ((odh.flags & ODH_FLAG_COMPR_MASK) != BDB_COMPRESS_ZSTD ||
+                    (id = ZSTD_getDictID_fromFrame(hdr + ODH_SIZE,
+                                                   data.size - ODH_SIZE)) == 0)
+                    continue;
+                for (int i = 0; i < n; i++) {
+                    if (ids[i] == id && !refd[i]) {
+                        refd[i] = 1;
+                        nrefd++;
+                    }
+                }
+            }
+            dbcp->c_close(dbcp);
+            free(key.data);
+            if (rc != 0 && rc != DB_NOTFOUND)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+/* Once a table has zstd_dict_max dictionaries, drop the ones no record uses
+ * any more.  The current one always stays: it is the only one new records
+ * are compressed with, and it stays current until this returns.  Returns how
+ * many are left, or -1 if we couldn't tell. */
+static int zstd_prune_dicts(bdb_state_type *bdb_state)
+{
+    unsigned *ids, *drop, cur;
+    char *refd;
+    int n, ndrop = 0, rc;
+
+    if (bdb_get_zstd_dict_ids(NULL, bdb_state->name, &ids, &n))
+        return -1;
+    if (n < bdb_state->attr->zstd_dict_max) {
+        free(ids);
+        return n;
+    }
+
+    cur = zstd_current_id(bdb_state);
+    refd = calloc(n, 1);
+    drop = malloc(n * sizeof(*drop));
+    if (refd == NULL || drop == NULL) {
+        n = -1;
+        goto done;
+    }
+
+    BDB_READLOCK("zstd_prune_dicts");
+    rc = zstd_mark_referenced(bdb_state, ids, refd, n);
+    BDB_RELLOCK();
+    if (rc) {
+        logmsg(LOGMSG_ERROR, "%s: couldn't scan %s\n", __func__,
+               bdb_state->name);
+        n = -1;
+        goto done;
+    }
+
+    for (int i = 0; i < n; i++)
+        if (!refd[i] && ids[i] != cur)
+            drop[ndrop++] = ids[i];
+    if (ndrop == 0)
+        goto done;
+    if ((rc = bdb_del_zstd_dicts(NULL, bdb_state->name, drop, ndrop)) != 0) {
+        logmsg(LOGMSG_ERROR, "%s: deleting dictionaries of %s rc %d\n",
+               __func__, bdb_state->name, rc);
+        n = -1;
+        goto done;
+    }
+    logmsg(LOGMSG_INFO, "%s: dropped %d unused zstd dictionaries of %s\n",
+           __func__, ndrop, bdb_state->name);
+    n -= ndrop;
+
+done:
+    free(drop);
+    free(refd);
+    free(ids);
+    return n;
+}
+
+/* Train a zstd dictionary from a sample of the table's records, save it in
+ * llmeta and start compressing new records with it.  Only the master trains,
+ * as only it can write llmeta; replicants pick the dictionary up from there.
+ * Returns 0 if there was nothing to do. */
+int bdb_zstd_train_dict(bdb_state_type *bdb_state)
+{
+    int nstripes, stripe, rc = 0, n = 0, alloc = 0, ndicts;
+    size_t budget, used = 0, dsz;
+    size_t *sizes = NULL;
+    char *samples = NULL, *dict = NULL;
+    struct zstd_dicts *d;
+    unsigned id;
+
+    if (!bdb_state->ondisk_header || bdb_state->attr->zstd_dict_size <= 0 ||
+        (bdb_state->compress != BDB_COMPRESS_ZSTD &&
+         bdb_state->compress_blobs != BDB_COMPRESS_ZSTD) ||
+        !bdb_amimaster(bdb_state))
+        return 0;
+
+    if ((ndicts = zstd_prune_dicts(bdb_state)) < 0)
+        return -1;
+    if (ndicts >= bdb_state->attr->zstd_dict_max) {
+        logmsg(LOGMSG_WARN, "%s: %s has %d zstd dictionaries in use, not "
+                            "training another\n",
+               __func__, bdb_state->name, ndicts);
+        return 0;
+    }
+
+    budget = bdb_state->attr->zstd_dict_sample;
+    if ((samples = malloc(budget)) == NULL)
+        return ENOMEM;
+    nstripes = bdb_state->attr->dtastripe > 0 ? bdb_state->attr->dtastripe : 1;
+
+    BDB_READLOCK("zstd_train_dict");
+    for (stripe = 0; stripe < nstripes; stripe++) {
+        DB *dbp = bdb_state->dbp_data[0][stripe];
+        size_t stripe_max = budget / nstripes * (stripe + 1);
+        DBT key = {0}, data = {0};
+        DBC *dbcp;
+
+        if (dbp == NULL || dbp->cursor(dbp, NULL, &dbcp, 0) != 0)
+            continue;
+        key.flags = data.flags = DB_DBT_REALLOC;
+        while (used < stripe_max &&
+               dbcp->c_get(dbcp, &key, &data, DB_NEXT) == 0) {
+            struct odh odh;
+            void *freeptr = NULL;
+            if (bdb_unpack(bdb_state, data.data, data.size, NULL, 0, &odh,
+                           &freeptr) != 0)
+                continue;
+            if (odh.length > 0 && used + odh.length <= budget) {
+                if (n == alloc) {
+                    alloc = alloc ? alloc * 2 : 1024;
+                    sizes = realloc(sizes, alloc * sizeof(size_t));
+                }
+                memcpy(samples + used, odh.recptr, odh.length);
+                sizes[n++] = odh.length;
+                used += odh.length;
+            }
+            free(freeptr);
+        }
+        dbcp->c_close(dbcp);
+        free(key.data);
+        free(data.data);
+    }
+    BDB_RELLOCK();
+
+    /* zdict needs a handful of samples to find anything */
+    if (n < 16) {
+        logmsg(LOGMSG_INFO, "%s: only %d records in %s, not training\n",
+               __func__, n, bdb_state->name);
+        goto done;
+    }
+
+    if ((dict = malloc(bdb_state->attr->zstd_dict_size)) == NULL) {
+        rc = ENOMEM;
+        goto done;
+    }
+    dsz = ZDICT_trainFromBuffer(dict, bdb_state->attr->zstd_dict_size,
+                                samples, sizes, n);
+    if (ZDICT_isError(dsz)) {
+        logmsg(LOGMSG_WARN, "%s: training %s from %d records: %s\n",
+               __func__, bdb_state->name, n, ZDICT_getErrorName(dsz));
+        goto done;
+    }
+    if ((id = ZDICT_getDictID(dict, dsz)) == 0)
+        goto done;
+
+    if ((rc = bdb_put_zstd_dict(NULL, bdb_state->name, id, dict, dsz)) != 0) {
+        logmsg(LOGMSG_ERROR, "%s: saving dictionary for %s rc %d\n",
+               __func__, bdb_state->name, rc);
+        goto done;
+    }
+
+    if ((d = zstd_get_dicts(bdb_state)) != NULL)
+        zstd_set_current(bdb_state, d, id, dict, dsz,
+                         bdb_get_rep_gen(bdb_state));
+    logmsg(LOGMSG_INFO, "%s: trained zstd dictionary %u for %s from %d "
+                        "records (%zu bytes)\n",
+           __func__, id, bdb_state->name, n, used);
+
+done:
+    free(dict);
+    free(sizes);
+    free(samples);
+    return rc;
+}
+
+/* List a table's zstd dictionaries */
+void bdb_zstd_dict_report(bdb_state_type *bdb_state)
+{
+    unsigned *ids, cur;
+    int n;
+
+    if (bdb_get_zstd_dict_ids(NULL, bdb_state->name, &ids, &n)) {
+        logmsg(LOGMSG_ERROR, "couldn't list zstd dictionaries of %s\n",
+               bdb_state->name);
+        return;
+    }
+    cur = zstd_current_id(bdb_state);
+    logmsg(LOGMSG_USER, "%s: %d zstd dictionaries\n", bdb_state->name, n);
+    for (int i = 0; i < n; i++)
+        logmsg(LOGMSG_USER, "  dictionary %u%s\n", ids[i],
+               ids[i] == cur ? " (current)" : "");
+    free(ids);
+}
+#else
+void bdb_zstd_free(bdb_state_type *bdb_state) {}
+
+int bdb_zstd_train_dict(bdb_state_type *bdb_state) { return 0; }
+
+void bdb_zstd_dict_report(bdb_state_type *bdb_state)
+{
+    logmsg(LOGMSG_USER, "not built with zstd\n");
+}
+#endif
+
+
 /*
  * Map of the 7-byte on disk header:
  *
@@ -151,6 +681,8 @@ const char *bdb_algo2compr(int alg)
         return "crle";
     case BDB_COMPRESS_LZ4:
         return "lz4 ";
+    case BDB_COMPRESS_ZSTD:
+        return "zstd";
     default:
         return "????";
     }
@@ -166,6 +698,10 @@ int bdb_compr2algo(const char *a)
         return BDB_COMPRESS_CRLE;
     if (strncasecmp(a, "lz4", 3) == 0)
         return BDB_COMPRESS_LZ4;
+#ifdef WITH_ZSTD
+    if (strcasecmp(a, "zstd") == 0)
+        return BDB_COMPRESS_ZSTD;
+#endif
     return BDB_COMPRESS_NONE;
 }
 
@@ -416,6 +952,23 @@ int bdb_pack(bdb_state_type *bdb_state, const struct odh *odh, void *to,
                 *recsize = rc + ODH_SIZE;
             }
             break;
+
+#ifdef WITH_ZSTD
+        case BDB_COMPRESS_ZSTD:
+            if ((rc = zstd_compress(bdb_state, odh->recptr, odh->length,
+                                    (char *)to + ODH_SIZE,
+                                    odh->length - 1)) == 0) {
+                alg = BDB_COMPRESS_NONE;
+            } else {
+                *recsize = rc + ODH_SIZE;
+            }
+            break;
+#endif
+
+        default:
+            /* an algorithm this build can't produce */
+            alg = BDB_COMPRESS_NONE;
+            break;
         }
 
         if (alg == BDB_COMPRESS_NONE) {
@@ -596,6 +1149,21 @@ static int bdb_unpack_updateid(bdb_state_type *bdb_state, const void *from,
                 if (rc != odh->length) {
                     goto err;
                 }
+#ifdef WITH_ZSTD
+            } else if (alg == BDB_COMPRESS_ZSTD) {
+                rc = zstd_decompress(bdb_state, (char *)from + ODH_SIZE,
+                                     fromlen - ODH_SIZE, to, odh->length);
+                if (rc != odh->length) {
+                    logmsg(LOGMSG_ERROR,
+                           "%s:ERROR zstd decompress rc %d expected %u\n",
+                           __func__, rc, (unsigned)odh->length);
+                    goto err;
+                }
+#endif
+            } else {
+                logmsg(LOGMSG_ERROR, "%s:ERROR unknown compression %d\n",
+                       __func__, alg);
+                goto err;
             }
 
             /* Successfully decompressed */
@@ -1338,6 +1906,17 @@ inline void bdb_set_datacopy_odh(bdb_state_type *bdb_state, int cdc)
     bdb_state->datacopy_odh = cdc;
 }
 
+/* The payload of index ixnum holds dtalen bytes of chosen columns rather than
+ * the whole record, so it can't be handed out as the dta. */
+void bdb_set_partial_datacopy(bdb_state_type *bdb_state, int ixnum, int dtalen)
+{
+    if (bdb_state == NULL) {
+        logmsg(LOGMSG_ERROR, "%s(NULL)!!\n", __func__);
+        return;
+    }
+    bdb_state->ixdtalen[ixnum] = dtalen;
+}
+
 int bdb_validate_compression_alg(int alg)
 {
     switch (alg) {
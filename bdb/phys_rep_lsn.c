@@ -10,11 +10,227 @@
 #include <cdb2api.h>
 #include <parse_lsn.h>
 #include "locks.h"
+#include <locks_wrap.h>
 
 int matchable_log_type(int rectype);
 
 extern int gbl_verbose_physrep;
 
+/* Sparse index of the timestamps of the matchable (commit and checkpoint)
+ * records of each log file that rolls while we run.  A segment covers up to
+ * LOG_INDEX_SEG matchable records of one file and keeps the oldest and newest
+ * timestamp among them, so a search back through the log for a time can skip
+ * every segment whose records are all newer. */
+int gbl_log_index = 1;
+
+#define LOG_INDEX_SEG 1000
+
+struct log_index_seg {
+    DB_LSN start; /* first matchable record */
+    u_int64_t min_ts;
+    u_int64_t max_ts;
+};
+
+static pthread_mutex_t log_index_lk = PTHREAD_MUTEX_INITIALIZER;
+static struct log_index_seg *log_index;
+static int log_index_n;
+static DB_LSN log_index_pos;  /* last record read */
+static DB_LSN log_index_tail; /* first record not indexed */
+static int log_index_gen;     /* bumped when the log is truncated */
+
+static int log_index_grow(struct log_index_seg **segs, int n, int *alloc)
+{
+    struct log_index_seg *p;
+
+    if (n < *alloc)
+        return 0;
+    if ((p = realloc(*segs, (*alloc * 2 + 16) * sizeof(*p))) == NULL)
+        return -1;
+    *segs = p;
+    *alloc = *alloc * 2 + 16;
+    return 0;
+}
+
+/* Index the log files that have rolled since the last call, and forget the
+ * ones that have been deleted. */
+void bdb_log_index_update(bdb_state_type *bdb_state)
+{
+    struct log_index_seg *segs = NULL, *seg = NULL;
+    int n = 0, alloc = 0, cnt = 0, gen, rc;
+    DB_LSN lsn, first, last, tail = {0};
+    u_int32_t rectype;
+    u_int64_t ts;
+    DB_LOGC *logc;
+    DBT logrec;
+
+    if (!gbl_log_index)
+        return;
+    Pthread_mutex_lock(&log_index_lk);
+    lsn = log_index_pos;
+    gen = log_index_gen;
+    Pthread_mutex_unlock(&log_index_lk);
+    if (bdb_state->dbenv->log_cursor(bdb_state->dbenv, &logc, 0))
+        return;
+    bzero(&logrec, sizeof(DBT));
+    logrec.flags = DB_DBT_REALLOC;
+
+    if (logc->get(logc, &last, &logrec, DB_LAST) ||
+        logc->get(logc, &first, &logrec, DB_FIRST))
+        goto done;
+
+    if (lsn.file == 0) {
+        /* start with the file being written now */
+        Pthread_mutex_lock(&log_index_lk);
+        if (gen == log_index_gen)
+            log_index_pos = last;
+        Pthread_mutex_unlock(&log_index_lk);
+        goto done;
+    }
+    if (lsn.file == last.file)
+        goto done;
+    if (log_compare(&lsn, &first) < 0) {
+        /* what we read last was deleted; carry on from the oldest file */
+        lsn = first;
+        rc = logc->get(logc, &lsn, &logrec, DB_SET);
+    } else if ((rc = logc->get(logc, &lsn, &logrec, DB_SET)) == 0) {
+        rc = logc->get(logc, &lsn, &logrec, DB_NEXT);
+    }
+
+    for (; rc == 0; rc = logc->get(logc, &lsn, &logrec, DB_NEXT)) {
+        if (lsn.file >= last.file) {
+            tail = lsn;
+            break;
+        }
+        LOGCOPY_32(&rectype, logrec.data);
+        if (!matchable_log_type(rectype))
+            continue;
+        ts = get_timestamp_from_matchable_record(logrec.data);
+        if (seg == NULL || cnt == LOG_INDEX_SEG ||
+            seg->start.file != lsn.file) {
+            if (log_index_grow(&segs, n, &alloc))
+                goto done;
+            seg = &segs[n++];
+            seg->start = lsn;
+            seg->min_ts = seg->max_ts = ts;
+            cnt = 0;
+        }
+        if (ts < seg->min_ts)
+            seg->min_ts = ts;
+        if (ts > seg->max_ts)
+            seg->max_ts = ts;
+        cnt++;
+    }
+    if (tail.file == 0)
+        /* didn't get to the end; we'll read these again next time */
+        goto done;
+
+    /* resume from the last record of the file before the one being written */
+    lsn = tail;
+    if (logc->get(logc, &lsn, &logrec, DB_PREV))
+        goto done;
+
+    Pthread_mutex_lock(&log_index_lk);
+    if (gen != log_index_gen) {
+        /* the log was truncated under us */
+        Pthread_mutex_unlock(&log_index_lk);
+        goto done;
+    }
+    int gone = 0;
+    while (gone < log_index_n && log_index[gone].start.file < first.file)
+        gone++;
+    log_index_n -= gone;
+    memmove(log_index, log_index + gone, log_index_n * sizeof(*log_index));
+    if (n) {
+        struct log_index_seg *p =
+            realloc(log_index, (log_index_n + n) * sizeof(*p));
+        if (p) {
+            log_index = p;
+            memcpy(log_index + log_index_n, segs, n * sizeof(*segs));
+            log_index_n += n;
+        } else {
+            /* drop what we have rather than leave a hole */
+            log_index_n = 0;
+        }
+    }
+    log_index_tail = tail;
+    log_index_pos = lsn;
+    Pthread_mutex_unlock(&log_index_lk);
+
+done:
+    free(segs);
+    if (logrec.data)
+        free(logrec.data);
+    logc->close(logc, 0);
+}
+
+/* The log now ends before next.  Segments going past it keep their timestamps,
+ * which only makes them less likely to be skipped. */
+void bdb_log_index_truncate(DB_LSN *next)
+{
+    Pthread_mutex_lock(&log_index_lk);
+    while (log_index_n > 0 &&
+           log_compare(&log_index[log_index_n - 1].start, next) >= 0)
+        log_index_n--;
+    if (log_index_n == 0) {
+        bzero(&log_index_pos, sizeof(log_index_pos));
+    } else {
+        if (log_compare(&log_index_tail, next) > 0)
+            log_index_tail = *next;
+        if (log_compare(&log_index_pos, next) >= 0)
+            log_index_pos = log_index[log_index_n - 1].start;
+    }
+    log_index_gen++;
+    Pthread_mutex_unlock(&log_index_lk);
+}
+
+/* If the index rules out every record from some point to its end for a search
+ * for the last record at or before time, set seek to that point and tail to
+ * where the unindexed part of the log starts. */
+static int log_index_find(u_int64_t time, DB_LSN *seek, DB_LSN *tail)
+{
+    int i, found = 0;
+
+    Pthread_mutex_lock(&log_index_lk);
+    for (i = log_index_n - 1; i >= 0; i--) {
+        if (log_index[i].min_ts <= time)
+            break;
+    }
+    if (i + 1 < log_index_n) {
+        *seek = log_index[i + 1].start;
+        *tail = log_index_tail;
+        found = 1;
+    }
+    Pthread_mutex_unlock(&log_index_lk);
+    return found;
+}
+
+void bdb_log_index_dump(void)
+{
+    int i, nsegs;
+
+    Pthread_mutex_lock(&log_index_lk);
+    if (log_index_n == 0)
+        logmsg(LOGMSG_USER, "log index is empty%s\n",
+               gbl_log_index ? "" : " (log_index off)");
+    for (i = 0; i < log_index_n; i += nsegs) {
+        u_int64_t min_ts = log_index[i].min_ts, max_ts = log_index[i].max_ts;
+        for (nsegs = 1; i + nsegs < log_index_n &&
+                        log_index[i + nsegs].start.file == log_index[i].start.file;
+             nsegs++) {
+            if (log_index[i + nsegs].min_ts < min_ts)
+                min_ts = log_index[i + nsegs].min_ts;
+            if (log_index[i + nsegs].max_ts > max_ts)
+                max_ts = log_index[i + nsegs].max_ts;
+        }
+        logmsg(LOGMSG_USER,
+               "log.%010u: %d segments from {%u:%u}, timestamps %" PRIu64
+               " to %" PRIu64 "\n",
+               log_index[i].start.file, nsegs, log_index[i].start.file,
+               log_index[i].start.offset, min_ts, max_ts);
+    }
+    Pthread_mutex_unlock(&log_index_lk);
+}
+
 LOG_INFO get_last_lsn(bdb_state_type *bdb_state)
 {
     int rc;
@@ -80,6 +296,8 @@ int find_log_timestamp(bdb_state_type *bdb_state, time_t time,
     DBT logrec;
     DB_LSN rec_lsn;
     u_int32_t rectype;
+    DB_LSN seek, tail;
+    int seeking;
 
     /* get last record then iterate */
     rc = bdb_state->dbenv->log_cursor(bdb_state->dbenv, &logc, 0);
@@ -91,9 +309,18 @@ int find_log_timestamp(bdb_state_type *bdb_state, time_t time,
     bzero(&logrec, sizeof(DBT));
     logrec.flags = DB_DBT_REALLOC;
 
+    seeking = log_index_find(time, &seek, &tail);
+
     do {
         do {
             rc = logc->get(logc, &rec_lsn, &logrec, DB_PREV);
+            if (rc == 0 && seeking && log_compare(&rec_lsn, &tail) < 0) {
+                /* nothing in the unindexed tail; skip to where the index
+                 * says the records stop being too new */
+                seeking = 0;
+                rec_lsn = seek;
+                rc = logc->get(logc, &rec_lsn, &logrec, DB_SET);
+            }
             if (rc) {
                 logmsg(LOGMSG_ERROR, "%s: can't get log record rc %d\n",
                        __func__, rc);
@@ -23,5 +23,7 @@ int truncate_log_lock(struct bdb_state_tag *, unsigned int file,
                       unsigned int offset, uint32_t flags);
 int find_log_timestamp(struct bdb_state_tag *, time_t time, unsigned int *file,
                        unsigned int *offset);
+void bdb_log_index_update(struct bdb_state_tag *);
+void bdb_log_index_dump(void);
 
 #endif
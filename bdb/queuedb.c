@@ -49,7 +49,17 @@ struct queuedb_key {
 
 enum { QUEUEDB_KEY_LEN = 4 + 8 };
 
+/* Items stored once for every consumer use this in place of a consumer
+ * number, and each consumer's place in them is kept under QUEUEDB_CURSOR.
+ * Both sort after the per-consumer items. */
+#define QUEUEDB_SHARED MAXCONSUMERS
+#define QUEUEDB_CURSOR (MAXCONSUMERS + 1)
+
+/* A shared item ends with the mask of the consumers it is for */
+enum { QUEUEDB_MASK_LEN = 4 };
+
 int gbl_debug_queuedb = 0;
+int gbl_queuedb_shared_min_consumers = 0;
 
 static uint8_t *queuedb_key_get(struct queuedb_key *p_queuedb_key,
                                 uint8_t *p_buf, uint8_t *p_buf_end)
@@ -93,6 +103,91 @@ int bdb_queuedb_best_pagesize(int avg_item_sz)
     return calc_pagesize(avg_item_sz);
 }
 
+static int genid_cmp(uint64_t a, uint64_t b)
+{
+    /* same order as the keys */
+    return memcmp(&a, &b, sizeof(uint64_t));
+}
+
+static int queuedb_consumer_mask(bdb_state_type *bdb_state, uint32_t *mask)
+{
+    int n = 0;
+    *mask = 0;
+    for (int i = 0; i < MAXCONSUMERS; i++) {
+        if (btst(&bdb_state->active_consumers, i)) {
+            *mask |= (1U << i);
+            n++;
+        }
+    }
+    return n;
+}
+
+static int queuedb_berk_rc(int rc, int *bdberr)
+{
+    if (rc == 0)
+        return 0;
+    if (rc == DB_LOCK_DEADLOCK)
+        *bdberr = BDBERR_DEADLOCK;
+    else if (rc == DB_NOTFOUND)
+        *bdberr = BDBERR_FETCH_DTA;
+    else
+        *bdberr = BDBERR_MISC;
+    return -1;
+}
+
+/* Store one copy of the item for all the consumers in mask; databuf has room
+ * for the mask after the item */
+static int queuedb_add_shared(bdb_state_type *bdb_state, tran_type *tran,
+                              uint8_t *databuf, size_t len, uint64_t genid,
+                              uint32_t mask, int *bdberr)
+{
+    DB *db = bdb_state->dbp_data[0][0];
+    struct bdb_queue_priv *qstate = bdb_state->qpriv;
+    struct queuedb_key k = {QUEUEDB_SHARED, genid};
+    uint8_t key[QUEUEDB_KEY_LEN];
+    DBT dbt_key = {0}, dbt_data = {0};
+    int rc;
+
+    queuedb_key_put(&k, key, key + sizeof(key));
+    mask = htonl(mask);
+    memcpy(databuf + len, &mask, QUEUEDB_MASK_LEN);
+
+    dbt_key.data = key;
+    dbt_key.size = QUEUEDB_KEY_LEN;
+    dbt_data.data = databuf;
+    dbt_data.size = len + QUEUEDB_MASK_LEN;
+    rc = db->put(db, tran->tid, &dbt_key, &dbt_data, 0);
+    if (rc == DB_LOCK_DEADLOCK)
+        qstate->stats.n_add_deadlocks++;
+    else if (rc)
+        logmsg(LOGMSG_ERROR, "queuedb %s shared genid %" PRIx64 " put rc %d\n",
+               bdb_state->name, genid, rc);
+    return queuedb_berk_rc(rc, bdberr);
+}
+
+/* The genid of the last shared item this consumer consumed, 0 if none */
+static int queuedb_get_cursor(bdb_state_type *bdb_state, DB_TXN *tid,
+                              int consumer, uint64_t *genid, int *bdberr)
+{
+    DB *db = bdb_state->dbp_data[0][0];
+    struct queuedb_key k = {QUEUEDB_CURSOR, consumer};
+    uint8_t key[QUEUEDB_KEY_LEN];
+    DBT dbt_key = {0}, dbt_data = {0};
+    int rc;
+
+    queuedb_key_put(&k, key, key + sizeof(key));
+    dbt_key.data = key;
+    dbt_key.size = QUEUEDB_KEY_LEN;
+    dbt_data.data = genid;
+    dbt_data.ulen = sizeof(*genid);
+    dbt_data.flags = DB_DBT_USERMEM;
+    *genid = 0;
+    rc = db->get(db, tid, &dbt_key, &dbt_data, 0);
+    if (rc == DB_NOTFOUND)
+        return 0;
+    return queuedb_berk_rc(rc, bdberr);
+}
+
 /* add to queue */
 int bdb_queuedb_add(bdb_state_type *bdb_state, tran_type *tran, const void *dta,
                     size_t dtalen, int *bdberr, unsigned long long *out_genid)
@@ -110,7 +205,8 @@ int bdb_queuedb_add(bdb_state_type *bdb_state, tran_type *tran, const void *dta,
         logmsg(LOGMSG_USER, ">>> bdb_queuedb_add %s\n", bdb_state->name);
 
     qstate = (struct bdb_queue_priv *)bdb_state->qpriv;
-    databuf = malloc(dtalen + sizeof(struct bdb_queue_found));
+    databuf = malloc(dtalen + sizeof(struct bdb_queue_found) +
+                     QUEUEDB_MASK_LEN);
     qfnd.genid = get_genid(bdb_state, 0);
     qfnd.data_len = dtalen;
     qfnd.data_offset = sizeof(struct bdb_queue_found);
@@ -140,6 +236,18 @@ int bdb_queuedb_add(bdb_state_type *bdb_state, tran_type *tran, const void *dta,
     }
 
     *bdberr = BDBERR_NOERROR;
+
+    /* with enough consumers, store it once and let each keep its place */
+    uint32_t mask;
+    if (gbl_queuedb_shared_min_consumers > 0 &&
+        queuedb_consumer_mask(bdb_state, &mask) >=
+            gbl_queuedb_shared_min_consumers) {
+        rc = queuedb_add_shared(bdb_state, tran, databuf,
+                                dtalen + sizeof(struct bdb_queue_found),
+                                qfnd.genid, mask, bdberr);
+        goto done;
+    }
+
     db = bdb_state->dbp_data[0][0];
     for (int i = 0; i < MAXCONSUMERS; i++) {
         if (btst(&bdb_state->active_consumers, i)) {
@@ -234,6 +342,15 @@ int bdb_queuedb_walk(bdb_state_type *bdb_state, int flags, void *lastitem,
 
         lastitem = (void *)dbt_key.data;
 
+        /* a consumer's place in the shared items isn't an item */
+        struct queuedb_key fndk;
+        if (queuedb_key_get(&fndk, dbt_key.data,
+                            (uint8_t *)dbt_key.data + dbt_key.size) &&
+            fndk.consumer == QUEUEDB_CURSOR) {
+            rc = dbcp->c_get(dbcp, &dbt_key, &dbt_data, DB_NEXT);
+            continue;
+        }
+
         p_buf = dbt_data.data;
         p_buf_end = p_buf + dbt_data.size;
         p_buf = (uint8_t *)queue_found_get(&qfnd, p_buf, p_buf_end);
@@ -250,7 +367,7 @@ int bdb_queuedb_walk(bdb_state_type *bdb_state, int flags, void *lastitem,
             rc = 0;
             break;
         }
-        rc = dbcp->c_get(dbcp, &dbt_key, &dbt_key, DB_NEXT);
+        rc = dbcp->c_get(dbcp, &dbt_key, &dbt_data, DB_NEXT);
     }
     if (rc) {
         if (rc == DB_LOCK_DEADLOCK) {
@@ -297,11 +414,12 @@ int bdb_queuedb_dump(bdb_state_type *bdb_state, FILE *out, int *bdberr)
     return 0;
 }
 
-int bdb_queuedb_get(bdb_state_type *bdb_state, int consumer,
-                    const struct bdb_queue_cursor *prevcursor, void **fnd,
-                    size_t *fnddtalen, size_t *fnddtaoff,
-                    struct bdb_queue_cursor *fndcursor, unsigned int *epoch,
-                    int *bdberr)
+/* The next item stored for this consumer alone */
+static int queuedb_get_own(bdb_state_type *bdb_state, int consumer,
+                           const struct bdb_queue_cursor *prevcursor,
+                           void **fnd, size_t *fnddtalen, size_t *fnddtaoff,
+                           struct bdb_queue_cursor *fndcursor,
+                           unsigned int *epoch, int *bdberr)
 {
 
     if (bdb_state->dbp_data[0][0] == NULL) { // trigger dropped?
@@ -381,7 +499,8 @@ int bdb_queuedb_get(bdb_state_type *bdb_state, int consumer,
         fsnapf(stdout, dbt_key.data, dbt_key.size);
     }
 
-    if (prevcursor && prevcursor->genid[0] != 0 && prevcursor->genid[1] != 0) {
+    if (prevcursor &&
+        (prevcursor->genid[0] != 0 || prevcursor->genid[1] != 0)) {
         /* We found something!  It may however be:
          * (1) the previous record that wasn't consumed yet
          * (2) a record for another consumer
@@ -517,6 +636,246 @@ done:
     return rc;
 }
 
+/* The next shared item for this consumer: after prevcursor, and after the
+ * last one it consumed */
+static int queuedb_get_shared(bdb_state_type *bdb_state, int consumer,
+                              const struct bdb_queue_cursor *prevcursor,
+                              void **fnd, size_t *fnddtalen, size_t *fnddtaoff,
+                              struct bdb_queue_cursor *fndcursor, int *bdberr)
+{
+    DB *db = bdb_state->dbp_data[0][0];
+    struct queuedb_key k = {QUEUEDB_SHARED, 0}, fndk;
+    struct bdb_queue_found qfnd;
+    uint8_t key[QUEUEDB_KEY_LEN];
+    DBT dbt_key = {0}, dbt_data = {0};
+    DBC *dbcp = NULL;
+    uint64_t after = 0, consumed;
+    uint32_t mask;
+    int rc, checked = 0;
+
+    if (prevcursor)
+        memcpy(&after, prevcursor->genid, sizeof(after));
+
+    if ((rc = db->cursor(db, NULL, &dbcp, 0)) != 0) {
+        *bdberr = BDBERR_MISC;
+        return -1;
+    }
+
+    k.genid = after;
+    queuedb_key_put(&k, key, key + sizeof(key));
+    dbt_key.data = key;
+    dbt_key.size = dbt_key.ulen = QUEUEDB_KEY_LEN;
+    dbt_key.flags = DB_DBT_USERMEM;
+    dbt_data.flags = DB_DBT_REALLOC;
+
+    rc = dbcp->c_get(dbcp, &dbt_key, &dbt_data, DB_SET_RANGE);
+    while (rc == 0) {
+        queuedb_key_get(&fndk, key, key + sizeof(key));
+        if (fndk.consumer != QUEUEDB_SHARED) {
+            rc = DB_NOTFOUND;
+            break;
+        }
+        /* skip what this consumer has already consumed */
+        if (!checked) {
+            checked = 1;
+            if (queuedb_get_cursor(bdb_state, NULL, consumer, &consumed,
+                                   bdberr) != 0) {
+                rc = -1;
+                goto done;
+            }
+            if (genid_cmp(consumed, after) > 0) {
+                after = k.genid = consumed;
+                queuedb_key_put(&k, key, key + sizeof(key));
+                dbt_key.size = QUEUEDB_KEY_LEN;
+                rc = dbcp->c_get(dbcp, &dbt_key, &dbt_data, DB_SET_RANGE);
+                continue;
+            }
+        }
+        if (genid_cmp(fndk.genid, after) > 0 &&
+            dbt_data.size >= sizeof(struct bdb_queue_found) + QUEUEDB_MASK_LEN) {
+            memcpy(&mask,
+                   (uint8_t *)dbt_data.data + dbt_data.size - QUEUEDB_MASK_LEN,
+                   QUEUEDB_MASK_LEN);
+            /* items added before this consumer was aren't for it */
+            if (ntohl(mask) & (1U << consumer))
+                break;
+        }
+        rc = dbcp->c_get(dbcp, &dbt_key, &dbt_data, DB_NEXT);
+    }
+    if (rc) {
+        rc = queuedb_berk_rc(rc, bdberr);
+        goto done;
+    }
+
+    if (queue_found_get(&qfnd, dbt_data.data,
+                        (uint8_t *)dbt_data.data + dbt_data.size) == NULL) {
+        logmsg(LOGMSG_ERROR, "%s: can't decode header size %u in queue %s\n",
+               __func__, dbt_data.size, bdb_state->name);
+        *bdberr = BDBERR_MISC;
+        rc = -1;
+        goto done;
+    }
+    *fnd = dbt_data.data;
+    if (fnddtalen)
+        *fnddtalen = dbt_data.size - QUEUEDB_MASK_LEN;
+    if (fnddtaoff)
+        *fnddtaoff = qfnd.data_offset;
+    if (fndcursor) {
+        memcpy(fndcursor->genid, &fndk.genid, sizeof(fndk.genid));
+        fndcursor->recno = 0;
+        fndcursor->reserved = 0;
+    }
+    dbt_data.data = NULL;
+    *bdberr = BDBERR_NOERROR;
+
+done:
+    if (dbt_data.data)
+        free(dbt_data.data);
+    dbcp->c_close(dbcp);
+    return rc;
+}
+
+static uint64_t queuedb_found_genid(const void *fnd)
+{
+    struct bdb_queue_found qfnd = {0};
+    queue_found_get(&qfnd, fnd, (uint8_t *)fnd + sizeof(struct bdb_queue_found));
+    return qfnd.genid;
+}
+
+int bdb_queuedb_get(bdb_state_type *bdb_state, int consumer,
+                    const struct bdb_queue_cursor *prevcursor, void **fnd,
+                    size_t *fnddtalen, size_t *fnddtaoff,
+                    struct bdb_queue_cursor *fndcursor, unsigned int *epoch,
+                    int *bdberr)
+{
+    struct bdb_queue_cursor scursor;
+    size_t sdtalen = 0, sdtaoff = 0;
+    void *sfnd = NULL;
+    int rc, src, sbdberr = 0;
+
+    rc = queuedb_get_own(bdb_state, consumer, prevcursor, fnd, fnddtalen,
+                         fnddtaoff, fndcursor, epoch, bdberr);
+    if (rc && *bdberr != BDBERR_FETCH_DTA)
+        return rc;
+
+    src = queuedb_get_shared(bdb_state, consumer, prevcursor, &sfnd, &sdtalen,
+                             &sdtaoff, &scursor, &sbdberr);
+    if (src) {
+        if (sbdberr == BDBERR_FETCH_DTA)
+            return rc;
+        if (rc == 0) {
+            free(*fnd);
+            *fnd = NULL;
+        }
+        *bdberr = sbdberr;
+        return src;
+    }
+
+    /* found both kinds: the older item goes first */
+    if (rc == 0) {
+        if (genid_cmp(queuedb_found_genid(*fnd), queuedb_found_genid(sfnd)) <
+            0) {
+            free(sfnd);
+            return 0;
+        }
+        free(*fnd);
+    }
+    *fnd = sfnd;
+    if (fnddtalen)
+        *fnddtalen = sdtalen;
+    if (fnddtaoff)
+        *fnddtaoff = sdtaoff;
+    if (fndcursor)
+        *fndcursor = scursor;
+    *bdberr = BDBERR_NOERROR;
+    return 0;
+}
+
+/* Consume a shared item: move this consumer's place up to it, and remove it
+ * if every other consumer it is for has passed it.  Returns 1 if genid isn't
+ * a shared item. */
+static int queuedb_consume_shared(bdb_state_type *bdb_state, tran_type *tran,
+                                  int consumer, uint64_t genid, int *bdberr)
+{
+    DB *db = bdb_state->dbp_data[0][0];
+    struct bdb_queue_priv *qstate = bdb_state->qpriv;
+    struct queuedb_key k = {QUEUEDB_SHARED, genid};
+    uint8_t key[QUEUEDB_KEY_LEN], ckey[QUEUEDB_KEY_LEN];
+    DBT dbt_key = {0}, dbt_data = {0};
+    DBC *dbcp = NULL;
+    uint32_t mask;
+    int rc, passed = 1;
+
+    if ((rc = db->cursor(db, tran->tid, &dbcp, 0)) != 0) {
+        *bdberr = BDBERR_MISC;
+        return -1;
+    }
+    queuedb_key_put(&k, key, key + sizeof(key));
+    dbt_key.data = key;
+    dbt_key.size = dbt_key.ulen = QUEUEDB_KEY_LEN;
+    dbt_key.flags = DB_DBT_USERMEM;
+    dbt_data.flags = DB_DBT_REALLOC;
+    rc = dbcp->c_get(dbcp, &dbt_key, &dbt_data, DB_SET);
+    if (rc == DB_NOTFOUND) {
+        rc = 1;
+        goto done;
+    } else if (rc) {
+        if (rc == DB_LOCK_DEADLOCK)
+            qstate->stats.n_consume_deadlocks++;
+        rc = queuedb_berk_rc(rc, bdberr);
+        goto done;
+    }
+    if (dbt_data.size < sizeof(struct bdb_queue_found) + QUEUEDB_MASK_LEN) {
+        logmsg(LOGMSG_ERROR, "%s: invalid shared item size %u in queue %s\n",
+               __func__, dbt_data.size, bdb_state->name);
+        *bdberr = BDBERR_MISC;
+        rc = -1;
+        goto done;
+    }
+    memcpy(&mask, (uint8_t *)dbt_data.data + dbt_data.size - QUEUEDB_MASK_LEN,
+           QUEUEDB_MASK_LEN);
+    mask = ntohl(mask);
+
+    k.consumer = QUEUEDB_CURSOR;
+    k.genid = consumer;
+    queuedb_key_put(&k, ckey, ckey + sizeof(ckey));
+    DBT dbt_ckey = {.data = ckey, .size = QUEUEDB_KEY_LEN};
+    DBT dbt_cdata = {.data = &genid, .size = sizeof(genid)};
+    if ((rc = db->put(db, tran->tid, &dbt_ckey, &dbt_cdata, 0)) != 0) {
+        rc = queuedb_berk_rc(rc, bdberr);
+        goto done;
+    }
+
+    for (int i = 0; i < MAXCONSUMERS && passed; i++) {
+        uint64_t other;
+        if (i == consumer || !(mask & (1U << i)) ||
+            !btst(&bdb_state->active_consumers, i))
+            continue;
+        if (queuedb_get_cursor(bdb_state, tran->tid, i, &other, bdberr) != 0) {
+            rc = -1;
+            goto done;
+        }
+        if (other == 0 || genid_cmp(other, genid) < 0)
+            passed = 0;
+    }
+    if (passed && (rc = dbcp->c_del(dbcp, 0)) != 0) {
+        rc = queuedb_berk_rc(rc, bdberr);
+        goto done;
+    }
+    if (gbl_debug_queuedb)
+        logmsg(LOGMSG_USER, ">> CONSUMED shared%s\n", passed ? ", removed" : "");
+    rc = 0;
+
+done:
+    if (dbt_data.data)
+        free(dbt_data.data);
+    if (dbcp->c_close(dbcp) == DB_LOCK_DEADLOCK) {
+        *bdberr = BDBERR_DEADLOCK;
+        rc = -1;
+    }
+    return rc;
+}
+
 int bdb_queuedb_consume(bdb_state_type *bdb_state, tran_type *tran,
                         int consumer, const void *prevfnd, int *bdberr)
 {
@@ -548,6 +907,9 @@ int bdb_queuedb_consume(bdb_state_type *bdb_state, tran_type *tran,
         rc = -1;
         goto done;
     }
+    if ((rc = queuedb_consume_shared(bdb_state, tran, consumer, qfnd.genid,
+                                     bdberr)) != 1)
+        goto done;
     k.consumer = consumer;
     k.genid = 0;
     if (gbl_debug_queuedb)
@@ -663,10 +1025,12 @@ const struct bdb_queue_stats *bdb_queuedb_get_stats(bdb_state_type *bdb_state)
 }
 
 int bdb_trigger_subscribe(bdb_state_type *bdb_state, pthread_cond_t **cond,
-                          pthread_mutex_t **lock, const uint8_t **open)
+                          pthread_mutex_t **lock, const uint8_t **open,
+                          const uint64_t **gen)
 {
     DB_ENV *dbenv = bdb_state->dbenv;
-    return dbenv->trigger_subscribe(dbenv, bdb_state->name, cond, lock, open);
+    return dbenv->trigger_subscribe(dbenv, bdb_state->name, cond, lock, open,
+                                    gen);
 }
 
 int bdb_trigger_unsubscribe(bdb_state_type *bdb_state)
@@ -675,6 +1039,12 @@ int bdb_trigger_unsubscribe(bdb_state_type *bdb_state)
     return dbenv->trigger_unsubscribe(dbenv, bdb_state->name);
 }
 
+int bdb_trigger_commit(bdb_state_type *bdb_state)
+{
+    DB_ENV *dbenv = bdb_state->dbenv;
+    return dbenv->trigger_commit(dbenv, bdb_state->name);
+}
+
 int bdb_trigger_open(bdb_state_type *bdb_state)
 {
     DB_ENV *dbenv = bdb_state->dbenv;
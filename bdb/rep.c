@@ -30,6 +30,7 @@
 #include <alloca.h>
 #include <limits.h>
 #include <math.h>
+#include <float.h>
 
 #include <epochlib.h>
 #include <build/db.h>
@@ -737,6 +738,7 @@ void rep_reset_send_callcount(void) { callcount = 0; }
 void rep_reset_send_bytecount(void) { bytecount = 0; }
 
 extern int gbl_decoupled_logputs;
+extern int gbl_net_lowpri_queue_pct;
 
 int berkdb_send_rtn(DB_ENV *dbenv, const DBT *control, const DBT *rec,
                     const DB_LSN *lsnp, char *host, uint32_t flags,
@@ -764,6 +766,9 @@ int berkdb_send_rtn(DB_ENV *dbenv, const DBT *control, const DBT *rec,
     int dontsend;
 
     int is_logput = 0;
+    DB_LSN stage_lsn;
+    int timed = 0;
+    uint64_t start_us;
 
     tran_type *tran;
 
@@ -973,6 +978,13 @@ int berkdb_send_rtn(DB_ENV *dbenv, const DBT *control, const DBT *rec,
         }
     }
 
+    /* time the commit's way to the replicants if it's one we sample */
+    if ((flags & DB_REP_PERMANENT) && lsnp) {
+        db_lsn_type_get(&stage_lsn, (uint8_t *)lsnp,
+                        (uint8_t *)lsnp + sizeof(DB_LSN));
+        timed = bdb_rep_stage_sampled(&stage_lsn);
+    }
+
     gblcontext = 0;
 
     if (tran) {
@@ -1052,9 +1064,18 @@ int berkdb_send_rtn(DB_ENV *dbenv, const DBT *control, const DBT *rec,
                     sendflags |= NET_SEND_TRACE;
                 }
 
+                if (timed)
+                    start_us = comdb2_time_epochus();
                 rc =
                     net_send_flags(bdb_state->repinfo->netinfo, hostlist[i],
                                    USER_TYPE_BERKDB_REP, buf, bufsz, sendflags);
+                if (timed && rc == 0) {
+                    uint64_t now_us = comdb2_time_epochus();
+                    bdb_rep_stage_record(hostlist[i],
+                                         BDB_REP_STAGE_NET_ENQUEUE,
+                                         now_us - start_us);
+                    bdb_rep_stage_sent(hostlist[i], &stage_lsn, now_us);
+                }
 
                 if (flags & DB_REP_TRACE) {
                     logmsg(LOGMSG_USER, "%s line %d net_send_flags rc %d\n",
@@ -1092,6 +1113,28 @@ int berkdb_send_rtn(DB_ENV *dbenv, const DBT *control, const DBT *rec,
         if (flags & DB_REP_NODROP)
             sendflags |= NET_SEND_NODROP;
 
+        /* Log sent to a single replicant is a catch-up fill, in answer to
+           its request; the live log goes to everyone.  Fills queue behind
+           the live log and control messages, and one that doesn't fit in
+           the fills' share of the queue fails, so a REP_ALL_REQ answer ends
+           in LOG_MORE and the replicant asks again when it gets there.  What
+           ends a fill, and NEWFILE in the middle of one, must stay in order
+           with it but is never turned away. */
+        if (gbl_net_lowpri_queue_pct > 0) {
+            switch (rectype) {
+            case REP_LOG:
+            case REP_LOG_FILL:
+                sendflags |= NET_SEND_LOWPRI;
+                if (!(flags & DB_REP_NODROP))
+                    sendflags &= ~NET_SEND_NODROP;
+                break;
+            case REP_LOG_MORE:
+            case REP_NEWFILE:
+                sendflags |= NET_SEND_LOWPRI;
+                break;
+            }
+        }
+
         if (bdb_state->attr->net_inorder_logputs)
             sendflags |= NET_SEND_INORDER;
 
@@ -1104,10 +1147,18 @@ int berkdb_send_rtn(DB_ENV *dbenv, const DBT *control, const DBT *rec,
             sendflags |= NET_SEND_TRACE;
         }
 
+        if (timed)
+            start_us = comdb2_time_epochus();
         rc = net_send_flags(bdb_state->repinfo->netinfo, host,
                             USER_TYPE_BERKDB_REP, buf, bufsz, sendflags);
         if (rc != 0)
             outrc = 1;
+        else if (timed) {
+            uint64_t now_us = comdb2_time_epochus();
+            bdb_rep_stage_record(host, BDB_REP_STAGE_NET_ENQUEUE,
+                                 now_us - start_us);
+            bdb_rep_stage_sent(host, &stage_lsn, now_us);
+        }
     }
 
     if (useheap)
@@ -3136,6 +3187,34 @@ static int node_in_list(int node, int list[], int listsz)
 
 /* ripped out ALL SUPPORT FOR ALL BROKEN CRAP MODES, aside from "newcoh" */
 
+/* order nodes by their average replication time over the last 10 seconds,
+ * quickest first; nodes with no history go last */
+static void sort_nodes_by_reptime(bdb_state_type *bdb_state,
+                                  const char **nodes, int numnodes)
+{
+    double avg[REPMAX];
+    int i, j;
+
+    Pthread_mutex_lock(&(bdb_state->seqnum_info->lock));
+    for (i = 0; i < numnodes; i++) {
+        struct averager *a =
+            bdb_state->seqnum_info->time_10seconds[nodeix(nodes[i])];
+        avg[i] = (a && averager_depth(a) > 0) ? averager_avg(a) : DBL_MAX;
+    }
+    Pthread_mutex_unlock(&(bdb_state->seqnum_info->lock));
+
+    for (i = 1; i < numnodes; i++) {
+        const char *node = nodes[i];
+        double t = avg[i];
+        for (j = i; j > 0 && avg[j - 1] > t; j--) {
+            nodes[j] = nodes[j - 1];
+            avg[j] = avg[j - 1];
+        }
+        nodes[j] = node;
+        avg[j] = t;
+    }
+}
+
 static int bdb_wait_for_seqnum_from_all_int(bdb_state_type *bdb_state,
                                             seqnum_type *seqnum, int *timeoutms,
                                             uint64_t txnsize, int newcoh)
@@ -3144,6 +3223,7 @@ static int bdb_wait_for_seqnum_from_all_int(bdb_state_type *bdb_state,
     const char *nodelist[REPMAX];
     const char *connlist[REPMAX];
     int durable_lsns = bdb_state->attr->durable_lsns;
+    int durable_majority_waitms = bdb_state->attr->durable_majority_waitms;
     int catchup_window = bdb_state->attr->catchup_window;
     int do_slow_node_check = 0;
     DB_LSN *masterlsn;
@@ -3248,6 +3328,12 @@ static int bdb_wait_for_seqnum_from_all_int(bdb_state_type *bdb_state,
             goto done_wait;
         }
 
+        /* wait for the usual quick nodes first, so one slow node doesn't
+         * hold up the first ack and with it the timeout for the rest */
+        if (numnodes > 1 && bdb_state->attr->rep_ack_fastest_first &&
+            bdb_state->attr->track_replication_times)
+            sort_nodes_by_reptime(bdb_state, nodelist, numnodes);
+
         for (i = 0; i < numnodes; i++) {
             if (bdb_state->rep_trace)
                 logmsg(LOGMSG_USER,
@@ -3330,6 +3416,13 @@ got_ack:
         if (waitms < bdb_state->attr->rep_timeout_minms)
             waitms = bdb_state->attr->rep_timeout_minms;
 
+        /* once a majority has the commit it is durable; the nodes left over
+         * get a short wait, and are made incoherent if they miss it */
+        if (durable_lsns && durable_majority_waitms > 0 &&
+            waitms > durable_majority_waitms &&
+            num_successfully_acked + 1 >= (total_connected + 1) / 2 + 1)
+            waitms = durable_majority_waitms;
+
         begin_time = comdb2_time_epochms();
 
         if (bdb_state->rep_trace)
@@ -3764,6 +3857,9 @@ void bdb_set_seqnum(void *in_bdb_state)
 
 int gbl_online_recovery = 1;
 
+/* when the message being processed was handed to us by net */
+static __thread uint64_t rep_stage_received_us;
+
 static int process_berkdb(bdb_state_type *bdb_state, char *host, DBT *control,
                           DBT *rec)
 {
@@ -3783,6 +3879,11 @@ static int process_berkdb(bdb_state_type *bdb_state, char *host, DBT *control,
     int got_vote2lock = 0;
     int done = 0;
     int master_confused = 0;
+    DB_LSN stage_lsn;
+    uint64_t received_us = rep_stage_received_us, apply_us = 0, applied_us = 0;
+    char *from = host;
+
+    rep_stage_received_us = 0;
 
     /* don't give it to berkeley db if we havent started rep yet */
     if (!bdb_state->rep_started || control == NULL) {
@@ -3839,10 +3940,27 @@ static int process_berkdb(bdb_state_type *bdb_state, char *host, DBT *control,
     if (debug_switch_rep_delay())
         sleep(2);
 
+    /* a commit record we sample: time it from net to the ack */
+    if (rectype == REP_LOG && (ntohl(rep_control->flags) & DB_LOG_PERM) &&
+        received_us) {
+        stage_lsn.file = ntohl(rep_control->lsn.file);
+        stage_lsn.offset = ntohl(rep_control->lsn.offset);
+        if (bdb_rep_stage_sampled(&stage_lsn)) {
+            apply_us = comdb2_time_epochus();
+            bdb_rep_stage_record(from, BDB_REP_STAGE_REPLICANT_RECEIVE,
+                                 apply_us - received_us);
+        }
+    }
+
     r = bdb_state->dbenv->rep_process_message(bdb_state->dbenv, control, rec,
                                               &host, &permlsn,
                                               &commit_generation, online);
 
+    if (apply_us) {
+        applied_us = comdb2_time_epochus();
+        bdb_rep_stage_record(from, BDB_REP_STAGE_APPLY, applied_us - apply_us);
+    }
+
     if (got_vote2lock) {
         if (bdb_get_rep_master(bdb_state, &master, &gen, &egen) != 0) {
             abort();
@@ -4018,6 +4136,9 @@ static int process_berkdb(bdb_state_type *bdb_state, char *host, DBT *control,
 
         if (!gbl_early) {
             rc = do_ack(bdb_state, permlsn, generation);
+            if (applied_us)
+                bdb_rep_stage_record(from, BDB_REP_STAGE_ACK_SEND,
+                                     comdb2_time_epochus() - applied_us);
         }
 
         break;
@@ -4094,6 +4215,7 @@ static int process_berkdb(bdb_state_type *bdb_state, char *host, DBT *control,
 
 int gbl_force_incoherent = 0;
 int gbl_ignore_coherency = 0;
+extern int gbl_load_cache_at_startup;
 
 static int bdb_am_i_coherent_int(bdb_state_type *bdb_state)
 {
@@ -4122,6 +4244,20 @@ static int bdb_am_i_coherent_int(bdb_state_type *bdb_state)
         }
     }
 
+    /* Don't take reads until the startup cache load has finished */
+    if (gbl_load_cache_at_startup &&
+        __memp_load_progress(bdb_state->dbenv, NULL, NULL, NULL)) {
+        static time_t lastpr = 0;
+        time_t now = time(NULL);
+        if (now - lastpr) {
+            logmsg(LOGMSG_INFO,
+                   "%s returning INCOHERENT while loading the cache\n",
+                   __func__);
+            lastpr = now;
+        }
+        return 0;
+    }
+
     if (gbl_ignore_coherency) {
         static time_t lastpr = 0;
         time_t now = time(NULL);
@@ -5076,6 +5212,7 @@ static int berkdb_receive_rtn_int(void *ack_handle, void *usr_ptr,
         p_buf = (uint8_t *)rep_berkdb_seqnum_type_get(&berkdb_seqnum, p_buf,
                                                       p_buf_end);
 
+        bdb_rep_stage_acked(from_node, &berkdb_seqnum.lsn);
         got_new_seqnum_from_node(bdb_state, &berkdb_seqnum, from_node, is_tcp);
         break;
 
@@ -5139,6 +5276,9 @@ void berkdb_receive_rtn(void *ack_handle, void *usr_ptr, char *from_host,
     bdb_state_type *bdb_state;
     int rc;
 
+    if (gbl_rep_stage_sample > 0 && usertype == USER_TYPE_BERKDB_REP)
+        rep_stage_received_us = comdb2_time_epochus();
+
     /* get a pointer back to our bdb_state */
     bdb_state = usr_ptr;
 
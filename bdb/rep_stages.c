@@ -0,0 +1,187 @@
+/*
+   Copyright 2024 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/* Replication stage latencies.  A commit's way to a replicant and back is
+ * timed in the pieces each node can see on its own clock: on the master the
+ * log put, the enqueue of the record for each replicant, the wait in that
+ * replicant's net queue until the writer flushes it, and the time until the
+ * replicant's ack comes back; on a replicant the wait from the record being
+ * read off the socket to it being given to berkdb, the apply, and the ack.
+ * Only one commit in rep_stage_sample is timed, picked by its lsn, so where
+ * both ends time a commit they time the same ones.  Each stage has a
+ * histogram per peer: the replicant on the master, the master on a
+ * replicant. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <build/db.h>
+#include "bdb_int.h"
+#include "locks_wrap.h"
+#include "epochlib.h"
+#include "hdrhist.h"
+
+int gbl_rep_stage_sample = 16;
+
+/* an ack that doesn't come in this long is given up on */
+#define REP_STAGE_ACK_TIMEOUT_US (10 * 1000000ULL)
+
+struct rep_stage_host {
+    char *host;
+    struct hdrhist h[BDB_REP_STAGE_MAX];
+    DB_LSN ack_lsn; /* the timed commit this host's ack is awaited for */
+    uint64_t ack_sent_us;
+    struct rep_stage_host *next;
+};
+
+static pthread_mutex_t stages_lk = PTHREAD_MUTEX_INITIALIZER;
+static struct rep_stage_host *stage_hosts;
+
+static const char *stage_names[BDB_REP_STAGE_MAX] = {
+    "log_put",     "net_enqueue", "writer_send", "replicant_receive",
+    "apply",       "ack_send",    "ack_receive"};
+
+const char *bdb_rep_stage_name(int stage)
+{
+    if (stage < 0 || stage >= BDB_REP_STAGE_MAX)
+        return "unknown";
+    return stage_names[stage];
+}
+
+int bdb_rep_stage_sampled(const DB_LSN *lsn)
+{
+    uint32_t h;
+
+    if (gbl_rep_stage_sample <= 0 || lsn->file == 0)
+        return 0;
+    if (gbl_rep_stage_sample == 1)
+        return 1;
+    h = lsn->file * 2654435761U ^ lsn->offset * 2246822519U;
+    h ^= h >> 15;
+    return h % (uint32_t)gbl_rep_stage_sample == 0;
+}
+
+/* expects stages_lk held */
+static struct rep_stage_host *get_host(const char *host)
+{
+    struct rep_stage_host *s;
+
+    for (s = stage_hosts; s; s = s->next) {
+        if (strcmp(s->host, host) == 0)
+            return s;
+    }
+    if ((s = calloc(1, sizeof(*s))) == NULL ||
+        (s->host = strdup(host)) == NULL) {
+        free(s);
+        return NULL;
+    }
+    for (int i = 0; i < BDB_REP_STAGE_MAX; i++)
+        hdrhist_init(&s->h[i]);
+    s->next = stage_hosts;
+    stage_hosts = s;
+    return s;
+}
+
+void bdb_rep_stage_record(const char *host, int stage, uint64_t us)
+{
+    struct rep_stage_host *s;
+
+    if (host == NULL || stage < 0 || stage >= BDB_REP_STAGE_MAX)
+        return;
+    Pthread_mutex_lock(&stages_lk);
+    if ((s = get_host(host)) != NULL)
+        hdrhist_record(&s->h[stage], us);
+    Pthread_mutex_unlock(&stages_lk);
+}
+
+void bdb_rep_stage_sent(const char *host, const DB_LSN *lsn, uint64_t now_us)
+{
+    struct rep_stage_host *s;
+
+    Pthread_mutex_lock(&stages_lk);
+    if ((s = get_host(host)) != NULL &&
+        (s->ack_sent_us == 0 ||
+         now_us - s->ack_sent_us > REP_STAGE_ACK_TIMEOUT_US)) {
+        s->ack_lsn = *lsn;
+        s->ack_sent_us = now_us;
+    }
+    Pthread_mutex_unlock(&stages_lk);
+}
+
+void bdb_rep_stage_acked(const char *host, const DB_LSN *lsn)
+{
+    struct rep_stage_host *s;
+
+    Pthread_mutex_lock(&stages_lk);
+    for (s = stage_hosts; s; s = s->next) {
+        if (strcmp(s->host, host) == 0)
+            break;
+    }
+    if (s && s->ack_sent_us && log_compare(lsn, &s->ack_lsn) >= 0) {
+        hdrhist_record(&s->h[BDB_REP_STAGE_ACK_RECEIVE],
+                       comdb2_time_epochus() - s->ack_sent_us);
+        s->ack_sent_us = 0;
+    }
+    Pthread_mutex_unlock(&stages_lk);
+}
+
+void bdb_rep_stage_net_latency(netinfo_type *netinfo, const char *host,
+                               uint64_t us)
+{
+    bdb_rep_stage_record(host, BDB_REP_STAGE_WRITER_SEND, us);
+}
+
+void bdb_rep_stage_get(int stage, struct hdrhist *out)
+{
+    struct rep_stage_host *s;
+
+    hdrhist_init(out);
+    if (stage < 0 || stage >= BDB_REP_STAGE_MAX)
+        return;
+    Pthread_mutex_lock(&stages_lk);
+    for (s = stage_hosts; s; s = s->next)
+        hdrhist_merge(out, &s->h[stage]);
+    Pthread_mutex_unlock(&stages_lk);
+}
+
+int bdb_rep_stages_collect(bdb_rep_stage_collect_f func, void *arg)
+{
+    struct rep_stage_host *s;
+    struct hdrhist *h;
+    char *host;
+    int rc = 0;
+
+    /* copied out one at a time so the callback runs without stages_lk */
+    if ((h = malloc(sizeof(*h))) == NULL)
+        return -1;
+    Pthread_mutex_lock(&stages_lk);
+    for (s = stage_hosts; s && rc == 0; s = s->next) {
+        for (int i = 0; i < BDB_REP_STAGE_MAX && rc == 0; i++) {
+            if (s->h[i].count == 0)
+                continue;
+            *h = s->h[i];
+            host = strdup(s->host);
+            Pthread_mutex_unlock(&stages_lk);
+            rc = host ? func(arg, host, i, h) : -1;
+            free(host);
+            Pthread_mutex_lock(&stages_lk);
+        }
+    }
+    Pthread_mutex_unlock(&stages_lk);
+    free(h);
+    return rc;
+}
@@ -0,0 +1,213 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/* Row cache: unpacked data records by genid, so a fetch of a record that
+ * is read over and over skips the descent of the data btree and the
+ * decompression of the record.
+ *
+ * An entry is stamped with the dirty generation of the data file it was
+ * read from, and is only good while that generation hasn't moved.  The
+ * generation is bumped for every page of the file made dirty, by this
+ * node's transactions, their aborts and the log replayed from the master
+ * alike, so no path that changes a record can skip the invalidation; the
+ * price is that any write to a stripe drops all of its rows.  That suits
+ * what the cache is for, read-mostly tables.
+ *
+ * A record is stamped with the generation read before it was fetched and
+ * only kept if the generation is still the same after, so a change that
+ * lands while it is being read is never cached.  Reads in a transaction,
+ * which can see their own changes, and dirty reads aren't cached. */
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <build/db.h>
+#include <logmsg.h>
+#include <list.h>
+#include <plhash.h>
+#include <locks_wrap.h>
+#include "bdb_int.h"
+
+int gbl_row_cache_mb = 0;
+
+#define ROW_CACHE_SHARDS 16
+
+struct row_cache_key {
+    u_int8_t fileid[DB_FILE_ID_LEN];
+    u_int32_t pad;
+    unsigned long long genid;
+};
+
+struct row_cache_ent {
+    struct row_cache_key key;
+    u_int64_t dirty_gen;
+    int len;
+    uint8_t ver;
+    LINKC_T(struct row_cache_ent) lnk;
+    char dta[];
+};
+
+struct row_cache_shard {
+    pthread_mutex_t lk;
+    hash_t *h;
+    LISTC_T(struct row_cache_ent) lru; /* oldest first */
+    size_t bytes;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+static struct row_cache_shard shards[ROW_CACHE_SHARDS];
+static pthread_once_t row_cache_once = PTHREAD_ONCE_INIT;
+
+static void row_cache_init(void)
+{
+    for (int i = 0; i < ROW_CACHE_SHARDS; i++) {
+        struct row_cache_shard *s = &shards[i];
+        Pthread_mutex_init(&s->lk, NULL);
+        s->h = hash_init_o(offsetof(struct row_cache_ent, key),
+                           sizeof(struct row_cache_key));
+        listc_init(&s->lru, offsetof(struct row_cache_ent, lnk));
+    }
+}
+
+static struct row_cache_shard *row_cache_shard(const struct row_cache_key *k)
+{
+    /* the low bits of a genid are its stripe and updateid */
+    unsigned long long h = k->genid ^ (k->genid >> 20) ^ (k->genid >> 40);
+    return &shards[h % ROW_CACHE_SHARDS];
+}
+
+static void row_cache_key(struct row_cache_key *k, DB *dbp,
+                          unsigned long long genid)
+{
+    memset(k, 0, sizeof(*k));
+    memcpy(k->fileid, dbp->fileid, DB_FILE_ID_LEN);
+    k->genid = genid;
+}
+
+static void row_cache_remove(struct row_cache_shard *s,
+                             struct row_cache_ent *e)
+{
+    hash_del(s->h, e);
+    listc_rfl(&s->lru, e);
+    s->bytes -= sizeof(*e) + e->len;
+    free(e);
+}
+
+int bdb_row_cache_gen(DB *dbp, u_int64_t *gen)
+{
+    if (gbl_row_cache_mb <= 0)
+        return -1;
+    pthread_once(&row_cache_once, row_cache_init);
+    return dbp->mpf->get_dirty_gen(dbp->mpf, gen);
+}
+
+int bdb_row_cache_get(DB *dbp, unsigned long long genid, u_int64_t gen,
+                      void *dta, int dtalen, int *reqdtalen, uint8_t *ver)
+{
+    struct row_cache_key k;
+    struct row_cache_shard *s;
+    struct row_cache_ent *e;
+    int found = 0;
+
+    row_cache_key(&k, dbp, genid);
+    s = row_cache_shard(&k);
+
+    Pthread_mutex_lock(&s->lk);
+    if ((e = hash_find(s->h, &k)) != NULL) {
+        if (e->dirty_gen == gen) {
+            memcpy(dta, e->dta, e->len < dtalen ? e->len : dtalen);
+            *reqdtalen = e->len;
+            *ver = e->ver;
+            listc_rfl(&s->lru, e);
+            listc_abl(&s->lru, e);
+            found = 1;
+        } else {
+            row_cache_remove(s, e);
+        }
+    }
+    if (found)
+        s->hits++;
+    else
+        s->misses++;
+    Pthread_mutex_unlock(&s->lk);
+
+    return found;
+}
+
+void bdb_row_cache_put(DB *dbp, unsigned long long genid, u_int64_t gen,
+                       const void *dta, int len, uint8_t ver)
+{
+    struct row_cache_shard *s;
+    struct row_cache_ent *e, *old;
+    size_t maxbytes = (size_t)gbl_row_cache_mb * 1024 * 1024 / ROW_CACHE_SHARDS;
+    u_int64_t now;
+
+    if (sizeof(*e) + len > maxbytes / 16)
+        return;
+    /* a page changed under the read; the record may be stale already */
+    if (dbp->mpf->get_dirty_gen(dbp->mpf, &now) || now != gen)
+        return;
+    if ((e = malloc(sizeof(*e) + len)) == NULL)
+        return;
+    row_cache_key(&e->key, dbp, genid);
+    e->dirty_gen = gen;
+    e->len = len;
+    e->ver = ver;
+    memcpy(e->dta, dta, len);
+    s = row_cache_shard(&e->key);
+
+    Pthread_mutex_lock(&s->lk);
+    if ((old = hash_find(s->h, &e->key)) != NULL)
+        row_cache_remove(s, old);
+    hash_add(s->h, e);
+    listc_abl(&s->lru, e);
+    s->bytes += sizeof(*e) + len;
+    while (s->bytes > maxbytes && (old = s->lru.top) != NULL)
+        row_cache_remove(s, old);
+    Pthread_mutex_unlock(&s->lk);
+}
+
+void bdb_row_cache_report(void)
+{
+    uint64_t hits = 0, misses = 0;
+    size_t bytes = 0;
+    int nents = 0;
+
+    if (gbl_row_cache_mb <= 0) {
+        logmsg(LOGMSG_USER, "row cache is off (row_cache_mb 0)\n");
+        return;
+    }
+    pthread_once(&row_cache_once, row_cache_init);
+    for (int i = 0; i < ROW_CACHE_SHARDS; i++) {
+        struct row_cache_shard *s = &shards[i];
+        Pthread_mutex_lock(&s->lk);
+        hits += s->hits;
+        misses += s->misses;
+        bytes += s->bytes;
+        nents += s->lru.count;
+        Pthread_mutex_unlock(&s->lk);
+    }
+    logmsg(LOGMSG_USER,
+           "row cache: %d rows, %zu bytes of %d MB, hits %" PRIu64
+           " misses %" PRIu64 " (%.1f%%)\n",
+           nents, bytes, gbl_row_cache_mb, hits, misses,
+           hits + misses ? 100.0 * hits / (hits + misses) : 0.0);
+}
@@ -98,7 +98,7 @@ static inline int check_free_space(const char *path)
 }
 
 #define _64K (64 * 1024)
-static DB *dbp_from_meta(DB *dbp, DBMETA *meta)
+DB *dbp_from_meta(DB *dbp, DBMETA *meta)
 {
     uint32_t magic;
     if (FLD_ISSET(meta->metaflags, DBMETA_CHKSUM))
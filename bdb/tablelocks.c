@@ -0,0 +1,487 @@
+/*
+   Copyright 2024 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/* Table lock fast path.  Nearly every statement takes a read lock on each
+ * table it uses, and all of them meet on the one berkdb lock object for the
+ * table; table write locks are taken by schema changes and little else.  So
+ * while no writer is about, a read lock is only written down, on one of the
+ * table's per-cpu slots and under the locker it is for, and berkdb never
+ * sees it.
+ *
+ * A writer raises the table's pending count first, which sends later readers
+ * to berkdb, then takes each slot in turn and gets the real read lock on
+ * berkdb for every locker it finds there.  Only then does it ask for its own
+ * write lock, which waits for those readers the way it always would, and the
+ * deadlock detector sees all of them.  No writer is let go on to its write
+ * lock while nodes another writer took out of the slots are still to be made
+ * real.  None of this module's mutexes is held while berkdb is asked for a
+ * lock; a node being made real is marked instead, and its locker waits for
+ * it before letting go of its locks or giving them to its parent.  A node
+ * that berkdb would not lock, as for a deadlock victim, goes back into its
+ * slot and the writer fails with DB_LOCK_DEADLOCK.
+ *
+ * berkdb calls in here as it lets go of a locker's locks, and as a child
+ * locker's are given to its parent, so what is written down goes with them.
+ * A replicant gets the write locks of the master's transactions straight off
+ * the log; those go through the same revocation first.  A node is in a slot
+ * and in its locker's bucket, and whoever takes it out of the second of
+ * those frees it. */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include <build/db.h>
+#include <logmsg.h>
+#include <list.h>
+#include <plhash.h>
+#include <locks_wrap.h>
+#include <comdb2_atomic.h>
+#include "bdb_int.h"
+#include "locks.h"
+
+int gbl_tablelock_fastpath = 0;
+
+#define TBLLK_SLOTS 16
+#define TBLLK_BUCKETS 256
+#define TBLLK_POLL_MS 10
+#define TBLLK_WAIT_MS 1000 /* for another writer's readers to be made real */
+
+struct tbllk;
+
+struct tbllk_node {
+    struct tbllk *t;
+    u_int32_t lid;
+    int slot;
+    int exclusive; /* a writer's hold on pending, never in a slot */
+    int done;      /* for an exclusive node, the readers were all made real */
+    int inslot;
+    int inbucket;
+    int inflating; /* berkdb is being asked for its real lock */
+    LINKC_T(struct tbllk_node) slnk;
+    LINKC_T(struct tbllk_node) blnk;
+};
+
+struct tbllk_slot {
+    pthread_mutex_t lk;
+    LISTC_T(struct tbllk_node) holders;
+} __attribute__((aligned(64)));
+
+struct tbllk {
+    char name[TABLELOCK_KEY_SIZE];
+    int pending;
+    int inflating; /* nodes writers took out of the slots, not yet real */
+    pthread_mutex_t xlk;
+    pthread_cond_t xcond;
+    struct tbllk_slot slots[TBLLK_SLOTS];
+};
+
+struct tbllk_bucket {
+    pthread_mutex_t lk;
+    pthread_cond_t cond; /* a node in here was made real, or not */
+    int count;
+    LISTC_T(struct tbllk_node) nodes;
+};
+
+static hash_t *tbllk_hash;
+static pthread_rwlock_t tbllk_hash_lk = PTHREAD_RWLOCK_INITIALIZER;
+static struct tbllk_bucket buckets[TBLLK_BUCKETS];
+static pthread_once_t tbllk_once = PTHREAD_ONCE_INIT;
+
+static void tbllk_init(void)
+{
+    tbllk_hash =
+        hash_init_o(offsetof(struct tbllk, name), TABLELOCK_KEY_SIZE);
+    for (int i = 0; i < TBLLK_BUCKETS; i++) {
+        Pthread_mutex_init(&buckets[i].lk, NULL);
+        Pthread_cond_init(&buckets[i].cond, NULL);
+        listc_init(&buckets[i].nodes, offsetof(struct tbllk_node, blnk));
+    }
+}
+
+static inline struct tbllk_bucket *tbllk_bucket(u_int32_t lid)
+{
+    return &buckets[(lid * 2654435761U) >> 24];
+}
+
+/* Tables are never taken out: there are only as many as were ever locked */
+static struct tbllk *tbllk_get(const void *name, int create)
+{
+    struct tbllk *t;
+
+    pthread_once(&tbllk_once, tbllk_init);
+    Pthread_rwlock_rdlock(&tbllk_hash_lk);
+    t = hash_find_readonly(tbllk_hash, name);
+    Pthread_rwlock_unlock(&tbllk_hash_lk);
+    if (t || !create)
+        return t;
+
+    Pthread_rwlock_wrlock(&tbllk_hash_lk);
+    if ((t = hash_find(tbllk_hash, name)) == NULL &&
+        (t = calloc(1, sizeof(*t))) != NULL) {
+        memcpy(t->name, name, TABLELOCK_KEY_SIZE);
+        Pthread_mutex_init(&t->xlk, NULL);
+        Pthread_cond_init(&t->xcond, NULL);
+        for (int i = 0; i < TBLLK_SLOTS; i++) {
+            Pthread_mutex_init(&t->slots[i].lk, NULL);
+            listc_init(&t->slots[i].holders,
+                       offsetof(struct tbllk_node, slnk));
+        }
+        hash_add(tbllk_hash, t);
+    }
+    Pthread_rwlock_unlock(&tbllk_hash_lk);
+    return t;
+}
+
+static void bucket_add(struct tbllk_node *n)
+{
+    struct tbllk_bucket *b = tbllk_bucket(n->lid);
+
+    Pthread_mutex_lock(&b->lk);
+    listc_abl(&b->nodes, n);
+    n->inbucket = 1;
+    ATOMIC_ADD32(b->count, 1);
+    Pthread_mutex_unlock(&b->lk);
+}
+
+/* expects the bucket locked */
+static int bucket_inflating(struct tbllk_bucket *b, u_int32_t lid)
+{
+    struct tbllk_node *n;
+
+    LISTC_FOR_EACH(&b->nodes, n, blnk)
+    {
+        if (n->lid == lid && n->inflating)
+            return 1;
+    }
+    return 0;
+}
+
+/* expects the bucket locked */
+static void bucket_rem(struct tbllk_bucket *b, struct tbllk_node *n)
+{
+    listc_rfl(&b->nodes, n);
+    n->inbucket = 0;
+    ATOMIC_ADD32(b->count, -1);
+}
+
+int bdb_tablelock_fast_read(DB_ENV *dbenv, u_int32_t lid, const void *name)
+{
+    struct tbllk *t;
+    struct tbllk_slot *s;
+    struct tbllk_node *n, *held;
+    struct tbllk_bucket *b;
+    int cpu;
+
+    if (!gbl_tablelock_fastpath)
+        return -1;
+    if ((t = tbllk_get(name, 1)) == NULL || ATOMIC_LOAD32(t->pending))
+        return -1;
+    if ((n = calloc(1, sizeof(*n))) == NULL)
+        return -1;
+    if ((cpu = sched_getcpu()) < 0)
+        cpu = 0;
+    n->t = t;
+    n->lid = lid;
+    n->slot = cpu % TBLLK_SLOTS;
+
+    /* in the bucket before the slot: a writer finding it in the slot can
+     * find it there.  A locker that has the table already needs nothing
+     * more; if a writer is turning it into a real lock that is done before
+     * any writer gets its own. */
+    b = tbllk_bucket(lid);
+    Pthread_mutex_lock(&b->lk);
+    LISTC_FOR_EACH(&b->nodes, held, blnk)
+    {
+        if (held->lid == lid && held->t == t && !held->exclusive) {
+            Pthread_mutex_unlock(&b->lk);
+            free(n);
+            return 0;
+        }
+    }
+    listc_abl(&b->nodes, n);
+    n->inbucket = 1;
+    ATOMIC_ADD32(b->count, 1);
+    Pthread_mutex_unlock(&b->lk);
+
+    s = &t->slots[n->slot];
+    Pthread_mutex_lock(&s->lk);
+    if (ATOMIC_LOAD32(t->pending) == 0) {
+        listc_abl(&s->holders, n);
+        n->inslot = 1;
+        Pthread_mutex_unlock(&s->lk);
+        return 0;
+    }
+    Pthread_mutex_unlock(&s->lk);
+
+    Pthread_mutex_lock(&b->lk);
+    bucket_rem(b, n);
+    Pthread_mutex_unlock(&b->lk);
+    free(n);
+    return -1;
+}
+
+/* Get the real read lock for a node a writer took out of its slot.  A node
+ * berkdb will not lock goes back into its slot, and the error is returned. */
+static int tbllk_inflate(DB_ENV *dbenv, struct tbllk_node *n)
+{
+    struct tbllk_bucket *b;
+    struct tbllk_slot *s;
+    DB_LOCK dblk;
+    DBT lk = {0};
+    u_int32_t lid;
+    int rc;
+
+    lk.data = n->t->name;
+    lk.size = TABLELOCK_KEY_SIZE;
+
+    for (;;) {
+        /* it may be moving to a parent locker */
+        lid = ATOMIC_LOAD32(n->lid);
+        b = tbllk_bucket(lid);
+        Pthread_mutex_lock(&b->lk);
+        if (n->lid == lid)
+            break;
+        Pthread_mutex_unlock(&b->lk);
+    }
+    if (!n->inbucket) {
+        /* its locker let go of it after it was taken */
+        Pthread_mutex_unlock(&b->lk);
+        free(n);
+        return 0;
+    }
+    /* the locker waits for this before letting go of its locks, or giving
+     * them to a parent, so the lock can't outlive it or miss the move */
+    n->inflating = 1;
+    Pthread_mutex_unlock(&b->lk);
+
+    rc = dbenv->lock_get(dbenv, lid, 0, &lk, DB_LOCK_READ, &dblk);
+
+    Pthread_mutex_lock(&b->lk);
+    n->inflating = 0;
+    if (rc == 0) {
+        bucket_rem(b, n);
+    } else {
+        logmsg(LOGMSG_ERROR, "%s: read lock for locker %x on %.*s rc %d\n",
+               __func__, lid, SHORT_TABLENAME_LEN, n->t->name, rc);
+        s = &n->t->slots[n->slot];
+        Pthread_mutex_lock(&s->lk);
+        listc_abl(&s->holders, n);
+        n->inslot = 1;
+        Pthread_mutex_unlock(&s->lk);
+    }
+    Pthread_cond_broadcast(&b->cond);
+    Pthread_mutex_unlock(&b->lk);
+    if (rc == 0)
+        free(n);
+    return rc;
+}
+
+/* expects t->xlk held */
+static int tbllk_xwait(struct tbllk *t, int *waited)
+{
+    struct timespec ts;
+
+    if (*waited >= TBLLK_WAIT_MS)
+        return DB_LOCK_DEADLOCK;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += TBLLK_POLL_MS * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&t->xcond, &t->xlk, &ts);
+    *waited += TBLLK_POLL_MS;
+    return 0;
+}
+
+int bdb_tablelock_fast_exclusive(DB_ENV *dbenv, u_int32_t lid,
+                                 const void *name)
+{
+    LISTC_T(struct tbllk_node) taken;
+    struct tbllk_bucket *b;
+    struct tbllk *t;
+    struct tbllk_node *n, *x;
+    int count, waited = 0, rc = 0;
+
+    if ((t = tbllk_get(name, 1)) == NULL)
+        return ENOMEM;
+
+    /* a locker that has been through this for the table already holds it
+     * or waits for it in berkdb, and no new reader is in a slot since */
+    b = tbllk_bucket(lid);
+    Pthread_mutex_lock(&b->lk);
+    LISTC_FOR_EACH(&b->nodes, x, blnk)
+    {
+        if (x->lid == lid && x->t == t && x->exclusive && x->done) {
+            Pthread_mutex_unlock(&b->lk);
+            return 0;
+        }
+    }
+    Pthread_mutex_unlock(&b->lk);
+
+    if ((x = calloc(1, sizeof(*x))) == NULL)
+        return ENOMEM;
+    x->t = t;
+    x->lid = lid;
+    x->exclusive = 1;
+    /* pending goes back down as this locker lets go of its locks, whether
+     * or not the write lock is had */
+    ATOMIC_ADD32(t->pending, 1);
+    bucket_add(x);
+
+    listc_init(&taken, offsetof(struct tbllk_node, slnk));
+    Pthread_mutex_lock(&t->xlk);
+    for (;;) {
+        count = 0;
+        for (int i = 0; i < TBLLK_SLOTS; i++) {
+            struct tbllk_slot *s = &t->slots[i];
+            Pthread_mutex_lock(&s->lk);
+            while ((n = listc_rtl(&s->holders)) != NULL) {
+                n->inslot = 0;
+                listc_abl(&taken, n);
+                count++;
+            }
+            Pthread_mutex_unlock(&s->lk);
+        }
+        if (count == 0) {
+            if (t->inflating == 0)
+                break;
+            /* another writer's readers are not all real yet */
+            if ((rc = tbllk_xwait(t, &waited)) != 0)
+                break;
+            continue;
+        }
+
+        t->inflating += count;
+        Pthread_mutex_unlock(&t->xlk);
+        while ((n = listc_rtl(&taken)) != NULL) {
+            int irc = tbllk_inflate(dbenv, n);
+            if (irc && !rc)
+                rc = DB_LOCK_DEADLOCK;
+        }
+        Pthread_mutex_lock(&t->xlk);
+        t->inflating -= count;
+        Pthread_cond_broadcast(&t->xcond);
+        if (rc)
+            break;
+    }
+    Pthread_mutex_unlock(&t->xlk);
+
+    if (rc == 0) {
+        Pthread_mutex_lock(&b->lk);
+        x->done = 1;
+        Pthread_mutex_unlock(&b->lk);
+    }
+    return rc;
+}
+
+int bdb_tablelock_fast_held(u_int32_t lid)
+{
+    if (ATOMIC_LOADPTR(tbllk_hash) == NULL)
+        return 0;
+    return ATOMIC_LOAD32(tbllk_bucket(lid)->count) > 0;
+}
+
+void bdb_tablelock_fast_release(u_int32_t lid, int readonly)
+{
+    LISTC_T(struct tbllk_node) mine;
+    struct tbllk_bucket *b;
+    struct tbllk_node *n, *tmp;
+    struct tbllk_slot *s;
+
+    if (!bdb_tablelock_fast_held(lid))
+        return;
+    b = tbllk_bucket(lid);
+    listc_init(&mine, offsetof(struct tbllk_node, blnk));
+    Pthread_mutex_lock(&b->lk);
+    while (bucket_inflating(b, lid))
+        Pthread_cond_wait(&b->cond, &b->lk);
+    LISTC_FOR_EACH_SAFE(&b->nodes, n, tmp, blnk)
+    {
+        if (n->lid != lid || (readonly && n->exclusive))
+            continue;
+        bucket_rem(b, n);
+        listc_abl(&mine, n);
+    }
+    Pthread_mutex_unlock(&b->lk);
+
+    while ((n = listc_rtl(&mine)) != NULL) {
+        if (n->exclusive) {
+            ATOMIC_ADD32(n->t->pending, -1);
+            free(n);
+            continue;
+        }
+        s = &n->t->slots[n->slot];
+        Pthread_mutex_lock(&s->lk);
+        if (!n->inslot) {
+            /* a writer has it, and frees it on seeing it out of here */
+            Pthread_mutex_unlock(&s->lk);
+            continue;
+        }
+        listc_rfl(&s->holders, n);
+        n->inslot = 0;
+        Pthread_mutex_unlock(&s->lk);
+        free(n);
+    }
+}
+
+void bdb_tablelock_fast_inherit(u_int32_t child, u_int32_t parent)
+{
+    struct tbllk_bucket *cb, *pb;
+    struct tbllk_node *n, *tmp;
+
+    if (!bdb_tablelock_fast_held(child))
+        return;
+    cb = tbllk_bucket(child);
+    pb = tbllk_bucket(parent);
+    for (;;) {
+        if (cb < pb) {
+            Pthread_mutex_lock(&cb->lk);
+            Pthread_mutex_lock(&pb->lk);
+        } else if (cb > pb) {
+            Pthread_mutex_lock(&pb->lk);
+            Pthread_mutex_lock(&cb->lk);
+        } else {
+            Pthread_mutex_lock(&cb->lk);
+        }
+        if (!bucket_inflating(cb, child))
+            break;
+        /* the other bucket isn't held across the wait: the locker the
+         * node waits on in berkdb may need it to let go */
+        if (cb != pb)
+            Pthread_mutex_unlock(&pb->lk);
+        Pthread_cond_wait(&cb->cond, &cb->lk);
+        Pthread_mutex_unlock(&cb->lk);
+    }
+    LISTC_FOR_EACH_SAFE(&cb->nodes, n, tmp, blnk)
+    {
+        if (n->lid != child)
+            continue;
+        bucket_rem(cb, n);
+        XCHANGE32(n->lid, parent);
+        listc_abl(&pb->nodes, n);
+        n->inbucket = 1;
+        ATOMIC_ADD32(pb->count, 1);
+    }
+    if (cb != pb)
+        Pthread_mutex_unlock(&pb->lk);
+    Pthread_mutex_unlock(&cb->lk);
+}
@@ -17,11 +17,13 @@
 #include <alloca.h>
 
 #include <errno.h>
+#include <inttypes.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <strings.h>
+#include <time.h>
 #include <unistd.h>
 #include <assert.h>
 #include <openssl/rand.h>
@@ -50,8 +52,10 @@
 #include "locks_wrap.h"
 #include "bdb_int.h"
 #include "strbuf.h"
+#include "mem_governor.h"
 
 extern int recover_deadlock_simple(bdb_state_type *bdb_state);
+extern int db_is_stopped(void);
 
 #ifdef __GLIBC__
 extern int backtrace(void **, int);
@@ -148,6 +152,10 @@ struct temp_cursor {
     int ind;
     int keymalloclen;
     int datamalloclen;
+    /* skiplist position; if `deleted', the cursor sits just after `node'
+       (before the first row if `node' is NULL) */
+    struct skip_node *node;
+    int deleted;
 };
 
 typedef struct arr_elem {
@@ -192,13 +200,39 @@ typedef struct arr_elem {
    a temparray will fall back to a temptable.
    A temparray is more efficient than a temptable. Besides, it uses far
    less memory than a temptable for small and medium-sized requests. */
+
+/* A skiplist temptable keeps btree semantics (unique keys, ordered
+   cursors, unpacked-key searches) but holds its rows in memory, in an
+   arena of large blocks that is released all at once.  Once the arena
+   outgrows temptable_inmem_sz bytes, the rows are copied into a berkdb
+   temp btree and the table carries on as a regular temptable. */
 enum {
     TEMP_TABLE_TYPE_BTREE,
     TEMP_TABLE_TYPE_HASH,
     TEMP_TABLE_TYPE_LIST,
-    TEMP_TABLE_TYPE_ARRAY
+    TEMP_TABLE_TYPE_ARRAY,
+    TEMP_TABLE_TYPE_SKIPLIST
 };
 
+#define SKIPLIST_MAXLEVEL 16
+#define SKIPLIST_BLKSZ (64 * 1024)
+
+typedef struct skip_node {
+    int keylen;
+    int dtalen;
+    void *key;
+    void *dta;
+    struct skip_node *prev;
+    int level;
+    struct skip_node *next[1];
+} skip_node_t;
+
+typedef struct skip_blk {
+    struct skip_blk *next;
+    size_t used;
+    size_t size;
+} skip_blk_t;
+
 struct temp_table {
     DB_ENV *dbenv_temp;
 
@@ -227,6 +261,13 @@ struct temp_table {
        a tempcursor can reuse the same piece of memory. */
     int maxkeylen;
     int maxdatalen;
+
+    skip_node_t *skip_head;
+    skip_node_t *skip_tail;
+    int skip_level;
+    unsigned int skip_seed;
+    skip_blk_t *skip_blks;
+    unsigned long long skip_maxsz;
 };
 
 enum { TMPTBL_PRIORITY, TMPTBL_WAIT };
@@ -247,11 +288,38 @@ static int temp_table_compare(DB *db, const DBT *dbt1, const DBT *dbt2);
 
 /* refactored both insert and put code paths here */
 static int bdb_temp_table_insert_put(bdb_state_type *, struct temp_table *,
-                                     void *key, int keylen, void *data,
-                                     int dtalen, int *bdberr);
+                                     struct temp_cursor *, void *key,
+                                     int keylen, void *data, int dtalen,
+                                     void *unpacked, int *bdberr);
 
 void *bdb_temp_table_get_cur(struct temp_cursor *skippy) { return skippy->cur; }
 
+/* What an array or skiplist holds in memory is charged to the memory
+   governor as it is counted in inmemsz */
+static inline void temp_table_mem_add(struct temp_table *tbl, long long sz)
+{
+    tbl->inmemsz += sz;
+    memgov_charge(MEMGOV_TEMPTABLE, sz);
+}
+
+static inline void temp_table_mem_clear(struct temp_table *tbl)
+{
+    memgov_charge(MEMGOV_TEMPTABLE, -(long long)tbl->inmemsz);
+    tbl->inmemsz = 0;
+}
+
+/* Spill early when the governor asks, unless the table is too small for
+   spilling it to give much back */
+#define TEMP_TABLE_MEMGOV_MINSZ (64 * 1024)
+static int temp_table_mem_over(struct temp_table *tbl)
+{
+    if (tbl->inmemsz < TEMP_TABLE_MEMGOV_MINSZ ||
+        !memgov_over(MEMGOV_TEMPTABLE))
+        return 0;
+    memgov_spilled(MEMGOV_TEMPTABLE);
+    return 1;
+}
+
 static int histcmpfunc(const void *key1, const void *key2, int len)
 {
     return !pthread_equal(*(pthread_t *)key1, *(pthread_t *)key2);
@@ -266,8 +334,8 @@ hash_t *bdb_temp_table_histhash_init(void)
 static int bdb_temp_table_init_temp_db(bdb_state_type *bdb_state,
                                        struct temp_table *tbl, int *bdberr);
 
-static int create_temp_db_env(bdb_state_type *bdb_state, struct temp_table *tbl,
-                              int *bdberr)
+static int open_temp_db_env(bdb_state_type *bdb_state, struct temp_table *tbl,
+                            int *bdberr)
 {
     int rc;
     DB_ENV *dbenv_temp;
@@ -336,6 +404,276 @@ error:
     return rc;
 }
 
+/* Temp table environments kept ready.  Opening a berkdb environment, with
+ * its region and its cache, is most of what making a temp btree costs, and
+ * was done by whoever needed the btree: a query creating one, or spilling a
+ * skiplist, array or hash table to one.  The prewarm thread keeps
+ * temptable_prewarm of them open, each with an empty btree, and a table that
+ * needs one takes one off the ready list instead.  Only environments with the
+ * cache size tables are given now are handed out; the thread closes any left
+ * from an earlier temptable_cachesz.
+ *
+ * A btree with many rows is emptied by recreating it, which is slow enough to
+ * keep off the query closing its table as well: the environment is taken off
+ * the table, which goes back to the pool without one, and the thread empties
+ * it and puts it on the ready list, or closes it if the list is full. */
+
+int gbl_temptable_prewarm = 4;
+int gbl_temptable_async_cleanup = 1;
+
+/* a btree with this many rows is recreated rather than emptied row by row */
+#define TEMP_TABLE_TRUNCATE_ROWS 100
+
+struct temp_env {
+    DB_ENV *dbenv;
+    DB *db;
+    unsigned long long cachesz;
+    struct temp_env *next;
+};
+
+static pthread_mutex_t temp_env_lk = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t temp_env_cond = PTHREAD_COND_INITIALIZER;
+static struct temp_env *temp_env_ready; /* each with an empty btree */
+static int temp_env_nready;
+static struct temp_env *temp_env_dirty; /* taken off closed tables */
+static int temp_env_thd_running;
+static int64_t temp_env_hits;
+static int64_t temp_env_misses;
+static int64_t temp_env_cleaned;
+
+static unsigned long long temp_table_cachesz(bdb_state_type *bdb_state)
+{
+    unsigned long long cachesz = bdb_state->attr->temptable_cachesz;
+
+    /* 512k minimim cache */
+    if (cachesz < 524288)
+        cachesz = 524288;
+    return cachesz;
+}
+
+static struct temp_env *temp_env_open(bdb_state_type *bdb_state,
+                                      unsigned long long cachesz)
+{
+    struct temp_table stub = {0};
+    struct temp_env *e;
+    int bdberr = 0;
+
+    if ((e = calloc(1, sizeof(*e))) == NULL)
+        return NULL;
+    stub.cachesz = cachesz;
+    listc_init(&stub.cursors, offsetof(struct temp_cursor, lnk));
+    if (open_temp_db_env(bdb_state, &stub, &bdberr) != 0) {
+        free(e);
+        return NULL;
+    }
+    e->dbenv = stub.dbenv_temp;
+    e->db = stub.tmpdb;
+    e->db->app_private = NULL;
+    e->cachesz = cachesz;
+    return e;
+}
+
+static void temp_env_close(struct temp_env *e)
+{
+    if (e->db)
+        (void)e->db->close(e->db, 0);
+    (void)e->dbenv->close(e->dbenv, 0);
+    free(e);
+}
+
+/* Recreate the btree of an environment a closed table left behind */
+static int temp_env_clean(bdb_state_type *bdb_state, struct temp_env *e)
+{
+    struct temp_table stub = {0};
+    int bdberr = 0, rc;
+
+    stub.dbenv_temp = e->dbenv;
+    stub.tmpdb = e->db;
+    listc_init(&stub.cursors, offsetof(struct temp_cursor, lnk));
+    if ((rc = bdb_temp_table_init_temp_db(bdb_state, &stub, &bdberr)) != 0) {
+        e->db = NULL;
+        temp_env_close(e);
+        return rc;
+    }
+    e->db = stub.tmpdb;
+    e->db->app_private = NULL;
+    return 0;
+}
+
+/* Give tbl an environment and an empty btree.  One is taken off the ready
+   list if there is one of the right size. */
+static int create_temp_db_env(bdb_state_type *bdb_state, struct temp_table *tbl,
+                              int *bdberr)
+{
+    struct temp_env *e = NULL;
+
+    if (gbl_temptable_prewarm > 0) {
+        Pthread_mutex_lock(&temp_env_lk);
+        if (temp_env_ready && temp_env_ready->cachesz == tbl->cachesz) {
+            e = temp_env_ready;
+            temp_env_ready = e->next;
+            temp_env_nready--;
+            temp_env_hits++;
+        } else {
+            temp_env_misses++;
+        }
+        if (temp_env_nready < gbl_temptable_prewarm)
+            Pthread_cond_signal(&temp_env_cond);
+        Pthread_mutex_unlock(&temp_env_lk);
+    }
+    if (e == NULL)
+        return open_temp_db_env(bdb_state, tbl, bdberr);
+
+    tbl->dbenv_temp = e->dbenv;
+    tbl->tmpdb = e->db;
+    tbl->tmpdb->app_private = tbl;
+    tbl->rowid = 2;
+    tbl->num_mem_entries = 0;
+    free(e);
+    return 0;
+}
+
+/* Whether closing tbl should leave emptying its btree to the prewarm
+   thread; returns what to hand the environment over in */
+static struct temp_env *temp_env_defer(struct temp_table *tbl)
+{
+    if (!gbl_temptable_async_cleanup || !ATOMIC_LOAD32(temp_env_thd_running) ||
+        tbl->temp_table_type != TEMP_TABLE_TYPE_BTREE ||
+        tbl->dbenv_temp == NULL || tbl->tmpdb == NULL ||
+        tbl->num_mem_entries < TEMP_TABLE_TRUNCATE_ROWS)
+        return NULL;
+    return calloc(1, sizeof(struct temp_env));
+}
+
+static void temp_env_put_dirty(struct temp_table *tbl, struct temp_env *e)
+{
+    e->dbenv = tbl->dbenv_temp;
+    e->db = tbl->tmpdb;
+    e->db->app_private = NULL;
+    e->cachesz = tbl->cachesz;
+    tbl->dbenv_temp = NULL;
+    tbl->tmpdb = NULL;
+    tbl->num_mem_entries = 0;
+
+    Pthread_mutex_lock(&temp_env_lk);
+    e->next = temp_env_dirty;
+    temp_env_dirty = e;
+    Pthread_cond_signal(&temp_env_cond);
+    Pthread_mutex_unlock(&temp_env_lk);
+}
+
+/* One piece of the prewarm thread's work.  Expects temp_env_lk held, and
+   lets go of it while it opens, empties or closes an environment.  Returns 0
+   if there was nothing to do. */
+static int temp_env_work(bdb_state_type *bdb_state, unsigned long long cachesz)
+{
+    struct temp_env *e, **pe;
+
+    if ((e = temp_env_dirty) != NULL) {
+        temp_env_dirty = e->next;
+        Pthread_mutex_unlock(&temp_env_lk);
+        int rc = temp_env_clean(bdb_state, e);
+        Pthread_mutex_lock(&temp_env_lk);
+        if (rc == 0) {
+            e->next = temp_env_ready;
+            temp_env_ready = e;
+            temp_env_nready++;
+            temp_env_cleaned++;
+        }
+        return 1;
+    }
+
+    for (pe = &temp_env_ready; *pe; pe = &(*pe)->next) {
+        if ((*pe)->cachesz != cachesz)
+            break;
+    }
+    if (*pe == NULL && temp_env_nready > gbl_temptable_prewarm)
+        pe = &temp_env_ready;
+    if ((e = *pe) != NULL) {
+        *pe = e->next;
+        temp_env_nready--;
+        Pthread_mutex_unlock(&temp_env_lk);
+        temp_env_close(e);
+        Pthread_mutex_lock(&temp_env_lk);
+        return 1;
+    }
+
+    if (temp_env_nready < gbl_temptable_prewarm) {
+        Pthread_mutex_unlock(&temp_env_lk);
+        e = temp_env_open(bdb_state, cachesz);
+        Pthread_mutex_lock(&temp_env_lk);
+        if (e == NULL)
+            return 0; /* try again later */
+        e->next = temp_env_ready;
+        temp_env_ready = e;
+        temp_env_nready++;
+        return 1;
+    }
+    return 0;
+}
+
+void *bdb_temp_table_prewarm_thread(void *arg)
+{
+    bdb_state_type *bdb_state = (bdb_state_type *)arg;
+    struct temp_env *e;
+    struct timespec ts;
+
+    if (bdb_state->parent)
+        bdb_state = bdb_state->parent;
+
+    thread_started("bdb temptable prewarm");
+    bdb_thread_event(bdb_state, 1);
+
+    Pthread_mutex_lock(&temp_env_lk);
+    XCHANGE32(temp_env_thd_running, 1);
+    while (!db_is_stopped()) {
+        if (temp_env_work(bdb_state, temp_table_cachesz(bdb_state)))
+            continue;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec++;
+        pthread_cond_timedwait(&temp_env_cond, &temp_env_lk, &ts);
+    }
+    /* closed tables empty their own btrees from here on */
+    XCHANGE32(temp_env_thd_running, 0);
+    while ((e = temp_env_dirty) != NULL || (e = temp_env_ready) != NULL) {
+        if (e == temp_env_dirty) {
+            temp_env_dirty = e->next;
+        } else {
+            temp_env_ready = e->next;
+            temp_env_nready--;
+        }
+        Pthread_mutex_unlock(&temp_env_lk);
+        temp_env_close(e);
+        Pthread_mutex_lock(&temp_env_lk);
+    }
+    Pthread_mutex_unlock(&temp_env_lk);
+
+    bdb_thread_event(bdb_state, 0);
+    return NULL;
+}
+
+void bdb_temp_table_prewarm_report(void)
+{
+    int nready, ndirty = 0;
+    int64_t hits, misses, cleaned;
+    struct temp_env *e;
+
+    Pthread_mutex_lock(&temp_env_lk);
+    nready = temp_env_nready;
+    for (e = temp_env_dirty; e; e = e->next)
+        ndirty++;
+    hits = temp_env_hits;
+    misses = temp_env_misses;
+    cleaned = temp_env_cleaned;
+    Pthread_mutex_unlock(&temp_env_lk);
+
+    logmsg(LOGMSG_USER,
+           "temptable prewarm: %d ready of %d, %d to empty, %" PRId64
+           " taken ready, %" PRId64 " opened on demand, %" PRId64
+           " emptied in the background\n",
+           nready, gbl_temptable_prewarm, ndirty, hits, misses, cleaned);
+}
+
 static int bdb_array_copy_to_temp_db(bdb_state_type *bdb_state,
                                      struct temp_table *tbl, int *bdberr)
 {
@@ -373,7 +711,7 @@ static int bdb_array_copy_to_temp_db(bdb_state_type *bdb_state,
         free(elem->key);
         free(elem->dta);
     }
-    tbl->inmemsz = 0;
+    temp_table_mem_clear(tbl);
     tbl->num_mem_entries = nents;
 
     /* its now a btree! */
@@ -481,6 +819,328 @@ done:
     return rc;
 }
 
+/* Carve `sz' bytes out of the table's arena.  Small allocations share
+   the current block; oversized ones get a block of their own that is
+   linked behind it so the current block keeps filling. */
+static void *skip_alloc(struct temp_table *tbl, size_t sz)
+{
+    skip_blk_t *blk = tbl->skip_blks;
+    void *p;
+
+    sz = (sz + 7) & ~(size_t)7;
+    if (sz > SKIPLIST_BLKSZ / 4) {
+        blk = malloc(sizeof(skip_blk_t) + sz);
+        if (blk == NULL)
+            return NULL;
+        blk->size = blk->used = sz;
+        if (tbl->skip_blks) {
+            blk->next = tbl->skip_blks->next;
+            tbl->skip_blks->next = blk;
+        } else {
+            blk->next = NULL;
+            tbl->skip_blks = blk;
+        }
+        temp_table_mem_add(tbl, sz);
+        return blk + 1;
+    }
+
+    if (blk == NULL || blk->used + sz > blk->size) {
+        blk = malloc(sizeof(skip_blk_t) + SKIPLIST_BLKSZ);
+        if (blk == NULL)
+            return NULL;
+        blk->size = SKIPLIST_BLKSZ;
+        blk->used = 0;
+        blk->next = tbl->skip_blks;
+        tbl->skip_blks = blk;
+        temp_table_mem_add(tbl, SKIPLIST_BLKSZ);
+    }
+    p = (char *)(blk + 1) + blk->used;
+    blk->used += sz;
+    return p;
+}
+
+static void skip_free_all(struct temp_table *tbl)
+{
+    skip_blk_t *blk, *next;
+    struct temp_cursor *cur;
+
+    for (blk = tbl->skip_blks; blk; blk = next) {
+        next = blk->next;
+        free(blk);
+    }
+    tbl->skip_blks = NULL;
+    tbl->skip_head = tbl->skip_tail = NULL;
+    tbl->skip_level = 0;
+    temp_table_mem_clear(tbl);
+    tbl->num_mem_entries = 0;
+
+    LISTC_FOR_EACH(&tbl->cursors, cur, lnk)
+    {
+        cur->node = NULL;
+        cur->deleted = 0;
+    }
+}
+
+static int skip_init(struct temp_table *tbl)
+{
+    size_t sz = offsetof(skip_node_t, next) +
+                SKIPLIST_MAXLEVEL * sizeof(skip_node_t *);
+
+    tbl->skip_head = skip_alloc(tbl, sz);
+    if (tbl->skip_head == NULL)
+        return -1;
+    memset(tbl->skip_head, 0, sz);
+    tbl->skip_head->level = SKIPLIST_MAXLEVEL;
+    tbl->skip_tail = NULL;
+    tbl->skip_level = 1;
+    return 0;
+}
+
+/* p = 1/4 per level, from a per-table xorshift */
+static int skip_random_level(struct temp_table *tbl)
+{
+    unsigned int x = tbl->skip_seed;
+    int level = 1;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    tbl->skip_seed = x;
+    while ((x & 3) == 0 && level < SKIPLIST_MAXLEVEL) {
+        level++;
+        x >>= 2;
+    }
+    return level;
+}
+
+/* Compare a row against a search key, the same way temp_table_compare
+   does for the berkdb btree. */
+static inline int skip_cmp(struct temp_table *tbl, skip_node_t *n,
+                           const void *key, int keylen, void *unpacked)
+{
+    if (unpacked)
+        return tbl->cmpfunc(NULL, n->keylen, n->key, -1, unpacked);
+    return tbl->cmpfunc(tbl->usermem, n->keylen, n->key, keylen, key);
+}
+
+/* Return the first row not less than `key'.  If `update' is given, it
+   receives the last node before that row on every level. */
+static skip_node_t *skip_seek(struct temp_table *tbl, const void *key,
+                              int keylen, void *unpacked,
+                              skip_node_t **update)
+{
+    skip_node_t *x = tbl->skip_head;
+    int i;
+
+    for (i = tbl->skip_level - 1; i >= 0; --i) {
+        while (x->next[i] &&
+               skip_cmp(tbl, x->next[i], key, keylen, unpacked) < 0)
+            x = x->next[i];
+        if (update)
+            update[i] = x;
+    }
+    return x->next[0];
+}
+
+/* Insert a row.  A row with an equal key has its payload replaced, which
+   is what a put into the (non-dup) berkdb btree does. */
+static int skip_insert(struct temp_table *tbl, void *key, int keylen,
+                       void *data, int dtalen, void *unpacked,
+                       skip_node_t **out)
+{
+    skip_node_t *update[SKIPLIST_MAXLEVEL], *n;
+    size_t nodesz;
+    int level, i;
+
+    if (tbl->skip_head == NULL && skip_init(tbl) != 0)
+        return -1;
+
+    n = skip_seek(tbl, key, keylen, unpacked, update);
+    if (n && skip_cmp(tbl, n, key, keylen, unpacked) == 0) {
+        if (dtalen > n->dtalen && (n->dta = skip_alloc(tbl, dtalen)) == NULL)
+            return -1;
+        memcpy(n->dta, data, dtalen);
+        n->dtalen = dtalen;
+        *out = n;
+        return 0;
+    }
+
+    level = skip_random_level(tbl);
+    nodesz = offsetof(skip_node_t, next) + level * sizeof(skip_node_t *);
+    nodesz = (nodesz + 7) & ~(size_t)7;
+    n = skip_alloc(tbl, nodesz + ((keylen + 7) & ~7) + dtalen);
+    if (n == NULL)
+        return -1;
+    n->keylen = keylen;
+    n->dtalen = dtalen;
+    n->key = (char *)n + nodesz;
+    n->dta = (char *)n->key + ((keylen + 7) & ~7);
+    n->level = level;
+    memcpy(n->key, key, keylen);
+    memcpy(n->dta, data, dtalen);
+
+    if (level > tbl->skip_level) {
+        for (i = tbl->skip_level; i < level; ++i)
+            update[i] = tbl->skip_head;
+        tbl->skip_level = level;
+    }
+    for (i = 0; i < level; ++i) {
+        n->next[i] = update[i]->next[i];
+        update[i]->next[i] = n;
+    }
+    n->prev = (update[0] == tbl->skip_head) ? NULL : update[0];
+    if (n->next[0])
+        n->next[0]->prev = n;
+    else
+        tbl->skip_tail = n;
+
+    ++tbl->num_mem_entries;
+    if (keylen > tbl->maxkeylen)
+        tbl->maxkeylen = keylen;
+    if (dtalen > tbl->maxdatalen)
+        tbl->maxdatalen = dtalen;
+    *out = n;
+    return 0;
+}
+
+/* Unlink a row.  Its memory stays in the arena; cursors sitting on it
+   are left just after its predecessor, as a berkdb cursor is after c_del. */
+static void skip_delete(struct temp_table *tbl, skip_node_t *n)
+{
+    skip_node_t *update[SKIPLIST_MAXLEVEL], *x = tbl->skip_head;
+    struct temp_cursor *cur;
+    int i;
+
+    for (i = tbl->skip_level - 1; i >= 0; --i) {
+        while (x->next[i] && x->next[i] != n &&
+               skip_cmp(tbl, x->next[i], n->key, n->keylen, NULL) < 0)
+            x = x->next[i];
+        update[i] = x;
+    }
+    for (i = 0; i < n->level && i < tbl->skip_level; ++i) {
+        if (update[i]->next[i] == n)
+            update[i]->next[i] = n->next[i];
+    }
+    if (n->next[0])
+        n->next[0]->prev = n->prev;
+    else
+        tbl->skip_tail = n->prev;
+    while (tbl->skip_level > 1 &&
+           tbl->skip_head->next[tbl->skip_level - 1] == NULL)
+        --tbl->skip_level;
+    --tbl->num_mem_entries;
+
+    LISTC_FOR_EACH(&tbl->cursors, cur, lnk)
+    {
+        if (cur->node == n) {
+            cur->node = n->prev;
+            cur->deleted = 1;
+        }
+    }
+}
+
+/* Position `cur' on `n', copying the row out like a berkdb get would. */
+static int skip_to_cur(struct temp_cursor *cur, skip_node_t *n)
+{
+    cur->valid = 0;
+    cur->node = n;
+    cur->deleted = 0;
+    if (n == NULL)
+        return IX_PASTEOF;
+
+    if (cur->key == NULL || cur->keymalloclen < n->keylen) {
+        void *p = realloc(cur->key, n->keylen ? n->keylen : 1);
+        if (p == NULL)
+            return -1;
+        cur->key = p;
+        cur->keymalloclen = n->keylen;
+    }
+    if (cur->data == NULL || cur->datamalloclen < n->dtalen) {
+        void *p = realloc(cur->data, n->dtalen ? n->dtalen : 1);
+        if (p == NULL)
+            return -1;
+        cur->data = p;
+        cur->datamalloclen = n->dtalen;
+    }
+    cur->keylen = n->keylen;
+    cur->datalen = n->dtalen;
+    memcpy(cur->key, n->key, n->keylen);
+    memcpy(cur->data, n->dta, n->dtalen);
+    cur->valid = 1;
+    return 0;
+}
+
+/* Move the rows of a skiplist temptable into a berkdb temp btree and
+   reposition every open cursor on the row it was on. */
+static int bdb_skiplist_copy_to_temp_db(bdb_state_type *bdb_state,
+                                        struct temp_table *tbl, int *bdberr)
+{
+    int rc = 0;
+    DBT dbt_key, dbt_data;
+    struct temp_cursor *cur;
+    skip_node_t *n;
+    unsigned long long nents = tbl->num_mem_entries;
+
+    if (tbl->dbenv_temp == NULL &&
+        (rc = create_temp_db_env(bdb_state, tbl, bdberr)) != 0)
+        return rc;
+
+    bzero(&dbt_key, sizeof(DBT));
+    bzero(&dbt_data, sizeof(DBT));
+    dbt_key.flags = dbt_data.flags = DB_DBT_USERMEM;
+    for (n = tbl->skip_head ? tbl->skip_head->next[0] : NULL; n;
+         n = n->next[0]) {
+        dbt_key.ulen = dbt_key.size = n->keylen;
+        dbt_data.ulen = dbt_data.size = n->dtalen;
+        dbt_key.data = n->key;
+        dbt_data.data = n->dta;
+
+        rc = tbl->tmpdb->put(tbl->tmpdb, NULL, &dbt_key, &dbt_data, 0);
+        if (rc) {
+            logmsg(LOGMSG_ERROR, "%s:%d put rc %d\n", __FILE__, __LINE__, rc);
+            *bdberr = rc;
+            return rc;
+        }
+    }
+
+    /* its now a btree! */
+    tbl->temp_table_type = TEMP_TABLE_TYPE_BTREE;
+
+    /* A cursor left after a deleted row is put on the row before it,
+       so a following next still returns the right row. */
+    LISTC_FOR_EACH(&tbl->cursors, cur, lnk)
+    {
+        if (cur->cur == NULL &&
+            (rc = tbl->tmpdb->cursor(tbl->tmpdb, NULL, &cur->cur, 0)) != 0) {
+            cur->cur = NULL;
+            logmsg(LOGMSG_ERROR, "%s:%d cursor rc %d\n", __FILE__, __LINE__,
+                   rc);
+            *bdberr = rc;
+            break;
+        }
+        if (cur->node == NULL)
+            continue;
+
+        bzero(&dbt_key, sizeof(DBT));
+        bzero(&dbt_data, sizeof(DBT));
+        dbt_key.flags = DB_DBT_USERMEM;
+        dbt_key.ulen = dbt_key.size = cur->node->keylen;
+        dbt_key.data = cur->node->key;
+        dbt_data.flags = DB_DBT_USERMEM | DB_DBT_PARTIAL;
+        rc = cur->cur->c_get(cur->cur, &dbt_key, &dbt_data, DB_SET);
+        if (rc) {
+            logmsg(LOGMSG_ERROR, "%s:%d c_get rc %d\n", __FILE__, __LINE__,
+                   rc);
+            *bdberr = rc;
+            break;
+        }
+    }
+
+    skip_free_all(tbl);
+    tbl->num_mem_entries = nents;
+    return rc;
+}
+
 static int bdb_temp_table_init_temp_db(bdb_state_type *bdb_state,
                                        struct temp_table *tbl, int *bdberr)
 {
@@ -588,11 +1248,7 @@ static struct temp_table *bdb_temp_table_create_main(bdb_state_type *bdb_state,
         if (sql) tbl->sql = strdup(sql);
     }
 
-    tbl->cachesz = bdb_state->attr->temptable_cachesz;
-
-    /* 512k minimim cache */
-    if (tbl->cachesz < 524288)
-        tbl->cachesz = 524288;
+    tbl->cachesz = temp_table_cachesz(bdb_state);
 
     if (gbl_temptable_pool_capacity == 0) {
         Pthread_mutex_lock(&parent->temp_list_lock);
@@ -762,6 +1418,12 @@ static struct temp_table *bdb_temp_table_create_type(bdb_state_type *bdb_state,
     if (table != NULL) {
         table->num_mem_entries = 0;
         table->cmpfunc = key_memcmp;
+        if (temp_table_type == TEMP_TABLE_TYPE_SKIPLIST) {
+            table->skip_maxsz = bdb_state->attr->temptable_inmem_sz;
+            table->skip_seed = (table->tblid + 1) * 2654435761U;
+            if (table->skip_maxsz == 0)
+                temp_table_type = TEMP_TABLE_TYPE_BTREE;
+        }
         table->temp_table_type = temp_table_type;
 
         if (temp_table_type == TEMP_TABLE_TYPE_BTREE &&
@@ -780,14 +1442,17 @@ struct temp_table *bdb_temp_table_create_flags(bdb_state_type *bdb_state,
 {
     int temptype;
 
-    temptype = TEMP_TABLE_TYPE_BTREE;
+    if (flags & BDB_TEMP_TABLE_DONT_USE_INMEM)
+        temptype = TEMP_TABLE_TYPE_BTREE;
+    else
+        temptype = TEMP_TABLE_TYPE_SKIPLIST;
 
     return bdb_temp_table_create_type(bdb_state, temptype, bdberr);
 }
 
 struct temp_table *bdb_temp_table_create(bdb_state_type *bdb_state, int *bdberr)
 {
-    return bdb_temp_table_create_type(bdb_state, TEMP_TABLE_TYPE_BTREE, bdberr);
+    return bdb_temp_table_create_flags(bdb_state, 0, bdberr);
 }
 
 struct temp_table *bdb_temp_list_create(bdb_state_type *bdb_state, int *bdberr)
@@ -838,6 +1503,11 @@ struct temp_cursor *bdb_temp_table_cursor(bdb_state_type *bdb_state,
     case TEMP_TABLE_TYPE_ARRAY:
         cur->ind = 0;
         break;
+
+    case TEMP_TABLE_TYPE_SKIPLIST:
+        cur->node = NULL;
+        cur->deleted = 0;
+        break;
     }
 
     if (rc) {
@@ -870,8 +1540,8 @@ int bdb_temp_table_insert(bdb_state_type *bdb_state, struct temp_cursor *cur,
     DBT dkey, ddata;
     struct temp_table *tbl = cur->tbl;
 
-    int rc = bdb_temp_table_insert_put(bdb_state, tbl, key, keylen, data,
-                                       dtalen, bdberr);
+    int rc = bdb_temp_table_insert_put(bdb_state, tbl, cur, key, keylen, data,
+                                       dtalen, NULL, bdberr);
     if (rc <= 0)
         goto done;
 
@@ -925,7 +1595,7 @@ int bdb_temp_table_update(bdb_state_type *bdb_state, struct temp_cursor *cur,
         elem = &cur->tbl->elements[cur->ind];
         free(elem->key);
         free(elem->dta);
-        cur->tbl->inmemsz -= (elem->keylen + elem->dtalen);
+        temp_table_mem_add(cur->tbl, -(long long)(elem->keylen + elem->dtalen));
 
         /* malloc and copy */
         keycopy = malloc(keylen);
@@ -944,7 +1614,7 @@ int bdb_temp_table_update(bdb_state_type *bdb_state, struct temp_cursor *cur,
         elem->key = keycopy;
         elem->dtalen = dtalen;
         elem->dta = dtacopy;
-        cur->tbl->inmemsz += (elem->keylen + elem->dtalen);
+        temp_table_mem_add(cur->tbl, elem->keylen + elem->dtalen);
     }
 
     REOPEN_CURSOR(cur);
@@ -985,8 +1655,8 @@ int bdb_temp_table_put(bdb_state_type *bdb_state, struct temp_table *tbl,
 {
     DBT dkey, ddata;
 
-    int rc = bdb_temp_table_insert_put(bdb_state, tbl, key, keylen, data,
-                                       dtalen, bdberr);
+    int rc = bdb_temp_table_insert_put(bdb_state, tbl, NULL, key, keylen,
+                                       data, dtalen, unpacked, bdberr);
     if (rc <= 0)
         goto done;
 
@@ -1071,6 +1741,15 @@ static int bdb_temp_table_first_last(bdb_state_type *bdb_state,
         return 0;
     }
 
+    if (cur->tbl->temp_table_type == TEMP_TABLE_TYPE_SKIPLIST) {
+        if (cur->tbl->num_mem_entries == 0) {
+            cur->valid = 0;
+            return IX_EMPTY;
+        }
+        return skip_to_cur(cur, (how == DB_LAST) ? cur->tbl->skip_tail
+                                                 : cur->tbl->skip_head->next[0]);
+    }
+
     REOPEN_CURSOR(cur);
 
     /*Pthread_setspecific(cur->tbl->curkey, cur);*/
@@ -1168,6 +1847,19 @@ static int bdb_temp_table_next_prev_norewind(bdb_state_type *bdb_state,
         return 0;
     }
 
+    if (cur->tbl->temp_table_type == TEMP_TABLE_TYPE_SKIPLIST) {
+        skip_node_t *n = cur->node;
+        if (how == DB_NEXT) {
+            if (n == NULL)
+                n = cur->tbl->skip_head ? cur->tbl->skip_head->next[0] : NULL;
+            else
+                n = n->next[0];
+        } else if (!cur->deleted && n) {
+            n = n->prev;
+        }
+        return skip_to_cur(cur, n);
+    }
+
     REOPEN_CURSOR(cur);
 
     /*Pthread_setspecific(cur->tbl->curkey, cur);*/
@@ -1431,13 +2123,17 @@ int bdb_temp_table_truncate(bdb_state_type *bdb_state, struct temp_table *tbl,
             free(elem->key);
             free(elem->dta);
         }
-        tbl->inmemsz = 0;
+        temp_table_mem_clear(tbl);
         tbl->num_mem_entries = 0;
         break;
 
+    case TEMP_TABLE_TYPE_SKIPLIST:
+        skip_free_all(tbl);
+        break;
+
     case TEMP_TABLE_TYPE_BTREE:
 
-        if (tbl->num_mem_entries < 100)
+        if (tbl->num_mem_entries < TEMP_TABLE_TRUNCATE_ROWS)
             rc = bdb_temp_table_truncate_temp_db(bdb_state, tbl, bdberr);
         else
             rc = bdb_temp_table_init_temp_db(bdb_state, tbl, bdberr);
@@ -1456,12 +2152,34 @@ done:
     return rc;
 }
 
+/* Close tbl's cursors and empty it, for its owner to use it again as it
+   was, compare function and all.  An array that has spilled to a btree has
+   its own environment to hold on to and is left alone for the owner to
+   close; that returns 1. */
+int bdb_temp_table_reset(bdb_state_type *bdb_state, struct temp_table *tbl,
+                         int *bdberr)
+{
+    struct temp_cursor *cur, *temp;
+    int rc;
+
+    if (tbl->temp_table_type != TEMP_TABLE_TYPE_ARRAY)
+        return 1;
+
+    LISTC_FOR_EACH_SAFE(&tbl->cursors, cur, temp, lnk)
+    {
+        if ((rc = bdb_temp_table_close_cursor(bdb_state, cur, bdberr)) != 0)
+            return rc;
+    }
+    return bdb_temp_table_truncate(bdb_state, tbl, bdberr);
+}
+
 /* XXX todo - call bdb_temp_table_truncate() and put on a list at parent
    bdb_state */
 int bdb_temp_table_close(bdb_state_type *bdb_state, struct temp_table *tbl,
                          int *bdberr)
 {
     struct temp_cursor *cur, *temp;
+    struct temp_env *deferred;
     DB_MPOOL_STAT *tmp;
     int rc;
 
@@ -1482,11 +2200,13 @@ int bdb_temp_table_close(bdb_state_type *bdb_state, struct temp_table *tbl,
         }
     }
 
-    rc = bdb_temp_table_truncate(bdb_state, tbl, bdberr);
+    if ((deferred = temp_env_defer(tbl)) == NULL) {
+        rc = bdb_temp_table_truncate(bdb_state, tbl, bdberr);
 
-    if (rc != 0) {
-        logmsg(LOGMSG_ERROR, "%s: bdb_temp_table_truncate rc = %d\n",
-               __func__, rc);
+        if (rc != 0) {
+            logmsg(LOGMSG_ERROR, "%s: bdb_temp_table_truncate rc = %d\n",
+                   __func__, rc);
+        }
     }
 
     if (tbl->dbenv_temp != NULL) {
@@ -1542,6 +2262,9 @@ int bdb_temp_table_close(bdb_state_type *bdb_state, struct temp_table *tbl,
         Pthread_mutex_unlock(&(bdb_state->temp_list_lock));
     }
 
+    if (deferred)
+        temp_env_put_dirty(tbl, deferred);
+
     if (gbl_temptable_pool_capacity > 0) {
         rc = comdb2_objpool_return(bdb_state->temp_table_pool, tbl);
     } else {
@@ -1663,6 +2386,11 @@ int bdb_temp_table_destroy_lru(struct temp_table *tbl,
             free(elem->key);
             free(elem->dta);
         }
+        temp_table_mem_clear(tbl);
+        break;
+
+    case TEMP_TABLE_TYPE_SKIPLIST:
+        skip_free_all(tbl);
         break;
 
     case TEMP_TABLE_TYPE_BTREE:
@@ -1733,13 +2461,23 @@ int bdb_temp_table_delete(bdb_state_type *bdb_state, struct temp_cursor *cur,
         free(elem->key);
         free(elem->dta);
         --cur->tbl->num_mem_entries;
-        cur->tbl->inmemsz -= (elem->keylen + elem->dtalen);
+        temp_table_mem_add(cur->tbl, -(long long)(elem->keylen + elem->dtalen));
         memmove(elem, elem + 1,
                 sizeof(arr_elem_t) * (cur->tbl->num_mem_entries - cur->ind));
         rc = 0;
         goto done;
     }
 
+    if (cur->tbl->temp_table_type == TEMP_TABLE_TYPE_SKIPLIST) {
+        if (cur->node == NULL || cur->deleted) {
+            rc = -1;
+            goto done;
+        }
+        skip_delete(cur->tbl, cur->node);
+        rc = 0;
+        goto done;
+    }
+
     REOPEN_CURSOR(cur);
 
     rc = cur->cur->c_del(cur->cur, 0);
@@ -1888,6 +2626,19 @@ int bdb_temp_table_find(bdb_state_type *bdb_state, struct temp_cursor *cur,
         return 0;
     }
 
+    if (cur->tbl->temp_table_type == TEMP_TABLE_TYPE_SKIPLIST) {
+        skip_node_t *n;
+        if (cur->tbl->num_mem_entries == 0) {
+            cur->valid = 0;
+            return IX_EMPTY;
+        }
+        n = skip_seek(cur->tbl, key, keylen, unpacked, NULL);
+        /* find anything at all if possible */
+        if (n == NULL)
+            return bdb_temp_table_last(bdb_state, cur, bdberr);
+        return skip_to_cur(cur, n);
+    }
+
     REOPEN_CURSOR(cur);
 
     /*Pthread_setspecific(cur->tbl->curkey, cur);*/
@@ -2042,6 +2793,17 @@ int bdb_temp_table_find_exact(bdb_state_type *bdb_state,
         return 0;
     }
 
+    if (cur->tbl->temp_table_type == TEMP_TABLE_TYPE_SKIPLIST) {
+        skip_node_t *n = NULL;
+        if (cur->tbl->num_mem_entries != 0)
+            n = skip_seek(cur->tbl, key, keylen, NULL, NULL);
+        if (n == NULL || skip_cmp(cur->tbl, n, key, keylen, NULL) != 0) {
+            cur->valid = 0;
+            return IX_NOTFND;
+        }
+        return skip_to_cur(cur, n) ? -1 : IX_FND;
+    }
+
     REOPEN_CURSOR(cur);
 
     /*Pthread_setspecific(cur->tbl->curkey, cur);*/
@@ -2123,7 +2885,8 @@ int bdb_temp_table_close_cursor(bdb_state_type *bdb_state,
     tbl = cur->tbl;
 
     if (cur->tbl->temp_table_type == TEMP_TABLE_TYPE_BTREE ||
-        cur->tbl->temp_table_type == TEMP_TABLE_TYPE_ARRAY) {
+        cur->tbl->temp_table_type == TEMP_TABLE_TYPE_ARRAY ||
+        cur->tbl->temp_table_type == TEMP_TABLE_TYPE_SKIPLIST) {
         if (cur->key) {
             free(cur->key);
             cur->key = NULL;
@@ -2284,9 +3047,10 @@ int bdb_temp_table_maybe_reset_priority_thread(bdb_state_type *bdb_state,
 }
 
 static int bdb_temp_table_insert_put(bdb_state_type *bdb_state,
-                                     struct temp_table *tbl, void *key,
+                                     struct temp_table *tbl,
+                                     struct temp_cursor *cur, void *key,
                                      int keylen, void *data, int dtalen,
-                                     int *bdberr)
+                                     void *unpacked, int *bdberr)
 {
     int rc, cmp, lo, hi, mid;
     tmptbl_cmp cmpfn;
@@ -2380,10 +3144,10 @@ static int bdb_temp_table_insert_put(bdb_state_type *bdb_state,
         elem->dta = dtacopy;
 
         ++tbl->num_mem_entries;
-        tbl->inmemsz += (keylen + dtalen);
+        temp_table_mem_add(tbl, keylen + dtalen);
 
         if (tbl->num_mem_entries == tbl->max_mem_entries ||
-            tbl->inmemsz > tbl->cachesz) {
+            tbl->inmemsz > tbl->cachesz || temp_table_mem_over(tbl)) {
             gbl_temptable_spills++;
             rc = bdb_array_copy_to_temp_db(bdb_state, tbl, bdberr);
             if (unlikely(rc)) {
@@ -2399,6 +3163,29 @@ static int bdb_temp_table_insert_put(bdb_state_type *bdb_state,
         return 0;
     }
 
+    if (tbl->temp_table_type == TEMP_TABLE_TYPE_SKIPLIST) {
+        skip_node_t *n;
+
+        if (skip_insert(tbl, key, keylen, data, dtalen, unpacked, &n) != 0)
+            return -1;
+
+        /* like c_put, leave the inserting cursor on the new row */
+        if (cur) {
+            cur->node = n;
+            cur->deleted = 0;
+        }
+
+        if (tbl->inmemsz > tbl->skip_maxsz || temp_table_mem_over(tbl)) {
+            gbl_temptable_spills++;
+            rc = bdb_skiplist_copy_to_temp_db(bdb_state, tbl, bdberr);
+            if (unlikely(rc)) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
     assert (tbl->temp_table_type == TEMP_TABLE_TYPE_BTREE);
     tbl->num_mem_entries++;
 
@@ -50,6 +50,8 @@
 #include <memory_sync.h>
 #include <autoanalyze.h>
 #include <logmsg.h>
+#include "phys_rep_lsn.h"
+#include "comdb2_pthread_create.h"
 
 extern int db_is_stopped(void);
 extern int send_myseqnum_to_master_udp(bdb_state_type *bdb_state);
@@ -126,6 +128,7 @@ void *memp_trickle_thread(void *arg)
         sleep(1);
 
     thread_started("bdb memptrickle");
+    comdb2_thread_set_affinity(COMDB2_THR_CLASS_BDB, NULL);
 
     bdb_thread_event(bdb_state, 1);
 
@@ -164,6 +167,70 @@ void *memp_trickle_thread(void *arg)
     return NULL;
 }
 
+/* Keeps spare log files ready for log switches, see log_prealloc_files */
+void *log_prealloc_thread(void *arg)
+{
+    bdb_state_type *bdb_state;
+
+    bdb_state = (bdb_state_type *)arg;
+    if (bdb_state->parent)
+        bdb_state = bdb_state->parent;
+
+    while (!bdb_state->passed_dbenv_open)
+        sleep(1);
+
+    thread_started("bdb log prealloc");
+    bdb_thread_event(bdb_state, 1);
+
+    while (!db_is_stopped()) {
+        bdb_state->dbenv->log_prealloc(bdb_state->dbenv);
+        sleep(1);
+    }
+
+    bdb_thread_event(bdb_state, 0);
+    return NULL;
+}
+
+/* Page compaction only looks at the pages reads happen to bring in.  This
+   walks all the btrees slowly so that the sparse pages of indexes nobody
+   reads, typically after a big delete, get merged as well. */
+void *pgcompact_sweep_thread(void *arg)
+{
+    bdb_state_type *bdb_state;
+    repinfo_type *repinfo;
+    int rate, nsparse;
+
+    bdb_state = (bdb_state_type *)arg;
+    if (bdb_state->parent)
+        bdb_state = bdb_state->parent;
+    repinfo = bdb_state->repinfo;
+
+    while (!bdb_state->passed_dbenv_open)
+        sleep(1);
+
+    thread_started("bdb pgcompact sweep");
+    bdb_thread_event(bdb_state, 1);
+
+    while (!db_is_stopped()) {
+        rate = bdb_state->attr->page_compact_sweep_rate;
+        if (rate <= 0 || repinfo->master_host != repinfo->myhost) {
+            sleep(1);
+            continue;
+        }
+
+        /* a tenth of a second's worth at a time */
+        BDB_READLOCK("pgcompact_sweep_thread");
+        bdb_state->dbenv->memp_sweep_sparse(bdb_state->dbenv, (rate + 9) / 10,
+                                            &nsparse);
+        BDB_RELLOCK();
+
+        poll(NULL, 0, 100);
+    }
+
+    bdb_thread_event(bdb_state, 0);
+    return NULL;
+}
+
 void *deadlockdetect_thread(void *arg)
 {
     bdb_state_type *bdb_state;
@@ -364,6 +431,7 @@ void *logdelete_thread(void *arg)
 
         if ((now - last_run_time) >= run_interval) {
             delete_log_files(bdb_state);
+            bdb_log_index_update(bdb_state);
             last_run_time = now;
         }
         sleep(1);
@@ -382,8 +450,74 @@ int64_t gbl_last_checkpoint_ms;
 int64_t gbl_total_checkpoint_ms;
 int gbl_checkpoint_count;
 int gbl_cache_flush_interval = 30;
+int gbl_load_cache_at_startup = 0;
 int backend_opened(void);
 
+/* Warm the bufferpool from the saved pagelist once the tables are open. */
+static void *load_cache_thd(void *arg)
+{
+    bdb_state_type *bdb_state = arg;
+
+    thread_started("bdb load cache");
+    bdb_thread_event(bdb_state, BDBTHR_EVENT_START_RDONLY);
+    bdb_state->dbenv->memp_load_default(bdb_state->dbenv);
+    bdb_thread_event(bdb_state, BDBTHR_EVENT_DONE_RDONLY);
+    return NULL;
+}
+
+void create_load_cache_thread(bdb_state_type *bdb_state)
+{
+    pthread_t thread_id;
+    pthread_attr_t thd_attr;
+
+    if (bdb_state->parent)
+        bdb_state = bdb_state->parent;
+
+    Pthread_attr_init(&thd_attr);
+    Pthread_attr_setstacksize(&thd_attr, 128 * 1024);
+    Pthread_attr_setdetachstate(&thd_attr, PTHREAD_CREATE_DETACHED);
+
+    int rc = pthread_create(&thread_id, &thd_attr, load_cache_thd, bdb_state);
+    if (rc != 0)
+        logmsg(LOGMSG_ERROR, "%s: pthread_create: %s\n", __func__,
+               strerror(rc));
+    Pthread_attr_destroy(&thd_attr);
+}
+
+/* Write out this poll's share of the dirty pages.  The share is what it
+   takes to be done by the next checkpoint, which comes when its time is up
+   or when the log moves to a new file, whichever is sooner at the rate the
+   log grew since the last poll.  Writing the oldest first-dirtied pages
+   lets the checkpoint LSN move up without the checkpoint having to flush
+   them itself. */
+static void fuzzy_checkpoint(bdb_state_type *bdb_state, int poll_ms,
+                             long long left_ms, const DB_LSN *lastlsn,
+                             const DB_LSN *crtlsn)
+{
+    long long logleft;
+    int nwrote = 0;
+    int rc;
+
+    if (poll_ms <= 0)
+        return;
+
+    if (lastlsn->file == crtlsn->file && crtlsn->offset > lastlsn->offset) {
+        logleft = (long long)bdb_state->attr->logfilesize - crtlsn->offset;
+        if (logleft < 0)
+            logleft = 0;
+        logleft = logleft * poll_ms / (crtlsn->offset - lastlsn->offset);
+        if (logleft < left_ms)
+            left_ms = logleft;
+    }
+    if (left_ms > INT_MAX)
+        left_ms = INT_MAX;
+
+    rc = bdb_state->dbenv->memp_fuzzy(bdb_state->dbenv, poll_ms, (int)left_ms,
+                                      &nwrote);
+    if (rc != 0 && rc != DB_LOCK_DESIRED)
+        logmsg(LOGMSG_ERROR, "%s: memp_fuzzy rc %d\n", __func__, rc);
+}
+
 void *checkpoint_thread(void *arg)
 {
     int rc, now;
@@ -398,6 +532,7 @@ void *checkpoint_thread(void *arg)
     unsigned long long crt_time_msec;
     DB_LSN logfile;
     DB_LSN crtlogfile;
+    DB_LSN lastlsn;
     int broken;
     static int have_checkpoint_thd = 0;
     static pthread_mutex_t lk = PTHREAD_MUTEX_INITIALIZER;
@@ -411,6 +546,7 @@ void *checkpoint_thread(void *arg)
     Pthread_mutex_unlock(&lk);
 
     thread_started("bdb checkpoint");
+    comdb2_thread_set_affinity(COMDB2_THR_CLASS_BDB, NULL);
 
     bdb_state = (bdb_state_type *)arg;
     if (bdb_state->parent)
@@ -457,7 +593,9 @@ void *checkpoint_thread(void *arg)
         if ((gbl_cache_flush_interval > 0) &&
             ((now = time(NULL)) - last_cache_dump) > gbl_cache_flush_interval) {
             if (!loaded_cache) {
-                bdb_state->dbenv->memp_load_default(bdb_state->dbenv);
+                /* Already loaded (or loading) by create_load_cache_thread */
+                if (!gbl_load_cache_at_startup)
+                    bdb_state->dbenv->memp_load_default(bdb_state->dbenv);
                 loaded_cache = 1;
             } else {
                 bdb_state->dbenv->memp_dump_default(bdb_state->dbenv, 0);
@@ -485,6 +623,7 @@ void *checkpoint_thread(void *arg)
             }
             end_sleep_time_msec = osql_log_time() + total_sleep_msec;
             crt_time_msec = 0;
+            lastlsn = logfile;
 
             do {
                 if (checkpointtimepoll > end_sleep_time_msec - crt_time_msec) {
@@ -496,6 +635,14 @@ void *checkpoint_thread(void *arg)
                 BDB_READLOCK("checkpoint_thread2");
                 broken = bdb_state->dbenv->log_get_last_lsn(bdb_state->dbenv,
                                                             &crtlogfile);
+                if (!broken && bdb_state->attr->fuzzy_checkpoint) {
+                    crt_time_msec = osql_log_time();
+                    fuzzy_checkpoint(bdb_state, checkpointtimepoll,
+                                     (long long)(end_sleep_time_msec -
+                                                 crt_time_msec),
+                                     &lastlsn, &crtlogfile);
+                }
+                lastlsn = crtlogfile;
                 BDB_RELLOCK();
 
                 if (!broken) {
@@ -1515,6 +1515,7 @@ static int bdb_tran_commit_with_seqnum_int_int(
     tran_type *physical_tran = NULL;
     DB_LSN lsn;
     DB_LSN old_lsn;
+    uint64_t start_us;
 
     bzero(&lsn, sizeof(DB_LSN));
     bzero(&old_lsn, sizeof(DB_LSN));
@@ -1550,7 +1551,12 @@ static int bdb_tran_commit_with_seqnum_int_int(
 
     case TRANCLASS_LOGICAL_NOROWLOCKS:
         flags = (tran->request_ack) ? DB_TXN_REP_ACK : 0;
+        start_us = gbl_rep_stage_sample > 0 ? comdb2_time_epochus() : 0;
         rc = tran->tid->commit_getlsn(tran->tid, flags, &lsn, tran);
+        if (rc == 0 && start_us && bdb_rep_stage_sampled(&lsn))
+            bdb_rep_stage_record(bdb_state->repinfo->myhost,
+                                 BDB_REP_STAGE_LOG_PUT,
+                                 comdb2_time_epochus() - start_us);
         if (rc != 0) {
             *bdberr = BDBERR_MISC;
             outrc = -1;
@@ -1643,8 +1649,13 @@ static int bdb_tran_commit_with_seqnum_int_int(
         /* "normal" case for physical transactions. just commit */
         flags = DB_TXN_DONT_GET_REPO_MTX;
         flags |= (tran->request_ack) ? DB_TXN_REP_ACK : 0;
+        start_us = gbl_rep_stage_sample > 0 ? comdb2_time_epochus() : 0;
         rc = tran->tid->commit_getlsn(tran->tid, flags, &lsn, tran);
         bdb_osql_trn_repo_unlock();
+        if (rc == 0 && start_us && bdb_rep_stage_sampled(&lsn))
+            bdb_rep_stage_record(bdb_state->repinfo->myhost,
+                                 BDB_REP_STAGE_LOG_PUT,
+                                 comdb2_time_epochus() - start_us);
         if (rc != 0) {
             logmsg(LOGMSG_ERROR, 
                    "%s:%d failed commit_getlsn, rc %d\n", __func__,
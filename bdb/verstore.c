@@ -0,0 +1,183 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/* In-memory store of old row versions for snapshot and serializable readers.
+ *
+ * The shadow tables of a snapshot transaction only hold a pointer to the
+ * undo log record for a row that was deleted or updated after it started;
+ * the row is rebuilt from the log the first time the cursor lands on it.
+ * Every reader that needs the same version pays for the same rebuild, which
+ * adds up with many long-running readers on a busy table.  The store keeps
+ * rebuilt versions keyed by the undo record lsn and the genid, so only the
+ * first reader goes to the log.
+ *
+ * A version never changes once written, so the store can drop anything at
+ * any time; a reader that misses just goes back to the log.  Versions whose
+ * undo record is older than the oldest active snapshot are dropped about
+ * once a second, and the least recently used go first when the store is
+ * over snapisol_version_store_size. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <build/db.h>
+#include <plhash.h>
+#include <list.h>
+#include <logmsg.h>
+#include <locks_wrap.h>
+#include <epochlib.h>
+#include "bdb_int.h"
+#include "bdb_osqltrn.h"
+
+struct verstore_key {
+    DB_LSN lsn; /* undo record that replaced this version */
+    unsigned long long genid;
+};
+
+struct verstore_ent {
+    struct verstore_key key; /* first, for the hash */
+    int len;
+    LINKC_T(struct verstore_ent) lnk;
+    char row[];
+};
+
+static pthread_mutex_t verstore_lk = PTHREAD_MUTEX_INITIALIZER;
+static hash_t *verstore_hash;
+static LISTC_T(struct verstore_ent) verstore_lru; /* most recent on top */
+static int64_t verstore_bytes;
+static int verstore_trimmed;
+static int64_t verstore_hits;
+static int64_t verstore_misses;
+
+static void verstore_del(struct verstore_ent *ent)
+{
+    hash_del(verstore_hash, ent);
+    listc_rfl(&verstore_lru, ent);
+    verstore_bytes -= sizeof(*ent) + ent->len;
+    free(ent);
+}
+
+/* drop versions no active snapshot can ask for, then the least recently used
+   ones until we fit; called with verstore_lk held */
+static void verstore_trim(DB_LSN *oldest, int64_t max)
+{
+    struct verstore_ent *ent, *tmp;
+
+    if (oldest) {
+        LISTC_FOR_EACH_SAFE(&verstore_lru, ent, tmp, lnk)
+        {
+            if (log_compare(&ent->key.lsn, oldest) < 0)
+                verstore_del(ent);
+        }
+    }
+    while (verstore_bytes > max && (ent = LISTC_BOT(&verstore_lru)) != NULL)
+        verstore_del(ent);
+}
+
+/* Copy the version of genid that the undo record at lsn replaced into buf.
+ * Returns 0 if it was in the store. */
+int bdb_verstore_find(bdb_state_type *bdb_state, DB_LSN *lsn,
+                      unsigned long long genid, void *buf, int buflen)
+{
+    struct verstore_key key = {.lsn = *lsn, .genid = genid};
+    struct verstore_ent *ent;
+    int rc = 1;
+
+    if (bdb_state->attr->snapisol_version_store_size <= 0)
+        return 1;
+
+    Pthread_mutex_lock(&verstore_lk);
+    if (verstore_hash && (ent = hash_find(verstore_hash, &key)) != NULL &&
+        ent->len == buflen) {
+        memcpy(buf, ent->row, ent->len);
+        listc_rfl(&verstore_lru, ent);
+        listc_atl(&verstore_lru, ent);
+        verstore_hits++;
+        rc = 0;
+    } else {
+        verstore_misses++;
+    }
+    Pthread_mutex_unlock(&verstore_lk);
+
+    return rc;
+}
+
+/* Remember a version rebuilt from the log */
+void bdb_verstore_add(bdb_state_type *bdb_state, DB_LSN *lsn,
+                      unsigned long long genid, const void *row, int len)
+{
+    int64_t max = bdb_state->attr->snapisol_version_store_size;
+    struct verstore_ent *ent;
+    DB_LSN oldest, *poldest = NULL;
+    int now;
+
+    if (max <= 0) {
+        if (verstore_bytes > 0) {
+            Pthread_mutex_lock(&verstore_lk);
+            verstore_trim(NULL, 0);
+            Pthread_mutex_unlock(&verstore_lk);
+        }
+        return;
+    }
+    /* a few huge rows shouldn't flush everything else */
+    if (len > max / 16)
+        return;
+
+    if ((ent = malloc(sizeof(*ent) + len)) == NULL)
+        return;
+    ent->key.lsn = *lsn;
+    ent->key.genid = genid;
+    ent->len = len;
+    memcpy(ent->row, row, len);
+
+    now = comdb2_time_epoch();
+    if (now != verstore_trimmed) {
+        bdb_oldest_active_lsn(bdb_state, &oldest);
+        poldest = &oldest;
+    }
+
+    Pthread_mutex_lock(&verstore_lk);
+    if (!verstore_hash) {
+        verstore_hash = hash_init(sizeof(struct verstore_key));
+        listc_init(&verstore_lru, offsetof(struct verstore_ent, lnk));
+    }
+    if (hash_find(verstore_hash, &ent->key) != NULL) {
+        /* another reader got here first */
+        Pthread_mutex_unlock(&verstore_lk);
+        free(ent);
+        return;
+    }
+    hash_add(verstore_hash, ent);
+    listc_atl(&verstore_lru, ent);
+    verstore_bytes += sizeof(*ent) + len;
+    if (poldest)
+        verstore_trimmed = now;
+    verstore_trim(poldest, max);
+    Pthread_mutex_unlock(&verstore_lk);
+}
+
+void bdb_verstore_stat(void)
+{
+    Pthread_mutex_lock(&verstore_lk);
+    logmsg(LOGMSG_USER,
+           "version store: %d versions, %" PRId64 " bytes, %" PRId64
+           " hits, %" PRId64 " misses\n",
+           verstore_hash ? listc_size(&verstore_lru) : 0, verstore_bytes,
+           verstore_hits, verstore_misses);
+    Pthread_mutex_unlock(&verstore_lk);
+}
@@ -1,4 +1,8 @@
-#include <db.h>
+#include "db_config.h"
+#include "db_int.h"
+#include "dbinc/db_page.h"
+#include "dbinc/btree.h"
+#include "dbinc/mp.h"
 #include <btree/bt_cache.h>
 #include <crc32c.h>
 
@@ -18,6 +22,7 @@ uint32_t rcache_collide;
 
 typedef struct {
 	uint8_t fileid[DB_FILE_ID_LEN];
+	uint32_t pgno;
 	uint16_t gen;
 	uint32_t hitmiss;
 	void *bfpool_pg;
@@ -27,13 +32,20 @@ typedef struct {
 typedef struct {
 	size_t pgsz;
 	size_t count;
+	int levels;
 	CacheSlot slots[];
 } CacheHndl;
 
 static __thread CacheHndl *hndl = NULL;
 
+/*
+ * Each sql thread keeps copies of the inner btree pages it descends
+ * through, keyed by file and page number.  Only the top 'levels' levels of
+ * a tree are cached; with enough levels a point lookup only reads its leaf
+ * from the buffer pool.
+ */
 void
-rcache_init(size_t count, size_t pgsz)
+rcache_init(size_t count, size_t pgsz, int levels)
 {
 #ifdef __x86_64
 	if (pgsz % (4 * 1024) != 0) {
@@ -49,6 +61,9 @@ rcache_init(size_t count, size_t pgsz)
 	}
 	hndl->count = count;
 	hndl->pgsz = pgsz;
+	hndl->levels = levels < 1 ? 1 : levels;
+	if (hndl->levels > RCACHE_MAX_LEVELS)
+		hndl->levels = RCACHE_MAX_LEVELS;
 	uint8_t *pages = (uint8_t *)&hndl->slots[count];
 	CacheSlot *slot = &hndl->slots[0];
 	CacheSlot *end = &hndl->slots[count];
@@ -63,10 +78,16 @@ rcache_init(size_t count, size_t pgsz)
 }
 
 static inline void
-hash_fileid(void *fileid, uint32_t * crc, uint32_t * hash)
+hash_fileid(void *fileid, uint32_t pgno, uint32_t * crc, uint32_t * hash)
 {
 	*crc = crc32c(fileid, DB_FILE_ID_LEN);
-	*hash = *crc % hndl->count;
+	*hash = (*crc ^ (pgno * 2654435761U)) % hndl->count;
+}
+
+int
+rcache_levels(void)
+{
+	return hndl ? hndl->levels : 0;
 }
 
 void
@@ -79,19 +100,19 @@ rcache_destroy(void)
 }
 
 int
-rcache_find(DB *dbp, void **cached_pg, void **bfpool_pg,
+rcache_find(DB *dbp, db_pgno_t pgno, void **cached_pg, void **bfpool_pg,
     uint16_t * gen, uint32_t * slot_ptr)
 {
 	if (hndl == NULL || dbp->pgsize > hndl->pgsz)
 		return -1;
 	uint32_t crc, slot;
 
-	hash_fileid(dbp->fileid, &crc, &slot);
+	hash_fileid(dbp->fileid, pgno, &crc, &slot);
 	if (crc == 0)
 		return -1;
 	CacheSlot *cache = &hndl->slots[slot];
 
-	if (cache->bfpool_pg
+	if (cache->bfpool_pg && cache->pgno == pgno
 	    && memcmp(cache->fileid, dbp->fileid, DB_FILE_ID_LEN) == 0) {
 		*cached_pg = cache->cached_pg;
 		*bfpool_pg = cache->bfpool_pg;
@@ -112,8 +133,9 @@ rcache_save(DB *dbp, void *page, uint16_t gen)
 	if (hndl == NULL || dbp->pgsize > hndl->pgsz)
 		return -1;
 	uint32_t crc, slot;
+	db_pgno_t pgno = PGNO((PAGE *)page);
 
-	hash_fileid(dbp->fileid, &crc, &slot);
+	hash_fileid(dbp->fileid, pgno, &crc, &slot);
 	if (crc == 0)
 		return -1;
 	CacheSlot *cache = &hndl->slots[slot];
@@ -128,6 +150,7 @@ rcache_save(DB *dbp, void *page, uint16_t gen)
 	cache->hitmiss = 1;
 	cache->bfpool_pg = page;
 	cache->gen = gen;
+	cache->pgno = pgno;
 	memcpy(cache->cached_pg, page, dbp->pgsize);
 	memcpy(cache->fileid, dbp->fileid, DB_FILE_ID_LEN);
 	++rcache_savd;
@@ -141,3 +164,67 @@ rcache_invalidate(uint32_t slot)
 
 	++rcache_invalid;
 }
+
+/*
+ * Save a copy of a page read under a read lock, stamping its buffer with
+ * the generation the copy is validated against.
+ */
+void
+rcache_save_pg(DB *dbp, void *page)
+{
+	uint16_t gen = LSN(page).file + LSN(page).offset;
+
+	GET_BH_GEN(page) = gen;
+	rcache_save(dbp, page, gen);
+}
+
+/*
+ * Once a search holds a page read from the buffer pool, check that none of
+ * the cached pages above it changed or left the buffer pool since they
+ * were copied.  Stale entries are dropped.
+ */
+int
+rcache_valid(rcache_ref *rc, int nrc)
+{
+	int i, valid;
+
+	for (i = 0, valid = 1; i < nrc; ++i) {
+		DB_LSN *l1 = &LSN(rc[i].cached_pg);
+		DB_LSN *l2 = &LSN(rc[i].bfpool_pg);
+
+		if (rc[i].gen == GET_BH_GEN(rc[i].bfpool_pg)
+		    && memcmp(l1, l2, sizeof(DB_LSN)) == 0 && rc[i].gen == GET_BH_GEN(rc[i].bfpool_pg)	//re-check. warm&fuzzy
+		    )
+			continue;
+		rcache_invalidate(rc[i].slot);
+		valid = 0;
+	}
+	return valid;
+}
+
+/*
+ * Follow the first (or last) child pointers from the root through cached
+ * inner pages without locking them.  Sets pgno to the first page that has
+ * to come from the buffer pool and returns how many cached pages were
+ * used; the caller validates them once it holds that page.
+ */
+int
+rcache_descend(DB *dbp, db_pgno_t root, int last, rcache_ref *rc,
+    db_pgno_t *pgno)
+{
+	PAGE *h;
+	int n;
+
+	*pgno = root;
+	for (n = 0; n < RCACHE_MAX_LEVELS; ++n) {
+		if (rcache_find(dbp, *pgno, &rc[n].cached_pg, &rc[n].bfpool_pg,
+		    &rc[n].gen, &rc[n].slot) != 0)
+			break;
+		h = rc[n].cached_pg;
+		if (NUM_ENT(h) == 0)
+			break;
+		*pgno = GET_BINTERNAL(dbp, h,
+		    last ? NUM_ENT(h) - O_INDX : 0)->pgno;
+	}
+	return n;
+}
@@ -1,11 +1,27 @@
 #ifndef INCLUDE_BT_CACHE_H
 #define INCLUDE_BT_CACHE_H
 
+/* Most btree levels a search can walk through the cache before validating. */
+#define RCACHE_MAX_LEVELS 8
+
+/* A cached inner page a search went through without reading it. */
+typedef struct {
+	void *cached_pg;
+	void *bfpool_pg;
+	uint16_t gen;
+	uint32_t slot;
+} rcache_ref;
+
 struct __db;
-int rcache_find(struct __db *, void **cached_pg, void **bfpool_pg,
-	uint16_t * gen, uint32_t * slot);
+int rcache_find(struct __db *, db_pgno_t pgno, void **cached_pg,
+	void **bfpool_pg, uint16_t * gen, uint32_t * slot);
 int rcache_save(struct __db *, void *page, uint16_t gen);
 void rcache_invalidate(uint32_t slot);
+int rcache_levels(void);
+void rcache_save_pg(struct __db *, void *page);
+int rcache_valid(rcache_ref *rc, int nrc);
+int rcache_descend(struct __db *, db_pgno_t root, int last, rcache_ref *rc,
+	db_pgno_t *pgno);
 
 #define GET_BH_GEN(pg) (*(uint16_t *)((uint8_t *)pg - (offsetof(BH, buf) - offsetof(BH, generation))))
 
@@ -22,6 +22,7 @@ static const char revid[] = "$Id: bt_cursor.c,v 11.169 2003/11/19 18:41:06 bosti
 #endif
 #include <walkback.h>
 #include <pthread.h>
+#include <stdbool.h>
 
 #include "db_int.h"
 #include "dbinc/db_page.h"
@@ -32,6 +33,7 @@ static const char revid[] = "$Id: bt_cursor.c,v 11.169 2003/11/19 18:41:06 bosti
 
 #include <btree/bt_prefix.h>
 #include <btree/bt_pf.h>
+#include <btree/bt_cache.h>
 #include <stdlib.h>
 
 #include "debug_switches.h"
@@ -75,6 +77,133 @@ extern int gbl_disable_overflow_page_trace;
 int gbl_skip_cget_in_db_put = 1;
 __thread DB *prefault_dbp = NULL;
 
+/*
+ * Per-thread insert hints: the leaf page each thread last inserted into,
+ * per tree.  A thread inserting a sorted run (bulk load, bplog replay)
+ * keeps landing on the same leaf, so the page is checked before searching
+ * the tree, even when the run isn't at either edge of the tree or other
+ * threads are inserting elsewhere in it.  Like bt_lpgno, a hint is only
+ * advisory: the page is locked and its keys checked before it is used.
+ */
+int gbl_bt_insert_hint = 0;
+
+#define	BT_INSERT_HINTS	16
+static __thread struct {
+	DB *dbp;
+	db_pgno_t pgno;
+} bt_insert_hints[BT_INSERT_HINTS];
+
+#define	BT_INSERT_HINT(dbp)						\
+	(&bt_insert_hints[((uintptr_t)(dbp) >> 4) % BT_INSERT_HINTS])
+
+/*
+ * Per-thread read hints: the leaf page each thread's last DB_SET_RANGE
+ * search landed on, per tree.  Sorted key probes (IN lists, nested-loop
+ * joins over an ordered outer table) tend to land on the same leaf as the
+ * previous probe, so the hinted page is read-locked and checked against the
+ * key before descending from the root.  A miss backs the hint off
+ * exponentially, up to BT_READ_HINT_MAXSKIP searches, so random probes
+ * don't pay for a wasted page lock on every search.
+ */
+int gbl_bt_read_hint = 0;
+
+#define	BT_READ_HINTS		16
+#define	BT_READ_HINT_MAXSKIP	64
+struct bt_read_hint {
+	DB *dbp;
+	db_pgno_t pgno;
+	u_int32_t skip;
+	u_int32_t backoff;
+};
+static __thread struct bt_read_hint bt_read_hints[BT_READ_HINTS];
+
+#define	BT_READ_HINT(dbp)						\
+	(&bt_read_hints[((uintptr_t)(dbp) >> 4) % BT_READ_HINTS])
+
+/*
+ * Hash hints: a table per tree, shared by all threads, from the hash of a
+ * key to the leaf an exact DB_SET_RANGE match for it was last found on.
+ * Equality lookups on random keys (uuids, session ids) don't land near the
+ * previous lookup, so the read hints above don't help them, but repeated
+ * lookups of a hot key do go straight to its leaf.  Each slot holds the
+ * key's hash in its high half and the page number in its low half, and is
+ * read and written whole, so a racing update can only make the hint wrong,
+ * which the key check on the locked page catches.
+ */
+static u_int32_t
+__bam_hash_hint_key(key)
+	const DBT *key;
+{
+	const u_int8_t *k, *e;
+	u_int32_t h;
+
+	for (h = 2166136261U, k = key->data, e = k + key->size; k < e; ++k) {
+		h ^= *k;
+		h *= 16777619;
+	}
+	return (h | 1);
+}
+
+static BT_HASH_HINTS *
+__bam_hash_hints(dbp)
+	DB *dbp;
+{
+	BT_HASH_HINTS *hh, *cur;
+	BTREE *t;
+	u_int32_t n;
+
+	t = dbp->bt_internal;
+	if ((hh = __atomic_load_n(&t->bt_hash_hints, __ATOMIC_ACQUIRE)) != NULL)
+		return (hh);
+
+	/* The first lookup sizes the table, to a power of two. */
+	for (n = 1; n <= dbp->dbenv->attr.btree_hash_hint / 2; n <<= 1)
+		;
+	if (__os_calloc(dbp->dbenv, 1, sizeof(BT_HASH_HINTS) +
+	    n * sizeof(u_int64_t), &hh) != 0)
+		return (NULL);
+	hh->mask = n - 1;
+	cur = NULL;
+	if (!__atomic_compare_exchange_n(&t->bt_hash_hints, &cur, hh, 0,
+	    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		__os_free(dbp->dbenv, hh);
+		hh = cur;
+	}
+	return (hh);
+}
+
+static db_pgno_t
+__bam_hash_hint_get(dbp, key)
+	DB *dbp;
+	const DBT *key;
+{
+	BT_HASH_HINTS *hh;
+	u_int64_t v;
+	u_int32_t h;
+
+	if ((hh = __bam_hash_hints(dbp)) == NULL)
+		return (PGNO_INVALID);
+	h = __bam_hash_hint_key(key);
+	v = __atomic_load_n(&hh->slot[h & hh->mask], __ATOMIC_RELAXED);
+	return ((u_int32_t)(v >> 32) == h ? (db_pgno_t)v : PGNO_INVALID);
+}
+
+static void
+__bam_hash_hint_put(dbp, key, pgno)
+	DB *dbp;
+	const DBT *key;
+	db_pgno_t pgno;
+{
+	BT_HASH_HINTS *hh;
+	u_int32_t h;
+
+	if ((hh = __bam_hash_hints(dbp)) == NULL)
+		return;
+	h = __bam_hash_hint_key(key);
+	__atomic_store_n(&hh->slot[h & hh->mask],
+	    (u_int64_t)h << 32 | pgno, __ATOMIC_RELAXED);
+}
+
 /*
  * Acquire a new page/lock.  If we hold a page/lock, discard the page, and
  * lock-couple the lock.
@@ -138,6 +267,7 @@ __thread DB *prefault_dbp = NULL;
 	if ((ret) == 0)	{						\
         if (!F_ISSET(dbc, DBC_RMW | DBC_WRITECURSOR | DBC_WRITER) && (dbc)->dbp->olcompact)	\
             __flags |= DB_MPOOL_COMPACT;			\
+        __flags |= DB_MPOOL_USEONCE; /* scans don't promote pages */ \
 		ret = __memp_fget(__mpf, &(fpgno), __flags, &(pagep));	\
     } \
 }
@@ -3303,6 +3433,73 @@ __pageorder_scan_warning(const char *func)
 	}
 }
 
+/*
+ * __bam_c_edge --
+ *	Walk a cursor down the left or right edge of the tree to a leaf.
+ *	Read cursors first follow the rcache copies of the top inner pages
+ *	without locking them, and validate those once the cursor holds the
+ *	first page it had to lock and read.
+ */
+static int
+__bam_c_edge(dbc, last)
+	DBC *dbc;
+	int last;
+{
+	extern bool gbl_rcache;
+	BTREE_CURSOR *cp;
+	rcache_ref rc[RCACHE_MAX_LEVELS];
+	db_pgno_t pgno;
+	db_indx_t indx;
+	int i, nrc, ret, top_level, use_rc;
+
+	cp = (BTREE_CURSOR *)dbc->internal;
+	use_rc = gbl_rcache && cp->root == 1 && !F_ISSET(dbc, DBC_RMW);
+
+again:	pgno = cp->root;
+	nrc = use_rc ? rcache_descend(dbc->dbp, cp->root, last, rc, &pgno) : 0;
+	top_level = nrc > 0 ? LEVEL(rc[0].cached_pg) : 0;
+
+	for (;;) {
+		ACQUIRE_CUR_COUPLE(dbc, DB_LOCK_READ, pgno, ret);
+		if (ret != 0)
+			return (ret);
+
+		if (nrc > 0) {
+			if (!rcache_valid(rc, nrc)) {
+				use_rc = 0;
+				goto again;
+			}
+#if USE_BTPF
+			for (i = 0; i < nrc; ++i)
+				trk_descent(dbc->dbp, dbc, rc[i].cached_pg,
+				    last ? NUM_ENT(rc[i].cached_pg) - O_INDX : 0);
+#endif
+			nrc = 0;
+		}
+		if (top_level == 0)
+			top_level = LEVEL(cp->page);
+
+		/* If we find a leaf page, we're done. */
+		if (ISLEAF(cp->page))
+			break;
+		if (use_rc && TYPE(cp->page) == P_IBTREE &&
+		    top_level - LEVEL(cp->page) < rcache_levels())
+			rcache_save_pg(dbc->dbp, cp->page);
+
+		indx = !last || NUM_ENT(cp->page) == 0 ?
+		    0 : NUM_ENT(cp->page) - O_INDX;
+#if USE_BTPF
+		trk_descent(dbc->dbp, dbc, cp->page, indx);
+#endif
+		pgno = GET_BINTERNAL(dbc->dbp, cp->page, indx)->pgno;
+	}
+#if USE_BTPF
+	trk_leaf(dbc, cp->page, last ? NUM_ENT(cp->page) : 0);
+	crsr_jump(dbc);
+#endif
+	return (0);
+}
+
 /*
  * __bam_c_first --
  *	Return the first record.
@@ -3353,25 +3550,8 @@ __bam_c_first(dbc)
 	else {
 
 		/* Walk down the left-hand side of the tree. */
-		for (pgno = cp->root;;) {
-
-			ACQUIRE_CUR_COUPLE(dbc, DB_LOCK_READ, pgno, ret);
-			if (ret != 0)
-				return (ret);
-
-			/* If we find a leaf page, we're done. */
-			if (ISLEAF(cp->page))
-				break;
-#if USE_BTPF
-			trk_descent(dbc->dbp, dbc, cp->page, 0);
-#endif
-			pgno = GET_BINTERNAL(dbc->dbp, cp->page, 0)->pgno;
-
-		}
-#if USE_BTPF
-		trk_leaf(dbc, cp->page, 0);
-		crsr_jump(dbc);
-#endif
+		if ((ret = __bam_c_edge(dbc, 0)) != 0)
+			return (ret);
 	}
 
 	/* If we want a write lock instead of a read lock, get it now. */
@@ -3400,38 +3580,18 @@ __bam_c_last(dbc)
 	DBC *dbc;
 {
 	BTREE_CURSOR *cp;
-	db_pgno_t pgno;
 	int ret;
 
 	cp = (BTREE_CURSOR *)dbc->internal;
 	ret = 0;
-	db_indx_t n_ent = 0;
 
 	/* Assert that this isn't a page-order cursor. */
 	DB_ASSERT(!F_ISSET(dbc, DBC_PAGE_ORDER));
 
 	/* Walk down the right-hand side of the tree. */
-	for (pgno = cp->root;;) {
-		ACQUIRE_CUR_COUPLE(dbc, DB_LOCK_READ, pgno, ret);
-		if (ret != 0)
-			return (ret);
-
-
-		/* If we find a leaf page, we're done. */
-		if (ISLEAF(cp->page))
-			break;
-		n_ent = NUM_ENT(cp->page) == 0 ? 0 : NUM_ENT(cp->page) - O_INDX;
-#if USE_BTPF
-		trk_descent(dbc->dbp, dbc, cp->page, n_ent);
-#endif
-		pgno = GET_BINTERNAL(dbc->dbp, cp->page,
-		    NUM_ENT(cp->page) - O_INDX)->pgno;
+	if ((ret = __bam_c_edge(dbc, 1)) != 0)
+		return (ret);
 
-	}
-#if USE_BTPF
-	trk_leaf(dbc, cp->page, NUM_ENT(cp->page));
-	crsr_jump(dbc);
-#endif
 	/* If we want a write lock instead of a read lock, get it now. */
 	if (F_ISSET(dbc, DBC_RMW)) {
 		ACQUIRE_WRITE_LOCK(dbc, ret);
@@ -3754,11 +3914,12 @@ __bam_c_search(dbc, root_pgno, key, flags, exactp)
 	BTREE_CURSOR *cp;
 	DB *dbp;
 	PAGE *h;
-	db_indx_t indx, *inp;
+	struct bt_read_hint *rh;
+	db_indx_t base, indx, *inp, lim;
 	db_pgno_t bt_lpgno;
 	db_recno_t recno;
 	u_int32_t sflags;
-	int cmp, ret;
+	int cmp, hinted, ret;
 	int oldret;
 
 	dbp = dbc->dbp;
@@ -3797,7 +3958,75 @@ __bam_c_search(dbc, root_pgno, key, flags, exactp)
 	case DB_SET_RANGE:
 		sflags =
 		    (F_ISSET(dbc, DBC_RMW) ? S_WRITE : S_READ) | S_DUPFIRST;
-		goto search;
+
+		/*
+		 * Try the leaf the last range search on this tree landed on.
+		 * If the key sorts between the first and last keys on that
+		 * page, its position is on that page.  Leave duplicates to
+		 * the full search, it has to find the first of them.
+		 */
+		if (F_ISSET(dbp, DB_AM_DUP))
+			goto search;
+		bt_lpgno = PGNO_INVALID;
+		rh = BT_READ_HINT(dbp);
+		hinted = gbl_bt_read_hint &&
+		    rh->dbp == dbp && rh->pgno != PGNO_INVALID;
+		if (hinted && rh->skip > 0) {
+			--rh->skip;
+			hinted = 0;
+		}
+		if (hinted)
+			bt_lpgno = rh->pgno;
+		else if (dbp->dbenv->attr.btree_hash_hint > 0)
+			bt_lpgno = __bam_hash_hint_get(dbp, key);
+		if (bt_lpgno == PGNO_INVALID)
+			goto search;
+
+		h = NULL;
+		ACQUIRE_CUR(dbc, F_ISSET(dbc, DBC_RMW) ?
+		    DB_LOCK_WRITE : DB_LOCK_READ, bt_lpgno, ret);
+		if (ret != 0)
+			goto read_miss;
+
+		h = cp->page;
+		if (TYPE(h) != P_LBTREE || NUM_ENT(h) == 0)
+			goto read_miss;
+		if ((ret = __bam_cmp(dbp, key, h, 0, t->bt_compare, &cmp)) != 0)
+			return (ret);
+		if (cmp < 0)
+			goto read_miss;
+		if ((ret = __bam_cmp(dbp, key, h, NUM_ENT(h) - P_INDX,
+		    t->bt_compare, &cmp)) != 0)
+			return (ret);
+		if (cmp > 0)
+			goto read_miss;
+		for (base = 0, lim = NUM_ENT(h) / P_INDX; lim != 0; lim >>= 1) {
+			indx = base + ((lim >> 1) * P_INDX);
+			if ((ret = __bam_cmp(dbp,
+			    key, h, indx, t->bt_compare, &cmp)) != 0)
+				return (ret);
+			if (cmp == 0)
+				break;
+			if (cmp > 0) {
+				base = indx + P_INDX;
+				--lim;
+			}
+		}
+		if (cmp != 0) {
+			indx = base;
+			cmp = -1;
+		}
+		if (hinted)
+			rh->skip = rh->backoff = 0;
+		goto fast_hit;
+
+read_miss:	if (hinted) {
+			rh->backoff = rh->backoff == 0 ? 1 :
+			    rh->backoff >= BT_READ_HINT_MAXSKIP / 2 ?
+			    BT_READ_HINT_MAXSKIP : rh->backoff * 2;
+			rh->skip = rh->backoff;
+		}
+		goto fast_miss;
 	case DB_KEYFIRST:
 		sflags = S_KEYFIRST;
 		goto fast_search;
@@ -3826,6 +4055,12 @@ fast_search:	/*
 		 * then read a different page because it changed underfoot.
 		 */
 		bt_lpgno = t->bt_lpgno;
+		hinted = 0;
+		if (gbl_bt_insert_hint && BT_INSERT_HINT(dbp)->dbp == dbp &&
+		    BT_INSERT_HINT(dbp)->pgno != PGNO_INVALID) {
+			bt_lpgno = BT_INSERT_HINT(dbp)->pgno;
+			hinted = 1;
+		}
 
 		/*
 		 * If the tree has no history of insertion, do it the slow way.
@@ -3890,7 +4125,7 @@ try_begin:	if (h->prev_pgno == PGNO_INVALID) {
 				return (ret);
 
 			if (cmp > 0)
-				goto fast_miss;
+				goto try_middle;
 			if (cmp < 0)
 				goto fast_hit;
 
@@ -3909,7 +4144,39 @@ try_begin:	if (h->prev_pgno == PGNO_INVALID) {
 			    indx += P_INDX);
 			goto fast_hit;
 		}
-		goto fast_miss;
+
+		/*
+		 * A hinted page may be in the middle of the tree.  If the key
+		 * sorts strictly between the first and last keys on the page,
+		 * then this is the leaf it belongs on; find its slot.  Leave
+		 * duplicates to the full search.
+		 */
+try_middle:	if (!hinted || F_ISSET(dbp, DB_AM_DUP) ||
+		    NUM_ENT(h) < 2 * P_INDX)
+			goto fast_miss;
+		if ((ret = __bam_cmp(dbp, key, h, 0, t->bt_compare, &cmp)) != 0)
+			return (ret);
+		if (cmp <= 0)
+			goto fast_miss;
+		if ((ret = __bam_cmp(dbp, key, h, NUM_ENT(h) - P_INDX,
+		    t->bt_compare, &cmp)) != 0)
+			return (ret);
+		if (cmp >= 0)
+			goto fast_miss;
+		for (base = 0, lim = NUM_ENT(h) / P_INDX; lim != 0; lim >>= 1) {
+			indx = base + ((lim >> 1) * P_INDX);
+			if ((ret = __bam_cmp(dbp,
+			    key, h, indx, t->bt_compare, &cmp)) != 0)
+				return (ret);
+			if (cmp == 0)
+				goto fast_hit;
+			if (cmp > 0) {
+				base = indx + P_INDX;
+				--lim;
+			}
+		}
+		indx = base;
+		cmp = -1;
 
 fast_hit:	/* Set the exact match flag, we may have found a duplicate. */
 		*exactp = cmp == 0;
@@ -3972,6 +4239,23 @@ search:		if ((ret = __bam_search(dbc, root_pgno,
 		    cp->indx >= NUM_ENT(cp->page) - P_INDX) ||
 		    (PREV_PGNO(cp->page) == PGNO_INVALID &&
 		    cp->indx == 0) ? cp->pgno : PGNO_INVALID;
+	if (gbl_bt_insert_hint && TYPE(cp->page) == P_LBTREE &&
+	    (flags == DB_KEYFIRST || flags == DB_KEYLAST)) {
+		BT_INSERT_HINT(dbp)->dbp = dbp;
+		BT_INSERT_HINT(dbp)->pgno = cp->pgno;
+	}
+	if (gbl_bt_read_hint && TYPE(cp->page) == P_LBTREE &&
+	    flags == DB_SET_RANGE) {
+		rh = BT_READ_HINT(dbp);
+		if (rh->dbp != dbp) {
+			rh->dbp = dbp;
+			rh->skip = rh->backoff = 0;
+		}
+		rh->pgno = cp->pgno;
+	}
+	if (flags == DB_SET_RANGE && *exactp && TYPE(cp->page) == P_LBTREE &&
+	    dbp->dbenv->attr.btree_hash_hint > 0)
+		__bam_hash_hint_put(dbp, key, cp->pgno);
 	return (0);
 }
 
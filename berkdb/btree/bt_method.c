@@ -101,6 +101,9 @@ __bam_db_close(dbp)
 	if (t->re_source != NULL)
 		__os_free(dbp->dbenv, t->re_source);
 
+	if (t->bt_hash_hints != NULL)
+		__os_free(dbp->dbenv, t->bt_hash_hints);
+
 	__os_free(dbp->dbenv, t);
 	dbp->bt_internal = NULL;
 
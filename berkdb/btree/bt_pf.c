@@ -148,6 +148,7 @@ btpf_rst(btpf * x)
 	x->direction = UNSET;
 	x->rdr_rec_cnt = 0;
 	x->rdr_pg_cnt = 0;
+	x->rdr_pg_miss = 0;
 	x->wndw = 0;
 	x->tr_page = PGNO_INVALID;
 	x->on = PF_ON;
@@ -159,6 +160,25 @@ btpf_cnt_rst(btpf * pf)
 {
 	pf->rdr_rec_cnt = 0;
 	pf->rdr_pg_cnt = 0;
+	pf->rdr_pg_miss = 0;
+}
+
+/*
+ * Is the page already in the buffer pool?  Used to measure how well the
+ * read ahead keeps up with the cursor, and to not queue pages that don't
+ * need to be read.
+ */
+static inline int
+pg_resident(DB_MPOOLFILE *mpf, db_pgno_t pgno)
+{
+	PAGE *h;
+
+	if (pgno == PGNO_INVALID)
+		return 1;
+	if (__memp_fget(mpf, &pgno, DB_MPOOL_PROBE, &h) != 0)
+		return 0;
+	(void)__memp_fput(mpf, h, 0);
+	return 1;
 }
 
 int
@@ -232,6 +252,9 @@ crsr_pf_nxt(DBC *dbc)
 	}
 	PFX(dbc)->direction = FORWARD;  
 	if (!ret) {
+		if (PFX(dbc)->status == PF &&
+		    !pg_resident(dbc->dbp->mpf, NEXT_PGNO(dbc->internal->page)))
+			PFX(dbc)->rdr_pg_miss++;
 		PFX(dbc)->rdr_pg_cnt++;
 		PFX(dbc)->rdr_rec_cnt++;
 		ret = chk_forward(dbc);
@@ -264,6 +287,9 @@ crsr_pf_prv(DBC *dbc)
 	PFX(dbc)->direction = BACKWARD;
 
 	if (!ret) {
+		if (PFX(dbc)->status == PF &&
+		    !pg_resident(dbc->dbp->mpf, PREV_PGNO(dbc->internal->page)))
+			PFX(dbc)->rdr_pg_miss++;
 		PFX(dbc)->rdr_pg_cnt++;
 		PFX(dbc)->rdr_rec_cnt++;
 		ret = chk_backward(dbc);
@@ -286,6 +312,19 @@ crsr_jump(DBC *dbc)
 	return (0);
 }
 
+/*
+ * Only start reading ahead once the cursor looks like a scan: it either
+ * stepped onto a sibling leaf or read enough records in one direction
+ * since it was last positioned.
+ */
+static inline int
+seq_detected(btpf * f, DBC *dbc)
+{
+	if (f->status != INIT)
+		return 1;
+	return f->rdr_pg_cnt > 0 || f->rdr_rec_cnt >= SEQ_TH(dbc);
+}
+
 static inline int
 chk_forward(DBC *dbc)
 {
@@ -295,7 +334,7 @@ chk_forward(DBC *dbc)
 	int rst = 0;
 	int32_t th;
 
-	if (f->status == LOADED_ALL)
+	if (f->status == LOADED_ALL || !seq_detected(f, dbc))
 		return rst;
 
 	th = f->wndw - f->rdr_pg_cnt - CU_GAP(dbc);  
@@ -326,9 +365,9 @@ chk_backward(DBC *dbc)
 	int rst = 0;
 	int32_t th;
 
-	if (f->status == LOADED_ALL)
-		return rst;    
-        
+	if (f->status == LOADED_ALL || !seq_detected(f, dbc))
+		return rst;
+
 	th = f->wndw - f->rdr_pg_cnt - CU_GAP(dbc);
 	fetch = (th <= 0);
 
@@ -348,17 +387,31 @@ chk_backward(DBC *dbc)
 	return rst;
 }
 
+/*
+ * Size the next window from what the cursor saw during the last one.  If
+ * it reached leaf pages that were still not in the cache the read ahead
+ * is falling behind and the window grows; if every page was already there
+ * it shrinks back towards the minimum so warm scans don't flood the
+ * prefault threads.
+ */
 static inline int
 adj_wndw(DBC *dbc, btpf * f)
 {
+	u_int32_t inc;
+
 	if (f->wndw == 0) {
 		f->wndw = WNDW_MIN(dbc);
-	} else {
-		f->wndw *=  WNDW_INC(dbc);
+	} else if (f->rdr_pg_miss > 0) {
+		inc = WNDW_INC(dbc) > 2 ? WNDW_INC(dbc) : 2;
+		f->wndw *= inc;
 		f->wndw = f->wndw > WNDW_MAX(dbc) ? WNDW_MAX(dbc) : f->wndw;
+	} else if (f->rdr_pg_cnt > 0) {
+		f->wndw -= f->wndw / 4;
+		f->wndw = f->wndw < WNDW_MIN(dbc) ? WNDW_MIN(dbc) : f->wndw;
 	}
 #if BTPF_DEBUG 
-	fprintf(stderr, "Adapting window to %d\n", f->wndw);
+	fprintf(stderr, "Adapting window to %d, missed %u of %u pages\n",
+	    f->wndw, f->rdr_pg_miss, f->rdr_pg_cnt);
 #endif
 	return (0);
 }
@@ -620,6 +673,46 @@ end:
 }
 
 
+/*
+ * Queue a leaf page of the read ahead window, unless it is already cached.
+ * With btpf_ovfl the leaf is read here instead so that the overflow pages
+ * its records point to can be queued as well.
+ */
+static inline void
+load_leaf(DBC *dbc, db_pgno_t pgno)
+{
+	DB *dbp = dbc->dbp;
+	DB_MPOOLFILE *mpf = dbp->mpf;
+	DB_LOCK lock;
+	BKEYDATA *bk;
+	PAGE *h;
+	db_pgno_t opgno;
+	db_indx_t i;
+
+	if (!OVFL_PF(dbc)) {
+		if (!pg_resident(mpf, pgno))
+			LOAD(mpf, pgno);
+		return;
+	}
+
+	if (__db_lget(dbc, 0, pgno, DB_LOCK_READ, DB_LOCK_NOWAIT, &lock) != 0) {
+		LOAD(mpf, pgno);
+		return;
+	}
+	if (__memp_fget(mpf, &pgno, DB_MPOOL_PFGET, &h) == 0) {
+		for (i = 0; ISLEAF(h) && i < NUM_ENT(h); i++) {
+			bk = GET_BKEYDATA(dbp, h, i);
+			if (B_TYPE(bk) != B_OVERFLOW)
+				continue;
+			opgno = ((BOVERFLOW *)bk)->pgno;
+			if (!pg_resident(mpf, opgno))
+				LOAD(mpf, opgno);
+		}
+		(void)__memp_fput(mpf, h, DB_MPOOL_PFPUT);
+	}
+	(void)__LPUT(dbc, lock);
+}
+
 static inline int
 page_load_f(btpf * pf, DBC *dbc)
 {
@@ -662,7 +755,7 @@ page_load_f(btpf * pf, DBC *dbc)
 #if BTPF_DEBUG  
 			fprintf(stderr, "LOADING: %u from:%u indx:%d of:%d real:%d\n", t_pgno, pgno, pf->curindx[1] + i, pf->maxindx[1], h->entries );
 #endif
-			LOAD(mpf, t_pgno);
+			load_leaf(dbc, t_pgno);
 
 		}
 
@@ -745,7 +838,7 @@ page_load_b(btpf * pf, DBC *dbc)
 #if BTPF_DEBUG  
 			fprintf(stderr, "LOADING: %u from:%u indx:%d of:%d real:%d\n", t_pgno, pgno, i, pf->maxindx[1], h->entries );
 #endif            
-			LOAD(mpf,t_pgno);
+			load_leaf(dbc, t_pgno);
 
 			if (i == 0)
 				break; // it's an unsigned type it overflows and loop forever otherwise
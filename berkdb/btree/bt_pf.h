@@ -17,6 +17,8 @@
 #define WNDW_INC(dbc) dbc->dbp->dbenv->attr.btpf_wndw_inc
 #define WNDW_MAX(dbc) dbc->dbp->dbenv->attr.btpf_wndw_max
 #define MIN_TH(dbc)   dbc->dbp->dbenv->attr.btpf_min_th
+#define SEQ_TH(dbc)   dbc->dbp->dbenv->attr.btpf_seq_th
+#define OVFL_PF(dbc)  dbc->dbp->dbenv->attr.btpf_ovfl
 
 typedef enum {
 	INIT,
@@ -54,6 +56,7 @@ typedef struct {
 	btpf_direction direction;
 	u_int32_t   rdr_rec_cnt; // records read in the same direction
 	u_int32_t   rdr_pg_cnt; // pages read by the cursor to catch up
+	u_int32_t   rdr_pg_miss; // of those, pages that were not in the cache
 	u_int32_t   wndw;
 	u_int32_t   on; // pre-faulting is on/off
    
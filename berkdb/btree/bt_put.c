@@ -571,6 +571,71 @@ user_copy:
 /* COMDB2 HACK to make snapisol & rowlocks work */
 int bdb_logical_logging_enabled();
 
+/*
+ * __bam_ritem_split --
+ *	Log and apply a same-size replacement as one __bam_repl record per
+ *	run of changed bytes, where runs are at least ritem_split_gap bytes
+ *	apart.  Each record describes the item as the one before it left it,
+ *	so redo and undo work on them unchanged.  Returns 0 if the changes
+ *	are one run, leaving the item for the caller to log and replace.
+ */
+static int
+__bam_ritem_split(dbc, h, indx, data, prefix, suffix, retp)
+	DBC *dbc;
+	PAGE *h;
+	u_int32_t indx;
+	DBT *data;
+	db_indx_t prefix, suffix;
+	int *retp;
+{
+	BKEYDATA *bk;
+	DB *dbp;
+	DBT orig, repl;
+	u_int32_t end, gap, i, run, start;
+	u_int8_t *o, *n;
+
+	dbp = dbc->dbp;
+	bk = GET_BKEYDATA(dbp, h, indx);
+	o = bk->data;
+	n = data->data;
+	gap = dbp->dbenv->attr.ritem_split_gap;
+	end = bk->len - suffix;
+
+	/* Is there a gap at all? */
+	for (i = prefix, run = 0; i < end && run < gap; i++)
+		run = (o[i] == n[i]) ? run + 1 : 0;
+	if (i >= end)
+		return (0);
+
+	*retp = 0;
+	for (start = prefix; start < end;) {
+		/* The run ends at the first gap-long stretch of equal bytes. */
+		for (i = start, run = 0; i < end && run < gap; i++)
+			run = (o[i] == n[i]) ? run + 1 : 0;
+		if (run >= gap)
+			i -= run;
+
+		memset(&orig, 0, sizeof(orig));
+		memset(&repl, 0, sizeof(repl));
+		orig.data = o + start;
+		orig.size = i - start;
+		repl.data = n + start;
+		repl.size = i - start;
+		if ((*retp = __bam_repl_log(dbp, dbc->txn, &LSN(h), 0, PGNO(h),
+		    &LSN(h), indx, (u_int32_t)B_DISSET(bk), &orig, &repl,
+		    start, bk->len - i)) != 0)
+			return (1);
+		memcpy(o + start, n + start, i - start);
+
+		/* Skip to the next changed byte. */
+		for (start = i; start < end && o[start] == n[start]; start++)
+			;
+	}
+
+	B_TSET(bk, B_KEYDATA, 0, 0, 0);
+	return (1);
+}
+
 /*
  * __bam_ritem --
  *	Replace an item on a page.
@@ -624,6 +689,20 @@ __bam_ritem(dbc, h, indx, data)
 		    suffix < min && *p == *t && !disable_prefix_suffix_opt;
 		    ++suffix, --p, --t);
 
+		/*
+		 * Small changes far apart in a same-size item, such as two
+		 * counters at either end of a wide row, are cheaper logged
+		 * as a record each than as one spanning everything between.
+		 */
+		if (data->size == bk->len &&
+		    dbp->dbenv->attr.ritem_split_gap > 0 &&
+		    bk->len - (prefix + suffix) >
+		    2 * dbp->dbenv->attr.ritem_split_gap &&
+		    !disable_prefix_suffix_opt &&
+		    __bam_ritem_split(dbc, h, indx, data, prefix, suffix,
+		    &ret))
+			return (ret);
+
 		/* We only log the parts of the keys that have changed. */
 		orig.data = (u_int8_t *)bk->data + prefix;
 		orig.size = bk->len - (prefix + suffix);
@@ -74,15 +74,65 @@ static const char revid[] = "$Id: bt_search.c,v 11.47 2003/06/30 17:19:35 bostic
 #include <logmsg.h>
 #include <locks_wrap.h>
 
+/*
+ * The binary search of a page with memcmp ordered keys compares each probe
+ * from the byte where the search key stops matching both of the bounds
+ * found so far: on a sorted page, every key between two bounds starts with
+ * what the bounds have in common with the search key.  The compare goes a
+ * word at a time and tells how far the key matched, for the next bound.
+ */
+int gbl_bt_search_lcp = 1;
+
+static inline int
+__bam_lcpcmp(a, alen, b, blen, skip, lcpp)
+	const u_int8_t *a;
+	size_t alen;
+	const u_int8_t *b;
+	size_t blen;
+	size_t skip;
+	size_t *lcpp;
+{
+	u_int64_t x, y;
+	size_t i, len;
+
+	len = alen > blen ? blen : alen;
+	if (unlikely(skip > len))
+		skip = 0;
+	for (i = skip; i + sizeof(u_int64_t) <= len; i += sizeof(u_int64_t)) {
+		memcpy(&x, a + i, sizeof(x));
+		memcpy(&y, b + i, sizeof(y));
+		if (x != y) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+			i += __builtin_clzll(x ^ y) / 8;
+#else
+			i += __builtin_ctzll(x ^ y) / 8;
+#endif
+			*lcpp = i;
+			return ((int)a[i] - (int)b[i]);
+		}
+	}
+	for (; i < len; i++) {
+		if (a[i] != b[i]) {
+			*lcpp = i;
+			return ((int)a[i] - (int)b[i]);
+		}
+	}
+	*lcpp = len;
+	return ((long)alen - (long)blen);
+}
+
 /*
  * __bam_cmp --
  *	Compare a key to a given record.
  *
  * PUBLIC: int __bam_cmp __P((DB *, const DBT *, PAGE *,
  * PUBLIC:    u_int32_t, int (*)(DB *, const DBT *, const DBT *), int *));
+ *
+ * With lcpp set, the default compare starts at byte skip, and *lcpp gets
+ * how many bytes of the key match the record; 0 when it isn't known.
  */
 static inline int
-__bam_cmp_inline(dbp, dbt, h, indx, func, cmpp, buf)
+__bam_cmp_inline(dbp, dbt, h, indx, func, cmpp, buf, skip, lcpp)
 	DB *dbp;
 	const DBT *dbt;
 	PAGE *h;
@@ -90,6 +140,8 @@ __bam_cmp_inline(dbp, dbt, h, indx, func, cmpp, buf)
 	int (*func)__P((DB *, const DBT *, const DBT *));
 	int *cmpp;
 	uint8_t *buf;
+	size_t skip;
+	size_t *lcpp;
 {
 	BINTERNAL *bi;
 	BKEYDATA *bk;
@@ -122,7 +174,10 @@ __bam_cmp_inline(dbp, dbt, h, indx, func, cmpp, buf)
 			pg_dbt.data = bk->data;
 			ASSIGN_ALIGN_DIFF(u_int32_t, pg_dbt.size, db_indx_t,
 			    bk->len);
-			if (likely(func == __bam_defcmp)) {
+			if (likely(func == __bam_defcmp) && lcpp) {
+				*cmpp = __bam_lcpcmp(dbt->data, dbt->size,
+				    pg_dbt.data, pg_dbt.size, skip, lcpp);
+			} else if (likely(func == __bam_defcmp)) {
 				int len;
 				len = dbt->size > pg_dbt.size ? pg_dbt.size
 				    : dbt->size;
@@ -168,7 +223,10 @@ __bam_cmp_inline(dbp, dbt, h, indx, func, cmpp, buf)
 
 			pg_dbt.data = bi->data;
 			pg_dbt.size = bi->len;
-			if (likely(func == __bam_defcmp)) {
+			if (likely(func == __bam_defcmp) && lcpp) {
+				*cmpp = __bam_lcpcmp(dbt->data, dbt->size,
+				    pg_dbt.data, pg_dbt.size, skip, lcpp);
+			} else if (likely(func == __bam_defcmp)) {
 				int len;
 
 				len = dbt->size > pg_dbt.size ? pg_dbt.size
@@ -347,10 +405,9 @@ __bam_search(dbc, root_pgno, key, flags, stop, recnop, exactp)
 	int adjust, cmp, deloffset, ret, stack;
 	int (*func) __P((DB *, const DBT *, const DBT *));
 	void *cached_pg = NULL;
-	void *bfpool_pg = NULL;
-	bool save = false;
-	uint16_t gen;
-	uint32_t slot;
+	rcache_ref rc[RCACHE_MAX_LEVELS];
+	int nrc = 0, top_level = 0;
+	bool save = false, rc_off = false;
 	unsigned int hh = 0;
 	genid_hash *hash = NULL;
 	__genid_pgno *hashtbl = NULL;
@@ -401,12 +458,13 @@ try_again:
 
 	extern bool gbl_rcache;
 
-	if (gbl_rcache && pg == 1 && bfpool_pg == NULL &&
+	if (gbl_rcache && pg == 1 && !rc_off &&
 	    lock_mode == DB_LOCK_READ && LF_ISSET(S_FIND)) {
 		save = true;
-		if (rcache_find(
-		    dbp, &cached_pg, &bfpool_pg, &gen, &slot) == 0) {
-			h = cached_pg;
+		if (rcache_find(dbp, pg, &rc[0].cached_pg, &rc[0].bfpool_pg,
+		    &rc[0].gen, &rc[0].slot) == 0) {
+			h = cached_pg = rc[0].cached_pg;
+			nrc = 1;
 			goto got_pg;
 		}
 	}
@@ -530,12 +588,8 @@ hash_backup:
 		}
 	}
 
-	if (save && TYPE(h) == P_IBTREE) {	// WORKS ONLY WHEN ROOT IS INTERNAL
-		uint16_t gen = LSN(h).file + LSN(h).offset;
-
-		GET_BH_GEN(h) = gen;
-		rcache_save(dbp, h, gen);
-	}
+	if (save && TYPE(h) == P_IBTREE)	// WORKS ONLY WHEN ROOT IS INTERNAL
+		rcache_save_pg(dbp, h);
 
 	INTERNAL_PTR_CHECK(cp == dbc->internal);
 
@@ -577,6 +631,7 @@ hash_backup:
 
 	/* Choose a comparison function. */
 got_pg:func = t->bt_compare;
+	top_level = LEVEL(h);
 
 	INTERNAL_PTR_CHECK(cp == dbc->internal);
 
@@ -591,15 +646,18 @@ got_pg:func = t->bt_compare;
 		 */
 		adjust = TYPE(h) == P_LBTREE ? P_INDX : O_INDX;
 		uint8_t buf[KEYBUF];
+		size_t lo_lcp = 0, hi_lcp = 0, lcp;
 
 		for (base = 0,
 		    lim = NUM_ENT(h) / (db_indx_t) adjust; lim != 0;
 		    lim >>= 1) {
 			indx = base + ((lim >> 1) * adjust);
 
+			lcp = 0;
 			if ((ret =
 				__bam_cmp_inline(dbp, key, h, indx, func, &cmp,
-				    buf)) != 0)
+				    buf, lo_lcp < hi_lcp ? lo_lcp : hi_lcp,
+				    gbl_bt_search_lcp ? &lcp : NULL)) != 0)
 				goto err;
 			if (cmp == 0) {
 				if (TYPE(h) == P_LBTREE || TYPE(h) == P_LDUP)
@@ -609,7 +667,9 @@ got_pg:func = t->bt_compare;
 			if (cmp > 0) {
 				base = indx + adjust;
 				--lim;
-			}
+				lo_lcp = lcp;
+			} else
+				hi_lcp = lcp;
 		}
 
 		/*
@@ -738,6 +798,25 @@ next:		if (recnop != NULL)
 			lock_mode = stack &&
 			    LF_ISSET(S_WRITE) ? DB_LOCK_WRITE : DB_LOCK_READ;
 
+			/*
+			 * Inner pages within rcache_levels of the root may be
+			 * cached as well; they are validated together once
+			 * the search reads a page from the buffer pool.
+			 */
+			if (!stack && save && !rc_off &&
+			    nrc < RCACHE_MAX_LEVELS &&
+			    top_level - (LEVEL(h) - 1) < rcache_levels() &&
+			    rcache_find(dbp, pg, &rc[nrc].cached_pg,
+			    &rc[nrc].bfpool_pg, &rc[nrc].gen,
+			    &rc[nrc].slot) == 0) {
+				if (!cached_pg) {
+					(void)__memp_fput(mpf, h, 0);
+					(void)__LPUT(dbc, lock);
+				}
+				h = cached_pg = rc[nrc++].cached_pg;
+				continue;
+			}
+
 			if (cached_pg) {
 				/* Used rcache to get here. Don't lck couple. */
 				if ((ret = __db_lget(dbc, 0, pg, lock_mode, 0,
@@ -773,7 +852,9 @@ next:		if (recnop != NULL)
 				 */
 				cached_pg = NULL;
 
-				rcache_invalidate(slot);
+				while (nrc > 0)
+					rcache_invalidate(rc[--nrc].slot);
+				rc_off = true;
 				__LPUT(dbc, lock);
 				goto try_again;
 			}
@@ -782,21 +863,21 @@ next:		if (recnop != NULL)
 
 		if (cached_pg) {
 			/* Used rcache and got child page. Validate rcache. */
-			DB_LSN *l1 = &LSN(cached_pg);
-			DB_LSN *l2 = &LSN(bfpool_pg);
 			cached_pg = NULL;
 
-			if (gen == GET_BH_GEN(bfpool_pg)
-			    && memcmp(l1, l2, sizeof(DB_LSN)) == 0 && gen == GET_BH_GEN(bfpool_pg)	//re-check. warm&fuzzy
-			    ) {
-				;
-			} else {
+			if (!rcache_valid(rc, nrc)) {
+				nrc = 0;
+				rc_off = true;
 				__memp_fput(mpf, h, 0);
 				__LPUT(dbc, lock);
-				rcache_invalidate(slot);
 				goto try_again;
 			}
+			nrc = 0;
 		}
+
+		if (save && lock_mode == DB_LOCK_READ &&
+		    TYPE(h) == P_IBTREE && top_level - LEVEL(h) < rcache_levels())
+			rcache_save_pg(dbp, h);
 	}
 	/* NOTREACHED */
 
@@ -70,6 +70,7 @@ static int __bam_broot __P((DBC *, PAGE *, PAGE *, PAGE *));
 static int __bam_page __P((DBC *, EPG *, EPG *));
 static int __bam_pinsert __P((DBC *, EPG *, PAGE *, PAGE *, int));
 static int __bam_psplit __P((DBC *, EPG *, PAGE *, PAGE *, db_indx_t *));
+static db_indx_t __bam_psplit_pfx __P((DB *, PAGE *, db_indx_t, int));
 static int __bam_root __P((DBC *, EPG *));
 static int __ram_root __P((DBC *, PAGE *, PAGE *, PAGE *));
 
@@ -1022,6 +1023,62 @@ noprefix:			nksize = child_bk->len;
 	return (0);
 }
 
+/*
+ * __bam_psplit_pfx --
+ *	Look up to window key/data pairs either side of a leaf split point
+ *	for the one whose separator, as computed by the prefix routine, is
+ *	shortest.  Ties go to the pair closest to the original split point.
+ */
+static db_indx_t
+__bam_psplit_pfx(dbp, pp, splitp, window)
+	DB *dbp;
+	PAGE *pp;
+	db_indx_t splitp;
+	int window;
+{
+	BTREE *t;
+	BKEYDATA *a, *b;
+	DBT ad, bd;
+	db_indx_t best;
+	size_t len, bestlen;
+	int cnt, off;
+	u_int8_t abuf[KEYBUF], bbuf[KEYBUF];
+
+	t = dbp->bt_internal;
+	if (t->bt_prefix == NULL)
+		return (splitp);
+
+	best = splitp;
+	bestlen = SIZE_MAX;
+	for (cnt = 0; cnt <= 2 * window; ++cnt) {
+		/* 0, -1, +1, -2, +2, ... pairs from the split point. */
+		off = (int)splitp +
+		    (cnt & 1 ? -(cnt + 1) / 2 : cnt / 2) * P_INDX;
+		if (off < P_INDX || off > (int)NUM_ENT(pp) - P_INDX)
+			continue;
+
+		a = GET_BKEYDATA(dbp, pp, off - P_INDX);
+		b = GET_BKEYDATA(dbp, pp, off);
+		if (bk_decompress(dbp, pp, &a, abuf, KEYBUF) != 0 ||
+		    bk_decompress(dbp, pp, &b, bbuf, KEYBUF) != 0)
+			continue;
+		if (B_TYPE(a) != B_KEYDATA || B_TYPE(b) != B_KEYDATA)
+			continue;
+
+		memset(&ad, 0, sizeof(ad));
+		ad.data = a->data;
+		ASSIGN_ALIGN_DIFF(u_int32_t, ad.size, db_indx_t, a->len);
+		memset(&bd, 0, sizeof(bd));
+		bd.data = b->data;
+		ASSIGN_ALIGN_DIFF(u_int32_t, bd.size, db_indx_t, b->len);
+		if ((len = t->bt_prefix(dbp, &ad, &bd)) < bestlen) {
+			bestlen = len;
+			best = (db_indx_t)off;
+		}
+	}
+	return (best);
+}
+
 /*
  * __bam_psplit --
  *	Do the real work of splitting the page.
@@ -1036,7 +1093,7 @@ __bam_psplit(dbc, cp, lp, rp, splitret)
 	DB *dbp;
 	PAGE *pp;
 	db_indx_t half, *inp, nbytes, off, splitp, top;
-	int adjust, cnt, iflag, isbigkey, ret;
+	int adjust, cnt, iflag, isbigkey, ret, sorted;
 
 	dbp = dbc->dbp;
 	pp = cp->page;
@@ -1077,12 +1134,15 @@ __bam_psplit(dbc, cp, lp, rp, splitret)
 	 * wrong, we'll do the split the right way next time.
 	 */
 	off = 0;
+	sorted = 0;
 	if (NEXT_PGNO(pp) == PGNO_INVALID && cp->indx >= NUM_ENT(pp) - adjust)
 		off = NUM_ENT(pp) - adjust;
 	else if (PREV_PGNO(pp) == PGNO_INVALID && cp->indx == 0)
 		off = adjust;
-	if (off != 0)
+	if (off != 0) {
+		sorted = 1;
 		goto sort;
+	}
 
 	/*
 	 * Split the data to the left and right pages.  Try not to split on
@@ -1187,6 +1247,17 @@ sort:	splitp = off;
 			}
 		}
 
+	/*
+	 * The key promoted to the parent is truncated to the shortest prefix
+	 * that still separates the two pages.  Moving the split point by a
+	 * few items can make that prefix a lot shorter on wide keys, which
+	 * buys fanout on every internal page above.
+	 */
+	if (TYPE(pp) == P_LBTREE && !sorted && !isbigkey &&
+	    dbp->dbenv->attr.btree_split_pfx_window > 0)
+		splitp = __bam_psplit_pfx(dbp, pp, splitp,
+		    dbp->dbenv->attr.btree_split_pfx_window);
+
 	/*
 	 * We can't split in the middle a set of duplicates.  We know that
 	 * no duplicate set can take up more than about 25% of the page,
@@ -668,6 +668,7 @@ struct __db_log_cursor {
 #define	DB_LOG_SILENT_ERR	0x04	/* Turn-off error messages. */
 #define DB_LOG_NO_PANIC		0x08    /* Don't panic on error. */
 #define DB_LOG_CUSTOM_SIZE  0x10    /* This cursor has a custom size */
+#define DB_LOG_REP_FILL     0x20    /* Read through the log read cache */
 	u_int32_t flags;
     struct __db_log_cursor *next;
     struct __db_log_cursor *prev;
@@ -699,6 +700,11 @@ struct __db_log_stat {
 	u_int32_t st_regsize;		/* Region size. */
 	u_int32_t st_maxcommitperflush;	/* Max number of commits in a flush. */
 	u_int32_t st_mincommitperflush;	/* Min number of commits in a flush. */
+	u_int32_t st_commitsflushed;	/* Commits made durable by syncs. */
+	u_int32_t st_gc_waits;		/* Group-commit waits before a sync. */
+	u_int32_t st_gc_window_usec;	/* Last group-commit wait. */
+	u_int32_t st_gc_arrival_usec;	/* Avg commit inter-arrival time. */
+	u_int32_t st_gc_fsync_usec;	/* Avg log fsync time. */
 	u_int32_t st_total_wakeups;	/* Total writer td-wakeup. */
 	u_int32_t st_false_wakeups;	/* No-write td-wakeup counter. */
 	u_int32_t st_max_td_written;	/* Max flushed in a wakeup. */
@@ -727,6 +733,7 @@ struct __db_log_stat {
 
 /* Flag values for DB_MPOOLFILE->get. */
 #define	DB_MPOOL_COMPACT	0x080   /* Compact a page if necessary */
+#define	DB_MPOOL_USEONCE	0x100   /* Scan access, don't promote page */
 
 /* Flag values for DB_MPOOLFILE->put, DB_MPOOLFILE->set. */
 #define	DB_MPOOL_CLEAN		0x001	/* Page is not modified. */
@@ -813,6 +820,8 @@ struct __db_mpoolfile {
 	int (*open)__P((DB_MPOOLFILE *, const char *, u_int32_t, int, size_t));
 	int (*put) __P((DB_MPOOLFILE *, void *, u_int32_t));
 	int (*set) __P((DB_MPOOLFILE *, void *, u_int32_t));
+	int (*get_dirty_gen) __P((DB_MPOOLFILE *, u_int64_t *));
+	int (*get_stat) __P((DB_MPOOLFILE *, DB_MPOOL_FSTAT *));
 	int (*get_clear_len) __P((DB_MPOOLFILE *, u_int32_t *));
 	int (*set_clear_len) __P((DB_MPOOLFILE *, u_int32_t));
 	int (*get_fileid) __P((DB_MPOOLFILE *, u_int8_t *));
@@ -894,6 +903,9 @@ struct __db_mpool_stat {
 	u_int64_t st_alloc_max_pages;	/* Max checked during allocation. */
 	u_int64_t st_ckp_pages_sync;	/* Number of pages sync'd using perfect ckp. */
 	u_int64_t st_ckp_pages_skip;	/* Number of pages skipped using perfect ckp. */
+	u_int64_t st_numa_local_hit;	/* Hits from the cache's home node. */
+	u_int64_t st_numa_remote_hit;	/* Hits from another node. */
+	u_int64_t st_2q_promote;	/* Pages promoted out of probation. */
 };
 
 /* Mpool file statistics structure. */
@@ -912,6 +924,8 @@ struct __db_mpool_fstat {
 	u_int64_t st_page_out;		/* Pages written out. */
 	u_int64_t st_ro_merges;		/* Read merges performed. */
 	u_int64_t st_rw_merges;		/* Write merges performed. */
+	u_int64_t st_evict;		/* Pages evicted from the cache. */
+	u_int64_t st_pages;		/* Pages in the cache. */
 };
 
 /*******************************************************
@@ -2051,6 +2065,10 @@ typedef int (*collect_locks_f)(void *args, int64_t threadid, int32_t lockerid,
 		const char *mode, const char *status, const char *table,
 		int64_t page, const char *rectype);
 
+typedef int (*collect_lock_heat_f)(void *args, const char *table,
+		int64_t page, const char *rectype, u_int64_t nwaits,
+		u_int64_t total_us, u_int64_t max_us, const char *stacks);
+
 /* Database Environment handle. */
 struct __db_env {
 	/*******************************************************
@@ -2282,6 +2300,7 @@ struct __db_env {
 	int  (*set_lg_regionmax) __P((DB_ENV *, u_int32_t));
 	int  (*log_archive) __P((DB_ENV *, char **[], u_int32_t));
 	int  (*log_get_last_lsn) __P((DB_ENV *, DB_LSN *));
+	int  (*log_prealloc) __P((DB_ENV *));
 	int  (*log_cursor) __P((DB_ENV *, DB_LOGC **, u_int32_t));
 	int  (*log_file) __P((DB_ENV *, const DB_LSN *, char *, size_t));
 	int  (*log_flush) __P((DB_ENV *, const DB_LSN *));
@@ -2313,6 +2332,7 @@ struct __db_env {
 	int  (*lock_id_set_logical_abort) __P((DB_ENV *, u_int32_t));
 	int  (*lock_stat) __P((DB_ENV *, DB_LOCK_STAT **, u_int32_t));
 	int  (*collect_locks) __P((DB_ENV *, collect_locks_f, void *arg));
+	int  (*collect_lock_heat) __P((DB_ENV *, collect_lock_heat_f, void *arg));
 	int  (*lock_locker_lockcount)
 		__P((DB_ENV *, u_int32_t id, u_int32_t *nlocks));
 	int  (*lock_locker_pagelockcount)
@@ -2348,6 +2368,8 @@ struct __db_env {
 	int  (*memp_dump_default) __P((DB_ENV *, u_int32_t));
 	int  (*memp_load_default) __P((DB_ENV *));
 	int  (*memp_trickle) __P((DB_ENV *, int, int *, int));
+	int  (*memp_fuzzy) __P((DB_ENV *, int, int, int *));
+	int  (*memp_sweep_sparse) __P((DB_ENV *, int, int *));
 
 	void *rep_handle;		/* Replication handle and methods. */
 	int  (*rep_elect) __P((DB_ENV *, int, int, u_int32_t, u_int32_t *, char **));
@@ -2558,8 +2580,10 @@ struct __db_env {
 	int (*unlock_recovery_lock)(DB_ENV *);
 	/* Trigger/consumer signalling support */
 	int(*trigger_subscribe) __P((DB_ENV *, const char *, pthread_cond_t **,
-					 pthread_mutex_t **, const uint8_t **active));
+					 pthread_mutex_t **, const uint8_t **active,
+					 const uint64_t **gen));
 	int(*trigger_unsubscribe) __P((DB_ENV *, const char *));
+	int(*trigger_commit) __P((DB_ENV *, const char *));
 	int(*trigger_open) __P((DB_ENV *, const char *));
 	int(*trigger_close) __P((DB_ENV *, const char *));
 };
@@ -2845,6 +2869,8 @@ struct __recovery_processor {
 	LINKC_T(struct __recovery_processor) lnk;
 	comdb2ma msp;
 	int mspsize;
+	void *pglogs;		/* page lsn list, for rep_apply_page_queues */
+	u_int32_t pglogs_cnt;
 };
 
 struct __rowlock_list {
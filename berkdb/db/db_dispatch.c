@@ -505,6 +505,82 @@ __db_dispatch(dbenv, dtab, dtabsize, db, lsnp, redo, info)
 		    rectype == DB___txn_ckp || rectype == DB___txn_recycle)
 			return (dtab[rectype] (dbenv, db, lsnp, redo, info));
 		break;
+	case DB_TXN_BACKWARD_ROLL:
+	case DB_TXN_FORWARD_ROLL:
+		if ((ret = __db_dispatch_prep(dbenv,
+		    db, lsnp, &redo, info, &make_call)) != 0)
+			return (ret);
+		break;
+	case DB_TXN_GETPGNOS:
+		/*
+		 * If this is one of DB's own log records, we simply
+		 * dispatch.
+		 */
+		if (rectype < DB_user_BEGIN) {
+			make_call = 1;
+			break;
+		}
+
+		/*
+		 * If we're still here, this is a custom record in an
+		 * application that's doing app-specific logging.  Such a
+		 * record doesn't have a getpgno function for the user
+		 * dispatch function to call--the getpgnos functions return
+		 * which pages replication needs to lock using the TXN_RECS
+		 * structure, which is private and not something we want to
+		 * document.
+		 *
+		 * Thus, we leave any necessary locking for the app's
+		 * recovery function to do during the upcoming
+		 * DB_TXN_APPLY.  Fill in default getpgnos info (we need
+		 * a stub entry for every log record that will get
+		 * DB_TXN_APPLY'd) and return success.
+		 */
+		return (__db_default_getpgnos(dbenv, lsnp, info));
+	case DB_TXN_BACKWARD_ALLOC:
+	default:
+		return (__db_unknown_flag(
+		    dbenv, "__db_dispatch", (u_int32_t)redo));
+	}
+
+	if (make_call)
+		return (__db_dispatch_call(dbenv,
+		    dtab, dtabsize, db, lsnp, redo, info));
+
+	return (0);
+}
+
+/*
+ * __db_dispatch_prep --
+ *
+ * The part of __db_dispatch for the backward and forward recovery passes
+ * that decides, from the transaction list, whether the record is to be
+ * undone or redone at all.  It looks at and updates the transaction list,
+ * so it has to run in log order; __db_dispatch_call can then apply the
+ * record later, or in another thread.  Sets *make_callp, and may change
+ * the operation in *redop.
+ *
+ * PUBLIC: int __db_dispatch_prep __P((DB_ENV *,
+ * PUBLIC:     DBT *, DB_LSN *, db_recops *, void *, int *));
+ */
+int
+__db_dispatch_prep(dbenv, db, lsnp, redop, info, make_callp)
+	DB_ENV *dbenv;
+	DBT *db;
+	DB_LSN *lsnp;
+	db_recops *redop;
+	void *info;
+	int *make_callp;
+{
+	u_int32_t rectype, txnid;
+	int make_call, ret;
+
+	LOGCOPY_32(&rectype, db->data);
+	LOGCOPY_32(&txnid, (u_int8_t *)db->data + sizeof(rectype));
+	make_call = ret = 0;
+	*make_callp = 0;
+
+	switch (*redop) {
 	case DB_TXN_BACKWARD_ROLL:
 		/*
 		 * Running full recovery in the backward pass.  If we've
@@ -587,7 +663,7 @@ __db_dispatch(dbenv, dtab, dtabsize, db, lsnp, redo, info)
 				 * present during the backward pass.
 				 */
 				make_call = 1;
-				redo = DB_TXN_BACKWARD_ALLOC;
+				*redop = DB_TXN_BACKWARD_ALLOC;
 			} else if (rectype == DB___dbreg_register) {
 				/*
 				 * This may be a transaction dbreg_register.
@@ -601,86 +677,79 @@ __db_dispatch(dbenv, dtab, dtabsize, db, lsnp, redo, info)
 			}
 		}
 		break;
-	case DB_TXN_GETPGNOS:
-		/*
-		 * If this is one of DB's own log records, we simply
-		 * dispatch.
-		 */
-		if (rectype < DB_user_BEGIN) {
-			make_call = 1;
-			break;
-		}
-
-		/*
-		 * If we're still here, this is a custom record in an
-		 * application that's doing app-specific logging.  Such a
-		 * record doesn't have a getpgno function for the user
-		 * dispatch function to call--the getpgnos functions return
-		 * which pages replication needs to lock using the TXN_RECS
-		 * structure, which is private and not something we want to
-		 * document.
-		 *
-		 * Thus, we leave any necessary locking for the app's
-		 * recovery function to do during the upcoming
-		 * DB_TXN_APPLY.  Fill in default getpgnos info (we need
-		 * a stub entry for every log record that will get
-		 * DB_TXN_APPLY'd) and return success.
-		 */
-		return (__db_default_getpgnos(dbenv, lsnp, info));
-	case DB_TXN_BACKWARD_ALLOC:
 	default:
 		return (__db_unknown_flag(
-		    dbenv, "__db_dispatch", (u_int32_t)redo));
+		    dbenv, "__db_dispatch_prep", (u_int32_t)*redop));
 	}
 
 	/*
 	 * The switch statement uses ret to receive the return value of
 	 * __db_txnlist_find, which returns a large number of different
-	 * statuses, none of which we will be returning.  For safety,
-	 * let's reset this here in case we ever do a "return(ret)"
-	 * below in the future.
+	 * statuses, none of which we will be returning.
 	 */
-	ret = 0;
+	*make_callp = make_call;
+	return (0);
+}
 
-	if (make_call) {
+/*
+ * __db_dispatch_call --
+ *
+ * Apply a record that __db_dispatch decided to make the call for.
+ *
+ * PUBLIC: int __db_dispatch_call __P((DB_ENV *,
+ * PUBLIC:     int (**)__P((DB_ENV *, DBT *, DB_LSN *, db_recops, void *)),
+ * PUBLIC:     size_t, DBT *, DB_LSN *, db_recops, void *));
+ */
+int
+__db_dispatch_call(dbenv, dtab, dtabsize, db, lsnp, redo, info)
+	DB_ENV *dbenv;
+	int (**dtab)__P((DB_ENV *, DBT *, DB_LSN *, db_recops, void *));
+	size_t dtabsize;
+	DBT *db;
+	DB_LSN *lsnp;
+	db_recops redo;
+	void *info;
+{
+	u_int32_t rectype, txnid;
+
+	LOGCOPY_32(&rectype, db->data);
+	LOGCOPY_32(&txnid, (u_int8_t *)db->data + sizeof(rectype));
+
+	/*
+	 * If the debug flag is set then we are logging
+	 * records for a non-durable update so that they
+	 * may be examined for diagnostic purposes.
+	 * So only make the call if we are printing,
+	 * otherwise we need to extract the previous
+	 * lsn so undo will work properly.
+	 */
+	if (rectype & DB_debug_FLAG) {
+		if (redo == DB_TXN_PRINT)
+			rectype &= ~DB_debug_FLAG;
+		else {
+			LOGCOPY_TOLSN(lsnp,
+			    (u_int8_t *)db->data +
+			    sizeof(rectype) + sizeof(txnid));
+			return (0);
+		}
+	}
+	if (rectype >= DB_user_BEGIN && dbenv->app_dispatch != NULL)
+		return (dbenv->app_dispatch(dbenv, db, lsnp, redo));
+	else {
 		/*
-		 * If the debug flag is set then we are logging
-		 * records for a non-durable update so that they
-		 * may be examined for diagnostic purposes.
-		 * So only make the call if we are printing,
-		 * otherwise we need to extract the previous
-		 * lsn so undo will work properly.
+		 * The size of the dtab table argument is the same as
+		 * the standard table, use the standard table's size
+		 * as our sanity check.
 		 */
-		if (rectype & DB_debug_FLAG) {
-			if (redo == DB_TXN_PRINT)
-				rectype &= ~DB_debug_FLAG;
-			else {
-				LOGCOPY_TOLSN(lsnp,
-				    (u_int8_t *)db->data +
-				    sizeof(rectype) + sizeof(txnid));
-				return (0);
-			}
-		}
-		if (rectype >= DB_user_BEGIN && dbenv->app_dispatch != NULL)
-			return (dbenv->app_dispatch(dbenv, db, lsnp, redo));
-		else {
-			/*
-			 * The size of the dtab table argument is the same as
-			 * the standard table, use the standard table's size
-			 * as our sanity check.
-			 */
-			if (rectype > dtabsize || dtab[rectype] == NULL) {
-				__db_err(dbenv,
-				    "Illegal record type %lu in log",
-				    (u_long)rectype);
-				return (EINVAL);
-			}
-			/* let's do this only on the replicants, for now */
-			return (dtab[rectype](dbenv, db, lsnp, redo, info));
+		if (rectype > dtabsize || dtab[rectype] == NULL) {
+			__db_err(dbenv,
+			    "Illegal record type %lu in log",
+			    (u_long)rectype);
+			return (EINVAL);
 		}
+		/* let's do this only on the replicants, for now */
+		return (dtab[rectype](dbenv, db, lsnp, redo, info));
 	}
-
-	return (0);
 }
 
 /*
@@ -760,6 +760,12 @@ __db_cursor_arg(dbp, flags)
 		LF_CLR(DB_PAGE_ORDER | DB_DISCARD_PAGES);
 	}
 
+	/* Discarding pages works for any scan, not just page-order ones. */
+	if (LF_ISSET(DB_DISCARD_PAGES)) {
+		discardp = 1;
+		LF_CLR(DB_DISCARD_PAGES);
+	}
+
 	/* Check for invalid function flags. */
 	switch (flags) {
 	case 0:
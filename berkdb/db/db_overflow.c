@@ -89,11 +89,21 @@ __db_goff(dbp, dbt, tlen, pgno, bpp, bpsz)
 	db_indx_t bytes;
 	u_int32_t curoff, needed, start;
 	u_int8_t *p, *src;
+	u_int32_t nocache;
 	int ret;
 
 	dbenv = dbp->dbenv;
 	mpf = dbp->mpf;
 
+	/*
+	 * Pages of a large item are read once, front to back; read them
+	 * without pushing the rest of the cache out.  Pages that were
+	 * already cached keep their priority.
+	 */
+	nocache = (dbenv->attr.overflow_nocache_kb > 0 &&
+	    tlen >= (u_int32_t)dbenv->attr.overflow_nocache_kb * 1024) ?
+	    DB_MPOOL_NOCACHE : 0;
+
 	/*
 	 * Check if the buffer is big enough; if it is not and we are
 	 * allowed to malloc space, then we'll malloc it.  If we are
@@ -139,7 +149,7 @@ __db_goff(dbp, dbt, tlen, pgno, bpp, bpsz)
 	 */
 	dbt->size = needed;
 	for (curoff = 0, p = dbt->data; pgno != PGNO_INVALID && needed > 0;) {
-		if ((ret = __memp_fget(mpf, &pgno, 0, &h)) != 0)
+		if ((ret = __memp_fget(mpf, &pgno, nocache, &h)) != 0)
 			return (ret);
 
 		/* Check if we need any bytes from this page. */
@@ -158,7 +168,7 @@ __db_goff(dbp, dbt, tlen, pgno, bpp, bpsz)
 		}
 		curoff += OV_LEN(h);
 		pgno = h->next_pgno;
-		(void)__memp_fput(mpf, h, 0);
+		(void)__memp_fput(mpf, h, nocache);
 	}
 	return (0);
 }
@@ -48,6 +48,7 @@
 struct __btree;		typedef struct __btree BTREE;
 struct __cursor;	typedef struct __cursor BTREE_CURSOR;
 struct __epg;		typedef struct __epg EPG;
+struct __bt_hash_hints; typedef struct __bt_hash_hints BT_HASH_HINTS;
 struct __recno;		typedef struct __recno RECNO;
 /* comdb2 addition */
 struct __cursor_pause;	typedef struct __cursor_pause BTREE_CURSOR_PAUSE;
@@ -280,6 +281,12 @@ extern u_int8_t compile_time_assert_btree_cursor_ser_size[sizeof(DBCS)
 /*
  * The in-memory, per-tree btree/recno data structure.
  */
+/* Per-tree table of key hashes to leaf pages, see bt_cursor.c. */
+struct __bt_hash_hints {
+	u_int32_t mask;			/* Number of slots - 1. */
+	u_int64_t slot[];		/* Key hash << 32 | pgno. */
+};
+
 struct __btree {			/* Btree access method. */
 	/*
 	 * !!!
@@ -312,6 +319,13 @@ struct __btree {			/* Btree access method. */
 	 */
 	db_pgno_t bt_lpgno;		/* Last insert location. */
 
+	/*
+	 * !!!
+	 * Like bt_lpgno, the hash hints are advisory only: allocated on
+	 * first use, then read and written a slot at a time without a mutex.
+	 */
+	BT_HASH_HINTS *bt_hash_hints;	/* Key hash to leaf page. */
+
 	/*
 	 * !!!
 	 * The re_modified field is NOT protected by any mutex, and for this
@@ -36,6 +36,10 @@ BERK_DEF_ATTR(btpf_wndw_inc, "Increment factor for the number of pages read ahea
 BERK_DEF_ATTR(btpf_pg_gap, "Min. number of records to the page limit before read ahead", BERK_ATTR_TYPE_INTEGER, 0)
 BERK_DEF_ATTR(btpf_cu_gap, "How close a cursor should be (pages) to the prefaulted limit before prefaulting again", BERK_ATTR_TYPE_INTEGER, 5)
 BERK_DEF_ATTR(btpf_min_th, "Preload pages only if the tree has heigth less than this parameter", BERK_ATTR_TYPE_INTEGER, 1)
+BERK_DEF_ATTR(btpf_seq_th, "Records a cursor must read in one direction before reading ahead", BERK_ATTR_TYPE_INTEGER, 16)
+BERK_DEF_ATTR(btpf_ovfl, "Also read ahead the overflow pages referenced by read ahead leaf pages", BERK_ATTR_TYPE_BOOLEAN, 0)
+BERK_DEF_ATTR(btree_split_pfx_window, "Key/data pairs either side of the middle a leaf split may move to promote a shorter separator", BERK_ATTR_TYPE_INTEGER, 0)
+BERK_DEF_ATTR(btree_hash_hint, "Slots in the per-btree table of key hashes to the leaf pages they were last found on, tried before descending for equality lookups", BERK_ATTR_TYPE_INTEGER, 0)
 BERK_DEF_ATTR(recovery_verify, "After recovery, run a full pass to make sure everything is applied", BERK_ATTR_TYPE_BOOLEAN, 0)
 BERK_DEF_ATTR(recovery_verify_fatal, "Abort if recovery_verify is set, and fails.", BERK_ATTR_TYPE_BOOLEAN, 0)
 BERK_DEF_ATTR(cache_lc, "Collect logs into LSN_COLLECTIONs as they come in", BERK_ATTR_TYPE_BOOLEAN, 0)
@@ -59,6 +63,13 @@ BERK_DEF_ATTR(latch_max_poll, "Poll latch this many times before returning deadl
 BERK_DEF_ATTR(latch_timed_mutex, "Use a timed mutex", BERK_ATTR_TYPE_BOOLEAN, 1)
 BERK_DEF_ATTR(log_cursor_cache, "Cache log cursors", BERK_ATTR_TYPE_BOOLEAN, 0)
 BERK_DEF_ATTR(recovery_processor_poll_interval_us, "Recovery processor wakes this often to check workers", BERK_ATTR_TYPE_INTEGER, 1000)
+BERK_DEF_ATTR(rep_apply_page_queues, "Spread the records of a replicated transaction over this many apply queues by the pages they touch; 0 uses one queue per file", BERK_ATTR_TYPE_INTEGER, 0)
+BERK_DEF_ATTR(recovery_parallel_threads, "Apply the page records of the recovery backward and forward passes on this many threads, split by file; 0 applies them all in the recovering thread", BERK_ATTR_TYPE_INTEGER, 0)
+BERK_DEF_ATTR(overflow_nocache_kb, "Read overflow items of at least this many kilobytes, such as large blobs, without keeping their pages in the cache; 0 caches them all", BERK_ATTR_TYPE_INTEGER, 1024)
+BERK_DEF_ATTR(log_prealloc_files, "Keep this many log files ahead of the current one created and allocated, so a log switch doesn't wait on the file system", BERK_ATTR_TYPE_INTEGER, 0)
+BERK_DEF_ATTR(ritem_split_gap, "Log a same-size item replacement as a record per changed range when the ranges are at least this many unchanged bytes apart; 0 logs one record spanning all of the changes", BERK_ATTR_TYPE_INTEGER, 128)
+BERK_DEF_ATTR(lock_detect_skip_unblocked, "Skip the deadlock detector run for a new lock wait when none of the lockers it waits for is waiting itself; whichever of them waits last runs it", BERK_ATTR_TYPE_BOOLEAN, 1)
+BERK_DEF_ATTR(lock_lowpri_wait_last, "Queue lock waiters ahead of waiting low priority lockers, such as schema change and analyze, instead of behind them", BERK_ATTR_TYPE_BOOLEAN, 1)
 BERK_DEF_ATTR(lsnerr_logflush, "Flush log on lsn error", BERK_ATTR_TYPE_BOOLEAN, 1)
 BERK_DEF_ATTR(tracked_locklist_init, "Initial allocation count for tracked locks", BERK_ATTR_TYPE_INTEGER, 10)
 /* This is a placeholder for now */
@@ -41,7 +41,8 @@ typedef enum {
 
 	DB_SYNC_TRICKLE,           /* Trickle sync. */
 	DB_SYNC_REMOVABLE_QEXTENT,  /* Remove buffers of removable extent */
-	DB_SYNC_LRU		         /* Trickle LRU pages. */
+	DB_SYNC_LRU,		         /* Trickle LRU pages. */
+	DB_SYNC_FUZZY		         /* Trickle oldest-dirtied pages. */
 } db_sync_op;
 
 /*
@@ -158,6 +159,7 @@ struct __mpool {
 	 */
 	int	  htab_buckets;	/* Number of hash table entries. */
 	roff_t	  htab;		/* Hash table offset. */
+	int	  numa_node;	/* Home NUMA node of this cache, or -1. */
 	u_int32_t last_checked;	/* Last bucket checked for free. */
 	u_int32_t lru_count;	/* Counter for buffer LRU */
 
@@ -211,6 +213,7 @@ struct __db_mpool_hash {
 #define MPOOL_PRI_INDEX     2   /* Index pages get a 50% boost. */
 #define MPOOL_PRI_INTERNAL  4   /* Internal pages get an additional 25% boost. */
 #define	MPOOL_PRI_VERY_HIGH	1	/* Add number of buffers in pool. */
+#define	MPOOL_PRI_HOT		4	/* 2Q: re-referenced pages get 25%. */
 
 /*
  * MPOOLFILE --
@@ -273,6 +276,13 @@ struct __mpoolfile {
 	int32_t	  no_backing_file;	/* Never open a backing file. */
 	int32_t	  unlink_on_close;	/* Unlink file on last close. */
 
+	/*
+	 * Bumped every time a page of the file is marked dirty, whether by
+	 * a transaction, its abort or recovery.  While it doesn't move, no
+	 * page of the file has changed.
+	 */
+	u_int64_t dirty_gen;
+
 	/*
 	 * We do not protect the statistics in "stat" because of the cost of
 	 * the mutex in the get/put routines.  There is a chance that a count
@@ -329,6 +339,7 @@ struct __bh {
 #define	BH_TRASH	0x020		/* Page is garbage. */
 #define BH_NOINCR	0x040		/* Don't increment lru_cache. */
 #define BH_PREFAULT	0x080		/* prefault pages */
+#define BH_PROBATION	0x100		/* Not yet re-referenced (2Q). */
 	u_int16_t	flags;
 	u_int16_t	generation;	/* This changes before page changes */
 	u_int32_t	priority;	/* LRU priority. */
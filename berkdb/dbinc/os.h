@@ -70,15 +70,32 @@ struct __fh_t {
 	u_int32_t pgsize;
 	u_int32_t offset;
 
+	/*
+	 * File size last seen by a compressed page write; a page past it is
+	 * written whole, so the file never ends short of a page.
+	 */
+	off_t	  pgcomp_eof;
+
 #define	DB_FH_NOSYNC	0x01		/* Handle doesn't need to be sync'd. */
 #define	DB_FH_OPENED	0x02		/* Handle is valid. */
 #define	DB_FH_UNLINK	0x04		/* Unlink on close */
 #define	DB_FH_TEMP   	0x08		/* Unlink on close */
 #define DB_FH_DIRECT    0x10		/* On linux use to do direct IO */
 #define DB_FH_SYNC      0x20
+#define DB_FH_PGCOMP    0x40		/* Pages may be stored compressed */
 	u_int8_t flags;
 };
 
+/* One vectored request of an __os_uring_rw batch. */
+struct iovec;
+typedef struct __os_uring_req {
+	struct iovec *iov;
+	int	  iovcnt;
+	size_t	  len;			/* Total bytes described by iov. */
+	off_t	  off;			/* File offset. */
+	int	  res;			/* Bytes transferred, or -errno. */
+} OS_URING_REQ;
+
 #if defined(__cplusplus)
 }
 #endif
@@ -220,6 +220,7 @@ struct __db_reginfo_t {		/* __db_r_attach IN parameters. */
 #define	REGION_CREATE		0x01	/* Caller created region. */
 #define	REGION_CREATE_OK	0x02	/* Caller willing to create region. */
 #define	REGION_JOIN_OK		0x04	/* Caller is looking for a match. */
+#define	REGION_ANONMAP		0x08	/* Region is an anonymous mapping. */
 	u_int32_t   flags;
 	int         fd;
 };
@@ -8,6 +8,7 @@ struct __db_trigger_subscription {
 	char *name;
 	int active;
 	uint8_t open;
+	uint64_t gen; /* bumped each time an insert into the queue commits */
 	pthread_cond_t cond;
 	pthread_mutex_t lock;
 };
@@ -88,8 +88,10 @@ static int __dbenv_set_comdb2_dirs __P((DB_ENV *, char *, char *, char *));
 static int __dbenv_set_is_tmp_tbl __P((DB_ENV *, int));
 static int __dbenv_set_use_sys_malloc __P((DB_ENV *, int));
 static int __dbenv_trigger_subscribe __P((DB_ENV *, const char *,
-	pthread_cond_t **, pthread_mutex_t **, const uint8_t **));
+	pthread_cond_t **, pthread_mutex_t **, const uint8_t **,
+	const uint64_t **));
 static int __dbenv_trigger_unsubscribe __P((DB_ENV *, const char *));
+static int __dbenv_trigger_commit __P((DB_ENV *, const char *));
 static int __dbenv_trigger_open __P((DB_ENV *, const char *));
 static int __dbenv_trigger_close __P((DB_ENV *, const char *));
 int __dbenv_apply_log __P((DB_ENV *, unsigned int, unsigned int, int64_t,
@@ -332,6 +334,7 @@ __dbenv_init(dbenv)
 
 	dbenv->trigger_subscribe = __dbenv_trigger_subscribe;
 	dbenv->trigger_unsubscribe = __dbenv_trigger_unsubscribe;
+	dbenv->trigger_commit = __dbenv_trigger_commit;
 	dbenv->trigger_open = __dbenv_trigger_open;
 	dbenv->trigger_close = __dbenv_trigger_close;
 
@@ -1360,12 +1363,13 @@ __dbenv_get_durable_lsn(dbenv, lsnp, generation)
 }
 
 static int
-__dbenv_trigger_subscribe(dbenv, fname, cond, lock, open)
+__dbenv_trigger_subscribe(dbenv, fname, cond, lock, open, gen)
 	DB_ENV *dbenv;
 	const char *fname;
 	pthread_cond_t **cond;
 	pthread_mutex_t **lock;
 	const uint8_t **open;
+	const uint64_t **gen;
 {
 	int rc = 1;
 	struct __db_trigger_subscription *t;
@@ -1376,6 +1380,7 @@ __dbenv_trigger_subscribe(dbenv, fname, cond, lock, open)
 		*cond = &t->cond;
 		*lock = &t->lock;
 		*open = &t->open;
+		*gen = &t->gen;
 		rc = 0;
 	}
 	Pthread_mutex_unlock(&t->lock);
@@ -1394,6 +1399,28 @@ __dbenv_trigger_unsubscribe(dbenv, fname)
 	return 0;
 }
 
+/*
+ * An insert into the queue has committed: wake its consumers.  Unlike the
+ * signal from __db_pitem, which fires before the insert can be read and is
+ * lost if no consumer is waiting at that instant, the bump of gen is seen by
+ * a consumer that checks it under the lock before it waits.
+ */
+static int
+__dbenv_trigger_commit(dbenv, fname)
+	DB_ENV *dbenv;
+	const char *fname;
+{
+	struct __db_trigger_subscription *t;
+	t = __db_get_trigger_subscription(fname);
+	Pthread_mutex_lock(&t->lock);
+	if (t->active) {
+		++t->gen;
+		Pthread_cond_broadcast(&t->cond);
+	}
+	Pthread_mutex_unlock(&t->lock);
+	return 0;
+}
+
 static int
 __dbenv_trigger_open(dbenv, fname)
 	DB_ENV *dbenv;
@@ -40,6 +40,7 @@ static const char revid[] = "$Id: env_open.c,v 11.144 2003/09/13 18:39:34 bostic
 
 #include "logmsg.h"
 #include "locks_wrap.h"
+#include "comdb2_pthread_create.h"
 
 static int __db_tmp_open __P((DB_ENV *, u_int32_t, char *, DB_FH **));
 static int __dbenv_config __P((DB_ENV *, const char *, u_int32_t));
@@ -108,6 +109,7 @@ __dbenv_open(dbenv, db_home, flags, mode)
 	DB_MPOOL *dbmp;
 	u_int32_t init_flags, orig_flags;
 	int rep_check, ret;
+	char **dirp;
 
 	orig_flags = dbenv->flags;
 	rep_check = 0;
@@ -600,11 +602,15 @@ foundlsn:
 		thdpool_set_linger(dbenv->recovery_processors, 30);
 		thdpool_set_maxqueue(dbenv->recovery_processors, 0);
 		thdpool_set_wait(dbenv->recovery_processors, 1);
+		thdpool_set_affinity_class(dbenv->recovery_processors,
+		    COMDB2_THR_CLASS_REP);
 		dbenv->recovery_workers = thdpool_create("recovery_workers", 0);
 		thdpool_set_maxthds(dbenv->recovery_workers,
 		    dbenv->num_recovery_worker_threads);
 		thdpool_set_linger(dbenv->recovery_workers, 30);
 		thdpool_set_maxqueue(dbenv->recovery_workers, 8000);
+		thdpool_set_affinity_class(dbenv->recovery_workers,
+		    COMDB2_THR_CLASS_REP);
 		Pthread_mutex_init(&dbenv->recover_lk, NULL);
 		Pthread_cond_init(&dbenv->recover_cond, NULL);
 		Pthread_rwlock_init(&dbenv->ser_lk, NULL);
@@ -662,6 +668,15 @@ foundlsn:
 
 	dbenv->verbose |= DB_VERB_REPLICATION;
 
+	/* Finish freeing whatever a previous run left being reclaimed. */
+	if (dbenv->db_home != NULL)
+		__os_reclaim_scan(dbenv->db_home);
+	if (dbenv->db_log_dir != NULL)
+		__os_reclaim_scan(dbenv->db_log_dir);
+	if (dbenv->db_data_dir != NULL)
+		for (dirp = dbenv->db_data_dir; *dirp != NULL; ++dirp)
+			__os_reclaim_scan(*dirp);
+
 	return (0);
 
 err:				/* If we fail after creating the regions, remove them. */
@@ -42,6 +42,7 @@ static const char revid[] =
 #include "dbinc/txn.h"
 #include "dbinc/mp.h"
 #include "dbinc/db_am.h"
+#include "dbinc/hash.h"
 #include "dbinc/db_swap.h"
 #include "dbinc_auto/db_auto.h"
 #include <locks_wrap.h>
@@ -931,6 +932,264 @@ void log_recovery_progress(int stage, int progress)
 
 
 
+/*
+ * Parallel recovery.  With recovery_parallel_threads set, the backward and
+ * forward passes still read the log in one thread, but hand the page
+ * records they apply to worker threads, picked by the record's file id.
+ * All the records of a file go to the same worker in the order they were
+ * read, so every page sees its records in the same order as in a serial
+ * pass, and a file's handle is only used by one thread at a time.
+ *
+ * Whether a record is applied at all is still decided by the reading
+ * thread, in log order (__db_dispatch_prep): that is what looks at and
+ * updates the transaction list.  Records without a file id (transaction,
+ * dbreg, checkpoint and application records) and the allocation records,
+ * whose recovery functions add to the limbo list, are barriers: the reader
+ * waits for the workers to go idle and applies them itself.
+ */
+#define RECPAR_MAXQUEUE 1024
+
+struct __rec_par_rec {
+	DB_LSN lsn;
+	db_recops redo;
+	DBT dbt;
+	LINKC_T(struct __rec_par_rec) lnk;
+};
+
+struct __rec_par;
+
+struct __rec_par_worker {
+	struct __rec_par *par;
+	pthread_t tid;
+	pthread_cond_t cond;
+	LISTC_T(struct __rec_par_rec) q;
+};
+
+struct __rec_par {
+	DB_ENV *dbenv;
+	void *info;
+	pthread_mutex_t lk;
+	pthread_cond_t cond;	/* queue space, or a worker done */
+	int nworkers;
+	int pending;		/* queued or being applied */
+	int stop;
+	int ret;
+	DB_LSN errlsn;
+	u_int64_t nparallel;
+	u_int64_t nbarrier;
+	struct __rec_par_worker *workers;
+};
+
+static void *
+__rec_par_worker_thd(arg)
+	void *arg;
+{
+	struct __rec_par_worker *w = arg;
+	struct __rec_par *par = w->par;
+	DB_ENV *dbenv = par->dbenv;
+	struct __rec_par_rec *rr;
+	int ret;
+
+	Pthread_mutex_lock(&par->lk);
+	while (1) {
+		while ((rr = listc_rtl(&w->q)) == NULL && !par->stop)
+			Pthread_cond_wait(&w->cond, &par->lk);
+		if (rr == NULL)
+			break;
+		Pthread_mutex_unlock(&par->lk);
+
+		/* Nothing more is applied once a worker has failed. */
+		ret = par->ret ? 0 : __db_dispatch_call(dbenv,
+		    dbenv->recover_dtab, dbenv->recover_dtab_size,
+		    &rr->dbt, &rr->lsn, rr->redo, par->info);
+
+		Pthread_mutex_lock(&par->lk);
+		if (ret != 0 && ret != DB_TXN_CKP && par->ret == 0) {
+			par->ret = ret;
+			par->errlsn = rr->lsn;
+		}
+		par->pending--;
+		Pthread_cond_broadcast(&par->cond);
+		free(rr);
+	}
+	Pthread_mutex_unlock(&par->lk);
+	return (NULL);
+}
+
+static void __rec_par_destroy __P((struct __rec_par *));
+
+static struct __rec_par *
+__rec_par_create(dbenv, info, nworkers)
+	DB_ENV *dbenv;
+	void *info;
+	int nworkers;
+{
+	struct __rec_par *par;
+	int i;
+
+	if ((par = calloc(1, sizeof(*par))) == NULL ||
+	    (par->workers = calloc(nworkers, sizeof(*par->workers))) == NULL) {
+		free(par);
+		return (NULL);
+	}
+	par->dbenv = dbenv;
+	par->info = info;
+	Pthread_mutex_init(&par->lk, NULL);
+	Pthread_cond_init(&par->cond, NULL);
+	for (i = 0; i < nworkers; i++) {
+		struct __rec_par_worker *w = &par->workers[i];
+		w->par = par;
+		Pthread_cond_init(&w->cond, NULL);
+		listc_init(&w->q, offsetof(struct __rec_par_rec, lnk));
+		if (pthread_create(&w->tid, NULL, __rec_par_worker_thd, w)) {
+			Pthread_cond_destroy(&w->cond);
+			break;
+		}
+		par->nworkers++;
+	}
+	if (par->nworkers == 0) {
+		__rec_par_destroy(par);
+		return (NULL);
+	}
+	logmsg(LOGMSG_WARN, "recovery applying page records on %d threads\n",
+	    par->nworkers);
+	return (par);
+}
+
+/* Wait for everything queued to be applied. */
+static int
+__rec_par_drain(par, lsnp)
+	struct __rec_par *par;
+	DB_LSN *lsnp;
+{
+	int ret;
+
+	Pthread_mutex_lock(&par->lk);
+	while (par->pending > 0)
+		Pthread_cond_wait(&par->cond, &par->lk);
+	if ((ret = par->ret) != 0)
+		*lsnp = par->errlsn;
+	Pthread_mutex_unlock(&par->lk);
+	return (ret);
+}
+
+static void
+__rec_par_destroy(par)
+	struct __rec_par *par;
+{
+	DB_LSN lsn;
+	int i;
+
+	if (par == NULL)
+		return;
+	(void)__rec_par_drain(par, &lsn);
+	Pthread_mutex_lock(&par->lk);
+	par->stop = 1;
+	for (i = 0; i < par->nworkers; i++)
+		Pthread_cond_signal(&par->workers[i].cond);
+	Pthread_mutex_unlock(&par->lk);
+	for (i = 0; i < par->nworkers; i++) {
+		pthread_join(par->workers[i].tid, NULL);
+		Pthread_cond_destroy(&par->workers[i].cond);
+	}
+	Pthread_cond_destroy(&par->cond);
+	Pthread_mutex_destroy(&par->lk);
+	free(par->workers);
+	free(par);
+}
+
+static void
+__rec_par_report(par, pass)
+	struct __rec_par *par;
+	const char *pass;
+{
+	if (par == NULL)
+		return;
+	logmsg(LOGMSG_WARN, "%s pass applied %"PRIu64" records on %d threads, "
+	    "%"PRIu64" in the recovering thread\n", pass, par->nparallel,
+	    par->nworkers, par->nbarrier);
+	par->nparallel = par->nbarrier = 0;
+}
+
+/* Page records that only touch pages of their own file. */
+static int
+__rec_par_page_record(rectype)
+	u_int32_t rectype;
+{
+	switch (rectype) {
+	case DB___db_pg_alloc:
+	case DB___db_pg_new:
+	case DB___db_pg_prepare:
+	case DB___ham_metagroup:
+	case DB___ham_groupalloc:
+		/* these can add to the limbo list */
+		return (0);
+	default:
+		return (rectype < DB_user_BEGIN);
+	}
+}
+
+/*
+ * Undo or redo one record during the backward or forward pass.  If it
+ * returns an error, *lsnp is the record that failed.
+ */
+static int
+__rec_par_dispatch(par, dbt, lsnp, redo)
+	struct __rec_par *par;
+	DBT *dbt;
+	DB_LSN *lsnp;
+	db_recops redo;
+{
+	DB_ENV *dbenv = par->dbenv;
+	struct __rec_par_worker *w;
+	struct __rec_par_rec *rr;
+	u_int32_t rectype, fileid;
+	int make_call, ret;
+
+	LOGCOPY_32(&rectype, dbt->data);
+	fileid = UINT32_MAX;
+	if (__rec_par_page_record(rectype))
+		fileid = file_id_for_recovery_record(dbenv, NULL, rectype, dbt);
+
+	if (fileid == UINT32_MAX) {
+		par->nbarrier++;
+		if ((ret = __rec_par_drain(par, lsnp)) != 0)
+			return (ret);
+		return (__db_dispatch(dbenv, dbenv->recover_dtab,
+		    dbenv->recover_dtab_size, dbt, lsnp, redo, par->info));
+	}
+
+	if ((ret = __db_dispatch_prep(dbenv,
+	    dbt, lsnp, &redo, par->info, &make_call)) != 0 || !make_call)
+		return (ret);
+
+	if ((rr = malloc(sizeof(*rr) + dbt->size)) == NULL)
+		return (ENOMEM);
+	memset(&rr->dbt, 0, sizeof(rr->dbt));
+	rr->dbt.data = (u_int8_t *)(rr + 1);
+	rr->dbt.size = dbt->size;
+	memcpy(rr->dbt.data, dbt->data, dbt->size);
+	rr->lsn = *lsnp;
+	rr->redo = redo;
+
+	w = &par->workers[fileid % par->nworkers];
+	Pthread_mutex_lock(&par->lk);
+	while (listc_size(&w->q) >= RECPAR_MAXQUEUE && par->ret == 0)
+		Pthread_cond_wait(&par->cond, &par->lk);
+	if ((ret = par->ret) != 0) {
+		*lsnp = par->errlsn;
+		Pthread_mutex_unlock(&par->lk);
+		free(rr);
+		return (ret);
+	}
+	listc_abl(&w->q, rr);
+	par->pending++;
+	par->nparallel++;
+	Pthread_cond_signal(&w->cond);
+	Pthread_mutex_unlock(&par->lk);
+	return (0);
+}
+
 /*
  * __db_apprec --
  *	Perform recovery.  If max_lsn is non-NULL, then we are trying
@@ -964,6 +1223,7 @@ __db_apprec(dbenv, max_lsn, trunclsn, update, flags)
 	void *txninfo;
 	DB_LSN logged_checkpoint_lsn;
 	int start_recovery_at_dbregs;
+	struct __rec_par *par;
 
 	COMPQUIET(nfiles, (double)0);
 
@@ -973,6 +1233,7 @@ __db_apprec(dbenv, max_lsn, trunclsn, update, flags)
 
 	hi_txn = TXN_MAXIMUM;
 	txninfo = NULL;
+	par = NULL;
 
 	pass = "initial";
 
@@ -1366,6 +1627,9 @@ __db_apprec(dbenv, max_lsn, trunclsn, update, flags)
 			(u_long)first_lsn.file, (u_long)first_lsn.offset);
 
 	pass = "backward";
+	if (dbenv->attr.recovery_parallel_threads > 0)
+		par = __rec_par_create(dbenv, txninfo,
+		    dbenv->attr.recovery_parallel_threads);
 	ret = __log_c_get(logc, &lsn, &data, DB_LAST);
 	if (ret)
 		goto err;
@@ -1385,9 +1649,13 @@ __db_apprec(dbenv, max_lsn, trunclsn, update, flags)
 			dbenv->db_feedback(dbenv, DB_RECOVER, progress);
 		}
 
-		ret = __db_dispatch(dbenv, dbenv->recover_dtab,
-			dbenv->recover_dtab_size, &data, &lsn,
-			DB_TXN_BACKWARD_ROLL, txninfo);
+		if (par != NULL)
+			ret = __rec_par_dispatch(par, &data, &lsn,
+				DB_TXN_BACKWARD_ROLL);
+		else
+			ret = __db_dispatch(dbenv, dbenv->recover_dtab,
+				dbenv->recover_dtab_size, &data, &lsn,
+				DB_TXN_BACKWARD_ROLL, txninfo);
 		if (ret != 0) {
 			if (ret != DB_TXN_CKP)
 				goto msgerr;
@@ -1400,6 +1668,9 @@ __db_apprec(dbenv, max_lsn, trunclsn, update, flags)
 
 	if (ret != 0 && ret != DB_NOTFOUND)
 		goto err;
+	if (par != NULL && (ret = __rec_par_drain(par, &lsn)) != 0)
+		goto msgerr;
+	__rec_par_report(par, pass);
 
 	log_recovery_progress(2, -1);
 
@@ -1444,9 +1715,13 @@ __db_apprec(dbenv, max_lsn, trunclsn, update, flags)
 			dbenv->db_feedback(dbenv, DB_RECOVER, progress);
 		}
 
-		ret = __db_dispatch(dbenv, dbenv->recover_dtab,
-			dbenv->recover_dtab_size, &data, &lsn,
-			DB_TXN_FORWARD_ROLL, txninfo);
+		if (par != NULL)
+			ret = __rec_par_dispatch(par, &data, &lsn,
+				DB_TXN_FORWARD_ROLL);
+		else
+			ret = __db_dispatch(dbenv, dbenv->recover_dtab,
+				dbenv->recover_dtab_size, &data, &lsn,
+				DB_TXN_FORWARD_ROLL, txninfo);
 		if (ret != 0) {
 			if (ret != DB_TXN_CKP)
 				goto msgerr;
@@ -1458,6 +1733,11 @@ __db_apprec(dbenv, max_lsn, trunclsn, update, flags)
 
 	if (ret != 0 && ret != DB_NOTFOUND)
 		goto err;
+	if (par != NULL && (ret = __rec_par_drain(par, &lsn)) != 0)
+		goto msgerr;
+	__rec_par_report(par, pass);
+	__rec_par_destroy(par);
+	par = NULL;
 	dbenv->recovery_pass = DB_TXN_NOT_IN_RECOVERY;
 
 	/*
@@ -1657,7 +1937,9 @@ msgerr:	__db_err(dbenv,
 			(u_long) lsn.file, (u_long) lsn.offset, pass);
 	}
 
-err:	if (logc != NULL && (t_ret = __log_c_close(logc)) != 0 && ret == 0)
+err:	__rec_par_destroy(par);
+
+	if (logc != NULL && (t_ret = __log_c_close(logc)) != 0 && ret == 0)
 		ret = t_ret;
 
 	if (txninfo != NULL)
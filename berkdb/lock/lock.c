@@ -44,6 +44,7 @@ static const char revid[] = "$Id: lock.c,v 11.134 2003/11/18 21:30:38 ubell Exp
 #include "util.h"
 #include "locks_wrap.h"
 #include "thread_stats.h"
+#include "wait_event.h"
 #include "tohex.h"
 
 
@@ -75,6 +76,14 @@ int gbl_lock_conflict_trace;
 unsigned gbl_ddlk = 0;
 
 void (*gbl_bb_log_lock_waits_fn) (const void *, size_t sz, int waitms) = NULL;
+extern int gbl_lock_heat_objects;
+
+/* Table read locks the comdb2 layer holds without a lock object of ours */
+extern int bdb_tablelock_fast_held(u_int32_t);
+extern void bdb_tablelock_fast_release(u_int32_t, int);
+extern void bdb_tablelock_fast_inherit(u_int32_t, u_int32_t);
+extern int bdb_tablelock_fast_exclusive(DB_ENV *, u_int32_t, const void *);
+#define TABLELOCK_OBJ_SIZE 32
 
 static int __lock_freelock __P((DB_LOCKTAB *,
 	struct __db_lock *, DB_LOCKER *, u_int32_t));
@@ -121,6 +130,99 @@ static pthread_mutex_t lblk = PTHREAD_MUTEX_INITIALIZER;
 
 pthread_key_t lockmgr_key;
 
+/*
+ * Per-thread caches of free lock and locker structures.  A thread that
+ * frees a lock is usually about to allocate another, so recycling it
+ * locally keeps the structure warm in this core's cache and keeps the
+ * shared partition free-list heads from bouncing between cores.  Cached
+ * structures are on no free list; they go back to the partition lists
+ * when the cache is full or the thread exits.  gbl_lk_tcache_gen is bumped
+ * whenever the lock region is opened or closed so that a cache left over
+ * from an earlier region is dropped instead of reused.
+ */
+#define	LK_TCACHE_MAX	64
+int gbl_lk_thread_cache = 0;
+u_int32_t gbl_lk_tcache_gen = 0;
+
+struct lk_tcache {
+	DB_ENV *dbenv;
+	u_int32_t gen;
+	int nlocks;
+	int nlockers;
+	struct __db_lock *locks[LK_TCACHE_MAX];
+	DB_LOCKER *lockers[LK_TCACHE_MAX];
+};
+
+static pthread_key_t lk_tcache_key;
+static pthread_once_t lk_tcache_once = PTHREAD_ONCE_INIT;
+
+static void
+lk_tcache_free(void *arg)
+{
+	struct lk_tcache *tc = arg;
+	DB_LOCKREGION *region;
+	DB_LOCKTAB *lt;
+	struct __db_lock *lp;
+	DB_LOCKER *lkr;
+	int i;
+
+	if (tc->gen == gbl_lk_tcache_gen &&
+	    (lt = tc->dbenv->lk_handle) != NULL) {
+		region = lt->reginfo.primary;
+		for (i = 0; i < tc->nlocks; ++i) {
+			lp = tc->locks[i];
+			lock_obj_partition(region, lp->lpartition);
+			SH_TAILQ_INSERT_HEAD(&region->free_locks[lp->lpartition],
+			    lp, links, __db_lock);
+			unlock_obj_partition(region, lp->lpartition);
+		}
+		for (i = 0; i < tc->nlockers; ++i) {
+			lkr = tc->lockers[i];
+			lock_locker_partition(region, lkr->partition);
+			SH_TAILQ_INSERT_HEAD(&region->free_lockers[lkr->partition],
+			    lkr, links, __db_locker);
+			unlock_locker_partition(region, lkr->partition);
+		}
+	}
+	free(tc);
+}
+
+static void
+lk_tcache_key_init(void)
+{
+	Pthread_key_create(&lk_tcache_key, lk_tcache_free);
+}
+
+static inline int
+lk_tcache_size(void)
+{
+	return (gbl_lk_thread_cache < LK_TCACHE_MAX ?
+	    gbl_lk_thread_cache : LK_TCACHE_MAX);
+}
+
+static struct lk_tcache *
+lk_tcache_get(DB_ENV *dbenv)
+{
+	struct lk_tcache *tc;
+
+	if (gbl_lk_thread_cache <= 0)
+		return (NULL);
+	pthread_once(&lk_tcache_once, lk_tcache_key_init);
+	if ((tc = pthread_getspecific(lk_tcache_key)) == NULL) {
+		if ((tc = calloc(1, sizeof(*tc))) == NULL)
+			return (NULL);
+		Pthread_setspecific(lk_tcache_key, tc);
+		tc->gen = gbl_lk_tcache_gen - 1;
+	}
+	if (tc->gen != gbl_lk_tcache_gen) {
+		/* The region these came from is gone. */
+		tc->nlocks = tc->nlockers = 0;
+		tc->dbenv = dbenv;
+		tc->gen = gbl_lk_tcache_gen;
+	}
+	return (tc->dbenv == dbenv ? tc : NULL);
+}
+
 static int __lock_getlocker_int(DB_LOCKTAB *, u_int32_t locker, u_int32_t indx,
     u_int32_t partition, int create, u_int32_t retries, DB_LOCKER **retp,
     int *created, int is_logical);
@@ -679,6 +781,7 @@ __lock_id_free(dbenv, id)
 	region = lt->reginfo.primary;
 
 	__free_latch_lockerid(dbenv, id);
+	bdb_tablelock_fast_release(id, 0);
 
 	LOCKREGION(dbenv, lt);
 	lock_lockers(region);
@@ -1322,6 +1425,34 @@ opstring(int op)
 	}
 }
 
+/*
+ * Give the table read locks a child holds outside of the lock table to its
+ * parent, as __lock_inherit_locks does with the ones in it.
+ */
+static void
+__lock_inherit_fast_tablelocks(lt, locker)
+	DB_LOCKTAB *lt;
+	u_int32_t locker;
+{
+	DB_LOCKER *sh_locker, *sh_parent;
+	DB_LOCKREGION *region;
+	u_int32_t ndx, parent = 0;
+
+	region = lt->reginfo.primary;
+	LOCKER_INDX(lt, region, locker, ndx);
+	if (__lock_getlocker(lt, locker, ndx, 0, GETLOCKER_KEEP_PART,
+		&sh_locker) != 0 || sh_locker == NULL)
+		return;
+	if (sh_locker->parent_locker != INVALID_ROFF) {
+		sh_parent = (DB_LOCKER *)R_ADDR(&lt->reginfo,
+		    sh_locker->parent_locker);
+		parent = sh_parent->id;
+	}
+	unlock_locker_partition(region, sh_locker->partition);
+	if (parent)
+		bdb_tablelock_fast_inherit(locker, parent);
+}
+
 int
 __lock_vec(dbenv, locker, flags, list, nlist, elistp)
 	DB_ENV *dbenv;
@@ -1364,6 +1495,8 @@ __lock_vec(dbenv, locker, flags, list, nlist, elistp)
 			    list[i].mode, list[i].timeout, &list[i].lock);
 			break;
 		case DB_LOCK_INHERIT:
+			if (bdb_tablelock_fast_held(locker))
+				__lock_inherit_fast_tablelocks(lt, locker);
 			ret = __lock_inherit_locks(lt, locker, flags);
 			break;
 		case DB_LOCK_PUT:
@@ -1373,6 +1506,9 @@ __lock_vec(dbenv, locker, flags, list, nlist, elistp)
 		case DB_LOCK_PUT_ALL:
 		case DB_LOCK_PUT_READ:
 		case DB_LOCK_UPGRADE_WRITE:
+			if (list[i].op != DB_LOCK_UPGRADE_WRITE)
+				bdb_tablelock_fast_release(locker,
+				    list[i].op == DB_LOCK_PUT_READ);
 #ifdef VERBOSE_LATCH
 			printf("Calling %s for lockerid %u line %d\n",
 			    opstring(list[i].op), locker, __LINE__);
@@ -2000,6 +2136,22 @@ rep_return_deadlock(DB_ENV *dbenv, u_int32_t sz)
 	}
 }
 
+/* Is this locker, or the transaction it belongs to, a preferred victim? */
+static inline int
+__lock_locker_is_lowpri(lt, locker)
+	DB_LOCKTAB *lt;
+	DB_LOCKER *locker;
+{
+	DB_LOCKER *master;
+
+	if (F_ISSET(locker, DB_LOCKER_KILLME))
+		return (1);
+	if (locker->master_locker == INVALID_ROFF)
+		return (0);
+	master = (DB_LOCKER *)R_ADDR(&lt->reginfo, locker->master_locker);
+	return (F_ISSET(master, DB_LOCKER_KILLME) != 0);
+}
+
 #define ADD_TO_HOLDARR(x)                                                      \
 	do {                                                                   \
 		if (holdix + 1 >= holdsz) {                                    \
@@ -2038,6 +2190,7 @@ __lock_get_internal_int(lt, locker, in_locker, flags, obj, lock_mode, timeout,
 	u_int32_t partition = gbl_lk_parts, lpartition = gbl_lkr_parts;
 	uint64_t x1 = 0, x2;
 	struct __db_lock *newl, *lp, *firstlp, *wwrite;
+	struct lk_tcache *tc;
 	DB_ENV *dbenv;
 	DB_LOCKER *sh_locker;
 	DB_LOCKOBJ *sh_obj;
@@ -2045,7 +2198,7 @@ __lock_get_internal_int(lt, locker, in_locker, flags, obj, lock_mode, timeout,
 	u_int32_t holder, obj_ndx, ihold, *holdarr, holdix, holdsz;
 	extern int gbl_lock_get_verbose_waiter;
 	int verbose_waiter = gbl_lock_get_verbose_waiter;;
-	int grant_dirty, no_dd, ret, t_ret;
+	int grant_dirty, no_dd, holders_wait, ret, t_ret;
 	extern int gbl_locks_check_waiters;
 
 	/*
@@ -2442,39 +2595,44 @@ __lock_get_internal_int(lt, locker, in_locker, flags, obj, lock_mode, timeout,
 		if (++region->stat.st_nlocks > region->stat.st_maxnlocks)
 			region->stat.st_maxnlocks = region->stat.st_nlocks;
 
-		if ((newl =
-			SH_TAILQ_FIRST(&region->free_locks[partition],
-			    __db_lock)) == NULL) {
-			unsigned num;
-			++region->nwlk_scale[partition];
-			num = region->object_p_size
-			    * region->nwlk_scale[partition];
-			PRINTF(nwlk_scale, "add  lk:%d part:%d sc:%d\n",
-			    num, partition, region->nwlk_scale[partition]);
-			ret = __os_malloc(dbenv,
-			    sizeof(struct __db_lock) * num, &newl);
-			if (ret != 0) {
-				__db_err(dbenv, __db_lock_err, "locks");
-				unlock_obj_partition(region, partition);
-				unlock_locker_partition(region, lpartition);
-				if (holdarr)
-					__os_free(dbenv, holdarr);
-				return (ENOMEM);
-			}
-			ret =
-			    add_to_lock_partition(dbenv, lt, partition, num,
-			    newl);
-			if (ret != 0) {
-				if (holdarr)
-					__os_free(dbenv, holdarr);
-				return ret;
+		if ((tc = lk_tcache_get(dbenv)) != NULL && tc->nlocks > 0) {
+			newl = tc->locks[--tc->nlocks];
+			newl->lpartition = partition;
+		} else {
+			if ((newl =
+				SH_TAILQ_FIRST(&region->free_locks[partition],
+				    __db_lock)) == NULL) {
+				unsigned num;
+				++region->nwlk_scale[partition];
+				num = region->object_p_size
+				    * region->nwlk_scale[partition];
+				PRINTF(nwlk_scale, "add  lk:%d part:%d sc:%d\n",
+				    num, partition, region->nwlk_scale[partition]);
+				ret = __os_malloc(dbenv,
+				    sizeof(struct __db_lock) * num, &newl);
+				if (ret != 0) {
+					__db_err(dbenv, __db_lock_err, "locks");
+					unlock_obj_partition(region, partition);
+					unlock_locker_partition(region, lpartition);
+					if (holdarr)
+						__os_free(dbenv, holdarr);
+					return (ENOMEM);
+				}
+				ret =
+				    add_to_lock_partition(dbenv, lt, partition, num,
+				    newl);
+				if (ret != 0) {
+					if (holdarr)
+						__os_free(dbenv, holdarr);
+					return ret;
+				}
+				newl =
+				    SH_TAILQ_FIRST(&region->free_locks[partition],
+				    __db_lock);
 			}
-			newl =
-			    SH_TAILQ_FIRST(&region->free_locks[partition],
-			    __db_lock);
+			SH_TAILQ_REMOVE(&region->free_locks[partition], newl,
+			    links, __db_lock);
 		}
-		SH_TAILQ_REMOVE(&region->free_locks[partition], newl,
-		    links, __db_lock);
 		newl->holderp = sh_locker;
 		newl->refcount = 1;
 		newl->mode = lock_mode;
@@ -2584,6 +2742,23 @@ upgrade:
 			    __db_lock);
 			break;
 		case TAIL:
+			/*
+			 * Low priority lockers (schema change, analyze) wait
+			 * behind everyone else that comes along.
+			 */
+			if (dbenv->attr.lock_lowpri_wait_last &&
+			    !__lock_locker_is_lowpri(lt, sh_locker)) {
+				for (lp = SH_TAILQ_FIRST(&sh_obj->waiters,
+					__db_lock); lp != NULL &&
+				    !__lock_locker_is_lowpri(lt, lp->holderp);
+				    lp = SH_TAILQ_NEXT(lp, links, __db_lock))
+					;
+				if (lp != NULL) {
+					SH_TAILQ_INSERT_BEFORE(&sh_obj->waiters,
+					    lp, newl, links, __db_lock);
+					break;
+				}
+			}
 			SH_TAILQ_INSERT_TAIL(&sh_obj->waiters, newl, links);
 			break;
 		default:
@@ -2687,11 +2862,16 @@ upgrade:
 			goto err;
 		}
 
-		/* Light a flag in the holder's locker */
+		/*
+		 * Light a flag in the holder's locker.  A deadlock through
+		 * this wait needs one of those we wait for to be waiting too,
+		 * so note whether any of them is.
+		 */
+		holders_wait = 0;
 		if (holdarr) {
 			u_int32_t locker_ndx;
 			u_int32_t ii;
-			DB_LOCKER *holder_locker;
+			DB_LOCKER *holder_locker, *holder_master;
 			for (ii = 0; ii < holdix; ii++) {
 				LOCKER_INDX(lt, region, holdarr[ii],
 				    locker_ndx);
@@ -2705,9 +2885,17 @@ upgrade:
                                "Set waitflag for lockid %u\n",
 						    holdarr[ii]);
 					holder_locker->has_waiters = 1;
+					holder_master =
+					    holder_locker->master_locker ==
+					    INVALID_ROFF ? holder_locker :
+					    (DB_LOCKER *)R_ADDR(&lt->reginfo,
+						holder_locker->master_locker);
+					if (holder_master->wstatus)
+						holders_wait = 1;
 					unlock_locker_partition(region,
 					    holder_locker->partition);
-				}
+				} else
+					holders_wait = 1;
 			}
 			__os_free(dbenv, holdarr);
 			holdarr = NULL;
@@ -2717,13 +2905,31 @@ upgrade:
 		 * We are about to wait; before waiting, see if the deadlock
 		 * detector should be run.
 		 */
-		if (region->detect != DB_LOCK_NORUN && !no_dd)
+		/*
+		 * Unless nothing we wait for is waiting: then there's no
+		 * cycle yet, and if one of them goes on to wait it runs the
+		 * detector itself.  Nothing else catches a cycle we miss, as
+		 * the periodic detector only runs without autodeadlockdetect.
+		 * It can't be missed: our wstatus was set under our locker
+		 * partition before we looked at theirs under each of theirs,
+		 * so of two waits that close a cycle the later one sees the
+		 * other waiting.  We only know who we wait for when every
+		 * conflicting holder and waiter went into holdarr.
+		 */
+		if (region->detect != DB_LOCK_NORUN && !no_dd &&
+		    (holders_wait || holdix == 0 ||
+			!dbenv->attr.lock_detect_skip_unblocked ||
+			!gbl_locks_check_waiters ||
+			lock_mode == DB_LOCK_DIRTY || action == SECOND ||
+			LF_ISSET(DB_LOCK_LOGICAL)))
 			__lock_detect(dbenv, region->detect, NULL);
 
 		if (gbl_bb_berkdb_enable_lock_timing) {
 			x1 = bb_berkdb_fasttime();
 		}
+		uint64_t wait = wait_event_begin(WAIT_EVENT_LOCK);
 		MUTEX_LOCK(dbenv, &newl->mutex);
+		wait_event_end(wait);
 
 		if (gbl_bb_berkdb_enable_thread_stats) {
 			struct berkdb_thread_stats *t;
@@ -2752,6 +2958,9 @@ upgrade:
 				gbl_bb_log_lock_waits_fn(sh_obj->lockobj.data,
 				    sh_obj->lockobj.size, U2M(x2 - x1));
 			}
+			if (gbl_lock_heat_objects > 0)
+				__lock_heat_record(sh_obj->lockobj.data,
+				    sh_obj->lockobj.size, d);
 		}
 
 		LOCKREGION(dbenv, (DB_LOCKTAB *)dbenv->lk_handle);
@@ -3282,6 +3491,7 @@ __lock_freelock(lt, lockp, sh_locker, flags)
 {
 	DB_ENV *dbenv;
 	DB_LOCKREGION *region;
+	struct lk_tcache *tc;
 	int ret;
 	struct __db_lock_lsn *lp_lsn, *next_lsn;
 	lp_lsn = next_lsn = NULL;
@@ -3332,8 +3542,13 @@ __lock_freelock(lt, lockp, sh_locker, flags)
 		lockp->nlsns = 0;
 		SH_LIST_INIT(&lockp->lsns);
 		Pthread_mutex_unlock(&lockp->lsns_mtx);
-		SH_TAILQ_INSERT_HEAD(&region->free_locks[lockp->lpartition],
-		    lockp, links, __db_lock);
+		if ((tc = lk_tcache_get(dbenv)) != NULL &&
+		    tc->nlocks < lk_tcache_size())
+			tc->locks[tc->nlocks++] = lockp;
+		else
+			SH_TAILQ_INSERT_HEAD(
+			    &region->free_locks[lockp->lpartition],
+			    lockp, links, __db_lock);
 		region->stat.st_nlocks--;
 #ifndef TESTSUITE
 		if (gbl_berkdb_track_locks)
@@ -3572,6 +3787,7 @@ __lock_freefamilylocker(lt, locker)
 	region = lt->reginfo.primary;
 
 	__free_latch_lockerid(lt->dbenv, locker);
+	bdb_tablelock_fast_release(locker, 0);
 
 	lock_lockers(region);
 	LOCKREGION(dbenv, lt);
@@ -3622,6 +3838,7 @@ __lock_freelocker(lt, region, sh_locker, indx)
 	DB_LOCKER *sh_locker;
 	u_int32_t indx;
 {
+	struct lk_tcache *tc;
 	u_int32_t partition = sh_locker->partition;
 	if (F_ISSET(sh_locker, DB_LOCKER_TRACK))
 		logmsg(LOGMSG_USER, "LOCKID %u FREED\n", sh_locker->id);
@@ -3635,8 +3852,12 @@ __lock_freelocker(lt, region, sh_locker, indx)
 
 	HASHREMOVE_EL(region->locker_tab[partition], indx, __db_locker, links,
 	    sh_locker);
-	SH_TAILQ_INSERT_HEAD(&region->free_lockers[partition], sh_locker, links,
-	    __db_locker);
+	if ((tc = lk_tcache_get(lt->dbenv)) != NULL &&
+	    tc->nlockers < lk_tcache_size())
+		tc->lockers[tc->nlockers++] = sh_locker;
+	else
+		SH_TAILQ_INSERT_HEAD(&region->free_lockers[partition],
+		    sh_locker, links, __db_locker);
 	SH_TAILQ_REMOVE(&region->lockers, sh_locker, ulinks, __db_locker);
 	region->stat.st_nlockers--;
 }
@@ -3809,6 +4030,7 @@ __lock_getlocker_int(lt, locker, indx, partition, create, retries, retp,
 	DB_ENV *dbenv;
 	DB_LOCKER *sh_locker;
 	DB_LOCKREGION *region;
+	struct lk_tcache *tc;
 
 	dbenv = lt->dbenv;
 	region = lt->reginfo.primary;
@@ -3823,33 +4045,37 @@ __lock_getlocker_int(lt, locker, indx, partition, create, retries, retp,
 	 */
 	if (sh_locker == NULL && create) {
 		/* Create new locker and then insert it into hash table. */
-		if ((sh_locker = SH_TAILQ_FIRST(&region->free_lockers[partition],
-			    __db_locker)) == NULL) {
-			unsigned i, num;
-			++region->nwlkr_scale[partition];
-			num = region->locker_p_size * region->nwlkr_scale[partition];
-			PRINTF(nwlkr_scale, "add lkr:%d part:%d sc:%d\n",
-			    num, partition, region->nwlkr_scale[partition]);
-			int ret = __os_malloc(dbenv, sizeof(DB_LOCKER) * num, &sh_locker);
-			if (ret != 0) {
-				__db_err(dbenv, __db_lock_err,
-				    "locker entries");
-				return (ENOMEM);
-			}
-			sh_locker->has_pglk_lsn = 0;
-			sh_locker->ntrackedlocks = 0;
-			sh_locker->maxtrackedlocks = 0;
-			sh_locker->tracked_locklist = NULL;
-			for (i = 0; i < num; ++i, ++sh_locker)
-				SH_TAILQ_INSERT_HEAD(&region->
-				    free_lockers[partition], sh_locker, links,
+		if ((tc = lk_tcache_get(dbenv)) != NULL && tc->nlockers > 0)
+			sh_locker = tc->lockers[--tc->nlockers];
+		else {
+			if ((sh_locker = SH_TAILQ_FIRST(&region->free_lockers[partition],
+				    __db_locker)) == NULL) {
+				unsigned i, num;
+				++region->nwlkr_scale[partition];
+				num = region->locker_p_size * region->nwlkr_scale[partition];
+				PRINTF(nwlkr_scale, "add lkr:%d part:%d sc:%d\n",
+				    num, partition, region->nwlkr_scale[partition]);
+				int ret = __os_malloc(dbenv, sizeof(DB_LOCKER) * num, &sh_locker);
+				if (ret != 0) {
+					__db_err(dbenv, __db_lock_err,
+					    "locker entries");
+					return (ENOMEM);
+				}
+				sh_locker->has_pglk_lsn = 0;
+				sh_locker->ntrackedlocks = 0;
+				sh_locker->maxtrackedlocks = 0;
+				sh_locker->tracked_locklist = NULL;
+				for (i = 0; i < num; ++i, ++sh_locker)
+					SH_TAILQ_INSERT_HEAD(&region->
+					    free_lockers[partition], sh_locker, links,
+					    __db_locker);
+				sh_locker =
+				    SH_TAILQ_FIRST(&region->free_lockers[partition],
 				    __db_locker);
-			sh_locker =
-			    SH_TAILQ_FIRST(&region->free_lockers[partition],
-			    __db_locker);
+			}
+			SH_TAILQ_REMOVE(&region->free_lockers[partition],
+			    sh_locker, links, __db_locker);
 		}
-		SH_TAILQ_REMOVE(&region->free_lockers[partition],
-		    sh_locker, links, __db_locker);
 		sh_locker->id = locker;
 		sh_locker->dd_id = 0;
 		sh_locker->master_locker = INVALID_ROFF;
@@ -5539,6 +5765,15 @@ __lock_list_parse_pglogs_int(dbenv, locker, flags, lock_mode, list, maxlsn,
 				uint32_t lflags =
 				    (flags & (~(LOCK_GET_LIST_GETLOCK |
 					    LOCK_GET_LIST_PRINTLOCK)));
+				/* readers holding the table outside of the
+				 * lock table are made to show up in it */
+				if (get_lock && size == TABLELOCK_OBJ_SIZE &&
+				    IS_WRITELOCK(lock_mode) &&
+				    (ret = bdb_tablelock_fast_exclusive(dbenv,
+					locker, obj_dbt.data)) != 0) {
+					lock->pgno = save_pgno;
+					goto err;
+				}
 				if (get_lock &&
 				    (ret =
 					__lock_get_internal(lt, locker,
@@ -5706,6 +5941,14 @@ __lock_get_list_int_int(dbenv, locker, flags, lock_mode, list, pcontext, maxlsn,
 					uint32_t lflags =
 					    (flags & (~(LOCK_GET_LIST_GETLOCK |
 						    LOCK_GET_LIST_PRINTLOCK)));
+					if (size == TABLELOCK_OBJ_SIZE &&
+					    IS_WRITELOCK(lock_mode) &&
+					    (ret = bdb_tablelock_fast_exclusive(
+						dbenv, locker,
+						obj_dbt.data)) != 0) {
+						lock->pgno = save_pgno;
+						goto err;
+					}
 					if ((ret =
 						__lock_get_internal(lt, locker,
 						    sh_locker, lflags, &obj_dbt,
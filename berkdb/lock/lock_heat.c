@@ -0,0 +1,291 @@
+/*-
+ * See the file LICENSE for redistribution information.
+ *
+ * Copyright (c) 1996-2003
+ *	Sleepycat Software.  All rights reserved.
+ */
+
+#include "db_config.h"
+
+#ifndef NO_SYSTEM_INCLUDES
+#include <sys/types.h>
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+#include "db_int.h"
+#include "dbinc/lock.h"
+#include "logmsg.h"
+#include "locks_wrap.h"
+#include "list.h"
+#include "plhash.h"
+#include "walkback.h"
+
+/*
+ * Lock heat: for the lock objects that are waited on, how many waits, how
+ * long in all and at worst, and the stacks that waited most.  Only a wait
+ * comes here, and a wait has already slept, so the cost falls on a thread
+ * that was not running anyway.  While lock_heat_objects is set, that many
+ * objects are kept, the one waited on least recently making room for a new
+ * one, and one in lock_heat_sample waits is counted.  A stack is taken for
+ * one in LOCK_HEAT_STACK_EVERY of an object's waits; each object keeps its
+ * LOCK_HEAT_STACKS most common.  The bdb lock and schema lock, which are
+ * not region locks, come in by name.
+ */
+int gbl_lock_heat_objects = 0;
+int gbl_lock_heat_sample = 1;
+
+#define	LOCK_HEAT_OBJ_MAX	64
+#define	LOCK_HEAT_FRAMES	16
+#define	LOCK_HEAT_STACKS	4
+#define	LOCK_HEAT_STACK_EVERY	8
+
+struct lock_heat_key {
+	u_int8_t named;
+	u_int8_t size;
+	u_int8_t pad[2];
+	u_int8_t data[LOCK_HEAT_OBJ_MAX];
+};
+
+struct lock_heat_stack {
+	u_int64_t nwaits;
+	unsigned nframes;
+	void *pcs[LOCK_HEAT_FRAMES];
+};
+
+struct lock_heat_ent {
+	struct lock_heat_key key;
+	u_int64_t nwaits;
+	u_int64_t total_us;
+	u_int64_t max_us;
+	struct lock_heat_stack stacks[LOCK_HEAT_STACKS];
+	LINKC_T(struct lock_heat_ent) lnk;
+};
+
+static pthread_mutex_t heat_lk = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t heat_once = PTHREAD_ONCE_INIT;
+static hash_t *heat_h;
+static LISTC_T(struct lock_heat_ent) heat_lru;	/* least recent first */
+static __thread unsigned heat_tick;
+
+static void
+lock_heat_init()
+{
+	heat_h = hash_init_o(offsetof(struct lock_heat_ent, key),
+	    sizeof(struct lock_heat_key));
+	listc_init(&heat_lru, offsetof(struct lock_heat_ent, lnk));
+}
+
+static void
+lock_heat_add_stack(e, pcs, nframes)
+	struct lock_heat_ent *e;
+	void **pcs;
+	unsigned nframes;
+{
+	struct lock_heat_stack *s, *min;
+	int i;
+
+	min = &e->stacks[0];
+	for (i = 0; i < LOCK_HEAT_STACKS; i++) {
+		s = &e->stacks[i];
+		if (s->nframes == nframes &&
+		    memcmp(s->pcs, pcs, nframes * sizeof(void *)) == 0) {
+			s->nwaits++;
+			return;
+		}
+		if (s->nwaits < min->nwaits)
+			min = s;
+	}
+	/* take over the least common, keeping its count as the floor */
+	min->nwaits++;
+	min->nframes = nframes;
+	memcpy(min->pcs, pcs, nframes * sizeof(void *));
+}
+
+static void
+lock_heat_add(k, wait_us)
+	struct lock_heat_key *k;
+	u_int64_t wait_us;
+{
+	struct lock_heat_ent *e;
+	void *pcs[LOCK_HEAT_FRAMES];
+	unsigned nframes;
+	int want_stack;
+
+	pthread_once(&heat_once, lock_heat_init);
+
+	Pthread_mutex_lock(&heat_lk);
+	if ((e = hash_find(heat_h, k)) == NULL) {
+		if (heat_lru.count >= gbl_lock_heat_objects &&
+		    (e = heat_lru.top) != NULL) {
+			hash_del(heat_h, e);
+			listc_rfl(&heat_lru, e);
+			memset(e, 0, sizeof(*e));
+		} else if ((e = calloc(1, sizeof(*e))) == NULL) {
+			Pthread_mutex_unlock(&heat_lk);
+			return;
+		}
+		e->key = *k;
+		hash_add(heat_h, e);
+	} else
+		listc_rfl(&heat_lru, e);
+	listc_abl(&heat_lru, e);
+	want_stack = e->nwaits % LOCK_HEAT_STACK_EVERY == 0;
+	e->nwaits++;
+	e->total_us += wait_us;
+	if (e->max_us < wait_us)
+		e->max_us = wait_us;
+	Pthread_mutex_unlock(&heat_lk);
+
+	if (!want_stack ||
+	    stack_pc_getlist(NULL, pcs, LOCK_HEAT_FRAMES, &nframes) != 0)
+		return;
+	if (nframes > LOCK_HEAT_FRAMES)
+		nframes = LOCK_HEAT_FRAMES;
+
+	Pthread_mutex_lock(&heat_lk);
+	if ((e = hash_find(heat_h, k)) != NULL)
+		lock_heat_add_stack(e, pcs, nframes);
+	Pthread_mutex_unlock(&heat_lk);
+}
+
+static int
+lock_heat_stack_cmp(a, b)
+	const void *a;
+	const void *b;
+{
+	const struct lock_heat_stack *x = a, *y = b;
+
+	return (x->nwaits < y->nwaits ? 1 : x->nwaits > y->nwaits ? -1 : 0);
+}
+
+static int
+lock_heat_sampled()
+{
+	if (gbl_lock_heat_objects <= 0)
+		return (0);
+	return (gbl_lock_heat_sample <= 1 ||
+	    ++heat_tick % (unsigned)gbl_lock_heat_sample == 0);
+}
+
+/*
+ * __lock_heat_record --
+ *	Count a wait of wait_us on a region lock object.
+ *
+ * PUBLIC: void __lock_heat_record __P((const void *, u_int32_t, u_int64_t));
+ */
+void
+__lock_heat_record(obj, size, wait_us)
+	const void *obj;
+	u_int32_t size;
+	u_int64_t wait_us;
+{
+	struct lock_heat_key k;
+
+	/* comdb2's lock objects are all smaller */
+	if (size > LOCK_HEAT_OBJ_MAX || !lock_heat_sampled())
+		return;
+	memset(&k, 0, sizeof(k));
+	k.size = size;
+	memcpy(k.data, obj, size);
+	lock_heat_add(&k, wait_us);
+}
+
+/*
+ * __berkdb_lock_heat_named --
+ *	Count a wait of wait_us on a lock outside the lock region.
+ *
+ * PUBLIC: void __berkdb_lock_heat_named __P((const char *, u_int64_t));
+ */
+void
+__berkdb_lock_heat_named(name, wait_us)
+	const char *name;
+	u_int64_t wait_us;
+{
+	struct lock_heat_key k;
+
+	if (!lock_heat_sampled())
+		return;
+	memset(&k, 0, sizeof(k));
+	k.named = 1;
+	strncpy((char *)k.data, name, LOCK_HEAT_OBJ_MAX - 1);
+	k.size = strlen((char *)k.data);
+	lock_heat_add(&k, wait_us);
+}
+
+/*
+ * __lock_heat_collect --
+ *	DB_ENV->collect_lock_heat.
+ *
+ * PUBLIC: int __lock_heat_collect __P((DB_ENV *, collect_lock_heat_f, void *));
+ */
+int
+__lock_heat_collect(dbenv, func, arg)
+	DB_ENV *dbenv;
+	collect_lock_heat_f func;
+	void *arg;
+{
+	struct lock_heat_ent *ents, *e;
+	struct lock_heat_stack *s;
+	char name[256], rectype[80];
+	char stacks[LOCK_HEAT_STACKS * (LOCK_HEAT_FRAMES * 19 + 24)];
+	size_t off;
+	int64_t page;
+	int i, j, n;
+
+	if (heat_h == NULL)
+		return (0);
+
+	/* copy out, so naming the objects happens without heat_lk */
+	Pthread_mutex_lock(&heat_lk);
+	if ((ents = malloc((heat_lru.count + 1) * sizeof(*ents))) == NULL) {
+		Pthread_mutex_unlock(&heat_lk);
+		return (ENOMEM);
+	}
+	n = 0;
+	LISTC_FOR_EACH(&heat_lru, e, lnk)
+		ents[n++] = *e;
+	Pthread_mutex_unlock(&heat_lk);
+
+	for (i = 0; i < n; i++) {
+		e = &ents[i];
+		if (e->key.named) {
+			snprintf(name, sizeof(name), "%s", (char *)e->key.data);
+			snprintf(rectype, sizeof(rectype), "NAMED");
+			page = -1;
+		} else
+			__lock_describe_obj(dbenv, e->key.data, e->key.size,
+			    name, sizeof(name), rectype, sizeof(rectype),
+			    &page);
+
+		qsort(e->stacks, LOCK_HEAT_STACKS, sizeof(e->stacks[0]),
+		    lock_heat_stack_cmp);
+		stacks[0] = '\0';
+		for (j = 0, off = 0; j < LOCK_HEAT_STACKS; j++) {
+			s = &e->stacks[j];
+			if (s->nframes == 0)
+				continue;
+			off += snprintf(stacks + off, sizeof(stacks) - off,
+			    "%s%llu:", off ? "\n" : "",
+			    (unsigned long long)s->nwaits);
+			for (unsigned f = 0;
+			    f < s->nframes && off < sizeof(stacks); f++)
+				off += snprintf(stacks + off,
+				    sizeof(stacks) - off, " %p", s->pcs[f]);
+			if (off >= sizeof(stacks))
+				break;
+		}
+
+		if ((*func)(arg, name[0] ? name : NULL, page, rectype,
+		    e->nwaits, e->total_us, e->max_us,
+		    stacks[0] ? stacks : NULL) != 0)
+			break;
+	}
+	free(ents);
+	return (0);
+}
@@ -34,6 +34,8 @@ static size_t
 static size_t __lock_region_maint __P((DB_ENV *));
 #endif
 
+extern u_int32_t gbl_lk_tcache_gen;
+
 /*
  * The conflict arrays are set up such that the row is the lock you are
  * holding and the column is the lock that is desired.
@@ -144,6 +146,7 @@ __lock_open(dbenv)
 	R_UNLOCK(dbenv, &lt->reginfo);
 
 	dbenv->lk_handle = lt;
+	++gbl_lk_tcache_gen;
 	return (0);
 
 err:	if (lt->reginfo.addr != NULL) {
@@ -441,6 +444,7 @@ __lock_dbenv_refresh(dbenv)
 	__os_free(dbenv, lt);
 
 	dbenv->lk_handle = NULL;
+	++gbl_lk_tcache_gen;
 	return (ret);
 }
 
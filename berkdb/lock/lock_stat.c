@@ -626,48 +626,60 @@ static char *status_to_str(int lpstatus)
 
 #include "tohex.h"
 
-static int
-__collect_lock(DB_LOCKTAB *lt, DB_LOCKER *lip, struct __db_lock *lp,
-		collect_locks_f func, void *arg)
+/*
+ * __lock_describe_obj --
+ *	Name a lock object the way the lock listings do: the file or table it
+ *	is on into name, the kind of lock into rectype, and its page into
+ *	*pagep, or -1 if it isn't a page lock.
+ *
+ * PUBLIC: void __lock_describe_obj __P((DB_ENV *, const void *, u_int32_t,
+ * PUBLIC:     char *, size_t, char *, size_t, int64_t *));
+ */
+void
+__lock_describe_obj(dbenv, obj, size, name, namelen, rectype, rectypelen,
+    pagep)
+	DB_ENV *dbenv;
+	const void *obj;
+	u_int32_t size;
+	char *name;
+	size_t namelen;
+	char *rectype;
+	size_t rectypelen;
+	int64_t *pagep;
 {
-	DB_LOCKOBJ *lockobj;
 	db_pgno_t pgno = 0;
 	DB_LSN lsn;
-	int64_t page = -1;
-	u_int32_t *fidp, type;
-	u_int8_t *ptr;
+	u_int32_t type;
+	const u_int8_t *ptr = obj;
 	char minmax = 0;
 	char *hexdump = NULL;
 	char *namep = NULL;
-	char rectype[80]={0};
 	unsigned long long genid;
-	char fileid[DB_FILE_ID_LEN];
+	u_int8_t fileid[DB_FILE_ID_LEN];
 	char tablename[64] = {0};
-	const char *mode, *status;
+	int l;
 
-	mode = mode_to_str(lp->mode);
-	status = status_to_str(lp->status);
-
-	lockobj = lp->lockobj;
-	ptr = lockobj->lockobj.data;
+	*pagep = -1;
+	rectype[0] = '\0';
 
-	switch(lockobj->lockobj.size) {
+	switch(size) {
 		case(sizeof(struct __db_ilock)):
 			memcpy(&pgno, ptr, sizeof(db_pgno_t));
-			fidp = (u_int32_t *)(ptr + sizeof(db_pgno_t));
-			type = *(u_int32_t *)(ptr + sizeof(db_pgno_t) + DB_FILE_ID_LEN);
-			if (__dbreg_get_name(lt->dbenv, (u_int8_t *) fidp, &namep) != 0)
+			memcpy(fileid, ptr + sizeof(db_pgno_t), DB_FILE_ID_LEN);
+			memcpy(&type, ptr + sizeof(db_pgno_t) + DB_FILE_ID_LEN,
+			    sizeof(type));
+			if (__dbreg_get_name(dbenv, fileid, &namep) != 0)
 				namep = NULL;
 			switch(type) {
 				case (DB_PAGE_LOCK):
-					snprintf(rectype, sizeof(rectype), "PAGE");
-					page = pgno;
+					snprintf(rectype, rectypelen, "PAGE");
+					*pagep = pgno;
 					break;
 				case (DB_HANDLE_LOCK):
-					snprintf(rectype, sizeof(rectype), "HANDLE");
+					snprintf(rectype, rectypelen, "HANDLE");
 					break;
 				default:
-					snprintf(rectype, sizeof(rectype), "UNKNOWN");
+					snprintf(rectype, rectypelen, "UNKNOWN");
 					break;
 			}
 			break;
@@ -677,58 +689,55 @@ __collect_lock(DB_LOCKTAB *lt, DB_LOCKER *lip, struct __db_lock *lp,
 			memcpy(fileid, ptr, DB_FILE_ID_LEN);
 			memcpy(&genid, ptr + DB_FILE_ID_LEN + sizeof(short),
 					sizeof(unsigned long long));
-			fidp = (u_int32_t*) fileid;
-			if (__dbreg_get_name(lt->dbenv, (u_int8_t *)fidp, &namep) != 0)
+			if (__dbreg_get_name(dbenv, fileid, &namep) != 0)
 				namep = NULL;
-			int l=strlen(namep);
+			l = namep ? strlen(namep) : 0;
 			if (l >= 5 && !strncmp(&namep[l-5], "index", 5)) {
-				snprintf(rectype, sizeof(rectype), "KEYHASH %llx", genid);
+				snprintf(rectype, rectypelen, "KEYHASH %llx", genid);
 			} else {
-				snprintf(rectype, sizeof(rectype), "ROWLOCK %llx", genid);
+				snprintf(rectype, rectypelen, "ROWLOCK %llx", genid);
 			}
 			break;
 
 		case (31):
 			memcpy(fileid, ptr, DB_FILE_ID_LEN);
-			memcpy(&minmax, ((char *)ptr)+30, sizeof(char));
-			fidp = (u_int32_t *) fileid;
-			if (__dbreg_get_name(lt->dbenv, (u_int8_t *) fidp, &namep) != 0)
+			memcpy(&minmax, ptr + 30, sizeof(char));
+			if (__dbreg_get_name(dbenv, fileid, &namep) != 0)
 				namep = NULL;
-			snprintf(rectype, sizeof(rectype), "MINMAX %s", minmax == 0 ?
+			snprintf(rectype, rectypelen, "MINMAX %s", minmax == 0 ?
 					"MIN" : "MAX");
 			break;
 
 		case (32):
 			memcpy(tablename, ptr, 28);
-			snprintf(rectype, sizeof(rectype), "TABLELOCK %s", tablename);
+			snprintf(rectype, rectypelen, "TABLELOCK %s", tablename);
 			namep = tablename;
 			break;
 
 		case (20):
 			memcpy(fileid, ptr, DB_FILE_ID_LEN);
-			fidp = (u_int32_t *) fileid;
-			if (__dbreg_get_name(lt->dbenv, (u_int8_t *) fidp, &namep) != 0)
+			if (__dbreg_get_name(dbenv, fileid, &namep) != 0)
 				namep = NULL;
-			snprintf(rectype, sizeof(rectype), "STRIPELOCK");
+			snprintf(rectype, rectypelen, "STRIPELOCK");
 			break;
 
 		/* LSN LOCK .. REALLY?? */
 		case (8):
 			memcpy(&lsn, ptr, sizeof(DB_LSN));
-			snprintf(rectype, sizeof(rectype), "LSN %u:%u", lsn.file,lsn.offset);
+			snprintf(rectype, rectypelen, "LSN %u:%u", lsn.file,lsn.offset);
 			break;
 
 		case (4):
 			if (*((int *)ptr) == 1) {
 				namep = "ENVLOCK";
-				snprintf(rectype, sizeof(rectype), "ENVLOCK");
+				snprintf(rectype, rectypelen, "ENVLOCK");
 				break;
 			}
 
 		default:
-			hexdumpbuf(lockobj->lockobj.data, lockobj->lockobj.size, &hexdump);
-			snprintf(rectype, sizeof(rectype), "UNKNOWN-TYPE SIZE %d",
-					lockobj->lockobj.size);
+			hexdumpbuf((char *)ptr, size, &hexdump);
+			snprintf(rectype, rectypelen, "UNKNOWN-TYPE SIZE %d",
+					size);
 			namep = hexdump;
 			break;
 	}
@@ -736,9 +745,34 @@ __collect_lock(DB_LOCKTAB *lt, DB_LOCKER *lip, struct __db_lock *lp,
 	if (namep && memcmp(namep, "XXX.", 4) == 0)
 		namep += 4;
 
-	(*func)(arg, lip->tid, lip->id, mode, status, namep, page, rectype);
+	if (namep)
+		snprintf(name, namelen, "%s", namep);
+	else
+		name[0] = '\0';
 	if (hexdump)
 		free(hexdump);
+}
+
+static int
+__collect_lock(DB_LOCKTAB *lt, DB_LOCKER *lip, struct __db_lock *lp,
+		collect_locks_f func, void *arg)
+{
+	DB_LOCKOBJ *lockobj;
+	int64_t page;
+	char rectype[80];
+	char name[256];
+	const char *mode, *status;
+
+	mode = mode_to_str(lp->mode);
+	status = status_to_str(lp->status);
+
+	lockobj = lp->lockobj;
+	__lock_describe_obj(lt->dbenv, lockobj->lockobj.data,
+	    lockobj->lockobj.size, name, sizeof(name), rectype,
+	    sizeof(rectype), &page);
+
+	(*func)(arg, lip->tid, lip->id, mode, status, name[0] ? name : NULL,
+	    page, rectype);
 	return 0;
 }
 
@@ -1037,6 +1037,8 @@ __log_region_destroy(dbenv, infop)
 	COMPQUIET(infop, NULL);
 }
 
+void bdb_log_index_truncate(DB_LSN *);
+
 /*
  * __log_vtruncate
  *	This is a virtual truncate.  We set up the log indicators to
@@ -1055,7 +1057,7 @@ __log_vtruncate(dbenv, lsn, ckplsn, trunclsn)
 	DBT log_dbt;
 	DB_LOG *dblp;
 	DB_LOGC *logc;
-	DB_LSN end_lsn;
+	DB_LSN end_lsn, next_lsn;
 	DB_MUTEX *flush_mutexp;
 	LOG *lp;
 	u_int32_t bytes, c_len;
@@ -1128,8 +1130,13 @@ __log_vtruncate(dbenv, lsn, ckplsn, trunclsn)
 	/* Truncate the log to the new point. */
 	if ((ret = __log_zero(dbenv, &lp->lsn, &end_lsn)) != 0)
 		goto err;
+	next_lsn = lp->lsn;
 
 err:	R_UNLOCK(dbenv, &dblp->reginfo);
+	if (ret == 0) {
+		__log_rcache_truncate();
+		bdb_log_index_truncate(&next_lsn);
+	}
 	return (ret);
 }
 
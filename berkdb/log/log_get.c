@@ -227,6 +227,7 @@ __log_c_close(logc)
         ZERO_LSN(logc->bp_lsn);
         logc->bp_maxrec = 0;
         logc->bp_rlen = 0;
+        F_CLR(logc, DB_LOG_REP_FILL);
         if (logc->c_fhp != NULL) {
             (void)__os_closehandle(dbenv, logc->c_fhp);
             logc->c_fhp = NULL;
@@ -1669,6 +1670,16 @@ __log_c_io(logc, fnum, offset, p, nrp, eofp)
 		__os_free(dbenv, np);
 	}
 
+	/* Replicant fills share the log read cache. */
+	if (F_ISSET(logc, DB_LOG_REP_FILL) &&
+	    (ret = __log_rcache_read(logc, fnum, offset, p, nrp)) != -1) {
+		if (ret != 0 && !F_ISSET(logc, DB_LOG_SILENT_ERR))
+			__db_err(dbenv,
+			    "DB_LOGC->get: LSN: %lu/%lu: cached read: %s",
+			    (u_long)fnum, (u_long)offset, db_strerror(ret));
+		return (ret);
+	}
+
 	/* Seek to the record's offset. */
 	if ((ret = __os_seek(dbenv,
 	    logc->c_fhp, 0, 0, offset, 0, DB_OS_SEEK_SET)) != 0) {
@@ -101,6 +101,7 @@ __log_dbenv_create(dbenv)
 		dbenv->log_put = __log_put_pp;
 		dbenv->log_stat = __log_stat_pp;
 		dbenv->log_get_last_lsn = __log_get_last_lsn_pp;
+		dbenv->log_prealloc = __log_prealloc_pp;
 	}
 }
 
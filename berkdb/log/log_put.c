@@ -31,6 +31,7 @@ static const char revid[] = "$Id: log_put.c,v 11.145 2003/09/13 19:20:39 bostic
 
 #include <assert.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "db_int.h"
 #include "dbinc/crypto.h"
@@ -45,6 +46,7 @@ static const char revid[] = "$Id: log_put.c,v 11.145 2003/09/13 19:20:39 bostic
 
 #include "logmsg.h"
 #include <locks_wrap.h>
+#include "wait_event.h"
 #include <poll.h>
 
 extern unsigned long long get_commit_context(const void *, uint32_t generation);
@@ -62,6 +64,7 @@ static int __log_fill_segments __P((DB_LOG *, DB_LSN *, DB_LSN *, void *,
 	u_int32_t));
 static int __log_flush_commit __P((DB_ENV *, const DB_LSN *, u_int32_t));
 static int __log_newfh __P((DB_LOG *));
+static void __log_prealloc_take __P((DB_LOG *, u_int32_t));
 static int __log_put_next __P((DB_ENV *,
 	DB_LSN *, u_int64_t *, DBT *, const DBT *, HDR *, DB_LSN *, int,
 	u_int8_t *key, u_int32_t));
@@ -132,6 +135,72 @@ __log_put_pp(dbenv, lsnp, udbt, flags)
 
 int gbl_commit_delay_trace = 0;
 
+/*
+ * Group commit.  When commits arrive faster than the log can be fsync'd,
+ * a thread about to sync for a commit first waits briefly, looking like a
+ * flush in progress, so that commits arriving in the meantime queue up
+ * behind it and are made durable by the same fsync.  The wait is sized
+ * from moving averages of the commit inter-arrival time and of the fsync
+ * latency and never exceeds gbl_group_commit_max_usec (0 disables it).
+ * The averages are maintained under the log region lock.
+ */
+int gbl_group_commit_max_usec = 0;
+static u_int64_t gc_last_arrival;
+static u_int64_t gc_gap_avg;
+static u_int64_t gc_fsync_avg;
+
+static inline u_int64_t
+gc_now_usec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return ((u_int64_t)tv.tv_sec * 1000000 + tv.tv_usec);
+}
+
+#define	GC_EWMA(avg, sample)	((avg) == 0 ? (sample) :		\
+	(avg) - (avg) / 8 + (sample) / 8)
+
+static void
+__log_group_commit_arrival(lp)
+	LOG *lp;
+{
+	u_int64_t now, gap;
+
+	now = gc_now_usec();
+	if (gc_last_arrival != 0 && now > gc_last_arrival) {
+		gap = now - gc_last_arrival;
+		/* An idle spell says nothing about the current rate. */
+		if (gap > 1000000)
+			gc_gap_avg = 0;
+		else
+			gc_gap_avg = GC_EWMA(gc_gap_avg, gap);
+	}
+	gc_last_arrival = now;
+	lp->stat.st_gc_arrival_usec = (u_int32_t)gc_gap_avg;
+}
+
+/*
+ * Return how long a committer should wait before syncing, in usecs.
+ * There is only something to gain if more than one commit is expected to
+ * arrive per fsync; in that case wait for about one fsync's worth.
+ */
+static u_int64_t
+__log_group_commit_window(lp)
+	LOG *lp;
+{
+	u_int64_t window;
+
+	if (gbl_group_commit_max_usec <= 0 || gc_fsync_avg == 0 ||
+	    gc_gap_avg == 0 || gc_gap_avg >= gc_fsync_avg)
+		return (0);
+	window = gc_fsync_avg;
+	if (window > (u_int64_t)gbl_group_commit_max_usec)
+		window = gbl_group_commit_max_usec;
+	lp->stat.st_gc_window_usec = (u_int32_t)window;
+	return (window);
+}
+
 static inline int is_commit_record(int rectype) {
     switch(rectype) {
         /* regop regop_gen regop_rowlocks */
@@ -1289,6 +1358,8 @@ __log_lwr_lsn(dblp)
 	}
 }
 
+static int __log_flush_int_ll __P((DB_LOG *, const DB_LSN *, int));
+
 /*
  * __log_flush_int --
  *	Write all records less than or equal to the specified LSN; internal
@@ -1301,6 +1372,22 @@ __log_flush_int(dblp, lsnp, release)
 	DB_LOG *dblp;
 	const DB_LSN *lsnp;
 	int release;
+{
+	uint64_t wait;
+	int ret;
+
+	/* includes waiting for someone else's flush to cover us */
+	wait = wait_event_begin(WAIT_EVENT_LOG_FLUSH);
+	ret = __log_flush_int_ll(dblp, lsnp, release);
+	wait_event_end(wait);
+	return (ret);
+}
+
+static int
+__log_flush_int_ll(dblp, lsnp, release)
+	DB_LOG *dblp;
+	const DB_LSN *lsnp;
+	int release;
 {
 	struct __db_commit *commit, *tcommit;
 
@@ -1312,6 +1399,7 @@ __log_flush_int(dblp, lsnp, release)
 	DB_MUTEX *flush_mutexp;
 	LOG *lp;
 	u_int32_t ncommit, w_off, listcnt;
+	u_int64_t window, fsync_start, fsync_end;
 	int do_flush, first, ret, wrote_inmem;
 
 	dbenv = dblp->dbenv;
@@ -1359,6 +1447,8 @@ __log_flush_int(dblp, lsnp, release)
 			return (0);
 
 		flush_lsn = *lsnp;
+		if (release && gbl_group_commit_max_usec > 0)
+			__log_group_commit_arrival(lp);
 	}
 
 	/*
@@ -1447,6 +1537,20 @@ __log_flush_int(dblp, lsnp, release)
 			flush_lsn = lp->t_lsn;
 		} else
 			return (0);
+		} else if (release && lsnp != NULL &&
+	    (window = __log_group_commit_window(lp)) != 0) {
+		/*
+		 * Nobody is flushing.  Hold off so that commits arriving in
+		 * the meantime queue up behind us, then sync for all of them.
+		 */
+		lp->in_flush++;
+		R_UNLOCK(dbenv, &dblp->reginfo);
+		(void)__os_sleep(dbenv, 0, (u_long)window);
+		R_LOCK(dbenv, &dblp->reginfo);
+		lp->in_flush--;
+		if (log_compare(&lp->t_lsn, &flush_lsn) > 0)
+			flush_lsn = lp->t_lsn;
+		++lp->stat.st_gc_waits;
 	}
 
 	/*
@@ -1539,6 +1643,7 @@ flush:	MUTEX_LOCK(dbenv, flush_mutexp);
 		R_UNLOCK(dbenv, &dblp->reginfo);
 
 	/* Sync all writes to disk. */
+	fsync_start = gbl_group_commit_max_usec > 0 ? gc_now_usec() : 0;
 	if ((ret = __os_fsync(dbenv, dblp->lfhp)) != 0) {
 		MUTEX_UNLOCK(dbenv, flush_mutexp);
 		if (release)
@@ -1556,6 +1661,13 @@ flush:	MUTEX_LOCK(dbenv, flush_mutexp);
 	 * set for the new buffer.
 	 */
 	lp->s_lsn = s_lsn;
+	if (fsync_start != 0) {
+		fsync_end = gc_now_usec();
+		if (fsync_end > fsync_start)
+			gc_fsync_avg =
+			    GC_EWMA(gc_fsync_avg, fsync_end - fsync_start);
+		lp->stat.st_gc_fsync_usec = (u_int32_t)gc_fsync_avg;
+	}
 
 	/*
 	 * The s_lsn optimization doesn't work for the segmented buffer case
@@ -1651,6 +1763,7 @@ done:	listcnt = 0;
 			}
 		}
 	}
+	lp->stat.st_commitsflushed += ncommit;
 	if (lp->stat.st_maxcommitperflush < ncommit)
 		lp->stat.st_maxcommitperflush = ncommit;
 	if (lp->stat.st_mincommitperflush > ncommit ||
@@ -2092,6 +2205,8 @@ __log_newfh(dblp)
 
 	/* Get the path of the new file and open it. */
 	dblp->lfname = lp->lsn.file;
+	if (dbenv->attr.log_prealloc_files > 0)
+		__log_prealloc_take(dblp, dblp->lfname);
 	if ((ret = __log_valid(dblp, dblp->lfname, 0, &dblp->lfhp,
 	    flags, &status)) != 0)
 		__db_err(dbenv,
@@ -2102,6 +2217,138 @@ __log_newfh(dblp)
 	return (ret);
 }
 
+/*
+ * Log files can be made ahead of time, by __log_prealloc_pp, so that a log
+ * switch doesn't wait for the file system to create and allocate one.  The
+ * spare for log.N is log.N.prealloc, which __log_find doesn't take for a
+ * log file.  It is empty, with its blocks allocated, so once it is renamed
+ * it reads like a freshly created log file.
+ */
+static int
+__log_prealloc_name(dblp, filenumber, namep, sparep)
+	DB_LOG *dblp;
+	u_int32_t filenumber;
+	char **namep, **sparep;
+{
+	DB_ENV *dbenv;
+	size_t len;
+	int ret;
+
+	dbenv = dblp->dbenv;
+	if ((ret = __log_name(dblp, filenumber, namep, NULL, 0)) != 0)
+		return (ret);
+	len = strlen(*namep) + sizeof(".prealloc.tmp");
+	if ((ret = __os_malloc(dbenv, len, sparep)) != 0) {
+		__os_free(dbenv, *namep);
+		return (ret);
+	}
+	snprintf(*sparep, len, "%s.prealloc", *namep);
+	return (0);
+}
+
+/*
+ * __log_prealloc_take --
+ *	Put the spare of a log file in its place, if there is one and the log
+ *	file doesn't exist yet.
+ */
+static void
+__log_prealloc_take(dblp, filenumber)
+	DB_LOG *dblp;
+	u_int32_t filenumber;
+{
+	DB_ENV *dbenv;
+	char *name, *spare;
+
+	dbenv = dblp->dbenv;
+	if (__log_prealloc_name(dblp, filenumber, &name, &spare) != 0)
+		return;
+	/* link, not rename: never replace a log file that is there */
+	if (link(spare, name) == 0)
+		(void)unlink(spare);
+	__os_free(dbenv, spare);
+	__os_free(dbenv, name);
+}
+
+/*
+ * __log_prealloc_pp --
+ *	DB_ENV->log_prealloc.  Make sure the next log_prealloc_files log files
+ *	have a spare, and remove the spares that were never used.
+ *
+ * PUBLIC: int __log_prealloc_pp __P((DB_ENV *));
+ */
+int
+__log_prealloc_pp(dbenv)
+	DB_ENV *dbenv;
+{
+	DB_FH *fhp;
+	DB_LOG *dblp;
+	LOG *lp;
+	u_int32_t cur, fnum;
+	char *name, *spare, *tmp;
+	int i, n, ret;
+
+	PANIC_CHECK(dbenv);
+	ENV_REQUIRES_CONFIG(dbenv,
+	    dbenv->lg_handle, "DB_ENV->log_prealloc", DB_INIT_LOG);
+
+	dblp = dbenv->lg_handle;
+	lp = dblp->reginfo.primary;
+	if ((n = dbenv->attr.log_prealloc_files) <= 0)
+		return (0);
+
+	/*
+	 * Read without the region lock; it only says where to look.  The
+	 * current file may not have been opened yet, but the one before it
+	 * has been, so its spare, if any, is left over.
+	 */
+	cur = lp->lsn.file;
+	if (cur > 1 &&
+	    __log_prealloc_name(dblp, cur - 1, &name, &spare) == 0) {
+		(void)unlink(spare);
+		__os_free(dbenv, spare);
+		__os_free(dbenv, name);
+	}
+
+	ret = 0;
+	for (i = 1; i <= n; i++) {
+		fnum = cur + i;
+		if ((ret = __log_prealloc_name(dblp, fnum, &name, &spare)) != 0)
+			break;
+		tmp = NULL;
+		if (__os_exists(name, NULL) == 0 ||
+		    __os_exists(spare, NULL) == 0)
+			goto next;
+
+		/* make it under another name so it is never seen half made */
+		if ((ret = __os_malloc(dbenv, strlen(spare) + 5, &tmp)) != 0)
+			goto next;
+		snprintf(tmp, strlen(spare) + 5, "%s.tmp", spare);
+		if ((ret = __os_open(dbenv, tmp, DB_OSO_CREATE | DB_OSO_TRUNC,
+		    lp->persist.mode, &fhp)) != 0)
+			goto next;
+		ret = __os_preallocate(dbenv, 0, lp->log_nsize, fhp);
+		(void)__os_closehandle(dbenv, fhp);
+		if (ret != 0 ||
+		    (ret = __os_rename(dbenv, tmp, spare, 0)) != 0) {
+			(void)unlink(tmp);
+			goto next;
+		}
+
+		/* the log may have moved past it while we were at it */
+		if (lp->lsn.file > fnum)
+			(void)unlink(spare);
+
+next:		if (tmp != NULL)
+			__os_free(dbenv, tmp);
+		__os_free(dbenv, spare);
+		__os_free(dbenv, name);
+		if (ret != 0)
+			break;
+	}
+
+	return (ret);
+}
+
 /*
  * __log_name --
  *	Return the log name for a particular file, and optionally open it.
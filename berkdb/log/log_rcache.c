@@ -0,0 +1,391 @@
+/*-
+ * See the file LICENSE for redistribution information.
+ *
+ * Copyright (c) 1996-2003
+ *	Sleepycat Software.  All rights reserved.
+ */
+
+#include "db_config.h"
+
+#ifndef NO_SYSTEM_INCLUDES
+#include <sys/types.h>
+
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#endif
+
+#include "db_int.h"
+#include "dbinc/log.h"
+#include "list.h"
+#include "plhash.h"
+#include "logmsg.h"
+#include "locks_wrap.h"
+
+/*
+ * Log read cache for the master's replicant fill requests.  A replicant that
+ * has fallen behind asks for records that have left the log buffer, and each
+ * one of them walks the same stretch of the log through its own cursor a
+ * buffer at a time.  While log_read_cache_mb is set, a cursor marked
+ * DB_LOG_REP_FILL reads through fixed chunks of the log files shared by every
+ * such cursor: a miss reads its chunk and the next few in one read, and
+ * anyone after a chunk that is being read waits for that read rather than
+ * issuing its own.  Only bytes that can't change are kept: whole chunks below
+ * the write offset of the current file and anything in an older one.  A
+ * truncate of the log drops the lot.  The disk reads of misses are held to
+ * log_read_cache_rate_mb a second, so catching up replicants can't starve
+ * the log writes of live commits.
+ */
+int gbl_log_read_cache_mb = 0;
+int gbl_log_read_cache_rate_mb = 0;
+
+#define	RCACHE_CHUNK		MEGABYTE
+/* chunks read by a miss, counting its own */
+#define	RCACHE_READAHEAD	4
+
+struct rcache_key {
+	u_int32_t file;
+	u_int32_t chunk;
+};
+
+struct rcache_chunk {
+	struct rcache_key key;
+	u_int32_t len;		/* short only at the end of an older file */
+	int loading;		/* being read; not on the lru yet */
+	u_int64_t gen;		/* rcache_gen when it was read */
+	LINKC_T(struct rcache_chunk) lnk;
+	u_int8_t *data;
+};
+
+static pthread_mutex_t rcache_lk = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rcache_cd = PTHREAD_COND_INITIALIZER;
+static pthread_once_t rcache_once = PTHREAD_ONCE_INIT;
+static hash_t *rcache_h;
+static LISTC_T(struct rcache_chunk) rcache_lru;	/* oldest first */
+static size_t rcache_bytes;
+static u_int64_t rcache_gen;	/* bumped by every truncate */
+static u_int64_t rcache_hits, rcache_misses, rcache_waits, rcache_throttled;
+
+static pthread_mutex_t rcache_rate_lk = PTHREAD_MUTEX_INITIALIZER;
+static time_t rcache_rate_sec;
+static int64_t rcache_rate_used;
+
+static void
+rcache_init()
+{
+	rcache_h = hash_init_o(offsetof(struct rcache_chunk, key),
+	    sizeof(struct rcache_key));
+	listc_init(&rcache_lru, offsetof(struct rcache_chunk, lnk));
+}
+
+static void
+rcache_free(c)
+	struct rcache_chunk *c;
+{
+	free(c->data);
+	free(c);
+}
+
+/* Drop a chunk that is done loading; rcache_lk is held. */
+static void
+rcache_remove(c)
+	struct rcache_chunk *c;
+{
+	hash_del(rcache_h, c);
+	listc_rfl(&rcache_lru, c);
+	rcache_bytes -= c->len;
+	rcache_free(c);
+}
+
+static void
+rcache_evict()
+{
+	size_t maxbytes;
+	struct rcache_chunk *c;
+
+	maxbytes = (size_t)gbl_log_read_cache_mb * MEGABYTE;
+	while (rcache_bytes > maxbytes && (c = rcache_lru.top) != NULL)
+		rcache_remove(c);
+}
+
+/* Hold the disk reads of misses to log_read_cache_rate_mb a second. */
+static void
+rcache_throttle(bytes)
+	size_t bytes;
+{
+	int64_t limit;
+	time_t now;
+	int waited;
+
+	for (waited = 0;; waited = 1) {
+		if ((limit = (int64_t)gbl_log_read_cache_rate_mb * MEGABYTE) <= 0)
+			return;
+		Pthread_mutex_lock(&rcache_rate_lk);
+		if ((now = time(NULL)) != rcache_rate_sec) {
+			rcache_rate_sec = now;
+			rcache_rate_used = 0;
+		}
+		if (rcache_rate_used < limit) {
+			rcache_rate_used += bytes;
+			Pthread_mutex_unlock(&rcache_rate_lk);
+			return;
+		}
+		Pthread_mutex_unlock(&rcache_rate_lk);
+		if (!waited) {
+			Pthread_mutex_lock(&rcache_lk);
+			rcache_throttled++;
+			Pthread_mutex_unlock(&rcache_lk);
+		}
+		poll(NULL, 0, 20);
+	}
+}
+
+/*
+ * Read the chunk c is the placeholder for, and the ones after it up to
+ * nchunks, through the cursor's file handle.  Returns with rcache_lk held and
+ * c on the lru, or freed if the read failed or the log moved under it.
+ */
+static int
+rcache_load(logc, c, nchunks, limit)
+	DB_LOGC *logc;
+	struct rcache_chunk *c;
+	u_int32_t nchunks, limit;
+{
+	DB_ENV *dbenv;
+	struct rcache_chunk *ra;
+	struct rcache_key k;
+	u_int8_t *buf;
+	size_t len, nr, n;
+	u_int32_t i, idx;
+	int ret;
+
+	dbenv = logc->dbenv;
+	len = (size_t)nchunks * RCACHE_CHUNK;
+	nr = 0;
+	if ((buf = malloc(len)) == NULL)
+		ret = ENOMEM;
+	else {
+		rcache_throttle(len);
+		if ((ret = __os_seek(dbenv, logc->c_fhp, 0, 0,
+		    c->key.chunk * RCACHE_CHUNK, 0, DB_OS_SEEK_SET)) == 0)
+			ret = __os_read(dbenv, logc->c_fhp, buf, len, &nr);
+	}
+
+	Pthread_mutex_lock(&rcache_lk);
+	rcache_misses++;
+	c->loading = 0;
+	Pthread_cond_broadcast(&rcache_cd);
+	if (ret != 0 || c->gen != rcache_gen) {
+		hash_del(rcache_h, c);
+		rcache_free(c);
+		free(buf);
+		return (ret);
+	}
+
+	/* the chunk asked for goes on the lru last, so it is evicted last */
+	for (i = 1; i <= nchunks; i++) {
+		idx = i % nchunks;
+		n = nr > idx * RCACHE_CHUNK ? nr - idx * RCACHE_CHUNK : 0;
+		if (n > RCACHE_CHUNK)
+			n = RCACHE_CHUNK;
+		/* the tail of the current file can still grow */
+		if (n < RCACHE_CHUNK && limit != UINT32_MAX)
+			continue;
+		if (idx == 0)
+			ra = c;
+		else {
+			/* past the end of an older file */
+			if (n == 0)
+				continue;
+			k.file = c->key.file;
+			k.chunk = c->key.chunk + idx;
+			if (hash_find(rcache_h, &k) != NULL ||
+			    (ra = calloc(1, sizeof(*ra))) == NULL)
+				continue;
+			ra->key = k;
+		}
+		if ((ra->data = malloc(n ? n : 1)) == NULL) {
+			if (ra != c)
+				free(ra);
+			continue;
+		}
+		memcpy(ra->data, buf + idx * RCACHE_CHUNK, n);
+		ra->len = (u_int32_t)n;
+		if (ra != c)
+			hash_add(rcache_h, ra);
+		listc_abl(&rcache_lru, ra);
+		rcache_bytes += n;
+	}
+	if (c->data == NULL) {
+		hash_del(rcache_h, c);
+		rcache_free(c);
+	}
+	free(buf);
+	rcache_evict();
+	return (0);
+}
+
+/*
+ * __log_rcache_read --
+ *	Read a range of a log file through the log read cache.  Returns 0 with
+ *	*nrp set to what was read, an error, or -1 if the range can't be cached
+ *	and the caller should read it itself.  The cursor's file handle must be
+ *	open on fnum.
+ *
+ * PUBLIC: int __log_rcache_read __P((DB_LOGC *,
+ * PUBLIC:     u_int32_t, u_int32_t, void *, size_t *));
+ */
+int
+__log_rcache_read(logc, fnum, offset, p, nrp)
+	DB_LOGC *logc;
+	u_int32_t fnum, offset;
+	void *p;
+	size_t *nrp;
+{
+	DB_ENV *dbenv;
+	DB_LOG *dblp;
+	LOG *lp;
+	struct rcache_chunk *c;
+	struct rcache_key k;
+	size_t want, got, n;
+	u_int32_t cur_file, limit, coff, nchunks;
+	int ret;
+
+	if (gbl_log_read_cache_mb <= 0 || logc->c_fhp == NULL)
+		return (-1);
+	pthread_once(&rcache_once, rcache_init);
+
+	dbenv = logc->dbenv;
+	dblp = dbenv->lg_handle;
+	lp = dblp->reginfo.primary;
+	want = *nrp;
+
+	R_LOCK(dbenv, &dblp->reginfo);
+	cur_file = lp->lsn.file;
+	limit = lp->w_off;
+	R_UNLOCK(dbenv, &dblp->reginfo);
+
+	if (fnum > cur_file)
+		return (-1);
+	if (fnum < cur_file)
+		limit = UINT32_MAX;
+	else if (((offset + want + RCACHE_CHUNK - 1) / RCACHE_CHUNK) *
+	    RCACHE_CHUNK > limit)
+		return (-1);
+
+	Pthread_mutex_lock(&rcache_lk);
+	for (got = 0; got < want;) {
+		k.file = fnum;
+		k.chunk = (u_int32_t)((offset + got) / RCACHE_CHUNK);
+		coff = (u_int32_t)((offset + got) % RCACHE_CHUNK);
+
+		if ((c = hash_find(rcache_h, &k)) == NULL) {
+			if ((c = calloc(1, sizeof(*c))) == NULL) {
+				ret = ENOMEM;
+				goto err;
+			}
+			c->key = k;
+			c->loading = 1;
+			c->gen = rcache_gen;
+			hash_add(rcache_h, c);
+			Pthread_mutex_unlock(&rcache_lk);
+
+			nchunks = RCACHE_READAHEAD;
+			if (limit != UINT32_MAX &&
+			    (k.chunk + nchunks) * RCACHE_CHUNK > limit)
+				nchunks = limit / RCACHE_CHUNK - k.chunk;
+			if ((ret = rcache_load(logc, c, nchunks, limit)) != 0)
+				goto err;
+			/* not kept: the log moved, or the cache is too small */
+			if (hash_find(rcache_h, &k) == NULL) {
+				Pthread_mutex_unlock(&rcache_lk);
+				return (-1);
+			}
+			continue;
+		}
+		if (c->loading) {
+			rcache_waits++;
+			Pthread_cond_wait(&rcache_cd, &rcache_lk);
+			continue;
+		}
+
+		rcache_hits++;
+		n = c->len > coff ? c->len - coff : 0;
+		if (n > want - got)
+			n = want - got;
+		memcpy((u_int8_t *)p + got, c->data + coff, n);
+		got += n;
+		listc_rfl(&rcache_lru, c);
+		listc_abl(&rcache_lru, c);
+		/* the end of an older file */
+		if (c->len < RCACHE_CHUNK)
+			break;
+	}
+	Pthread_mutex_unlock(&rcache_lk);
+	*nrp = got;
+	return (0);
+
+err:	Pthread_mutex_unlock(&rcache_lk);
+	return (ret);
+}
+
+/*
+ * __log_rcache_truncate --
+ *	The log was truncated; nothing cached can be trusted.
+ *
+ * PUBLIC: void __log_rcache_truncate __P((void));
+ */
+void
+__log_rcache_truncate()
+{
+	struct rcache_chunk *c;
+
+	pthread_once(&rcache_once, rcache_init);
+	Pthread_mutex_lock(&rcache_lk);
+	while ((c = rcache_lru.top) != NULL)
+		rcache_remove(c);
+	/* and whatever is being read now won't be kept */
+	rcache_gen++;
+	Pthread_mutex_unlock(&rcache_lk);
+}
+
+/*
+ * __berkdb_log_rcache_report --
+ *	Print how the log read cache is doing.
+ *
+ * PUBLIC: void __berkdb_log_rcache_report __P((void));
+ */
+void
+__berkdb_log_rcache_report()
+{
+	u_int64_t hits, misses, waits, throttled;
+	size_t bytes;
+	int nchunks;
+
+	if (gbl_log_read_cache_mb <= 0) {
+		logmsg(LOGMSG_USER,
+		    "log read cache is off (log_read_cache_mb 0)\n");
+		return;
+	}
+	pthread_once(&rcache_once, rcache_init);
+	Pthread_mutex_lock(&rcache_lk);
+	hits = rcache_hits;
+	misses = rcache_misses;
+	waits = rcache_waits;
+	throttled = rcache_throttled;
+	bytes = rcache_bytes;
+	nchunks = rcache_lru.count;
+	Pthread_mutex_unlock(&rcache_lk);
+
+	logmsg(LOGMSG_USER, "log read cache: %d chunks, %zu bytes of %d MB, "
+	    "hits %" PRIu64 " misses %" PRIu64 " waits %" PRIu64
+	    " throttled %" PRIu64 " (%d MB/s%s)\n", nchunks, bytes,
+	    gbl_log_read_cache_mb, hits, misses, waits, throttled,
+	    gbl_log_read_cache_rate_mb,
+	    gbl_log_read_cache_rate_mb > 0 ? "" : ", unlimited");
+}
@@ -521,10 +521,12 @@ found:		if (offsetp != NULL)
 			if (ret == 0) {
 				++c_mp->stat.st_rw_evict;
 				if(ISLEAF(bhp->buf)) ++c_mp->stat.st_rw_levict;
+				++bh_mfp->stat.st_evict;
 			}
 		} else {
 			++c_mp->stat.st_ro_evict;
 			if(ISLEAF(bhp->buf)) ++c_mp->stat.st_ro_levict;
+			++bh_mfp->stat.st_evict;
 		}
 
 		/*
@@ -38,6 +38,7 @@ static const char revid[] = "$Id: mp_bh.c,v 11.86 2003/07/02 20:02:37 mjc Exp $"
 #include "locks_wrap.h"
 #include "thread_stats.h"
 #include "comdb2_atomic.h"
+#include "wait_event.h"
 
 char *bdb_trans(const char infile[], char outfile[]);
 extern int gbl_test_badwrite_intvl;
@@ -410,6 +411,7 @@ __memp_recover_page(dbmfp, hp, bhp, pgno)
 	if (pgidx < 0)
 		return DB_PAGE_NOTFOUND;
 
+	ATOMIC_ADD64(mfp->dirty_gen, 1);
 	ATOMIC_ADD32(hp->hash_page_dirty, 1);
 	ATOMIC_ADD32(c_mp->stat.st_page_dirty, 1);
 	F_SET(bhp, BH_DIRTY);
@@ -465,10 +467,14 @@ __memp_pgread(dbmfp, hp, bhp, can_create, is_recovery_page)
 	 * them now, we create them when the pages have to be flushed.
 	 */
 	nr = 0;
-	if (dbmfp->fhp != NULL)
-		if ((ret = __os_io(dbenv, DB_IO_READ,
-		    dbmfp->fhp, bhp->pgno, pagesize, bhp->buf, &nr)) != 0)
+	if (dbmfp->fhp != NULL) {
+		uint64_t wait = wait_event_begin(WAIT_EVENT_PAGE_READ);
+		ret = __os_io(dbenv, DB_IO_READ,
+		    dbmfp->fhp, bhp->pgno, pagesize, bhp->buf, &nr);
+		wait_event_end(wait);
+		if (ret != 0)
 			goto err;
+	}
 
 	/*
 	 * The page may not exist; if it doesn't, nr may well be 0, but we
@@ -786,6 +792,7 @@ __memp_pgwrite_multi(dbenv, dbmfp, hps, bhps, numpages, wrrec)
 	DB_MPOOL *dbmp;
 	MPOOL *c_mp;
 	u_int32_t n_cache;
+	uint64_t wait;
 	int ret, i, idx;
 
 	mfp = dbmfp == NULL ? NULL : dbmfp->mfp;
@@ -1035,9 +1042,11 @@ __memp_pgwrite_multi(dbenv, dbmfp, hps, bhps, numpages, wrrec)
 	}
 
 	/* Write the page. */
-	if ((ret = __os_iov(dbenv, DB_IO_WRITE, dbmfp->fhp,
-		    bhps[0]->pgno, mfp->stat.st_pagesize,
-		    bparray, numpages, &nw)) != 0) {
+	wait = wait_event_begin(WAIT_EVENT_PAGE_WRITE);
+	ret = __os_iov(dbenv, DB_IO_WRITE, dbmfp->fhp,
+	    bhps[0]->pgno, mfp->stat.st_pagesize, bparray, numpages, &nw);
+	wait_event_end(wait);
+	if (ret != 0) {
 		__db_err(dbenv, "%s: writev failed for page %lu",
 		    __memp_fn(dbmfp), (u_long) bhp->pgno);
 		goto err;
@@ -210,6 +210,14 @@ __memp_falloc_len(mfp, offset, len)
 
 u_int64_t gbl_memp_pgreads = 0;
 
+/*
+ * 2Q-style scan resistance: pages enter the cache on probation and only
+ * get the hot-page boost in __memp_fput once they are fetched again by a
+ * caller that isn't scanning (DB_MPOOL_USEONCE, NOCACHE or prefault).
+ * A table scan then only recycles probationary pages.
+ */
+int gbl_mpool_2q = 0;
+
 /*
  * __memp_fget_internal --
  *	Get a page from the file.
@@ -232,7 +240,7 @@ __memp_fget_internal(dbmfp, pgnoaddr, flags, addrp, did_io)
 	MPOOLFILE *mfp;
 	roff_t mf_offset;
 	u_int32_t n_cache, st_hsearch, alloc_flags;
-	int b_incr, extending, first, ret, is_recovery_page;
+	int b_incr, extending, first, ret, is_recovery_page, useonce;
 	db_pgno_t falloc_off, falloc_len;
 
 	uint64_t start_time_us = 0;
@@ -246,6 +254,11 @@ __memp_fget_internal(dbmfp, pgnoaddr, flags, addrp, did_io)
 
 	*(void **)addrp = NULL;
 
+	/* Strip the scan hint so the flag comparisons below still work. */
+	useonce = LF_ISSET(DB_MPOOL_USEONCE | DB_MPOOL_PFGET) ||
+	    flags == DB_MPOOL_NOCACHE;
+	LF_CLR(DB_MPOOL_USEONCE);
+
 	dbenv = dbmfp->dbenv;
 	dbmp = dbenv->mp_handle;
 
@@ -396,6 +409,18 @@ retry:	st_hsearch = 0;
 
 		++mfp->stat.st_cache_hit;
 
+		if (F_ISSET(bhp, BH_PROBATION) && !useonce) {
+			F_CLR(bhp, BH_PROBATION);
+			++c_mp->stat.st_2q_promote;
+		}
+
+		if (c_mp->numa_node >= 0) {
+			if (__memp_numa_node() == c_mp->numa_node)
+				++c_mp->stat.st_numa_local_hit;
+			else
+				++c_mp->stat.st_numa_remote_hit;
+		}
+
         if (LF_ISSET(DB_MPOOL_PFGET))
             ++c_mp->stat.st_page_pf_in_late;
 
@@ -682,6 +707,9 @@ alloc:		/*
 			F_SET(bhp, BH_NOINCR);
 		}
 
+		if (gbl_mpool_2q)
+			F_SET(bhp, BH_PROBATION);
+
 		/*
 		 * If we created the page, zero it out.  If we didn't create
 		 * the page, read from the backing file.
@@ -1095,8 +1123,10 @@ __memp_add_sparse_page(dbenv, id, ufid, pgno, sparseness)
 		if (sparseness < spgs.list[ii + 1].sparseness)
 			break;
 
-	if (ii == -1)
+	if (ii == -1) {
+		Pthread_mutex_unlock(&spgs.lock);
 		return;
+	}
 
 	ent.dbenv = dbenv;
 	ent.id = id;
@@ -1114,6 +1144,96 @@ __memp_add_sparse_page(dbenv, id, ufid, pgno, sparseness)
 	Pthread_mutex_unlock(&spgs.lock);
 }
 
+/*
+ * Where the sweep is: a dbreg id and a page in it.  There is one sweeping
+ * thread.
+ */
+static int32_t sweep_fileid;
+static db_pgno_t sweep_pgno;
+
+/*
+ * __memp_sweep_sparse_pp --
+ *	DB_ENV->memp_sweep_sparse.  Look at the next npages pages of the open
+ *	btrees, one file after another, and offer the sparse leaf pages to the
+ *	page compact thread, like __memp_fget does for the pages it reads.
+ *	Pages fetched only for this leave the cache first.  *nsparsep is the
+ *	number of pages offered.
+ *
+ * PUBLIC: int __memp_sweep_sparse_pp __P((DB_ENV *, int, int *));
+ */
+int
+__memp_sweep_sparse_pp(dbenv, npages, nsparsep)
+	DB_ENV *dbenv;
+	int npages;
+	int *nsparsep;
+{
+	DB *dbp;
+	DB_LOG *dblp;
+	PAGE *h;
+	db_pgno_t last_pgno;
+	double fullsz, sparseness;
+	int nfiles;
+
+	*nsparsep = 0;
+	if (gbl_pg_compact_thresh <= 0)
+		return (0);
+
+	dblp = dbenv->lg_handle;
+	nfiles = 0;
+	while (npages > 0) {
+		if (sweep_fileid >= dblp->dbentry_cnt) {
+			sweep_fileid = 0;
+			sweep_pgno = 0;
+			/* one pass over the files per call at most */
+			if (nfiles > dblp->dbentry_cnt)
+				break;
+		}
+		++nfiles;
+
+		if (__dbreg_id_to_db_prefault(dbenv,
+		    NULL, &dbp, sweep_fileid, 0) != 0) {
+			++sweep_fileid;
+			sweep_pgno = 0;
+			continue;
+		}
+
+		if (dbp->type != DB_BTREE || dbp->log_filename == NULL) {
+			__dbreg_prefault_complete(dbenv, sweep_fileid);
+			++sweep_fileid;
+			sweep_pgno = 0;
+			continue;
+		}
+
+		/* a stale last page only ends the sweep of the file early */
+		last_pgno = dbp->mpf->mfp->last_pgno;
+		fullsz = dbp->pgsize - SIZEOF_PAGE;
+		for (; npages > 0 && sweep_pgno <= last_pgno;
+		    ++sweep_pgno, --npages) {
+			if (__memp_fget(dbp->mpf, &sweep_pgno,
+			    DB_MPOOL_NOCACHE, &h) != 0)
+				break;
+			if (TYPE(h) == P_LBTREE) {
+				sparseness = P_FREESPACE(dbp, h) / fullsz;
+				if (sparseness >= (1 - gbl_pg_compact_thresh)) {
+					__memp_add_sparse_page(dbenv,
+					    dbp->log_filename->id, dbp->fileid,
+					    sweep_pgno, sparseness);
+					++*nsparsep;
+				}
+			}
+			(void)__memp_fput(dbp->mpf, h, DB_MPOOL_NOCACHE);
+		}
+
+		__dbreg_prefault_complete(dbenv, sweep_fileid);
+		if (npages > 0) {
+			++sweep_fileid;
+			sweep_pgno = 0;
+		}
+	}
+
+	return (0);
+}
+
 /*
  * __memp_init_pgcompact_routines --
  *  Initialize data and thread
@@ -24,6 +24,7 @@ static const char revid[] = "$Id: mp_fopen.c,v 11.120 2003/11/07 18:45:15 ubell
 #include "dbinc/log.h"
 #include "dbinc/mp.h"
 #include "locks_wrap.h"
+#include "comdb2_atomic.h"
 
 #ifdef HAVE_RPC
 #include "dbinc_auto/db_server.h"
@@ -34,6 +35,8 @@ static int __memp_fclose_pp __P((DB_MPOOLFILE *, u_int32_t));
 static int __memp_fopen_pp __P((DB_MPOOLFILE *,
 		const char *, u_int32_t, int, size_t));
 static int __memp_get_clear_len __P((DB_MPOOLFILE *, u_int32_t *));
+static int __memp_get_dirty_gen __P((DB_MPOOLFILE *, u_int64_t *));
+static int __memp_get_stat __P((DB_MPOOLFILE *, DB_MPOOL_FSTAT *));
 static int __memp_get_flags __P((DB_MPOOLFILE *, u_int32_t *));
 static int __memp_get_lsn_offset __P((DB_MPOOLFILE *, int32_t *));
 static int __memp_get_maxsize __P((DB_MPOOLFILE *, u_int32_t *, u_int32_t *));
@@ -42,6 +45,14 @@ static int __memp_get_pgcookie __P((DB_MPOOLFILE *, DBT *));
 static int __memp_get_priority __P((DB_MPOOLFILE *, DB_CACHE_PRIORITY *));
 static int __memp_set_priority __P((DB_MPOOLFILE *, DB_CACHE_PRIORITY));
 
+/*
+ * Each new MPOOLFILE starts its dirty generation in a range of its own, so a
+ * file closed, discarded and opened again never repeats a generation that
+ * callers may have seen from its earlier MPOOLFILE.
+ */
+static u_int64_t mfp_dirty_gen_base;
+#define	MFP_DIRTY_GEN_RANGE	(1ULL << 40)
+
 /*
  * __memp_fcreate_pp --
  *	DB_ENV->memp_fcreate pre/post processing.
@@ -140,6 +151,8 @@ __memp_fcreate(dbenv, retp)
 	} else
 #endif
 	{
+		dbmfp->get_dirty_gen = __memp_get_dirty_gen;
+		dbmfp->get_stat = __memp_get_stat;
 		dbmfp->get_clear_len = __memp_get_clear_len;
 		dbmfp->set_clear_len = __memp_set_clear_len;
 		dbmfp->get_fileid = __memp_get_fileid;
@@ -314,6 +327,39 @@ __memp_set_flags(dbmfp, flags, onoff)
 	return (0);
 }
 
+/*
+ * __memp_get_dirty_gen --
+ *	Get the count of pages of the file marked dirty so far.
+ */
+static int
+__memp_get_dirty_gen(dbmfp, genp)
+	DB_MPOOLFILE *dbmfp;
+	u_int64_t *genp;
+{
+	MPF_ILLEGAL_BEFORE_OPEN(dbmfp, "DB_MPOOLFILE->get_dirty_gen");
+
+	*genp = ATOMIC_LOAD64(dbmfp->mfp->dirty_gen);
+	return (0);
+}
+
+/*
+ * __memp_get_stat --
+ *	Get the file's statistics and the count of its pages in the cache.
+ */
+static int
+__memp_get_stat(dbmfp, statp)
+	DB_MPOOLFILE *dbmfp;
+	DB_MPOOL_FSTAT *statp;
+{
+	MPF_ILLEGAL_BEFORE_OPEN(dbmfp, "DB_MPOOLFILE->get_stat");
+
+	/* unlocked, like the counters themselves */
+	*statp = dbmfp->mfp->stat;
+	statp->file_name = NULL;
+	statp->st_pages = dbmfp->mfp->block_cnt;
+	return (0);
+}
+
 /*
  * __memp_get_ftype --
  *	Get the file type (as registered).
@@ -705,6 +751,7 @@ __memp_fopen(dbmfp, mfp, path, flags, mode, pagesize)
 
 		goto err;
 	}
+	F_SET(dbmfp->fhp, DB_FH_PGCOMP);
 
 	/*
 	 * Open the recovery-page file handle if the user has enabled this
@@ -886,6 +933,7 @@ alloc:	/* Allocate and initialize a new MPOOLFILE. */
 		goto err;
 	memset(mfp, 0, sizeof(MPOOLFILE));
 	mfp->mpf_cnt = 1;
+	mfp->dirty_gen = ATOMIC_ADD64(mfp_dirty_gen_base, MFP_DIRTY_GEN_RANGE);
 	mfp->ftype = dbmfp->ftype;
 	mfp->stat.st_pagesize = pagesize;
 	mfp->lsn_off = dbmfp->lsn_offset;
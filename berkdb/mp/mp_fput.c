@@ -25,6 +25,7 @@ static const char revid[] = "$Id: mp_fput.c,v 11.48 2003/09/30 17:12:00 sue Exp
 #include "comdb2_atomic.h"
 
 extern int gbl_enable_cache_internal_nodes;
+extern int gbl_mpool_2q;
 
 static void __memp_reset_lru __P((DB_ENV *, REGINFO *));
 
@@ -152,6 +153,9 @@ __memp_fput_internal(dbmfp, pgaddr, flags, pgorder)
 	hp = R_ADDR(&dbmp->reginfo[n_cache], c_mp->htab);
 	hp = &hp[NBUCKET(c_mp, bhp->mf_offset, bhp->pgno)];
 
+	if (LF_ISSET(DB_MPOOL_DIRTY))
+		ATOMIC_ADD64(dbmfp->mfp->dirty_gen, 1);
+
 	MUTEX_LOCK(dbenv, &hp->hash_mutex);
 
 	/* Set/clear the page bits. */
@@ -229,6 +233,13 @@ __memp_fput_internal(dbmfp, pgaddr, flags, pgorder)
 		 */
 		bhp->priority = c_mp->lru_count;
 
+		/*
+		 * Probationary pages keep plain FIFO order and are evicted
+		 * ahead of re-referenced pages of the same age.
+		 */
+		if (F_ISSET(bhp, BH_PROBATION))
+			goto sort;
+
 		adjust = 0;
 		if (dbmfp->mfp->priority != 0)
 			adjust =
@@ -248,6 +259,9 @@ __memp_fput_internal(dbmfp, pgaddr, flags, pgorder)
 		    TYPE(pgaddr) == P_IBTREE)
 			adjust += c_mp->stat.st_pages / MPOOL_PRI_INTERNAL;
 
+		if (gbl_mpool_2q)
+			adjust += c_mp->stat.st_pages / MPOOL_PRI_HOT;
+
 		if (adjust > 0) {
 			if (UINT32_T_MAX - bhp->priority >= (u_int32_t)adjust)
 				bhp->priority += adjust;
@@ -257,6 +271,7 @@ __memp_fput_internal(dbmfp, pgaddr, flags, pgorder)
 		}
 	}
 
+sort:
 	/* 
 	 * If this is a no-increment buffer don't increment lru cache.  
 	 * This prevents transient buffers from pushing out others.
@@ -97,6 +97,9 @@ __memp_fset(dbmfp, pgaddr, flags)
 	hp = R_ADDR(&dbmp->reginfo[n_cache], c_mp->htab);
 	hp = &hp[NBUCKET(c_mp, bhp->mf_offset, bhp->pgno)];
 
+	if (LF_ISSET(DB_MPOOL_DIRTY))
+		ATOMIC_ADD64(dbmfp->mfp->dirty_gen, 1);
+
 	MUTEX_LOCK(dbenv, &hp->hash_mutex);
 
 	/* Set/clear the page bits. */
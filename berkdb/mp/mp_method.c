@@ -100,6 +100,8 @@ __memp_dbenv_create(dbenv)
 		dbenv->memp_dump_default = __memp_dump_default_pp;
 		dbenv->memp_load_default = __memp_load_default_pp;
 		dbenv->memp_trickle = __memp_trickle_pp;
+		dbenv->memp_fuzzy = __memp_fuzzy_pp;
+		dbenv->memp_sweep_sparse = __memp_sweep_sparse_pp;
 	}
 	dbenv->memp_fcreate = __memp_fcreate_pp;
 	(void)pthread_once(&init_pgcompact_once, __memp_init_pgcompact_routines);
@@ -17,13 +17,160 @@ static const char revid[] = "$Id: mp_region.c,v 11.55 2003/06/30 17:20:19 bostic
 #endif
 
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
 
 #include "db_int.h"
 #include "dbinc/db_shash.h"
 #include "dbinc/mp.h"
+#include "logmsg.h"
 
 
 static int __mpool_init __P((DB_ENV *, DB_MPOOL *, int, int));
+static int __memp_numa_init __P((void));
+static int __memp_numa_bind __P((REGINFO *, int));
+
+/*
+ * NUMA placement of the cache.  The cache is already made of mp_ncache
+ * regions, and NCACHE() always maps a page to the same region.  With
+ * gbl_mpool_numa, the region count is rounded up to a multiple of the
+ * number of NUMA nodes and region i is bound to node (i % nodes), so
+ * every page has a stable home node and __memp_alloc() allocates buffers
+ * from memory on that node.
+ */
+int gbl_mpool_numa = 0;
+
+static int numa_nnodes = 0;
+static int numa_ncpus = 0;
+static int *numa_cpu_node = NULL;
+
+#define	NUMA_MPOL_PREFERRED	1
+#define	NUMA_NODE_DIR		"/sys/devices/system/node"
+
+/* Parse a cpulist ("0-3,8,10-11") and map its cpus to node. */
+static void
+__memp_numa_cpulist(node, path)
+	int node;
+	const char *path;
+{
+	FILE *f;
+	int lo, hi, c;
+
+	if ((f = fopen(path, "r")) == NULL)
+		return;
+	while (fscanf(f, "%d", &lo) == 1) {
+		hi = lo;
+		c = fgetc(f);
+		if (c == '-') {
+			if (fscanf(f, "%d", &hi) != 1)
+				break;
+			c = fgetc(f);
+		}
+		for (; lo <= hi; lo++)
+			if (lo >= 0 && lo < numa_ncpus)
+				numa_cpu_node[lo] = node;
+		if (c != ',')
+			break;
+	}
+	fclose(f);
+}
+
+/* Returns the number of NUMA nodes, 0 if unknown. */
+static int
+__memp_numa_init()
+{
+	DIR *d;
+	struct dirent *de;
+	char path[256];
+	int node;
+
+	if (numa_nnodes)
+		return (numa_nnodes);
+
+	if ((numa_ncpus = (int)sysconf(_SC_NPROCESSORS_CONF)) <= 0)
+		return (0);
+	if ((numa_cpu_node = calloc(numa_ncpus, sizeof(int))) == NULL)
+		return (0);
+	if ((d = opendir(NUMA_NODE_DIR)) == NULL)
+		return (0);
+	while ((de = readdir(d)) != NULL) {
+		if (strncmp(de->d_name, "node", 4) != 0 ||
+		    sscanf(de->d_name + 4, "%d", &node) != 1)
+			continue;
+		snprintf(path, sizeof(path), "%s/%s/cpulist",
+		    NUMA_NODE_DIR, de->d_name);
+		__memp_numa_cpulist(node, path);
+		if (node + 1 > numa_nnodes)
+			numa_nnodes = node + 1;
+	}
+	closedir(d);
+	return (numa_nnodes);
+}
+
+/*
+ * Prefer node (i % nodes) for the memory backing cache region i.  Called
+ * before the region is initialized so untouched pages fault in on that
+ * node.  Returns the node, or -1.
+ */
+static int
+__memp_numa_bind(infop, i)
+	REGINFO *infop;
+	int i;
+{
+#if defined(__linux__) && defined(SYS_mbind)
+	unsigned long mask;
+	uintptr_t start, end;
+	long pagesz;
+	int node;
+
+	if (numa_nnodes < 2 || numa_nnodes > (int)(8 * sizeof(mask)))
+		return (-1);
+	node = i % numa_nnodes;
+	mask = 1UL << node;
+	pagesz = sysconf(_SC_PAGESIZE);
+	start = ((uintptr_t)infop->addr + pagesz - 1) & ~(pagesz - 1);
+	end = ((uintptr_t)infop->addr + infop->rp->size) & ~(pagesz - 1);
+	if (end <= start)
+		return (-1);
+	if (syscall(SYS_mbind, (void *)start, end - start,
+	    NUMA_MPOL_PREFERRED, &mask, 8 * sizeof(mask), 0) != 0) {
+		logmsg(LOGMSG_WARN,
+		    "mpool: can't bind cache %d to numa node %d: %s\n",
+		    i, node, strerror(errno));
+		return (-1);
+	}
+	return (node);
+#else
+	return (-1);
+#endif
+}
+
+/*
+ * __memp_numa_node --
+ *	Node of the cpu we are running on, or -1.
+ *
+ * PUBLIC: int __memp_numa_node __P((void));
+ */
+int
+__memp_numa_node()
+{
+#if defined(__linux__)
+	int cpu;
+
+	if (numa_cpu_node == NULL || (cpu = sched_getcpu()) < 0 ||
+	    cpu >= numa_ncpus)
+		return (-1);
+	return (numa_cpu_node[cpu]);
+#else
+	return (-1);
+#endif
+}
 #ifdef HAVE_MUTEX_SYSTEM_RESOURCES
 static size_t __mpool_region_maint __P((REGINFO *));
 #endif
@@ -44,9 +191,19 @@ __memp_open(dbenv)
 	size_t reg_size;
 	u_int32_t *regids;
 	u_int32_t i;
-	int htab_buckets, ret;
+	int htab_buckets, node, ret;
 	double x;
 
+	/* Give every NUMA node the same number of cache regions. */
+	if (gbl_mpool_numa && F_ISSET(dbenv, DB_ENV_CREATE) &&
+	    (i = __memp_numa_init()) > 1 && dbenv->mp_ncache % i != 0) {
+		logmsg(LOGMSG_INFO,
+		    "mpool: %u numa nodes, using %u caches instead of %u\n",
+		    i, dbenv->mp_ncache + i - dbenv->mp_ncache % i,
+		    dbenv->mp_ncache);
+		dbenv->mp_ncache += i - dbenv->mp_ncache % i;
+	}
+
 	/* Figure out how big each cache region is. */
 	x = ((double)dbenv->mp_gbytes) * GIGABYTE;
 	x += dbenv->mp_bytes;
@@ -107,8 +264,11 @@ __memp_open(dbenv)
 		dbmp->reginfo[0] = reginfo;
 
 		/* Initialize the first region. */
+		node = gbl_mpool_numa ?
+		    __memp_numa_bind(&dbmp->reginfo[0], 0) : -1;
 		if ((ret = __mpool_init(dbenv, dbmp, 0, htab_buckets)) != 0)
 			goto err;
+		((MPOOL *)dbmp->reginfo[0].primary)->numa_node = node;
 
 		/*
 		 * Create/initialize remaining regions and copy their IDs into
@@ -124,9 +284,12 @@ __memp_open(dbenv)
 			if ((ret = __db_r_attach(
 			    dbenv, &dbmp->reginfo[i], reg_size)) != 0)
 				goto err;
+			node = gbl_mpool_numa ?
+			    __memp_numa_bind(&dbmp->reginfo[i], i) : -1;
 			if ((ret =
 			    __mpool_init(dbenv, dbmp, i, htab_buckets)) != 0)
 				goto err;
+			((MPOOL *)dbmp->reginfo[i].primary)->numa_node = node;
 			R_UNLOCK(dbenv, &dbmp->reginfo[i]);
 
 			regids[i] = dbmp->reginfo[i].id;
@@ -236,6 +399,7 @@ __mpool_init(dbenv, dbmp, reginfo_off, htab_buckets)
 	reginfo->rp->primary = R_OFFSET(reginfo, reginfo->primary);
 	mp = reginfo->primary;
 	memset(mp, 0, sizeof(*mp));
+	mp->numa_node = -1;
 
 #ifdef	HAVE_MUTEX_SYSTEM_RESOURCES
 	maint_size = __mpool_region_maint(reginfo);
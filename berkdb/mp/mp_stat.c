@@ -170,6 +170,10 @@ __memp_stat(dbenv, gspp, fspp, flags)
 				    c_mp->stat.st_alloc_max_pages;
 			sp->st_ckp_pages_sync += c_mp->stat.st_ckp_pages_sync;
 			sp->st_ckp_pages_skip += c_mp->stat.st_ckp_pages_skip;
+			sp->st_numa_local_hit += c_mp->stat.st_numa_local_hit;
+			sp->st_numa_remote_hit +=
+			    c_mp->stat.st_numa_remote_hit;
+			sp->st_2q_promote += c_mp->stat.st_2q_promote;
 
 			if (LF_ISSET(DB_STAT_CLEAR)) {
 				dbmp->reginfo[i].rp->mutex.mutex_set_wait = 0;
@@ -269,6 +273,7 @@ __memp_stat(dbenv, gspp, fspp, flags)
 			nlen = strlen(name) + 1;
 			*tfsp = tstruct;
 			*tstruct = mfp->stat;
+			tstruct->st_pages = mfp->block_cnt;
 			if (LF_ISSET(DB_STAT_CLEAR)) {
 				pagesize = mfp->stat.st_pagesize;
 				memset(&mfp->stat, 0, sizeof(mfp->stat));
@@ -477,6 +482,7 @@ __memp_pbh(dbmp, bhp, fmap, fp)
 		{ BH_LOCKED,		"locked" },
 		{ BH_TRASH,		"trash" },
 		{ BH_NOINCR,		"low prio" },
+		{ BH_PROBATION,		"probation" },
 		{ BH_PREFAULT,		"prefault" },
 		{ 0,			NULL }
 	};
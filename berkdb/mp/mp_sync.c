@@ -27,10 +27,12 @@ static const char revid[] = "$Id: mp_sync.c,v 11.80 2003/09/13 19:20:41 bostic E
 #include <limits.h>
 
 #include "thdpool.h"
+#include "comdb2_pthread_create.h"
 #include <ctrace.h>
 #include <pool.h>
 #include <logmsg.h>
 #include <locks_wrap.h>
+#include <comdb2_atomic.h>
 
 typedef struct {
 	DB_MPOOL_HASH *track_hp;	/* Hash bucket. */
@@ -43,6 +45,7 @@ typedef struct {
 
 static int __bhcmp __P((const void *, const void *));
 static int __bhlru __P((const void *, const void *));
+static int __bhfuzzy __P((const void *, const void *));
 static int __memp_close_flush_files __P((DB_ENV *, DB_MPOOL *));
 static int __memp_sync_files __P((DB_ENV *, DB_MPOOL *));
 
@@ -230,6 +233,7 @@ mempsync_thd(void *p)
 	bdb_state = dbenv->app_private;
 	bdb_set_key(bdb_state);
 	bdb_thread_event(bdb_state, BDBTHR_EVENT_START_RDONLY);
+	comdb2_thread_set_affinity(COMDB2_THR_CLASS_BDB, NULL);
 
 	rep_check = IS_ENV_REPLICATED(dbenv);
 
@@ -609,7 +613,7 @@ trickle_do_work(struct thdpool *thdpool, void *work, void *thddata, int thd_op)
 			    mfp, &bhparray[off_gather], gathered, 1)) == 0)
 				wrote += gathered;
 			else if (op == DB_SYNC_CACHE || op == DB_SYNC_TRICKLE ||
-			    op == DB_SYNC_LRU)
+			    op == DB_SYNC_LRU || op == DB_SYNC_FUZZY)
 				__db_err(dbenv, "%s: unable to flush page: %lu",
 				     __memp_fns(dbmp, mfp), (u_long) bhp->pgno);
 			else
@@ -849,7 +853,7 @@ trickle_do_work(struct thdpool *thdpool, void *work, void *thddata, int thd_op)
 				    &bhparray[off_gather], gathered, 1)) == 0)
 				wrote += gathered;
 			else if (op == DB_SYNC_CACHE || op == DB_SYNC_TRICKLE
-			    || op == DB_SYNC_LRU)
+			    || op == DB_SYNC_LRU || op == DB_SYNC_FUZZY)
 				__db_err(dbenv, "%s: unable to flush page: %lu",
 				    __memp_fns(dbmp, mfp), (u_long) bhp->pgno);
 			else
@@ -981,7 +985,7 @@ trickle_do_work(struct thdpool *thdpool, void *work, void *thddata, int thd_op)
 		    mfp, &bhparray[off_gather], gathered, 1)) == 0)
 			wrote += gathered;
 		else if (op == DB_SYNC_CACHE || op == DB_SYNC_TRICKLE ||
-		    op == DB_SYNC_LRU)
+		    op == DB_SYNC_LRU || op == DB_SYNC_FUZZY)
 			__db_err(dbenv, "%s: unable to flush page: %lu",
 			    __memp_fns(dbmp, mfp), (u_long) bhp->pgno);
 		else
@@ -1023,6 +1027,7 @@ int gbl_load_cache_threads = 8;
 int gbl_load_cache_max_pages = 0;
 int gbl_dump_cache_max_pages = 0;
 int gbl_max_pages_per_cache_thread = 8192;
+int gbl_load_cache_report_secs = 10;
 
 void
 init_trickle_threads(void)
@@ -1033,6 +1038,7 @@ init_trickle_threads(void)
 	thdpool_set_maxthds(trickle_thdpool, 4);
 	thdpool_set_maxqueue(trickle_thdpool, 8000);
 	thdpool_set_longwaitms(trickle_thdpool, 30000);
+	thdpool_set_affinity_class(trickle_thdpool, COMDB2_THR_CLASS_BDB);
 	Pthread_mutex_init(&pgpool_lk, NULL);
 
 	pgpool =
@@ -1201,7 +1207,7 @@ __memp_sync_int(dbenv, dbmfp, trickle_max, op, wrotep, restartable,
 				 * there's another writing thread and flushing
 				 * the cache for this handle is meaningless.)
 				 */
-				if (op == DB_SYNC_FILE &&
+				if ((op == DB_SYNC_FILE || op == DB_SYNC_FUZZY) &&
 				    !F_ISSET(bhp, BH_DIRTY))
 					continue;
 
@@ -1328,6 +1334,8 @@ __memp_sync_int(dbenv, dbmfp, trickle_max, op, wrotep, restartable,
 	 */
 	if (op == DB_SYNC_LRU)
 		qsort(bharray, ar_cnt, sizeof(BH_TRACK), __bhlru);
+	else if (op == DB_SYNC_FUZZY)
+		qsort(bharray, ar_cnt, sizeof(BH_TRACK), __bhfuzzy);
 	else if (ar_cnt > 1)
 		qsort(bharray, ar_cnt, sizeof(BH_TRACK), __bhcmp);
 
@@ -1335,15 +1343,15 @@ __memp_sync_int(dbenv, dbmfp, trickle_max, op, wrotep, restartable,
 	 * If we're trickling buffers, only write enough to reach the correct
 	 * percentage.
 	 */
-	if ((op == DB_SYNC_TRICKLE || op == DB_SYNC_LRU)
-	    && ar_cnt > trickle_max)
+	if ((op == DB_SYNC_TRICKLE || op == DB_SYNC_LRU ||
+		op == DB_SYNC_FUZZY) && ar_cnt > trickle_max)
 		ar_cnt = trickle_max;
 
 	/*
-	 * Write the LRU pages in file/page order, only sorting as many
-	 * as ar_cnt.
+	 * Write the LRU and oldest-dirtied pages in file/page order, only
+	 * sorting as many as ar_cnt.
 	 */
-	if (op == DB_SYNC_LRU)
+	if (op == DB_SYNC_LRU || op == DB_SYNC_FUZZY)
 		qsort(bharray, ar_cnt, sizeof(BH_TRACK), __bhcmp);
 
 	/*
@@ -1378,7 +1386,7 @@ __memp_sync_int(dbenv, dbmfp, trickle_max, op, wrotep, restartable,
 	 */
 	if (do_parallel &&
 	    (op == DB_SYNC_TRICKLE || op == DB_SYNC_LRU ||
-		op == DB_SYNC_CACHE)) {
+		op == DB_SYNC_FUZZY || op == DB_SYNC_CACHE)) {
 
 		for (i = 1, j = 0; i < ar_cnt; ++i) {
 			if (bharray[j].track_off != bharray[i].track_off) {
@@ -1895,6 +1903,44 @@ typedef struct fileid_page_env
 
 void touch_page(DB_MPOOLFILE *mpf, db_pgno_t pgno);
 
+/* Progress of the current (or last) __memp_load. */
+static int memp_load_active = 0;
+static u_int64_t memp_load_queued = 0;
+static u_int64_t memp_load_done = 0;
+static u_int32_t memp_load_start = 0;
+
+/*
+ * __memp_load_progress --
+ *	Report whether a cache load is running and how far along it is.
+ *
+ * PUBLIC: int __memp_load_progress
+ * PUBLIC:	 __P((DB_ENV *, u_int64_t *, u_int64_t *, u_int32_t *));
+ */
+int
+__memp_load_progress(dbenv, queued, done, elapsed)
+	DB_ENV *dbenv;
+	u_int64_t *queued, *done;
+	u_int32_t *elapsed;
+{
+	COMPQUIET(dbenv, NULL);
+	if (queued)
+		*queued = ATOMIC_LOAD64(memp_load_queued);
+	if (done)
+		*done = ATOMIC_LOAD64(memp_load_done);
+	if (elapsed)
+		*elapsed = memp_load_start ? time(NULL) - memp_load_start : 0;
+	return (ATOMIC_LOAD32(memp_load_active));
+}
+
+static void
+memp_load_report(const char *what)
+{
+	logmsg(LOGMSG_INFO, "%s bufferpool: %"PRIu64" of %"PRIu64" pages "
+	    "in %u seconds\n", what, ATOMIC_LOAD64(memp_load_done),
+	    ATOMIC_LOAD64(memp_load_queued),
+	    (u_int32_t)(time(NULL) - memp_load_start));
+}
+
 static void
 load_fileids(struct thdpool *thdpool, void *work, void *thddata, int thd_op)
 {
@@ -1920,8 +1966,10 @@ load_fileids(struct thdpool *thdpool, void *work, void *thddata, int thd_op)
 	if (dbmfp) {
 		for(int pages = 0 ; pages < pagelist->cnt; pages++) {
 			touch_page(dbmfp, pagelist->pages[pages]);
+			ATOMIC_ADD64(memp_load_done, 1);
 		}
-	} 
+	} else
+		ATOMIC_ADD64(memp_load_done, pagelist->cnt);
 
 	Pthread_mutex_lock(fileid_env->lk);
 	(*fileid_env->active_threads)--;
@@ -2044,6 +2092,7 @@ static void
 load_fileids_thdpool(fileid_page_env_t *fileid_env)
 {
 	int ret;
+	ATOMIC_ADD64(memp_load_queued, fileid_env->pagelist->cnt);
 	Pthread_mutex_lock(fileid_env->lk);
 	(*fileid_env->active_threads)++;
 	if ((ret = thdpool_enqueue(loadcache_thdpool, load_fileids,
@@ -2086,6 +2135,7 @@ __memp_load(dbenv, s, pagecount, lines)
 	pthread_mutex_t lk = PTHREAD_MUTEX_INITIALIZER;
 	pthread_cond_t cd = PTHREAD_COND_INITIALIZER;
 	int active_threads = 0;
+	u_int32_t lastpr;
 	(*lines) = (*pagecount) = 0;
 
 
@@ -2100,7 +2150,11 @@ __memp_load(dbenv, s, pagecount, lines)
 		return -1;
 	}
 
-	start = time(NULL);
+	start = lastpr = time(NULL);
+	memp_load_start = start;
+	XCHANGE64(memp_load_queued, 0);
+	XCHANGE64(memp_load_done, 0);
+	XCHANGE32(memp_load_active, 1);
 	while ((!max_pages || (*pagecount) < max_pages) && (ret =
 				sbuf2fread(cfileid, sizeof(cfileid), 1, s)) == 1) {
 		lineno++;
@@ -2166,6 +2220,11 @@ __memp_load(dbenv, s, pagecount, lines)
 			if (fileid_env->pagelist->cnt >= gbl_max_pages_per_cache_thread) {
 				load_fileids_thdpool(fileid_env);
 				fileid_env = NULL;
+				if (time(NULL) - lastpr >= gbl_load_cache_report_secs &&
+				    gbl_load_cache_report_secs > 0) {
+					memp_load_report("Loading");
+					lastpr = time(NULL);
+				}
 			}
 
 			(*pagecount)++;
@@ -2187,11 +2246,27 @@ __memp_load(dbenv, s, pagecount, lines)
 done:
 	Pthread_mutex_lock(&lk);
 	while(active_threads > 0) {
-		Pthread_cond_wait(&cd, &lk);
+		struct timespec ts;
+		int secs = gbl_load_cache_report_secs > 0 ?
+		    gbl_load_cache_report_secs : 1;
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += secs;
+		Pthread_mutex_unlock(&lk);
+		if (gbl_load_cache_report_secs > 0 &&
+		    time(NULL) - lastpr >= gbl_load_cache_report_secs) {
+			memp_load_report("Loading");
+			lastpr = time(NULL);
+		}
+		Pthread_mutex_lock(&lk);
+		if (active_threads > 0)
+			pthread_cond_timedwait(&cd, &lk, &ts);
 	}
 	Pthread_mutex_unlock(&lk);
 	end = time(NULL);
+	XCHANGE32(memp_load_active, 0);
 
+	memp_load_report("Loaded");
 	logmsg(LOGMSG_DEBUG, "Loaded %"PRIu64" bufferpool pages in %u seconds\n",
 			*pagecount, (end - start));
 	(*lines) = lineno;
@@ -2482,3 +2557,27 @@ __bhlru(p1, p2)
 
 	return (0);
 }
+
+/*
+ * __bhfuzzy --
+ *	Oldest first-dirtied pages first: they are the ones holding the next
+ *	checkpoint LSN back.  Pages with no begin LSN go last.
+ */
+static int
+__bhfuzzy(p1, p2)
+	const void *p1, *p2;
+{
+	BH_TRACK *bhp1, *bhp2;
+	int z1, z2;
+
+	bhp1 = (BH_TRACK *)p1;
+	bhp2 = (BH_TRACK *)p2;
+
+	z1 = IS_ZERO_LSN(bhp1->track_tx_begin_lsn);
+	z2 = IS_ZERO_LSN(bhp2->track_tx_begin_lsn);
+	if (z1 != z2)
+		return (z1 ? 1 : -1);
+
+	return (log_compare(&bhp1->track_tx_begin_lsn,
+	    &bhp2->track_tx_begin_lsn));
+}
@@ -25,6 +25,7 @@ static const char revid[] = "$Id: mp_trickle.c,v 11.30 2003/09/13 19:20:41 bosti
 #include <time.h>
 
 static int __memp_trickle __P((DB_ENV *, int, int *, int));
+static int __memp_fuzzy __P((DB_ENV *, int, int, int *));
 
 /*
  * __memp_trickle_pp --
@@ -124,3 +125,82 @@ done:	memcpy(&mp->trickle_lsn, &last_lsn, sizeof(DB_LSN));
 
 	return (ret);
 }
+
+/*
+ * __memp_fuzzy_pp --
+ *	DB_ENV->memp_fuzzy pre/post processing.
+ *
+ * PUBLIC: int __memp_fuzzy_pp __P((DB_ENV *, int, int, int *));
+ */
+int
+__memp_fuzzy_pp(dbenv, poll_ms, left_ms, nwrotep)
+	DB_ENV *dbenv;
+	int poll_ms, left_ms, *nwrotep;
+{
+	int rep_check, ret;
+
+	PANIC_CHECK(dbenv);
+	ENV_REQUIRES_CONFIG(dbenv,
+	    dbenv->mp_handle, "memp_fuzzy", DB_INIT_MPOOL);
+
+	rep_check = IS_ENV_REPLICATED(dbenv) ? 1 : 0;
+	if (rep_check)
+		__env_rep_enter(dbenv);
+	ret = __memp_fuzzy(dbenv, poll_ms, left_ms, nwrotep);
+	if (rep_check)
+		__env_rep_exit(dbenv);
+	return (ret);
+}
+
+/*
+ * __memp_fuzzy --
+ *	DB_ENV->memp_fuzzy.
+ *
+ *	Called every poll_ms between checkpoints, with left_ms until the
+ *	next one is due.  Writes this poll's share of the dirty pages, oldest
+ *	first-dirtied first, so the checkpoint finds little left to flush.
+ */
+static int
+__memp_fuzzy(dbenv, poll_ms, left_ms, nwrotep)
+	DB_ENV *dbenv;
+	int poll_ms, left_ms, *nwrotep;
+{
+	DB_MPOOL *dbmp;
+	MPOOL *c_mp, *mp;
+	u_int32_t dirty, i, dtmp;
+	int n, ret, wrote;
+
+	dbmp = dbenv->mp_handle;
+	mp = dbmp->reginfo[0].primary;
+
+	if (nwrotep == NULL)
+		nwrotep = &wrote;
+	*nwrotep = 0;
+
+	if (poll_ms < 1)
+		return (EINVAL);
+	if (left_ms < poll_ms)
+		left_ms = poll_ms;
+
+	for (i = dirty = 0; i < mp->nreg; ++i) {
+		c_mp = dbmp->reginfo[i].primary;
+		__memp_stat_hash(&dbmp->reginfo[i], c_mp, &dtmp);
+		dirty += dtmp;
+	}
+
+	/* Round up so a handful of dirty pages still go out. */
+	n = (int)(((u_int64_t)dirty * poll_ms + left_ms - 1) / left_ms);
+	if (n <= 0)
+		return (0);
+
+	if (dbenv->iomap && dbenv->attr.iomap_enabled)
+		dbenv->iomap->memptrickle_active = time(NULL);
+	ret = __memp_sync_int(dbenv, NULL, n, DB_SYNC_FUZZY, nwrotep, 1,
+	    NULL, 0);
+	if (dbenv->iomap && dbenv->attr.iomap_enabled)
+		dbenv->iomap->memptrickle_active = 0;
+
+	mp->stat.st_page_trickle += *nwrotep;
+
+	return (ret);
+}
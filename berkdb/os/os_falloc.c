@@ -30,8 +30,9 @@ static const char revid[] = "$Id: os_falloc.c,v 11.32 2014/09/32 12:27:03 bostic
 
 /*
  * __os_fallocate --
- *	    Preallocate an open file, Linux style. Caller ensures fhp->fd is
- *      open. Returns 0 on success, __os_get_errno() on fail.
+ *	    Preallocate an open file, Linux style, if preallocate_on_writes
+ *      is on. Caller ensures fhp->fd is open. Returns 0 on success,
+ *      __os_get_errno() on fail.
  *
  * PUBLIC: int __os_fallocate __P((DB_ENV *, off_t, off_t, DB_FH *));
  */
@@ -40,6 +41,24 @@ __os_fallocate(dbenv, offset, len, fhp)
 	DB_ENV *dbenv;
 	off_t offset, len;
 	DB_FH *fhp;
+{
+	if (!dbenv->attr.preallocate_on_writes)
+		return (0);
+	return (__os_preallocate(dbenv, offset, len, fhp));
+}
+
+/*
+ * __os_preallocate --
+ *	    Preallocate an open file, Linux style, whatever
+ *      preallocate_on_writes says.
+ *
+ * PUBLIC: int __os_preallocate __P((DB_ENV *, off_t, off_t, DB_FH *));
+ */
+int
+__os_preallocate(dbenv, offset, len, fhp)
+	DB_ENV *dbenv;
+	off_t offset, len;
+	DB_FH *fhp;
 {
 	int ret = 0;
 
@@ -49,8 +68,7 @@ __os_fallocate(dbenv, offset, len, fhp)
 	 * for file size as before. Also we need to use syscall because
 	 * this can't be compiled on systems without falloc headers.
 	 */
-	if (dbenv->attr.preallocate_on_writes &&
-	    fhp != NULL &&
+	if (fhp != NULL &&
 	    syscall(SYS_fallocate, fhp->fd, FALLOC_FL_KEEP_SIZE,
 	    offset, len) == -1) {
 		ret = __os_get_errno();
@@ -60,3 +78,28 @@ __os_fallocate(dbenv, offset, len, fhp)
 
 	return (ret);
 }
+
+/*
+ * __os_punch_hole --
+ *	    Give a range of an open file back to the filesystem, keeping
+ *      the file size.  Returns 0 on success, __os_get_errno() on fail,
+ *      EOPNOTSUPP where holes can't be punched.
+ *
+ * PUBLIC: int __os_punch_hole __P((DB_ENV *, off_t, off_t, DB_FH *));
+ */
+int
+__os_punch_hole(dbenv, offset, len, fhp)
+	DB_ENV *dbenv;
+	off_t offset, len;
+	DB_FH *fhp;
+{
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+	if (syscall(SYS_fallocate, fhp->fd,
+	    FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, len) == -1)
+		return (__os_get_errno());
+	return (0);
+#else
+	COMPQUIET(dbenv, NULL);
+	return (EOPNOTSUPP);
+#endif
+}
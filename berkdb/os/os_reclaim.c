@@ -0,0 +1,282 @@
+/*-
+ * See the file LICENSE for redistribution information.
+ *
+ * Copyright (c) 1997-2003
+ *	Sleepycat Software.  All rights reserved.
+ */
+
+#include "db_config.h"
+
+#ifndef NO_SYSTEM_INCLUDES
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "db_int.h"
+#include "logmsg.h"
+#include "locks_wrap.h"
+
+/*
+ * Unlinking a very large file makes the filesystem give back all of its
+ * extents at once, which can hold up every other I/O on the disk for a long
+ * time, and the unlink of a removed database file runs as its transaction
+ * commits.  While file_reclaim_rate_mb is set, a file larger than one step
+ * is instead renamed into a .reclaim directory next to it, which takes no
+ * time, and a background thread truncates it that many MB a second before
+ * unlinking what is left.  A file being reclaimed when the process stops is
+ * picked up again by __os_reclaim_scan.
+ */
+int gbl_file_reclaim_rate_mb = 0;
+
+#define	RECLAIM_DIR	".reclaim"
+/* let anyone still holding the file open finish with it */
+#define	RECLAIM_GRACE	30
+
+struct reclaim_file {
+	char *path;
+	off_t size;
+	time_t queued;
+	struct reclaim_file *next;
+};
+
+static pthread_mutex_t reclaim_lk = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reclaim_cd = PTHREAD_COND_INITIALIZER;
+static struct reclaim_file *reclaim_head, *reclaim_tail;
+static int64_t reclaim_pending;
+static int reclaim_nfiles;
+static int reclaim_started;
+static unsigned reclaim_seq;
+
+static void
+reclaim_done(bytes)
+	off_t bytes;
+{
+	Pthread_mutex_lock(&reclaim_lk);
+	reclaim_pending -= bytes;
+	Pthread_mutex_unlock(&reclaim_lk);
+}
+
+static void
+reclaim_one(f)
+	struct reclaim_file *f;
+{
+	off_t size, step;
+	time_t wait;
+	int fd;
+
+	if ((wait = f->queued + RECLAIM_GRACE - time(NULL)) > 0)
+		sleep(wait);
+
+	size = f->size;
+	if ((fd = open(f->path, O_WRONLY)) != -1) {
+		while (size > 0) {
+			step = (off_t)gbl_file_reclaim_rate_mb << 20;
+			if (step <= 0 || step > size)
+				step = size;
+			if (ftruncate(fd, size - step) != 0) {
+				logmsg(LOGMSG_ERROR, "%s: ftruncate %s: %s\n",
+				    __func__, f->path, strerror(errno));
+				break;
+			}
+			size -= step;
+			reclaim_done(step);
+			if (size > 0)
+				poll(NULL, 0, 1000);
+		}
+		close(fd);
+	}
+	if (unlink(f->path) != 0 && errno != ENOENT)
+		logmsg(LOGMSG_ERROR, "%s: unlink %s: %s\n", __func__, f->path,
+		    strerror(errno));
+	reclaim_done(size);
+
+	Pthread_mutex_lock(&reclaim_lk);
+	reclaim_nfiles--;
+	Pthread_mutex_unlock(&reclaim_lk);
+	free(f->path);
+	free(f);
+}
+
+static void *
+reclaim_thd(arg)
+	void *arg;
+{
+	struct reclaim_file *f;
+
+	COMPQUIET(arg, NULL);
+	for (;;) {
+		Pthread_mutex_lock(&reclaim_lk);
+		while ((f = reclaim_head) == NULL)
+			Pthread_cond_wait(&reclaim_cd, &reclaim_lk);
+		if ((reclaim_head = f->next) == NULL)
+			reclaim_tail = NULL;
+		Pthread_mutex_unlock(&reclaim_lk);
+
+		reclaim_one(f);
+	}
+	return (NULL);
+}
+
+static int
+reclaim_enqueue(path, size)
+	const char *path;
+	off_t size;
+{
+	struct reclaim_file *f;
+	pthread_attr_t attr;
+	pthread_t tid;
+	int ret = 0;
+
+	if ((f = calloc(1, sizeof(*f))) == NULL ||
+	    (f->path = strdup(path)) == NULL) {
+		free(f);
+		return (ENOMEM);
+	}
+	f->size = size;
+	f->queued = time(NULL);
+
+	Pthread_mutex_lock(&reclaim_lk);
+	if (!reclaim_started) {
+		Pthread_attr_init(&attr);
+		Pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		if ((ret = pthread_create(&tid, &attr, reclaim_thd, NULL)) == 0)
+			reclaim_started = 1;
+		Pthread_attr_destroy(&attr);
+	}
+	if (ret == 0) {
+		if (reclaim_tail != NULL)
+			reclaim_tail->next = f;
+		else
+			reclaim_head = f;
+		reclaim_tail = f;
+		reclaim_pending += size;
+		reclaim_nfiles++;
+		Pthread_cond_signal(&reclaim_cd);
+	}
+	Pthread_mutex_unlock(&reclaim_lk);
+
+	if (ret != 0) {
+		free(f->path);
+		free(f);
+	}
+	return (ret);
+}
+
+/*
+ * __os_reclaim --
+ *	Hand a large file to the reclaimer instead of unlinking it.  Returns 0
+ *	if the file is gone from its path, nonzero if the caller should unlink
+ *	it itself.
+ *
+ * PUBLIC: int __os_reclaim __P((DB_ENV *, const char *));
+ */
+int
+__os_reclaim(dbenv, path)
+	DB_ENV *dbenv;
+	const char *path;
+{
+	char dir[PATH_MAX], trash[PATH_MAX];
+	const char *base, *slash;
+	struct stat st;
+	unsigned seq;
+
+	COMPQUIET(dbenv, NULL);
+
+	if (gbl_file_reclaim_rate_mb <= 0 || DB_GLOBAL(j_unlink) != NULL)
+		return (1);
+	if (stat(path, &st) != 0 || !S_ISREG(st.st_mode) ||
+	    st.st_size <= ((off_t)gbl_file_reclaim_rate_mb << 20))
+		return (1);
+
+	if ((slash = strrchr(path, '/')) != NULL) {
+		base = slash + 1;
+		if (snprintf(dir, sizeof(dir), "%.*s/%s", (int)(slash - path),
+		    path, RECLAIM_DIR) >= (int)sizeof(dir))
+			return (1);
+	} else {
+		base = path;
+		snprintf(dir, sizeof(dir), "%s", RECLAIM_DIR);
+	}
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+		return (1);
+
+	Pthread_mutex_lock(&reclaim_lk);
+	seq = ++reclaim_seq;
+	Pthread_mutex_unlock(&reclaim_lk);
+	if (snprintf(trash, sizeof(trash), "%s/%s.%ld.%u", dir, base,
+	    (long)time(NULL), seq) >= (int)sizeof(trash))
+		return (1);
+	if (rename(path, trash) != 0)
+		return (1);
+
+	if (reclaim_enqueue(trash, st.st_size) != 0)
+		/* we can't truncate it slowly, so do it now */
+		(void)unlink(trash);
+	return (0);
+}
+
+/*
+ * __os_reclaim_scan --
+ *	Queue whatever was left being reclaimed under dir.
+ *
+ * PUBLIC: void __os_reclaim_scan __P((const char *));
+ */
+void
+__os_reclaim_scan(dir)
+	const char *dir;
+{
+	char rdir[PATH_MAX], path[PATH_MAX];
+	struct dirent *ent;
+	struct stat st;
+	DIR *d;
+
+	if (snprintf(rdir, sizeof(rdir), "%s/%s", dir, RECLAIM_DIR) >=
+	    (int)sizeof(rdir) || (d = opendir(rdir)) == NULL)
+		return;
+	while ((ent = readdir(d)) != NULL) {
+		if (snprintf(path, sizeof(path), "%s/%s", rdir,
+		    ent->d_name) >= (int)sizeof(path) ||
+		    stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+			continue;
+		logmsg(LOGMSG_INFO, "%s: reclaiming %s, %lld bytes\n",
+		    __func__, path, (long long)st.st_size);
+		if (reclaim_enqueue(path, st.st_size) != 0)
+			(void)unlink(path);
+	}
+	closedir(d);
+}
+
+/*
+ * __berkdb_reclaim_report --
+ *	Print what the reclaimer has left to do.
+ *
+ * PUBLIC: void __berkdb_reclaim_report __P((void));
+ */
+void
+__berkdb_reclaim_report()
+{
+	int64_t pending;
+	int nfiles;
+
+	Pthread_mutex_lock(&reclaim_lk);
+	pending = reclaim_pending;
+	nfiles = reclaim_nfiles;
+	Pthread_mutex_unlock(&reclaim_lk);
+
+	logmsg(LOGMSG_USER, "file reclaim: %d files, %lld bytes pending, "
+	    "%d MB/s%s\n", nfiles, (long long)pending,
+	    gbl_file_reclaim_rate_mb,
+	    gbl_file_reclaim_rate_mb > 0 ? "" : " (off)");
+}
@@ -18,6 +18,7 @@ static const char revid[] = "$Id: os_region.c,v 11.17 2003/07/13 17:45:23 bostic
 #include <stdio.h>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <errno.h>
 #include <sys/types.h>
 #endif
 
@@ -27,6 +28,12 @@ static const char revid[] = "$Id: os_region.c,v 11.17 2003/07/13 17:45:23 bostic
 
 extern char gbl_dbname[MAX_DBNAME_LENGTH];
 extern int gbl_largepages;
+extern int gbl_region_hugepages;
+
+/* what the regions ended up backed by, for "stat regions" */
+static size_t region_hugetlb_bytes;
+static size_t region_thp_bytes;
+static size_t region_small_bytes;
 
 
 struct region {
@@ -90,6 +97,82 @@ __dbenv_regiontype(int type)
   will return the memory.
 */
 
+/*
+ * __os_r_anon_attach --
+ *	Map a region from anonymous memory, on explicit huge pages if the
+ *	system has them reserved, on transparent huge pages otherwise.
+ *	Returns non-zero if nothing could be mapped and the caller should
+ *	fall back to the heap.
+ */
+static int
+__os_r_anon_attach(dbenv, infop, rp)
+	DB_ENV *dbenv;
+	REGINFO *infop;
+	REGION *rp;
+{
+	size_t MB_2 = 2 * 1024 * 1024UL;
+	size_t size, less;
+	void *p;
+
+	size = rp->size;
+	if ((less = size % MB_2) != 0)
+		size += MB_2 - less;
+
+#ifdef MAP_HUGETLB
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (p != MAP_FAILED) {
+		rp->size = size;
+		infop->addr = p;
+		F_SET(infop, REGION_ANONMAP);
+		region_hugetlb_bytes += size;
+		logmsg(LOGMSG_INFO,
+		    "os_r_attach: %s region %u on huge pages (size: %zu)\n",
+		    __dbenv_regiontype(infop->type), infop->id, size);
+		return (0);
+	}
+#endif
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		logmsg(LOGMSG_WARN,
+		    "os_r_attach: can't map %s region %u (size: %zu): %s\n",
+		    __dbenv_regiontype(infop->type), infop->id, size,
+		    strerror(errno));
+		return (1);
+	}
+	rp->size = size;
+	infop->addr = p;
+	F_SET(infop, REGION_ANONMAP);
+#ifdef MADV_HUGEPAGE
+	if (madvise(p, size, MADV_HUGEPAGE) == 0) {
+		region_thp_bytes += size;
+		logmsg(LOGMSG_INFO,
+		    "os_r_attach: %s region %u on transparent huge pages "
+		    "(size: %zu)\n", __dbenv_regiontype(infop->type),
+		    infop->id, size);
+		return (0);
+	}
+#endif
+	region_small_bytes += size;
+	logmsg(LOGMSG_INFO,
+	    "os_r_attach: no huge pages for %s region %u (size: %zu)\n",
+	    __dbenv_regiontype(infop->type), infop->id, size);
+	return (0);
+}
+
+void
+berkdb_region_hugepage_stats(void)
+{
+	logmsg(LOGMSG_USER, "region_hugepages %d\n", gbl_region_hugepages);
+	logmsg(LOGMSG_USER, "  huge pages             %zu bytes\n",
+	    region_hugetlb_bytes);
+	logmsg(LOGMSG_USER, "  transparent huge pages %zu bytes\n",
+	    region_thp_bytes);
+	logmsg(LOGMSG_USER, "  regular pages          %zu bytes\n",
+	    region_small_bytes);
+}
+
 /*
  * __os_r_attach --
  *	Attach to a shared memory region.
@@ -115,7 +198,10 @@ __os_r_attach(dbenv, infop, rp)
 	   used to create the region. */
 	dbenv->set_use_sys_malloc(dbenv, 1);
 
-	if (!gbl_largepages || rp->size < MB_2) {
+	if (!gbl_largepages && gbl_region_hugepages && rp->size >= MB_2 &&
+	    __os_r_anon_attach(dbenv, infop, rp) == 0) {
+		ret = 0;
+	} else if (!gbl_largepages || rp->size < MB_2) {
         if (rp->size != 0)
             ret = __os_calloc(dbenv, 1, rp->size, &infop->addr);
         else {
@@ -176,7 +262,11 @@ __os_r_detach(dbenv, infop, destroy)
 
 	dbenv->set_use_sys_malloc(dbenv, 1);
 
-	if (infop->fd < 0 && infop->addr) {
+	if (F_ISSET(infop, REGION_ANONMAP)) {
+		munmap(infop->addr, rp->size);
+		infop->addr = NULL;
+		F_CLR(infop, REGION_ANONMAP);
+	} else if (infop->fd < 0 && infop->addr) {
 		__os_free(dbenv, infop->addr);
 	} else {
 		char name[MAXPATHLEN];
@@ -44,7 +44,9 @@ static const char revid[] = "$Id: os_rw.c,v 11.30 2003/05/23 21:19:05 bostic Exp
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <time.h>
+#include <sys/uio.h>
 #endif
 
 #include "db_int.h"
@@ -56,6 +58,8 @@ static const char revid[] = "$Id: os_rw.c,v 11.30 2003/05/23 21:19:05 bostic Exp
 #include <poll.h>
 #include "logmsg.h"
 #include "locks_wrap.h"
+#include "crc32c.h"
+#include "pgcomp.h"
 
 uint64_t bb_berkdb_fasttime(void);
 
@@ -68,8 +72,11 @@ static int __os_physwrite __P((DB_ENV *, DB_FH *, void *, size_t, size_t *));
    are always multiples of 512, which is true for all cases in berkeley */
 
 static pthread_key_t iobufkey;
+static pthread_key_t pgcompkey;
 static pthread_once_t once = PTHREAD_ONCE_INIT;
 int gbl_verify_direct_io = 0;
+int gbl_page_compress = 0;
+static int pgcomp_nopunch = 0;
 
 void fsnapf(FILE *, void *, size_t);
 
@@ -95,6 +102,7 @@ static inline void
 init_iobuf(void)
 {
 	Pthread_key_create(&iobufkey, free_iobuf);
+	Pthread_key_create(&pgcompkey, free_iobuf);
 }
 
 static void *
@@ -102,6 +110,10 @@ get_aligned_buffer(void *buf, size_t bufsz, int copy)
 {
 	struct iobuf *b;
 
+	/* a caller's buffer that O_DIRECT can take as it is needs no copy */
+	if (buf != NULL && ((uintptr_t)buf & 511) == 0 && (bufsz & 511) == 0)
+		return buf;
+
 	b = pthread_getspecific(iobufkey);
 	if (b == NULL) {
 		b = malloc(sizeof(struct iobuf));
@@ -193,6 +205,136 @@ again:
 	return rc;
 }
 
+/*
+ * The buffer a page is compressed into, or inflated through.  It is kept
+ * apart from the O_DIRECT bounce buffer, and block aligned, so a compressed
+ * page goes to __berkdb_pwrite without another copy.
+ */
+static u_int8_t *
+get_pgcomp_buffer(size_t bufsz)
+{
+	struct iobuf *b;
+
+	pthread_once(&once, init_iobuf);
+	b = pthread_getspecific(pgcompkey);
+	if (b != NULL && b->sz >= bufsz)
+		return b->buf;
+	if (b == NULL) {
+		if ((b = calloc(1, sizeof(struct iobuf))) == NULL)
+			return NULL;
+		Pthread_setspecific(pgcompkey, b);
+	}
+	free(b->buf);
+	b->buf = NULL;
+	b->sz = 0;
+	if (posix_memalign(&b->buf, PGCOMP_BLOCK, bufsz))
+		return NULL;
+	b->sz = bufsz;
+	return b->buf;
+}
+
+/*
+ * pgcomp_write --
+ *	Write a page compressed, if that saves a filesystem block: the
+ *	compressed image goes at the start of the page's slot and the rest of
+ *	the slot is punched out.  Returns 0 if the page was written, nonzero
+ *	if the caller should write it as it is.
+ *
+ *	Page 0 is the metadata page, which gets read without the mpool while
+ *	the file is being opened, and is never compressed.
+ */
+static int
+pgcomp_write(dbenv, fhp, pgno, pagesize, buf, niop)
+	DB_ENV *dbenv;
+	DB_FH *fhp;
+	db_pgno_t pgno;
+	size_t pagesize, *niop;
+	u_int8_t *buf;
+{
+	struct pgcomp_hdr *h;
+	struct stat st;
+	u_int8_t *cbuf;
+	off_t off;
+	size_t len;
+	int clen;
+
+	if (pgno == 0 || pgcomp_nopunch || pagesize < 2 * PGCOMP_BLOCK)
+		return (1);
+
+	/*
+	 * A page that grows the file is written whole, so the file never
+	 * ends in the middle of a page.
+	 */
+	off = (off_t)pgno * pagesize;
+	if (off + (off_t)pagesize > fhp->pgcomp_eof) {
+		if (fstat(fhp->fd, &st) != 0)
+			return (1);
+		fhp->pgcomp_eof = st.st_size;
+		if (off + (off_t)pagesize > st.st_size)
+			return (1);
+	}
+
+	if ((cbuf = get_pgcomp_buffer(pagesize)) == NULL)
+		return (1);
+	clen = LZ4_compress_default((const char *)buf,
+	    (char *)cbuf + PGCOMP_HDRSZ, (int)pagesize,
+	    (int)(pagesize - PGCOMP_HDRSZ - PGCOMP_BLOCK));
+	if (clen <= 0)
+		return (1);
+	len = (PGCOMP_HDRSZ + clen + PGCOMP_BLOCK - 1) & ~(PGCOMP_BLOCK - 1);
+
+	h = (struct pgcomp_hdr *)cbuf;
+	memset(h, 0, PGCOMP_HDRSZ);
+	memcpy(h->lsn, buf, sizeof(h->lsn) + sizeof(h->pgno));
+	h->type = buf[offsetof(struct pgcomp_hdr, type)];
+	h->magic = htonl(PGCOMP_MAGIC);
+	h->clen = htonl(clen);
+	h->crc = htonl(crc32c(cbuf + PGCOMP_HDRSZ, clen));
+	memset(cbuf + PGCOMP_HDRSZ + clen, 0, len - PGCOMP_HDRSZ - clen);
+
+	if (__berkdb_pwrite(dbenv, fhp->fd, cbuf, len, off,
+	    F_ISSET(fhp, DB_FH_DIRECT)) != (int)len)
+		return (1);
+
+	/*
+	 * Whatever is left in the tail is ignored on the way back in, so the
+	 * page is good even if the punch fails; but then compressing it saves
+	 * nothing, and we stop.
+	 */
+	if (__os_punch_hole(dbenv, off + len, pagesize - len, fhp) ==
+	    EOPNOTSUPP) {
+		logmsg(LOGMSG_WARN, "%s: %s can't punch holes, "
+		    "page_compress has no effect\n", __func__,
+		    fhp->name ? fhp->name : "file");
+		pgcomp_nopunch = 1;
+	}
+
+	*niop = pagesize;
+	return (0);
+}
+
+/*
+ * pgcomp_read --
+ *	Turn a page read in compressed back into the page.  A damaged
+ *	compressed page is left as it is, for the page checksum to catch.
+ */
+static void
+pgcomp_read(fhp, pgno, pagesize, buf)
+	DB_FH *fhp;
+	db_pgno_t pgno;
+	size_t pagesize;
+	u_int8_t *buf;
+{
+	u_int8_t *scratch;
+
+	if (!pgcomp_is_compressed(buf))
+		return;
+	if ((scratch = get_pgcomp_buffer(pagesize)) == NULL ||
+	    pgcomp_inflate(buf, pagesize, scratch) != 0)
+		logmsg(LOGMSG_ERROR, "%s: %s page %u: bad compressed page\n",
+		    __func__, fhp->name ? fhp->name : "file", pgno);
+}
+
 /*
  * __os_io_partial --
  *	Do a partial page io.  This is used to test recovery page logging.
@@ -492,6 +634,9 @@ __os_io(dbenv, op, fhp, pgno, pagesize, buf, niop)
 		if (__os_fs_notzero())
 			goto slow;
 #endif
+		if (gbl_page_compress && F_ISSET(fhp, DB_FH_PGCOMP) &&
+		    pgcomp_write(dbenv, fhp, pgno, pagesize, buf, niop) == 0)
+			goto written;
 
 		if (__berkdb_write_alarm_ms) {
 			uint64_t x1, x2;
@@ -530,6 +675,7 @@ __os_io(dbenv, op, fhp, pgno, pagesize, buf, niop)
 					F_ISSET(fhp, DB_FH_DIRECT));
 		}
 
+written:
 		if (__berkdb_num_write_ios)
 			(*__berkdb_num_write_ios)++;
 		if (write_callback)
@@ -537,8 +683,11 @@ __os_io(dbenv, op, fhp, pgno, pagesize, buf, niop)
 
 		break;
 	}
-	if (*niop == (size_t) pagesize)
+	if (*niop == (size_t) pagesize) {
+		if (op == DB_IO_READ && F_ISSET(fhp, DB_FH_PGCOMP))
+			pgcomp_read(fhp, pgno, pagesize, buf);
 		return (0);
+	}
 	logmsg(LOGMSG_DEBUG, "%s: failed %s io: expected %zd got %zd\n", __func__, op == DB_IO_READ ? "read" : "write", pagesize, *niop);
     // try to do a seek + read/write
 slow:
@@ -559,6 +708,10 @@ slow:
 
 err:	MUTEX_THREAD_UNLOCK(dbenv, fhp->mutexp);
 
+	if (ret == 0 && op == DB_IO_READ && *niop == pagesize &&
+	    F_ISSET(fhp, DB_FH_PGCOMP))
+		pgcomp_read(fhp, pgno, pagesize, buf);
+
 	return (ret);
 
 }
@@ -813,6 +966,126 @@ __berkdb_direct_pwritev(DB_ENV *dbenv,
 }
 #endif
 
+extern int gbl_berkdb_io_uring;
+
+/*
+ * __os_iov_uring --
+ *	Issue an __os_iov request as one io_uring batch: direct io files
+ *	submit every sgio_max chunk of the aligned copy at once, buffered
+ *	files every run of pages straight from the page buffers.  Returns
+ *	non-zero to make the caller fall back to the synchronous path.
+ */
+static int
+__os_iov_uring(dbenv, op, fhp, pgno, pagesize, bufs, nobufs, niop)
+	DB_ENV *dbenv;
+	int op;
+	DB_FH *fhp;
+	db_pgno_t pgno;
+	size_t pagesize, nobufs, *niop;
+	u_int8_t **bufs;
+{
+	OS_URING_REQ *reqs;
+	struct iovec *iov;
+	u_int8_t *abuf;
+	size_t chunk, i, nreqs, npg;
+	uint64_t x1 = 0, x2;
+	int direct, ret;
+
+	direct = F_ISSET(fhp, DB_FH_DIRECT) ? 1 : 0;
+	if ((chunk = dbenv->attr.sgio_max / pagesize) == 0)
+		chunk = 1;
+	if (!direct && chunk > IOV_MAX)
+		chunk = IOV_MAX;
+	nreqs = (nobufs + chunk - 1) / chunk;
+
+	abuf = NULL;
+	if (direct) {
+		pthread_once(&once, init_iobuf);
+		if ((abuf = get_aligned_buffer(NULL, nobufs * pagesize, 0)) ==
+		    NULL)
+			return (ENOMEM);
+		if (op == DB_IO_WRITE)
+			for (i = 0; i < nobufs; i++)
+				memcpy(abuf + i * pagesize, bufs[i], pagesize);
+	}
+
+	if ((ret = __os_malloc(dbenv, nreqs * sizeof(OS_URING_REQ) +
+	    (direct ? nreqs : nobufs) * sizeof(struct iovec), &reqs)) != 0)
+		return (ret);
+	iov = (struct iovec *)&reqs[nreqs];
+
+	for (i = 0; i < nreqs; i++) {
+		npg = nobufs - i * chunk < chunk ? nobufs - i * chunk : chunk;
+		reqs[i].off = (off_t)(pgno + i * chunk) * pagesize;
+		reqs[i].len = npg * pagesize;
+		if (direct) {
+			reqs[i].iov = &iov[i];
+			reqs[i].iovcnt = 1;
+			iov[i].iov_base = abuf + i * chunk * pagesize;
+			iov[i].iov_len = reqs[i].len;
+		} else {
+			size_t j;
+
+			reqs[i].iov = &iov[i * chunk];
+			reqs[i].iovcnt = (int)npg;
+			for (j = 0; j < npg; j++) {
+				iov[i * chunk + j].iov_base = bufs[i * chunk + j];
+				iov[i * chunk + j].iov_len = pagesize;
+			}
+		}
+	}
+
+	if (__berkdb_write_alarm_ms || __berkdb_read_alarm_ms)
+		x1 = bb_berkdb_fasttime();
+
+	ret = __os_uring_rw(dbenv, op, fhp->fd, reqs, (int)nreqs);
+	__os_free(dbenv, reqs);
+	if (ret != 0)
+		return (ret);
+
+	if (direct && op == DB_IO_READ)
+		for (i = 0; i < nobufs; i++)
+			memcpy(bufs[i], abuf + i * pagesize, pagesize);
+	*niop = nobufs * pagesize;
+
+	if (op == DB_IO_READ) {
+		if (__berkdb_num_read_ios)
+			(*__berkdb_num_read_ios) += nreqs;
+		if (__berkdb_read_alarm_ms) {
+			x2 = bb_berkdb_fasttime();
+			if ((x2 - x1) > M2U(__berkdb_read_alarm_ms) &&
+			    __berkdb_trace_func) {
+				char s[80];
+
+				snprintf(s, sizeof(s),
+				    "LONG URING READ (%d) %d ms fd %d\n",
+				    (int)(*niop), U2M(x2 - x1), fhp->fd);
+				__berkdb_trace_func(s);
+			}
+		}
+		if (read_callback)
+			read_callback(*niop);
+	} else {
+		if (__berkdb_num_write_ios)
+			(*__berkdb_num_write_ios) += nreqs;
+		if (__berkdb_write_alarm_ms) {
+			x2 = bb_berkdb_fasttime();
+			if ((x2 - x1) > M2U(__berkdb_write_alarm_ms) &&
+			    __berkdb_trace_func) {
+				char s[80];
+
+				snprintf(s, sizeof(s),
+				    "LONG URING WRITE (%d) %d ms fd %d\n",
+				    (int)(*niop), U2M(x2 - x1), fhp->fd);
+				__berkdb_trace_func(s);
+			}
+		}
+		if (write_callback)
+			write_callback(*niop);
+	}
+	return (0);
+}
+
 /*
  * __os_iov --
  *      Write a vector of data. Useful for skipping mpool buffer headers.
@@ -855,10 +1128,14 @@ __os_iov(dbenv, op, fhp, pgno, pagesize, bufs, nobufs, niop)
 		}
 	}
 
-	if (!F_ISSET(fhp, DB_FH_DIRECT))
-		goto slow;
 	if (nobufs == 1)
 		goto slow;
+	/* pages are compressed one at a time */
+	if (gbl_page_compress && F_ISSET(fhp, DB_FH_PGCOMP))
+		goto slow;
+	if (!F_ISSET(fhp, DB_FH_DIRECT) && (gbl_berkdb_io_uring <= 0 ||
+	    DB_GLOBAL(j_read) != NULL || DB_GLOBAL(j_write) != NULL))
+		goto slow;
 
 	if (op == DB_IO_WRITE && dbenv->attr.check_zero_lsn_writes
 	    && (dbenv->open_flags & DB_INIT_TXN)) {
@@ -892,6 +1169,16 @@ __os_iov(dbenv, op, fhp, pgno, pagesize, bufs, nobufs, niop)
 	DB_ASSERT(F_ISSET(fhp, DB_FH_OPENED) &&
 	    fhp->fd != -1 && DB_GLOBAL(j_read) != NULL);
 
+	if (gbl_berkdb_io_uring > 0) {
+		if (op == DB_IO_WRITE)
+			__checkpoint_verify(dbenv);
+		if (__os_iov_uring(dbenv,
+		    op, fhp, pgno, pagesize, bufs, nobufs, niop) == 0)
+			return (0);
+		if (!F_ISSET(fhp, DB_FH_DIRECT))
+			goto slow;
+	}
+
 	uint64_t x1 = 0, x2;
 
 	max_bufs = nobufs;
@@ -1049,6 +1336,7 @@ __os_truncate(dbenv, fhp, offset)
 	DB_ASSERT(F_ISSET(fhp, DB_FH_OPENED) && fhp->fd != -1);
 	MUTEX_THREAD_LOCK(dbenv, fhp->mutexp);
 	rc = ftruncate(fhp->fd, offset);
+	fhp->pgcomp_eof = 0;
 	MUTEX_THREAD_UNLOCK(dbenv, fhp->mutexp);
 	if (rc == -1) {
 		logmsg(LOGMSG_ERROR, "ftruncate(%u) %d %s\n",
@@ -79,6 +79,12 @@ ___os_unlink(dbenv, path)
 	if (!tmp_file)
 		__checkpoint_verify(dbenv);
 
+	/* A big file can go to the reclaimer, which frees it a step at a time */
+	if (!tmp_file && __os_reclaim(dbenv, path) == 0) {
+		ret = 0;
+		goto done;
+	}
+
 	retries = 0;
 retry:	ret = DB_GLOBAL(j_unlink) != NULL ? DB_GLOBAL(j_unlink) (path) :
 #ifdef HAVE_VXWORKS
@@ -118,7 +124,7 @@ retry:	ret = DB_GLOBAL(j_unlink) != NULL ? DB_GLOBAL(j_unlink) (path) :
 	}
 
 	/* verify after */
-	if (!tmp_file)
+done:	if (!tmp_file)
 		__checkpoint_verify(dbenv);
 
 	return (ret);
@@ -0,0 +1,262 @@
+/*-
+ * See the file LICENSE for redistribution information.
+ *
+ * Copyright (c) 1997-2003
+ *	Sleepycat Software.  All rights reserved.
+ */
+
+#include "db_config.h"
+
+#ifndef NO_SYSTEM_INCLUDES
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif /* NO_SYSTEM_INCLUDES */
+
+/*
+ * Use the raw system calls so that we don't depend on liburing; the
+ * syscall numbers are only defined by kernel headers that also ship
+ * linux/io_uring.h.
+ */
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+#define	HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+#include "db_int.h"
+#include "logmsg.h"
+#include "locks_wrap.h"
+
+/*
+ * Submission queue depth of the per-thread ring used by __os_iov.  Zero
+ * (the default) keeps the synchronous pread/pwrite paths.
+ */
+int gbl_berkdb_io_uring = 0;
+
+#ifdef HAVE_IO_URING
+struct os_uring {
+	int fd;
+	unsigned entries;
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_ptr, *cq_ptr;
+	size_t sq_sz, cq_sz, sqes_sz;
+};
+
+static pthread_key_t uring_key;
+static pthread_once_t uring_once = PTHREAD_ONCE_INIT;
+static int uring_disabled = 0;
+
+static void
+uring_free(void *p)
+{
+	struct os_uring *r = p;
+
+	if (r->sqes != NULL && r->sqes != MAP_FAILED)
+		munmap(r->sqes, r->sqes_sz);
+	if (r->cq_ptr != NULL && r->cq_ptr != MAP_FAILED &&
+	    r->cq_ptr != r->sq_ptr)
+		munmap(r->cq_ptr, r->cq_sz);
+	if (r->sq_ptr != NULL && r->sq_ptr != MAP_FAILED)
+		munmap(r->sq_ptr, r->sq_sz);
+	if (r->fd >= 0)
+		close(r->fd);
+	free(r);
+}
+
+static void
+uring_key_init(void)
+{
+	Pthread_key_create(&uring_key, uring_free);
+}
+
+static struct os_uring *
+uring_get(void)
+{
+	struct io_uring_params p;
+	struct os_uring *r;
+	char *sq, *cq;
+
+	pthread_once(&uring_once, uring_key_init);
+	if ((r = pthread_getspecific(uring_key)) != NULL)
+		return (r);
+	if (uring_disabled)
+		return (NULL);
+
+	if ((r = calloc(1, sizeof(*r))) == NULL)
+		return (NULL);
+	memset(&p, 0, sizeof(p));
+	if ((r->fd = (int)syscall(__NR_io_uring_setup,
+	    (unsigned)gbl_berkdb_io_uring, &p)) < 0) {
+		logmsg(LOGMSG_WARN, "%s: io_uring_setup failed: %s, "
+		    "using synchronous io\n", __func__, strerror(errno));
+		uring_disabled = 1;
+		free(r);
+		return (NULL);
+	}
+
+	r->entries = p.sq_entries;
+	r->sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	r->cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (r->cq_sz > r->sq_sz)
+			r->sq_sz = r->cq_sz;
+		r->cq_sz = r->sq_sz;
+	}
+	r->sq_ptr = mmap(NULL, r->sq_sz, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if (r->sq_ptr == MAP_FAILED)
+		goto err;
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		r->cq_ptr = r->sq_ptr;
+	else if ((r->cq_ptr = mmap(NULL, r->cq_sz, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING)) ==
+	    MAP_FAILED)
+		goto err;
+	r->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	if ((r->sqes = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES)) == MAP_FAILED)
+		goto err;
+
+	sq = r->sq_ptr;
+	cq = r->cq_ptr;
+	r->sq_head = (unsigned *)(sq + p.sq_off.head);
+	r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	r->sq_array = (unsigned *)(sq + p.sq_off.array);
+	r->cq_head = (unsigned *)(cq + p.cq_off.head);
+	r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	Pthread_setspecific(uring_key, r);
+	return (r);
+
+err:	logmsg(LOGMSG_WARN, "%s: io_uring mmap failed: %s, "
+	    "using synchronous io\n", __func__, strerror(errno));
+	uring_disabled = 1;
+	uring_free(r);
+	return (NULL);
+}
+#endif
+
+/*
+ * __os_uring_rw --
+ *	Submit a batch of vectored reads or writes against one file and
+ *	wait for all of them.  Each request's result (bytes or -errno) is
+ *	left in its res field.  Returns 0 if every request transferred its
+ *	full length, EIO if any came up short, and ENOTSUP if io_uring isn't
+ *	configured or available; callers then use the synchronous path.
+ *
+ * PUBLIC: int __os_uring_rw __P((DB_ENV *, int, int, OS_URING_REQ *, int));
+ */
+int
+__os_uring_rw(dbenv, op, fd, reqs, nreqs)
+	DB_ENV *dbenv;
+	int op, fd;
+	OS_URING_REQ *reqs;
+	int nreqs;
+{
+#ifdef HAVE_IO_URING
+	struct os_uring *r;
+	struct io_uring_sqe *sqe;
+	struct io_uring_cqe *cqe;
+	unsigned head, tail, idx;
+	long sub;
+	int i, next, inflight, pending, n, ret;
+
+	if (gbl_berkdb_io_uring <= 0 || (r = uring_get()) == NULL)
+		return (ENOTSUP);
+
+	ret = 0;
+	for (next = 0, inflight = 0, pending = 0;
+	    next < nreqs || inflight > 0;) {
+		/* Fill the submission queue. */
+		tail = *r->sq_tail;
+		for (n = 0; next < nreqs && inflight + n < (int)r->entries;
+		    ++n, ++next) {
+			idx = tail & *r->sq_mask;
+			sqe = &r->sqes[idx];
+			memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = op == DB_IO_WRITE ?
+			    IORING_OP_WRITEV : IORING_OP_READV;
+			sqe->fd = fd;
+			sqe->addr = (unsigned long)reqs[next].iov;
+			sqe->len = reqs[next].iovcnt;
+			sqe->off = reqs[next].off;
+			sqe->user_data = next;
+			r->sq_array[idx] = idx;
+			reqs[next].res = 0;
+			++tail;
+		}
+		__atomic_store_n(r->sq_tail, tail, __ATOMIC_RELEASE);
+		inflight += n;
+		pending += n;
+
+		/*
+		 * The kernel may take fewer entries than we offer; the rest
+		 * stay on the ring and are offered again on the next pass.
+		 * It only waits for a completion if it took all of them.
+		 */
+		if ((sub = syscall(__NR_io_uring_enter, r->fd,
+		    (unsigned)pending, 1U, IORING_ENTER_GETEVENTS,
+		    NULL, 0)) >= 0) {
+			pending -= (int)sub;
+			if (pending > 0 && sub == 0)
+				__os_yield(dbenv, 1);
+		} else if (errno == EINTR || errno == EAGAIN ||
+		    errno == EBUSY) {
+			/*
+			 * Nothing was taken.  Reap what has completed to make
+			 * room on the completion ring, then offer them again.
+			 */
+			__os_yield(dbenv, 1);
+		} else {
+			/*
+			 * The ring is unusable.  Closing it makes the kernel
+			 * cancel or finish whatever is in flight.
+			 */
+			ret = __os_get_errno();
+			logmsg(LOGMSG_ERROR, "%s: io_uring_enter failed: %s, "
+			    "disabling io_uring\n", __func__, strerror(ret));
+			uring_disabled = 1;
+			Pthread_setspecific(uring_key, NULL);
+			uring_free(r);
+			return (ret);
+		}
+
+		/* Reap whatever has completed. */
+		head = *r->cq_head;
+		while (head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+			cqe = &r->cqes[head & *r->cq_mask];
+			i = (int)cqe->user_data;
+			reqs[i].res = cqe->res;
+			if (cqe->res < 0 || (size_t)cqe->res != reqs[i].len)
+				ret = EIO;
+			++head;
+			--inflight;
+		}
+		__atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+	}
+	return (ret);
+#else
+	COMPQUIET(dbenv, NULL);
+	COMPQUIET(op, 0);
+	COMPQUIET(fd, 0);
+	COMPQUIET(reqs, NULL);
+	COMPQUIET(nreqs, 0);
+	return (ENOTSUP);
+#endif
+}
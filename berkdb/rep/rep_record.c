@@ -132,7 +132,7 @@ extern void allow_sc_to_run(void);
 
 int64_t gbl_rep_trans_parallel = 0, gbl_rep_trans_serial =
 	0, gbl_rep_trans_deadlocked = 0, gbl_rep_trans_inline =
-	0, gbl_rep_rowlocks_multifile = 0;
+	0, gbl_rep_rowlocks_multifile = 0, gbl_rep_trans_page_queues = 0;
 
 static inline int wait_for_running_transactions(DB_ENV *dbenv);
 
@@ -1374,7 +1374,7 @@ skip:				/*
 		/* A confused replicant can send a request
 		 * for an invalid log record, and cause the master
 		 * to panic.  Don't let that happen. */
-		F_SET(logc, DB_LOG_NO_PANIC);
+		F_SET(logc, DB_LOG_NO_PANIC | DB_LOG_REP_FILL);
 		memset(&data_dbt, 0, sizeof(data_dbt));
 		oldfilelsn = lsn = rp->lsn;
 
@@ -1624,7 +1624,7 @@ more:
 		fromline = __LINE__;
 		if ((ret = __log_cursor(dbenv, &logc)) != 0)
 			goto errlock;
-		F_SET(logc, DB_LOG_NO_PANIC);
+		F_SET(logc, DB_LOG_NO_PANIC | DB_LOG_REP_FILL);
 		memset(&data_dbt, 0, sizeof(data_dbt));
 		ret = __log_c_get(logc, &rp->lsn, &data_dbt, DB_SET);
 		int resp_rc;
@@ -3982,6 +3982,167 @@ logical_record_file_affinity(int rectype)
 
 int gbl_processor_thd_poll;
 
+extern int bdb_get_pglogs_key_list(int i, void *list, db_pgno_t *pgno,
+	unsigned char **fileid, DB_LSN *lsn);
+
+struct rep_pgent {
+	unsigned char *fileid;
+	db_pgno_t pgno;
+	int rec;
+};
+
+static int
+rep_pgent_cmp(const void *a, const void *b)
+{
+	const struct rep_pgent *pa = a, *pb = b;
+	int cmp;
+
+	if ((cmp = memcmp(pa->fileid, pb->fileid, DB_FILE_ID_LEN)) != 0)
+		return (cmp);
+	if (pa->pgno != pb->pgno)
+		return (pa->pgno < pb->pgno ? -1 : 1);
+	return (0);
+}
+
+static inline int
+rep_uf_find(int *parent, int i)
+{
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return (i);
+}
+
+static inline void
+rep_uf_union(int *parent, int a, int b)
+{
+	a = rep_uf_find(parent, a);
+	b = rep_uf_find(parent, b);
+	if (a != b)
+		parent[a < b ? b : a] = a < b ? a : b;
+}
+
+/*
+ * Assign the records of a transaction to apply queues using the page lsn
+ * list collected from its commit record.  Records that share a page land on
+ * the same queue and are applied in lsn order; records with disjoint page
+ * sets can be applied concurrently even within one file.  A record missing
+ * from the page list could touch any page of its file, so all records of
+ * that file are kept together.  Records without a file stay on queue 0 as
+ * they do with per-file queues.  Returns NULL to fall back to per-file
+ * queues.
+ *
+ * This is only as safe as the page list is complete.  The master builds it
+ * from the page write locks taken while each record's operation ran (see
+ * __lock_update_tracked_writelocks_lsn), so a listed record must not write
+ * any page it isn't listed under.  The physical btree records of those
+ * operations aren't listed at all, which keeps every file that has them on a
+ * single queue; anything that starts listing records by some other means has
+ * to keep that property.  The rep_page_queues test checks replicants against
+ * the master.
+ */
+static int *
+__rep_page_queues(dbenv, rp, fileids, nqueues)
+	DB_ENV *dbenv;
+	struct __recovery_processor *rp;
+	const int *fileids;
+	int nqueues;
+{
+	struct rep_pgent *pe;
+	struct logrecord key, *lr;
+	unsigned char *ufid;
+	db_pgno_t pgno;
+	u_int8_t *covered, *partial;
+	int *parent, *filerec, *qids;
+	int i, k, m, n, maxfid, first0, root;
+
+	n = rp->lc.nlsns;
+	pe = NULL;
+	covered = partial = NULL;
+	parent = filerec = qids = NULL;
+
+	maxfid = 0;
+	for (i = 0; i < n; i++)
+		if (fileids[i] > maxfid)
+			maxfid = fileids[i];
+
+	if ((pe = malloc(sizeof(*pe) * rp->pglogs_cnt)) == NULL ||
+	    (covered = calloc(n, 1)) == NULL ||
+	    (partial = calloc(maxfid + 1, 1)) == NULL ||
+	    (parent = malloc(sizeof(int) * n)) == NULL ||
+	    (filerec = malloc(sizeof(int) * (maxfid + 1))) == NULL ||
+	    (qids = malloc(sizeof(int) * n)) == NULL)
+		goto err;
+
+	for (i = 0; i < n; i++)
+		parent[i] = i;
+
+	/* Find the record behind each page entry. */
+	for (k = 0, m = 0; k < (int)rp->pglogs_cnt; k++) {
+		bdb_get_pglogs_key_list(k, rp->pglogs, &pgno, &ufid, &key.lsn);
+		if ((lr = bsearch(&key, rp->lc.array, n,
+		    sizeof(struct logrecord), __rep_lsn_cmp)) == NULL)
+			continue;
+		pe[m].fileid = ufid;
+		pe[m].pgno = pgno;
+		pe[m].rec = (int)(lr - rp->lc.array);
+		covered[pe[m].rec] = 1;
+		m++;
+	}
+	if (m == 0)
+		goto err;
+
+	/* Records touching the same page are dependent. */
+	qsort(pe, m, sizeof(*pe), rep_pgent_cmp);
+	for (k = 1; k < m; k++)
+		if (rep_pgent_cmp(&pe[k - 1], &pe[k]) == 0)
+			rep_uf_union(parent, pe[k - 1].rec, pe[k].rec);
+
+	/* So are all records of a file that has unlisted records. */
+	for (i = 0; i < n; i++)
+		if (!covered[i])
+			partial[fileids[i]] = 1;
+	for (i = 0; i <= maxfid; i++)
+		filerec[i] = -1;
+	first0 = -1;
+	for (i = 0; i < n; i++) {
+		if (fileids[i] == 0) {
+			if (first0 == -1)
+				first0 = i;
+			rep_uf_union(parent, first0, i);
+		} else if (partial[fileids[i]]) {
+			if (filerec[fileids[i]] == -1)
+				filerec[fileids[i]] = i;
+			rep_uf_union(parent, filerec[fileids[i]], i);
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		root = rep_uf_find(parent, i);
+		if (first0 != -1 && root == rep_uf_find(parent, first0))
+			qids[i] = 0;
+		else
+			qids[i] = 1 + root % nqueues;
+	}
+
+	free(pe);
+	free(covered);
+	free(partial);
+	free(parent);
+	free(filerec);
+	return (qids);
+
+err:	free(pe);
+	free(covered);
+	free(partial);
+	free(parent);
+	free(filerec);
+	free(qids);
+	COMPQUIET(dbenv, NULL);
+	return (NULL);
+}
+
 static void
 processor_thd(struct thdpool *pool, void *work, void *thddata, int op)
 {
@@ -3998,6 +4159,7 @@ processor_thd(struct thdpool *pool, void *work, void *thddata, int op)
 	int ret, t_ret = 0, last_fileid = -1;
 	DB_LSN *lsnp;
 	int j;
+	int *fileids = NULL, *qids = NULL;
 	LISTC_T(struct __recovery_queue) queues;
 
 	DB_REP *db_rep;
@@ -4085,6 +4247,11 @@ processor_thd(struct thdpool *pool, void *work, void *thddata, int op)
 	/* First, bucket records per queue. */
 	data_dbt.flags = DB_DBT_REALLOC;
 
+	if ((fileids = malloc(sizeof(int) * (rp->lc.nlsns + 1))) == NULL) {
+		ret = ENOMEM;
+		goto err;
+	}
+
 	for (i = 0; i < rp->lc.nlsns; i++) {
 		int fileid;
 		u_int32_t rectype;
@@ -4124,6 +4291,20 @@ processor_thd(struct thdpool *pool, void *work, void *thddata, int op)
 		if (-1 == fileid || logical_start_commit(rectype)) {
 			fileid = 0;
 		}
+		fileids[i] = fileid;
+	}
+
+	/* Split the work by page set rather than by file if we can. */
+	if (rp->pglogs != NULL && dbenv->attr.rep_apply_page_queues > 0 &&
+	    (qids = __rep_page_queues(dbenv, rp, fileids,
+	    dbenv->attr.rep_apply_page_queues)) != NULL)
+		gbl_rep_trans_page_queues++;
+
+	for (i = 0; i < rp->lc.nlsns; i++) {
+		int fileid;
+
+		lsnp = &rp->lc.array[i].lsn;
+		fileid = qids ? qids[i] : fileids[i];
 
 		if (fileid >= rp->num_fileids) {
 			rp->recovery_queues =
@@ -4308,6 +4489,8 @@ processor_thd(struct thdpool *pool, void *work, void *thddata, int op)
 
 	/* cleanup - similar to __rep_process_txn */
 err:
+	free(fileids);
+	free(qids);
 	if (ret == 0) {
 		rep->stat.st_txns_applied++;
 		if (dbenv->attr.check_applied_lsns) {
@@ -5072,6 +5255,12 @@ reset_recovery_processor(rp)
 
 	lc_free(dbenv, rp, &rp->lc);
 
+	if (rp->pglogs != NULL) {
+		__os_free(dbenv, rp->pglogs);
+		rp->pglogs = NULL;
+		rp->pglogs_cnt = 0;
+	}
+
 	return ret;
 }
 
@@ -5433,8 +5622,13 @@ bad_resize:	;
 		(!txn_rl_args || (txn_rl_args->lflags & DB_TXN_LOGICAL_COMMIT)),
 		(txn_rl_args) ? txn_rl_args->ltranid : 0,
 		rctl->lsn, *commit_gen, timestamp, rp->context);
-	if (pglogs)
+	if (pglogs && dbenv->attr.rep_apply_page_queues > 0 && keycnt > 0) {
+		/* The processor uses it to find independent records. */
+		rp->pglogs = pglogs;
+		rp->pglogs_cnt = keycnt;
+	} else if (pglogs)
 		__os_free(dbenv, pglogs);
+	pglogs = NULL;
 	if (ret)
 		goto err;
 
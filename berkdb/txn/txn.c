@@ -862,7 +862,7 @@ extern int gbl_new_snapisol_logging;
 int bdb_transfer_txn_pglogs(void *bdb_state, void *pglogs_hashtbl, 
 	pthread_mutex_t *mutexp, DB_LSN commit_lsn, uint32_t flags,
 	unsigned long long logical_tranid, int32_t timestamp,
-	unsigned long long context);
+	unsigned long long context, int child);
 int __lock_set_parent_has_pglk_lsn(DB_ENV *dbenv, u_int32_t parentid, u_int32_t lockid);
 
 /* This prevents dbreg logs from being logged between the LOCK_PUT_READ and
@@ -1172,7 +1172,7 @@ __txn_commit_int(txnp, flags, ltranid, llid, last_commit_lsn, rlocks, inlks,
 							  DB_TXN_DONT_GET_REPO_MTX
 								 )),
 							ltranid, timestamp,
-							context);
+							context, 0);
 					}
 				}
 			}
@@ -1214,7 +1214,7 @@ __txn_commit_int(txnp, flags, ltranid, llid, last_commit_lsn, rlocks, inlks,
 						txnp->pglogs_hashtbl,	   
 						&txnp->pglogs_mutex,
 						txnp->parent->last_lsn,
-						fl, 0, timestamp, 0);
+						fl, 0, timestamp, 0, 1);
 				}	  
 			}
 
@@ -136,9 +136,19 @@ int cdb2_nid_dbname = CDB2_NID_DBNAME_DEFAULT;
 #define CDB2_CACHE_SSL_SESS_DEFAULT 0
 static int cdb2_cache_ssl_sess = CDB2_CACHE_SSL_SESS_DEFAULT;
 
+#define CDB2_SHARE_SSL_SESS_DEFAULT 0
+static int cdb2_share_ssl_sess = CDB2_SHARE_SSL_SESS_DEFAULT;
+
 #define CDB2_MIN_TLS_VER_DEFAULT 0
 static double cdb2_min_tls_ver = CDB2_MIN_TLS_VER_DEFAULT;
 
+#define CDB2_SSL_KTLS_DEFAULT 0
+static int cdb2_ssl_ktls = CDB2_SSL_KTLS_DEFAULT;
+
+/* In the dummy field of an SSLCONN request: we want kernel TLS. The server
+   enables it on its end too, so the connection never goes to sockpool. */
+#define NEWSQL_SSLCONN_KTLS 1
+
 static pthread_mutex_t cdb2_ssl_sess_lock = PTHREAD_MUTEX_INITIALIZER;
 
 typedef struct cdb2_ssl_sess_list cdb2_ssl_sess_list;
@@ -155,6 +165,33 @@ static pthread_mutex_t cdb2_cfg_lock = PTHREAD_MUTEX_INITIALIZER;
 #define CDB2_ALLOW_PMUX_ROUTE_DEFAULT 0
 static int cdb2_allow_pmux_route = CDB2_ALLOW_PMUX_ROUTE_DEFAULT;
 
+#define CDB2_ROW_BATCH_DEFAULT 0
+static int cdb2_row_batch = CDB2_ROW_BATCH_DEFAULT;
+
+#define CDB2_SOCKPOOL_PER_QUERY_DEFAULT 0
+static int cdb2_sockpool_per_query = CDB2_SOCKPOOL_PER_QUERY_DEFAULT;
+
+/* COMPIO_* bitmask of the algorithms to offer the server */
+#define CDB2_COMPRESS_DEFAULT COMPIO_NONE
+static int cdb2_compress = CDB2_COMPRESS_DEFAULT;
+#define CDB2_COMPRESS_MIN_BYTES_DEFAULT 1024
+static int cdb2_compress_min_bytes = CDB2_COMPRESS_MIN_BYTES_DEFAULT;
+
+/* how long to steer new connections away from a host that turned a query
+   away for being overloaded; 0 turns it off */
+#define CDB2_REJECT_AVOID_SECS_DEFAULT 10
+static int cdb2_reject_avoid_secs = CDB2_REJECT_AVOID_SECS_DEFAULT;
+
+/* how long a port portmux gave us is reused without asking again; 0 asks
+   every time */
+#define CDB2_PORTMUX_CACHE_SECS_DEFAULT 60
+static int cdb2_portmux_cache_secs = CDB2_PORTMUX_CACHE_SECS_DEFAULT;
+
+/* how long new handles reuse the hosts another handle discovered for the
+   same database; 0 discovers on every open */
+#define CDB2_DBHOSTS_CACHE_SECS_DEFAULT 30
+static int cdb2_dbhosts_cache_secs = CDB2_DBHOSTS_CACHE_SECS_DEFAULT;
+
 static int _PID; /* ONE-TIME */
 static int _MACHINE_ID; /* ONE-TIME */
 static char *_ARGV0; /* ONE-TIME */
@@ -293,6 +330,13 @@ static void reset_the_configuration(void)
     cdb2_tcpbufsz = CDB2_TCPBUFSZ_DEFAULT;
 
     cdb2_allow_pmux_route = CDB2_ALLOW_PMUX_ROUTE_DEFAULT;
+    cdb2_row_batch = CDB2_ROW_BATCH_DEFAULT;
+    cdb2_sockpool_per_query = CDB2_SOCKPOOL_PER_QUERY_DEFAULT;
+    cdb2_compress = CDB2_COMPRESS_DEFAULT;
+    cdb2_compress_min_bytes = CDB2_COMPRESS_MIN_BYTES_DEFAULT;
+    cdb2_reject_avoid_secs = CDB2_REJECT_AVOID_SECS_DEFAULT;
+    cdb2_portmux_cache_secs = CDB2_PORTMUX_CACHE_SECS_DEFAULT;
+    cdb2_dbhosts_cache_secs = CDB2_DBHOSTS_CACHE_SECS_DEFAULT;
     cdb2cfg_override = CDB2CFG_OVERRIDE_DEFAULT;
 
 #if WITH_SSL
@@ -306,7 +350,9 @@ static void reset_the_configuration(void)
 
     cdb2_nid_dbname = CDB2_NID_DBNAME_DEFAULT;
     cdb2_cache_ssl_sess = CDB2_CACHE_SSL_SESS_DEFAULT;
+    cdb2_share_ssl_sess = CDB2_SHARE_SSL_SESS_DEFAULT;
     cdb2_min_tls_ver = CDB2_MIN_TLS_VER_DEFAULT;
+    cdb2_ssl_ktls = CDB2_SSL_KTLS_DEFAULT;
 #endif
 
     reset_sockpool();
@@ -935,6 +981,19 @@ static cdb2_ssl_sess_list cdb2_ssl_sess_cache;
 #define TIME_MASK (-1ULL << CNT_BITS)
 #define CNT_MASK (-1ULL ^ TIME_MASK)
 
+/* A statement from cdb2_prepare().  It is sent with a sql cache hint like
+   cdb2_use_hint() does, so after the first run only the hint goes over the
+   wire and the server finds the statement in its cache by the hint. */
+struct cdb2_prepared {
+    char *sql;        /* NULL if the slot is free */
+    char *hint;       /* first word and hint only */
+    char *query_hint; /* whole statement with the hint */
+    int sent;         /* the server has seen query_hint */
+    int misses;       /* hint runs in a row the server didn't recognize */
+};
+
+#define CDB2_MAX_PREPARED_MISSES 2
+
 typedef struct cnonce {
     long hostid;
     int pid;
@@ -948,6 +1007,76 @@ typedef struct cnonce {
 #define TYPE_LEN 64
 #define POLICY_LEN 24
 
+/* Rows are unpacked into a bump allocator that is emptied when the next row
+ * is read, rather than malloc'ing and freeing every field of every row.
+ * What doesn't fit goes in overflow chunks, and the arena is grown to fit
+ * it next time. */
+struct cdb2_arena_chunk {
+    struct cdb2_arena_chunk *next;
+    long double data[]; /* aligned */
+};
+
+struct cdb2_arena {
+    char *buf;
+    size_t used;
+    size_t cap;
+    size_t need; /* asked for since the last reset */
+    struct cdb2_arena_chunk *overflow;
+};
+
+#define CDB2_ARENA_ALIGN(n) (((n) + 15) & ~(size_t)15)
+
+static void *cdb2_arena_alloc(void *data, size_t n)
+{
+    struct cdb2_arena *a = data;
+    n = CDB2_ARENA_ALIGN(n);
+    a->need += n;
+    if (a->used + n <= a->cap) {
+        void *p = a->buf + a->used;
+        a->used += n;
+        return p;
+    }
+    struct cdb2_arena_chunk *c = malloc(sizeof(*c) + n);
+    if (c == NULL)
+        return NULL;
+    c->next = a->overflow;
+    a->overflow = c;
+    return c->data;
+}
+
+static void cdb2_arena_free(void *data, void *p)
+{
+    /* released all at once by cdb2_arena_reset */
+}
+
+static void cdb2_arena_reset(struct cdb2_arena *a)
+{
+    while (a->overflow) {
+        struct cdb2_arena_chunk *c = a->overflow;
+        a->overflow = c->next;
+        free(c);
+    }
+    if (a->need > a->cap) {
+        size_t cap = CDB2_ARENA_ALIGN(a->need + a->need / 2);
+        char *buf = malloc(cap);
+        if (buf) {
+            free(a->buf);
+            a->buf = buf;
+            a->cap = cap;
+        }
+    }
+    a->used = 0;
+    a->need = 0;
+}
+
+static void cdb2_arena_destroy(struct cdb2_arena *a)
+{
+    cdb2_arena_reset(a);
+    free(a->buf);
+    a->buf = NULL;
+    a->cap = 0;
+}
+
 struct cdb2_hndl {
     char dbname[DBNAME_LEN];
     char cluster[64];
@@ -972,6 +1101,9 @@ struct cdb2_hndl {
     char *query_hint;
     char *hint;
     int use_hint;
+    struct cdb2_prepared *prepared;
+    int nprepared;
+    int prepared_id; /* statement cdb2_run_prepared() is running */
     int flags;
     char errstr[1024];
     cnonce_t cnonce;
@@ -995,6 +1127,11 @@ struct cdb2_hndl {
     int num_set_commands_sent;
     int is_read;
     unsigned long long rows_read;
+    int batch_row; /* row of lastresponse->row_batch being read */
+    int npipelined; /* sent by cdb2_send_statement, not read yet */
+    int no_compress; /* a node didn't understand the compress request */
+    struct cdb2_arena arena; /* lastresponse lives here */
+    ProtobufCAllocator allocator;
     int read_intrans_results;
     int first_record_read;
     char **commands;
@@ -1015,7 +1152,10 @@ struct cdb2_hndl {
     char *ca;
     char *crl;
     int cache_ssl_sess;
+    int share_ssl_sess;
+    int ssl_sess_shared; /* this connection's session went to sockpool */
     double min_tls_ver;
+    int ssl_ktls;
     cdb2_ssl_sess_list *sess_list;
     int nid_dbname;
 #endif
@@ -1374,10 +1514,19 @@ static void read_comdb2db_cfg(cdb2_hndl_tp *hndl, SBUF2 *s,
                 tok = strtok_r(NULL, " :,", &last);
                 if (tok)
                     cdb2_cache_ssl_sess = !!atoi(tok);
+            } else if (strcasecmp("ssl_session_share", tok) == 0) {
+                tok = strtok_r(NULL, " :,", &last);
+                if (tok)
+                    cdb2_share_ssl_sess = (strncasecmp(tok, "true", 4) == 0 ||
+                                           atoi(tok) != 0);
             } else if (strcasecmp(SSL_MIN_TLS_VER_OPT, tok) == 0) {
                 tok = strtok_r(NULL, " :,", &last);
                 if (tok)
                     cdb2_min_tls_ver = atof(tok);
+            } else if (strcasecmp(SSL_KTLS_OPT, tok) == 0) {
+                tok = strtok_r(NULL, " :,", &last);
+                if (tok)
+                    cdb2_ssl_ktls = (strncasecmp(tok, "true", 4) == 0);
 #endif /* WITH_SSL */
             } else if (strcasecmp("allow_pmux_route", tok) == 0) {
                 tok = strtok_r(NULL, " :,", &last);
@@ -1388,6 +1537,52 @@ static void read_comdb2db_cfg(cdb2_hndl_tp *hndl, SBUF2 *s,
                         cdb2_allow_pmux_route = 0;
                     }
                 }
+            } else if (strcasecmp("row_batch", tok) == 0) {
+                tok = strtok_r(NULL, " :,", &last);
+                if (tok) {
+                    if (strncasecmp(tok, "true", 4) == 0) {
+                        cdb2_row_batch = 1;
+                    } else {
+                        cdb2_row_batch = 0;
+                    }
+                }
+            } else if (strcasecmp("sockpool_per_query", tok) == 0) {
+                tok = strtok_r(NULL, " :,", &last);
+                if (tok) {
+                    if (strncasecmp(tok, "true", 4) == 0) {
+                        cdb2_sockpool_per_query = 1;
+                    } else {
+                        cdb2_sockpool_per_query = 0;
+                    }
+                }
+            } else if (strcasecmp("compress", tok) == 0) {
+                tok = strtok_r(NULL, " :,", &last);
+                if (tok) {
+                    if (strcasecmp(tok, "lz4") == 0)
+                        cdb2_compress = COMPIO_LZ4;
+                    else if (strcasecmp(tok, "zstd") == 0)
+                        cdb2_compress = COMPIO_ZSTD;
+                    else if (strcasecmp(tok, "any") == 0)
+                        cdb2_compress = COMPIO_LZ4 | COMPIO_ZSTD;
+                    else
+                        cdb2_compress = COMPIO_NONE;
+                }
+            } else if (strcasecmp("compress_min_bytes", tok) == 0) {
+                tok = strtok_r(NULL, " :,", &last);
+                if (tok)
+                    cdb2_compress_min_bytes = atoi(tok);
+            } else if (strcasecmp("reject_avoid_secs", tok) == 0) {
+                tok = strtok_r(NULL, " :,", &last);
+                if (tok)
+                    cdb2_reject_avoid_secs = atoi(tok);
+            } else if (strcasecmp("portmux_cache_secs", tok) == 0) {
+                tok = strtok_r(NULL, " :,", &last);
+                if (tok)
+                    cdb2_portmux_cache_secs = atoi(tok);
+            } else if (strcasecmp("dbhosts_cache_secs", tok) == 0) {
+                tok = strtok_r(NULL, " :,", &last);
+                if (tok)
+                    cdb2_dbhosts_cache_secs = atoi(tok);
             } else if (strcasecmp("install_static_libs_v2", tok) == 0 ||
                        strcasecmp("enable_static_libs", tok) == 0) {
                 if (cdb2_install != NULL)
@@ -1657,7 +1852,14 @@ struct sockpool_msg_vers0 {
     char typestr[48];
 };
 
-enum { SOCKPOOL_DONATE = 0, SOCKPOOL_REQUEST = 1 };
+enum {
+    SOCKPOOL_DONATE = 0,
+    SOCKPOOL_REQUEST = 1,
+    SOCKPOOL_SSL_SESSION_PUT = 3,
+    SOCKPOOL_SSL_SESSION_GET = 4
+};
+
+#define SOCKPOOL_SSL_SESSION_MAX 16384
 
 static int open_sockpool_ll(void)
 {
@@ -2008,6 +2210,173 @@ void cdb2_socket_pool_donate_ext(const char *typestr, int fd, int ttl,
     }
 }
 
+#if WITH_SSL
+/* SSL sessions go through sockpool too, for the other processes of this user
+   on the host to resume instead of each doing a full handshake.  A session
+   is named by a hash of the database, the host and everything the handshake
+   is made to verify, so a process only resumes one made on the same terms as
+   its own would be. */
+static int sockpool_no_ssl_sessions; /* sockpool too old to keep them */
+
+static void cdb2_ssl_sess_typestr(cdb2_hndl_tp *hndl, int indx, char *typestr,
+                                  size_t n)
+{
+    const char *parts[] = {hndl->dbname, hndl->hosts[indx], hndl->cert,
+                           hndl->key,    hndl->ca,           hndl->crl};
+    uint64_t h = 14695981039346656037ULL; /* FNV-1a */
+    const char *c;
+
+    for (int i = 0; i != sizeof(parts) / sizeof(parts[0]); ++i) {
+        c = parts[i] ? parts[i] : "";
+        do {
+            h = (h ^ (unsigned char)*c) * 1099511628211ULL;
+        } while (*c++ != '\0');
+    }
+    h = (h ^ (unsigned)hndl->c_sslmode) * 1099511628211ULL;
+    h = (h ^ (unsigned)hndl->nid_dbname) * 1099511628211ULL;
+    snprintf(typestr, n, "ssl/%016llx", (unsigned long long)h);
+}
+
+static int sockpool_ssl_fd(int *sp_generation)
+{
+    int fd = -1, enabled;
+
+    pthread_mutex_lock(&cdb2_sockpool_mutex);
+    enabled = sockpool_enabled == 1 && !sockpool_no_ssl_sessions;
+    if (enabled) {
+        *sp_generation = sockpool_generation;
+        fd = sockpool_get_from_pool();
+    }
+    pthread_mutex_unlock(&cdb2_sockpool_mutex);
+
+    if (enabled && fd == -1)
+        fd = open_sockpool_ll();
+    return fd;
+}
+
+static void sockpool_ssl_fd_done(int fd, int sp_generation, int broken)
+{
+    int closeit = 0;
+
+    pthread_mutex_lock(&cdb2_sockpool_mutex);
+    if (broken || sp_generation != sockpool_generation) {
+        sockpool_remove_fd(fd);
+        closeit = 1;
+    } else if (sockpool_place_fd_in_pool(fd) != 0) {
+        closeit = 1;
+    }
+    pthread_mutex_unlock(&cdb2_sockpool_mutex);
+    if (closeit)
+        close(fd);
+}
+
+static int sockpool_ssl_io(int fd, void *buf, size_t len, int wr)
+{
+    char *p = buf;
+    ssize_t nbytes;
+
+    while (len > 0) {
+        nbytes = wr ? write(fd, p, len) : read(fd, p, len);
+        if (nbytes == -1 && errno == EINTR)
+            continue;
+        if (nbytes <= 0)
+            return -1;
+        p += nbytes;
+        len -= nbytes;
+    }
+    return 0;
+}
+
+static SSL_SESSION *cdb2_sockpool_get_ssl_session(cdb2_hndl_tp *hndl,
+                                                  int indx)
+{
+    struct sockpool_msg_vers0 msg = {0};
+    SSL_SESSION *sess = NULL;
+    unsigned char *der = NULL;
+    const unsigned char *p;
+    int fd, sp_generation = -1, gotfd = -1, broken = 1;
+
+    if ((fd = sockpool_ssl_fd(&sp_generation)) == -1)
+        return NULL;
+
+    msg.request = SOCKPOOL_SSL_SESSION_GET;
+    cdb2_ssl_sess_typestr(hndl, indx, msg.typestr, sizeof(msg.typestr));
+    if (send_fd(fd, &msg, sizeof(msg), -1) == PASSFD_SUCCESS) {
+        if (recv_fd(fd, &msg, sizeof(msg), &gotfd) != PASSFD_SUCCESS) {
+            /* a sockpool that doesn't know the request hangs up on us */
+            pthread_mutex_lock(&cdb2_sockpool_mutex);
+            sockpool_no_ssl_sessions = 1;
+            pthread_mutex_unlock(&cdb2_sockpool_mutex);
+        } else if (msg.dbnum == 0) {
+            broken = 0;
+        } else if (msg.dbnum > 0 && msg.dbnum <= SOCKPOOL_SSL_SESSION_MAX &&
+                   (der = malloc(msg.dbnum)) != NULL &&
+                   sockpool_ssl_io(fd, der, msg.dbnum, 0) == 0) {
+            broken = 0;
+            p = der;
+            sess = d2i_SSL_SESSION(NULL, &p, msg.dbnum);
+        }
+    }
+    if (gotfd != -1)
+        close(gotfd);
+    sockpool_ssl_fd_done(fd, sp_generation, broken);
+    free(der);
+    return sess;
+}
+
+static void cdb2_sockpool_put_ssl_session(cdb2_hndl_tp *hndl, int indx,
+                                          SSL_SESSION *sess)
+{
+    struct sockpool_msg_vers0 msg = {0};
+    unsigned char *der, *p;
+    long timeout;
+    int fd, len, sp_generation = -1, broken;
+
+    timeout = SSL_SESSION_get_timeout(sess) -
+              (time(NULL) - SSL_SESSION_get_time(sess));
+    len = i2d_SSL_SESSION(sess, NULL);
+    if (timeout <= 0 || len <= 0 || len > SOCKPOOL_SSL_SESSION_MAX)
+        return;
+    if ((p = der = malloc(len)) == NULL)
+        return;
+    i2d_SSL_SESSION(sess, &p);
+
+    if ((fd = sockpool_ssl_fd(&sp_generation)) != -1) {
+        msg.request = SOCKPOOL_SSL_SESSION_PUT;
+        msg.dbnum = len;
+        msg.timeout = timeout > INT_MAX ? INT_MAX : (int)timeout;
+        cdb2_ssl_sess_typestr(hndl, indx, msg.typestr, sizeof(msg.typestr));
+        broken = send_fd(fd, &msg, sizeof(msg), -1) != PASSFD_SUCCESS ||
+                 sockpool_ssl_io(fd, der, len, 1) != 0;
+        sockpool_ssl_fd_done(fd, sp_generation, broken);
+    }
+    free(der);
+}
+
+/* Once per connection, when its session can be resumed: a TLS 1.3 server
+   sends its ticket after the handshake, so that may not be until the
+   connection is given up. */
+static void cdb2_share_ssl_session(cdb2_hndl_tp *hndl, SBUF2 *sb, int indx)
+{
+    SSL_SESSION *sess;
+    SSL *ssl;
+
+    if (!hndl->share_ssl_sess || hndl->ssl_sess_shared || indx < 0 ||
+        (ssl = sslio_get_ssl(sb)) == NULL)
+        return;
+    if ((sess = SSL_get1_session(ssl)) == NULL)
+        return;
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    if (SSL_SESSION_is_resumable(sess))
+#endif
+    {
+        cdb2_sockpool_put_ssl_session(hndl, indx, sess);
+        hndl->ssl_sess_shared = 1;
+    }
+    SSL_SESSION_free(sess);
+}
+#endif
+
 /* SOCKPOOL CODE ENDS */
 
 static inline int cdb2_hostid()
@@ -2051,7 +2420,7 @@ static int try_ssl(cdb2_hndl_tp *hndl, SBUF2 *sb, int indx)
     int rc, i, dossl = 0;
     cdb2_ssl_sess *p;
     cdb2_ssl_sess_list *store;
-    SSL_SESSION *sess;
+    SSL_SESSION *sess, *shared;
 
     if (hndl->c_sslmode >= SSL_REQUIRE) {
         switch (hndl->s_sslmode) {
@@ -2099,6 +2468,8 @@ static int try_ssl(cdb2_hndl_tp *hndl, SBUF2 *sb, int indx)
 
     /* If negotiation fails, let API retry. */
     struct newsqlheader hdr = {.type = ntohl(CDB2_REQUEST_TYPE__SSLCONN)};
+    if (hndl->ssl_ktls)
+        hdr.dummy = ntohl(NEWSQL_SSLCONN_KTLS);
     rc = sbuf2fwrite((char *)&hdr, sizeof(hdr), 1, sb);
     if (rc != 1)
         return -1;
@@ -2128,10 +2499,19 @@ static int try_ssl(cdb2_hndl_tp *hndl, SBUF2 *sb, int indx)
 
     p = (hndl->sess_list == NULL) ? NULL : &(hndl->sess_list->list[indx]);
 
+    /* Nothing of our own to resume: maybe another process has it. */
+    shared = NULL;
+    if ((p == NULL || p->sess == NULL) && hndl->share_ssl_sess)
+        shared = cdb2_sockpool_get_ssl_session(hndl, indx);
+
+    sslio_set_ktls(sb, hndl->ssl_ktls);
     rc = sslio_connect(sb, ctx, hndl->c_sslmode, hndl->dbname, hndl->nid_dbname,
                        hndl->errstr, sizeof(hndl->errstr),
-                       ((p != NULL) ? p->sess : NULL), &hndl->sslerr);
+                       ((p != NULL && p->sess != NULL) ? p->sess : shared),
+                       &hndl->sslerr);
 
+    if (shared != NULL)
+        SSL_SESSION_free(shared);
     SSL_CTX_free(ctx);
     if (rc != 1) {
         /* If SSL_connect() fails, invalidate the session. */
@@ -2140,6 +2520,10 @@ static int try_ssl(cdb2_hndl_tp *hndl, SBUF2 *sb, int indx)
         return -1;
     }
 
+    /* A resumed session is one sockpool has already */
+    hndl->ssl_sess_shared = SSL_session_reused(sslio_get_ssl(sb));
+    cdb2_share_ssl_session(hndl, sb, indx);
+
     if (hndl->cache_ssl_sess) {
         if (hndl->sess_list == NULL) {
             hndl->sess_list = malloc(sizeof(cdb2_ssl_sess_list));
@@ -2238,6 +2622,36 @@ static int cdb2portmux_route(cdb2_hndl_tp *hndl, const char *remote_host,
     return fd;
 }
 
+/* Offer the server the algorithms in cdb2_compress.  It replies with the one
+   it picked, or 0, and from then on both ends speak compressed frames.  A
+   server that predates this drops the connection; remember that, so the
+   retry connects without asking. */
+static int try_compress(cdb2_hndl_tp *hndl, SBUF2 *sb)
+{
+    int rc, algos = cdb2_compress & compio_supported();
+
+    if (algos == COMPIO_NONE || hndl->no_compress ||
+        compio_algo(sb) != COMPIO_NONE)
+        return 0;
+
+    struct newsqlheader hdr = {.type = ntohl(CDB2_REQUEST_TYPE__COMPRESS),
+                               .compression = ntohl(algos)};
+    if (sbuf2fwrite((char *)&hdr, sizeof(hdr), 1, sb) != 1 ||
+        sbuf2flush(sb) < 0 || (rc = sbuf2getc(sb)) < 0) {
+        hndl->no_compress = 1;
+        return -1;
+    }
+    if (rc == COMPIO_NONE)
+        return 0;
+    if (!(rc & algos) ||
+        compio_start(sb, rc, cdb2_compress_min_bytes) != 0) {
+        sprintf(hndl->errstr, "%s: can't start compression %d", __func__, rc);
+        return -1;
+    }
+    debugprint("compressing with %s\n", compio_name(rc));
+    return 0;
+}
+
 static void get_host_from_fd(cdb2_hndl_tp *hndl, int fd)
 {
     struct sockaddr_in addr;
@@ -2260,6 +2674,75 @@ static void get_host_from_fd(cdb2_hndl_tp *hndl, int fd)
 /* Tries to connect to specified node using sockpool.
  * If there is none, then makes a new socket connection.
  */
+/* Ports portmux handed out, shared by all the handles in the process so
+   that only the first of many new handles to a database pays for the
+   portmux round trip. */
+#define MAX_PORTMUX_CACHE 64
+static struct {
+    char host[64];
+    char name[128]; /* app/service/instance */
+    int port;
+    time_t when;
+} portmux_cache[MAX_PORTMUX_CACHE];
+static pthread_mutex_t portmux_cache_lk = PTHREAD_MUTEX_INITIALIZER;
+
+static int portmux_cache_find(const char *host, const char *name)
+{
+    time_t since = time(NULL) - cdb2_portmux_cache_secs;
+    int port = -1;
+
+    if (cdb2_portmux_cache_secs <= 0)
+        return -1;
+    pthread_mutex_lock(&portmux_cache_lk);
+    for (int i = 0; i < MAX_PORTMUX_CACHE; i++) {
+        if (portmux_cache[i].when > since &&
+            strcmp(portmux_cache[i].host, host) == 0 &&
+            strcmp(portmux_cache[i].name, name) == 0) {
+            port = portmux_cache[i].port;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&portmux_cache_lk);
+    return port;
+}
+
+static void portmux_cache_add(const char *host, const char *name, int port)
+{
+    int i, slot = 0;
+
+    if (cdb2_portmux_cache_secs <= 0)
+        return;
+    pthread_mutex_lock(&portmux_cache_lk);
+    for (i = 0; i < MAX_PORTMUX_CACHE; i++) {
+        if (strcmp(portmux_cache[i].host, host) == 0 &&
+            strcmp(portmux_cache[i].name, name) == 0) {
+            slot = i;
+            break;
+        }
+        if (portmux_cache[i].when < portmux_cache[slot].when)
+            slot = i;
+    }
+    strncpy(portmux_cache[slot].host, host,
+            sizeof(portmux_cache[slot].host) - 1);
+    strncpy(portmux_cache[slot].name, name,
+            sizeof(portmux_cache[slot].name) - 1);
+    portmux_cache[slot].port = port;
+    portmux_cache[slot].when = time(NULL);
+    pthread_mutex_unlock(&portmux_cache_lk);
+}
+
+/* The database may have come back on another port; ask portmux next time */
+static void portmux_cache_forget(const char *host, int port)
+{
+    pthread_mutex_lock(&portmux_cache_lk);
+    for (int i = 0; i < MAX_PORTMUX_CACHE; i++) {
+        if (portmux_cache[i].port == port &&
+            strcmp(portmux_cache[i].host, host) == 0)
+            portmux_cache[i].when = 0;
+    }
+    pthread_mutex_unlock(&portmux_cache_lk);
+}
+
 static int newsql_connect(cdb2_hndl_tp *hndl, int node_indx, int myport,
                           int timeoutms)
 {
@@ -2298,6 +2781,8 @@ static int newsql_connect(cdb2_hndl_tp *hndl, int node_indx, int myport,
         if (!cdb2_allow_pmux_route) {
             fd =
                 cdb2_tcpconnecth_to(hndl, host, port, 0, hndl->connect_timeout);
+            if (fd < 0)
+                portmux_cache_forget(host, port);
         } else {
             fd = cdb2portmux_route(hndl, host, "comdb2", "replication",
                                    hndl->dbname);
@@ -2324,6 +2809,11 @@ static int newsql_connect(cdb2_hndl_tp *hndl, int node_indx, int myport,
     }
 #endif
 
+    if (try_compress(hndl, sb) != 0) {
+        sbuf2close(sb);
+        return -1;
+    }
+
     hndl->sb = sb;
     hndl->num_set_commands_sent = 0;
     hndl->sent_client_info = 0;
@@ -2341,12 +2831,30 @@ static void newsql_disconnect(cdb2_hndl_tp *hndl, SBUF2 *sb, int line)
     debugprint("disconnecting from %s\n", hndl->hosts[hndl->connected_host]);
     int fd = sbuf2fileno(sb);
 
+    if (compio_algo(sb) != COMPIO_NONE) {
+        struct compio_stats st;
+        compio_get_stats(sb, &st);
+        debugprint("%s: in %lld raw %lld wire, out %lld raw %lld wire\n",
+                   compio_name(st.algo), (long long)st.raw_in,
+                   (long long)st.wire_in, (long long)st.raw_out,
+                   (long long)st.wire_out);
+    }
+
+#if WITH_SSL
+    if (sslio_has_ssl(sb))
+        cdb2_share_ssl_session(hndl, sb, hndl->connected_host);
+#endif
+
     int timeoutms = 10 * 1000;
     if (hndl->is_admin ||
         (hndl->firstresponse &&
          (!hndl->lastresponse ||
           (hndl->lastresponse->response_type != RESPONSE_TYPE__LAST_ROW))) ||
-        (!hndl->firstresponse) || hndl->in_trans) {
+        (!hndl->firstresponse) || hndl->in_trans || hndl->npipelined
+#if WITH_SSL
+        || (hndl->ssl_ktls && sslio_has_ssl(sb))
+#endif
+        ) {
         sbuf2close(sb);
     } else {
         sbuf2free(sb);
@@ -2355,9 +2863,32 @@ static void newsql_disconnect(cdb2_hndl_tp *hndl, SBUF2 *sb, int line)
     }
     hndl->use_hint = 0;
     hndl->sb = NULL;
+    /* whatever was pipelined on this connection is lost */
+    hndl->npipelined = 0;
     return;
 }
 
+/* With sockpool_per_query, hand the connection back to sockpool as soon as a
+   statement outside a transaction is done, so an idle handle doesn't hold a
+   connection (and a server thread) until it is closed.  The next statement
+   takes one from sockpool again, and resends the set commands. */
+static void cdb2_release_idle_connection(cdb2_hndl_tp *hndl)
+{
+    if (!cdb2_sockpool_per_query || !hndl->sb || hndl->in_trans ||
+        hndl->npipelined || !hndl->firstresponse || !hndl->lastresponse ||
+        hndl->lastresponse->response_type != RESPONSE_TYPE__LAST_ROW)
+        return;
+    pthread_mutex_lock(&cdb2_sockpool_mutex);
+    int enabled = sockpool_enabled;
+    pthread_mutex_unlock(&cdb2_sockpool_mutex);
+    if (enabled != 1)
+        return;
+
+    int use_hint = hndl->use_hint;
+    newsql_disconnect(hndl, hndl->sb, __LINE__);
+    hndl->use_hint = use_hint;
+}
+
 /* returns port number, or -1 for error*/
 static int cdb2portmux_get(cdb2_hndl_tp *hndl, const char *type,
                            const char *remote_host, const char *app,
@@ -2392,6 +2923,11 @@ static int cdb2portmux_get(cdb2_hndl_tp *hndl, const char *type,
 
     debugprint("name %s\n", name);
 
+    if ((port = portmux_cache_find(remote_host, name)) > 0) {
+        debugprint("cached port %d for '%s'\n", port, name);
+        goto after_callback;
+    }
+
     fd = cdb2_tcpconnecth_to(hndl, remote_host, CDB2_PORTMUXPORT, 0,
                              hndl->connect_timeout);
     if (fd < 0) {
@@ -2433,6 +2969,8 @@ static int cdb2portmux_get(cdb2_hndl_tp *hndl, const char *type,
         snprintf(hndl->errstr, sizeof(hndl->errstr),
                  "%s:%d Invalid response from portmux.\n", __func__, __LINE__);
         port = -1;
+    } else {
+        portmux_cache_add(remote_host, name, port);
     }
 after_callback:
     while ((e = cdb2_next_callback(hndl, CDB2_AFTER_PMUX, e)) != NULL) {
@@ -2469,6 +3007,7 @@ static inline int cdb2_try_connect_range(cdb2_hndl_tp *hndl, int begin, int max)
 }
 
 static int cdb2_get_dbhosts(cdb2_hndl_tp *hndl);
+static void dbhosts_cache_forget(cdb2_hndl_tp *hndl);
 
 /* combine hashes similar to hash_combine from boost library */
 static uint64_t val_combine(uint64_t lhs, uint64_t rhs)
@@ -2529,6 +3068,73 @@ static int getRandomExclude(int max, int exclude)
     return val;
 }
 
+/* Hosts that recently rejected a query because their sql pool was full.
+   Shared by all the handles in the process, so one handle's rejection
+   steers the others away too. */
+#define MAX_REJECTED_HOSTS 64
+static struct {
+    char dbname[DBNAME_LEN];
+    char host[64];
+    time_t when;
+} rejected_hosts[MAX_REJECTED_HOSTS];
+static pthread_mutex_t rejected_hosts_lk = PTHREAD_MUTEX_INITIALIZER;
+
+static void note_rejected_host(cdb2_hndl_tp *hndl)
+{
+    int i, slot = 0;
+
+    if (cdb2_reject_avoid_secs <= 0 || hndl->connected_host < 0)
+        return;
+    const char *host = hndl->hosts[hndl->connected_host];
+
+    pthread_mutex_lock(&rejected_hosts_lk);
+    for (i = 0; i < MAX_REJECTED_HOSTS; i++) {
+        if (strcmp(rejected_hosts[i].host, host) == 0 &&
+            strcmp(rejected_hosts[i].dbname, hndl->dbname) == 0) {
+            slot = i;
+            break;
+        }
+        if (rejected_hosts[i].when < rejected_hosts[slot].when)
+            slot = i;
+    }
+    strncpy(rejected_hosts[slot].dbname, hndl->dbname,
+            sizeof(rejected_hosts[slot].dbname) - 1);
+    strncpy(rejected_hosts[slot].host, host,
+            sizeof(rejected_hosts[slot].host) - 1);
+    rejected_hosts[slot].when = time(NULL);
+    pthread_mutex_unlock(&rejected_hosts_lk);
+}
+
+static int host_rejected_recently(cdb2_hndl_tp *hndl, int ix)
+{
+    time_t since = time(NULL) - cdb2_reject_avoid_secs;
+    int found = 0;
+
+    pthread_mutex_lock(&rejected_hosts_lk);
+    for (int i = 0; i < MAX_REJECTED_HOSTS; i++) {
+        if (rejected_hosts[i].when > since &&
+            strcmp(rejected_hosts[i].host, hndl->hosts[ix]) == 0 &&
+            strcmp(rejected_hosts[i].dbname, hndl->dbname) == 0) {
+            found = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&rejected_hosts_lk);
+    return found;
+}
+
+/* Like getRandomExclude, but draw a second host if the first has turned
+   queries away lately, and keep whichever wasn't rejected */
+static int getRandomHost(cdb2_hndl_tp *hndl, int max)
+{
+    int first = getRandomExclude(max, hndl->master);
+    if (cdb2_reject_avoid_secs <= 0 || max < 3 ||
+        !host_rejected_recently(hndl, first))
+        return first;
+    int second = getRandomExclude(max, hndl->master);
+    return host_rejected_recently(hndl, second) ? first : second;
+}
+
 static int cdb2_connect_sqlhost(cdb2_hndl_tp *hndl)
 {
     if (hndl->sb) {
@@ -2545,11 +3151,10 @@ retry_connect:
     if ((hndl->node_seq == 0) &&
         ((hndl->flags & CDB2_RANDOM) || ((hndl->flags & CDB2_RANDOMROOM) &&
                                          (hndl->num_hosts_sameroom == 0)))) {
-        hndl->node_seq = getRandomExclude(hndl->num_hosts, hndl->master);
+        hndl->node_seq = getRandomHost(hndl, hndl->num_hosts);
     } else if ((hndl->flags & CDB2_RANDOMROOM) && (hndl->node_seq == 0) &&
                (hndl->num_hosts_sameroom > 0)) {
-        hndl->node_seq =
-            getRandomExclude(hndl->num_hosts_sameroom, hndl->master);
+        hndl->node_seq = getRandomHost(hndl, hndl->num_hosts_sameroom);
         /* First try on same room. */
         if (0 == cdb2_try_connect_range(hndl, hndl->node_seq,
                                         hndl->num_hosts_sameroom))
@@ -2592,10 +3197,12 @@ retry_connect:
     }
 
     /* Can't connect to any of the nodes, re-check information about db. */
-    if (!(hndl->flags & CDB2_DIRECT_CPU) && requery_done == 0 &&
-        cdb2_get_dbhosts(hndl) == 0) {
-        requery_done = 1;
-        goto retry_connect;
+    if (!(hndl->flags & CDB2_DIRECT_CPU) && requery_done == 0) {
+        dbhosts_cache_forget(hndl);
+        if (cdb2_get_dbhosts(hndl) == 0) {
+            requery_done = 1;
+            goto retry_connect;
+        }
     }
 
     hndl->connected_host = -1;
@@ -2752,7 +3359,7 @@ static int cdb2_convert_error_code(int rc)
 static void clear_responses(cdb2_hndl_tp *hndl)
 {
     if (hndl->lastresponse) {
-        cdb2__sqlresponse__free_unpacked(hndl->lastresponse, NULL);
+        cdb2_arena_reset(&hndl->arena);
         free((void *)hndl->last_buf);
         hndl->last_buf = NULL;
         hndl->lastresponse = NULL;
@@ -2929,6 +3536,9 @@ static int cdb2_send_query(cdb2_hndl_tp *hndl, cdb2_hndl_tp *event_hndl,
         if (retries_done >= hndl->num_hosts) {
             features[n_features++] = CDB2_CLIENT_FEATURES__ALLOW_QUEUING;
         }
+        if (cdb2_row_batch) {
+            features[n_features++] = CDB2_CLIENT_FEATURES__ROW_BATCH;
+        }
 
         debugprint("sending to %s '%s' from-line %d retries is"
                    " %d do_append is %d\n",
@@ -3090,6 +3700,25 @@ static int retry_queries_and_skip(cdb2_hndl_tp *hndl, int num_retry,
         return (rcode);                                                        \
     } while (0)
 
+/* Every column of a batch must have an entry for each row. */
+static int cdb2_valid_row_batch(cdb2_hndl_tp *hndl,
+                                const CDB2SQLRESPONSE__Rowbatch *b)
+{
+    if (b->nrows <= 0 || hndl->firstresponse == NULL ||
+        b->n_columns != hndl->firstresponse->n_value)
+        return 0;
+    for (int i = 0; i < b->n_columns; i++) {
+        const CDB2SQLRESPONSE__Rowbatch__Column *c = b->columns[i];
+        size_t n = c->n_ints ? c->n_ints : c->n_reals ? c->n_reals
+                                                      : c->n_values;
+        if (n != b->nrows)
+            return 0;
+        if (c->has_nulls && c->nulls.len < (b->nrows + 7) / 8)
+            return 0;
+    }
+    return 1;
+}
+
 static int cdb2_next_record_int(cdb2_hndl_tp *hndl, int shouldretry)
 {
     int len;
@@ -3099,6 +3728,14 @@ static int cdb2_next_record_int(cdb2_hndl_tp *hndl, int shouldretry)
     if (hndl->ack)
         ack(hndl);
 
+    if (hndl->lastresponse && hndl->lastresponse->row_batch &&
+        hndl->batch_row + 1 < hndl->lastresponse->row_batch->nrows) {
+        /* next row of a batch we already have */
+        hndl->batch_row++;
+        hndl->rows_read++;
+        PRINT_AND_RETURN_OK(CDB2_OK);
+    }
+
 retry_next_record:
     if (hndl->first_buf == NULL || hndl->sb == NULL)
         PRINT_AND_RETURN_OK(CDB2_OK_DONE);
@@ -3164,10 +3801,15 @@ retry_next_record:
     }
 
     /* free previous response */
-    if (hndl->lastresponse)
-        cdb2__sqlresponse__free_unpacked(hndl->lastresponse, NULL);
-
-    hndl->lastresponse = cdb2__sqlresponse__unpack(NULL, len, hndl->last_buf);
+    hndl->lastresponse = NULL;
+    cdb2_arena_reset(&hndl->arena);
+
+    hndl->allocator.alloc = cdb2_arena_alloc;
+    hndl->allocator.free = cdb2_arena_free;
+    hndl->allocator.allocator_data = &hndl->arena;
+    hndl->lastresponse =
+        cdb2__sqlresponse__unpack(&hndl->allocator, len, hndl->last_buf);
+    hndl->batch_row = 0;
     debugprint("hndl->lastresponse->response_type=%d\n",
                hndl->lastresponse->response_type);
 
@@ -3178,6 +3820,14 @@ retry_next_record:
     }
 
     if (hndl->lastresponse->response_type == RESPONSE_TYPE__COLUMN_VALUES) {
+        if (hndl->lastresponse->row_batch &&
+            !cdb2_valid_row_batch(hndl, hndl->lastresponse->row_batch)) {
+            newsql_disconnect(hndl, hndl->sb, __LINE__);
+            sprintf(hndl->errstr, "%s: Invalid row batch from server",
+                    __func__);
+            PRINT_AND_RETURN_OK(-1);
+        }
+
         // "Good" rcodes are not retryable
         if (is_retryable(hndl, hndl->lastresponse->error_code) &&
             hndl->snapshot_file) {
@@ -3262,6 +3912,9 @@ int cdb2_next_record(cdb2_hndl_tp *hndl)
         rc = cdb2_next_record_int(hndl, 1);
     }
 
+    if (rc == CDB2_OK_DONE)
+        cdb2_release_idle_connection(hndl);
+
     if (log_calls)
         fprintf(stderr, "%p> cdb2_next_record(%p) = %d\n",
                 (void *)pthread_self(), hndl, rc);
@@ -3407,9 +4060,9 @@ int cdb2_close(cdb2_hndl_tp *hndl)
     }
 
     if (hndl->lastresponse) {
-        cdb2__sqlresponse__free_unpacked(hndl->lastresponse, NULL);
         free((void *)hndl->last_buf);
     }
+    cdb2_arena_destroy(&hndl->arena);
     if (hndl->num_set_commands) {
         while (hndl->num_set_commands) {
             hndl->num_set_commands--;
@@ -3423,6 +4076,12 @@ int cdb2_close(cdb2_hndl_tp *hndl)
     free(hndl->query_hint);
     free(hndl->hint);
     free(hndl->sql);
+    for (int i = 0; i < hndl->nprepared; i++) {
+        free(hndl->prepared[i].sql);
+        free(hndl->prepared[i].hint);
+        free(hndl->prepared[i].query_hint);
+    }
+    free(hndl->prepared);
 
     cdb2_clearbindings(hndl);
     cdb2_free_context_msgs(hndl);
@@ -3553,6 +4212,183 @@ int cdb2_run_statement(cdb2_hndl_tp *hndl, const char *sql)
     return cdb2_run_statement_typed(hndl, sql, 0, NULL);
 }
 
+/* Find the parameter list after the last VALUES of an INSERT, and make sure
+   its parameters are all plain '?', so that repeating it numbers the new
+   ones after the old ones.  Returns the offsets of '(' and ')'. */
+static int cdb2_find_values_row(const char *sql, size_t *start, size_t *end)
+{
+    const char *values = NULL, *p;
+    char quote = 0;
+    int depth = 0;
+
+    for (p = sql; *p; p++) {
+        if (quote) {
+            if (*p == quote)
+                quote = 0;
+        } else if (*p == '\'' || *p == '"' || *p == '`') {
+            quote = *p;
+        } else if (*p == '(') {
+            depth++;
+        } else if (*p == ')') {
+            depth--;
+        } else if (depth == 0 && strncasecmp(p, "values", 6) == 0 &&
+                   (p == sql || !isalnum(p[-1])) && !isalnum(p[6])) {
+            values = p;
+        }
+    }
+    if (values == NULL)
+        return -1;
+
+    p = cdb2_skipws(values + 6);
+    if (*p != '(')
+        return -1;
+    *start = p - sql;
+    for (depth = 0, quote = 0; *p; p++) {
+        if (quote) {
+            if (*p == quote)
+                quote = 0;
+        } else if (*p == '\'' || *p == '"' || *p == '`') {
+            quote = *p;
+        } else if (*p == '@' || *p == ':' || *p == '$' ||
+                   (*p == '?' && isdigit(p[1]))) {
+            return -1;
+        } else if (*p == '(') {
+            depth++;
+        } else if (*p == ')' && --depth == 0) {
+            break;
+        }
+    }
+    if (*p != ')' || *cdb2_skipws(p + 1) == ',')
+        return -1;
+    *end = p - sql;
+    return 0;
+}
+
+/* Run an INSERT ... VALUES (?, ...) for nrows rows at once, bound with
+   cdb2_bind_index in row order, as a single multi-row INSERT. */
+int cdb2_run_statement_rows(cdb2_hndl_tp *hndl, const char *sql, int nrows)
+{
+    size_t start, end, rowlen, len;
+    char *multi, *p;
+    int rc;
+
+    if (nrows <= 1)
+        return cdb2_run_statement(hndl, sql);
+
+    if (cdb2_find_values_row(sql, &start, &end) != 0) {
+        sprintf(hndl->errstr, "%s: Statement needs a single VALUES (...) row "
+                              "of unnumbered parameters",
+                __func__);
+        return CDB2ERR_BADREQ;
+    }
+    rowlen = end - start + 1;
+    len = strlen(sql);
+    if ((multi = malloc(len + (nrows - 1) * (rowlen + 2) + 1)) == NULL) {
+        sprintf(hndl->errstr, "%s: Out of memory", __func__);
+        return CDB2ERR_INTERNAL;
+    }
+    memcpy(multi, sql, end + 1);
+    p = multi + end + 1;
+    for (int i = 1; i < nrows; i++) {
+        memcpy(p, ", ", 2);
+        memcpy(p + 2, sql + start, rowlen);
+        p += rowlen + 2;
+    }
+    strcpy(p, sql + end + 1);
+
+    rc = cdb2_run_statement(hndl, multi);
+    free(multi);
+    return rc;
+}
+
+/* Prepared statements are kept with the handle and get ids from 1.  They
+   are bound and read like any other statement. */
+int cdb2_prepare(cdb2_hndl_tp *hndl, const char *sql, int *stmt_id)
+{
+    struct cdb2_prepared *p = NULL;
+    struct timeval tv;
+    char tag[CNONCE_STR_SZ + 16];
+    int id;
+
+    sql = cdb2_skipws(sql);
+    if (*sql == '\0' || strncasecmp(sql, "set", 3) == 0) {
+        sprintf(hndl->errstr, "%s: Statement can't be prepared", __func__);
+        return CDB2ERR_BADREQ;
+    }
+
+    for (id = 0; id < hndl->nprepared; id++) {
+        if (hndl->prepared[id].sql == NULL)
+            break;
+    }
+    if (id == hndl->nprepared) {
+        p = realloc(hndl->prepared, sizeof(*p) * (id + 1));
+        if (p == NULL) {
+            sprintf(hndl->errstr, "%s: Out of memory", __func__);
+            return CDB2ERR_INTERNAL;
+        }
+        hndl->prepared = p;
+        hndl->nprepared++;
+    }
+    p = &hndl->prepared[id];
+    memset(p, 0, sizeof(*p));
+
+    /* the tag must never name a different statement on the server, even for
+       a later handle at the same address, so it carries the time too */
+    gettimeofday(&tv, NULL);
+    snprintf(tag, sizeof(tag), CNONCE_STR_FMT "%lx-%d", (long)_MACHINE_ID,
+             _PID, (void *)hndl,
+             (unsigned long)(tv.tv_sec * 1000000 + tv.tv_usec), id);
+    if ((p->sql = strdup(sql)) == NULL ||
+        cdb2_query_with_hint(hndl, p->sql, strlen(p->sql), tag, &p->hint,
+                             &p->query_hint) != 0) {
+        free(p->sql);
+        p->sql = NULL;
+        return CDB2ERR_INTERNAL;
+    }
+    *stmt_id = id + 1;
+
+    if (log_calls)
+        fprintf(stderr, "%p> cdb2_prepare(%p, \"%s\") = %d\n",
+                (void *)pthread_self(), hndl, sql, *stmt_id);
+    return 0;
+}
+
+static struct cdb2_prepared *prepared_stmt(cdb2_hndl_tp *hndl, int stmt_id)
+{
+    if (stmt_id < 1 || stmt_id > hndl->nprepared ||
+        hndl->prepared[stmt_id - 1].sql == NULL) {
+        sprintf(hndl->errstr, "Invalid prepared statement id %d", stmt_id);
+        return NULL;
+    }
+    return &hndl->prepared[stmt_id - 1];
+}
+
+int cdb2_run_prepared(cdb2_hndl_tp *hndl, int stmt_id)
+{
+    struct cdb2_prepared *p;
+    int rc;
+
+    if ((p = prepared_stmt(hndl, stmt_id)) == NULL)
+        return CDB2ERR_INVALID_ID;
+    hndl->prepared_id = stmt_id;
+    rc = cdb2_run_statement_typed(hndl, p->sql, 0, NULL);
+    hndl->prepared_id = 0;
+    return rc;
+}
+
+int cdb2_finalize(cdb2_hndl_tp *hndl, int stmt_id)
+{
+    struct cdb2_prepared *p;
+
+    if ((p = prepared_stmt(hndl, stmt_id)) == NULL)
+        return CDB2ERR_INVALID_ID;
+    free(p->sql);
+    free(p->hint);
+    free(p->query_hint);
+    memset(p, 0, sizeof(*p));
+    return 0;
+}
+
 static void parse_dbresponse(CDB2DBINFORESPONSE *dbinfo_response,
                              char valid_hosts[][64], int *valid_ports,
                              int *master_node, int *num_valid_hosts,
@@ -3953,11 +4789,20 @@ static int process_ssl_set_command(cdb2_hndl_tp *hndl, const char *cmd)
         hndl->cache_ssl_sess = (strncasecmp(p, "ON", 2) == 0);
         if (hndl->cache_ssl_sess)
             cdb2_set_ssl_sessions(hndl, cdb2_get_ssl_sessions(hndl));
+    } else if (strncasecmp(p, "SSL_SESSION_SHARE",
+                           sizeof("SSL_SESSION_SHARE") - 1) == 0) {
+        p += sizeof("SSL_SESSION_SHARE");
+        p = cdb2_skipws(p);
+        hndl->share_ssl_sess = (strncasecmp(p, "ON", 2) == 0);
     } else if (strncasecmp(p, SSL_MIN_TLS_VER_OPT,
                            sizeof(SSL_MIN_TLS_VER_OPT) - 1) == 0) {
         p += sizeof(SSL_MIN_TLS_VER_OPT);
         p = cdb2_skipws(p);
         hndl->min_tls_ver = atof(p);
+    } else if (strncasecmp(p, SSL_KTLS_OPT, sizeof(SSL_KTLS_OPT) - 1) == 0) {
+        p += sizeof(SSL_KTLS_OPT);
+        p = cdb2_skipws(p);
+        hndl->ssl_ktls = (strncasecmp(p, "ON", 2) == 0);
     } else {
         rc = -1;
     }
@@ -4111,6 +4956,12 @@ static int cdb2_run_statement_typed_int(cdb2_hndl_tp *hndl, const char *sql,
 
     debugprint("running '%s' from line %d\n", sql, line);
 
+    /* set commands only affect statements sent after them */
+    if (hndl->npipelined && (!sql || strncasecmp(sql, "set", 3) != 0)) {
+        sprintf(hndl->errstr, "%s: Pipelined statements pending", __func__);
+        PRINT_AND_RETURN(CDB2ERR_BADSTATE);
+    }
+
     consume_previous_query(hndl);
     if (!sql)
         return 0;
@@ -4151,7 +5002,20 @@ static int cdb2_run_statement_typed_int(cdb2_hndl_tp *hndl, const char *sql,
     gettimeofday(&tv, NULL);
     hndl->timestampus = ((uint64_t)tv.tv_sec) * 1000000 + tv.tv_usec;
 
-    if (hndl->use_hint) {
+    struct cdb2_prepared *prepared = NULL;
+    if (hndl->prepared_id &&
+        hndl->prepared[hndl->prepared_id - 1].sql == sql) {
+        prepared = &hndl->prepared[hndl->prepared_id - 1];
+        /* a transaction may be replayed on another node, which wouldn't
+           know the hint */
+        if (prepared->sent && !hndl->in_trans &&
+            prepared->misses < CDB2_MAX_PREPARED_MISSES) {
+            sql = prepared->hint;
+            using_hint = 1;
+        } else {
+            sql = prepared->query_hint;
+        }
+    } else if (hndl->use_hint) {
         if (hndl->query && (strcmp(hndl->query, sql) == 0)) {
             sql = hndl->hint;
             using_hint = 1;
@@ -4567,12 +5431,26 @@ read_record:
         }
     }
 
+    if (prepared && hndl->firstresponse->error_code == 0) {
+        if (using_hint)
+            prepared->misses = 0;
+        else
+            prepared->sent = 1;
+    }
+
     if (using_hint) {
         if (hndl->firstresponse->error_code ==
                 CDB2__ERROR_CODE__PREPARE_ERROR_OLD ||
             hndl->firstresponse->error_code ==
                 CDB2__ERROR_CODE__PREPARE_ERROR) {
-            sql = hndl->query;
+            if (prepared) {
+                /* this node doesn't have it cached; send it all again */
+                prepared->misses++;
+                using_hint = 0;
+                sql = prepared->query_hint;
+            } else {
+                sql = hndl->query;
+            }
             hndl->retry_all = 1;
             debugprint("goto retry_queries error_code=%d\n",
                        hndl->firstresponse->error_code);
@@ -4630,6 +5508,8 @@ read_record:
         if (is_retryable(hndl, hndl->firstresponse->error_code) &&
             (hndl->snapshot_file || (!hndl->in_trans && !is_commit) ||
              commit_file)) {
+            if (hndl->firstresponse->error_code == CDB2ERR_REJECTED)
+                note_rejected_host(hndl);
             newsql_disconnect(hndl, hndl->sb, __LINE__);
             hndl->retry_all = 1;
 
@@ -4794,6 +5674,8 @@ int cdb2_run_statement_typed(cdb2_hndl_tp *hndl, const char *sql, int ntypes,
         hndl->temp_trans = 0;
     }
 
+    cdb2_release_idle_connection(hndl);
+
     if (log_calls) {
         if (ntypes == 0)
             fprintf(stderr, "%p> cdb2_run_statement(%p, \"%s\") = %d\n",
@@ -4820,6 +5702,147 @@ after_callback:
     return rc;
 }
 
+/* Pipelined statements: cdb2_send_statement() writes a statement and returns
+ * without reading anything, so several can be in flight on one connection.
+ * The server answers them in order, and cdb2_next_statement() reads the
+ * first response of the oldest one, after which its rows are read with
+ * cdb2_next_record() as usual.  None of this goes through the retry logic of
+ * cdb2_run_statement(): a statement that fails is not rerun, and a broken
+ * connection loses every statement still outstanding on it. */
+int cdb2_send_statement(cdb2_hndl_tp *hndl, const char *sql)
+{
+    int rc;
+
+    sql = cdb2_skipws(sql);
+    if (hndl->in_trans || hndl->is_hasql || hndl->use_hint ||
+        strncasecmp(sql, "set", 3) == 0 || strncasecmp(sql, "begin", 5) == 0 ||
+        strncasecmp(sql, "commit", 6) == 0 ||
+        strncasecmp(sql, "rollback", 8) == 0) {
+        sprintf(hndl->errstr, "%s: Statement can't be pipelined", __func__);
+        PRINT_AND_RETURN(CDB2ERR_BADSTATE);
+    }
+
+    if (hndl->sb == NULL) {
+        cdb2_connect_sqlhost(hndl);
+        if (hndl->sb == NULL) {
+            sprintf(hndl->errstr, "%s: Cannot connect to db", __func__);
+            PRINT_AND_RETURN(CDB2ERR_CONNECT_ERROR);
+        }
+    }
+
+    clear_snapshot_info(hndl, __LINE__);
+    if ((rc = next_cnonce(hndl)) != 0)
+        PRINT_AND_RETURN(rc);
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    hndl->timestampus = ((uint64_t)tv.tv_sec) * 1000000 + tv.tv_usec;
+
+    rc = cdb2_send_query(hndl, hndl, hndl->sb, hndl->dbname, (char *)sql,
+                         hndl->num_set_commands, hndl->num_set_commands_sent,
+                         hndl->commands, hndl->n_bindvars, hndl->bindvars, 0,
+                         NULL, 0, 0, 0, 0, __LINE__);
+    if (rc) {
+        sprintf(hndl->errstr, "%s: Can't send query to the db", __func__);
+        newsql_disconnect(hndl, hndl->sb, __LINE__);
+        PRINT_AND_RETURN(CDB2ERR_IO_ERROR);
+    }
+    hndl->npipelined++;
+    if (log_calls)
+        fprintf(stderr, "%p> cdb2_send_statement(%p, \"%s\") = %d\n",
+                (void *)pthread_self(), hndl, sql, hndl->npipelined);
+    return 0;
+}
+
+/* Read the first response of the oldest pipelined statement, finishing the
+ * rows of the one before it.  Returns like cdb2_run_statement(). */
+int cdb2_next_statement(cdb2_hndl_tp *hndl)
+{
+    int len, rc;
+    int type = 0;
+
+    if (hndl->npipelined == 0) {
+        sprintf(hndl->errstr, "%s: No pipelined statement pending", __func__);
+        PRINT_AND_RETURN(CDB2ERR_NOSTATEMENT);
+    }
+
+    consume_previous_query(hndl);
+    if (hndl->sb == NULL || hndl->npipelined == 0) {
+        sprintf(hndl->errstr, "%s: Connection lost", __func__);
+        PRINT_AND_RETURN(CDB2ERR_IO_ERROR);
+    }
+    hndl->npipelined--;
+    hndl->first_record_read = 0;
+    hndl->ntypes = 0;
+    hndl->types = NULL;
+
+    rc = cdb2_read_record(hndl, &hndl->first_buf, &len, &type);
+    /* ssl upgrades and redirects need the retry logic; the statement has
+     * to be run again with cdb2_run_statement() */
+    if (rc || hndl->first_buf == NULL ||
+        type == RESPONSE_HEADER__SQL_RESPONSE_SSL ||
+        type == RESPONSE_HEADER__DBINFO_RESPONSE ||
+        (hndl->firstresponse = cdb2__sqlresponse__unpack(
+             NULL, len, hndl->first_buf)) == NULL) {
+        sprintf(hndl->errstr, "%s: Can't read response from the db", __func__);
+        newsql_disconnect(hndl, hndl->sb, __LINE__);
+        PRINT_AND_RETURN(CDB2ERR_IO_ERROR);
+    }
+
+    if (hndl->firstresponse->response_type != RESPONSE_TYPE__COLUMN_NAMES) {
+        sprintf(hndl->errstr, "%s: Unknown response type %d", __func__,
+                hndl->firstresponse->response_type);
+        newsql_disconnect(hndl, hndl->sb, __LINE__);
+        PRINT_AND_RETURN(-1);
+    }
+    if (hndl->firstresponse->error_code)
+        PRINT_AND_RETURN(
+            cdb2_convert_error_code(hndl->firstresponse->error_code));
+
+    rc = cdb2_next_record_int(hndl, 0);
+    if (rc == CDB2_OK || rc == CDB2_OK_DONE)
+        rc = 0;
+    else
+        rc = cdb2_convert_error_code(rc);
+    if (log_calls)
+        fprintf(stderr, "%p> cdb2_next_statement(%p) = %d\n",
+                (void *)pthread_self(), hndl, rc);
+    PRINT_AND_RETURN(rc);
+}
+
+int cdb2_pending_statements(cdb2_hndl_tp *hndl)
+{
+    return hndl->npipelined;
+}
+
+/* The socket of the handle, for an event loop to watch for the next
+ * response.  Responses can also be sitting in the handle's read buffer
+ * already, which cdb2_poll_statement() checks. */
+int cdb2_fd(cdb2_hndl_tp *hndl)
+{
+    return hndl->sb ? sbuf2fileno(hndl->sb) : -1;
+}
+
+/* Returns 1 once there is something to read for the next statement, 0 if
+ * none arrived in timeoutms (-1 waits forever), or CDB2ERR_NOTCONNECTED. */
+int cdb2_poll_statement(cdb2_hndl_tp *hndl, int timeoutms)
+{
+    struct pollfd pol;
+    int rc;
+
+    if (hndl->sb == NULL)
+        return CDB2ERR_NOTCONNECTED;
+    if (sbuf2pending(hndl->sb) > 0)
+        return 1;
+    pol.fd = sbuf2fileno(hndl->sb);
+    pol.events = POLLIN;
+    do {
+        rc = poll(&pol, 1, timeoutms);
+    } while (rc == -1 && errno == EINTR);
+    if (rc < 0)
+        return CDB2ERR_NOTCONNECTED;
+    return rc > 0;
+}
+
 int cdb2_numcolumns(cdb2_hndl_tp *hndl)
 {
     int rc;
@@ -4940,8 +5963,32 @@ int cdb2_column_type(cdb2_hndl_tp *hndl, int col)
     return ret;
 }
 
+/* A batch keeps a column's values in the array for its type. NULLs have a
+ * placeholder entry and their bit set in nulls. */
+static const CDB2SQLRESPONSE__Rowbatch__Column *
+cdb2_batch_column(cdb2_hndl_tp *hndl, int col, int *isnull)
+{
+    const CDB2SQLRESPONSE__Rowbatch__Column *c =
+        hndl->lastresponse->row_batch->columns[col];
+    int row = hndl->batch_row;
+    *isnull = c->has_nulls && (c->nulls.data[row / 8] & (1 << (row % 8)));
+    return c;
+}
+
 int cdb2_column_size(cdb2_hndl_tp *hndl, int col)
 {
+    if (hndl->lastresponse && hndl->lastresponse->row_batch) {
+        int isnull;
+        const CDB2SQLRESPONSE__Rowbatch__Column *c =
+            cdb2_batch_column(hndl, col, &isnull);
+        if (isnull)
+            return 0;
+        if (c->n_ints)
+            return sizeof(int64_t);
+        if (c->n_reals)
+            return sizeof(double);
+        return c->values[hndl->batch_row].len;
+    }
     if ((hndl->lastresponse == NULL) || (hndl->lastresponse->value == NULL))
         return -1;
     return hndl->lastresponse->value[col]->value.len;
@@ -4949,6 +5996,21 @@ int cdb2_column_size(cdb2_hndl_tp *hndl, int col)
 
 void *cdb2_column_value(cdb2_hndl_tp *hndl, int col)
 {
+    if (hndl->lastresponse && hndl->lastresponse->row_batch) {
+        int isnull;
+        const CDB2SQLRESPONSE__Rowbatch__Column *c =
+            cdb2_batch_column(hndl, col, &isnull);
+        int row = hndl->batch_row;
+        if (isnull)
+            return NULL;
+        if (c->n_ints)
+            return &c->ints[row];
+        if (c->n_reals)
+            return &c->reals[row];
+        if (c->values[row].len == 0)
+            return (void *)"";
+        return c->values[row].data;
+    }
     if ((hndl->lastresponse == NULL) || (hndl->lastresponse->value == NULL))
         return NULL;
     if (hndl->lastresponse->value[col]->value.len == 0 &&
@@ -5443,7 +6505,111 @@ static inline void only_read_config(cdb2_hndl_tp *hndl)
     set_cdb2_timeouts(hndl);
 }
 
+/* What the last discovery found for each database, so that opening many
+   handles to one database asks comdb2db and dbinfo once rather than once
+   per handle.  A handle that can't connect to any of the hosts forgets the
+   entry and discovers afresh. */
+#define MAX_DBHOSTS_CACHE 16
+static struct {
+    char dbname[DBNAME_LEN];
+    char type[TYPE_LEN];
+    char hosts[MAX_NODES][64];
+    int ports[MAX_NODES];
+    int num_hosts;
+    int num_hosts_sameroom;
+    int master;
+    int dbnum;
+    time_t when;
+} dbhosts_cache[MAX_DBHOSTS_CACHE];
+static pthread_mutex_t dbhosts_cache_lk = PTHREAD_MUTEX_INITIALIZER;
+
+static int dbhosts_cache_find_lk(cdb2_hndl_tp *hndl)
+{
+    for (int i = 0; i < MAX_DBHOSTS_CACHE; i++) {
+        if (strcmp(dbhosts_cache[i].dbname, hndl->dbname) == 0 &&
+            strcmp(dbhosts_cache[i].type, hndl->type) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static int dbhosts_cache_get(cdb2_hndl_tp *hndl)
+{
+    time_t since = time(NULL) - cdb2_dbhosts_cache_secs;
+    int i, rc = -1;
+
+    if (cdb2_dbhosts_cache_secs <= 0)
+        return -1;
+    pthread_mutex_lock(&dbhosts_cache_lk);
+    if ((i = dbhosts_cache_find_lk(hndl)) >= 0 &&
+        dbhosts_cache[i].when > since) {
+        memcpy(hndl->hosts, dbhosts_cache[i].hosts, sizeof(hndl->hosts));
+        memcpy(hndl->ports, dbhosts_cache[i].ports, sizeof(hndl->ports));
+        hndl->num_hosts = dbhosts_cache[i].num_hosts;
+        hndl->num_hosts_sameroom = dbhosts_cache[i].num_hosts_sameroom;
+        hndl->master = dbhosts_cache[i].master;
+        hndl->dbnum = dbhosts_cache[i].dbnum;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&dbhosts_cache_lk);
+    return rc;
+}
+
+static void dbhosts_cache_put(cdb2_hndl_tp *hndl)
+{
+    int i, slot = 0;
+
+    if (cdb2_dbhosts_cache_secs <= 0 || hndl->num_hosts <= 0)
+        return;
+    pthread_mutex_lock(&dbhosts_cache_lk);
+    if ((i = dbhosts_cache_find_lk(hndl)) >= 0) {
+        slot = i;
+    } else {
+        for (i = 0; i < MAX_DBHOSTS_CACHE; i++) {
+            if (dbhosts_cache[i].when < dbhosts_cache[slot].when)
+                slot = i;
+        }
+    }
+    strncpy(dbhosts_cache[slot].dbname, hndl->dbname,
+            sizeof(dbhosts_cache[slot].dbname) - 1);
+    strncpy(dbhosts_cache[slot].type, hndl->type,
+            sizeof(dbhosts_cache[slot].type) - 1);
+    memcpy(dbhosts_cache[slot].hosts, hndl->hosts, sizeof(hndl->hosts));
+    memcpy(dbhosts_cache[slot].ports, hndl->ports, sizeof(hndl->ports));
+    dbhosts_cache[slot].num_hosts = hndl->num_hosts;
+    dbhosts_cache[slot].num_hosts_sameroom = hndl->num_hosts_sameroom;
+    dbhosts_cache[slot].master = hndl->master;
+    dbhosts_cache[slot].dbnum = hndl->dbnum;
+    dbhosts_cache[slot].when = time(NULL);
+    pthread_mutex_unlock(&dbhosts_cache_lk);
+}
+
+static void dbhosts_cache_forget(cdb2_hndl_tp *hndl)
+{
+    int i;
+
+    pthread_mutex_lock(&dbhosts_cache_lk);
+    if ((i = dbhosts_cache_find_lk(hndl)) >= 0)
+        dbhosts_cache[i].when = 0;
+    pthread_mutex_unlock(&dbhosts_cache_lk);
+}
+
+static int cdb2_get_dbhosts_int(cdb2_hndl_tp *hndl);
+
 static int cdb2_get_dbhosts(cdb2_hndl_tp *hndl)
+{
+    if (dbhosts_cache_get(hndl) == 0) {
+        debugprint("using cached hosts for %s/%s\n", hndl->dbname,
+                   hndl->type);
+        return 0;
+    }
+    int rc = cdb2_get_dbhosts_int(hndl);
+    if (rc == 0)
+        dbhosts_cache_put(hndl);
+    return rc;
+}
+
+static int cdb2_get_dbhosts_int(cdb2_hndl_tp *hndl)
 {
     char comdb2db_hosts[MAX_NODES][64];
     int comdb2db_ports[MAX_NODES];
@@ -5880,10 +7046,17 @@ static int set_up_ssl_params(cdb2_hndl_tp *hndl)
     if (hndl->cache_ssl_sess)
         cdb2_set_ssl_sessions(hndl, cdb2_get_ssl_sessions(hndl));
 
+    if ((sslenv = getenv("SSL_SESSION_SHARE")) != NULL)
+        hndl->share_ssl_sess = !!atoi(sslenv);
+    else
+        hndl->share_ssl_sess = cdb2_share_ssl_sess;
+
     if ((sslenv = getenv("SSL_MIN_TLS_VER")) != NULL)
         hndl->min_tls_ver = atof(sslenv);
     else
         hndl->min_tls_ver = cdb2_min_tls_ver;
+
+    hndl->ssl_ktls = cdb2_ssl_ktls;
     if (hndl->cache_ssl_sess)
         cdb2_set_ssl_sessions(hndl, cdb2_get_ssl_sessions(hndl));
 
@@ -5897,7 +7070,9 @@ static int set_up_ssl_params(cdb2_hndl_tp *hndl)
 
     cdb2_nid_dbname = CDB2_NID_DBNAME_DEFAULT;
     cdb2_cache_ssl_sess = CDB2_CACHE_SSL_SESS_DEFAULT;
+    cdb2_share_ssl_sess = CDB2_SHARE_SSL_SESS_DEFAULT;
     cdb2_min_tls_ver = CDB2_MIN_TLS_VER_DEFAULT;
+    cdb2_ssl_ktls = CDB2_SSL_KTLS_DEFAULT;
     return 0;
 }
 
@@ -207,6 +207,12 @@ int cdb2_run_statement(cdb2_hndl_tp *hndl, const char *sql);
 int cdb2_run_statement_typed(cdb2_hndl_tp *hndl, const char *sql, int ntypes,
                              int *types);
 
+int cdb2_send_statement(cdb2_hndl_tp *hndl, const char *sql);
+int cdb2_next_statement(cdb2_hndl_tp *hndl);
+int cdb2_pending_statements(cdb2_hndl_tp *hndl);
+int cdb2_fd(cdb2_hndl_tp *hndl);
+int cdb2_poll_statement(cdb2_hndl_tp *hndl, int timeoutms);
+
 int cdb2_numcolumns(cdb2_hndl_tp *hndl);
 const char *cdb2_column_name(cdb2_hndl_tp *hndl, int col);
 int cdb2_column_type(cdb2_hndl_tp *hndl, int col);
@@ -225,6 +231,10 @@ void cdb2_hndl_set_max_retries(cdb2_hndl_tp *hndl, int max_retries);
 void cdb2_hndl_set_min_retries(cdb2_hndl_tp *hndl, int min_retries);
 
 void cdb2_use_hint(cdb2_hndl_tp *hndl);
+int cdb2_prepare(cdb2_hndl_tp *hndl, const char *sql, int *stmt_id);
+int cdb2_run_prepared(cdb2_hndl_tp *hndl, int stmt_id);
+int cdb2_finalize(cdb2_hndl_tp *hndl, int stmt_id);
+int cdb2_run_statement_rows(cdb2_hndl_tp *hndl, const char *sql, int nrows);
 
 int cdb2_bind_param(cdb2_hndl_tp *hndl, const char *name, int type,
                     const void *varaddr, int length);
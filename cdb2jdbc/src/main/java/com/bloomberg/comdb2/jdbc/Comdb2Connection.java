@@ -59,6 +59,8 @@ public class Comdb2Connection implements Connection {
 
     private boolean usemicrodt = true;
 
+    private boolean batchInTxn = false;
+
     /**
      * -1 indicates the default txn mode.
      */
@@ -267,6 +269,14 @@ public class Comdb2Connection implements Connection {
         hndl.setVerifyRetry(vrfyRetry);
     }
 
+    public void setBatchInTxn(boolean batchInTxn) {
+        this.batchInTxn = batchInTxn;
+    }
+
+    public boolean getBatchInTxn() {
+        return batchInTxn;
+    }
+
     public void setStackAtOpen(boolean sendStack) {
         hndl.hasSendStack = true;
         hndl.setSendStack(sendStack);
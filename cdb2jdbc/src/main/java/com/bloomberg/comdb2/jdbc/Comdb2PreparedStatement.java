@@ -19,6 +19,7 @@ import java.net.URL;
 import java.nio.ByteBuffer;
 import java.sql.*;
 import java.util.ArrayList;
+import java.util.Arrays;
 import java.util.Calendar;
 import java.util.HashMap;
 import java.util.List;
@@ -430,9 +431,35 @@ public class Comdb2PreparedStatement extends Comdb2Statement implements Prepared
 
         int[] results = new int[batch.size()];
 
-        for (int i = 0; i < batch.size(); i++) {
-            intBindVars = batch.get(i);
-            results[i] = executeUpdate();
+        /* Run an autocommit batch as a single transaction: the server doesn't
+           answer the statements of a transaction one by one, so the whole
+           batch is sent back to back and only the commit waits for a reply.
+           It also makes the batch all or nothing, hence opt-in. */
+        boolean inTxn = conn.getBatchInTxn() && conn.getAutoCommit() && batch.size() > 1;
+        if (inTxn)
+            conn.setAutoCommit(false);
+
+        try {
+            for (int i = 0; i < batch.size(); i++) {
+                intBindVars = batch.get(i);
+                results[i] = executeUpdate();
+            }
+            if (inTxn) {
+                conn.commit();
+                /* counts aren't sent back for statements in a transaction */
+                Arrays.fill(results, Statement.SUCCESS_NO_INFO);
+            }
+        } catch (SQLException e) {
+            if (inTxn) {
+                try {
+                    conn.rollback();
+                } catch (SQLException ignored) {
+                }
+            }
+            throw e;
+        } finally {
+            if (inTxn)
+                conn.setAutoCommit(true);
         }
 
         batch = null;
@@ -119,6 +119,7 @@ public class Driver implements java.sql.Driver {
                     new BooleanOption("statement_query_effects", "StatementQueryEffects"));
             options.put("verify_retry", new BooleanOption("verify_retry", "VerifyRetry"));
             options.put("stack_at_open", new BooleanOption("stack_at_open", "StackAtOpen"));
+            options.put("batch_in_txn", new BooleanOption("batch_in_txn", "BatchInTxn"));
         } catch (Throwable e) {
             throw new SQLException(e);
         }
@@ -234,65 +234,104 @@ static uint32_t space_reqd(uint32_t r, uint32_t s)
            (s > 1 ? (varint_need(s) + s) : s);
 }
 
+/* Run detection kernels: return how many leading bytes of a and b match,
+ * looking at no more than n.  A pattern of size sz repeats for as many
+ * whole units as in.dt and in.dt + sz agree, so one kernel serves every
+ * pattern size.  The vector kernels are picked at runtime on first use. */
+typedef size_t (*match_len_fn)(const uint8_t *a, const uint8_t *b, size_t n);
+
+static size_t match_len_scalar(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    uint64_t qa, qb;
+    for (; i + sizeof(qa) <= n; i += sizeof(qa)) {
+        memcpy(&qa, a + i, sizeof(qa));
+        memcpy(&qb, b + i, sizeof(qb));
+        if (qa != qb)
+            break;
+    }
+    while (i < n && a[i] == b[i])
+        ++i;
+    return i;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+
+static size_t match_len_sse2(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+        if (m != 0xffff)
+            return i + __builtin_ctz(~m);
+    }
+    return i + match_len_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t match_len_avx2(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        unsigned m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+        if (m != 0xffffffffU)
+            return i + __builtin_ctz(~m);
+    }
+    return i + match_len_sse2(a + i, b + i, n - i);
+}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+
+static size_t match_len_neon(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t eq = vceqq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        if (vminvq_u8(eq) != 0xff)
+            break;
+    }
+    return i + match_len_scalar(a + i, b + i, n - i);
+}
+#endif
+
+static size_t match_len_pick(const uint8_t *a, const uint8_t *b, size_t n);
+static match_len_fn match_len = match_len_pick;
+
+static match_len_fn match_len_best(void)
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return match_len_avx2;
+    return match_len_sse2;
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    return match_len_neon;
+#else
+    return match_len_scalar;
+#endif
+}
+
+static size_t match_len_pick(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    match_len = match_len_best();
+    return match_len(a, b, n);
+}
+
 /* Check if 'sz' bytes repeat */
 static uint32_t repeats(Data in, uint32_t sz, uint32_t *r_)
 {
-    uint32_t r;
-    r = *r_ = 0;
+    *r_ = 0;
     if (in.sz < (sz * 2))
         return 0;
-    uint8_t *bp, *bx, bt;
-    uint16_t *wp, word;
-    switch (sz) {
-    case 1:
-        bt = *in.dt;        // 1st byte
-        bp = in.dt + sz;    // byte ptr
-        bx = in.dt + in.sz; // byte ptr max
-#ifndef _SUN_SOURCE
-        if (in.sz > 16) {
-            size_t qz = in.sz - in.sz % 8; // # of quads
-            uint64_t qw;
-            memset(&qw, bt, sizeof(qw));             // 1st quad
-            uint64_t *qp = (uint64_t *)in.dt;        // quad ptr
-            uint64_t *qx = (uint64_t *)(in.dt + qz); // quad ptr max
-            while (qp < qx && *qp == qw)
-                ++qp;
-            if ((uint8_t *)qp != in.dt) {
-                if (qp < qx) // last quad != 1st
-                    --qp;
-                bp = (uint8_t *)qp;
-            }
-        }
-#endif
-        // check remainder byte at a time
-        while (bp < bx && *bp == bt)
-            ++bp;
-        r = bp - in.dt - 1;
-        break;
-#ifndef _SUN_SOURCE
-    case 2:
-        word = *(uint16_t *)in.dt;
-        wp = (uint16_t *)(in.dt + sz);
-        in.sz -= (in.sz % sz);
-        while ((in.sz -= sz) != 0 && word == *wp) {
-            ++wp;
-            ++r;
-        }
-        break;
-#endif
-    default:
-        bp = in.dt + sz;
-        in.sz -= (in.sz % sz);
-        while ((in.sz -= sz) != 0) {
-            if (memcmp(in.dt, bp, sz))
-                break;
-            bp += sz;
-            ++r;
-        }
-        break;
-    }
-    *r_ = r;
-    return r;
+    // only whole units of sz bytes count
+    in.sz -= (in.sz % sz);
+    *r_ = match_len(in.dt, in.dt + sz, in.sz - sz) / sz;
+    return *r_;
 }
 
 /* Look for known pattern of size s at d */
@@ -536,31 +575,18 @@ int decompressComdb2RLE(Comdb2RLE *d)
             memset(output.dt, *p, r);
             output.dt += r;
             output.sz -= r;
-        } else
-            for (uint32_t i = 0; i <= r; ++i) {
-                switch (s) {
-                case 9:
-                    output.dt[8] = p[8];
-                    output.dt[7] = p[7];
-                    output.dt[6] = p[6];
-                    output.dt[5] = p[5];
-                case 5:
-                    output.dt[4] = p[4];
-                    output.dt[3] = p[3];
-                case 3:
-                    output.dt[2] = p[2];
-                case 2:
-                    output.dt[1] = p[1];
-                case 1:
-                    output.dt[0] = p[0];
-                    break;
-                default:
-                    memcpy(output.dt, p, s);
-                    break;
-                }
-                output.dt += s;
-                output.sz -= s;
+        } else {
+            // lay down the pattern once, then keep doubling what's written
+            size_t done = s, total = reqd;
+            memcpy(output.dt, p, s);
+            while (done < total) {
+                size_t n = done < total - done ? done : total - done;
+                memcpy(output.dt + done, output.dt, n);
+                done += n;
             }
+            output.dt += total;
+            output.sz -= total;
+        }
     }
     d->outsz = output.dt - d->out;
     return 0;
@@ -75,18 +75,31 @@ uint32_t crc32c_software(const uint8_t* buf, uint32_t sz, uint32_t crc)
 	return crc;
 }
 
-#ifdef __x86_64__
+#if defined(__x86_64__) || defined(__aarch64__)
 
+#ifdef __x86_64__
 #include <smmintrin.h>
 #include <wmmintrin.h>
+#define crc32c_u8(crc, v) _mm_crc32_u8(crc, v)
+#define crc32c_u64(crc, v) _mm_crc32_u64(crc, v)
+#else
+/* ARMv8 has the same instruction, optional before v8.1 */
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define crc32c_u8(crc, v) __crc32cb(crc, v)
+#define crc32c_u64(crc, v) __crc32cd(crc, v)
+#endif
 
 /* Fwd declare available methods to compute crc32c */
-static uint32_t crc32c_sse_pcl(const uint8_t *buf, uint32_t sz, uint32_t crc);
-static uint32_t crc32c_sse(const uint8_t *buf, uint32_t sz, uint32_t crc);
+static uint32_t crc32c_hw(const uint8_t *buf, uint32_t sz, uint32_t crc);
 
 typedef uint32_t(*crc32c_t)(const uint8_t* data, uint32_t size, uint32_t crc);
 static crc32c_t crc32c_func;
 
+#ifdef __x86_64__
+static uint32_t crc32c_sse_pcl(const uint8_t *buf, uint32_t sz, uint32_t crc);
+
 /* Vector type so that we can use pclmul */
 typedef long long v2di __attribute__ ((vector_size(16)));
 
@@ -111,10 +124,10 @@ void crc32c_init(int v)
 				logmsg(LOGMSG_INFO, "crc32c = crc32c_sse_pcl\n");
 			}
 		} else {
-			crc32c_func = crc32c_sse;
+			crc32c_func = crc32c_hw;
 			if (v) {
                 logmsg(LOGMSG_INFO, "SSE 4.2 SUPPORT FOR CRC32C\n");
-				logmsg(LOGMSG_INFO, "crc32c = crc32c_sse\n");
+				logmsg(LOGMSG_INFO, "crc32c = crc32c_hw\n");
 			}
 		}
 	}
@@ -126,6 +139,24 @@ void crc32c_init(int v)
 		}
 	}
 }
+#else
+void crc32c_init(int v)
+{
+	if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+		crc32c_func = crc32c_hw;
+		if (v) {
+			logmsg(LOGMSG_INFO, "ARMV8 CRC32 SUPPORT FOR CRC32C\n");
+			logmsg(LOGMSG_INFO, "crc32c = crc32c_hw\n");
+		}
+	} else {
+		crc32c_func = crc32c_software;
+		if (v) {
+			logmsg(LOGMSG_INFO, "NO HARDWARE SUPPORT FOR CRC32C\n");
+			logmsg(LOGMSG_INFO, "crc32c = crc32c_software\n");
+		}
+	}
+}
+#endif
 
 uint32_t crc32c_comdb2(const uint8_t* buf, uint32_t sz)
 {
@@ -133,7 +164,7 @@ uint32_t crc32c_comdb2(const uint8_t* buf, uint32_t sz)
 }
 
 /* Helper routines */
-static inline uint32_t crc32c_1024_sse_int(const uint8_t *buf, uint32_t crc);
+static inline uint32_t crc32c_1024_hw_int(const uint8_t *buf, uint32_t crc);
 static inline uint32_t crc32c_until_aligned(const uint8_t **buf, uint32_t *sz, uint32_t crc);
 static inline uint32_t crc32c_8s(const uint8_t *buf, uint32_t sz, uint32_t crc);
 
@@ -152,9 +183,9 @@ static inline uint32_t crc32c_8s(const uint8_t *buf, uint32_t sz, uint32_t crc);
 
 // Intel White Paper: Fast CRC Computation for iSCSI Polynomial Using CRC32 Instruction
 #define THREESOME			\
-c1 = _mm_crc32_u64(c1, b1[i]);	\
-c2 = _mm_crc32_u64(c2, b2[i]);	\
-c3 = _mm_crc32_u64(c3, b3[i]);	\
+c1 = crc32c_u64(c1, b1[i]);	\
+c2 = crc32c_u64(c2, b2[i]);	\
+c3 = crc32c_u64(c3, b3[i]);	\
 ++i;
 
 /* Compute chksum processing 8 bytes at a time */
@@ -165,20 +196,20 @@ static inline uint32_t crc32c_8s(const uint8_t *buf, uint32_t sz, uint32_t crc)
 	const uint64_t *b = (uint64_t *) buf;
 	const uint64_t *e = b + (sz / 8);
 	while (b < e) {
-		crc = _mm_crc32_u64(crc, *b);
+		crc = crc32c_u64(crc, *b);
 		++b;
 	}
 	buf = (uint8_t *) b;
 	intptr_t diff = end - buf;
 	int i = 0;
 	switch (diff) {
-	case 7: crc = _mm_crc32_u8(crc, buf[i]); ++i;
-	case 6: crc = _mm_crc32_u8(crc, buf[i]); ++i;
-	case 5: crc = _mm_crc32_u8(crc, buf[i]); ++i;
-	case 4: crc = _mm_crc32_u8(crc, buf[i]); ++i;
-	case 3: crc = _mm_crc32_u8(crc, buf[i]); ++i;
-	case 2: crc = _mm_crc32_u8(crc, buf[i]); ++i;
-	case 1: crc = _mm_crc32_u8(crc, buf[i]); ++i;
+	case 7: crc = crc32c_u8(crc, buf[i]); ++i;
+	case 6: crc = crc32c_u8(crc, buf[i]); ++i;
+	case 5: crc = crc32c_u8(crc, buf[i]); ++i;
+	case 4: crc = crc32c_u8(crc, buf[i]); ++i;
+	case 3: crc = crc32c_u8(crc, buf[i]); ++i;
+	case 2: crc = crc32c_u8(crc, buf[i]); ++i;
+	case 1: crc = crc32c_u8(crc, buf[i]); ++i;
 	}
 	return crc;
 }
@@ -187,7 +218,7 @@ static inline uint32_t crc32c_8s(const uint8_t *buf, uint32_t sz, uint32_t crc)
  * Compute chksum processing 1024 bytes at a time and using
  * lookup tables for recombination
  */
-static uint32_t crc32c_sse(const uint8_t *buf, uint32_t sz, uint32_t crc)
+static uint32_t crc32c_hw(const uint8_t *buf, uint32_t sz, uint32_t crc)
 {
 	crc = crc32c_until_aligned(&buf, &sz, crc);
 	uint32_t i = sz % 1024;
@@ -198,12 +229,13 @@ static uint32_t crc32c_sse(const uint8_t *buf, uint32_t sz, uint32_t crc)
 		i = 0;
 	}
 	while (i < sz) {
-		crc = crc32c_1024_sse_int(&buf[i], crc);
+		crc = crc32c_1024_hw_int(&buf[i], crc);
 		i += 1024;
 	}
 	return crc;
 }
 
+#ifdef __x86_64__
 /*
  * Compute chksum processing 3072 bytes at a time and using
  * PCLMUL for recombination. Use SSE for processing input < 3K.
@@ -228,8 +260,8 @@ static uint32_t crc32c_sse_pcl(const uint8_t *buf, uint32_t sz, uint32_t crc)
 		REPEAT_127(THREESOME);
 
 		// Combine three results
-		x1[0] = _mm_crc32_u64(c1, b1[127]); // block 1 crc
-		x2[0] = _mm_crc32_u64(c2, b2[127]); // block 2 crc
+		x1[0] = crc32c_u64(c1, b1[127]); // block 1 crc
+		x2[0] = crc32c_u64(c2, b2[127]); // block 2 crc
 
 		x1 = _mm_clmulepi64_si128(x1, K, 0x00); // mul by K[0]
 		x2 = _mm_clmulepi64_si128(x2, K, 0x10); // mul by K[1]
@@ -237,14 +269,15 @@ static uint32_t crc32c_sse_pcl(const uint8_t *buf, uint32_t sz, uint32_t crc)
 
 		out = x1[0];    // boring scalar operations
 		out ^= b3[127];
-		out = _mm_crc32_u64(c3, out);
+		out = crc32c_u64(c3, out);
 
 		buf += _3K;
 		sz -= _3K;
 	}
-	if (sz) out = crc32c_sse(buf, sz, out);
+	if (sz) out = crc32c_hw(buf, sz, out);
 	return out;
 }
+#endif
 
 /* Compute chksum 1 byte at a time until input is sizeof(intptr) aligned */
 static inline
@@ -257,13 +290,13 @@ uint32_t crc32c_until_aligned(const uint8_t **buf_, uint32_t *sz_, uint32_t crc)
 	if (adj > sz) adj = sz;
 	int i = 0;
 	switch (adj) {
-	case 7: crc = _mm_crc32_u8(crc, buf[i]); ++i;
-	case 6: crc = _mm_crc32_u8(crc, buf[i]); ++i;
-	case 5: crc = _mm_crc32_u8(crc, buf[i]); ++i;
-	case 4: crc = _mm_crc32_u8(crc, buf[i]); ++i;
-	case 3: crc = _mm_crc32_u8(crc, buf[i]); ++i;
-	case 2: crc = _mm_crc32_u8(crc, buf[i]); ++i;
-	case 1: crc = _mm_crc32_u8(crc, buf[i]); ++i;
+	case 7: crc = crc32c_u8(crc, buf[i]); ++i;
+	case 6: crc = crc32c_u8(crc, buf[i]); ++i;
+	case 5: crc = crc32c_u8(crc, buf[i]); ++i;
+	case 4: crc = crc32c_u8(crc, buf[i]); ++i;
+	case 3: crc = crc32c_u8(crc, buf[i]); ++i;
+	case 2: crc = crc32c_u8(crc, buf[i]); ++i;
+	case 1: crc = crc32c_u8(crc, buf[i]); ++i;
 		sz -= adj;
 		*sz_ = sz;
 		*buf_ = buf + i;
@@ -273,7 +306,7 @@ uint32_t crc32c_until_aligned(const uint8_t **buf_, uint32_t *sz_, uint32_t crc)
 
 /* Compute chksum for 1024 bytes using SSE & recombine using lookup tables */
 #include "crc32c_1024.h"
-static inline uint32_t crc32c_1024_sse_int(const uint8_t *buf, uint32_t crc)
+static inline uint32_t crc32c_1024_hw_int(const uint8_t *buf, uint32_t crc)
 {
 	uint64_t c1, c2, c3, tmp;
 	const uint64_t *b8 = (const uint64_t *) buf;
@@ -282,7 +315,7 @@ static inline uint32_t crc32c_1024_sse_int(const uint8_t *buf, uint32_t crc)
 	const uint64_t *b3 = &b8[85];
 	c2 = c3 = 0;
 
-	c1 = _mm_crc32_u64(crc, b8[0]);
+	c1 = crc32c_u64(crc, b8[0]);
 	int i = 0;
 	REPEAT_42(THREESOME);
 
@@ -299,7 +332,7 @@ static inline uint32_t crc32c_1024_sse_int(const uint8_t *buf, uint32_t crc)
 	tmp ^= ((uint64_t) mul_table1_672[(c1 >> 16) & 0xFF]) << 16;
 	tmp ^= ((uint64_t) mul_table1_672[(c1 >> 24) & 0xFF]) << 24;
 
-	return _mm_crc32_u64(c3, tmp);
+	return crc32c_u64(c3, tmp);
 }
 
-#endif // Intel only
+#endif // Intel and ARM only
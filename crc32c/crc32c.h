@@ -25,7 +25,7 @@ extern "C" {
 
 extern int gbl_crc32c;
 #define CRC32C_SEED 0 //The sparse files with all 0s will get a 0 checksum
-#ifdef __x86_64
+#if defined(__x86_64) || defined(__aarch64__)
 void crc32c_init(int v);
 
 uint32_t crc32c_comdb2(const uint8_t* buf, uint32_t sz);
@@ -209,6 +209,7 @@ extern struct key {
     int exprtype;
     int exprarraysz;
     char *where;
+    char *datacopy; /* comma separated columns of a partial datacopy */
 } * keys[MAXKEYS], *workkey, *rngs[MAXRNGS];
 
 enum KEYFLAGS {
@@ -217,6 +218,7 @@ enum KEYFLAGS {
 
 extern int workkeyflag;         /* work key's flag */
 extern int workkeypieceflag;    /* work key piece's flag */
+extern char *workkeydatacopy;   /* work key's datacopy columns */
 extern int keyixnum[MAXKEYS];   /* index # associated with a key */
 extern int keyexprnum[MAXKEYS]; /* case number associated with a key */
 
@@ -321,6 +323,7 @@ void key_setdup();
 void key_setrecnums(void);
 void key_setprimary(void);
 void key_setdatakey(void);
+void key_add_datacopy(char *column);
 void key_setuniqnulls(void);
 void reset_key_exprtype(void);
 void key_exprtype_add(int type, int arraysz);
@@ -838,6 +838,26 @@ void key_setprimary(void) { workkeyflag |= PRIMARY; }
 
 void key_setdatakey(void) { workkeyflag |= DATAKEY; }
 
+/* used by parser, adds a column to a partial datacopy: datacopy(a, b) */
+void key_add_datacopy(char *column)
+{
+    char *cols;
+    int len = workkeydatacopy ? strlen(workkeydatacopy) : 0;
+
+    CHECK_LEGACY_SCHEMA(1);
+    cols = csc2_malloc(len + strlen(column) + 2);
+    if (cols == NULL) {
+        csc2_error("ERROR: OUT OF MEMORY\n");
+        any_errors++;
+        return;
+    }
+    if (workkeydatacopy)
+        sprintf(cols, "%s,%s", workkeydatacopy, column);
+    else
+        strcpy(cols, column);
+    workkeydatacopy = cols;
+}
+
 void key_setuniqnulls(void)
 {
     CHECK_LEGACY_SCHEMA(1);
@@ -849,6 +869,7 @@ void key_piece_clear() /* used by parser, clears work key */
     workkey = 0;          /* clear work key */
     workkeyflag = 0;      /* clear flag for work key */
     workkeypieceflag = 0; /* clear key piece's flags */
+    workkeydatacopy = NULL; /* clear datacopy columns */
 }
 
 void key_piece_setdescend()
@@ -1042,6 +1063,7 @@ static void key_add_comn(int ix, char *tag, char *exprname,
     } else {
         keys[ii]->where = NULL;
     }
+    keys[ii]->datacopy = workkeydatacopy;
     nkeys++; /* next key */
 }
 
@@ -2561,6 +2583,25 @@ int dyns_is_idx_datacopy(int index)
     return dyns_is_idx_flagged(index, DATAKEY);
 }
 
+/* columns of a partial datacopy key, comma separated; NULL if the key copies
+ * the whole record or no data at all */
+char *dyns_get_idx_datacopy_cols(int index)
+{
+    int lastix = 0, i = 0;
+    if (index < 0 || index >= numix()) {
+        return NULL;
+    }
+    for (lastix = -1, i = 0; i < numkeys(); i++) {
+        if (lastix == keyixnum[i])
+            continue;
+        lastix = keyixnum[i];
+        if (keyixnum[i] != index)
+            continue;
+        return keys[i]->datacopy;
+    }
+    return NULL;
+}
+
 /* is key duplicate? */
 int dyns_is_idx_primary(int index)
 {
@@ -20,6 +20,7 @@ int keyixnum[MAXKEYS];
 int keyexprnum[MAXKEYS];
 int workkeyflag;
 int workkeypieceflag;
+char *workkeydatacopy;
 struct expression expr[EXPRMAX];
 struct expr_table exprtab[EXPRTABMAX];
 int ex_p;
@@ -114,6 +115,7 @@ void init_globals()
     workkey = 0;
     workkeyflag = 0;
     workkeypieceflag = 0;
+    workkeydatacopy = NULL;
     memset(rngs, 0, sizeof(rngs));
     memset(un_start, 0, sizeof(un_start));
     memset(un_end, 0, sizeof(un_end));
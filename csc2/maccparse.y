@@ -436,9 +436,14 @@ keyflags:	T_DUP		{ key_setdup(); }
                 | T_RECNUMS     { key_setrecnums(); }
                 | T_PRIMARY     { key_setprimary(); }
                 | T_DATAKEY     { key_setdatakey(); }
+                | T_DATAKEY '(' datacopycols ')' { key_setdatakey(); }
                 | T_UNIQNULLS   { key_setuniqnulls(); }
 		;
 
+datacopycols:	varname		{ key_add_datacopy($1); }
+		|	datacopycols ',' varname { key_add_datacopy($3); }
+		;
+
 compoundkey:	keypiece
 		|		keypiece '+' compoundkey
 		;
@@ -2206,13 +2206,17 @@ static struct db_state *find_tz(const char *name)
     }
 }
 
-static void add_tz(const char *name, struct db_state *ptr)
+/* returns the copy in the hash, which is never freed */
+static struct db_state *add_tz(const char *name, struct db_state *ptr)
 {
     tz_hash_entry_type *hash_entry_ptr = malloc(sizeof(tz_hash_entry_type));
+    if (hash_entry_ptr == NULL)
+        return ptr;
     memset(&hash_entry_ptr->key, 0, sizeof(hash_entry_ptr->key));
     strncpy0(hash_entry_ptr->key, name, sizeof(hash_entry_ptr->key));
     memcpy(&hash_entry_ptr->db_mem, ptr, sizeof(struct db_state));
     hash_add(tz_hash_tbl, hash_entry_ptr);
+    return &hash_entry_ptr->db_mem;
 }
 
 static int db_tzset(name) register const char *name;
@@ -2250,8 +2254,7 @@ static int db_tzset(name) register const char *name;
                 return -1;
 
             memcpy(&db_lclmem, &state, sizeof(struct db_state));
-            add_tz(name, &db_lclmem);
-            db_lclptr = &db_lclmem;
+            db_lclptr = add_tz(name, &db_lclmem);
         }
     }
 
@@ -2488,17 +2491,103 @@ const db_time_t * const         timeval;
         return db_localsub(timeval, 0L, &tm);
 }
 */
+
+/*
+** Each thread remembers the zone of its last conversion and the span
+** between the two transitions around it, in which the offset is fixed.
+** Converting a time in that span again needs neither the global mutex
+** nor a search of the transitions; result sets mostly hold times close
+** to each other in one zone.
+*/
+struct db_tzcache {
+    char name[NAME_KEY_MAX];
+    const struct db_state *sp; /* in tz_hash_tbl, NULL if nothing cached */
+    db_time_t lo;              /* span is [lo, hi) */
+    db_time_t hi;
+    long gmtoff;
+    int isdst;
+};
+
+static __thread struct db_tzcache db_tzcache;
+
+/* call with global_dt_mutex held, after db_localsub() of t succeeded */
+static void db_tzcache_set(struct db_tzcache *c, const char *name,
+                           db_time_t t)
+{
+    const struct db_state *sp = db_lclptr;
+    int i;
+
+    c->sp = NULL;
+    /* db_lclmem is reloaded by other zones; hashed zones are not */
+    if (sp == &db_lclmem || strlen(name) >= sizeof(c->name))
+        return;
+
+    if (sp->timecnt == 0 || t < sp->ats[0]) {
+        /* before the first transition times repeat every 400 years */
+        if (sp->timecnt && sp->goback)
+            return;
+        i = 0;
+        while (sp->ttis[i].tt_isdst)
+            if (++i >= sp->typecnt) {
+                i = 0;
+                break;
+            }
+        c->lo = LLONG_MIN;
+        c->hi = sp->timecnt ? sp->ats[0] : LLONG_MAX;
+    } else {
+        int lo = 1;
+        int hi = sp->timecnt;
+
+        if (sp->goahead && t > sp->ats[sp->timecnt - 1])
+            return;
+        while (lo < hi) {
+            int mid = (lo + hi) >> 1;
+
+            if (t < sp->ats[mid])
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        i = (int)sp->types[lo - 1];
+        c->lo = sp->ats[lo - 1];
+        if (lo < sp->timecnt)
+            c->hi = sp->ats[lo];
+        else
+            c->hi = sp->goahead ? sp->ats[lo - 1] + 1 : LLONG_MAX;
+    }
+
+    c->gmtoff = sp->ttis[i].tt_gmtoff;
+    c->isdst = sp->ttis[i].tt_isdst;
+    strcpy(c->name, name);
+    c->sp = sp;
+}
+
 int db_time2struct(name, timeval, outtm) register const char *const name;
 const db_time_t *const timeval;
 struct tm *outtm;
 {
+    struct db_tzcache *c = &db_tzcache;
     struct tm *ret = NULL;
 
+    if (c->sp && *timeval >= c->lo && *timeval < c->hi &&
+        strcmp(c->name, name) == 0) {
+        struct tm fast;
+
+        if (db_timesub(timeval, c->gmtoff, c->sp, &fast)) {
+            fast.tm_isdst = c->isdst;
+            memcpy(outtm, &fast, sizeof(struct tm));
+            return 0;
+        }
+    }
+
     Pthread_mutex_lock(&global_dt_mutex);
 
     if (!db_tzset(name)) ret = db_localsub(timeval, 0L, &tm);
 
-    if (ret) memcpy(outtm, ret, sizeof(struct tm));
+    if (ret) {
+        memcpy(outtm, ret, sizeof(struct tm));
+        db_tzcache_set(c, name, *timeval);
+    }
 
     Pthread_mutex_unlock(&global_dt_mutex);
 
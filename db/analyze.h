@@ -66,6 +66,13 @@ int64_t analyze_get_sampled_nrecs(const char *dbname, int ixnum);
  */
 int analyze_table(char *table, SBUF2 *sb, int scale, int override_llmeta);
 
+/**
+ * Update this table's stats from the index sketches kept since it was last
+ * analyzed, without scanning it.  Fails if the sketches don't cover all the
+ * changes or an index has no stats yet; a full analyze is needed then.
+ */
+int analyze_table_incremental(char *table, SBUF2 *sb);
+
 /**
  * Scale and analyze all tables in the database.  Write the results to
  * sqlite_stat1.
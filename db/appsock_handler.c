@@ -23,6 +23,11 @@
  * of this when doing appsock stuff!
  */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
 #include "lockmacros.h"
 #include "util.h"
 #include "comdb2.h"
@@ -59,6 +64,29 @@ int active_appsock_conns = 0;
 
 pthread_mutex_t appsock_conn_lk = PTHREAD_MUTEX_INITIALIZER;
 
+/* Parked connections: idle connections whose handler gave up its thread.
+ * One thread polls them all and hands each back to the pool when it has
+ * something to read, or when it has been idle too long. */
+struct parked_appsock {
+    SBUF2 *sb;
+    int deadline; /* epoch seconds, 0 for none */
+    appsock_resume_fn *resume;
+    void *arg;
+};
+
+typedef struct appsock_resume_args {
+    struct parked_appsock p;
+    int ready;
+} appsock_resume_args_t;
+
+int gbl_appsock_park_ms = 0;
+static pthread_mutex_t park_lk = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t park_once = PTHREAD_ONCE_INIT;
+static struct parked_appsock *parked;
+static int nparked, maxparked;
+static int park_pipe[2] = {-1, -1};
+static unsigned long long total_parked;
+
 /* HASH of all registered appsock handlers (one handler per appsock type) */
 hash_t *gbl_appsock_hash;
 
@@ -118,6 +146,8 @@ void appsock_quick_stat(void)
     logmsg(LOGMSG_USER, "num appsock connections %llu\n", total_appsock_conns);
     logmsg(LOGMSG_USER, "num active appsock connections %d\n",
            active_appsock_conns);
+    logmsg(LOGMSG_USER, "num parked appsock connections %d\n", nparked);
+    logmsg(LOGMSG_USER, "num appsock parks       %llu\n", total_parked);
     logmsg(LOGMSG_USER, "num appsock commands    %llu\n", total_toks);
 }
 
@@ -301,6 +331,161 @@ static void appsock_work_pp(struct thdpool *pool, void *work, void *thddata,
     free(w);
 }
 
+static void appsock_resume_pp(struct thdpool *pool, void *work,
+                              void *thddata, int op)
+{
+    appsock_resume_args_t *w = work;
+    struct appsock_thd_state *state = thddata;
+
+    switch (op) {
+    case THD_RUN:
+        thrman_setfd(state->thr_self, sbuf2fileno(w->p.sb));
+        w->p.resume(state->thr_self, w->p.arg, w->ready);
+        thrman_setfd(state->thr_self, -1);
+        thrman_where(state->thr_self, NULL);
+        if (thrman_get_type(state->thr_self) != THRTYPE_APPSOCK_POOL)
+            thrman_change_type(state->thr_self, THRTYPE_APPSOCK_POOL);
+        break;
+
+    case THD_FREE:
+        w->p.resume(NULL, w->p.arg, 0);
+        break;
+
+    default:
+        abort();
+    }
+    free(w);
+}
+
+/* Returns 0 if the connection is on its way to a pool thread, in which case
+ * the caller removes it from the parked list. */
+static int appsock_unpark(struct parked_appsock *p, int ready)
+{
+    appsock_resume_args_t *w = malloc(sizeof(*w));
+    if (w == NULL)
+        return -1;
+    w->p = *p;
+    w->ready = ready;
+    if (thdpool_enqueue(gbl_appsock_thdpool, appsock_resume_pp, w, 0, NULL,
+                        0) != 0) {
+        /* pool is full; leave it parked and try again next time around */
+        free(w);
+        return -1;
+    }
+    return 0;
+}
+
+static void *appsock_park_thd(void *unused)
+{
+    struct pollfd *fds = NULL;
+    int nfds = 0;
+
+    thread_started("appsock park");
+
+    while (!gbl_exit) {
+        Pthread_mutex_lock(&park_lk);
+        int n = nparked;
+        if (n + 1 > nfds) {
+            nfds = maxparked + 1;
+            fds = realloc(fds, nfds * sizeof(struct pollfd));
+        }
+        fds[0].fd = park_pipe[0];
+        fds[0].events = POLLIN;
+        for (int i = 0; i < n; i++) {
+            fds[i + 1].fd = sbuf2fileno(parked[i].sb);
+            fds[i + 1].events = POLLIN;
+            fds[i + 1].revents = 0;
+        }
+        Pthread_mutex_unlock(&park_lk);
+
+        int rc = poll(fds, n + 1, 1000);
+        if (rc < 0 && errno != EINTR) {
+            logmsg(LOGMSG_ERROR, "%s: poll rc %d errno %d\n", __func__, rc,
+                   errno);
+            sleep(1);
+            continue;
+        }
+        if (rc > 0 && (fds[0].revents & POLLIN)) {
+            char buf[64];
+            while (read(park_pipe[0], buf, sizeof(buf)) > 0)
+                ;
+        }
+
+        /* only this thread removes entries, so the first n are still the
+         * ones polled; new ones were appended behind them */
+        int now = comdb2_time_epoch();
+        Pthread_mutex_lock(&park_lk);
+        for (int i = n - 1; i >= 0; i--) {
+            int ready = rc > 0 && fds[i + 1].revents != 0;
+            if (!ready && (parked[i].deadline == 0 || parked[i].deadline > now))
+                continue;
+            if (appsock_unpark(&parked[i], ready) != 0)
+                continue;
+            parked[i] = parked[--nparked];
+        }
+        Pthread_mutex_unlock(&park_lk);
+    }
+    free(fds);
+    return NULL;
+}
+
+static void appsock_park_init(void)
+{
+    pthread_t tid;
+    if (pipe(park_pipe) != 0) {
+        logmsg(LOGMSG_ERROR, "%s: pipe errno %d\n", __func__, errno);
+        return;
+    }
+    fcntl(park_pipe[0], F_SETFL, fcntl(park_pipe[0], F_GETFL) | O_NONBLOCK);
+    fcntl(park_pipe[1], F_SETFL, fcntl(park_pipe[1], F_GETFL) | O_NONBLOCK);
+    if (pthread_create(&tid, NULL, appsock_park_thd, NULL) != 0) {
+        logmsg(LOGMSG_ERROR, "%s: can't create park thread\n", __func__);
+        close(park_pipe[0]);
+        close(park_pipe[1]);
+        park_pipe[0] = park_pipe[1] = -1;
+        return;
+    }
+    pthread_detach(tid);
+}
+
+/* Give up the calling thread while sb is idle.  resume is called on a pool
+ * thread once sb has something to read (ready = 1), once it has been idle for
+ * idle_secs (ready = 0), or with a NULL thread if the pool is going away; it
+ * owns sb from then on.  Returns non-zero if the connection could not be
+ * parked, and the caller carries on as before. */
+int appsock_park(SBUF2 *sb, int idle_secs, appsock_resume_fn *resume,
+                 void *arg)
+{
+    pthread_once(&park_once, appsock_park_init);
+    if (park_pipe[1] == -1)
+        return -1;
+
+    Pthread_mutex_lock(&park_lk);
+    if (nparked == maxparked) {
+        int n = maxparked ? maxparked * 2 : 64;
+        struct parked_appsock *p = realloc(parked, n * sizeof(*p));
+        if (p == NULL) {
+            Pthread_mutex_unlock(&park_lk);
+            return -1;
+        }
+        parked = p;
+        maxparked = n;
+    }
+    parked[nparked].sb = sb;
+    parked[nparked].deadline =
+        idle_secs > 0 ? comdb2_time_epoch() + idle_secs : 0;
+    parked[nparked].resume = resume;
+    parked[nparked].arg = arg;
+    nparked++;
+    total_parked++;
+    Pthread_mutex_unlock(&park_lk);
+
+    /* wake the park thread to add it to its poll set */
+    if (write(park_pipe[1], "", 1) < 0 && errno != EAGAIN)
+        logmsg(LOGMSG_ERROR, "%s: write errno %d\n", __func__, errno);
+    return 0;
+}
+
 int gbl_appsock_connection_warn_threshold = 80;
 
 void dump_appsock_threads(void)
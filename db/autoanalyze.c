@@ -54,6 +54,7 @@ void reset_aa_counter(char *tblname)
 
     tbl->aa_saved_counter = 0;
     tbl->aa_lastepoch = time(NULL);
+    ixsketch_reset(tbl);
 
     if (save_freq > 0 && thedb->master == gbl_mynode) {
         // save updated counter
@@ -106,7 +107,20 @@ void *auto_analyze_table(void *arg)
     int percent = bdb_attr_get(thedb->bdb_attr, 
                                BDB_ATTR_DEFAULT_ANALYZE_PERCENT);
 
-    if ((rc = analyze_table(tblname, sb, percent, 0)) == 0) {
+    /* fold the index sketches into the stats unless a full analyze is due */
+    struct dbtable *tbl = get_dbtable_by_name(tblname);
+    if (gbl_analyze_incremental && tbl && ixsketch_covers(tbl) &&
+        tbl->aa_incremental_runs < gbl_analyze_incremental_max) {
+        rc = analyze_table_incremental(tblname, sb);
+        if (rc)
+            logmsg(LOGMSG_WARN, "%s: incremental analyze %s failed rc:%d, "
+                                "running a full analyze\n",
+                   __func__, tblname, rc);
+    } else {
+        rc = -1;
+    }
+
+    if (rc == 0 || (rc = analyze_table(tblname, sb, percent, 0)) == 0) {
         reset_aa_counter(tblname);
     } else {
         logmsg(LOGMSG_ERROR, "%s: analyze_table %s failed rc:%d\n", __func__,
@@ -23,4 +23,22 @@ void *auto_analyze_main(void *);
 void *auto_analyze_table(void *);
 void autoanalyze_after_fastinit(char *);
 
+/* Index sketches for incremental analyze (ixsketch.c) */
+struct dbtable;
+struct ixsketch;
+extern int gbl_analyze_incremental;
+extern int gbl_analyze_incremental_max;
+void ixsketch_add(struct dbtable *db, int ixnum, const void *key);
+void ixsketch_del(struct dbtable *db, int ixnum);
+/* Start over, after the table's stats were rebuilt */
+void ixsketch_reset(struct dbtable *db);
+void ixsketch_free(struct ixsketch *sk);
+/* 1 if the sketch has seen every change since the table was analyzed */
+int ixsketch_covers(struct dbtable *db);
+/* Keys added and deleted since the reset, and the distinct values of each
+   key prefix among the added ones.  Returns the number of prefixes, or -1
+   if there is no sketch. */
+int ixsketch_get_stats(struct dbtable *db, int ixnum, int64_t *nadds,
+                       int64_t *ndels, double *distinct, int maxcols);
+
 #endif // INCLUDE_AUTOANALYZE_H
@@ -140,11 +140,15 @@ void berk_memp_sync_alarm_ms(int);
 int gbl_sc_timeoutms = 1000 * 60;
 char gbl_dbname[MAX_DBNAME_LENGTH];
 int gbl_largepages;
+int gbl_region_hugepages = 0;
 int gbl_llmeta_open = 0;
 
 int gbl_sqlite_sortermult = 1;
+int gbl_autoindex_bloom_filter = 1;
 
 int gbl_sqlite_sorter_mem = 300 * 1024 * 1024; /* 300 meg */
+int gbl_sqlite_sorter_prefix_min = 0;
+int gbl_sqlite_sorter_threads = 1;
 
 int gbl_strict_dbl_quotes = 0;
 int gbl_rep_node_pri = 0;
@@ -453,6 +457,9 @@ int gbl_ftables = 0;
 
 /* cdb2 features */
 int gbl_disable_skip_rows = 0;
+int gbl_newsql_row_batch = 0;
+int gbl_newsql_compress = 0;
+int gbl_newsql_compress_min_bytes = 1024;
 
 #if 0
 u_int gbl_blk_pq_shmkey = 0;
@@ -531,6 +538,7 @@ struct quantize *q_sql_steps_hour;
 struct quantize *q_sql_steps_all;
 
 extern int gbl_net_lmt_upd_incoherent_nodes;
+extern int gbl_load_cache_at_startup;
 extern int gbl_allow_user_schema;
 extern int gbl_skip_cget_in_db_put;
 
@@ -755,6 +763,7 @@ extern int gbl_uses_password;
 
 extern int gbl_direct_count;
 extern int gbl_parallel_count;
+extern int gbl_direct_count_cache;
 extern int gbl_debug_sqlthd_failures;
 extern int gbl_random_get_curtran_failures;
 extern int gbl_random_blkseq_replays;
@@ -3357,6 +3366,8 @@ static int create_db(char *dbname, char *dir) {
    return 0;
 }
 
+void __berkdb_lock_heat_named(const char *name, u_int64_t wait_us);
+
 static int init(int argc, char **argv)
 {
     char *dbname, *lrlname = NULL, ctmp[64];
@@ -3373,6 +3384,8 @@ static int init(int argc, char **argv)
 
     dyns_allow_bools();
 
+    gbl_schema_lk_wait_fn = __berkdb_lock_heat_named;
+
     rc = bdb_osql_log_repo_init(&bdberr);
     if (rc) {
         logmsg(LOGMSG_FATAL, "bdb_osql_log_repo_init failed to init log repository "
@@ -3992,6 +4005,9 @@ static int init(int argc, char **argv)
     gbl_backend_opened = 1;
     unlock_schema_lk();
 
+    if (gbl_load_cache_at_startup)
+        create_load_cache_thread(thedb->bdb_env);
+
     sqlinit();
     rc = create_sqlmaster_records(NULL);
     if (rc) {
@@ -5231,6 +5247,10 @@ static void register_all_int_switches()
     register_int_switch("parallel_count",
                         "When 'direct_count' is on, enable thread-per-stripe",
                         &gbl_parallel_count);
+    register_int_switch("direct_count_cache",
+                        "When 'direct_count' is on, reuse the count of data "
+                        "stripes that did not change since",
+                        &gbl_direct_count_cache);
     register_int_switch("debug_sqlthd_failures",
                         "Force sqlthd failures in unusual places",
                         &gbl_debug_sqlthd_failures);
@@ -5322,6 +5342,7 @@ static void handle_resume_sc()
 #define TOOL(x) #x,
 
 #define TOOLS           \
+   TOOL(cdb2_bench)     \
    TOOL(cdb2_dump)      \
    TOOL(cdb2_load)      \
    TOOL(cdb2_printlog)  \
@@ -356,7 +356,8 @@ enum OSQL_RPL_TYPE {
     OSQL_INSIDX = 25, /* new osql type to support indexes on expressions */
     OSQL_DBQ_CONSUME_UUID = 26,
     OSQL_STARTGEN = 27,
-    MAX_OSQL_TYPES = 28
+    OSQL_BATCH = 28, /* several ops for one session in a single message */
+    MAX_OSQL_TYPES = 29
 };
 
 enum DEBUGREQ { DEBUG_METADB_PUT = 1 };
@@ -724,6 +725,8 @@ typedef struct dbtable {
     time_t aa_lastepoch;
     unsigned aa_counter_upd;   // counter which includes updates
     unsigned aa_counter_noupd; // does not include updates
+    struct ixsketch *ixsketch; // changes since analyze, see ixsketch.c
+    int aa_incremental_runs;   // incremental analyzes since a full one
 
     /* Foreign key constraints */
     constraint_t constraints[MAXCONSTRAINTS];
@@ -803,6 +806,7 @@ typedef struct dbtable {
 
     uint64_t sc_nrecs;
     uint64_t sc_prev_nrecs;
+    uint32_t sc_redo_lag; /* commits logical redo has yet to replay */
     unsigned int sqlcur_ix;  /* count how many cursors where open in ix mode */
     unsigned int sqlcur_cur; /* count how many cursors where open in cur mode */
 
@@ -1149,11 +1153,21 @@ struct serial_tbname_hash {
     hash_t *idx_hash;
 };
 
+/* ranges of an index projected onto the first few bytes of the key;
+   a key outside all of them cannot be in any of the ranges */
+struct serial_range_filter {
+    uint64_t lo;
+    uint64_t hi;
+};
+
 struct serial_index_hash {
     int idxnum;
     int size;
     int begin;
     int end;
+    int nprefix; /* key bytes projected into the filter */
+    int nfilter;
+    struct serial_range_filter *filter; /* sorted and disjoint, or NULL */
 };
 
 struct client_query_stats {
@@ -1862,6 +1876,10 @@ int a2req(const char *s);
 void appsock_handler_start(struct dbenv *dbenv, SBUF2 *sb, int is_admin);
 void appsock_coalesce(struct dbenv *dbenv);
 void close_appsock(SBUF2 *sb);
+typedef void appsock_resume_fn(struct thr_handle *thr_self, void *arg,
+                               int ready);
+int appsock_park(SBUF2 *sb, int idle_secs, appsock_resume_fn *resume,
+                 void *arg);
 void thd_stats(void);
 void thd_dbinfo2_stats(struct db_info2_stats *stats);
 void thd_coalesce(struct dbenv *dbenv);
@@ -2308,6 +2326,8 @@ int dat_add_auxdb(int auxdb, struct ireq *iq, void *trans, void *data,
                   int datalen, unsigned long long *genid, int *out_rrn);
 int dat_set(struct ireq *iq, void *trans, void *data, size_t length, int rrn,
             unsigned long long genid);
+/* a genid for a record to be added with dat_set */
+unsigned long long dat_new_genid(struct ireq *iq);
 
 int dat_del(struct ireq *iq, void *trans, int rrn, unsigned long long genid);
 int dat_del_auxdb(int auxdb, struct ireq *iq, void *trans, int rrn,
@@ -2911,6 +2931,20 @@ void reqlog_set_path(struct reqlogger *logger, struct client_query_stats *path);
 void reqlog_set_context(struct reqlogger *logger, int ncontext, char **context);
 void reqlog_set_clnt(struct reqlogger *, struct sqlclntstate *);
 
+/* Per-thread latency histograms of the phases of a request */
+enum {
+    REQL_PHASE_QUEUE,   /* waiting for a sql thread */
+    REQL_PHASE_PREPARE, /* preparing the statement */
+    REQL_PHASE_RUN,     /* running it, after prepare */
+    REQL_PHASE_COMMIT,  /* writing the commit */
+    REQL_PHASE_REPWAIT, /* waiting for replicants to apply it */
+    REQL_PHASE_MAX
+};
+struct hdrhist;
+const char *reqlog_phase_name(int phase);
+void reqlog_phase_record(int phase, uint64_t us);
+void reqlog_phase_get(int phase, struct hdrhist *out);
+
 void process_nodestats(void);
 void nodestats_report(FILE *fh, const char *prefix, int disp_rates);
 void nodestats_node_report(FILE *fh, const char *prefix, int disp_rates,
@@ -3269,6 +3303,7 @@ extern int gbl_new_snapisol_logging;
 extern int gbl_new_snapisol_asof;
 extern int gbl_update_shadows_interval;
 extern int gbl_lowpri_snapisol_sessions;
+extern int gbl_analyze_lowpri;
 
 /* stats */
 /* non-sql request service times (last minute, last hour, since start) */
@@ -3559,7 +3594,10 @@ int table_version_set(tran_type *tran, const char *tablename,
  * Interface between partition roller and schema change */
 int sc_timepart_add_table(const char *existingTableName,
                           const char *newTableName, struct errstat *err);
-int sc_timepart_drop_table(const char *tableName, struct errstat *err);
+int sc_timepart_drop_table(const char *tableName, int schema_locked,
+                           struct errstat *err);
+int sc_timepart_compact_table(const char *tableName, int compress,
+                              struct errstat *err);
 
 /* SCHEMACHANGE DECLARATIONS*/
 
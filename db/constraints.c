@@ -31,6 +31,7 @@
 #include "logmsg.h"
 #include "views.h"
 #include "osqlsqlthr.h"
+#include "plhash.h"
 
 static void *get_constraint_table_cursor(void *table);
 
@@ -42,6 +43,9 @@ static int is_delete_op(int op);
 
 extern int gbl_partial_indexes;
 
+/* most parent keys verify_add_constraints() remembers per transaction */
+int gbl_fk_verified_keys_max = 10000;
+
 /**
  * Checks to see if there are any cascading deleletes/updates pointing to this
  * table
@@ -1264,17 +1268,50 @@ int delayed_key_adds(struct ireq *iq, block_state_t *blkstate, void *trans,
 }
 
 /* go through all entries in ct_add_table and */
-int verify_add_constraints(struct javasp_trans_state *javasp_trans_handle,
-                           struct ireq *iq, block_state_t *blkstate,
-                           void *trans, int *errout)
+/* A parent key found once stays found for the rest of the transaction:
+   we hold its lock and nothing in here deletes it.  Children of the same
+   parent, the usual case in a bulk load, need only the first probe. */
+struct fk_verified {
+    struct dbtable *tbl;
+    int ixnum;
+    int keylen;
+    char key[];
+};
+
+static unsigned int fk_verified_hash(const void *k, int len)
+{
+    const struct fk_verified *v = k;
+    return hash_default_fixedwidth((const unsigned char *)v->key, v->keylen) ^
+           (unsigned int)v->ixnum ^ (unsigned int)(uintptr_t)v->tbl;
+}
+
+static int fk_verified_cmp(const void *k1, const void *k2, int len)
+{
+    const struct fk_verified *v1 = k1, *v2 = k2;
+    if (v1->tbl != v2->tbl || v1->ixnum != v2->ixnum ||
+        v1->keylen != v2->keylen)
+        return 1;
+    return memcmp(v1->key, v2->key, v1->keylen);
+}
+
+static int fk_verified_free(void *obj, void *arg)
+{
+    free(obj);
+    return 0;
+}
+
+static int verify_add_constraints_int(struct ireq *iq, void *trans,
+                                      int *errout, hash_t *verified)
 {
     int rc = 0, fndrrn = 0, opcode = 0, err = 0;
     void *od_dta = NULL;
+    struct fk_verified *probe;
     char ondisk_tag[MAXTAGLEN];
     char key[MAXKEYLEN];
     int nulls;
 
     od_dta = (void *)alloca(20 * 1024 + 8);
+    probe = alloca(sizeof(struct fk_verified) + MAXKEYLEN);
     if (od_dta == NULL) {
         if (iq->debug)
             reqprintf(iq, "VERKYCNSTRT ERROR IN MALLOC");
@@ -1553,12 +1590,31 @@ int verify_add_constraints(struct javasp_trans_state *javasp_trans_handle,
                     currdb = iq->usedb;
                     iq->usedb = ftable;
 
+                    probe->tbl = ftable;
+                    probe->ixnum = fixnum;
+                    probe->keylen = fixlen;
+                    memcpy(probe->key, fkey, fixlen);
+
                     if (should_skip_constraint_for_index(iq, fixnum, nulls))
                         rc = IX_FND;
-                    else
+                    else if (verified && hash_find(verified, probe))
+                        rc = IX_FND;
+                    else {
                         rc = ix_find_by_key_tran(iq, fkey, fixlen, fixnum, key,
                                                  &fndrrn, &genid, NULL, NULL, 0,
                                                  trans);
+                        if ((rc == IX_FND || rc == IX_FNDMORE) && verified &&
+                            hash_get_num_entries(verified) <
+                                gbl_fk_verified_keys_max) {
+                            struct fk_verified *v =
+                                malloc(sizeof(struct fk_verified) + fixlen);
+                            if (v) {
+                                memcpy(v, probe,
+                                       sizeof(struct fk_verified) + fixlen);
+                                hash_add(verified, v);
+                            }
+                        }
+                    }
 
                     iq->usedb = currdb;
 
@@ -1626,6 +1682,24 @@ int verify_add_constraints(struct javasp_trans_state *javasp_trans_handle,
     return ERR_INTERNAL;
 }
 
+int verify_add_constraints(struct javasp_trans_state *javasp_trans_handle,
+                           struct ireq *iq, block_state_t *blkstate,
+                           void *trans, int *errout)
+{
+    hash_t *verified = NULL;
+    int rc;
+
+    if (gbl_fk_verified_keys_max > 0)
+        verified = hash_init_user(fk_verified_hash, fk_verified_cmp, 0,
+                                  sizeof(struct fk_verified));
+    rc = verify_add_constraints_int(iq, trans, errout, verified);
+    if (verified) {
+        hash_for(verified, fk_verified_free, NULL);
+        hash_free(verified);
+    }
+    return rc;
+}
+
 void dump_all_constraints(struct dbenv *env)
 {
     int i = 0;
@@ -14,24 +14,69 @@
    limitations under the License.
  */
 
+#include <limits.h>
+
 #include "cron.h"
 #include "cron_systable.h"
+#include "thdpool.h"
 
 /**
- * Primitive cron job that monitors a ordered list of epoch marked events,
- * each having a callback function associated
+ * Cron job that monitors epoch marked events, each having a callback
+ * function associated
  * Sleep until next event is to be triggered
  *
+ * The pending events of a scheduler sit in a hierarchical timer wheel:
+ * CRON_WHEEL_LEVELS levels of CRON_WHEEL_SLOTS slots, where a slot of a
+ * level spans a whole turn of the level below.  An event goes in the lowest
+ * level whose turn reaches its epoch, so queueing it does not depend on how
+ * many events there are; epochs past the top level wait in an overflow list.
+ * As the scheduler clock moves, the slot of a higher level that comes up is
+ * spread over the levels below, and the events of the slot that comes up in
+ * the lowest level are due.
+ *
+ * Due events run in epoch order on the scheduler thread or, for a parallel
+ * scheduler, on a pool of cron_workers threads, so that a long event does
+ * not hold up the others.  Two events of the same source never run at the
+ * same time.
+ *
  */
 
+#define CRON_WHEEL_BITS 6
+#define CRON_WHEEL_SLOTS (1 << CRON_WHEEL_BITS)
+#define CRON_WHEEL_MASK (CRON_WHEEL_SLOTS - 1)
+#define CRON_WHEEL_LEVELS 5
+
+/* where an event is queued, when not in a wheel slot */
+enum {
+    CRON_SLOT_NONE = -1,
+    CRON_SLOT_READY = -2,
+    CRON_SLOT_RUNNING = -3,
+    CRON_SLOT_OVERFLOW = -4
+};
+
+typedef LISTC_T(struct cron_event) cron_event_list_t;
+
+struct cron_wheel {
+    long long now;  /* current tick; events before it are due */
+    long long next; /* first tick with slots to look at */
+    int count;      /* events in the slots and in the overflow */
+    unsigned long long used[CRON_WHEEL_LEVELS]; /* slots that have events */
+    cron_event_list_t slots[CRON_WHEEL_LEVELS][CRON_WHEEL_SLOTS];
+    cron_event_list_t overflow;
+};
+
 struct cron_sched {
     pthread_t tid; /* pthread id of the thread owning this cron structure */
     pthread_cond_t cond; /* locking and signaling */
     pthread_mutex_t mtx;
-    int running; /* marked under mtx lock, signaling a event processing if set
+    int running; /* marked under mtx lock, number of events being processed
                   */
-    LISTC_T(struct cron_event) events; /* list of events */
-    LINKC_T(struct cron_sched) lnk;    /* link the cron schedulers */
+    struct cron_wheel wheel;    /* pending events */
+    cron_event_list_t ready;    /* due events, in the order they run */
+    cron_event_list_t inflight; /* events being processed */
+    unsigned long long seq;     /* events queued so far */
+    long long wake; /* tick the scheduler thread sleeps until, if it does */
+    LINKC_T(struct cron_sched) lnk; /* link the cron schedulers */
     sched_if_t impl;
 };
 
@@ -43,6 +88,11 @@ typedef struct cron_scheds {
 static cron_scheds_t crons;
 pthread_mutex_t _crons_mtx = PTHREAD_MUTEX_INITIALIZER;
 
+int gbl_cron_workers = 8;
+
+static struct thdpool *cron_thdpool;
+static pthread_once_t cron_thdpool_once = PTHREAD_ONCE_INIT;
+
 static void *_cron_runner(void *arg);
 static int _queue_event(cron_sched_t *sched, int epoch, FCRON func, void *arg1,
                         void *arg2, void *arg3, uuid_t *source_id,
@@ -54,6 +104,21 @@ void init_cron(void)
     Pthread_rwlock_init(&crons.rwlock, NULL);
 }
 
+static void _init_queues(cron_sched_t *sched)
+{
+    int i, j;
+
+    for (i = 0; i < CRON_WHEEL_LEVELS; i++)
+        for (j = 0; j < CRON_WHEEL_SLOTS; j++)
+            listc_init(&sched->wheel.slots[i][j],
+                       offsetof(struct cron_event, lnk));
+    listc_init(&sched->wheel.overflow, offsetof(struct cron_event, lnk));
+    listc_init(&sched->ready, offsetof(struct cron_event, lnk));
+    listc_init(&sched->inflight, offsetof(struct cron_event, lnk));
+    sched->wheel.next = LLONG_MAX;
+    sched->wake = LLONG_MIN;
+}
+
 /**
  * Add a new event to a scheduler.
  * Create a scheduler if none exists yet
@@ -80,7 +145,7 @@ cron_sched_t *cron_add_event(cron_sched_t *sched, const char *name, int epoch,
 
         Pthread_mutex_init(&sched->mtx, NULL);
         Pthread_cond_init(&sched->cond, NULL);
-        listc_init(&sched->events, offsetof(struct cron_event, lnk));
+        _init_queues(sched);
         if (!impl) {
             /* default to a time based cron */
             time_cron_create(&sched->impl, NULL, NULL);
@@ -95,6 +160,9 @@ cron_sched_t *cron_add_event(cron_sched_t *sched, const char *name, int epoch,
         }
 
         sched->impl.sched = sched;
+        sched->wheel.now = sched->impl.clock(&sched->impl);
+        if (sched->wheel.now < 0)
+            sched->wheel.now = 0;
 
         Pthread_rwlock_wrlock(&crons.rwlock);
         listc_abl(&crons.scheds, sched);
@@ -148,44 +216,191 @@ static void _set_event(cron_event_t *event, int epoch, FCRON func, void *arg1,
     event->schedif = &sched->impl;
 }
 
-static void _insert_ordered_event(cron_sched_t *sched, cron_event_t *event)
+/* due events run by epoch, and in the order they were queued */
+static int _event_before(const cron_event_t *a, const cron_event_t *b)
+{
+    return a->epoch < b->epoch || (a->epoch == b->epoch && a->seq < b->seq);
+}
+
+static cron_event_list_t *_slot_list(cron_sched_t *sched, int slot)
+{
+    switch (slot) {
+    case CRON_SLOT_READY:
+        return &sched->ready;
+    case CRON_SLOT_RUNNING:
+        return &sched->inflight;
+    case CRON_SLOT_OVERFLOW:
+        return &sched->wheel.overflow;
+    default:
+        return &sched->wheel.slots[slot / CRON_WHEEL_SLOTS]
+                                  [slot % CRON_WHEEL_SLOTS];
+    }
+}
+
+/* lists of the queued events, the ready ones first; NULL past the last */
+static cron_event_list_t *_queue_list(cron_sched_t *sched, int i)
+{
+    if (i == 0)
+        return &sched->ready;
+    if (i == 1)
+        return &sched->wheel.overflow;
+    i -= 2;
+    if (i >= CRON_WHEEL_LEVELS * CRON_WHEEL_SLOTS)
+        return NULL;
+    return &sched->wheel.slots[i / CRON_WHEEL_SLOTS][i % CRON_WHEEL_SLOTS];
+}
+
+/* take an event off whatever list has it */
+static void _unlink_event(cron_sched_t *sched, cron_event_t *event)
+{
+    cron_event_list_t *list;
+
+    if (event->slot == CRON_SLOT_NONE)
+        return;
+
+    list = _slot_list(sched, event->slot);
+    listc_rfl(list, event);
+    if (event->slot >= 0 || event->slot == CRON_SLOT_OVERFLOW)
+        sched->wheel.count--;
+    if (event->slot >= 0 && list->count == 0)
+        sched->wheel.used[event->slot / CRON_WHEEL_SLOTS] &=
+            ~(1ULL << (event->slot % CRON_WHEEL_SLOTS));
+    event->slot = CRON_SLOT_NONE;
+}
+
+static void _ready_event(cron_sched_t *sched, cron_event_t *event)
 {
-    LISTC_T(struct cron_event) tmpsched;
     cron_event_t *crt;
 
-    listc_init(&tmpsched, offsetof(struct cron_event, lnk));
+    /* events come off the wheel in order, so this mostly appends */
+    for (crt = sched->ready.bot; crt && _event_before(event, crt);
+         crt = crt->lnk.prev)
+        ;
+    if (crt)
+        listc_add_after(&sched->ready, event, crt);
+    else
+        listc_atl(&sched->ready, event);
+    event->slot = CRON_SLOT_READY;
+}
 
-    /* add all older records that preceed current event */
-    while ((crt = sched->events.top) != NULL) {
-        if (crt->epoch <= event->epoch) {
-            listc_rfl(&sched->events, crt);
-            listc_atl(&tmpsched, crt); /* ! reversed order */
-        } else {
+static void _wheel_add(cron_sched_t *sched, cron_event_t *event)
+{
+    struct cron_wheel *wheel = &sched->wheel;
+    long long delta = (long long)event->epoch - wheel->now;
+    long long tick;
+    int level, shift, idx;
+
+    if (delta < 0) {
+        _ready_event(sched, event);
+        return;
+    }
+
+    wheel->count++;
+    for (level = 0; level < CRON_WHEEL_LEVELS; level++) {
+        if (delta < (1LL << (CRON_WHEEL_BITS * (level + 1))))
             break;
-        }
     }
+    if (level == CRON_WHEEL_LEVELS) {
+        listc_abl(&wheel->overflow, event);
+        event->slot = CRON_SLOT_OVERFLOW;
+        shift = CRON_WHEEL_BITS * CRON_WHEEL_LEVELS;
+        tick = ((wheel->now >> shift) + 1) << shift;
+    } else {
+        shift = CRON_WHEEL_BITS * level;
+        idx = (event->epoch >> shift) & CRON_WHEEL_MASK;
+        listc_abl(&wheel->slots[level][idx], event);
+        wheel->used[level] |= 1ULL << idx;
+        event->slot = level * CRON_WHEEL_SLOTS + idx;
+        /* the tick its slot comes up at */
+        tick = ((long long)event->epoch >> shift) << shift;
+    }
+    if (tick < wheel->next)
+        wheel->next = tick;
+}
 
-    /* NOTE: make sure the event is unique, i.e. only one set
-       of parameters */
-    if (!sched->events.top ||
-        (memcmp(event, sched->events.top, sizeof(*event)) != 0)) {
-        /* add new event, anything left in sched queue follows new event */
-        listc_atl(&sched->events, event);
+/* queue again the events of a slot, from the current tick */
+static void _wheel_spread(cron_sched_t *sched, cron_event_list_t *list)
+{
+    cron_event_list_t tmp;
+    cron_event_t *event;
+
+    listc_init(&tmp, offsetof(struct cron_event, lnk));
+    while ((event = list->top) != NULL) {
+        _unlink_event(sched, event);
+        listc_abl(&tmp, event);
     }
+    while ((event = listc_rtl(&tmp)) != NULL)
+        _wheel_add(sched, event);
+}
 
-    /* add all older events */
-    while ((crt = tmpsched.top) != NULL) {
-        listc_rfl(&tmpsched, crt);
-        listc_atl(&sched->events, crt); /* now order is proper again */
+/* the first tick after the current one with something to do: a slot of
+   the lowest level with events, a slot of a higher level to spread, or the
+   end of a turn of a level that has events for its next turn */
+static long long _wheel_next_tick(struct cron_wheel *wheel)
+{
+    long long next = LLONG_MAX;
+    long long tick, base;
+    unsigned long long later;
+    int level, shift, idx;
+
+    for (level = 0; level < CRON_WHEEL_LEVELS; level++) {
+        if (!wheel->used[level])
+            continue;
+        shift = CRON_WHEEL_BITS * level;
+        idx = (wheel->now >> shift) & CRON_WHEEL_MASK;
+        base = (wheel->now >> shift) - idx;
+        later = wheel->used[level] & ~((2ULL << idx) - 1);
+        if (later)
+            tick = (base + __builtin_ctzll(later)) << shift;
+        else
+            tick = (base + CRON_WHEEL_SLOTS) << shift;
+        if (tick < next)
+            next = tick;
+    }
+    if (wheel->overflow.count) {
+        shift = CRON_WHEEL_BITS * CRON_WHEEL_LEVELS;
+        tick = ((wheel->now >> shift) + 1) << shift;
+        if (tick < next)
+            next = tick;
     }
+    return next;
+}
 
-    /* THIS MUST BE CALLED UNDER sched->mtx, guaranteed if called from callback
-     */
-    if (sched->events.top == event) {
-        /* new event at the top of the list,
-           notify cron to pick up the event */
-        Pthread_cond_signal(&sched->cond);
+/* turn the wheel up to clock, readying the events that are due */
+static void _wheel_advance(cron_sched_t *sched, long long clock)
+{
+    struct cron_wheel *wheel = &sched->wheel;
+    cron_event_t *event;
+    int level, shift, idx;
+
+    while (wheel->count > 0 && wheel->next <= clock) {
+        wheel->now = wheel->next;
+
+        /* spread from the top down, a higher slot can feed a lower one */
+        shift = CRON_WHEEL_BITS * CRON_WHEEL_LEVELS;
+        if ((wheel->now & ((1LL << shift) - 1)) == 0)
+            _wheel_spread(sched, &wheel->overflow);
+        for (level = CRON_WHEEL_LEVELS - 1; level > 0; level--) {
+            shift = CRON_WHEEL_BITS * level;
+            if (wheel->now & ((1LL << shift) - 1))
+                continue;
+            idx = (wheel->now >> shift) & CRON_WHEEL_MASK;
+            if (wheel->used[level] & (1ULL << idx))
+                _wheel_spread(sched, &wheel->slots[level][idx]);
+        }
+
+        idx = wheel->now & CRON_WHEEL_MASK;
+        while ((event = wheel->slots[0][idx].top) != NULL) {
+            _unlink_event(sched, event);
+            _ready_event(sched, event);
+        }
+
+        wheel->next = _wheel_next_tick(wheel);
     }
+    if (wheel->count == 0)
+        wheel->next = LLONG_MAX;
+    if (wheel->now <= clock)
+        wheel->now = clock + 1;
 }
 
 static int _queue_event(cron_sched_t *sched, int epoch, FCRON func, void *arg1,
@@ -207,6 +422,8 @@ static int _queue_event(cron_sched_t *sched, int epoch, FCRON func, void *arg1,
 
     /* A new event is born */
     _set_event(event, epoch, func, arg1, arg2, arg3, sched);
+    event->seq = sched->seq++;
+    event->slot = CRON_SLOT_NONE;
 
     if (source_id) {
         comdb2uuidcpy(event->source_id, *source_id);
@@ -214,14 +431,21 @@ static int _queue_event(cron_sched_t *sched, int epoch, FCRON func, void *arg1,
         comdb2uuid_clear(event->source_id);
     }
 
-    _insert_ordered_event(sched, event);
+    _wheel_add(sched, event);
+
+    /* THIS MUST BE CALLED UNDER sched->mtx, guaranteed if called from callback
+     */
+    if (event->slot == CRON_SLOT_READY || sched->wheel.next < sched->wake) {
+        /* due before the cron wakes up, notify cron to pick up the event */
+        Pthread_cond_broadcast(&sched->cond);
+    }
 
     return err->errval = CRON_NOERR;
 }
 
 static void _destroy_event(cron_sched_t *sched, cron_event_t *event)
 {
-    listc_rfl(&sched->events, event);
+    _unlink_event(sched, event);
     if (event->arg1)
         free(event->arg1);
     if (event->arg2)
@@ -231,6 +455,129 @@ static void _destroy_event(cron_sched_t *sched, cron_event_t *event)
     free(event);
 }
 
+/* done with a running event; "xerr" is NULL if it was dropped unrun */
+static void _finish_event(cron_sched_t *sched, cron_event_t *event,
+                          struct errstat *xerr)
+{
+    Pthread_mutex_lock(&sched->mtx);
+    if (xerr && xerr->errval)
+        logmsg(LOGMSG_ERROR, "Schedule %s error event %d rc=%d errstr=%s\n",
+               (sched->impl.name) ? sched->impl.name : "(noname)",
+               event->epoch, xerr->errval, xerr->errstr);
+    _destroy_event(sched, event);
+    sched->running--;
+    /* wakes the scheduler for events of the same source, and cron_lock */
+    Pthread_cond_broadcast(&sched->cond);
+    Pthread_mutex_unlock(&sched->mtx);
+}
+
+static void _run_event(cron_sched_t *sched, cron_event_t *event)
+{
+    struct errstat xerr;
+
+    bzero(&xerr, sizeof(xerr));
+    event->func(event, &xerr);
+    _finish_event(sched, event, &xerr);
+}
+
+static void _cron_event_pp(struct thdpool *pool, void *work, void *thddata,
+                           int op)
+{
+    cron_event_t *event = work;
+    cron_sched_t *sched = event->schedif->sched;
+
+    switch (op) {
+    case THD_RUN:
+        _run_event(sched, event);
+        break;
+    case THD_FREE:
+        _finish_event(sched, event, NULL);
+        break;
+    }
+}
+
+static void cron_thdpool_init(void)
+{
+    cron_thdpool = thdpool_create("cronpool", 0);
+
+    if (gbl_exit_on_pthread_create_fail)
+        thdpool_set_exit(cron_thdpool);
+
+    thdpool_set_minthds(cron_thdpool, 0);
+    thdpool_set_maxthds(cron_thdpool, gbl_cron_workers);
+    thdpool_set_maxqueue(cron_thdpool, 1000);
+    thdpool_set_linger(cron_thdpool, 30);
+}
+
+/* kickoff events, queued at INT_MIN, set up the scheduler thread itself */
+static int _run_on_pool(cron_sched_t *sched, cron_event_t *event)
+{
+    return sched->impl.parallel && gbl_cron_workers > 0 &&
+           event->epoch != INT_MIN;
+}
+
+/* an event waits while another of its source runs */
+static int _source_running(cron_sched_t *sched, cron_event_t *event)
+{
+    cron_event_t *crt;
+
+    if (comdb2uuid_is_zero(event->source_id))
+        return 0;
+    LISTC_FOR_EACH(&sched->inflight, crt, lnk)
+    {
+        if (comdb2uuidcmp(crt->source_id, event->source_id) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * Start the due events, in order
+ * NOTE: we don't need to keep the scheduler lock while an event runs!
+ * The event is off the queues, on the inflight list, so the queues can
+ * change in the meantime.  This prevents callbacks that acquire resources
+ * locks from deadlocking with other resource threads that try to schedule
+ * an event.  The running count keeps out cron_lock callers until done.
+ *
+ */
+static void _run_ready(cron_sched_t *sched, long long clock)
+{
+    cron_event_t *event, *tmp;
+    int pool;
+
+again:
+    LISTC_FOR_EACH_SAFE(&sched->ready, event, tmp, lnk)
+    {
+        if (event->epoch > clock)
+            break;
+        if (_source_running(sched, event))
+            continue;
+        pool = _run_on_pool(sched, event);
+        if (pool && sched->running >= gbl_cron_workers)
+            break;
+
+        _unlink_event(sched, event);
+        listc_abl(&sched->inflight, event);
+        event->slot = CRON_SLOT_RUNNING;
+        sched->running++;
+        Pthread_mutex_unlock(&sched->mtx);
+
+        if (pool) {
+            pthread_once(&cron_thdpool_once, cron_thdpool_init);
+            if (thdpool_enqueue(cron_thdpool, _cron_event_pp, event, 0, NULL,
+                                0) != 0)
+                pool = 0;
+        }
+        /* lets do it */
+        if (!pool)
+            _run_event(sched, event);
+
+        Pthread_mutex_lock(&sched->mtx);
+        /* the queue could have changed while unlocked */
+        goto again;
+    }
+}
+
 /**
  * Regular wake up and run job
  * Function is meant to be used with pthread_create
@@ -242,66 +589,42 @@ static void *_cron_runner(void *arg)
 {
     cron_sched_t *sched = (cron_sched_t *)arg;
     cron_event_t *event;
+    long long clock, next;
+    int epoch;
     int rc;
-    struct errstat xerr;
-    int locked;
 
     if (!sched) {
         logmsg(LOGMSG_ERROR, "%s: NULL schedule!\n", __func__);
         return NULL;
     }
 
-    locked = 0;
+    Pthread_mutex_lock(&sched->mtx);
     while (!gbl_exit && !db_is_stopped()) {
-        Pthread_mutex_lock(&sched->mtx);
-        locked = 1;
-
-        while ((event = sched->events.top) != NULL) {
-            if (sched->impl.is_exec_time(&sched->impl, event)) {
-                bzero(&xerr, sizeof(xerr));
-
-                /* lets do it */
-                /* NOTE: we don't need to keep the scheduler lock here!
-                   The event pointer should be stable, but the list can change
-                   in the
-                   meantime.  This prevents callbacks that acquire resources
-                   locks from
-                   deadlocking with other resource threads that try to schedule
-                   an event
-                   We mark the cron job as working, to exclude access to top
-                   event to any other thread !!!
-                   */
-                sched->running = 1;
-                Pthread_mutex_unlock(&sched->mtx);
-                event->func(event, &xerr);
-                Pthread_mutex_lock(&sched->mtx);
-                sched->running = 0;
-
-                if (xerr.errval)
-                    logmsg(LOGMSG_ERROR,
-                           "Schedule %s error event %d rc=%d errstr=%s\n",
-                           (sched->impl.name) ? sched->impl.name : "(noname)",
-                           event->epoch, xerr.errval, xerr.errstr);
-                _destroy_event(sched, event);
-            } else {
-                break;
-            }
-        }
-
-        rc = sched->impl.wait_next_event(&sched->impl, event);
+        clock = sched->impl.clock(&sched->impl);
+        _wheel_advance(sched, clock);
+        _run_ready(sched, clock);
+
+        /* sleep until the wheel has work, or until a due event that is
+           held back can go, which a running event signals when done */
+        next = sched->wheel.next;
+        if ((event = sched->ready.top) != NULL && event->epoch > clock &&
+            event->epoch < next)
+            next = event->epoch;
+        if (next > INT_MAX)
+            next = LLONG_MAX;
+        epoch = (int)next;
+
+        sched->wake = next;
+        rc = sched->impl.wait_next_event(&sched->impl,
+                                         (next != LLONG_MAX) ? &epoch : NULL);
+        sched->wake = LLONG_MIN;
         if (rc && rc != ETIMEDOUT) {
             logmsg(LOGMSG_ERROR, "%s: bad pthread_cond_timedwait rc=%d\n",
                    __func__, rc);
             break;
         }
-
-        Pthread_mutex_unlock(&sched->mtx);
-        locked = 0;
-    }
-
-    if (locked) {
-        Pthread_mutex_unlock(&sched->mtx);
     }
+    Pthread_mutex_unlock(&sched->mtx);
 
     logmsg(LOGMSG_DEBUG, "Exiting cron job for %s\n", sched->impl.name);
     return NULL;
@@ -324,38 +647,46 @@ void cron_signal_worker(cron_sched_t *sched)
  * Update the next event arguments for a specific event
  * NOTE:
  * Since this can race with an actual exection, the function
- * wait if it tries to update the first to run event while the
- * event is under processing!
- * Events not at the top of the list are safe to update since
- * the cron thread cannot access the queue until this is done
+ * wait if it tries to update while events are under processing!
+ * Queued events are safe to update since the cron thread cannot
+ * access the queue until this is done
  *
  */
 int cron_update_event(cron_sched_t *sched, int epoch, FCRON func, void *arg1,
                       void *arg2, void *arg3, uuid_t source_id,
                       struct errstat *err)
 {
+    cron_event_list_t found;
+    cron_event_list_t *list;
     cron_event_t *event = NULL, *tmp = NULL;
-    int found = 0;
-
-    cron_lock(sched);
+    int i;
 
-    LISTC_FOR_EACH_SAFE(&sched->events, event, tmp, lnk)
-    {
-        if (comdb2uuidcmp(event->source_id, source_id) == 0) {
+    listc_init(&found, offsetof(struct cron_event, lnk));
 
-            /* we can process this */
-            _set_event(event, epoch, func, arg1, arg2, arg3, sched);
+    cron_lock(sched);
 
-            /* remote the event, and reinsert it in the new position */
-            listc_rfl(&sched->events, event);
-            _insert_ordered_event(sched, event);
-            found = 1;
+    for (i = 0; (list = _queue_list(sched, i)) != NULL; i++) {
+        LISTC_FOR_EACH_SAFE(list, event, tmp, lnk)
+        {
+            if (comdb2uuidcmp(event->source_id, source_id) == 0) {
+                /* remove the event, and reinsert it in the new position */
+                _unlink_event(sched, event);
+                listc_abl(&found, event);
+            }
         }
     }
+    i = found.count;
+    while ((event = listc_rtl(&found)) != NULL) {
+        /* we can process this */
+        _set_event(event, epoch, func, arg1, arg2, arg3, sched);
+        _wheel_add(sched, event);
+    }
+    if (i)
+        Pthread_cond_broadcast(&sched->cond);
 
     cron_unlock(sched);
 
-    return (found) ? CRON_NOERR : CRON_ERR_EXIST;
+    return (i) ? CRON_NOERR : CRON_ERR_EXIST;
 }
 
 /**
@@ -364,13 +695,17 @@ int cron_update_event(cron_sched_t *sched, int epoch, FCRON func, void *arg1,
  */
 void cron_clear_queue(cron_sched_t *sched)
 {
+    cron_event_list_t *list;
     cron_event_t *event;
+    int i;
 
     cron_lock(sched);
 
     /* mop up */
-    while ((event = sched->events.top))
-        _destroy_event(sched, event);
+    for (i = 0; (list = _queue_list(sched, i)) != NULL; i++) {
+        while ((event = list->top))
+            _destroy_event(sched, event);
+    }
 
     cron_unlock(sched);
 }
@@ -451,7 +786,7 @@ int cron_systable_schedulers_collect(void **data, int *nrecords)
         arr[narr].name = strdup(sched->impl.name);
         arr[narr].type = strdup(cron_type_to_name(sched->impl.type));
         arr[narr].running = sched->running;
-        arr[narr].nevents = sched->events.count;
+        arr[narr].nevents = sched->wheel.count + sched->ready.count;
         arr[narr].description = sched->impl.describe
                                     ? sched->impl.describe(&sched->impl)
                                     : strdup("");
@@ -481,22 +816,52 @@ void cron_systable_schedulers_free(void *arr, int nrecords)
     free(arr);
 }
 
+static int _event_cmp(const void *a, const void *b)
+{
+    const cron_event_t *x = *(const cron_event_t **)a;
+    const cron_event_t *y = *(const cron_event_t **)b;
+
+    return _event_before(x, y) ? -1 : _event_before(y, x) ? 1 : 0;
+}
+
 int cron_systable_sched_events_collect(cron_sched_t *sched,
                                        systable_cron_events_t **parr,
                                        int *nrecords, int *pnsize)
 {
     systable_cron_events_t *arr = *parr, *temparr;
     int narr = *nrecords;
+    cron_event_list_t *list;
+    cron_event_t **events = NULL;
     cron_event_t *event;
     int nsize = *pnsize;
+    int nevents = 0;
+    int count;
     int rc = 0;
+    int i;
     uuidstr_t us;
 
     cron_lock(sched);
-    LISTC_FOR_EACH(&sched->events, event, lnk)
-    {
-        if ((narr + sched->events.count) >= nsize) {
-            nsize += sched->events.count;
+
+    /* the wheel keeps no order between slots; list the events by epoch */
+    count = sched->wheel.count + sched->ready.count;
+    if (count && !(events = malloc(count * sizeof(cron_event_t *)))) {
+        logmsg(LOGMSG_ERROR, "%s OOM %lu!\n", __func__,
+               count * sizeof(cron_event_t *));
+        rc = -1;
+        goto done;
+    }
+    for (i = 0; (list = _queue_list(sched, i)) != NULL; i++) {
+        LISTC_FOR_EACH(list, event, lnk)
+        {
+            events[nevents++] = event;
+        }
+    }
+    qsort(events, nevents, sizeof(cron_event_t *), _event_cmp);
+
+    for (i = 0; i < nevents; i++) {
+        event = events[i];
+        if ((narr + count) >= nsize) {
+            nsize += count;
             temparr = realloc(arr, sizeof(systable_cron_events_t) * nsize);
             if (!temparr) {
                 logmsg(LOGMSG_ERROR, "%s OOM %lu!\n", __func__,
@@ -522,6 +887,7 @@ int cron_systable_sched_events_collect(cron_sched_t *sched,
     }
 done:
     cron_unlock(sched);
+    free(events);
 
     *pnsize = nsize;
     *parr = arr;
@@ -574,20 +940,19 @@ void cron_systable_events_free(void *arr, int nrecords)
 
 /*************** Default time scheduler implementation ******************/
 
-static int time_is_exec_time(sched_if_t *impl, cron_event_t *event)
+static long long time_clock(sched_if_t *impl)
 {
     struct timespec now;
-    assert(event);
     clock_gettime(CLOCK_REALTIME, &now);
-    return event->epoch <= now.tv_sec;
+    return now.tv_sec;
 }
 
-static int time_wait_next_event(sched_if_t *impl, cron_event_t *event)
+static int time_wait_next_event(sched_if_t *impl, const int *next)
 {
     cron_sched_t *sched = impl->sched;
     struct timespec ts;
-    if (event) {
-        ts.tv_sec = event->epoch;
+    if (next) {
+        ts.tv_sec = *next;
     } else {
         clock_gettime(CLOCK_REALTIME, &ts);
         ts.tv_sec += sched->impl.default_sleep_idle;
@@ -607,7 +972,7 @@ void time_cron_create(sched_if_t *intf, char *(*describe)(sched_if_t *),
     intf->type = CRON_TIMEPART;
     intf->default_sleep_idle =
         bdb_attr_get(thedb->bdb_attr, BDB_ATTR_CRON_IDLE_SECS);
-    intf->is_exec_time = time_is_exec_time;
+    intf->clock = time_clock;
     intf->wait_next_event = time_wait_next_event;
     intf->describe = describe;
     intf->event_describe = event_describe;
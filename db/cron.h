@@ -22,7 +22,7 @@
 #include "cron_systable.h"
 
 /**
- * Primitive cron job that monitors a ordered list of epoch marked events,
+ * Cron job that monitors a timer wheel of epoch marked events,
  * each having a callback function associated
  * Sleep until next event is to be triggered
  *
@@ -59,6 +59,8 @@ struct cron_event {
     void *arg3;
     uuid_t source_id; /* source id, if any, used to map events to sources */
     struct sched_if *schedif; /* implicit scheduler */
+    unsigned long long seq; /* orders the events due at the same epoch */
+    int slot;               /* where the event is queued, see cron.c */
     LINKC_T(struct cron_event) lnk;
 };
 typedef struct cron_event cron_event_t;
@@ -68,10 +70,11 @@ struct sched_if {
     enum cron_type type;
     char *name;
     int default_sleep_idle;
-    /* check if it is time to execute event "event" */
-    int (*is_exec_time)(struct sched_if *impl, cron_event_t *event);
-    /* sleep until a signal or next event is due */
-    int (*wait_next_event)(struct sched_if *impl, cron_event_t *event);
+    int parallel; /* due events can run on the cron worker pool */
+    /* current value of the clock the events' epochs are in */
+    long long (*clock)(struct sched_if *impl);
+    /* sleep until a signal or epoch "next" is due; NULL if none is queued */
+    int (*wait_next_event)(struct sched_if *impl, const int *next);
     /* describe the scheduler */
     char *(*describe)(struct sched_if *impl);
     /* describe the event function */
@@ -80,6 +83,10 @@ struct sched_if {
 };
 typedef struct sched_if sched_if_t;
 
+/* size of the pool running the events of parallel schedulers; 0 runs every
+   event on its scheduler's thread */
+extern int gbl_cron_workers;
+
 /**
  * Add a new event to a scheduler, and create a scheduler if needed.
  * NOTE: to create a scheduler, "sched"== NULL, and "intf"!=NULL
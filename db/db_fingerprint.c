@@ -18,12 +18,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
+#include <inttypes.h>
 
 #include "logmsg.h"
 #include "md5.h"
 #include "sql.h"
 #include "util.h"
 #include "tohex.h"
+#include "hdrhist.h"
+#include "thdpool.h"
 
 hash_t *gbl_fingerprint_hash = NULL;
 pthread_mutex_t gbl_fingerprint_hash_mu = PTHREAD_MUTEX_INITIALIZER;
@@ -31,6 +34,12 @@ pthread_mutex_t gbl_fingerprint_hash_mu = PTHREAD_MUTEX_INITIALIZER;
 extern int gbl_fingerprint_queries;
 extern int gbl_verbose_normalized_queries;
 int gbl_fingerprint_max_queries = 1000; /* TODO: Tunable? */
+int gbl_fingerprint_max_running = 0;
+int gbl_fingerprint_limit_min_cost = 1000;
+int gbl_fingerprint_plan_regression = 4;
+
+/* runs with a new plan before it is compared with the old one */
+#define FINGERPRINT_PLAN_RUNS 10
 
 void calc_fingerprint(const char *zNormSql, size_t *pnNormSql,
                       unsigned char fingerprint[FINGERPRINTSZ]) {
@@ -49,7 +58,8 @@ void calc_fingerprint(const char *zNormSql, size_t *pnNormSql,
 
 void add_fingerprint(const char *zSql, const char *zNormSql, int64_t cost,
                      int64_t time, int64_t prepTime, int64_t nrows,
-                     struct reqlogger *logger, unsigned char *fingerprint_out) {
+                     int64_t latencyus, struct reqlogger *logger,
+                     unsigned char *fingerprint_out) {
     assert(zSql);
     size_t nNormSql = 0;
     unsigned char fingerprint[FINGERPRINTSZ];
@@ -81,6 +91,9 @@ void add_fingerprint(const char *zSql, const char *zNormSql, int64_t cost,
         t->rows = nrows;
         t->zNormSql = strdup(zNormSql);
         t->nNormSql = nNormSql;
+        t->latency = calloc(1, sizeof(struct hdrhist));
+        if (t->latency)
+            hdrhist_record(t->latency, latencyus);
         hash_add(gbl_fingerprint_hash, t);
 
         char fp[FINGERPRINTSZ*2+1]; /* 16 ==> 33 */
@@ -104,6 +117,8 @@ void add_fingerprint(const char *zSql, const char *zNormSql, int64_t cost,
         t->time += time;
         t->prepTime += prepTime;
         t->rows += nrows;
+        if (t->latency)
+            hdrhist_record(t->latency, latencyus);
         assert( memcmp(t->fingerprint,fingerprint,FINGERPRINTSZ)==0 );
         assert( t->zNormSql!=zNormSql );
         assert( t->nNormSql==nNormSql );
@@ -119,3 +134,125 @@ done:
     if (fingerprint_out)
         memcpy(fingerprint_out, fingerprint, FINGERPRINTSZ);
 }
+
+/*
+** Admission control by query shape.  A statement whose fingerprint has
+** averaged at least fingerprint_limit_min_cost so far is only run if fewer
+** than fingerprint_max_running statements of the same shape are running on
+** this node, half that while requests are queueing for the sql pool.
+** Shapes seen for the first time are always let in.  Returns 1 if the
+** statement may run, in which case fingerprint_release() must follow.
+*/
+int fingerprint_admit(const char *zNormSql,
+                      unsigned char fingerprint[FINGERPRINTSZ])
+{
+    struct fingerprint_track *t;
+    size_t nNormSql;
+    int limit = gbl_fingerprint_max_running;
+    int admit = 1;
+
+    if (limit <= 0 || zNormSql == NULL)
+        return 0;
+    calc_fingerprint(zNormSql, &nNormSql, fingerprint);
+    if (thdpool_get_queue_depth(gbl_sqlengine_thdpool) > 0 && limit > 1)
+        limit /= 2;
+
+    Pthread_mutex_lock(&gbl_fingerprint_hash_mu);
+    t = gbl_fingerprint_hash ? hash_find(gbl_fingerprint_hash, fingerprint)
+                             : NULL;
+    if (t == NULL) {
+        admit = 0; /* nothing to count against */
+    } else if (t->count > 0 &&
+               t->cost / t->count >= gbl_fingerprint_limit_min_cost &&
+               t->running >= limit) {
+        admit = -1;
+        t->rejected++;
+    } else {
+        t->running++;
+    }
+    Pthread_mutex_unlock(&gbl_fingerprint_hash_mu);
+    return admit;
+}
+
+void fingerprint_release(const unsigned char fingerprint[FINGERPRINTSZ])
+{
+    struct fingerprint_track *t;
+
+    Pthread_mutex_lock(&gbl_fingerprint_hash_mu);
+    t = gbl_fingerprint_hash ? hash_find(gbl_fingerprint_hash, fingerprint)
+                             : NULL;
+    if (t && t->running > 0)
+        t->running--;
+    Pthread_mutex_unlock(&gbl_fingerprint_hash_mu);
+}
+
+static uint64_t plan_signature(const struct client_query_stats *stats)
+{
+    uint64_t h = 14695981039346656037ULL; /* FNV-1a */
+
+    for (int i = 0; i < stats->n_components; i++) {
+        const struct client_query_path_component *c = &stats->path_stats[i];
+        for (const char *p = c->table; *p && p < c->table + sizeof(c->table);
+             p++)
+            h = (h ^ (unsigned char)*p) * 1099511628211ULL;
+        h = (h ^ (uint32_t)c->ix) * 1099511628211ULL;
+    }
+    return h;
+}
+
+/*
+** Plans change when analyze refreshes the stats.  A fingerprint remembers
+** which tables and indexes its last run went through; when that changes, the
+** average cost under the old plan is kept, and once the new plan has run
+** FINGERPRINT_PLAN_RUNS times, a warning is logged if it is
+** fingerprint_plan_regression times costlier.
+*/
+void fingerprint_check_plan(const unsigned char fingerprint[FINGERPRINTSZ],
+                            const struct client_query_stats *stats,
+                            int64_t cost)
+{
+    struct fingerprint_track *t;
+    uint64_t plan;
+    int64_t avg = 0, prev = 0;
+
+    if (gbl_fingerprint_plan_regression <= 0 || stats == NULL ||
+        stats->n_components == 0)
+        return;
+    plan = plan_signature(stats);
+
+    Pthread_mutex_lock(&gbl_fingerprint_hash_mu);
+    t = gbl_fingerprint_hash ? hash_find(gbl_fingerprint_hash, fingerprint)
+                             : NULL;
+    if (t == NULL) {
+        Pthread_mutex_unlock(&gbl_fingerprint_hash_mu);
+        return;
+    }
+    if (t->plan != plan) {
+        if (t->plan != 0) {
+            t->prev_plan_avg = t->plan_count ? t->plan_cost / t->plan_count : 0;
+            t->plan_changes++;
+        }
+        t->plan = plan;
+        t->plan_count = 0;
+        t->plan_cost = 0;
+    }
+    t->plan_count++;
+    t->plan_cost += cost;
+    if (t->plan_count == FINGERPRINT_PLAN_RUNS && t->prev_plan_avg > 0) {
+        avg = t->plan_cost / t->plan_count;
+        prev = t->prev_plan_avg;
+        if (avg < gbl_fingerprint_limit_min_cost ||
+            avg < prev * gbl_fingerprint_plan_regression)
+            avg = 0;
+    }
+    Pthread_mutex_unlock(&gbl_fingerprint_hash_mu);
+
+    if (avg) {
+        char fp[FINGERPRINTSZ * 2 + 1];
+        util_tohex(fp, (const char *)fingerprint, FINGERPRINTSZ);
+        logmsg(LOGMSG_WARN,
+               "fingerprint %s: plan changed, average cost went from %" PRId64
+               " to %" PRId64 "\n",
+               fp, prev, avg);
+    }
+}
@@ -23,6 +23,8 @@
 #include "bdb_api.h"
 #include "net.h"
 #include "thread_stats.h"
+#include "hdrhist.h"
+#include "mem_governor.h"
 
 #include <sys/time.h>
 #include <sys/resource.h>
@@ -76,17 +78,26 @@ struct comdb2_metrics_store {
     int64_t total_aborts;
     double sql_queue_time;
     int64_t sql_queue_timeouts;
+    int64_t sql_queue_classes;
+    int64_t sql_queue_rejects;
+    int64_t sql_queue_class_max_wait;
     double handle_buf_queue_time;
     int64_t denied_appsock_connections;
     int64_t locks;
     int64_t temptable_created;
     int64_t temptable_create_reqs;
     int64_t temptable_spills;
+    int64_t memgov_bytes;
+    int64_t memgov_spills;
+    int64_t memgov_admission_waits;
     int64_t net_drops;
     int64_t net_queue_size;
     int64_t rep_deadlocks;
     int64_t rw_evicts;
     int64_t standing_queue_time;
+    int64_t phase_p99[REQL_PHASE_MAX];
+    int64_t phase_p999[REQL_PHASE_MAX];
+    int64_t rep_stage_p99[BDB_REP_STAGE_MAX];
     int64_t minimum_truncation_file;
     int64_t minimum_truncation_offset;
     int64_t minimum_truncation_timestamp;
@@ -204,6 +215,17 @@ comdb2_metric gbl_metrics[] = {
     {"sql_queue_timeouts", "Number of sql items timed-out waiting on queue",
      STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
      &stats.sql_queue_timeouts, NULL},
+    {"sql_queue_classes", "Number of fair queueing classes on the sql queue",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.sql_queue_classes, NULL},
+    {"sql_queue_rejects",
+     "Number of sql items refused because their class was over maxagems",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_CUMULATIVE,
+     &stats.sql_queue_rejects, NULL},
+    {"sql_queue_class_max_wait",
+     "Longest ms the next item of any sql queue class has waited",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.sql_queue_class_max_wait, NULL},
     {"handle_buf_queue_time", "Average ms spent waiting in handle-buf queue",
      STATISTIC_DOUBLE, STATISTIC_COLLECTION_TYPE_LATEST,
      &stats.handle_buf_queue_time, NULL},
@@ -222,6 +244,19 @@ comdb2_metric gbl_metrics[] = {
      "Number of temporary tables that had to be spilled to disk-backed tables",
      STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_CUMULATIVE,
      &stats.temptable_spills, NULL},
+    {"memgov_bytes",
+     "Bytes temp tables and sorters hold in memory, as the memory governor "
+     "counts them",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST, &stats.memgov_bytes,
+     NULL},
+    {"memgov_spills", "Number of spills to disk the memory governor asked for",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_CUMULATIVE,
+     &stats.memgov_spills, NULL},
+    {"memgov_admission_waits",
+     "Number of statements held back while the server was over its memory "
+     "budget",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_CUMULATIVE,
+     &stats.memgov_admission_waits, NULL},
     {"net_drops",
      "Number of packets that didn't fit on network queue and were dropped",
      STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_CUMULATIVE, &stats.net_drops,
@@ -235,6 +270,57 @@ comdb2_metric gbl_metrics[] = {
     {"standing_queue_time", "How long the database has had a standing queue",
      STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
      &stats.standing_queue_time, NULL},
+    {"queue_latency_p99", "p99 percentile of microseconds spent waiting in the sql queue",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.phase_p99[REQL_PHASE_QUEUE], NULL},
+    {"queue_latency_p999", "p999 percentile of microseconds spent waiting in the sql queue",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.phase_p999[REQL_PHASE_QUEUE], NULL},
+    {"prepare_latency_p99", "p99 percentile of microseconds spent preparing sql",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.phase_p99[REQL_PHASE_PREPARE], NULL},
+    {"prepare_latency_p999", "p999 percentile of microseconds spent preparing sql",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.phase_p999[REQL_PHASE_PREPARE], NULL},
+    {"run_latency_p99", "p99 percentile of microseconds spent running sql",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.phase_p99[REQL_PHASE_RUN], NULL},
+    {"run_latency_p999", "p999 percentile of microseconds spent running sql",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.phase_p999[REQL_PHASE_RUN], NULL},
+    {"commit_latency_p99", "p99 percentile of microseconds spent writing commits",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.phase_p99[REQL_PHASE_COMMIT], NULL},
+    {"commit_latency_p999", "p999 percentile of microseconds spent writing commits",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.phase_p999[REQL_PHASE_COMMIT], NULL},
+    {"repwait_latency_p99", "p99 percentile of microseconds spent waiting for replicants",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.phase_p99[REQL_PHASE_REPWAIT], NULL},
+    {"repwait_latency_p999", "p999 percentile of microseconds spent waiting for replicants",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.phase_p999[REQL_PHASE_REPWAIT], NULL},
+    {"rep_log_put_latency_p99", "p99 percentile of microseconds spent writing the commit record",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.rep_stage_p99[BDB_REP_STAGE_LOG_PUT], NULL},
+    {"rep_net_enqueue_latency_p99", "p99 percentile of microseconds spent enqueueing a commit for a replicant",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.rep_stage_p99[BDB_REP_STAGE_NET_ENQUEUE], NULL},
+    {"rep_writer_send_latency_p99", "p99 percentile of microseconds spent in a replicant's net queue before being flushed",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.rep_stage_p99[BDB_REP_STAGE_WRITER_SEND], NULL},
+    {"rep_replicant_receive_latency_p99", "p99 percentile of microseconds spent from a replicant reading a commit to giving it to berkdb",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.rep_stage_p99[BDB_REP_STAGE_REPLICANT_RECEIVE], NULL},
+    {"rep_apply_latency_p99", "p99 percentile of microseconds spent applying a commit on a replicant",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.rep_stage_p99[BDB_REP_STAGE_APPLY], NULL},
+    {"rep_ack_send_latency_p99", "p99 percentile of microseconds spent from applying a commit on a replicant to sending its ack",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.rep_stage_p99[BDB_REP_STAGE_ACK_SEND], NULL},
+    {"rep_ack_receive_latency_p99", "p99 percentile of microseconds spent from enqueueing a commit for a replicant to getting its ack",
+     STATISTIC_INTEGER, STATISTIC_COLLECTION_TYPE_LATEST,
+     &stats.rep_stage_p99[BDB_REP_STAGE_ACK_RECEIVE], NULL},
 #if 0
     {"minimum_truncation_file", "Minimum truncation file", STATISTIC_INTEGER,
      STATISTIC_COLLECTION_TYPE_LATEST, &stats.minimum_truncation_file, NULL},
@@ -410,6 +496,12 @@ int refresh_metrics(void)
     stats.concurrent_sql = time_metric_average(thedb->concurrent_queries);
     stats.sql_queue_time = time_metric_average(thedb->sql_queue_time);
     stats.sql_queue_timeouts = thdpool_get_timeouts(gbl_sqlengine_thdpool);
+    int nclasses, nrejected, maxwait;
+    thdpool_get_class_stats(gbl_sqlengine_thdpool, &nclasses, &nrejected,
+                            &maxwait);
+    stats.sql_queue_classes = nclasses;
+    stats.sql_queue_rejects = nrejected;
+    stats.sql_queue_class_max_wait = maxwait;
     stats.handle_buf_queue_time =
         time_metric_average(thedb->handle_buf_queue_time);
     stats.concurrent_connections = time_metric_average(thedb->connections);
@@ -446,6 +538,13 @@ int refresh_metrics(void)
     stats.temptable_created = gbl_temptable_created;
     stats.temptable_create_reqs = gbl_temptable_create_reqs;
     stats.temptable_spills = gbl_temptable_spills;
+    struct memgov_stats gov;
+    memgov_get_stats(&gov);
+    stats.memgov_bytes = gov.total;
+    stats.memgov_spills = 0;
+    for (int i = 0; i < MEMGOV_MAX; i++)
+        stats.memgov_spills += gov.spills[i];
+    stats.memgov_admission_waits = gov.admission_waits;
 
     struct net_stats net_stats;
     rc = net_get_stats(thedb->handle_sibling, &net_stats);
@@ -462,6 +561,17 @@ int refresh_metrics(void)
 
     stats.standing_queue_time = metrics_standing_queue_time();
 
+    struct hdrhist h;
+    for (int i = 0; i < REQL_PHASE_MAX; i++) {
+        reqlog_phase_get(i, &h);
+        stats.phase_p99[i] = hdrhist_percentile(&h, 99);
+        stats.phase_p999[i] = hdrhist_percentile(&h, 99.9);
+    }
+    for (int i = 0; i < BDB_REP_STAGE_MAX; i++) {
+        bdb_rep_stage_get(i, &h);
+        stats.rep_stage_p99[i] = hdrhist_percentile(&h, 99);
+    }
+
 #if 0
     bdb_min_truncate(thedb->bdb_env, &min_file, &min_offset, &min_timestamp);
     stats.minimum_truncation_file = min_file;
@@ -30,6 +30,7 @@
 #include "portmuxapi.h"
 #include "config.h"
 #include "net.h"
+#include "comdb2_pthread_create.h"
 
 /* Maximum allowable size of the value of tunable. */
 #define MAX_TUNABLE_VALUE_SIZE 512
@@ -316,6 +317,109 @@ extern int gbl_debug_omit_dta_write;
 extern int gbl_debug_omit_idx_write;
 extern int gbl_debug_omit_blob_write;
 extern int eventlog_nkeep;
+extern int gbl_net_writev;
+extern int gbl_net_zerocopy_min_bytes;
+extern int gbl_net_lockfree_enqueue;
+extern int gbl_osql_batch_bytes;
+extern int gbl_osql_batch_ms;
+extern int gbl_osql_apply_parallel;
+extern int gbl_osql_apply_parallel_minops;
+extern int gbl_bt_insert_hint;
+extern int gbl_mpool_numa;
+extern int gbl_mpool_2q;
+extern int gbl_berkdb_io_uring;
+extern int gbl_load_cache_at_startup;
+extern int gbl_load_cache_report_secs;
+extern int gbl_lk_thread_cache;
+extern int gbl_group_commit_max_usec;
+extern int gbl_net_compress;
+extern int gbl_net_compress_min_bytes;
+extern int gbl_rep_ack_batch_usec;
+extern int gbl_stag_plans;
+extern int gbl_sqlcache_warm;
+extern int gbl_sql_queue_class;
+extern int gbl_sql_stmt_arena;
+extern int gbl_sql_stmt_arena_keep;
+extern int gbl_sqlite_sorter_prefix_min;
+extern int gbl_sqlite_sorter_threads;
+extern int gbl_sc_sorted_index_build;
+extern int gbl_sc_latency_budget_ms;
+extern int gbl_dohast_stripe_scan;
+extern int gbl_dohast_union_aggregates;
+extern int gbl_timepart_prune_shards;
+extern int gbl_bt_read_hint;
+extern int gbl_lua_bytecode_cache;
+extern int gbl_newsql_row_batch;
+extern int gbl_appsock_park_ms;
+extern int gbl_newsql_compress;
+extern int gbl_newsql_compress_min_bytes;
+extern int gbl_fdb_sql_batch_rows;
+extern int gbl_fdb_push_limit;
+extern int gbl_fdb_result_cache_ttl_ms;
+extern int gbl_fdb_result_cache_max_rows;
+extern int gbl_fdb_result_cache_max_bytes;
+extern int gbl_serial_range_filter_min;
+extern int gbl_wait_event_sample_ms;
+extern int gbl_analyze_incremental;
+extern int gbl_analyze_incremental_max;
+extern int gbl_physrep_fetch_ahead_kb;
+extern char *gbl_kafka_cdc_topics;
+extern int gbl_kafka_cdc_linger_ms;
+extern int gbl_queuedb_shared_min_consumers;
+extern int gbl_osql_single_row_fastpath;
+extern int gbl_osql_local_noshadow;
+extern int gbl_bdblock_reader_bias;
+extern int gbl_lazy_key_decode;
+extern int gbl_sql_filter_pushdown;
+extern int gbl_sql_filter_raw_compare;
+extern int gbl_sql_blob_cache_mb;
+extern int gbl_sql_blob_cache_min_kb;
+extern int gbl_region_hugepages;
+extern int gbl_fingerprint_max_running;
+extern int gbl_fingerprint_limit_min_cost;
+extern int gbl_fk_verified_keys_max;
+extern int gbl_skip_unchanged_keys;
+extern int gbl_analyze_lowpri;
+extern int gbl_net_single_heartbeat_thread;
+extern int gbl_timepart_drop_shard_unlocked;
+extern int gbl_fingerprint_plan_regression;
+extern int gbl_autoindex_bloom_filter;
+extern int gbl_result_cache_mb;
+extern int gbl_result_cache_max_rows;
+extern int gbl_table_open_threads;
+extern int gbl_row_cache_mb;
+extern int gbl_page_compress;
+extern int gbl_timepart_compact_after;
+extern int gbl_file_reclaim_rate_mb;
+extern int gbl_sc_logical_redo_threads;
+extern int gbl_log_index;
+extern int gbl_log_read_cache_mb;
+extern int gbl_log_read_cache_rate_mb;
+extern int gbl_lock_heat_objects;
+extern int gbl_lock_heat_sample;
+extern int gbl_profile_hz;
+extern int gbl_rep_stage_sample;
+extern int gbl_upsert_single_probe;
+extern int gbl_osql_bplog_cache;
+extern int gbl_osql_sess_cache;
+extern int gbl_osql_shadtbl_cache;
+extern int gbl_cron_workers;
+extern int gbl_bt_search_lcp;
+extern int gbl_mem_budget_mb;
+extern int gbl_mem_budget_temptable_mb;
+extern int gbl_mem_budget_sorter_mb;
+extern int gbl_mem_query_budget_mb;
+extern int gbl_mem_admission_wait_ms;
+extern int gbl_mem_thread_cache;
+extern int gbl_llmeta_cache_mb;
+extern int gbl_tablelock_fastpath;
+extern int gbl_net_lowpri_queue_pct;
+extern int gbl_temptable_prewarm;
+extern int gbl_temptable_async_cleanup;
+extern int gbl_txn_chunk_throttle_ms;
+extern int gbl_osql_stream_minops;
+extern int gbl_osql_stream_max_pending;
+extern int gbl_schema_lk_sharded;
 
 int gbl_page_order_table_scan = 0;
 
@@ -611,6 +715,11 @@ static int maxretries_verify(void *context, void *value)
     return 0;
 }
 
+static int thread_cpus_verify(void *context, void *value)
+{
+    return comdb2_cpus_verify(value);
+}
+
 static int maxcolumns_verify(void *context, void *value)
 {
     if (*(int *)value <= 0 || *(int *)value > MAXCOLUMNS) {
@@ -1811,4 +1811,728 @@ REGISTER_TUNABLE("strict_double_quotes",
 REGISTER_TUNABLE("eventlog_nkeep", "Keep this many eventlog files (Default: 2)",
                  TUNABLE_INTEGER, &eventlog_nkeep, 0, NULL, NULL, NULL, NULL);
 
+REGISTER_TUNABLE("net_writev",
+                 "Net writer threads gather queued messages into sendmsg() "
+                 "iovecs instead of copying them through the socket buffer.  "
+                 "Not used for SSL connections.  (Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_net_writev, 0, NULL, NULL, NULL, NULL);
+REGISTER_TUNABLE("net_zerocopy_min_bytes",
+                 "With net_writev, send messages of at least this many bytes "
+                 "with MSG_ZEROCOPY.  0 disables.  (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_net_zerocopy_min_bytes, 0, NULL, NULL,
+                 NULL, NULL);
+REGISTER_TUNABLE("net_lockfree_enqueue",
+                 "Enqueue net messages onto a lock-free per-node stack which "
+                 "the writer thread merges into its queue.  (Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_net_lockfree_enqueue, READONLY | NOARG,
+                 NULL, NULL, NULL, NULL);
+
+REGISTER_TUNABLE("osql_batch_bytes",
+                 "Pack osql ops sent to a remote master into batches of up to "
+                 "this many bytes; 0 sends every op as its own message. The "
+                 "master must understand batched osql streams. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_osql_batch_bytes, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("osql_batch_ms",
+                 "Send a partial osql batch once its oldest op is this many "
+                 "ms old. (Default: 10)",
+                 TUNABLE_INTEGER, &gbl_osql_batch_ms, 0, NULL, NULL, NULL, NULL);
+
+REGISTER_TUNABLE("osql_apply_parallel",
+                 "Replay the bplog of insert-only transactions on up to this "
+                 "many threads, one table per thread under its own child "
+                 "transaction. 0 replays serially. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_osql_apply_parallel, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("osql_apply_parallel_minops",
+                 "Only replay the bplog in parallel for transactions with at "
+                 "least this many ops. (Default: 1000)",
+                 TUNABLE_INTEGER, &gbl_osql_apply_parallel_minops, 0, NULL,
+                 NULL, NULL, NULL);
+
+REGISTER_TUNABLE("bt_insert_hint",
+                 "Remember the leaf each thread last inserted into, per "
+                 "btree, and try it before searching the tree. Speeds up "
+                 "sorted insert runs such as bulk loads. (Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_bt_insert_hint, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("mpool_numa",
+                 "Bind each buffer pool cache region to a NUMA node and round "
+                 "the number of caches up to a multiple of the node count. "
+                 "(Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_mpool_numa, READONLY, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("mpool_2q",
+                 "Use a 2Q style scan resistant buffer pool replacement "
+                 "policy: pages read by page order scans and prefaulting stay "
+                 "on probation and are evicted before re-referenced pages. "
+                 "(Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_mpool_2q, 0, NULL, NULL, NULL, NULL);
+
+REGISTER_TUNABLE("berkdb_io_uring",
+                 "Queue depth of the per-thread io_uring used for multi-page "
+                 "data file reads and writes; 0 uses synchronous "
+                 "pread/pwrite. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_berkdb_io_uring, READONLY, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("load_cache_at_startup",
+                 "Load the saved bufferpool pagelist as soon as the tables "
+                 "are open, and stay incoherent until it is loaded. (Default: "
+                 "off)",
+                 TUNABLE_BOOLEAN, &gbl_load_cache_at_startup, READONLY, NULL,
+                 NULL, NULL, NULL);
+
+REGISTER_TUNABLE("load_cache_report_secs",
+                 "Report bufferpool load progress every this many seconds; 0 "
+                 "to disable. (Default: 10)",
+                 TUNABLE_INTEGER, &gbl_load_cache_report_secs, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("lk_thread_cache",
+                 "Number of free lock and locker structures each thread keeps "
+                 "for reuse before returning them to the shared partition "
+                 "free lists (max 64). (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_lk_thread_cache, READONLY, NULL,
+                 NULL, NULL, NULL);
+
+REGISTER_TUNABLE("group_commit_max_usec",
+                 "Upper bound in microseconds on how long a committing thread "
+                 "waits for other commits to share its log sync. The wait "
+                 "adapts to the commit arrival rate and fsync latency. 0 "
+                 "disables. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_group_commit_max_usec, 0, NULL,
+                 NULL, NULL, NULL);
+
+REGISTER_TUNABLE("net_compress",
+                 "LZ4 compress replication messages sent to nodes that "
+                 "advertise support for it.  (Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_net_compress, 0, NULL, NULL, NULL, NULL);
+
+REGISTER_TUNABLE("net_compress_min_bytes",
+                 "With net_compress, only compress messages of at least this "
+                 "many bytes.  (Default: 1024)",
+                 TUNABLE_INTEGER, &gbl_net_compress_min_bytes, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("rep_ack_batch_usec",
+                 "Replicants send at most one ack per this many microseconds, "
+                 "acking the latest commit lsn.  0 acks every commit.  "
+                 "(Default: 0)",
+                 TUNABLE_INTEGER, &gbl_rep_ack_batch_usec, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("stag_conversion_plans",
+                 "Use per schema pair compiled plans for server tag to tag "
+                 "conversions. (Default: on)",
+                 TUNABLE_BOOLEAN, &gbl_stag_plans, 0, NULL, NULL, NULL, NULL);
+
+REGISTER_TUNABLE("sql_stmt_cache_warm",
+                 "Number of the statements most often cached by any sql "
+                 "engine thread that each thread prepares into its own cache "
+                 "after opening a new engine, e.g. after a schema change. "
+                 "(Default: 0)",
+                 TUNABLE_INTEGER, &gbl_sqlcache_warm, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("sql_queue_class",
+                 "Group queued sql for round robin scheduling on the sql "
+                 "engine pool: 0 off, 1 by user, 2 by client origin, 3 by "
+                 "query text.",
+                 TUNABLE_INTEGER, &gbl_sql_queue_class, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("sql_stmt_arena",
+                 "Run each sql statement with its own memory arena.",
+                 TUNABLE_BOOLEAN, &gbl_sql_stmt_arena, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("sql_stmt_arena_keep",
+                 "Largest footprint in bytes of an empty statement arena kept "
+                 "for reuse.",
+                 TUNABLE_INTEGER, &gbl_sql_stmt_arena_keep, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("sqlite_sorter_prefix_min",
+                 "Sort in-memory sorter lists of at least this many records "
+                 "by a normalized prefix of their first column, comparing "
+                 "whole records only on ties. 0 disables.",
+                 TUNABLE_INTEGER, &gbl_sqlite_sorter_prefix_min, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("sqlite_sorter_threads",
+                 "Maximum number of threads used to radix sort the prefixes "
+                 "of a large sorter list.",
+                 TUNABLE_INTEGER, &gbl_sqlite_sorter_threads, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("sc_sorted_index_build",
+                 "Build the new indexes of an index-only logical live schema "
+                 "change from keys extracted and sorted per stripe, then "
+                 "replay the log. (Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_sc_sorted_index_build, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("sc_latency_budget_ms",
+                 "If set, schema change adjusts its threads, replication wait "
+                 "batch and per record pacing to keep sql service time and "
+                 "its own replication waits under this many ms. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_sc_latency_budget_ms, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("dohast_stripe_scan",
+                 "Split aggregate-only table scans into one parallel scan per "
+                 "data stripe.",
+                 TUNABLE_BOOLEAN, &gbl_dohast_stripe_scan, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("dohast_union_aggregates",
+                 "Split aggregates over union all views, like time "
+                 "partitions, into one parallel query per table.",
+                 TUNABLE_BOOLEAN, &gbl_dohast_union_aggregates, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("timepart_prune_shards",
+                 "Skip time partition shards that a constant upper bound on "
+                 "comdb2_rowtimestamp rules out.",
+                 TUNABLE_BOOLEAN, &gbl_timepart_prune_shards, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("bt_read_hint",
+                 "Remember the leaf that each thread last landed on in a "
+                 "range search, per btree, and try it before searching the "
+                 "tree. Speeds up sorted key probes such as IN lists and "
+                 "nested-loop joins. (Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_bt_read_hint, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("lua_bytecode_cache",
+                 "Number of compiled stored procedure chunks kept and shared "
+                 "by all Lua states, so calls do not parse the procedure "
+                 "source again. 0 disables the cache. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_lua_bytecode_cache, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("newsql_row_batch",
+                 "Pack up to this many result rows into each response for "
+                 "clients that ask for row batches. 0 to send one row per "
+                 "response. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_newsql_row_batch, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("appsock_park_ms",
+                 "If an idle newsql connection outside of a transaction sees "
+                 "no request for this many ms, hand its appsock thread back "
+                 "to the pool until the next request arrives. 0 turns parking "
+                 "off. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_appsock_park_ms, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("newsql_compress",
+                 "Let clients that ask for it switch their connection to LZ4 "
+                 "or zstd compressed framing. (Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_newsql_compress, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("newsql_compress_min_bytes",
+                 "On compressed connections, send flushes smaller than this "
+                 "many bytes uncompressed. (Default: 1024)",
+                 TUNABLE_INTEGER, &gbl_newsql_compress_min_bytes, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("fdb_sql_batch_rows",
+                 "Number of rows a remote sql query buffers before sending "
+                 "them to the database that asked for them. The first row is "
+                 "always sent at once. 0 or 1 sends every row as it comes. "
+                 "(Default: 0)",
+                 TUNABLE_INTEGER, &gbl_fdb_sql_batch_rows, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("fdb_push_limit",
+                 "Pass the LIMIT of a query over a single remote table to the "
+                 "remote database, when all of the WHERE clause is sent "
+                 "along. (Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_fdb_push_limit, NOARG, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("fdb_result_cache_ttl_ms",
+                 "Keep the rows of remote queries for this many milliseconds "
+                 "and answer the same query from them, as long as the remote "
+                 "schema does not change. Rows may be this stale. 0 turns the "
+                 "cache off. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_fdb_result_cache_ttl_ms, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("fdb_result_cache_max_rows",
+                 "Do not cache remote query results with more rows than this. "
+                 "(Default: 1000)",
+                 TUNABLE_INTEGER, &gbl_fdb_result_cache_max_rows, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("fdb_result_cache_max_bytes",
+                 "Memory the remote query result cache may use. (Default: "
+                 "64MB)",
+                 TUNABLE_INTEGER, &gbl_fdb_result_cache_max_bytes, 0, NULL,
+                 NULL, NULL, NULL);
+
+REGISTER_TUNABLE("serial_range_filter_min",
+                 "Serializable and selectv read ranges on an index are "
+                 "summarized into a range filter once there are at least this "
+                 "many, so committed writes are checked against them in log "
+                 "time. 0 disables the filter. (Default: 8)",
+                 TUNABLE_INTEGER, &gbl_serial_range_filter_min, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("wait_event_sample_ms",
+                 "Record wait events (lock, page io, log flush, replication, "
+                 "net send and thread pool waits) and sample what every "
+                 "thread is waiting on this often, in ms. 0 turns wait events "
+                 "off. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_wait_event_sample_ms, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("analyze_incremental",
+                 "Keep HyperLogLog sketches of every index so that "
+                 "autoanalyze can update stats without scanning the table. "
+                 "(Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_analyze_incremental, NOARG, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("analyze_incremental_max",
+                 "Most incremental analyzes of a table before autoanalyze "
+                 "runs a full one again. (Default: 10)",
+                 TUNABLE_INTEGER, &gbl_analyze_incremental_max, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("physrep_fetch_ahead_kb",
+                 "Read up to this many kb of log from the physrep source "
+                 "ahead of applying it, in a separate thread.  0 reads and "
+                 "applies one record at a time.  (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_physrep_fetch_ahead_kb, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("kafka_cdc_topics",
+                 "Publish committed row changes to Kafka, as a list of "
+                 "table:topic pairs; * maps any table. Needs kafka_brokers "
+                 "and the kafkacdc plugin.",
+                 TUNABLE_STRING, &gbl_kafka_cdc_topics, READONLY | READEARLY,
+                 NULL, NULL, NULL, NULL);
+
+REGISTER_TUNABLE("kafka_cdc_linger_ms",
+                 "How long the kafkacdc plugin lets messages batch up before "
+                 "sending them.  (Default: 100ms)",
+                 TUNABLE_INTEGER, &gbl_kafka_cdc_linger_ms, READONLY, NULL,
+                 NULL, NULL, NULL);
+
+REGISTER_TUNABLE("queuedb_shared_min_consumers",
+                 "Store a queue item once, rather than once per consumer, "
+                 "when the queue has at least this many consumers; each "
+                 "consumer keeps its place in the shared items.  0 turns this "
+                 "off.  (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_queuedb_shared_min_consumers, 0, NULL,
+                 NULL, NULL, NULL);
+
+REGISTER_TUNABLE("osql_single_row_fastpath",
+                 "Keep the first row written by an autocommit socksql "
+                 "statement out of the replicant's shadow tables. (Default: "
+                 "on)",
+                 TUNABLE_BOOLEAN, &gbl_osql_single_row_fastpath, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("osql_local_noshadow",
+                 "Don't keep socksql rows in shadow tables when the sql "
+                 "thread runs on the master.  A master swing then fails the "
+                 "transaction instead of replaying it. (Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_osql_local_noshadow, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("bdblock_reader_bias",
+                 "Let bdb read locks skip the shared rwlock while no writer "
+                 "wants it. (Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_bdblock_reader_bias, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("lazy_key_decode",
+                 "Build the sqlite form of an index key only when a query "
+                 "needs it; columns are otherwise read straight from the "
+                 "ondisk key. (Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_lazy_key_decode, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("sql_filter_pushdown",
+                 "Let table scans skip rows that fail simple comparisons and "
+                 "IS NULL tests in the WHERE clause, before the rows reach "
+                 "sqlite.",
+                 TUNABLE_BOOLEAN, &gbl_sql_filter_pushdown, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("sql_filter_raw_compare",
+                 "Compare the WHERE terms of sql_filter_pushdown with the "
+                 "ondisk bytes of the row when the value converts exactly "
+                 "to the column type.",
+                 TUNABLE_BOOLEAN, &gbl_sql_filter_raw_compare, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("sql_blob_cache_mb",
+                 "Megabytes of large blobs read by sql to keep in a cache "
+                 "shared by all sql threads. 0 turns the cache off.",
+                 TUNABLE_INTEGER, &gbl_sql_blob_cache_mb, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("sql_blob_cache_min_kb",
+                 "Smallest blob, in kilobytes, that sql_blob_cache_mb caches.",
+                 TUNABLE_INTEGER, &gbl_sql_blob_cache_min_kb, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("region_hugepages",
+                 "Back the berkdb regions with anonymous memory on huge "
+                 "pages, falling back to transparent huge pages and then to "
+                 "regular pages. Ignored with largepages. (Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_region_hugepages, READONLY | NOARG,
+                 NULL, NULL, NULL, NULL);
+
+REGISTER_TUNABLE("fingerprint_max_running",
+                 "Reject a statement outside a transaction if this many "
+                 "statements with the same fingerprint are already running on "
+                 "this node, half as many while the sql pool has a queue. "
+                 "Only applies to fingerprints that have averaged "
+                 "fingerprint_limit_min_cost. 0 turns this off. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_fingerprint_max_running, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("fingerprint_limit_min_cost",
+                 "Average cost a fingerprint needs before "
+                 "fingerprint_max_running applies to it. (Default: 1000)",
+                 TUNABLE_INTEGER, &gbl_fingerprint_limit_min_cost, 0, NULL,
+                 NULL, NULL, NULL);
+
+REGISTER_TUNABLE("fk_verified_keys_max",
+                 "Parent keys a transaction's foreign key check remembers as "
+                 "found, so that children of the same parent probe the parent "
+                 "index once.  0 probes for every child.  (Default: 10000)",
+                 TUNABLE_INTEGER, &gbl_fk_verified_keys_max, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("skip_unchanged_keys",
+                 "On update, reuse the old key for indexes whose columns the "
+                 "update didn't set instead of forming the new key.  "
+                 "(Default: on)",
+                 TUNABLE_BOOLEAN, &gbl_skip_unchanged_keys, NOARG, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("analyze_lowpri",
+                 "Make analyze's cursors low priority lockers: the preferred "
+                 "deadlock victims, queued behind other lock waiters.  "
+                 "(Default: on)",
+                 TUNABLE_BOOLEAN, &gbl_analyze_lowpri, NOARG, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("net_single_heartbeat_thread",
+                 "Send and check heartbeats on one thread per net instead of "
+                 "two.  (Default: on)",
+                 TUNABLE_BOOLEAN, &gbl_net_single_heartbeat_thread,
+                 READONLY | NOARG, NULL, NULL, NULL, NULL);
+
+REGISTER_TUNABLE("timepart_drop_shard_unlocked",
+                 "Drop a time partition's expired shard without holding the "
+                 "schema lock, except to finalize.  (Default: on)",
+                 TUNABLE_BOOLEAN, &gbl_timepart_drop_shard_unlocked, NOARG,
+                 NULL, NULL, NULL, NULL);
+
+REGISTER_TUNABLE("fingerprint_plan_regression",
+                 "Warn when a query's plan changes and its average cost grows "
+                 "by this factor over the old plan's.  0 turns plan tracking "
+                 "off.  (Default: 4)",
+                 TUNABLE_INTEGER, &gbl_fingerprint_plan_regression, 0, NULL,
+                 NULL, NULL, NULL);
+
+REGISTER_TUNABLE("autoindex_bloom_filter",
+                 "Keep a bloom filter of the keys of each automatic index and "
+                 "skip the index seek for join keys that are not in it.  "
+                 "(Default: on)",
+                 TUNABLE_BOOLEAN, &gbl_autoindex_bloom_filter, NOARG, NULL,
+                 NULL, NULL, NULL);
+
+REGISTER_TUNABLE("result_cache_mb",
+                 "Memory for the rows of read-only statements kept by the "
+                 "result cache, in MB.  A statement run again with the same "
+                 "parameters before the next commit is answered from the "
+                 "cache.  0 turns the cache off.  (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_result_cache_mb, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("result_cache_max_rows",
+                 "Largest result, in rows, that the result cache keeps.  "
+                 "(Default: 1000)",
+                 TUNABLE_INTEGER, &gbl_result_cache_max_rows, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("table_open_threads",
+                 "Open the tables' files on this many threads at startup. 0 "
+                 "or 1 opens them one at a time. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_table_open_threads, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("row_cache_mb",
+                 "Memory, in MB, for caching unpacked data records by genid "
+                 "for fetches outside a transaction. A write to a data stripe "
+                 "drops its cached records. 0 turns the cache off. (Default: "
+                 "0)",
+                 TUNABLE_INTEGER, &gbl_row_cache_mb, 0, NULL, NULL, NULL, NULL);
+
+REGISTER_TUNABLE("page_compress",
+                 "Write data and index pages LZ4 compressed, punching out the "
+                 "file blocks they no longer need. Pages already compressed "
+                 "are read either way. (Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_page_compress, EXPERIMENTAL, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("timepart_compact_after",
+                 "Rebuild a time partition shard with zstd compression once "
+                 "it is this many rollouts old. 0 never.  (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_timepart_compact_after, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("file_reclaim_rate_mb",
+                 "Rename removed files larger than this many MB aside and "
+                 "free them in the background at this many MB a second, "
+                 "instead of unlinking them at once. 0 turns this off. "
+                 "(Default: 0)",
+                 TUNABLE_INTEGER, &gbl_file_reclaim_rate_mb, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("sc_logical_redo_threads",
+                 "If set, logical live schema change redoes the log on this "
+                 "many threads, each taking the records of a share of the "
+                 "data stripes. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_sc_logical_redo_threads, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("log_index",
+                 "Keep a sparse in-memory index of the commit timestamps of "
+                 "each log file as it rolls, so finding the log record for a "
+                 "time skips the files that are all newer. (Default: on)",
+                 TUNABLE_BOOLEAN, &gbl_log_index, NOARG, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("log_read_cache_mb",
+                 "Size of the cache the master reads older log through to "
+                 "answer replicant fill requests, with readahead, so lagging "
+                 "replicants share one read. 0 turns this off. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_log_read_cache_mb, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("log_read_cache_rate_mb",
+                 "Most MB a second read from disk for replicant fill requests "
+                 "through the log read cache. 0 is no limit. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_log_read_cache_rate_mb, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("lock_heat_objects",
+                 "Lock objects whose waits are counted for comdb2_lock_heat. "
+                 "0 turns the counting off. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_lock_heat_objects, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("lock_heat_sample",
+                 "Count one in this many lock waits for comdb2_lock_heat. "
+                 "(Default: 1)",
+                 TUNABLE_INTEGER, &gbl_lock_heat_sample, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("profile_hz",
+                 "Stack samples a second of cpu taken by the profile message "
+                 "trap and sys.cmd.profile. (Default: 97)",
+                 TUNABLE_INTEGER, &gbl_profile_hz, 0, NULL, NULL, NULL, NULL);
+
+REGISTER_TUNABLE("rep_stage_sample",
+                 "Time one commit in this many through each stage of "
+                 "replication, for comdb2_replication_stages; 0 turns it off. "
+                 "(Default: 16)",
+                 TUNABLE_INTEGER, &gbl_rep_stage_sample, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("sql_thread_cpus",
+                 "SQL engine threads are bound to these cpus when they start.",
+                 TUNABLE_STRING, &gbl_sql_thread_cpus, READONLY, NULL,
+                 thread_cpus_verify, NULL, NULL);
+
+REGISTER_TUNABLE("commit_thread_cpus",
+                 "Threads that apply writes and commit are bound to these "
+                 "cpus when they start.",
+                 TUNABLE_STRING, &gbl_commit_thread_cpus, READONLY, NULL,
+                 thread_cpus_verify, NULL, NULL);
+
+REGISTER_TUNABLE("rep_thread_cpus",
+                 "Replication apply threads are bound to these cpus when they "
+                 "start.",
+                 TUNABLE_STRING, &gbl_rep_thread_cpus, READONLY, NULL,
+                 thread_cpus_verify, NULL, NULL);
+
+REGISTER_TUNABLE("net_thread_cpus",
+                 "Net reader and writer threads are bound to these cpus when "
+                 "they start.",
+                 TUNABLE_STRING, &gbl_net_thread_cpus, READONLY, NULL,
+                 thread_cpus_verify, NULL, NULL);
+
+REGISTER_TUNABLE("bdb_thread_cpus",
+                 "Berkdb trickle, memp sync and checkpoint threads are bound "
+                 "to these cpus when they start.",
+                 TUNABLE_STRING, &gbl_bdb_thread_cpus, READONLY, NULL,
+                 thread_cpus_verify, NULL, NULL);
+
+REGISTER_TUNABLE("upsert_single_probe",
+                 "For INSERT ... ON CONFLICT DO NOTHING, find a conflict on "
+                 "the last unique index checked by adding its key ahead of "
+                 "the record, instead of searching for the key and then "
+                 "adding it.",
+                 TUNABLE_BOOLEAN, &gbl_upsert_single_probe, NOARG, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("osql_bplog_cache",
+                 "Finished osql transaction logs kept on the master, temp "
+                 "tables and all, for new transactions to use again (Default: "
+                 "32)",
+                 TUNABLE_INTEGER, &gbl_osql_bplog_cache, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("osql_sess_cache",
+                 "Closed osql sessions kept on the master for new "
+                 "transactions to use again (Default: 64)",
+                 TUNABLE_INTEGER, &gbl_osql_sess_cache, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("osql_shadtbl_cache",
+                 "Emptied shadow temp tables each thread keeps for its next "
+                 "transaction to use again (Default: 16)",
+                 TUNABLE_INTEGER, &gbl_osql_shadtbl_cache, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("cron_workers",
+                 "Number of threads running the events of the time partition "
+                 "scheduler, so that rollouts and purges of different "
+                 "partitions do not wait on each other.  0 runs them all on "
+                 "the scheduler thread.  (Default: 8)",
+                 TUNABLE_INTEGER, &gbl_cron_workers, 0, NULL, NULL, NULL, NULL);
+
+REGISTER_TUNABLE("bt_search_lcp",
+                 "Skip the key prefix already known to match when binary "
+                 "searching a btree page, and compare the rest a word at a "
+                 "time.  (Default: on)",
+                 TUNABLE_BOOLEAN, &gbl_bt_search_lcp, NOARG, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("mem_budget_mb",
+                 "Memory, in megabytes, temp tables and sorters may hold "
+                 "across the server before they spill to disk and new "
+                 "statements wait to be let in.  0 for no budget.  (Default: "
+                 "0)",
+                 TUNABLE_INTEGER, &gbl_mem_budget_mb, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("mem_budget_temptable_mb",
+                 "Memory, in megabytes, temp tables may hold across the "
+                 "server before they spill to disk.  0 for no budget.  "
+                 "(Default: 0)",
+                 TUNABLE_INTEGER, &gbl_mem_budget_temptable_mb, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("mem_budget_sorter_mb",
+                 "Memory, in megabytes, sorters may hold across the server "
+                 "before they write their records out to disk.  0 for no "
+                 "budget.  (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_mem_budget_sorter_mb, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("mem_query_budget_mb",
+                 "Memory, in megabytes, the temp tables and sorters of one "
+                 "statement may hold before they spill to disk.  0 for no "
+                 "budget.  (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_mem_query_budget_mb, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("mem_admission_wait_ms",
+                 "Longest a new statement outside a transaction waits for the "
+                 "server to get under mem_budget_mb before it runs anyway.  "
+                 "(Default: 5000)",
+                 TUNABLE_INTEGER, &gbl_mem_admission_wait_ms, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("mem_thread_cache",
+                 "Small chunks of each size class a thread keeps for reuse "
+                 "when it frees them, instead of taking the allocator's lock "
+                 "to give them back.  0 turns the thread cache off.  "
+                 "(Default: 16)",
+                 TUNABLE_INTEGER, &gbl_mem_thread_cache, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("llmeta_cache_mb",
+                 "Memory, in MB, for caching what exact fetches of llmeta "
+                 "keys outside a transaction found. Any write to llmeta, on "
+                 "this node or replicated, drops the cache. 0 turns the cache "
+                 "off. (Default: 2)",
+                 TUNABLE_INTEGER, &gbl_llmeta_cache_mb, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("tablelock_fastpath",
+                 "Keep table read locks out of the lock table while no writer "
+                 "wants the table; a writer turns them into real locks first. "
+                 "(Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_tablelock_fastpath, NOARG, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("net_lowpri_queue_pct",
+                 "Queue log fills for a replicant behind its live log and "
+                 "control messages, and give them at most this percentage of "
+                 "its net queue; a fill that doesn't fit is answered with "
+                 "LOG_MORE. 0 queues fills with everything else. (Default: 50)",
+                 TUNABLE_INTEGER, &gbl_net_lowpri_queue_pct, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("temptable_prewarm",
+                 "Number of temp table environments, each with an empty "
+                 "btree, a background thread keeps open for temp tables to "
+                 "take instead of opening their own. 0 opens them as they are "
+                 "needed. (Default: 4)",
+                 TUNABLE_INTEGER, &gbl_temptable_prewarm, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("temptable_async_cleanup",
+                 "Leave emptying the btree of a closed temp table with many "
+                 "rows to the temptable prewarm thread, rather than the query "
+                 "closing it. (Default: on)",
+                 TUNABLE_BOOLEAN, &gbl_temptable_async_cleanup, NOARG, NULL,
+                 NULL, NULL, NULL);
+
+REGISTER_TUNABLE("txn_chunk_throttle_ms",
+                 "Milliseconds a statement run with SET TRANSACTION CHUNK "
+                 "sleeps, holding no locks, after each chunk it commits",
+                 TUNABLE_INTEGER, &gbl_txn_chunk_throttle_ms, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("osql_stream_minops",
+                 "A socksql transaction that has sent this many ops is "
+                 "applied on the master as the rest come in, rather than once "
+                 "they are all in. 0 turns it off. (Default: 0)",
+                 TUNABLE_INTEGER, &gbl_osql_stream_minops, 0, NULL, NULL, NULL,
+                 NULL);
+
+REGISTER_TUNABLE("osql_stream_max_pending",
+                 "Ops a streaming socksql transaction can get ahead of the "
+                 "master applying it before its reader waits. 0 for no limit. "
+                 "(Default: 100000)",
+                 TUNABLE_INTEGER, &gbl_osql_stream_max_pending, 0, NULL, NULL,
+                 NULL, NULL);
+
+REGISTER_TUNABLE("schema_lk_sharded",
+                 "Use a schema lock whose readers count themselves on "
+                 "per-thread cache lines instead of the pthread rwlock. "
+                 "(Default: off)",
+                 TUNABLE_BOOLEAN, &gbl_schema_lk_sharded, READONLY, NULL, NULL,
+                 NULL, NULL);
+
 #endif /* _DB_TUNABLES_H */
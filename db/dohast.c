@@ -23,6 +23,8 @@
 
 int gbl_dohast_disable = 0;
 int gbl_dohast_verbose = 0;
+int gbl_dohast_stripe_scan = 0;
+int gbl_dohast_union_aggregates = 0;
 
 static void node_free(dohsql_node_t **pnode, sqlite3 *db);
 static void _save_params(Parse *pParse, dohsql_node_t *node);
@@ -338,6 +340,7 @@ static dohsql_node_t *gen_oneselect(Vdbe *v, Select *p, Expr *extraRows,
     }
 
     node->type = AST_TYPE_SELECT;
+    node->stripe = -1;
     p->pPrior = p->pNext = NULL;
     node->sql = sqlite_struct_to_string(v, p, extraRows, order_size, order_dir,
                                         &node->params, is_union);
@@ -381,10 +384,22 @@ static void node_free(dohsql_node_t **pnode, sqlite3 *db)
     if ((*pnode)->order_dir) {
         free((*pnode)->order_dir);
     }
+    if ((*pnode)->tbl) {
+        sqlite3_free((*pnode)->tbl);
+    }
+    dohsql_combine_free((*pnode)->combine);
     free(*pnode);
     *pnode = NULL;
 }
 
+/* Did comdb2_timepart_prune leave nothing for this arm to read? */
+static int _pruned_arm(Select *p)
+{
+    int val;
+
+    return p->pWhere && sqlite3ExprIsInteger(p->pWhere, &val) && val == 0;
+}
+
 static dohsql_node_t *gen_union(Vdbe *v, Select *p, int span)
 {
     dohsql_node_t *node;
@@ -402,6 +417,7 @@ static dohsql_node_t *gen_union(Vdbe *v, Select *p, int span)
         return NULL;
 
     node->type = AST_TYPE_UNION;
+    node->stripe = -1;
     node->nodes = (dohsql_node_t **)(node + 1);
     node->nnodes = span;
     node->ncols = p->pEList->nExpr;
@@ -445,6 +461,14 @@ static dohsql_node_t *gen_union(Vdbe *v, Select *p, int span)
 
     /* generate queries */
     while (crt) {
+        /* shards pruned by comdb2_timepart_prune need no thread; a limit
+           without the head arm would lose its offset, so keep them then */
+        if (!pLimit && _pruned_arm(crt) &&
+            node->nnodes - node->npruned > 2) {
+            node->npruned++;
+            crt = crt->pNext;
+            continue;
+        }
         assert(crt == p || !crt->pOrderBy); /* can "restore" to NULL? */
         crt->pOrderBy = p->pOrderBy;
         *psub = gen_oneselect(v, crt, pOffset, &node->order_size,
@@ -472,6 +496,7 @@ static dohsql_node_t *gen_union(Vdbe *v, Select *p, int span)
         crt = crt->pNext;
         psub++;
     }
+    node->nnodes -= node->npruned;
 done:
     crt = p;
     while (crt) {
@@ -519,6 +544,463 @@ static int skip_tables(Select *p)
     return 0;
 }
 
+/* Is expr a column the arms of a split can read?  For a union view every arm
+   has to project it from a real column of its table. */
+static int _split_column(Select *view, Expr *expr)
+{
+    Select *arm;
+
+    if (expr->op != TK_COLUMN || expr->iColumn < 0)
+        return 0;
+    for (arm = view; arm; arm = arm->pPrior) {
+        if (arm->pEList->a[expr->iColumn].pExpr->iColumn < 0)
+            return 0;
+    }
+    return 1;
+}
+
+static int _splitWhereCallback(Walker *pWalker, Expr *pExpr)
+{
+    Index *pIdx;
+
+    if (pExpr->op != TK_COLUMN)
+        return WRC_Continue;
+    /* a rowid lookup would find the row from every stripe */
+    if (!_split_column(pWalker->u.pSelect, pExpr))
+        return WRC_Abort;
+    if (!pWalker->eCode)
+        return WRC_Continue;
+    /* leave anything an index might serve to the planner */
+    for (pIdx = pExpr->y.pTab->pIndex; pIdx; pIdx = pIdx->pNext) {
+        if (pIdx->pPartIdxWhere || pIdx->aiColumn[0] < 0 ||
+            pIdx->aiColumn[0] == pExpr->iColumn)
+            return WRC_Abort;
+    }
+    return WRC_Continue;
+}
+
+static int _numeric_column(Expr *expr)
+{
+    static const char *types[] = {"smallint", "int", "largeint", "smallfloat",
+                                  "float"};
+    const char *type;
+    int i;
+
+    type = sqlite3ColumnType(&expr->y.pTab->aCol[expr->iColumn], "");
+    for (i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        if (strcasecmp(type, types[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/* Returns the text of an aggregate whose per arm results can be folded into
+   the overall result, and how to fold them; an avg also needs the count of
+   its argument, returned in *pCount */
+static char *_gen_split_agg(Vdbe *v, Select *view, Expr *expr, int *combine,
+                            char **pCount, struct params_info **pParamsOut)
+{
+    const char *name = expr->u.zToken;
+    Expr *arg = NULL;
+    char *sArg;
+    char *ret;
+
+    if (expr->op != TK_AGG_FUNCTION ||
+        ExprHasProperty(expr, EP_Distinct | EP_WinFunc))
+        return NULL;
+    if (expr->x.pList) {
+        if (expr->x.pList->nExpr != 1)
+            return NULL;
+        arg = expr->x.pList->a[0].pExpr;
+    }
+
+    if (strcasecmp(name, "count") == 0) {
+        *combine = DOHSQL_COMBINE_SUM;
+        if (!arg)
+            return sqlite3_mprintf("count(*)");
+        if (!_split_column(view, arg))
+            return NULL;
+    } else {
+        if (!arg || !_split_column(view, arg))
+            return NULL;
+        if (strcasecmp(name, "sum") == 0 || strcasecmp(name, "total") == 0)
+            *combine = DOHSQL_COMBINE_SUM;
+        else if (strcasecmp(name, "avg") == 0)
+            *combine = DOHSQL_COMBINE_AVG;
+        else if (strcasecmp(name, "min") == 0)
+            *combine = DOHSQL_COMBINE_MIN;
+        else if (strcasecmp(name, "max") == 0)
+            *combine = DOHSQL_COMBINE_MAX;
+        else
+            return NULL;
+        if (*combine == DOHSQL_COMBINE_MIN || *combine == DOHSQL_COMBINE_MAX) {
+            /* folded with the default collation */
+            if (arg->y.pTab->aCol[arg->iColumn].zColl)
+                return NULL;
+        } else if (!_numeric_column(arg)) {
+            return NULL;
+        }
+    }
+
+    sArg = sqlite3ExprDescribeParams(v, arg, pParamsOut);
+    if (!sArg)
+        return NULL;
+    if (*combine == DOHSQL_COMBINE_AVG) {
+        *pCount = sqlite3_mprintf("count(%s)", sArg);
+        ret = *pCount ? sqlite3_mprintf("total(%s)", sArg) : NULL;
+    } else {
+        ret = sqlite3_mprintf("%s(%s)", name, sArg);
+    }
+    sqlite3_free(sArg);
+    return ret;
+}
+
+static char *_append_col(char *cols, char *sExpr, const char *alias)
+{
+    char *ret;
+
+    if (!sExpr) {
+        sqlite3_free(cols);
+        return NULL;
+    }
+    if (alias)
+        ret = sqlite3_mprintf("%s%s%s aS \"%w\"", cols ? cols : "",
+                              cols ? ", " : "", sExpr, alias);
+    else
+        ret = sqlite3_mprintf("%s%s%s", cols ? cols : "", cols ? ", " : "",
+                              sExpr);
+    sqlite3_free(sExpr);
+    sqlite3_free(cols);
+    return ret;
+}
+
+/* Is the select list term a group by key; returns its group by index */
+static int _group_key(Select *p, Expr *expr)
+{
+    int i;
+
+    if (!p->pGroupBy)
+        return -1;
+    for (i = 0; i < p->pGroupBy->nExpr; i++) {
+        if (sqlite3ExprCompare(NULL, p->pGroupBy->a[i].pExpr, expr, -1) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/* Generate the select one arm runs; the leading columns match the original
+   select list, the avg counts and the group by keys left out of that list
+   trail them.  A distinct select is grouped by its whole select list. */
+static char *_gen_split_select(Vdbe *v, Select *p, Select *view,
+                               const char *tbl, int notindexed,
+                               struct dohsql_combine *cmb,
+                               struct params_info **pParamsOut)
+{
+    ExprList *c = p->pEList;
+    ExprList *g = p->pGroupBy;
+    char *cols = NULL;
+    char *where = NULL;
+    char *group = NULL;
+    char *counts[c->nExpr];
+    char *ret = NULL;
+    int distinct = !(p->selFlags & SF_Aggregate);
+    int ncols = c->nExpr;
+    int i, j;
+
+    memset(counts, 0, sizeof(counts));
+    for (i = 0; i < c->nExpr; i++) {
+        Expr *expr = c->a[i].pExpr;
+        char *sExpr;
+
+        cmb->arg[i] = -1;
+        if (distinct || _group_key(p, expr) >= 0) {
+            cmb->op[i] = DOHSQL_COMBINE_GROUP;
+            /* the keys are folded with the default collation too */
+            sExpr = _split_column(view, expr) &&
+                            !expr->y.pTab->aCol[expr->iColumn].zColl
+                        ? sqlite3ExprDescribeParams(v, expr, pParamsOut)
+                        : NULL;
+        } else {
+            sExpr = _gen_split_agg(v, view, expr, &cmb->op[i], &counts[i],
+                                   pParamsOut);
+        }
+        /* keep the column names of the original statement */
+        cols = _append_col(cols, sExpr,
+                           c->a[i].zName ? c->a[i].zName : c->a[i].zSpan);
+        if (!cols)
+            goto done;
+    }
+    for (i = 0; i < c->nExpr; i++) {
+        if (!counts[i])
+            continue;
+        cmb->arg[i] = ncols;
+        cmb->op[ncols] = DOHSQL_COMBINE_SUM;
+        cmb->arg[ncols++] = -1;
+        cols = _append_col(cols, counts[i], NULL);
+        counts[i] = NULL;
+        if (!cols)
+            goto done;
+    }
+
+    cmb->ngroup = 0;
+    for (i = 0; distinct && i < c->nExpr; i++)
+        cmb->group[cmb->ngroup++] = i;
+    for (i = 0; g && i < g->nExpr; i++) {
+        Expr *expr = g->a[i].pExpr;
+        char *sExpr;
+
+        if (!_split_column(view, expr))
+            goto done;
+        sExpr = sqlite3ExprDescribeParams(v, expr, pParamsOut);
+        if (!sExpr)
+            goto done;
+        group = _append_col(group, sqlite3_mprintf("%s", sExpr), NULL);
+        if (!group) {
+            sqlite3_free(sExpr);
+            goto done;
+        }
+        cmb->group[cmb->ngroup++] = -1;
+        for (j = 0; j < c->nExpr; j++) {
+            if (cmb->op[j] == DOHSQL_COMBINE_GROUP && _group_key(p, c->a[j].pExpr) == i) {
+                cmb->group[cmb->ngroup - 1] = j;
+                break;
+            }
+        }
+        if (j < c->nExpr) {
+            sqlite3_free(sExpr);
+            continue;
+        }
+        /* a hidden key */
+        cmb->group[cmb->ngroup - 1] = ncols;
+        cmb->op[ncols] = DOHSQL_COMBINE_GROUP;
+        cmb->arg[ncols++] = -1;
+        cols = _append_col(cols, sExpr, NULL);
+        if (!cols)
+            goto done;
+    }
+    cmb->ncols = ncols;
+
+    if (p->pWhere) {
+        where = sqlite3ExprDescribeParams(v, p->pWhere, pParamsOut);
+        if (!where)
+            goto done;
+    }
+
+    ret = sqlite3_mprintf("SeLeCT %s%s FRoM \"%w\"%s%s%s%s%s",
+                          distinct ? "DiSTiNCT " : "", cols, tbl, notindexed ? " NoT INDeXeD" : "",
+                          where ? " WHeRe " : "", where ? where : "",
+                          group ? " GRoUP By " : "", group ? group : "");
+done:
+    for (i = 0; i < c->nExpr; i++)
+        sqlite3_free(counts[i]);
+    sqlite3_free(group);
+    sqlite3_free(where);
+    sqlite3_free(cols);
+    return ret;
+}
+
+/* The arms of a union view; returns their number, or 0 if some arm does
+   more than project the columns of one table */
+static int _union_view_arms(Select *view, Table *pTab)
+{
+    Select *arm;
+    Expr *expr;
+    int n = 0;
+    int i;
+
+    if (view->op != TK_ALL && view->op != TK_SELECT)
+        return 0;
+    for (arm = view; arm; arm = arm->pPrior) {
+        if ((arm->op != TK_ALL && arm->pPrior) ||
+            (!arm->pPrior && arm->op != TK_SELECT) || arm->pWhere ||
+            arm->pGroupBy || arm->pHaving || arm->pOrderBy || arm->pLimit ||
+            arm->pWith || arm->recording ||
+            (arm->selFlags & (SF_Aggregate | SF_Distinct)) ||
+            arm->pSrc->nSrc != 1 || arm->pSrc->a[0].pSelect ||
+            !arm->pSrc->a[0].pTab || IsVirtual(arm->pSrc->a[0].pTab) ||
+            arm->pSrc->a[0].pTab->pSelect || skip_tables(arm) ||
+            arm->pEList->nExpr != pTab->nCol)
+            return 0;
+        for (i = 0; i < arm->pEList->nExpr; i++) {
+            expr = arm->pEList->a[i].pExpr;
+            if (expr->op != TK_COLUMN)
+                return 0;
+            /* the arms are queried by the view column names */
+            if (expr->iColumn >= 0 &&
+                strcasecmp(expr->y.pTab->aCol[expr->iColumn].zName,
+                           pTab->aCol[i].zName))
+                return 0;
+        }
+        n++;
+    }
+    return n;
+}
+
+/* Does an index lead with a column of the select list; the planner walks
+   that index for a distinct instead of sorting */
+static int _distinct_indexed(Select *p)
+{
+    Index *pIdx;
+    Expr *expr;
+    int i;
+
+    for (i = 0; i < p->pEList->nExpr; i++) {
+        expr = p->pEList->a[i].pExpr;
+        if (expr->op != TK_COLUMN)
+            continue;
+        for (pIdx = expr->y.pTab->pIndex; pIdx; pIdx = pIdx->pNext) {
+            if (pIdx->aiColumn[0] == expr->iColumn)
+                return 1;
+        }
+    }
+    return 0;
+}
+
+/* The order by of a grouped split has to be a prefix of its group by, or
+   of the select list of a distinct select; the folded groups come out in
+   that order */
+static int _split_order_ok(Select *p)
+{
+    ExprList *keys = (p->selFlags & SF_Aggregate) ? p->pGroupBy : p->pEList;
+    int i;
+
+    if (!p->pOrderBy)
+        return 1;
+    if (!keys || p->pOrderBy->nExpr > keys->nExpr)
+        return 0;
+    for (i = 0; i < p->pOrderBy->nExpr; i++) {
+        if (p->pOrderBy->a[i].sortOrder ||
+            sqlite3ExprCompare(NULL, p->pOrderBy->a[i].pExpr,
+                               keys->a[i].pExpr, -1))
+            return 0;
+    }
+    return 1;
+}
+
+/* An aggregate or distinct select is split into a union of arms that each
+   compute the partial aggregates, or the distinct rows, of their part of the
+   data, and dohsql folds them:
+   - over a table it has to scan whole anyway, one arm per data stripe;
+   - over a union all view, like a time partition, one arm per table */
+static dohsql_node_t *gen_agg_split(Vdbe *v, Select *p)
+{
+    struct sql_thread *thd = pthread_getspecific(query_info_key);
+    struct SrcList_item *src = &p->pSrc->a[0];
+    Select *view = src->pSelect;
+    Select *arm = NULL;
+    int nnodes;
+    dohsql_node_t *node;
+    dohsql_node_t *sub;
+    struct dohsql_combine *cmb;
+    Walker w = {0};
+    char *tmp;
+    int narm;
+    int i;
+
+    /* one or the other; a distinct over aggregates is left alone */
+    if (!(p->selFlags & SF_Aggregate) == !(p->selFlags & SF_Distinct) ||
+        p->pHaving || p->pLimit || !_split_order_ok(p) || !src->pTab ||
+        src->fg.notIndexed || src->fg.isIndexedBy)
+        return NULL;
+
+    if (view) {
+        if (!gbl_dohast_union_aggregates)
+            return NULL;
+        nnodes = _union_view_arms(view, src->pTab);
+        if (nnodes < 2)
+            return NULL;
+    } else {
+        if (!gbl_dohast_stripe_scan || gbl_dtastripe < 2 ||
+            IsVirtual(src->pTab) || src->pTab->pSelect ||
+            src->pTab->pSchema != v->db->aDb[0].pSchema)
+            return NULL;
+        /* a lone count(*) is answered from the btree counts already */
+        if (!p->pWhere && !p->pGroupBy && p->pEList->nExpr == 1 &&
+            p->pEList->a[0].pExpr->op == TK_AGG_FUNCTION &&
+            !p->pEList->a[0].pExpr->x.pList)
+            return NULL;
+        if (!(p->selFlags & SF_Aggregate) && _distinct_indexed(p))
+            return NULL;
+        /* the arms scan on cursor transactions of their own, each starting
+           when its shard does: they would not see the writes of a client
+           transaction, nor read from one snapshot */
+        if (!thd || !thd->clnt || thd->clnt->in_client_trans ||
+            thd->clnt->dbtran.mode == TRANLEVEL_SERIAL ||
+            thd->clnt->dbtran.mode == TRANLEVEL_SNAPISOL)
+            return NULL;
+        nnodes = gbl_dtastripe;
+    }
+
+    if (p->pWhere) {
+        w.xExprCallback = _splitWhereCallback;
+        w.xSelectCallback = sqlite3SelectWalkFail;
+        w.u.pSelect = view;
+        w.eCode = view == NULL;
+        if (sqlite3WalkExpr(&w, p->pWhere) != WRC_Continue)
+            return NULL;
+    }
+
+    node = (dohsql_node_t *)calloc(1, sizeof(dohsql_node_t) +
+                                          nnodes * sizeof(void *));
+    if (!node)
+        return NULL;
+    node->type = AST_TYPE_UNION;
+    node->stripe = -1;
+    node->nodes = (dohsql_node_t **)(node + 1);
+    node->ncols = p->pEList->nExpr;
+
+    /* at most one avg count per column, plus the hidden group by keys */
+    narm = node->ncols * 2 + (p->pGroupBy ? p->pGroupBy->nExpr : 0);
+    cmb = node->combine = calloc(1, sizeof(struct dohsql_combine));
+    if (!cmb)
+        goto err;
+    cmb->op = calloc(narm, sizeof(int));
+    cmb->arg = calloc(narm, sizeof(int));
+    cmb->group = calloc(narm, sizeof(int));
+    if (!cmb->op || !cmb->arg || !cmb->group)
+        goto err;
+    if (!view) {
+        node->tbl = sqlite3_mprintf("%s", src->pTab->zName);
+        if (!node->tbl)
+            goto err;
+    }
+
+    /* the view arms are linked last to first */
+    for (i = 0, arm = view; i < nnodes; i++) {
+        sub = node->nodes[i] = calloc(1, sizeof(dohsql_node_t));
+        if (!sub)
+            goto err;
+        node->nnodes++;
+        sub->type = AST_TYPE_SELECT;
+        sub->stripe = view ? -1 : i;
+        sub->ncols = node->ncols;
+        sub->sql = _gen_split_select(
+            v, p, view, view ? arm->pSrc->a[0].pTab->zName : node->tbl,
+            view == NULL, cmb, &sub->params);
+        if (!sub->sql)
+            goto err;
+        tmp = node->sql ? sqlite3_mprintf("%s uNioN aLL %s", node->sql,
+                                          sub->sql)
+                        : sqlite3_mprintf("%s", sub->sql);
+        sqlite3_free(node->sql);
+        node->sql = tmp;
+        if (!tmp)
+            goto err;
+        if (arm)
+            arm = arm->pPrior;
+    }
+
+    /* the view is distributed, don't generate its arms again */
+    for (arm = view; arm; arm = arm->pPrior)
+        arm->selFlags |= SF_ASTIncluded;
+
+    return node;
+
+err:
+    node_free(&node, v->db);
+    return NULL;
+}
+
 static dohsql_node_t *gen_select(Vdbe *v, Select *p)
 {
     Select *crt;
@@ -542,6 +1024,11 @@ static dohsql_node_t *gen_select(Vdbe *v, Select *p)
         crt = crt->pPrior;
     }
 
+    /* aggregates over one table or union view can be split */
+    if (!not_recognized && p->op == TK_SELECT && !p->pWith &&
+        p->pSrc->nSrc == 1 && (ret = gen_agg_split(v, p)) != NULL)
+        return ret;
+
     /* no with, joins or subqueries */
     if (not_recognized || p->pSrc->nSrc == 0 /*with*/ ||
         p->pSrc->nSrc > 1 /*joins*/ || p->pSrc->a->pSelect /*subquery*/ ||
@@ -63,6 +63,8 @@ struct dohsql_connector {
     long long queue_size;   /* size of queue in bytes */
     int nparams;            /* parameters for the child */
     struct param_data *params;
+    int stripe;             /* data stripe the child scans, -1 for all */
+    char *tbl;              /* table of the stripe scan */
     dohsql_connector_stats_t stats;
 };
 typedef struct dohsql_connector dohsql_connector_t;
@@ -108,6 +110,12 @@ struct dohsql {
     int order_size;
     int *order_dir;
     int nparams;
+    /* aggregate fold support */
+    struct dohsql_combine *combine;
+    row_t **parts;  /* partial rows, folded in place */
+    int nparts;
+    int next_part;  /* next folded row to return */
+    int folded;
     /* stats */
     dohsql_req_stats_t stats;
     struct plugin_callbacks backup;
@@ -135,6 +143,8 @@ static void sqlengine_work_shard(struct thdpool *pool, void *work,
 static int order_init(dohsql_t *conns, dohsql_node_t *node);
 static int dohsql_dist_next_row_ordered(struct sqlclntstate *clnt,
                                         sqlite3_stmt *stmt);
+static int dohsql_dist_next_row_combined(struct sqlclntstate *clnt,
+                                         sqlite3_stmt *stmt);
 static int _param_index(dohsql_connector_t *conn, const char *b, int64_t *c);
 static int _param_value(dohsql_connector_t *conn, struct param_data *b, int c,
                         const char *src);
@@ -740,6 +750,264 @@ got_row:
     return SQLITE_ROW;
 }
 
+void dohsql_combine_free(struct dohsql_combine *cmb)
+{
+    if (!cmb)
+        return;
+    free(cmb->op);
+    free(cmb->arg);
+    free(cmb->group);
+    free(cmb);
+}
+
+static row_t *_copy_row(const Mem *src, int ncols)
+{
+    row_t *row;
+    int i;
+
+    row = sqlite3_malloc64(sizeof(Mem) * ncols);
+    if (!row)
+        return NULL;
+    for (i = 0; i < ncols; i++) {
+        if (sqlite3_value_dup_inplace(&row[i], &src[i]) != SQLITE_OK) {
+            while (i-- > 0)
+                sqlite3_value_free_inplace(&row[i]);
+            sqlite3_free(row);
+            return NULL;
+        }
+    }
+    return row;
+}
+
+static void _free_row(row_t *row, int ncols)
+{
+    int i;
+
+    for (i = 0; i < ncols; i++)
+        sqlite3_value_free_inplace(&row[i]);
+    sqlite3_free(row);
+}
+
+static void _free_parts(dohsql_t *conns)
+{
+    int i;
+
+    for (i = 0; i < conns->nparts; i++)
+        _free_row(conns->parts[i], conns->combine->ncols);
+    free(conns->parts);
+    conns->parts = NULL;
+    conns->nparts = 0;
+}
+
+static int _add_part(dohsql_t *conns, const Mem *src)
+{
+    row_t **parts;
+    row_t *row;
+
+    if ((conns->nparts & (conns->nparts - 1)) == 0) {
+        parts = realloc(conns->parts,
+                        sizeof(row_t *) * (conns->nparts ? conns->nparts * 2 : 1));
+        if (!parts)
+            return SQLITE_NOMEM;
+        conns->parts = parts;
+    }
+    row = _copy_row(src, conns->combine->ncols);
+    if (!row)
+        return SQLITE_NOMEM;
+    conns->parts[conns->nparts++] = row;
+    return SQLITE_OK;
+}
+
+/* Fold val into acc; returns -1 if a sum of integers overflows, which fails
+   the statement the way sqlite's sum() does */
+static int _combine_value(int op, Mem *acc, Mem *val)
+{
+    i64 sum;
+
+    if (op == DOHSQL_COMBINE_GROUP || sqlite3_value_type(val) == SQLITE_NULL)
+        return 0;
+
+    if (sqlite3_value_type(acc) != SQLITE_NULL) {
+        switch (op) {
+        case DOHSQL_COMBINE_SUM:
+        case DOHSQL_COMBINE_AVG:
+            if (sqlite3_value_type(acc) == SQLITE_INTEGER &&
+                sqlite3_value_type(val) == SQLITE_INTEGER) {
+                if (__builtin_add_overflow(sqlite3_value_int64(acc),
+                                           sqlite3_value_int64(val), &sum))
+                    return -1;
+                sqlite3VdbeMemSetInt64(acc, sum);
+            } else {
+                sqlite3VdbeMemSetDouble(acc, sqlite3_value_double(acc) +
+                                                 sqlite3_value_double(val));
+            }
+            return 0;
+        case DOHSQL_COMBINE_MIN:
+            if (sqlite3MemCompare(val, acc, NULL) >= 0)
+                return 0;
+            break;
+        case DOHSQL_COMBINE_MAX:
+            if (sqlite3MemCompare(val, acc, NULL) <= 0)
+                return 0;
+            break;
+        }
+    }
+
+    sqlite3_value_free_inplace(acc);
+    if (sqlite3_value_dup_inplace(acc, val) != SQLITE_OK)
+        acc->flags = MEM_Null;
+    return 0;
+}
+
+static int _cmp_group(const struct dohsql_combine *cmb, const row_t *a,
+                      const row_t *b)
+{
+    int i, rc;
+
+    for (i = 0; i < cmb->ngroup; i++) {
+        rc = sqlite3MemCompare(&a[cmb->group[i]], &b[cmb->group[i]], NULL);
+        if (rc)
+            return rc;
+    }
+    return 0;
+}
+
+struct part_ref {
+    const struct dohsql_combine *cmb;
+    row_t *row;
+};
+
+static int _cmp_part(const void *a, const void *b)
+{
+    const struct part_ref *pa = a;
+    const struct part_ref *pb = b;
+
+    return _cmp_group(pa->cmb, pa->row, pb->row);
+}
+
+/* Sort the partial rows by group and fold each group into its first row;
+   the groups keep the order a serial group by returns them in.  An error
+   is left on the coordinator statement, where the client reads it from. */
+static int _fold_parts(dohsql_t *conns, Vdbe *v)
+{
+    const struct dohsql_combine *cmb = conns->combine;
+    struct part_ref *refs;
+    row_t *acc;
+    int overflow = 0;
+    int i, j, n;
+
+    if (cmb->ngroup && conns->nparts > 1) {
+        refs = malloc(sizeof(*refs) * conns->nparts);
+        if (!refs)
+            return SQLITE_NOMEM;
+        for (i = 0; i < conns->nparts; i++) {
+            refs[i].cmb = cmb;
+            refs[i].row = conns->parts[i];
+        }
+        qsort(refs, conns->nparts, sizeof(*refs), _cmp_part);
+        for (i = 0; i < conns->nparts; i++)
+            conns->parts[i] = refs[i].row;
+        free(refs);
+    }
+
+    for (i = 0, n = 0; i < conns->nparts; n++) {
+        acc = conns->parts[n] = conns->parts[i++];
+        while (i < conns->nparts &&
+               (!cmb->ngroup || !_cmp_group(cmb, acc, conns->parts[i]))) {
+            for (j = 0; j < cmb->ncols; j++) {
+                if (_combine_value(cmb->op[j], &acc[j], &conns->parts[i][j]))
+                    overflow = 1;
+            }
+            _free_row(conns->parts[i++], cmb->ncols);
+        }
+        for (j = 0; j < conns->ncols; j++) {
+            if (cmb->op[j] != DOHSQL_COMBINE_AVG)
+                continue;
+            if (sqlite3_value_int64(&acc[cmb->arg[j]]) == 0)
+                sqlite3VdbeMemSetNull(&acc[j]);
+            else
+                sqlite3VdbeMemSetDouble(
+                    &acc[j], sqlite3_value_double(&acc[j]) /
+                                 sqlite3_value_int64(&acc[cmb->arg[j]]));
+        }
+    }
+    conns->nparts = n;
+
+    if (overflow) {
+        sqlite3VdbeError(v, "integer overflow");
+        v->rc = SQLITE_ERROR;
+        return SQLITE_ERROR;
+    }
+    return SQLITE_OK;
+}
+
+/* Collect the partial rows of all the arms */
+static int _gather_parts(struct sqlclntstate *clnt, sqlite3_stmt *stmt)
+{
+    dohsql_t *conns = clnt->conns;
+    row_t *row;
+    int rc;
+
+    while ((rc = init_next_row(clnt, stmt)) == SQLITE_ROW) {
+        if ((rc = _add_part(conns, ((Vdbe *)stmt)->pResultSet)) != SQLITE_OK) {
+            sqlite3_reset(stmt);
+            _signal_children_master_is_done(conns);
+            return rc;
+        }
+    }
+    if (rc != SQLITE_DONE)
+        return rc;
+
+    while ((rc = _get_a_parallel_row(conns, &row, &conns->child_err)) !=
+           SQLITE_DONE) {
+        if (rc == SQLITE_ROW) {
+            if ((rc = _add_part(conns, row)) != SQLITE_OK) {
+                _signal_children_master_is_done(conns);
+                return rc;
+            }
+        } else if (rc == SQLITE_OK) {
+            poll(NULL, 0, 10);
+        } else {
+            return rc;
+        }
+    }
+    /* recycle the last child row */
+    add_row(conns, 0, NULL);
+
+    return SQLITE_OK;
+}
+
+/**
+ * this folds the partial aggregates of N engine outputs
+ *
+ */
+static int dohsql_dist_next_row_combined(struct sqlclntstate *clnt,
+                                         sqlite3_stmt *stmt)
+{
+    dohsql_t *conns = clnt->conns;
+    int rc;
+
+    if (!conns->folded) {
+        conns->folded = 1;
+        rc = _gather_parts(clnt, stmt);
+        if (rc == SQLITE_OK)
+            rc = _fold_parts(conns, (Vdbe *)stmt);
+        if (rc != SQLITE_OK)
+            return rc;
+    }
+
+    if (conns->next_part >= conns->nparts)
+        return SQLITE_DONE;
+
+    /* the rows are ours; any child index makes the column callbacks read
+       them */
+    conns->row = conns->parts[conns->next_part++];
+    conns->row_src = 1;
+    conns->nrows++;
+
+    return SQLITE_ROW;
+}
+
 static int dohsql_write_response(struct sqlclntstate *c, int t, void *a, int i)
 {
     if (gbl_plugin_api_debug)
@@ -1085,6 +1353,7 @@ static void _shard_disconnect(dohsql_connector_t *conn)
         free(conn->cols);
 
     free(conn->params);
+    free(conn->tbl);
     free(clnt->sql);
     clnt->sql = NULL;
     cleanup_clnt(clnt);
@@ -1098,8 +1367,12 @@ static void _master_clnt_set(struct sqlclntstate *clnt)
     clnt->conns->backup = clnt->plugin;
 
     clnt->plugin.column_count = dohsql_dist_column_count;
-    clnt->plugin.next_row = (clnt->conns->order) ? dohsql_dist_next_row_ordered
-                                                 : dohsql_dist_next_row;
+    if (clnt->conns->combine)
+        clnt->plugin.next_row = dohsql_dist_next_row_combined;
+    else
+        clnt->plugin.next_row = (clnt->conns->order)
+                                    ? dohsql_dist_next_row_ordered
+                                    : dohsql_dist_next_row;
     clnt->plugin.column_type = dohsql_dist_column_type;
     clnt->plugin.column_int64 = dohsql_dist_column_int64;
     clnt->plugin.column_double = dohsql_dist_column_double;
@@ -1176,6 +1449,8 @@ int dohsql_distribute(dohsql_node_t *node)
             return SHARD_ERR_MALLOC;
         }
     }
+    conns->combine = node->combine;
+    node->combine = NULL;
     clnt->conns = conns;
     /* augment interface */
     _master_clnt_set(clnt);
@@ -1188,6 +1463,10 @@ int dohsql_distribute(dohsql_node_t *node)
         if ((rc = _shard_connect(clnt, &conns->conns[i], node->nodes[i]->sql,
                                  nparams, params)) != 0)
             return rc;
+        conns->conns[i].stripe = node->nodes[i]->stripe;
+        if (conns->conns[i].stripe >= 0 &&
+            !(conns->conns[i].tbl = strdup(node->tbl)))
+            return SHARD_ERR_MALLOC;
 
         if (i > 0) {
             /* launch the new sqlite engine a the next shard */
@@ -1226,6 +1505,15 @@ int dohsql_end_distribute(struct sqlclntstate *clnt, struct reqlogger *logger)
     if (!clnt->conns)
         return SHARD_NOERR;
 
+    if (conns->combine) {
+        /* once returning folded rows, the current row is one of the parts */
+        if (conns->next_part > 0) {
+            conns->row = NULL;
+            conns->row_src = 0;
+        }
+        _free_parts(conns);
+    }
+
     if (conns->row && conns->row_src) {
         Pthread_mutex_lock(&conns->conns[conns->row_src].mtx);
         if (queue_add(conns->conns[conns->row_src].que_free, conns->row))
@@ -1290,6 +1578,7 @@ int dohsql_end_distribute(struct sqlclntstate *clnt, struct reqlogger *logger)
         free(conns->order);
         free(conns->order_dir);
     }
+    dohsql_combine_free(conns->combine);
     _master_clnt_reset(clnt);
     clnt->conns = NULL;
     free(conns);
@@ -1300,6 +1589,22 @@ int dohsql_end_distribute(struct sqlclntstate *clnt, struct reqlogger *logger)
 #define DOHSQL_CLIENT                                                          \
     (clnt->plugin.state && clnt->plugin.write_response == dohsql_write_response)
 
+int dohsql_scan_stripe(struct sqlclntstate *clnt, const char *tablename)
+{
+    dohsql_connector_t *conn;
+
+    if (clnt->conns)
+        conn = &clnt->conns->conns[0];
+    else if (DOHSQL_CLIENT)
+        conn = clnt->plugin.state;
+    else
+        return -1;
+
+    if (conn->stripe < 0 || strcasecmp(conn->tbl, tablename))
+        return -1;
+    return conn->stripe;
+}
+
 void dohsql_wait_for_master(sqlite3_stmt *stmt, struct sqlclntstate *clnt)
 {
     dohsql_connector_t *conn;
@@ -1830,7 +2135,11 @@ void explain_distribution(dohsql_node_t *node)
         return;
 
     if (node->type == AST_TYPE_UNION) {
-        snprintf(str, sizeof(str), "Threads %d", node->nnodes);
+        if (node->npruned)
+            snprintf(str, sizeof(str), "Threads %d, pruned shards %d",
+                     node->nnodes, node->npruned);
+        else
+            snprintf(str, sizeof(str), "Threads %d", node->nnodes);
         char *pstr = &str[0];
 
         if (write_response(clnt, RESPONSE_ROW_STR, &pstr, 1))
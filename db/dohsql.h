@@ -25,6 +25,23 @@ struct params_info {
     struct param_data *params;
 };
 
+/* how a union folds the partial aggregates of its arms */
+enum dohsql_combine_op {
+    DOHSQL_COMBINE_GROUP = 1, /* group by key */
+    DOHSQL_COMBINE_SUM,
+    DOHSQL_COMBINE_MIN,
+    DOHSQL_COMBINE_MAX,
+    DOHSQL_COMBINE_AVG /* total, divided by the count column "arg" */
+};
+
+struct dohsql_combine {
+    int ncols;  /* columns of the arm rows; the leading ones are returned */
+    int *op;    /* dohsql_combine_op, per arm column */
+    int *arg;   /* count column of an avg, per arm column */
+    int *group; /* arm columns of the group by keys, in group by order */
+    int ngroup;
+};
+
 struct dohsql_node {
     enum ast_type type;
     char *sql;
@@ -35,6 +52,10 @@ struct dohsql_node {
     int *order_dir;
     int nparams;
     struct params_info *params;
+    int stripe; /* data stripe scanned by this select, -1 for all */
+    char *tbl;  /* table of the stripe scan */
+    struct dohsql_combine *combine; /* set if the union folds aggregates */
+    int npruned; /* time partition shards left out of the union */
 };
 typedef struct dohsql_node dohsql_node_t;
 
@@ -66,6 +87,19 @@ void dohsql_wait_for_master(sqlite3_stmt *stmt, struct sqlclntstate *clnt);
     struct sql_thread *thd = pthread_getspecific(query_info_key);              \
     struct sqlclntstate *clnt = thd->clnt;
 
+/**
+ * Return the data stripe a table scan of "tablename" is restricted to,
+ * or -1 if it has to scan all of them
+ *
+ */
+int dohsql_scan_stripe(struct sqlclntstate *clnt, const char *tablename);
+
+/**
+ * Free a combine descriptor
+ *
+ */
+void dohsql_combine_free(struct dohsql_combine *cmb);
+
 /**
  * Return 1 if this sql thread servers a parallel statement
  *
@@ -38,6 +38,8 @@
 #include "plhash.h"
 #include "logmsg.h"
 #include "thread_stats.h"
+#include "thread_util.h"
+#include "flibc.h"
 #include "dbinc/locker_info.h"
 
 #include "cson_amalgamation_core.h"
@@ -56,10 +58,36 @@ static int eventlog_verbose = 0;
 
 static gzFile eventlog = NULL;
 static pthread_mutex_t eventlog_lk = PTHREAD_MUTEX_INITIALIZER;
+/* held while writing to or swapping the file, always after eventlog_lk */
+static pthread_mutex_t eventlog_write_lk = PTHREAD_MUTEX_INITIALIZER;
 static gzFile eventlog_open(void);
 int eventlog_every_n = 1;
 int64_t eventlog_count = 0;
 
+/* Binary format.  The file starts with EVENTLOG_BIN_MAGIC and a 4-byte
+   version, then each event is a 4-byte length followed by the encoded
+   event object.  A value is a 1-byte tag and its body:
+       'o' object   4-byte count, then count (4-byte key length, key, value)
+       'a' array    4-byte count, then count values
+       's' string   4-byte length, then the bytes
+       'i' integer  8 bytes
+       'd' double   8 bytes, IEEE 754
+       't' true, 'f' false, 'n' null
+   Lengths and numbers are big-endian.  cdb2_sqlreplay reads either format
+   and -J converts a binary log to JSON; bump the version if the encoding
+   changes. */
+#define EVENTLOG_BIN_MAGIC "CDB2EVLG"
+#define EVENTLOG_BIN_MAGICSZ 8
+#define EVENTLOG_BIN_VERSION 1
+static int eventlog_binary = 0;
+
+/* In async mode request threads serialize events into a ring buffer of
+   their own, and a writer thread compresses and writes them.  An event that
+   doesn't fit in its thread's ring is dropped. */
+static int eventlog_async = 0;
+static int eventlog_ringsz = 1024 * 1024;
+static int64_t eventlog_dropped = 0;
+
 static void eventlog_roll(void);
 #define min(x, y) ((x) < (y) ? (x) : (y))
 
@@ -72,11 +100,54 @@ LISTC_T(struct sqltrack) sql_statements;
 
 static hash_t *seen_sql;
 
+/* a serialized event, or a batch of them */
+struct evbuf {
+    char *data;
+    size_t len;
+    size_t cap;
+};
+
+/* Single producer, single consumer: only the owning thread moves head and
+   only the writer moves tail. */
+struct evring {
+    char *buf;
+    uint64_t size;
+    uint64_t head;
+    uint64_t tail;
+    int exited;
+    /* the writer's snapshot, under evring_lk */
+    uint64_t snap;
+    int snap_exited;
+    LINKC_T(struct evring) lnk;
+};
+
+static pthread_mutex_t evring_lk = PTHREAD_MUTEX_INITIALIZER;
+static LISTC_T(struct evring) evrings;
+static pthread_key_t evring_key;
+static __thread struct evring *my_evring;
+/* newsql events in async mode, under eventlog_lk */
+static struct evbuf eventlog_pending;
+
+static pthread_mutex_t writer_lk = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_cond = PTHREAD_COND_INITIALIZER;
+static int writer_started = 0;
+static uint64_t flush_requested = 0;
+static uint64_t flush_done = 0;
+
+static void evring_exit(void *arg)
+{
+    struct evring *r = arg;
+    /* the writer frees it once it's drained */
+    __atomic_store_n(&r->exited, 1, __ATOMIC_RELEASE);
+}
+
 void eventlog_init()
 {
     seen_sql =
         hash_init_o(offsetof(struct sqltrack, fingerprint), FINGERPRINTSZ);
     listc_init(&sql_statements, offsetof(struct sqltrack, lnk));
+    listc_init(&evrings, offsetof(struct evring, lnk));
+    Pthread_key_create(&evring_key, evring_exit);
     if (eventlog_enabled) eventlog = eventlog_open();
 }
 
@@ -135,6 +206,11 @@ static gzFile eventlog_open()
         return NULL;
     }
     gbl_eventlog_fname = fname;
+    if (eventlog_binary) {
+        uint32_t version = htonl(EVENTLOG_BIN_VERSION);
+        bytes_written += gzwrite(f, EVENTLOG_BIN_MAGIC, EVENTLOG_BIN_MAGICSZ);
+        bytes_written += gzwrite(f, &version, sizeof(version));
+    }
     return f;
 }
 
@@ -359,19 +435,316 @@ void eventlog_perfdata(cson_object *obj, const struct reqlogger *logger)
     cson_object_set(obj, "perf", perfval);
 }
 
-int write_json(void *state, const void *src, unsigned int n)
+int write_logmsg(void *state, const void *src, unsigned int n)
 {
-    int rc = gzwrite((gzFile)state, src, n);
-    bytes_written += rc;
-    return rc != n;
+    logmsg(LOGMSG_USER, "%.*s", n, (const char *)src);
+    return 0;
 }
 
-int write_logmsg(void *state, const void *src, unsigned int n)
+static int evbuf_append(struct evbuf *b, const void *src, size_t n)
 {
-    logmsg(LOGMSG_USER, "%.*s", n, (const char *)src);
+    if (b->len + n > b->cap) {
+        size_t cap = b->cap ? b->cap : 1024;
+        char *p;
+        while (cap < b->len + n)
+            cap *= 2;
+        if ((p = realloc(b->data, cap)) == NULL)
+            return 1;
+        b->data = p;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, src, n);
+    b->len += n;
     return 0;
 }
 
+static int write_evbuf(void *state, const void *src, unsigned int n)
+{
+    return evbuf_append(state, src, n);
+}
+
+static void evbuf_u32(struct evbuf *b, uint32_t v)
+{
+    v = htonl(v);
+    evbuf_append(b, &v, sizeof(v));
+}
+
+/* overwrite a length or count written earlier as a placeholder */
+static void evbuf_put_u32(struct evbuf *b, size_t off, uint32_t v)
+{
+    if (off + sizeof(v) > b->len)
+        return;
+    v = htonl(v);
+    memcpy(b->data + off, &v, sizeof(v));
+}
+
+static void evbin_bytes(struct evbuf *b, const char *s, unsigned int len)
+{
+    evbuf_u32(b, len);
+    evbuf_append(b, s, len);
+}
+
+static void evbin_value(struct evbuf *b, cson_value *v)
+{
+    char tag;
+
+    if (cson_value_is_object(v)) {
+        cson_object_iterator it;
+        cson_kvp *kvp;
+        uint32_t count = 0;
+        size_t off;
+
+        tag = 'o';
+        evbuf_append(b, &tag, 1);
+        off = b->len;
+        evbuf_u32(b, 0);
+        cson_object_iter_init(cson_value_get_object(v), &it);
+        while ((kvp = cson_object_iter_next(&it)) != NULL) {
+            cson_string *key = cson_kvp_key(kvp);
+            evbin_bytes(b, cson_string_cstr(key),
+                        cson_string_length_bytes(key));
+            evbin_value(b, cson_kvp_value(kvp));
+            count++;
+        }
+        evbuf_put_u32(b, off, count);
+    } else if (cson_value_is_array(v)) {
+        cson_array *arr = cson_value_get_array(v);
+        unsigned int n = cson_array_length_get(arr);
+
+        tag = 'a';
+        evbuf_append(b, &tag, 1);
+        evbuf_u32(b, n);
+        for (unsigned int i = 0; i < n; i++)
+            evbin_value(b, cson_array_get(arr, i));
+    } else if (cson_value_is_string(v)) {
+        cson_string *str = cson_value_get_string(v);
+
+        tag = 's';
+        evbuf_append(b, &tag, 1);
+        evbin_bytes(b, cson_string_cstr(str), cson_string_length_bytes(str));
+    } else if (cson_value_is_integer(v)) {
+        int64_t i = flibc_htonll(cson_value_get_integer(v));
+
+        tag = 'i';
+        evbuf_append(b, &tag, 1);
+        evbuf_append(b, &i, sizeof(i));
+    } else if (cson_value_is_double(v)) {
+        double d = flibc_htond(cson_value_get_double(v));
+
+        tag = 'd';
+        evbuf_append(b, &tag, 1);
+        evbuf_append(b, &d, sizeof(d));
+    } else if (cson_value_is_bool(v)) {
+        tag = cson_value_get_bool(v) ? 't' : 'f';
+        evbuf_append(b, &tag, 1);
+    } else {
+        tag = 'n';
+        evbuf_append(b, &tag, 1);
+    }
+}
+
+/* one event, as it goes in the file */
+static void eventlog_serialize(struct evbuf *b, cson_value *val)
+{
+    if (eventlog_binary) {
+        size_t off = b->len;
+        evbuf_u32(b, 0);
+        evbin_value(b, val);
+        evbuf_put_u32(b, off, b->len - off - sizeof(uint32_t));
+    } else {
+        cson_output(val, write_evbuf, b, &opt);
+    }
+}
+
+static struct evring *evring_get(void)
+{
+    struct evring *r = my_evring;
+    if (r)
+        return r;
+    if ((r = calloc(1, sizeof(struct evring))) == NULL)
+        return NULL;
+    r->size = eventlog_ringsz;
+    if ((r->buf = malloc(r->size)) == NULL) {
+        free(r);
+        return NULL;
+    }
+    Pthread_mutex_lock(&evring_lk);
+    listc_abl(&evrings, r);
+    Pthread_mutex_unlock(&evring_lk);
+    Pthread_setspecific(evring_key, r);
+    my_evring = r;
+    return r;
+}
+
+static void evring_put(const char *data, size_t len)
+{
+    struct evring *r = evring_get();
+    uint64_t tail, pos;
+    size_t n;
+
+    if (r == NULL) {
+        __atomic_add_fetch(&eventlog_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    if (len > r->size - (r->head - tail)) {
+        __atomic_add_fetch(&eventlog_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    pos = r->head % r->size;
+    n = min(len, r->size - pos);
+    memcpy(r->buf + pos, data, n);
+    memcpy(r->buf, data + n, len - n);
+    __atomic_store_n(&r->head, r->head + len, __ATOMIC_RELEASE);
+}
+
+/* move what the owner had written by the snapshot into b */
+static void evring_take(struct evring *r, struct evbuf *b)
+{
+    uint64_t len = r->snap - r->tail;
+    uint64_t pos = r->tail % r->size;
+    size_t n = min(len, r->size - pos);
+
+    evbuf_append(b, r->buf + pos, n);
+    evbuf_append(b, r->buf, len - n);
+    __atomic_store_n(&r->tail, r->snap, __ATOMIC_RELEASE);
+}
+
+static void eventlog_drain(int flush)
+{
+    struct evbuf b;
+    struct evring *r, *tmp;
+
+    /* A newsql event is queued under eventlog_lk before any thread can see
+       the fingerprint in seen_sql, so everything in the rings as of this
+       snapshot has its newsql in eventlog_pending by the time we take it
+       below, and it's written first. */
+    Pthread_mutex_lock(&evring_lk);
+    LISTC_FOR_EACH(&evrings, r, lnk)
+    {
+        r->snap_exited = __atomic_load_n(&r->exited, __ATOMIC_ACQUIRE);
+        r->snap = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    }
+    Pthread_mutex_unlock(&evring_lk);
+
+    Pthread_mutex_lock(&eventlog_lk);
+    b = eventlog_pending;
+    memset(&eventlog_pending, 0, sizeof(eventlog_pending));
+    Pthread_mutex_unlock(&eventlog_lk);
+
+    Pthread_mutex_lock(&evring_lk);
+    LISTC_FOR_EACH_SAFE(&evrings, r, tmp, lnk)
+    {
+        evring_take(r, &b);
+        if (r->snap_exited) {
+            listc_rfl(&evrings, r);
+            free(r->buf);
+            free(r);
+        }
+    }
+    Pthread_mutex_unlock(&evring_lk);
+
+    Pthread_mutex_lock(&eventlog_write_lk);
+    if (eventlog != NULL) {
+        if (b.len > 0)
+            bytes_written += gzwrite(eventlog, b.data, b.len);
+        if (flush)
+            gzflush(eventlog, 1);
+    }
+    Pthread_mutex_unlock(&eventlog_write_lk);
+    free(b.data);
+}
+
+static void *eventlog_writer(void *arg)
+{
+    thread_started("eventlog writer");
+
+    while (1) {
+        struct timespec ts;
+        uint64_t flush;
+
+        Pthread_mutex_lock(&writer_lk);
+        if (flush_done == flush_requested) {
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += 100 * 1000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&writer_cond, &writer_lk, &ts);
+        }
+        flush = flush_requested;
+        Pthread_mutex_unlock(&writer_lk);
+
+        eventlog_drain(flush != flush_done);
+
+        Pthread_mutex_lock(&writer_lk);
+        if (flush != flush_done) {
+            flush_done = flush;
+            Pthread_cond_broadcast(&writer_cond);
+        }
+        Pthread_mutex_unlock(&writer_lk);
+    }
+    return NULL;
+}
+
+/* under eventlog_lk */
+static void eventlog_start_writer(void)
+{
+    pthread_t tid;
+
+    if (writer_started)
+        return;
+    if (pthread_create(&tid, &gbl_pthread_attr_detached, eventlog_writer,
+                       NULL) != 0) {
+        logmsg(LOGMSG_ERROR, "%s: can't create eventlog writer\n", __func__);
+        return;
+    }
+    writer_started = 1;
+}
+
+/* wait until everything logged so far is written and flushed */
+static void eventlog_flush_async(void)
+{
+    uint64_t want;
+
+    Pthread_mutex_lock(&writer_lk);
+    want = ++flush_requested;
+    Pthread_cond_broadcast(&writer_cond);
+    while (flush_done < want)
+        Pthread_cond_wait(&writer_cond, &writer_lk);
+    Pthread_mutex_unlock(&writer_lk);
+}
+
+/* Write out an event.  newsql events are written with eventlog_lk held,
+   the rest without. */
+static void eventlog_write(cson_value *val, int locked)
+{
+    struct evbuf b = {0};
+
+    eventlog_serialize(&b, val);
+
+    if (eventlog_async && writer_started) {
+        if (locked)
+            evbuf_append(&eventlog_pending, b.data, b.len);
+        else
+            evring_put(b.data, b.len);
+        free(b.data);
+        return;
+    }
+
+    if (!locked)
+        Pthread_mutex_lock(&eventlog_lk);
+    if (eventlog != NULL && eventlog_enabled && b.len > 0) {
+        Pthread_mutex_lock(&eventlog_write_lk);
+        bytes_written += gzwrite(eventlog, b.data, b.len);
+        Pthread_mutex_unlock(&eventlog_write_lk);
+    }
+    if (!locked)
+        Pthread_mutex_unlock(&eventlog_lk);
+    free(b.data);
+}
+
 static void eventlog_context(cson_object *obj, const struct reqlogger *logger)
 {
     if (logger->ncontext > 0) {
@@ -449,7 +822,7 @@ static void eventlog_add_newsql(cson_object *obj, const struct reqlogger *logger
     /* yes, this can spill the file to beyond the configured size - we need
        this
        event to be in the same file as the event its being logged for */
-    cson_output(newval, write_json, eventlog, &opt);
+    eventlog_write(newval, 1);
     if (eventlog_verbose) cson_output(newval, write_logmsg, stdout, &opt);
     cson_value_free(newval);
 }
@@ -567,10 +940,7 @@ void eventlog_add(const struct reqlogger *logger)
     obj = cson_value_get_object(val);
     eventlog_add_int(obj, logger);
 
-    Pthread_mutex_lock(&eventlog_lk);
-    if (eventlog != NULL && eventlog_enabled)
-        cson_output(val, write_json, eventlog, &opt);
-    Pthread_mutex_unlock(&eventlog_lk);
+    eventlog_write(val, 0);
 
     if (eventlog_verbose) cson_output(val, write_logmsg, stdout, &opt);
 
@@ -586,17 +956,24 @@ void cson_snap_info_key(cson_object *obj, snap_uid_t *snap_info)
 
 void eventlog_status(void)
 {
-    if (eventlog_enabled == 1)
+    if (eventlog_enabled == 1) {
         logmsg(LOGMSG_USER, "Eventlog enabled, file:%s\n", gbl_eventlog_fname);
-    else
+        logmsg(LOGMSG_USER, "Eventlog format %s, %s, %" PRId64
+                            " events dropped\n",
+               eventlog_binary ? "binary" : "json",
+               eventlog_async ? "async" : "sync",
+               __atomic_load_n(&eventlog_dropped, __ATOMIC_RELAXED));
+    } else
         logmsg(LOGMSG_USER, "Eventlog disabled\n");
 }
 
 static void eventlog_roll(void)
 {
+    Pthread_mutex_lock(&eventlog_write_lk);
     eventlog_close();
 
     eventlog = eventlog_open();
+    Pthread_mutex_unlock(&eventlog_write_lk);
 }
 
 static void eventlog_enable(void)
@@ -607,7 +984,9 @@ static void eventlog_enable(void)
 
 static void eventlog_disable(void)
 {
+    Pthread_mutex_lock(&eventlog_write_lk);
     eventlog_close();
+    Pthread_mutex_unlock(&eventlog_write_lk);
     eventlog = NULL;
     eventlog_enabled = 0;
     bytes_written = 0;
@@ -618,7 +997,8 @@ void eventlog_stop(void)
     eventlog_disable();
 }
 
-static void eventlog_process_message_locked(char *line, int lline, int *toff)
+static void eventlog_process_message_locked(char *line, int lline, int *toff,
+                                            int *flush)
 {
     char *tok;
     int ltok;
@@ -710,8 +1090,62 @@ static void eventlog_process_message_locked(char *line, int lline, int *toff)
             logmsg(LOGMSG_ERROR, "Expected on/off for 'verbose'\n");
             return;
         }
+    } else if (tokcmp(tok, ltok, "format") == 0) {
+        int binary;
+        tok = segtok(line, lline, toff, &ltok);
+        if (tokcmp(tok, ltok, "binary") == 0)
+            binary = 1;
+        else if (tokcmp(tok, ltok, "json") == 0)
+            binary = 0;
+        else {
+            logmsg(LOGMSG_ERROR, "Expected binary/json for 'format'\n");
+            return;
+        }
+        /* queued events are already serialized in the old format */
+        if (eventlog_async && binary != eventlog_binary) {
+            logmsg(LOGMSG_ERROR, "Turn off async to change the format\n");
+            return;
+        }
+        if (binary != eventlog_binary) {
+            eventlog_binary = binary;
+            /* one format per file */
+            if (eventlog != NULL)
+                eventlog_roll();
+        }
+        logmsg(LOGMSG_USER, "Eventlog format is %s\n",
+               binary ? "binary" : "json");
+    } else if (tokcmp(tok, ltok, "async") == 0) {
+        tok = segtok(line, lline, toff, &ltok);
+        if (tokcmp(tok, ltok, "on") == 0) {
+            eventlog_start_writer();
+            eventlog_async = writer_started;
+        } else if (tokcmp(tok, ltok, "off") == 0) {
+            /* the writer still drains what's queued */
+            eventlog_async = 0;
+            *flush = writer_started;
+        } else {
+            logmsg(LOGMSG_ERROR, "Expected on/off for 'async'\n");
+            return;
+        }
+    } else if (tokcmp(tok, ltok, "ringsize") == 0) {
+        int sz;
+        tok = segtok(line, lline, toff, &ltok);
+        sz = toknum(tok, ltok);
+        if (sz < 64 * 1024) {
+            logmsg(LOGMSG_ERROR, "Ring size must be at least 64K\n");
+            return;
+        }
+        /* for threads that start logging from now on */
+        eventlog_ringsz = sz;
+        logmsg(LOGMSG_USER, "Eventlog ring size %d bytes\n", sz);
     } else if (tokcmp(tok, ltok, "flush") == 0) {
-        gzflush(eventlog, 1);
+        if (eventlog_async)
+            *flush = 1;
+        else {
+            Pthread_mutex_lock(&eventlog_write_lk);
+            gzflush(eventlog, 1);
+            Pthread_mutex_unlock(&eventlog_write_lk);
+        }
     } else {
         logmsg(LOGMSG_ERROR, "Unknown eventlog command\n");
         return;
@@ -720,9 +1154,15 @@ static void eventlog_process_message_locked(char *line, int lline, int *toff)
 
 void eventlog_process_message(char *line, int lline, int *toff)
 {
+    int flush = 0;
+
     Pthread_mutex_lock(&eventlog_lk);
-    eventlog_process_message_locked(line, lline, toff);
+    eventlog_process_message_locked(line, lline, toff, &flush);
     Pthread_mutex_unlock(&eventlog_lk);
+
+    /* the writer needs eventlog_lk to drain */
+    if (flush)
+        eventlog_flush_async();
 }
 
 void log_deadlock_cycle(locker_info *idmap, u_int32_t *deadmap,
@@ -766,9 +1206,6 @@ void log_deadlock_cycle(locker_info *idmap, u_int32_t *deadmap,
     }
     logmsg(LOGMSG_USER, "\n");
 
-    Pthread_mutex_lock(&eventlog_lk);
-    if (eventlog_enabled && eventlog != NULL)
-        cson_output(dval, write_json, eventlog, &opt);
-    Pthread_mutex_unlock(&eventlog_lk);
+    eventlog_write(dval, 0);
     cson_value_free(dval);
 }
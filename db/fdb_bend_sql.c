@@ -43,6 +43,8 @@
 extern int gbl_fdb_track;
 extern int blockproc2sql_error(int rc, const char *func, int line);
 
+int gbl_fdb_sql_batch_rows = 0;
+
 
 int fdb_appsock_work(const char *cid, struct sqlclntstate *clnt, int version,
                      enum run_sql_flags flags, char *sql, int sqllen,
@@ -93,7 +95,7 @@ int fdb_svc_cursor_open_sql(char *tid, char *cid, int code_release, int version,
  *
  */
 int fdb_svc_sql_row(SBUF2 *sb, char *cid, char *row, int rowlen, int ret,
-                    int isuuid)
+                    int isuuid, int flush)
 {
     /* NOTE: we assume everything required is embedded in the sqlite row
        including genid and datacopy fields - as generated by select
@@ -108,7 +110,7 @@ int fdb_svc_sql_row(SBUF2 *sb, char *cid, char *row, int rowlen, int ret,
     }
 
     rc = fdb_bend_send_row(sb, NULL, cid, genid, row, rowlen, NULL, 0, ret,
-                           isuuid);
+                           isuuid, flush);
 
     return rc;
 }
@@ -62,6 +62,7 @@ extern int gbl_expressions_indexes;
 
 int gbl_fdb_track = 0;
 int gbl_fdb_track_times = 0;
+int gbl_fdb_push_limit = 0;
 
 struct fdb_tbl;
 struct fdb;
@@ -190,6 +191,7 @@ struct fdb_cursor {
     fdb_msg_t *msg; /* msg memory */
 
     Expr *hint;     /* expression passed down by sqlite */
+    long long limit; /* most rows the statement reads, 0 if unknown */
     char *sql_hint; /* precreated sql query including hint */
     int is_schema;  /* special processing for accessing remote sqlite_master */
     int isuuid;     /* use extended 128bit UUID instead of 64bit fastseed*/
@@ -199,6 +201,10 @@ struct fdb_cursor {
     uuid_t tiduuid; /* UUID/fastseed storage for transaction, if any, or 0 */
     char *node;     /* connected to where? */
     int need_ssl;   /* uses ssl */
+
+    fdb_rescache_ent_t *rc_read; /* cached result being replayed, or NULL */
+    int rc_row;                  /* current row of rc_read */
+    fdb_rescache_ent_t *rc_fill; /* result being recorded, or NULL */
 };
 
 static fdb_cache_t fdbs;
@@ -230,6 +236,7 @@ static int fdb_cursor_find_last(BtCursor *pCur, Mem *key, int nfields,
                                 int bias);
 static int fdb_cursor_set_hint(BtCursor *pCur, void *hint);
 static void *fdb_cursor_get_hint(BtCursor *pCur);
+static int fdb_cursor_set_limit(BtCursor *pCur, long long limit);
 static int fdb_cursor_set_sql(BtCursor *pCur, const char *sql);
 static char *fdb_cursor_name(BtCursor *pCur);
 static char *fdb_cursor_tblname(BtCursor *pCur);
@@ -2388,6 +2395,7 @@ static fdb_cursor_if_t *_fdb_cursor_open_remote(struct sqlclntstate *clnt,
     fdbc_if->get_found_data = fdb_cursor_get_found_data;
     fdbc_if->set_hint = fdb_cursor_set_hint;
     fdbc_if->get_hint = fdb_cursor_get_hint;
+    fdbc_if->set_limit = fdb_cursor_set_limit;
     fdbc_if->set_sql = fdb_cursor_set_sql;
     fdbc_if->name = fdb_cursor_name;
     fdbc_if->tblname = fdb_cursor_tblname;
@@ -2557,6 +2565,97 @@ done:
     return pCur->fdbc;
 }
 
+/* Stop replaying or recording a cached result */
+static void fdb_cursor_rescache_reset(fdb_cursor_t *fdbc)
+{
+    if (fdbc->rc_read) {
+        fdb_rescache_put(fdbc->rc_read);
+        fdbc->rc_read = NULL;
+    }
+    if (fdbc->rc_fill) {
+        fdb_rescache_fill_abort(fdbc->rc_fill);
+        fdbc->rc_fill = NULL;
+    }
+}
+
+/* Can the rows of this cursor come from, or go to, the result cache? */
+static int fdb_cursor_use_rescache(BtCursor *pCur, fdb_cursor_t *fdbc)
+{
+    struct sqlclntstate *clnt = pCur->clnt;
+
+    if (gbl_fdb_result_cache_ttl_ms <= 0 || !fdbc->ent || fdbc->sql_hint ||
+        fdbc->trans || !clnt)
+        return 0;
+
+    /* rows up to a ttl old have no place in a snapshot */
+    if (clnt->dbtran.mode == TRANLEVEL_SNAPISOL ||
+        clnt->dbtran.mode == TRANLEVEL_SERIAL)
+        return 0;
+
+    return 1;
+}
+
+/**
+ * Serve sql from the result cache if it is there, otherwise start
+ * recording its result.  Returns 1 if the rows come from the cache.
+ *
+ */
+static int fdb_cursor_rescache_start(BtCursor *pCur, fdb_cursor_t *fdbc,
+                                     const char *sql)
+{
+    fdb_tbl_t *tbl;
+
+    fdb_cursor_rescache_reset(fdbc);
+    if (!fdb_cursor_use_rescache(pCur, fdbc))
+        return 0;
+
+    tbl = fdbc->ent->tbl;
+    fdbc->rc_read = fdb_rescache_get(tbl->fdb->dbname, tbl->version, sql);
+    if (fdbc->rc_read) {
+        fdbc->rc_row = 0;
+        return 1;
+    }
+
+    fdbc->rc_fill =
+        fdb_rescache_fill_start(tbl->fdb->dbname, tbl->name, tbl->version, sql);
+    return 0;
+}
+
+/* Return code for the current replayed row, as fdb_recv_row would */
+static int fdb_cursor_rescache_rc(fdb_cursor_t *fdbc)
+{
+    int nrows = fdb_rescache_nrows(fdbc->rc_read);
+
+    if (fdbc->rc_row >= nrows)
+        return IX_EMPTY;
+    return (fdbc->rc_row < nrows - 1) ? IX_FNDMORE : IX_FND;
+}
+
+/* Record the row just received; publish the result once it is complete */
+static void fdb_cursor_rescache_row(fdb_cursor_t *fdbc, int rc)
+{
+    if (!fdbc->rc_fill)
+        return;
+
+    if (rc == IX_FND || rc == IX_FNDMORE) {
+        if (fdb_rescache_fill_row(fdbc->rc_fill, fdb_msg_genid(fdbc->msg),
+                                  fdb_msg_data(fdbc->msg),
+                                  fdb_msg_datalen(fdbc->msg))) {
+            /* too big to cache */
+            fdb_cursor_rescache_reset(fdbc);
+            return;
+        }
+        if (rc == IX_FNDMORE)
+            return;
+    } else if (rc != IX_EMPTY && rc != IX_NOTFND && rc != IX_PASTEOF) {
+        fdb_cursor_rescache_reset(fdbc);
+        return;
+    }
+
+    fdb_rescache_fill_done(fdbc->rc_fill);
+    fdbc->rc_fill = NULL;
+}
+
 /**
  * Close the cursor locally
  *
@@ -2579,6 +2678,7 @@ static void fdb_cursor_close_on_open(BtCursor *pCur, int cache)
             fdbc->fcon.sock.sb = NULL;
         }
 
+        fdb_cursor_rescache_reset(fdbc);
         fdb_msg_clean_message(fdbc->msg);
         free(pCur->fdbc);
         pCur->fdbc = NULL;
@@ -2623,6 +2723,7 @@ static char *_build_run_sql_from_hint(BtCursor *pCur, Mem *m, int ncols,
     sqlite3 *sqlitedb = pCur->sqlite;
     char *columnsDesc = NULL;
     int using_col_filter = 0;
+    char limitDesc[32] = "";
 
     if (!fdbc->ent) {
         tableName = "sqlite_master";
@@ -2657,18 +2758,28 @@ static char *_build_run_sql_from_hint(BtCursor *pCur, Mem *m, int ncols,
         }
     }
 
+    /* sqlite told us it stops after this many rows; only pass it on if
+       the remote returns them in the order sqlite walks them, and the
+       whole filter made it into the query */
+    if (fdbc->limit > 0 && fdbc->ent && gbl_fdb_push_limit &&
+        (fdbc->hint == NULL || whereDesc != NULL) &&
+        ((fdbc->ent->ixnum >= 0 && bias != OP_Found && bias != OP_NotFound) ||
+         (fdbc->ent->ixnum < 0 && bias == OP_Next))) {
+        snprintf(limitDesc, sizeof(limitDesc), " LIMIT %lld", fdbc->limit);
+    }
+
     if (whereDesc || hasCondition) {
-        sql = sqlite3_mprintf("SELECT %s%srowid FROM \"%w\" WHERE %s%s%s",
+        sql = sqlite3_mprintf("SELECT %s%srowid FROM \"%w\" WHERE %s%s%s%s",
                  (columnsDesc) ? columnsDesc : ((using_col_filter) ? "" : "*"),
                  (columnsDesc) ? ", " : ((using_col_filter) ? "" : ", "),
                  tableName, whereDesc ? whereDesc : "",
                  (whereDesc != NULL && hasCondition) ? " AND " : "",
-                 orderDesc ? orderDesc : "");
+                 orderDesc ? orderDesc : "", limitDesc);
     } else {
-        sql = sqlite3_mprintf("SELECT %s%srowid FROM \"%w\"%s",
+        sql = sqlite3_mprintf("SELECT %s%srowid FROM \"%w\"%s%s",
                  (columnsDesc) ? columnsDesc : ((using_col_filter) ? "" : "*"),
                  (columnsDesc) ? ", " : ((using_col_filter) ? "" : ", "),
-                 tableName, orderDesc ? orderDesc : "");
+                 tableName, orderDesc ? orderDesc : "", limitDesc);
     }
 
     if (!sql) {
@@ -2705,6 +2816,13 @@ static char *fdb_cursor_get_data(BtCursor *pCur)
 {
     assert(pCur->fdbc != NULL);
 
+    if (pCur->fdbc->impl->rc_read) {
+        fdb_cursor_t *fdbc = pCur->fdbc->impl;
+        char *data;
+        fdb_rescache_row(fdbc->rc_read, fdbc->rc_row, NULL, NULL, &data);
+        return data;
+    }
+
     if (gbl_fdb_track) {
         int len = fdb_msg_datalen(pCur->fdbc->impl->msg);
         logmsg(LOGMSG_USER, "XXXX: get data %d [", len);
@@ -2718,6 +2836,13 @@ static int fdb_cursor_get_datalen(BtCursor *pCur)
 {
     assert(pCur->fdbc != NULL);
 
+    if (pCur->fdbc->impl->rc_read) {
+        fdb_cursor_t *fdbc = pCur->fdbc->impl;
+        int datalen;
+        fdb_rescache_row(fdbc->rc_read, fdbc->rc_row, NULL, &datalen, NULL);
+        return datalen;
+    }
+
     if (gbl_fdb_track) {
         logmsg(LOGMSG_USER, "XXXX: get datalen %d\n",
                 fdb_msg_datalen(pCur->fdbc->impl->msg));
@@ -2729,6 +2854,13 @@ static unsigned long long fdb_cursor_get_genid(BtCursor *pCur)
 {
     assert(pCur->fdbc != NULL);
 
+    if (pCur->fdbc->impl->rc_read) {
+        fdb_cursor_t *fdbc = pCur->fdbc->impl;
+        unsigned long long genid;
+        fdb_rescache_row(fdbc->rc_read, fdbc->rc_row, &genid, NULL, NULL);
+        return genid;
+    }
+
     if (gbl_fdb_track) {
         logmsg(LOGMSG_USER, "XXXX: get genid %llx\n",
                 fdb_msg_genid(pCur->fdbc->impl->msg));
@@ -2750,6 +2882,11 @@ static void fdb_cursor_get_found_data(BtCursor *pCur, unsigned long long *genid,
    assert(cur->msg.dr.rc == IX_FND || cur->msg.dr.rc == IX_FNDMORE || cur->msg.dr.rc == IX_NOTFND);
 #endif
 
+    if (cur->rc_read) {
+        fdb_rescache_row(cur->rc_read, cur->rc_row, genid, datalen, data);
+        return;
+    }
+
     *genid = fdb_msg_genid(cur->msg);
     *datalen = fdb_msg_datalen(cur->msg);
     *data = fdb_msg_data(cur->msg);
@@ -2900,6 +3037,14 @@ static void *fdb_cursor_get_hint(BtCursor *pCur)
     return pCur->fdbc->impl->hint;
 }
 
+static int fdb_cursor_set_limit(BtCursor *pCur, long long limit)
+{
+    assert(pCur->fdbc);
+    pCur->fdbc->impl->limit = (limit > 0) ? limit : 0;
+
+    return 0;
+}
+
 static int fdb_cursor_reopen(BtCursor *pCur)
 {
     struct sql_thread *thd;
@@ -2951,6 +3096,11 @@ static int fdb_cursor_move_sql(BtCursor *pCur, int how)
     unsigned long long end_rpc;
 
     if (fdbc) {
+        if (fdbc->rc_read && how != CFIRST && how != CLAST) {
+            fdbc->rc_row++;
+            return fdb_cursor_rescache_rc(fdbc);
+        }
+
         start_rpc = osql_log_time();
 
         /* this is a rewind, lets make sure the pipe is clean */
@@ -2992,6 +3142,12 @@ static int fdb_cursor_move_sql(BtCursor *pCur, int how)
                 return FDB_ERR_MALLOC;
             }
 
+            if (fdb_cursor_rescache_start(pCur, fdbc, sql)) {
+                if (fdbc->sql_hint != sql)
+                    sqlite3_free(sql);
+                return fdb_cursor_rescache_rc(fdbc);
+            }
+
             rc = fdb_send_run_sql(
                 fdbc->msg, fdbc->cid, sqllen, sql,
                 (fdbc->ent) ? fdb_table_version(fdbc->ent->tbl->version) : 0, 0,
@@ -3005,6 +3161,7 @@ static int fdb_cursor_move_sql(BtCursor *pCur, int how)
         if (!rc) {
             /* otherwise.read row */
             rc = fdb_recv_row(fdbc->msg, fdbc->cid, fdbc->fcon.sock.sb);
+            fdb_cursor_rescache_row(fdbc, rc);
 
             if (rc != IX_FND && rc != IX_FNDMORE && rc != IX_NOTFND &&
                 rc != IX_PASTEOF && rc != IX_EMPTY) {
@@ -3214,6 +3371,12 @@ static int fdb_cursor_find_sql_common(BtCursor *pCur, Mem *key, int nfields,
             return FDB_ERR_MALLOC;
         }
 
+        if (fdb_cursor_rescache_start(pCur, fdbc, sql)) {
+            if (fdbc->sql_hint != sql)
+                sqlite3_free(sql);
+            return fdb_cursor_rescache_rc(fdbc);
+        }
+
         start_rpc = osql_log_time();
 
         rc = fdb_send_run_sql(
@@ -3229,6 +3392,7 @@ static int fdb_cursor_find_sql_common(BtCursor *pCur, Mem *key, int nfields,
         if (!rc) {
             /* otherwise.read row */
             rc = fdb_recv_row(fdbc->msg, fdbc->cid, fdbc->fcon.sock.sb);
+            fdb_cursor_rescache_row(fdbc, rc);
 
             if (rc != IX_FND && rc != IX_FNDMORE && rc != IX_NOTFND &&
                 rc != IX_PASTEOF && rc != IX_EMPTY) {
@@ -4180,6 +4344,9 @@ static int __free_fdb_tbl(void *obj, void *arg)
         fdb_sqlstat_cache_destroy(&fdb->sqlstats);
     }
 
+    /* cached results are keyed by version, but don't keep stale ones */
+    fdb_rescache_clear(fdb->dbname, tbl->name);
+
     /* free each entry for table */
     LISTC_FOR_EACH_SAFE(&tbl->ents, ent, tmp, lnk)
     {
@@ -4411,10 +4578,14 @@ int fdb_process_message(const char *line, int lline)
                         "schema cache for table \"tblname\" in db \"dbname\"\n"
                         "    fdb clear sqlite_stats            = removes "
                         "cached sqlite stats data\n"
+                        "    fdb clear results                 = removes "
+                        "cached remote query results\n"
                         "    fdb info db                       = print cached "
                         "tables names and their versions for all dbs\n"
                         "    fdb info db dbname                = print cached "
-                        "tables names and their versions in db \"dbname\"\n");
+                        "tables names and their versions in db \"dbname\"\n"
+                        "    fdb info results                  = print cached "
+                        "remote query results\n");
     } else if (tokcmp(tok, ltok, "init") == 0) {
         fdb_init();
     } else if (tokcmp(tok, ltok, "clear") == 0) {
@@ -4468,6 +4639,8 @@ int fdb_process_message(const char *line, int lline)
             }
         } else if (tokcmp(tok, ltok, "sqlite_stats") == 0) {
             fdb_clear_sqlite_stats();
+        } else if (tokcmp(tok, ltok, "results") == 0) {
+            fdb_rescache_clear(NULL, NULL);
         } else {
             logmsg(LOGMSG_ERROR, "fdb clear missing type\n");
             return FDB_ERR_GENERIC;
@@ -4494,6 +4667,8 @@ int fdb_process_message(const char *line, int lline)
 
                 free(dbname);
             }
+        } else if (tokcmp(tok, ltok, "results") == 0) {
+            fdb_rescache_info();
         } else {
             logmsg(LOGMSG_ERROR, "fdb info error: unrecognized argument\n");
             return FDB_ERR_GENERIC;
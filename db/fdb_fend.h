@@ -199,6 +199,7 @@ typedef struct fdb_cursor_if {
 
     int (*set_hint)(BtCursor *pCur, void *hint);
     void *(*get_hint)(BtCursor *pCur);
+    int (*set_limit)(BtCursor *pCur, long long limit);
 
     int (*set_sql)(BtCursor *pCur, const char *sql);
     char *(*name)(BtCursor *pCur);
@@ -16,11 +16,17 @@
 
 #include <stdio.h>
 #include <pthread.h>
+#include <inttypes.h>
 
 #include <comdb2.h>
 #include <sql.h>
 #include <bdb_api.h>
 #include <util.h>
+#include <plhash.h>
+#include <list.h>
+#include <epochlib.h>
+#include <logmsg.h>
+#include <locks_wrap.h>
 
 #include "fdb_fend.h"
 #include "fdb_fend_cache.h"
@@ -626,3 +632,292 @@ static int fdb_sqlstat_cursor_update(BtCursor *pCur, struct sqlclntstate *clnt,
 {
     abort();
 }
+
+/**
+ * Cache of remote query results
+ *
+ * Rows returned by a remote cursor are recorded under the text of the query
+ * and the version of the remote table schema, and replayed to the next
+ * cursor running the same query until the entry is older than
+ * fdb_result_cache_ttl_ms.  Only the schema is versioned, so rows may be up
+ * to a ttl stale; this is meant for reference tables that rarely change.
+ * Entries are immutable once published and are freed when the last cursor
+ * reading them lets go.
+ *
+ */
+
+struct fdb_rescache_ent {
+    char *key;     /* dbname, table version and query */
+    char *dbname;
+    char *tblname;
+    int64_t expires; /* epoch ms */
+
+    int refs;      /* cursors reading it, plus one while it is cached */
+    int cached;    /* in the hash and the lru */
+    int nrows;
+    int *rowoff;   /* offset of each row in buf */
+    int nalloc;
+    char *buf;     /* rows, each a rescache_row followed by the data */
+    int buflen;
+    int bufalloc;
+
+    LINKC_T(struct fdb_rescache_ent) lnk;
+};
+
+struct rescache_row {
+    unsigned long long genid;
+    int datalen;
+};
+
+int gbl_fdb_result_cache_ttl_ms = 0;
+int gbl_fdb_result_cache_max_rows = 1000;
+int gbl_fdb_result_cache_max_bytes = 64 * 1024 * 1024;
+
+static pthread_mutex_t rescache_mtx = PTHREAD_MUTEX_INITIALIZER;
+static hash_t *rescache_hash;
+static LISTC_T(struct fdb_rescache_ent) rescache_lru; /* most recent on top */
+static int64_t rescache_bytes;
+static int64_t rescache_hits;
+static int64_t rescache_misses;
+static int64_t rescache_evicts;
+
+static int rescache_init(void)
+{
+    if (rescache_hash)
+        return 0;
+    rescache_hash = hash_init_strptr(offsetof(struct fdb_rescache_ent, key));
+    if (!rescache_hash)
+        return -1;
+    listc_init(&rescache_lru, offsetof(struct fdb_rescache_ent, lnk));
+    return 0;
+}
+
+static void rescache_free(fdb_rescache_ent_t *ent)
+{
+    free(ent->key);
+    free(ent->dbname);
+    free(ent->tblname);
+    free(ent->rowoff);
+    free(ent->buf);
+    free(ent);
+}
+
+static void rescache_unref(fdb_rescache_ent_t *ent)
+{
+    if (--ent->refs == 0)
+        rescache_free(ent);
+}
+
+/* take ent out of the cache; called with rescache_mtx held */
+static void rescache_unlink(fdb_rescache_ent_t *ent)
+{
+    if (!ent->cached)
+        return;
+    hash_del(rescache_hash, ent);
+    listc_rfl(&rescache_lru, ent);
+    rescache_bytes -= ent->bufalloc;
+    ent->cached = 0;
+    rescache_unref(ent);
+}
+
+static char *rescache_key(const char *dbname, unsigned long long version,
+                          const char *sql)
+{
+    return sqlite3_mprintf("%s:%llu:%s", dbname, version, sql);
+}
+
+fdb_rescache_ent_t *fdb_rescache_get(const char *dbname,
+                                     unsigned long long version,
+                                     const char *sql)
+{
+    fdb_rescache_ent_t *ent = NULL;
+    char *key;
+
+    if ((key = rescache_key(dbname, version, sql)) == NULL)
+        return NULL;
+
+    Pthread_mutex_lock(&rescache_mtx);
+    if (rescache_hash && (ent = hash_find(rescache_hash, &key)) != NULL) {
+        if (comdb2_time_epochms() >= ent->expires) {
+            rescache_unlink(ent);
+            ent = NULL;
+        } else {
+            listc_rfl(&rescache_lru, ent);
+            listc_atl(&rescache_lru, ent);
+            ent->refs++;
+        }
+    }
+    if (ent)
+        rescache_hits++;
+    else
+        rescache_misses++;
+    Pthread_mutex_unlock(&rescache_mtx);
+
+    sqlite3_free(key);
+    return ent;
+}
+
+void fdb_rescache_put(fdb_rescache_ent_t *ent)
+{
+    Pthread_mutex_lock(&rescache_mtx);
+    rescache_unref(ent);
+    Pthread_mutex_unlock(&rescache_mtx);
+}
+
+int fdb_rescache_nrows(fdb_rescache_ent_t *ent) { return ent->nrows; }
+
+void fdb_rescache_row(fdb_rescache_ent_t *ent, int row,
+                      unsigned long long *genid, int *datalen, char **data)
+{
+    struct rescache_row *r = (struct rescache_row *)(ent->buf +
+                                                     ent->rowoff[row]);
+    if (genid)
+        *genid = r->genid;
+    if (datalen)
+        *datalen = r->datalen;
+    if (data)
+        *data = (char *)(r + 1);
+}
+
+fdb_rescache_ent_t *fdb_rescache_fill_start(const char *dbname,
+                                            const char *tblname,
+                                            unsigned long long version,
+                                            const char *sql)
+{
+    fdb_rescache_ent_t *ent;
+    char *key;
+
+    if ((ent = calloc(1, sizeof(*ent))) == NULL)
+        return NULL;
+    key = rescache_key(dbname, version, sql);
+    if (key)
+        ent->key = strdup(key);
+    sqlite3_free(key);
+    ent->dbname = strdup(dbname);
+    ent->tblname = strdup(tblname);
+    if (!ent->key || !ent->dbname || !ent->tblname) {
+        rescache_free(ent);
+        return NULL;
+    }
+    ent->refs = 1;
+    return ent;
+}
+
+int fdb_rescache_fill_row(fdb_rescache_ent_t *ent, unsigned long long genid,
+                          char *data, int datalen)
+{
+    struct rescache_row *r;
+    int need;
+
+    if (ent->nrows >= gbl_fdb_result_cache_max_rows)
+        return -1;
+
+    /* keep the rows aligned for the header */
+    need = (sizeof(*r) + datalen + 7) & ~7;
+    if (ent->buflen + need > gbl_fdb_result_cache_max_bytes)
+        return -1;
+    if (ent->buflen + need > ent->bufalloc) {
+        int len = ent->bufalloc ? 2 * ent->bufalloc : 4096;
+        char *buf;
+        while (len < ent->buflen + need)
+            len *= 2;
+        if ((buf = realloc(ent->buf, len)) == NULL)
+            return -1;
+        ent->buf = buf;
+        ent->bufalloc = len;
+    }
+    if (ent->nrows == ent->nalloc) {
+        int n = ent->nalloc ? 2 * ent->nalloc : 16;
+        int *off;
+        if ((off = realloc(ent->rowoff, n * sizeof(int))) == NULL)
+            return -1;
+        ent->rowoff = off;
+        ent->nalloc = n;
+    }
+
+    r = (struct rescache_row *)(ent->buf + ent->buflen);
+    r->genid = genid;
+    r->datalen = datalen;
+    if (datalen > 0)
+        memcpy(r + 1, data, datalen);
+    ent->rowoff[ent->nrows++] = ent->buflen;
+    ent->buflen += need;
+    return 0;
+}
+
+void fdb_rescache_fill_done(fdb_rescache_ent_t *ent)
+{
+    fdb_rescache_ent_t *old;
+
+    Pthread_mutex_lock(&rescache_mtx);
+    if (rescache_init() || gbl_fdb_result_cache_ttl_ms <= 0) {
+        rescache_unref(ent);
+        Pthread_mutex_unlock(&rescache_mtx);
+        return;
+    }
+
+    /* someone else ran the same query meanwhile */
+    if ((old = hash_find(rescache_hash, &ent->key)) != NULL)
+        rescache_unlink(old);
+
+    ent->expires = comdb2_time_epochms() + gbl_fdb_result_cache_ttl_ms;
+    ent->cached = 1;
+    hash_add(rescache_hash, ent);
+    listc_atl(&rescache_lru, ent);
+    rescache_bytes += ent->bufalloc;
+
+    while (rescache_bytes > gbl_fdb_result_cache_max_bytes &&
+           (old = LISTC_BOT(&rescache_lru)) != NULL) {
+        rescache_unlink(old);
+        rescache_evicts++;
+    }
+    /* the cache holds its own reference now */
+    Pthread_mutex_unlock(&rescache_mtx);
+}
+
+void fdb_rescache_fill_abort(fdb_rescache_ent_t *ent)
+{
+    /* never published, nobody else can see it */
+    rescache_free(ent);
+}
+
+void fdb_rescache_clear(const char *dbname, const char *tblname)
+{
+    fdb_rescache_ent_t *ent, *tmp;
+
+    Pthread_mutex_lock(&rescache_mtx);
+    if (rescache_hash) {
+        LISTC_FOR_EACH_SAFE(&rescache_lru, ent, tmp, lnk)
+        {
+            if (dbname && strcasecmp(ent->dbname, dbname))
+                continue;
+            if (tblname && strcasecmp(ent->tblname, tblname))
+                continue;
+            rescache_unlink(ent);
+        }
+    }
+    Pthread_mutex_unlock(&rescache_mtx);
+}
+
+void fdb_rescache_info(void)
+{
+    fdb_rescache_ent_t *ent;
+    int64_t now = comdb2_time_epochms();
+
+    Pthread_mutex_lock(&rescache_mtx);
+    logmsg(LOGMSG_USER,
+           "Result cache: %d entries, %" PRId64 " bytes, %" PRId64
+           " hits, %" PRId64 " misses, %" PRId64 " evicted\n",
+           rescache_hash ? listc_size(&rescache_lru) : 0, rescache_bytes,
+           rescache_hits, rescache_misses, rescache_evicts);
+    if (rescache_hash) {
+        LISTC_FOR_EACH(&rescache_lru, ent, lnk)
+        {
+            logmsg(LOGMSG_USER, "  %s.%s rows %d bytes %d expires in %" PRId64
+                                "ms refs %d \"%s\"\n",
+                   ent->dbname, ent->tblname, ent->nrows, ent->bufalloc,
+                   ent->expires - now, ent->refs - 1, ent->key);
+        }
+    }
+    Pthread_mutex_unlock(&rescache_mtx);
+}
@@ -42,4 +42,45 @@ int fdb_sqlstat_cache_create(struct sqlclntstate *clnt, fdb_t *fdb,
  */
 void fdb_sqlstat_cache_destroy(fdb_sqlstat_cache_t **pcache);
 
+/**
+ * Cache of remote query results, keyed by the query and the remote table
+ * version; see gbl_fdb_result_cache_ttl_ms
+ *
+ */
+typedef struct fdb_rescache_ent fdb_rescache_ent_t;
+
+extern int gbl_fdb_result_cache_ttl_ms;
+
+/* return a reference to the cached result of sql, or NULL */
+fdb_rescache_ent_t *fdb_rescache_get(const char *dbname,
+                                     unsigned long long version,
+                                     const char *sql);
+
+/* release a reference returned by fdb_rescache_get */
+void fdb_rescache_put(fdb_rescache_ent_t *ent);
+
+int fdb_rescache_nrows(fdb_rescache_ent_t *ent);
+
+/* rows stay valid until the reference is released */
+void fdb_rescache_row(fdb_rescache_ent_t *ent, int row,
+                      unsigned long long *genid, int *datalen, char **data);
+
+/* record the result of sql; the rows are appended with fdb_rescache_fill_row
+   and the entry is either published with fdb_rescache_fill_done or dropped
+   with fdb_rescache_fill_abort */
+fdb_rescache_ent_t *fdb_rescache_fill_start(const char *dbname,
+                                            const char *tblname,
+                                            unsigned long long version,
+                                            const char *sql);
+
+/* return -1 if the result is too big to cache */
+int fdb_rescache_fill_row(fdb_rescache_ent_t *ent, unsigned long long genid,
+                          char *data, int datalen);
+void fdb_rescache_fill_done(fdb_rescache_ent_t *ent);
+void fdb_rescache_fill_abort(fdb_rescache_ent_t *ent);
+
+/* drop the cached results of a table, or all of them for NULL */
+void fdb_rescache_clear(const char *dbname, const char *tblname);
+void fdb_rescache_info(void);
+
 #endif
@@ -91,6 +91,7 @@
 #include "views.h"
 #include "logmsg.h"
 #include "time_accounting.h"
+#include "wait_event.h"
 
 int (*comdb2_ipc_master_set)(char *host) = 0;
 
@@ -618,6 +619,7 @@ static int trans_wait_for_seqnum_int(void *bdb_handle, struct dbenv *dbenv,
 
     /*wait for synchronization, if necessary */
     start_ms = comdb2_time_epochms();
+    uint64_t wait = wait_event_begin(WAIT_EVENT_REPLICATION);
     switch (sync) {
     default:
 
@@ -692,6 +694,7 @@ static int trans_wait_for_seqnum_int(void *bdb_handle, struct dbenv *dbenv,
             poll(0, 0, next_commit - now);
     }
 
+    wait_event_end(wait);
     end_ms = comdb2_time_epochms();
     iq->reptimems = end_ms - start_ms;
 
@@ -744,8 +747,11 @@ static int trans_commit_int(struct ireq *iq, void *trans, char *source_host,
 
     memset(&ss, -1, sizeof(ss));
 
+    uint64_t startus = comdb2_time_epochus();
     rc = trans_commit_seqnum_int(bdb_handle, dbenv, iq, trans, &ss, logical,
                                  blkseq, blklen, blkkey, blkkeylen);
+    uint64_t commitus = comdb2_time_epochus();
+    reqlog_phase_record(REQL_PHASE_COMMIT, commitus - startus);
 
     if (gbl_extended_sql_debug_trace && iq->have_snap_info) {
         cn_len = iq->snap_info.keylen;
@@ -762,6 +768,7 @@ static int trans_commit_int(struct ireq *iq, void *trans, char *source_host,
 
     rc = trans_wait_for_seqnum_int(bdb_handle, dbenv, iq, source_host,
                                    timeoutms, adaptive, &ss);
+    reqlog_phase_record(REQL_PHASE_REPWAIT, comdb2_time_epochus() - commitus);
 
     if (cnonce) {
         DB_LSN *lsn = (DB_LSN *)&ss;
@@ -950,13 +957,23 @@ int ix_addk_auxdb(int auxdb, struct ireq *iq, void *trans, void *key, int ixnum,
     if (!bdb_handle)
         return ERR_NO_AUXDB;
 
+    struct schema *pd = iq->usedb->ixschema[ixnum]->partial_datacopy;
+    if (dta && pd) {
+        void *partial = alloca(pd->recsize);
+        dtalen = partial_datacopy_from_ondisk(iq->usedb, ixnum, dta, partial);
+        dta = partial;
+    }
+
     iq->gluewhere = "bdb_prim_addkey";
     rc = bdb_prim_addkey_genid(bdb_handle, trans, key, ixnum, rrn, genid, dta,
                                dtalen, isnull,
                                &bdberr);
     iq->gluewhere = "bdb_prim_addkey done";
-    if (rc == 0)
+    if (rc == 0) {
+        if (!auxdb)
+            ixsketch_add(iq->usedb, ixnum, key);
         return 0;
+    }
 
     /*translate engine rcodes */
     switch (bdberr) {
@@ -1004,6 +1021,13 @@ int ix_upd_key(struct ireq *iq, void *trans, void *key, int keylen, int ixnum,
     if (!bdb_handle)
         return ERR_NO_AUXDB;
 
+    struct schema *pd = iq->usedb->ixschema[ixnum]->partial_datacopy;
+    if (dta && pd) {
+        void *partial = alloca(pd->recsize);
+        dtalen = partial_datacopy_from_ondisk(iq->usedb, ixnum, dta, partial);
+        dta = partial;
+    }
+
     iq->gluewhere = "bdb_prim_updkey";
     rc = bdb_prim_updkey_genid(bdb_handle, trans, key, keylen, ixnum, genid,
                                oldgenid, dta, dtalen, isnull, &bdberr);
@@ -1044,8 +1068,11 @@ int ix_delk_auxdb(int auxdb, struct ireq *iq, void *trans, void *key, int ixnum,
     rc = bdb_prim_delkey_genid(bdb_handle, trans, key, ixnum, rrn, genid,
                                isnull, &bdberr);
     iq->gluewhere = "bdb_prim_delkey done";
-    if (rc == 0)
+    if (rc == 0) {
+        if (!auxdb)
+            ixsketch_del(iq->usedb, ixnum);
         return 0;
+    }
     /*translate engine rcodes */
     switch (bdberr) {
     case BDBERR_DEADLOCK:
@@ -1246,6 +1273,14 @@ int dat_add(struct ireq *iq, void *trans, void *data, int datalen,
     return rc;
 }
 
+unsigned long long dat_new_genid(struct ireq *iq)
+{
+    int modnum = 0;
+    if (iq->blkstate)
+        modnum = iq->blkstate->modnum;
+    return bdb_prim_newgenid(get_bdb_handle(iq->usedb, AUXDB_NONE), modnum);
+}
+
 int dat_set(struct ireq *iq, void *trans, void *data, size_t length, int rrn,
             unsigned long long genid)
 {
@@ -3070,6 +3105,9 @@ int serial_check_callback(char *tbname, int idxnum, void *key, int keylen,
     if ((ih = hash_find(th->idx_hash, &(idxnum))) == NULL) {
         return 0;
     }
+    if (currange_filter_excludes(ih, key, keylen)) {
+        return 0;
+    }
     for (i = ih->begin; i <= ih->end; i++) {
         CurRange *r = arr->ranges[i];
         if ((r->lflag ||
@@ -3945,29 +3983,105 @@ void get_disable_skipscan_all()
  
 
 
+int gbl_table_open_threads = 0;
+
+static bdb_state_type *open_table_tran(struct dbenv *dbenv, struct dbtable *db,
+                                       tran_type *tran, uint32_t flags,
+                                       int *bdberr)
+{
+    if (db->dbnum)
+        logmsg(LOGMSG_INFO, "open table '%s' (dbnum %d)\n", db->tablename,
+               db->dbnum);
+    else
+        logmsg(LOGMSG_INFO, "open table '%s'\n", db->tablename);
+
+    return bdb_open_more_tran(
+        db->tablename, dbenv->basedir, db->lrl, db->nix,
+        (short *)db->ix_keylen, db->ix_dupes, db->ix_recnums, db->ix_datacopy,
+        db->ix_collattr, db->ix_nullsallowed,
+        db->numblobs + 1, /* main record + n blobs */
+        dbenv->bdb_env, tran, flags, bdberr);
+}
+
+struct open_tables_arg {
+    struct dbenv *dbenv;
+    uint32_t flags;
+    pthread_mutex_t lk;
+    int next;
+};
+
+static void *open_tables_thd(void *arg)
+{
+    struct open_tables_arg *a = arg;
+    int bdberr, ii;
+
+    backend_thread_event(a->dbenv, COMDB2_THR_EVENT_START_RDWR);
+    while (1) {
+        Pthread_mutex_lock(&a->lk);
+        ii = a->next++;
+        Pthread_mutex_unlock(&a->lk);
+        if (ii >= a->dbenv->num_dbs)
+            break;
+        struct dbtable *db = a->dbenv->dbs[ii];
+        db->handle = open_table_tran(a->dbenv, db, NULL, a->flags, &bdberr);
+    }
+    backend_thread_event(a->dbenv, COMDB2_THR_EVENT_DONE_RDWR);
+    return NULL;
+}
+
+/* Open the tables on table_open_threads threads.  Tables that fail to open
+ * are left without a handle, for the caller to retry and report */
+static void open_tables_parallel(struct dbenv *dbenv, uint32_t flags)
+{
+    struct open_tables_arg a = {.dbenv = dbenv, .flags = flags};
+    int nthds = gbl_table_open_threads;
+    pthread_t *thds;
+    pthread_attr_t attr;
+    int started = 0;
+
+    if (nthds > dbenv->num_dbs)
+        nthds = dbenv->num_dbs;
+    if ((thds = malloc(nthds * sizeof(pthread_t))) == NULL)
+        return;
+    Pthread_mutex_init(&a.lk, NULL);
+    Pthread_attr_init(&attr);
+    Pthread_attr_setstacksize(&attr, 4096 * 1024);
+    for (int i = 0; i < nthds; i++) {
+        if (pthread_create(&thds[started], &attr, open_tables_thd, &a) == 0)
+            started++;
+    }
+    if (started == 0)
+        logmsg(LOGMSG_WARN, "%s: can't create threads, opening serially\n",
+               __func__);
+    for (int i = 0; i < started; i++)
+        Pthread_join(thds[i], NULL);
+    Pthread_attr_destroy(&attr);
+    Pthread_mutex_destroy(&a.lk);
+    free(thds);
+}
+
 /* open the db files, etc */
 int backend_open_tran(struct dbenv *dbenv, tran_type *tran, uint32_t flags)
 {
     int bdberr, ii;
     struct dbtable *db = NULL;
     int rc;
+    /* a transaction can't be shared between threads */
+    int parallel = (tran == NULL && gbl_table_open_threads > 1 &&
+                    dbenv->num_dbs > 1);
+
+    if (parallel) {
+        for (ii = 0; ii < dbenv->num_dbs; ii++)
+            dbenv->dbs[ii]->handle = NULL;
+        open_tables_parallel(dbenv, flags);
+    }
 
     /* open tables */
     for (ii = 0; ii < dbenv->num_dbs; ii++) {
         db = dbenv->dbs[ii];
 
-        if (db->dbnum)
-            logmsg(LOGMSG_INFO, "open table '%s' (dbnum %d)\n", db->tablename,
-                   db->dbnum);
-        else
-            logmsg(LOGMSG_INFO, "open table '%s'\n", db->tablename);
-
-        db->handle = bdb_open_more_tran(
-            db->tablename, dbenv->basedir, db->lrl, db->nix,
-            (short *)db->ix_keylen, db->ix_dupes, db->ix_recnums,
-            db->ix_datacopy, db->ix_collattr, db->ix_nullsallowed,
-            db->numblobs + 1, /* main record + n blobs */
-            dbenv->bdb_env, tran, flags, &bdberr);
+        if (!parallel || db->handle == NULL)
+            db->handle = open_table_tran(dbenv, db, tran, flags, &bdberr);
 
         if (db->handle == NULL) {
             if (bdb_attr_get(thedb->bdb_attr, BDB_ATTR_IGNORE_BAD_TABLE)) {
@@ -47,10 +47,7 @@
 #include "intern_strings.h"
 #include "logmsg.h"
 #include <poll.h>
-
-#ifdef MONITOR_STACK
 #include "comdb2_pthread_create.h"
-#endif
 
 void (*comdb2_ipc_sndbak)(int *, int) = 0;
 
@@ -427,6 +424,7 @@ static void *thd_req(void *vthd)
 
     thread_started("request");
     THREAD_TYPE("tag");
+    comdb2_thread_set_affinity(COMDB2_THR_CLASS_COMMIT, NULL);
 
     thr_self = thrman_register(THRTYPE_REQ);
     logger = thrman_get_reqlogger(thr_self);
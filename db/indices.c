@@ -27,6 +27,31 @@
 
 extern int gbl_partial_indexes;
 
+int gbl_skip_unchanged_keys = 1;
+int gbl_upsert_single_probe = 1;
+
+/* Whether an update leaves the key of index ixnum as it was, so that the
+ * new key is the old one and needn't be formed.  updCols is what the
+ * update set: updCols[0] ondisk columns, -1 for each one it didn't touch.
+ * Expression keys may read any column, and datacopy and decimal keys carry
+ * more than the key columns, so those are always formed. */
+static int key_unchanged(const struct dbtable *db, int ixnum,
+                         const int *updCols)
+{
+    struct schema *ix = db->ixschema[ixnum];
+
+    if (!gbl_skip_unchanged_keys || updCols == NULL ||
+        db->ix_datacopy[ixnum] || db->ix_collattr[ixnum])
+        return 0;
+    for (int i = 0; i < ix->nmembers; i++) {
+        int col = ix->member[i].idx;
+        if (ix->member[i].isExpr || col < 0 || col >= updCols[0] ||
+            updCols[col + 1] != -1)
+            return 0;
+    }
+    return 1;
+}
+
 /* Check whether the key for the specified record is already present in
  * the index.
  *
@@ -87,6 +112,11 @@ static int check_index(struct ireq *iq, void *trans, int ixnum,
         return 0;
     }
 
+    /* definitely a new key, skip the descent */
+    if (bdb_ixbloom_absent(iq->usedb->handle, ixnum, key, ixkeylen)) {
+        return 0;
+    }
+
     rc = ix_find_by_key_tran(iq, key, ixkeylen, ixnum, NULL, &fndrrn, &fndgenid,
                              NULL, NULL, 0, trans);
     if (rc == IX_FND) {
@@ -108,35 +138,64 @@ static int check_index(struct ireq *iq, void *trans, int ixnum,
     return 0;
 }
 
+/* Whether the record's key in unique index ixnum has to be checked */
+static int upsert_checks_index(struct ireq *iq, int ixnum,
+                               unsigned long long ins_keys)
+{
+    /* Ignore dup keys */
+    if (iq->usedb->ix_dupes[ixnum] != 0)
+        return 0;
+
+    /* Check for partial keys only when needed. */
+    if (gbl_partial_indexes && iq->usedb->ix_partial &&
+        !(ins_keys & (1ULL << ixnum)))
+        return 0;
+
+    return 1;
+}
+
 /* If a specific index has been used in the ON CONFLICT clause (aka
  * upsert target/index), then we must move the check for that particular
  * index to the very end so that errors from other (non-ignorable)
  * unique indexes have already been verified before we check and ignore
  * the error (if any) from the upsert index.
+ *
+ * If probe_ixnum is given, the last check isn't made but left to adding
+ * that index's key ahead of the record, which fails with IX_DUP where the
+ * check would have, so the conflicting key is searched for once instead
+ * of once to check and once more to add.  *probe_ixnum is the index left
+ * unchecked, or -1.
  */
 int check_for_upsert(struct ireq *iq, void *trans, struct schema *ondisktagsc,
                      blob_buffer_t *blobs, size_t maxblobs, int *opfailcode,
                      int *ixfailnum, int *retrc, const char *ondisktag,
                      void *od_dta, size_t od_len, unsigned long long ins_keys,
-                     int rec_flags)
+                     int rec_flags, int *probe_ixnum)
 {
     int rc = 0;
     int upsert_idx = rec_flags >> 8;
+    int last_idx = -1;
 
-    for (int ixnum = 0; ixnum < iq->usedb->nix; ixnum++) {
-        /* Skip check for upsert index, we'll do it after this loop. */
-        if (ixnum == upsert_idx) {
-            continue;
+    if (upsert_idx != MAXINDEX + 1) {
+        /* It must be a unique key. */
+        assert(iq->usedb->ix_dupes[upsert_idx] == 0);
+        if (upsert_checks_index(iq, upsert_idx, ins_keys))
+            last_idx = upsert_idx;
+    } else {
+        /* Any conflict is ignored, so any index can go last */
+        for (int ixnum = 0; ixnum < iq->usedb->nix; ixnum++) {
+            if (upsert_checks_index(iq, ixnum, ins_keys))
+                last_idx = ixnum;
         }
+    }
 
-        /* Ignore dup keys */
-        if (iq->usedb->ix_dupes[ixnum] != 0) {
+    for (int ixnum = 0; ixnum < iq->usedb->nix; ixnum++) {
+        /* Skip check for upsert index, we'll do it after this loop. */
+        if (ixnum == upsert_idx || ixnum == last_idx) {
             continue;
         }
 
-        /* Check for partial keys only when needed. */
-        if (gbl_partial_indexes && iq->usedb->ix_partial &&
-            !(ins_keys & (1ULL << ixnum))) {
+        if (!upsert_checks_index(iq, ixnum, ins_keys)) {
             continue;
         }
 
@@ -148,42 +207,160 @@ int check_for_upsert(struct ireq *iq, void *trans, struct schema *ondisktagsc,
         }
     }
 
+    /* a write disabled index isn't looked at by adding the key */
+    if (probe_ixnum) {
+        *probe_ixnum = -1;
+        if (last_idx != -1 &&
+            !(iq->usedb->ix_disabled[last_idx] & INDEX_WRITE_DISABLED)) {
+            *probe_ixnum = last_idx;
+            return 0;
+        }
+    }
+
     /* Perform the check for upsert index that we skipped above. */
-    if (upsert_idx != MAXINDEX + 1) {
+    if (last_idx != -1) {
+        rc = check_index(iq, trans, last_idx, ondisktagsc, blobs, maxblobs,
+                         opfailcode, ixfailnum, retrc, ondisktag, od_dta,
+                         od_len, ins_keys);
+        if (rc) {
+            return rc;
+        }
+    }
+    return 0;
+}
 
-        /* It must be a unique key. */
-        assert(iq->usedb->ix_dupes[upsert_idx] == 0);
+/* Form and add the key of ixnum for a new record.  vgenid, when set, is the
+ * genid a resumed add has to find missing from the index; it is cleared once
+ * that is known. */
+static int add_record_index(struct ireq *iq, void *trans, int ixnum,
+                            blob_buffer_t *blobs, size_t maxblobs,
+                            int *opfailcode, int *ixfailnum, int rrn,
+                            unsigned long long genid,
+                            unsigned long long *vgenid, void *od_dta,
+                            size_t od_len, const char *ondisktag,
+                            struct schema *ondisktagsc)
+{
+    char *od_dta_tail = NULL;
+    int od_tail_len;
+    char key[MAXKEYLEN];
+    char mangled_key[MAXKEYLEN];
 
-        /* Check for partial keys only when needed. */
-        if (gbl_partial_indexes && iq->usedb->ix_partial &&
-            !(ins_keys & (1ULL << upsert_idx))) {
-            /* NOOP */
-        } else {
-            rc = check_index(iq, trans, upsert_idx, ondisktagsc, blobs,
-                             maxblobs, opfailcode, ixfailnum, retrc, ondisktag,
-                             od_dta, od_len, ins_keys);
-            if (rc) {
-                return rc;
-            }
+    int ixkeylen = getkeysize(iq->usedb, ixnum);
+    if (ixkeylen < 0) {
+        if (iq->debug)
+            reqprintf(iq, "BAD INDEX %d OR KEYLENGTH %d", ixnum, ixkeylen);
+        reqerrstrhdr(iq, "Table '%s' ", iq->usedb->tablename);
+        reqerrstr(iq, COMDB2_ADD_RC_INVL_KEY, "bad index %d or keylength %d",
+                  ixnum, ixkeylen);
+        *ixfailnum = ixnum;
+        *opfailcode = OP_FAILED_BAD_REQUEST;
+        return ERR_BADREQ;
+    }
+
+    int rc;
+    if (iq->idxInsert)
+        rc = create_key_from_ireq(iq, ixnum, 0, &od_dta_tail, &od_tail_len,
+                                  mangled_key, od_dta, od_len, key);
+    else {
+        char ixtag[MAXTAGLEN];
+        snprintf(ixtag, sizeof(ixtag), "%s_IX_%d", ondisktag, ixnum);
+        rc = create_key_from_ondisk_sch_blobs(
+            iq->usedb, ondisktagsc, ixnum, &od_dta_tail, &od_tail_len,
+            mangled_key, ondisktag, od_dta, od_len, ixtag, key, NULL, blobs,
+            maxblobs, iq->tzname);
+    }
+    if (rc == -1) {
+        if (iq->debug)
+            reqprintf(iq, "CAN'T FORM INDEX %d", ixnum);
+        reqerrstrhdr(iq, "Table '%s' ", iq->usedb->tablename);
+        reqerrstr(iq, COMDB2_ADD_RC_INVL_IDX, "cannot form index %d", ixnum);
+        *ixfailnum = ixnum;
+        *opfailcode = OP_FAILED_INTERNAL + ERR_FORM_KEY;
+        return rc;
+    }
+
+    /* light the prefault kill bit for this subop - newkeys */
+    prefault_kill_bits(iq, ixnum, PFRQ_NEWKEY);
+    if (iq->osql_step_ix)
+        gbl_osqlpf_step[*(iq->osql_step_ix)].step += 2;
+
+    int isnullk = ix_isnullk(iq->usedb, key, ixnum);
+
+    if (*vgenid && iq->usedb->ix_dupes[ixnum] == 0 && !isnullk) {
+        int fndrrn = 0;
+        unsigned long long fndgenid = 0ULL;
+        rc = ix_find_by_key_tran(iq, key, ixkeylen, ixnum, NULL, &fndrrn,
+                                 &fndgenid, NULL, NULL, 0, trans);
+        if (rc == IX_FND && fndgenid == *vgenid) {
+            return ERR_VERIFY;
+        } else if (rc == RC_INTERNAL_RETRY) {
+            return RC_INTERNAL_RETRY;
+        } else if (rc != IX_FNDMORE && rc != IX_NOTFND && rc != IX_PASTEOF &&
+                   rc != IX_EMPTY) {
+            logmsg(LOGMSG_ERROR, "%s:%d got unexpected error rc = %d\n",
+                   __func__, __LINE__, rc);
+            return ERR_INTERNAL;
+        }
+
+        /* The row is not in new btree, proceed with the add */
+        *vgenid = 0; // no need to verify again
+    }
+
+    /* add the key */
+    rc = ix_addk(iq, trans, key, ixnum, genid, rrn, od_dta_tail, od_tail_len,
+                 isnullk);
+
+    if (*vgenid && rc == IX_DUP) {
+        if (iq->usedb->ix_dupes[ixnum] || isnullk) {
+            return ERR_VERIFY;
         }
     }
+
+    if (iq->debug) {
+        reqprintf(iq, "ix_addk IX %d LEN %u KEY ", ixnum, ixkeylen);
+        reqdumphex(iq, key, ixkeylen);
+        reqmoref(iq, " RC %d", rc);
+    }
+
+    if (rc == RC_INTERNAL_RETRY) {
+        return rc;
+    } else if (rc != 0) {
+        *ixfailnum = ixnum;
+        /* If following changes, update OSQL_INSREC in osqlcomm.c */
+        *opfailcode = OP_FAILED_UNIQ; /* really? */
+
+        return rc;
+    }
     return 0;
 }
 
+int add_upsert_probe_key(struct ireq *iq, void *trans, int ixnum,
+                         blob_buffer_t *blobs, size_t maxblobs,
+                         int *opfailcode, int *ixfailnum, int rrn,
+                         unsigned long long genid, void *od_dta, size_t od_len,
+                         const char *ondisktag, struct schema *ondisktagsc)
+{
+    unsigned long long vgenid = 0;
+
+    return add_record_index(iq, trans, ixnum, blobs, maxblobs, opfailcode,
+                            ixfailnum, rrn, genid, &vgenid, od_dta, od_len,
+                            ondisktag, ondisktagsc);
+}
+
 int add_record_indices(struct ireq *iq, void *trans, blob_buffer_t *blobs,
                        size_t maxblobs, int *opfailcode, int *ixfailnum,
                        int *rrn, unsigned long long *genid,
                        unsigned long long vgenid, unsigned long long ins_keys,
                        int opcode, int blkpos, void *od_dta, size_t od_len,
-                       const char *ondisktag, struct schema *ondisktagsc)
+                       const char *ondisktag, struct schema *ondisktagsc,
+                       int added_ixnum)
 {
-    char *od_dta_tail = NULL;
-    int od_tail_len;
     if (iq->osql_step_ix)
         gbl_osqlpf_step[*(iq->osql_step_ix)].step += 1;
     for (int ixnum = 0; ixnum < iq->usedb->nix; ixnum++) {
-        char key[MAXKEYLEN];
-        char mangled_key[MAXKEYLEN];
+        /* already added as the upsert's probe */
+        if (ixnum == added_ixnum)
+            continue;
 
         if (gbl_use_plan && iq->usedb->plan &&
             iq->usedb->plan->ix_plan[ixnum] != -1)
@@ -194,93 +371,11 @@ int add_record_indices(struct ireq *iq, void *trans, blob_buffer_t *blobs,
             !(ins_keys & (1ULL << ixnum)))
             continue;
 
-        int ixkeylen = getkeysize(iq->usedb, ixnum);
-        if (ixkeylen < 0) {
-            if (iq->debug)
-                reqprintf(iq, "BAD INDEX %d OR KEYLENGTH %d", ixnum, ixkeylen);
-            reqerrstrhdr(iq, "Table '%s' ", iq->usedb->tablename);
-            reqerrstr(iq, COMDB2_ADD_RC_INVL_KEY,
-                      "bad index %d or keylength %d", ixnum, ixkeylen);
-            *ixfailnum = ixnum;
-            *opfailcode = OP_FAILED_BAD_REQUEST;
-            return ERR_BADREQ;
-        }
-
-        int rc;
-        if (iq->idxInsert)
-            rc = create_key_from_ireq(iq, ixnum, 0, &od_dta_tail, &od_tail_len,
-                                      mangled_key, od_dta, od_len, key);
-        else {
-            char ixtag[MAXTAGLEN];
-            snprintf(ixtag, sizeof(ixtag), "%s_IX_%d", ondisktag, ixnum);
-            rc = create_key_from_ondisk_sch_blobs(
-                iq->usedb, ondisktagsc, ixnum, &od_dta_tail, &od_tail_len,
-                mangled_key, ondisktag, od_dta, od_len, ixtag, key, NULL, blobs,
-                maxblobs, iq->tzname);
-        }
-        if (rc == -1) {
-            if (iq->debug)
-                reqprintf(iq, "CAN'T FORM INDEX %d", ixnum);
-            reqerrstrhdr(iq, "Table '%s' ", iq->usedb->tablename);
-            reqerrstr(iq, COMDB2_ADD_RC_INVL_IDX, "cannot form index %d",
-                      ixnum);
-            *ixfailnum = ixnum;
-            *opfailcode = OP_FAILED_INTERNAL + ERR_FORM_KEY;
-            return rc;
-        }
-
-        /* light the prefault kill bit for this subop - newkeys */
-        prefault_kill_bits(iq, ixnum, PFRQ_NEWKEY);
-        if (iq->osql_step_ix)
-            gbl_osqlpf_step[*(iq->osql_step_ix)].step += 2;
-
-        int isnullk = ix_isnullk(iq->usedb, key, ixnum);
-
-        if (vgenid && iq->usedb->ix_dupes[ixnum] == 0 && !isnullk) {
-            int fndrrn = 0;
-            unsigned long long fndgenid = 0ULL;
-            rc = ix_find_by_key_tran(iq, key, ixkeylen, ixnum, NULL, &fndrrn,
-                                     &fndgenid, NULL, NULL, 0, trans);
-            if (rc == IX_FND && fndgenid == vgenid) {
-                return ERR_VERIFY;
-            } else if (rc == RC_INTERNAL_RETRY) {
-                return RC_INTERNAL_RETRY;
-            } else if (rc != IX_FNDMORE && rc != IX_NOTFND &&
-                       rc != IX_PASTEOF && rc != IX_EMPTY) {
-                logmsg(LOGMSG_ERROR, "%s:%d got unexpected error rc = %d\n",
-                       __func__, __LINE__, rc);
-                return ERR_INTERNAL;
-            }
-
-            /* The row is not in new btree, proceed with the add */
-            vgenid = 0; // no need to verify again
-        }
-
-        /* add the key */
-        rc = ix_addk(iq, trans, key, ixnum, *genid, *rrn, od_dta_tail,
-                     od_tail_len, isnullk);
-
-        if (vgenid && rc == IX_DUP) {
-            if (iq->usedb->ix_dupes[ixnum] || isnullk) {
-                return ERR_VERIFY;
-            }
-        }
-
-        if (iq->debug) {
-            reqprintf(iq, "ix_addk IX %d LEN %u KEY ", ixnum, ixkeylen);
-            reqdumphex(iq, key, ixkeylen);
-            reqmoref(iq, " RC %d", rc);
-        }
-
-        if (rc == RC_INTERNAL_RETRY) {
+        int rc = add_record_index(iq, trans, ixnum, blobs, maxblobs,
+                                  opfailcode, ixfailnum, *rrn, *genid, &vgenid,
+                                  od_dta, od_len, ondisktag, ondisktagsc);
+        if (rc)
             return rc;
-        } else if (rc != 0) {
-            *ixfailnum = ixnum;
-            /* If following changes, update OSQL_INSREC in osqlcomm.c */
-            *opfailcode = OP_FAILED_UNIQ; /* really? */
-
-            return rc;
-        }
     }
     return 0;
 }
@@ -343,7 +438,8 @@ int upd_record_indices(struct ireq *iq, void *trans, int *opfailcode,
                        unsigned long long del_keys, int flags,
                        blob_buffer_t *add_idx_blobs,
                        blob_buffer_t *del_idx_blobs, int same_genid_with_upd,
-                       unsigned long long vgenid, int *deferredAdd)
+                       unsigned long long vgenid, int *deferredAdd,
+                       const int *updCols)
 {
     char *od_dta_tail = NULL;
     int od_tail_len;
@@ -417,6 +513,10 @@ int upd_record_indices(struct ireq *iq, void *trans, int *opfailcode,
                 rc = create_key_from_ireq(iq, ixnum, 0, &od_dta_tail,
                                           &od_tail_len, mangled_newkey, od_dta,
                                           od_len, newkey);
+        } else if (key_unchanged(iq->usedb, ixnum, updCols)) {
+            memcpy(newkey, oldkey, keysize);
+            od_dta_tail = NULL;
+            od_tail_len = 0;
         } else /* form the new key from "od_dta" into "newkey" */
             rc = create_key_from_ondisk_blobs(
                 iq->usedb, ixnum, &od_dta_tail, &od_tail_len, mangled_newkey,
@@ -21,14 +21,21 @@ int check_for_upsert(struct ireq *iq, void *trans, struct schema *ondisktagsc,
                      blob_buffer_t *blobs, size_t maxblobs, int *opfailcode,
                      int *ixfailnum, int *retrc, const char *ondisktag,
                      void *od_dta, size_t od_len, unsigned long long ins_keys,
-                     int rec_flags);
+                     int rec_flags, int *probe_ixnum);
+
+int add_upsert_probe_key(struct ireq *iq, void *trans, int ixnum,
+                         blob_buffer_t *blobs, size_t maxblobs,
+                         int *opfailcode, int *ixfailnum, int rrn,
+                         unsigned long long genid, void *od_dta, size_t od_len,
+                         const char *ondisktag, struct schema *ondisktagsc);
 
 int add_record_indices(struct ireq *iq, void *trans, blob_buffer_t *blobs,
                        size_t maxblobs, int *opfailcode, int *ixfailnum,
                        int *rrn, unsigned long long *genid,
                        unsigned long long vgenid, unsigned long long ins_keys,
                        int opcode, int blkpos, void *od_dta, size_t od_len,
-                       const char *ondisktag, struct schema *ondisktagsc);
+                       const char *ondisktag, struct schema *ondisktagsc,
+                       int added_ixnum);
 
 int upd_record_indices(struct ireq *iq, void *trans, int *opfailcode,
                        int *ixfailnum, int rrn, unsigned long long *newgenid,
@@ -37,7 +44,8 @@ int upd_record_indices(struct ireq *iq, void *trans, int *opfailcode,
                        unsigned long long del_keys, int flags,
                        blob_buffer_t *add_idx_blobs,
                        blob_buffer_t *del_idx_blobs, int same_genid_with_upd,
-                       unsigned long long vgenid, int *deferredAdd);
+                       unsigned long long vgenid, int *deferredAdd,
+                       const int *updCols);
 
 int del_record_indices(struct ireq *iq, void *trans, int *opfailcode,
                        int *ixfailnum, int rrn, unsigned long long genid,
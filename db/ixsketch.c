@@ -0,0 +1,209 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/*
+ * Index sketches for incremental analyze.
+ *
+ * While analyze_incremental is on, the master counts the keys added to and
+ * deleted from every index, and keeps a HyperLogLog of the distinct values
+ * of each key prefix among the added keys.  They describe what changed
+ * since the table was last analyzed, and analyze_table_incremental() folds
+ * them into the existing sqlite_stat1/sqlite_stat4 rows instead of scanning
+ * the table again.
+ *
+ * Like the autoanalyze counters, keys from transactions that later abort
+ * are counted too; the next full analyze puts that right.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <alloca.h>
+
+#include "comdb2.h"
+#include "sql.h"
+#include "autoanalyze.h"
+#include "hll.h"
+#include <memory_sync.h>
+
+int gbl_analyze_incremental = 0;
+int gbl_analyze_incremental_max = 10;
+
+struct ixsketch_ix {
+    int ncols;
+    int *prefixlen; /* key bytes in each prefix */
+    struct hll *hll; /* distinct added values, one per prefix */
+    int64_t nadds;
+    int64_t ndels;
+};
+
+struct ixsketch {
+    pthread_mutex_t lk;
+    time_t since;
+    int nix;
+    struct ixsketch_ix ix[];
+};
+
+static pthread_mutex_t ixsketch_create_lk = PTHREAD_MUTEX_INITIALIZER;
+
+void ixsketch_free(struct ixsketch *sk)
+{
+    if (sk == NULL)
+        return;
+    for (int i = 0; i < sk->nix; i++) {
+        free(sk->ix[i].prefixlen);
+        free(sk->ix[i].hll);
+    }
+    Pthread_mutex_destroy(&sk->lk);
+    free(sk);
+}
+
+static struct ixsketch *ixsketch_new(struct dbtable *db)
+{
+    struct ixsketch *sk;
+
+    sk = calloc(1, offsetof(struct ixsketch, ix) +
+                       db->nix * sizeof(struct ixsketch_ix));
+    if (sk == NULL)
+        return NULL;
+    Pthread_mutex_init(&sk->lk, NULL);
+    sk->since = time(NULL);
+    sk->nix = db->nix;
+
+    for (int i = 0; i < db->nix; i++) {
+        struct schema *s = db->ixschema[i];
+        struct ixsketch_ix *ix = &sk->ix[i];
+        int len = 0;
+
+        ix->ncols = s->nmembers;
+        ix->prefixlen = malloc(ix->ncols * sizeof(int));
+        ix->hll = malloc(ix->ncols * sizeof(struct hll));
+        if (ix->prefixlen == NULL || ix->hll == NULL) {
+            ixsketch_free(sk);
+            return NULL;
+        }
+        for (int j = 0; j < ix->ncols; j++) {
+            len += s->member[j].len;
+            ix->prefixlen[j] = len;
+            hll_init(&ix->hll[j]);
+        }
+    }
+    return sk;
+}
+
+static struct ixsketch *ixsketch_get(struct dbtable *db)
+{
+    struct ixsketch *sk = db->ixsketch;
+    if (sk)
+        return sk;
+
+    Pthread_mutex_lock(&ixsketch_create_lk);
+    if ((sk = db->ixsketch) == NULL) {
+        sk = ixsketch_new(db);
+        MEMORY_SYNC;
+        db->ixsketch = sk;
+    }
+    Pthread_mutex_unlock(&ixsketch_create_lk);
+    return sk;
+}
+
+void ixsketch_add(struct dbtable *db, int ixnum, const void *key)
+{
+    struct ixsketch *sk;
+    struct ixsketch_ix *ix;
+    uint64_t *hash;
+
+    if (!gbl_analyze_incremental || is_sqlite_stat(db->tablename))
+        return;
+    if ((sk = ixsketch_get(db)) == NULL || ixnum >= sk->nix)
+        return;
+
+    ix = &sk->ix[ixnum];
+    hash = alloca(ix->ncols * sizeof(uint64_t));
+    for (int j = 0; j < ix->ncols; j++)
+        hash[j] = hll_hash(key, ix->prefixlen[j]);
+
+    Pthread_mutex_lock(&sk->lk);
+    ix->nadds++;
+    for (int j = 0; j < ix->ncols; j++)
+        hll_add(&ix->hll[j], hash[j]);
+    Pthread_mutex_unlock(&sk->lk);
+}
+
+void ixsketch_del(struct dbtable *db, int ixnum)
+{
+    struct ixsketch *sk;
+
+    if (!gbl_analyze_incremental || is_sqlite_stat(db->tablename))
+        return;
+    if ((sk = ixsketch_get(db)) == NULL || ixnum >= sk->nix)
+        return;
+
+    Pthread_mutex_lock(&sk->lk);
+    sk->ix[ixnum].ndels++;
+    Pthread_mutex_unlock(&sk->lk);
+}
+
+void ixsketch_reset(struct dbtable *db)
+{
+    struct ixsketch *sk = db->ixsketch;
+
+    if (sk == NULL)
+        return;
+
+    Pthread_mutex_lock(&sk->lk);
+    sk->since = time(NULL);
+    for (int i = 0; i < sk->nix; i++) {
+        struct ixsketch_ix *ix = &sk->ix[i];
+        ix->nadds = ix->ndels = 0;
+        for (int j = 0; j < ix->ncols; j++)
+            hll_init(&ix->hll[j]);
+    }
+    Pthread_mutex_unlock(&sk->lk);
+}
+
+int ixsketch_covers(struct dbtable *db)
+{
+    struct ixsketch *sk = db->ixsketch;
+    /* a sketch started after the last analyze has missed some changes */
+    return sk != NULL && sk->since <= db->aa_lastepoch;
+}
+
+int ixsketch_get_stats(struct dbtable *db, int ixnum, int64_t *nadds,
+                       int64_t *ndels, double *distinct, int maxcols)
+{
+    struct ixsketch *sk = db->ixsketch;
+    struct ixsketch_ix *ix;
+    int ncols;
+
+    if (sk == NULL || ixnum >= sk->nix)
+        return -1;
+    ix = &sk->ix[ixnum];
+
+    Pthread_mutex_lock(&sk->lk);
+    *nadds = ix->nadds;
+    *ndels = ix->ndels;
+    ncols = ix->ncols < maxcols ? ix->ncols : maxcols;
+    for (int j = 0; j < ncols; j++) {
+        distinct[j] = hll_estimate(&ix->hll[j]);
+        /* the estimate can drift past the number of values added */
+        if (distinct[j] > ix->nadds)
+            distinct[j] = ix->nadds;
+    }
+    Pthread_mutex_unlock(&sk->lk);
+    return ncols;
+}
@@ -25,19 +25,15 @@ typedef struct logical_state {
 } logical_state_t;
 
 /* this should be called under sched->mtx */
-static int logical_is_exec_time(sched_if_t *impl, cron_event_t *event)
+static long long logical_clock(sched_if_t *impl)
 {
     logical_state_t *state = (logical_state_t *)impl->state;
-    int rc = 0;
-    assert(event);
     assert(state);
 
-    rc = event->epoch <= state->clock;
-
-    return rc;
+    return state->clock;
 }
 
-static int logical_wait_next_event(sched_if_t *impl, cron_event_t *event)
+static int logical_wait_next_event(sched_if_t *impl, const int *next)
 {
     logical_state_t *state = (logical_state_t *)impl->state;
     struct errstat err = {0};
@@ -88,7 +84,7 @@ logical_cron_create(sched_if_t *intf, char *(*describe)(sched_if_t *),
     intf->type = CRON_LOGICAL;
     intf->default_sleep_idle =
         bdb_attr_get(thedb->bdb_attr, BDB_ATTR_CRON_LOGICAL_IDLE_SECS);
-    intf->is_exec_time = logical_is_exec_time;
+    intf->clock = logical_clock;
     intf->wait_next_event = logical_wait_next_event;
     intf->describe = describe;
     intf->event_describe = event_describe;
@@ -29,29 +29,105 @@
 #include <mem_uncategorized.h>
 #include <mem_override.h>
 #include <logmsg.h>
+#include <locks_wrap.h>
 
-struct lrucache *lrucache_init(hashfunc_t *hashfunc, cmpfunc_t *cmpfunc,
-                               void (*freefunc)(void *), int offset, int keyoff,
-                               int keysz, int maxent)
+static struct lrucache *lrucache_init_int(hashfunc_t *hashfunc,
+                                          cmpfunc_t *cmpfunc,
+                                          void (*freefunc)(void *), int offset,
+                                          int keyoff, int keysz, int maxent,
+                                          int nshards, int concurrent)
 {
     struct lrucache *cache;
 
+    if (nshards < 1)
+        nshards = 1;
     cache = malloc(sizeof(struct lrucache));
-    cache->maxent = maxent;
+    cache->shards = calloc(nshards, sizeof(struct lrucache_shard));
+    cache->nshards = nshards;
+    cache->concurrent = concurrent;
     cache->freefunc = freefunc;
+    cache->hashfunc = hashfunc;
     cache->offset = offset;
     cache->keyoff = keyoff;
     cache->keysz = keysz;
-    listc_init(&cache->lru, offset + offsetof(struct lrucache_link, lnk));
-    listc_init(&cache->used, offset + offsetof(struct lrucache_link, lnk));
-    cache->h = hash_init_user(hashfunc, cmpfunc, keyoff, keysz);
+    lrucache_set_maxent(cache, maxent);
+    lrucache_set_maxbytes(cache, 0);
+    for (int i = 0; i < nshards; i++) {
+        struct lrucache_shard *s = &cache->shards[i];
+        Pthread_mutex_init(&s->lk, NULL);
+        listc_init(&s->lru, offset + offsetof(struct lrucache_link, lnk));
+        listc_init(&s->used, offset + offsetof(struct lrucache_link, lnk));
+        s->h = hash_init_user(hashfunc, cmpfunc, keyoff, keysz);
+    }
 
     return cache;
 }
 
+struct lrucache *lrucache_init(hashfunc_t *hashfunc, cmpfunc_t *cmpfunc,
+                               void (*freefunc)(void *), int offset, int keyoff,
+                               int keysz, int maxent)
+{
+    return lrucache_init_int(hashfunc, cmpfunc, freefunc, offset, keyoff,
+                             keysz, maxent, 1, 0);
+}
+
+struct lrucache *lrucache_init_concurrent(hashfunc_t *hashfunc,
+                                          cmpfunc_t *cmpfunc,
+                                          void (*freefunc)(void *), int offset,
+                                          int keyoff, int keysz, int maxent,
+                                          int nshards)
+{
+    return lrucache_init_int(hashfunc, cmpfunc, freefunc, offset, keyoff,
+                             keysz, maxent, nshards, 1);
+}
+
+void lrucache_set_maxent(struct lrucache *cache, int maxent)
+{
+    cache->maxent = maxent;
+    cache->shardmax = (maxent + cache->nshards - 1) / cache->nshards;
+}
+
+void lrucache_set_maxbytes(struct lrucache *cache, long long maxbytes)
+{
+    cache->maxbytes = maxbytes;
+    cache->shardmaxbytes = (maxbytes + cache->nshards - 1) / cache->nshards;
+}
+
+static struct lrucache_shard *lrucache_shard(struct lrucache *cache,
+                                             const void *key)
+{
+    if (cache->nshards == 1)
+        return &cache->shards[0];
+    return &cache->shards[cache->hashfunc(key, cache->keysz) %
+                          cache->nshards];
+}
+
+static inline int lrucache_size(struct lrucache *cache, void *ent)
+{
+    return ((struct lrucache_link *)((uintptr_t)ent + cache->offset))->size;
+}
+
+static inline void shard_lock(struct lrucache *cache, struct lrucache_shard *s)
+{
+    if (cache->concurrent)
+        Pthread_mutex_lock(&s->lk);
+}
+
+static inline void shard_unlock(struct lrucache *cache,
+                                struct lrucache_shard *s)
+{
+    if (cache->concurrent)
+        Pthread_mutex_unlock(&s->lk);
+}
+
 int lrucache_hasentry(struct lrucache *cache, void *key)
 {
-    void *ent = hash_find(cache->h, key);
+    struct lrucache_shard *s = lrucache_shard(cache, key);
+    void *ent;
+
+    shard_lock(cache, s);
+    ent = hash_find(s->h, key);
+    shard_unlock(cache, s);
     if (ent) {
         return 1;
     }
@@ -60,44 +136,69 @@ int lrucache_hasentry(struct lrucache *cache, void *key)
 
 void *lrucache_find(struct lrucache *cache, void *key)
 {
-    void *ent = hash_find(cache->h, key);
+    struct lrucache_shard *s = lrucache_shard(cache, key);
+    void *ent;
+
+    shard_lock(cache, s);
+    ent = hash_find(s->h, key);
     if (ent) {
         struct lrucache_link *lent;
         lent = (struct lrucache_link *)((uintptr_t)ent + cache->offset);
         lent->ref++;
         lent->hits++;
         if (lent->ref == 1) {
-            listc_rfl(&cache->lru, ent);
-            listc_abl(&cache->used, ent);
+            listc_rfl(&s->lru, ent);
+            listc_abl(&s->used, ent);
         }
     }
+    shard_unlock(cache, s);
     return ent;
 }
 
-void lrucache_add(struct lrucache *cache, void *item)
+int lrucache_add_sized(struct lrucache *cache, void *item, int size)
 {
+    struct lrucache_shard *s =
+        lrucache_shard(cache, (char *)item + cache->keyoff);
     void *ent;
     struct lrucache_link *lent;
 
     lent = (struct lrucache_link *)((uintptr_t)item + cache->offset);
     lent->ref = 0;
     lent->hits = 0;
+    lent->size = size;
 
-    while (cache->lru.count >= cache->maxent) {
-        ent = listc_rtl(&cache->lru);
+    shard_lock(cache, s);
+    if (hash_find(s->h, (char *)item + cache->keyoff)) {
+        shard_unlock(cache, s);
+        return -1;
+    }
+    /* entries in use can leave the shard over its bytes for a while */
+    while (s->lru.count >= cache->shardmax ||
+           (cache->shardmaxbytes && s->lru.count > 0 &&
+            s->bytes + size > cache->shardmaxbytes)) {
+        ent = listc_rtl(&s->lru);
         if (ent) {
-            int ret = hash_del(cache->h, ent);
+            int ret = hash_del(s->h, ent);
             if (ret != 0) {
                 logmsg(LOGMSG_ERROR, "NOT DELETED.\n");
             } else {
+                s->bytes -= lrucache_size(cache, ent);
                 cache->freefunc(ent);
             }
         } else {
-            return;
+            break;
         }
     }
-    hash_add(cache->h, item);
-    listc_abl(&cache->lru, item);
+    hash_add(s->h, item);
+    listc_abl(&s->lru, item);
+    s->bytes += size;
+    shard_unlock(cache, s);
+    return 0;
+}
+
+int lrucache_add(struct lrucache *cache, void *item)
+{
+    return lrucache_add_sized(cache, item, 0);
 }
 static int finalize_hint_hash(void *hash_entry, void *cache_)
 {
@@ -107,12 +208,34 @@ static int finalize_hint_hash(void *hash_entry, void *cache_)
     return 0;
 }
 
-void lrucache_destroy(struct lrucache *cache)
+static void lrucache_clear_shard(struct lrucache *cache,
+                                 struct lrucache_shard *s)
 {
     void *ent;
-    int used_count;
 
-    used_count = cache->used.count;
+    while ((ent = listc_rtl(&s->lru)) != NULL) {
+        hash_del(s->h, ent);
+        s->bytes -= lrucache_size(cache, ent);
+        cache->freefunc(ent);
+    }
+}
+
+void lrucache_clear(struct lrucache *cache)
+{
+    for (int i = 0; i < cache->nshards; i++) {
+        struct lrucache_shard *s = &cache->shards[i];
+        shard_lock(cache, s);
+        lrucache_clear_shard(cache, s);
+        shard_unlock(cache, s);
+    }
+}
+
+void lrucache_destroy(struct lrucache *cache)
+{
+    int used_count = 0;
+
+    for (int i = 0; i < cache->nshards; i++)
+        used_count += cache->shards[i].used.count;
     if (used_count != 0) {
         logmsg(LOGMSG_WARN, 
             "trying to destroy cache with in-use entries: %d entries on list\n",
@@ -120,25 +243,28 @@ void lrucache_destroy(struct lrucache *cache)
         return;
     }
 
-    ent = listc_rtl(&cache->lru);
-    while (ent) {
-        hash_del(cache->h, ent);
-        cache->freefunc(ent);
-        ent = listc_rtl(&cache->lru);
+    for (int i = 0; i < cache->nshards; i++) {
+        struct lrucache_shard *s = &cache->shards[i];
+        lrucache_clear_shard(cache, s);
+        /* Lets see if something is remaining. */
+        hash_for(s->h, finalize_hint_hash, cache);
+        hash_free(s->h);
+        Pthread_mutex_destroy(&s->lk);
     }
-    /* Lets see if something is remaining. */
-    hash_for(cache->h, finalize_hint_hash, cache);
-    hash_free(cache->h);
+    free(cache->shards);
     free(cache);
 }
 
 void lrucache_release(struct lrucache *cache, void *key)
 {
+    struct lrucache_shard *s = lrucache_shard(cache, key);
     void *ent;
     struct lrucache_link *lent;
 
-    ent = hash_find(cache->h, key);
+    shard_lock(cache, s);
+    ent = hash_find(s->h, key);
     if (ent == NULL) {
+        shard_unlock(cache, s);
         logmsg(LOGMSG_ERROR, "releasing key, but not found?\n");
         return;
     }
@@ -148,41 +274,47 @@ void lrucache_release(struct lrucache *cache, void *key)
     if (lent->ref < 0) {
         logmsg(LOGMSG_ERROR, "key released more often than found, ref %d\n",
                 lent->ref);
-        return;
     } else if (lent->ref == 0) {
-        listc_rfl(&cache->used, ent);
-        listc_abl(&cache->lru, ent);
+        listc_rfl(&s->used, ent);
+        listc_abl(&s->lru, ent);
     }
+    shard_unlock(cache, s);
 }
 
-void lrucache_foreach(struct lrucache *cache, void (*display)(void *, void *),
-                      void *usrptr)
+static void lrucache_foreach_list(listc_t *list,
+                                  void (*display)(void *, void *),
+                                  void *usrptr)
 {
     void *ent;
     linkc_t *l;
 
-    logmsg(LOGMSG_USER, "%d in lru, %d in used\n", cache->lru.count, cache->used.count);
-    hash_dump_stats(cache->h, stdout, NULL);
-
-    logmsg(LOGMSG_USER, "lru:\n");
-    ent = cache->lru.top;
+    ent = list->top;
     while (ent) {
         display(ent, usrptr);
 
-        uintptr_t p = (uintptr_t)ent + cache->lru.diff +
-                      offsetof(struct lrucache_link, lnk);
+        uintptr_t p = (uintptr_t)ent + list->diff;
         l = (linkc_t *)p;
         ent = l->next;
     }
+}
 
-    logmsg(LOGMSG_USER, "used:\n");
-    ent = cache->used.top;
-    while (ent) {
-        display(ent, usrptr);
+void lrucache_foreach(struct lrucache *cache, void (*display)(void *, void *),
+                      void *usrptr)
+{
+    for (int i = 0; i < cache->nshards; i++) {
+        struct lrucache_shard *s = &cache->shards[i];
 
-        uintptr_t p = (uintptr_t)ent + cache->lru.diff +
-                      offsetof(struct lrucache_link, lnk);
-        l = (linkc_t *)p;
-        ent = l->next;
+        shard_lock(cache, s);
+        if (cache->nshards > 1)
+            logmsg(LOGMSG_USER, "shard %d: ", i);
+        logmsg(LOGMSG_USER, "%d in lru, %d in used, %lld bytes\n",
+               s->lru.count, s->used.count, s->bytes);
+        hash_dump_stats(s->h, stdout, NULL);
+
+        logmsg(LOGMSG_USER, "lru:\n");
+        lrucache_foreach_list(&s->lru, display, usrptr);
+        logmsg(LOGMSG_USER, "used:\n");
+        lrucache_foreach_list(&s->used, display, usrptr);
+        shard_unlock(cache, s);
     }
 }
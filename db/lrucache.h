@@ -17,41 +17,71 @@
 #ifndef INCLUDED_LRUCACHE_H
 #define INCLUDED_LRUCACHE_H
 
+#include <pthread.h>
 #include "plhash.h"
 #include "list.h"
 
+struct lrucache_shard {
+    pthread_mutex_t lk; /* if the cache is concurrent */
+    hash_t *h;
+    listc_t lru;
+    listc_t used;
+    long long bytes; /* sizes of the entries added with lrucache_add_sized */
+};
+
 struct lrucache {
     int maxent;
+    int shardmax; /* maxent split over the shards */
+    long long maxbytes;
+    long long shardmaxbytes;
     void (*freefunc)(void *);
-    hash_t *h;
+    hashfunc_t *hashfunc;
     int offset;
     int keyoff;
     int keysz;
-    listc_t lru;
-    listc_t used;
+    int concurrent;
+    int nshards;
+    struct lrucache_shard *shards;
 };
 
 struct lrucache_link {
     linkc_t lnk;
     int ref;
     int hits;
+    int size;
 };
 
 typedef struct lrucache lrucache;
 typedef struct lrucache_link lrucache_link;
 
+/* Callers lock around every call */
 struct lrucache *lrucache_init(hashfunc_t *hashfunc, cmpfunc_t *cmpfunc,
                                void (*freefunc)(void *), int offset, int keyoff,
                                int keysz, int maxent);
+/* The cache locks itself; keys are spread over nshards, each with its own
+ * lock, hash and LRU list holding its share of maxent.  An entry returned
+ * by lrucache_find is safe to use until lrucache_release. */
+struct lrucache *lrucache_init_concurrent(hashfunc_t *hashfunc,
+                                          cmpfunc_t *cmpfunc,
+                                          void (*freefunc)(void *), int offset,
+                                          int keyoff, int keysz, int maxent,
+                                          int nshards);
 void *lrucache_find(struct lrucache *cache, void *key);
 
 int lrucache_hasentry(struct lrucache *cache, void *key);
 
-void lrucache_add(struct lrucache *cache, void *item);
+/* Returns non-zero, without adding, if an entry with this key exists */
+int lrucache_add(struct lrucache *cache, void *item);
+/* Like lrucache_add, but the entry counts size bytes against maxbytes */
+int lrucache_add_sized(struct lrucache *cache, void *item, int size);
 void lrucache_destroy(struct lrucache *cache);
+/* Free all the entries nobody is using */
+void lrucache_clear(struct lrucache *cache);
 void lrucache_foreach(struct lrucache *cache, void (*display)(void *, void *),
                       void *usrptr);
 void lrucache_set_maxent(struct lrucache *cache, int maxent);
+/* 0 for no limit on the bytes held, the default */
+void lrucache_set_maxbytes(struct lrucache *cache, long long maxbytes);
 void lrucache_release(struct lrucache *cache, void *key);
 
 #endif
@@ -49,6 +49,7 @@
 #include <limits.h>
 #include <strings.h>
 #include <poll.h>
+#include <time.h>
 #include <str0.h>
 #include <epochlib.h>
 #include <plhash.h>
@@ -67,10 +68,19 @@
 #include "time_accounting.h"
 #include <ctrace.h>
 #include "intern_strings.h"
+#include "thdpool.h"
+#include "comdb2_pthread_create.h"
+#include "comdb2_atomic.h"
 
 int g_osql_blocksql_parallel_max = 5;
 int gbl_osql_check_replicant_numops = 1;
+int gbl_osql_apply_parallel = 0; /* max tables replayed at once, 0 = serial */
+int gbl_osql_apply_parallel_minops = 1000;
+int gbl_osql_bplog_cache = 32; /* finished bplogs kept to be used again */
+int gbl_osql_stream_minops = 0; /* ops in before a session streams, 0 = never */
+int gbl_osql_stream_max_pending = 100000;
 extern int gbl_blocksql_grace;
+extern int gbl_max_wr_rows_per_txn;
 
 
 struct blocksql_tran {
@@ -89,6 +99,14 @@ struct blocksql_tran {
     int delayed;
     int rows;
     bool iscomplete;
+
+    /* streaming sessions, all under store_mtx */
+    pthread_cond_t stream_cond; /* ops came in, or were applied */
+    int applied;                /* ops the block processor has taken */
+    int stalled_at;             /* applied when the saver gave up on it */
+    bool stream_waiting;        /* the saver waits for the block processor */
+    bool stream_ddl;            /* a schema change came in after dispatch */
+    struct blocksql_tran *next_cached;
 };
 
 typedef struct oplog_key {
@@ -180,6 +198,63 @@ static int osql_bplog_instbl_key_cmp(void *usermem, int key1len,
     return 0;
 }
 
+/* A finished bplog keeps its emptied temp tables and goes on a free list,
+   so the next transaction to come in does not allocate them again.  The
+   block processor that frees a bplog is seldom the one starting the next,
+   hence the one list for all. */
+static pthread_mutex_t bplog_cache_lk = PTHREAD_MUTEX_INITIALIZER;
+static blocksql_tran_t *bplog_cache;
+static int bplog_cache_count;
+
+static blocksql_tran_t *bplog_cache_get(void)
+{
+    blocksql_tran_t *tran;
+
+    Pthread_mutex_lock(&bplog_cache_lk);
+    if ((tran = bplog_cache) != NULL) {
+        bplog_cache = tran->next_cached;
+        bplog_cache_count--;
+    }
+    Pthread_mutex_unlock(&bplog_cache_lk);
+    return tran;
+}
+
+/* Returns 0 if tran was kept, else its tables are left for the caller */
+static int bplog_cache_put(blocksql_tran_t *tran)
+{
+    int bdberr = 0;
+
+    if (gbl_osql_bplog_cache <= 0 || tran->db == NULL ||
+        bdb_temp_table_reset(thedb->bdb_env, tran->db, &bdberr) != 0)
+        return -1;
+    if (tran->db_ins &&
+        bdb_temp_table_reset(thedb->bdb_env, tran->db_ins, &bdberr) != 0) {
+        bdb_temp_table_close(thedb->bdb_env, tran->db_ins, &bdberr);
+        tran->db_ins = NULL;
+    }
+
+    tran->sess = NULL;
+    tran->last_db = NULL;
+    tran->dowait = 0;
+    tran->delayed = 0;
+    tran->rows = 0;
+    tran->iscomplete = 0;
+    tran->applied = 0;
+    tran->stream_waiting = 0;
+    tran->stream_ddl = 0;
+
+    Pthread_mutex_lock(&bplog_cache_lk);
+    if (bplog_cache_count >= gbl_osql_bplog_cache) {
+        Pthread_mutex_unlock(&bplog_cache_lk);
+        return -1;
+    }
+    tran->next_cached = bplog_cache;
+    bplog_cache = tran;
+    bplog_cache_count++;
+    Pthread_mutex_unlock(&bplog_cache_lk);
+    return 0;
+}
+
 /**
  * Adds the current session
  * If there is no bplog created, it creates one.
@@ -203,29 +278,34 @@ int osql_bplog_start(struct ireq *iq, osql_sess_t *sess)
     if (iq->blocksql_tran)
         abort();
 
-    tran = calloc(sizeof(blocksql_tran_t), 1);
-    if (!tran) {
-        logmsg(LOGMSG_ERROR, "%s: error allocating %zu bytes\n", __func__,
-               sizeof(blocksql_tran_t));
-        return -1;
-    }
+    if ((tran = bplog_cache_get()) == NULL) {
+        tran = calloc(sizeof(blocksql_tran_t), 1);
+        if (!tran) {
+            logmsg(LOGMSG_ERROR, "%s: error allocating %zu bytes\n", __func__,
+                   sizeof(blocksql_tran_t));
+            return -1;
+        }
 
-    Pthread_mutex_init(&tran->store_mtx, NULL);
+        Pthread_mutex_init(&tran->store_mtx, NULL);
+        Pthread_cond_init(&tran->stream_cond, NULL);
 
-    iq->blocksql_tran = tran; /* now blockproc knows about it */
+        /* init temporary table and cursor */
+        tran->db = bdb_temp_array_create(thedb->bdb_env, &bdberr);
+        if (!tran->db || bdberr) {
+            logmsg(LOGMSG_ERROR, "%s: failed to create temp table bdberr=%d\n",
+                   __func__, bdberr);
+            Pthread_mutex_destroy(&tran->store_mtx);
+            Pthread_cond_destroy(&tran->stream_cond);
+            free(tran);
+            return -1;
+        }
 
-    /* init temporary table and cursor */
-    tran->db = bdb_temp_array_create(thedb->bdb_env, &bdberr);
-    if (!tran->db || bdberr) {
-        logmsg(LOGMSG_ERROR, "%s: failed to create temp table bdberr=%d\n",
-               __func__, bdberr);
-        free(tran);
-        return -1;
+        bdb_temp_table_set_cmp_func(tran->db, osql_bplog_key_cmp);
     }
 
-    bdb_temp_table_set_cmp_func(tran->db, osql_bplog_key_cmp);
+    iq->blocksql_tran = tran; /* now blockproc knows about it */
 
-    if (sess->is_reorder_on) {
+    if (sess->is_reorder_on && !tran->db_ins) {
         tran->db_ins = bdb_temp_array_create(thedb->bdb_env, &bdberr);
         if (!tran->db_ins) {
             // We can stll work without a INS table
@@ -238,6 +318,7 @@ int osql_bplog_start(struct ireq *iq, osql_sess_t *sess)
     }
 
     tran->dowait = 1;
+    tran->stalled_at = -1;
 
     iq->timings.req_received = osql_log_time();
     iq->tranddl = 0;
@@ -286,6 +367,10 @@ int osql_bplog_finish_sql(struct ireq *iq, struct block_err *err)
         error = 1;
         break;
     case SESS_PENDING:
+        /* its ops are applied as they come in, and it is checked again once
+           they are all in */
+        if (tran->sess->streaming)
+            return 0;
         rc = osql_sess_test_slow(tran->sess);
         if (rc)
             return rc;
@@ -558,6 +643,33 @@ char *osql_get_tran_summary(struct ireq *iq)
     return ret;
 }
 
+static void bplog_destroy(blocksql_tran_t *tran)
+{
+    int rc = 0;
+    int bdberr = 0;
+
+    Pthread_mutex_destroy(&tran->store_mtx);
+    Pthread_cond_destroy(&tran->stream_cond);
+
+    rc = bdb_temp_table_close(thedb->bdb_env, tran->db, &bdberr);
+    if (rc != 0) {
+        logmsg(LOGMSG_ERROR, "%s: failed close table rc=%d bdberr=%d\n",
+               __func__, rc, bdberr);
+    } else {
+        tran->db = NULL;
+    }
+
+    if (tran->db_ins) {
+        rc = bdb_temp_table_close(thedb->bdb_env, tran->db_ins, &bdberr);
+        if (rc != 0) {
+            logmsg(LOGMSG_ERROR, "%s: failed close table rc=%d bdberr=%d\n",
+                   __func__, rc, bdberr);
+        }
+    }
+
+    free(tran);
+}
+
 /**
  * Free all the sessions and free the bplog
  * HACKY: since we want to catch and report long requests in block
@@ -568,8 +680,6 @@ static pthread_mutex_t kludgelk = PTHREAD_MUTEX_INITIALIZER;
 void osql_bplog_free(struct ireq *iq, int are_sessions_linked, const char *func,
                      const char *callfunc, int line)
 {
-    int rc = 0;
-    int bdberr = 0;
     Pthread_mutex_lock(&kludgelk);
     blocksql_tran_t *tran = (blocksql_tran_t *)iq->blocksql_tran;
     iq->blocksql_tran = NULL;
@@ -588,26 +698,8 @@ void osql_bplog_free(struct ireq *iq, int are_sessions_linked, const char *func,
     osql_close_session(iq, &tran->sess, are_sessions_linked, func, callfunc,
                        line);
 
-    /* destroy transaction */
-    Pthread_mutex_destroy(&tran->store_mtx);
-
-    rc = bdb_temp_table_close(thedb->bdb_env, tran->db, &bdberr);
-    if (rc != 0) {
-        logmsg(LOGMSG_ERROR, "%s: failed close table rc=%d bdberr=%d\n",
-               __func__, rc, bdberr);
-    } else {
-        tran->db = NULL;
-    }
-
-    if (tran->db_ins) {
-        rc = bdb_temp_table_close(thedb->bdb_env, tran->db_ins, &bdberr);
-        if (rc != 0) {
-            logmsg(LOGMSG_ERROR, "%s: failed close table rc=%d bdberr=%d\n",
-                   __func__, rc, bdberr);
-        }
-    }
-
-    free(tran);
+    if (bplog_cache_put(tran) != 0)
+        bplog_destroy(tran);
 
     /* free the space for sql strings */
     if (iq->sqlhistory_ptr && iq->sqlhistory_ptr != &iq->sqlhistory[0]) {
@@ -651,6 +743,7 @@ const char *osql_reqtype_str(int type)
         "INSIDX",
         "DBQ_CONSUME_UUID",
         "STARTGEN",
+        "BATCH",
     };
     return typestr[type];
 }
@@ -784,6 +877,90 @@ static void send_error_to_replicant(int rqid, const char *host, int errval,
 #define DEBUG_PRINT_TMPBL_SAVING()
 #endif
 
+/* Streaming.  A socksql session that has sent osql_stream_minops ops is
+ * handed to a block processor before it completes, and the block processor
+ * applies its ops in the order they come in while the rest are still
+ * streaming, rather than sitting idle until the DONE op.  The ops are still
+ * saved in the bplog, as a deadlock or verify retry replays it.  A session
+ * whose ops are reordered, or whose selectvs take writelocks, needs all of
+ * them first and is never streamed; nor is one that sent a schema change
+ * before it streams, and one that sends it after is failed.  The saver is
+ * held back while the block processor is more than osql_stream_max_pending
+ * ops behind. */
+#define STREAM_POLL_MS 10
+#define STREAM_STALL_MS 100
+
+/* expects store_mtx held */
+static void stream_timedwait(blocksql_tran_t *tran, int ms)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += ms * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&tran->stream_cond, &tran->store_mtx, &ts);
+}
+
+/* Expects store_mtx held.  A block processor that makes no progress for
+ * STREAM_STALL_MS, as when it waits on a lock, is not waited for again until
+ * it does: the reader thread saving these ops saves those of other sessions
+ * too, and one of them may hold the lock. */
+static void stream_backpressure(blocksql_tran_t *tran)
+{
+    int limit = gbl_osql_stream_max_pending;
+    int waited = 0;
+
+    while (limit > 0 && tran->rows - tran->applied > limit &&
+           tran->applied != tran->stalled_at) {
+        int applied = tran->applied;
+
+        tran->stream_waiting = 1;
+        stream_timedwait(tran, STREAM_POLL_MS);
+        tran->stream_waiting = 0;
+
+        if (tran->applied != applied)
+            waited = 0;
+        else if ((waited += STREAM_POLL_MS) >= STREAM_STALL_MS)
+            tran->stalled_at = applied;
+    }
+}
+
+static int stream_ok(osql_sess_t *sess, struct ireq *iq)
+{
+    int minops = gbl_osql_stream_minops;
+
+    return minops > 0 && sess->seq + 1 >= minops && !sess->dispatched &&
+           (sess->type == OSQL_SOCK_REQ || sess->type == OSQL_SOCK_REQ_COST) &&
+           !sess->is_reorder_on && !sess->selectv_writelock_on_update &&
+           iq->tranddl == 0;
+}
+
+static int stream_dispatch(osql_sess_t *sess, struct ireq *iq)
+{
+    int rc = 0;
+
+    osql_sess_lock(sess);
+    osql_sess_lock_complete(sess);
+    if (!osql_sess_dispatched(sess) && !osql_sess_is_terminated(sess)) {
+        /* sess->iq is kept, as more ops are still to be saved */
+        sess->streaming = 1;
+        osql_sess_set_dispatched(sess, 1);
+        rc = handle_buf_sorese(thedb, iq, debug_this_request(gbl_debug_until));
+        if (rc) {
+            /* iq is gone; nothing more is saved */
+            sess->streaming = 0;
+            osql_session_set_ireq(sess, NULL);
+        }
+    }
+    osql_sess_unlock_complete(sess);
+    osql_sess_unlock(sess);
+
+    return rc;
+}
+
 /**
  * Inserts the op in the iq oplog
  * If sql processing is local, this is called by sqlthread
@@ -813,7 +990,7 @@ int osql_bplog_saveop(osql_sess_t *sess, char *rpl, int rplen,
     int bdberr;
     int debug = 0;
 
-    if (type == OSQL_SCHEMACHANGE)
+    if (type == OSQL_SCHEMACHANGE && !sess->streaming)
         iq->tranddl++;
 
     assert(sess->rqid == rqid);
@@ -858,6 +1035,14 @@ int osql_bplog_saveop(osql_sess_t *sess, char *rpl, int rplen,
 
     DEBUG_PRINT_TMPBL_SAVING();
 
+    if (sess->streaming && type == OSQL_SCHEMACHANGE)
+        tran->stream_ddl = 1;
+
+    /* the block processor streaming this session takes an error from
+       sess->xerr, not from the bplog */
+    if (sess->streaming && type == OSQL_XERR)
+        goto saved;
+
     ACCUMULATE_TIMING(CHR_TMPSVOP,
                       rc_op = bdb_temp_table_put(thedb->bdb_env, tmptbl, &key,
                                                  sizeof(key), rpl, rplen, NULL,
@@ -874,6 +1059,12 @@ int osql_bplog_saveop(osql_sess_t *sess, char *rpl, int rplen,
 
     tran->rows++;
 
+    if (sess->streaming) {
+        Pthread_cond_broadcast(&tran->stream_cond);
+        stream_backpressure(tran);
+    }
+
+saved:
     Pthread_mutex_unlock(&tran->store_mtx);
 
     if (rc_op)
@@ -883,8 +1074,11 @@ int osql_bplog_saveop(osql_sess_t *sess, char *rpl, int rplen,
     /* check if type is done */
     rc = osql_comm_is_done(type, rpl, rplen, rqid == OSQL_RQID_USE_UUID, &xerr,
                            osql_session_get_ireq(sess));
-    if (rc == 0)
+    if (rc == 0) {
+        if (osql_session_is_sorese(sess) && stream_ok(sess, iq))
+            return stream_dispatch(sess, iq);
         return 0;
+    }
 
     // only OSQL_DONE_SNAP, OSQL_DONE, OSQL_DONE_STATS, and OSQL_XERR
     // are processed beyond this point
@@ -920,6 +1114,13 @@ int osql_bplog_saveop(osql_sess_t *sess, char *rpl, int rplen,
 
     osql_sess_set_complete(rqid, uuid, sess, xerr);
 
+    if (sess->streaming) {
+        /* the block processor waits for this once it has all the ops */
+        Pthread_mutex_lock(&tran->store_mtx);
+        Pthread_cond_broadcast(&tran->stream_cond);
+        Pthread_mutex_unlock(&tran->store_mtx);
+    }
+
     /* if we received a too early, check the coherency and mark blackout node */
     if (xerr && xerr->errval == OSQL_TOOEARLY) {
         osql_comm_blkout_node(sess->offhost);
@@ -1328,10 +1529,357 @@ get_next_merge_tmps(struct temp_cursor *dbc, struct temp_cursor *dbc_ins,
 #define DEBUG_PRINT_TMPBL_READ()
 #endif
 
+typedef int (*apply_func_t)(struct ireq *, unsigned long long, uuid_t, void *,
+                            char **, int, int *, int **,
+                            blob_buffer_t blobs[MAXBLOBS], int,
+                            struct block_err *, int *, SBUF2 *);
+
+/* Parallel bplog replay.  The bplog is sorted by table (see
+ * setup_reorder_key), so when a transaction only inserts into tables
+ * without constraints or triggers, the ops of each table can be replayed
+ * by a pool thread under its own child of the block processor transaction,
+ * while the block processor keeps reading the bplog.  The children are
+ * committed into the parent before the final commit.  Anything that depends
+ * on the deferred constraint pass (updates, deletes, selectv, queues) is
+ * replayed serially after the pool threads are drained. */
+typedef struct apply_state {
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    pthread_mutex_t tranlk; /* child begin/commit share the parent */
+    int running;
+    int rc; /* first failure */
+    struct block_err err;
+    errstat_t errstat;
+    int receivedrows;
+    uint64_t txnsize;
+    int written_row_count;
+    double cost;
+} apply_state_t;
+
+typedef struct apply_group {
+    apply_state_t *st;
+    struct ireq iq; /* the worker's own, usedb is set by the group's USEDB */
+    void *parent;
+    apply_func_t func;
+    unsigned long long rqid;
+    uuid_t uuid;
+    int step; /* step of the first op */
+    int nops;
+    int alloc;
+    char **data;
+    int *datalen;
+} apply_group_t;
+
+static struct thdpool *gbl_osql_apply_thdpool;
+static pthread_once_t osql_apply_once = PTHREAD_ONCE_INIT;
+
+static void osql_apply_thd_start(struct thdpool *pool, void *thddata)
+{
+    backend_thread_event(thedb, COMDB2_THR_EVENT_START_RDWR);
+}
+
+static void osql_apply_thd_end(struct thdpool *pool, void *thddata)
+{
+    backend_thread_event(thedb, COMDB2_THR_EVENT_DONE_RDWR);
+}
+
+static void osql_apply_thdpool_init(void)
+{
+    gbl_osql_apply_thdpool = thdpool_create("osqlapplypool", 0);
+
+    if (gbl_exit_on_pthread_create_fail)
+        thdpool_set_exit(gbl_osql_apply_thdpool);
+
+    thdpool_set_init_fn(gbl_osql_apply_thdpool, osql_apply_thd_start);
+    thdpool_set_affinity_class(gbl_osql_apply_thdpool, COMDB2_THR_CLASS_COMMIT);
+    thdpool_set_delt_fn(gbl_osql_apply_thdpool, osql_apply_thd_end);
+    thdpool_set_minthds(gbl_osql_apply_thdpool, 0);
+    thdpool_set_maxthds(gbl_osql_apply_thdpool, 16);
+    thdpool_set_maxqueue(gbl_osql_apply_thdpool, 64);
+    thdpool_set_linger(gbl_osql_apply_thdpool, 10);
+    thdpool_set_longwaitms(gbl_osql_apply_thdpool, 10000);
+}
+
+/* can the ops of this table be replayed off the block processor thread? */
+static int apply_table_parallel_ok(int tbl_idx)
+{
+    struct dbtable *db;
+    int ii;
+
+    if (tbl_idx <= 0 || tbl_idx > thedb->num_dbs)
+        return 0;
+    db = thedb->dbs[tbl_idx - 1];
+    if (db->n_constraints || db->n_rev_constraints)
+        return 0;
+    for (ii = 0; ii < MAXCONSUMERS; ii++)
+        if (db->consumers[ii])
+            return 0;
+    return 1;
+}
+
+static int apply_parallel_ok(struct ireq *iq, blocksql_tran_t *tran,
+                             void *iq_tran, SBUF2 *logsb)
+{
+    if (gbl_osql_apply_parallel <= 0 || !tran->sess->is_reorder_on)
+        return 0;
+    if (tran->rows < gbl_osql_apply_parallel_minops)
+        return 0;
+    /* no nested logical transactions, and retries replay serially */
+    if (gbl_rowlocks || !iq_tran || iq->tranddl || iq->retries)
+        return 0;
+    /* the deferred constraint pass is shared by the whole transaction */
+    if (osql_get_delayed(iq) || iq->vfy_genid_track)
+        return 0;
+    if (gbl_replicate_local || iq->debug || logsb)
+        return 0;
+    return 1;
+}
+
+static void apply_group_free(apply_group_t *grp)
+{
+    int ii;
+    for (ii = 0; ii < grp->nops; ii++)
+        free(grp->data[ii]);
+    free(grp->data);
+    free(grp->datalen);
+    reqlog_free(grp->iq.reqlogger);
+    free(grp);
+}
+
+static void apply_group_run(apply_group_t *grp)
+{
+    apply_state_t *st = grp->st;
+    struct ireq *iq = &grp->iq;
+    blob_buffer_t blobs[MAXBLOBS] = {{0}};
+    struct block_err err = {0};
+    tran_type *trans = NULL;
+    int *updCols = NULL;
+    int flags = 0, receivedrows = 0;
+    int rc, irc, ii;
+
+    Pthread_mutex_lock(&st->tranlk);
+    rc = trans_start(iq, grp->parent, &trans);
+    Pthread_mutex_unlock(&st->tranlk);
+    if (rc) {
+        logmsg(LOGMSG_ERROR, "%s: trans_start failed rc %d\n", __func__, rc);
+        rc = ERR_INTERNAL;
+    }
+
+    for (ii = 0; ii < grp->nops && !rc; ii++) {
+        if (ATOMIC_LOAD32(st->rc))
+            break;
+        if (bdb_lock_desired(thedb->bdb_env)) {
+            err.errcode = ERR_NOMASTER;
+            rc = ERR_NOMASTER;
+            break;
+        }
+        rc = grp->func(iq, grp->rqid, grp->uuid, trans, &grp->data[ii],
+                       grp->datalen[ii], &flags, &updCols, blobs,
+                       grp->step + ii, &err, &receivedrows, NULL);
+        free(grp->data[ii]);
+        grp->data[ii] = NULL;
+    }
+
+    free_blob_buffers(blobs, MAXBLOBS);
+    free(updCols);
+
+    if (trans) {
+        Pthread_mutex_lock(&st->tranlk);
+        if (rc || ATOMIC_LOAD32(st->rc))
+            irc = trans_abort(iq, trans);
+        else
+            irc = trans_commit(iq, trans, gbl_mynode);
+        Pthread_mutex_unlock(&st->tranlk);
+        if (irc && !rc) {
+            logmsg(LOGMSG_ERROR, "%s: child commit failed rc %d\n", __func__,
+                   irc);
+            rc = ERR_INTERNAL;
+        }
+    }
+
+    Pthread_mutex_lock(&st->mtx);
+    st->receivedrows += receivedrows;
+    st->txnsize += iq->txnsize;
+    st->written_row_count += iq->written_row_count;
+    st->cost += iq->cost;
+    if (rc && !st->rc) {
+        st->err = err;
+        st->errstat = iq->errstat;
+        st->rc = rc;
+    }
+    st->running--;
+    Pthread_cond_signal(&st->cond);
+    Pthread_mutex_unlock(&st->mtx);
+
+    apply_group_free(grp);
+}
+
+static void apply_group_run_pp(struct thdpool *pool, void *work, void *thddata,
+                               int op)
+{
+    apply_group_t *grp = work;
+    switch (op) {
+    case THD_RUN:
+        apply_group_run(grp);
+        break;
+    case THD_FREE:
+        /* dequeued without running: report it as a lost group */
+        Pthread_mutex_lock(&grp->st->mtx);
+        if (!grp->st->rc)
+            grp->st->rc = ERR_INTERNAL;
+        grp->st->running--;
+        Pthread_cond_signal(&grp->st->cond);
+        Pthread_mutex_unlock(&grp->st->mtx);
+        apply_group_free(grp);
+        break;
+    }
+}
+
+static apply_group_t *apply_group_new(struct ireq *iq, apply_state_t *st,
+                                      void *parent, apply_func_t func,
+                                      unsigned long long rqid, uuid_t uuid,
+                                      int step)
+{
+    apply_group_t *grp = calloc(1, sizeof(apply_group_t));
+    if (!grp)
+        return NULL;
+    grp->st = st;
+
+    /* only what the replay reads; nothing the parent owns (logger, blkstate,
+     * javasp state, schema change, genid tracking) is shared with the worker */
+    struct ireq *wiq = &grp->iq;
+    init_fake_ireq(thedb, wiq);
+    wiq->is_fake = iq->is_fake;
+    wiq->frommach = iq->frommach;
+    wiq->where = "osql_apply_group";
+    wiq->nowus = iq->nowus;
+    wiq->startus = iq->startus;
+    wiq->__limits = iq->__limits;
+    wiq->origdb = iq->origdb;
+    wiq->rqid = iq->rqid;
+    wiq->opcode = iq->opcode;
+    wiq->osql_rowlocks_enable = iq->osql_rowlocks_enable;
+    wiq->osql_genid48_enable = iq->osql_genid48_enable;
+    strcpy(wiq->corigin, iq->corigin);
+    strcpy(wiq->tzname, iq->tzname);
+    wiq->snap_info = iq->snap_info;
+    wiq->have_snap_info = iq->have_snap_info;
+    wiq->sorese.rqid = iq->sorese.rqid;
+    comdb2uuidcpy(wiq->sorese.uuid, iq->sorese.uuid);
+    wiq->sorese.host = iq->sorese.host;
+    wiq->sorese.type = iq->sorese.type;
+    wiq->is_sorese = iq->is_sorese;
+    wiq->client_endian = iq->client_endian;
+    wiq->have_client_endian = iq->have_client_endian;
+    wiq->is_block2positionmode = iq->is_block2positionmode;
+    wiq->timeoutms = iq->timeoutms;
+    wiq->transflags = iq->transflags;
+    wiq->queryid = iq->queryid;
+    wiq->osql_flags = iq->osql_flags;
+    wiq->priority = iq->priority;
+    /* the limits are checked again on the sums in apply_wait */
+    wiq->written_row_count = 0;
+    wiq->cost = 0;
+    /* a logger of its own; it gathers nothing, errors go back in st */
+    wiq->reqlogger = reqlog_alloc();
+    if (!wiq->reqlogger) {
+        free(grp);
+        return NULL;
+    }
+
+    grp->parent = parent;
+    grp->func = func;
+    grp->rqid = rqid;
+    comdb2uuidcpy(grp->uuid, uuid);
+    grp->step = step;
+    return grp;
+}
+
+static int apply_group_add(apply_group_t *grp, char *data, int datalen)
+{
+    if (grp->nops == grp->alloc) {
+        int alloc = grp->alloc ? grp->alloc * 2 : 64;
+        char **d = realloc(grp->data, alloc * sizeof(char *));
+        if (!d)
+            return ERR_INTERNAL;
+        grp->data = d;
+        int *l = realloc(grp->datalen, alloc * sizeof(int));
+        if (!l)
+            return ERR_INTERNAL;
+        grp->datalen = l;
+        grp->alloc = alloc;
+    }
+    grp->data[grp->nops] = data;
+    grp->datalen[grp->nops] = datalen;
+    grp->nops++;
+    return 0;
+}
+
+/* hand a table's ops to the pool, waiting for a free slot first */
+static void apply_group_dispatch(apply_group_t *grp)
+{
+    apply_state_t *st = grp->st;
+
+    Pthread_mutex_lock(&st->mtx);
+    while (st->running >= gbl_osql_apply_parallel)
+        Pthread_cond_wait(&st->cond, &st->mtx);
+    st->running++;
+    Pthread_mutex_unlock(&st->mtx);
+
+    if (thdpool_enqueue(gbl_osql_apply_thdpool, apply_group_run_pp, grp, 0,
+                        NULL, THDPOOL_FORCE_DISPATCH) != 0) {
+        /* pool is busy: replay it here, still under its own child */
+        apply_group_run(grp);
+    }
+}
+
+/* wait for all dispatched tables; returns the first failure */
+static int apply_wait(apply_state_t *st, struct ireq *iq,
+                      struct block_err *err, int *receivedrows)
+{
+    int rc;
+
+    Pthread_mutex_lock(&st->mtx);
+    while (st->running > 0)
+        Pthread_cond_wait(&st->cond, &st->mtx);
+    rc = st->rc;
+    *receivedrows += st->receivedrows;
+    st->receivedrows = 0;
+    iq->txnsize += st->txnsize;
+    st->txnsize = 0;
+    iq->written_row_count += st->written_row_count;
+    st->written_row_count = 0;
+    iq->cost += st->cost;
+    st->cost = 0;
+    if (rc) {
+        *err = st->err;
+        iq->errstat = st->errstat;
+    }
+    Pthread_mutex_unlock(&st->mtx);
+
+    /* each worker only saw its own share of the rows */
+    if (!rc && gbl_max_wr_rows_per_txn &&
+        iq->written_row_count > gbl_max_wr_rows_per_txn) {
+        reqerrstr(iq, COMDB2_CSTRT_RC_TRN_TOO_BIG,
+                  "Transaction exceeds max rows");
+        rc = ERR_TRAN_TOO_BIG;
+    } else if (!rc && iq->__limits.maxcost &&
+               iq->cost > iq->__limits.maxcost) {
+        rc = ERR_LIMIT;
+    }
+    if (rc && !st->rc) {
+        err->blockop_num = 0;
+        err->errcode = rc;
+        err->ixnum = -1;
+    }
+
+    return rc;
+}
+
 static int process_this_session(
     struct ireq *iq, void *iq_tran, osql_sess_t *sess, int *bdberr, int *nops,
     struct block_err *err, SBUF2 *logsb, struct temp_cursor *dbc,
-    struct temp_cursor *dbc_ins,
+    struct temp_cursor *dbc_ins, int parallel,
     int (*func)(struct ireq *, unsigned long long, uuid_t, void *, char **, int,
                 int *, int **, blob_buffer_t blobs[MAXBLOBS], int,
                 struct block_err *, int *, SBUF2 *))
@@ -1391,6 +1939,16 @@ static int process_this_session(
     if (rc)
         return rc;
 
+    apply_state_t st = {0};
+    apply_group_t *grp = NULL;
+    int grp_tbl = -1;
+    if (parallel) {
+        pthread_once(&osql_apply_once, osql_apply_thdpool_init);
+        Pthread_mutex_init(&st.mtx, NULL);
+        Pthread_cond_init(&st.cond, NULL);
+        Pthread_mutex_init(&st.tranlk, NULL);
+    }
+
     while (!rc && !rc_out) {
         char *data = NULL;
         int datalen = 0;
@@ -1403,11 +1961,48 @@ static int process_this_session(
         if (bdb_lock_desired(thedb->bdb_env)) {
             logmsg(LOGMSG_ERROR, "%lu %s:%d blocksql session closing early\n",
                    pthread_self(), __FILE__, __LINE__);
+            free(data);
+            if (grp)
+                apply_group_dispatch(grp);
+            if (parallel)
+                apply_wait(&st, iq, err, &receivedrows);
             err->blockop_num = 0;
             err->errcode = ERR_NOMASTER;
             err->ixnum = 0;
             reqlog_set_error(iq->reqlogger, "ERR_NOMASTER", ERR_NOMASTER);
-            return ERR_NOMASTER /*OSQL_FAILDISPATCH*/;
+            rc_out = ERR_NOMASTER /*OSQL_FAILDISPATCH*/;
+            goto done;
+        }
+
+        if (parallel) {
+            int tbl = drain_adds ? opkey_ins->tbl_idx : opkey->tbl_idx;
+            if (tbl != grp_tbl) {
+                if (grp)
+                    apply_group_dispatch(grp);
+                grp = NULL;
+                grp_tbl = tbl;
+                if (apply_table_parallel_ok(tbl))
+                    grp = apply_group_new(iq, &st, iq_tran, func, rqid, uuid,
+                                          step);
+            }
+            if (grp) {
+                if ((rc_out = apply_group_add(grp, data, datalen)) != 0) {
+                    free(data);
+                    apply_group_free(grp);
+                    grp = NULL;
+                    break;
+                }
+                step++;
+                rc = get_next_merge_tmps(dbc, dbc_ins, &opkey, &opkey_ins,
+                                         &drain_adds, bdberr, add_stripe);
+                continue;
+            }
+            /* serial op: nothing may run under iq_tran's children */
+            if ((rc_out = apply_wait(&st, iq, err, &receivedrows)) != 0) {
+                free(data);
+                reqlog_set_error(iq->reqlogger, "Error processing", rc_out);
+                break;
+            }
         }
 
         lastrcv = receivedrows;
@@ -1453,6 +2048,180 @@ static int process_this_session(
         /* fall-through */
     }
 
+    if (parallel) {
+        int prc;
+        if (grp)
+            apply_group_dispatch(grp);
+        prc = apply_wait(&st, iq, err, &receivedrows);
+        if (prc && (rc_out == 0 || rc_out == OSQL_RC_DONE)) {
+            reqlog_set_error(iq->reqlogger, "Error processing", prc);
+            rc_out = prc;
+        }
+    }
+
+    if (rc_out == OSQL_RC_DONE) {
+        *nops += receivedrows;
+        rc_out = 0;
+    }
+
+done:
+    if (parallel) {
+        Pthread_mutex_destroy(&st.mtx);
+        Pthread_cond_destroy(&st.cond);
+        Pthread_mutex_destroy(&st.tranlk);
+    }
+
+    return rc_out;
+}
+
+/* Wait for op `step' of a streaming session; expects store_mtx held.
+ * Returns 0 once it is in, 1 if the session ended without it, or an error */
+static int stream_wait_op(blocksql_tran_t *tran, int step,
+                          struct block_err *err)
+{
+    struct errstat *xerr;
+    int rc;
+
+    while (step >= tran->rows) {
+        if (osql_sess_test_complete(tran->sess, &xerr) != SESS_PENDING)
+            return 1;
+
+        if (bdb_lock_desired(thedb->bdb_env)) {
+            logmsg(LOGMSG_ERROR, "%lu %s:%d blocksql session closing early\n",
+                   pthread_self(), __FILE__, __LINE__);
+            err->blockop_num = 0;
+            err->errcode = ERR_NOMASTER;
+            err->ixnum = 0;
+            return ERR_NOMASTER;
+        }
+
+        Pthread_mutex_unlock(&tran->store_mtx);
+        rc = osql_sess_test_slow(tran->sess);
+        Pthread_mutex_lock(&tran->store_mtx);
+        if (rc)
+            return rc;
+
+        stream_timedwait(tran, STREAM_POLL_MS);
+    }
+    return 0;
+}
+
+/* Like process_this_session, for a session that is still streaming: the ops
+ * are taken in the order they came in, as they come in, and store_mtx is let
+ * go while each is applied so that the saver can keep adding them.  Stops at
+ * the DONE op, or when the session ends without one; how it ended is for
+ * osql_bplog_finish_sql to say. */
+static int process_streamed_session(struct ireq *iq, void *iq_tran,
+                                    blocksql_tran_t *tran, int *bdberr,
+                                    int *nops, struct block_err *err,
+                                    SBUF2 *logsb, struct temp_cursor *dbc,
+                                    apply_func_t func)
+{
+    osql_sess_t *sess = tran->sess;
+    unsigned long long rqid = osql_sess_getrqid(sess);
+    blob_buffer_t blobs[MAXBLOBS] = {{0}};
+    oplog_key_t key = {0};
+    int *updCols = NULL;
+    int countops = 0;
+    int lastrcv = 0;
+    int receivedrows = 0;
+    int flags = 0;
+    int rc = 0, rc_out = 0;
+    uuid_t uuid;
+
+    iq->queryid = osql_sess_queryid(sess);
+    osql_sess_getuuid(sess, uuid);
+
+    if (rqid != OSQL_RQID_USE_UUID)
+        reqlog_set_rqid(iq->reqlogger, &rqid, sizeof(unsigned long long));
+    else
+        reqlog_set_rqid(iq->reqlogger, uuid, sizeof(uuid));
+    reqlog_set_event(iq->reqlogger, "txn");
+
+    for (int step = 0;; step++) {
+        char *data = NULL;
+        int datalen = 0;
+
+        if ((rc = stream_wait_op(tran, step, err)) != 0) {
+            if (rc != 1) {
+                reqlog_set_error(iq->reqlogger, "Error processing", rc);
+                rc_out = rc;
+            }
+            break;
+        }
+
+        if (tran->stream_ddl) {
+            errstat_set_rcstrf(&iq->errstat, ERR_BADREQ,
+                               "schema change in a transaction already "
+                               "being applied");
+            reqlog_set_error(iq->reqlogger, "ERR_BADREQ", ERR_BADREQ);
+            rc_out = ERR_BADREQ;
+            break;
+        }
+
+        key.seq = step;
+        rc = bdb_temp_table_find(thedb->bdb_env, dbc, &key, sizeof(key), NULL,
+                                 bdberr);
+        if (rc != IX_FND ||
+            ((oplog_key_t *)bdb_temp_table_key(dbc))->seq != step) {
+            reqlog_set_error(iq->reqlogger, "Internal Error", rc);
+            logmsg(LOGMSG_ERROR, "%s: op %d not in the bplog rc=%d bdberr=%d\n",
+                   __func__, step, rc, *bdberr);
+            rc_out = ERR_INTERNAL;
+            break;
+        }
+        get_tmptbl_data_and_len(dbc, NULL, false, &data, &datalen);
+        /* Reset temp cursor data - it will be freed after the callback. */
+        bdb_temp_table_reset_datapointers(dbc);
+
+        if (step >= tran->applied) {
+            tran->applied = step + 1;
+            if (tran->stream_waiting)
+                Pthread_cond_broadcast(&tran->stream_cond);
+        }
+        Pthread_mutex_unlock(&tran->store_mtx);
+
+        if (bdb_lock_desired(thedb->bdb_env)) {
+            logmsg(LOGMSG_ERROR, "%lu %s:%d blocksql session closing early\n",
+                   pthread_self(), __FILE__, __LINE__);
+            free(data);
+            Pthread_mutex_lock(&tran->store_mtx);
+            err->blockop_num = 0;
+            err->errcode = ERR_NOMASTER;
+            err->ixnum = 0;
+            reqlog_set_error(iq->reqlogger, "ERR_NOMASTER", ERR_NOMASTER);
+            rc_out = ERR_NOMASTER;
+            break;
+        }
+
+        lastrcv = receivedrows;
+
+        /* this locks pages */
+        rc_out = func(iq, rqid, uuid, iq_tran, &data, datalen, &flags, &updCols,
+                      blobs, step, err, &receivedrows, logsb);
+        free(data);
+
+        Pthread_mutex_lock(&tran->store_mtx);
+
+        if (rc_out != 0 && rc_out != OSQL_RC_DONE) {
+            reqlog_set_error(iq->reqlogger, "Error processing", rc_out);
+            /* error processing, can be a verify error or deadlock */
+            break;
+        }
+
+        if (lastrcv != receivedrows && is_rowlocks_transaction(iq_tran)) {
+            rowlocks_check_commit_physical(thedb->bdb_env, iq_tran, ++countops);
+        }
+
+        if (rc_out == OSQL_RC_DONE)
+            break;
+    }
+
+    free_blob_buffers(blobs, MAXBLOBS);
+
+    if (updCols)
+        free(updCols);
+
     if (rc_out == OSQL_RC_DONE) {
         *nops += receivedrows;
         rc_out = 0;
@@ -1461,6 +2230,23 @@ static int process_this_session(
     return rc_out;
 }
 
+/* After a streamed session was applied, wait for it to end and check how it
+ * did, as osql_bplog_finish_sql does for one that came in whole; expects
+ * store_mtx held */
+static int stream_finish(struct ireq *iq, blocksql_tran_t *tran,
+                         struct block_err *err)
+{
+    /* no op is that far off; this returns when the session is over */
+    int rc = stream_wait_op(tran, INT_MAX, err);
+    if (rc != 1)
+        return rc;
+
+    Pthread_mutex_unlock(&tran->store_mtx);
+    rc = osql_bplog_finish_sql(iq, err);
+    Pthread_mutex_lock(&tran->store_mtx);
+    return rc;
+}
+
 /**
  * Log the strings for each completed blocksql request for the
  * reqlog
@@ -1531,8 +2317,14 @@ static int apply_changes(struct ireq *iq, blocksql_tran_t *tran, void *iq_tran,
 
     /* go through the complete list and apply all the changes */
     if (tran->iscomplete) {
-        out_rc = process_this_session(iq, iq_tran, tran->sess, &bdberr, nops,
-                                      err, logsb, dbc, dbc_ins, func);
+        out_rc = process_this_session(
+            iq, iq_tran, tran->sess, &bdberr, nops, err, logsb, dbc, dbc_ins,
+            apply_parallel_ok(iq, tran, iq_tran, logsb), func);
+    } else if (tran->sess->streaming) {
+        out_rc = process_streamed_session(iq, iq_tran, tran, &bdberr, nops, err,
+                                          logsb, dbc, func);
+        if (out_rc == 0)
+            out_rc = stream_finish(iq, tran, err);
     }
 
     Pthread_mutex_unlock(&tran->store_mtx);
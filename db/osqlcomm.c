@@ -50,6 +50,7 @@
 #include "sc_struct.h"
 #include <compat.h>
 #include <unistd.h>
+#include "comdb2_atomic.h"
 
 #define BLKOUT_DEFAULT_DELTA 5
 #define MAX_CLUSTER 16
@@ -5945,6 +5946,351 @@ out:
     return rc;
 }
 
+/* Batched osql stream.  Ops a sql thread ships to a remote master without
+ * nodelay are packed into one OSQL_BATCH message per session, which is sent
+ * once it reaches osql_batch_bytes, once its oldest op is osql_batch_ms old,
+ * or right before the next message that isn't batched (eg. the commit).
+ * Batches that sit while their sql thread is busy elsewhere are sent by the
+ * flusher thread once they are osql_batch_ms old.
+ * The master unpacks it in osql_sess_rcvop().  Layout, after the usual
+ * osql_rpl_t/osql_uuid_rpl_t header: int nops, then nops x (int len, op). */
+int gbl_osql_batch_bytes = 0; /* 0 disables batching */
+int gbl_osql_batch_ms = 10;
+
+typedef struct osql_batch {
+    pthread_mutex_t lk; /* its sql thread and the flusher */
+    const char *host;
+    int usertype;
+    unsigned long long rqid;
+    uuid_t uuid;
+    int nops;
+    int rc; /* failed flusher send, returned on the owner's next send */
+    int start_ms;
+    int len;
+    int alloc;
+    uint8_t *buf;
+    LINKC_T(struct osql_batch) lnk;
+} osql_batch_t;
+
+static pthread_key_t osql_batch_key;
+static pthread_once_t osql_batch_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t osql_batch_list_lk = PTHREAD_MUTEX_INITIALIZER;
+static LISTC_T(osql_batch_t) osql_batch_list;
+
+/* set while this thread sends a batch, which comes back through
+ * osql_batch_send */
+static __thread int osql_batch_flushing;
+
+static unsigned long long osql_batch_sent;
+static unsigned long long osql_batch_ops;
+
+static int osql_batch_flush(osql_batch_t *batch);
+
+static void osql_batch_free(void *arg)
+{
+    osql_batch_t *batch = arg;
+
+    Pthread_mutex_lock(&osql_batch_list_lk);
+    listc_rfl(&osql_batch_list, batch);
+    Pthread_mutex_unlock(&osql_batch_list_lk);
+
+    Pthread_mutex_destroy(&batch->lk);
+    free(batch->buf);
+    free(batch);
+}
+
+/* Sends the batches that got old while their sql threads were away */
+static void *osql_batch_flusher(void *arg)
+{
+    osql_batch_t *batch;
+    int now;
+
+    thread_started("osql batch flusher");
+
+    while (!db_is_stopped()) {
+        poll(NULL, 0, gbl_osql_batch_ms > 1 ? gbl_osql_batch_ms / 2 : 1);
+        if (gbl_osql_batch_bytes <= 0)
+            continue;
+
+        now = comdb2_time_epochms();
+        Pthread_mutex_lock(&osql_batch_list_lk);
+        LISTC_FOR_EACH(&osql_batch_list, batch, lnk)
+        {
+            /* its owner is adding to it, or sending it */
+            if (pthread_mutex_trylock(&batch->lk) != 0)
+                continue;
+            if (batch->nops && !batch->rc &&
+                now - batch->start_ms >= gbl_osql_batch_ms)
+                batch->rc = osql_batch_flush(batch);
+            Pthread_mutex_unlock(&batch->lk);
+        }
+        Pthread_mutex_unlock(&osql_batch_list_lk);
+    }
+    return NULL;
+}
+
+static void osql_batch_init_key(void)
+{
+    pthread_attr_t attr;
+    pthread_t tid;
+    int rc;
+
+    Pthread_key_create(&osql_batch_key, osql_batch_free);
+    listc_init(&osql_batch_list, offsetof(osql_batch_t, lnk));
+
+    Pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    Pthread_attr_setstacksize(&attr, 100 * 1024);
+    rc = pthread_create(&tid, &attr, osql_batch_flusher, NULL);
+    if (rc)
+        logmsg(LOGMSG_ERROR, "%s: pthread_create error %d %s\n", __func__, rc,
+               strerror(rc));
+    Pthread_attr_destroy(&attr);
+}
+
+static osql_batch_t *osql_batch_get(int create)
+{
+    osql_batch_t *batch;
+
+    pthread_once(&osql_batch_once, osql_batch_init_key);
+    batch = pthread_getspecific(osql_batch_key);
+    if (!batch && create) {
+        batch = calloc(1, sizeof(osql_batch_t));
+        if (batch) {
+            Pthread_mutex_init(&batch->lk, NULL);
+            Pthread_setspecific(osql_batch_key, batch);
+            Pthread_mutex_lock(&osql_batch_list_lk);
+            listc_abl(&osql_batch_list, batch);
+            Pthread_mutex_unlock(&osql_batch_list_lk);
+        }
+    }
+    return batch;
+}
+
+static int osql_nettype_is_batchable(int usertype)
+{
+    switch (usertype) {
+    case NET_OSQL_SOCK_RPL:
+    case NET_OSQL_RECOM_RPL:
+    case NET_OSQL_SNAPISOL_RPL:
+    case NET_OSQL_SERIAL_RPL:
+    case NET_OSQL_SOCK_RPL_UUID:
+    case NET_OSQL_RECOM_RPL_UUID:
+    case NET_OSQL_SNAPISOL_RPL_UUID:
+    case NET_OSQL_SERIAL_RPL_UUID:
+        return 1;
+    }
+    return 0;
+}
+
+static int osql_batch_hdrlen(int usertype)
+{
+    return (osql_nettype_is_uuid(usertype) ? OSQLCOMM_UUID_RPL_TYPE_LEN
+                                           : OSQLCOMM_RPL_TYPE_LEN) +
+           sizeof(int);
+}
+
+/* Ship whatever is in the batch.  The caller holds its lock. */
+static int osql_batch_flush(osql_batch_t *batch)
+{
+    uint8_t *p_buf, *p_buf_end;
+    int rc, nops;
+
+    if (batch->nops == 0)
+        return 0;
+
+    p_buf = batch->buf;
+    p_buf_end = p_buf + osql_batch_hdrlen(batch->usertype);
+    if (osql_nettype_is_uuid(batch->usertype)) {
+        osql_uuid_rpl_t hd = {0};
+        hd.type = OSQL_BATCH;
+        comdb2uuidcpy(hd.uuid, batch->uuid);
+        p_buf = osqlcomm_uuid_rpl_type_put(&hd, p_buf, p_buf_end);
+    } else {
+        osql_rpl_t hd = {0};
+        hd.type = OSQL_BATCH;
+        hd.sid = batch->rqid;
+        p_buf = osqlcomm_rpl_type_put(&hd, p_buf, p_buf_end);
+    }
+    nops = batch->nops;
+    p_buf = buf_put(&nops, sizeof(nops), p_buf, p_buf_end);
+
+    /* offload_net_send comes back through osql_batch_send */
+    batch->nops = 0;
+    osql_batch_flushing = 1;
+    rc = offload_net_send(batch->host, batch->usertype, batch->buf, batch->len,
+                          0);
+    osql_batch_flushing = 0;
+    batch->len = 0;
+    if (rc == 0) {
+        ATOMIC_ADD64(osql_batch_sent, 1);
+        ATOMIC_ADD64(osql_batch_ops, nops);
+    }
+    return rc;
+}
+
+/* Try to add an op to this thread's batch, whose lock the caller holds.
+ * Returns 0 if the op was taken, 1 if the caller has to send it itself, or
+ * the rc of a failed flush. */
+static int osql_batch_add(osql_batch_t *batch, const char *host, int usertype,
+                          void *data, int datalen, int ntails, void **tails,
+                          int *tailens)
+{
+    unsigned long long rqid = 0;
+    uuid_t uuid;
+    int oplen, ii, rc, now;
+    uint8_t *p_buf, *p_buf_end;
+
+    oplen = datalen;
+    for (ii = 0; ii < ntails; ii++)
+        oplen += tailens[ii];
+
+    if (oplen + osql_batch_hdrlen(usertype) + sizeof(int) >
+        gbl_osql_batch_bytes)
+        return 1;
+
+    if (osql_nettype_is_uuid(usertype)) {
+        osql_uuid_rpl_t hd;
+        if (!osqlcomm_uuid_rpl_type_get(&hd, data, (uint8_t *)data + datalen))
+            return 1;
+        comdb2uuidcpy(uuid, hd.uuid);
+    } else {
+        osql_rpl_t hd;
+        if (!osqlcomm_rpl_type_get(&hd, data, (uint8_t *)data + datalen))
+            return 1;
+        rqid = hd.sid;
+        comdb2uuid_clear(uuid);
+    }
+
+    /* a batch only ever holds ops for one session */
+    if (batch->nops &&
+        (batch->host != host || batch->usertype != usertype ||
+         batch->rqid != rqid || comdb2uuidcmp(batch->uuid, uuid) != 0)) {
+        if ((rc = osql_batch_flush(batch)) != 0)
+            return rc;
+    }
+
+    if (batch->alloc < gbl_osql_batch_bytes) {
+        uint8_t *newbuf = realloc(batch->buf, gbl_osql_batch_bytes);
+        if (!newbuf)
+            return 1;
+        batch->buf = newbuf;
+        batch->alloc = gbl_osql_batch_bytes;
+    }
+
+    if (batch->nops &&
+        batch->len + sizeof(int) + oplen > batch->alloc) {
+        if ((rc = osql_batch_flush(batch)) != 0)
+            return rc;
+    }
+
+    now = comdb2_time_epochms();
+    if (batch->nops == 0) {
+        batch->host = host;
+        batch->usertype = usertype;
+        batch->rqid = rqid;
+        comdb2uuidcpy(batch->uuid, uuid);
+        batch->start_ms = now;
+        batch->len = osql_batch_hdrlen(usertype);
+    }
+
+    p_buf = batch->buf + batch->len;
+    p_buf_end = batch->buf + batch->alloc;
+    p_buf = buf_put(&oplen, sizeof(oplen), p_buf, p_buf_end);
+    p_buf = buf_no_net_put(data, datalen, p_buf, p_buf_end);
+    for (ii = 0; ii < ntails; ii++)
+        p_buf = buf_no_net_put(tails[ii], tailens[ii], p_buf, p_buf_end);
+    batch->len = p_buf - batch->buf;
+    batch->nops++;
+
+    if (batch->len >= gbl_osql_batch_bytes ||
+        now - batch->start_ms >= gbl_osql_batch_ms)
+        return osql_batch_flush(batch);
+
+    return 0;
+}
+
+/* Either batch this op (returns 0 or an error rc), or flush the pending
+ * batch so ordering is kept and tell the caller to send it (returns 1). */
+static int osql_batch_send(const char *host, int usertype, void *data,
+                           int datalen, int nodelay, int ntails, void **tails,
+                           int *tailens)
+{
+    osql_batch_t *batch;
+    int batchable, rc = 1;
+
+    if (!host || host == gbl_mynode || osql_batch_flushing)
+        return 1;
+
+    batchable = gbl_osql_batch_bytes > 0 && !nodelay &&
+                osql_nettype_is_batchable(usertype);
+    if (!(batch = osql_batch_get(batchable)))
+        return 1;
+
+    Pthread_mutex_lock(&batch->lk);
+    if (batch->rc) {
+        /* the flusher lost ops of this session */
+        rc = batch->rc;
+        batch->rc = 0;
+    } else if (batchable) {
+        rc = osql_batch_add(batch, host, usertype, data, datalen, ntails,
+                            tails, tailens);
+    }
+    if (rc == 1 && (rc = osql_batch_flush(batch)) == 0)
+        rc = 1;
+    Pthread_mutex_unlock(&batch->lk);
+    return rc;
+}
+
+/* Walk the ops of an OSQL_BATCH message.  Returns a pointer past the op, or
+ * NULL at the end or on a malformed message. */
+const uint8_t *osql_comm_batch_next(const uint8_t *p_buf,
+                                    const uint8_t *p_buf_end, int hasuuid,
+                                    char **op, int *oplen, int *optype)
+{
+    int len;
+
+    if (p_buf >= p_buf_end)
+        return NULL;
+    if (!(p_buf = buf_get(&len, sizeof(len), p_buf, p_buf_end)))
+        return NULL;
+    if (len <= 0 || len > p_buf_end - p_buf)
+        return NULL;
+
+    if (hasuuid) {
+        osql_uuid_rpl_t hd;
+        if (!osqlcomm_uuid_rpl_type_get(&hd, p_buf, p_buf + len))
+            return NULL;
+        *optype = hd.type;
+    } else {
+        osql_rpl_t hd;
+        if (!osqlcomm_rpl_type_get(&hd, p_buf, p_buf + len))
+            return NULL;
+        *optype = hd.type;
+    }
+    *op = (char *)p_buf;
+    *oplen = len;
+    return p_buf + len;
+}
+
+/* First op of an OSQL_BATCH message; sets the op count. */
+const uint8_t *osql_comm_batch_first(const uint8_t *data, int datalen,
+                                     int hasuuid, int *nops)
+{
+    const uint8_t *p_buf = data;
+    const uint8_t *p_buf_end = data + datalen;
+
+    p_buf += hasuuid ? OSQLCOMM_UUID_RPL_TYPE_LEN : OSQLCOMM_RPL_TYPE_LEN;
+    return buf_get(nops, sizeof(*nops), p_buf, p_buf_end);
+}
+
+void osql_comm_batch_stats(unsigned long long *batches,
+                           unsigned long long *ops)
+{
+    *batches = osql_batch_sent;
+    *ops = osql_batch_ops;
+}
+
 /* this wrapper tries to provide a reliable net_send that will prevent loosing
    packets
    due to queue being full */
@@ -5968,6 +6314,13 @@ static int offload_net_send(const char *host, int usertype, void *data,
         return 0;
     }
 
+    if (usertype >= 0) {
+        int brc = osql_batch_send(host, usertype, data, datalen, nodelay, 0,
+                                  NULL, NULL);
+        if (brc != 1)
+            return brc;
+    }
+
     osql_comm_t *comm = get_thecomm();
     if (!comm)
         return -1;
@@ -6067,6 +6420,12 @@ static int offload_net_send_tails(const char *host, int usertype, void *data,
     int unknownerror_retry = 0;
     int rc = -1;
 
+    rc = osql_batch_send(host, usertype, data, datalen, nodelay, ntails, tails,
+                         tailens);
+    if (rc != 1)
+        return rc;
+    rc = -1;
+
     while (rc) {
         if (host == gbl_mynode)
             host = NULL;
@@ -8530,6 +8889,7 @@ int osqlpfthdpool_init(void)
     thdpool_set_maxqueue(gbl_osqlpfault_thdpool, 1000);
     thdpool_set_linger(gbl_osqlpfault_thdpool, 10);
     thdpool_set_longwaitms(gbl_osqlpfault_thdpool, 10000);
+    thdpool_set_work_stealing(gbl_osqlpfault_thdpool, 1);
 
     gbl_osqlpf_step = (osqlpf_step *)calloc(1000, sizeof(osqlpf_step));
     if (gbl_osqlpf_step == NULL)
@@ -84,6 +84,20 @@ int offload_comm_send_blockreply(char *host, unsigned long long rqid, void *buf,
 int osql_comm_is_done(int type, char *rpl, int rpllen, int hasuuid,
                       struct errstat **xerr, struct ireq *);
 
+/**
+ * Walk the ops packed in an OSQL_BATCH message: "first" returns the start
+ * of the first op and sets "nops", "next" returns the op at "p_buf" and a
+ * pointer past it, or NULL if the batch is malformed
+ *
+ */
+const uint8_t *osql_comm_batch_first(const uint8_t *data, int datalen,
+                                     int hasuuid, int *nops);
+const uint8_t *osql_comm_batch_next(const uint8_t *p_buf,
+                                    const uint8_t *p_buf_end, int hasuuid,
+                                    char **op, int *oplen, int *optype);
+void osql_comm_batch_stats(unsigned long long *batches,
+                           unsigned long long *ops);
+
 /**
  * Send a "POKE" message to "tonode" inquering about session "rqid"
  *
@@ -122,6 +122,66 @@ static int free_selectv_genids(void *obj, void *arg)
     return 0;
 }
 
+int gbl_osql_sess_cache = 64; /* closed sessions kept to be used again */
+
+/* A session is created on the thread reading the replicants' sockets and
+   closed by the block processor that ran it, so a closed session goes on one
+   list for all.  It keeps its locks, its emptied queue and its cleared
+   selectv hash; everything else starts over as calloc would have it. */
+static pthread_mutex_t sess_cache_lk = PTHREAD_MUTEX_INITIALIZER;
+static osql_sess_t *sess_cache;
+static int sess_cache_count;
+
+static osql_sess_t *sess_cache_get(void)
+{
+    osql_sess_t *sess;
+
+    Pthread_mutex_lock(&sess_cache_lk);
+    if ((sess = sess_cache) != NULL) {
+        sess_cache = sess->next_cached;
+        sess->next_cached = NULL;
+        sess_cache_count--;
+    }
+    Pthread_mutex_unlock(&sess_cache_lk);
+    return sess;
+}
+
+/* Returns 0 if sess was kept, else it is left as it was */
+static int sess_cache_put(osql_sess_t *sess)
+{
+    pthread_mutex_t mtx, clients_mtx, completed_lock;
+    pthread_cond_t cond;
+    queue_type *que;
+    hash_t *selectv_genids;
+
+    Pthread_mutex_lock(&sess_cache_lk);
+    if (sess_cache_count >= gbl_osql_sess_cache) {
+        Pthread_mutex_unlock(&sess_cache_lk);
+        return -1;
+    }
+
+    /* nobody else can see sess; its locks are put back where they were */
+    mtx = sess->mtx;
+    cond = sess->cond;
+    clients_mtx = sess->clients_mtx;
+    completed_lock = sess->completed_lock;
+    que = sess->que;
+    selectv_genids = sess->selectv_genids;
+    memset(sess, 0, sizeof(*sess));
+    sess->mtx = mtx;
+    sess->cond = cond;
+    sess->clients_mtx = clients_mtx;
+    sess->completed_lock = completed_lock;
+    sess->que = que;
+    sess->selectv_genids = selectv_genids;
+
+    sess->next_cached = sess_cache;
+    sess_cache = sess;
+    sess_cache_count++;
+    Pthread_mutex_unlock(&sess_cache_lk);
+    return 0;
+}
+
 static void _destroy_session(osql_sess_t **prq, int phase)
 {
     osql_sess_t *rq = *prq;
@@ -145,12 +205,16 @@ static void _destroy_session(osql_sess_t **prq, int phase)
                         comdb2uuidstr(rq->uuid, us), cleared);
         }
 
-        queue_free(rq->que);
-        if (rq->selectv_writelock_on_update) {
+        if (rq->selectv_genids) {
             hash_for(rq->selectv_genids, free_selectv_genids, NULL);
             hash_clear(rq->selectv_genids);
-            hash_free(rq->selectv_genids);
         }
+        if (sess_cache_put(rq) == 0)
+            break;
+
+        queue_free(rq->que);
+        if (rq->selectv_genids)
+            hash_free(rq->selectv_genids);
     case 1:
         Pthread_cond_destroy(&rq->cond);
     case 2:
@@ -504,6 +568,27 @@ int osql_sess_unlock_complete(osql_sess_t *sess)
     return 0;
 }
 
+/* save op; if this fails, sess is FREED! */
+static int osql_sess_saveop(osql_sess_t *sess, char *data, int datalen,
+                            unsigned long long rqid, uuid_t uuid, int type)
+{
+    int rc = osql_bplog_saveop(sess, data, datalen, rqid, uuid, type);
+
+    if (!rc) {
+        /* Must increment seq under completed_lock */
+        Pthread_mutex_lock(&sess->completed_lock);
+        if (sess->rqid == rqid || (rqid == OSQL_RQID_USE_UUID &&
+                                   comdb2uuidcmp(sess->uuid, uuid) == 0)) {
+            sess->seq++;
+            sess->last_row = time(NULL);
+        }
+
+        Pthread_mutex_unlock(&sess->completed_lock);
+    }
+
+    return rc;
+}
+
 /**
  * Handles a new op received for session "rqid"
  * It saves the packet in the local bplog
@@ -541,6 +626,7 @@ int osql_sess_rcvop(unsigned long long rqid, uuid_t uuid, int type, void *data,
     }
 
     if (is_msg_done && perr && htonl(perr->errval) == SQLITE_ABORT &&
+        !sess->streaming &&
         !bdb_attr_get(thedb->bdb_attr, BDB_ATTR_DISABLE_SELECTVONLY_TRAN_NOP)) {
         /* release the session */
         if ((rc = osql_repository_put(sess, is_msg_done)) != 0) {
@@ -563,8 +649,10 @@ int osql_sess_rcvop(unsigned long long rqid, uuid_t uuid, int type, void *data,
     *found = 1;
 
     Pthread_mutex_lock(&sess->completed_lock);
-    /* ignore new coming osql packages */
-    if (sess->completed || sess->dispatched || sess->terminate) {
+    /* ignore new coming osql packages; a streaming session was dispatched
+       before they were all in */
+    if (sess->completed || (sess->dispatched && !sess->streaming) ||
+        sess->terminate) {
         uuidstr_t us;
         Pthread_mutex_unlock(&sess->completed_lock);
         if ((rc = osql_repository_put(sess, is_msg_done)) != 0) {
@@ -580,20 +668,26 @@ int osql_sess_rcvop(unsigned long long rqid, uuid_t uuid, int type, void *data,
     }
     Pthread_mutex_unlock(&sess->completed_lock);
 
-    /* save op */
-    int rc_out = osql_bplog_saveop(sess, data, datalen, rqid, uuid, type);
-
-    /* if rc_out, sess is FREED! */
-    if (!rc_out) {
-        /* Must increment seq under completed_lock */
-        Pthread_mutex_lock(&sess->completed_lock);
-        if (sess->rqid == rqid || (rqid == OSQL_RQID_USE_UUID &&
-                                   comdb2uuidcmp(sess->uuid, uuid) == 0)) {
-            sess->seq++;
-            sess->last_row = time(NULL);
+    int rc_out = 0;
+    if (type == OSQL_BATCH) {
+        /* several ops packed by the replicant, save them one at a time */
+        int hasuuid = (rqid == OSQL_RQID_USE_UUID);
+        int nops = 0, oplen, optype;
+        char *op;
+        const uint8_t *p_buf, *p_buf_end = (uint8_t *)data + datalen;
+
+        p_buf = osql_comm_batch_first(data, datalen, hasuuid, &nops);
+        while (!rc_out && nops-- > 0) {
+            p_buf = osql_comm_batch_next(p_buf, p_buf_end, hasuuid, &op,
+                                         &oplen, &optype);
+            if (!p_buf) {
+                logmsg(LOGMSG_ERROR, "%s: malformed osql batch\n", __func__);
+                break;
+            }
+            rc_out = osql_sess_saveop(sess, op, oplen, rqid, uuid, optype);
         }
-
-        Pthread_mutex_unlock(&sess->completed_lock);
+    } else {
+        rc_out = osql_sess_saveop(sess, data, datalen, rqid, uuid, type);
     }
 
     /* release the session */
@@ -764,12 +858,27 @@ osql_sess_t *osql_sess_create_sock(const char *sql, int sqlen, char *tzname,
            comdb2uuidstr(uuid, us));
 #endif
 
-    /* alloc object */
-    sess = (osql_sess_t *)calloc(sizeof(*sess), 1);
-    if (!sess) {
-        logmsg(LOGMSG_ERROR, "%s:unable to allocate %zu bytes\n", __func__,
-               sizeof(*sess));
-        return NULL;
+    /* alloc object, unless a closed one is there to take */
+    if ((sess = sess_cache_get()) == NULL) {
+        sess = (osql_sess_t *)calloc(sizeof(*sess), 1);
+        if (!sess) {
+            logmsg(LOGMSG_ERROR, "%s:unable to allocate %zu bytes\n", __func__,
+                   sizeof(*sess));
+            return NULL;
+        }
+
+        /* init sync fields */
+        Pthread_mutex_init(&sess->clients_mtx, NULL);
+        Pthread_mutex_init(&sess->completed_lock, NULL);
+        Pthread_mutex_init(&sess->mtx, NULL);
+        Pthread_cond_init(&sess->cond, NULL);
+
+        /* init queue of messages */
+        sess->que = queue_new();
+        if (!sess->que) {
+            _destroy_session(&sess, 1);
+            return NULL;
+        }
     }
 #if DEBUG_REORDER
     uuidstr_t us;
@@ -778,19 +887,6 @@ osql_sess_t *osql_sess_create_sock(const char *sql, int sqlen, char *tzname,
            sql, sess, us);
 #endif
 
-    /* init sync fields */
-    Pthread_mutex_init(&sess->clients_mtx, NULL);
-    Pthread_mutex_init(&sess->completed_lock, NULL);
-    Pthread_mutex_init(&sess->mtx, NULL);
-    Pthread_cond_init(&sess->cond, NULL);
-
-    /* init queue of messages */
-    sess->que = queue_new();
-    if (!sess->que) {
-        _destroy_session(&sess, 1);
-        return NULL;
-    }
-
     sess->rqid = rqid;
     comdb2uuidcpy(sess->uuid, uuid);
     sess->req = NULL;
@@ -801,7 +897,7 @@ osql_sess_t *osql_sess_create_sock(const char *sql, int sqlen, char *tzname,
     sess->start = sess->initstart = time(NULL);
     sess->is_reorder_on = is_reorder_on;
     sess->selectv_writelock_on_update = gbl_selectv_writelock_on_update;
-    if (sess->selectv_writelock_on_update)
+    if (sess->selectv_writelock_on_update && !sess->selectv_genids)
         sess->selectv_genids =
             hash_init(offsetof(selectv_genid_t, get_writelock));
     if (tzname)
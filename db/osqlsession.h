@@ -56,6 +56,8 @@ struct osql_sess {
     int terminate; /* gets set if anything goes wrong w/ the session and we need
                       to abort */
     int dispatched; /* Set when session is dispatched to handle_buf */
+    int streaming;  /* Set when dispatched before it completed, for its ops to
+                       be applied as they come in */
 
     enum OSQL_REQ_TYPE type; /* session version */
 
@@ -103,6 +105,7 @@ struct osql_sess {
     hash_t *selectv_genids;
     char *table; // intern'd usedb
     int tableversion;
+    struct osql_sess *next_cached;
 };
 
 enum {
@@ -36,6 +36,10 @@ extern int g_osql_max_trans;
 extern int gbl_partial_indexes;
 extern int gbl_expressions_indexes;
 
+int gbl_osql_single_row_fastpath = 1;
+int gbl_osql_local_noshadow = 0;
+int gbl_osql_shadtbl_cache = 16; /* emptied tables each thread keeps */
+
 typedef struct blob_key {
     unsigned long long seq; /* tbl->seq identifying the owning row */
     unsigned long long id;  /* blob index in the row */
@@ -97,6 +101,8 @@ static int process_local_shadtbl_sc(struct sqlclntstate *clnt, int *bdberr);
 static int process_local_shadtbl_bpfunc(struct sqlclntstate *clnt, int *bdberr);
 static int process_local_shadtbl_dbq(struct sqlclntstate *, int *bdberr,
                                      int *crt_nops);
+static int process_local_shadtbl_shadrow(struct sqlclntstate *clnt,
+                                         int *crt_nops);
 
 static int insert_record_indexes(BtCursor *pCur, struct sql_thread *thd,
                                  int64_t nKey, int *bdberr);
@@ -524,6 +530,79 @@ static shad_tbl_t *create_shadtbl(struct BtCursor *pCur,
     return tbl;
 }
 
+/* A transaction's shadow tables are emptied and kept by the thread that
+   closes them, rather than closed, for the next transaction on that thread
+   to take; they go with the thread when it exits. */
+struct shadtbl_cache {
+    int count;
+    struct tmp_table *top;
+};
+
+static pthread_once_t shadtbl_cache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t shadtbl_cache_key;
+
+static void shadtbl_cache_free(void *p)
+{
+    struct shadtbl_cache *c = p;
+    struct tmp_table *tbl;
+    int bdberr = 0;
+
+    while ((tbl = c->top) != NULL) {
+        c->top = tbl->next_cached;
+        bdb_temp_table_close(thedb->bdb_env, tbl->table, &bdberr);
+        free(tbl);
+    }
+    free(c);
+}
+
+static void shadtbl_cache_init_key(void)
+{
+    Pthread_key_create(&shadtbl_cache_key, shadtbl_cache_free);
+}
+
+static struct shadtbl_cache *shadtbl_cache(void)
+{
+    struct shadtbl_cache *c;
+
+    pthread_once(&shadtbl_cache_once, shadtbl_cache_init_key);
+    if ((c = pthread_getspecific(shadtbl_cache_key)) == NULL &&
+        (c = calloc(1, sizeof(*c))) != NULL)
+        Pthread_setspecific(shadtbl_cache_key, c);
+    return c;
+}
+
+static struct tmp_table *shadtbl_cache_get(void)
+{
+    struct shadtbl_cache *c = shadtbl_cache();
+    struct tmp_table *tbl;
+
+    if (c == NULL || (tbl = c->top) == NULL)
+        return NULL;
+    c->top = tbl->next_cached;
+    c->count--;
+    tbl->next_cached = NULL;
+    /* back to the default compare; the callers that want theirs set it */
+    bdb_temp_table_set_cmp_func(tbl->table, NULL);
+    return tbl;
+}
+
+/* Returns 0 if tbl was kept, else it is left for the caller to close */
+static int shadtbl_cache_put(bdb_state_type *bdb_env, struct tmp_table *tbl,
+                             int *bdberr)
+{
+    struct shadtbl_cache *c;
+
+    if (gbl_osql_shadtbl_cache <= 0 || (c = shadtbl_cache()) == NULL ||
+        c->count >= gbl_osql_shadtbl_cache)
+        return -1;
+    if (bdb_temp_table_reset(bdb_env, tbl->table, bdberr) != 0)
+        return -1;
+    tbl->next_cached = c->top;
+    c->top = tbl;
+    c->count++;
+    return 0;
+}
+
 static int destroy_tablecursor(bdb_state_type *bdb_env, struct temp_cursor *cur,
                                struct tmp_table *tbl, int *bdberr)
 {
@@ -537,7 +616,7 @@ static int destroy_tablecursor(bdb_state_type *bdb_env, struct temp_cursor *cur,
                    __func__, rc, *bdberr);
     }
 
-    if (tbl) {
+    if (tbl && shadtbl_cache_put(bdb_env, tbl, bdberr) != 0) {
         rc = bdb_temp_table_close(bdb_env, tbl->table, bdberr);
         if (rc)
             logmsg(LOGMSG_ERROR, "%s: fail to close tbl rc=%d bdberr=%d\n",
@@ -713,22 +792,24 @@ static int create_tablecursor(bdb_state_type *bdb_env, struct tmp_table **ptbl,
                               int skip_cursor)
 {
 
-    struct tmp_table *tbl =
-        (struct tmp_table *)calloc(1, sizeof(struct tmp_table));
+    struct tmp_table *tbl = shadtbl_cache_get();
 
     if (!tbl) {
-        logmsg(LOGMSG_ERROR, "%s: unable to allocate %zu bytes\n", __func__,
-               sizeof(struct tmp_table));
-        return -1;
-    }
+        tbl = (struct tmp_table *)calloc(1, sizeof(struct tmp_table));
+        if (!tbl) {
+            logmsg(LOGMSG_ERROR, "%s: unable to allocate %zu bytes\n",
+                   __func__, sizeof(struct tmp_table));
+            return -1;
+        }
 
-    tbl->table = bdb_temp_array_create(bdb_env, bdberr);
+        tbl->table = bdb_temp_array_create(bdb_env, bdberr);
 
-    if (!tbl->table) {
-        logmsg(LOGMSG_ERROR, "%s: bdb_temp_table_create failed, bderr=%d\n",
-                __func__, *bdberr);
-        free(tbl);
-        return -1;
+        if (!tbl->table) {
+            logmsg(LOGMSG_ERROR, "%s: bdb_temp_table_create failed, bderr=%d\n",
+                   __func__, *bdberr);
+            free(tbl);
+            return -1;
+        }
     }
     if (skip_cursor) {
         *pcur = NULL;
@@ -1278,6 +1359,67 @@ int osql_save_dbq_consume(struct sqlclntstate *clnt, const char *spname,
     return 0;
 }
 
+int osql_save_shadrow(struct BtCursor *pCur, struct sql_thread *thd,
+                      int isupd, char *pData, int nData, int *updCols,
+                      int flags)
+{
+    struct sqlclntstate *clnt = thd->clnt;
+    shadrow_t *shad = &clnt->osql.shadrow;
+    struct dbtable *db = pCur->db;
+    int ncols = (updCols) ? updCols[0] + 1 : 0;
+
+    if (!gbl_osql_single_row_fastpath ||
+        clnt->dbtran.mode != TRANLEVEL_SOSQL || clnt->dbtran.dtran ||
+        clnt->ctrl_sqlengine != SQLENG_NORMAL_PROCESS)
+        return 0;
+
+    /* only the statement's first row, and only if the shadow tables
+       would just be holding the record */
+    if (shad->tablename || !osql_shadtbl_empty(clnt))
+        return 0;
+    if (db->numblobs || (gbl_expressions_indexes && db->ix_expr) ||
+        (gbl_partial_indexes && db->ix_partial))
+        return 0;
+    if (isupd && is_genid_synthetic(pCur->genid))
+        return 0;
+
+    shad->tablename = strdup(db->tablename);
+    shad->data = malloc(nData);
+    if (ncols)
+        shad->updcols = malloc(ncols * sizeof(int));
+    if (!shad->tablename || !shad->data || (ncols && !shad->updcols)) {
+        free(shad->tablename);
+        free(shad->data);
+        free(shad->updcols);
+        memset(shad, 0, sizeof(*shad));
+        return 0;
+    }
+    memcpy(shad->data, pData, nData);
+    if (ncols)
+        memcpy(shad->updcols, updCols, ncols * sizeof(int));
+    shad->datalen = nData;
+    shad->tableversion = db->tableversion;
+    shad->isupd = isupd;
+    shad->genid = pCur->genid;
+    shad->flags = flags;
+
+    clnt->osql.dirty = 1;
+
+    return 1;
+}
+
+int osql_skip_shadtbl(struct sqlclntstate *clnt)
+{
+    osqlstate_t *osql = &clnt->osql;
+
+    if (!gbl_osql_local_noshadow || clnt->dbtran.mode != TRANLEVEL_SOSQL ||
+        clnt->dbtran.dtran || osql->host != gbl_mynode)
+        return 0;
+
+    osql->noshadow = 1;
+    return 1;
+}
+
 int osql_save_updcols(struct BtCursor *pCur, struct sql_thread *thd,
                       int *updCols)
 {
@@ -1518,6 +1660,13 @@ int osql_shadtbl_process(struct sqlclntstate *clnt, int *nops, int *bdberr,
     if (rc)
         return -1;
 
+    /* the statement's first row, if it was kept out of the shadow tables */
+    rc = process_local_shadtbl_shadrow(clnt, nops);
+    if (rc == SQLITE_TOOBIG)
+        return rc;
+    if (rc)
+        return -1;
+
     LISTC_FOR_EACH(&osql->shadtbls, tbl, linkv)
     {
         /* we need to reset any cached nops in tbl */
@@ -2195,6 +2344,65 @@ static int process_local_shadtbl_dbq(struct sqlclntstate *clnt, int *bdberr,
     return SQLITE_OK;
 }
 
+static int process_local_shadtbl_shadrow(struct sqlclntstate *clnt,
+                                         int *crt_nops)
+{
+    osqlstate_t *osql = &clnt->osql;
+    shadrow_t *shad = &osql->shadrow;
+    int osql_nettype = tran2netrpl(clnt->dbtran.mode);
+    int rc;
+
+    if (!shad->tablename)
+        return 0;
+
+    rc = process_local_shadtbl_usedb(clnt, shad->tablename,
+                                     shad->tableversion);
+    if (rc)
+        return rc;
+
+    if (clnt->osql_max_trans && (*crt_nops + 1) > clnt->osql_max_trans)
+        return SQLITE_TOOBIG;
+
+    if (!shad->isupd) {
+        rc = osql_send_insrec(osql->host, osql->rqid, osql->uuid, shad->genid,
+                              -1ULL, shad->data, shad->datalen, osql_nettype,
+                              osql->logsb, shad->flags);
+    } else {
+        if (osql->is_reorder_on) {
+            rc = osql_send_updrec(osql->host, osql->rqid, osql->uuid,
+                                  shad->genid, -1ULL, -1ULL, shad->data,
+                                  shad->datalen, osql_nettype, osql->logsb);
+            if (rc)
+                goto err;
+        }
+        if (shad->updcols) {
+            rc = osql_send_updcols(osql->host, osql->rqid, osql->uuid,
+                                   shad->genid, osql_nettype,
+                                   &shad->updcols[1], shad->updcols[0],
+                                   osql->logsb);
+            if (rc)
+                goto err;
+            osql->replicant_numops++;
+            DEBUG_PRINT_NUMOPS();
+        }
+        if (!osql->is_reorder_on)
+            rc = osql_send_updrec(osql->host, osql->rqid, osql->uuid,
+                                  shad->genid, -1ULL, -1ULL, shad->data,
+                                  shad->datalen, osql_nettype, osql->logsb);
+    }
+err:
+    if (rc) {
+        logmsg(LOGMSG_ERROR,
+               "%s: error writting record to master in offload mode!\n",
+               __func__);
+        return SQLITE_INTERNAL;
+    }
+    osql->replicant_numops++;
+    DEBUG_PRINT_NUMOPS();
+    ++(*crt_nops);
+    return 0;
+}
+
 static int insert_record_indexes(BtCursor *pCur, struct sql_thread *thd,
                                  int64_t nKey, int *bdberr)
 {
@@ -2239,7 +2447,12 @@ static int insert_record_indexes(BtCursor *pCur, struct sql_thread *thd,
             return SQLITE_INTERNAL;
         }
 
-        if (pCur->db->ix_datacopy[ix]) {
+        if (pCur->db->ixschema[ix]->partial_datacopy) {
+            datacopy =
+                alloca(pCur->db->ixschema[ix]->partial_datacopy->recsize);
+            datacopylen = partial_datacopy_from_ondisk(
+                pCur->db, ix, pCur->ondisk_buf, datacopy);
+        } else if (pCur->db->ix_datacopy[ix]) {
             datacopy = pCur->ondisk_buf;
             datacopylen = getdatsize(pCur->db);
         } else if (pCur->db->ix_collattr[ix]) {
@@ -2388,6 +2601,14 @@ static inline void osql_destroy_dbq(osqlstate_t *osql)
     osql->shadbq.genid = 0;
 }
 
+static inline void osql_destroy_shadrow(osqlstate_t *osql)
+{
+    free(osql->shadrow.tablename);
+    free(osql->shadrow.data);
+    free(osql->shadrow.updcols);
+    memset(&osql->shadrow, 0, sizeof(osql->shadrow));
+}
+
 /**
  * Frees shadow tables used by this sql client
  *
@@ -2398,8 +2619,10 @@ void osql_shadtbl_close(struct sqlclntstate *clnt)
     shad_tbl_t *tbl = NULL, *tmp = NULL;
 
     osql->dirty = 0;
+    osql->noshadow = 0;
     osql_destroy_verify_temptbl(thedb->bdb_env, clnt);
     osql_destroy_dbq(osql);
+    osql_destroy_shadrow(osql);
     osql_destroy_schemachange_temptbl(thedb->bdb_env, clnt);
     osql_destroy_bpfunc_temptbl(thedb->bdb_env, clnt);
 
@@ -3297,7 +3520,8 @@ static int osql_destroy_bpfunc_temptbl(bdb_state_type *bdb_state,
 int osql_shadtbl_empty(struct sqlclntstate *clnt)
 {
     return listc_empty(&clnt->osql.shadtbls) && !clnt->osql.verify_tbl &&
-           !clnt->osql.sc_tbl && !clnt->osql.bpfunc_tbl;
+           !clnt->osql.sc_tbl && !clnt->osql.bpfunc_tbl &&
+           !clnt->osql.shadrow.tablename;
 }
 
 int osql_shadtbl_usedb_only(struct sqlclntstate *clnt)
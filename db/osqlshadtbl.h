@@ -28,6 +28,7 @@ struct osqlstate;
 struct tmp_table {
     void *table;
     /*int flags;*/
+    struct tmp_table *next_cached;
 };
 
 struct shad_tbl {
@@ -98,6 +99,26 @@ int osql_save_updcols(struct BtCursor *pCur, struct sql_thread *thd,
                       int *updCols);
 int osql_save_dbq_consume(struct sqlclntstate *, const char *spname, genid_t);
 
+/**
+ * Keep the first row written by an autocommit socksql statement in memory
+ * instead of the shadow tables; it was already sent and is needed only if
+ * the session is replayed.
+ * Returns 1 if the row was kept, 0 if the caller has to save it
+ *
+ */
+int osql_save_shadrow(struct BtCursor *pCur, struct sql_thread *thd,
+                      int isupd, char *pData, int nData, int *updCols,
+                      int flags);
+
+/**
+ * Socksql rows sent to the master running this sql thread need no shadow
+ * copy when osql_local_noshadow is set; a master swing then fails the
+ * transaction instead of replaying it.
+ * Returns 1 if the caller should not save the row
+ *
+ */
+int osql_skip_shadtbl(struct sqlclntstate *clnt);
+
 void *osql_get_shadow_bydb(struct sqlclntstate *clnt, struct dbtable *db);
 int osql_fetch_shadblobs_by_genid(struct BtCursor *pCur, int *blobnum,
                                   blob_status_t *blobs, int *bdberr);
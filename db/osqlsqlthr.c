@@ -298,6 +298,9 @@ int osql_delrec(struct BtCursor *pCur, struct sql_thread *thd)
                    __LINE__, __func__, rc);
             return rc;
         }
+
+        if (osql_skip_shadtbl(clnt))
+            return SQLITE_OK;
     }
 
     if (gbl_expressions_indexes && pCur->db->ix_expr) {
@@ -420,6 +423,13 @@ int osql_insrec(struct BtCursor *pCur, struct sql_thread *thd, char *pData,
                    __LINE__, __func__, rc);
             return rc;
         }
+
+        if (osql_skip_shadtbl(clnt))
+            return SQLITE_OK;
+
+        if (osql_save_shadrow(pCur, thd, 0 /* isupd */, pData, nData, NULL,
+                              flags))
+            return SQLITE_OK;
     }
 
     if (gbl_expressions_indexes && pCur->db->ix_expr) {
@@ -563,6 +573,13 @@ int osql_updrec(struct BtCursor *pCur, struct sql_thread *thd, char *pData,
                    __LINE__, __func__, rc);
             return rc;
         }
+
+        if (osql_skip_shadtbl(clnt))
+            return SQLITE_OK;
+
+        if (osql_save_shadrow(pCur, thd, 1 /* isupd */, pData, nData, updCols,
+                              flags))
+            return SQLITE_OK;
     }
 
     if (gbl_expressions_indexes && pCur->db->ix_expr) {
@@ -831,6 +848,16 @@ int osql_sock_restart(struct sqlclntstate *clnt, int maxretries,
         cheap_stack_trace();
     }
 
+    /* the rows went to the old master with no shadow copy */
+    if (osql->noshadow) {
+        logmsg(LOGMSG_ERROR,
+               "%s: master swing, cannot replay master-local rqid=%llx\n",
+               __func__, osql->rqid);
+        errstat_set_rc(&osql->xerr, ERR_NOMASTER);
+        errstat_set_str(&osql->xerr, "master swing in master-local session");
+        return SQLITE_CLIENT_CHANGENODE;
+    }
+
     do {
         retries++;
         sentops = 0;
@@ -975,7 +1002,8 @@ static inline int sock_restart_retryable_rcode(int restart_rc)
  * Returns the result of block processor commit
  *
  */
-int osql_sock_commit(struct sqlclntstate *clnt, int type)
+static int osql_sock_commit_int(struct sqlclntstate *clnt, int type,
+                                int keep_shadows)
 {
     osqlstate_t *osql = &clnt->osql;
     int rc = 0, rc2;
@@ -1208,15 +1236,18 @@ done:
        osql_set_replay(__FILE__, __LINE__, clnt, OSQL_RETRY_LAST);
    }
 
-   osql_shadtbl_close(clnt);
-
-   if (clnt->dbtran.mode == TRANLEVEL_SOSQL) {
-       /* we also need to free the tran object */
-       rc = trans_abort_shadow((void **)&clnt->dbtran.shadow_tran, &bdberr);
-       if (rc)
-           logmsg(LOGMSG_ERROR, 
-                   "%s:%d failed to abort shadow tran for socksql rc=%d\n",
-                   __FILE__, __LINE__, rc);
+   if (!keep_shadows) {
+       osql_shadtbl_close(clnt);
+
+       if (clnt->dbtran.mode == TRANLEVEL_SOSQL) {
+           /* we also need to free the tran object */
+           rc = trans_abort_shadow((void **)&clnt->dbtran.shadow_tran,
+                                   &bdberr);
+           if (rc)
+               logmsg(LOGMSG_ERROR,
+                      "%s:%d failed to abort shadow tran for socksql rc=%d\n",
+                      __FILE__, __LINE__, rc);
+       }
    }
 
    osql->sock_started = 0;
@@ -1224,6 +1255,21 @@ done:
    return rcout;
 }
 
+int osql_sock_commit(struct sqlclntstate *clnt, int type)
+{
+    return osql_sock_commit_int(clnt, type, 0);
+}
+
+int osql_sock_commit_chunk(struct sqlclntstate *clnt)
+{
+    int rc = osql_sock_commit_int(clnt, OSQL_SOCK_REQ, 1);
+    /* what the shadow tables hold is committed now, and can't be replayed to
+       a new master */
+    if (rc == 0)
+        clnt->osql.noshadow = 1;
+    return rc;
+}
+
 /**
  * Terminates a sosql session
  * It notifies the block processor to abort the request
@@ -1498,8 +1544,10 @@ static int osql_send_commit_logic(struct sqlclntstate *clnt, int is_retry,
 
     extern int gbl_always_send_cnonce;
     int send_cnonce = gbl_always_send_cnonce ? 1 : has_high_availability(clnt);
+    /* the chunks of a statement would all carry its cnonce */
     if (osql->rqid == OSQL_RQID_USE_UUID && send_cnonce &&
-        get_cnonce(clnt, &snap_info) == 0 && !clnt->trans_has_sp) {
+        !clnt->dbtran.maxchunksize && get_cnonce(clnt, &snap_info) == 0 &&
+        !clnt->trans_has_sp) {
 
         /* pass to master the state of verify retry.
          * if verify retry is on and error is retryable, don't write to
@@ -144,6 +144,14 @@ int osql_sock_start_deferred(struct sqlclntstate *clnt);
  */
 int osql_sock_commit(struct sqlclntstate *clnt, int type);
 
+/**
+ * Commits what a statement sent so far as a transaction of its own, for it
+ * to carry on in a new sosql session.  The shadow tran and tables stay, as
+ * the statement's cursors still use them.
+ *
+ */
+int osql_sock_commit_chunk(struct sqlclntstate *clnt);
+
 /**
  * Terminates a sosql session
  * It notifies the block processor to abort the request
@@ -18,6 +18,8 @@
 
 #include <parse_lsn.h>
 #include <logmsg.h>
+#include <list.h>
+#include <locks_wrap.h>
 
 /* internal implementation */
 typedef struct DB_Connection {
@@ -44,6 +46,9 @@ static DB_Connection *get_connect(char *hostname);
 static int insert_connect(char *hostname, char *dbname, size_t tier);
 static void delete_connect(DB_Connection *cnct);
 static LOG_INFO handle_record(LOG_INFO prev_info);
+static void update_source_lsn(void);
+static int apply_fetched(LOG_INFO *prev_info, int64_t highest_gen,
+                         int64_t *new_gen);
 static int find_new_repl_db(void);
 static DB_Connection *get_rand_connect(size_t tier);
 static void *keep_in_sync(void *args);
@@ -120,6 +125,42 @@ int gbl_physrep_register_interval = 3600;
 static int last_register;
 int gbl_blocking_physrep = 0;
 
+/* Read this much log ahead of the apply; 0 applies each record as it is
+   read from the source */
+int gbl_physrep_fetch_ahead_kb = 0;
+
+/* A log record read from the source and waiting to be applied */
+struct fetched_rec {
+    unsigned int file;
+    unsigned int offset;
+    int64_t timestamp;
+    int len;
+    LINKC_T(struct fetched_rec) lnk;
+    char blob[];
+};
+
+struct fetch_queue {
+    pthread_mutex_t lk;
+    pthread_cond_t cd;
+    LISTC_T(struct fetched_rec) recs;
+    int64_t bytes;
+    int64_t limit;
+    int64_t highest_gen;
+    int64_t new_gen; /* set if the source's master changed */
+    int stop;
+    int done;
+    int rc; /* last cdb2_next_record rc */
+};
+
+/* How far behind the source we are, for "stat physrep" */
+static pthread_mutex_t lag_lk = PTHREAD_MUTEX_INITIALIZER;
+static LOG_INFO source_lsn;      /* source's end of log, last we heard */
+static LOG_INFO applied_lsn;     /* last record we applied */
+static int64_t applied_ts;       /* commit time of the last commit applied */
+static int64_t fetched_bytes;    /* read from the source, not yet applied */
+static uint64_t applied_records;
+static uint64_t applied_bytes;
+
 static void *keep_in_sync(void *args)
 {
     /* vars for syncing */
@@ -195,6 +236,8 @@ repl_loop:
             if (rc < 0 || rc >= sql_cmd_len)
                 logmsg(LOGMSG_ERROR, "sql_cmd buffer is not long enough!\n");
 
+            update_source_lsn();
+
             if ((rc = cdb2_run_statement(repl_db, sql_cmd)) != CDB2_OK) {
                 logmsg(LOGMSG_ERROR, "Couldn't query the database, retrying\n");
                 close_repl_connection();
@@ -210,27 +253,47 @@ repl_loop:
             }
 
             /* our log matches, so apply each record log received */
-            while (do_repl && !do_truncate &&
-                   (rc = cdb2_next_record(repl_db)) == CDB2_OK) {
-                /* check the generation id to make sure the master hasn't
-                 * switched */
-                int64_t *rec_gen = (int64_t *)cdb2_column_value(repl_db, 2);
-                if (rec_gen && *rec_gen > highest_gen) {
-                    int64_t new_gen = *rec_gen;
+            if (gbl_physrep_fetch_ahead_kb > 0) {
+                int64_t new_gen = 0;
+                rc = apply_fetched(&prev_info, highest_gen, &new_gen);
+                if (new_gen) {
                     if (gbl_verbose_physrep) {
                         logmsg(LOGMSG_USER,
-                               "%s: My master changed, set "
-                               "truncate flag\n",
+                               "%s: My master changed, set truncate flag\n",
                                __func__);
                         logmsg(LOGMSG_USER,
                                "%s: gen: %" PRId64 ", rec_gen: %" PRId64 "\n",
-                               __func__, gen, *rec_gen);
+                               __func__, gen, new_gen);
                     }
                     do_truncate = 1;
                     highest_gen = new_gen;
                     goto repl_loop;
                 }
-                prev_info = handle_record(prev_info);
+            } else {
+                while (do_repl && !do_truncate &&
+                       (rc = cdb2_next_record(repl_db)) == CDB2_OK) {
+                    /* check the generation id to make sure the master hasn't
+                     * switched */
+                    int64_t *rec_gen =
+                        (int64_t *)cdb2_column_value(repl_db, 2);
+                    if (rec_gen && *rec_gen > highest_gen) {
+                        int64_t new_gen = *rec_gen;
+                        if (gbl_verbose_physrep) {
+                            logmsg(LOGMSG_USER,
+                                   "%s: My master changed, set "
+                                   "truncate flag\n",
+                                   __func__);
+                            logmsg(LOGMSG_USER,
+                                   "%s: gen: %" PRId64 ", rec_gen: %" PRId64
+                                   "\n",
+                                   __func__, gen, *rec_gen);
+                        }
+                        do_truncate = 1;
+                        highest_gen = new_gen;
+                        goto repl_loop;
+                    }
+                    prev_info = handle_record(prev_info);
+                }
             }
 
             if (rc != CDB2_OK_DONE || do_truncate) {
@@ -285,25 +348,83 @@ int apply_log_procedure(unsigned int file, unsigned int offset, void *blob,
 }
 
 /* privates */
-static LOG_INFO handle_record(LOG_INFO prev_info)
+static void note_source_lsn(unsigned int file, unsigned int offset)
 {
-    /* vars for 1 record */
-    void *blob;
-    int blob_len;
+    Pthread_mutex_lock(&lag_lk);
+    if (file > source_lsn.file ||
+        (file == source_lsn.file && offset > source_lsn.offset)) {
+        source_lsn.file = file;
+        source_lsn.offset = offset;
+    }
+    Pthread_mutex_unlock(&lag_lk);
+}
+
+/* Ask the source where its log ends, so that lag is known even while we
+   are a long way from reading that far */
+static void update_source_lsn(void)
+{
+    unsigned int file, offset;
     char *lsn;
-    int64_t *timestamp;
     int rc;
-    unsigned int file, offset;
 
-    lsn = (char *)cdb2_column_value(repl_db, 0);
-    timestamp = (int64_t *)cdb2_column_value(repl_db, 3);
-    blob = cdb2_column_value(repl_db, 4);
-    blob_len = cdb2_column_size(repl_db, 4);
+    rc = cdb2_run_statement(repl_db, "select lsn from "
+                                     "comdb2_transaction_logs(NULL, NULL, 4) "
+                                     "limit 1");
+    if (rc != CDB2_OK)
+        return;
+    while ((rc = cdb2_next_record(repl_db)) == CDB2_OK) {
+        lsn = (char *)cdb2_column_value(repl_db, 0);
+        if (lsn && char_to_lsn(lsn, &file, &offset) == 0)
+            note_source_lsn(file, offset);
+    }
+}
 
-    if ((rc = char_to_lsn(lsn, &file, &offset)) != 0) {
-        logmsg(LOGMSG_ERROR, "Could not parse lsn:%s\n", lsn);
+void physrep_stat(void)
+{
+    LOG_INFO src, applied;
+    int64_t ts, fetched, lag_bytes = 0;
+    uint64_t nrecs, nbytes;
+    u_int32_t lg_max = 0;
+
+    Pthread_mutex_lock(&lag_lk);
+    src = source_lsn;
+    applied = applied_lsn;
+    ts = applied_ts;
+    fetched = fetched_bytes;
+    nrecs = applied_records;
+    nbytes = applied_bytes;
+    Pthread_mutex_unlock(&lag_lk);
+
+    /* log files are all lg_max bytes but the last, so this is close */
+    thedb->bdb_env->dbenv->get_lg_max(thedb->bdb_env->dbenv, &lg_max);
+    if (src.file > applied.file ||
+        (src.file == applied.file && src.offset > applied.offset)) {
+        lag_bytes = (int64_t)(src.file - applied.file) * lg_max +
+                    src.offset - applied.offset;
     }
 
+    logmsg(LOGMSG_USER, "physrep source %s, fetch ahead %d kb\n",
+           repl_db_connected && curr_cnct ? curr_cnct->hostname : "none",
+           gbl_physrep_fetch_ahead_kb);
+    logmsg(LOGMSG_USER, "  source lsn   {%u:%u}\n", src.file, src.offset);
+    logmsg(LOGMSG_USER, "  applied lsn  {%u:%u}\n", applied.file,
+           applied.offset);
+    logmsg(LOGMSG_USER, "  lag          %" PRId64 " bytes, %" PRId64
+                        " seconds\n",
+           lag_bytes, ts ? (int64_t)time(NULL) - ts : 0);
+    logmsg(LOGMSG_USER, "  fetched      %" PRId64 " bytes not applied yet\n",
+           fetched);
+    logmsg(LOGMSG_USER, "  applied      %" PRIu64 " records, %" PRIu64
+                        " bytes\n",
+           nrecs, nbytes);
+}
+
+static LOG_INFO apply_record(LOG_INFO prev_info, unsigned int file,
+                             unsigned int offset, int64_t *timestamp,
+                             void *blob, int blob_len)
+{
+    int rc;
+
     if (gbl_deferred_phys_flag && timestamp) {
         time_t curr_time = time(NULL);
         /* Change this to sleep only once a second to test the
@@ -340,6 +461,15 @@ static LOG_INFO handle_record(LOG_INFO prev_info)
         logmsg(LOGMSG_ERROR, "Something went wrong with applying the logs\n");
     }
 
+    Pthread_mutex_lock(&lag_lk);
+    applied_lsn.file = file;
+    applied_lsn.offset = offset;
+    if (timestamp && *timestamp)
+        applied_ts = *timestamp;
+    applied_records++;
+    applied_bytes += blob_len;
+    Pthread_mutex_unlock(&lag_lk);
+
     LOG_INFO next_info;
     next_info.file = file;
     next_info.offset = offset;
@@ -348,6 +478,159 @@ static LOG_INFO handle_record(LOG_INFO prev_info)
     return next_info;
 }
 
+static LOG_INFO handle_record(LOG_INFO prev_info)
+{
+    /* vars for 1 record */
+    void *blob;
+    int blob_len;
+    char *lsn;
+    int64_t *timestamp;
+    unsigned int file, offset;
+
+    lsn = (char *)cdb2_column_value(repl_db, 0);
+    timestamp = (int64_t *)cdb2_column_value(repl_db, 3);
+    blob = cdb2_column_value(repl_db, 4);
+    blob_len = cdb2_column_size(repl_db, 4);
+
+    if (char_to_lsn(lsn, &file, &offset) != 0) {
+        logmsg(LOGMSG_ERROR, "Could not parse lsn:%s\n", lsn);
+    }
+    note_source_lsn(file, offset);
+
+    return apply_record(prev_info, file, offset, timestamp, blob, blob_len);
+}
+
+/* Reads the rest of the current query's records into the queue, staying at
+   most physrep_fetch_ahead_kb ahead of the apply.  Stops before a record
+   from a newer generation, which the apply side has to truncate for. */
+static void *fetch_records(void *arg)
+{
+    struct fetch_queue *q = arg;
+    struct fetched_rec *r;
+    int64_t *rec_gen, *timestamp;
+    char *lsn;
+    int rc, len, stop;
+
+    while (1) {
+        Pthread_mutex_lock(&q->lk);
+        while (!q->stop && q->bytes >= q->limit)
+            Pthread_cond_wait(&q->cd, &q->lk);
+        stop = q->stop;
+        Pthread_mutex_unlock(&q->lk);
+        if (stop || !do_repl) {
+            rc = -1;
+            break;
+        }
+
+        if ((rc = cdb2_next_record(repl_db)) != CDB2_OK)
+            break;
+
+        rec_gen = (int64_t *)cdb2_column_value(repl_db, 2);
+        if (rec_gen && *rec_gen > q->highest_gen) {
+            q->new_gen = *rec_gen;
+            break;
+        }
+
+        lsn = (char *)cdb2_column_value(repl_db, 0);
+        timestamp = (int64_t *)cdb2_column_value(repl_db, 3);
+        len = cdb2_column_size(repl_db, 4);
+        if ((r = malloc(offsetof(struct fetched_rec, blob) + len)) == NULL) {
+            logmsg(LOGMSG_ERROR, "%s: can't allocate %d bytes\n", __func__,
+                   len);
+            rc = -1;
+            break;
+        }
+        if (char_to_lsn(lsn, &r->file, &r->offset) != 0) {
+            logmsg(LOGMSG_ERROR, "Could not parse lsn:%s\n", lsn);
+        }
+        r->timestamp = timestamp ? *timestamp : 0;
+        r->len = len;
+        memcpy(r->blob, cdb2_column_value(repl_db, 4), len);
+        note_source_lsn(r->file, r->offset);
+
+        Pthread_mutex_lock(&q->lk);
+        listc_abl(&q->recs, r);
+        q->bytes += len;
+        Pthread_cond_signal(&q->cd);
+        Pthread_mutex_unlock(&q->lk);
+
+        Pthread_mutex_lock(&lag_lk);
+        fetched_bytes += len;
+        Pthread_mutex_unlock(&lag_lk);
+    }
+
+    Pthread_mutex_lock(&q->lk);
+    q->rc = rc;
+    q->done = 1;
+    Pthread_cond_signal(&q->cd);
+    Pthread_mutex_unlock(&q->lk);
+    return NULL;
+}
+
+/* Apply the current query's records while another thread reads ahead, so
+   the round trips to the source overlap with applying.  Returns the last
+   cdb2_next_record rc, and sets *new_gen if the source's master changed. */
+static int apply_fetched(LOG_INFO *prev_info, int64_t highest_gen,
+                         int64_t *new_gen)
+{
+    struct fetch_queue q = {0};
+    struct fetched_rec *r;
+    pthread_t tid;
+    int rc;
+
+    Pthread_mutex_init(&q.lk, NULL);
+    Pthread_cond_init(&q.cd, NULL);
+    listc_init(&q.recs, offsetof(struct fetched_rec, lnk));
+    q.limit = (int64_t)gbl_physrep_fetch_ahead_kb * 1024;
+    q.highest_gen = highest_gen;
+
+    if ((rc = pthread_create(&tid, NULL, fetch_records, &q)) != 0) {
+        logmsg(LOGMSG_ERROR, "%s: can't create fetch thread rc %d\n",
+               __func__, rc);
+        rc = -1;
+        goto out;
+    }
+
+    while (1) {
+        Pthread_mutex_lock(&q.lk);
+        while ((r = listc_rtl(&q.recs)) == NULL && !q.done)
+            Pthread_cond_wait(&q.cd, &q.lk);
+        if (r) {
+            q.bytes -= r->len;
+            Pthread_cond_signal(&q.cd);
+        }
+        Pthread_mutex_unlock(&q.lk);
+        if (r == NULL)
+            break;
+
+        Pthread_mutex_lock(&lag_lk);
+        fetched_bytes -= r->len;
+        Pthread_mutex_unlock(&lag_lk);
+
+        if (!do_repl) {
+            free(r);
+            Pthread_mutex_lock(&q.lk);
+            q.stop = 1;
+            Pthread_cond_signal(&q.cd);
+            Pthread_mutex_unlock(&q.lk);
+            continue;
+        }
+        *prev_info = apply_record(*prev_info, r->file, r->offset,
+                                  r->timestamp ? &r->timestamp : NULL,
+                                  r->blob, r->len);
+        free(r);
+    }
+
+    Pthread_join(tid, NULL);
+    rc = q.rc;
+    *new_gen = q.new_gen;
+
+out:
+    Pthread_cond_destroy(&q.cd);
+    Pthread_mutex_destroy(&q.lk);
+    return rc;
+}
+
 static int register_self()
 {
     int rc;
@@ -14,6 +14,9 @@ int start_replication();
 
 int stop_replication();
 
+/* Print how far behind the source we are */
+void physrep_stat(void);
+
 /* expose as a hook for apply_log */
 int apply_log_procedure(unsigned int file, unsigned int offset, void *blob,
                         int blob_len, int newfile);
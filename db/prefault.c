@@ -62,6 +62,64 @@ extern pthread_key_t lockmgr_key;
 
 static void *prefault_io_thread(void *arg);
 
+/* requests that fault in the same record or key are the same request; ones
+   carrying a new record are not, the keys they form depend on it */
+static int pfrq_dedupable(const pfrq_t *req)
+{
+    switch (req->type) {
+    case PFRQ_OLDDATA:
+    case PFRQ_OLDKEY:
+    case PFRQ_NEWKEY:
+    case PFRQ_OLDDATA_OLDKEYS:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static unsigned int pfrq_hash(const void *key, int len)
+{
+    const pfrq_t *req = key;
+    unsigned int h;
+
+    h = hash_default_fixedwidth((const unsigned char *)&req->genid,
+                                sizeof(req->genid));
+    h = h * 31 + (unsigned int)(uintptr_t)req->db;
+    h = h * 31 + req->type * 64 + req->index;
+    if (req->type == PFRQ_OLDKEY || req->type == PFRQ_NEWKEY)
+        h = h * 31 + hash_default_fixedwidth(req->key, req->len);
+    return h;
+}
+
+static int pfrq_cmp(const void *key1, const void *key2, int len)
+{
+    const pfrq_t *a = key1;
+    const pfrq_t *b = key2;
+
+    if (a->db != b->db || a->type != b->type || a->index != b->index ||
+        a->genid != b->genid)
+        return 1;
+    if (a->type == PFRQ_OLDKEY || a->type == PFRQ_NEWKEY)
+        return a->len != b->len || memcmp(a->key, b->key, a->len);
+    return 0;
+}
+
+/* the block processor this request was made for has moved past its op */
+static int pfrq_passed(struct dbenv *dbenv, const pfrq_t *req)
+{
+    prefault_helper_thread_type *helper;
+
+    if (req->helper_thread < 0 ||
+        req->helper_thread >= dbenv->prefault_helper.numthreads)
+        return 0;
+    helper = &dbenv->prefault_helper.threads[req->helper_thread];
+    /* a different seqnum is a different transaction, the existing
+       checks count those */
+    if (!req->seqnum || req->seqnum != helper->seqnum)
+        return 0;
+    return req->opnum < helper->opnum;
+}
+
 /* initialize the prefault io pool.  pass set the number of io threads,
  and the queue depth */
 int start_prefault_io_threads(struct dbenv *dbenv, int numthreads, int maxq)
@@ -99,6 +157,7 @@ int start_prefault_io_threads(struct dbenv *dbenv, int numthreads, int maxq)
         logmsg(LOGMSG_FATAL, "couldnt create prefault io queue\n");
         exit(1);
     }
+    dbenv->prefaultiopool.pending = hash_init_user(pfrq_hash, pfrq_cmp, 0, 0);
 
     for (i = 0; i < numthreads; i++) {
         rc = pthread_create(&(dbenv->prefaultiopool.threads[i]), &attr,
@@ -130,6 +189,8 @@ unsigned int enque_pfault_ll(struct dbenv *dbenv, pfrq_t *qdata)
     if (dbenv->prefaultiopool.numthreads == 0)
         return 1;
 
+    qdata->pending = 0;
+
     Pthread_mutex_lock(&(dbenv->prefaultiopool.mutex));
     /*fprintf(stderr, "about to add item, q now=%d\n",
        queue_count(dbenv->prefaultiopool.ioq));*/
@@ -149,6 +210,20 @@ unsigned int enque_pfault_ll(struct dbenv *dbenv, pfrq_t *qdata)
         return 1;
     }
 
+    if (pfrq_dedupable(qdata)) {
+        /* the same fault is already queued; it will broadcast for us */
+        pfrq_t *dup = hash_find(dbenv->prefaultiopool.pending, qdata);
+        if (dup) {
+            if (qdata->broadcast)
+                dup->broadcast = 1;
+            dbenv->prefault_stats.deduped++;
+            Pthread_mutex_unlock(&(dbenv->prefaultiopool.mutex));
+            return 1;
+        }
+        if (hash_add(dbenv->prefaultiopool.pending, qdata) == 0)
+            qdata->pending = 1;
+    }
+
     rc = queue_add(dbenv->prefaultiopool.ioq, qdata);
     if (rc != 0) {
         logmsg(LOGMSG_ERROR, "could not add data to queue!\n");
@@ -410,6 +485,7 @@ int enque_pfault_exit(struct dbenv *dbenv)
    qdata->dolocal = 1;
    qdata->record = NULL;
    qdata->tag = NULL;
+   qdata->helper_thread = -1;
    rc = enque_pfault_ll(dbenv, qdata);
    
    if (rc != 0)
@@ -488,6 +564,11 @@ static void *prefault_io_thread(void *arg)
         /*fprintf(stderr, "consumed item, q now=%d\n",
            queue_count(dbenv->prefaultiopool.ioq));*/
 
+        if (req->pending) {
+            hash_del(dbenv->prefaultiopool.pending, req);
+            req->pending = 0;
+        }
+
         Pthread_mutex_unlock(&(dbenv->prefaultiopool.mutex));
 
         assert(req != NULL);
@@ -496,7 +577,11 @@ static void *prefault_io_thread(void *arg)
 
         MEMORY_SYNC;
 
-        if (req->dolocal)
+        if (req->dolocal && pfrq_passed(dbenv, req)) {
+            dbenv->prefault_stats.skipped_passed++;
+            if (req->type == PFRQ_OLDDATA_OLDKEYS_NEWKEYS)
+                needfree = 1;
+        } else if (req->dolocal)
             switch (req->type) {
             /* fault in a dta record by genid */
             case PFRQ_OLDDATA: {
@@ -1017,6 +1102,11 @@ void prefault_stats(struct dbenv *dbenv)
 
     logmsg(LOGMSG_USER, "skipped_seq %d\n", dbenv->prefault_stats.skipped_seq);
 
+    logmsg(LOGMSG_USER, "skipped_passed %d\n",
+           dbenv->prefault_stats.skipped_passed);
+
+    logmsg(LOGMSG_USER, "deduped %d\n", dbenv->prefault_stats.deduped);
+
     logmsg(LOGMSG_USER, "processed %d\n", dbenv->prefault_stats.processed);
 
     logmsg(LOGMSG_USER, "aborts %d\n", dbenv->prefault_stats.aborts);
@@ -20,6 +20,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <plhash.h>
 
 enum pfrq_type {
     PFRQ_OLDDATA = 1, /* given a table, genid : fault the dta record */
@@ -70,6 +71,8 @@ typedef struct {
 
     int skipped;
     int skipped_seq;
+    int skipped_passed;
+    int deduped;
     int processed;
 
     int aborts;
@@ -85,6 +88,7 @@ typedef struct prefaultiopool {
     int maxq;
     pthread_t threads[128]; /* XXX yeah, make this better */
     queue_type *ioq;
+    hash_t *pending; /* queued requests, to drop duplicates */
 } prefaultiopool_type;
 
 typedef struct pfrq {
@@ -108,6 +112,7 @@ typedef struct pfrq {
     struct ireq *iq;
     int helper_thread;
     unsigned int seqnum;
+    int pending; /* in prefaultiopool.pending */
 } pfrq_t;
 
 enum { PREFAULT_TOBLOCK = 1, PREFAULT_READAHEAD = 2 };
@@ -139,6 +144,7 @@ typedef struct {
     void *blkstate;
 
     unsigned int seqnum;
+    unsigned int opnum; /* op the block processor we help has reached */
 } prefault_helper_thread_type;
 
 typedef struct {
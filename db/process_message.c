@@ -16,6 +16,9 @@
 
 extern int __berkdb_write_alarm_ms;
 extern int __berkdb_read_alarm_ms;
+extern void __berkdb_reclaim_report(void);
+extern void bdb_log_index_dump(void);
+extern void __berkdb_log_rcache_report(void);
 
 #ifdef __sun
 /* for PTHREAD_STACK_MIN on Solaris */
@@ -83,6 +86,10 @@ extern int __berkdb_read_alarm_ms;
 #include "sc_global.h"
 #include "logmsg.h"
 #include "comdb2_atomic.h"
+#include "wait_event.h"
+#include "result_cache.h"
+#include "profile.h"
+#include "phys_rep.h"
 
 extern int gbl_exit_alarm_sec;
 extern int gbl_disable_rowlocks_logging;
@@ -132,6 +139,7 @@ void bdb_berktest_multi(void *);
 void bdb_berktest_commit_delay(uint32_t);
 void rowlocks_clear_stats(void);
 void rowlocks_print_stats(FILE *f);
+void berkdb_region_hugepage_stats(void);
 void rowlocks_bench(void *, int, int);
 void rowlocks_lock1_bench(void *, int, int);
 void rowlocks_lock2_bench(void *, int, int);
@@ -196,7 +204,9 @@ static const char *HELP_MAIN[] = {
     "help bdb       - database backend commands",
     "help schema    - schema related commands",
     "help fstblk    - fstblk commands", "help compr     - compression commands",
-    "help analyze   - analyze commands", "exit           - exit task", NULL};
+    "help analyze   - analyze commands",
+    "profile #      - sample stacks for # seconds into a folded stacks file",
+    "exit           - exit task", NULL};
 
 static const char *HELP_JAVA[] = {
     "Java stored procedure engine commands:-", "java stat",
@@ -210,9 +220,19 @@ static const char *HELP_STAT[] = {
     "stat stal                  - thread status",
     "stat long                  - request statistics",
     "stat reql                  - dumps long request settings",
+    "stat wait                  - dump wait event totals and top waiters",
+    "stat resultcache           - dump result cache hit rate and size",
+    "stat rowcache              - dump row cache hit rate and size",
+    "stat llmetacache           - dump llmeta cache hit rate and size",
+    "stat zstd <table>          - list a table's zstd dictionaries",
+    "stat reclaim               - dump files waiting to be freed",
+    "stat logindex              - dump the timestamp ranges of indexed logs",
+    "stat logreadcache          - log read cache for replicant fills",
+    "stat physrep               - physical replication lag and throughput",
     "stat appsock               - socket request statistics",
     "stat fstblk                - fstblk statistics",
     "stat blob                  - blob subsystems statistics",
+    "stat regions               - what backs the berkdb regions",
     "stat resources             - dump list of registered resources",
     "stat signals               - signal handling setup",
     "stat csc2vers <table>      - get current schema version for table",
@@ -291,6 +311,7 @@ static const char *HELP_ANALYZE[] = {
     "Commands for setting analyze options:-",
     "stat analyze       - print analyze stats",
     "backout [table]    - backout analyze stats [optionally for table]",
+    "incremental table  - update stats for table from its index sketches",
     "sample             - enable sampling btrees",
     "nosample           - disable sampling btrees",
     "thresh <size>      - sample tables larger than <size>",
@@ -616,6 +637,7 @@ void bdb_clear_logfile_pglogs_stat();
 #endif
 void bdb_osql_trn_clients_status();
 void bdb_newsi_mempool_stat();
+void bdb_verstore_stat(void);
 
 static pthread_mutex_t exiting_lock = PTHREAD_MUTEX_INITIALIZER;
 void *clean_exit_thd(void *unused)
@@ -944,6 +966,7 @@ clipper_usage:
         bdb_osql_trn_clients_status();
         logmsg(LOGMSG_USER, "Release locks on snapisol lockwait count: %llu\n",
                release_locks_on_si_lockwait_cnt);
+        bdb_verstore_stat();
         if (gbl_new_snapisol) {
             logmsg(LOGMSG_USER, "newsi memory pool stat:\n");
             bdb_newsi_mempool_stat();
@@ -971,6 +994,27 @@ clipper_usage:
                 logmsg(LOGMSG_USER, "Walkback warning is disabled\n");
             }
         }
+    } else if (tokcmp(tok, ltok, "profile") == 0) {
+        int seconds = 10;
+        char *path;
+        FILE *f;
+        tok = segtok(line, lline, &st, &ltok);
+        if (ltok > 0)
+            seconds = toknum(tok, ltok);
+        path = comdb2_location("tmp", "profile.%s.%ld.folded", thedb->envname,
+                               (long)time(NULL));
+        if ((f = fopen(path, "w")) == NULL) {
+            logmsg(LOGMSG_ERROR, "cannot open %s: %s\n", path,
+                   strerror(errno));
+        } else {
+            if (profile_run(seconds, f) != 0) {
+                logmsg(LOGMSG_ERROR, "a profile is already running\n");
+                unlink(path);
+            } else
+                logmsg(LOGMSG_USER, "folded stacks in %s\n", path);
+            fclose(f);
+        }
+        free(path);
     } else if (tokcmp(tok, ltok, "pageordertrace") == 0) {
         if (gbl_enable_pageorder_trace) {
            logmsg(LOGMSG_USER, "pageorder trace already on\n");
@@ -1578,6 +1622,8 @@ clipper_usage:
             blob_print_stats();
         } else if (tokcmp(tok, ltok, "compr") == 0) {
             compr_print_stats();
+        } else if (tokcmp(tok, ltok, "regions") == 0) {
+            berkdb_region_hugepage_stats();
         } else if (tokcmp(tok, ltok, "resources") == 0) {
             dumpresources();
         } else if (tokcmp(tok, ltok, "signals") == 0) {
@@ -1658,6 +1704,31 @@ clipper_usage:
             dump_table_sizes(thedb);
         } else if (tokcmp(tok, ltok, "reql") == 0) {
             reqlog_stat();
+        } else if (tokcmp(tok, ltok, "wait") == 0) {
+            wait_event_report();
+        } else if (tokcmp(tok, ltok, "resultcache") == 0) {
+            result_cache_report();
+        } else if (tokcmp(tok, ltok, "rowcache") == 0) {
+            bdb_row_cache_report();
+        } else if (tokcmp(tok, ltok, "llmetacache") == 0) {
+            bdb_llmeta_cache_report();
+        } else if (tokcmp(tok, ltok, "zstd") == 0) {
+            char table[MAXTABLELEN];
+            struct dbtable *db;
+            tok = segtok(line, lline, &st, &ltok);
+            tokcpy0(tok, ltok, table, sizeof(table));
+            if (ltok == 0 || (db = get_dbtable_by_name(table)) == NULL)
+                logmsg(LOGMSG_ERROR, "unknown table '%s'\n", table);
+            else
+                bdb_zstd_dict_report(db->handle);
+        } else if (tokcmp(tok, ltok, "reclaim") == 0) {
+            __berkdb_reclaim_report();
+        } else if (tokcmp(tok, ltok, "logindex") == 0) {
+            bdb_log_index_dump();
+        } else if (tokcmp(tok, ltok, "logreadcache") == 0) {
+            __berkdb_log_rcache_report();
+        } else if (tokcmp(tok, ltok, "physrep") == 0) {
+            physrep_stat();
         } else if (tokcmp(tok, ltok, "switch") == 0) {
             switch_status();
         } else if (tokcmp(tok, ltok, "clnt") == 0) {
@@ -2942,6 +3013,17 @@ clipper_usage:
             SBUF2 *sb = sbuf2open(fileno(stdout), 0);
             handle_backout(sb, table);
             if(table) free(table);
+        } else if (tokcmp(tok, ltok, "incremental") == 0) {
+            tok = segtok(line, lline, &st, &ltok);
+            if (ltok <= 0) {
+                logmsg(LOGMSG_ERROR, "Analyze incremental needs a table\n");
+                return 0;
+            }
+            char *table = tokdup(tok, ltok);
+            SBUF2 *sb = sbuf2open(fileno(stdout), 0);
+            analyze_table_incremental(table, sb);
+            sbuf2free(sb);
+            free(table);
         } else if(tokcmp(tok,ltok,"abort") == 0) {
             if(!analyze_is_running()) {
                 logmsg(LOGMSG_ERROR, "Analyze is not running [or not running on this node].\n");
@@ -3319,6 +3401,31 @@ clipper_usage:
         logmsg(LOGMSG_USER, 
             "Read: %llu    Written: %llu    Throttles: %llu   Reorders: %llu\n",
             read, written, waits, reorders);
+        {
+            unsigned long long calls, bytes, zcsends, zccopied;
+            net_get_writev_usage(thedb->handle_sibling, &calls, &bytes,
+                                 &zcsends, &zccopied);
+            if (calls)
+                logmsg(LOGMSG_USER, "Writev calls: %llu    Bytes/call: %llu   "
+                                    "Zerocopy sends: %llu   Copied: %llu\n",
+                       calls, bytes / calls, zcsends, zccopied);
+        }
+        {
+            unsigned long long zmsgs, zin, zout, unzmsgs;
+            net_get_compress_usage(thedb->handle_sibling, &zmsgs, &zin, &zout,
+                                   &unzmsgs);
+            if (zmsgs || unzmsgs)
+                logmsg(LOGMSG_USER, "Compressed sends: %llu    Ratio: %.2f   "
+                                    "Decompressed reads: %llu\n",
+                       zmsgs, zout ? (double)zin / zout : 0.0, unzmsgs);
+        }
+        {
+            unsigned long long batches, ops;
+            osql_comm_batch_stats(&batches, &ops);
+            if (batches)
+                logmsg(LOGMSG_USER, "Osql batches: %llu    Ops/batch: %llu\n",
+                       batches, ops / batches);
+        }
         num_nodes = net_get_all_nodes(thedb->handle_sibling, hosts);
         if (num_nodes > 0) {
             int i;
@@ -4856,6 +4963,8 @@ static void request_stats(struct dbenv *dbenv)
     }
 }
 
+extern int gbl_direct_count_cache;
+
 void fastcount(char *tablename)
 {
     uint64_t dtasize;
@@ -4868,6 +4977,23 @@ void fastcount(char *tablename)
         return;
     }
 
+    if (gbl_direct_count_cache) {
+        int64_t count;
+        int retries = 0;
+        int rc;
+
+        do {
+            rc = bdb_table_direct_count(p_db->handle, &count);
+        } while (rc == BDBERR_DEADLOCK && ++retries < gbl_maxretries);
+        if (rc == 0) {
+            logmsg(LOGMSG_USER, "table %s has %" PRId64 " records\n",
+                   tablename, count);
+            return;
+        }
+        logmsg(LOGMSG_ERROR, "%s: count of %s failed rc %d, estimating\n",
+               __func__, tablename, rc);
+    }
+
     calc_table_size(p_db);
     dtasize = p_db->totalsize / 3;
     recsize = p_db->lrl;
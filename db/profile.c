@@ -0,0 +1,249 @@
+/*
+   Copyright 2024 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/* The samples are taken by a SIGPROF handler off an ITIMER_PROF timer, so
+ * they land on the threads that are using the cpu, which is what a cpu spike
+ * is made of.  The handler only unwinds into a slot it claims in an array
+ * allocated for the run; the slots are sorted, counted and symbolized after
+ * the timer is stopped.  A thread blocked in a system call when the signal
+ * comes is restarted, as the handler is installed with SA_RESTART. */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+#include "comdb2_atomic.h"
+#include "epochlib.h"
+#include "logmsg.h"
+#include "thrman.h"
+#include "tohex.h"
+#include "walkback.h"
+#include "sql.h"
+#include "profile.h"
+
+int gbl_profile_hz = 97;
+
+#define PROFILE_FRAMES 32
+#define PROFILE_MAX_SAMPLES 65536
+#define PROFILE_MAX_SECONDS 600
+
+struct profile_sample {
+    int done;
+    int type;
+    int has_query;
+    unsigned nframes;
+    unsigned char query[FINGERPRINTSZ];
+    void *pcs[PROFILE_FRAMES];
+};
+
+static int prof_running;
+static int prof_inflight;
+static int prof_next;
+static int prof_dropped;
+static struct profile_sample *prof_samples;
+
+static __thread unsigned char prof_query[FINGERPRINTSZ];
+static __thread int prof_has_query;
+
+int profile_active(void)
+{
+    return ATOMIC_LOAD32(prof_running) == 1;
+}
+
+void profile_set_query(const unsigned char *fingerprint)
+{
+    if (fingerprint == NULL) {
+        prof_has_query = 0;
+        return;
+    }
+    prof_has_query = 0;
+    memcpy(prof_query, fingerprint, FINGERPRINTSZ);
+    prof_has_query = 1;
+}
+
+/* Only async-signal-safe things in here: libunwind's local unwind, this
+ * thread's own variables and the slot it claimed */
+static void profile_sigprof(int sig, siginfo_t *info, void *ctx)
+{
+    struct profile_sample *s;
+    int serrno = errno;
+    int n;
+
+    ATOMIC_ADD32(prof_inflight, 1);
+    if (ATOMIC_LOAD32(prof_running) != 1)
+        goto out;
+    if ((n = ATOMIC_ADD32(prof_next, 1) - 1) >= PROFILE_MAX_SAMPLES) {
+        ATOMIC_ADD32(prof_dropped, 1);
+        goto out;
+    }
+    s = &prof_samples[n];
+    s->type = thrman_self_type();
+    if ((s->has_query = prof_has_query) != 0)
+        memcpy(s->query, prof_query, FINGERPRINTSZ);
+    if (stack_pc_getlist((ucontext_t *)ctx, s->pcs, PROFILE_FRAMES,
+                         &s->nframes) != 0)
+        s->nframes = 0;
+    if (s->nframes > PROFILE_FRAMES)
+        s->nframes = PROFILE_FRAMES;
+    __atomic_store_n(&s->done, 1, __ATOMIC_RELEASE);
+out:
+    ATOMIC_ADD32(prof_inflight, -1);
+    errno = serrno;
+}
+
+static int sample_cmp(const void *a, const void *b)
+{
+    const struct profile_sample *x = *(struct profile_sample **)a;
+    const struct profile_sample *y = *(struct profile_sample **)b;
+    int c;
+
+    if (x->type != y->type)
+        return x->type < y->type ? -1 : 1;
+    if (x->has_query != y->has_query)
+        return x->has_query < y->has_query ? -1 : 1;
+    if (x->has_query && (c = memcmp(x->query, y->query, FINGERPRINTSZ)) != 0)
+        return c;
+    if (x->nframes != y->nframes)
+        return x->nframes < y->nframes ? -1 : 1;
+    return memcmp(x->pcs, y->pcs, x->nframes * sizeof(void *));
+}
+
+static void write_frame(FILE *out, void *pc)
+{
+    const char *base;
+    Dl_info dl;
+
+    if (dladdr(pc, &dl) == 0) {
+        fprintf(out, ";%p", pc);
+    } else if (dl.dli_sname) {
+        fprintf(out, ";%s", dl.dli_sname);
+    } else {
+        /* a static function: leave something addr2line can take */
+        base = dl.dli_fname ? strrchr(dl.dli_fname, '/') : NULL;
+        fprintf(out, ";%s+%#lx",
+                base ? base + 1 : (dl.dli_fname ? dl.dli_fname : "?"),
+                (unsigned long)((uintptr_t)pc - (uintptr_t)dl.dli_fbase));
+    }
+}
+
+static void write_stack(FILE *out, const struct profile_sample *s, int count)
+{
+    char fp[FINGERPRINTSZ * 2 + 1];
+
+    fprintf(out, "%s", thrman_type2a(s->type));
+    if (s->has_query) {
+        util_tohex(fp, (const char *)s->query, FINGERPRINTSZ);
+        fprintf(out, ";fp:%s", fp);
+    }
+    /* folded stacks go from the outermost frame in */
+    for (int i = (int)s->nframes - 1; i >= 0; i--)
+        write_frame(out, s->pcs[i]);
+    fprintf(out, " %d\n", count);
+}
+
+static void write_folded(FILE *out, int nsamples)
+{
+    struct profile_sample **sorted;
+    int n = 0, i, j;
+
+    if ((sorted = malloc(nsamples * sizeof(*sorted) + 1)) == NULL) {
+        logmsg(LOGMSG_ERROR, "%s: out of memory\n", __func__);
+        return;
+    }
+    for (i = 0; i < nsamples; i++) {
+        if (prof_samples[i].done && prof_samples[i].nframes)
+            sorted[n++] = &prof_samples[i];
+    }
+    qsort(sorted, n, sizeof(*sorted), sample_cmp);
+    for (i = 0; i < n; i = j) {
+        for (j = i + 1; j < n && sample_cmp(&sorted[i], &sorted[j]) == 0; j++)
+            ;
+        write_stack(out, sorted[i], j - i);
+    }
+    free(sorted);
+}
+
+int profile_run(int seconds, FILE *out)
+{
+    struct sigaction sa;
+    struct itimerval it = {{0}};
+    int zero = 0, hz, nsamples, now, end;
+
+    if (!CAS32(prof_running, zero, 1))
+        return -1;
+
+    if (seconds <= 0)
+        seconds = 1;
+    else if (seconds > PROFILE_MAX_SECONDS)
+        seconds = PROFILE_MAX_SECONDS;
+    if ((hz = gbl_profile_hz) <= 0 || hz > 1000)
+        hz = 97;
+
+    if ((prof_samples = calloc(PROFILE_MAX_SAMPLES,
+                               sizeof(struct profile_sample))) == NULL) {
+        logmsg(LOGMSG_ERROR, "%s: out of memory\n", __func__);
+        XCHANGE32(prof_running, 0);
+        return -1;
+    }
+    XCHANGE32(prof_next, 0);
+    XCHANGE32(prof_dropped, 0);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = profile_sigprof;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPROF, &sa, NULL);
+
+    it.it_interval.tv_usec = 1000000 / hz;
+    it.it_value = it.it_interval;
+    setitimer(ITIMER_PROF, &it, NULL);
+
+    logmsg(LOGMSG_USER, "profiling for %d seconds at %d Hz\n", seconds, hz);
+    /* our own SIGPROF cuts the poll short */
+    end = comdb2_time_epochms() + seconds * 1000;
+    while ((now = comdb2_time_epochms()) < end)
+        poll(NULL, 0, end - now);
+
+    memset(&it, 0, sizeof(it));
+    setitimer(ITIMER_PROF, &it, NULL);
+    XCHANGE32(prof_running, 2);
+    /* a SIGPROF still on its way would otherwise end the process */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_IGN;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPROF, &sa, NULL);
+    while (ATOMIC_LOAD32(prof_inflight) > 0)
+        poll(NULL, 0, 1);
+
+    if ((nsamples = ATOMIC_LOAD32(prof_next)) > PROFILE_MAX_SAMPLES)
+        nsamples = PROFILE_MAX_SAMPLES;
+    write_folded(out, nsamples);
+    fflush(out);
+    logmsg(LOGMSG_USER, "profile: %d samples, %d dropped\n", nsamples,
+           ATOMIC_LOAD32(prof_dropped));
+
+    free(prof_samples);
+    prof_samples = NULL;
+    XCHANGE32(prof_running, 0);
+    return 0;
+}
@@ -0,0 +1,42 @@
+/*
+   Copyright 2024 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef INCLUDED_PROFILE_H
+#define INCLUDED_PROFILE_H
+
+#include <stdio.h>
+
+/* Sampling profiler.  For the seconds asked for, the stack of whichever
+   thread is on cpu is taken profile_hz times a second of cpu, tagged with
+   the thread's thrman type and the fingerprint of the statement it is
+   running, and the samples are written out as folded stacks, one
+   "type;fingerprint;outermost;...;innermost count" line per distinct stack,
+   ready for flamegraph.pl.  Nothing is paid outside of a run but noting the
+   fingerprint each statement already computes. */
+
+extern int gbl_profile_hz;
+
+/* Profile for seconds and write the folded stacks to out.  Returns -1
+   without waiting if a run is already going. */
+int profile_run(int seconds, FILE *out);
+
+/* Whether a run is going, so the fingerprint is worth noting */
+int profile_active(void);
+
+/* The statement this thread is running, or NULL when it is done */
+void profile_set_query(const unsigned char *fingerprint);
+
+#endif
@@ -51,6 +51,7 @@
 #include "indices.h"
 
 extern int gbl_partial_indexes;
+extern int gbl_upsert_single_probe;
 extern int gbl_expressions_indexes;
 
 static int check_blob_buffers(struct ireq *iq, blob_buffer_t *blobs,
@@ -400,10 +401,19 @@ int add_record(struct ireq *iq, void *trans, const uint8_t *p_buf_tag_name,
         ERR;
     }
 
+    /* For ON CONFLICT DO NOTHING the last conflict check can be the add of
+     * that key, made ahead of the record with a genid taken for it, when
+     * the record is added the usual way. */
+    int probe_ixnum = -1;
     if ((rec_flags & OSQL_IGNORE_FAILURE) != 0) {
+        int single_probe = gbl_upsert_single_probe && !vgenid &&
+                           !(flags & RECFLAGS_KEEP_GENID) &&
+                           !is_event_from_sc(flags) &&
+                           (!gbl_use_plan || !iq->usedb->plan);
         rc = check_for_upsert(iq, trans, ondisktagsc, blobs, maxblobs,
                               opfailcode, ixfailnum, &retrc, ondisktag, od_dta,
-                              od_len, ins_keys, rec_flags);
+                              od_len, ins_keys, rec_flags,
+                              single_probe ? &probe_ixnum : NULL);
         if (rc)
             ERR;
     }
@@ -434,6 +444,17 @@ int add_record(struct ireq *iq, void *trans, const uint8_t *p_buf_tag_name,
         if (flags & RECFLAGS_KEEP_GENID) {
             assert(genid != 0);
             retrc = dat_set(iq, trans, od_dta, od_len, *rrn, *genid);
+        } else if (probe_ixnum != -1) {
+            *rrn = 2;
+            *genid = dat_new_genid(iq);
+            /* on a conflict nothing has been written */
+            retrc = add_upsert_probe_key(iq, trans, probe_ixnum, blobs,
+                                         maxblobs, opfailcode, ixfailnum,
+                                         *rrn, *genid, od_dta, od_len,
+                                         ondisktag, ondisktagsc);
+            if (retrc)
+                ERR;
+            retrc = dat_set(iq, trans, od_dta, od_len, *rrn, *genid);
         } else
             retrc = dat_add(iq, trans, od_dta, od_len, genid, rrn);
 
@@ -513,7 +534,8 @@ int add_record(struct ireq *iq, void *trans, const uint8_t *p_buf_tag_name,
         retrc =
             add_record_indices(iq, trans, blobs, maxblobs, opfailcode,
                                ixfailnum, rrn, genid, vgenid, ins_keys, opcode,
-                               blkpos, od_dta, od_len, ondisktag, ondisktagsc);
+                               blkpos, od_dta, od_len, ondisktag, ondisktagsc,
+                               probe_ixnum);
         if (retrc)
             ERR;
     }
@@ -1238,7 +1260,8 @@ int upd_record(struct ireq *iq, void *trans, void *primkey, int rrn,
     retrc = upd_record_indices(
         iq, trans, opfailcode, ixfailnum, rrn, genid, ins_keys, opcode, blkpos,
         od_dta, od_len, old_dta, del_keys, flags, add_idx_blobs, del_idx_blobs,
-        same_genid_with_upd, vgenid, &deferredAdd);
+        same_genid_with_upd, vgenid, &deferredAdd,
+        using_myupdatecols ? NULL : updCols);
 
     if (retrc)
         ERR;
@@ -69,6 +69,7 @@
 #include "comdb2uuid.h"
 #include "strbuf.h"
 #include "roll_file.h"
+#include "hdrhist.h"
 
 #include "eventlog.h"
 #include "reqlog_int.h"
@@ -599,6 +600,28 @@ static void scanrules_ll(void)
     }
 }
 
+/* latency of each request phase, in microseconds */
+static struct hdrhist_set *phase_hists;
+
+static const char *phase_names[REQL_PHASE_MAX] = {
+    "queue", "prepare", "run", "commit", "repwait"};
+
+const char *reqlog_phase_name(int phase)
+{
+    return (phase >= 0 && phase < REQL_PHASE_MAX) ? phase_names[phase]
+                                                  : "unknown";
+}
+
+void reqlog_phase_record(int phase, uint64_t us)
+{
+    hdrhist_set_record(phase_hists, phase, us);
+}
+
+void reqlog_phase_get(int phase, struct hdrhist *out)
+{
+    hdrhist_set_get(phase_hists, phase, out);
+}
+
 int reqlog_init(const char *dbname)
 {
     struct output *out;
@@ -630,6 +653,8 @@ int reqlog_init(const char *dbname)
 
     eventlog_init();
 
+    phase_hists = hdrhist_set_new(REQL_PHASE_MAX);
+
     scanrules_ll();
     return 0;
 }
@@ -654,6 +679,9 @@ static const char *help_text[] = {
     "       every N          - log only every Nth event, 0 logs all",
     "       verbose on/off   - turn on/off verbose mode",
     "       flush            - flush log file to disk",
+    "       format binary/json - log format, binary is smaller and cheaper",
+    "       async on/off     - write from a background thread",
+    "       ringsize N       - per thread buffer for async mode, in bytes",
     "reql [rulename] ...     - add/modify rules.  The default rule is '0'.",
     "                          Valid rule names begin with a digit or '.'.",
     "   General commands:", "       delete           - delete named rule",
@@ -997,6 +1025,20 @@ void reqlog_stat(void)
     }
     eventlog_status();
     Pthread_mutex_unlock(&rules_mutex);
+
+    struct hdrhist h;
+    for (int i = 0; i < REQL_PHASE_MAX; i++) {
+        reqlog_phase_get(i, &h);
+        if (h.count == 0)
+            continue;
+        logmsg(LOGMSG_USER,
+               "%-8s latency us : count %" PRIu64 " avg %" PRIu64
+               " p50 %" PRIu64 " p99 %" PRIu64 " p999 %" PRIu64
+               " max %" PRIu64 "\n",
+               reqlog_phase_name(i), h.count, hdrhist_mean(&h),
+               hdrhist_percentile(&h, 50), hdrhist_percentile(&h, 99),
+               hdrhist_percentile(&h, 99.9), h.max);
+    }
 }
 
 struct reqlogger *reqlog_alloc(void)
@@ -0,0 +1,596 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/*
+ * Result cache for read-only statements.
+ *
+ * The key is the statement text, the client settings that change what it
+ * returns, its bound parameters, and the commit genid this node had applied
+ * when the statement started.  Every commit, on the master or applied on a
+ * replicant, moves the commit genid, so an entry is never found again once
+ * anything has changed; stale entries age out of the LRU.  The rows are
+ * only stored if the commit genid did not move while the statement ran.
+ *
+ * The cached rows are plain malloc memory, not sqlite's: they outlive the
+ * statement arena and the sql thread that made them.  A hit replays them
+ * through the client's next_row and column callbacks, the way dohsql feeds
+ * the rows of its shards to the client, and the engine is never stepped.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+#include "comdb2.h"
+#include "comdb2_atomic.h"
+#include "sql.h"
+#include "sqliteInt.h"
+#include "vdbeInt.h"
+#include "lrucache.h"
+#include "result_cache.h"
+
+int gbl_result_cache_mb = 0;
+int gbl_result_cache_max_rows = 1000;
+
+#define RESULT_CACHE_MAXENT (1 << 20)
+#define RESULT_CACHE_SHARDS 16
+
+struct rc_key {
+    unsigned int hash;
+    int len;
+    char *buf;
+};
+
+struct rc_entry {
+    struct rc_key key;
+    int ncols;
+    int nrows;
+    Mem *cells; /* nrows * ncols, strings and blobs point into payload */
+    char *payload;
+    lrucache_link lnk;
+};
+
+/* a statement being collected or replayed, hung off the clnt */
+struct result_cache_run {
+    struct rc_key key;
+    unsigned long long version;
+    int ncols;
+
+    /* replaying */
+    struct rc_entry *hit;
+    int next;
+    Mem *row; /* the current row; conversions allocate in here */
+    struct plugin_callbacks backup;
+
+    /* collecting */
+    int nrows;
+    int maxrows;
+    Mem *cells;
+    char *payload;
+    size_t npayload;
+    size_t payloadsz;
+    int abandoned;
+};
+
+static struct lrucache *result_cache;
+static pthread_once_t result_cache_once = PTHREAD_ONCE_INIT;
+static int result_cache_mb;
+
+static uint64_t rc_lookups;
+static uint64_t rc_hits;
+static uint64_t rc_stored;
+static uint64_t rc_uncacheable;
+static uint64_t rc_abandoned;
+
+static unsigned int rc_hashfunc(const void *key, int len)
+{
+    return ((const struct rc_key *)key)->hash;
+}
+
+static int rc_cmpfunc(const void *key1, const void *key2, int len)
+{
+    const struct rc_key *k1 = key1;
+    const struct rc_key *k2 = key2;
+
+    if (k1->hash != k2->hash || k1->len != k2->len)
+        return 1;
+    return memcmp(k1->buf, k2->buf, k1->len);
+}
+
+static void rc_entry_free(void *p)
+{
+    struct rc_entry *ent = p;
+
+    free(ent->key.buf);
+    free(ent->cells);
+    free(ent->payload);
+    free(ent);
+}
+
+static void result_cache_init(void)
+{
+    result_cache = lrucache_init_concurrent(
+        rc_hashfunc, rc_cmpfunc, rc_entry_free, offsetof(struct rc_entry, lnk),
+        offsetof(struct rc_entry, key), sizeof(struct rc_key),
+        RESULT_CACHE_MAXENT, RESULT_CACHE_SHARDS);
+}
+
+static struct lrucache *result_cache_get(void)
+{
+    int mb = gbl_result_cache_mb;
+
+    pthread_once(&result_cache_once, result_cache_init);
+    if (mb != result_cache_mb) {
+        /* shrinking takes effect as entries are added */
+        lrucache_set_maxbytes(result_cache, (long long)mb * 1024 * 1024);
+        result_cache_mb = mb;
+    }
+    return result_cache;
+}
+
+static const char *cacheable_aggs[] = {"count", "sum", "total", "avg",
+                                       "min",   "max", "group_concat"};
+
+static int cacheable_agg(const FuncDef *f)
+{
+    for (int i = 0; i < sizeof(cacheable_aggs) / sizeof(cacheable_aggs[0]);
+         i++) {
+        if (strcasecmp(f->zName, cacheable_aggs[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static const FuncDef *op_func(const Op *op)
+{
+    if (op->p4type == P4_FUNCDEF)
+        return op->p4.pFunc;
+    if (op->p4type == P4_FUNCCTX)
+        return op->p4.pCtx->pFunc;
+    return NULL;
+}
+
+/* Does the statement only read local tables, and only call functions that
+   return the same thing each time? */
+static int cacheable_program(Vdbe *v)
+{
+    const FuncDef *f;
+
+    for (int i = 0; i < v->nOp; i++) {
+        const Op *op = &v->aOp[i];
+        switch (op->opcode) {
+        case OP_OpenRead:
+        case OP_ReopenIdx:
+        case OP_OpenRead_Record:
+            /* temp tables and remote tables don't move the commit genid */
+            if (op->p3 != 0)
+                return 0;
+            break;
+        case OP_VOpen:
+        case OP_VFilter:
+            return 0;
+        case OP_Function0:
+        case OP_Function:
+        case OP_PureFunc0:
+        case OP_PureFunc:
+            f = op_func(op);
+            if (f == NULL || !(f->funcFlags & SQLITE_FUNC_CONSTANT))
+                return 0;
+            break;
+        case OP_AggStep:
+        case OP_AggStep1:
+        case OP_AggInverse:
+        case OP_AggValue:
+        case OP_AggFinal:
+            f = op_func(op);
+            if (f == NULL || !cacheable_agg(f))
+                return 0;
+            break;
+        }
+    }
+    return 1;
+}
+
+struct keybuf {
+    char *buf;
+    int len;
+    int sz;
+};
+
+static int key_append(struct keybuf *k, const void *data, int len)
+{
+    if (k->len + len > k->sz) {
+        int sz = (k->len + len) * 2;
+        char *buf = realloc(k->buf, sz);
+        if (buf == NULL)
+            return -1;
+        k->buf = buf;
+        k->sz = sz;
+    }
+    memcpy(k->buf + k->len, data, len);
+    k->len += len;
+    return 0;
+}
+
+static int key_append_param(struct keybuf *k, const Mem *m)
+{
+    char type;
+
+    /* datetimes and intervals carry more than their value */
+    if (m->flags & (MEM_Datetime | MEM_Interval)) {
+        return -1;
+    } else if (m->flags & MEM_Null) {
+        type = 'n';
+        return key_append(k, &type, 1);
+    } else if (m->flags & MEM_Int) {
+        type = 'i';
+        return key_append(k, &type, 1) || key_append(k, &m->u.i, sizeof(i64));
+    } else if (m->flags & MEM_Real) {
+        type = 'r';
+        return key_append(k, &type, 1) ||
+               key_append(k, &m->u.r, sizeof(double));
+    } else if ((m->flags & (MEM_Str | MEM_Blob)) && !(m->flags & MEM_Zero)) {
+        type = (m->flags & MEM_Str) ? 's' : 'b';
+        return key_append(k, &type, 1) ||
+               key_append(k, &m->n, sizeof(int)) ||
+               key_append(k, m->z, m->n);
+    }
+    return -1;
+}
+
+static int make_key(struct sqlclntstate *clnt, Vdbe *v,
+                    unsigned long long version, struct rc_key *key)
+{
+    struct keybuf k = {0};
+    const char *sql = v->zSql ? v->zSql : "";
+    char ci_like = clnt->using_case_insensitive_like != 0;
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    if (key_append(&k, &version, sizeof(version)) ||
+        key_append(&k, &clnt->dtprec, sizeof(clnt->dtprec)) ||
+        key_append(&k, &ci_like, 1) ||
+        key_append(&k, clnt->tzname, strlen(clnt->tzname) + 1) ||
+        key_append(&k, sql, strlen(sql) + 1))
+        goto err;
+    for (int i = 0; i < v->nVar; i++) {
+        if (key_append_param(&k, &v->aVar[i]))
+            goto err;
+    }
+
+    for (int i = 0; i < k.len; i++) {
+        h ^= (unsigned char)k.buf[i];
+        h *= 0x100000001b3ULL;
+    }
+    key->hash = (unsigned int)(h ^ (h >> 32));
+    key->len = k.len;
+    key->buf = k.buf;
+    return 0;
+
+err:
+    free(k.buf);
+    return -1;
+}
+
+static unsigned long long commit_version(void)
+{
+    return bdb_get_commit_genid(thedb->bdb_env, NULL);
+}
+
+/* replay */
+
+static const Mem *rc_value(struct sqlclntstate *clnt, int iCol)
+{
+    struct result_cache_run *run = clnt->rcache;
+    return &run->row[iCol];
+}
+
+#define FUNC_COLUMN_TYPE(ret, type)                                            \
+    static ret rc_column_##type(struct sqlclntstate *clnt,                     \
+                                sqlite3_stmt *stmt, int iCol)                  \
+    {                                                                          \
+        struct result_cache_run *run = clnt->rcache;                           \
+        if (run->next == 0)                                                    \
+            return sqlite3_column_##type(stmt, iCol);                          \
+        return sqlite3_value_##type((sqlite3_value *)rc_value(clnt, iCol));    \
+    }
+
+FUNC_COLUMN_TYPE(int, type)
+FUNC_COLUMN_TYPE(sqlite_int64, int64)
+FUNC_COLUMN_TYPE(double, double)
+FUNC_COLUMN_TYPE(int, bytes)
+FUNC_COLUMN_TYPE(const unsigned char *, text)
+FUNC_COLUMN_TYPE(const void *, blob)
+FUNC_COLUMN_TYPE(const dttz_t *, datetime)
+
+static const intv_t *rc_column_interval(struct sqlclntstate *clnt,
+                                        sqlite3_stmt *stmt, int iCol, int type)
+{
+    struct result_cache_run *run = clnt->rcache;
+    if (run->next == 0)
+        return sqlite3_column_interval(stmt, iCol, type);
+    return sqlite3_value_interval((sqlite3_value *)rc_value(clnt, iCol), type);
+}
+
+static void rc_release_row(struct result_cache_run *run)
+{
+    for (int i = 0; i < run->ncols; i++)
+        sqlite3VdbeMemRelease(&run->row[i]);
+}
+
+static int rc_next_row(struct sqlclntstate *clnt, sqlite3_stmt *stmt)
+{
+    struct result_cache_run *run = clnt->rcache;
+    struct rc_entry *ent = run->hit;
+
+    if (run->next >= ent->nrows)
+        return SQLITE_DONE;
+
+    rc_release_row(run);
+    for (int i = 0; i < run->ncols; i++) {
+        Mem *m = &run->row[i];
+        memcpy(m, &ent->cells[run->next * run->ncols + i], MEMCELLSIZE);
+        m->tz = clnt->tzname;
+        m->db = NULL;
+    }
+    run->next++;
+    return SQLITE_ROW;
+}
+
+static void rc_replay_set(struct sqlclntstate *clnt)
+{
+    struct result_cache_run *run = clnt->rcache;
+
+    run->backup = clnt->plugin;
+    clnt->plugin.next_row = rc_next_row;
+    clnt->plugin.column_type = rc_column_type;
+    clnt->plugin.column_int64 = rc_column_int64;
+    clnt->plugin.column_double = rc_column_double;
+    clnt->plugin.column_text = rc_column_text;
+    clnt->plugin.column_bytes = rc_column_bytes;
+    clnt->plugin.column_blob = rc_column_blob;
+    clnt->plugin.column_datetime = rc_column_datetime;
+    clnt->plugin.column_interval = rc_column_interval;
+}
+
+static void rc_replay_reset(struct sqlclntstate *clnt)
+{
+    struct plugin_callbacks *backup = &clnt->rcache->backup;
+
+    clnt->plugin.next_row = backup->next_row;
+    clnt->plugin.column_type = backup->column_type;
+    clnt->plugin.column_int64 = backup->column_int64;
+    clnt->plugin.column_double = backup->column_double;
+    clnt->plugin.column_text = backup->column_text;
+    clnt->plugin.column_bytes = backup->column_bytes;
+    clnt->plugin.column_blob = backup->column_blob;
+    clnt->plugin.column_datetime = backup->column_datetime;
+    clnt->plugin.column_interval = backup->column_interval;
+}
+
+static void rc_run_free(struct sqlclntstate *clnt)
+{
+    struct result_cache_run *run = clnt->rcache;
+
+    if (run == NULL)
+        return;
+    if (run->hit) {
+        rc_replay_reset(clnt);
+        rc_release_row(run);
+        lrucache_release(result_cache, &run->key);
+    }
+    free(run->row);
+    free(run->cells);
+    free(run->payload);
+    free(run->key.buf);
+    free(run);
+    clnt->rcache = NULL;
+}
+
+void result_cache_begin(struct sqlclntstate *clnt, sqlite3_stmt *stmt)
+{
+    Vdbe *v = (Vdbe *)stmt;
+    struct lrucache *cache;
+    struct result_cache_run *run;
+    int maxbytes;
+
+    rc_run_free(clnt);
+
+    if (gbl_result_cache_mb <= 0)
+        return;
+    if (!clnt->isselect || sqlite3_column_count(stmt) == 0 || v->explain || v->recording || clnt->conns ||
+        clnt->verify_indexes || clnt->in_client_trans ||
+        clnt->ctrl_sqlengine != SQLENG_NORMAL_PROCESS ||
+        !cacheable_program(v)) {
+        ATOMIC_ADD64(rc_uncacheable, 1);
+        return;
+    }
+
+    cache = result_cache_get();
+    if ((run = calloc(1, sizeof(*run))) == NULL)
+        return;
+    run->version = commit_version();
+    run->ncols = sqlite3_column_count(stmt);
+    if (make_key(clnt, v, run->version, &run->key)) {
+        ATOMIC_ADD64(rc_uncacheable, 1);
+        free(run);
+        return;
+    }
+    /* an entry may take a sixteenth of the cache */
+    maxbytes = gbl_result_cache_mb * (1024 * 1024 / 16);
+    run->maxrows = gbl_result_cache_max_rows;
+    if (run->ncols > 0 && run->maxrows > maxbytes / (run->ncols * sizeof(Mem)))
+        run->maxrows = maxbytes / (run->ncols * sizeof(Mem));
+    clnt->rcache = run;
+
+    ATOMIC_ADD64(rc_lookups, 1);
+    if ((run->hit = lrucache_find(cache, &run->key)) != NULL) {
+        if ((run->row = calloc(run->ncols, sizeof(Mem))) == NULL) {
+            lrucache_release(cache, &run->key);
+            run->hit = NULL;
+            rc_run_free(clnt);
+            return;
+        }
+        ATOMIC_ADD64(rc_hits, 1);
+        rc_replay_set(clnt);
+    }
+}
+
+static void rc_abandon(struct result_cache_run *run)
+{
+    run->abandoned = 1;
+    free(run->cells);
+    free(run->payload);
+    run->cells = NULL;
+    run->payload = NULL;
+    ATOMIC_ADD64(rc_abandoned, 1);
+}
+
+static int rc_payload(struct result_cache_run *run, const char *z, int n)
+{
+    if (run->npayload + n > run->payloadsz) {
+        size_t sz = (run->npayload + n) * 2;
+        char *payload = realloc(run->payload, sz);
+        if (payload == NULL)
+            return -1;
+        run->payload = payload;
+        run->payloadsz = sz;
+    }
+    memcpy(run->payload + run->npayload, z, n);
+    run->npayload += n;
+    return 0;
+}
+
+void result_cache_add_row(struct sqlclntstate *clnt, sqlite3_stmt *stmt)
+{
+    struct result_cache_run *run = clnt->rcache;
+    Mem *cells;
+
+    if (run == NULL || run->hit || run->abandoned)
+        return;
+    if (run->nrows >= run->maxrows ||
+        run->npayload > (size_t)gbl_result_cache_mb * (1024 * 1024 / 16)) {
+        rc_abandon(run);
+        return;
+    }
+    if ((run->nrows & (run->nrows - 1)) == 0) {
+        cells = realloc(run->cells, sizeof(Mem) * run->ncols *
+                                        (run->nrows ? run->nrows * 2 : 1));
+        if (cells == NULL) {
+            rc_abandon(run);
+            return;
+        }
+        run->cells = cells;
+    }
+
+    cells = &run->cells[run->nrows * run->ncols];
+    memset(cells, 0, sizeof(Mem) * run->ncols);
+    for (int i = 0; i < run->ncols; i++) {
+        const Mem *m = (const Mem *)sqlite3_column_value(stmt, i);
+        Mem *c = &cells[i];
+
+        memcpy(c, m, MEMCELLSIZE);
+        c->flags = m->flags & (MEM_Null | MEM_Int | MEM_Real | MEM_Str |
+                               MEM_Blob | MEM_Datetime | MEM_Interval);
+        c->tz = NULL;
+        c->z = NULL;
+        if (c->flags & (MEM_Str | MEM_Blob)) {
+            if (m->flags & MEM_Zero) {
+                rc_abandon(run);
+                return;
+            }
+            /* the offset until the payload stops moving */
+            c->z = (char *)(uintptr_t)run->npayload;
+            if (rc_payload(run, m->z, m->n) ||
+                ((c->flags & MEM_Str) && rc_payload(run, "", 1))) {
+                rc_abandon(run);
+                return;
+            }
+            c->flags |= MEM_Static | ((c->flags & MEM_Str) ? MEM_Term : 0);
+        }
+    }
+    run->nrows++;
+}
+
+void result_cache_end(struct sqlclntstate *clnt, int store)
+{
+    struct result_cache_run *run = clnt->rcache;
+    struct rc_entry *ent;
+    size_t size;
+
+    if (run == NULL)
+        return;
+    if (!store || run->hit || run->abandoned ||
+        commit_version() != run->version) {
+        rc_run_free(clnt);
+        return;
+    }
+
+    if ((ent = calloc(1, sizeof(*ent))) == NULL) {
+        rc_run_free(clnt);
+        return;
+    }
+    ent->key = run->key;
+    ent->ncols = run->ncols;
+    ent->nrows = run->nrows;
+    ent->cells = run->cells;
+    ent->payload = run->payload;
+    run->key.buf = NULL;
+    run->cells = NULL;
+    run->payload = NULL;
+    for (int i = 0; i < ent->nrows * ent->ncols; i++) {
+        Mem *c = &ent->cells[i];
+        if (c->flags & (MEM_Str | MEM_Blob))
+            c->z = ent->payload + (uintptr_t)c->z;
+    }
+
+    size = sizeof(*ent) + ent->key.len + run->npayload +
+           sizeof(Mem) * ent->nrows * ent->ncols;
+    if (lrucache_add_sized(result_cache, ent, size) == 0)
+        ATOMIC_ADD64(rc_stored, 1);
+    else
+        rc_entry_free(ent); /* someone else stored it first */
+    rc_run_free(clnt);
+}
+
+void result_cache_report(void)
+{
+    uint64_t lookups = ATOMIC_LOAD64(rc_lookups);
+    uint64_t hits = ATOMIC_LOAD64(rc_hits);
+
+    logmsg(LOGMSG_USER, "result cache: %d MB, max %d rows per statement\n",
+           gbl_result_cache_mb, gbl_result_cache_max_rows);
+    logmsg(LOGMSG_USER,
+           "  lookups %" PRIu64 ", hits %" PRIu64 " (%.1f%%), stored %" PRIu64
+           "\n",
+           lookups, hits, lookups ? 100.0 * hits / lookups : 0.0,
+           ATOMIC_LOAD64(rc_stored));
+    logmsg(LOGMSG_USER,
+           "  not cacheable %" PRIu64 ", too large %" PRIu64 "\n",
+           ATOMIC_LOAD64(rc_uncacheable), ATOMIC_LOAD64(rc_abandoned));
+    if (result_cache) {
+        long long bytes = 0;
+        int nents = 0;
+        for (int i = 0; i < result_cache->nshards; i++) {
+            struct lrucache_shard *s = &result_cache->shards[i];
+            Pthread_mutex_lock(&s->lk);
+            bytes += s->bytes;
+            nents += s->lru.count + s->used.count;
+            Pthread_mutex_unlock(&s->lk);
+        }
+        logmsg(LOGMSG_USER, "  %d entries, %lld bytes\n", nents, bytes);
+    }
+}
@@ -0,0 +1,48 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef INCLUDED_RESULT_CACHE_H
+#define INCLUDED_RESULT_CACHE_H
+
+/* Result cache.  The rows of a read-only statement run outside a client
+   transaction are kept, keyed by its text, its bound parameters and the
+   commit this node had applied when it ran; the same statement run again
+   before the next commit is answered from them without stepping the
+   engine.  Off while result_cache_mb is 0. */
+
+struct sqlclntstate;
+struct sqlite3_stmt;
+
+extern int gbl_result_cache_mb;
+extern int gbl_result_cache_max_rows;
+
+/* Once the statement is bound and before it is stepped: on a hit the
+   client's next_row and column callbacks replay the cached rows, on a miss
+   of a statement that can be cached its rows are collected */
+void result_cache_begin(struct sqlclntstate *clnt, struct sqlite3_stmt *stmt);
+
+/* Collect the row the statement is on */
+void result_cache_add_row(struct sqlclntstate *clnt,
+                          struct sqlite3_stmt *stmt);
+
+/* The statement is done; store the rows collected if it ran to the end
+   without an error */
+void result_cache_end(struct sqlclntstate *clnt, int store);
+
+/* Hit rate and size, to LOGMSG_USER */
+void result_cache_report(void);
+
+#endif
@@ -70,6 +70,14 @@ struct fingerprint_track {
     int64_t rows;     /* Cumulative number of rows selected */
     char *zNormSql;   /* The normalized SQL query */
     size_t nNormSql;  /* Length of normalized SQL query */
+    struct hdrhist *latency; /* Execution time in microseconds */
+    int running;      /* Statements of this shape running now */
+    int64_t rejected; /* Turned away by fingerprint_admit() */
+    uint64_t plan;         /* tables and indexes the last run went through */
+    int64_t plan_count;    /* runs with this plan */
+    int64_t plan_cost;     /* their cumulative cost */
+    int64_t prev_plan_avg; /* average cost with the plan before, if any */
+    int64_t plan_changes;  /* times the plan changed */
 };
 
 typedef struct stmt_hash_entry {
@@ -103,6 +111,8 @@ struct sqlthdstate {
     int dbopen_gen;
     int analyze_gen;
     int views_gen;
+    int warm_gen; /* dbopen_gen we are warming the stmt cache for */
+    int warm_pos; /* how far through that we are; -1 once done */
 };
 
 typedef struct osqltimings {
@@ -129,6 +139,17 @@ typedef struct {
     genid_t genid;
 } shadbq_t;
 
+typedef struct {
+    char *tablename; /* NULL if no row is kept */
+    int tableversion;
+    int isupd;
+    unsigned long long genid; /* row being updated */
+    char *data;
+    int datalen;
+    int *updcols;
+    int flags;
+} shadrow_t;
+
 typedef struct osqlstate {
 
     /* == sql_thread == */
@@ -156,6 +177,7 @@ typedef struct osqlstate {
     LISTC_T(struct shad_tbl)
         shadtbls;    /* storage for shadow tables created by offloading */
     shadbq_t shadbq; /* storage for dbq's shadtbl */
+    shadrow_t shadrow; /* autocommit row kept out of the shadow tables */
 
     struct temp_table *
         verify_tbl; /* storage for verify, common for all transaction */
@@ -195,6 +217,10 @@ typedef struct osqlstate {
 
     /* set to 1 if we have already called osql_sock_start in socksql mode */
     bool sock_started : 1;
+
+    /* set if rows were sent to the local master without a shadow copy; the
+       session cannot be replayed */
+    bool noshadow : 1;
 } osqlstate_t;
 
 enum ctrl_sqleng {
@@ -236,6 +262,11 @@ typedef struct {
     fdb_tbl_ent_t **lockedRemTables; /* list of fdb_tbl_ent_t* for read-locked
                                         remote tables */
     int nLockedRemTables; /* number of pointers in lockedRemTablesRootp */
+
+    int maxchunksize; /* SET TRANSACTION CHUNK: rows per commit, 0 for all */
+    int crtchunksize; /* rows written since the last chunk was committed */
+    int chunk_commit; /* recover_deadlock is to commit a chunk */
+    int chunk_rc;     /* and how that went */
 } dbtran_type;
 typedef dbtran_type trans_t;
 
@@ -285,6 +316,9 @@ void currangearr_append(CurRangeArr *arr, CurRange *r);
 CurRange *currangearr_get(CurRangeArr *arr, int n);
 void currangearr_double_if_full(CurRangeArr *arr);
 void currangearr_build_hash(CurRangeArr *arr);
+struct serial_index_hash;
+int currange_filter_excludes(struct serial_index_hash *ih, const void *key,
+                             int keylen);
 void currangearr_free(CurRangeArr *arr);
 void currangearr_print(CurRangeArr *arr);
 void currange_free(CurRange *cr);
@@ -714,6 +748,7 @@ struct sqlclntstate {
     struct sql_hist_cost spcost;
 
     int planner_effort;
+    int queue_priority; /* higher runs first within its sql queue class */
     int osql_max_trans;
     /* read-set validation */
     CurRangeArr *arr;
@@ -752,7 +787,7 @@ struct sqlclntstate {
 
     int8_t has_recording;
     int8_t is_retry;
-    int8_t get_cost;
+    int8_t get_cost; /* 2 is "set getcost analyze" */
     int8_t is_explain;
     uint8_t is_analyze;
     uint8_t is_overlapping;
@@ -773,6 +808,8 @@ struct sqlclntstate {
 
     int verify_remote_schemas;
 
+    struct result_cache_run *rcache; /* statement in the result cache */
+
     /* sharding scheme */
     dohsql_t *conns;
     int nconns;
@@ -817,6 +854,18 @@ struct sqlclntstate {
     LINKC_T(struct sqlclntstate) lnk;
 };
 
+/* What the cursors on a table or index cost a statement, gathered while the
+   client has "set getcost analyze" on */
+struct cursor_cost {
+    uint64_t nrows;       /* moves and finds that landed on a row */
+    uint64_t npages;      /* pages got from the buffer pool */
+    uint64_t nreads;      /* pages read from disk */
+    uint64_t lockwait_us;
+    uint64_t convert_us;  /* turning ondisk rows into sqlite records */
+    uint64_t write_bytes; /* written to disk; for temp tables, spills */
+    uint64_t us;
+};
+
 /* Query stats. */
 struct query_path_component {
     char lcl_tbl_name[MAXTABLELEN];
@@ -826,6 +875,7 @@ struct query_path_component {
     int nnext;
     int nwrite;
     int nblobs;
+    struct cursor_cost analyze;
     LINKC_T(struct query_path_component) lnk;
 };
 
@@ -904,6 +954,7 @@ struct BtCursor {
     int dtabuflen;
     void *keybuf;
     int keybuflen;
+    uint8_t keybuf_stale; /* keybuf not yet built from lastkey */
 
     int dtabuf_alloc;
     int keybuf_alloc;
@@ -957,6 +1008,9 @@ struct BtCursor {
 
     /* move me */
     int (*cursor_move)(BtCursor *, int *pRes, int how);
+    /* set getcost analyze: cursor_move is a wrapper that times this */
+    int (*analyzed_move)(BtCursor *, int *pRes, int how);
+    struct cursor_cost analyze;
     /* temptables have these -- lua ones need locking */
     int (*cursor_del)(bdb_state_type *, struct temp_cursor *, int *bdberr,
                       BtCursor *);
@@ -1000,6 +1054,9 @@ struct BtCursor {
     unsigned long long col_mask; /* tracking first 63 columns, if bit is set,
                                     column is needed */
 
+    struct cursor_filter *filter; /* simple WHERE terms a table scan checks
+                                     before handing a row to sqlite */
+
     unsigned long long keyDdl; /* rowid for side DDL row */
     char *dataDdl;             /* DDL row, cached during CREATE operations */
     int nDataDdl;   /* length of the cached row for DDL instructions */
@@ -1023,6 +1080,7 @@ struct sql_thread {
     struct Btree *bt, *bttmp;
     int startms;
     int prepms;
+    uint64_t prepus;
     int stime;
     int nmove;
     int nfind;
@@ -1059,6 +1117,11 @@ struct connection_info {
     cdb2_client_datetime_t last_reset_time;
     char *state;
     char *sql;
+    char *compression;
+    int64_t raw_bytes_out;
+    int64_t wire_bytes_out;
+    int64_t raw_bytes_in;
+    int64_t wire_bytes_in;
 
     /* latched in sqlinterfaces, not returned */ 
     time_t connect_time_int;
@@ -1151,6 +1214,10 @@ void comdb2_set_tmptbl_lk(pthread_mutex_t *);
 struct temptable get_tbl_by_rootpg(const sqlite3 *, int);
 void clone_temp_table(sqlite3 *, const sqlite3 *, const char *,
                       struct temptable *);
+/* Run a read-only query from a thread that isn't a sql engine thread,
+   passing each row to row(); stops early if row() returns non-zero */
+int run_sql_query_rows(const char *sql, int (*row)(void *, sqlite3_stmt *),
+                       void *arg);
 int sqlengine_prepare_engine(struct sqlthdstate *, struct sqlclntstate *,
                              int recreate);
 int sqlserver2sqlclient_error(int rc);
@@ -1222,7 +1289,17 @@ void clnt_query_cost(struct sqlthdstate *thd, double *pCost, int64_t *pPrepMs);
 void calc_fingerprint(const char *zNormSql, size_t *pnNormSql,
                       unsigned char fingerprint[FINGERPRINTSZ]);
 void add_fingerprint(const char *, const char *, int64_t, int64_t, int64_t,
-                     int64_t, struct reqlogger *, unsigned char *fingerprint_out);
+                     int64_t, int64_t latencyus, struct reqlogger *,
+                     unsigned char *fingerprint_out);
+/* 1: run it and call fingerprint_release(), 0: not limited, -1: reject */
+int fingerprint_admit(const char *zNormSql,
+                      unsigned char fingerprint[FINGERPRINTSZ]);
+void fingerprint_release(const unsigned char fingerprint[FINGERPRINTSZ]);
+/* Note the plan a run of this fingerprint used, and warn if the plan changed
+   and runs got costlier */
+void fingerprint_check_plan(const unsigned char fingerprint[FINGERPRINTSZ],
+                            const struct client_query_stats *stats,
+                            int64_t cost);
 
 long long run_sql_return_ll(const char *query, struct errstat *err);
 long long run_sql_thd_return_ll(const char *query, struct sql_thread *thd,
@@ -22,6 +22,7 @@
 #include <sys/types.h>
 #include <netinet/in.h>
 #include <inttypes.h>
+#include <math.h>
 #include <pthread.h>
 #include <epochlib.h>
 #include "analyze.h"
@@ -37,6 +38,7 @@
 #include <ctrace.h>
 #include <logmsg.h>
 #include "str0.h"
+#include "tohex.h"
 
 /* amount of thread-memory initialized for this thread */
 #ifndef PER_THREAD_MALLOC
@@ -73,6 +75,9 @@ int analyze_max_comp_threads = 10;
 /* current number of analyze-sampling threads */
 static int analyze_cur_comp_threads = 0;
 
+/* analyze's cursors are the first to go in a deadlock */
+int gbl_analyze_lowpri = 1;
+
 /* table-thread mutex */
 static pthread_mutex_t table_thd_mutex = PTHREAD_MUTEX_INITIALIZER;
 
@@ -122,6 +127,7 @@ typedef struct table_descriptor {
     SBUF2 *sb;
     int scale;
     int override_llmeta;
+    int incremental; /* fold in the index sketches instead of scanning */
     index_descriptor_t index[MAXINDEX];
 } table_descriptor_t;
 
@@ -849,6 +855,15 @@ static int analyze_table_int(table_descriptor_t *td,
     rc = run_internal_sql_clnt(&clnt, "COMMIT");
     if (rc) snprintf(zErrTab, sizeof(zErrTab), "COMMIT");
 
+    /* rows may have drifted from the last zstd dictionary; retrain it (the
+     * master does, replicants pick it up from llmeta) */
+    if (rc == 0)
+        bdb_zstd_train_dict(tbl->handle);
+
+    /* the index scans rebuild the unique key filters too */
+    if (rc == 0)
+        bdb_ixbloom_build(tbl->handle);
+
 cleanup:
     sbuf2flush(sb2);
     sbuf2free(sb2);
@@ -873,6 +888,397 @@ error:
     goto cleanup;
 }
 
+/* most key columns incremental analyze adjusts; the rest are kept */
+#define INCR_MAXCOLS 64
+
+/* a row of sqlite_stat1 (stat) or sqlite_stat4 (neq, nlt, ndlt, sample) */
+struct incr_stat {
+    char *idx;
+    char *val[3];
+    void *sample;
+    int samplelen;
+};
+
+struct incr_stats {
+    int n;
+    int alloc;
+    struct incr_stat *rows;
+};
+
+static char *incr_column_dup(sqlite3_stmt *stmt, int col)
+{
+    const char *s = (const char *)sqlite3_column_text(stmt, col);
+    return strdup(s ? s : "");
+}
+
+static int incr_stat_row(void *arg, sqlite3_stmt *stmt)
+{
+    struct incr_stats *st = arg;
+    struct incr_stat *r;
+    int ncols = sqlite3_column_count(stmt);
+
+    if (st->n == st->alloc) {
+        int alloc = st->alloc ? st->alloc * 2 : 16;
+        struct incr_stat *rows = realloc(st->rows, alloc * sizeof(*rows));
+        if (rows == NULL)
+            return -1;
+        st->rows = rows;
+        st->alloc = alloc;
+    }
+    r = &st->rows[st->n++];
+    memset(r, 0, sizeof(*r));
+    r->idx = incr_column_dup(stmt, 0);
+    for (int i = 1; i < ncols && i <= 3; i++)
+        r->val[i - 1] = incr_column_dup(stmt, i);
+    if (ncols > 4) {
+        r->samplelen = sqlite3_column_bytes(stmt, 4);
+        r->sample = malloc(r->samplelen ? r->samplelen : 1);
+        if (r->sample)
+            memcpy(r->sample, sqlite3_column_blob(stmt, 4), r->samplelen);
+    }
+    return 0;
+}
+
+static void incr_stats_free(struct incr_stats *st)
+{
+    for (int i = 0; i < st->n; i++) {
+        free(st->rows[i].idx);
+        for (int j = 0; j < 3; j++)
+            free(st->rows[i].val[j]);
+        free(st->rows[i].sample);
+    }
+    free(st->rows);
+    memset(st, 0, sizeof(*st));
+}
+
+/* parse up to max leading integers; *rest points past them */
+static int incr_parse_ints(const char *s, double *v, int max,
+                           const char **rest)
+{
+    int n = 0;
+    char *end;
+
+    while (n < max) {
+        while (*s == ' ')
+            s++;
+        if (*s < '0' || *s > '9')
+            break;
+        v[n++] = strtod(s, &end);
+        s = end;
+    }
+    if (rest)
+        *rest = s;
+    return n;
+}
+
+static void incr_format_ints(char *buf, size_t len, const double *v, int n,
+                             const char *rest)
+{
+    int off = 0;
+    for (int i = 0; i < n && off < len; i++)
+        off += snprintf(buf + off, len - off, "%s%lld", i ? " " : "",
+                        (long long)v[i]);
+    if (rest && *rest && off < len)
+        snprintf(buf + off, len - off, "%s", rest);
+}
+
+/* How an index's stats change, computed from stat1 and the sketch */
+struct incr_scale {
+    double n0, n;
+    int ncols;
+    double eq[INCR_MAXCOLS];  /* rows per prefix value, new/old */
+    double dlt[INCR_MAXCOLS]; /* distinct prefix values, new/old */
+};
+
+/* New stat1 values for one index.  Returns 0 and fills in newstat, or -1
+   if the sketch has nothing for this index. */
+static int incr_index_stat1(struct dbtable *tbl, int ixnum, const char *stat,
+                            char *newstat, size_t len, struct incr_scale *sc)
+{
+    double v[INCR_MAXCOLS + 1], distinct[INCR_MAXCOLS];
+    int64_t nadds, ndels;
+    const char *rest;
+    int nv, nprefix;
+    int unique = !(tbl->ixschema[ixnum]->flags & SCHEMA_DUP);
+
+    nprefix =
+        ixsketch_get_stats(tbl, ixnum, &nadds, &ndels, distinct, INCR_MAXCOLS);
+    if (nprefix < 0)
+        return -1;
+    nv = incr_parse_ints(stat, v, INCR_MAXCOLS + 1, &rest);
+    if (nv < 1)
+        return -1;
+
+    sc->n0 = v[0];
+    sc->n = v[0] + nadds - ndels;
+    if (sc->n < 1)
+        sc->n = 1;
+    sc->ncols = nv - 1;
+
+    for (int j = 0; j < sc->ncols; j++) {
+        double a0 = v[j + 1] >= 1 ? v[j + 1] : 1;
+        double d0 = sc->n0 / a0, d, a;
+
+        if (j >= nprefix) {
+            /* columns we don't sketch (the genid): keep rows per value */
+            sc->eq[j] = 1;
+            sc->dlt[j] = sc->n0 > 0 ? sc->n / sc->n0 : 1;
+            continue;
+        }
+        if (unique && j == nprefix - 1) {
+            d = sc->n;
+        } else {
+            /* The added rows had distinct[j] values for this prefix.  If
+               they were mostly different from each other they were likely
+               new values too; if they repeated, likely existing ones. */
+            double h = distinct[j];
+            double f = nadds > 0 ? h / nadds : 0;
+            d = d0 + h * f;
+            if (d < h)
+                d = h;
+        }
+        if (d > sc->n)
+            d = sc->n;
+        if (d < 1)
+            d = 1;
+        a = ceil(sc->n / d);
+        v[j + 1] = a;
+        sc->eq[j] = a / a0;
+        sc->dlt[j] = d0 > 0 ? d / d0 : 1;
+    }
+    v[0] = sc->n;
+    incr_format_ints(newstat, len, v, nv, rest);
+    return 0;
+}
+
+/* New stat4 values for a sample, scaling the old counts like stat1 */
+static void incr_index_stat4(const struct incr_scale *sc, char **val,
+                             char *neq, char *nlt, char *ndlt, size_t len)
+{
+    double eq[INCR_MAXCOLS], lt[INCR_MAXCOLS], dlt[INCR_MAXCOLS];
+    double grow = sc->n0 > 0 ? sc->n / sc->n0 : 1;
+    int n = incr_parse_ints(val[0], eq, INCR_MAXCOLS, NULL);
+    int nl = incr_parse_ints(val[1], lt, INCR_MAXCOLS, NULL);
+    int nd = incr_parse_ints(val[2], dlt, INCR_MAXCOLS, NULL);
+
+    for (int j = 0; j < n; j++) {
+        double f = j < sc->ncols ? sc->eq[j] : 1;
+        eq[j] = floor(eq[j] * f + 0.5);
+        if (eq[j] < 1)
+            eq[j] = 1;
+    }
+    for (int j = 0; j < nl; j++)
+        lt[j] = floor(lt[j] * grow + 0.5);
+    for (int j = 0; j < nd; j++) {
+        double f = j < sc->ncols ? sc->dlt[j] : grow;
+        dlt[j] = floor(dlt[j] * f + 0.5);
+    }
+    incr_format_ints(neq, len, eq, n, NULL);
+    incr_format_ints(nlt, len, lt, nl, NULL);
+    incr_format_ints(ndlt, len, dlt, nd, NULL);
+}
+
+static int incr_run(struct sqlclntstate *clnt, char *sql, char *zErrTab,
+                    size_t errlen)
+{
+    int rc;
+    assert(sql != NULL);
+    rc = run_internal_sql_clnt(clnt, sql);
+    if (rc)
+        strncpy0(zErrTab, sql, errlen);
+    sqlite3_free(sql);
+    return rc;
+}
+
+/* Fold the index sketches into the table's existing stats.  The old stats
+   are saved as cdb2.<table>.sav, like a full analyze does, so they can be
+   backed out. */
+static int analyze_table_incremental_int(table_descriptor_t *td)
+{
+    char zErrTab[256] = {0};
+    struct incr_stats stat1 = {0}, stat4 = {0};
+    struct incr_scale *scale = NULL;
+    int have_stat4 = get_dbtable_by_name("sqlite_stat4") != NULL;
+    char *sql;
+    int rc;
+
+    struct dbtable *tbl = get_dbtable_by_name(td->table);
+    if (!tbl) {
+        sbuf2printf(td->sb, "?Cannot find table '%s'\n", td->table);
+        return -1;
+    }
+    if (!ixsketch_covers(tbl)) {
+        sbuf2printf(td->sb, "?No index sketches cover all changes to '%s' "
+                            "since it was last analyzed\n",
+                    td->table);
+        return -1;
+    }
+
+    sql = sqlite3_mprintf("select idx, stat from sqlite_stat1 where tbl = %Q",
+                          td->table);
+    rc = run_sql_query_rows(sql, incr_stat_row, &stat1);
+    sqlite3_free(sql);
+    if (rc == 0 && have_stat4) {
+        sql = sqlite3_mprintf("select idx, neq, nlt, ndlt, sample from "
+                              "sqlite_stat4 where tbl = %Q",
+                              td->table);
+        rc = run_sql_query_rows(sql, incr_stat_row, &stat4);
+        sqlite3_free(sql);
+    }
+    if (rc) {
+        sbuf2printf(td->sb, "?Can't read the stats for table '%s'\n",
+                    td->table);
+        goto done;
+    }
+
+    logmsg(LOGMSG_INFO, "Incremental analyze starting, table %s\n",
+           td->table);
+
+    SBUF2 *sb2 = sbuf2open(fileno(stdout), 0);
+    struct sqlclntstate clnt;
+    start_internal_sql_clnt(&clnt);
+    clnt.osql_max_trans = 0;
+    clnt.sb = sb2;
+    sbuf2settimeout(clnt.sb, 0, 0);
+
+    scale = calloc(tbl->nix ? tbl->nix : 1, sizeof(struct incr_scale));
+    if (scale == NULL) {
+        rc = -1;
+        snprintf(zErrTab, sizeof(zErrTab), "malloc");
+        goto cleanup;
+    }
+
+    rc = run_internal_sql_clnt(&clnt, "BEGIN");
+    if (rc) {
+        snprintf(zErrTab, sizeof(zErrTab), "BEGIN");
+        goto cleanup;
+    }
+
+    rc = incr_run(&clnt,
+                  sqlite3_mprintf("delete from sqlite_stat1 where "
+                                  "tbl='cdb2.%q.sav'",
+                                  td->table),
+                  zErrTab, sizeof(zErrTab));
+    if (rc == 0)
+        rc = incr_run(&clnt,
+                      sqlite3_mprintf("insert into sqlite_stat1 select "
+                                      "'cdb2.%q.sav', idx, stat from "
+                                      "sqlite_stat1 where tbl='%q'",
+                                      td->table, td->table),
+                      zErrTab, sizeof(zErrTab));
+    if (rc == 0 && have_stat4)
+        rc = incr_run(&clnt,
+                      sqlite3_mprintf("delete from sqlite_stat4 where "
+                                      "tbl='cdb2.%q.sav'",
+                                      td->table),
+                      zErrTab, sizeof(zErrTab));
+    if (rc == 0 && have_stat4)
+        rc = incr_run(&clnt,
+                      sqlite3_mprintf("insert into sqlite_stat4 select "
+                                      "'cdb2.%q.sav', idx, neq, nlt, ndlt, "
+                                      "sample from sqlite_stat4 where "
+                                      "tbl='%q'",
+                                      td->table, td->table),
+                      zErrTab, sizeof(zErrTab));
+    if (rc)
+        goto error;
+
+    for (int i = 0; i < tbl->nix; i++) {
+        const char *ixname = tbl->ixschema[i]->sqlitetag;
+        struct incr_stat *r = NULL;
+        char newstat[1024];
+
+        for (int k = 0; k < stat1.n; k++) {
+            if (strcmp(stat1.rows[k].idx, ixname) == 0) {
+                r = &stat1.rows[k];
+                break;
+            }
+        }
+        if (r == NULL) {
+            rc = -1;
+            snprintf(zErrTab, sizeof(zErrTab),
+                     "no stats for index %s, a full analyze is needed",
+                     ixname);
+            goto error;
+        }
+        if (incr_index_stat1(tbl, i, r->val[0], newstat, sizeof(newstat),
+                             &scale[i]) != 0) {
+            rc = -1;
+            snprintf(zErrTab, sizeof(zErrTab), "no sketch for index %s",
+                     ixname);
+            goto error;
+        }
+        rc = incr_run(&clnt,
+                      sqlite3_mprintf("update sqlite_stat1 set stat=%Q where "
+                                      "tbl=%Q and idx=%Q",
+                                      newstat, td->table, ixname),
+                      zErrTab, sizeof(zErrTab));
+        if (rc)
+            goto error;
+
+        for (int k = 0; k < stat4.n; k++) {
+            struct incr_stat *s = &stat4.rows[k];
+            char neq[1024], nlt[1024], ndlt[1024];
+            char *hex;
+
+            if (strcmp(s->idx, ixname) != 0 || s->sample == NULL)
+                continue;
+            incr_index_stat4(&scale[i], s->val, neq, nlt, ndlt, sizeof(neq));
+            hex = malloc(2 * s->samplelen + 1);
+            if (hex == NULL) {
+                rc = -1;
+                snprintf(zErrTab, sizeof(zErrTab), "malloc");
+                goto error;
+            }
+            util_tohex(hex, s->sample, s->samplelen);
+            rc = incr_run(&clnt,
+                          sqlite3_mprintf("update sqlite_stat4 set neq=%Q, "
+                                          "nlt=%Q, ndlt=%Q where tbl=%Q and "
+                                          "idx=%Q and sample=x'%s'",
+                                          neq, nlt, ndlt, td->table, ixname,
+                                          hex),
+                          zErrTab, sizeof(zErrTab));
+            free(hex);
+            if (rc)
+                goto error;
+        }
+    }
+
+    rc = run_internal_sql_clnt(&clnt, "COMMIT");
+    if (rc) {
+        snprintf(zErrTab, sizeof(zErrTab), "COMMIT");
+    } else {
+        /* get every sql engine to load the new stats */
+        int bdberr;
+        bdb_llog_analyze(thedb->bdb_env, 1, &bdberr);
+    }
+
+cleanup:
+    sbuf2flush(sb2);
+    sbuf2free(sb2);
+
+    if (rc) {
+        sbuf2printf(td->sb,
+                    "?Incremental analyze table %s. Error occurred with: %s\n",
+                    td->table, zErrTab);
+    } else {
+        sbuf2printf(td->sb, "?Incremental analyze completed table %s\n",
+                    td->table);
+        logmsg(LOGMSG_INFO, "Incremental analyze completed, table %s\n",
+               td->table);
+    }
+    end_internal_sql_clnt(&clnt);
+done:
+    free(scale);
+    incr_stats_free(&stat1);
+    incr_stats_free(&stat4);
+    return rc;
+
+error:
+    run_internal_sql_clnt(&clnt, "ROLLBACK");
+    goto cleanup;
+}
+
 /* spawn thread to analyze a table */
 static void *table_thread(void *arg)
 {
@@ -893,11 +1299,18 @@ static void *table_thread(void *arg)
     td->table_state = TABLE_RUNNING;
 
     /* analyze the table */
-    rc = analyze_table_int(td, thd_self);
+    if (td->incremental)
+        rc = analyze_table_incremental_int(td);
+    else
+        rc = analyze_table_int(td, thd_self);
 
     ctrace("analyze_table_int: Table %s, rc = %d\n", td->table, rc);
     /* mark the return */
     if (0 == rc) {
+        struct dbtable *tbl = get_dbtable_by_name(td->table);
+        if (tbl)
+            tbl->aa_incremental_runs =
+                td->incremental ? tbl->aa_incremental_runs + 1 : 0;
         td->table_state = TABLE_COMPLETE;
         if (thedb->master == gbl_mynode) { // reset directly
             ctrace("analyze: Analyzed Table %s, reseting counter to 0\n", td->table);
@@ -1030,8 +1443,8 @@ int get_analyze_abort_requested()
 }
 
 
-/* analyze 'table' */
-int analyze_table(char *table, SBUF2 *sb, int scale, int override_llmeta)
+static int analyze_table_mode(char *table, SBUF2 *sb, int scale,
+                              int override_llmeta, int incremental)
 {
     if (check_stat1(sb))
         return -1;
@@ -1052,6 +1465,7 @@ int analyze_table(char *table, SBUF2 *sb, int scale, int override_llmeta)
     td.sb = sb;
     td.scale = scale;
     td.override_llmeta = override_llmeta;
+    td.incremental = incremental;
     strncpy0(td.table, table, sizeof(td.table));
 
     /* dispatch */
@@ -1080,6 +1494,17 @@ int analyze_table(char *table, SBUF2 *sb, int scale, int override_llmeta)
     return rc;
 }
 
+/* analyze 'table' */
+int analyze_table(char *table, SBUF2 *sb, int scale, int override_llmeta)
+{
+    return analyze_table_mode(table, sb, scale, override_llmeta, 0);
+}
+
+int analyze_table_incremental(char *table, SBUF2 *sb)
+{
+    return analyze_table_mode(table, sb, 0, 0, 1);
+}
+
 /* Analyze all tables in this database */
 int analyze_database(SBUF2 *sb, int scale, int override_llmeta)
 {
@@ -1101,11 +1101,16 @@ void get_one_explain_line(sqlite3 *hndl, strbuf *out, Vdbe *v, int indent,
     case OP_CursorHint:
         strbuf_appendf(out, "Cursor [%d] table ", op->p1);
         print_cursor_description(out, &cur[op->p1]);
-        char *descr = sqlite3ExprDescribe(hndl->pVdbe, op->p4.pExpr);
-        strbuf_appendf(out, " hint \"%s\"",
-                       (descr) ? descr : "(expression not parseable, see 592)");
-        if (descr)
-            sqlite3_free(descr);
+        if (op->p4type == P4_EXPR) {
+            char *descr = sqlite3ExprDescribe(hndl->pVdbe, op->p4.pExpr);
+            strbuf_appendf(out, " hint \"%s\"",
+                           (descr) ? descr
+                                   : "(expression not parseable, see 592)");
+            if (descr)
+                sqlite3_free(descr);
+        }
+        if (op->p2)
+            strbuf_appendf(out, " limit R%d", op->p2);
         break;
     case OP_SorterOpen:
         strbuf_appendf(out, "Open sorter new table with %d field(s) and cursor "
@@ -1149,6 +1154,15 @@ void get_one_explain_line(sqlite3 *hndl, strbuf *out, Vdbe *v, int indent,
                             "and fall through to next instruction",
                        op->p1, op->p2);
         break;
+    case OP_FilterAdd:
+        strbuf_appendf(out, "Add key R%d..R%d to bloom filter R%d", op->p3,
+                       op->p3 + op->p4.i - 1, op->p1);
+        break;
+    case OP_Filter:
+        strbuf_appendf(out, "If key R%d..R%d is not in bloom filter R%d "
+                            "go to %d",
+                       op->p3, op->p3 + op->p4.i - 1, op->p1, op->p2);
+        break;
 
     case OP_ParseSchema:
         strbuf_append(out, "Read and parse all entries from the MASTER tables");
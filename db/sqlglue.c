@@ -93,6 +93,7 @@
 #include "fdb_fend.h"
 #include "fdb_access.h"
 #include "bdb_osqlcur.h"
+#include "dohsql.h"
 
 #include "debug_switches.h"
 #include "logmsg.h"
@@ -101,6 +102,8 @@
 
 #include "str0.h"
 #include "comdb2_atomic.h"
+#include "lrucache.h"
+#include "thread_stats.h"
 
 unsigned long long get_id(bdb_state_type *);
 
@@ -323,6 +326,121 @@ static inline void currangearr_coalesce(CurRangeArr *arr)
     currangearr_merge_neighbor(arr);
 }
 
+/* Indexes with at least this many read ranges get a range filter, so that a
+   committed write is checked in log time instead of against every range. */
+int gbl_serial_range_filter_min = 8;
+
+static uint64_t currange_project(const void *key, int nprefix)
+{
+    const unsigned char *k = key;
+    uint64_t v = 0;
+    for (int i = 0; i < nprefix; i++)
+        v = (v << 8) | k[i];
+    return v;
+}
+
+static int range_filter_cmp(const void *p, const void *q)
+{
+    const struct serial_range_filter *l = p;
+    const struct serial_range_filter *r = q;
+    if (l->lo != r->lo)
+        return l->lo < r->lo ? -1 : 1;
+    return 0;
+}
+
+/* Project the ranges of an index onto the first nprefix bytes of the key,
+   which every bound has, and merge them into a sorted list of disjoint
+   intervals.  A bound <= key over the bound's length implies the same
+   for the projection, so a key that misses the intervals misses every
+   range, and only a hit needs the precise check. */
+static int currange_build_filter(void *obj, void *arg)
+{
+    struct serial_index_hash *ih = obj;
+    CurRangeArr *arr = arg;
+    struct serial_range_filter *f;
+    int nprefix = sizeof(uint64_t);
+    int i, n;
+
+    ih->nprefix = 0;
+    ih->nfilter = 0;
+    ih->filter = NULL;
+    if (gbl_serial_range_filter_min <= 0 ||
+        ih->end - ih->begin + 1 < gbl_serial_range_filter_min)
+        return 0;
+
+    for (i = ih->begin; i <= ih->end; i++) {
+        CurRange *r = arr->ranges[i];
+        if (!r->lflag) {
+            if (!r->lkey)
+                return 0;
+            if (r->lkeylen < nprefix)
+                nprefix = r->lkeylen;
+        }
+        if (!r->rflag) {
+            if (!r->rkey)
+                return 0;
+            if (r->rkeylen < nprefix)
+                nprefix = r->rkeylen;
+        }
+    }
+    if (nprefix <= 0)
+        return 0;
+
+    f = malloc(sizeof(struct serial_range_filter) * (ih->end - ih->begin + 1));
+    if (f == NULL)
+        return 0;
+    for (i = ih->begin, n = 0; i <= ih->end; i++) {
+        CurRange *r = arr->ranges[i];
+        f[n].lo = r->lflag ? 0 : currange_project(r->lkey, nprefix);
+        f[n].hi = r->rflag ? UINT64_MAX : currange_project(r->rkey, nprefix);
+        if (f[n].lo <= f[n].hi)
+            n++;
+    }
+    qsort(f, n, sizeof(struct serial_range_filter), range_filter_cmp);
+    for (i = 1, ih->nfilter = n ? 1 : 0; i < n; i++) {
+        struct serial_range_filter *last = &f[ih->nfilter - 1];
+        if (f[i].lo <= last->hi || f[i].lo - 1 == last->hi) {
+            if (f[i].hi > last->hi)
+                last->hi = f[i].hi;
+        } else {
+            f[ih->nfilter++] = f[i];
+        }
+    }
+    ih->nprefix = nprefix;
+    ih->filter = f;
+    return 0;
+}
+
+static int currange_build_tbl_filters(void *obj, void *arg)
+{
+    struct serial_tbname_hash *th = obj;
+    if (!th->islocked)
+        hash_for(th->idx_hash, currange_build_filter, arg);
+    return 0;
+}
+
+/* Return 1 if key cannot be in any read range of the index */
+int currange_filter_excludes(struct serial_index_hash *ih, const void *key,
+                             int keylen)
+{
+    int lo = 0, hi = ih->nfilter - 1;
+    uint64_t v;
+
+    if (ih->filter == NULL || keylen < ih->nprefix)
+        return 0;
+    v = currange_project(key, ih->nprefix);
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (v < ih->filter[mid].lo)
+            hi = mid - 1;
+        else if (v > ih->filter[mid].hi)
+            lo = mid + 1;
+        else
+            return 0;
+    }
+    return 1;
+}
+
 void currangearr_build_hash(CurRangeArr *arr)
 {
     if (arr->size == 0)
@@ -361,12 +479,14 @@ void currangearr_build_hash(CurRangeArr *arr)
             }
         }
     }
+    hash_for(range_hash, currange_build_tbl_filters, arr);
     arr->hash = range_hash;
 }
 
 static int free_idxhash(void *obj, void *arg)
 {
     struct serial_index_hash *ih = (struct serial_index_hash *)obj;
+    free(ih->filter);
     free(ih);
     return 0;
 }
@@ -773,11 +893,12 @@ void done_sql_thread(void)
     bdb_temp_table_maybe_reset_priority_thread(thedb->bdb_env, 1);
 }
 
-static int ondisk_to_sqlite_tz(struct dbtable *db, struct schema *s, void *inp,
-                               int rrn, unsigned long long genid, void *outp,
-                               int maxout, int nblobs, void **blob,
-                               size_t *blobsz, size_t *bloboffs, int *reqsize,
-                               const char *tzname, BtCursor *pCur)
+static int ondisk_to_sqlite_tz_int(struct dbtable *db, struct schema *s,
+                                   void *inp, int rrn, unsigned long long genid,
+                                   void *outp, int maxout, int nblobs,
+                                   void **blob, size_t *blobsz,
+                                   size_t *bloboffs, int *reqsize,
+                                   const char *tzname, BtCursor *pCur)
 {
     unsigned char *out = (unsigned char *)outp, *in = (unsigned char *)inp;
     struct field *f;
@@ -886,6 +1007,95 @@ done:
     return rc;
 }
 
+static int ondisk_to_sqlite_tz(struct dbtable *db, struct schema *s, void *inp,
+                               int rrn, unsigned long long genid, void *outp,
+                               int maxout, int nblobs, void **blob,
+                               size_t *blobsz, size_t *bloboffs, int *reqsize,
+                               const char *tzname, BtCursor *pCur)
+{
+    int64_t start;
+    int rc;
+
+    if (pCur == NULL || pCur->analyzed_move == NULL)
+        return ondisk_to_sqlite_tz_int(db, s, inp, rrn, genid, outp, maxout,
+                                       nblobs, blob, blobsz, bloboffs, reqsize,
+                                       tzname, pCur);
+    start = comdb2_time_epochus();
+    rc = ondisk_to_sqlite_tz_int(db, s, inp, rrn, genid, outp, maxout, nblobs,
+                                 blob, blobsz, bloboffs, reqsize, tzname, pCur);
+    pCur->analyze.convert_us += comdb2_time_epochus() - start;
+    return rc;
+}
+
+/* set getcost analyze: what this thread did in berkdb across one cursor
+   operation is charged to the cursor */
+struct cursor_cost_snap {
+    int64_t us;
+    unsigned fgets;
+    unsigned preads;
+    unsigned pwrite_bytes;
+    uint64_t lockwait_us;
+};
+
+static void cursor_cost_start(struct cursor_cost_snap *snap)
+{
+    const struct berkdb_thread_stats *st = bdb_get_thread_stats();
+
+    snap->us = comdb2_time_epochus();
+    snap->fgets = st->n_memp_fgets;
+    snap->preads = st->n_preads;
+    snap->pwrite_bytes = st->pwrite_bytes;
+    snap->lockwait_us = st->lock_wait_time_us;
+}
+
+static void cursor_cost_end(BtCursor *pCur,
+                            const struct cursor_cost_snap *snap, int onrow)
+{
+    const struct berkdb_thread_stats *st = bdb_get_thread_stats();
+    struct cursor_cost *c = &pCur->analyze;
+
+    c->us += comdb2_time_epochus() - snap->us;
+    c->npages += st->n_memp_fgets - snap->fgets;
+    c->nreads += st->n_preads - snap->preads;
+    c->write_bytes += st->pwrite_bytes - snap->pwrite_bytes;
+    c->lockwait_us += st->lock_wait_time_us - snap->lockwait_us;
+    if (onrow)
+        c->nrows++;
+}
+
+static int cursor_move_analyzed(BtCursor *pCur, int *pRes, int how)
+{
+    struct cursor_cost_snap snap;
+    int rc;
+
+    cursor_cost_start(&snap);
+    rc = pCur->analyzed_move(pCur, pRes, how);
+    cursor_cost_end(pCur, &snap, rc == SQLITE_OK && *pRes == 0);
+    return rc;
+}
+
+int gbl_lazy_key_decode = 0;
+
+/* Index moves leave keybuf to be built from lastkey the first time sqlite
+   asks for the packed key; a scan that only reads raw columns never builds
+   it.  Columns are still limited to the cooked ones, as at move time. */
+static int cook_key(BtCursor *pCur)
+{
+    int rc;
+
+    if (!pCur->keybuf_stale)
+        return 0;
+    pCur->keybuf_stale = 0;
+    rc = ondisk_to_sqlite_tz(pCur->db, pCur->sc, pCur->lastkey, pCur->rrn,
+                             pCur->genid, pCur->keybuf, pCur->keybuf_alloc, 0,
+                             NULL, NULL, NULL, &pCur->keybuflen,
+                             pCur->clnt->tzname, pCur);
+    if (rc)
+        logmsg(LOGMSG_ERROR, "%s: ondisk_to_sqlite_tz error rc = %d\n",
+               __func__, rc);
+    return rc;
+}
+
 /* Convert comdb2 record to sqlite format. Return 0 on success, -1 on error,
    -2 if buffer not big enough (reqsize contains required size in this case) */
 static int ondisk_to_sqlite(struct dbtable *db, struct schema *s, void *inp, int rrn,
@@ -1782,7 +1992,10 @@ static int create_sqlmaster_record(struct dbtable *tbl, void *tran)
             struct schema *ondisk = tbl->schema;
             int datacopy_pos = 0;
             size_t need;
-            /* Add all fields from ONDISK to index */
+            /* Add all fields from ONDISK to index, or just the copied ones
+             * for datacopy(col, ...); datacopy[] then maps to the payload */
+            if (schema->partial_datacopy)
+                ondisk = schema->partial_datacopy;
             for (int ondisk_i = 0; ondisk_i < ondisk->nmembers; ++ondisk_i) {
                 int skip = 0;
                 struct field *ondisk_field = &ondisk->member[ondisk_i];
@@ -2474,6 +2687,328 @@ static int cursor_move_table(BtCursor *pCur, int *pRes, int how)
     return outrc;
 }
 
+/* Comparisons of a column against a value, and IS [NOT] NULL, taken from
+   the WHERE terms sqlite hints to a table scan.  Rows that fail one of them
+   are skipped here, without a trip through the VDBE, which still checks
+   every term of the rows we return.  Anything we are not sure to compare
+   exactly as sqlite would is left to sqlite.
+
+   Where the value converts exactly to the column's ondisk type, the term
+   keeps that ondisk image and rows are compared with a memcmp of the field
+   bytes, which sort like the values; nothing is decoded per row. */
+int gbl_sql_filter_pushdown = 1;
+int gbl_sql_filter_raw_compare = 1;
+
+#define CURSOR_FILTER_MAXTERMS 8
+#define CURSOR_FILTER_MAXSTR 64
+
+struct cursor_filter_term {
+    int col;
+    int op; /* TK_EQ..TK_GE, TK_ISNULL or TK_NOTNULL */
+    Mem val;
+    char str[CURSOR_FILTER_MAXSTR + 1];
+    int rawlen; /* ondisk image of val is in raw, if not 0 */
+    uint8_t raw[16];
+};
+
+struct cursor_filter {
+    int nterms;
+    struct cursor_filter_term term[CURSOR_FILTER_MAXTERMS];
+};
+
+static int cursor_filter_value(BtCursor *pCur, const Expr *e, Mem *aMem,
+                               struct cursor_filter_term *t)
+{
+    const Mem *r = NULL;
+    int neg = 0;
+    i64 ival;
+    double rval;
+
+    if (e->op == TK_UMINUS) {
+        neg = 1;
+        e = e->pLeft;
+    }
+    memset(&t->val, 0, sizeof(Mem));
+    switch (e->op) {
+    case TK_INTEGER:
+        if (e->flags & EP_IntValue)
+            ival = e->u.iValue;
+        else if (sqlite3DecOrHexToI64(e->u.zToken, &ival) != 0)
+            return 0;
+        t->val.u.i = neg ? -ival : ival;
+        t->val.flags = MEM_Int;
+        return 1;
+    case TK_FLOAT:
+        if (sqlite3AtoF(e->u.zToken, &rval, sqlite3Strlen30(e->u.zToken),
+                        SQLITE_UTF8) <= 0)
+            return 0;
+        t->val.u.r = neg ? -rval : rval;
+        t->val.flags = MEM_Real;
+        return 1;
+    case TK_STRING:
+        if (neg || strlen(e->u.zToken) > sizeof(t->str))
+            return 0;
+        t->val.n = strlen(e->u.zToken);
+        memcpy(t->str, e->u.zToken, t->val.n);
+        break;
+    case TK_REGISTER:
+    case TK_VARIABLE:
+        if (neg)
+            return 0;
+        if (e->op == TK_REGISTER && aMem)
+            r = &aMem[e->iTable];
+        else if (e->op == TK_VARIABLE && pCur->vdbe && e->iColumn > 0 &&
+                 e->iColumn <= pCur->vdbe->nVar)
+            r = &pCur->vdbe->aVar[e->iColumn - 1];
+        if (r == NULL)
+            return 0;
+        /* copy it; the register may be reused while we scan */
+        if ((r->flags & MEM_AffMask) == MEM_Int) {
+            t->val.u.i = r->u.i;
+            t->val.flags = MEM_Int;
+            return 1;
+        }
+        if ((r->flags & MEM_AffMask) == MEM_Real) {
+            t->val.u.r = r->u.r;
+            t->val.flags = MEM_Real;
+            return 1;
+        }
+        if ((r->flags & MEM_AffMask) != MEM_Str || (r->flags & MEM_Zero) ||
+            r->enc != SQLITE_UTF8 || r->n > sizeof(t->str))
+            return 0;
+        t->val.n = r->n;
+        memcpy(t->str, r->z, r->n);
+        break;
+    default:
+        return 0;
+    }
+    t->str[t->val.n] = 0;
+    t->val.z = t->str;
+    t->val.flags = MEM_Str | MEM_Static;
+    t->val.enc = SQLITE_UTF8;
+    return 1;
+}
+
+/* Fill in t->raw when the field bytes of the rows can be compared with it
+   directly.  Integers and reals are stored big-endian with the sign
+   flipped, so memcmp orders them like their values.  Strings are compared
+   with strncmp, since the bytes after the terminator are not ours. */
+static void cursor_filter_raw(const struct field *f,
+                              struct cursor_filter_term *t)
+{
+    const uint8_t *in;
+    int intype, inlen, outsz;
+    i64 ival;
+    double rval;
+
+    t->rawlen = 0;
+    if (!gbl_sql_filter_raw_compare)
+        return;
+    switch (f->type) {
+    case SERVER_BINT:
+    case SERVER_UINT:
+        if (!(t->val.flags & MEM_Int) || f->len > sizeof(t->raw))
+            return;
+        ival = flibc_htonll(t->val.u.i);
+        in = (uint8_t *)&ival;
+        inlen = sizeof(ival);
+        intype = CLIENT_INT;
+        break;
+    case SERVER_BREAL:
+        if (f->len > sizeof(t->raw))
+            return;
+        if (t->val.flags & MEM_Int) {
+            if (t->val.u.i > (1LL << 53) || t->val.u.i < -(1LL << 53))
+                return;
+            rval = (double)t->val.u.i;
+        } else {
+            rval = t->val.u.r;
+        }
+        /* -0.0 and 0.0 are equal but not the same bytes */
+        if (rval == 0 || rval != rval)
+            return;
+        if (f->len == 1 + sizeof(float) && (double)(float)rval != rval)
+            return;
+        rval = flibc_htond(rval);
+        in = (uint8_t *)&rval;
+        inlen = sizeof(rval);
+        intype = CLIENT_REAL;
+        break;
+    case SERVER_BCSTR:
+        if (t->val.n >= f->len - 1 || memchr(t->str, 0, t->val.n))
+            return;
+        t->rawlen = f->len;
+        return;
+    default:
+        return;
+    }
+    /* fails if the value is out of range for the column */
+    if (CLIENT_to_SERVER(in, inlen, intype, 0, NULL, NULL, t->raw, f->len,
+                         f->type, 0, &outsz, &f->convopts, NULL) != 0)
+        return;
+    t->rawlen = f->len;
+}
+
+static void cursor_filter_add(BtCursor *pCur, struct cursor_filter *flt,
+                              const Expr *e, Mem *aMem)
+{
+    struct cursor_filter_term *t;
+    const Expr *col, *val = NULL;
+    struct field *f;
+    int op = e->op;
+
+    if (op == TK_AND) {
+        cursor_filter_add(pCur, flt, e->pLeft, aMem);
+        cursor_filter_add(pCur, flt, e->pRight, aMem);
+        return;
+    }
+    if (flt->nterms >= CURSOR_FILTER_MAXTERMS)
+        return;
+
+    switch (op) {
+    case TK_ISNULL:
+    case TK_NOTNULL:
+        col = e->pLeft;
+        break;
+    case TK_EQ:
+    case TK_NE:
+    case TK_LT:
+    case TK_LE:
+    case TK_GT:
+    case TK_GE:
+        if (e->pLeft->op == TK_COLUMN) {
+            col = e->pLeft;
+            val = e->pRight;
+        } else {
+            /* 5 < x is x > 5 */
+            col = e->pRight;
+            val = e->pLeft;
+            if (op != TK_EQ && op != TK_NE)
+                op = (op == TK_LT) ? TK_GT : (op == TK_LE) ? TK_GE
+                   : (op == TK_GT) ? TK_LT : TK_LE;
+        }
+        break;
+    default:
+        return;
+    }
+    if (col->op != TK_COLUMN || col->iColumn < 0 ||
+        col->iColumn >= pCur->sc->nmembers)
+        return;
+
+    t = &flt->term[flt->nterms];
+    t->col = col->iColumn;
+    t->op = op;
+    t->rawlen = 0;
+    if (val) {
+        if (!cursor_filter_value(pCur, val, aMem, t))
+            return;
+        /* sqlite would convert one side of a text/number comparison */
+        f = &pCur->sc->member[t->col];
+        switch (f->type) {
+        case SERVER_BINT:
+        case SERVER_UINT:
+        case SERVER_BREAL:
+            if (!(t->val.flags & (MEM_Int | MEM_Real)))
+                return;
+            break;
+        case SERVER_BCSTR:
+            if (!(t->val.flags & MEM_Str))
+                return;
+            break;
+        default:
+            return;
+        }
+        cursor_filter_raw(f, t);
+    }
+    flt->nterms++;
+}
+
+static void cursor_filter_set(BtCursor *pCur, const Expr *pExpr, Mem *aMem)
+{
+    struct cursor_filter *flt = pCur->filter;
+
+    if (!gbl_sql_filter_pushdown || pCur->cursor_class != CURSORCLASS_TABLE)
+        return;
+    if (flt == NULL) {
+        if ((flt = malloc(sizeof(struct cursor_filter))) == NULL)
+            return;
+        pCur->filter = flt;
+    }
+    flt->nterms = 0;
+    cursor_filter_add(pCur, flt, pExpr, aMem);
+}
+
+static int cursor_filter_match(BtCursor *pCur)
+{
+    struct cursor_filter *flt = pCur->filter;
+    Mem m;
+    int c;
+
+    for (int i = 0; i < flt->nterms; i++) {
+        struct cursor_filter_term *t = &flt->term[i];
+
+        if (t->rawlen) {
+            const struct field *f = &pCur->sc->member[t->col];
+            const uint8_t *p = (uint8_t *)pCur->dtabuf + f->offset;
+
+            if (stype_is_null(p))
+                return 0;
+            if (f->type == SERVER_BCSTR)
+                c = strncmp((char *)p + 1, t->str, f->len - 1);
+            else
+                c = memcmp(p + 1, t->raw + 1, f->len - 1);
+            goto cmp;
+        }
+        memset(&m, 0, sizeof(Mem));
+        if (get_data(pCur, pCur->sc, pCur->dtabuf, t->col, &m, 0,
+                     pCur->clnt->tzname))
+            continue;
+        if (m.flags & MEM_Null) {
+            /* a comparison with NULL is never true */
+            if (t->op == TK_ISNULL)
+                continue;
+            return 0;
+        }
+        if (t->op == TK_ISNULL)
+            return 0;
+        if (t->op == TK_NOTNULL)
+            continue;
+        if ((m.flags & MEM_AffMask) & ~(MEM_Int | MEM_Real | MEM_Str))
+            continue;
+
+        c = sqlite3MemCompare(&m, &t->val, NULL);
+    cmp:
+        switch (t->op) {
+        case TK_EQ: c = (c == 0); break;
+        case TK_NE: c = (c != 0); break;
+        case TK_LT: c = (c < 0); break;
+        case TK_LE: c = (c <= 0); break;
+        case TK_GT: c = (c > 0); break;
+        case TK_GE: c = (c >= 0); break;
+        }
+        if (!c)
+            return 0;
+    }
+    return 1;
+}
+
+static int cursor_move_table_filter(BtCursor *pCur, int *pRes, int how)
+{
+    int rc;
+
+    while ((rc = cursor_move_table(pCur, pRes, how)) == SQLITE_OK &&
+           *pRes == 0 && pCur->filter && pCur->filter->nterms > 0 &&
+           !pCur->is_btree_count && !pCur->is_recording &&
+           !cursor_filter_match(pCur)) {
+        /* each skipped row still goes through sql_tick and the costs */
+        if (how == CFIRST)
+            how = CNEXT;
+        else if (how == CLAST)
+            how = CPREV;
+    }
+    return rc;
+}
+
 static int cursor_move_index(BtCursor *pCur, int *pRes, int how)
 {
     struct sql_thread *thd = pCur->thd;
@@ -2608,6 +3143,11 @@ static int cursor_move_index(BtCursor *pCur, int *pRes, int how)
             return outrc;
 
         /* if this cursor is on a key, convert key */
+        if (gbl_lazy_key_decode) {
+            pCur->keybuf_stale = 1;
+            return outrc;
+        }
+        pCur->keybuf_stale = 0;
         rc = ondisk_to_sqlite_tz(pCur->db, pCur->sc, pCur->lastkey /* in */,
                                  pCur->rrn, pCur->genid, pCur->keybuf /* out */,
                                  pCur->keybuf_alloc, 0, NULL, NULL, NULL,
@@ -3559,6 +4099,45 @@ int sqlite3BtreeLast(BtCursor *pCur, int *pRes)
     return rc;
 }
 
+int gbl_txn_chunk_throttle_ms = 0;
+
+/* SET TRANSACTION CHUNK N: once a statement has written N rows, what it sent
+ * is committed as a transaction of its own and the statement carries on in a
+ * new one, so its bplog and the replicated transaction stay bounded.  The
+ * chunk commits with the statement's locks let go, as in recovering from a
+ * deadlock, and txn_chunk_throttle_ms is slept before they are taken back. */
+static int chunk_transaction(struct sqlclntstate *clnt, struct sql_thread *thd)
+{
+    int rc;
+
+    if (clnt->dbtran.maxchunksize <= 0 ||
+        clnt->dbtran.mode != TRANLEVEL_SOSQL || clnt->dbtran.dtran ||
+        clnt->osql.running_ddl || clnt->has_recording ||
+        !clnt->osql.sock_started)
+        return SQLITE_OK;
+
+    if (++clnt->dbtran.crtchunksize < clnt->dbtran.maxchunksize)
+        return SQLITE_OK;
+    clnt->dbtran.crtchunksize = 0;
+
+    clnt->dbtran.chunk_commit = 1;
+    clnt->dbtran.chunk_rc = 0;
+    rc = recover_deadlock_flags(thedb->bdb_env, thd, NULL,
+                                gbl_txn_chunk_throttle_ms, __func__, __LINE__,
+                                0);
+    clnt->dbtran.chunk_commit = 0;
+    if (rc == 0)
+        rc = clnt->dbtran.chunk_rc;
+    if (rc == 0) {
+        /* rows are committed; a retry would write them twice */
+        osql_set_replay(__FILE__, __LINE__, clnt, OSQL_RETRY_LAST);
+    } else {
+        logmsg(LOGMSG_ERROR, "%s: failed to commit chunk rc=%d\n", __func__,
+               rc);
+    }
+    return rc;
+}
+
 /*forward*/
 
 /*
@@ -3697,6 +4276,8 @@ int sqlite3BtreeDelete(BtCursor *pCur, int usage)
             clnt->effects.num_deleted++;
             clnt->log_effects.num_deleted++;
             clnt->nrows++;
+            if (rc == SQLITE_OK)
+                rc = chunk_transaction(clnt, thd);
         } else {
             /* make sure we have a distributed transaction and use that to
              * update remote */
@@ -4103,6 +4684,8 @@ int sqlite3BtreeKey(BtCursor *pCur, u32 offset, u32 amt, void *pBuf)
         assert(amt == sizeof(pCur->genid));
         memcpy(pBuf, &pCur->genid, sizeof(pCur->genid));
     } else {
+        if (cook_key(pCur))
+            rc = SQLITE_INTERNAL;
         memcpy(pBuf, ((char *)pCur->keybuf) + offset, amt);
     }
 
@@ -4260,6 +4843,7 @@ i64 sqlite3BtreeIntegerKey(BtCursor *pCur)
         else
             size = pCur->rrn;
     } else {
+        cook_key(pCur);
         size = pCur->keybuflen;
     }
 
@@ -4550,6 +5134,7 @@ int sqlite3BtreeBeginTrans(Vdbe *vdbe, Btree *pBt, int wrflag, int *pSchemaVersi
 
     clnt->ins_keys = 0ULL;
     clnt->del_keys = 0ULL;
+    clnt->dbtran.crtchunksize = 0;
 
     if (gbl_expressions_indexes) {
         free_cached_idx(clnt->idxInsert);
@@ -5339,11 +5924,11 @@ static int bias_cmp(bias_info *info, void *found)
 **                  is larger than intKey/pIdxKey.
 **
 */
-int sqlite3BtreeMovetoUnpacked(BtCursor *pCur, /* The cursor to be moved */
-                               UnpackedRecord *pIdxKey, /* Unpacked index key */
-                               i64 intKey,              /* The table key */
-                               int bias, /* used to detect the vdbe operation */
-                               int *pRes) /* Write search results here */
+static int btree_moveto_unpacked(BtCursor *pCur, /* The cursor to be moved */
+                                 UnpackedRecord *pIdxKey, /* Unpacked index key */
+                                 i64 intKey,              /* The table key */
+                                 int bias, /* used to detect the vdbe operation */
+                                 int *pRes) /* Write search results here */
 {
     int rc = SQLITE_OK;
     void *buf = NULL;
@@ -5837,6 +6422,7 @@ int sqlite3BtreeMovetoUnpacked(BtCursor *pCur, /* The cursor to be moved */
 #endif
             pCur->eof = 0;
             pCur->lastkey = pCur->fndkey;
+            pCur->keybuf_stale = 0;
             rc = ondisk_to_sqlite_tz(pCur->db, pCur->sc, pCur->fndkey,
                                      pCur->rrn, pCur->genid, pCur->keybuf,
                                      pCur->keybuf_alloc, 0, NULL, NULL, NULL,
@@ -5944,6 +6530,20 @@ done:
     return rc;
 }
 
+int sqlite3BtreeMovetoUnpacked(BtCursor *pCur, UnpackedRecord *pIdxKey,
+                               i64 intKey, int bias, int *pRes)
+{
+    struct cursor_cost_snap snap;
+    int rc;
+
+    if (pCur->analyzed_move == NULL)
+        return btree_moveto_unpacked(pCur, pIdxKey, intKey, bias, pRes);
+    cursor_cost_start(&snap);
+    rc = btree_moveto_unpacked(pCur, pIdxKey, intKey, bias, pRes);
+    cursor_cost_end(pCur, &snap, rc == SQLITE_OK && *pRes == 0);
+    return rc;
+}
+
 /*
  ** For the entry that cursor pCur is point to, return as
  ** many bytes of the key or data as are available on the local
@@ -5968,6 +6568,7 @@ const void *sqlite3BtreeKeyFetch(BtCursor *pCur, u32 *pAmt)
         *pAmt = bdb_temp_table_keysize(pCur->tmptable->cursor);
         goto done;
     }
+    cook_key(pCur);
     out = pCur->keybuf;
     *pAmt = pCur->keybuflen;
 done:
@@ -6197,6 +6798,13 @@ int sqlite3BtreeCloseCursor(BtCursor *pCur)
             /* note: we record writes in record routines on the master */
             qc->nwrite += pCur->nwrite;
             qc->nblobs += pCur->nblobs;
+            qc->analyze.nrows += pCur->analyze.nrows;
+            qc->analyze.npages += pCur->analyze.npages;
+            qc->analyze.nreads += pCur->analyze.nreads;
+            qc->analyze.lockwait_us += pCur->analyze.lockwait_us;
+            qc->analyze.convert_us += pCur->analyze.convert_us;
+            qc->analyze.write_bytes += pCur->analyze.write_bytes;
+            qc->analyze.us += pCur->analyze.us;
         }
     }
 
@@ -6233,6 +6841,7 @@ skip:
         }
         if (pCur->keybuf)
             free(pCur->keybuf);
+        free(pCur->filter);
 
         if (pCur->is_sampled_idx) {
             rc = sampler_close(pCur->sampler);
@@ -6381,6 +6990,124 @@ unsigned long long get_rowid(BtCursor *pCur)
     return pCur->genid;
 }
 
+/* Large blobs read by sql, shared by all threads.  The key has the full
+   genid of the row, which changes whenever the row is updated, and the
+   table version, which changes with its schema, so an entry can't go
+   stale; entries of deleted rows are just never found again. */
+int gbl_sql_blob_cache_mb = 0;
+int gbl_sql_blob_cache_min_kb = 16;
+
+#define SQL_BLOB_CACHE_SHARDS 16
+#define SQL_BLOB_CACHE_MAXENT (1 << 20)
+
+struct sql_blob_key {
+    char tablename[MAXTABLELEN];
+    unsigned long long tableversion;
+    unsigned long long genid;
+    int blobnum;
+    int pad;
+};
+
+struct sql_blob_ent {
+    struct sql_blob_key key;
+    lrucache_link lnk;
+    int len;
+    char data[];
+};
+
+static lrucache *sql_blob_cache;
+static pthread_once_t sql_blob_cache_once = PTHREAD_ONCE_INIT;
+
+static unsigned int sql_blob_hash(const void *key, int len)
+{
+    return hash_default_fixedwidth(key, len);
+}
+
+static int sql_blob_cmp(const void *key1, const void *key2, int len)
+{
+    return memcmp(key1, key2, len);
+}
+
+static void sql_blob_cache_init(void)
+{
+    sql_blob_cache = lrucache_init_concurrent(
+        sql_blob_hash, sql_blob_cmp, free, offsetof(struct sql_blob_ent, lnk),
+        offsetof(struct sql_blob_ent, key), sizeof(struct sql_blob_key),
+        SQL_BLOB_CACHE_MAXENT, SQL_BLOB_CACHE_SHARDS);
+}
+
+static int sql_blob_cache_on(BtCursor *pCur)
+{
+    /* shadow rows of our own transaction aren't anybody else's */
+    return gbl_sql_blob_cache_mb > 0 && !is_genid_synthetic(pCur->genid);
+}
+
+static void sql_blob_cache_key(BtCursor *pCur, int blobnum,
+                               struct sql_blob_key *key)
+{
+    memset(key, 0, sizeof(*key));
+    strncpy0(key->tablename, pCur->db->tablename, sizeof(key->tablename));
+    key->tableversion = pCur->db->tableversion;
+    key->genid = pCur->genid;
+    key->blobnum = blobnum;
+}
+
+/* Returns a copy the caller frees, or NULL if the blob isn't cached */
+static void *sql_blob_cache_find(BtCursor *pCur, int blobnum, int *len)
+{
+    struct sql_blob_key key;
+    struct sql_blob_ent *ent;
+    void *data;
+
+    pthread_once(&sql_blob_cache_once, sql_blob_cache_init);
+    sql_blob_cache_key(pCur, blobnum, &key);
+    if ((ent = lrucache_find(sql_blob_cache, &key)) == NULL)
+        return NULL;
+    if ((data = malloc(ent->len)) != NULL) {
+        memcpy(data, ent->data, ent->len);
+        *len = ent->len;
+    }
+    lrucache_release(sql_blob_cache, &key);
+    return data;
+}
+
+static void sql_blob_cache_add(BtCursor *pCur, int blobnum, const void *data,
+                               int len)
+{
+    struct sql_blob_ent *ent;
+    long long maxbytes = (long long)gbl_sql_blob_cache_mb << 20;
+
+    if (len < gbl_sql_blob_cache_min_kb * 1024LL || len > maxbytes / 4)
+        return;
+    pthread_once(&sql_blob_cache_once, sql_blob_cache_init);
+    if (sql_blob_cache->maxbytes != maxbytes)
+        lrucache_set_maxbytes(sql_blob_cache, maxbytes);
+    if ((ent = malloc(offsetof(struct sql_blob_ent, data) + len)) == NULL)
+        return;
+    sql_blob_cache_key(pCur, blobnum, &ent->key);
+    ent->len = len;
+    memcpy(ent->data, data, len);
+    /* another thread may have just added it */
+    if (lrucache_add_sized(sql_blob_cache, ent, len) != 0)
+        free(ent);
+}
+
+/* m takes over data */
+static void blob_to_mem(const struct field *f, Mem *m, void *data, int len)
+{
+    m->z = data;
+    m->n = len;
+    m->flags = MEM_Dyn;
+    m->xDel = free;
+
+    if (f->type == SERVER_VUTF8) {
+        m->flags |= MEM_Str;
+        if (m->n > 0)
+            --m->n; /* sqlite string lengths do not include NULL */
+    } else
+        m->flags |= MEM_Blob;
+}
+
 /*
  ** ADDON:
  ** this function is also called for recom/snapisol/serial
@@ -6413,6 +7140,15 @@ static int fetch_blob_into_sqlite_mem(BtCursor *pCur, struct schema *sc,
         thd->cost += pCur->blob_cost;
     }
 
+    if (sql_blob_cache_on(pCur)) {
+        int len;
+        void *data = sql_blob_cache_find(pCur, blobnum, &len);
+        if (data) {
+            blob_to_mem(f, m, data, len);
+            return 0;
+        }
+    }
+
 again:
     memcpy(&blobs, &pCur->blob_descriptor, sizeof(blobs));
 
@@ -6478,17 +7214,10 @@ again:
         m->z = NULL;
         m->flags = MEM_Null;
     } else {
-        m->z = blobs.blobptrs[0];
-        m->n = blobs.bloblens[0];
-        m->flags = MEM_Dyn;
-        m->xDel = free;
-
-        if (f->type == SERVER_VUTF8) {
-            m->flags |= MEM_Str;
-            if (m->n > 0)
-                --m->n; /* sqlite string lengths do not include NULL */
-        } else
-            m->flags |= MEM_Blob;
+        if (sql_blob_cache_on(pCur))
+            sql_blob_cache_add(pCur, blobnum, blobs.blobptrs[0],
+                               blobs.bloblens[0]);
+        blob_to_mem(f, m, blobs.blobptrs[0], blobs.bloblens[0]);
     }
 
     return 0;
@@ -6500,7 +7229,8 @@ int is_datacopy(BtCursor *pCur, int *fnum)
     /*if (nmembers == 0) return 0;*/
     if (pCur->ixnum >= 0 && pCur->db->ix_datacopy[pCur->ixnum] &&
         *fnum >= nmembers) {
-        /* Make fnum point to correct column as if rec is .ONDISK */
+        /* Make fnum point to correct column as if rec is .ONDISK (or the
+         * payload of a partial datacopy) */
         *fnum = pCur->sc->datacopy[*fnum - nmembers];
         return 1;
     }
@@ -6916,9 +7646,14 @@ int get_data(BtCursor *pCur, struct schema *sc, uint8_t *in, int fnum, Mem *m,
 
             in = (unsigned char *)new_in;
         } else if (pCur->ixnum >= 0 && pCur->db->ix_datacopy[pCur->ixnum]) {
+            struct schema *ixs = pCur->db->ixschema[pCur->ixnum];
             struct field *fidx = &(pCur->db->schema->member[f->idx]);
+            int offset = fidx->offset;
             assert(f->len == fidx->len);
-            in = pCur->bdbcur->datacopy(pCur->bdbcur) + fidx->offset;
+            if (ixs->partial_datacopy)
+                offset = partial_datacopy_offset(ixs, f->idx);
+            assert(offset >= 0);
+            in = pCur->bdbcur->datacopy(pCur->bdbcur) + offset;
         }
 
         decimal_ondisk_to_sqlite(in, f->len, (decQuad *)&m->du.tv.u.dec, &null);
@@ -6953,6 +7688,12 @@ int get_datacopy(BtCursor *pCur, int fnum, Mem *m)
     uint8_t *in;
 
     in = pCur->bdbcur->datacopy(pCur->bdbcur);
+
+    /* the columns of a partial datacopy don't move with the table's version */
+    struct schema *pd = pCur->db->ixschema[pCur->ixnum]->partial_datacopy;
+    if (pd)
+        return get_data(pCur, pd, in, fnum, m, 0, pCur->clnt->tzname);
+
     if (!is_genid_synthetic(pCur->genid)) {
         uint8_t ver = pCur->bdbcur->ver(pCur->bdbcur);
         vtag_to_ondisk_vermap(pCur->db, in, NULL, ver);
@@ -7792,6 +8533,8 @@ sqlite3BtreeCursor_cursor(Btree *pBt,      /* The btree */
         } else
             cur->cursor_class = CURSORCLASS_TABLE;
         cur->cursor_move = cursor_move_table;
+        if (cur->cursor_class == CURSORCLASS_TABLE)
+            cur->cursor_move = cursor_move_table_filter;
         cur->sc = cur->db->schema;
     } else {
         cur->cursor_class = CURSORCLASS_INDEX;
@@ -7943,6 +8686,12 @@ sqlite3BtreeCursor_cursor(Btree *pBt,      /* The btree */
         return rc;
     }
 
+    if (cur->ixnum == -1) {
+        int stripe = dohsql_scan_stripe(clnt, cur->db->tablename);
+        if (stripe >= 0)
+            cur->bdbcur->setstripe(cur->bdbcur, stripe);
+    }
+
     if (gbl_expressions_indexes && !clnt->isselect && cur->db->ix_expr) {
         if (!clnt->idxInsert)
             clnt->idxInsert = calloc(MAXINDEX, sizeof(uint8_t *));
@@ -8130,6 +8879,11 @@ int sqlite3BtreeCursor(
         cur->db->sqlcur_cur++;
     }
 
+    if (cur && clnt->get_cost == 2 && cur->cursor_move) {
+        cur->analyzed_move = cur->cursor_move;
+        cur->cursor_move = cursor_move_analyzed;
+    }
+
     if (thd && cur) {
         Pthread_mutex_lock(&thd->lk);
         listc_abl(&pBt->cursors, cur);
@@ -8231,7 +8985,7 @@ int sqlite3BtreeBeginStmt(Btree *pBt, int iStatement)
  ** to Hipp, sqlite won't use record id's again without first re-reading the
  ** record.
  */
-int sqlite3BtreeInsert(
+static int btree_insert(
     BtCursor *pCur, /* Insert data into the table of this cursor */
     const BtreePayload *pPayload, /* The key and data of the new record */
     int bias, int seekResult, int flags)
@@ -8516,6 +9270,8 @@ int sqlite3BtreeInsert(
                 clnt->log_effects.num_inserted++;
                 clnt->nrows++;
             }
+            if (rc == SQLITE_OK)
+                rc = chunk_transaction(clnt, thd);
         } else {
             /* make sure we have a distributed transaction and use that to
              * update remote */
@@ -8568,6 +9324,20 @@ done:
     return rc;
 }
 
+int sqlite3BtreeInsert(BtCursor *pCur, const BtreePayload *pPayload, int bias,
+                       int seekResult, int flags)
+{
+    struct cursor_cost_snap snap;
+    int rc;
+
+    if (pCur->analyzed_move == NULL)
+        return btree_insert(pCur, pPayload, bias, seekResult, flags);
+    cursor_cost_start(&snap);
+    rc = btree_insert(pCur, pPayload, bias, seekResult, flags);
+    cursor_cost_end(pCur, &snap, 0);
+    return rc;
+}
+
 /*
 ** Advance the cursor to the next entry in the database. 
 ** Return value:
@@ -8974,9 +9744,10 @@ int get_curtran_flags(bdb_state_type *bdb_state, struct sqlclntstate *clnt,
     int bdberr = 0;
     int max_retries =
         gbl_move_deadlk_max_attempt >= 0 ? gbl_move_deadlk_max_attempt : 500;
-    int lowpri = gbl_lowpri_snapisol_sessions &&
-                 (clnt->dbtran.mode == TRANLEVEL_SNAPISOL ||
-                  clnt->dbtran.mode == TRANLEVEL_SERIAL);
+    int lowpri = (gbl_lowpri_snapisol_sessions &&
+                  (clnt->dbtran.mode == TRANLEVEL_SNAPISOL ||
+                   clnt->dbtran.mode == TRANLEVEL_SERIAL)) ||
+                 (gbl_analyze_lowpri && clnt->is_analyze);
     int curtran_flags = lowpri ? BDB_CURTRAN_LOW_PRIORITY : 0;
     int rc = 0;
 
@@ -9283,6 +10054,11 @@ static int recover_deadlock_flags_int(bdb_state_type *bdb_state,
             return -300;
         }
     }
+
+    /* a chunk is committed holding no locks, so the master can apply it even
+       if it runs this statement itself */
+    if (clnt->dbtran.chunk_commit)
+        clnt->dbtran.chunk_rc = osql_sock_commit_chunk(clnt);
 #if 0
    sprintf(buf, "recover_deadlock put curtran tid %d\n", pthread_self());
    bdb_bdblock_print(thedb->bdb_env, buf);
@@ -10063,6 +10839,11 @@ void *get_lastkey(BtCursor *pCur)
     return pCur->is_sampled_idx ? sampler_key(pCur->sampler) : pCur->lastkey;
 }
 
+int key_is_raw(BtCursor *pCur)
+{
+    return pCur->keybuf_stale;
+}
+
 void set_cook_fields(BtCursor *pCur, int cols)
 {
     if (pCur) {
@@ -10782,10 +11563,16 @@ const char *comdb2_get_sql(void)
 }
 
 int gbl_fdb_track_hints = 0;
-static void sqlite3BtreeCursorHint_Range(BtCursor *pCur, const Expr *pExpr)
+static void sqlite3BtreeCursorHint_Range(BtCursor *pCur, const Expr *pExpr,
+                                         Mem *aMem)
 {
     char *expr = "?no vdbe engine?";
 
+    if (pCur && pCur->bt && !pCur->bt->is_remote) {
+        cursor_filter_set(pCur, pExpr, aMem);
+        return;
+    }
+
     if (pCur && pCur->bt && pCur->bt->is_remote) {
         expr = sqlite3ExprDescribeAtRuntime(pCur->vdbe, pExpr);
         if (!expr) /* failed hinting, calling sqlite engine will catch it */
@@ -10805,6 +11592,21 @@ static void sqlite3BtreeCursorHint_Range(BtCursor *pCur, const Expr *pExpr)
     }
 }
 
+static void sqlite3BtreeCursorHint_Limit(BtCursor *pCur, i64 limit,
+                                         const Expr *pExpr)
+{
+    if (!pCur || !pCur->bt || !pCur->bt->is_remote || !pCur->fdbc ||
+        !pCur->fdbc->set_limit)
+        return;
+
+    /* the limit counts rows that pass the whole filter; if the filter could
+       not be handed to the remote, it returns more rows than that */
+    if (pExpr && pCur->fdbc->get_hint(pCur) != pExpr)
+        limit = 0;
+
+    pCur->fdbc->set_limit(pCur, limit);
+}
+
 /*
 ** Provide hints to the cursor.  The particular hint given (and the type
 ** and number of the varargs parameters) is determined by the eHintType
@@ -10832,8 +11634,18 @@ void sqlite3BtreeCursorHint(BtCursor *pCur, int eHintType, ...)
 
     case BTREE_HINT_RANGE: {
         Expr *expr = va_arg(ap, Expr *);
+        Mem *aMem = va_arg(ap, Mem *);
 
-        sqlite3BtreeCursorHint_Range(pCur, expr);
+        sqlite3BtreeCursorHint_Range(pCur, expr, aMem);
+
+        break;
+    }
+
+    case BTREE_HINT_LIMIT: {
+        i64 limit = va_arg(ap, i64);
+        Expr *expr = va_arg(ap, Expr *);
+
+        sqlite3BtreeCursorHint_Limit(pCur, limit, expr);
 
         break;
     }
@@ -11168,6 +11980,51 @@ out:
     thread_memdestroy();
 }
 
+int run_sql_query_rows(const char *sql, int (*row)(void *, sqlite3_stmt *),
+                       void *arg)
+{
+    int rc;
+    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt = NULL;
+
+    struct sqlclntstate clnt;
+    reset_clnt(&clnt, NULL, 1);
+    clnt.sql = (char *)sql;
+
+    struct sql_thread *thd = start_sql_thread();
+    get_copy_rootpages(thd);
+    thd->clnt = &clnt;
+    sql_get_query_id(thd);
+    if ((rc = get_curtran(thedb->bdb_env, &clnt)) != 0) {
+        goto out;
+    }
+    if ((rc = sqlite3_open_serial("db", &db, 0)) != SQLITE_OK) {
+        goto put;
+    }
+    clnt.no_transaction = 1;
+    if ((rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) != SQLITE_OK) {
+        logmsg(LOGMSG_ERROR, "%s: prepare \"%s\" rc %d %s\n", __func__, sql,
+               rc, sqlite3_errmsg(db));
+        goto close;
+    }
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if ((rc = row(arg, stmt)) != 0)
+            break;
+    }
+    if (rc == SQLITE_DONE)
+        rc = 0;
+    sqlite3_finalize(stmt);
+
+close:
+    sqlite3_close(db);
+put:
+    put_curtran(thedb->bdb_env, &clnt);
+out:
+    thd->clnt = NULL;
+    done_sql_thread();
+    return rc;
+}
+
 void clone_temp_table(sqlite3 *dest, const sqlite3 *src, const char *sql,
                       struct temptable *tbl)
 {
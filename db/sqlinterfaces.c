@@ -52,6 +52,7 @@
 #include "types.h"
 #include "tag.h"
 #include "thdpool.h"
+#include "comdb2_pthread_create.h"
 #include "ssl_bend.h"
 
 #include <dynschematypes.h>
@@ -107,8 +108,12 @@
 #include <str0.h>
 #include <eventlog.h>
 #include "perf.h"
+#include "wait_event.h"
 
 #include "dohsql.h"
+#include "result_cache.h"
+#include "profile.h"
+#include "mem_governor.h"
 
 /* delete this after comdb2_api.h changes makes it through */
 #define SQLHERR_MASTER_QUEUE_FULL -108
@@ -120,6 +125,7 @@ extern int gbl_allow_pragma;
 extern int gbl_use_appsock_as_sqlthread;
 extern int g_osql_max_trans;
 extern int gbl_fdb_track;
+extern int gbl_fdb_sql_batch_rows;
 extern int gbl_return_long_column_names;
 extern int gbl_stable_rootpages_test;
 extern int gbl_verbose_normalized_queries;
@@ -166,7 +172,7 @@ int gbl_bpfunc_auth_gen = 1;
 
 struct thdpool *gbl_sqlengine_thdpool = NULL;
 
-void rcache_init(size_t, size_t);
+void rcache_init(size_t, size_t, int);
 void rcache_destroy(void);
 void sql_reset_sqlthread(struct sql_thread *thd);
 int blockproc2sql_error(int rc, const char *func, int line);
@@ -174,7 +180,8 @@ static int test_no_btcursors(struct sqlthdstate *thd);
 static void sql_thread_describe(void *obj, FILE *out);
 int watcher_warning_function(void *arg, int timeout, int gap);
 static char *get_query_cost_as_string(struct sql_thread *thd,
-                                      struct sqlclntstate *clnt);
+                                      struct sqlclntstate *clnt,
+                                      sqlite3_stmt *stmt);
 
 void handle_sql_intrans_unrecoverable_error(struct sqlclntstate *clnt);
 
@@ -645,8 +652,88 @@ int sql_mem_init(void *arg)
     return 0;
 }
 
+/* Statement arenas.  While a statement runs, sqlite allocations come from
+ * an arena of its own instead of the thread's SQLITE mspace, so short lived
+ * execution memory doesn't fragment the long lived prepared statements and
+ * schema around it.  An arena that is empty when the statement finishes is
+ * kept for the next one (or dropped if it grew past sql_stmt_arena_keep);
+ * one still holding blocks is retired until they are freed.  Blocks are
+ * freed through their own arena, so this is safe for memory that outlives
+ * the statement. */
+int gbl_sql_stmt_arena = 0;
+int gbl_sql_stmt_arena_keep = 1024 * 1024;
+#define SQL_MAX_RETIRED_ARENAS 8
+static __thread comdb2ma sql_stmt_arena = NULL;
+static __thread comdb2ma sql_idle_arena = NULL;
+static __thread int sql_stmt_arena_on = 0;
+static __thread comdb2ma sql_retired_arenas[SQL_MAX_RETIRED_ARENAS];
+static __thread int sql_nretired = 0;
+
+static void sql_reap_arenas(void)
+{
+    for (int i = 0; i < sql_nretired;) {
+        if (comdb2ma_nblocks(sql_retired_arenas[i]) == 0) {
+            comdb2ma_destroy(sql_retired_arenas[i]);
+            sql_retired_arenas[i] = sql_retired_arenas[--sql_nretired];
+        } else {
+            ++i;
+        }
+    }
+}
+
+static void sql_stmt_arena_begin(void)
+{
+    if (!gbl_sql_stmt_arena || sql_stmt_arena_on || sql_mspace == NULL)
+        return;
+    sql_reap_arenas();
+    /* too much pinned memory; let the retired arenas drain first */
+    if (sql_nretired >= SQL_MAX_RETIRED_ARENAS)
+        return;
+    if (sql_idle_arena) {
+        sql_stmt_arena = sql_idle_arena;
+        sql_idle_arena = NULL;
+    } else {
+        sql_stmt_arena = comdb2ma_create(0, 0, "SQLSTMT", COMDB2MA_MT_UNSAFE);
+        if (sql_stmt_arena == NULL || comdb2ma_nblocks(sql_stmt_arena) < 0) {
+            if (sql_stmt_arena)
+                comdb2ma_destroy(sql_stmt_arena);
+            sql_stmt_arena = NULL;
+            return;
+        }
+    }
+    sql_stmt_arena_on = 1;
+}
+
+static void sql_stmt_arena_end(void)
+{
+    comdb2ma arena = sql_stmt_arena;
+
+    if (!sql_stmt_arena_on)
+        return;
+    sql_stmt_arena_on = 0;
+    sql_stmt_arena = NULL;
+
+    if (comdb2ma_nblocks(arena) == 0) {
+        if (comdb2ma_footprint(arena) > gbl_sql_stmt_arena_keep)
+            comdb2ma_destroy(arena);
+        else
+            sql_idle_arena = arena;
+    } else {
+        sql_retired_arenas[sql_nretired++] = arena;
+    }
+}
+
 void sql_mem_shutdown(void *arg)
 {
+    /* like sql_mspace, arenas go away with whatever is left in them */
+    if (sql_stmt_arena_on)
+        sql_stmt_arena_end();
+    while (sql_nretired > 0)
+        comdb2ma_destroy(sql_retired_arenas[--sql_nretired]);
+    if (sql_idle_arena) {
+        comdb2ma_destroy(sql_idle_arena);
+        sql_idle_arena = NULL;
+    }
     if (sql_mspace) {
         comdb2ma_destroy(sql_mspace);
         sql_mspace = NULL;
@@ -658,7 +745,8 @@ static void *sql_mem_malloc(int size)
     if (unlikely(sql_mspace == NULL))
         sql_mem_init(NULL);
 
-    void *out = comdb2_malloc(sql_mspace, size);
+    void *out = comdb2_malloc(sql_stmt_arena ? sql_stmt_arena : sql_mspace,
+                              size);
 
 #ifdef DEBUG_SQLITE_MEMORY
     struct blk *b = malloc(sizeof(struct blk));
@@ -1144,6 +1232,13 @@ static void sql_statement_done(struct sql_thread *thd, struct reqlogger *logger,
 
     time_metric_add(thedb->service_time, h->cost.time);
 
+    wait_event_set_query(NULL, 0);
+    profile_set_query(NULL);
+
+    int64_t latencyus = logger ? reqlog_current_us(logger) : 0;
+    if (latencyus > thd->prepus)
+        reqlog_phase_record(REQL_PHASE_RUN, latencyus - thd->prepus);
+
     /* request logging framework takes care of logging long sql requests */
     reqlog_set_cost(logger, h->cost.cost);
     if (rqid) {
@@ -1173,11 +1268,11 @@ static void sql_statement_done(struct sql_thread *thd, struct reqlogger *logger,
             }
             if (clnt->work.zOrigNormSql) { /* NOTE: Not subject to prepare. */
                 add_fingerprint(h->sql, clnt->work.zOrigNormSql, cost, time,
-                                prepTime, rows, logger, fingerprint);
+                                prepTime, rows, latencyus, logger, fingerprint);
                 have_fingerprint = 1;
             } else if (clnt->work.zNormSql && sqlite3_is_success(clnt->prep_rc)) {
                 add_fingerprint(h->sql, clnt->work.zNormSql, cost, time,
-                                prepTime, rows, logger, fingerprint);
+                                prepTime, rows, latencyus, logger, fingerprint);
                 have_fingerprint = 1;
             } else {
                 reqlog_reset_fingerprint(logger, FINGERPRINTSZ);
@@ -1193,6 +1288,9 @@ static void sql_statement_done(struct sql_thread *thd, struct reqlogger *logger,
     }
     reqlog_set_vreplays(logger, clnt->verify_retries);
 
+    if (have_fingerprint)
+        fingerprint_check_plan(fingerprint, clnt->query_stats, cost);
+
     if (clnt->saved_rc)
         reqlog_set_error(logger, clnt->saved_errstr, clnt->saved_rc);
 
@@ -1515,6 +1613,9 @@ static void sql_update_usertran_state(struct sqlclntstate *clnt)
 
 static void log_queue_time(struct reqlogger *logger, struct sqlclntstate *clnt)
 {
+    if (clnt->deque_timeus > clnt->enque_timeus)
+        reqlog_phase_record(REQL_PHASE_QUEUE,
+                            clnt->deque_timeus - clnt->enque_timeus);
     if (!gbl_track_queue_time)
         return;
     if (clnt->deque_timeus > clnt->enque_timeus)
@@ -2360,6 +2461,139 @@ static int add_stmt_table(struct sqlthdstate *thd, const char *sql,
     return requeue_stmt_entry(thd, entry);
 }
 
+/*
+ * Statements we have cached, shared by all sql engine threads.
+ *
+ * A prepared sqlite3_stmt belongs to the sqlite3 handle of the thread that
+ * prepared it (its program points at that handle's schema, collations and
+ * key infos), so the programs themselves can't be shared.  What we share is
+ * which statements are worth caching: every time a thread caches a
+ * statement it's counted here.  After a thread opens a new engine, e.g.
+ * after a schema change bumped gbl_dbopen_gen, it prepares the
+ * gbl_sqlcache_warm most popular of these into its own cache, so the hot
+ * statements don't each miss again.  It does SQLCACHE_WARM_BATCH of them
+ * ahead of each of its next queries, so no one query waits for them all.
+ */
+int gbl_sqlcache_warm = 0;
+#define SQLCACHE_WARM_BATCH 4
+
+struct shared_stmt {
+    char *sql;
+    int64_t nprepares;
+    LINKC_T(struct shared_stmt) lnk;
+};
+
+static pthread_mutex_t shared_stmt_lk = PTHREAD_MUTEX_INITIALIZER;
+static hash_t *shared_stmts;
+static LISTC_T(struct shared_stmt) shared_stmt_lru;
+
+static void note_shared_stmt(const char *sql)
+{
+    struct shared_stmt *s;
+
+    if (gbl_sqlcache_warm <= 0)
+        return;
+
+    Pthread_mutex_lock(&shared_stmt_lk);
+    if (shared_stmts == NULL) {
+        shared_stmts = hash_init_strptr(offsetof(struct shared_stmt, sql));
+        listc_init(&shared_stmt_lru, offsetof(struct shared_stmt, lnk));
+    }
+    if ((s = hash_find(shared_stmts, &sql)) != NULL) {
+        listc_rfl(&shared_stmt_lru, s);
+    } else {
+        /* twice what a thread keeps, param and noparam */
+        if (listc_size(&shared_stmt_lru) >= 4 * gbl_max_sqlcache) {
+            struct shared_stmt *old = listc_rbl(&shared_stmt_lru);
+            hash_del(shared_stmts, old);
+            free(old->sql);
+            free(old);
+        }
+        s = calloc(1, sizeof(*s));
+        s->sql = strdup(sql);
+        hash_add(shared_stmts, s);
+    }
+    s->nprepares++;
+    listc_atl(&shared_stmt_lru, s);
+    Pthread_mutex_unlock(&shared_stmt_lk);
+}
+
+/* Returns up to max of the most prepared statements; caller frees them. */
+static int get_shared_stmts(char **sqls, int max)
+{
+    struct shared_stmt *s;
+    int64_t counts[max];
+    int n = 0;
+
+    Pthread_mutex_lock(&shared_stmt_lk);
+    if (shared_stmts) {
+        LISTC_FOR_EACH(&shared_stmt_lru, s, lnk)
+        {
+            int i;
+            /* keep sqls[] sorted by count, most prepared first */
+            if (n == max) {
+                if (s->nprepares <= counts[max - 1])
+                    continue;
+                free(sqls[max - 1]);
+                i = max - 1;
+            } else {
+                i = n++;
+            }
+            for (; i > 0 && counts[i - 1] < s->nprepares; --i) {
+                sqls[i] = sqls[i - 1];
+                counts[i] = counts[i - 1];
+            }
+            sqls[i] = strdup(s->sql);
+            counts[i] = s->nprepares;
+        }
+    }
+    Pthread_mutex_unlock(&shared_stmt_lk);
+    return n;
+}
+
+static void warm_stmt_cache(struct sqlthdstate *thd, struct sqlclntstate *clnt)
+{
+    int max = gbl_sqlcache_warm;
+    if (max <= 0 || thd->stmt_caching_table == NULL) {
+        thd->warm_pos = -1;
+        return;
+    }
+    if (max > gbl_max_sqlcache * 2)
+        max = gbl_max_sqlcache * 2;
+
+    char **sqls = malloc(sizeof(char *) * max);
+    int n = get_shared_stmts(sqls, max);
+    int i, nprepared = 0;
+    for (i = thd->warm_pos; i < n && nprepared < SQLCACHE_WARM_BATCH; ++i) {
+        sqlite3_stmt *stmt = NULL;
+        int flags = gbl_fingerprint_queries ? SQLITE_PREPARE_NORMALIZE : 0;
+        if (strlen(sqls[i]) >= MAX_HASH_SQL_LENGTH ||
+            hash_find(thd->stmt_caching_table, sqls[i]) != NULL)
+            continue;
+        ++nprepared;
+        clnt->no_transaction = 1;
+        thd->authState.clnt = clnt;
+        thd->authState.flags = PREPARE_DENY_CREATE_TRIGGER |
+                               (gbl_allow_pragma ? 0 : PREPARE_DENY_PRAGMA);
+        thd->authState.numDdls = 0;
+        int rc = sqlite3_prepare_v3(thd->sqldb, sqls[i], -1, flags, &stmt, NULL);
+        thd->authState.flags = 0;
+        clnt->no_transaction = 0;
+        if (rc == SQLITE_OK && stmt && (thd->authState.numDdls > 0 ||
+                                        sqlite3_stmt_isexplain(stmt) ||
+                                        add_stmt_table(thd, sqls[i], NULL,
+                                                       stmt) != 0))
+            rc = SQLITE_ERROR;
+        if (rc != SQLITE_OK && stmt)
+            sqlite3_finalize(stmt);
+    }
+    thd->warm_pos = (i < n) ? i : -1;
+    for (i = 0; i < n; ++i)
+        free(sqls[i]);
+    free(sqls);
+    thd->authState.numDdls = 0;
+}
+
 static inline int find_stmt_table(struct sqlthdstate *thd, const char *sql,
                                   stmt_hash_entry_type **entry)
 {
@@ -2434,23 +2668,20 @@ int sqlhint_cmp(const void *key1, const void *key2, int len)
     return strcmp((char *)s1, (char *)s2);
 }
 
+/* every sql thread looks here before preparing a hinted query */
+#define SQL_HINT_SHARDS 16
+
 void init_sql_hint_table()
 {
-    sql_hints = lrucache_init(sqlhint_hash, sqlhint_cmp, free,
-                              offsetof(sql_hint_hash_entry_type, lnk),
-                              offsetof(sql_hint_hash_entry_type, sql_hint),
-                              sizeof(char *), gbl_max_sql_hint_cache);
+    sql_hints = lrucache_init_concurrent(
+        sqlhint_hash, sqlhint_cmp, free,
+        offsetof(sql_hint_hash_entry_type, lnk),
+        offsetof(sql_hint_hash_entry_type, sql_hint), sizeof(char *),
+        gbl_max_sql_hint_cache, SQL_HINT_SHARDS);
 }
 
-void reinit_sql_hint_table()
-{
-    Pthread_mutex_lock(&gbl_sql_lock);
-    {
-        delete_sql_hint_table();
-        init_sql_hint_table();
-    }
-    Pthread_mutex_unlock(&gbl_sql_lock);
-}
+/* hints that are in use stay until they are released */
+void reinit_sql_hint_table() { lrucache_clear(sql_hints); }
 
 static void add_sql_hint_table(char *sql_hint, char *sql_str)
 {
@@ -2465,26 +2696,16 @@ static void add_sql_hint_table(char *sql_hint, char *sql_str)
     entry->sql_str = entry->sql_hint + sql_hint_len;
     memcpy(entry->sql_str, sql_str, sql_len);
 
-    Pthread_mutex_lock(&gbl_sql_lock);
-    {
-        if (lrucache_hasentry(sql_hints, &sql_hint) == 0) {
-            lrucache_add(sql_hints, entry);
-        } else {
-            free(entry);
-            logmsg(LOGMSG_ERROR, "Client BUG: Two threads using same SQL tag.\n");
-        }
+    if (lrucache_add(sql_hints, entry) != 0) {
+        free(entry);
+        logmsg(LOGMSG_ERROR, "Client BUG: Two threads using same SQL tag.\n");
     }
-    Pthread_mutex_unlock(&gbl_sql_lock);
 }
 
 static int find_sql_hint_table(char *sql_hint, char **sql_str)
 {
     sql_hint_hash_entry_type *entry;
-    Pthread_mutex_lock(&gbl_sql_lock);
-    {
-        entry = lrucache_find(sql_hints, &sql_hint);
-    }
-    Pthread_mutex_unlock(&gbl_sql_lock);
+    entry = lrucache_find(sql_hints, &sql_hint);
     if (entry) {
         *sql_str = entry->sql_str;
         return 0;
@@ -2494,13 +2715,7 @@ static int find_sql_hint_table(char *sql_hint, char **sql_str)
 
 static int has_sql_hint_table(char *sql_hint)
 {
-    int ret;
-    Pthread_mutex_lock(&gbl_sql_lock);
-    {
-        ret = lrucache_hasentry(sql_hints, &sql_hint);
-    }
-    Pthread_mutex_unlock(&gbl_sql_lock);
-    return ret;
+    return lrucache_hasentry(sql_hints, &sql_hint);
 }
 
 #define SQLCACHEHINT "/*+ RUNCOMDB2SQL"
@@ -3076,6 +3291,8 @@ static int put_prepared_stmt_int(struct sqlthdstate *thd,
         if (!(rec->status & CACHE_FOUND_STR)) {
             add_sql_hint_table(rec->cache_hint, clnt->sql);
         }
+    } else {
+        note_shared_stmt(sqlptr);
     }
     return add_stmt_table(thd, sqlptr, gbl_debug_temptables ? rec->sql : NULL,
                           stmt);
@@ -3097,11 +3314,7 @@ void put_prepared_stmt_distributed(struct sqlthdstate *thd,
     }
     if ((rec->status & CACHE_HAS_HINT) && (rec->status & CACHE_FOUND_STR)) {
         char *k = rec->cache_hint;
-        Pthread_mutex_lock(&gbl_sql_lock);
-        {
-            lrucache_release(sql_hints, &k);
-        }
-        Pthread_mutex_unlock(&gbl_sql_lock);
+        lrucache_release(sql_hints, &k);
     }
 }
 
@@ -3278,6 +3491,13 @@ static void normalize_stmt_and_store(
       if (zNormSql) {
         assert(clnt->work.zNormSql==0);
         clnt->work.zNormSql = zNormSql;
+        if (gbl_wait_event_sample_ms || profile_active()) {
+          unsigned char fingerprint[FINGERPRINTSZ];
+          size_t nNormSql;
+          calc_fingerprint(zNormSql, &nNormSql, fingerprint);
+          wait_event_set_query(fingerprint, FINGERPRINTSZ);
+          profile_set_query(fingerprint);
+        }
       } else if (gbl_verbose_normalized_queries) {
         logmsg(LOGMSG_USER, "FAILED sqlite3_normalized_sql({%s})\n", rec->sql);
       }
@@ -3316,6 +3536,12 @@ static int get_prepared_stmt_int(struct sqlthdstate *thd,
         return handle_bad_transaction_mode(thd, clnt);
     }
     query_stats_setup(thd, clnt);
+    if (thd->warm_gen != thd->dbopen_gen) {
+        thd->warm_gen = thd->dbopen_gen;
+        thd->warm_pos = 0;
+    }
+    if (thd->warm_pos >= 0)
+        warm_stmt_cache(thd, clnt);
     get_cached_stmt(thd, clnt, rec);
     int sqlPrepFlags = 0;
 
@@ -3333,7 +3559,7 @@ static int get_prepared_stmt_int(struct sqlthdstate *thd,
     const char *tail = NULL;
 
     /* if we did not get a cached stmt, need to prepare it in sql engine */
-    int startPrepMs = comdb2_time_epochms(); /* start of prepare phase */
+    uint64_t startPrepUs = comdb2_time_epochus(); /* start of prepare phase */
     while (rec->stmt == NULL) {
         clnt->no_transaction = 1;
         thd->authState.clnt = clnt;
@@ -3357,7 +3583,9 @@ static int get_prepared_stmt_int(struct sqlthdstate *thd,
         update_schema_remotes(clnt, rec);
     }
     if (rec->stmt) {
-        thd->sqlthd->prepms = comdb2_time_epochms() - startPrepMs;
+        thd->sqlthd->prepus = comdb2_time_epochus() - startPrepUs;
+        thd->sqlthd->prepms = U2M(thd->sqlthd->prepus);
+        reqlog_phase_record(REQL_PHASE_PREPARE, thd->sqlthd->prepus);
         free_normalized_sql(clnt);
         if (!(flags & PREPARE_NO_NORMALIZE)) {
             normalize_stmt_and_store(clnt, rec);
@@ -3740,6 +3968,11 @@ void run_stmt_setup(struct sqlclntstate *clnt, sqlite3_stmt *stmt)
     clnt->nsteps = 0;
     comdb2_set_sqlite_vdbe_tzname_int(v, clnt);
     comdb2_set_sqlite_vdbe_dtprec_int(v, clnt);
+#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
+    /* for set getcost analyze, count this run's opcodes only */
+    if (clnt->get_cost == 2)
+        sqlite3_stmt_scanstatus_reset(stmt);
+#endif
 
 #ifdef DEBUG
     if (gbl_debug_sql_opcodes) {
@@ -3824,7 +4057,8 @@ static int post_sqlite_processing(struct sqlthdstate *thd,
             free(clnt->prev_cost_string);
             clnt->prev_cost_string = NULL;
         }
-        clnt->prev_cost_string = get_query_cost_as_string(thd->sqlthd, clnt);
+        clnt->prev_cost_string =
+            get_query_cost_as_string(thd->sqlthd, clnt, rec->stmt);
     }
     char *errstr = NULL;
     int rc = rc_sqlite_to_client(thd, clnt, rec, &errstr);
@@ -3834,6 +4068,8 @@ static int post_sqlite_processing(struct sqlthdstate *thd,
         }
         clnt->had_errors = 1;
     } else {
+        if (clnt->rcache)
+            result_cache_end(clnt, 1);
         Pthread_mutex_lock(&clnt->wait_mutex);
         clnt->ready_for_heartbeats = 0;
         Pthread_mutex_unlock(&clnt->wait_mutex);
@@ -3861,6 +4097,8 @@ static int run_stmt(struct sqlthdstate *thd, struct sqlclntstate *clnt,
     sqlite3_stmt *stmt = rec->stmt;
 
     run_stmt_setup(clnt, stmt);
+    if (gbl_result_cache_mb || clnt->rcache)
+        result_cache_begin(clnt, stmt);
 
     /* this is a regular sql query, add it to history */
     if (srs_tran_add_query(clnt))
@@ -3910,6 +4148,9 @@ static int run_stmt(struct sqlthdstate *thd, struct sqlclntstate *clnt,
             return rc;
         }
 
+        if (clnt->rcache)
+            result_cache_add_row(clnt, stmt);
+
         if (clnt->isselect == 1) {
             clnt->effects.num_selected++;
             clnt->log_effects.num_selected++;
@@ -3981,6 +4222,8 @@ static void sqlite_done(struct sqlthdstate *thd, struct sqlclntstate *clnt,
         dohsql_end_distribute(clnt, thd->logger);
         distributed = 1;
     }
+    if (clnt->rcache)
+        result_cache_end(clnt, 0);
 
     sql_statement_done(thd->sqlthd, thd->logger, clnt, outrc);
 
@@ -4064,6 +4307,8 @@ int handle_sqlite_requests(struct sqlthdstate *thd, struct sqlclntstate *clnt)
     struct sql_state rec = {0};
     rec.sql = clnt->sql;
     char *allocd_str = NULL;
+    unsigned char fingerprint[FINGERPRINTSZ];
+    int admitted = 0;
 
     do {
         /* clean old stats */
@@ -4096,10 +4341,34 @@ int handle_sqlite_requests(struct sqlthdstate *thd, struct sqlclntstate *clnt)
         if (clnt->statement_query_effects)
             reset_query_effects(clnt);
 
+        /* outside a transaction the client retries a reject elsewhere */
+        if (!clnt->in_client_trans) {
+            admitted = fingerprint_admit(clnt->work.zNormSql, fingerprint);
+            if (admitted < 0) {
+                write_response(clnt, RESPONSE_ERROR_REJECT,
+                               "too many queries of this shape running", 0);
+                rc = SQLITE_BUSY;
+                handle_sqlite_error(thd, clnt, &rec, rc);
+                break;
+            }
+        }
+
+        /* a transaction may hold locks others need to give memory back, so
+         * only a statement outside one waits for the server to get under
+         * its budget */
+        memgov_query_start();
+        if (!clnt->in_client_trans)
+            memgov_admit();
+
         int fast_error = 0;
 
         /* run the engine */
+        sql_stmt_arena_begin();
         rc = run_stmt(thd, clnt, &rec, &fast_error, &err);
+        if (admitted > 0) {
+            fingerprint_release(fingerprint);
+            admitted = 0;
+        }
         if (rc) {
             int irc = errstat_get_rc(&err);
             switch(irc) {
@@ -4124,6 +4393,7 @@ int handle_sqlite_requests(struct sqlthdstate *thd, struct sqlclntstate *clnt)
     post_run_reqlog(thd, clnt, &rec);
 
     sqlite_done(thd, clnt, &rec, rc);
+    sql_stmt_arena_end();
 
     if (allocd_str)
         free(allocd_str);
@@ -4811,6 +5081,57 @@ static int send_heartbeat(struct sqlclntstate *clnt)
         }                                                                      \
     } while (0)
 
+/* How queued sql is grouped for fair queueing on the sql engine pool:
+ * 0 - not grouped, 1 - by user, 2 - by client origin, 3 - by query text.
+ * The query's normalized fingerprint isn't known until it is prepared on a
+ * sql thread, so mode 3 keys by a hash of the text as sent. */
+int gbl_sql_queue_class = 0;
+
+enum {
+    SQL_QUEUE_CLASS_NONE = 0,
+    SQL_QUEUE_CLASS_USER = 1,
+    SQL_QUEUE_CLASS_ORIGIN = 2,
+    SQL_QUEUE_CLASS_SQL = 3
+};
+
+static const char *sql_queue_class_key(struct sqlclntstate *clnt, char *buf,
+                                       size_t len)
+{
+    switch (gbl_sql_queue_class) {
+    case SQL_QUEUE_CLASS_USER:
+        return clnt->have_user ? clnt->user : NULL;
+    case SQL_QUEUE_CLASS_ORIGIN:
+        return clnt->origin;
+    case SQL_QUEUE_CLASS_SQL:
+        if (clnt->sql == NULL)
+            return NULL;
+        snprintf(buf, len, "%08x",
+                 hash_default_fixedwidth((const unsigned char *)clnt->sql,
+                                         strlen(clnt->sql)));
+        return buf;
+    default:
+        return NULL;
+    }
+}
+
+/* Only OP users may move their queries up within their class; everyone
+ * else's run at the default priority */
+static int sql_queue_priority(struct sqlclntstate *clnt)
+{
+    int bdberr, valid_user;
+
+    if (clnt->queue_priority <= 0 || !gbl_uses_password)
+        return clnt->queue_priority;
+
+    char *user = clnt->have_user ? clnt->user : DEFAULT_USER;
+    char *password = clnt->have_password ? clnt->password : DEFAULT_PASSWORD;
+    if (bdb_user_password_check(user, password, &valid_user) != 0)
+        return 0;
+    if (bdb_tbl_op_access_get(thedb->bdb_env, NULL, 0, "", user, &bdberr) != 0)
+        return 0;
+    return clnt->queue_priority;
+}
+
 static int enqueue_sql_query(struct sqlclntstate *clnt)
 {
     char msg[1024];
@@ -4866,14 +5187,20 @@ static int enqueue_sql_query(struct sqlclntstate *clnt)
     sqlcpy = strdup(msg);
     assert(clnt->dbtran.pStmt == NULL);
     uint32_t flags = (clnt->admin ? THDPOOL_FORCE_DISPATCH : 0);
-    if ((rc = thdpool_enqueue(gbl_sqlengine_thdpool, sqlengine_work_appsock_pp,
-                              clnt, clnt->queue_me, sqlcpy, flags)) != 0) {
+    char keybuf[16];
+    const char *classkey = sql_queue_class_key(clnt, keybuf, sizeof(keybuf));
+    int priority = sql_queue_priority(clnt);
+    if ((rc = thdpool_enqueue_class(gbl_sqlengine_thdpool,
+                                    sqlengine_work_appsock_pp, clnt,
+                                    clnt->queue_me, sqlcpy, flags, classkey,
+                                    priority)) != 0) {
         if ((clnt->in_client_trans || clnt->osql.replay == OSQL_RETRY_DO) &&
             gbl_requeue_on_tran_dispatch) {
             /* force this request to queue */
-            rc = thdpool_enqueue(gbl_sqlengine_thdpool,
-                                 sqlengine_work_appsock_pp, clnt, 1, sqlcpy,
-                                 flags | THDPOOL_FORCE_QUEUE);
+            rc = thdpool_enqueue_class(gbl_sqlengine_thdpool,
+                                       sqlengine_work_appsock_pp, clnt, 1,
+                                       sqlcpy, flags | THDPOOL_FORCE_QUEUE,
+                                       classkey, priority);
         }
 
         if (rc) {
@@ -5031,7 +5358,8 @@ void sqlengine_thd_start(struct thdpool *pool, struct sqlthdstate *thd,
 
     thd->sqlthd = pthread_getspecific(query_info_key);
     rcache_init(bdb_attr_get(thedb->bdb_attr, BDB_ATTR_RCACHE_COUNT),
-                bdb_attr_get(thedb->bdb_attr, BDB_ATTR_RCACHE_PGSZ));
+                bdb_attr_get(thedb->bdb_attr, BDB_ATTR_RCACHE_PGSZ),
+                bdb_attr_get(thedb->bdb_attr, BDB_ATTR_RCACHE_LEVELS));
 }
 
 int gbl_abort_invalid_query_info_key;
@@ -5219,6 +5547,7 @@ void reset_clnt(struct sqlclntstate *clnt, SBUF2 *sb, int initial)
 
     /* start off in comdb2 mode till we're told otherwise */
     clnt->dbtran.mode = tdef_to_tranlevel(gbl_sql_tranlevel_default);
+    clnt->dbtran.maxchunksize = 0;
     clnt->heartbeat = 0;
     clnt->limits.maxcost = gbl_querylimits_maxcost;
     clnt->limits.tablescans_ok = gbl_querylimits_tablescans_ok;
@@ -5304,6 +5633,7 @@ void reset_clnt(struct sqlclntstate *clnt, SBUF2 *sb, int initial)
     }
     clnt->planner_effort =
         bdb_attr_get(thedb->bdb_attr, BDB_ATTR_PLANNER_EFFORT);
+    clnt->queue_priority = 0;
     clnt->osql_max_trans = g_osql_max_trans;
 
     free_normalized_sql(clnt);
@@ -5765,8 +6095,58 @@ int comdb2_get_server_port()
  * function will allocate memory for string
  * and caller should free that memory area
  */
+/* set getcost analyze: where the time went, by table or index and by
+   opcode */
+static void append_query_analysis(strbuf *out, struct sql_thread *thd,
+                                  sqlite3_stmt *stmt)
+{
+    struct query_path_component *c;
+
+    strbuf_append(out, "Cursors:\n");
+    LISTC_FOR_EACH(&thd->query_stats, c, lnk)
+    {
+        const struct cursor_cost *a = &c->analyze;
+        if (c->nfind == 0 && c->nnext == 0 && c->nwrite == 0)
+            continue;
+        strbuf_append(out, "    ");
+        if (c->lcl_tbl_name[0] == '\0') {
+            strbuf_append(out, "temp");
+        } else {
+            if (c->ix >= 0)
+                strbuf_appendf(out, "index %d on ", c->ix);
+            if (c->rmt_db[0])
+                strbuf_appendf(out, "table %s.%s", c->rmt_db,
+                               c->lcl_tbl_name);
+            else
+                strbuf_appendf(out, "table %s", c->lcl_tbl_name);
+        }
+        strbuf_appendf(out,
+                       " rows %" PRIu64 " pages %" PRIu64 " disk reads %" PRIu64
+                       " lock wait %" PRIu64 "us convert %" PRIu64
+                       "us written %" PRIu64 " bytes time %" PRIu64 "us\n",
+                       a->nrows, a->npages, a->nreads, a->lockwait_us,
+                       a->convert_us, a->write_bytes, a->us);
+    }
+
+#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
+    Vdbe *v = (Vdbe *)stmt;
+    if (v == NULL || v->anExec == NULL)
+        return;
+    strbuf_append(out, "Opcodes:\n");
+    for (int ii = 0; ii < v->nOp; ii++) {
+        const Op *op = &v->aOp[ii];
+        if (v->anExec[ii] == 0)
+            continue;
+        strbuf_appendf(out, "    %4d %-16s %4d %4d %4d executed %lld\n", ii,
+                       sqlite3OpcodeName(op->opcode), op->p1, op->p2, op->p3,
+                       (long long)v->anExec[ii]);
+    }
+#endif
+}
+
 static char *get_query_cost_as_string(struct sql_thread *thd,
-                                      struct sqlclntstate *clnt)
+                                      struct sqlclntstate *clnt,
+                                      sqlite3_stmt *stmt)
 {
     if (!clnt || !thd)
         return NULL;
@@ -5801,6 +6181,8 @@ static char *get_query_cost_as_string(struct sql_thread *thd,
         }
         strbuf_append(out, "\n");
     }
+    if (clnt->get_cost == 2)
+        append_query_analysis(out, thd, stmt);
 
     char *str = strbuf_disown(out);
     strbuf_free(out);
@@ -5818,6 +6200,7 @@ static int execute_sql_query_offload_inner_loop(struct sqlclntstate *clnt,
     int rc = 0;
     int tmp;
     int sent;
+    int batch, nsent = 0, unflushed = 0;
 
     if (!clnt->fdb_state.remote_sql_sb) {
         while ((ret = next_row(clnt, stmt)) == SQLITE_ROW)
@@ -5830,6 +6213,15 @@ static int execute_sql_query_offload_inner_loop(struct sqlclntstate *clnt,
         else
             cid = (char *)&clnt->osql.rqid;
 
+        /* rows go out in batches of gbl_fdb_sql_batch_rows, except for the
+           first one so that a probe doesn't wait for a whole batch; in recom
+           and serial mode the caller may need each row before it can let us
+           make progress, so those are sent as they come */
+        batch = gbl_fdb_sql_batch_rows;
+        if (clnt->dbtran.mode == TRANLEVEL_RECOM ||
+            clnt->dbtran.mode == TRANLEVEL_SERIAL)
+            batch = 1;
+
         sent = 0;
         while (1) {
             /* NOTE: in the recom and serial mode, the cursors look at the
@@ -5856,9 +6248,13 @@ static int execute_sql_query_offload_inner_loop(struct sqlclntstate *clnt,
 
             if (res.z) {
                 /* now we have the packed sqlite row in Mem->z */
+                int flush = (nsent++ == 0 || ++unflushed >= batch);
                 rc = fdb_svc_sql_row(clnt->fdb_state.remote_sql_sb, cid, res.z,
                                      res.n, IX_FNDMORE,
-                                     clnt->osql.rqid == OSQL_RQID_USE_UUID);
+                                     clnt->osql.rqid == OSQL_RQID_USE_UUID,
+                                     flush);
+                if (flush)
+                    unflushed = 0;
                 if (rc) {
                     /*
                     fprintf(stderr, "%s: failed to send back sql row\n",
@@ -5898,11 +6294,11 @@ static int execute_sql_query_offload_inner_loop(struct sqlclntstate *clnt,
             if (sent == 1) {
                 rc = fdb_svc_sql_row(clnt->fdb_state.remote_sql_sb, cid, res.z,
                                      res.n, IX_FND,
-                                     clnt->osql.rqid == OSQL_RQID_USE_UUID);
+                                     clnt->osql.rqid == OSQL_RQID_USE_UUID, 1);
             } else {
                 rc = fdb_svc_sql_row(clnt->fdb_state.remote_sql_sb, cid, res.z,
                                      res.n, IX_EMPTY,
-                                     clnt->osql.rqid == OSQL_RQID_USE_UUID);
+                                     clnt->osql.rqid == OSQL_RQID_USE_UUID, 1);
             }
             if (rc) {
                 /*
@@ -6007,7 +6403,7 @@ done:
             rc = fdb_svc_sql_row(clnt->fdb_state.remote_sql_sb, cid,
                                  (char *)tmp, strlen(tmp) + 1,
                                  errstat_get_rc(&clnt->osql.xerr),
-                                 clnt->osql.rqid == OSQL_RQID_USE_UUID);
+                                 clnt->osql.rqid == OSQL_RQID_USE_UUID, 1);
             if (rc) {
                 logmsg(LOGMSG_ERROR,
                        "%s failed to send back error rc=%d errstr=%s\n",
@@ -6036,6 +6432,7 @@ int sqlpool_init(void)
 
     /* big fat stack to handle big queries */
     thdpool_set_stack_size(gbl_sqlengine_thdpool, 4 * 1024 * 1024);
+    thdpool_set_affinity_class(gbl_sqlengine_thdpool, COMDB2_THR_CLASS_SQL);
     thdpool_set_init_fn(gbl_sqlengine_thdpool, thdpool_sqlengine_start);
     thdpool_set_delt_fn(gbl_sqlengine_thdpool, thdpool_sqlengine_end);
     thdpool_set_minthds(gbl_sqlengine_thdpool, 4);
@@ -6046,6 +6443,7 @@ int sqlpool_init(void)
     thdpool_set_dque_fn(gbl_sqlengine_thdpool, thdpool_sqlengine_dque);
     thdpool_set_dump_on_full(gbl_sqlengine_thdpool, 1);
     thdpool_set_queued_callback(gbl_sqlengine_thdpool, clnt_queued_event);
+    thdpool_set_fairq(gbl_sqlengine_thdpool, gbl_sql_queue_class != 0);
 
     return 0;
 }
@@ -6492,11 +6890,7 @@ static void dump_sql_hint_entry(void *item, void *p)
 void sql_dump_hints(void)
 {
     int count = 0;
-    Pthread_mutex_lock(&gbl_sql_lock);
-    {
-        lrucache_foreach(sql_hints, dump_sql_hint_entry, &count);
-    }
-    Pthread_mutex_unlock(&gbl_sql_lock);
+    lrucache_foreach(sql_hints, dump_sql_hint_entry, &count);
 }
 
 /**
@@ -6584,6 +6978,14 @@ int gather_connection_info(struct connection_info **info, int *num_connections)
        c[cid].host = clnt->origin;
        c[cid].state_int = clnt->state;
        c[cid].time_in_state_int = clnt->state_start_time;
+       struct compio_stats st = {0};
+       if (clnt->sb)
+           compio_get_stats(clnt->sb, &st);
+       c[cid].compression = (char *)compio_name(st.algo);
+       c[cid].raw_bytes_out = st.raw_out;
+       c[cid].wire_bytes_out = st.wire_out;
+       c[cid].raw_bytes_in = st.raw_in;
+       c[cid].wire_bytes_in = st.wire_in;
        Pthread_mutex_lock(&clnt->state_lk);
        if (clnt->state == CONNECTION_RUNNING ||
            clnt->state == CONNECTION_QUEUED) {
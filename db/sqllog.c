@@ -79,39 +79,48 @@ static void free_event(struct log_event *e)
 
 static void *async_logthd(void *unused)
 {
-    struct log_event *e = NULL;
-    int rc;
+    LISTC_T(struct log_event) batch;
+    struct log_event *e;
+    int rc, stop = 0;
 
-    for (;;) {
-        Pthread_mutex_lock(&sql_log_lk);
-        if (e) {
-            async_size -= e->bufsz;
-            free_event(e);
-        }
+    listc_init(&batch, offsetof(struct log_event, lnk));
 
-        e = listc_rtl(&sqllog_events);
-        while (e == NULL) {
+    while (!stop) {
+        /* take everything queued at once, so producers only contend with
+         * us once per batch rather than once per event */
+        Pthread_mutex_lock(&sql_log_lk);
+        while (listc_size(&sqllog_events) == 0)
             Pthread_cond_wait(&async_writer_wait, &sql_log_lk);
-            e = listc_rtl(&sqllog_events);
-        }
+        while ((e = listc_rtl(&sqllog_events)) != NULL)
+            listc_abl(&batch, e);
         /* don't hold lock while possibly doing IO */
         Pthread_mutex_unlock(&sql_log_lk);
 
-        /* this is our cue to stop */
-        if (e->buf == 0 && e->bufsz == 0) {
-            free_event(e);
-            return NULL;
+        LISTC_FOR_EACH(&batch, e, lnk)
+        {
+            /* this is our cue to stop */
+            if (e->buf == 0 && e->bufsz == 0) {
+                stop = 1;
+                break;
+            }
+            rc = fwrite(e->buf, e->bufsz, 1, sqllog);
+            if (rc != 1) {
+                /* do what? disable logging? */
+            }
+            async_nmessages++;
         }
 
-        rc = fwrite(e->buf, e->bufsz, 1, sqllog);
-        if (rc != 1) {
-            /* do what? disable logging? */
+        Pthread_mutex_lock(&sql_log_lk);
+        while ((e = listc_rtl(&batch)) != NULL) {
+            async_size -= e->bufsz;
+            free_event(e);
         }
-        async_nmessages++;
+        Pthread_mutex_unlock(&sql_log_lk);
 
-        if (sqllog_rollat_size && ftell(sqllog) > sqllog_rollat_size)
+        if (!stop && sqllog_rollat_size && ftell(sqllog) > sqllog_rollat_size)
             sqllog_roll_locked(sqllog_keep_files, 1);
     }
+    return NULL;
 }
 
 static void async_enqueue(void *buf, int bufsz)
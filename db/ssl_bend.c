@@ -27,6 +27,7 @@
 
 /* sys */
 #include <errno.h>
+#include <inttypes.h>
 #include <openssl/crypto.h>
 #include <openssl/objects.h>
 #include <string.h>
@@ -66,6 +67,9 @@ int gbl_nid_dbname = NID_commonName;
 #endif
 /* Minimum acceptable TLS version */
 double gbl_min_tls_ver = 0;
+int gbl_ssl_ktls = 0;
+int64_t gbl_ssl_ktls_conns = 0;
+char *gbl_ssl_ticket_key_file = NULL;
 
 ssl_mode gbl_client_ssl_mode = SSL_UNKNOWN;
 ssl_mode gbl_rep_ssl_mode = SSL_UNKNOWN;
@@ -277,6 +281,24 @@ int ssl_process_lrl(char *line, size_t len)
             return EINVAL;
         }
         gbl_min_tls_ver = atof(tok);
+    } else if (tokcmp(line, ltok, SSL_TICKET_KEY_OPT) == 0) {
+        tok = segtok(line, len, &st, &ltok);
+        if (ltok <= 0) {
+            my_ssl_eprintln("Expected file for `" SSL_TICKET_KEY_OPT "'.");
+            return EINVAL;
+        }
+
+        gbl_ssl_ticket_key_file = tokdup(tok, ltok);
+        if (gbl_ssl_ticket_key_file == NULL) {
+            my_ssl_eprintln("Failed to duplicate string: %s.", strerror(errno));
+            return errno;
+        }
+    } else if (tokcmp(line, ltok, SSL_KTLS_OPT) == 0) {
+        tok = segtok(line, len, &st, &ltok);
+        gbl_ssl_ktls = (ltok <= 0) ? 1 : toknum(tok, ltok);
+        if (gbl_ssl_ktls && !HAVE_KTLS)
+            logmsg(LOGMSG_WARN, "OpenSSL was built without kernel TLS. "
+                                "`" SSL_KTLS_OPT "' has no effect.\n");
     }
     return 0;
 }
@@ -301,6 +323,12 @@ int ssl_bend_init(const char *default_certdir)
             ks, &gbl_cert_file, &gbl_key_file, &gbl_ca_file, &gbl_crl_file,
             gbl_sess_cache_sz, gbl_ciphers, gbl_min_tls_ver,
             errmsg, sizeof(errmsg));
+        if (rc == 0 && gbl_ssl_ticket_key_file != NULL &&
+            (rc = ssl_set_ticket_keys(gbl_ssl_ctx, gbl_ssl_ticket_key_file,
+                                      errmsg, sizeof(errmsg))) != 0) {
+            SSL_CTX_free(gbl_ssl_ctx);
+            gbl_ssl_ctx = NULL;
+        }
         if (rc == 0) {
             if (gbl_client_ssl_mode == SSL_UNKNOWN)
                 gbl_client_ssl_mode = SSL_ALLOW;
@@ -385,6 +413,15 @@ void ssl_stats(void)
         logmsg(LOGMSG_INFO, "Session Cache Size: %ld\n", gbl_sess_cache_sz);
 
     logmsg(LOGMSG_INFO, "Cipher suites: %s\n", gbl_ciphers);
+    logmsg(LOGMSG_INFO, "Session ticket keys: %s\n",
+           gbl_ssl_ticket_key_file ? gbl_ssl_ticket_key_file
+                                   : "random (this process only)");
+
+    if (gbl_ssl_ktls && HAVE_KTLS)
+        logmsg(LOGMSG_INFO, "Kernel TLS: YES (%" PRId64 " connections)\n",
+               gbl_ssl_ktls_conns);
+    else
+        logmsg(LOGMSG_INFO, "Kernel TLS: no\n");
 
     if (gbl_nid_user == NID_undef)
         logmsg(LOGMSG_INFO,
@@ -26,6 +26,7 @@
 #define _INCLUDED_SSL_BEND_H_
 
 #include <stddef.h>
+#include <stdint.h>
 #include <ssl_support.h>
 
 /* Path to the server certificate. */
@@ -57,9 +58,18 @@ extern long gbl_sess_cache_sz;
    Turn it on at your own risk. */
 extern int gbl_ssl_allow_remsql;
 
+/* Let newsql clients that ask for it use kernel TLS, and the number of
+   connections that got it. */
+extern int gbl_ssl_ktls;
+extern int64_t gbl_ssl_ktls_conns;
+
 /* OpenSSL cipher suites. */
 extern const char *gbl_ciphers;
 
+/* File with the session ticket keys, so that tickets outlive the process and
+   are good on all nodes that have it. NULL to let OpenSSL make them up. */
+extern char *gbl_ssl_ticket_key_file;
+
 /* Client SSL mode */
 extern ssl_mode gbl_client_ssl_mode;
 
@@ -45,6 +45,7 @@
 #include "tag.h"
 #include "types.h"
 #include "comdb2.h"
+#include "autoanalyze.h"
 #include "block_internal.h"
 #include "prefault.h"
 
@@ -59,6 +60,7 @@
 #include "views.h"
 #include "debug_switches.h"
 #include "logmsg.h"
+#include "comdb2_atomic.h"
 
 extern struct dbenv *thedb;
 extern pthread_mutex_t csc2_subsystem_mtx;
@@ -1490,6 +1492,113 @@ int clone_server_to_client_tag(const char *table, const char *fromtag,
 
 char *indexes_expressions_unescape(char *expr);
 extern int gbl_new_indexes;
+
+/* Build the payload schema of a datacopy(col, ...) index: the listed columns
+ * in order, followed by any decimal key columns (their quantum is read back
+ * from the payload).  Offsets are within the payload. */
+static int create_partial_datacopy(dbtable *db, struct schema *schema,
+                                   struct schema *ix, char *cols)
+{
+    struct schema *pd;
+    struct field *m;
+    char *copy, *col, *saveptr = NULL;
+    int ncols, offset, i;
+
+    ncols = ix->nmembers + 1;
+    for (col = cols; *col; col++)
+        if (*col == ',')
+            ncols++;
+
+    pd = ix->partial_datacopy = calloc(1, sizeof(struct schema));
+    pd->member = calloc(ncols, sizeof(struct field));
+    pd->tag = strdup(ix->tag);
+    pd->flags = SCHEMA_DATACOPY;
+    pd->ixnum = ix->ixnum;
+    copy = strdup(cols);
+
+    for (col = strtok_r(copy, ",", &saveptr); col;
+         col = strtok_r(NULL, ",", &saveptr)) {
+        int fidx = find_field_idx_in_tag(schema, col);
+        if (fidx == -1) {
+            logmsg(LOGMSG_ERROR, "%s: datacopy column %s not in table %s\n",
+                   ix->tag, col, db->tablename);
+            if (db->iq)
+                reqerrstr(db->iq, ERR_SC, "datacopy column %s not found", col);
+            free(copy);
+            return -1;
+        }
+        switch (schema->member[fidx].type) {
+        case SERVER_BLOB:
+        case SERVER_BLOB2:
+        case SERVER_VUTF8:
+            logmsg(LOGMSG_ERROR, "%s: datacopy column %s is a blob\n", ix->tag,
+                   col);
+            if (db->iq)
+                reqerrstr(db->iq, ERR_SC,
+                          "blob datacopy column %s is not supported", col);
+            free(copy);
+            return -1;
+        }
+        if (partial_datacopy_offset(ix, fidx) != -1) {
+            logmsg(LOGMSG_ERROR, "%s: datacopy column %s listed twice\n",
+                   ix->tag, col);
+            if (db->iq)
+                reqerrstr(db->iq, ERR_SC, "datacopy column %s listed twice",
+                          col);
+            free(copy);
+            return -1;
+        }
+        pd->member[pd->nmembers++].idx = fidx;
+    }
+    free(copy);
+
+    for (i = 0; i < ix->nmembers; i++) {
+        if (ix->member[i].idx >= 0 && ix->member[i].type == SERVER_DECIMAL &&
+            partial_datacopy_offset(ix, ix->member[i].idx) == -1)
+            pd->member[pd->nmembers++].idx = ix->member[i].idx;
+    }
+
+    for (i = 0, offset = 0; i < pd->nmembers; i++) {
+        m = &pd->member[i];
+        m->type = schema->member[m->idx].type;
+        m->len = schema->member[m->idx].len;
+        m->name = strdup(schema->member[m->idx].name);
+        m->blob_index = -1;
+        memcpy(&m->convopts, &schema->member[m->idx].convopts,
+               sizeof(struct field_conv_opts));
+        m->offset = offset;
+        offset += m->len;
+    }
+    pd->recsize = offset;
+    return 0;
+}
+
+/* Offset in the payload of partial datacopy index ix of table column fidx,
+ * -1 if it is not copied. */
+int partial_datacopy_offset(const struct schema *ix, int fidx)
+{
+    const struct schema *pd = ix->partial_datacopy;
+    for (int i = 0; i < pd->nmembers; i++) {
+        if (pd->member[i].idx == fidx)
+            return pd->member[i].offset;
+    }
+    return -1;
+}
+
+/* Copy the columns of partial datacopy index ixnum out of ondisk record
+ * inbuf.  Returns the payload length. */
+int partial_datacopy_from_ondisk(const struct dbtable *db, int ixnum,
+                                 const void *inbuf, void *outbuf)
+{
+    const struct schema *pd = db->ixschema[ixnum]->partial_datacopy;
+    for (int i = 0; i < pd->nmembers; i++) {
+        const struct field *m = &pd->member[i];
+        memcpy((char *)outbuf + m->offset,
+               (const char *)inbuf + db->schema->member[m->idx].offset, m->len);
+    }
+    return pd->recsize;
+}
+
 /* create keys for each schema */
 static int create_key_schema(dbtable *db, struct schema *schema, int alt)
 {
@@ -1501,6 +1610,7 @@ static int create_key_schema(dbtable *db, struct schema *schema, int alt)
     char altname[MAXTAGLEN];
     char tmptagname[MAXTAGLEN + sizeof(".NEW.")];
     char *where;
+    char *dccols;
     char *expr;
     int rc;
     int ascdesc;
@@ -1685,6 +1795,12 @@ static int create_key_schema(dbtable *db, struct schema *schema, int alt)
             m->offset = offset;
             offset += m->len;
         }
+        if ((s->flags & SCHEMA_DATACOPY) &&
+            (dccols = dyns_get_idx_datacopy_cols(ix)) != NULL) {
+            rc = create_partial_datacopy(db, schema, s, dccols);
+            if (rc)
+                goto errout;
+        }
         /* rest of fields irrelevant for indexes */
         add_tag_schema(dbname, s);
         rc = dyns_get_idx_tag(ix, altname, MAXTAGLEN, &where);
@@ -4053,6 +4169,217 @@ static int stag_to_stag_field(const char *inbuf, char *outbuf, int flags,
     return 0;
 }
 
+/*
+ * Compiled stag_to_stag conversions.
+ *
+ * Converting between two server tags does the same name lookups and type
+ * dispatch for every row.  For each (from, to) schema pair we compile that
+ * once into a list of ops: fields that are the same fixed width type and
+ * length on both sides (ints and reals) are plain byte copies, and runs of
+ * them that are adjacent in both records are coalesced into one memcpy.
+ * Everything else (strings, blobs, descending, expressions, defaults, seqno)
+ * remains a STAG_OP_FIELD handled by stag_to_stag_field.
+ *
+ * Plans hang off the destination schema and are freed with it.  They're
+ * keyed by a plan_id that's never reused, rather than the source schema's
+ * address, so a schema change that frees and reallocates a source tag can't
+ * pick up a stale plan.
+ */
+int gbl_stag_plans = 1;
+
+enum { STAG_OP_COPY, STAG_OP_NOTNULL, STAG_OP_FIELD };
+
+struct stag_op {
+    int op;
+    int field;     /* to field; first one for a coalesced copy */
+    int field_idx; /* from field */
+    int from_off;
+    int to_off;
+    int len;
+};
+
+#define STAG_MAX_PLANS 8
+
+struct stag_plan {
+    struct stag_plan *next;
+    const struct schema *from;
+    unsigned long long from_id;
+    int nops;
+    struct stag_op ops[1];
+};
+
+static pthread_mutex_t stag_plan_lk = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long long stag_plan_next_id = 0;
+
+static int stag_field_is_copy(const struct schema *fromsch,
+                              const struct field *from_field,
+                              const struct schema *tosch,
+                              const struct field *to_field)
+{
+    if (from_field->type != to_field->type || from_field->len != to_field->len)
+        return 0;
+    /* the only types whose same size SERVER_to_SERVER is a memcpy */
+    if (to_field->type != SERVER_BINT && to_field->type != SERVER_BREAL)
+        return 0;
+    if ((from_field->flags & INDEX_DESCEND) || (to_field->flags & INDEX_DESCEND))
+        return 0;
+    if ((tosch->flags & SCHEMA_INDEX) && to_field->isExpr)
+        return 0;
+    if (gbl_replicate_local && strcasecmp(to_field->name, "comdb2_seqno") == 0)
+        return 0;
+    return 1;
+}
+
+static struct stag_plan *compile_stag_plan(const struct schema *fromsch,
+                                           const struct schema *tosch,
+                                           int same_tag)
+{
+    struct stag_plan *plan;
+    struct stag_op *op;
+    int field;
+
+    /* worst case is a null check and an op for each field */
+    plan = malloc(offsetof(struct stag_plan, ops) +
+                  sizeof(struct stag_op) * (2 * tosch->nmembers + 1));
+    if (plan == NULL)
+        return NULL;
+    plan->from = fromsch;
+    plan->from_id = fromsch->plan_id;
+    plan->nops = 0;
+
+    /* NO_NULL checks on copied fields go first; the copies can't fail */
+    for (field = 0; field < tosch->nmembers; field++) {
+        const struct field *to_field = &tosch->member[field];
+        int field_idx = same_tag ? field
+                                 : find_field_idx_in_tag(fromsch, to_field->name);
+        if (field_idx < 0 ||
+            !stag_field_is_copy(fromsch, &fromsch->member[field_idx], tosch,
+                                to_field) ||
+            !(to_field->flags & NO_NULL))
+            continue;
+        op = &plan->ops[plan->nops++];
+        op->op = STAG_OP_NOTNULL;
+        op->field = field;
+        op->field_idx = field_idx;
+    }
+
+    for (field = 0; field < tosch->nmembers; field++) {
+        const struct field *to_field = &tosch->member[field];
+        const struct field *from_field;
+        int field_idx = same_tag ? field
+                                 : find_field_idx_in_tag(fromsch, to_field->name);
+
+        if (field_idx < 0 ||
+            !stag_field_is_copy(fromsch, &fromsch->member[field_idx], tosch,
+                                to_field)) {
+            op = &plan->ops[plan->nops++];
+            op->op = STAG_OP_FIELD;
+            op->field = field;
+            op->field_idx = field_idx;
+            continue;
+        }
+
+        from_field = &fromsch->member[field_idx];
+        op = plan->nops ? &plan->ops[plan->nops - 1] : NULL;
+        if (op && op->op == STAG_OP_COPY &&
+            op->from_off + op->len == from_field->offset &&
+            op->to_off + op->len == to_field->offset) {
+            op->len += to_field->len;
+            continue;
+        }
+        op = &plan->ops[plan->nops++];
+        op->op = STAG_OP_COPY;
+        op->field = field;
+        op->field_idx = field_idx;
+        op->from_off = from_field->offset;
+        op->to_off = to_field->offset;
+        op->len = to_field->len;
+    }
+    return plan;
+}
+
+/* Find or build the plan for converting fromsch records into tosch. */
+static const struct stag_plan *get_stag_plan(struct schema *fromsch,
+                                             struct schema *tosch,
+                                             int same_tag)
+{
+    struct stag_plan *plan;
+    int nplans = 0;
+
+    for (plan = ATOMIC_LOADPTR(tosch->plans); plan; plan = plan->next) {
+        if (plan->from == fromsch && plan->from_id == fromsch->plan_id)
+            return plan;
+        nplans++;
+    }
+    if (nplans >= STAG_MAX_PLANS)
+        return NULL;
+
+    Pthread_mutex_lock(&stag_plan_lk);
+    if (fromsch->plan_id == 0)
+        fromsch->plan_id = ++stag_plan_next_id;
+    for (plan = tosch->plans; plan; plan = plan->next) {
+        if (plan->from == fromsch && plan->from_id == fromsch->plan_id)
+            break;
+    }
+    if (plan == NULL &&
+        (plan = compile_stag_plan(fromsch, tosch, same_tag)) != NULL) {
+        plan->next = tosch->plans;
+        (void)XCHANGEPTR(tosch->plans, plan);
+    }
+    Pthread_mutex_unlock(&stag_plan_lk);
+    return plan;
+}
+
+static void free_stag_plans(struct schema *schema)
+{
+    struct stag_plan *plan, *next;
+    for (plan = schema->plans; plan; plan = next) {
+        next = plan->next;
+        free(plan);
+    }
+    schema->plans = NULL;
+}
+
+static int stag_to_stag_with_plan(const struct stag_plan *plan,
+                                  const char *inbuf, char *outbuf, int flags,
+                                  struct convert_failure *fail_reason,
+                                  blob_buffer_t *inblobs,
+                                  blob_buffer_t *outblobs, int maxblobs,
+                                  const char *tzname, struct schema *fromsch,
+                                  struct schema *tosch)
+{
+    const struct stag_op *op = plan->ops;
+    const struct stag_op *end = plan->ops + plan->nops;
+    int rc;
+
+    for (; op < end; op++) {
+        switch (op->op) {
+        case STAG_OP_COPY:
+            memcpy(outbuf + op->to_off, inbuf + op->from_off, op->len);
+            break;
+        case STAG_OP_NOTNULL:
+            if (stype_is_null(inbuf + fromsch->member[op->field_idx].offset)) {
+                if (fail_reason) {
+                    fail_reason->target_field_idx = op->field;
+                    fail_reason->source_field_idx = -1;
+                    fail_reason->reason =
+                        CONVERT_FAILED_NULL_CONSTRAINT_VIOLATION;
+                }
+                return -1;
+            }
+            break;
+        default:
+            rc = stag_to_stag_field(inbuf, outbuf, flags, fail_reason, inblobs,
+                                    outblobs, maxblobs, tzname, op->field_idx,
+                                    op->field, fromsch, tosch);
+            if (rc)
+                return rc;
+            break;
+        }
+    }
+    return 0;
+}
+
 /*
  * On success only outblobs will be valid, there is no need to free up inblobs.
  * On failure the caller should free inblobs and outblobs.
@@ -4089,6 +4416,14 @@ static int _stag_to_stag_buf_flags_blobs(
     if (strcmp(fromtag, totag) == 0)
         same_tag = 1;
 
+    if (gbl_stag_plans) {
+        const struct stag_plan *plan = get_stag_plan(fromsch, tosch, same_tag);
+        if (plan)
+            return stag_to_stag_with_plan(plan, inbuf, outbuf, flags,
+                                          fail_reason, inblobs, outblobs,
+                                          maxblobs, tzname, fromsch, tosch);
+    }
+
     for (int field = 0; field < tosch->nmembers; field++) {
         int field_idx;
 
@@ -4472,12 +4807,12 @@ static int default_cmp(int oldlen, const void *oldptr, int newlen,
 /* compare_tag_int() return codes
  * SC_TAG_CHANGE if :-
  *   1. new recsize is smaller
- *   2. field type has changed
+ *   2. field type has changed, other than widening an unsigned int
  *   3. NULL attribute removed from field
  *   4. field size reduced
  *   5. field deleted
  * SC_BAD_NEW_FIELD: New field missing dbstore or null
- * SC_COLUMN_ADDED: If new column is added
+ * SC_COLUMN_ADDED: If new column is added, or one is widened
  * SC_DBSTORE_CHANGE: Only change is dbstore of an existing field */
 int compare_tag_int(struct schema *old, struct schema *new, FILE *out,
                     int strict)
@@ -4503,7 +4838,14 @@ int compare_tag_int(struct schema *old, struct schema *new, FILE *out,
                 if (fnew->type != fold->type) {
                     snprintf(buf, sizeof(buf), "data type was %d, now %d",
                              fold->type, fnew->type);
-                    change = SC_TAG_CHANGE;
+                    /* an unsigned int widened to a larger signed one holds
+                       every old value, so old rows convert as they are read */
+                    if (fold->type == SERVER_UINT &&
+                        fnew->type == SERVER_BINT && fnew->len > fold->len &&
+                        ((fold->flags & NO_NULL) || !(fnew->flags & NO_NULL)))
+                        change = SC_COLUMN_ADDED;
+                    else
+                        change = SC_TAG_CHANGE;
                 } else if (!(fold->flags & NO_NULL) &&
                            (fnew->flags & NO_NULL)) {
                     snprintf(buf, sizeof(buf),
@@ -4834,6 +5176,25 @@ int has_index_changed(dbtable *tbl, char *keynm, int ct_check, int newkey,
     return 0;
 }
 
+/* Returns 1 if the columns copied into the payloads of two datacopy indexes
+ * differ. */
+static int cmp_partial_datacopy(struct schema *oldix, struct schema *newix)
+{
+    struct schema *oldpd = oldix->partial_datacopy;
+    struct schema *newpd = newix->partial_datacopy;
+    if (oldpd == NULL || newpd == NULL)
+        return oldpd != newpd;
+    if (oldpd->nmembers != newpd->nmembers)
+        return 1;
+    for (int i = 0; i < newpd->nmembers; i++) {
+        if (oldpd->member[i].type != newpd->member[i].type ||
+            oldpd->member[i].len != newpd->member[i].len ||
+            strcmp(oldpd->member[i].name, newpd->member[i].name) != 0)
+            return 1;
+    }
+    return 0;
+}
+
 /* Compare two indexes and summarise their changes.
  * Input: oldix, newix - two index schemas to compare.
  *        oldtbl, newtbl - the corresponding table schemas.
@@ -4865,6 +5226,10 @@ int cmp_index_int(struct schema *oldix, struct schema *newix, char *descr,
         if (descr)
             snprintf(descr, descrlen, "partial index has changed");
         return 1;
+    } else if (cmp_partial_datacopy(oldix, newix)) {
+        if (descr)
+            snprintf(descr, descrlen, "datacopy columns have changed");
+        return 1;
     } else {
         int fidx;
         for (fidx = 0; fidx < newix->nmembers; fidx++) {
@@ -6274,6 +6639,9 @@ struct schema *clone_schema(struct schema *from)
         sc->datacopy = malloc(from->nmembers * sizeof(int));
         memcpy(sc->datacopy, from->datacopy, from->nmembers * sizeof(int));
     }
+
+    if (from->partial_datacopy)
+        sc->partial_datacopy = clone_schema(from->partial_datacopy);
     return sc;
 }
 
@@ -6657,6 +7025,11 @@ void set_bdb_option_flags(dbtable *db, int odh, int ipu, int isc, int ver,
     bdb_set_instant_schema_change(handle, isc);
     bdb_set_csc2_version(handle, ver);
     bdb_set_datacopy_odh(handle, datacopy_odh);
+    for (int ix = 0; ix < db->nix; ix++) {
+        struct schema *pd =
+            db->ixschema[ix] ? db->ixschema[ix]->partial_datacopy : NULL;
+        bdb_set_partial_datacopy(handle, ix, pd ? pd->recsize : 0);
+    }
     bdb_set_key_compression(handle);
 }
 
@@ -6820,6 +7193,7 @@ void rename_schema(const char *oldname, char *newname)
 void freeschema_internals(struct schema *schema)
 {
     int i;
+    free_stag_plans(schema);
     free(schema->tag);
     for (i = 0; i < schema->nmembers; i++) {
         if (schema->member[i].in_default) {
@@ -6834,6 +7208,7 @@ void freeschema_internals(struct schema *schema)
     if (schema->datacopy) {
         free(schema->datacopy);
     }
+    freeschema(schema->partial_datacopy);
     if (schema->csctag) {
         free(schema->csctag);
     }
@@ -6903,7 +7278,12 @@ void freedb_int(dbtable *db, dbtable *replace)
         }
     }
 
+    /* the index layout may have changed; start a new sketch */
+    ixsketch_free(db->ixsketch);
+    db->ixsketch = NULL;
     if (replace) {
+        ixsketch_free(replace->ixsketch);
+        replace->ixsketch = NULL;
         memcpy(db, replace, sizeof(dbtable));
         db->dbs_idx = dbs_idx;
     } else
@@ -70,8 +70,15 @@ struct schema {
                    file */
     char *sqlitetag;
     int *datacopy;
+    /* for indices with datacopy(col, ...), the columns copied into the
+     * payload; member idx is the column in the table */
+    struct schema *partial_datacopy;
     char *where;
     LINKC_T(struct schema) lnk;
+    /* compiled stag_to_stag conversions into this schema, one per source
+     * schema; see get_stag_plan() */
+    struct stag_plan *plans;
+    unsigned long long plan_id;
 };
 
 struct dbtag {
@@ -192,6 +199,7 @@ extern char gbl_ondisk_ver[];
 extern const int gbl_ondisk_ver_len;
 extern char gbl_ondisk_ver_fmt[];
 extern int gbl_use_t2t;
+extern int gbl_stag_plans;
 
 int tag_init(void);
 void add_tag_schema(const char *table, struct schema *);
@@ -444,6 +452,10 @@ int create_key_from_ireq(struct ireq *iq, int ixnum, int isDelete, char **tail,
                          int *taillen, char *mangled_key, const char *inbuf,
                          int inbuflen, char *outbuf);
 
+int partial_datacopy_from_ondisk(const struct dbtable *db, int ixnum,
+                                 const void *inbuf, void *outbuf);
+int partial_datacopy_offset(const struct schema *ix, int fidx);
+
 char* typestr(int type, int len);
 
 #endif
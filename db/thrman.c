@@ -102,6 +102,9 @@ static pthread_cond_t cond;
 static LISTC_T(struct thr_handle) thr_list;
 static int thr_type_counts[THRTYPE_MAX] = {0};
 
+/* The calling thread's type, readable from a signal handler */
+static __thread int thr_self_type = THRTYPE_UNKNOWN;
+
 static void thrman_destructor(void *param);
 
 void thrman_init(void)
@@ -149,6 +152,7 @@ struct thr_handle *thrman_register(enum thrtype type)
     thr->archtid = getarchtid();
     thr->type = type;
     thr->fd = -1;
+    thr_self_type = type;
 
     Pthread_setspecific(thrman_key, thr);
     Pthread_mutex_lock(&mutex);
@@ -164,6 +168,11 @@ struct thr_handle *thrman_register(enum thrtype type)
     return thr;
 }
 
+enum thrtype thrman_self_type(void)
+{
+    return thr_self_type;
+}
+
 enum thrtype thrman_get_type(struct thr_handle *thr)
 {
     if (thr)
@@ -191,6 +200,8 @@ void thrman_change_type(struct thr_handle *thr, enum thrtype newtype)
     thr_type_counts[thr->type]--;
     thr->type = newtype;
     thr_type_counts[thr->type]++;
+    if (pthread_equal(thr->tid, pthread_self()))
+        thr_self_type = newtype;
     if (gbl_thrman_trace) {
         char buf[1024];
        logmsg(LOGMSG_USER, "thrman_change_type: from %s -> %s\n", thrman_type2a(oldtype),
@@ -244,6 +255,7 @@ void thrman_unregister(void)
     thr = thrman_self();
     if (thr) {
         Pthread_setspecific(thrman_key, NULL);
+        thr_self_type = THRTYPE_UNKNOWN;
         thrman_destructor(thr);
     }
 }
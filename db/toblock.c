@@ -2163,6 +2163,7 @@ static int toblock_outer(struct ireq *iq, block_state_t *blkstate)
                 iq->dbenv->prefault_helper.threads[i].seqnum++;
                 if (iq->dbenv->prefault_helper.threads[i].seqnum == 0)
                     iq->dbenv->prefault_helper.threads[i].seqnum = 1;
+                iq->dbenv->prefault_helper.threads[i].opnum = 0;
 
                 /* he's working for me! */
                 iq->dbenv->prefault_helper.threads[i].working_for = my_tid;
@@ -2935,6 +2936,9 @@ static int toblock_main_int(struct javasp_trans_state *javasp_trans_handle,
                       breq2a(hdr.opcode));
 
         iq->blkstate->opnum = opnum;
+        /* queued prefaults for earlier ops are of no more use */
+        if (iq->helper_thread != -1)
+            iq->dbenv->prefault_helper.threads[iq->helper_thread].opnum = opnum;
 
         if (iq->debug) {
             reqmoref(iq, " %d %s(%d) offset after hdr %p", opnum,
@@ -282,6 +282,12 @@ static int verify_formkey_callback(const dbtable *tbl, void *dta,
     return rc;
 }
 
+static int verify_partial_datacopy_callback(const dbtable *tbl, int ix,
+                                            void *dta, void *out)
+{
+    return partial_datacopy_from_ondisk(tbl, ix, dta, out);
+}
+
 static int verify_add_blob_buffer_callback(void *parm, void *dta, int dtasz,
                                            int blobno)
 {
@@ -367,6 +373,7 @@ static int verify_table_int(const char *table, SBUF2 *sb,
         .get_blob_sizes_callback = verify_blobsizes_callback,
         .vtag_callback =
             (int (*)(void *, void *, int *, uint8_t))vtag_to_ondisk_vermap,
+        .partial_datacopy_callback = verify_partial_datacopy_callback,
         .add_blob_buffer_callback = verify_add_blob_buffer_callback,
         .free_blob_buffer_callback = verify_free_blob_buffer_callback,
         .verify_indexes_callback = verify_indexes_callback,
@@ -484,6 +491,7 @@ static int parallel_verify_table(const char *table, SBUF2 *sb,
         .get_blob_sizes_callback = verify_blobsizes_callback,
         .vtag_callback =
             (int (*)(void *, void *, int *, uint8_t))vtag_to_ondisk_vermap,
+        .partial_datacopy_callback = verify_partial_datacopy_callback,
         .add_blob_buffer_callback = verify_add_blob_buffer_callback,
         .free_blob_buffer_callback = verify_free_blob_buffer_callback,
         .verify_indexes_callback = verify_indexes_callback,
@@ -24,7 +24,9 @@ typedef enum {
     VERIFY_PARALLEL,
     VERIFY_DATA,
     VERIFY_INDICES,
-    VERIFY_BLOBS
+    VERIFY_BLOBS,
+    VERIFY_PAGEORDER, /* scan every file in page order, then merge */
+    VERIFY_CHECKSUM   /* only check the page checksums of every file */
 } verify_mode_t;
 void purge_by_genid(struct dbtable *db, unsigned long long *genid);
 void dump_record_by_rrn_genid(struct dbtable *db, int rrn, unsigned long long genid);
@@ -21,6 +21,7 @@
 #include <string.h>
 #include <pthread.h>
 #include <memory_sync.h>
+#include <comdb2_atomic.h>
 
 #include "comdb2.h"
 #include "crc32c.h"
@@ -80,6 +81,11 @@ struct timepart_views {
 */
 pthread_rwlock_t views_lk;
 
+int gbl_timepart_prune_shards = 0;
+int gbl_timepart_drop_shard_unlocked = 1;
+int gbl_timepart_compact_after = 0;
+static int compacting_shard = 0;
+
 /*
  Cron scheduler
  */
@@ -106,12 +112,14 @@ static void _remove_view_entry(timepart_views_t *views, int i);
 void *_view_cron_phase1(struct cron_event *event, struct errstat *err);
 void *_view_cron_phase2(struct cron_event *event, struct errstat *err);
 void *_view_cron_phase3(struct cron_event *event, struct errstat *err);
+void *_view_cron_compact(struct cron_event *event, struct errstat *err);
 static int _views_rollout_phase1(timepart_view_t *view, char **newShardName,
                                  struct errstat *err);
 static int _views_rollout_phase2(timepart_view_t *view,
                                  const char *newShardName, int *timeNextRollout,
                                  char **removeShardName, struct errstat *err);
-static int _views_rollout_phase3(const char *oldShardName, struct errstat *err);
+static int _views_rollout_phase3(const char *oldShardName, int schema_locked,
+                                 struct errstat *err);
 
 static int _view_restart(timepart_view_t *view, struct errstat *err);
 int views_cron_restart(timepart_views_t *views);
@@ -157,6 +165,8 @@ char *timepart_event_describe(sched_if_t *_, cron_event_t *event)
         name = "RollShards";
     else if (event->func == _view_cron_phase3)
         name = "DropShard";
+    else if (event->func == _view_cron_compact)
+        name = "CompactShard";
     else
         name = "Unknown";
 
@@ -174,6 +184,9 @@ timepart_views_t *timepart_views_init(struct dbenv *dbenv)
     const char *name = "timepart_cron";
 
     time_cron_create(&tpt_cron, timepart_describe, timepart_event_describe);
+    /* every time partition shares this scheduler; let the rollouts and
+       purges of different partitions run side by side */
+    tpt_cron.parallel = 1;
 
     Pthread_rwlock_init(&views_lk, NULL);
 
@@ -720,7 +733,8 @@ done:
 int views_purge(timepart_views_t *views, timepart_view_t *view,
                 struct errstat *err)
 {
-    return _views_rollout_phase3(view->shards[view->nshards - 1].tblname, err);
+    return _views_rollout_phase3(view->shards[view->nshards - 1].tblname, 1,
+                                 err);
 }
 
 /**
@@ -1078,6 +1092,7 @@ void *_view_cron_phase2(struct cron_event *event, struct errstat *err)
     int timeNextRollout = 0;
     int timeCrtRollout = 0;
     char *removeShardName = NULL;
+    char *compactShardName = NULL;
     int rc = 0;
     int bdberr;
 
@@ -1137,6 +1152,13 @@ void *_view_cron_phase2(struct cron_event *event, struct errstat *err)
         rc = _views_rollout_phase2(view, pShardName, &timeNextRollout,
                                    &removeShardName, err);
 
+        /* every rollout ages each shard by one, so the shard now at this
+           index is one that has just become old enough to compact */
+        if (rc == VIEW_NOERR && gbl_timepart_compact_after > 0 &&
+            gbl_timepart_compact_after < view->nshards)
+            compactShardName =
+                strdup(view->shards[gbl_timepart_compact_after].tblname);
+
         if (rc == VIEW_NOERR) {
             /* send signal to replicants that partition configuration changed */
             rc = bdb_llog_views(
@@ -1170,6 +1192,15 @@ done:
             rc = _view_cron_schedule_next_rollout(view, timeCrtRollout,
                                                   timeNextRollout,
                                                   removeShardName, name, err);
+            if (compactShardName &&
+                cron_add_event(event->schedif->sched, NULL,
+                               comdb2_time_epoch(), _view_cron_compact,
+                               compactShardName, NULL, NULL, &view->source_id,
+                               err, NULL) == NULL) {
+                logmsg(LOGMSG_ERROR, "%s: failed rc=%d errstr=%s\n",
+                       __func__, err->errval, err->errstr);
+                free(compactShardName);
+            }
             return NULL;
         } else {
             _handle_view_event_error(view, event->source_id, err);
@@ -1209,20 +1240,29 @@ void *_view_cron_phase3(struct cron_event *event, struct errstat *err)
         run = 0;
 
     if (run) {
+        /* the shard left the view in phase 2, so dropping it does not need
+           the view lock; the drop takes the schema lock to finalize only,
+           like a regular drop table, instead of blocking writers throughout */
+        int locked = !gbl_timepart_drop_shard_unlocked;
+
         bdb_thread_event(thedb->bdb_env, BDBTHR_EVENT_START_RDWR);
         BDB_READLOCK(__func__);
-        wrlock_schema_lk();
-        Pthread_rwlock_wrlock(&views_lk); /* I might decide to not lock this */
+        if (locked) {
+            wrlock_schema_lk();
+            Pthread_rwlock_wrlock(&views_lk);
+        }
 
-        rc = _views_rollout_phase3(pShardName, err);
+        rc = _views_rollout_phase3(pShardName, locked, err);
         if (rc != VIEW_NOERR) {
             logmsg(LOGMSG_ERROR, "%s: phase 3 failed rc=%d errstr=%s\n", __func__,
                     err->errval, err->errstr);
         }
 
-        Pthread_rwlock_unlock(&views_lk);
-        unlock_schema_lk();
-        csc2_free_all();
+        if (locked) {
+            Pthread_rwlock_unlock(&views_lk);
+            unlock_schema_lk();
+            csc2_free_all();
+        }
         BDB_RELLOCK();
         bdb_thread_event(thedb->bdb_env, BDBTHR_EVENT_DONE_RDWR);
     }
@@ -1230,6 +1270,99 @@ done:
     return NULL;
 }
 
+struct compact_shard_arg {
+    char *shardname;
+    cron_sched_t *sched;
+    uuid_t source_id;
+};
+
+static void *_view_compact_shard_thd(void *p)
+{
+    struct compact_shard_arg *arg = p;
+    struct errstat err = {0};
+    int rc;
+
+    thread_started("timepart compact");
+    bdb_thread_event(thedb->bdb_env, BDBTHR_EVENT_START_RDWR);
+
+    logmsg(LOGMSG_INFO, "%s: rebuilding shard %s compressed\n", __func__,
+           arg->shardname);
+    rc = sc_timepart_compact_table(arg->shardname, BDB_COMPRESS_ZSTD, &err);
+    if (rc != SC_VIEW_NOERR)
+        logmsg(LOGMSG_ERROR, "%s: shard %s rc=%d errstr=%s\n", __func__,
+               arg->shardname, err.errval, err.errstr);
+
+    bdb_thread_event(thedb->bdb_env, BDBTHR_EVENT_DONE_RDWR);
+    compacting_shard = 0;
+
+    /* another schema change had the table; come back later */
+    if (rc == SC_VIEW_ERR_EXIST && !gbl_exit &&
+        thedb->master == gbl_mynode &&
+        cron_add_event(arg->sched, NULL, comdb2_time_epoch() + 60,
+                       _view_cron_compact, arg->shardname, NULL, NULL,
+                       &arg->source_id, &err, NULL) != NULL)
+        arg->shardname = NULL;
+
+    free(arg->shardname);
+    free(arg);
+    return NULL;
+}
+
+/**
+ * Rebuild a shard that has aged timepart_compact_after rollouts into
+ * compressed, densely packed btrees; the shard stays in the partition and
+ * can be read throughout, as with any live rebuild
+ *
+ */
+void *_view_cron_compact(struct cron_event *event, struct errstat *err)
+{
+    struct compact_shard_arg *arg;
+    char *pShardName = (char *)event->arg1;
+    pthread_t tid;
+    int idle = 0;
+
+    if (!pShardName) {
+        errstat_set_rc(err, VIEW_ERR_BUG);
+        errstat_set_strf(err, "%s no shardname?", __func__);
+        return NULL;
+    }
+
+    if (gbl_exit || thedb->master != gbl_mynode || gbl_is_physical_replicant)
+        return NULL;
+
+    /* the rebuild runs on its own thread, so that it does not hold up the
+       rollouts of every partition sharing the scheduler; one at a time */
+    if (!CAS32(compacting_shard, idle, 1)) {
+        if (cron_add_event(event->schedif->sched, NULL,
+                           comdb2_time_epoch() + 60, _view_cron_compact,
+                           event->arg1, NULL, NULL, &event->source_id, err,
+                           NULL) != NULL)
+            event->arg1 = NULL;
+        return NULL;
+    }
+
+    arg = calloc(1, sizeof(*arg));
+    if (!arg || !(arg->shardname = strdup(pShardName))) {
+        free(arg);
+        compacting_shard = 0;
+        errstat_set_rc(err, VIEW_ERR_MALLOC);
+        errstat_set_strf(err, "OOM Malloc");
+        return NULL;
+    }
+    arg->sched = event->schedif->sched;
+    comdb2uuidcpy(arg->source_id, event->source_id);
+
+    if (pthread_create(&tid, &gbl_pthread_attr_detached,
+                       _view_compact_shard_thd, arg)) {
+        logmsg(LOGMSG_ERROR, "%s: failed to start thread for %s\n", __func__,
+               pShardName);
+        free(arg->shardname);
+        free(arg);
+        compacting_shard = 0;
+    }
+    return NULL;
+}
+
 static char* comdb2_partition_info_locked(const char *partition_name, 
                                           const char *option)
 {
@@ -1645,12 +1778,12 @@ oom:
 }
 
 static int _views_rollout_phase3(const char *oldestShardName,
-                                 struct errstat *err)
+                                 int schema_locked, struct errstat *err)
 {
     int rc;
 
     /* do schema change to drop table */
-    rc = sc_timepart_drop_table(oldestShardName, err);
+    rc = sc_timepart_drop_table(oldestShardName, schema_locked, err);
     if (rc != SC_VIEW_NOERR) {
         return err->errval;
     }
@@ -4,6 +4,9 @@
  */
 #include <sqlite3.h>
 #include <sqliteInt.h>
+#include <vdbeInt.h>
+
+extern int comdb2genidcontainstime(void);
 
 static char *_views_create_view_query(timepart_view_t *view, sqlite3 *db,
                                       struct errstat *err);
@@ -191,7 +194,13 @@ static char *_views_create_view_query(timepart_view_t *view, sqlite3 *db,
     }
     table0name = view->shards[0].tblname;
 
-    cols_str = sqlite3_mprintf("rowid as __hidden__rowid, ");
+    /* the row timestamp lets queries on the view prune shards, see
+       comdb2_timepart_prune */
+    cols_str = sqlite3_mprintf(
+        "rowid as __hidden__rowid, %s",
+        comdb2genidcontainstime()
+            ? "comdb2_rowtimestamp as __hidden__rowtimestamp, "
+            : "");
     if (!cols_str) {
         goto malloc;
     }
@@ -324,6 +333,129 @@ static int _view_delete_if_missing(const char *name, sqlite3 *db, void *arg)
     return 0;
 }
 
+/* Inclusive upper bound, in epoch seconds, that where clause pExpr puts on
+   the comdb2_rowtimestamp of cursor iCur; returns 0 if there is none */
+static int _timepart_rowtimestamp_bound(Parse *pParse, Expr *pExpr, int iCur,
+                                        const char *tz, long long *bound)
+{
+    sqlite3_value *pVal = NULL;
+    Expr *col, *val;
+    long long l, r;
+    int hl, hr;
+    int op;
+
+    switch (pExpr->op) {
+    case TK_AND:
+        hl = _timepart_rowtimestamp_bound(pParse, pExpr->pLeft, iCur, tz, &l);
+        hr = _timepart_rowtimestamp_bound(pParse, pExpr->pRight, iCur, tz, &r);
+        if (hl && hr)
+            *bound = (l < r) ? l : r;
+        else if (hl)
+            *bound = l;
+        else if (hr)
+            *bound = r;
+        return hl || hr;
+    case TK_BETWEEN:
+        col = pExpr->pLeft;
+        val = pExpr->x.pList->a[1].pExpr;
+        op = TK_LE;
+        break;
+    case TK_LT:
+    case TK_LE:
+    case TK_EQ:
+        col = pExpr->pLeft;
+        val = pExpr->pRight;
+        op = pExpr->op;
+        break;
+    case TK_GT:
+        col = pExpr->pRight;
+        val = pExpr->pLeft;
+        op = TK_LT;
+        break;
+    case TK_GE:
+        col = pExpr->pRight;
+        val = pExpr->pLeft;
+        op = TK_LE;
+        break;
+    default:
+        return 0;
+    }
+
+    if (col->op != TK_COLUMN || col->iTable != iCur || col->iColumn != -3)
+        return 0;
+
+    /* only literals are known at prepare time */
+    if (sqlite3ValueFromExpr(pParse->db, val, SQLITE_UTF8, SQLITE_AFF_BLOB,
+                             &pVal) != SQLITE_OK ||
+        !pVal)
+        return 0;
+    if (sqlite3VdbeMemDatetimefyTz(pVal, tz) != SQLITE_OK ||
+        !(pVal->flags & MEM_Datetime)) {
+        sqlite3ValueFree(pVal);
+        return 0;
+    }
+    *bound = pVal->du.dt.dttz_sec;
+    if (op == TK_LT && pVal->du.dt.dttz_frac == 0)
+        *bound -= 1;
+    sqlite3ValueFree(pVal);
+
+    return 1;
+}
+
+/**
+ * Rows are only ever written to the newest shard, so the rows of a shard
+ * are never older than the time that shard started receiving them.  Arms of
+ * a time partition query bounded above by a constant comdb2_rowtimestamp
+ * older than the start of their shard get a false where clause, and no scan
+ *
+ */
+void comdb2_timepart_prune(Parse *pParse, Select *p)
+{
+    struct sql_thread *thd;
+    timepart_view_t *view;
+    struct SrcList_item *src;
+    long long bound;
+    Select *crt;
+    int indx;
+    int prune;
+
+    if (!gbl_timepart_prune_shards || !thedb->timepart_views)
+        return;
+
+    thd = pthread_getspecific(query_info_key);
+    if (!thd || !thd->clnt)
+        return;
+
+    for (crt = p; crt; crt = crt->pPrior) {
+        if (!crt->pWhere || crt->pSrc->nSrc != 1)
+            continue;
+        src = &crt->pSrc->a[0];
+        if (!src->zName || src->pSelect)
+            continue;
+        if (!_timepart_rowtimestamp_bound(pParse, crt->pWhere, src->iCursor,
+                                          thd->clnt->tzname, &bound))
+            continue;
+
+        Pthread_rwlock_rdlock(&views_lk);
+        view = _check_shard_collision(thedb->timepart_views, src->zName, &indx,
+                                      _CHECK_ONLY_CURRENT_SHARDS);
+        /* manual partitions roll on a logical clock, not on time */
+        prune = view && view->period != VIEW_PARTITION_MANUAL &&
+                view->shards[indx].low > bound;
+        Pthread_rwlock_unlock(&views_lk);
+
+        if (!prune)
+            continue;
+
+        sqlite3ExprDelete(pParse->db, crt->pWhere);
+        crt->pWhere = sqlite3Expr(pParse->db, TK_INTEGER, "0");
+        sqlite3VdbeExplain(pParse, 0, "PRUNED SHARD %s", src->zName);
+        if (bdb_attr_get(thedb->bdb_attr, BDB_ATTR_DEBUG_TIMEPART_SQLITE))
+            logmsg(LOGMSG_USER, "%s: pruned shard %s, bound %lld\n", __func__,
+                   src->zName, bound);
+    }
+}
+
 #ifdef COMDB2_UPDATEABLE_VIEWS
 
 static int _views_create_triggers(timepart_view_t *view, sqlite3 *db,
@@ -135,6 +135,7 @@ static void DumpFunction(const Proto* f, const TString* p, DumpState* D)
  DumpChar(f->numparams,D);
  DumpChar(f->is_vararg,D);
  DumpChar(f->maxstacksize,D);
+ DumpBlock(f->argtypes,f->numparams,D);	/* comdb2 typed parameters */
  DumpCode(f,D);
  DumpConstants(f,D);
  DumpDebug(f,D);
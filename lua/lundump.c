@@ -171,6 +171,7 @@ static Proto* LoadFunction(LoadState* S, TString* p)
  f->numparams=LoadByte(S);
  f->is_vararg=LoadByte(S);
  f->maxstacksize=LoadByte(S);
+ LoadBlock(S,f->argtypes,f->numparams);	/* comdb2 typed parameters */
  LoadCode(S,f);
  LoadConstants(S,f);
  LoadDebug(S,f);
@@ -157,6 +157,12 @@ typedef struct {
     pthread_mutex_t *lock;
     pthread_cond_t *cond;
     const uint8_t *open;
+    const uint64_t *gen; /* bumped when an insert commits */
+
+    /* events handed out by get_batch(), for consume_batch() */
+    genid_t *batch;
+    int nbatch;
+    int batchsz;
     trigger_reg_t info; // must be last in struct
 } dbconsumer_t;
 
@@ -186,7 +192,8 @@ static int setup_dbconsumer(dbconsumer_t *q, struct consumer *consumer,
     // memcpy because variable size struct breaks fortify checks in strcpy.
     memcpy(q->info.spname, info->spname, spname_len + 1);
     strcpy(q->info.spname + spname_len + 1, info->spname + spname_len + 1);
-    return bdb_trigger_subscribe(qdb->handle, &q->cond, &q->lock, &q->open);
+    return bdb_trigger_subscribe(qdb->handle, &q->cond, &q->lock, &q->open,
+                                 &q->gen);
 }
 
 static int db_emiterror(lua_State *lua);
@@ -679,6 +686,19 @@ static int dbq_pushargs(Lua L, dbconsumer_t *q, struct qfound *f)
 }
 
 static const int dbq_delay = 1000; // ms
+
+// Call with q->lock held.
+// Waits until an insert into the queue commits after gen was read (returns
+// 0), or until ts (returns ETIMEDOUT).  Wakeups from the insert itself,
+// before its commit, are slept through.
+static int dbq_wait(dbconsumer_t *q, uint64_t gen, const struct timespec *ts)
+{
+    int rc = 0;
+    while (rc == 0 && *q->gen == gen && *q->open) {
+        rc = pthread_cond_timedwait(q->cond, q->lock, ts);
+    }
+    return rc;
+}
 // Call with q->lock held.
 // Unlocks q->lock on return.
 // Returns  -2:stopped -1:error  0:IX_NOTFND  1:IX_FND
@@ -706,8 +726,10 @@ static int dbq_poll(Lua L, dbconsumer_t *q, int delay)
             return -1;
         }
         int rc;
+        uint64_t gen;
         Pthread_mutex_lock(q->lock);
-again:  if (*q->open) {
+again:  gen = *q->gen;
+        if (*q->open) {
             rc = dbq_poll_int(L, q); // call will release q->lock
         } else {
             Pthread_mutex_unlock(q->lock);
@@ -724,8 +746,8 @@ again:  if (*q->open) {
         clock_gettime(CLOCK_REALTIME, &ts);
         ts.tv_sec += (dbq_delay / 1000);
         Pthread_mutex_lock(q->lock);
-        if (pthread_cond_timedwait(q->cond, q->lock, &ts) == 0) {
-            // was woken up -- try getting from queue
+        if (dbq_wait(q, gen, &ts) == 0) {
+            // an insert committed -- try getting from queue
             goto again;
         }
         Pthread_mutex_unlock(q->lock);
@@ -794,6 +816,116 @@ static int dbconsumer_poll(Lua L)
     return luaL_error(L, getsp(L)->error);
 }
 
+static int timespec_cmp(const struct timespec *a, const struct timespec *b)
+{
+    if (a->tv_sec != b->tv_sec)
+        return a->tv_sec < b->tv_sec ? -1 : 1;
+    if (a->tv_nsec != b->tv_nsec)
+        return a->tv_nsec < b->tv_nsec ? -1 : 1;
+    return 0;
+}
+
+// Call with q->lock held.
+// Unlocks q->lock on return.
+// Returns  -1:error  0:IX_NOTFND  1:IX_FND
+// If IX_FND will append Lua table to the batch on top of stack and
+// advance cur past it.
+static int dbq_batch_next(Lua L, dbconsumer_t *q, struct dbq_cursor *cur)
+{
+    struct qfound f = {0};
+    struct dbq_cursor fnd;
+    int rc = dbq_get(&q->iq, 0, q->nbatch ? cur : NULL, (void **)&f.item,
+                     &f.len, &f.dtaoff, &fnd, NULL);
+    Pthread_mutex_unlock(q->lock);
+    getsp(L)->num_instructions = 0;
+    if (rc == IX_NOTFND) {
+        return 0;
+    }
+    if (rc != 0 || dbq_pushargs(L, q, &f) != 1) {
+        return -1;
+    }
+    q->batch[q->nbatch++] = q->genid;
+    q->genid = 0;
+    lua_rawseti(L, -2, q->nbatch);
+    *cur = fnd;
+    return 1;
+}
+
+// Blocks until an event is available, like get(), then reads up to n events.
+// If the queue runs dry first, waits up to linger ms (counted from the first
+// event) for more to arrive.
+static int dbconsumer_get_batch(Lua L)
+{
+    dbconsumer_t *q = luaL_checkudata(L, 1, dbtypes.dbconsumer);
+    int n = luaL_checkint(L, 2);
+    int linger = luaL_optint(L, 3, 0); // ms
+    SP sp = getsp(L);
+    if (n <= 0) {
+        return luaL_argerror(L, 2, "batch size must be positive");
+    }
+    if (n > q->batchsz) {
+        genid_t *batch = realloc(q->batch, n * sizeof(genid_t));
+        if (batch == NULL) {
+            return luaL_error(L, "failed to allocate batch of %d", n);
+        }
+        q->batch = batch;
+        q->batchsz = n;
+    }
+    q->nbatch = 0;
+    q->genid = 0;
+    lua_newtable(L);
+
+    struct dbq_cursor cur;
+    struct timespec end = {0};
+    uint64_t gen;
+    while (q->nbatch < n) {
+        if (stop_waiting(L, q)) {
+            q->nbatch = 0;
+            return luaL_error(L, sp->error);
+        }
+        int rc;
+        Pthread_mutex_lock(q->lock);
+        gen = *q->gen;
+        if (*q->open) {
+            rc = dbq_batch_next(L, q, &cur); // call will release q->lock
+        } else {
+            Pthread_mutex_unlock(q->lock);
+            rc = -2;
+        }
+        if (rc < 0) {
+            q->nbatch = 0;
+            luabb_error(L, sp, "failed to read from:%s rc:%d",
+                        q->info.spname, rc);
+            return luaL_error(L, sp->error);
+        }
+        if (rc == 1) {
+            if (q->nbatch == 1) {
+                clock_gettime(CLOCK_REALTIME, &end);
+                end.tv_sec += linger / 1000;
+                end.tv_nsec += (linger % 1000) * 1000000L;
+                if (end.tv_nsec >= 1000000000L) {
+                    end.tv_sec++;
+                    end.tv_nsec -= 1000000000L;
+                }
+            }
+            continue;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        if (q->nbatch > 0 && timespec_cmp(&ts, &end) >= 0) {
+            break;
+        }
+        ts.tv_sec += (dbq_delay / 1000);
+        if (q->nbatch > 0 && timespec_cmp(&ts, &end) > 0) {
+            ts = end;
+        }
+        Pthread_mutex_lock(q->lock);
+        dbq_wait(q, gen, &ts);
+        Pthread_mutex_unlock(q->lock);
+    }
+    return 1;
+}
+
 static inline int push_and_return(Lua L, int rc)
 {
     lua_pushinteger(L, rc);
@@ -830,7 +962,8 @@ static int lua_trigger_impl(Lua L, dbconsumer_t *q)
 ** Start a new transaction in either case.
 ** Commit transaction only for (1)
 */
-static int lua_consumer_impl(Lua L, dbconsumer_t *q)
+static int lua_consumer_impl(Lua L, dbconsumer_t *q, const genid_t *genids,
+                             int n)
 {
     int rc = 0;
     SP sp = getsp(L);
@@ -842,12 +975,15 @@ static int lua_consumer_impl(Lua L, dbconsumer_t *q)
         }
         clnt->intrans = 1;
     }
-    if ((rc = osql_dbq_consume_logic(clnt, q->info.spname, q->genid)) != 0) {
-        if (start) {
-            osql_sock_abort(clnt, OSQL_SOCK_REQ);
-            clnt->intrans = 0;
+    for (int i = 0; i < n; ++i) {
+        if ((rc = osql_dbq_consume_logic(clnt, q->info.spname, genids[i])) !=
+            0) {
+            if (start) {
+                osql_sock_abort(clnt, OSQL_SOCK_REQ);
+                clnt->intrans = 0;
+            }
+            luaL_error(L, "%s osql_dbq_consume_logic rc:%d\n", __func__, rc);
         }
-        luaL_error(L, "%s osql_dbq_consume_logic rc:%d\n", __func__, rc);
     }
     if (start) {
         rc = osql_sock_commit(clnt, OSQL_SOCK_REQ);
@@ -868,8 +1004,9 @@ static int dbconsumer_consume_int(Lua L, dbconsumer_t *q)
         return -1;
     }
     enum consumer_t type = dbqueue_consumer_type(q->consumer);
-    int rc = (type == CONSUMER_TYPE_LUA) ? lua_trigger_impl(L, q)
-                                         : lua_consumer_impl(L, q);
+    int rc = (type == CONSUMER_TYPE_LUA)
+                 ? lua_trigger_impl(L, q)
+                 : lua_consumer_impl(L, q, &q->genid, 1);
     q->genid = 0;
     return rc;
 }
@@ -880,6 +1017,18 @@ static int dbconsumer_consume(Lua L)
     return push_and_return(L, dbconsumer_consume_int(L, q));
 }
 
+// Consumes every event from the last get_batch() in one transaction
+static int dbconsumer_consume_batch(Lua L)
+{
+    dbconsumer_t *q = luaL_checkudata(L, 1, dbtypes.dbconsumer);
+    if (q->nbatch == 0) {
+        return push_and_return(L, -1);
+    }
+    int rc = lua_consumer_impl(L, q, q->batch, q->nbatch);
+    q->nbatch = 0;
+    return push_and_return(L, rc);
+}
+
 static int db_emit_int(Lua);
 static int dbconsumer_emit(Lua L)
 {
@@ -896,6 +1045,8 @@ static int dbconsumer_free(Lua L)
 {
     dbconsumer_t *q = luaL_checkudata(L, 1, dbtypes.dbconsumer);
     luabb_trigger_unregister(L, q);
+    free(q->batch);
+    q->batch = NULL;
     return 0;
 }
 
@@ -2161,7 +2312,7 @@ static void lua_end_step(struct sqlclntstate *clnt, SP sp,
             unsigned char fingerprint[FINGERPRINTSZ];
             add_fingerprint(
                 sqlite3_sql(pStmt), zNormSql, cost,
-                timeMs, prepMs, pVdbe->luaRows, NULL,
+                timeMs, prepMs, pVdbe->luaRows, timeMs * 1000, NULL,
                 fingerprint);
             if (clnt->rawnodestats)
                 add_fingerprint_to_rawstats(clnt->rawnodestats, fingerprint, cost, pVdbe->luaRows, timeMs);
@@ -2951,10 +3102,116 @@ static int get_func_by_name(Lua L, const char *func, char **err)
     return 0;
 }
 
+/* Compiled chunks of procedure sources, shared by all Lua states so that a
+ * call doesn't have to parse its source again.  Keyed by the source text, so
+ * a new version of a procedure is simply a new entry; the least recently
+ * used ones are dropped past gbl_lua_bytecode_cache entries. */
+struct sp_bytecode {
+    char *src;
+    char *code;
+    size_t len;
+    LINKC_T(struct sp_bytecode) lnk;
+};
+
+int gbl_lua_bytecode_cache = 0;
+static hash_t *sp_bytecode_hash;
+static LISTC_T(struct sp_bytecode) sp_bytecode_lru;
+static pthread_mutex_t sp_bytecode_lk = PTHREAD_MUTEX_INITIALIZER;
+
+struct sp_dumpbuf {
+    char *buf;
+    size_t len, cap;
+};
+
+static int sp_dump_writer(Lua L, const void *p, size_t sz, void *ud)
+{
+    struct sp_dumpbuf *d = ud;
+    if (d->len + sz > d->cap) {
+        size_t cap = d->cap ? d->cap : 4096;
+        while (cap < d->len + sz)
+            cap *= 2;
+        char *buf = realloc(d->buf, cap);
+        if (buf == NULL)
+            return 1;
+        d->buf = buf;
+        d->cap = cap;
+    }
+    memcpy(d->buf + d->len, p, sz);
+    d->len += sz;
+    return 0;
+}
+
+static void sp_bytecode_add(const char *src, struct sp_dumpbuf *d)
+{
+    struct sp_bytecode *bc;
+    Pthread_mutex_lock(&sp_bytecode_lk);
+    if (sp_bytecode_hash == NULL) {
+        sp_bytecode_hash = hash_init_strptr(offsetof(struct sp_bytecode, src));
+        listc_init(&sp_bytecode_lru, offsetof(struct sp_bytecode, lnk));
+    }
+    if (hash_find(sp_bytecode_hash, &src) != NULL) {
+        /* another thread got here first */
+        Pthread_mutex_unlock(&sp_bytecode_lk);
+        free(d->buf);
+        return;
+    }
+    while (sp_bytecode_lru.count >= gbl_lua_bytecode_cache &&
+           (bc = listc_rbl(&sp_bytecode_lru)) != NULL) {
+        hash_del(sp_bytecode_hash, bc);
+        free(bc->src);
+        free(bc->code);
+        free(bc);
+    }
+    bc = malloc(sizeof(*bc));
+    bc->src = strdup(src);
+    bc->code = d->buf;
+    bc->len = d->len;
+    hash_add(sp_bytecode_hash, bc);
+    listc_atl(&sp_bytecode_lru, bc);
+    Pthread_mutex_unlock(&sp_bytecode_lk);
+}
+
+/* Like luaL_loadstring, from the shared cache when the source has been
+ * compiled before. */
+static int sp_load_chunk(Lua L, const char *src)
+{
+    struct sp_bytecode *bc;
+    struct sp_dumpbuf d = {0};
+    int rc;
+
+    if (gbl_lua_bytecode_cache <= 0)
+        return luaL_loadstring(L, src);
+
+    Pthread_mutex_lock(&sp_bytecode_lk);
+    if (sp_bytecode_hash && (bc = hash_find(sp_bytecode_hash, &src)) != NULL) {
+        listc_rfl(&sp_bytecode_lru, bc);
+        listc_atl(&sp_bytecode_lru, bc);
+        d.len = bc->len;
+        d.buf = malloc(d.len);
+        memcpy(d.buf, bc->code, d.len);
+    }
+    Pthread_mutex_unlock(&sp_bytecode_lk);
+    if (d.buf) {
+        /* chunk name is the source, as for luaL_loadstring */
+        rc = luaL_loadbuffer(L, d.buf, d.len, src);
+        free(d.buf);
+        return rc;
+    }
+
+    if ((rc = luaL_loadstring(L, src)) != 0)
+        return rc;
+    if (lua_dump(L, sp_dump_writer, &d) == 0 && d.len > 0)
+        sp_bytecode_add(src, &d);
+    else
+        free(d.buf);
+    return 0;
+}
+
 static int process_src(Lua L, const char *src, char **err)
 {
     int rc;
-    if ((rc = luaL_dostring(L, src)) != 0) {
+    if ((rc = sp_load_chunk(L, src)) != 0 ||
+        (rc = lua_pcall(L, 0, LUA_MULTRET, 0)) != 0) {
         *err = strdup(lua_tostring(L, -1));
         return -1;
     }
@@ -4088,6 +4345,9 @@ static int db_copyrow(Lua lua)
 
 char *gbl_kafka_brokers = NULL;
 char *gbl_kafka_topic = NULL;
+/* for the kafkacdc plugin */
+char *gbl_kafka_cdc_topics = NULL;
+int gbl_kafka_cdc_linger_ms = 100;
 
 #ifdef WITH_RDKAFKA
 
@@ -4682,6 +4942,8 @@ static const struct luaL_Reg dbconsumer_funcs[] = {
     {"get", dbconsumer_get},
     {"poll", dbconsumer_poll},
     {"consume", dbconsumer_consume},
+    {"get_batch", dbconsumer_get_batch},
+    {"consume_batch", dbconsumer_consume_batch},
     {"emit", dbconsumer_emit},
     {NULL, NULL}
 };
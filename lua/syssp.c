@@ -17,6 +17,7 @@
 #include <truncate_log.h>
 #include <bdb_api.h>
 #include <phys_rep.h>
+#include <profile.h>
 
 
 /* Wishes for anyone who wants to clean this up one day:
@@ -228,6 +229,13 @@ static int db_comdb_verify(Lua L) {
         } else if (strcmp(m, "blobs") == 0) {
             mode = VERIFY_BLOBS;
             logmsg(LOGMSG_INFO, "Verify ONLY blobs for table %s\n", tblname);
+        } else if (strcmp(m, "pageorder") == 0) {
+            mode = VERIFY_PAGEORDER;
+            logmsg(LOGMSG_INFO, "Verify in page order table %s\n", tblname);
+        } else if (strcmp(m, "checksum") == 0) {
+            mode = VERIFY_CHECKSUM;
+            logmsg(LOGMSG_INFO, "Verify ONLY page checksums for table %s\n",
+                   tblname);
         } else
             logmsg(LOGMSG_INFO, "Verify table %s\n", tblname);
     }
@@ -239,7 +247,7 @@ static int db_comdb_verify(Lua L) {
     int rc = 0;
 
     if (!tblname || strlen(tblname) < 1) {
-        db_verify_table_callback(L, "Usage: verify(\"<table>\" [,\"parallel\"|\"data\"|\"blobs\"|\"indices\"])");
+        db_verify_table_callback(L, "Usage: verify(\"<table>\" [,\"parallel\"|\"data\"|\"blobs\"|\"indices\"|\"pageorder\"|\"checksum\"])");
         return luaL_error(L, "Verify failed.");
     }
 
@@ -474,6 +482,59 @@ static int db_send(Lua L) {
     return 1;
 }
 
+static int db_profile(Lua L) {
+    FILE *f;
+    char buf[4096];
+    int rownum = 1;
+    int seconds;
+    SP sp = getsp(L);
+
+    if (sp) {
+        sp->max_num_instructions = 1000000; //allow large number of steps
+    }
+
+    if (!lua_isnumber(L, 1))
+        return luaL_error(L, "Expected number of seconds");
+
+    if (gbl_uses_password) {
+      if (sp && sp->clnt) {
+          int bdberr;
+          if (bdb_tbl_op_access_get(thedb->bdb_env, NULL, 0, "", sp->clnt->user, &bdberr)) {
+              return luaL_error(L, "User doesn't have access to run this command.");
+          }
+      }
+    }
+
+    seconds = lua_tointeger(L, 1);
+    lua_settop(L, 0);
+
+    if ((f = tmpfile()) == NULL)
+        return luaL_error(L, "Can't create a file for the profile");
+    if (profile_run(seconds, f) != 0) {
+        fclose(f);
+        return luaL_error(L, "A profile is already running");
+    }
+
+    lua_createtable(L, 0, 0);
+    rewind(f);
+    while (fgets(buf, sizeof(buf), f)) {
+        char *s;
+        s = strchr(buf, '\n');
+        if (s) *s = 0;
+
+        lua_createtable(L, 0, 1);
+
+        lua_pushstring(L, "out");
+        lua_pushstring(L, buf);
+        lua_settable(L, -3);
+
+        lua_rawseti(L, -2, rownum++);
+    }
+    fclose(f);
+
+    return 1;
+}
+
 static int db_comdb_start_replication(Lua L)
 {
     int rc;
@@ -544,6 +605,7 @@ static const luaL_Reg sys_funcs[] = {
     { "cluster", db_cluster },
     { "comdbg_tables", db_comdbg_tables },
     { "send", db_send },
+    { "profile", db_profile },
     { "load", db_csvcopy},
     { "comdb_analyze", db_comdb_analyze },
     { "comdb_verify", db_comdb_verify },
@@ -632,6 +694,26 @@ static struct sp_source syssps[] = {
         NULL
     },
 
+    {
+        // exec procedure sys.cmd.profile(30), then feed the rows to flamegraph.pl
+        "sys.cmd.profile",
+        "local function main(seconds)\n"
+        "    local schema = {\n"
+        "        { 'string', 'out' },\n"
+        "    }\n"
+        "    db:num_columns(table.getn(schema))\n"
+        "    for i, v in ipairs(schema) do\n"
+        "        db:column_name(v[2], i)\n"
+        "        db:column_type(v[1], i)\n"
+        "    end\n"
+        "    local msg = sys.profile(seconds)\n"
+        "    for i, v in ipairs(msg) do\n"
+        "        db:emit(v)\n"
+        "    end\n"
+        "end\n",
+        NULL
+    },
+
     {
         // to call analyze for a table: cdb2sql adidb local 'exec procedure sys.cmd.analyze("t1")'
         "sys.cmd.analyze",
@@ -165,6 +165,8 @@ struct comdb2mspace {
                              we do not write it to name because an allocator
                              may be reused by another type of thread later on */
     unsigned int debug : 1; /* Debugging flag. */
+    unsigned int tcache : 1; /* Lives as long as the process or as its refs, so
+                                its chunks may be kept in thread caches */
 
     size_t len;   /* length of name */
     char name[1]; /* name of the mspace */
@@ -458,6 +460,7 @@ int comdb2ma_init(size_t init_sz, size_t max_cap)
                     root.m = NULL;
                     break;
                 }
+                COMDB2_STATIC_MAS[i]->tcache = 1;
             }
 #endif /* !USE_SYS_ALLOC */
         }
@@ -718,6 +721,155 @@ static void get_stack_frames(void **fp, mspace m)
 #define get_stack_frames(fp, m)
 #endif
 
+/*
+ * Thread cache. The small chunks a thread frees are kept, by size class, for
+ * its next allocation of that class from the same allocator, so the hot paths
+ * that allocate and free the same sizes over and over don't take the
+ * allocator's lock each time. A cached chunk is still a chunk of the
+ * allocator it came from, and is still counted as in use there. When a bin
+ * grows past mem_thread_cache chunks, the least recently freed half goes back
+ * to the allocator under one lock; a thread gives back everything it has
+ * cached when it exits. Only the static and the per-thread allocators are
+ * cached. They are never destroyed while a chunk of theirs is out, and a
+ * cached chunk is out.
+ */
+int gbl_mem_thread_cache = 16;
+
+#define COMDB2MA_TC_SLOTS 8
+#define COMDB2MA_TC_SHIFT 4
+#define COMDB2MA_TC_CLASSES 16
+#define COMDB2MA_TC_MAX_SZ (COMDB2MA_TC_CLASSES << COMDB2MA_TC_SHIFT)
+
+struct tcache_bin {
+    void **head; /* chained through the first word of the payload */
+    int n;
+};
+
+struct tcache_slot {
+    comdb2ma cm;
+    int nchunks;
+    struct tcache_bin bins[COMDB2MA_TC_CLASSES];
+};
+
+static __thread struct tcache_slot tcache[COMDB2MA_TC_SLOTS];
+/* 0 - no destructor yet; 1 - registered; -1 - exiting, don't cache */
+static __thread int tcache_state;
+static pthread_once_t tcache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t tcache_key;
+
+static void comdb2_free_int(comdb2ma cm, void *ptr, int n);
+
+static inline struct tcache_slot *tcache_slot(comdb2ma cm)
+{
+    uintptr_t h = (uintptr_t)cm;
+    return &tcache[((h >> 6) ^ (h >> 12)) & (COMDB2MA_TC_SLOTS - 1)];
+}
+
+static void tcache_flush_slot(struct tcache_slot *slot)
+{
+    for (int i = 0; i != COMDB2MA_TC_CLASSES; ++i) {
+        struct tcache_bin *bin = &slot->bins[i];
+        if (bin->n != 0)
+            comdb2_free_int(slot->cm, bin->head, bin->n);
+        bin->head = NULL;
+        bin->n = 0;
+    }
+    slot->nchunks = 0;
+}
+
+static void tcache_exit(void *arg)
+{
+    tcache_state = -1;
+    for (int i = 0; i != COMDB2MA_TC_SLOTS; ++i) {
+        if (tcache[i].nchunks != 0)
+            tcache_flush_slot(&tcache[i]);
+    }
+}
+
+static void tcache_key_init(void)
+{
+    Pthread_key_create(&tcache_key, tcache_exit);
+}
+
+/* The size class a request of size from cm is cached in, or 0 if none */
+static inline int tcache_class(comdb2ma cm, size_t size)
+{
+    if (gbl_mem_thread_cache <= 0 || !cm->tcache || tcache_state < 0 ||
+        size > COMDB2MA_TC_MAX_SZ)
+        return 0;
+    return size == 0 ? 1 : (int)((size + (1 << COMDB2MA_TC_SHIFT) - 1) >>
+                                 COMDB2MA_TC_SHIFT);
+}
+
+static inline void **tcache_get(comdb2ma cm, int c)
+{
+    struct tcache_slot *slot = tcache_slot(cm);
+    struct tcache_bin *bin = &slot->bins[c - 1];
+    void **p;
+
+    if (slot->cm != cm || (p = bin->head) == NULL)
+        return NULL;
+    bin->head = (void **)*p;
+    --bin->n;
+    --slot->nchunks;
+    return p;
+}
+
+/* Returns 1 if p is kept in the thread cache, 0 if it is to be freed */
+static int tcache_put(comdb2ma cm, void **p)
+{
+    struct tcache_slot *slot;
+    struct tcache_bin *bin;
+    void **last, **rest;
+    size_t usable;
+    int max = gbl_mem_thread_cache, keep, c;
+
+    if (max <= 0 || !cm->tcache || tcache_state < 0 || COMDB2MA_ISDEBUG(p))
+        return 0;
+    /* a chunk is put in the largest class it can serve */
+    usable = comdb2_malloc_usable_size(p);
+    c = (int)(usable >> COMDB2MA_TC_SHIFT);
+    if (c == 0 || c > COMDB2MA_TC_CLASSES)
+        return 0;
+
+    if (tcache_state == 0) {
+        pthread_once(&tcache_once, tcache_key_init);
+        Pthread_setspecific(tcache_key, (void *)1);
+        tcache_state = 1;
+    }
+
+    slot = tcache_slot(cm);
+    if (slot->cm != cm) {
+        if (slot->nchunks != 0)
+            tcache_flush_slot(slot);
+        slot->cm = cm;
+    }
+
+    bin = &slot->bins[c - 1];
+    *p = (void *)bin->head;
+    bin->head = p;
+    ++bin->n;
+    ++slot->nchunks;
+
+    if (bin->n > max) {
+        keep = max >> 1;
+        if (keep == 0) {
+            rest = bin->head;
+            bin->head = NULL;
+        } else {
+            for (last = bin->head; --keep != 0; last = (void **)*last)
+                ;
+            rest = (void **)*last;
+            *last = NULL;
+        }
+        keep = max >> 1;
+        comdb2_free_int(cm, rest, bin->n - keep);
+        slot->nchunks -= bin->n - keep;
+        bin->n = keep;
+    }
+    return 1;
+}
+
 /*
  * Memory block layout
  * +----------------+
@@ -752,6 +904,14 @@ void *comdb2_malloc(comdb2ma cm, size_t size)
        in the middle of this malloc() call. */
     int d = debug_started;
     char *fp;
+    int c;
+
+    if ((c = (d && cm->debug) ? 0 : tcache_class(cm, size)) != 0) {
+        if ((out = tcache_get(cm, c)) != NULL)
+            return (void *)out;
+        /* so that the chunk goes back to the bin it is looked for in */
+        size = (size_t)c << COMDB2MA_TC_SHIFT;
+    }
 
     if (size > COMDB2MA_MAX_MEM) {
         // force failure if integer overflow
@@ -797,10 +957,14 @@ void *comdb2_calloc(comdb2ma cm, size_t n, size_t size)
 
     int d = debug_started;
     char *fp;
+    int c;
 
     if (n && size && COMDB2MA_MAX_MEM / n < size) {
         // force failure if integer overflow
         errno = ENOMEM;
+    } else if ((c = (d && cm->debug) ? 0 : tcache_class(cm, n * size)) != 0 &&
+               (out = tcache_get(cm, c)) != NULL) {
+        memset(out, 0, n * size);
     } else if (COMDB2MA_LOCK(cm) == 0) {
         nb = n * size;
         if (!COMDB2MA_FULL(cm))
@@ -938,14 +1102,20 @@ void *comdb2_resize(comdb2ma cm, void *ptr, size_t n)
     return (void *)out;
 }
 
-static void comdb2_free_int(comdb2ma cm, void *ptr)
+/* Free n chunks of cm, each after the first found in the first word of the
+   one before it */
+static void comdb2_free_int(comdb2ma cm, void *ptr, int n)
 {
-    void **p = (void **)ptr;
+    void **p = (void **)ptr, **next;
+    int i;
 
     if (COMDB2MA_LOCK(cm) == 0) {
-        mspace_free(cm->m, p + COMDB2MA_SENTINEL_OFS);
+        for (i = 0; i != n; ++i, p = next) {
+            next = (void **)*p;
+            mspace_free(cm->m, p + COMDB2MA_SENTINEL_OFS);
+        }
 #ifdef PER_THREAD_MALLOC
-        --cm->refs;
+        cm->refs -= n;
 
         /*
          * We must use (cm->nthds == 0) instead of (cm->nthds == 1) because
@@ -1005,10 +1175,10 @@ void comdb2_free(void *ptr)
         } else {
             cm = COMDB2MA_ALLOCATOR(p);
 
-            if (cm->bm == NULL)
-                comdb2_free_int(cm, ptr);
-            else
+            if (cm->bm != NULL)
                 comdb2_bfree(cm->bm, ptr);
+            else if (!tcache_put(cm, p))
+                comdb2_free_int(cm, ptr, 1);
         }
     }
 }
@@ -1080,6 +1250,20 @@ int comdb2_malloc_trim(comdb2ma cm, size_t pad)
     }
     return rc;
 }
+
+long comdb2ma_nblocks(comdb2ma cm)
+{
+#ifdef PER_THREAD_MALLOC
+    return (long)cm->refs;
+#else
+    return -1;
+#endif
+}
+
+size_t comdb2ma_footprint(comdb2ma cm)
+{
+    return mspace_footprint(cm->m);
+}
 // dynamic$
 
 //^static mspaces
@@ -1221,6 +1405,7 @@ static comdb2ma comdb2ma_create_int(void *base, size_t init_sz, size_t max_cap,
     out->line = line;
 
     out->debug = (debug_master_switch | debug_switches[find_switch_index(name)]);
+    out->tcache = 0;
 
 #ifdef PER_THREAD_MALLOC
     out->refs = 0;
@@ -1318,6 +1503,7 @@ static comdb2ma get_area(int indx)
                         __FILE__, __func__, __LINE__);
                     zone[indx]->onfreelist = indx;
                     zone[indx]->debug = (debug_master_switch | debug_switches[indx]);
+                    zone[indx]->tcache = 1;
                     listc_abl(&root.busylist[indx], zone[indx]);
                 } else {
                     /* Reached the limit. Grab one from busylist. */
@@ -2782,7 +2968,7 @@ static void comdb2_bfree_int(comdb2bma ma, void *ptr, int lk)
     if (lk && COMDB2BMA_LOCK(ma) != 0)
         return;
 
-    comdb2_free_int(ma->alloc, ptr);
+    comdb2_free_int(ma->alloc, ptr, 1);
 
     if (mspace_footprint(ma->alloc->m) > ma->cap)
         comdb2_malloc_trim(ma->alloc, 0);
@@ -457,6 +457,26 @@ int comdb2_malloc_stats(comdb2ma ma, int verbose, int human_readable,
 */
 int comdb2_malloc_trim(comdb2ma ma, size_t pad);
 
+/*
+** Return the number of blocks currently allocated from ma.
+**
+** PARAMETERS
+** ma  - memory allocator
+**
+** RETURN VALUE
+** >= 0 - number of live blocks
+** -1   - the allocator does not count its blocks
+*/
+long comdb2ma_nblocks(comdb2ma ma);
+
+/*
+** Return the number of bytes ma has obtained from the system.
+**
+** PARAMETERS
+** ma  - memory allocator
+*/
+size_t comdb2ma_footprint(comdb2ma ma);
+
 #endif /* COMDB2MA_OMIT_DYNAMIC */
 
 #ifndef COMDB2MA_OMIT_STATIC
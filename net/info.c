@@ -83,6 +83,18 @@ static void basic_node_data(struct host_node_tag *ptr)
     logmsg(LOGMSG_USER, "  enque bytes %-5u peak %-5u at %s\n",
            ptr->enque_bytes, ptr->peak_enque_bytes,
            fmt_time(&t, ptr->peak_enque_bytes_time));
+
+    if (ptr->peer_caps & NET_HELLO_CAP_LZ4 || ptr->stats.decompress_msgs)
+        logmsg(LOGMSG_USER,
+               "  lz4 sent %llu msgs %llu -> %llu bytes (ratio %.2f) "
+               "received %llu msgs\n",
+               ptr->stats.compress_msgs, ptr->stats.compress_bytes_in,
+               ptr->stats.compress_bytes_out,
+               ptr->stats.compress_bytes_out
+                   ? (double)ptr->stats.compress_bytes_in /
+                         ptr->stats.compress_bytes_out
+                   : 0.0,
+               ptr->stats.decompress_msgs);
 }
 
 static void basic_stat(netinfo_type *netinfo_ptr)
@@ -113,8 +125,11 @@ static void dump_node(netinfo_type *netinfo_ptr, char *host)
             basic_node_data(ptr);
             logmsg(LOGMSG_USER, "dedupe_count: %u\n", ptr->dedupe_count);
             Pthread_mutex_lock(&(ptr->enquelk));
-            logmsg(LOGMSG_USER, "write list %u items %u bytes:\n",
-                   ptr->enque_count, ptr->enque_bytes);
+            logmsg(LOGMSG_USER,
+                   "write list %u items %u bytes (low priority %u items %u "
+                   "bytes):\n",
+                   ptr->enque_count, ptr->enque_bytes, ptr->lowpri_count,
+                   ptr->lowpri_bytes);
             for (write_list_ptr = ptr->write_head; write_list_ptr != NULL;
                  write_list_ptr = write_list_ptr->next) {
                 logmsg(LOGMSG_USER, "  typ %d age %2d flg %2x len %4u\n",
@@ -70,6 +70,7 @@
 #include <assert.h>
 
 #include "locks_wrap.h"
+#include "comdb2_atomic.h"
 #include "net.h"
 #include "net_int.h"
 
@@ -101,8 +102,15 @@
 
 #include "debug_switches.h"
 #include "perf.h"
+#include "wait_event.h"
+#include "comdb2_pthread_create.h"
 
 #include <crc32c.h>
+#include <lz4.h>
+
+#if LZ4_VERSION_NUMBER < 10701
+#define LZ4_compress_default LZ4_compress_limitedOutput
+#endif
 
 #ifdef UDP_DEBUG
 static int curr_udp_cnt = 0;
@@ -189,7 +197,10 @@ static int read_connect_message(SBUF2 *sb, char hostname[], int hostnamel,
 static void *accept_thread(void *arg);
 static void *heartbeat_send_thread(void *arg);
 static void *heartbeat_check_thread(void *arg);
+static void *heartbeat_thread(void *arg);
 static void *writer_thread(void *args);
+/* most sampled messages timed per batch the writer takes */
+#define NET_SEND_LATENCY_MAX 8
 static void *reader_thread(void *arg);
 static void *connect_thread(void *arg);
 
@@ -506,6 +517,7 @@ static void close_hostnode_ll(host_node_type *host_node_ptr)
            send to garbcan without notifying sql, or master, and they
            will never be applied */
         host_node_ptr->got_hello = 0;
+        host_node_ptr->peer_caps = 0;
 
         shutdown_hostnode_socket(host_node_ptr);
 
@@ -580,8 +592,192 @@ static void check_list_sizes(host_node_type *host_node_ptr)
 
 int gbl_print_net_queue_size = 0;
 
+/* Lock-free enqueue: producers push onto a per-host stack with a CAS
+ * instead of taking enquelk.  The writer thread swaps the whole stack out,
+ * and applies the ordering (head, in-order, dedupe) while merging it into
+ * the write list, so those semantics are unchanged. */
+int gbl_net_lockfree_enqueue = 0;
+int gbl_net_lowpri_queue_pct = 50;
+
+static inline unsigned host_enque_count(host_node_type *host_node_ptr)
+{
+    return ATOMIC_LOAD32(host_node_ptr->enque_count) +
+           ATOMIC_LOAD32(host_node_ptr->mpsc_count);
+}
+
+static inline unsigned host_enque_bytes(host_node_type *host_node_ptr)
+{
+    return ATOMIC_LOAD32(host_node_ptr->enque_bytes) +
+           ATOMIC_LOAD32(host_node_ptr->mpsc_bytes);
+}
+
+/* Link an item into the write list after 'after', or at its head if that is
+ * NULL.  The caller should hold the enque lock. */
+static void link_write_data_lk(host_node_type *host_node_ptr,
+                               write_data *after, write_data *insert)
+{
+    insert->prev = after;
+    insert->next = after ? after->next : host_node_ptr->write_head;
+    if (insert->next)
+        insert->next->prev = insert;
+    else
+        host_node_ptr->write_tail = insert;
+    if (after)
+        after->next = insert;
+    else
+        host_node_ptr->write_head = insert;
+}
+
+/* Link an item into the write list.  The caller should hold the enque
+ * lock.  Low priority items stay at the tail, in the order they came; the
+ * others go ahead of all of them, as if the low priority ones weren't
+ * there. */
+static void enque_write_data_lk(netinfo_type *netinfo_ptr,
+                                host_node_type *host_node_ptr,
+                                write_data *insert)
+{
+    int flags = insert->flags;
+    write_data *last;
+
+    last = host_node_ptr->write_lowpri ? host_node_ptr->write_lowpri->prev
+                                       : host_node_ptr->write_tail;
+
+    if (flags & WRITE_MSG_LOWPRI) {
+        link_write_data_lk(host_node_ptr, host_node_ptr->write_tail, insert);
+        if (host_node_ptr->write_lowpri == NULL)
+            host_node_ptr->write_lowpri = insert;
+        host_node_ptr->lowpri_count++;
+        host_node_ptr->lowpri_bytes += insert->len;
+    } else if (flags & WRITE_MSG_HEAD) {
+        /* Insert at head of list */
+        link_write_data_lk(host_node_ptr, NULL, insert);
+    } else if (flags & WRITE_MSG_INORDER && netinfo_ptr->netcmp_rtn != NULL) {
+        int cnt = 0, reordered = 0;
+        write_data *ptr = last;
+
+        while (ptr != NULL &&
+               (netinfo_ptr->netcmp_rtn)(netinfo_ptr, insert->payload.raw,
+                                         insert->len, ptr->payload.raw,
+                                         ptr->len) < 0 &&
+               cnt++ < netinfo_ptr->enque_reorder_lookahead) {
+            reordered = 1;
+            ptr = ptr->prev;
+        }
+
+        /* Update some stats */
+        if (reordered) {
+            netinfo_ptr->stats.reorders++;
+            host_node_ptr->stats.reorders++;
+        }
+
+        /* Normal case: will be at the tail */
+        link_write_data_lk(host_node_ptr, ptr, insert);
+    } else {
+        /* Insert at tail of list */
+        link_write_data_lk(host_node_ptr, last, insert);
+    }
+
+    if (netinfo_ptr->qstat_enque_rtn) {
+        (netinfo_ptr->qstat_enque_rtn)(netinfo_ptr, host_node_ptr->qstat,
+                                       insert->payload.raw, insert->len);
+    }
+
+    if (host_node_ptr->netinfo_ptr->trace && debug_switch_net_verbose())
+        logmsg(LOGMSG_USER, "Queing %zu bytes %llu\n", insert->len, gettmms());
+    host_node_ptr->enque_count++;
+    if (host_node_ptr->enque_count > host_node_ptr->peak_enque_count) {
+        host_node_ptr->peak_enque_count = host_node_ptr->enque_count;
+        host_node_ptr->peak_enque_count_time = comdb2_time_epoch();
+    }
+    host_node_ptr->enque_bytes += insert->len;
+    if (host_node_ptr->enque_bytes > host_node_ptr->peak_enque_bytes) {
+        host_node_ptr->peak_enque_bytes = host_node_ptr->enque_bytes;
+        host_node_ptr->peak_enque_bytes_time = comdb2_time_epoch();
+    }
+}
+
+static void net_mpsc_push(host_node_type *host_node_ptr, write_data *insert)
+{
+    write_data *head;
+
+    insert->prev = NULL;
+    ATOMIC_ADD32(host_node_ptr->mpsc_count, 1);
+    ATOMIC_ADD32(host_node_ptr->mpsc_bytes, insert->len);
+    do {
+        head = ATOMIC_LOADPTR(host_node_ptr->mpsc_head);
+        insert->next = head;
+    } while (!CASPTR(host_node_ptr->mpsc_head, head, insert));
+}
+
+/* Move everything pushed by lock-free producers onto the write list.
+ * The caller should hold the enque lock. */
+static void net_mpsc_drain_lk(netinfo_type *netinfo_ptr,
+                              host_node_type *host_node_ptr)
+{
+    write_data *list, *next, *rev = NULL;
+    unsigned count = 0, bytes = 0;
+
+    if (ATOMIC_LOADPTR(host_node_ptr->mpsc_head) == NULL)
+        return;
+
+    list = (write_data *)XCHANGEPTR(host_node_ptr->mpsc_head, NULL);
+
+    /* the stack is newest first; put it back in enqueue order */
+    while (list) {
+        next = list->next;
+        list->next = rev;
+        rev = list;
+        count++;
+        bytes += list->len;
+        list = next;
+    }
+    ATOMIC_ADD32(host_node_ptr->mpsc_count, -count);
+    ATOMIC_ADD32(host_node_ptr->mpsc_bytes, -bytes);
+
+    for (list = rev; list; list = next) {
+        next = list->next;
+        if ((list->flags & WRITE_MSG_NODUPE) != 0 &&
+            host_node_ptr->write_head &&
+            list->payload.header.type ==
+                host_node_ptr->write_head->payload.header.type) {
+            host_node_ptr->dedupe_count++;
+            free(list);
+            continue;
+        }
+        enque_write_data_lk(netinfo_ptr, host_node_ptr, list);
+    }
+}
+
+/* Whether a message with these flags is to be turned away.  One message always
+ * slips in.  Low priority messages may fill up to net_lowpri_queue_pct of the
+ * queue; the others are held to the queue's limits with the low priority
+ * ones not counted, as the writer sends them first. */
+static int host_queue_full(netinfo_type *netinfo_ptr,
+                           host_node_type *host_node_ptr, int flags)
+{
+    unsigned count = host_enque_count(host_node_ptr);
+    unsigned bytes = host_enque_bytes(host_node_ptr);
+    unsigned lowcount = ATOMIC_LOAD32(host_node_ptr->lowpri_count);
+    unsigned lowbytes = ATOMIC_LOAD32(host_node_ptr->lowpri_bytes);
+    int pct = gbl_net_lowpri_queue_pct;
+
+    if ((flags & WRITE_MSG_NOLIMIT) || count == 0)
+        return 0;
+    if (flags & WRITE_MSG_LOWPRI) {
+        if (pct <= 0 || pct > 100)
+            pct = 100;
+        return lowcount > (long long)netinfo_ptr->max_queue * pct / 100 ||
+               lowbytes > (long long)netinfo_ptr->max_bytes * pct / 100 ||
+               count > netinfo_ptr->max_queue || bytes > netinfo_ptr->max_bytes;
+    }
+    if (lowcount <= count && lowbytes <= bytes) {
+        count -= lowcount;
+        bytes -= lowbytes;
+    }
+    return count > netinfo_ptr->max_queue || bytes > netinfo_ptr->max_bytes;
+}
+
 /* Enque a net message consisting of a header and some optional data.
- * The caller should hold the enque lock.
  * Note that dataptr1==NULL => datasz1==0 and dataptr2==NULL => datasz2==0
  */
 static int write_list(netinfo_type *netinfo_ptr, host_node_type *host_node_ptr,
@@ -594,19 +790,22 @@ static int write_list(netinfo_type *netinfo_ptr, host_node_type *host_node_ptr,
     char *ptr;
     int rc;
 
-    Pthread_mutex_lock(&(host_node_ptr->enquelk));
+    if (gbl_net_lockfree_enqueue) {
+        /* dedupe happens in the writer */
+        if (host_queue_full(netinfo_ptr, host_node_ptr, flags)) {
+            ATOMIC_ADD32(host_node_ptr->num_queue_full, 1);
+            return -2;
+        }
+        goto alloc;
+    }
 
+    Pthread_mutex_lock(&(host_node_ptr->enquelk));
 
-    /* let 1 message always slip in */
-    if (host_node_ptr->enque_count) {
-        if ((flags & WRITE_MSG_NOLIMIT) == 0 &&
-            ((host_node_ptr->enque_count > netinfo_ptr->max_queue) ||
-             (host_node_ptr->enque_bytes > netinfo_ptr->max_bytes))) {
-            host_node_ptr->num_queue_full++;
+    if (host_queue_full(netinfo_ptr, host_node_ptr, flags)) {
+        ATOMIC_ADD32(host_node_ptr->num_queue_full, 1);
 
-            rc = -2;
-            goto out;
-        }
+        rc = -2;
+        goto out;
     }
 
     /* Although generic, this logic was really added to ensure that we
@@ -625,6 +824,7 @@ static int write_list(netinfo_type *netinfo_ptr, host_node_type *host_node_ptr,
 
     Pthread_mutex_unlock(&(host_node_ptr->enquelk));
 
+alloc:
     for (datasz = 0, ii = 0; ii < iovcount; ii++) {
         if (iov[ii].iov_base)
             datasz += iov[ii].iov_len;
@@ -647,6 +847,12 @@ static int write_list(netinfo_type *netinfo_ptr, host_node_type *host_node_ptr,
 
     insert->flags = flags;
     insert->enque_time = comdb2_time_epoch();
+    insert->enque_us = 0;
+    if (netinfo_ptr->send_latency_rtn &&
+        *netinfo_ptr->send_latency_every > 0 &&
+        ATOMIC_ADD32(host_node_ptr->send_latency_tick, 1) %
+                *netinfo_ptr->send_latency_every == 0)
+        insert->enque_us = comdb2_time_epochus();
     insert->next = NULL;
     insert->prev = NULL;
     insert->len = sizeof(wire_header_type) + datasz;
@@ -671,81 +877,14 @@ static int write_list(netinfo_type *netinfo_ptr, host_node_type *host_node_ptr,
         }
     }
 
-    Pthread_mutex_lock(&(host_node_ptr->enquelk));
-
-    if (host_node_ptr->write_head == NULL) {
-        host_node_ptr->write_head = host_node_ptr->write_tail = insert;
-        insert->next = insert->prev = NULL;
-    } else if (flags & WRITE_MSG_HEAD) {
-        /* Insert at head of list */
-        insert->next = host_node_ptr->write_head;
-        insert->prev = NULL;
-        host_node_ptr->write_head->prev = insert;
-        host_node_ptr->write_head = insert;
-    } else if (flags & WRITE_MSG_INORDER && netinfo_ptr->netcmp_rtn != NULL) {
-        int cnt = 0, cmp, reordered = 0;
-        write_data *ptr = host_node_ptr->write_tail;
-
-        while (ptr != NULL &&
-               (cmp = (netinfo_ptr->netcmp_rtn)(
-                    netinfo_ptr, insert->payload.raw, insert->len,
-                    ptr->payload.raw, ptr->len)) < 0 &&
-               cnt++ < netinfo_ptr->enque_reorder_lookahead) {
-            reordered = 1;
-            ptr = ptr->prev;
-        }
-
-        /* Update some stats */
-        if (reordered) {
-            netinfo_ptr->stats.reorders++;
-            host_node_ptr->stats.reorders++;
-        }
-
-        /* Insert at head */
-        if (ptr == NULL) {
-            insert->next = host_node_ptr->write_head;
-            insert->prev = NULL;
-            host_node_ptr->write_head->prev = insert;
-            host_node_ptr->write_head = insert;
-        } else {
-            insert->prev = ptr;
-            insert->next = ptr->next;
-
-            /* Normal case: will be at the tail */
-            if (ptr == host_node_ptr->write_tail) {
-                host_node_ptr->write_tail = insert;
-            } else {
-                ptr->next->prev = insert;
-            }
-            ptr->next = insert;
-        }
-    } else
-
-    {
-        /* Insert at tail of list */
-        host_node_ptr->write_tail->next = insert;
-        insert->prev = host_node_ptr->write_tail;
-        insert->next = NULL;
-        host_node_ptr->write_tail = insert;
+    if (gbl_net_lockfree_enqueue) {
+        net_mpsc_push(host_node_ptr, insert);
+        return 0;
     }
 
-    if (netinfo_ptr->qstat_enque_rtn) {
-        (netinfo_ptr->qstat_enque_rtn)(netinfo_ptr, host_node_ptr->qstat,
-                                       insert->payload.raw, insert->len);
-    }
+    Pthread_mutex_lock(&(host_node_ptr->enquelk));
 
-    if (host_node_ptr->netinfo_ptr->trace && debug_switch_net_verbose())
-        logmsg(LOGMSG_USER, "Queing %zu bytes %llu\n", insert->len, gettmms());
-    host_node_ptr->enque_count++;
-    if (host_node_ptr->enque_count > host_node_ptr->peak_enque_count) {
-        host_node_ptr->peak_enque_count = host_node_ptr->enque_count;
-        host_node_ptr->peak_enque_count_time = comdb2_time_epoch();
-    }
-    host_node_ptr->enque_bytes += insert->len;
-    if (host_node_ptr->enque_bytes > host_node_ptr->peak_enque_bytes) {
-        host_node_ptr->peak_enque_bytes = host_node_ptr->enque_bytes;
-        host_node_ptr->peak_enque_bytes_time = comdb2_time_epoch();
-    }
+    enque_write_data_lk(netinfo_ptr, host_node_ptr, insert);
 
     rc = 0;
 
@@ -935,6 +1074,180 @@ static ssize_t write_stream(netinfo_type *netinfo_ptr,
     return nwrite;
 }
 
+/* Vectored writer: when enabled, the writer thread hands the queued
+ * write_data payloads straight to sendmsg() instead of copying them through
+ * the SBUF2 buffer.  Payloads of at least gbl_net_zerocopy_min_bytes are sent
+ * with MSG_ZEROCOPY where the kernel supports it (0 disables). */
+int gbl_net_writev = 0;
+int gbl_net_zerocopy_min_bytes = 0;
+
+/* Replication stream compression: user messages of at least
+ * gbl_net_compress_min_bytes are sent LZ4 compressed to peers whose hello
+ * said they can decode them.  Every node advertises the capability, so only
+ * the sending side needs gbl_net_compress turned on. */
+int gbl_net_compress = 0;
+int gbl_net_compress_min_bytes = 1024;
+
+#define NET_WRITEV_MAX_IOV 64
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#if defined(_LINUX_SOURCE) && defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+#include <linux/errqueue.h>
+#define NET_HAVE_ZEROCOPY 1
+#endif
+
+static int net_sendmsg(netinfo_type *netinfo_ptr, host_node_type *host_node_ptr,
+                       struct iovec *iov, int niov, int sendflags)
+{
+    SBUF2 *sb = host_node_ptr->sb;
+    struct msghdr msg = {0};
+    struct pollfd pol;
+    int fd, readtimeout, writetimeout, rc;
+    ssize_t n;
+
+    fd = sbuf2fileno(sb);
+    sbuf2gettimeout(sb, &readtimeout, &writetimeout);
+
+    while (niov > 0) {
+        if (writetimeout > 0) {
+            do {
+                pol.fd = fd;
+                pol.events = POLLOUT;
+                rc = poll(&pol, 1, writetimeout);
+            } while (rc == -1 && errno == EINTR);
+            if (rc <= 0 || (pol.revents & POLLOUT) == 0)
+                return -1;
+        }
+
+        msg.msg_iov = iov;
+        msg.msg_iovlen = niov;
+        n = sendmsg(fd, &msg, sendflags | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+#ifdef NET_HAVE_ZEROCOPY
+            /* Out of optmem for pinning pages: fall back to a copy */
+            if (errno == ENOBUFS && (sendflags & MSG_ZEROCOPY)) {
+                sendflags &= ~MSG_ZEROCOPY;
+                continue;
+            }
+#endif
+            return -1;
+        }
+
+#ifdef NET_HAVE_ZEROCOPY
+        if (sendflags & MSG_ZEROCOPY) {
+            host_node_ptr->zc_seq++;
+            host_node_ptr->stats.zerocopy_sends++;
+            netinfo_ptr->stats.zerocopy_sends++;
+        }
+#endif
+        netinfo_ptr->stats.bytes_written += n;
+        netinfo_ptr->stats.writev_calls++;
+        netinfo_ptr->stats.writev_bytes += n;
+        host_node_ptr->stats.bytes_written += n;
+        host_node_ptr->stats.writev_calls++;
+        host_node_ptr->stats.writev_bytes += n;
+
+        while (niov > 0 && n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            niov--;
+        }
+        if (niov > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+#ifdef NET_HAVE_ZEROCOPY
+/* Free zerocopy payloads the kernel is done with.  TCP completes zerocopy
+ * sends in order, so the highest completed sequence is a watermark. */
+static void net_zerocopy_reap(netinfo_type *netinfo_ptr,
+                              host_node_type *host_node_ptr)
+{
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+    struct msghdr msg;
+    struct cmsghdr *cm;
+    struct sock_extended_err *serr;
+    write_data *wd;
+    int fd;
+
+    if (host_node_ptr->zc_head == NULL)
+        return;
+
+    fd = sbuf2fileno(host_node_ptr->sb);
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1)
+            break;
+        for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            serr = (struct sock_extended_err *)CMSG_DATA(cm);
+            if (serr->ee_errno != 0 ||
+                serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+            if ((int)(serr->ee_data + 1 - host_node_ptr->zc_done) > 0)
+                host_node_ptr->zc_done = serr->ee_data + 1;
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                host_node_ptr->stats.zerocopy_copied++;
+                netinfo_ptr->stats.zerocopy_copied++;
+            }
+        }
+    }
+
+    while ((wd = host_node_ptr->zc_head) != NULL &&
+           (int)(wd->zc_seq - host_node_ptr->zc_done) < 0) {
+        host_node_ptr->zc_head = wd->next;
+        free(wd);
+    }
+    if (host_node_ptr->zc_head == NULL)
+        host_node_ptr->zc_tail = NULL;
+}
+
+static void net_zerocopy_park(host_node_type *host_node_ptr, write_data *wd)
+{
+    wd->zc_seq = host_node_ptr->zc_seq - 1;
+    wd->next = NULL;
+    if (host_node_ptr->zc_tail)
+        host_node_ptr->zc_tail->next = wd;
+    else
+        host_node_ptr->zc_head = wd;
+    host_node_ptr->zc_tail = wd;
+}
+#endif
+
+static void net_zerocopy_free_all(host_node_type *host_node_ptr)
+{
+    write_data *wd;
+    while ((wd = host_node_ptr->zc_head) != NULL) {
+        host_node_ptr->zc_head = wd->next;
+        free(wd);
+    }
+    host_node_ptr->zc_tail = NULL;
+}
+
+static int net_writev_batch(netinfo_type *netinfo_ptr,
+                            host_node_type *host_node_ptr, struct iovec *iov,
+                            write_data **batch, int *nbatch)
+{
+    int ii, rc;
+
+    if (*nbatch == 0)
+        return 0;
+    rc = net_sendmsg(netinfo_ptr, host_node_ptr, iov, *nbatch, 0);
+    for (ii = 0; ii < *nbatch; ii++)
+        free(batch[ii]);
+    *nbatch = 0;
+    return rc;
+}
+
 #if WITH_SSL
 extern ssl_mode gbl_rep_ssl_mode;
 extern SSL_CTX *gbl_ssl_ctx;
@@ -1061,6 +1374,8 @@ static int empty_write_list(host_node_type *host_node_ptr)
 
     Pthread_mutex_lock(&(host_node_ptr->enquelk));
 
+    net_mpsc_drain_lk(host_node_ptr->netinfo_ptr, host_node_ptr);
+
     nxt = ptr = host_node_ptr->write_head;
     while (nxt != NULL) {
         ptr = ptr->next;
@@ -1068,9 +1383,12 @@ static int empty_write_list(host_node_type *host_node_ptr)
         nxt = ptr;
     }
     host_node_ptr->write_head = host_node_ptr->write_tail = NULL;
+    host_node_ptr->write_lowpri = NULL;
 
     host_node_ptr->enque_count = 0;
     host_node_ptr->enque_bytes = 0;
+    host_node_ptr->lowpri_count = 0;
+    host_node_ptr->lowpri_bytes = 0;
 
     Pthread_mutex_unlock(&(host_node_ptr->enquelk));
 
@@ -1223,8 +1541,17 @@ static int write_message_int(netinfo_type *netinfo_ptr,
     }
 
     /* wake up the writer thread */
-    if (flags & WRITE_MSG_NODELAY)
-        Pthread_cond_signal(&(host_node_ptr->write_wakeup));
+    if (flags & WRITE_MSG_NODELAY) {
+        if (gbl_net_lockfree_enqueue &&
+            ATOMIC_LOAD32(host_node_ptr->writer_waiting)) {
+            /* the writer holds enquelk until it is in its wait */
+            Pthread_mutex_lock(&(host_node_ptr->enquelk));
+            Pthread_cond_signal(&(host_node_ptr->write_wakeup));
+            Pthread_mutex_unlock(&(host_node_ptr->enquelk));
+        } else {
+            Pthread_cond_signal(&(host_node_ptr->write_wakeup));
+        }
+    }
 
     return 0;
 }
@@ -1232,13 +1559,15 @@ static int write_message_int(netinfo_type *netinfo_ptr,
 static int write_message_checkhello(netinfo_type *netinfo_ptr,
                                     host_node_type *host_node_ptr, int type,
                                     const struct iovec *iov, int iovcount,
-                                    int nodelay, int nodrop, int inorder)
+                                    int nodelay, int nodrop, int inorder,
+                                    int lowpri)
 {
     return write_message_int(netinfo_ptr, host_node_ptr, type, iov, iovcount,
                              (nodelay ? WRITE_MSG_NODELAY : 0) |
                                  WRITE_MSG_NOHELLOCHECK |
                                  (nodrop ? WRITE_MSG_NOLIMIT : 0) |
-                                 (inorder ? WRITE_MSG_INORDER : 0));
+                                 (inorder ? WRITE_MSG_INORDER : 0) |
+                                 (lowpri ? WRITE_MSG_LOWPRI : 0));
 }
 
 static int write_message_nohello(netinfo_type *netinfo_ptr,
@@ -1317,6 +1646,15 @@ static int write_heartbeat(netinfo_type *netinfo_ptr,
                                  WRITE_MSG_NODELAY | WRITE_MSG_NOLIMIT);
 }
 
+static uint8_t *put_hello_caps(uint8_t *p_buf, const uint8_t *p_buf_end)
+{
+    int magic = NET_HELLO_EXT_MAGIC;
+    int caps = NET_HELLO_CAP_LZ4;
+
+    p_buf = buf_put(&magic, sizeof(int), p_buf, p_buf_end);
+    return buf_put(&caps, sizeof(int), p_buf, p_buf_end);
+}
+
 /*
   this is the protocol where each node advertises all the other nodes
   they know about so that eventually (quickly) every node know about
@@ -1346,7 +1684,8 @@ static int write_hello(netinfo_type *netinfo_ptr, host_node_type *host_node_ptr)
              (HOSTNAME_LEN * numhosts) + /* char host[16]... ( 1 per host ) */
              (sizeof(int) * numhosts) +  /* int port...      ( 1 per host ) */
              (sizeof(int) * numhosts) +  /* int node...      ( 1 per host ) */
-             (8 * numhosts);             /* some fluff space */
+             (8 * numhosts) +            /* some fluff space */
+             sizeof(int) + sizeof(int);  /* int magic, int caps */
 
     /* write long hostnames */
     for (tmp_host_ptr = netinfo_ptr->head; tmp_host_ptr != NULL;
@@ -1400,6 +1739,7 @@ static int write_hello(netinfo_type *netinfo_ptr, host_node_type *host_node_ptr)
                 buf_no_net_put(tmp_host_ptr->host, tmp_host_ptr->hostname_len,
                                p_buf, p_buf_end);
     }
+    p_buf = put_hello_caps(p_buf, p_buf_end);
 
     Pthread_rwlock_unlock(&(netinfo_ptr->lock));
 
@@ -1433,7 +1773,8 @@ static int write_hello_reply(netinfo_type *netinfo_ptr,
              (HOSTNAME_LEN * numhosts) + /* char host[16]... ( 1 per host ) */
              (sizeof(int) * numhosts) +  /* int port...      ( 1 per host ) */
              (sizeof(int) * numhosts) +  /* int node...      ( 1 per host ) */
-             (8 * numhosts);             /* some fluff space */
+             (8 * numhosts) +            /* some fluff space */
+             sizeof(int) + sizeof(int);  /* int magic, int caps */
 
     /* write long hostnames */
     for (tmp_host_ptr = netinfo_ptr->head; tmp_host_ptr != NULL;
@@ -1490,6 +1831,7 @@ static int write_hello_reply(netinfo_type *netinfo_ptr,
                 buf_no_net_put(tmp_host_ptr->host, tmp_host_ptr->hostname_len,
                                p_buf, p_buf_end);
     }
+    p_buf = put_hello_caps(p_buf, p_buf_end);
 
     Pthread_rwlock_unlock(&(netinfo_ptr->lock));
 
@@ -1588,8 +1930,9 @@ static void net_throttle_wait_loop(netinfo_type *netinfo_ptr,
     Pthread_mutex_lock(&(host_ptr->throttle_lock));
     host_ptr->throttle_waiters++;
 
-    while (!host_ptr->closed && ((host_ptr->enque_count > queue_threshold) ||
-                                 (host_ptr->enque_bytes > byte_threshold)))
+    while (!host_ptr->closed &&
+           ((host_enque_count(host_ptr) > queue_threshold) ||
+            (host_enque_bytes(host_ptr) > byte_threshold)))
 
     {
         struct timespec waittime;
@@ -1648,10 +1991,11 @@ int net_throttle_wait(netinfo_type *netinfo_ptr)
 
     host_node_type *ptr = netinfo_ptr->head;
     /* let 1 message always slip in */
-    if (ptr && ptr->enque_count) {
+    if (ptr && host_enque_count(ptr)) {
         while (ptr) {
-            if (!ptr->closed && ((ptr->enque_count > queue_threshold) ||
-                                 (ptr->enque_bytes > byte_threshold))) {
+            if (!ptr->closed &&
+                ((host_enque_count(ptr) > queue_threshold) ||
+                 (host_enque_bytes(ptr) > byte_threshold))) {
                 cnt++;
                 net_throttle_wait_loop(netinfo_ptr, ptr, queue_threshold,
                                        byte_threshold);
@@ -1678,7 +2022,7 @@ int net_get_queue_size(netinfo_type *netinfo_ptr, const char *hostname,
     }
 
     Pthread_mutex_lock(&(host_node_ptr->enquelk));
-    *usage = host_node_ptr->enque_count;
+    *usage = host_enque_count(host_node_ptr);
     *limit = netinfo_ptr->max_queue;
     Pthread_mutex_unlock(&(host_node_ptr->enquelk));
 
@@ -1718,6 +2062,8 @@ int net_send_message_payload_ack(netinfo_type *netinfo_ptr, const char *to_host,
         return NET_SEND_FAIL_INVALIDNODE;
     }
 
+    uint64_t wait = wait_event_begin(WAIT_EVENT_NET_SEND);
+
     if (host_node_ptr->host == netinfo_ptr->myhostname) {
         rc = NET_SEND_FAIL_SENDTOME;
         goto end;
@@ -1762,7 +2108,7 @@ int net_send_message_payload_ack(netinfo_type *netinfo_ptr, const char *to_host,
 
     rc = write_message_checkhello(netinfo_ptr, host_node_ptr,
                                   WIRE_HEADER_USER_MSG, iov, 2, 1 /*nodelay*/,
-                                  0, 0);
+                                  0, 0, 0);
 
     if (rc != 0) {
         if (seq_ptr)
@@ -1862,6 +2208,7 @@ int net_send_message_payload_ack(netinfo_type *netinfo_ptr, const char *to_host,
     }
 
 end:
+    wait_event_end(wait);
     Pthread_rwlock_unlock(&(netinfo_ptr->lock));
 
     return rc;
@@ -1974,10 +2321,70 @@ static void dump_queue(netinfo_type *netinfo_ptr, host_node_type *host_node_ptr)
     }
 }
 
-static int net_send_int(netinfo_type *netinfo_ptr, const char *host,
-                        int usertype, void *data, int datalen, int nodelay,
-                        int numtails, void **tails, int *taillens, int nodrop,
-                        int inorder, int trace)
+/* LZ4 compress a user message payload (data followed by its tails) into a
+ * single malloced buffer laid out as [complen][compressed data].  Returns
+ * NULL if the payload doesn't shrink. */
+static void *net_compress_payload(netinfo_type *netinfo_ptr,
+                                  host_node_type *host_node_ptr, void *data,
+                                  int datalen, void **tails, int *taillens,
+                                  int numtails, int len, int *outlen)
+{
+    char *src, *dst;
+    int complen, off, i;
+    uint8_t *p_buf, *p_buf_end;
+
+    if (len <= (int)(2 * sizeof(int)))
+        return NULL;
+
+    if (len == datalen) {
+        src = data;
+    } else {
+        src = malloc(len);
+        if (src == NULL)
+            return NULL;
+        off = 0;
+        if (data && datalen) {
+            memcpy(src, data, datalen);
+            off = datalen;
+        }
+        for (i = 0; i < numtails; i++) {
+            memcpy(src + off, tails[i], taillens[i]);
+            off += taillens[i];
+        }
+    }
+
+    /* no room for anything that wouldn't save at least a byte */
+    dst = malloc(len);
+    complen = 0;
+    if (dst)
+        complen = LZ4_compress_default(src, dst + sizeof(int), len,
+                                       len - sizeof(int) - 1);
+    if (src != data)
+        free(src);
+    if (complen <= 0) {
+        free(dst);
+        return NULL;
+    }
+
+    p_buf = (uint8_t *)dst;
+    p_buf_end = p_buf + sizeof(int);
+    buf_put(&complen, sizeof(int), p_buf, p_buf_end);
+    *outlen = sizeof(int) + complen;
+
+    host_node_ptr->stats.compress_msgs++;
+    host_node_ptr->stats.compress_bytes_in += len;
+    host_node_ptr->stats.compress_bytes_out += *outlen;
+    netinfo_ptr->stats.compress_msgs++;
+    netinfo_ptr->stats.compress_bytes_in += len;
+    netinfo_ptr->stats.compress_bytes_out += *outlen;
+
+    return dst;
+}
+
+static int net_send_int_ll(netinfo_type *netinfo_ptr, const char *host,
+                           int usertype, void *data, int datalen, int nodelay,
+                           int numtails, void **tails, int *taillens, int nodrop,
+                           int inorder, int trace, int lowpri)
 {
     host_node_type *host_node_ptr;
     net_send_message_header tmphd, msghd;
@@ -1988,6 +2395,9 @@ static int net_send_int(netinfo_type *netinfo_ptr, const char *host,
     int total_tails_len = 0;
     int i;
     int tailen;
+    int wire_type = WIRE_HEADER_USER_MSG;
+    void *zbuf = NULL;
+    int zlen;
 #if 0
    if (strcmp(netinfo_ptr->service, "offloadsql") == 0) {
        printf("net %s usertype %d to %s\n", netinfo_ptr->service, usertype, host);
@@ -2108,14 +2518,27 @@ static int net_send_int(netinfo_type *netinfo_ptr, const char *host,
         }
     }
 
+    if (gbl_net_compress && (host_node_ptr->peer_caps & NET_HELLO_CAP_LZ4) &&
+        msghd.datalen >= gbl_net_compress_min_bytes &&
+        (zbuf = net_compress_payload(netinfo_ptr, host_node_ptr, data,
+                                     datalen, tails, taillens, numtails,
+                                     msghd.datalen, &zlen)) != NULL) {
+        iov[1].iov_base = zbuf;
+        iov[1].iov_len = zlen;
+        iovcount = 2;
+        wire_type = WIRE_HEADER_USER_MSG_LZ4;
+    }
+
     if (nodelay) {
         host_node_ptr->num_flushes++;
         num_flushes++;
     }
 
-    rc = write_message_checkhello(netinfo_ptr, host_node_ptr,
-                                  WIRE_HEADER_USER_MSG, iov, iovcount, nodelay,
-                                  nodrop, inorder);
+    rc = write_message_checkhello(netinfo_ptr, host_node_ptr, wire_type, iov,
+                                  iovcount, nodelay, nodrop, inorder, lowpri);
+
+    /* write_list copied the payload */
+    free(zbuf);
 
     /* queue is full */
     if (-2 == rc) {
@@ -2153,6 +2576,19 @@ end:
     return rc;
 }
 
+static int net_send_int(netinfo_type *netinfo_ptr, const char *host,
+                        int usertype, void *data, int datalen, int nodelay,
+                        int numtails, void **tails, int *taillens, int nodrop,
+                        int inorder, int trace, int lowpri)
+{
+    uint64_t wait = wait_event_begin(WAIT_EVENT_NET_SEND);
+    int rc = net_send_int_ll(netinfo_ptr, host, usertype, data, datalen,
+                             nodelay, numtails, tails, taillens, nodrop,
+                             inorder, trace, lowpri);
+    wait_event_end(wait);
+    return rc;
+}
+
 int net_send_authcheck_all(netinfo_type *netinfo_ptr)
 {
     int rc, count = 0, i;
@@ -2180,14 +2616,14 @@ int net_send_inorder(netinfo_type *netinfo_ptr, const char *host, int usertype,
                      void *data, int datalen, int nodelay)
 {
     return net_send_int(netinfo_ptr, host, usertype, data, datalen, nodelay, 0,
-                        NULL, 0, 0, 1, 0);
+                        NULL, 0, 0, 1, 0, 0);
 }
 
 int net_send_inorder_nodrop(netinfo_type *netinfo_ptr, const char *host,
                             int usertype, void *data, int datalen, int nodelay)
 {
     return net_send_int(netinfo_ptr, host, usertype, data, datalen, nodelay, 0,
-                        NULL, 0, 1, 1, 0);
+                        NULL, 0, 1, 1, 0, 0);
 }
 
 int net_send_flags(netinfo_type *netinfo_ptr, const char *host, int usertype,
@@ -2196,7 +2632,7 @@ int net_send_flags(netinfo_type *netinfo_ptr, const char *host, int usertype,
     return net_send_int(netinfo_ptr, host, usertype, data, datalen,
                         (flags & NET_SEND_NODELAY), 0, NULL, 0,
                         (flags & NET_SEND_NODROP), (flags & NET_SEND_INORDER),
-                        (flags & NET_SEND_TRACE));
+                        (flags & NET_SEND_TRACE), (flags & NET_SEND_LOWPRI));
 }
 
 int net_send(netinfo_type *netinfo_ptr, const char *host, int usertype,
@@ -2204,7 +2640,7 @@ int net_send(netinfo_type *netinfo_ptr, const char *host, int usertype,
 {
 
     return net_send_int(netinfo_ptr, host, usertype, data, datalen, nodelay, 0,
-                        NULL, 0, 0, 0, 0);
+                        NULL, 0, 0, 0, 0, 0);
 }
 
 int net_send_nodrop(netinfo_type *netinfo_ptr, const char *host, int usertype,
@@ -2212,7 +2648,7 @@ int net_send_nodrop(netinfo_type *netinfo_ptr, const char *host, int usertype,
 {
 
     return net_send_int(netinfo_ptr, host, usertype, data, datalen, nodelay, 0,
-                        NULL, 0, 1, 0, 0);
+                        NULL, 0, 1, 0, 0, 0);
 }
 
 int net_send_tails(netinfo_type *netinfo_ptr, const char *host, int usertype,
@@ -2221,7 +2657,7 @@ int net_send_tails(netinfo_type *netinfo_ptr, const char *host, int usertype,
 {
 
     return net_send_int(netinfo_ptr, host, usertype, data, datalen, nodelay,
-                        numtails, tails, taillens, 0, 0, 0);
+                        numtails, tails, taillens, 0, 0, 0, 0);
 }
 
 int net_send_tail(netinfo_type *netinfo_ptr, const char *host, int usertype,
@@ -2241,7 +2677,7 @@ int net_send_tail(netinfo_type *netinfo_ptr, const char *host, int usertype,
     printf("\n");
 #endif
     return net_send_int(netinfo_ptr, host, usertype, data, datalen, nodelay, 1,
-                        &tail, &tailen, 0, 0, 0);
+                        &tail, &tailen, 0, 0, 0, 0);
 }
 
 /* returns all nodes MINUS you */
@@ -2350,6 +2786,14 @@ int net_register_queue_stat(netinfo_type *netinfo_ptr, QSTATINITFP *qinit,
     return 0;
 }
 
+int net_register_send_latency(netinfo_type *netinfo_ptr,
+                              NETSENDLATENCYFP *func, const int *every)
+{
+    netinfo_ptr->send_latency_every = every;
+    netinfo_ptr->send_latency_rtn = func;
+    return 0;
+}
+
 void net_userfunc_iterate(netinfo_type *netinfo_ptr, UFUNCITERFP *uf_iter,
                           void *arg)
 {
@@ -2740,7 +3184,8 @@ static void rem_from_netinfo_ll(netinfo_type *netinfo_ptr,
         netinfo_ptr->last_used_node_ptr = NULL;
     }
 
-    if (host_node_ptr->write_head != NULL) {
+    if (host_node_ptr->write_head != NULL ||
+        ATOMIC_LOADPTR(host_node_ptr->mpsc_head) != NULL) {
         /* purge anything pending to be sent */
         Pthread_mutex_lock(&(host_node_ptr->write_lock));
         empty_write_list(host_node_ptr);
@@ -3270,7 +3715,7 @@ void print_netinfo(netinfo_type *netinfo_ptr)
    number of entries actually returned
  */
 static int read_hostlist(netinfo_type *netinfo_ptr, SBUF2 *sb, char *hosts[],
-                         int ports[], int *numhosts)
+                         int ports[], int *numhosts, int *caps)
 {
     int datasz;
     int i;
@@ -3355,14 +3800,75 @@ static int read_hostlist(netinfo_type *netinfo_ptr, SBUF2 *sb, char *hosts[],
         }
     }
 
+    /* capabilities trail the host list; older nodes don't send them */
+    *caps = 0;
+    if (num == *numhosts && p_buf && p_buf_end - p_buf >= (int)(2 * sizeof(int))) {
+        int magic, c;
+        p_buf = (uint8_t *)buf_get(&magic, sizeof(int), p_buf, p_buf_end);
+        p_buf = (uint8_t *)buf_get(&c, sizeof(int), p_buf, p_buf_end);
+        if (magic == NET_HELLO_EXT_MAGIC)
+            *caps = c;
+    }
+
     free(data);
 
     return 0;
 }
 
+/* Read and decompress the [complen][lz4 data] body of a
+ * WIRE_HEADER_USER_MSG_LZ4 message into data, which holds datalen bytes. */
+static int read_compressed_user_data(host_node_type *host_node_ptr, void *data,
+                                     int datalen)
+{
+    netinfo_type *netinfo_ptr = host_node_ptr->netinfo_ptr;
+    uint8_t lenbf[sizeof(int)];
+    int complen, rc;
+    char *comp;
+
+    rc = read_stream(netinfo_ptr, host_node_ptr, host_node_ptr->sb, lenbf,
+                     sizeof(lenbf));
+    if (rc != sizeof(lenbf))
+        return -1;
+    buf_get(&complen, sizeof(int), lenbf, lenbf + sizeof(lenbf));
+    if (complen <= 0 || complen >= datalen) {
+        host_node_errf(LOGMSG_ERROR, host_node_ptr,
+                       "%s: bad compressed length %d for %d bytes\n", __func__,
+                       complen, datalen);
+        return -1;
+    }
+
+    comp = HOST_MALLOC(host_node_ptr, complen);
+    if (comp == NULL) {
+        host_node_errf(LOGMSG_ERROR, host_node_ptr, "%s: malloc %d failed\n",
+                       __func__, complen);
+        return -1;
+    }
+    rc = read_stream(netinfo_ptr, host_node_ptr, host_node_ptr->sb, comp,
+                     complen);
+    if (rc != complen) {
+        host_node_errf(LOGMSG_ERROR, host_node_ptr,
+                       "%s: wanted %d bytes, got %d\n", __func__, complen, rc);
+        free(comp);
+        return -1;
+    }
+
+    rc = LZ4_decompress_safe(comp, data, complen, datalen);
+    free(comp);
+    if (rc != datalen) {
+        host_node_errf(LOGMSG_ERROR, host_node_ptr,
+                       "%s: decompressed %d bytes, expected %d\n", __func__,
+                       rc, datalen);
+        return -1;
+    }
+
+    host_node_ptr->stats.decompress_msgs++;
+    netinfo_ptr->stats.decompress_msgs++;
+    return 0;
+}
+
 static int read_user_data(host_node_type *host_node_ptr, int *type, int *seqnum,
                           int *needack, int *datalen, void **data,
-                          int *malloced)
+                          int *malloced, int compressed)
 {
     int rc;
     net_send_message_header msghdr;
@@ -3406,6 +3912,14 @@ static int read_user_data(host_node_type *host_node_ptr, int *type, int *seqnum,
                            *datalen);
             goto fail;
         }
+        if (compressed) {
+            if (read_compressed_user_data(host_node_ptr, *data, *datalen)) {
+                if (*malloced)
+                    free(*data);
+                goto fail;
+            }
+            return 0;
+        }
         rc = read_stream(netinfo_ptr, host_node_ptr, sb, *data, *datalen);
         if (rc != *datalen) {
             host_node_errf(LOGMSG_ERROR, host_node_ptr,
@@ -3609,7 +4123,7 @@ int net_ack_message(void *handle, int outrc)
 }
 
 static int process_user_message(netinfo_type *netinfo_ptr,
-                                host_node_type *host_node_ptr)
+                                host_node_type *host_node_ptr, int compressed)
 {
     int usertype, seqnum, datalen, needack;
     ack_state_type *ack_state = NULL;
@@ -3623,7 +4137,7 @@ static int process_user_message(netinfo_type *netinfo_ptr,
     int malloced = 0;
 
     int rc = read_user_data(host_node_ptr, &usertype, &seqnum, &needack,
-                            &datalen, &data, &malloced);
+                            &datalen, &data, &malloced, compressed);
 
 #if 0
     logmsg(LOGMSG_DEBUG, "process_user_message from %s, ut=%d\n",
@@ -4022,6 +4536,143 @@ void kill_subnet(const char *subnet)
 }
 
 int gbl_net_writer_thread_poll_ms = 1000;
+int gbl_net_single_heartbeat_thread = 1;
+
+/* Fill in the wire header with correct details for our current connection. */
+static void net_fill_wire_header(netinfo_type *netinfo_ptr,
+                                 host_node_type *host_node_ptr,
+                                 write_data *write_list_ptr)
+{
+    wire_header_type *wire_header, tmp_wire_hdr;
+    uint8_t *p_buf, *p_buf_end;
+
+    wire_header = &write_list_ptr->payload.header;
+    if (netinfo_ptr->myhostname_len > HOSTNAME_LEN) {
+        snprintf(tmp_wire_hdr.fromhost, sizeof(tmp_wire_hdr.fromhost), ".%d",
+                 netinfo_ptr->myhostname_len);
+    } else {
+        strncpy0(tmp_wire_hdr.fromhost, netinfo_ptr->myhostname,
+                 sizeof(tmp_wire_hdr.fromhost));
+    }
+    tmp_wire_hdr.fromport = netinfo_ptr->myport;
+    tmp_wire_hdr.fromnode = 0;
+    if (host_node_ptr->hostname_len > HOSTNAME_LEN) {
+        snprintf(tmp_wire_hdr.tohost, sizeof(tmp_wire_hdr.tohost), ".%d",
+                 host_node_ptr->hostname_len);
+    } else {
+        strncpy0(tmp_wire_hdr.tohost, host_node_ptr->host,
+                 sizeof(tmp_wire_hdr.tohost));
+    }
+    tmp_wire_hdr.toport = host_node_ptr->port;
+    tmp_wire_hdr.tonode = 0;
+    tmp_wire_hdr.type = wire_header->type;
+
+    /* This shouldn't happen.. but for a while it was happening
+     * due to various races. */
+    if (tmp_wire_hdr.toport == 0)
+        host_node_errf(LOGMSG_WARN, host_node_ptr, "PORT IS ZERO! type %d\n",
+                       tmp_wire_hdr.type);
+
+    p_buf = (uint8_t *)wire_header;
+    p_buf_end = ((uint8_t *)wire_header + sizeof(*wire_header));
+
+    /* endianize this */
+    net_wire_header_put(&tmp_wire_hdr, p_buf, p_buf_end);
+}
+
+static int net_use_writev(host_node_type *host_node_ptr)
+{
+    if (!gbl_net_writev)
+        return 0;
+#if WITH_SSL
+    /* SSL has to go through the sbuf's write routine */
+    if (sslio_has_ssl(host_node_ptr->sb))
+        return 0;
+#endif
+    return 1;
+}
+
+/* Vectored version of the writer loop: gather up to NET_WRITEV_MAX_IOV
+ * payloads per sendmsg().  Frees (or parks, for zerocopy) every item on
+ * the list.  Called with the write lock held. */
+static int writev_list(netinfo_type *netinfo_ptr, host_node_type *host_node_ptr,
+                       write_data *write_list_ptr, int *flags)
+{
+    struct iovec iov[NET_WRITEV_MAX_IOV];
+    write_data *batch[NET_WRITEV_MAX_IOV];
+    write_data *next;
+    int nbatch = 0;
+    int rc;
+
+    /* anything already buffered in the sbuf (eg. the hello) goes first */
+    rc = sbuf2flush(host_node_ptr->sb);
+
+#ifdef NET_HAVE_ZEROCOPY
+    if (rc >= 0 && gbl_net_zerocopy_min_bytes > 0 &&
+        !host_node_ptr->zc_enabled) {
+        int one = 1;
+        if (setsockopt(sbuf2fileno(host_node_ptr->sb), SOL_SOCKET,
+                       SO_ZEROCOPY, &one, sizeof(one)) == 0)
+            host_node_ptr->zc_enabled = 1;
+        else
+            host_node_ptr->zc_enabled = -1;
+    }
+    if (host_node_ptr->zc_enabled > 0)
+        net_zerocopy_reap(netinfo_ptr, host_node_ptr);
+#endif
+
+    for (; write_list_ptr != NULL; write_list_ptr = next) {
+        next = write_list_ptr->next;
+
+        /* stop writing if we've hit an error or if we've disconnected */
+        if (host_node_ptr->closed || rc < 0) {
+            rc = -1;
+            free(write_list_ptr);
+            continue;
+        }
+
+        net_fill_wire_header(netinfo_ptr, host_node_ptr, write_list_ptr);
+        *flags |= write_list_ptr->flags;
+
+#ifdef NET_HAVE_ZEROCOPY
+        if (host_node_ptr->zc_enabled > 0 &&
+            write_list_ptr->len >= gbl_net_zerocopy_min_bytes) {
+            struct iovec zciov;
+            rc = net_writev_batch(netinfo_ptr, host_node_ptr, iov, batch,
+                                  &nbatch);
+            if (rc < 0) {
+                free(write_list_ptr);
+                continue;
+            }
+            zciov.iov_base = write_list_ptr->payload.raw;
+            zciov.iov_len = write_list_ptr->len;
+            rc = net_sendmsg(netinfo_ptr, host_node_ptr, &zciov, 1,
+                             MSG_ZEROCOPY);
+            net_zerocopy_park(host_node_ptr, write_list_ptr);
+            continue;
+        }
+#endif
+
+        iov[nbatch].iov_base = write_list_ptr->payload.raw;
+        iov[nbatch].iov_len = write_list_ptr->len;
+        batch[nbatch++] = write_list_ptr;
+        if (nbatch == NET_WRITEV_MAX_IOV)
+            rc = net_writev_batch(netinfo_ptr, host_node_ptr, iov, batch,
+                                  &nbatch);
+    }
+
+    if (nbatch) {
+        if (rc < 0) {
+            int ii;
+            for (ii = 0; ii < nbatch; ii++)
+                free(batch[ii]);
+        } else {
+            rc = net_writev_batch(netinfo_ptr, host_node_ptr, iov, batch,
+                                  &nbatch);
+        }
+    }
+    return rc;
+}
 
 static void *writer_thread(void *args)
 {
@@ -4029,12 +4680,15 @@ static void *writer_thread(void *args)
     host_node_type *host_node_ptr;
     write_data *write_list_ptr, *write_list_back;
     int rc, flags, maxage;
+    uint64_t sampled_us[NET_SEND_LATENCY_MAX];
+    int nsampled;
     struct timespec waittime;
 #ifndef HAS_CLOCK_GETTIME
     struct timeval tv;
 #endif
     thread_started("net writer");
     THREAD_TYPE(__func__);
+    comdb2_thread_set_affinity(COMDB2_THR_CLASS_NET, NULL);
 
     host_node_ptr = args;
     netinfo_ptr = host_node_ptr->netinfo_ptr;
@@ -4047,12 +4701,17 @@ static void *writer_thread(void *args)
     if (netinfo_ptr->start_thread_callback)
         netinfo_ptr->start_thread_callback(netinfo_ptr->callback_data);
 
+    host_node_ptr->zc_head = host_node_ptr->zc_tail = NULL;
+    host_node_ptr->zc_seq = host_node_ptr->zc_done = 0;
+    host_node_ptr->zc_enabled = 0;
+
     rc = write_hello(netinfo_ptr, host_node_ptr);
 
     Pthread_mutex_lock(&(host_node_ptr->enquelk));
 
     while (!host_node_ptr->decom_flag && !host_node_ptr->closed &&
            !netinfo_ptr->exiting) {
+        net_mpsc_drain_lk(netinfo_ptr, host_node_ptr);
         while (host_node_ptr->write_head != NULL) {
             unsigned count, bytes;
             int start_time, end_time, diff_time;
@@ -4060,10 +4719,13 @@ static void *writer_thread(void *args)
             /* grab the entire list and reset enqueue counters */
             write_list_back = write_list_ptr = host_node_ptr->write_head;
             host_node_ptr->write_head = host_node_ptr->write_tail = NULL;
+            host_node_ptr->write_lowpri = NULL;
             count = host_node_ptr->enque_count;
             bytes = host_node_ptr->enque_bytes;
             host_node_ptr->enque_count = 0;
             host_node_ptr->enque_bytes = 0;
+            host_node_ptr->lowpri_count = 0;
+            host_node_ptr->lowpri_bytes = 0;
 
             if (netinfo_ptr->qstat_clear_rtn) {
                 (netinfo_ptr->qstat_clear_rtn)(netinfo_ptr,
@@ -4079,15 +4741,28 @@ static void *writer_thread(void *args)
             flags = 0;
             maxage = 0;
 
+            /* the items are freed as they are written; note the sampled
+             * ones' enqueue times now */
+            nsampled = 0;
+            if (netinfo_ptr->send_latency_rtn) {
+                for (write_data *w = write_list_ptr;
+                     w != NULL && nsampled < NET_SEND_LATENCY_MAX; w = w->next)
+                    if (w->enque_us)
+                        sampled_us[nsampled++] = w->enque_us;
+            }
+
             Pthread_mutex_lock(&(host_node_ptr->write_lock));
             start_time = comdb2_time_epoch();
+            if (net_use_writev(host_node_ptr)) {
+                rc = writev_list(netinfo_ptr, host_node_ptr, write_list_ptr,
+                                 &flags);
+                write_list_ptr = NULL;
+            }
             while (write_list_ptr != NULL) {
                 /* stop writing if we've hit an error or if we've disconnected
                  */
                 if (!host_node_ptr->closed && rc >= 0) {
                     int age;
-                    wire_header_type *wire_header, tmp_wire_hdr;
-                    uint8_t *p_buf, *p_buf_end;
 
                     if (flags & WRITE_MSG_NODELAY) {
                         age = comdb2_time_epoch() - write_list_ptr->enque_time;
@@ -4095,43 +4770,8 @@ static void *writer_thread(void *args)
                             maxage = age;
                     }
 
-                    /* File in the wire header with correct details for our
-                     * current connection. */
-
-                    wire_header = &write_list_ptr->payload.header;
-                    if (netinfo_ptr->myhostname_len > HOSTNAME_LEN) {
-                        snprintf(tmp_wire_hdr.fromhost,
-                                 sizeof(tmp_wire_hdr.fromhost), ".%d",
-                                 netinfo_ptr->myhostname_len);
-                    } else {
-                        strncpy0(tmp_wire_hdr.fromhost, netinfo_ptr->myhostname,
-                                 sizeof(tmp_wire_hdr.fromhost));
-                    }
-                    tmp_wire_hdr.fromport = netinfo_ptr->myport;
-                    tmp_wire_hdr.fromnode = 0;
-                    if (host_node_ptr->hostname_len > HOSTNAME_LEN) {
-                        snprintf(tmp_wire_hdr.tohost,
-                                 sizeof(tmp_wire_hdr.tohost), ".%d",
-                                 host_node_ptr->hostname_len);
-                    } else {
-                        strncpy0(tmp_wire_hdr.tohost, host_node_ptr->host,
-                                 sizeof(tmp_wire_hdr.tohost));
-                    }
-                    tmp_wire_hdr.toport = host_node_ptr->port;
-                    tmp_wire_hdr.tonode = 0;
-                    tmp_wire_hdr.type = wire_header->type;
-
-                    /* This shouldn't happen.. but for a while it was happening
-                     * due to various races. */
-                    if (tmp_wire_hdr.toport == 0)
-                        host_node_errf(LOGMSG_WARN, host_node_ptr, "PORT IS ZERO! type %d\n",
-                                       tmp_wire_hdr.type);
-
-                    p_buf = (uint8_t *)wire_header;
-                    p_buf_end = ((uint8_t *)wire_header + sizeof(*wire_header));
-
-                    /* endianize this */
-                    net_wire_header_put(&tmp_wire_hdr, p_buf, p_buf_end);
+                    net_fill_wire_header(netinfo_ptr, host_node_ptr,
+                                         write_list_ptr);
 
                     rc = write_stream(
                         netinfo_ptr, host_node_ptr, host_node_ptr->sb,
@@ -4156,6 +4796,14 @@ static void *writer_thread(void *args)
             end_time = comdb2_time_epoch();
             Pthread_mutex_unlock(&(host_node_ptr->write_lock));
 
+            if (nsampled && rc >= 0) {
+                uint64_t now_us = comdb2_time_epochus();
+                for (int i = 0; i < nsampled; i++)
+                    netinfo_ptr->send_latency_rtn(netinfo_ptr,
+                                                  host_node_ptr->host,
+                                                  now_us - sampled_us[i]);
+            }
+
             diff_time = end_time - start_time;
             if (diff_time >= 2) {
                 /* this is really informational now so I won't use
@@ -4171,6 +4819,15 @@ static void *writer_thread(void *args)
             if (rc < 0) {
                 goto done;
             }
+            net_mpsc_drain_lk(netinfo_ptr, host_node_ptr);
+        }
+
+        /* Lock-free producers only take enquelk to signal us if they see
+         * this set; recheck the stack after publishing it. */
+        XCHANGE32(host_node_ptr->writer_waiting, 1);
+        if (ATOMIC_LOADPTR(host_node_ptr->mpsc_head) != NULL) {
+            XCHANGE32(host_node_ptr->writer_waiting, 0);
+            continue;
         }
 
 #ifdef HAS_CLOCK_GETTIME
@@ -4183,6 +4840,7 @@ static void *writer_thread(void *args)
 
         pthread_cond_timedwait(&(host_node_ptr->write_wakeup),
                                &(host_node_ptr->enquelk), &waittime);
+        XCHANGE32(host_node_ptr->writer_waiting, 0);
 
         /*
            Pthread_cond_wait(&(host_node_ptr->write_wakeup),
@@ -4195,6 +4853,10 @@ static void *writer_thread(void *args)
 done:
     Pthread_mutex_unlock(&(host_node_ptr->enquelk));
 
+    Pthread_mutex_lock(&(host_node_ptr->write_lock));
+    net_zerocopy_free_all(host_node_ptr);
+    Pthread_mutex_unlock(&(host_node_ptr->write_lock));
+
     Pthread_mutex_lock(&(host_node_ptr->lock));
     host_node_ptr->have_writer_thread = 0;
     if (gbl_verbose_net)
@@ -4259,8 +4921,10 @@ static int process_hello_common(netinfo_type *netinfo_ptr,
     host_node_type *newhost, *fndhost;
     int rc;
     int numhosts = REPMAX;
+    int caps;
 
-    rc = read_hostlist(netinfo_ptr, host_node_ptr->sb, hosts, ports, &numhosts);
+    rc = read_hostlist(netinfo_ptr, host_node_ptr->sb, hosts, ports, &numhosts,
+                       &caps);
     if (rc < 0)
         return -1; /* reader thread cleans up */
     if (rc != 0) {
@@ -4268,6 +4932,7 @@ static int process_hello_common(netinfo_type *netinfo_ptr,
                "process_hello_common:error from read_hostlist, rc=%d\n", rc);
         return 0;
     }
+    host_node_ptr->peer_caps = caps;
 
     /* add each host, dont worry, dupes wont be added */
     for (int i = 0; i < numhosts; i++) {
@@ -4304,6 +4969,7 @@ static void *reader_thread(void *arg)
 
     thread_started("net reader");
     THREAD_TYPE(__func__);
+    comdb2_thread_set_affinity(COMDB2_THR_CLASS_NET, NULL);
 
     host_node_ptr = arg;
     netinfo_ptr = host_node_ptr->netinfo_ptr;
@@ -4401,7 +5067,7 @@ static void *reader_thread(void *arg)
         case WIRE_HEADER_USER_MSG:
             if (netinfo_ptr->trace && debug_switch_net_verbose())
                 logmsg(LOGMSG_DEBUG, "Here %llu\n", gettmms());
-            rc = process_user_message(netinfo_ptr, host_node_ptr);
+            rc = process_user_message(netinfo_ptr, host_node_ptr, 0);
             if (rc != 0) {
                 logmsg(LOGMSG_ERROR, 
                         "reader thread: process_user_message error from host %s\n",
@@ -4410,6 +5076,17 @@ static void *reader_thread(void *arg)
             }
             break;
 
+        case WIRE_HEADER_USER_MSG_LZ4:
+            rc = process_user_message(netinfo_ptr, host_node_ptr, 1);
+            if (rc != 0) {
+                logmsg(LOGMSG_ERROR,
+                       "reader thread: compressed user message error from "
+                       "host %s\n",
+                       host_node_ptr->host);
+                goto done;
+            }
+            break;
+
         case WIRE_HEADER_ACK_PAYLOAD:
             rc = process_payload_ack(netinfo_ptr, host_node_ptr);
             if (rc != 0) {
@@ -5780,9 +6457,23 @@ static void *accept_thread(void *arg)
 }
 
 
-static void *heartbeat_send_thread(void *arg)
+static void heartbeat_send_all(netinfo_type *netinfo_ptr)
 {
     host_node_type *ptr;
+
+    /* netinfo lock protects the list AND the write_heartbeat call
+       no need to grab rdlock */
+    Pthread_rwlock_rdlock(&(netinfo_ptr->lock));
+    for (ptr = netinfo_ptr->head; ptr != NULL; ptr = ptr->next) {
+        if (ptr->host != netinfo_ptr->myhostname) {
+            write_heartbeat(netinfo_ptr, ptr);
+        }
+    }
+    Pthread_rwlock_unlock(&(netinfo_ptr->lock));
+}
+
+static void *heartbeat_send_thread(void *arg)
+{
     netinfo_type *netinfo_ptr;
 
     thread_started("net heartbeat send");
@@ -5798,15 +6489,7 @@ static void *heartbeat_send_thread(void *arg)
         netinfo_ptr->start_thread_callback(netinfo_ptr->callback_data);
 
     while (!netinfo_ptr->exiting) {
-        /* netinfo lock protects the list AND the write_heartbeat call
-           no need to grab rdlock */
-        Pthread_rwlock_rdlock(&(netinfo_ptr->lock));
-        for (ptr = netinfo_ptr->head; ptr != NULL; ptr = ptr->next) {
-            if (ptr->host != netinfo_ptr->myhostname) {
-                write_heartbeat(netinfo_ptr, ptr);
-            }
-        }
-        Pthread_rwlock_unlock(&(netinfo_ptr->lock));
+        heartbeat_send_all(netinfo_ptr);
 
         if (netinfo_ptr->exiting)
             break;
@@ -5986,14 +6669,76 @@ void net_set_writefn(SBUF2 *sb, sbuf2writefn writefn)
     watchlist_node->writefn = writefn;
 }
 
-static void *heartbeat_check_thread(void *arg)
+static void heartbeat_check_all(netinfo_type *netinfo_ptr)
 {
     host_node_type *ptr;
-    netinfo_type *netinfo_ptr;
     int timestamp;
     int fd;
     int node_timestamp;
     int running_user_func;
+    int now;
+
+    /* Re-register under portmux if it's time */
+    if (netinfo_ptr->portmux_register_interval > 0 &&
+        ((now = comdb2_time_epoch()) - netinfo_ptr->portmux_register_time) >
+            netinfo_ptr->portmux_register_interval) {
+        int pport;
+        if (netinfo_ptr->port_from_lrl)
+            pport = portmux_use(netinfo_ptr->app, netinfo_ptr->service,
+                                netinfo_ptr->instance, netinfo_ptr->myport);
+        else
+            pport = portmux_register(netinfo_ptr->app, netinfo_ptr->service,
+                                     netinfo_ptr->instance);
+
+        if (pport != netinfo_ptr->myport && pport > 0) {
+            /* What on earth should i do?  Abort maybe?  i'm already using
+             * the old port, and sockpool has it cached everywhere .. */
+            logmsg(LOGMSG_FATAL, "Portmux returned a different port for %s %s %s?  ",
+                    netinfo_ptr->app, netinfo_ptr->service,
+                    netinfo_ptr->instance);
+            logmsg(LOGMSG_FATAL, "Oldport=%d, returned-port=%d\n",
+                   netinfo_ptr->myport, pport);
+            abort();
+        }
+        netinfo_ptr->portmux_register_time = now;
+    }
+
+    Pthread_rwlock_rdlock(&(netinfo_ptr->lock));
+
+    for (ptr = netinfo_ptr->head; ptr != NULL; ptr = ptr->next) {
+        if (ptr->host != netinfo_ptr->myhostname) {
+            /* CLOSE it if we havent recieved a heartbeat from it */
+            timestamp = time(NULL);
+
+            Pthread_mutex_lock(&(ptr->timestamp_lock));
+            fd = ptr->fd;
+            running_user_func = ptr->running_user_func;
+            node_timestamp = ptr->timestamp;
+            Pthread_mutex_unlock(&(ptr->timestamp_lock));
+
+            if ((fd > 0) && (running_user_func == 0)) {
+                if ((timestamp - node_timestamp) >
+                    netinfo_ptr->heartbeat_check_time) {
+                    host_node_printf(
+                        LOGMSG_WARN,
+                        ptr, "%s: no data in %d seconds, killing session\n",
+                        __func__, timestamp - node_timestamp);
+
+                    /* mark last failing subnet */
+                    net_set_bad_subnet(ptr->subnet);
+
+                    close_hostnode(ptr);
+                }
+            }
+        }
+    }
+
+    Pthread_rwlock_unlock(&(netinfo_ptr->lock));
+}
+
+static void *heartbeat_check_thread(void *arg)
+{
+    netinfo_type *netinfo_ptr;
 
     thread_started("net heartbeat check");
 
@@ -6007,72 +6752,58 @@ static void *heartbeat_check_thread(void *arg)
         netinfo_ptr->start_thread_callback(netinfo_ptr->callback_data);
 
     while (!netinfo_ptr->exiting) {
-        int now;
-        /* Re-register under portmux if it's time */
-        if (netinfo_ptr->portmux_register_interval > 0 &&
-            ((now = comdb2_time_epoch()) - netinfo_ptr->portmux_register_time) >
-                netinfo_ptr->portmux_register_interval) {
-            int pport;
-            if (netinfo_ptr->port_from_lrl)
-                pport = portmux_use(netinfo_ptr->app, netinfo_ptr->service,
-                                    netinfo_ptr->instance, netinfo_ptr->myport);
-            else
-                pport = portmux_register(netinfo_ptr->app, netinfo_ptr->service,
-                                         netinfo_ptr->instance);
-
-            if (pport != netinfo_ptr->myport && pport > 0) {
-                /* What on earth should i do?  Abort maybe?  i'm already using
-                 * the old port, and sockpool has it cached everywhere .. */
-                logmsg(LOGMSG_FATAL, "Portmux returned a different port for %s %s %s?  ",
-                        netinfo_ptr->app, netinfo_ptr->service,
-                        netinfo_ptr->instance);
-                logmsg(LOGMSG_FATAL, "Oldport=%d, returned-port=%d\n",
-                       netinfo_ptr->myport, pport);
-                abort();
-            }
-            netinfo_ptr->portmux_register_time = now;
-        }
+        heartbeat_check_all(netinfo_ptr);
 
-        Pthread_rwlock_rdlock(&(netinfo_ptr->lock));
+        if (netinfo_ptr->exiting)
+            break;
+        sleep(1);
+    }
+
+    logmsg(LOGMSG_DEBUG, "heartbeat check thread exiting!\n");
+
+    if (netinfo_ptr->stop_thread_callback)
+        netinfo_ptr->stop_thread_callback(netinfo_ptr->callback_data);
 
-        /*fprintf(stderr, "heartbeat thread running\n");*/
+    return NULL;
+}
 
-        for (ptr = netinfo_ptr->head; ptr != NULL; ptr = ptr->next) {
-            if (ptr->host != netinfo_ptr->myhostname) {
-                /* CLOSE it if we havent recieved a heartbeat from it */
-                timestamp = time(NULL);
+/* Sends and checks heartbeats from one thread: both are a quick pass over
+   the host list, so they don't need a thread each */
+static void *heartbeat_thread(void *arg)
+{
+    netinfo_type *netinfo_ptr;
+    int last_send = 0;
+    int now;
 
-                Pthread_mutex_lock(&(ptr->timestamp_lock));
-                fd = ptr->fd;
-                running_user_func = ptr->running_user_func;
-                node_timestamp = ptr->timestamp;
-                Pthread_mutex_unlock(&(ptr->timestamp_lock));
+    thread_started("net heartbeat");
 
-                if ((fd > 0) && (running_user_func == 0)) {
-                    if ((timestamp - node_timestamp) >
-                        netinfo_ptr->heartbeat_check_time) {
-                        host_node_printf(
-                            LOGMSG_WARN,
-                            ptr, "%s: no data in %d seconds, killing session\n",
-                            __func__, timestamp - node_timestamp);
+    netinfo_ptr = (netinfo_type *)arg;
+    netinfo_ptr->heartbeat_send_thread_arch_tid = getarchtid();
+    netinfo_ptr->heartbeat_check_thread_arch_tid =
+        netinfo_ptr->heartbeat_send_thread_arch_tid;
+    logmsg(LOGMSG_INFO, "heartbeat thread starting.  send time=%d.  check "
+                        "time=%d.  tid=%d\n",
+           netinfo_ptr->heartbeat_send_time, netinfo_ptr->heartbeat_check_time,
+           netinfo_ptr->heartbeat_send_thread_arch_tid);
 
-                        /* mark last failing subnet */
-                        net_set_bad_subnet(ptr->subnet);
+    if (netinfo_ptr->start_thread_callback)
+        netinfo_ptr->start_thread_callback(netinfo_ptr->callback_data);
 
-                        close_hostnode(ptr);
-                    }
-                }
-            }
+    while (!netinfo_ptr->exiting) {
+        now = comdb2_time_epoch();
+        if (now - last_send >= netinfo_ptr->heartbeat_send_time) {
+            heartbeat_send_all(netinfo_ptr);
+            last_send = now;
         }
 
-        Pthread_rwlock_unlock(&(netinfo_ptr->lock));
+        heartbeat_check_all(netinfo_ptr);
 
         if (netinfo_ptr->exiting)
             break;
         sleep(1);
     }
 
-    logmsg(LOGMSG_DEBUG, "heartbeat check thread exiting!\n");
+    logmsg(LOGMSG_DEBUG, "heartbeat thread exiting!\n");
 
     if (netinfo_ptr->stop_thread_callback)
         netinfo_ptr->stop_thread_callback(netinfo_ptr->callback_data);
@@ -6227,26 +6958,40 @@ int net_init(netinfo_type *netinfo_ptr)
         host_node_printf(LOGMSG_INFO, host_node_ptr, "adding to sanctioned\n");
     }
 
-    /* create heartbeat writer thread */
-    rc = pthread_create(&(netinfo_ptr->heartbeat_send_thread_id),
-                        &(netinfo_ptr->pthread_attr_detach),
-                        heartbeat_send_thread, netinfo_ptr);
-    if (rc != 0) {
-        logmsg(LOGMSG_FATAL, "init_network:couldnt create heartbeat thread - "
-                        "rc=%d errno=%d %s exiting\n",
-                rc, errno, strerror(errno));
-        exit(1);
-    }
+    if (gbl_net_single_heartbeat_thread) {
+        rc = pthread_create(&(netinfo_ptr->heartbeat_send_thread_id),
+                            &(netinfo_ptr->pthread_attr_detach),
+                            heartbeat_thread, netinfo_ptr);
+        if (rc != 0) {
+            logmsg(LOGMSG_FATAL, "init_network:couldnt create heartbeat thread - "
+                            "rc=%d errno=%d %s exiting\n",
+                    rc, errno, strerror(errno));
+            exit(1);
+        }
+        netinfo_ptr->heartbeat_check_thread_id =
+            netinfo_ptr->heartbeat_send_thread_id;
+    } else {
+        /* create heartbeat writer thread */
+        rc = pthread_create(&(netinfo_ptr->heartbeat_send_thread_id),
+                            &(netinfo_ptr->pthread_attr_detach),
+                            heartbeat_send_thread, netinfo_ptr);
+        if (rc != 0) {
+            logmsg(LOGMSG_FATAL, "init_network:couldnt create heartbeat thread - "
+                            "rc=%d errno=%d %s exiting\n",
+                    rc, errno, strerror(errno));
+            exit(1);
+        }
 
-    /* create heartbeat reader thread */
-    rc = pthread_create(&(netinfo_ptr->heartbeat_check_thread_id),
-                        &(netinfo_ptr->pthread_attr_detach),
-                        heartbeat_check_thread, netinfo_ptr);
-    if (rc != 0) {
-        logmsg(LOGMSG_FATAL, "init_network:couldnt create heartbeat thread - "
-                        "rc=%d, errno=%d %s exiting\n",
-                rc, errno, strerror(errno));
-        exit(1);
+        /* create heartbeat reader thread */
+        rc = pthread_create(&(netinfo_ptr->heartbeat_check_thread_id),
+                            &(netinfo_ptr->pthread_attr_detach),
+                            heartbeat_check_thread, netinfo_ptr);
+        if (rc != 0) {
+            logmsg(LOGMSG_FATAL, "init_network:couldnt create heartbeat thread - "
+                            "rc=%d, errno=%d %s exiting\n",
+                    rc, errno, strerror(errno));
+            exit(1);
+        }
     }
 
     if (netinfo_ptr->accept_on_child || !netinfo_ptr->ischild) {
@@ -6533,6 +7278,30 @@ int net_get_network_usage(netinfo_type *netinfo_ptr,
     return 0;
 }
 
+int net_get_writev_usage(netinfo_type *netinfo_ptr,
+                         unsigned long long *calls, unsigned long long *bytes,
+                         unsigned long long *zerocopy_sends,
+                         unsigned long long *zerocopy_copied)
+{
+    *calls = netinfo_ptr->stats.writev_calls;
+    *bytes = netinfo_ptr->stats.writev_bytes;
+    *zerocopy_sends = netinfo_ptr->stats.zerocopy_sends;
+    *zerocopy_copied = netinfo_ptr->stats.zerocopy_copied;
+    return 0;
+}
+
+int net_get_compress_usage(netinfo_type *netinfo_ptr, unsigned long long *msgs,
+                           unsigned long long *bytes_in,
+                           unsigned long long *bytes_out,
+                           unsigned long long *decompress_msgs)
+{
+    *msgs = netinfo_ptr->stats.compress_msgs;
+    *bytes_in = netinfo_ptr->stats.compress_bytes_in;
+    *bytes_out = netinfo_ptr->stats.compress_bytes_out;
+    *decompress_msgs = netinfo_ptr->stats.decompress_msgs;
+    return 0;
+}
+
 int net_get_my_port(netinfo_type *netinfo_ptr) { return netinfo_ptr->myport; }
 
 void net_trace(netinfo_type *netinfo_ptr, int on) { netinfo_ptr->trace = on; }
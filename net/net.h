@@ -67,6 +67,8 @@ typedef void QSTATCLEARFP(struct netinfo_struct *netinfo, void *netstat);
 typedef void QSTATENQUEFP(struct netinfo_struct *netinfo, void *netstat,
                           void *rec, int len);
 typedef void QSTATFREEFP(struct netinfo_struct *netinfo, void *netstat);
+typedef void NETSENDLATENCYFP(struct netinfo_struct *netinfo,
+                              const char *host, uint64_t us);
 
 typedef void QSTATITERFP(struct netinfo_struct *netinfo, void *arg,
                          void *qstat);
@@ -90,7 +92,10 @@ enum {
     NET_SEND_NODELAY = 0x00000001,
     NET_SEND_NODROP = 0x00000002,
     NET_SEND_INORDER = 0x00000004,
-    NET_SEND_TRACE = 0x00000008
+    NET_SEND_TRACE = 0x00000008,
+    /* queued behind everything else, and limited to net_lowpri_queue_pct of
+       the queue */
+    NET_SEND_LOWPRI = 0x00000010
 };
 
 enum {
@@ -155,6 +160,12 @@ int net_register_queue_stat(netinfo_type *netinfo_ptr, QSTATINITFP *qinit,
                             QSTATREADERFP *reader, QSTATENQUEFP *enque,
                             QSTATCLEARFP *qclear, QSTATFREEFP *qfree);
 
+/* register a callback that the writer calls, for one in *every messages
+   (none while it is 0), with how long the message waited from being enqueued
+   until it was flushed to the host */
+int net_register_send_latency(netinfo_type *netinfo_ptr,
+                              NETSENDLATENCYFP *func, const int *every);
+
 /* register a callback that you can compare the order of things
    already on the write queue. */
 int net_register_netcmp(netinfo_type *netinfo_ptr, NETCMPFP func);
@@ -194,7 +205,8 @@ enum {
     WIRE_HEADER_ACK = 6,
     WIRE_HEADER_HELLO_REPLY = 7,
     WIRE_HEADER_DECOM_NAME = 8,
-    WIRE_HEADER_ACK_PAYLOAD = 9
+    WIRE_HEADER_ACK_PAYLOAD = 9,
+    WIRE_HEADER_USER_MSG_LZ4 = 10
 };
 
 /*
@@ -205,6 +217,12 @@ seqnum                                        (4 bytes)
 ack (1 == needack, 0 == noack)                (4 bytes)
 datalen                                       (4 bytes)
 data                                          (datalen bytes)
+
+  to a peer whose hello advertised NET_HELLO_CAP_LZ4, messages of at least
+  net_compress_min_bytes may instead go out as WIRE_HEADER_USER_MSG_LZ4,
+  where datalen is still the uncompressed length and data is replaced by:
+complen                                       (4 bytes)
+lz4 compressed data                           (complen bytes)
 */
 
 /*
@@ -388,6 +406,16 @@ int net_get_network_usage(netinfo_type *netinfo_ptr,
                           unsigned long long *throttle_waits,
                           unsigned long long *reorders);
 
+int net_get_writev_usage(netinfo_type *netinfo_ptr,
+                         unsigned long long *calls, unsigned long long *bytes,
+                         unsigned long long *zerocopy_sends,
+                         unsigned long long *zerocopy_copied);
+
+int net_get_compress_usage(netinfo_type *netinfo_ptr, unsigned long long *msgs,
+                           unsigned long long *bytes_in,
+                           unsigned long long *bytes_out,
+                           unsigned long long *decompress_msgs);
+
 int net_get_queue_size(netinfo_type *netinfo_type, const char *host, int *limit,
                        int *usage);
 
@@ -43,7 +43,8 @@ enum {
     WRITE_MSG_NOHELLOCHECK = 4,
     WRITE_MSG_NODUPE = 8,
     WRITE_MSG_NOLIMIT = 16,
-    WRITE_MSG_INORDER = 32
+    WRITE_MSG_INORDER = 32,
+    WRITE_MSG_LOWPRI = 64
 };
 
 #define HOSTNAME_LEN 16
@@ -66,9 +67,11 @@ BB_COMPILE_TIME_ASSERT(net_write_header_type,
 typedef struct write_node_data {
     int flags;
     int enque_time;
+    uint64_t enque_us; /* set on the messages sampled for send latency */
     struct write_node_data *next;
     struct write_node_data *prev;
     size_t len;
+    unsigned zc_seq; /* last MSG_ZEROCOPY send referencing this payload */
     /* Must be last thing in struct; payload immediately follows header */
     union {
         wire_header_type header;
@@ -116,12 +119,25 @@ typedef struct watchlist_node_tag {
     LINKC_T(struct watchlist_node_tag) lnk;
 } watchlist_node_type;
 
+/* Trails the long hostnames in hellos and hello replies.  Older nodes read
+ * the whole datasz and ignore what they don't parse. */
+#define NET_HELLO_EXT_MAGIC 0x6e657478 /* "netx" */
+#define NET_HELLO_CAP_LZ4 0x1
+
 /* lockless its just stats */
 typedef struct {
     unsigned long long bytes_written;
     unsigned long long bytes_read;
     unsigned long long throttle_waits;
     unsigned long long reorders;
+    unsigned long long writev_calls;
+    unsigned long long writev_bytes;
+    unsigned long long zerocopy_sends;
+    unsigned long long zerocopy_copied;
+    unsigned long long compress_msgs;
+    unsigned long long compress_bytes_in;
+    unsigned long long compress_bytes_out;
+    unsigned long long decompress_msgs;
 } stats_type;
 
 struct host_node_tag {
@@ -144,6 +160,14 @@ struct host_node_tag {
     arch_tid writer_thread_arch_tid;
     write_data *write_head;
     write_data *write_tail;
+    write_data *write_lowpri; /* first of the low priority items, which are
+                                 all at the tail */
+    unsigned lowpri_count;
+    unsigned lowpri_bytes;
+    write_data *mpsc_head; /* lock-free producers push here, newest first */
+    unsigned mpsc_count;
+    unsigned mpsc_bytes;
+    int writer_waiting;
     seq_data *wait_list;
     pthread_mutex_t lock;
     pthread_mutex_t enquelk;
@@ -153,6 +177,7 @@ struct host_node_tag {
     pthread_mutex_t write_lock;
     pthread_cond_t write_wakeup;
     int got_hello;
+    int peer_caps; /* NET_HELLO_CAP_* from the peer's last hello */
     int running_user_func; /* This is a count of how many are running */
     int closed;
     int really_closed;
@@ -171,6 +196,8 @@ struct host_node_tag {
 
     unsigned dedupe_count;
 
+    unsigned send_latency_tick;
+
     struct in_addr addr;
     int distress; /* if this is set, do not report any errors, we know we're
                     looping trying to get a successful read_message_header
@@ -205,6 +232,14 @@ struct host_node_tag {
     int interval_max_queue_bytes;
     void *qstat;
     struct time_metric *metric_queue_size;
+
+    /* Sent with MSG_ZEROCOPY, waiting for the kernel to release them.  Only
+     * the writer thread touches these. */
+    write_data *zc_head;
+    write_data *zc_tail;
+    unsigned zc_seq;  /* sequence number of the next zerocopy send */
+    unsigned zc_done; /* every zerocopy send before this has completed */
+    int zc_enabled;
 };
 
 /* Cut down data structure used for storing the sanc list. */
@@ -336,6 +371,8 @@ struct netinfo_struct {
     QSTATENQUEFP *qstat_enque_rtn;
     QSTATCLEARFP *qstat_clear_rtn;
     QSTATFREEFP *qstat_free_rtn;
+    NETSENDLATENCYFP *send_latency_rtn;
+    const int *send_latency_every;
 
     struct quantize *conntime_all;
     struct quantize *conntime_periodic;
@@ -168,6 +168,9 @@ static int wake_all_consumers(struct dbtable *db, int force)
     if (db->dbtype != DBTYPE_QUEUEDB)
         return -1;
 
+    /* lua consumers wait on the queue's trigger subscription instead */
+    bdb_trigger_commit(db->handle);
+
     Pthread_rwlock_rdlock(&db->consumer_lk);
     if (db->dbtype == DBTYPE_QUEUE || db->dbtype == DBTYPE_QUEUEDB) {
         for (consumern = 0; consumern < MAXCONSUMERS; consumern++) {
@@ -367,6 +370,7 @@ static unsigned long long dbqueue_get_front_genid(struct dbtable *table,
     size_t fnddtalen;
     size_t fnddtaoff;
     const uint8_t *open;
+    const uint64_t *gen;
     pthread_mutex_t *mu;
     pthread_cond_t *cond;
 
@@ -374,7 +378,7 @@ static unsigned long long dbqueue_get_front_genid(struct dbtable *table,
     iq.usedb = table;
     genid = 0;
 
-    rc = bdb_trigger_subscribe(table->handle, &cond, &mu, &open);
+    rc = bdb_trigger_subscribe(table->handle, &cond, &mu, &open, &gen);
     if (rc != 0) {
         logmsg(LOGMSG_ERROR,
                "dbq_get_front_genid: bdb_trigger_subscribe "
@@ -0,0 +1,399 @@
+/*
+   Copyright 2018 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/*
+ * Publish committed row changes to Kafka.
+ *
+ * On the master, a thread reads the change stream from
+ * comdb2_logical_operations and produces a message for every row operation
+ * to the topic its table is mapped to in kafka_cdc_topics.  Sends are
+ * asynchronous and batched by librdkafka for up to kafka_cdc_linger_ms.
+ * Once every message of a commit, and of all the commits before it, has
+ * been delivered, the commit's lsn is checkpointed in llmeta; the stream
+ * picks up after it when the master changes or the stream has to be
+ * restarted.  Delivery is at-least-once: anything sent after the last
+ * checkpoint can be sent again.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <librdkafka/rdkafka.h>
+
+#include "comdb2.h"
+#include "comdb2_plugin.h"
+#include "comdb2_initializer.h"
+#include "cdb2api.h"
+#include "list.h"
+#include "strbuf.h"
+#include "str0.h"
+#include "logmsg.h"
+#include <locks_wrap.h>
+
+/* Our name in llmeta */
+#define KAFKACDC_NAME "kafka"
+
+/* comdb2_logical_operations flags: block, durable, after minlsn */
+#define KAFKACDC_FLAGS "7"
+
+extern char *gbl_kafka_brokers;
+extern char *gbl_kafka_cdc_topics;
+extern int gbl_kafka_cdc_linger_ms;
+
+struct cdc_topic {
+    char *table; /* "*" matches any table */
+    rd_kafka_topic_t *rkt;
+};
+
+/* A commit we have sent messages for */
+struct cdc_commit {
+    char lsn[64];
+    unsigned int file;
+    unsigned int offset;
+    int outstanding; /* messages not yet delivered */
+    int complete;    /* all of its messages have been sent */
+    LINKC_T(struct cdc_commit) lnk;
+};
+
+struct kafkacdc {
+    rd_kafka_t *rk;
+    struct cdc_topic *topics;
+    int ntopics;
+    LISTC_T(struct cdc_commit) pending; /* in commit order */
+    int failed;                         /* a message was not delivered */
+    time_t last_save;
+};
+
+static void kafkacdc_delivered(rd_kafka_t *rk, const rd_kafka_message_t *msg,
+                               void *opaque)
+{
+    struct kafkacdc *k = opaque;
+    struct cdc_commit *c = msg->_private;
+
+    if (msg->err) {
+        logmsg(LOGMSG_ERROR, "%s: delivery to %s failed for %s: %s\n",
+               __func__, rd_kafka_topic_name(msg->rkt), c->lsn,
+               rd_kafka_err2str(msg->err));
+        k->failed = 1;
+    }
+    c->outstanding--;
+}
+
+static rd_kafka_topic_t *kafkacdc_topic(struct kafkacdc *k, const char *table)
+{
+    rd_kafka_topic_t *any = NULL;
+    for (int i = 0; i < k->ntopics; i++) {
+        if (strcasecmp(k->topics[i].table, table) == 0)
+            return k->topics[i].rkt;
+        if (strcmp(k->topics[i].table, "*") == 0)
+            any = k->topics[i].rkt;
+    }
+    return any;
+}
+
+/* kafka_cdc_topics is a list of table:topic pairs */
+static int kafkacdc_parse_topics(struct kafkacdc *k)
+{
+    char *topics, *tok, *lasts = NULL;
+
+    if ((topics = strdup(gbl_kafka_cdc_topics)) == NULL)
+        return -1;
+    for (tok = strtok_r(topics, ", ", &lasts); tok;
+         tok = strtok_r(NULL, ", ", &lasts)) {
+        char *topic = strchr(tok, ':');
+        struct cdc_topic *t;
+
+        if (topic == NULL || topic == tok || topic[1] == '\0') {
+            logmsg(LOGMSG_ERROR, "%s: bad table:topic '%s'\n", __func__, tok);
+            free(topics);
+            return -1;
+        }
+        *topic++ = '\0';
+        t = realloc(k->topics, (k->ntopics + 1) * sizeof(struct cdc_topic));
+        if (t == NULL) {
+            free(topics);
+            return -1;
+        }
+        k->topics = t;
+        t = &k->topics[k->ntopics];
+        if ((t->rkt = rd_kafka_topic_new(k->rk, topic, NULL)) == NULL) {
+            logmsg(LOGMSG_ERROR, "%s: can't create topic %s: %s\n", __func__,
+                   topic, rd_kafka_err2str(rd_kafka_last_error()));
+            free(topics);
+            return -1;
+        }
+        t->table = strdup(tok);
+        k->ntopics++;
+    }
+    free(topics);
+    return k->ntopics > 0 ? 0 : -1;
+}
+
+static int kafkacdc_init(struct kafkacdc *k)
+{
+    rd_kafka_conf_t *conf;
+    char errstr[512];
+    char linger[16];
+
+    listc_init(&k->pending, offsetof(struct cdc_commit, lnk));
+
+    conf = rd_kafka_conf_new();
+    snprintf(linger, sizeof(linger), "%d", gbl_kafka_cdc_linger_ms);
+    if (rd_kafka_conf_set(conf, "bootstrap.servers", gbl_kafka_brokers, errstr,
+                          sizeof(errstr)) != RD_KAFKA_CONF_OK ||
+        rd_kafka_conf_set(conf, "linger.ms", linger, errstr, sizeof(errstr)) !=
+            RD_KAFKA_CONF_OK) {
+        logmsg(LOGMSG_ERROR, "%s: %s\n", __func__, errstr);
+        rd_kafka_conf_destroy(conf);
+        return -1;
+    }
+    /* keep a row's messages in order when sends are retried */
+    if (rd_kafka_conf_set(conf, "enable.idempotence", "true", errstr,
+                          sizeof(errstr)) != RD_KAFKA_CONF_OK)
+        logmsg(LOGMSG_WARN, "%s: %s\n", __func__, errstr);
+    rd_kafka_conf_set_dr_msg_cb(conf, kafkacdc_delivered);
+    rd_kafka_conf_set_opaque(conf, k);
+
+    if ((k->rk = rd_kafka_new(RD_KAFKA_PRODUCER, conf, errstr,
+                              sizeof(errstr))) == NULL) {
+        logmsg(LOGMSG_ERROR, "%s: can't create producer: %s\n", __func__,
+               errstr);
+        return -1;
+    }
+    return kafkacdc_parse_topics(k);
+}
+
+/* Save the last commit that is fully delivered */
+static void kafkacdc_checkpoint(struct kafkacdc *k, int force)
+{
+    struct cdc_commit *c, *last = NULL;
+    time_t now = time(NULL);
+
+    if (k->failed)
+        return;
+    while ((c = k->pending.top) != NULL && c->complete &&
+           c->outstanding == 0) {
+        listc_rtl(&k->pending);
+        free(last);
+        last = c;
+    }
+    if (last == NULL)
+        return;
+    if (last->file && (force || now != k->last_save)) {
+        if (bdb_set_cdc_lsn(KAFKACDC_NAME, last->file, last->offset) == 0)
+            k->last_save = now;
+        free(last);
+        return;
+    }
+    /* not saved yet: keep it at the head for the next checkpoint */
+    listc_atl(&k->pending, last);
+}
+
+static int kafkacdc_produce(struct kafkacdc *k, cdb2_hndl_tp *hndl,
+                            struct cdc_commit *c, strbuf *msg)
+{
+    const char *table = cdb2_column_value(hndl, 3);
+    const char *genid = cdb2_column_value(hndl, 4);
+    const char *oldgenid = cdb2_column_value(hndl, 5);
+    const char *record = cdb2_column_value(hndl, 6);
+    const char *oldrecord = cdb2_column_value(hndl, 7);
+    const char *key = genid ? genid : oldgenid;
+    rd_kafka_topic_t *rkt;
+
+    if ((rkt = kafkacdc_topic(k, table)) == NULL)
+        return 0;
+
+    strbuf_clear(msg);
+    strbuf_appendf(msg,
+                   "{\"commitlsn\":\"%s\",\"opnum\":%lld,\"operation\":\"%s\","
+                   "\"table\":\"%s\"",
+                   c->lsn, *(long long *)cdb2_column_value(hndl, 1),
+                   (char *)cdb2_column_value(hndl, 2), table);
+    if (genid)
+        strbuf_appendf(msg, ",\"genid\":\"%s\"", genid);
+    if (oldgenid)
+        strbuf_appendf(msg, ",\"oldgenid\":\"%s\"", oldgenid);
+    if (record)
+        strbuf_appendf(msg, ",\"record\":%s", record);
+    if (oldrecord)
+        strbuf_appendf(msg, ",\"oldrecord\":%s", oldrecord);
+    strbuf_append(msg, "}");
+
+    while (rd_kafka_produce(rkt, RD_KAFKA_PARTITION_UA, RD_KAFKA_MSG_F_COPY,
+                            (void *)strbuf_buf(msg), strbuf_len(msg), key,
+                            key ? strlen(key) : 0, c) == -1) {
+        if (rd_kafka_last_error() != RD_KAFKA_RESP_ERR__QUEUE_FULL) {
+            logmsg(LOGMSG_ERROR, "%s: can't produce to %s: %s\n", __func__,
+                   rd_kafka_topic_name(rkt),
+                   rd_kafka_err2str(rd_kafka_last_error()));
+            return -1;
+        }
+        /* let deliveries make room */
+        rd_kafka_poll(k->rk, 100);
+    }
+    c->outstanding++;
+    return 0;
+}
+
+/* Where to start: after the checkpoint, or at the end of the log the first
+ * time round */
+static int kafkacdc_start_lsn(cdb2_hndl_tp *hndl, char *lsn, size_t len)
+{
+    unsigned int file, offset;
+    int rc;
+
+    if (bdb_get_cdc_lsn(KAFKACDC_NAME, &file, &offset) == 0) {
+        snprintf(lsn, len, "{%u:%u}", file, offset);
+        return 0;
+    }
+    if ((rc = cdb2_run_statement(
+             hndl, "select lsn from comdb2_transaction_logs(NULL, NULL, 4) "
+                   "limit 1")) != CDB2_OK)
+        return rc;
+    if ((rc = cdb2_next_record(hndl)) == CDB2_OK)
+        strncpy0(lsn, cdb2_column_value(hndl, 0), len);
+    while (rc == CDB2_OK)
+        rc = cdb2_next_record(hndl);
+    return rc == CDB2_OK_DONE ? 0 : rc;
+}
+
+static void kafkacdc_stream(struct kafkacdc *k)
+{
+    cdb2_hndl_tp *hndl = NULL;
+    struct cdc_commit *c = NULL;
+    strbuf *msg = NULL;
+    char minlsn[64];
+    int rc;
+
+    if ((rc = cdb2_open(&hndl, thedb->envname, gbl_myhostname,
+                        CDB2_DIRECT_CPU)) != 0) {
+        logmsg(LOGMSG_ERROR, "%s: can't connect rc %d\n", __func__, rc);
+        goto done;
+    }
+    if ((rc = kafkacdc_start_lsn(hndl, minlsn, sizeof(minlsn))) != 0) {
+        logmsg(LOGMSG_ERROR, "%s: can't find start lsn rc %d %s\n", __func__,
+               rc, cdb2_errstr(hndl));
+        goto done;
+    }
+    logmsg(LOGMSG_INFO, "%s: publishing commits after %s\n", __func__, minlsn);
+
+    msg = strbuf_new();
+    cdb2_bind_param(hndl, "minlsn", CDB2_CSTRING, minlsn, strlen(minlsn));
+    if ((rc = cdb2_run_statement(
+             hndl, "select commitlsn, opnum, operation, tablename, genid, "
+                   "oldgenid, record, oldrecord from comdb2_logical_operations "
+                   "where minlsn = @minlsn and flags = " KAFKACDC_FLAGS)) !=
+        CDB2_OK) {
+        logmsg(LOGMSG_ERROR, "%s: stream rc %d %s\n", __func__, rc,
+               cdb2_errstr(hndl));
+        goto done;
+    }
+    while ((rc = cdb2_next_record(hndl)) == CDB2_OK) {
+        const char *lsn = cdb2_column_value(hndl, 0);
+
+        if (db_is_stopped() || !bdb_amimaster(thedb->bdb_env) || k->failed)
+            break;
+        if (c == NULL || strcmp(c->lsn, lsn) != 0) {
+            if (c)
+                c->complete = 1;
+            if ((c = calloc(1, sizeof(struct cdc_commit))) == NULL)
+                break;
+            strncpy0(c->lsn, lsn, sizeof(c->lsn));
+            if (sscanf(lsn, "{%u:%u}", &c->file, &c->offset) != 2)
+                c->file = c->offset = 0;
+            listc_abl(&k->pending, c);
+        }
+        if (kafkacdc_produce(k, hndl, c, msg) != 0)
+            break;
+        rd_kafka_poll(k->rk, 0);
+        kafkacdc_checkpoint(k, 0);
+    }
+
+done:
+    if (hndl)
+        cdb2_close(hndl);
+    if (msg)
+        strbuf_free(msg);
+
+    /* every message has to come back before its commit can be freed */
+    while (rd_kafka_flush(k->rk, 1000) == RD_KAFKA_RESP_ERR__TIMED_OUT) {
+        if (db_is_stopped())
+            return;
+    }
+    /* the last commit may be partly sent: it is sent again next time */
+    if (c && rc == CDB2_OK_DONE)
+        c->complete = 1;
+    kafkacdc_checkpoint(k, 1);
+    while ((c = listc_rtl(&k->pending)) != NULL)
+        free(c);
+    k->failed = 0;
+}
+
+static void *kafkacdc_thd(void *arg)
+{
+    struct kafkacdc k = {0};
+
+    while (!gbl_ready)
+        sleep(1);
+
+    if (kafkacdc_init(&k) != 0) {
+        logmsg(LOGMSG_ERROR, "%s: not publishing to kafka\n", __func__);
+        return NULL;
+    }
+
+    backend_thread_event(thedb, COMDB2_THR_EVENT_START_RDWR);
+    while (!db_is_stopped()) {
+        if (bdb_amimaster(thedb->bdb_env))
+            kafkacdc_stream(&k);
+        sleep(1);
+    }
+    backend_thread_event(thedb, COMDB2_THR_EVENT_DONE_RDWR);
+    return NULL;
+}
+
+static int kafkacdc_post_recovery(void)
+{
+    pthread_attr_t attr;
+    pthread_t tid;
+    int rc;
+
+    if (gbl_kafka_cdc_topics == NULL)
+        return 0;
+    if (gbl_kafka_brokers == NULL) {
+        logmsg(LOGMSG_ERROR, "%s: kafka_cdc_topics needs kafka_brokers\n",
+               __func__);
+        return 0;
+    }
+
+    Pthread_attr_init(&attr);
+    Pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if ((rc = pthread_create(&tid, &attr, kafkacdc_thd, NULL)) != 0)
+        logmsg(LOGMSG_ERROR, "%s: can't create thread rc %d\n", __func__, rc);
+    Pthread_attr_destroy(&attr);
+    return 0;
+}
+
+comdb2_initializer_t kafkacdc_plugin = {
+    NULL,                  /* pre_recovery */
+    kafkacdc_post_recovery /* post_recovery */
+};
+
+#include "plugin.h"
@@ -16,6 +16,7 @@
 
 #include <alloca.h>
 #include <pthread.h>
+#include <poll.h>
 #include <stdlib.h>
 
 #include "comdb2_plugin.h"
@@ -38,7 +39,12 @@ extern int active_appsock_conns;
 #if WITH_SSL
 extern ssl_mode gbl_client_ssl_mode;
 extern SSL_CTX *gbl_ssl_ctx;
+extern int gbl_ssl_ktls;
+extern int64_t gbl_ssl_ktls_conns;
 extern int gbl_nid_dbname;
+extern int gbl_newsql_row_batch;
+extern int gbl_newsql_compress;
+extern int gbl_newsql_compress_min_bytes;
 void ssl_set_clnt_user(struct sqlclntstate *clnt);
 #endif
 
@@ -63,6 +69,10 @@ struct newsqlheader {
     int length;      /*  length of response */
 };
 
+/* Set in the dummy field of an SSLCONN request by clients that want kernel
+   TLS, and so don't donate the connection to sockpool. */
+#define NEWSQL_SSLCONN_KTLS 1
+
 struct newsql_postponed_data {
     size_t len;
     struct newsqlheader hdr;
@@ -110,8 +120,31 @@ struct newsql_postponed_data {
 /*  --                                                                    */
 /*  Rivers                                                                */
 
+/* Rows waiting to go out in one CDB2_SQLRESPONSE.row_batch. Column values
+ * that aren't INTEGER or REAL are copied into buf, and their data pointers
+ * hold offsets into it until the batch is sent. */
+struct newsql_batch_col {
+    int type;
+    void *nums; /* int64_t or double, by type */
+    ProtobufCBinaryData *values;
+    uint8_t *nulls;
+};
+
+struct newsql_rowbatch {
+    int maxrows; /* flush when this many rows are waiting; 0 if off */
+    int nrows;
+    int rowcols; /* columns in the rows */
+    int caprows; /* rows and columns allocated */
+    int ncols;
+    size_t buflen;
+    size_t bufcap;
+    uint8_t *buf;
+    struct newsql_batch_col *cols;
+};
+
 struct newsql_appdata {
     int8_t send_intrans_response;
+    struct newsql_rowbatch batch;
 
     CDB2QUERY *query;
     CDB2SQLQUERY *sqlquery;
@@ -376,16 +409,25 @@ done:
 }
 
 #define NEWSQL_MAX_RESPONSE_ON_STACK (16 * 1024)
+#define NEWSQL_MAX_ROWBATCH_BYTES (1024 * 1024)
+
+static int newsql_send_rowbatch(struct sqlclntstate *clnt);
 
 static int newsql_response_int(struct sqlclntstate *clnt,
                                const CDB2SQLRESPONSE *r, int h, int flush)
 {
+    struct newsql_appdata *appdata = clnt->appdata;
+    int rc;
+    /* batched rows go out ahead of anything that follows them */
+    if (appdata && appdata->batch.nrows &&
+        (rc = newsql_send_rowbatch(clnt)) != 0) {
+        return rc;
+    }
     size_t len = cdb2__sqlresponse__get_packed_size(r);
     uint8_t *buf;
     if (len < NEWSQL_MAX_RESPONSE_ON_STACK) {
         buf = alloca(len);
     } else {
-        struct newsql_appdata *appdata = clnt->appdata;
         if (appdata->packed_capacity < len) {
             appdata->packed_capacity = len + 1024;
             appdata->packed_buf =
@@ -399,7 +441,6 @@ static int newsql_response_int(struct sqlclntstate *clnt,
     hdr.type = ntohl(h);
     hdr.length = ntohl(len);
 
-    int rc;
     lock_client_write_lock(clnt);
     if ((rc = sbuf2write((char *)&hdr, sizeof(hdr), clnt->sb)) != sizeof(hdr))
         goto done;
@@ -463,6 +504,18 @@ static struct newsql_appdata *get_newsql_appdata(struct sqlclntstate *clnt,
     return appdata;
 }
 
+static void free_newsql_rowbatch(struct newsql_rowbatch *b)
+{
+    for (int i = 0; i < b->ncols; ++i) {
+        free(b->cols[i].nums);
+        free(b->cols[i].values);
+        free(b->cols[i].nulls);
+    }
+    free(b->cols);
+    free(b->buf);
+    memset(b, 0, sizeof(*b));
+}
+
 static void free_newsql_appdata(struct sqlclntstate *clnt)
 {
     struct newsql_appdata *appdata = clnt->appdata;
@@ -474,6 +527,7 @@ static void free_newsql_appdata(struct sqlclntstate *clnt)
         free(appdata->postponed);
         appdata->postponed = NULL;
     }
+    free_newsql_rowbatch(&appdata->batch);
     free(appdata->packed_buf);
     free(appdata);
     clnt->appdata = NULL;
@@ -490,6 +544,58 @@ extern int gbl_return_long_column_names;
         }                                                                      \
     } while (0)
 
+/* Rows of the statement about to run are batched if the client asked for it
+ * and the server allows it. */
+static void newsql_setup_rowbatch(struct sqlclntstate *clnt, int ncols)
+{
+    struct newsql_appdata *appdata = clnt->appdata;
+    struct newsql_rowbatch *b = &appdata->batch;
+    CDB2SQLQUERY *sqlquery = appdata->sqlquery;
+    int maxrows = 0;
+    b->nrows = 0;
+    b->buflen = 0;
+    b->maxrows = 0;
+    if (gbl_newsql_row_batch <= 1 || ncols <= 0) {
+        return;
+    }
+    for (int i = 0; i < sqlquery->n_features; ++i) {
+        if (sqlquery->features[i] == CDB2_CLIENT_FEATURES__ROW_BATCH) {
+            maxrows = gbl_newsql_row_batch;
+            break;
+        }
+    }
+    if (maxrows == 0) {
+        return;
+    }
+    /* arrays are sized for the largest batch seen on this connection */
+    if (ncols > b->ncols || maxrows > b->caprows) {
+        int n = ncols > b->ncols ? ncols : b->ncols;
+        int rows = maxrows > b->caprows ? maxrows : b->caprows;
+        free_newsql_rowbatch(b);
+        if ((b->cols = calloc(n, sizeof(struct newsql_batch_col))) == NULL) {
+            return;
+        }
+        b->ncols = n;
+        for (int i = 0; i < n; ++i) {
+            struct newsql_batch_col *c = &b->cols[i];
+            c->nums = malloc(rows * sizeof(int64_t));
+            c->values = malloc(rows * sizeof(ProtobufCBinaryData));
+            c->nulls = malloc((rows + 7) / 8);
+            if (!c->nums || !c->values || !c->nulls) {
+                free_newsql_rowbatch(b);
+                return;
+            }
+        }
+        b->caprows = rows;
+    }
+    for (int i = 0; i < ncols; ++i) {
+        b->cols[i].type = appdata->type[i];
+        memset(b->cols[i].nulls, 0, (maxrows + 7) / 8);
+    }
+    b->rowcols = ncols;
+    b->maxrows = maxrows;
+}
+
 static int newsql_columns(struct sqlclntstate *clnt, sqlite3_stmt *stmt)
 {
     int ncols = column_count(clnt, stmt);
@@ -507,6 +613,7 @@ static int newsql_columns(struct sqlclntstate *clnt, sqlite3_stmt *stmt)
         cols[i].has_type = 1;
         cols[i].type = appdata->type[i] = get_col_type(clnt, stmt, i);
     }
+    newsql_setup_rowbatch(clnt, ncols);
     CDB2SQLRESPONSE resp = CDB2__SQLRESPONSE__INIT;
     resp.response_type = RESPONSE_TYPE__COLUMN_NAMES;
     resp.n_value = ncols;
@@ -545,6 +652,7 @@ static int newsql_columns_lua(struct sqlclntstate *clnt,
         cols[i].type = appdata->type[i] =
             sp_column_type(arg, i, n_types, get_col_type(clnt, stmt, i));
     }
+    appdata->batch.maxrows = 0;
     clnt->osql.sent_column_data = 1;
     CDB2SQLRESPONSE resp = CDB2__SQLRESPONSE__INIT;
     resp.response_type = RESPONSE_TYPE__COLUMN_NAMES;
@@ -568,6 +676,7 @@ static int newsql_columns_str(struct sqlclntstate *clnt, char **names,
         cols[i].has_type = 1;
         cols[i].type = appdata->type[i] = SQLITE_TEXT;
     }
+    appdata->batch.maxrows = 0;
     clnt->osql.sent_column_data = 1;
     CDB2SQLRESPONSE resp = CDB2__SQLRESPONSE__INIT;
     resp.response_type = RESPONSE_TYPE__COLUMN_NAMES;
@@ -596,6 +705,9 @@ static int newsql_error(struct sqlclntstate *c, char *r, int e)
 
 static int newsql_flush(struct sqlclntstate *clnt)
 {
+    struct newsql_appdata *appdata = clnt->appdata;
+    if (appdata && appdata->batch.nrows && newsql_send_rowbatch(clnt) != 0)
+        return 1;
     lock_client_write_lock(clnt);
     int rc = sbuf2flush(clnt->sb);
     unlock_client_write_lock(clnt);
@@ -635,6 +747,8 @@ static int newsql_send_postponed_row(struct sqlclntstate *clnt)
     char *row = (char *)appdata->postponed->row;
     size_t len = appdata->postponed->len;
     int rc;
+    if (appdata->batch.nrows && (rc = newsql_send_rowbatch(clnt)) != 0)
+        return rc;
     lock_client_write_lock(clnt);
     if ((rc = sbuf2write(hdr, hdrsz, clnt->sb)) != hdrsz)
         goto done;
@@ -719,6 +833,110 @@ done:
 #error "Missing BYTE_ORDER"
 #endif
 
+/* Send the rows waiting in the batch as one response. */
+static int newsql_send_rowbatch(struct sqlclntstate *clnt)
+{
+    struct newsql_appdata *appdata = clnt->appdata;
+    struct newsql_rowbatch *b = &appdata->batch;
+    int nrows = b->nrows;
+    int ncols = b->rowcols;
+    CDB2SQLRESPONSE__Rowbatch__Column cols[ncols];
+    CDB2SQLRESPONSE__Rowbatch__Column *columns[ncols];
+    for (int i = 0; i < ncols; ++i) {
+        struct newsql_batch_col *c = &b->cols[i];
+        columns[i] = &cols[i];
+        cdb2__sqlresponse__rowbatch__column__init(&cols[i]);
+        switch (c->type) {
+        case SQLITE_INTEGER:
+            cols[i].n_ints = nrows;
+            cols[i].ints = c->nums;
+            break;
+        case SQLITE_FLOAT:
+            cols[i].n_reals = nrows;
+            cols[i].reals = c->nums;
+            break;
+        default:
+            for (int j = 0; j < nrows; ++j) {
+                c->values[j].data = b->buf + (uintptr_t)c->values[j].data;
+            }
+            cols[i].n_values = nrows;
+            cols[i].values = c->values;
+            break;
+        }
+        cols[i].has_nulls = 1;
+        cols[i].nulls.len = (nrows + 7) / 8;
+        cols[i].nulls.data = c->nulls;
+    }
+    CDB2SQLRESPONSE__Rowbatch rb = CDB2__SQLRESPONSE__ROWBATCH__INIT;
+    rb.nrows = nrows;
+    rb.n_columns = ncols;
+    rb.columns = columns;
+    CDB2SQLRESPONSE r = CDB2__SQLRESPONSE__INIT;
+    r.response_type = RESPONSE_TYPE__COLUMN_VALUES;
+    r.row_batch = &rb;
+
+    /* empty it first so newsql_response_int doesn't send it again */
+    b->nrows = 0;
+    b->buflen = 0;
+    int rc = newsql_response_int(clnt, &r, RESPONSE_HEADER__SQL_RESPONSE, 0);
+    for (int i = 0; i < ncols; ++i) {
+        memset(b->cols[i].nulls, 0, (nrows + 7) / 8);
+    }
+    return rc;
+}
+
+/* Add a row, as built by newsql_row, to the batch. INTEGER and REAL values
+ * must be in host order. */
+static int newsql_batch_row(struct sqlclntstate *clnt,
+                            const CDB2SQLRESPONSE__Column *cols, int ncols)
+{
+    struct newsql_appdata *appdata = clnt->appdata;
+    struct newsql_rowbatch *b = &appdata->batch;
+    int row = b->nrows;
+    for (int i = 0; i < ncols; ++i) {
+        struct newsql_batch_col *c = &b->cols[i];
+        int isnull = cols[i].isnull;
+        if (isnull) {
+            c->nulls[row / 8] |= 1 << (row % 8);
+        }
+        switch (c->type) {
+        case SQLITE_INTEGER:
+        case SQLITE_FLOAT: {
+            uint8_t *num = (uint8_t *)c->nums + row * sizeof(int64_t);
+            if (isnull) {
+                memset(num, 0, sizeof(int64_t));
+            } else {
+                memcpy(num, cols[i].value.data, sizeof(int64_t));
+            }
+            break;
+        }
+        default: {
+            size_t len = cols[i].value.len;
+            if (b->buflen + len > b->bufcap) {
+                size_t cap = (b->buflen + len) * 2;
+                uint8_t *buf = realloc(b->buf, cap);
+                if (buf == NULL) {
+                    return -1;
+                }
+                b->buf = buf;
+                b->bufcap = cap;
+            }
+            if (len) {
+                memcpy(b->buf + b->buflen, cols[i].value.data, len);
+            }
+            c->values[row].len = len;
+            c->values[row].data = (uint8_t *)(uintptr_t)b->buflen;
+            b->buflen += len;
+            break;
+        }
+        }
+    }
+    if (++b->nrows >= b->maxrows || b->buflen >= NEWSQL_MAX_ROWBATCH_BYTES) {
+        return newsql_send_rowbatch(clnt);
+    }
+    return 0;
+}
+
 static int newsql_row(struct sqlclntstate *clnt, struct response_data *arg,
                       int postpone)
 {
@@ -736,6 +954,10 @@ static int newsql_row(struct sqlclntstate *clnt, struct response_data *arg,
     if (!appdata->sqlquery->little_endian)
 #endif
         flip = 1;
+    /* protobuf takes care of byte order for batched numbers */
+    int batch = appdata->batch.maxrows && ncols == appdata->batch.rowcols &&
+                !postpone && !arg->pingpong;
+    int flipnum = flip && !batch;
     CDB2SQLRESPONSE__Column cols[ncols];
     CDB2SQLRESPONSE__Column *value[ncols];
     for (int i = 0; i < ncols; ++i) {
@@ -750,12 +972,12 @@ static int newsql_row(struct sqlclntstate *clnt, struct response_data *arg,
         switch (type) {
         case SQLITE_INTEGER: {
             int64_t i64 = column_int64(clnt, stmt, i);
-            newsql_integer(cols, i, i64, flip);
+            newsql_integer(cols, i, i64, flipnum);
             break;
         }
         case SQLITE_FLOAT: {
             double d = column_double(clnt, stmt, i);
-            newsql_double(cols, i, d, flip);
+            newsql_double(cols, i, d, flipnum);
             break;
         }
         case SQLITE_TEXT: {
@@ -813,6 +1035,9 @@ static int newsql_row(struct sqlclntstate *clnt, struct response_data *arg,
             return -1;
         }
     }
+    if (batch) {
+        return newsql_batch_row(clnt, cols, ncols);
+    }
     CDB2SQLRESPONSE r = CDB2__SQLRESPONSE__INIT;
     r.response_type = RESPONSE_TYPE__COLUMN_VALUES;
     r.n_value = ncols;
@@ -1465,7 +1690,15 @@ static int process_set_commands(struct dbenv *dbenv, struct sqlclntstate *clnt,
                            "processing set command '%s'\n", sqlstr);
             sqlstr += 3;
             sqlstr = skipws(sqlstr);
-            if (strncasecmp(sqlstr, "transaction", 11) == 0) {
+            if (strncasecmp(sqlstr, "transaction", 11) == 0 &&
+                strncasecmp(skipws(sqlstr + 11), "chunk", 5) == 0) {
+                sqlstr = skipws(sqlstr + 11) + 5;
+                int chunksz = strtol(sqlstr, &endp, 10);
+                if (endp != sqlstr && chunksz >= 0)
+                    clnt->dbtran.maxchunksize = chunksz;
+                else
+                    rc = ii + 1;
+            } else if (strncasecmp(sqlstr, "transaction", 11) == 0) {
                 sqlstr += 11;
                 sqlstr = skipws(sqlstr);
                 clnt->dbtran.mode = TRANLEVEL_INVALID;
@@ -1712,6 +1945,8 @@ static int process_set_commands(struct dbenv *dbenv, struct sqlclntstate *clnt,
                 sqlstr = skipws(sqlstr);
                 if (strncasecmp(sqlstr, "on", 2) == 0) {
                     clnt->get_cost = 1;
+                } else if (strncasecmp(sqlstr, "analyze", 7) == 0) {
+                    clnt->get_cost = 2;
                 } else {
                     clnt->get_cost = 0;
                 }
@@ -1746,6 +1981,11 @@ static int process_set_commands(struct dbenv *dbenv, struct sqlclntstate *clnt,
                 printf("setting clnt->planner_effort to %d\n",
                        clnt->planner_effort);
 #endif
+            } else if (strncasecmp(sqlstr, "querypriority", 13) == 0) {
+                sqlstr += 13;
+                int priority = strtol(sqlstr, &endp, 10);
+                if (0 <= priority && priority <= 10)
+                    clnt->queue_priority = priority;
             } else if (strncasecmp(sqlstr, "intransresults", 14) == 0) {
                 sqlstr += 14;
                 sqlstr = skipws(sqlstr);
@@ -1860,6 +2100,7 @@ retry_read:
 
     hdr.type = ntohl(hdr.type);
     hdr.compression = ntohl(hdr.compression);
+    hdr.dummy = ntohl(hdr.dummy);
     hdr.length = ntohl(hdr.length);
 
     if (hdr.type == CDB2_REQUEST_TYPE__SSLCONN) {
@@ -1884,6 +2125,8 @@ retry_read:
         if ((rc = sbuf2putc(sb, ssl_able)) < 0 || (rc = sbuf2flush(sb)) < 0)
             return NULL;
 
+        sslio_set_ktls(sb, gbl_ssl_ktls && (hdr.dummy & NEWSQL_SSLCONN_KTLS));
+
         /* Don't close the connection if SSL verify fails so that we can
            send back an error to the client. */
         if (ssl_able == 'Y' &&
@@ -1894,6 +2137,9 @@ retry_read:
             return NULL;
         }
 
+        if (sslio_has_ktls(sb))
+            ATOMIC_ADD64(gbl_ssl_ktls_conns, 1);
+
         /* Extract the user from the certificate. */
         ssl_set_clnt_user(clnt);
 #else
@@ -1902,6 +2148,26 @@ retry_read:
             return NULL;
 #endif
         goto retry_read;
+    } else if (hdr.type == CDB2_REQUEST_TYPE__COMPRESS) {
+        /* The compression field has the algorithms the client can do.
+           Reply with the one we picked (0 for none), after which both ends
+           switch to compressed framing.  The client goes back to plain
+           bytes before donating the connection to sockpool. */
+        if (compio_algo(sb) != COMPIO_NONE) {
+            logmsg(LOGMSG_WARN, "The connection is already compressed.\n");
+            return NULL;
+        }
+        int algo = gbl_newsql_compress ? compio_choose(hdr.compression)
+                                       : COMPIO_NONE;
+        if ((rc = sbuf2putc(sb, algo)) < 0 || (rc = sbuf2flush(sb)) < 0)
+            return NULL;
+        if (algo != COMPIO_NONE &&
+            compio_start(sb, algo, gbl_newsql_compress_min_bytes) != 0) {
+            logmsg(LOGMSG_ERROR, "%s: can't start %s compression\n", __func__,
+                   compio_name(algo));
+            return NULL;
+        }
+        goto retry_read;
     } else if (hdr.type == CDB2_REQUEST_TYPE__RESET) { /* Reset from sockpool.*/
 
         if (clnt->ctrl_sqlengine == SQLENG_INTRANS_STATE) {
@@ -2102,12 +2368,22 @@ static inline int incoh_reject(int admin, bdb_state_type *bdb_state)
 
 int64_t gbl_denied_appsock_connection_count = 0;
 
-#define APPDATA ((struct newsql_appdata *)(clnt.appdata))
+#define APPDATA ((struct newsql_appdata *)(clnt->appdata))
+struct newsql_session {
+    struct sqlclntstate clnt;
+    struct dbenv *dbenv;
+    SBUF2 *sb;
+};
+
+static void newsql_session_run(struct newsql_session *, struct thr_handle *,
+                               CDB2QUERY *);
+static void newsql_session_end(struct newsql_session *, CDB2QUERY *);
+static int newsql_park(struct newsql_session *);
+
 static int handle_newsql_request(comdb2_appsock_arg_t *arg)
 {
     CDB2QUERY *query = NULL;
-    int rc = 0;
-    struct sqlclntstate clnt;
+    struct sqlclntstate *clnt;
     struct thr_handle *thr_self;
     struct sbuf2 *sb;
     struct dbenv *dbenv;
@@ -2150,6 +2426,13 @@ static int handle_newsql_request(comdb2_appsock_arg_t *arg)
     }
 
 
+    struct newsql_session *s = calloc(1, sizeof(*s));
+    if (s == NULL)
+        return APPSOCK_RETURN_ERR;
+    clnt = &s->clnt;
+    s->dbenv = dbenv;
+    s->sb = sb;
+
     /*
       This flag cannot be set to non-zero until after all the early returns in
       this function; otherwise, we may "leak" appsock connections.
@@ -2164,28 +2447,28 @@ static int handle_newsql_request(comdb2_appsock_arg_t *arg)
     */
     thrman_change_type(thr_self, THRTYPE_APPSOCK_SQL);
 
-    reset_clnt(&clnt, sb, 1);
-    clnt_register(&clnt);
+    reset_clnt(clnt, sb, 1);
+    clnt_register(clnt);
 
-    get_newsql_appdata(&clnt, 32);
-    plugin_set_callbacks(&clnt, newsql);
-    clnt.tzname[0] = '\0';
-    clnt.admin = arg->admin;
+    get_newsql_appdata(clnt, 32);
+    plugin_set_callbacks(clnt, newsql);
+    clnt->tzname[0] = '\0';
+    clnt->admin = arg->admin;
 
-    if (incoh_reject(clnt.admin, thedb->bdb_env)) {
+    if (incoh_reject(clnt->admin, thedb->bdb_env)) {
         logmsg(LOGMSG_ERROR,
                "%s:%d td %u new query on incoherent node, dropping socket\n",
                __func__, __LINE__, (uint32_t)pthread_self());
         goto done;
     }
 
-    query = read_newsql_query(dbenv, &clnt, sb);
+    query = read_newsql_query(dbenv, clnt, sb);
     if (query == NULL) {
         logmsg(LOGMSG_DEBUG, "Query is NULL.\n");
         goto done;
     }
 
-    if (!clnt.admin && check_active_appsock_connections(&clnt)) {
+    if (!clnt->admin && check_active_appsock_connections(clnt)) {
         static time_t pr = 0;
         time_t now;
 
@@ -2199,7 +2482,7 @@ static int handle_newsql_request(comdb2_appsock_arg_t *arg)
             pr = now;
         }
 
-        newsql_error(&clnt, "Exhausted appsock connections.",
+        newsql_error(clnt, "Exhausted appsock connections.",
                      CDB2__ERROR_CODE__APPSOCK_LIMIT);
         goto done;
     }
@@ -2215,20 +2498,20 @@ static int handle_newsql_request(comdb2_appsock_arg_t *arg)
 
     CDB2SQLQUERY *sql_query = query->sqlquery;
 
-    if (!clnt.admin && do_query_on_master_check(dbenv, &clnt, sql_query))
+    if (!clnt->admin && do_query_on_master_check(dbenv, clnt, sql_query))
         goto done;
 
     if (sql_query->client_info) {
-        clnt.conninfo.pid = sql_query->client_info->pid;
-        clnt.last_pid = sql_query->client_info->pid;
+        clnt->conninfo.pid = sql_query->client_info->pid;
+        clnt->last_pid = sql_query->client_info->pid;
     }
     else {
-        clnt.conninfo.pid = 0;
-        clnt.last_pid = 0;
+        clnt->conninfo.pid = 0;
+        clnt->last_pid = 0;
     }
-    clnt.osql.count_changes = 1;
-    clnt.dbtran.mode = tdef_to_tranlevel(gbl_sql_tranlevel_default);
-    newsql_clr_high_availability(&clnt);
+    clnt->osql.count_changes = 1;
+    clnt->dbtran.mode = tdef_to_tranlevel(gbl_sql_tranlevel_default);
+    newsql_clr_high_availability(clnt);
 
     int notimeout = disable_server_sql_timeouts();
     sbuf2settimeout(
@@ -2246,7 +2529,7 @@ static int handle_newsql_request(comdb2_appsock_arg_t *arg)
 
     net_add_watch_warning(
         sb, bdb_attr_get(thedb->bdb_attr, BDB_ATTR_MAX_SQL_IDLE_TIME),
-        wrtimeoutsec, &clnt, watcher_warning_function);
+        wrtimeoutsec, clnt, watcher_warning_function);
 
     /* appsock threads aren't sql threads so for appsock pool threads
      * sqlthd will be NULL */
@@ -2256,7 +2539,26 @@ static int handle_newsql_request(comdb2_appsock_arg_t *arg)
         sqlthd->clnt->origin[0] = 0;
     }
 
-    sbuf2setclnt(sb, &clnt);
+    sbuf2setclnt(sb, clnt);
+
+    newsql_session_run(s, thr_self, query);
+    arg->sb = NULL;
+    return APPSOCK_RETURN_OK;
+
+done:
+    newsql_session_end(s, query);
+    arg->sb = NULL;
+    return APPSOCK_RETURN_OK;
+}
+
+static void newsql_session_run(struct newsql_session *s,
+                               struct thr_handle *thr_self, CDB2QUERY *query)
+{
+    struct sqlclntstate *clnt = &s->clnt;
+    struct dbenv *dbenv = s->dbenv;
+    SBUF2 *sb = s->sb;
+    CDB2SQLQUERY *sql_query;
+    int rc = 0;
 
     while (query) {
         sql_query = query->sqlquery;
@@ -2265,23 +2567,23 @@ static int handle_newsql_request(comdb2_appsock_arg_t *arg)
 #endif
         APPDATA->query = query;
         APPDATA->sqlquery = sql_query;
-        clnt.sql = sql_query->sql_query;
-        clnt.added_to_hist = 0;
-
-        if (!clnt.in_client_trans) {
-            bzero(&clnt.effects, sizeof(clnt.effects));
-            bzero(&clnt.log_effects, sizeof(clnt.log_effects));
-            clnt.had_errors = 0;
-            clnt.ctrl_sqlengine = SQLENG_NORMAL_PROCESS;
+        clnt->sql = sql_query->sql_query;
+        clnt->added_to_hist = 0;
+
+        if (!clnt->in_client_trans) {
+            bzero(&clnt->effects, sizeof(clnt->effects));
+            bzero(&clnt->log_effects, sizeof(clnt->log_effects));
+            clnt->had_errors = 0;
+            clnt->ctrl_sqlengine = SQLENG_NORMAL_PROCESS;
         }
-        if (clnt.dbtran.mode < TRANLEVEL_SOSQL) {
-            clnt.dbtran.mode = TRANLEVEL_SOSQL;
+        if (clnt->dbtran.mode < TRANLEVEL_SOSQL) {
+            clnt->dbtran.mode = TRANLEVEL_SOSQL;
         }
-        clnt.osql.sent_column_data = 0;
-        clnt.stop_this_statement = 0;
+        clnt->osql.sent_column_data = 0;
+        clnt->stop_this_statement = 0;
 
-        if ((clnt.tzname[0] == '\0') && sql_query->tzname)
-            strncpy0(clnt.tzname, sql_query->tzname, sizeof(clnt.tzname));
+        if ((clnt->tzname[0] == '\0') && sql_query->tzname)
+            strncpy0(clnt->tzname, sql_query->tzname, sizeof(clnt->tzname));
 
         if (sql_query->dbname && dbenv->envname &&
             strcasecmp(sql_query->dbname, dbenv->envname)) {
@@ -2290,57 +2592,57 @@ static int handle_newsql_request(comdb2_appsock_arg_t *arg)
                      "DB name mismatch query:%s actual:%s", sql_query->dbname,
                      dbenv->envname);
             logmsg(LOGMSG_ERROR, "%s\n", errstr);
-            newsql_error(&clnt, errstr, CDB2__ERROR_CODE__WRONG_DB);
+            newsql_error(clnt, errstr, CDB2__ERROR_CODE__WRONG_DB);
             goto done;
         }
 
         if (sql_query->client_info) {
-            if (clnt.rawnodestats) {
-                release_node_stats(clnt.argv0, clnt.stack, clnt.origin);
-                clnt.rawnodestats = NULL;
+            if (clnt->rawnodestats) {
+                release_node_stats(clnt->argv0, clnt->stack, clnt->origin);
+                clnt->rawnodestats = NULL;
             }
-            if (clnt.conninfo.pid &&
-                clnt.conninfo.pid != sql_query->client_info->pid) {
+            if (clnt->conninfo.pid &&
+                clnt->conninfo.pid != sql_query->client_info->pid) {
                 /* Different pid is coming without reset. */
                 logmsg(LOGMSG_WARN,
                        "Multiple processes using same socket PID 1 %d "
                        "PID 2 %d Host %.8x\n",
-                       clnt.conninfo.pid, sql_query->client_info->pid,
+                       clnt->conninfo.pid, sql_query->client_info->pid,
                        sql_query->client_info->host_id);
             }
-            clnt.conninfo.pid = sql_query->client_info->pid;
-            clnt.conninfo.node = sql_query->client_info->host_id;
-            if (clnt.argv0) {
-                free(clnt.argv0);
-                clnt.argv0 = NULL;
+            clnt->conninfo.pid = sql_query->client_info->pid;
+            clnt->conninfo.node = sql_query->client_info->host_id;
+            if (clnt->argv0) {
+                free(clnt->argv0);
+                clnt->argv0 = NULL;
             }
-            if (clnt.stack) {
-                free(clnt.stack);
-                clnt.stack = NULL;
+            if (clnt->stack) {
+                free(clnt->stack);
+                clnt->stack = NULL;
             }
             if (sql_query->client_info->argv0) {
-                clnt.argv0 = strdup(sql_query->client_info->argv0);
+                clnt->argv0 = strdup(sql_query->client_info->argv0);
             }
             if (sql_query->client_info->stack) {
-                clnt.stack = strdup(sql_query->client_info->stack);
+                clnt->stack = strdup(sql_query->client_info->stack);
             }
         }
 
-        if (clnt.rawnodestats == NULL) {
-            clnt.rawnodestats = get_raw_node_stats(
-                clnt.argv0, clnt.stack, clnt.origin, sbuf2fileno(clnt.sb));
+        if (clnt->rawnodestats == NULL) {
+            clnt->rawnodestats = get_raw_node_stats(
+                clnt->argv0, clnt->stack, clnt->origin, sbuf2fileno(clnt->sb));
         }
 
-        if (process_set_commands(dbenv, &clnt, sql_query))
+        if (process_set_commands(dbenv, clnt, sql_query))
             goto done;
 
-        if (gbl_rowlocks && clnt.dbtran.mode != TRANLEVEL_SERIAL)
-            clnt.dbtran.mode = TRANLEVEL_SNAPISOL;
+        if (gbl_rowlocks && clnt->dbtran.mode != TRANLEVEL_SERIAL)
+            clnt->dbtran.mode = TRANLEVEL_SNAPISOL;
 
         /* avoid new accepting new queries/transaction on opened connections
            if we are incoherent (and not in a transaction). */
-        if (incoh_reject(clnt.admin, thedb->bdb_env) &&
-            (clnt.ctrl_sqlengine == SQLENG_NORMAL_PROCESS)) {
+        if (incoh_reject(clnt->admin, thedb->bdb_env) &&
+            (clnt->ctrl_sqlengine == SQLENG_NORMAL_PROCESS)) {
             logmsg(LOGMSG_ERROR,
                    "%s line %d td %u new query on incoherent node, "
                    "dropping socket\n",
@@ -2348,103 +2650,154 @@ static int handle_newsql_request(comdb2_appsock_arg_t *arg)
             goto done;
         }
 
-        clnt.heartbeat = 1;
+        clnt->heartbeat = 1;
         ATOMIC_ADD32(gbl_nnewsql, 1);
 
-        bool isCommitRollback = (strncasecmp(clnt.sql, "commit", 6) == 0 ||
-                                 strncasecmp(clnt.sql, "rollback", 8) == 0)
+        bool isCommitRollback = (strncasecmp(clnt->sql, "commit", 6) == 0 ||
+                                 strncasecmp(clnt->sql, "rollback", 8) == 0)
                                     ? true
                                     : false;
 
-        if (!clnt.had_errors || isCommitRollback) {
+        if (!clnt->had_errors || isCommitRollback) {
             /* tell blobmem that I want my priority back
                when the sql thread is done */
             comdb2bma_pass_priority_back(blobmem);
-            rc = dispatch_sql_query(&clnt);
+            rc = dispatch_sql_query(clnt);
 
-            if (clnt.had_errors && isCommitRollback) {
+            if (clnt->had_errors && isCommitRollback) {
                 rc = -1;
             }
         }
-        clnt_change_state(&clnt, CONNECTION_IDLE);
+        clnt_change_state(clnt, CONNECTION_IDLE);
 
-        if (clnt.osql.replay == OSQL_RETRY_DO) {
-            if (clnt.trans_has_sp) {
-                osql_set_replay(__FILE__, __LINE__, &clnt, OSQL_RETRY_NONE);
-                srs_tran_destroy(&clnt);
+        if (clnt->osql.replay == OSQL_RETRY_DO) {
+            if (clnt->trans_has_sp) {
+                osql_set_replay(__FILE__, __LINE__, clnt, OSQL_RETRY_NONE);
+                srs_tran_destroy(clnt);
             } else {
-                rc = srs_tran_replay(&clnt, arg->thr_self);
+                rc = srs_tran_replay(clnt, thr_self);
             }
 
-            if (clnt.osql.history == NULL) {
+            if (clnt->osql.history == NULL) {
                 query = APPDATA->query = NULL;
             }
         } else {
             /* if this transaction is done (marked by SQLENG_NORMAL_PROCESS),
                clean transaction sql history
             */
-            if (clnt.osql.history &&
-                clnt.ctrl_sqlengine == SQLENG_NORMAL_PROCESS) {
-                srs_tran_destroy(&clnt);
+            if (clnt->osql.history &&
+                clnt->ctrl_sqlengine == SQLENG_NORMAL_PROCESS) {
+                srs_tran_destroy(clnt);
                 query = APPDATA->query = NULL;
             }
         }
 
-        if (rc && !clnt.in_client_trans)
+        if (rc && !clnt->in_client_trans)
             goto done;
 
-        if (clnt.added_to_hist) {
-            clnt.added_to_hist = 0;
+        if (clnt->added_to_hist) {
+            clnt->added_to_hist = 0;
         } else if (APPDATA->query) {
             cdb2__query__free_unpacked(APPDATA->query, &pb_alloc);
             APPDATA->query = NULL;
         }
-        query = read_newsql_query(dbenv, &clnt, sb);
+        if (newsql_park(s))
+            return;
+        query = read_newsql_query(dbenv, clnt, sb);
     }
 
 done:
+    newsql_session_end(s, query);
+}
+
+static void newsql_session_end(struct newsql_session *s, CDB2QUERY *query)
+{
+    struct sqlclntstate *clnt = &s->clnt;
+    SBUF2 *sb = s->sb;
+
     sbuf2setclnt(sb, NULL);
-    clnt_unregister(&clnt);
+    clnt_unregister(clnt);
 
-    if (clnt.ctrl_sqlengine == SQLENG_INTRANS_STATE) {
-        handle_sql_intrans_unrecoverable_error(&clnt);
+    if (clnt->ctrl_sqlengine == SQLENG_INTRANS_STATE) {
+        handle_sql_intrans_unrecoverable_error(clnt);
     }
 
-    if (clnt.rawnodestats) {
-        release_node_stats(clnt.argv0, clnt.stack, clnt.origin);
-        clnt.rawnodestats = NULL;
+    if (clnt->rawnodestats) {
+        release_node_stats(clnt->argv0, clnt->stack, clnt->origin);
+        clnt->rawnodestats = NULL;
     }
 
-    if (clnt.argv0) {
-        free(clnt.argv0);
-        clnt.argv0 = NULL;
+    if (clnt->argv0) {
+        free(clnt->argv0);
+        clnt->argv0 = NULL;
     }
 
-    if (clnt.stack) {
-        free(clnt.stack);
-        clnt.stack = NULL;
+    if (clnt->stack) {
+        free(clnt->stack);
+        clnt->stack = NULL;
     }
 
-    close_sp(&clnt);
-    osql_clean_sqlclntstate(&clnt);
+    close_sp(clnt);
+    osql_clean_sqlclntstate(clnt);
 
-    if (clnt.dbglog) {
-        sbuf2close(clnt.dbglog);
-        clnt.dbglog = NULL;
+    if (clnt->dbglog) {
+        sbuf2close(clnt->dbglog);
+        clnt->dbglog = NULL;
     }
 
     if (query) {
         cdb2__query__free_unpacked(query, &pb_alloc);
     }
 
-    free_newsql_appdata(&clnt);
+    free_newsql_appdata(clnt);
 
     /* XXX free logical tran?  */
     close_appsock(sb);
-    arg->sb = NULL;
-    cleanup_clnt(&clnt);
+    cleanup_clnt(clnt);
+    free(s);
+}
 
-    return APPSOCK_RETURN_OK;
+/* A connection between statements outside of a transaction can give up its
+ * appsock thread: it waits appsock_park_ms for the next request first, so
+ * busy connections never park, and is then idle until the park thread hands
+ * it back to the pool.  The session state stays in struct newsql_session. */
+extern int gbl_appsock_park_ms;
+extern int gbl_use_appsock_as_sqlthread;
+
+static void newsql_resume(struct thr_handle *thr_self, void *arg, int ready)
+{
+    struct newsql_session *s = arg;
+    CDB2QUERY *query = NULL;
+
+    if (thr_self == NULL || !ready) {
+        /* pool is going away, or idle past max_sql_idle_time */
+        newsql_session_end(s, NULL);
+        return;
+    }
+    thrman_change_type(thr_self, THRTYPE_APPSOCK_SQL);
+    query = read_newsql_query(s->dbenv, &s->clnt, s->sb);
+    newsql_session_run(s, thr_self, query);
+}
+
+static int newsql_park(struct newsql_session *s)
+{
+    struct sqlclntstate *clnt = &s->clnt;
+    struct pollfd pol;
+
+    if (gbl_appsock_park_ms <= 0 || gbl_use_appsock_as_sqlthread ||
+        clnt->in_client_trans ||
+        clnt->ctrl_sqlengine != SQLENG_NORMAL_PROCESS || clnt->osql.history ||
+        sbuf2pending(s->sb) > 0)
+        return 0;
+
+    pol.fd = sbuf2fileno(s->sb);
+    pol.events = POLLIN;
+    if (poll(&pol, 1, gbl_appsock_park_ms) != 0)
+        return 0;
+
+    return appsock_park(
+               s->sb, bdb_attr_get(thedb->bdb_attr, BDB_ATTR_MAX_SQL_IDLE_TIME),
+               newsql_resume, s) == 0;
 }
 
 comdb2_appsock_t newsql_plugin = {
@@ -1046,7 +1046,7 @@ int fdb_msg_read_message(SBUF2 *sb, fdb_msg_t *msg, enum recv_flags flags)
             char *data = strdup("Access Error: db not allowed to connect");
             int datalen = strlen(data) + 1;
             fdb_bend_send_row(sb, msg, NULL, 0, data, datalen, NULL, 0,
-                              FDB_ERR_ACCESS, 0);
+                              FDB_ERR_ACCESS, 0, 1);
             return -1;
         }
 
@@ -2605,7 +2605,8 @@ static enum svc_move_types move_type(int type)
 
 int fdb_bend_send_row(SBUF2 *sb, fdb_msg_t *msg, char *cid,
                       unsigned long long genid, char *data, int datalen,
-                      char *datacopy, int datacopylen, int ret, int isuuid)
+                      char *datacopy, int datacopylen, int ret, int isuuid,
+                      int flush)
 {
     int rc;
     fdb_msg_t lcl_msg;
@@ -2630,7 +2631,7 @@ int fdb_bend_send_row(SBUF2 *sb, fdb_msg_t *msg, char *cid,
     msg->dr.datacopylen = datacopylen;
     msg->dr.datacopy = datacopy;
 
-    rc = fdb_msg_write_message(sb, msg, 1);
+    rc = fdb_msg_write_message(sb, msg, flush);
 
     if (gbl_fdb_track) {
         fdb_msg_print_message(sb, msg, "sending msg");
@@ -2665,7 +2666,7 @@ int fdb_bend_cursor_move(SBUF2 *sb, fdb_msg_t *msg, svc_callback_arg_t *arg)
     }
 
     rc = fdb_bend_send_row(sb, msg, NULL, genid, data, datalen, datacopy,
-                           datacopylen, rc, arg->isuuid);
+                           datacopylen, rc, arg->isuuid, 1);
 
     return rc;
 }
@@ -2724,7 +2725,7 @@ int fdb_bend_cursor_find(SBUF2 *sb, fdb_msg_t *msg, svc_callback_arg_t *arg)
     }
 
     rc = fdb_bend_send_row(sb, msg, NULL, genid, data, datalen, datacopy,
-                           datacopylen, rc, arg->isuuid);
+                           datacopylen, rc, arg->isuuid, 1);
 
     return rc;
 }
@@ -2773,7 +2774,7 @@ int fdb_bend_run_sql(SBUF2 *sb, fdb_msg_t *msg, svc_callback_arg_t *arg)
         const char *tmp = errstat_get_str(&clnt->fdb_state.xerr);
         rc = fdb_svc_sql_row(clnt->fdb_state.remote_sql_sb, cid,
                              (char *)tmp, /* the actual row is the errstr */
-                             strlen(tmp) + 1, irc, arg->isuuid);
+                             strlen(tmp) + 1, irc, arg->isuuid, 1);
         if (rc) {
             logmsg(LOGMSG_ERROR, "%s: fdb_send_rc failed rc=%d\n", __func__,
                    rc);
@@ -3372,7 +3373,7 @@ static int _check_code_release(SBUF2 *sb, char *cid, int code_release,
 
         /* we need to send back a rc code */
         rc = fdb_svc_sql_row(sb, cid, errstr, strlen(errstr) + 1, errval,
-                             isuuid);
+                             isuuid, 1);
         if (rc) {
             logmsg(LOGMSG_ERROR, "%s: fdb_send_rc failed rc=%d\n", __func__,
                    rc);
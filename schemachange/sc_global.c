@@ -296,6 +296,9 @@ void sc_status(struct dbenv *dbenv)
         else if (db && db->doing_upgrade)
             logmsg(LOGMSG_USER, "Upgrade phase running %" PRId64 " upgraded\n",
                    db->sc_nrecs);
+        if (db && db->sc_live_logical)
+            logmsg(LOGMSG_USER, "Logical redo %u commits behind\n",
+                   db->sc_redo_lag);
 
         logmsg(LOGMSG_USER, "-------------------------\n");
         sctbl = hash_next(sc_tables, &ent, &bkt);
@@ -653,7 +653,7 @@ int do_schema_change_tran(sc_arg_t *arg)
     return rc;
 }
 
-int do_schema_change_locked(struct schema_change_type *s)
+static int do_schema_change_int(struct schema_change_type *s, int locked)
 {
     int rc = 0;
     struct ireq *iq = NULL;
@@ -673,14 +673,24 @@ int do_schema_change_locked(struct schema_change_type *s)
     arg->iq = iq;
     arg->sc = s;
     arg->trans = NULL;
-    /* the only callers are lightweight timepartition events,
-       which already have schema lock */
-    arg->iq->sc_locked = 1;
+    /* the callers are timepartition events; unless they
+       already have the schema lock, it is only taken to finalize */
+    arg->iq->sc_locked = locked;
     rc = do_schema_change_tran(arg);
     free(iq);
     return rc;
 }
 
+int do_schema_change_locked(struct schema_change_type *s)
+{
+    return do_schema_change_int(s, 1);
+}
+
+int do_schema_change_unlocked(struct schema_change_type *s)
+{
+    return do_schema_change_int(s, 0);
+}
+
 int finalize_schema_change_thd(struct ireq *iq, tran_type *trans)
 {
     if (iq == NULL || iq->sc == NULL) abort();
@@ -35,4 +35,5 @@ int verify_constraints_exist(struct dbtable *from_db, struct dbtable *to_db,
 
 int do_schema_change_tran(sc_arg_t *);
 int do_schema_change_locked(struct schema_change_type *);
+int do_schema_change_unlocked(struct schema_change_type *);
 #endif
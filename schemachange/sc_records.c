@@ -35,6 +35,9 @@
 #include "logmsg.h"
 
 int gbl_logical_live_sc = 0;
+int gbl_sc_sorted_index_build = 0;
+int gbl_sc_latency_budget_ms = 0;
+int gbl_sc_logical_redo_threads = 0;
 
 extern int gbl_partial_indexes;
 
@@ -148,6 +151,59 @@ static inline int print_aggregate_sc_stat(struct convert_record_data *data,
     return 1;
 }
 
+/* Keep foreground work within sc_latency_budget_ms: called once per
+ * sc_check_lockwaits_sec, compares the average sql service time and the
+ * average time our own commits waited for replication against the budget.
+ * Over budget (or any deadlock) halves the number of convert threads and
+ * the records between replication waits, then starts pacing each record
+ * once both are down to 1.  Comfortably under budget undoes that one step
+ * at a time. */
+static void sc_throttle_check(struct convert_record_data *data,
+                              int64_t diff_deadlocks)
+{
+    struct common_members *cm = data->cmembers;
+    int budget = gbl_sc_latency_budget_ms;
+    int sc_threads =
+        bdb_attr_get(data->from->dbenv->bdb_attr, BDB_ATTR_SC_USE_NUM_THREADS);
+    uint32_t maxthreads = cm->maxthreads, batch = cm->batch;
+    uint32_t pace = cm->pace_usec;
+    double fg_ms, rep_ms = 0;
+
+    fg_ms = time_metric_average(thedb->service_time);
+    int64_t waits = cm->rep_waits - cm->last_rep_waits;
+    if (waits > 0)
+        rep_ms = (cm->rep_wait_us - cm->last_rep_wait_us) / 1000.0 / waits;
+    cm->last_rep_waits = cm->rep_waits;
+    cm->last_rep_wait_us = cm->rep_wait_us;
+
+    if (fg_ms > budget || rep_ms > budget || diff_deadlocks > 0) {
+        if (maxthreads > 1 || batch > 1) {
+            if (maxthreads > 1)
+                XCHANGE32(cm->maxthreads, maxthreads / 2);
+            if (batch > 1)
+                cm->batch = batch / 2;
+        } else {
+            cm->pace_usec = pace ? MIN(pace * 2, 1000000) : 1000;
+        }
+    } else if (fg_ms < budget / 2.0 && rep_ms < budget / 2.0) {
+        if (pace)
+            cm->pace_usec = pace > 1000 ? pace / 2 : 0;
+        else {
+            increase_max_threads(&cm->maxthreads, sc_threads);
+            cm->batch = MIN(batch * 2, gbl_num_record_converts);
+        }
+    }
+
+    if (cm->maxthreads != maxthreads || cm->batch != batch ||
+        cm->pace_usec != pace)
+        sc_printf(data->s,
+                  "[%s] throttle: sql service %.1fms replication %.1fms "
+                  "deadlocks %ld budget %dms -> threads %u batch %u pace "
+                  "%uus\n",
+                  data->from->tablename, fg_ms, rep_ms, diff_deadlocks, budget,
+                  cm->maxthreads, cm->batch, cm->pace_usec);
+}
+
 static inline void lkcounter_check(struct convert_record_data *data, int now)
 {
     uint32_t copy_lasttime = data->cmembers->lkcountercheck_lasttime;
@@ -180,6 +236,10 @@ static inline void lkcounter_check(struct convert_record_data *data, int now)
         "%s: diff_deadlocks=%ld, diff_lockwaits=%ld, maxthr=%d, currthr=%d\n",
         __func__, diff_deadlocks, diff_lockwaits, data->cmembers->maxthreads,
         data->cmembers->thrcount);
+    if (gbl_sc_latency_budget_ms > 0) {
+        sc_throttle_check(data, diff_deadlocks);
+        return;
+    }
     increase_max_threads(
         &data->cmembers->maxthreads,
         bdb_attr_get(data->from->dbenv->bdb_attr, BDB_ATTR_SC_USE_NUM_THREADS));
@@ -371,8 +431,16 @@ static void delay_sc_if_needed(struct convert_record_data *data,
     int rc;
 
     /* wait for replication on what we just committed */
-    if ((data->nrecs % data->num_records_per_trans) == 0) {
-        if ((rc = trans_wait_for_seqnum(&data->iq, gbl_mynode, ss)) != 0) {
+    int batch = data->num_records_per_trans;
+    if (gbl_sc_latency_budget_ms > 0 && data->cmembers->batch)
+        batch = data->cmembers->batch;
+    if ((data->nrecs % batch) == 0) {
+        int64_t start = comdb2_time_epochus();
+        rc = trans_wait_for_seqnum(&data->iq, gbl_mynode, ss);
+        ATOMIC_ADD64(data->cmembers->rep_wait_us,
+                     comdb2_time_epochus() - start);
+        ATOMIC_ADD64(data->cmembers->rep_waits, 1);
+        if (rc != 0) {
             sc_errf(data->s, "delay_sc_if_needed: error waiting for "
                              "replication rcode %d\n",
                     rc);
@@ -397,6 +465,9 @@ static void delay_sc_if_needed(struct convert_record_data *data,
 
     if (inco_delay) poll(NULL, 0, inco_delay * mult);
 
+    if (data->cmembers->pace_usec)
+        usleep(data->cmembers->pace_usec);
+
     /* if we're in commitdelay mode, magnify the delay by 5 here */
     int delay = bdb_attr_get(data->from->dbenv->bdb_attr, BDB_ATTR_COMMITDELAY);
     if (delay != 0)
@@ -574,6 +645,95 @@ static int prepare_and_verify_newdb_record(struct convert_record_data *data,
     return 0;
 }
 
+/* Sorted index build.  When a logical live schema change keeps the data file
+ * and blobs and only has indexes to build, the convert threads don't insert
+ * anything: each one extracts the new keys of its stripe into a temp table
+ * per index, keyed by index key and genid.  Once every stripe is done the
+ * tables are merged and each new index is loaded in key order, so berkdb
+ * fills every page as it splits off the right edge.  The logical redo thread
+ * holds off until then and replays the log from the start of the schema
+ * change. */
+static int sorted_ix_build_ok(struct dbtable *from, struct dbtable *to,
+                              struct schema_change_type *s)
+{
+    if (!gbl_sc_sorted_index_build || !s->logical_livesc ||
+        s->scanmode != SCAN_PARALLEL)
+        return 0;
+    if (!gbl_use_plan || !to->plan || is_dta_being_rebuilt(to->plan) ||
+        !to->plan->plan_blobs)
+        return 0;
+    if (s->schema_change == SC_CONSTRAINT_CHANGE || s->use_new_genids ||
+        s->force_rebuild || s->use_old_blobs_on_rebuild)
+        return 0;
+    /* keys of these need blobs or per-row checks we don't do here */
+    if (to->ix_expr || (gbl_partial_indexes && to->ix_partial))
+        return 0;
+    for (int ixnum = 0; ixnum < to->nix; ixnum++) {
+        if (to->plan->ix_plan[ixnum] == -1)
+            return 1;
+    }
+    return 0;
+}
+
+/* form key ixnum of the new table from a .NEW..ONDISK record */
+static int sorted_ix_form_key(struct dbtable *to, int ixnum, void *od_dta,
+                              char *key, char *mangled_key, char **tail,
+                              int *taillen, const char *tzname)
+{
+    char ixtag[MAXTAGLEN];
+    snprintf(ixtag, sizeof(ixtag), ".NEW..ONDISK_IX_%d", ixnum);
+    return create_key_from_ondisk_sch_blobs(
+        to, to->schema, ixnum, tail, taillen, mangled_key, ".NEW..ONDISK",
+        od_dta, to->lrl, ixtag, key, NULL, NULL, 0, tzname);
+}
+
+/* stash the new keys of one record in the temp tables of its stripe */
+static int sorted_ix_extract(struct convert_record_data *data, void *od_dta,
+                             unsigned long long genid)
+{
+    char key[MAXKEYLEN + sizeof(genid)];
+    char mangled_key[MAXKEYLEN];
+    int rc, bdberr;
+
+    for (int ixnum = 0; ixnum < data->to->nix; ixnum++) {
+        char *tail = NULL;
+        int taillen = 0;
+
+        if (data->to->plan->ix_plan[ixnum] != -1)
+            continue;
+
+        int ixkeylen = getkeysize(data->to, ixnum);
+        if (sorted_ix_form_key(data->to, ixnum, od_dta, key, mangled_key,
+                               &tail, &taillen, data->iq.tzname)) {
+            sc_errf(data->s, "cannot form index %d for genid 0x%llx\n", ixnum,
+                    genid);
+            return ERR_INTERNAL;
+        }
+        memcpy(key + ixkeylen, &genid, sizeof(genid));
+
+        if (data->sorted_keys[ixnum] == NULL) {
+            data->sorted_keys[ixnum] =
+                bdb_temp_table_create(thedb->bdb_env, &bdberr);
+            if (data->sorted_keys[ixnum] == NULL) {
+                sc_errf(data->s,
+                        "failed to create key table for index %d, bdberr %d\n",
+                        ixnum, bdberr);
+                return ERR_INTERNAL;
+            }
+        }
+        rc = bdb_temp_table_put(thedb->bdb_env, data->sorted_keys[ixnum], key,
+                                ixkeylen + sizeof(genid), tail ? tail : key,
+                                taillen, NULL, &bdberr);
+        if (rc) {
+            sc_errf(data->s,
+                    "failed to save key of index %d, rc %d bdberr %d\n",
+                    ixnum, rc, bdberr);
+            return ERR_INTERNAL;
+        }
+    }
+    return 0;
+}
+
 /* converts a single record and prepares for the next one
  * should be called from a while loop
  * param data: pointer to all the state information
@@ -929,7 +1089,11 @@ static int convert_record(struct convert_record_data *data)
 
     assert(data->trans != NULL);
 
-    if (data->s->schema_change != SC_CONSTRAINT_CHANGE) {
+    if (data->s->sorted_ix_build) {
+        rc = sorted_ix_extract(data, p_buf_data, ngenid);
+        if (rc)
+            goto err;
+    } else if (data->s->schema_change != SC_CONSTRAINT_CHANGE) {
         int nrrn = rrn;
         rc = add_record(
             &data->iq, data->trans, p_tagname_buf, p_tagname_buf_end,
@@ -945,8 +1109,10 @@ static int convert_record(struct convert_record_data *data)
     }
 
     /* if we have been rebuilding the data files we're gonna
-       call bdb_get_high_genid to resume, not look at llmeta */
+       call bdb_get_high_genid to resume, not look at llmeta.  A sorted
+       build has nothing in the new indexes to resume from yet. */
     if (usellmeta && !is_dta_being_rebuilt(data->to->plan) &&
+        !data->s->sorted_ix_build &&
         (data->nrecs %
          BDB_ATTR_GET(thedb->bdb_attr, INDEXREBUILD_SAVE_EVERY_N)) == 0) {
         int bdberr;
@@ -961,7 +1127,18 @@ static int convert_record(struct convert_record_data *data)
     }
 
 err:
-    if (data->s->logical_livesc && (rc == IX_DUP || rc == ERR_CONSTR)) {
+    if (data->s->sorted_ix_build && rc == ERR_CONSTR &&
+        data->cv_genid != ngenid) {
+        /* the logical redo thread isn't running yet, so there is nothing to
+         * wait for; read the row again once in case it was just changed */
+        data->cv_genid = ngenid;
+        trans_abort(&data->iq, data->trans);
+        data->trans = NULL;
+        poll(0, 0, 200);
+        return 1;
+    }
+    if (data->s->logical_livesc && !data->s->sorted_ix_build &&
+        (rc == IX_DUP || rc == ERR_CONSTR)) {
         /* handle constraints violations */
         if (data->cv_genid != ngenid) {
             /* get current lsn if this is a new constraint violation */
@@ -1262,6 +1439,370 @@ static void stop_sc_redo_wait(bdb_state_type *bdb_state,
     Pthread_mutex_unlock(&bdb_state->sc_redo_lk);
 }
 
+/* whether the row with this genid still exists and still maps to key in
+ * index ixnum of the new table */
+static int sorted_ix_key_is_current(struct convert_record_data *data,
+                                    tran_type *trans, int ixnum,
+                                    unsigned long long genid, const char *key,
+                                    int *current)
+{
+    char newkey[MAXKEYLEN];
+    char mangled_key[MAXKEYLEN];
+    void *od_dta = data->dta_buf;
+    int dtalen = 0;
+    int rc;
+
+    *current = 0;
+    data->iq.usedb = data->from;
+    rc = ix_find_by_rrn_and_genid_tran(&data->iq, 2, genid, data->dta_buf,
+                                       &dtalen, data->from->lrl, trans);
+    data->iq.usedb = data->to;
+    if (rc == IX_NOTFND)
+        return 0;
+    if (rc != IX_FND)
+        return rc == RC_INTERNAL_RETRY ? rc : ERR_INTERNAL;
+
+    if (!data->s->rebuild_index) {
+        bzero(data->wrblb, sizeof(data->wrblb));
+        rc = convert_server_record_cachedmap(
+            data->to->tablename, data->tagmap, od_dta, data->rec->recbuf,
+            data->s, data->from->schema, data->to->schema, data->wrblb,
+            sizeof(data->wrblb) / sizeof(data->wrblb[0]));
+        free_blob_buffers(data->wrblb,
+                          sizeof(data->wrblb) / sizeof(data->wrblb[0]));
+        if (rc)
+            return ERR_INTERNAL;
+        od_dta = data->rec->recbuf;
+    }
+    if (sorted_ix_form_key(data->to, ixnum, od_dta, newkey, mangled_key, NULL,
+                           NULL, data->iq.tzname))
+        return ERR_INTERNAL;
+    *current = memcmp(newkey, key, getkeysize(data->to, ixnum)) == 0;
+    return 0;
+}
+
+/* Add one extracted key to its new index.  The stripes were read at
+ * different times, so a unique key can collide with a row that has been
+ * deleted or changed since its key was extracted.  Only a collision between
+ * two rows that both still hold the key is a real violation; the stale side
+ * is dropped and logical redo catches up with whatever happened to it. */
+static int sorted_ix_add(struct convert_record_data *data, tran_type *trans,
+                         int ixnum, char *key, unsigned long long genid,
+                         char *tail, int taillen)
+{
+    struct dbtable *to = data->to;
+    unsigned long long fndgenid = 0;
+    int isnullk = ix_isnullk(to, key, ixnum);
+    int fndrrn = 0, current;
+    int rc;
+
+    rc = ix_addk(&data->iq, trans, key, ixnum, genid, 2, tail, taillen,
+                 isnullk);
+    if (rc != IX_DUP)
+        return rc;
+
+    /* the same key/genid pair, loaded by an earlier attempt */
+    if (to->ix_dupes[ixnum] || isnullk)
+        return 0;
+
+    rc = ix_find_by_key_tran(&data->iq, key, getkeysize(to, ixnum), ixnum,
+                             NULL, &fndrrn, &fndgenid, NULL, NULL, 0, trans);
+    if (rc == RC_INTERNAL_RETRY)
+        return rc;
+    if (rc != IX_FND && rc != IX_FNDMORE)
+        return ERR_INTERNAL;
+    if (fndgenid == genid)
+        return 0;
+
+    if ((rc = sorted_ix_key_is_current(data, trans, ixnum, genid, key,
+                                       &current)) != 0)
+        return rc;
+    if (!current)
+        return 0;
+    if ((rc = sorted_ix_key_is_current(data, trans, ixnum, fndgenid, key,
+                                       &current)) != 0)
+        return rc;
+    if (current)
+        return IX_DUP;
+
+    rc = ix_delk(&data->iq, trans, key, ixnum, 2, fndgenid, 0);
+    if (rc)
+        return rc;
+    return ix_addk(&data->iq, trans, key, ixnum, genid, 2, tail, taillen, 0);
+}
+
+struct sorted_ix_key {
+    char *buf; /* key, genid, then the tail */
+    size_t bufsz;
+    int taillen;
+};
+
+struct sorted_ix_load {
+    struct convert_record_data data;
+    struct convert_record_data *stripes;
+    int nstripes;
+    int ixnum;
+};
+
+/* add a batch of keys in one transaction, starting over on deadlock */
+static int sorted_ix_add_batch(struct convert_record_data *data, int ixnum,
+                               struct sorted_ix_key *batch, int nbatch)
+{
+    int ixkeylen = getkeysize(data->to, ixnum);
+    db_seqnum_type ss;
+    int rc;
+
+again:
+    if (gbl_sc_abort || data->from->sc_abort || data->s->sc_thd_failed ||
+        (data->s->iq && data->s->iq->sc_should_abort))
+        return -1;
+
+    rc = trans_start_sc(&data->iq, NULL, &data->trans);
+    if (rc) {
+        sc_errf(data->s, "error %d starting transaction\n", rc);
+        return -1;
+    }
+    set_tran_lowpri(&data->iq, data->trans);
+
+    for (int i = 0; i < nbatch; i++) {
+        unsigned long long genid;
+        memcpy(&genid, batch[i].buf + ixkeylen, sizeof(genid));
+        rc = sorted_ix_add(data, data->trans, ixnum, batch[i].buf, genid,
+                           batch[i].taillen
+                               ? batch[i].buf + ixkeylen + sizeof(genid)
+                               : NULL,
+                           batch[i].taillen);
+        if (rc == RC_INTERNAL_RETRY) {
+            trans_abort(&data->iq, data->trans);
+            data->trans = NULL;
+            data->totnretries++;
+            poll(0, 0, (rand() % 500 + 10));
+            goto again;
+        } else if (rc == IX_DUP) {
+            if (data->s->iq)
+                reqerrstr(data->s->iq, ERR_SC,
+                          "add key constraint duplicate key '%s' on table "
+                          "'%s' index %d",
+                          get_keynm_from_db_idx(data->to, ixnum),
+                          data->to->tablename, ixnum);
+            sc_errf(data->s,
+                    "Could not add duplicate entry in index %d genid 0x%llx\n",
+                    ixnum, genid);
+            return -1;
+        } else if (rc) {
+            sc_errf(data->s, "Error adding key to index %d rc %d genid 0x%llx\n",
+                    ixnum, rc, genid);
+            return -1;
+        }
+    }
+
+    if (data->live)
+        rc = trans_commit_seqnum(&data->iq, data->trans, &ss);
+    else
+        rc = trans_commit(&data->iq, data->trans, gbl_mynode);
+    data->trans = NULL;
+    if (rc) {
+        sc_errf(data->s, "%s: trans_commit failed with rcode %d\n", __func__,
+                rc);
+        return -1;
+    }
+    if (data->live)
+        delay_sc_if_needed(data, &ss);
+    data->nrecs += nbatch;
+    return 0;
+}
+
+/* merge the per-stripe key tables of one index and append them to it */
+static void *sorted_ix_load_thd(struct sorted_ix_load *ld)
+{
+    struct convert_record_data *data = &ld->data;
+    struct thr_handle *thr_self;
+    struct temp_cursor *cur[MAXDTASTRIPE] = {0};
+    struct sorted_ix_key *batch = NULL;
+    int ixnum = ld->ixnum;
+    int keysz = getkeysize(data->to, ixnum) + sizeof(unsigned long long);
+    int nbatch = 0, bdberr, rc = 0;
+
+    thread_started("sorted index load");
+    thr_self = thrman_register(THRTYPE_SCHEMACHANGE);
+    backend_thread_event(thedb, COMDB2_THR_EVENT_START_RDWR);
+
+    data->iq.reqlogger = thrman_get_reqlogger(thr_self);
+    data->outrc = -1;
+    data->lasttime = comdb2_time_epoch();
+    data->rec = allocate_db_record(data->to->tablename, ".NEW..ONDISK");
+    data->dta_buf = malloc(data->from->lrl);
+    batch = calloc(data->num_records_per_trans, sizeof(*batch));
+    if (!data->rec || !data->dta_buf || !batch) {
+        sc_errf(data->s, "%s: out of memory\n", __func__);
+        goto cleanup;
+    }
+
+    for (int st = 0; st < ld->nstripes; st++) {
+        struct temp_table *tbl = ld->stripes[st].sorted_keys[ixnum];
+        if (tbl == NULL)
+            continue;
+        cur[st] = bdb_temp_table_cursor(thedb->bdb_env, tbl, NULL, &bdberr);
+        if (cur[st] == NULL) {
+            sc_errf(data->s, "failed to open key cursor, bdberr %d\n", bdberr);
+            goto cleanup;
+        }
+        rc = bdb_temp_table_first(thedb->bdb_env, cur[st], &bdberr);
+        if (rc == IX_EMPTY) {
+            bdb_temp_table_close_cursor(thedb->bdb_env, cur[st], &bdberr);
+            cur[st] = NULL;
+        } else if (rc != IX_FND) {
+            sc_errf(data->s, "failed to read keys, rc %d bdberr %d\n", rc,
+                    bdberr);
+            goto cleanup;
+        }
+    }
+
+    while (1) {
+        int min = -1;
+        for (int st = 0; st < ld->nstripes; st++) {
+            if (cur[st] &&
+                (min == -1 || memcmp(bdb_temp_table_key(cur[st]),
+                                     bdb_temp_table_key(cur[min]), keysz) < 0))
+                min = st;
+        }
+
+        int maxbatch = data->num_records_per_trans;
+        if (gbl_sc_latency_budget_ms > 0 && data->cmembers->batch)
+            maxbatch = MIN(data->cmembers->batch, maxbatch);
+        if (min == -1 || nbatch >= maxbatch) {
+            if (nbatch && sorted_ix_add_batch(data, ixnum, batch, nbatch))
+                goto cleanup;
+            nbatch = 0;
+            if (min == -1)
+                break;
+        }
+
+        struct sorted_ix_key *k = &batch[nbatch++];
+        k->taillen = bdb_temp_table_datasize(cur[min]);
+        if (k->bufsz < keysz + k->taillen) {
+            free(k->buf);
+            k->bufsz = keysz + k->taillen;
+            if ((k->buf = malloc(k->bufsz)) == NULL) {
+                sc_errf(data->s, "%s: out of memory\n", __func__);
+                goto cleanup;
+            }
+        }
+        memcpy(k->buf, bdb_temp_table_key(cur[min]), keysz);
+        if (k->taillen)
+            memcpy(k->buf + keysz, bdb_temp_table_data(cur[min]), k->taillen);
+
+        rc = bdb_temp_table_next(thedb->bdb_env, cur[min], &bdberr);
+        if (rc == IX_PASTEOF) {
+            bdb_temp_table_close_cursor(thedb->bdb_env, cur[min], &bdberr);
+            cur[min] = NULL;
+        } else if (rc != IX_FND) {
+            sc_errf(data->s, "failed to read keys, rc %d bdberr %d\n", rc,
+                    bdberr);
+            goto cleanup;
+        }
+
+        int now = comdb2_time_epoch();
+        if (gbl_sc_report_freq > 0 &&
+            now >= data->lasttime + gbl_sc_report_freq) {
+            data->lasttime = now;
+            sc_printf(data->s, "[%s] index %d: loaded %lld sorted keys\n",
+                      data->to->tablename, ixnum, data->nrecs);
+        }
+    }
+
+    sc_printf(data->s, "[%s] index %d: loaded %lld sorted keys with %d "
+                       "retries\n",
+              data->to->tablename, ixnum, data->nrecs, data->totnretries);
+    data->outrc = 0;
+
+cleanup:
+    for (int st = 0; st < ld->nstripes; st++) {
+        if (cur[st])
+            bdb_temp_table_close_cursor(thedb->bdb_env, cur[st], &bdberr);
+    }
+    if (batch) {
+        for (int i = 0; i < data->num_records_per_trans; i++)
+            free(batch[i].buf);
+        free(batch);
+    }
+    if (data->outrc)
+        data->s->sc_thd_failed = -1;
+    convert_record_data_cleanup(data);
+    backend_thread_event(thedb, COMDB2_THR_EVENT_DONE_RDWR);
+    return NULL;
+}
+
+/* Once every stripe has been extracted, load each new index from its sorted
+ * keys, one thread per index. */
+static int sorted_ix_load_all(struct convert_record_data *base,
+                              struct convert_record_data *stripes,
+                              int nstripes)
+{
+    struct sorted_ix_load *ld;
+    pthread_attr_t attr;
+    int nix = base->to->nix;
+    int outrc = 0;
+
+    ld = calloc(nix, sizeof(*ld));
+    if (ld == NULL) {
+        sc_errf(base->s, "%s: out of memory\n", __func__);
+        return -1;
+    }
+
+    Pthread_attr_init(&attr);
+    Pthread_attr_setstacksize(&attr, DEFAULT_THD_STACKSZ);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    for (int ixnum = 0; ixnum < nix; ixnum++) {
+        if (base->to->plan->ix_plan[ixnum] != -1)
+            continue;
+        ld[ixnum].data = *base;
+        ld[ixnum].data.stripe = -1;
+        ld[ixnum].data.nrecs = 0;
+        ld[ixnum].stripes = stripes;
+        ld[ixnum].nstripes = nstripes;
+        ld[ixnum].ixnum = ixnum;
+        sc_printf(base->s, "[%s] starting sorted load of index %d\n",
+                  base->to->tablename, ixnum);
+        if (pthread_create(&ld[ixnum].data.tid, &attr,
+                           (void *(*)(void *))sorted_ix_load_thd, &ld[ixnum])) {
+            sc_errf(base->s, "[%s] starting load thread failed for index %d\n",
+                    base->to->tablename, ixnum);
+            base->s->sc_thd_failed = -1;
+            ld[ixnum].data.tid = 0;
+            outrc = -1;
+            break;
+        }
+    }
+
+    for (int ixnum = 0; ixnum < nix; ixnum++) {
+        if (!ld[ixnum].data.tid)
+            continue;
+        pthread_join(ld[ixnum].data.tid, NULL);
+        if (ld[ixnum].data.outrc)
+            outrc = -1;
+    }
+
+    Pthread_attr_destroy(&attr);
+    free(ld);
+    return outrc;
+}
+
+static void sorted_ix_free(struct convert_record_data *stripes, int nstripes)
+{
+    int bdberr;
+    for (int st = 0; st < nstripes; st++) {
+        for (int ixnum = 0; ixnum < MAXINDEX; ixnum++) {
+            if (stripes[st].sorted_keys[ixnum]) {
+                bdb_temp_table_close(thedb->bdb_env,
+                                     stripes[st].sorted_keys[ixnum], &bdberr);
+                stripes[st].sorted_keys[ixnum] = NULL;
+            }
+        }
+    }
+}
+
 int convert_all_records(struct dbtable *from, struct dbtable *to,
                         unsigned long long *sc_genids,
                         struct schema_change_type *s)
@@ -1344,8 +1885,12 @@ int convert_all_records(struct dbtable *from, struct dbtable *to,
         sc_threads = gbl_dtastripe;
     }
     data.cmembers->maxthreads = sc_threads;
-    data.cmembers->is_decrease_thrds = bdb_attr_get(
-        data.from->dbenv->bdb_attr, BDB_ATTR_SC_DECREASE_THRDS_ON_DEADLOCK);
+    data.cmembers->batch = gbl_num_record_converts;
+    /* the latency throttle works through the same thread accounting */
+    data.cmembers->is_decrease_thrds =
+        bdb_attr_get(data.from->dbenv->bdb_attr,
+                     BDB_ATTR_SC_DECREASE_THRDS_ON_DEADLOCK) ||
+        gbl_sc_latency_budget_ms > 0;
 
     // tagmap only needed if we are doing work on the data file
     data.tagmap = get_tag_mapping(
@@ -1419,6 +1964,10 @@ int convert_all_records(struct dbtable *from, struct dbtable *to,
         }
 
         s->logical_livesc = 1;
+        s->sorted_ix_build = sorted_ix_build_ok(from, to, s);
+        if (s->sorted_ix_build)
+            sc_printf(s, "[%s] building new indexes from sorted keys\n",
+                      s->tablename);
         Pthread_rwlock_wrlock(&s->db->sc_live_lk);
         s->db->sc_live_logical = 1;
         Pthread_rwlock_unlock(&s->db->sc_live_lk);
@@ -1430,6 +1979,7 @@ int convert_all_records(struct dbtable *from, struct dbtable *to,
                     s->tablename);
             bdb_clear_logical_live_sc(s->db->handle, 1 /* lock table */);
             s->logical_livesc = 0;
+            s->sorted_ix_build = 0;
             free(s->sc_convert_done);
             s->sc_convert_done = NULL;
             return -1;
@@ -1463,6 +2013,8 @@ int convert_all_records(struct dbtable *from, struct dbtable *to,
         int rc = 0;
 
         data.isThread = 1;
+        memset(threadData, 0, sizeof(threadData));
+        memset(threadSkipped, 0, sizeof(threadSkipped));
 
         Pthread_attr_init(&attr);
         Pthread_attr_setstacksize(&attr, DEFAULT_THD_STACKSZ);
@@ -1537,6 +2089,12 @@ int convert_all_records(struct dbtable *from, struct dbtable *to,
 
         /* destroy attr */
         Pthread_attr_destroy(&attr);
+
+        if (outrc == 0 && s->sorted_ix_build)
+            outrc = sorted_ix_load_all(&data, threadData, gbl_dtastripe);
+        sorted_ix_free(threadData, gbl_dtastripe);
+        /* let logical redo replay what was written meanwhile */
+        s->sorted_ix_build = 0;
     }
 
     print_final_sc_stat(&data);
@@ -2457,6 +3015,8 @@ static int live_sc_redo_add(struct convert_record_data *data, DB_LOGC *logc,
             rc = 0;
             goto done;
         }
+        if (rc == IX_DUP && data->redo_dup_retry)
+            goto done;
         if (rc) {
             if (data->s->iq) {
                 if (rc == IX_DUP)
@@ -2848,6 +3408,8 @@ static int live_sc_redo_logical_rec(struct convert_record_data *data,
             return 0;
         }
         rc = live_sc_redo_add(data, logc, rec, logdta);
+        if (rc == IX_DUP && data->redo_dup_retry)
+            return rc;
         if (rc) {
             logmsg(LOGMSG_ERROR,
                    "%s: [%s] failed to redo add lsn[%u:%u] rc=%d\n", __func__,
@@ -2869,6 +3431,8 @@ static int live_sc_redo_logical_rec(struct convert_record_data *data,
     case DB_llog_undo_upd_dta:
     case DB_llog_undo_upd_dta_lk:
         rc = live_sc_redo_update(data, logc, rec, logdta);
+        if (rc == IX_DUP && data->redo_dup_retry)
+            return rc;
         if (rc) {
             logmsg(LOGMSG_ERROR,
                    "%s: [%s] failed to redo update lsn[%u:%u] rc=%d\n",
@@ -2884,20 +3448,74 @@ static int live_sc_redo_logical_rec(struct convert_record_data *data,
     return 0;
 }
 
-static int live_sc_redo_logical_log(struct convert_record_data *data,
-                                    bdb_llog_cursor *pCur)
+/* With sc_logical_redo_threads set, the logical redo thread only reads the
+ * log: the records of each transaction are split by data stripe and queued to
+ * one worker per group of stripes, which redoes them in its own transaction.
+ * A stripe always goes to the same worker, so the changes to a row are redone
+ * in the order they were made.  Rows of different stripes can be redone out
+ * of order, which matters only for a unique key one row gives up and another
+ * takes: a worker that gets a duplicate waits for the others to redo every
+ * transaction before its own and tries once more.  The redo thread hands out
+ * at most SC_REDO_WINDOW transactions before it waits for the workers to
+ * finish them, and only then moves the lsn the convert threads and the
+ * finalize wait on. */
+#define SC_REDO_WINDOW 256
+
+/* the records of one transaction for one worker */
+struct sc_redo_batch {
+    DB_LSN lsn; /* of the transaction */
+    LISTC_T(bdb_osql_log_rec_t) recs;
+    LINKC_T(struct sc_redo_batch) lnk;
+};
+
+struct sc_redo_worker {
+    struct convert_record_data data;
+    struct sc_redo_pool *pool;
+    LISTC_T(struct sc_redo_batch) q;
+    struct sc_redo_batch *cur; /* being redone */
+};
+
+struct sc_redo_pool {
+    pthread_mutex_t lk;
+    pthread_cond_t cd;
+    int nworkers;
+    int nqueued; /* handed out and not yet redone */
+    int exiting;
+    struct sc_redo_worker *workers;
+    struct sc_redo_batch **next; /* per worker, being filled */
+};
+
+/* wait until no other worker has a transaction before lsn left to redo */
+static void sc_redo_wait_lower(struct sc_redo_pool *pool,
+                               struct convert_record_data *data, DB_LSN *lsn)
+{
+    int lower;
+
+    Pthread_mutex_lock(&pool->lk);
+    do {
+        lower = 0;
+        for (int i = 0; i < pool->nworkers && !lower; i++) {
+            struct sc_redo_worker *w = &pool->workers[i];
+            if (&w->data == data)
+                continue;
+            if ((w->cur && log_compare(&w->cur->lsn, lsn) < 0) ||
+                (w->q.top && log_compare(&w->q.top->lsn, lsn) < 0))
+                lower = 1;
+        }
+        if (lower)
+            Pthread_cond_wait(&pool->cd, &pool->lk);
+    } while (lower && !data->s->sc_thd_failed);
+    Pthread_mutex_unlock(&pool->lk);
+}
+
+/* Move the records of the transaction at pCur that touch the table to recs.
+ * Returns the number moved. */
+static int live_sc_redo_collect(struct convert_record_data *data,
+                                bdb_llog_cursor *pCur, listc_t *recs)
 {
-    int rc = 0;
-    bdb_state_type *bdb_state = thedb->bdb_env;
     bdb_osql_log_rec_t *rec = NULL, *tmp = NULL;
-    DB_LOGC *logc = NULL;
-    int interested = 0;
-    DBT logdta = {0};
-    logdta.flags = DB_DBT_REALLOC;
-    LISTC_T(bdb_osql_log_rec_t) recs; /* list of relevant undo records */
-    listc_init(&recs, offsetof(bdb_osql_log_rec_t, lnk));
+    int n = 0;
 
-    /* pre process recs */
     LISTC_FOR_EACH_SAFE(&pCur->log->impl->recs, rec, tmp, lnk)
     {
         /* skip if it is not data operations */
@@ -2907,44 +3525,55 @@ static int live_sc_redo_logical_log(struct convert_record_data *data,
         if (strcasecmp(data->s->tablename, rec->table) != 0)
             continue;
 
-        /* get one op that needs to be redone - mark interested */
-        interested = 1;
         listc_rfl(&pCur->log->impl->recs, rec);
+        listc_abl(recs, rec);
+        n++;
+    }
+    return n;
+}
 
-        if (rec->dtafile >= 1) {
-            /* put blob records into a list hash based on genid */
-            struct blob_recs brecs = {0};
-            struct blob_recs *pbrecs = NULL;
-            brecs.genid = rec->genid;
-            pbrecs = hash_find(data->blob_hash, &brecs);
-            if (pbrecs) {
-                listc_abl(&pbrecs->recs, rec);
-            } else {
-                pbrecs = calloc(1, sizeof(struct blob_recs));
-                if (pbrecs == NULL) {
-                    logmsg(LOGMSG_ERROR, "%s:%d failed to malloc blob rec\n",
-                           __func__, __LINE__);
-                    rc = -1;
-                    goto done;
-                }
-                pbrecs->genid = rec->genid;
-                listc_init(&pbrecs->recs, offsetof(bdb_osql_log_rec_t, lnk));
-                listc_abl(&pbrecs->recs, rec);
-                hash_add(data->blob_hash, pbrecs);
-            }
+/* Redo recs, the records of the transaction at lsn, against the new btrees.
+ * If save_lsn is set, lsn is saved as the point to resume from now and then.
+ * Frees recs. */
+static int live_sc_redo_apply(struct convert_record_data *data, listc_t *recs,
+                              DB_LSN *lsn, int save_lsn)
+{
+    int rc = 0;
+    bdb_state_type *bdb_state = thedb->bdb_env;
+    bdb_osql_log_rec_t *rec = NULL, *tmp = NULL;
+    DB_LOGC *logc = NULL;
+    int dupwait = 0;
+    DBT logdta = {0};
+    logdta.flags = DB_DBT_REALLOC;
+
+    LISTC_FOR_EACH_SAFE(recs, rec, tmp, lnk)
+    {
+        if (rec->dtafile < 1)
+            continue;
+        /* put blob records into a list hash based on genid */
+        listc_rfl(recs, rec);
+        struct blob_recs brecs = {0};
+        struct blob_recs *pbrecs = NULL;
+        brecs.genid = rec->genid;
+        pbrecs = hash_find(data->blob_hash, &brecs);
+        if (pbrecs) {
+            listc_abl(&pbrecs->recs, rec);
         } else {
-            /* put relevant log records into a linked list so we don't need to
-             * loop on the transaction's logical operations list anymore */
-            listc_abl(&recs, rec);
+            pbrecs = calloc(1, sizeof(struct blob_recs));
+            if (pbrecs == NULL) {
+                logmsg(LOGMSG_ERROR, "%s:%d failed to malloc blob rec\n",
+                       __func__, __LINE__);
+                listc_abl(recs, rec);
+                rc = -1;
+                goto done;
+            }
+            pbrecs->genid = rec->genid;
+            listc_init(&pbrecs->recs, offsetof(bdb_osql_log_rec_t, lnk));
+            listc_abl(&pbrecs->recs, rec);
+            hash_add(data->blob_hash, pbrecs);
         }
     }
 
-    if (!interested) {
-        /* nothing to do if none of the logical ops are relevant to the table */
-        rc = 0;
-        goto done;
-    }
-
     if ((rc = bdb_state->dbenv->log_cursor(bdb_state->dbenv, &logc, 0)) != 0) {
         logmsg(LOGMSG_ERROR, "%s:%d failed to get log-cursor %d\n", __func__,
                __LINE__, rc);
@@ -2969,9 +3598,10 @@ again:
         reqlog_new_request(&data->iq); // TODO: cleanup (reset) logger
         reqpushprefixf(&data->iq, "0x%llx: LOGICAL REDO ", pthread_self());
     }
+    data->redo_dup_retry = data->redo_pool && !dupwait;
 
     /* redo each of the log records revelant to this table */
-    LISTC_FOR_EACH(&recs, rec, lnk)
+    LISTC_FOR_EACH(recs, rec, lnk)
     {
         if (data->s->sc_thd_failed) {
             if (!data->s->retry_bad_genids)
@@ -2991,22 +3621,24 @@ again:
         /* redo this logical op */
         rc = live_sc_redo_logical_rec(data, logc, rec, &logdta);
         if (rc) {
-            logmsg(LOGMSG_ERROR,
-                   "[%s] redo failed at record lsn[%u:%u] table[%s] type[%d] "
-                   "rc=%d\n",
-                   data->s->tablename, rec->lsn.file, rec->lsn.offset,
-                   rec->table, rec->type, rc);
+            if (rc != IX_DUP || !data->redo_dup_retry)
+                logmsg(LOGMSG_ERROR,
+                       "[%s] redo failed at record lsn[%u:%u] table[%s] "
+                       "type[%d] rc=%d\n",
+                       data->s->tablename, rec->lsn.file, rec->lsn.offset,
+                       rec->table, rec->type, rc);
             goto done;
         }
     }
 
     data->nrecs++;
-    if (data->nrecs %
-            BDB_ATTR_GET(thedb->bdb_attr, SC_LOGICAL_SAVE_LSN_EVERY_N) ==
-        0) {
+    if (save_lsn &&
+        data->nrecs %
+                BDB_ATTR_GET(thedb->bdb_attr, SC_LOGICAL_SAVE_LSN_EVERY_N) ==
+            0) {
         int bdberr = 0;
-        rc = bdb_set_sc_start_lsn(data->trans, data->s->tablename,
-                                  &(pCur->curLsn), &bdberr);
+        rc = bdb_set_sc_start_lsn(data->trans, data->s->tablename, lsn,
+                                  &bdberr);
         if (rc != 0) {
             if (bdberr == BDBERR_DEADLOCK)
                 rc = RC_INTERNAL_RETRY;
@@ -3019,11 +3651,11 @@ again:
             }
             data->nrecs--;
         } else {
-            sc_set_logical_redo_lwm(data->s->tablename, pCur->curLsn.file);
+            sc_set_logical_redo_lwm(data->s->tablename, lsn->file);
 #ifdef LOGICAL_LIVESC_DEBUG
             logmsg(LOGMSG_DEBUG, "[%s] %s:%d sets sc start lsn to [%u][%u]\n",
-                   data->s->tablename, __func__, __LINE__, pCur->curLsn.file,
-                   pCur->curLsn.offset);
+                   data->s->tablename, __func__, __LINE__, lsn->file,
+                   lsn->offset);
 #endif
         }
     }
@@ -3040,6 +3672,14 @@ done:
                 poll(0, 0, (rand() % 500 + 10));
                 goto again;
             }
+            if (rc == IX_DUP && data->redo_dup_retry) {
+                /* the key may belong to a row of another stripe that is to
+                 * give it up in a transaction before this one */
+                data->trans = NULL;
+                dupwait = 1;
+                sc_redo_wait_lower(data->redo_pool, data, lsn);
+                goto again;
+            }
         } else if (data->live)
             rc = trans_commit_seqnum(&data->iq, data->trans, &ss);
         else
@@ -3049,7 +3689,7 @@ done:
     reqlog_end_request(data->iq.reqlogger, 0, __func__, __LINE__);
 
     /* free memory used in this function */
-    clear_recs_list(&recs);
+    clear_recs_list(recs);
     clear_blob_hash(data->blob_hash);
     data->trans = NULL;
     if (rc && !data->s->sc_thd_failed)
@@ -3058,11 +3698,247 @@ done:
         logc->close(logc, 0);
     if (logdta.data)
         free(logdta.data);
+    return rc;
+}
+
+static int live_sc_redo_logical_log(struct convert_record_data *data,
+                                    bdb_llog_cursor *pCur)
+{
+    int rc = 0;
+    LISTC_T(bdb_osql_log_rec_t) recs; /* list of relevant undo records */
+    listc_init(&recs, offsetof(bdb_osql_log_rec_t, lnk));
+
+    /* nothing to do if none of the logical ops are relevant to the table */
+    if (live_sc_redo_collect(data, pCur, (listc_t *)&recs))
+        rc = live_sc_redo_apply(data, (listc_t *)&recs, &pCur->curLsn, 1);
+
+    bdb_osql_log_destroy(pCur->log);
+    pCur->log = NULL;
+    return rc;
+}
+
+static void *sc_redo_worker_thd(struct sc_redo_worker *w)
+{
+    struct sc_redo_pool *pool = w->pool;
+    struct convert_record_data *data = &w->data;
+    struct thr_handle *thr_self;
+    struct sc_redo_batch *b;
+    int rc = 0;
+
+    thread_started("logical redo worker");
+    thr_self = thrman_register(THRTYPE_SCHEMACHANGE);
+    backend_thread_event(thedb, COMDB2_THR_EVENT_START_RDWR);
+    data->iq.reqlogger = thrman_get_reqlogger(thr_self);
+
+    Pthread_mutex_lock(&pool->lk);
+    while (1) {
+        while ((b = listc_rtl(&w->q)) == NULL && !pool->exiting)
+            Pthread_cond_wait(&pool->cd, &pool->lk);
+        if (b == NULL)
+            break;
+        w->cur = b;
+        Pthread_mutex_unlock(&pool->lk);
+
+        /* once one fails the schema change is over; just drain the queue */
+        if (rc == 0)
+            rc = live_sc_redo_apply(data, (listc_t *)&b->recs, &b->lsn, 0);
+        else
+            clear_recs_list(&b->recs);
+        free(b);
+
+        Pthread_mutex_lock(&pool->lk);
+        w->cur = NULL;
+        pool->nqueued--;
+        Pthread_cond_broadcast(&pool->cd);
+    }
+    Pthread_mutex_unlock(&pool->lk);
+
+    backend_thread_event(thedb, COMDB2_THR_EVENT_DONE_RDWR);
+    return NULL;
+}
+
+/* Queue the records of the transaction at pCur that touch the table to the
+ * workers of their stripes */
+static int sc_redo_dispatch(struct convert_record_data *data,
+                            bdb_llog_cursor *pCur)
+{
+    struct sc_redo_pool *pool = data->redo_pool;
+    bdb_osql_log_rec_t *rec;
+    int rc = 0;
+    LISTC_T(bdb_osql_log_rec_t) recs;
+    listc_init(&recs, offsetof(bdb_osql_log_rec_t, lnk));
+
+    if (live_sc_redo_collect(data, pCur, (listc_t *)&recs) == 0)
+        goto done;
+
+    while ((rec = listc_rtl(&recs)) != NULL) {
+        int i = (rec->dtastripe > 0 ? rec->dtastripe : 0) % pool->nworkers;
+        struct sc_redo_batch *b = pool->next[i];
+        if (b == NULL) {
+            if ((b = malloc(sizeof(*b))) == NULL) {
+                logmsg(LOGMSG_ERROR, "%s:%d failed to malloc redo batch\n",
+                       __func__, __LINE__);
+                listc_atl(&recs, rec);
+                rc = -1;
+                break;
+            }
+            b->lsn = pCur->curLsn;
+            listc_init(&b->recs, offsetof(bdb_osql_log_rec_t, lnk));
+            pool->next[i] = b;
+        }
+        listc_abl(&b->recs, rec);
+    }
+
+    Pthread_mutex_lock(&pool->lk);
+    for (int i = 0; i < pool->nworkers; i++) {
+        struct sc_redo_batch *b = pool->next[i];
+        if (b == NULL)
+            continue;
+        pool->next[i] = NULL;
+        if (rc) {
+            clear_recs_list(&b->recs);
+            free(b);
+            continue;
+        }
+        listc_abl(&pool->workers[i].q, b);
+        pool->nqueued++;
+    }
+    Pthread_cond_broadcast(&pool->cd);
+    Pthread_mutex_unlock(&pool->lk);
+    if (rc == 0)
+        data->nrecs++;
+
+done:
+    clear_recs_list(&recs);
     bdb_osql_log_destroy(pCur->log);
     pCur->log = NULL;
     return rc;
 }
 
+/* Wait for the workers to redo everything handed out if there is a window's
+ * worth of it, or if force is set.  Returns 1 if they are caught up. */
+static int sc_redo_pool_sync(struct sc_redo_pool *pool, int force)
+{
+    int caught_up;
+
+    Pthread_mutex_lock(&pool->lk);
+    if (force || pool->nqueued >= SC_REDO_WINDOW) {
+        while (pool->nqueued > 0)
+            Pthread_cond_wait(&pool->cd, &pool->lk);
+    }
+    caught_up = pool->nqueued == 0;
+    Pthread_mutex_unlock(&pool->lk);
+    return caught_up;
+}
+
+static int sc_redo_pool_queued(struct sc_redo_pool *pool)
+{
+    int n;
+
+    Pthread_mutex_lock(&pool->lk);
+    n = pool->nqueued;
+    Pthread_mutex_unlock(&pool->lk);
+    return n;
+}
+
+/* the buffers logical redo needs, so it need not malloc and free them for
+ * every record */
+static int live_sc_redo_alloc(struct convert_record_data *data)
+{
+    data->rec = allocate_db_record(data->to->tablename, ".NEW..ONDISK");
+    data->blob_hash = hash_init_o(offsetof(struct blob_recs, genid),
+                                  sizeof(unsigned long long));
+    data->dta_buf = malloc(data->from->lrl + ODH_SIZE);
+    data->old_dta_buf = malloc(data->from->lrl + ODH_SIZE);
+    data->unpack_dta_buf = malloc(data->from->lrl + ODH_SIZE);
+    data->unpack_old_dta_buf = malloc(data->from->lrl + ODH_SIZE);
+    data->blb_buf = NULL;
+    data->old_blb_buf = NULL;
+    bzero(data->freeblb, sizeof(data->freeblb));
+    bzero(data->wrblb, sizeof(data->wrblb));
+    bzero(&data->blb, sizeof(data->blb));
+    bzero(&data->blbcopy, sizeof(data->blbcopy));
+    if (!data->blob_hash) {
+        logmsg(LOGMSG_ERROR, "%s: failed to init blob hash\n", __func__);
+        return -1;
+    }
+    if (!data->dta_buf || !data->old_dta_buf || !data->unpack_dta_buf ||
+        !data->unpack_old_dta_buf) {
+        logmsg(LOGMSG_ERROR, "%s: failed to malloc buffer\n", __func__);
+        return -1;
+    }
+    return 0;
+}
+
+static void sc_redo_pool_stop(struct sc_redo_pool *pool)
+{
+    Pthread_mutex_lock(&pool->lk);
+    pool->exiting = 1;
+    Pthread_cond_broadcast(&pool->cd);
+    Pthread_mutex_unlock(&pool->lk);
+
+    for (int i = 0; i < pool->nworkers; i++) {
+        struct sc_redo_worker *w = &pool->workers[i];
+        if (w->data.tid)
+            pthread_join(w->data.tid, NULL);
+        convert_record_data_cleanup(&w->data);
+        if (w->data.blob_hash)
+            hash_free(w->data.blob_hash);
+    }
+    Pthread_cond_destroy(&pool->cd);
+    Pthread_mutex_destroy(&pool->lk);
+    free(pool->next);
+    free(pool->workers);
+    free(pool);
+}
+
+/* start nworkers threads to redo the log for base */
+static struct sc_redo_pool *sc_redo_pool_start(struct convert_record_data *base,
+                                               int nworkers)
+{
+    struct sc_redo_pool *pool;
+    pthread_attr_t attr;
+
+    if ((pool = calloc(1, sizeof(*pool))) == NULL)
+        return NULL;
+    Pthread_mutex_init(&pool->lk, NULL);
+    Pthread_cond_init(&pool->cd, NULL);
+    pool->workers = calloc(nworkers, sizeof(*pool->workers));
+    pool->next = calloc(nworkers, sizeof(*pool->next));
+    if (!pool->workers || !pool->next) {
+        sc_redo_pool_stop(pool);
+        return NULL;
+    }
+
+    Pthread_attr_init(&attr);
+    Pthread_attr_setstacksize(&attr, DEFAULT_THD_STACKSZ);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    for (int i = 0; i < nworkers; i++) {
+        struct sc_redo_worker *w = &pool->workers[i];
+        w->data = *base;
+        w->data.tid = 0;
+        w->data.nrecs = 0;
+        w->data.redo_pool = pool;
+        w->pool = pool;
+        listc_init(&w->q, offsetof(struct sc_redo_batch, lnk));
+        pool->nworkers++;
+        if (live_sc_redo_alloc(&w->data) ||
+            pthread_create(&w->data.tid, &attr,
+                           (void *(*)(void *))sc_redo_worker_thd, w)) {
+            sc_errf(base->s, "[%s] starting logical redo worker %d failed\n",
+                    base->s->tablename, i);
+            w->data.tid = 0;
+            Pthread_attr_destroy(&attr);
+            sc_redo_pool_stop(pool);
+            return NULL;
+        }
+    }
+
+    Pthread_attr_destroy(&attr);
+    return pool;
+}
+
 static struct sc_redo_lsn *get_next_redo_lsn(bdb_state_type *bdb_state,
                                              struct schema_change_type *s)
 {
@@ -3096,6 +3972,20 @@ static struct sc_redo_lsn *get_next_redo_lsn(bdb_state_type *bdb_state,
     return redo;
 }
 
+/* drop queued commits up to lsn, a serial log scan is going to cover them */
+static void sc_redo_discard(bdb_state_type *bdb_state, DB_LSN *lsn)
+{
+    struct sc_redo_lsn *redo;
+
+    Pthread_mutex_lock(&bdb_state->sc_redo_lk);
+    while ((redo = LISTC_TOP(&bdb_state->sc_redo_list)) != NULL &&
+           log_compare(&redo->lsn, lsn) <= 0) {
+        listc_rfl(&bdb_state->sc_redo_list, redo);
+        free(redo);
+    }
+    Pthread_mutex_unlock(&bdb_state->sc_redo_lk);
+}
+
 static int sc_redo_size(bdb_state_type *bdb_state)
 {
     int sz = 0;
@@ -3123,6 +4013,7 @@ void *live_sc_logical_redo_thd(struct convert_record_data *data)
     DB_LSN eofLsn = {0};
     int serial = 0;
     DB_LSN serialLsn = {0}; /* scan serial upto this LSN for resume */
+    int sorted_wait = 0;
 
     bzero(pCur, sizeof(bdb_llog_cursor));
 
@@ -3158,37 +4049,25 @@ void *live_sc_logical_redo_thd(struct convert_record_data *data)
 
     /* init all buffer needed by this thread to do logical redo so we don't need
      * to malloc & free every single time */
-    data->rec = allocate_db_record(data->to->tablename, ".NEW..ONDISK");
     data->iq.usedb = data->to;
-    data->blob_hash = hash_init_o(offsetof(struct blob_recs, genid),
-                                  sizeof(unsigned long long));
-    if (!data->blob_hash) {
-        logmsg(LOGMSG_ERROR, "%s: failed to init blob hash\n", __func__);
-        s->iq->sc_should_abort = 1;
-        goto cleanup;
-    }
-    data->dta_buf = malloc(data->from->lrl + ODH_SIZE);
-    data->old_dta_buf = malloc(data->from->lrl + ODH_SIZE);
-    data->unpack_dta_buf = malloc(data->from->lrl + ODH_SIZE);
-    data->unpack_old_dta_buf = malloc(data->from->lrl + ODH_SIZE);
-    data->blb_buf = NULL;
-    data->old_blb_buf = NULL;
-    if (!data->dta_buf || !data->old_dta_buf || !data->unpack_dta_buf ||
-        !data->unpack_old_dta_buf) {
-        logmsg(LOGMSG_ERROR, "%s: failed to malloc buffer\n", __func__);
+    if (live_sc_redo_alloc(data)) {
         s->iq->sc_should_abort = 1;
         goto cleanup;
     }
-    bzero(data->freeblb, sizeof(data->freeblb));
-    bzero(data->wrblb, sizeof(data->wrblb));
-    bzero(&data->blb, sizeof(data->blb));
-    bzero(&data->blbcopy, sizeof(data->blbcopy));
     data->tagmap = get_tag_mapping(
         data->from->schema /*tbl .ONDISK tag schema*/,
         data->to->schema /*tbl .NEW..ONDISK schema */); // free tagmap only once
 
     s->hitLastCnt = 0;
 
+    if (gbl_sc_logical_redo_threads > 1 && gbl_dtastripe > 1) {
+        int nworkers = MIN(gbl_sc_logical_redo_threads, gbl_dtastripe);
+        data->redo_pool = sc_redo_pool_start(data, nworkers);
+        if (data->redo_pool)
+            sc_printf(s, "[%s] logical redo on %d threads\n", s->tablename,
+                      nworkers);
+    }
+
     data->to->sc_from = data->from;
 
     /* s->curLsn is used to synchronize between logical redo thread and convert
@@ -3213,6 +4092,26 @@ void *live_sc_logical_redo_thd(struct convert_record_data *data)
             goto cleanup;
         }
 
+        if (s->sorted_ix_build) {
+            /* the convert threads are still building the new indexes from
+             * sorted keys; leave the redo list alone until they are done */
+            sorted_wait = 1;
+            poll(NULL, 0, 100);
+            continue;
+        }
+        if (sorted_wait) {
+            /* replay everything since the start lsn serially; commits queued
+             * up to this point are covered by the scan */
+            sorted_wait = 0;
+            serial = 1;
+            bdb_get_commit_genid(thedb->bdb_env, &serialLsn);
+            sc_redo_discard(bdb_state, &serialLsn);
+            sc_printf(s, "[%s] logical redo run serial from [%u][%u] to "
+                         "[%u][%u] after sorted index build\n",
+                      s->tablename, pCur->curLsn.file, pCur->curLsn.offset,
+                      serialLsn.file, serialLsn.offset);
+        }
+
         /* scan serially */
         if (!serial) {
             /* Get the next lsn to redo, wait upto 10s unless all convert
@@ -3225,6 +4124,8 @@ void *live_sc_logical_redo_thd(struct convert_record_data *data)
                    eofLsn.file, eofLsn.offset);
 #endif
             /* Table has not been touch since last eofLsn */
+            if (data->redo_pool)
+                sc_redo_pool_sync(data->redo_pool, 1);
             Pthread_mutex_lock(&s->livesc_mtx);
             curLsn = eofLsn;
             Pthread_mutex_unlock(&s->livesc_mtx);
@@ -3289,7 +4190,10 @@ void *live_sc_logical_redo_thd(struct convert_record_data *data)
             }
             if (pCur->log && !pCur->hitLast) {
                 /* redo this transaction against the new btrees */
-                rc = live_sc_redo_logical_log(data, pCur);
+                if (data->redo_pool)
+                    rc = sc_redo_dispatch(data, pCur);
+                else
+                    rc = live_sc_redo_logical_log(data, pCur);
                 if (rc) {
                     sc_errf(s, "[%s] logical redo failed at [%u:%u]\n",
                             s->tablename, pCur->curLsn.file,
@@ -3300,17 +4204,23 @@ void *live_sc_logical_redo_thd(struct convert_record_data *data)
                 assert(pCur->log == NULL /* i.e. consumed */);
                 s->hitLastCnt = 0;
             }
-            Pthread_mutex_lock(&s->livesc_mtx);
-            curLsn = pCur->curLsn;
-            Pthread_mutex_unlock(&s->livesc_mtx);
-
-            eofLsn = curLsn;
+            /* with workers, everything up to here has to be redone first */
+            if (!data->redo_pool ||
+                sc_redo_pool_sync(data->redo_pool,
+                                  pCur->hitLast ||
+                                      (!serial && sc_redo_size(bdb_state) == 0))) {
+                Pthread_mutex_lock(&s->livesc_mtx);
+                curLsn = pCur->curLsn;
+                Pthread_mutex_unlock(&s->livesc_mtx);
+
+                eofLsn = curLsn;
+            }
 
             if (!serial) {
                 free(redo);
                 redo = NULL;
             }
-            else if (log_compare(&curLsn, &serialLsn) > 0) {
+            else if (log_compare(&pCur->curLsn, &serialLsn) > 0) {
                 sc_printf(s, "[%s] logical redo exits serial mode\n",
                           s->tablename);
                 serial = 0;
@@ -3339,6 +4249,10 @@ void *live_sc_logical_redo_thd(struct convert_record_data *data)
                 sc_set_logical_redo_lwm(s->tablename, curLsn.file);
             }
         }
+        int redo_size = sc_redo_size(bdb_state);
+        int redo_queued =
+            data->redo_pool ? sc_redo_pool_queued(data->redo_pool) : 0;
+        data->from->sc_redo_lag = redo_size + redo_queued;
         int now = comdb2_time_epoch();
         int copy_sc_report_freq = gbl_sc_report_freq;
         if (copy_sc_report_freq > 0 &&
@@ -3348,10 +4262,11 @@ void *live_sc_logical_redo_thd(struct convert_record_data *data)
             data->prev_nrecs = data->nrecs;
             sc_printf(s,
                       "[%s] logical redo at LSN [%u][%u] transactions done "
-                      "+%lld (%lld txn/s). Redo List Size: %d\n",
+                      "+%lld (%lld txn/s). Redo List Size: %d, queued to "
+                      "workers: %d\n",
                       data->from->tablename, curLsn.file, curLsn.offset,
-                      diff_nrecs, diff_nrecs / copy_sc_report_freq,
-                      sc_redo_size(bdb_state));
+                      diff_nrecs, diff_nrecs / copy_sc_report_freq, redo_size,
+                      redo_queued);
         }
         if (pCur->hitLast) {
             if (s->got_tablelock) {
@@ -3369,6 +4284,11 @@ void *live_sc_logical_redo_thd(struct convert_record_data *data)
     }
 
 cleanup:
+    if (data->redo_pool) {
+        sc_redo_pool_stop(data->redo_pool);
+        data->redo_pool = NULL;
+    }
+    data->from->sc_redo_lag = 0;
     convert_record_data_cleanup(data);
 
     if (data->isThread)
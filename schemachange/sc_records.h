@@ -21,6 +21,11 @@
 #include <bdb/bdb_int.h>
 
 extern int gbl_logical_live_sc;
+extern int gbl_sc_sorted_index_build;
+extern int gbl_sc_latency_budget_ms;
+extern int gbl_sc_logical_redo_threads;
+
+struct sc_redo_pool;
 
 struct common_members {
     int64_t ndeadlocks;
@@ -30,6 +35,12 @@ struct common_members {
     uint32_t maxthreads;         // maximum number of SC threads allowed
     int is_decrease_thrds;       // is feature on to backoff and decrease threads
     uint32_t total_lasttime;     // last time we computed total stats
+    uint32_t batch;              // records between waits for replication
+    uint32_t pace_usec;          // throttle delay after each record
+    int64_t rep_wait_us;         // time spent waiting for replication
+    int64_t rep_waits;           // number of waits for replication
+    int64_t last_rep_wait_us;    // rep_wait_us at the last throttle check
+    int64_t last_rep_waits;      // rep_waits at the last throttle check
 };
 
 /* for passing state data to schema change threads/functions */
@@ -77,6 +88,12 @@ struct convert_record_data {
                            converting the records */
     unsigned long long cv_genid; /* the genid of the record that we get
                                     constraint violation on */
+    struct temp_table *sorted_keys[MAXINDEX]; /* sorted index build: new keys
+                                                 extracted from this stripe */
+    struct sc_redo_pool *redo_pool; /* logical redo: the workers replaying the
+                                       log, NULL if it is replayed serially */
+    int redo_dup_retry; /* a duplicate redoing this transaction may be a row
+                           another redo worker got to first */
 };
 
 int convert_all_records(struct dbtable *from, struct dbtable *to,
@@ -1165,7 +1165,8 @@ error:
     return xerr->errval;
 }
 
-int sc_timepart_drop_table(const char *tableName, struct errstat *xerr)
+int sc_timepart_drop_table(const char *tableName, int schema_locked,
+                           struct errstat *xerr)
 {
     struct schema_change_type sc = {0};
     struct dbtable *db;
@@ -1236,7 +1237,10 @@ int sc_timepart_drop_table(const char *tableName, struct errstat *xerr)
         sc.newcsc2 = schemabuf;
     }
 
-    rc = do_schema_change_locked(&sc);
+    if (schema_locked)
+        rc = do_schema_change_locked(&sc);
+    else
+        rc = do_schema_change_unlocked(&sc);
     if (rc) {
         xerr->errval = SC_VIEW_ERR_SC;
         snprintf(xerr->errstr, sizeof(xerr->errstr), "failed to drop table");
@@ -1249,6 +1253,84 @@ error:
     return xerr->errval;
 }
 
+int sc_timepart_compact_table(const char *tableName, int compress,
+                              struct errstat *xerr)
+{
+    struct schema_change_type sc = {0};
+    struct dbtable *db;
+    char *schemabuf = NULL;
+    int rc;
+
+    init_schemachange_type(&sc);
+    /* prepare sc */
+    sc.onstack = 1;
+    sc.type = DBTYPE_TAGGED_TABLE;
+
+    snprintf(sc.tablename, sizeof(sc.tablename), "%s", tableName);
+    sc.tablename[sizeof(sc.tablename) - 1] = '\0';
+
+    sc.scanmode = gbl_default_sc_scanmode;
+
+    sc.live = 1;
+
+    /* this is a rebuild, into new compressed and densely packed btrees */
+    sc.alteronly = 1;
+    sc.force_rebuild = 1;
+    sc.same_schema = 1;
+    sc.compress = compress;
+    sc.compress_blobs = compress;
+    sc.finalize = 1;
+
+    /* a shard sc without an id is resumed as part of an alter of the whole
+       partition; with one, a new master drops it instead */
+    comdb2uuid(sc.uuid);
+
+    db = get_dbtable_by_name(tableName);
+    if (db == NULL) {
+        xerr->errval = SC_VIEW_ERR_BUG;
+        snprintf(xerr->errstr, sizeof(xerr->errstr), "table '%s' not found\n",
+                 tableName);
+        goto error;
+    }
+    if (get_csc2_file(db->tablename, -1 /*highest csc2_version*/, &schemabuf,
+                      NULL /*csc2len*/)) {
+        xerr->errval = SC_VIEW_ERR_BUG;
+        snprintf(xerr->errstr, sizeof(xerr->errstr),
+                 "could not get schema for table '%s'\n", tableName);
+        goto error;
+    }
+    sc.newcsc2 = schemabuf;
+
+    /* still one schema change at a time */
+    if (thedb->master != gbl_mynode) {
+        xerr->errval = SC_VIEW_ERR_EXIST;
+        snprintf(xerr->errstr, sizeof(xerr->errstr),
+                 "I am not master; master is %s\n", thedb->master);
+        goto error;
+    }
+
+    if (sc_set_running(sc.tablename, 1, bdb_get_a_genid(thedb->bdb_env),
+                       gbl_mynode, time(NULL)) != 0) {
+        xerr->errval = SC_VIEW_ERR_EXIST;
+        snprintf(xerr->errstr, sizeof(xerr->errstr), "schema change running");
+        goto error;
+    }
+
+    /* do the dance */
+    sc.nothrevent = 1;
+    rc = do_schema_change_unlocked(&sc);
+    if (rc) {
+        xerr->errval = SC_VIEW_ERR_SC;
+        snprintf(xerr->errstr, sizeof(xerr->errstr), "failed to rebuild table");
+    } else
+        xerr->errval = SC_VIEW_NOERR;
+    return xerr->errval;
+
+error:
+    free_schema_change_type(&sc);
+    return xerr->errval;
+}
+
 /* shortcut for running table upgrade in a schemachange shell */
 int start_table_upgrade(struct dbenv *dbenv, const char *tbl,
                         unsigned long long genid, int full, int partial,
@@ -197,6 +197,8 @@ struct schema_change_type {
     int already_finalized;
 
     int logical_livesc;
+    int sorted_ix_build; /* set while the convert threads extract and load
+                            index keys in sorted order (logical redo waits) */
     int *sc_convert_done;
     unsigned int hitLastCnt;
     int got_tablelock;
@@ -13,6 +13,14 @@
  *  - client sends a request message
  *  - server responds with a donate message and the same typestr
  *      - server may or may not include an fd with its donate message
+ *
+ * SSL sessions (protocol version zero only) are kept for other processes of
+ * the same user to resume.  The typestr names the session; dbnum is the
+ * length of the DER encoded session that follows the message:
+ *  - to keep one, the client sends a put message, timeout being the seconds
+ *    it is good for, and the session; the server does not respond
+ *  - to get one, the client sends a get message; the server responds with
+ *    a put message, dbnum 0 if it has none, and the session
  */
 
 #ifndef INCLUDED_SOCKPOOL_P_H
@@ -20,7 +28,16 @@
 
 #define SOCKPOOL_SOCKET_NAME "/tmp/sockpool.socket"
 
-enum { SOCKPOOL_DONATE = 0, SOCKPOOL_REQUEST = 1, SOCKPOOL_FORGET_PORT = 2 };
+enum {
+    SOCKPOOL_DONATE = 0,
+    SOCKPOOL_REQUEST = 1,
+    SOCKPOOL_FORGET_PORT = 2,
+    SOCKPOOL_SSL_SESSION_PUT = 3,
+    SOCKPOOL_SSL_SESSION_GET = 4
+};
+
+/* the longest SSL session sockpool takes */
+#define SOCKPOOL_SSL_SESSION_MAX 16384
 
 /* Clients should send one of these to the sql proxy after making a new
  * unix domain socket connection.  If the sqlproxy doesn't like what it gets
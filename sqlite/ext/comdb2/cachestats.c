@@ -0,0 +1,234 @@
+/*
+   Copyright 2024 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/* comdb2_cache_stats: how much of each table's data, blobs and indexes is
+ * in the buffer pool, and how hot it is.  The counters are the buffer
+ * pool's own per-file ones, which are bumped without a lock as pages are
+ * fetched, so nothing extra is paid on the read path.  The rates are over
+ * the interval since the counters were last sampled, which happens at most
+ * once a second however often the table is read. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "comdb2.h"
+#include "comdb2systblInt.h"
+#include "ezsystables.h"
+#include "cdb2api.h"
+#include <bdb/bdb_api.h>
+#include <plhash.h>
+#include <locks_wrap.h>
+
+#define CACHE_STATS_MIN_INTERVAL_MS 1000
+
+typedef struct systable_cache_stats {
+    char *tablename;
+    char *kind;
+    char *indexname;
+    int64_t pages;
+    int64_t bytes;
+    int64_t hits;
+    int64_t misses;
+    double hit_ratio;
+    int64_t pages_in;
+    int64_t pages_out;
+    int64_t evictions;
+    double pages_in_per_sec;
+    double pages_out_per_sec;
+    double evictions_per_sec;
+} systable_cache_stats_t;
+
+/* last sample of a file, to take the rates from */
+struct cache_sample {
+    char *key;
+    int64_t when_ms;
+    int64_t pages_in;
+    int64_t pages_out;
+    int64_t evictions;
+    double pages_in_per_sec;
+    double pages_out_per_sec;
+    double evictions_per_sec;
+    unsigned seen;
+};
+
+static pthread_mutex_t samples_lk = PTHREAD_MUTEX_INITIALIZER;
+static hash_t *samples;
+static unsigned samples_gen;
+
+static void set_rates(const char *key, int64_t now, systable_cache_stats_t *r)
+{
+    struct cache_sample *s;
+    double secs;
+
+    if (samples == NULL)
+        samples = hash_init_strptr(offsetof(struct cache_sample, key));
+    if ((s = hash_find(samples, &key)) == NULL) {
+        if ((s = calloc(1, sizeof(*s))) == NULL ||
+            (s->key = strdup(key)) == NULL) {
+            free(s);
+            return;
+        }
+        s->when_ms = now;
+        s->pages_in = r->pages_in;
+        s->pages_out = r->pages_out;
+        s->evictions = r->evictions;
+        hash_add(samples, s);
+    } else if (now - s->when_ms >= CACHE_STATS_MIN_INTERVAL_MS) {
+        secs = (now - s->when_ms) / 1000.0;
+        /* a file reopened by a schema change starts its counters over */
+        if (r->pages_in >= s->pages_in && r->pages_out >= s->pages_out &&
+            r->evictions >= s->evictions) {
+            s->pages_in_per_sec = (r->pages_in - s->pages_in) / secs;
+            s->pages_out_per_sec = (r->pages_out - s->pages_out) / secs;
+            s->evictions_per_sec = (r->evictions - s->evictions) / secs;
+        }
+        s->when_ms = now;
+        s->pages_in = r->pages_in;
+        s->pages_out = r->pages_out;
+        s->evictions = r->evictions;
+    }
+    s->seen = samples_gen;
+    r->pages_in_per_sec = s->pages_in_per_sec;
+    r->pages_out_per_sec = s->pages_out_per_sec;
+    r->evictions_per_sec = s->evictions_per_sec;
+}
+
+static int drop_unseen(void *obj, void *arg)
+{
+    struct cache_sample *s = obj;
+
+    if (s->seen != samples_gen) {
+        hash_del(samples, s);
+        free(s->key);
+        free(s);
+    }
+    return 0;
+}
+
+static void add_row(systable_cache_stats_t *r, struct dbtable *db,
+                    const char *kind, const char *indexname, int ixnum,
+                    int64_t now)
+{
+    struct bdb_cache_stats st;
+    char key[MAXTABLELEN + 16];
+
+    bdb_get_file_cache_stats(db->handle, ixnum, &st);
+    r->tablename = strdup(db->tablename);
+    r->kind = strdup(kind);
+    r->indexname = indexname ? strdup(indexname) : NULL;
+    r->pages = st.pages;
+    r->bytes = st.bytes;
+    r->hits = st.hits;
+    r->misses = st.misses;
+    r->hit_ratio =
+        st.hits + st.misses ? (double)st.hits / (st.hits + st.misses) : 0;
+    r->pages_in = st.pages_in;
+    r->pages_out = st.pages_out;
+    r->evictions = st.evictions;
+
+    snprintf(key, sizeof(key), "%s:%d", db->tablename, ixnum);
+    set_rates(key, now, r);
+}
+
+static int get_cache_stats(void **data, int *records)
+{
+    systable_cache_stats_t *rows;
+    struct dbtable *db;
+    int64_t now = comdb2_time_epochms();
+    int n = 0, max = 0;
+
+    *data = NULL;
+    *records = 0;
+
+    rdlock_schema_lk();
+    for (int i = 0; i < thedb->num_dbs; i++) {
+        db = thedb->dbs[i];
+        max += 1 + (db->numblobs > 0) + db->nix;
+    }
+    if ((rows = calloc(max ? max : 1, sizeof(*rows))) == NULL) {
+        unlock_schema_lk();
+        return SQLITE_NOMEM;
+    }
+
+    Pthread_mutex_lock(&samples_lk);
+    samples_gen++;
+    for (int i = 0; i < thedb->num_dbs; i++) {
+        db = thedb->dbs[i];
+        if (db->handle == NULL)
+            continue;
+        add_row(&rows[n++], db, "data", NULL, BDB_CACHE_STATS_DATA, now);
+        if (db->numblobs > 0)
+            add_row(&rows[n++], db, "blobs", NULL, BDB_CACHE_STATS_BLOBS,
+                    now);
+        for (int ix = 0; ix < db->nix; ix++)
+            add_row(&rows[n++], db, "index", db->ixschema[ix]->csctag, ix,
+                    now);
+    }
+    hash_for(samples, drop_unseen, NULL);
+    Pthread_mutex_unlock(&samples_lk);
+    unlock_schema_lk();
+
+    *data = rows;
+    *records = n;
+    return 0;
+}
+
+static void free_cache_stats(void *p, int n)
+{
+    systable_cache_stats_t *rows = p;
+    for (int i = 0; i < n; i++) {
+        free(rows[i].tablename);
+        free(rows[i].kind);
+        free(rows[i].indexname);
+    }
+    free(p);
+}
+
+sqlite3_module systblCacheStatsModule = {
+    .access_flag = CDB2_ALLOW_USER,
+};
+
+int systblCacheStatsInit(sqlite3 *db)
+{
+    return create_system_table(
+        db, "comdb2_cache_stats", &systblCacheStatsModule, get_cache_stats,
+        free_cache_stats, sizeof(systable_cache_stats_t),
+        CDB2_CSTRING, "tablename", -1,
+        offsetof(systable_cache_stats_t, tablename),
+        CDB2_CSTRING, "kind", -1, offsetof(systable_cache_stats_t, kind),
+        CDB2_CSTRING, "indexname", -1,
+        offsetof(systable_cache_stats_t, indexname),
+        CDB2_INTEGER, "pages", -1, offsetof(systable_cache_stats_t, pages),
+        CDB2_INTEGER, "bytes", -1, offsetof(systable_cache_stats_t, bytes),
+        CDB2_INTEGER, "hits", -1, offsetof(systable_cache_stats_t, hits),
+        CDB2_INTEGER, "misses", -1, offsetof(systable_cache_stats_t, misses),
+        CDB2_REAL, "hit_ratio", -1,
+        offsetof(systable_cache_stats_t, hit_ratio),
+        CDB2_INTEGER, "pages_in", -1,
+        offsetof(systable_cache_stats_t, pages_in),
+        CDB2_INTEGER, "pages_out", -1,
+        offsetof(systable_cache_stats_t, pages_out),
+        CDB2_INTEGER, "evictions", -1,
+        offsetof(systable_cache_stats_t, evictions),
+        CDB2_REAL, "pages_in_per_sec", -1,
+        offsetof(systable_cache_stats_t, pages_in_per_sec),
+        CDB2_REAL, "pages_out_per_sec", -1,
+        offsetof(systable_cache_stats_t, pages_out_per_sec),
+        CDB2_REAL, "evictions_per_sec", -1,
+        offsetof(systable_cache_stats_t, evictions_per_sec),
+        SYSTABLE_END_OF_FIELDS);
+}
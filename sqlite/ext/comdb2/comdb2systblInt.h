@@ -43,10 +43,13 @@ int systblTypeSamplesInit(sqlite3 *db);
 int systblRepNetQueueStatInit(sqlite3 *db);
 int systblSqlpoolQueueInit(sqlite3 *db);
 int systblActivelocksInit(sqlite3 *db);
+int systblLockHeatInit(sqlite3 *db);
+int systblReplicationStagesInit(sqlite3 *db);
 int systblNetUserfuncsInit(sqlite3 *db);
 int systblClusterInit(sqlite3 *db);
 int systblActiveOsqlsInit(sqlite3 *db);
 int systblBlkseqInit(sqlite3 *db);
+int systblCacheStatsInit(sqlite3 *db);
 int systblTimepartInit(sqlite3*db);
 int systblCronInit(sqlite3*db);
 int systblFingerprintsInit(sqlite3 *);
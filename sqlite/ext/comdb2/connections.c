@@ -60,7 +60,7 @@ void free_connections(void *data, int num_points) {
     for (int i = 0; i < num_points; i++) {
         if (info[i].sql)
             free(info[i].sql);
-        /* state is static, don't free */
+        /* state and compression are static, don't free */
     }
     free(data);
 }
@@ -79,5 +79,10 @@ int systblConnectionsInit(sqlite3 *db) {
             CDB2_CSTRING, "state", -1, offsetof(struct connection_info, state),
             CDB2_INTERVALDS, "time_in_state", -1, offsetof(struct connection_info, time_in_state),
             CDB2_CSTRING, "sql", -1, offsetof(struct connection_info, sql),
+            CDB2_CSTRING, "compression", -1, offsetof(struct connection_info, compression),
+            CDB2_INTEGER, "raw_bytes_out", -1, offsetof(struct connection_info, raw_bytes_out),
+            CDB2_INTEGER, "wire_bytes_out", -1, offsetof(struct connection_info, wire_bytes_out),
+            CDB2_INTEGER, "raw_bytes_in", -1, offsetof(struct connection_info, raw_bytes_in),
+            CDB2_INTEGER, "wire_bytes_in", -1, offsetof(struct connection_info, wire_bytes_in),
             SYSTABLE_END_OF_FIELDS);
 }
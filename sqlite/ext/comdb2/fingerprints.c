@@ -22,6 +22,7 @@
 #include "sql.h"
 #include "plhash.h"
 #include "tohex.h"
+#include "hdrhist.h"
 
 struct fingerprint_track_systbl {
     char *fingerprint;
@@ -32,6 +33,12 @@ struct fingerprint_track_systbl {
     int64_t rows;     /* Cumulative number of rows selected */
     char *zNormSql;   /* The normalized SQL query */
     size_t nNormSql;  /* Length of normalized SQL query */
+    int64_t p50;      /* Execution time percentiles, in microseconds */
+    int64_t p90;
+    int64_t p99;
+    int64_t p999;
+    int64_t max;
+    int64_t rejected; /* Turned away by admission control */
 
     char fp[FINGERPRINTSZ*2+1];
 };
@@ -76,6 +83,15 @@ static int fingerprints_callback(void **data, int *npoints)
                     pFp[copied].time = pEntry->time;
                     pFp[copied].prepTime = pEntry->prepTime;
                     pFp[copied].rows = pEntry->rows;
+                    pFp[copied].rejected = pEntry->rejected;
+                    if (pEntry->latency != NULL) {
+                        struct hdrhist *h = pEntry->latency;
+                        pFp[copied].p50 = hdrhist_percentile(h, 50);
+                        pFp[copied].p90 = hdrhist_percentile(h, 90);
+                        pFp[copied].p99 = hdrhist_percentile(h, 99);
+                        pFp[copied].p999 = hdrhist_percentile(h, 99.9);
+                        pFp[copied].max = h->max;
+                    }
                     if (pEntry->zNormSql != NULL) {
                         pFp[copied].zNormSql = strdup(pEntry->zNormSql);
                         pFp[copied].nNormSql = strlen(pEntry->zNormSql);
@@ -124,5 +140,17 @@ int systblFingerprintsInit(sqlite3 *db)
         offsetof(struct fingerprint_track_systbl, rows),
         CDB2_CSTRING, "normalized_sql", -1,
         offsetof(struct fingerprint_track_systbl, zNormSql),
+        CDB2_INTEGER, "p50_us", -1,
+        offsetof(struct fingerprint_track_systbl, p50),
+        CDB2_INTEGER, "p90_us", -1,
+        offsetof(struct fingerprint_track_systbl, p90),
+        CDB2_INTEGER, "p99_us", -1,
+        offsetof(struct fingerprint_track_systbl, p99),
+        CDB2_INTEGER, "p999_us", -1,
+        offsetof(struct fingerprint_track_systbl, p999),
+        CDB2_INTEGER, "max_us", -1,
+        offsetof(struct fingerprint_track_systbl, max),
+        CDB2_INTEGER, "rejected", -1,
+        offsetof(struct fingerprint_track_systbl, rejected),
         SYSTABLE_END_OF_FIELDS);
 }
@@ -0,0 +1,94 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "comdb2.h"
+#include "bdb_int.h"
+#include "comdb2systblInt.h"
+#include "ezsystables.h"
+#include "cdb2api.h"
+
+typedef struct systable_lockheat {
+    char *object;
+    char *type;
+    int64_t page;
+    int page_isnull;
+    int64_t waits;
+    int64_t total_wait_us;
+    int64_t max_wait_us;
+    char *stacks;
+} systable_lockheat_t;
+
+typedef struct getlockheat {
+    int count;
+    int alloc;
+    systable_lockheat_t *records;
+} getlockheat_t;
+
+static int collect(void *args, const char *object, int64_t page,
+                   const char *rectype, u_int64_t nwaits, u_int64_t total_us,
+                   u_int64_t max_us, const char *stacks)
+{
+    getlockheat_t *a = (getlockheat_t *)args;
+    systable_lockheat_t *l;
+    if (a->count >= a->alloc) {
+        int alloc = a->alloc ? a->alloc * 2 : 16;
+        l = realloc(a->records, alloc * sizeof(systable_lockheat_t));
+        if (l == NULL)
+            return -1;
+        a->records = l;
+        a->alloc = alloc;
+    }
+    l = &a->records[a->count++];
+    l->object = object ? strdup(object) : NULL;
+    l->type = strdup(rectype);
+    if (page < 0) {
+        l->page_isnull = 1;
+        l->page = 0;
+    } else {
+        l->page = page;
+        l->page_isnull = 0;
+    }
+    l->waits = nwaits;
+    l->total_wait_us = total_us;
+    l->max_wait_us = max_us;
+    l->stacks = stacks ? strdup(stacks) : NULL;
+    return 0;
+}
+
+static int get_lockheat(void **data, int *records)
+{
+    bdb_state_type *bdb_state = thedb->bdb_env;
+    getlockheat_t a = {0};
+    bdb_state->dbenv->collect_lock_heat(bdb_state->dbenv, collect, &a);
+    *data = a.records;
+    *records = a.count;
+    return 0;
+}
+
+static void free_lockheat(void *p, int n)
+{
+    systable_lockheat_t *l = p;
+    for (int i = 0; i < n; i++) {
+        free(l[i].object);
+        free(l[i].type);
+        free(l[i].stacks);
+    }
+    free(p);
+}
+
+sqlite3_module systblLockHeatModule = {
+    .access_flag = CDB2_ALLOW_USER,
+};
+
+int systblLockHeatInit(sqlite3 *db) {
+    return create_system_table(db, "comdb2_lock_heat", &systblLockHeatModule,
+            get_lockheat, free_lockheat, sizeof(systable_lockheat_t),
+            CDB2_CSTRING, "object", -1, offsetof(systable_lockheat_t, object),
+            CDB2_CSTRING, "locktype", -1, offsetof(systable_lockheat_t, type),
+            CDB2_INTEGER, "page", offsetof(systable_lockheat_t, page_isnull), offsetof(systable_lockheat_t, page),
+            CDB2_INTEGER, "waits", -1, offsetof(systable_lockheat_t, waits),
+            CDB2_INTEGER, "total_wait_us", -1, offsetof(systable_lockheat_t, total_wait_us),
+            CDB2_INTEGER, "max_wait_us", -1, offsetof(systable_lockheat_t, max_wait_us),
+            CDB2_CSTRING, "stacks", -1, offsetof(systable_lockheat_t, stacks),
+            SYSTABLE_END_OF_FIELDS);
+}
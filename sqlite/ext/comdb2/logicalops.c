@@ -40,14 +40,25 @@
 /* Column numbers */
 #define LOGICALOPS_COLUMN_START        0
 #define LOGICALOPS_COLUMN_STOP         1
-#define LOGICALOPS_COLUMN_COMMITLSN    2
-#define LOGICALOPS_COLUMN_OPNUM        3
-#define LOGICALOPS_COLUMN_OPERATION    4
-#define LOGICALOPS_COLUMN_TABLE        5
-#define LOGICALOPS_COLUMN_OLDGENID     6
-#define LOGICALOPS_COLUMN_OLDRECORD    7
-#define LOGICALOPS_COLUMN_GENID        8
-#define LOGICALOPS_COLUMN_RECORD       9
+#define LOGICALOPS_COLUMN_FLAGS        2
+#define LOGICALOPS_COLUMN_COMMITLSN    3
+#define LOGICALOPS_COLUMN_OPNUM        4
+#define LOGICALOPS_COLUMN_OPERATION    5
+#define LOGICALOPS_COLUMN_TABLE        6
+#define LOGICALOPS_COLUMN_OLDGENID     7
+#define LOGICALOPS_COLUMN_OLDRECORD    8
+#define LOGICALOPS_COLUMN_GENID        9
+#define LOGICALOPS_COLUMN_RECORD       10
+
+/* Flags for the hidden flags column.  A subscriber that wants a change
+ * stream selects with BLOCK (and usually DURABLE), remembers the last
+ * commitlsn it consumed, and resumes with minlsn = that lsn and AFTER set.
+ * Everything is decoded from the log after commit; nothing is written. */
+enum {
+    LOGICALOPS_FLAGS_BLOCK   = 0x1, /* wait at the end of the log */
+    LOGICALOPS_FLAGS_DURABLE = 0x2, /* only return durable commits */
+    LOGICALOPS_FLAGS_AFTER   = 0x4, /* skip the commit at minlsn */
+};
 
 /* Dynamically reallocating string type */
 typedef struct dynstr {
@@ -83,6 +94,9 @@ struct logicalops_cursor {
   char genid[32];
   int reclen;
   int oldreclen;
+  int flags;
+  int blocked;               /* gave up waiting: end of the stream */
+  char *tblfilter;           /* only this table's operations */
 };
 
 static int logicalopsConnect(
@@ -95,7 +109,7 @@ static int logicalopsConnect(
   sqlite3_vtab *pNew;
   int rc;
   rc = sqlite3_declare_vtab(db,
-     "CREATE TABLE x(minlsn hidden,maxlsn hidden,commitlsn,opnum,operation,tablename,oldgenid,oldrecord,genid,record)");
+     "CREATE TABLE x(minlsn hidden,maxlsn hidden,flags hidden,commitlsn,opnum,operation,tablename,oldgenid,oldrecord,genid,record)");
   if( rc==SQLITE_OK ){
     pNew = *ppVtab = sqlite3_malloc( sizeof(*pNew) );
     if( pNew==0 ) return SQLITE_NOMEM;
@@ -145,6 +159,8 @@ static int logicalopsClose(sqlite3_vtab_cursor *cur){
       strbuf_free(pCur->oldjsonrec);
   if (pCur->table)
       free(pCur->table);
+  if (pCur->tblfilter)
+      sqlite3_free(pCur->tblfilter);
   sqlite3_free(pCur);
   return SQLITE_OK;
 }
@@ -476,6 +492,14 @@ static void reset_json_cursors(logicalops_cursor *pCur)
         strbuf_clear(pCur->oldjsonrec);
 }
 
+/* Returned by the produce functions for an operation on a filtered table */
+#define LOGICALOPS_SKIPPED (-2)
+
+static int table_filtered(logicalops_cursor *pCur)
+{
+    return pCur->tblfilter && strcasecmp(pCur->table, pCur->tblfilter) != 0;
+}
+
 static void reset_record_state(logicalops_cursor *pCur)
 {
     if (pCur->table) {
@@ -533,6 +557,11 @@ static int produce_update_data_record(logicalops_cursor *pCur, DB_LOGC *logc,
         pCur->table = strdup((char *)(upd_dta->table.data));
     }
 
+    if (table_filtered(pCur)) {
+        rc = LOGICALOPS_SKIPPED;
+        goto done;
+    }
+
     assert(dtalen <= PACKED_MEMORY_SIZE);
     ASSERT_PARAMETER(dtalen);
     genid_format(pCur, genid, pCur->genid, sizeof(pCur->genid));
@@ -707,6 +736,11 @@ static int produce_add_data_record(logicalops_cursor *pCur, DB_LOGC *logc,
         dtafile = add_dta->dtafile;
         pCur->table = strdup((char *)(add_dta->table.data));
     }
+
+    if (table_filtered(pCur)) {
+        rc = LOGICALOPS_SKIPPED;
+        goto done;
+    }
     genid_format(pCur, genid, pCur->genid, sizeof(pCur->genid));
     if (dtafile == 0) { 
         snprintf(pCur->opstring, sizeof(pCur->opstring), "insert-record");
@@ -812,6 +846,11 @@ static int produce_delete_data_record(logicalops_cursor *pCur, DB_LOGC *logc,
         pCur->table = strdup((char *)(del_dta->table.data));
     }
 
+    if (table_filtered(pCur)) {
+        rc = LOGICALOPS_SKIPPED;
+        goto done;
+    }
+
     assert(dtalen <= PACKED_MEMORY_SIZE);
     genid_format(pCur, genid, pCur->oldgenid, sizeof(pCur->oldgenid));
 
@@ -917,6 +956,9 @@ static int unpack_logical_record(logicalops_cursor *pCur)
                 if ((rc = produce_delete_data_record(pCur, logc, rec, &logdta)) == 0) {
                     pCur->llog_cur.subop++;
                     produced_row=1;
+                } else if (rc == LOGICALOPS_SKIPPED) {
+                    pCur->llog_cur.subop++;
+                    rc = 0;
                 }
                 break;
 
@@ -931,6 +973,9 @@ static int unpack_logical_record(logicalops_cursor *pCur)
                 if ((rc = produce_add_data_record(pCur, logc, rec, &logdta)) == 0) {
                     pCur->llog_cur.subop++;
                     produced_row=1;
+                } else if (rc == LOGICALOPS_SKIPPED) {
+                    pCur->llog_cur.subop++;
+                    rc = 0;
                 }
                 break;
                 /*
@@ -944,6 +989,9 @@ static int unpack_logical_record(logicalops_cursor *pCur)
                 if ((rc = produce_update_data_record(pCur, logc, rec, &logdta)) == 0) {
                     pCur->llog_cur.subop++;
                     produced_row=1;
+                } else if (rc == LOGICALOPS_SKIPPED) {
+                    pCur->llog_cur.subop++;
+                    rc = 0;
                 }
                 break;
                 /*
@@ -972,6 +1020,58 @@ static int unpack_logical_record(logicalops_cursor *pCur)
     return (produced_row && rc != 0) ? -1 : !produced_row;
 }
 
+extern pthread_mutex_t gbl_logput_lk;
+extern pthread_cond_t gbl_logput_cond;
+extern pthread_mutex_t gbl_durable_lsn_lk;
+extern pthread_cond_t gbl_durable_lsn_cond;
+
+/* Wait a little for the log to move, giving up our locks if they are
+ * wanted */
+static void logicalops_wait(pthread_mutex_t *lk, pthread_cond_t *cond)
+{
+    struct sql_thread *thd = NULL;
+    struct timespec ts;
+    int sleepms = 100;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += (200 * 1000000);
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    Pthread_mutex_lock(lk);
+    pthread_cond_timedwait(cond, lk, &ts);
+    Pthread_mutex_unlock(lk);
+
+    while (bdb_the_lock_desired()) {
+        if (thd == NULL)
+            thd = pthread_getspecific(query_info_key);
+        recover_deadlock(thedb->bdb_env, thd, NULL, sleepms);
+        sleepms *= 2;
+        if (sleepms > 10000)
+            sleepms = 10000;
+    }
+}
+
+/* Returns 1 once the current commit is durable, 0 if we should stop */
+static int logicalops_durable(logicalops_cursor *pCur)
+{
+    bdb_state_type *bdb_state = thedb->bdb_env;
+    DB_LSN durable_lsn = {0};
+    uint32_t durable_gen = 0;
+
+    while (1) {
+        bdb_state->dbenv->get_durable_lsn(bdb_state->dbenv, &durable_lsn,
+                                          &durable_gen);
+        if (log_compare(&durable_lsn, &pCur->llog_cur.curLsn) >= 0)
+            return 1;
+        if ((pCur->flags & LOGICALOPS_FLAGS_BLOCK) == 0 ||
+            !bdb_amimaster(bdb_state) || bdb_the_lock_desired())
+            return 0;
+        logicalops_wait(&gbl_durable_lsn_lk, &gbl_durable_lsn_cond);
+    }
+}
+
 /*
 ** Advance a logicalops cursor to the next log entry
 */
@@ -979,13 +1079,37 @@ static int logicalopsNext(sqlite3_vtab_cursor *cur){
   logicalops_cursor *pCur = (logicalops_cursor*)cur;
   int rc;
 
-  if (pCur->llog_cur.hitLast)
+  if (pCur->blocked)
+      return SQLITE_OK;
+  if (pCur->llog_cur.hitLast && (pCur->flags & LOGICALOPS_FLAGS_BLOCK) == 0)
       return SQLITE_OK;
 
 again:
-    if (pCur->llog_cur.log == NULL &&
-        (bdb_llog_cursor_next(&pCur->llog_cur) != 0))
-        return SQLITE_INTERNAL;
+    if (pCur->llog_cur.log == NULL) {
+        if (bdb_llog_cursor_next(&pCur->llog_cur) != 0)
+            return SQLITE_INTERNAL;
+
+        /* Tail the log: wait for the next commit */
+        if (pCur->llog_cur.hitLast &&
+            (pCur->flags & LOGICALOPS_FLAGS_BLOCK)) {
+            logicalops_wait(&gbl_logput_lk, &gbl_logput_cond);
+            goto again;
+        }
+
+        /* Resuming: the subscriber has already seen this commit */
+        if (pCur->llog_cur.log && (pCur->flags & LOGICALOPS_FLAGS_AFTER) &&
+            log_compare(&pCur->llog_cur.curLsn, &pCur->llog_cur.minLsn) == 0) {
+            bdb_osql_log_destroy(pCur->llog_cur.log);
+            pCur->llog_cur.log = NULL;
+            goto again;
+        }
+
+        if (pCur->llog_cur.log && (pCur->flags & LOGICALOPS_FLAGS_DURABLE) &&
+            !logicalops_durable(pCur)) {
+            pCur->blocked = 1;
+            return SQLITE_OK;
+        }
+    }
 
     if (pCur->llog_cur.log && !pCur->llog_cur.hitLast) {
         rc = unpack_logical_record(pCur);
@@ -1101,6 +1225,10 @@ static int logicalopsColumn(
         sqlite3_result_text(ctx, pCur->maxLsnStr, -1, NULL);
         break;
 
+    case LOGICALOPS_COLUMN_FLAGS:
+        sqlite3_result_int64(ctx, pCur->flags);
+        break;
+
     case LOGICALOPS_COLUMN_COMMITLSN:
         if (!pCur->curLsnStr) {
             pCur->curLsnStr = sqlite3_malloc(32);
@@ -1160,7 +1288,7 @@ static int logicalopsEof(sqlite3_vtab_cursor *cur){
       if ((rc=logicalopsNext(cur)) != SQLITE_OK)
           return rc;
   }
-  if (pCur->llog_cur.hitLast)
+  if (pCur->blocked || pCur->llog_cur.hitLast)
       return 1;
   if (pCur->llog_cur.maxLsn.file > 0 &&
       log_compare(&pCur->llog_cur.curLsn, &pCur->llog_cur.maxLsn) > 0)
@@ -1190,6 +1318,20 @@ static int logicalopsFilter(
           return SQLITE_CONV_ERROR;
       }
   }
+  pCur->flags = 0;
+  if( idxNum & 4 ){
+      pCur->flags = sqlite3_value_int64(argv[i++]);
+  }
+  if (pCur->tblfilter) {
+      sqlite3_free(pCur->tblfilter);
+      pCur->tblfilter = NULL;
+  }
+  if( idxNum & 8 ){
+      const unsigned char *table = sqlite3_value_text(argv[i++]);
+      if (table && (pCur->tblfilter = sqlite3_mprintf("%s", table)) == NULL)
+          return SQLITE_NOMEM;
+  }
+  pCur->blocked = 0;
   pCur->iRowid = 1;
   return SQLITE_OK;
 }
@@ -1202,6 +1344,8 @@ static int logicalopsBestIndex(
   int idxNum = 0;
   int startIdx = -1;
   int stopIdx = -1;
+  int flagsIdx = -1;
+  int tableIdx = -1;
   int nArg = 0;
 
   const struct sqlite3_index_constraint *pConstraint;
@@ -1218,6 +1362,14 @@ static int logicalopsBestIndex(
         stopIdx = i;
         idxNum |= 2;
         break;
+      case LOGICALOPS_COLUMN_FLAGS:
+        flagsIdx = i;
+        idxNum |= 4;
+        break;
+      case LOGICALOPS_COLUMN_TABLE:
+        tableIdx = i;
+        idxNum |= 8;
+        break;
     }
   }
   if( startIdx>=0 ){
@@ -1228,6 +1380,14 @@ static int logicalopsBestIndex(
     pIdxInfo->aConstraintUsage[stopIdx].argvIndex = ++nArg;
     pIdxInfo->aConstraintUsage[stopIdx].omit = 1;
   }
+  if( flagsIdx>=0 ){
+    pIdxInfo->aConstraintUsage[flagsIdx].argvIndex = ++nArg;
+    pIdxInfo->aConstraintUsage[flagsIdx].omit = 1;
+  }
+  if( tableIdx>=0 ){
+    /* Checked again by sqlite: the filter matches case-insensitively */
+    pIdxInfo->aConstraintUsage[tableIdx].argvIndex = ++nArg;
+  }
   if( (idxNum & 3)==3 ){
     /* Both start= and stop= boundaries are available.  This is the 
     ** the preferred case */
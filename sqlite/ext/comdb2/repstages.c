@@ -0,0 +1,109 @@
+/*
+   Copyright 2024 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/* comdb2_replication_stages: latency of each stage of a commit's
+ * replication that this node times, per peer. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "comdb2.h"
+#include "comdb2systblInt.h"
+#include "ezsystables.h"
+#include "cdb2api.h"
+#include <bdb/bdb_api.h>
+#include "hdrhist.h"
+
+typedef struct systable_rep_stage {
+    char *host;
+    char *stage;
+    int64_t samples;
+    int64_t avg_us;
+    int64_t p50_us;
+    int64_t p90_us;
+    int64_t p99_us;
+    int64_t max_us;
+} systable_rep_stage_t;
+
+typedef struct get_rep_stages {
+    int count;
+    int alloc;
+    systable_rep_stage_t *records;
+} get_rep_stages_t;
+
+static int collect(void *arg, const char *host, int stage,
+                   const struct hdrhist *h)
+{
+    get_rep_stages_t *a = arg;
+    systable_rep_stage_t *r;
+    if (a->count >= a->alloc) {
+        int alloc = a->alloc ? a->alloc * 2 : 16;
+        r = realloc(a->records, alloc * sizeof(systable_rep_stage_t));
+        if (r == NULL)
+            return -1;
+        a->records = r;
+        a->alloc = alloc;
+    }
+    r = &a->records[a->count++];
+    r->host = strdup(host);
+    r->stage = strdup(bdb_rep_stage_name(stage));
+    r->samples = h->count;
+    r->avg_us = hdrhist_mean(h);
+    r->p50_us = hdrhist_percentile(h, 50);
+    r->p90_us = hdrhist_percentile(h, 90);
+    r->p99_us = hdrhist_percentile(h, 99);
+    r->max_us = h->max;
+    return 0;
+}
+
+static int get_rep_stages(void **data, int *records)
+{
+    get_rep_stages_t a = {0};
+    bdb_rep_stages_collect(collect, &a);
+    *data = a.records;
+    *records = a.count;
+    return 0;
+}
+
+static void free_rep_stages(void *p, int n)
+{
+    systable_rep_stage_t *r = p;
+    for (int i = 0; i < n; i++) {
+        free(r[i].host);
+        free(r[i].stage);
+    }
+    free(p);
+}
+
+sqlite3_module systblReplicationStagesModule = {
+    .access_flag = CDB2_ALLOW_USER,
+};
+
+int systblReplicationStagesInit(sqlite3 *db)
+{
+    return create_system_table(
+        db, "comdb2_replication_stages", &systblReplicationStagesModule,
+        get_rep_stages, free_rep_stages, sizeof(systable_rep_stage_t),
+        CDB2_CSTRING, "host", -1, offsetof(systable_rep_stage_t, host),
+        CDB2_CSTRING, "stage", -1, offsetof(systable_rep_stage_t, stage),
+        CDB2_INTEGER, "samples", -1, offsetof(systable_rep_stage_t, samples),
+        CDB2_INTEGER, "avg_us", -1, offsetof(systable_rep_stage_t, avg_us),
+        CDB2_INTEGER, "p50_us", -1, offsetof(systable_rep_stage_t, p50_us),
+        CDB2_INTEGER, "p90_us", -1, offsetof(systable_rep_stage_t, p90_us),
+        CDB2_INTEGER, "p99_us", -1, offsetof(systable_rep_stage_t, p99_us),
+        CDB2_INTEGER, "max_us", -1, offsetof(systable_rep_stage_t, max_us),
+        SYSTABLE_END_OF_FIELDS);
+}
@@ -262,8 +262,12 @@ int comdb2SystblInit(
     rc = systblTypeSamplesInit(db);
   if (rc == SQLITE_OK)
     rc = systblRepNetQueueStatInit(db);
+  if (rc == SQLITE_OK)
+    rc = systblReplicationStagesInit(db);
   if (rc == SQLITE_OK)
     rc = systblActivelocksInit(db);
+  if (rc == SQLITE_OK)
+    rc = systblLockHeatInit(db);
   if (rc == SQLITE_OK)
     rc = systblSqlpoolQueueInit(db);
   if (rc == SQLITE_OK)
@@ -274,6 +278,8 @@ int comdb2SystblInit(
     rc = systblActiveOsqlsInit(db);
   if (rc == SQLITE_OK)
     rc = systblBlkseqInit(db);
+  if (rc == SQLITE_OK)
+    rc = systblCacheStatsInit(db);
   if (rc == SQLITE_OK)
     rc = systblFingerprintsInit(db);
   if (rc == SQLITE_OK)
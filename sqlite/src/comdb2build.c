@@ -2561,6 +2561,8 @@ struct comdb2_key {
     char *table;
     /* Partial index expression */
     char *where;
+    /* Columns copied by datacopy(col, ...), comma separated */
+    char *datacopy_cols;
     /* Key flags */
     uint8_t flags;
     /* List of columns */
@@ -3142,7 +3144,10 @@ static char *format_csc2(struct comdb2_ddl_context *ctx)
         }
 
         if ((key->flags & KEY_DATACOPY) != 0) {
-            strbuf_append(csc2, "datacopy ");
+            if (key->datacopy_cols)
+                strbuf_appendf(csc2, "datacopy(%s) ", key->datacopy_cols);
+            else
+                strbuf_append(csc2, "datacopy ");
         }
 
         if ((key->flags & KEY_UNIQNULLS) != 0) {
@@ -4079,6 +4084,17 @@ static int retrieve_schema(Parse *pParse, struct comdb2_ddl_context *ctx)
         if (schema->ix[i]->flags & SCHEMA_DATACOPY) {
             key->flags |= KEY_DATACOPY;
         }
+        if (schema->ix[i]->partial_datacopy) {
+            struct schema *pd = schema->ix[i]->partial_datacopy;
+            struct strbuf *cols = strbuf_new();
+            for (int j = 0; j < pd->nmembers; j++)
+                strbuf_appendf(cols, "%s%s", j ? ", " : "",
+                               pd->member[j].name);
+            key->datacopy_cols = comdb2_strdup(ctx->mem, strbuf_buf(cols));
+            strbuf_free(cols);
+            if (key->datacopy_cols == 0)
+                goto oom;
+        }
         if (schema->ix[i]->flags & SCHEMA_UNIQNULLS) {
             key->flags |= KEY_UNIQNULLS;
         }
@@ -5784,6 +5800,26 @@ static int check_dependent_cons(struct comdb2_ddl_context *ctx,
     return 0;
 }
 
+/*
+  Check whether the column is copied by the key's datacopy(col, ...).
+*/
+static int datacopy_has_column(struct comdb2_key *key, const char *column)
+{
+    size_t len = strlen(column);
+    const char *p = key->datacopy_cols;
+
+    while (p) {
+        while (isspace(*p))
+            p++;
+        if (strncasecmp(p, column, len) == 0 &&
+            (p[len] == ',' || p[len] == 0))
+            return 1;
+        if ((p = strchr(p, ',')) != 0)
+            p++;
+    }
+    return 0;
+}
+
 /*
  * Check whether the specified column has any existing associated
  * key(s) and drop if asked.
@@ -5815,6 +5851,16 @@ static int check_dependent_keys(struct comdb2_ddl_context *ctx,
                 }
             }
         }
+
+        if (!(key->flags & KEY_DELETED) &&
+            datacopy_has_column(key, column)) {
+            if (drop) {
+                check_dependent_cons(ctx, key, 1);
+                key->flags |= KEY_DELETED;
+            } else {
+                return 1;
+            }
+        }
     }
     return 0;
 }
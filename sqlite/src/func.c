@@ -1932,9 +1932,69 @@ struct SumCtx {
 #if defined(SQLITE_BUILDING_FOR_COMDB2)
   u8 decs;          /* True if summing decimals */
   decQuad decSum;   /* decQuad aggregation */
+  u8 decPend;       /* True if decCoef holds values not yet in decSum */
+  int decExp;       /* Exponent of the values in decCoef */
+  i64 decCoef;      /* Sum of their coefficients */
 #endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
 };
 
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+/*
+** Decimal SUM() adds the values of a run that share an exponent as plain
+** integers and only goes through decQuadAdd() when the exponent changes,
+** the integer sum would overflow, or the aggregate is finalized.  Sums of
+** money columns are mostly such runs.  Zeros and non-finite values always
+** take the decQuadAdd() path, which knows their rules.
+*/
+static int decSumAddFast(SumCtx *p, const decQuad *v){
+  uint8_t bcd[DECQUAD_Pmax];
+  i64 c = 0;
+  int exp, i;
+
+  if( !decQuadIsFinite(v) || decQuadIsZero(v) ) return 0;
+  exp = decQuadGetExponent(v);
+  if( p->decPend && exp!=p->decExp ) return 0;
+  if( decQuadGetCoefficient(v, bcd) ) c = -1;
+  for(i=0; i<DECQUAD_Pmax-18; i++){
+    if( bcd[i] ) return 0;
+  }
+  {
+    i64 m = 0;
+    for(; i<DECQUAD_Pmax; i++) m = m*10 + bcd[i];
+    c = (c<0) ? -m : m;
+  }
+  if( p->decPend==0 ){
+    p->decCoef = 0;
+    p->decExp = exp;
+  }
+  if( sqlite3AddInt64(&p->decCoef, c) ) return 0;
+  p->decPend = 1;
+  return 1;
+}
+
+/* Add the pending integer sum into decSum; returns non-zero on overflow */
+static int decSumFlush(SumCtx *p){
+  uint8_t bcd[DECQUAD_Pmax];
+  u64 m;
+  decContext ctx;
+  decQuad pend, res;
+  int i;
+
+  if( p->decPend==0 ) return 0;
+  p->decPend = 0;
+  m = (p->decCoef<0) ? -(u64)p->decCoef : (u64)p->decCoef;
+  for(i=DECQUAD_Pmax-1; i>=0; i--){
+    bcd[i] = m % 10;
+    m /= 10;
+  }
+  decQuadFromBCD(&pend, p->decExp, bcd, p->decCoef<0 ? DECFLOAT_Sign : 0);
+  dec_ctx_init( &ctx, DEC_INIT_DECQUAD, gbl_decimal_rounding);
+  decQuadAdd( &res, &p->decSum, &pend, &ctx);
+  p->decSum = res;
+  return dfp_conv_check_status(&ctx, "quad", "add(quads)");
+}
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
+
 /*
 ** Routines used to compute the sum, average, and total.
 **
@@ -1977,6 +2037,12 @@ static void sumStep(sqlite3_context *context, int argc, sqlite3_value **argv){
 
           fprintf(stderr, "%s  = %s\n", aaa, bbb);
         }
+      }else if( decSumAddFast(p, &v.u.dec) ){
+        /* added to the pending run */
+      }else if( p->decPend && decSumFlush(p) ){
+        sqlite3_result_error(context, "decimal overflow", -1);
+      }else if( decSumAddFast(p, &v.u.dec) ){
+        /* started a new run */
       }else{
         decContext ctx;
         decQuad    res;
@@ -2046,6 +2112,10 @@ static void sumFinalize(sqlite3_context *context){
 #if defined(SQLITE_BUILDING_FOR_COMDB2)
     }else if( p->decs){
        intv_t res;
+       if( decSumFlush(p) ){
+         sqlite3_result_error(context, "decimal overflow", -1);
+         return;
+       }
        res.type = INTV_DECIMAL_TYPE;
        res.sign = 0;
        res.u.dec = p->decSum;
@@ -2067,6 +2137,10 @@ static void avgFinalize(sqlite3_context *context){
       decQuad res;
       intv_t  tv;
 
+      if( decSumFlush(p) ){
+        sqlite3_result_error(context, "decimal overflow", -1);
+        return;
+      }
       dec_ctx_init( &ctx, DEC_INIT_DECQUAD, gbl_decimal_rounding);
       decQuadFromInt32( &denom, p->cnt);
       decQuadDivide( &res, &p->decSum, &denom, &ctx);
@@ -2091,6 +2165,10 @@ static void totalFinalize(sqlite3_context *context){
 #if defined(SQLITE_BUILDING_FOR_COMDB2)
   if( p && p->decs ){
     intv_t res;
+    if( decSumFlush(p) ){
+      sqlite3_result_error(context, "decimal overflow", -1);
+      return;
+    }
     res.type = INTV_DECIMAL_TYPE;
     res.sign = 0;
     res.u.dec = p->decSum;
@@ -421,9 +421,20 @@ static int lookupName(
        pExpr->iColumn = -2;
        pExpr->affinity = SQLITE_AFF_TEXT;
     }else if( cnt==0 && cntTab==1 && pMatch && sqlite3IsComdb2RowTimestamp(pMatch->pTab, zCol) ){
+       /* time partition views carry the shard row timestamps in a hidden
+       ** column; anything else reads it from the cursor genid */
        cnt = 1;
        pExpr->iColumn = -3;
        pExpr->affinity = SQLITE_AFF_TEXT;
+       if( pMatch->pSelect ){
+         for(j=0, pCol=pMatch->pTab->aCol; j<pMatch->pTab->nCol; j++, pCol++){
+           if( sqlite3StrICmp(pCol->zName, "__hidden__rowtimestamp")==0 ){
+             pExpr->iColumn = (i16)j;
+             pExpr->affinity = pCol->affinity;
+             break;
+           }
+         }
+       }
     }
 
     /* Check if a partial index or an expression index contains blob fields. */
@@ -14,6 +14,10 @@
 */
 #include "sqliteInt.h"
 
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+void comdb2_timepart_prune(Parse*, Select*);
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
+
 /*
 ** Trace output macros
 */
@@ -5887,6 +5891,7 @@ int sqlite3Select(
 #endif
 
 #if defined(SQLITE_BUILDING_FOR_COMDB2)
+  comdb2_timepart_prune(pParse, p);
   ast_t *ast = ast_init(pParse, __func__);
   if( ast ) ast_push(ast, AST_TYPE_SELECT, v, p);
 #endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
@@ -6234,6 +6239,20 @@ int sqlite3Select(
       }
     }
 
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+    /* If each row from a remote cursor is a row of the result, the remote
+    ** database need not send more than LIMIT+OFFSET of them. */
+    if( p->iLimit && sSort.pOrderBy==0 && !sDistinct.isTnct
+     && pTabList->nSrc==1 && sqlite3WhereRemoteHintAddr(pWInfo)
+#ifndef SQLITE_OMIT_WINDOWFUNC
+     && pWin==0
+#endif
+    ){
+      sqlite3VdbeChangeP2(v, sqlite3WhereRemoteHintAddr(pWInfo),
+                          p->iOffset ? p->iOffset+1 : p->iLimit);
+    }
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
+
     /* If sorting index that was created by a prior OP_OpenEphemeral 
     ** instruction ended up not being needed, then change the OP_OpenEphemeral
     ** into an OP_Noop.
@@ -4214,6 +4214,9 @@ LogEst sqlite3WhereOutputRowCount(WhereInfo*);
 int sqlite3WhereIsDistinct(WhereInfo*);
 int sqlite3WhereIsOrdered(WhereInfo*);
 int sqlite3WhereOrderByLimitOptLabel(WhereInfo*);
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+int sqlite3WhereRemoteHintAddr(WhereInfo*);
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
 int sqlite3WhereIsSorted(WhereInfo*);
 int sqlite3WhereContinueLabel(WhereInfo*);
 int sqlite3WhereBreakLabel(WhereInfo*);
@@ -5013,6 +5016,8 @@ int sqlite3RecordCompareExprList(UnpackedRecord *rec, Mem *mems);
 int sqlite3ExprList2MemArray(ExprList *list, Mem *mems);
 Mem* sqlite3CloneResult(sqlite3_stmt *pStmt, Mem *cols, long long *pSize);
 void sqlite3CloneResultFree(sqlite3_stmt *pStmt, Mem **cols, long long *pSize);
+int sqlite3_value_dup_inplace(sqlite3_value *pNew, const sqlite3_value *pOrig);
+void sqlite3_value_free_inplace(sqlite3_value *v);
 #endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
 
 int sqlite3ExprVectorSize(Expr *pExpr);
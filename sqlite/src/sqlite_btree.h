@@ -182,9 +182,17 @@ int sqlite3BtreeNewDb(Btree *p);
 **     to prefetch content from remote machines - to provide those
 **     implementations with limits on what needs to be prefetched and thereby
 **     reduce network bandwidth.
+**
+** BTREE_HINT_LIMIT  (arguments: i64, Expr*)
+**
+**     The statement reads at most that many rows from the cursor, provided
+**     the cursor also honors the Expr* (the one given by the preceding
+**     BTREE_HINT_RANGE hint, or NULL if there was none).  A value of zero or
+**     less means no limit.
 */
 #define BTREE_HINT_FLAGS 1       /* Set flags indicating cursor usage */
 #define BTREE_HINT_RANGE 2       /* Range constraints on queries */
+#define BTREE_HINT_LIMIT 3       /* Most rows the statement will read */
 
 /*
 ** Values that may be OR'd together to form the second argument to the
@@ -31,6 +31,7 @@
 void set_cook_fields(BtCursor *pCur, int cols);
 void sqlite3SetConversionError(void);
 void *get_lastkey(BtCursor *pCur);
+int key_is_raw(BtCursor *pCur);
 void print_cooked_access(BtCursor *pCur, int col);
 void comdb2SetWriteFlag(int wrflag);
 int is_datacopy(BtCursor *pCur, int *fnum);
@@ -924,6 +925,38 @@ static Mem *out2Prerelease(Vdbe *p, VdbeOp *pOp){
 }
 
 
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+/*
+** Compute a hash on the P4 registers starting with r[P3] for the
+** OP_FilterAdd and OP_Filter opcodes.  Values that compare equal must
+** hash the same: an integer and a real hash by their integer part, and
+** all strings, blobs and NULLs hash alike since a collating sequence can
+** make different strings equal.  Return 0 if some register holds a
+** datetime, interval or decimal, which compare equal to values of other
+** types and cannot be hashed at all.
+*/
+static int filterHash(const Mem *aMem, const Op *pOp, u64 *pH){
+  int i, mx;
+  u64 h = 0;
+  assert( pOp->p4type==P4_INT32 );
+  for(i=pOp->p3, mx=i+pOp->p4.i; i<mx; i++){
+    const Mem *p = &aMem[i];
+    if( p->flags & (MEM_Datetime|MEM_Interval) ){
+      return 0;
+    }else if( p->flags & MEM_Int ){
+      h += p->u.i;
+    }else if( p->flags & MEM_Real ){
+      if( p->u.r>-9.2e18 && p->u.r<9.2e18 ) h += (i64)p->u.r;
+    }else if( p->flags & (MEM_Str|MEM_Blob) ){
+      h += 4093;
+    }
+    h *= 0x100000001b3ULL;
+  }
+  *pH = h;
+  return 1;
+}
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
+
 /*
 ** Execute as much of a VDBE program as we can.
 ** This is the core of sqlite3_step().  
@@ -1587,6 +1620,12 @@ case OP_SoftNull: {
 case OP_Blob: {                /* out2 */
   assert( pOp->p1 <= SQLITE_MAX_LENGTH );
   pOut = out2Prerelease(p, pOp);
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+  if( pOp->p4.z==0 ){
+    sqlite3VdbeMemSetZeroBlob(pOut, pOp->p1);
+    if( sqlite3VdbeMemExpandBlob(pOut) ) goto no_mem;
+  }else
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
   sqlite3VdbeMemSetStr(pOut, pOp->p4.z, pOp->p1, 0, 0);
   pOut->enc = encoding;
   UPDATE_MAX_BLOBSIZE(pOut);
@@ -3038,7 +3077,8 @@ case OP_Column: {
       datacopy = p2;
       if( is_datacopy(pCrsr, &datacopy) ){
         rc = get_datacopy(pCrsr, datacopy, pDest);
-      }else if(pC->nCookFields>=0 && p2>=pC->nCookFields){
+      }else if((pC->nCookFields>=0 && p2>=pC->nCookFields) ||
+               (key_is_raw(pCrsr) && p2<pCrsr->sc->nmembers)){
         zData = (u8 *)get_lastkey(pCrsr);
         rc = get_data(pCrsr, pCrsr->sc, (u8 *) zData, p2, pDest, 0, pCrsr->clnt->tzname);
       }else{
@@ -8232,6 +8272,61 @@ case OP_Function: {            /* group */
   break;
 }
 
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+/* Opcode: FilterAdd P1 * P3 P4 *
+** Synopsis: filter(P1) += key(P3@P4)
+**
+** Compute a hash on the P4 registers starting with r[P3] and
+** add that hash to the bloom filter contained in r[P1].  If the
+** registers cannot be hashed, r[P1] is set to NULL and the filter
+** is not used any more.
+*/
+case OP_FilterAdd: {
+  u64 h;
+
+  assert( pOp->p1>0 && pOp->p1<=(p->nMem+1 - p->nCursor) );
+  pIn1 = &aMem[pOp->p1];
+  if( (pIn1->flags & MEM_Blob)==0 ) break;
+  assert( pIn1->n>0 );
+  if( !filterHash(aMem, pOp, &h) ){
+    sqlite3VdbeMemSetNull(pIn1);
+    break;
+  }
+  h %= (u64)pIn1->n*8;
+  pIn1->z[h/8] |= 1<<(h&7);
+  break;
+}
+
+/* Opcode: Filter P1 P2 P3 P4 *
+** Synopsis: if key(P3@P4) not in filter(P1) goto P2
+**
+** Compute a hash on the key contained in the P4 registers starting
+** with r[P3].  Check to see if that hash is found in the
+** bloom filter hosted by register P1.  If it is not present then
+** maybe jump to P2.  Otherwise fall through.
+**
+** It is always safe to fall through: a false positive only costs the
+** seek that follows.  Jumping for a key that was added would lose rows.
+*/
+case OP_Filter: {          /* jump */
+  u64 h;
+
+  assert( pOp->p1>0 && pOp->p1<=(p->nMem+1 - p->nCursor) );
+  pIn1 = &aMem[pOp->p1];
+  if( (pIn1->flags & MEM_Blob)==0 ) break;
+  assert( pIn1->n>0 );
+  if( !filterHash(aMem, pOp, &h) ) break;
+  h %= (u64)pIn1->n*8;
+  if( (pIn1->z[h/8] & (1<<(h&7)))==0 ){
+    VdbeBranchTaken(1, 2);
+    goto jump_to_p2;
+  }else{
+    VdbeBranchTaken(0, 2);
+  }
+  break;
+}
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
+
 /* Opcode: Trace P1 P2 * P4 *
 **
 ** Write P4 on the statement trace output if statement tracing is
@@ -8331,25 +8426,47 @@ case OP_Init: {          /* jump */
 }
 
 #ifdef SQLITE_ENABLE_CURSOR_HINTS
-/* Opcode: CursorHint P1 * * P4 *
+/* Opcode: CursorHint P1 P2 * P4 *
 **
 ** Provide a hint to cursor P1 that it only needs to return rows that
 ** satisfy the Expr in P4.  TK_REGISTER terms in the P4 expression refer
 ** to values currently held in registers.  TK_COLUMN terms in the P4
 ** expression refer to columns in the b-tree to which cursor P1 is pointing.
+**
+** In comdb2, P4 may be empty, and if P2 is not zero register P2 holds
+** the most rows the statement will read from the cursor.
 */
 case OP_CursorHint: {
   VdbeCursor *pC;
 
   assert( pOp->p1>=0 && pOp->p1<p->nCursor );
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+  assert( pOp->p4type==P4_EXPR || pOp->p4type==P4_NOTUSED );
+#else /* defined(SQLITE_BUILDING_FOR_COMDB2) */
   assert( pOp->p4type==P4_EXPR );
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
   pC = p->apCsr[pOp->p1];
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+  if( pC && pC->eCurType==CURTYPE_BTREE ){
+#else /* defined(SQLITE_BUILDING_FOR_COMDB2) */
   if( pC ){
-#if !defined(SQLITE_BUILDING_FOR_COMDB2)
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+    if( pOp->p4type==P4_EXPR ){
+      sqlite3BtreeCursorHint(pC->uc.pCursor, BTREE_HINT_RANGE,
+                             pOp->p4.pExpr, aMem);
+    }
+    if( pOp->p2 ){
+      assert( pOp->p2>0 && pOp->p2<=(p->nMem+1 - p->nCursor) );
+      sqlite3BtreeCursorHint(pC->uc.pCursor, BTREE_HINT_LIMIT,
+                             aMem[pOp->p2].u.i,
+                             pOp->p4type==P4_EXPR ? pOp->p4.pExpr : 0);
+    }
+#else /* defined(SQLITE_BUILDING_FOR_COMDB2) */
     assert( pC->eCurType==CURTYPE_BTREE );
-#endif /* !defined(SQLITE_BUILDING_FOR_COMDB2) */
     sqlite3BtreeCursorHint(pC->uc.pCursor, BTREE_HINT_RANGE,
                            pOp->p4.pExpr, aMem);
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
   }
   break;
 }
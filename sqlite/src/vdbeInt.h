@@ -125,6 +125,7 @@ struct VdbeSorter {
   u8 iPrev;                       /* Previous thread used to flush PMA */
   u8 nTask;                       /* Size of aTask[] array */
   u8 typeMask;
+  i64 nGovMem;                    /* Bytes charged to the memory governor */
   SortSubtask aTask[1];           /* One or more subtasks */
 
   int nfind;
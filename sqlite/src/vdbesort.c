@@ -143,7 +143,17 @@
 #include <cheapstack.h>
 #include <sys/time.h>
 
+#include "mem_governor.h"
+
 int comdb2_tmpdir_space_low();
+
+/* Give back what the in-memory records were charged to the governor */
+static void vdbeSorterGovRelease(VdbeSorter *pSorter){
+  if( pSorter->nGovMem ){
+    memgov_charge(MEMGOV_SORTER, -pSorter->nGovMem);
+    pSorter->nGovMem = 0;
+  }
+}
 #endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
 
 /* 
@@ -1281,6 +1291,9 @@ void sqlite3VdbeSorterReset(sqlite3 *db, VdbeSorter *pSorter){
   pSorter->bUsePMA = 0;
   pSorter->iMemory = 0;
   pSorter->mxKeysize = 0;
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+  vdbeSorterGovRelease(pSorter);
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
   sqlite3DbFree(db, pSorter->pUnpacked);
   pSorter->pUnpacked = 0;
 }
@@ -1424,6 +1437,334 @@ static SorterCompare vdbeSorterGetCompare(VdbeSorter *p){
   return vdbeSorterCompare;
 }
 
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+/*
+** Normalized-prefix sort.
+**
+** Large in-memory lists are sorted by a 64-bit key built from the first
+** field of each record such that comparing keys as unsigned integers
+** never contradicts vdbeSorterCompare(): the top two bits hold the
+** storage class (NULL < numeric < text < blob) and the rest hold an
+** order-preserving truncation of the value.  Keys are radix sorted and
+** only runs of equal keys are compared with the full record comparator.
+** The radix passes never look at the records, so they can be spread
+** over threads; runs of ties are resolved on the calling thread.
+*/
+extern int gbl_sqlite_sorter_prefix_min;
+extern int gbl_sqlite_sorter_threads;
+
+typedef struct SorterPrefix SorterPrefix;
+struct SorterPrefix {
+  u64 iKey;                       /* Normalized prefix of the first field */
+  SorterRecord *pRec;             /* Record it was taken from */
+};
+
+#define SORTER_PREFIX_NULL 0
+#define SORTER_PREFIX_NUM  1
+#define SORTER_PREFIX_TEXT 2
+#define SORTER_PREFIX_BLOB 3
+
+/* The first pass splits keys on their top SORTER_PREFIX_MSD bits */
+#define SORTER_PREFIX_MSD 10
+
+/* Buckets smaller than this are insertion sorted */
+#define SORTER_PREFIX_SMALL 32
+/* Fewer records than this per thread is not worth a thread */
+#define SORTER_PREFIX_MT_MIN 65536
+
+/*
+** Compute the prefix of record pRec.  Return 1 if the first field has a
+** serial type the prefix cannot order (comdb2 datetime or interval).
+*/
+static int vdbeSorterPrefix(const u8 *aRec, int nRec, u64 *piKey){
+  u32 szHdr, st;
+  int n;
+  const u8 *v;
+  u64 x = 0;
+
+  n = getVarint32(aRec, szHdr);
+  if( szHdr>(u32)nRec || n>=(int)szHdr ) return 1;
+  getVarint32(&aRec[n], st);
+  v = &aRec[szHdr];
+
+  if( st==0 ){
+    *piKey = (u64)SORTER_PREFIX_NULL<<62;
+    return 0;
+  }
+  if( st<=9 ){
+    double r;
+    if( st==7 ){
+      u64 b = ((u64)v[0]<<56) | ((u64)v[1]<<48) | ((u64)v[2]<<40) |
+              ((u64)v[3]<<32) | ((u64)v[4]<<24) | ((u64)v[5]<<16) |
+              ((u64)v[6]<<8) | (u64)v[7];
+      memcpy(&r, &b, sizeof(r));
+    }else if( st>=8 ){
+      r = st - 8;
+    }else{
+      static const u8 aLen[] = {0, 1, 2, 3, 4, 6, 8};
+      u64 u = (v[0] & 0x80) ? ~(u64)0 : 0;
+      int k;
+      for(k=0; k<aLen[st]; k++) u = (u<<8) | v[k];
+      r = (double)(i64)u;
+    }
+    if( r==0.0 ) r = 0.0;   /* -0.0 and 0.0 compare equal */
+    memcpy(&x, &r, sizeof(x));
+    x = (x & 0x8000000000000000ULL) ? ~x : (x | 0x8000000000000000ULL);
+    *piKey = ((u64)SORTER_PREFIX_NUM<<62) | (x>>2);
+    return 0;
+  }
+  if( st>=12 && st<SQLITE_MAX_U32-1 ){
+    u32 len = (st-12)/2;
+    int k;
+    if( szHdr+len>(u32)nRec ) return 1;
+    for(k=0; k<8; k++){
+      x = (x<<8) | (k<(int)len ? v[k] : 0);
+    }
+    *piKey = ((u64)((st&1) ? SORTER_PREFIX_TEXT : SORTER_PREFIX_BLOB)<<62) |
+             (x>>2);
+    return 0;
+  }
+  return 1;
+}
+
+static void vdbeSorterPrefixInsertion(SorterPrefix *a, int n){
+  int i, j;
+  for(i=1; i<n; i++){
+    SorterPrefix t = a[i];
+    for(j=i; j>0 && a[j-1].iKey>t.iKey; j--) a[j] = a[j-1];
+    a[j] = t;
+  }
+}
+
+/*
+** Stable LSD radix sort of a[0..n) on the low seven bytes, which covers
+** every bit below the first pass's split, using b[] as scratch.  Passes whose byte is the same in every key are skipped.  The
+** result is left in a[].
+*/
+static void vdbeSorterPrefixRadix(SorterPrefix *a, SorterPrefix *b, int n){
+  int aCnt[7][256];
+  int i, pass;
+  SorterPrefix *src = a, *dst = b;
+
+  if( n<SORTER_PREFIX_SMALL ){
+    vdbeSorterPrefixInsertion(a, n);
+    return;
+  }
+  memset(aCnt, 0, sizeof(aCnt));
+  for(i=0; i<n; i++){
+    u64 k = a[i].iKey;
+    for(pass=0; pass<7; pass++) aCnt[pass][(k>>(pass*8)) & 0xff]++;
+  }
+  for(pass=0; pass<7; pass++){
+    int *c = aCnt[pass];
+    int sum = 0, shift = pass*8;
+    SorterPrefix *t;
+    if( c[(a[0].iKey>>shift) & 0xff]==n ) continue;
+    for(i=0; i<256; i++){ int t2 = c[i]; c[i] = sum; sum += t2; }
+    for(i=0; i<n; i++) dst[c[(src[i].iKey>>shift) & 0xff]++] = src[i];
+    t = src; src = dst; dst = t;
+  }
+  if( src!=a ) memcpy(a, src, n*sizeof(SorterPrefix));
+}
+
+typedef struct SorterPrefixJob SorterPrefixJob;
+struct SorterPrefixJob {
+  SorterPrefix *a;                /* Keys, already split on the top byte */
+  SorterPrefix *b;                /* Scratch space the same size as a[] */
+  int *aStart;                    /* aStart[i] is where bucket i begins */
+  int iFirst, iLast;              /* Buckets [iFirst, iLast) are ours */
+#if SQLITE_MAX_WORKER_THREADS>0
+  SQLiteThread *pThread;
+#endif
+};
+
+static void *vdbeSorterPrefixJob(void *pCtx){
+  SorterPrefixJob *p = (SorterPrefixJob*)pCtx;
+  int i;
+  for(i=p->iFirst; i<p->iLast; i++){
+    int s = p->aStart[i], e = p->aStart[i+1];
+    if( e-s>1 ) vdbeSorterPrefixRadix(&p->a[s], &p->b[s], e-s);
+  }
+  return 0;
+}
+
+/*
+** Sort a[0..n) by key.  The first pass splits on the top bits; the
+** resulting buckets are then sorted independently, on up to nThread
+** threads.
+*/
+static void vdbeSorterPrefixSort(SorterPrefix *a, SorterPrefix *b, int n,
+                                 int nThread){
+  SorterPrefixJob aJob[SORTER_MAX_MERGE_COUNT];
+  const int nBkt = 1<<SORTER_PREFIX_MSD;
+  const int shift = 64-SORTER_PREFIX_MSD;
+  int aStart[(1<<SORTER_PREFIX_MSD)+1];
+  int i, j, sum, nJob, per;
+
+  memset(aStart, 0, sizeof(aStart));
+  for(i=0; i<n; i++) aStart[(a[i].iKey>>shift)+1]++;
+  for(i=1; i<=nBkt; i++) aStart[i] += aStart[i-1];
+  {
+    int aPos[1<<SORTER_PREFIX_MSD];
+    memcpy(aPos, aStart, sizeof(aPos));
+    for(i=0; i<n; i++) b[aPos[a[i].iKey>>shift]++] = a[i];
+  }
+  memcpy(a, b, n*sizeof(SorterPrefix));
+
+#if SQLITE_MAX_WORKER_THREADS>0
+  if( sqlite3GlobalConfig.bCoreMutex==0 ) nThread = 1;
+#endif
+  if( nThread>SORTER_MAX_MERGE_COUNT ) nThread = SORTER_MAX_MERGE_COUNT;
+  if( nThread>n/SORTER_PREFIX_MT_MIN ) nThread = n/SORTER_PREFIX_MT_MIN;
+  if( nThread<1 ) nThread = 1;
+
+  /* Hand out buckets in order so each job gets about n/nThread keys */
+  per = (n + nThread - 1) / nThread;
+  for(nJob=0, i=0; i<nBkt && nJob<nThread; nJob++){
+    aJob[nJob].a = a;
+    aJob[nJob].b = b;
+    aJob[nJob].aStart = aStart;
+    aJob[nJob].iFirst = i;
+    for(sum=0; i<nBkt && (sum<per || nJob==nThread-1); i++){
+      sum += aStart[i+1]-aStart[i];
+    }
+    aJob[nJob].iLast = i;
+  }
+
+#if SQLITE_MAX_WORKER_THREADS>0
+  for(j=1; j<nJob; j++){
+    if( sqlite3ThreadCreate(&aJob[j].pThread, vdbeSorterPrefixJob, &aJob[j]) ){
+      aJob[j].pThread = 0;
+      vdbeSorterPrefixJob(&aJob[j]);
+    }
+  }
+  vdbeSorterPrefixJob(&aJob[0]);
+  for(j=1; j<nJob; j++){
+    void *pRet;
+    if( aJob[j].pThread ) sqlite3ThreadJoin(aJob[j].pThread, &pRet);
+  }
+#else
+  for(j=0; j<nJob; j++) vdbeSorterPrefixJob(&aJob[j]);
+#endif
+}
+
+/*
+** Merge sort the u.pNext-linked list p the same way vdbeSorterSort()
+** does.  aSlot[] must be zeroed and is zeroed again on return.
+*/
+static SorterRecord *vdbeSorterSortLinked(
+  SortSubtask *pTask,
+  SorterRecord *p,
+  SorterRecord **aSlot
+){
+  int i;
+  while( p ){
+    SorterRecord *pNext = p->u.pNext;
+    p->u.pNext = 0;
+    for(i=0; aSlot[i]; i++){
+      p = vdbeSorterMerge(pTask, p, aSlot[i]);
+      aSlot[i] = 0;
+    }
+    aSlot[i] = p;
+    p = pNext;
+  }
+  p = 0;
+  for(i=0; i<64; i++){
+    if( aSlot[i]==0 ) continue;
+    p = p ? vdbeSorterMerge(pTask, p, aSlot[i]) : aSlot[i];
+    aSlot[i] = 0;
+  }
+  return p;
+}
+
+/*
+** Try to sort pList by normalized prefix.  Return SQLITE_OK if the list
+** was sorted, SQLITE_NOTFOUND if the caller should sort it the usual way,
+** or an error code.
+**
+** Records are laid out oldest first before sorting and ties are merged
+** with the same comparator and tie-breaking as vdbeSorterSort(), so the
+** sort stays stable.
+*/
+static int vdbeSorterSortPrefix(
+  SortSubtask *pTask,
+  SorterList *pList,
+  SorterRecord **aSlot
+){
+  KeyInfo *pKeyInfo = pTask->pSorter->pKeyInfo;
+  SorterPrefix *a, *b;
+  SorterRecord *p, *pHead = 0, **pp = &pHead;
+  i64 nByte;
+  int n, i, j;
+
+  if( gbl_sqlite_sorter_prefix_min<=0 ) return SQLITE_NOTFOUND;
+  if( pKeyInfo->aColl[0]
+   && sqlite3StrICmp(pKeyInfo->aColl[0]->zName, sqlite3StrBINARY) ){
+    return SQLITE_NOTFOUND;
+  }
+
+  for(n=0, p=pList->pList; p; n++){
+    if( pList->aMemory ){
+      p = (u8*)p==pList->aMemory ? 0
+                                 : (SorterRecord*)&pList->aMemory[p->u.iNext];
+    }else{
+      p = p->u.pNext;
+    }
+  }
+  if( n<gbl_sqlite_sorter_prefix_min ) return SQLITE_NOTFOUND;
+
+  /* Don't let the keys take more memory than the records themselves */
+  nByte = (i64)n * 2 * sizeof(SorterPrefix);
+  if( pTask->pSorter->mxPmaSize>0 && nByte>pTask->pSorter->mxPmaSize ){
+    return SQLITE_NOTFOUND;
+  }
+  a = (SorterPrefix*)sqlite3Malloc(nByte);
+  if( a==0 ) return SQLITE_NOTFOUND;
+  b = &a[n];
+
+  for(i=n-1, p=pList->pList; p; i--){
+    if( vdbeSorterPrefix(SRVAL(p), p->nVal, &a[i].iKey) ){
+      sqlite3_free(a);
+      return SQLITE_NOTFOUND;
+    }
+    if( pKeyInfo->aSortOrder[0] ) a[i].iKey = ~a[i].iKey;
+    a[i].pRec = p;
+    if( pList->aMemory ){
+      p = (u8*)p==pList->aMemory ? 0
+                                 : (SorterRecord*)&pList->aMemory[p->u.iNext];
+    }else{
+      p = p->u.pNext;
+    }
+  }
+
+  vdbeSorterPrefixSort(a, b, n, gbl_sqlite_sorter_threads);
+
+  for(i=0; i<n; i=j){
+    for(j=i+1; j<n && a[j].iKey==a[i].iKey; j++);
+    if( j-i==1 ){
+      p = a[i].pRec;
+      p->u.pNext = 0;
+    }else{
+      /* tied prefixes: link newest first, as pList is, and merge */
+      int k;
+      p = 0;
+      for(k=i; k<j; k++){
+        a[k].pRec->u.pNext = p;
+        p = a[k].pRec;
+      }
+      p = vdbeSorterSortLinked(pTask, p, aSlot);
+    }
+    *pp = p;
+    while( p->u.pNext ) p = p->u.pNext;
+    pp = &p->u.pNext;
+  }
+  pList->pList = pHead;
+
+  sqlite3_free(a);
+  return pTask->pUnpacked->errCode;
+}
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
+
 /*
 ** Sort the linked list of records headed at pTask->pList. Return 
 ** SQLITE_OK if successful, or an SQLite error code (i.e. SQLITE_NOMEM) if 
@@ -1446,6 +1787,14 @@ static int vdbeSorterSort(SortSubtask *pTask, SorterList *pList){
     return SQLITE_NOMEM_BKPT;
   }
 
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+  rc = vdbeSorterSortPrefix(pTask, pList, aSlot);
+  if( rc!=SQLITE_NOTFOUND ){
+    sqlite3_free(aSlot);
+    return rc;
+  }
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
+
   while( p ){
     SorterRecord *pNext;
     if( pList->aMemory ){
@@ -1737,6 +2086,9 @@ static void *vdbeSorterFlushThread(void *pCtx){
 ** using a background thread.
 */
 static int vdbeSorterFlushPMA(VdbeSorter *pSorter){
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+  vdbeSorterGovRelease(pSorter);
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
 #if SQLITE_MAX_WORKER_THREADS==0
   pSorter->bUsePMA = 1;
   return vdbeSorterListToPMA(&pSorter->aTask[0], &pSorter->list);
@@ -1865,6 +2217,18 @@ int sqlite3VdbeSorterWrite(
        || (pSorter->list.szPMA > pSorter->mnPmaSize && sqlite3HeapNearlyFull())
       );
     }
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+    /* Or write a PMA early if the memory governor says sorters hold too
+    ** much, once there is enough here for a PMA to be worth writing */
+    if( !bFlush
+     && (pSorter->list.aMemory ? pSorter->iMemory : pSorter->list.szPMA)
+          > pSorter->mnPmaSize
+     && memgov_over(MEMGOV_SORTER)
+    ){
+      memgov_spilled(MEMGOV_SORTER);
+      bFlush = 1;
+    }
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
     if( bFlush ){
       rc = vdbeSorterFlushPMA(pSorter);
       pSorter->list.szPMA = 0;
@@ -1916,6 +2280,10 @@ int sqlite3VdbeSorterWrite(
   memcpy(SRVAL(pNew), pVal->z, pVal->n);
   pNew->nVal = pVal->n;
   pSorter->list.pList = pNew;
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+  pSorter->nGovMem += nReq;
+  memgov_charge(MEMGOV_SORTER, nReq);
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
 
   return rc;
 }
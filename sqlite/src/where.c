@@ -113,6 +113,18 @@ int sqlite3WhereIsOrdered(WhereInfo *pWInfo){
 ** that might make the code run a little faster, but should not change
 ** the final answer.
 */
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+/*
+** Return the address of the OP_CursorHint coded for a WHERE that is a
+** single loop over a remote table and that is entirely pushed to the remote
+** database, or 0.  Every row such a cursor returns is a row of the result,
+** so the caller can set P2 of that opcode to its LIMIT register.
+*/
+int sqlite3WhereRemoteHintAddr(WhereInfo *pWInfo){
+  return pWInfo->addrRemoteHint;
+}
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
+
 int sqlite3WhereOrderByLimitOptLabel(WhereInfo *pWInfo){
   WhereLevel *pInner;
   if( !pWInfo->bOrderedInnerLoop ){
@@ -865,6 +877,21 @@ static void constructAutomaticIndex(
   sqlite3VdbeAddOp2(v, OP_OpenAutoindex, pLevel->iIdxCur, nKeyCol+1);
   sqlite3VdbeSetP4KeyInfo(pParse, pIdx);
   VdbeComment((v, "for %s", pTable->zName));
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+  /* Keep a bloom filter of the keys so that probes for keys that are not
+  ** there skip the seek; in an equi-join most of them miss. */
+  extern int gbl_autoindex_bloom_filter;
+  if( gbl_autoindex_bloom_filter ){
+    u64 sz = sqlite3LogEstToInt(pTable->nRowLogEst);
+    if( sz<10000 ){
+      sz = 10000;
+    }else if( sz>10000000 ){
+      sz = 10000000;
+    }
+    pLevel->regFilter = ++pParse->nMem;
+    sqlite3VdbeAddOp2(v, OP_Blob, (int)sz, pLevel->regFilter);
+  }
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
 
   /* Fill the automatic index with content */
   pTabItem = &pWC->pWInfo->pTabList->a[pLevel->iFrom];
@@ -887,6 +914,12 @@ static void constructAutomaticIndex(
   regBase = sqlite3GenerateIndexKey(
       pParse, pIdx, pLevel->iTabCur, regRecord, 0, 0, 0, 0
   );
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+  if( pLevel->regFilter ){
+    sqlite3VdbeAddOp4Int(v, OP_FilterAdd, pLevel->regFilter, 0, regBase,
+                         pLoop->u.btree.nEq);
+  }
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
   sqlite3VdbeAddOp2(v, OP_IdxInsert, pLevel->iIdxCur, regRecord);
   sqlite3VdbeChangeP5(v, OPFLAG_USESEEKRESULT);
   if( pPartial ) sqlite3VdbeResolveLabel(v, iContinue);
@@ -75,6 +75,9 @@ struct WhereLevel {
   int addrCont;         /* Jump here to continue with the next loop cycle */
   int addrFirst;        /* First instruction of interior of the loop */
   int addrBody;         /* Beginning of the body of this loop */
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+  int regFilter;        /* Bloom filter of the automatic index keys, or 0 */
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
 #if !defined(SQLITE_BUILDING_FOR_COMDB2) && !defined(SQLITE_LIKE_DOESNT_MATCH_BLOBS)
   u32 iLikeRepCntr;     /* LIKE range processing counter register (times 2) */
   int addrLikeRep;      /* LIKE range processing address */
@@ -465,6 +468,10 @@ struct WhereInfo {
   u8 eDistinct;             /* One of the WHERE_DISTINCT_* values */
   u8 bOrderedInnerLoop;     /* True if only the inner-most loop is ordered */
   int iTop;                 /* The very beginning of the WHERE loop */
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+  int addrRemoteHint;       /* OP_CursorHint covering the whole WHERE of a
+                            ** single remote loop, or 0 */
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
   WhereLoop *pLoops;        /* List of all WhereLoop objects */
   Bitmask revMask;          /* Mask of ORDER BY terms that need reversing */
   LogEst nRowOut;           /* Estimated number of output rows */
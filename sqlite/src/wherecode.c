@@ -954,13 +954,19 @@ static void codeCursorHint(
    */
   Bitmask msk;
   WhereLoop *pWLoop;
+  int nResidual = 0;    /* Terms left for the local engine to check */
+  int addr;
+  int bLocal = 0;       /* Hinting a local table scan */
 #endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
   if( OptimizationDisabled(db, SQLITE_CursorHints) ) return;
 #if defined(SQLITE_BUILDING_FOR_COMDB2)
-  /* Really need to run this only for remote cursors */
   /* hack, at this point only remcurs have it */
-  if( pWInfo->pTabList->a[iLevel].zDatabase==NULL )
-    return;
+  if( pWInfo->pTabList->a[iLevel].zDatabase==NULL ){
+    /* Local cursors only use the hint to skip rows of a table scan that
+    ** cannot match; the terms are still coded below as usual. */
+    if( pLoop->u.btree.pIndex!=0 || pEndRange!=0 ) return;
+    bLocal = 1;
+  }
 
   /* Need this Mask since the code lower ignores TERM_CODED !!!!*/
   iCur = pLevel->iIdxCur;
@@ -1026,10 +1032,20 @@ static void codeCursorHint(
         sWalker.eCode = 0;
         sWalker.xExprCallback = codeCursorHintIsOrFunction;
         sqlite3WalkExpr(&sWalker, pTerm->pExpr);
-        if( sWalker.eCode ) continue;
+        if( sWalker.eCode ){
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+          nResidual++;
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
+          continue;
+        }
       }
     }else{
-      if( ExprHasProperty(pTerm->pExpr, EP_FromJoin) ) continue;
+      if( ExprHasProperty(pTerm->pExpr, EP_FromJoin) ){
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+        nResidual++;
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
+        continue;
+      }
     }
 
 #if defined(SQLITE_BUILDING_FOR_COMDB2)
@@ -1050,7 +1066,12 @@ static void codeCursorHint(
 #endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
 
     /* No subqueries or non-deterministic functions allowed */
-    if( sqlite3ExprContainsSubquery(pTerm->pExpr) ) continue;
+    if( sqlite3ExprContainsSubquery(pTerm->pExpr) ){
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+      nResidual++;
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
+      continue;
+    }
 
     /* For an index scan, make sure referenced columns are actually in
     ** the index. */
@@ -1058,12 +1079,34 @@ static void codeCursorHint(
       sWalker.eCode = 0;
       sWalker.xExprCallback = codeCursorHintCheckExpr;
       sqlite3WalkExpr(&sWalker, pTerm->pExpr);
-      if( sWalker.eCode ) continue;
+      if( sWalker.eCode ){
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+        nResidual++;
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
+        continue;
+      }
     }
 
     /* If we survive all prior tests, that means this term is worth hinting */
     pExpr = sqlite3ExprAnd(db, pExpr, sqlite3ExprDup(db, pTerm->pExpr, 0));
   }
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+  addr = 0;
+  if( pExpr!=0 ){
+    sWalker.xExprCallback = codeCursorHintFixExpr;
+    sqlite3WalkExpr(&sWalker, pExpr);
+    addr = sqlite3VdbeAddOp4(v, OP_CursorHint,
+                      (sHint.pIdx ? sHint.iIdxCur : sHint.iTabCur), 0, 0,
+                      (const char*)pExpr, P4_EXPR);
+  }else if( !bLocal && pWInfo->nLevel==1 && nResidual==0 ){
+    /* nothing to filter, but the select may still want to pass a LIMIT */
+    addr = sqlite3VdbeAddOp1(v, OP_CursorHint,
+                      (sHint.pIdx ? sHint.iIdxCur : sHint.iTabCur));
+  }
+  if( !bLocal && pWInfo->nLevel==1 && nResidual==0 ){
+    pWInfo->addrRemoteHint = addr;
+  }
+#else /* defined(SQLITE_BUILDING_FOR_COMDB2) */
   if( pExpr!=0 ){
     sWalker.xExprCallback = codeCursorHintFixExpr;
     sqlite3WalkExpr(&sWalker, pExpr);
@@ -1071,6 +1114,7 @@ static void codeCursorHint(
                       (sHint.pIdx ? sHint.iIdxCur : sHint.iTabCur), 0, 0,
                       (const char*)pExpr, P4_EXPR);
   }
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
 }
 #else
 #if defined(SQLITE_BUILDING_FOR_COMDB2)
@@ -1756,6 +1800,14 @@ Bitmask sqlite3WhereCodeOneLoopStart(
       start_constraints = 1;
     }
     codeApplyAffinity(pParse, regBase, nConstraint - bSeekPastNull, zStartAff);
+#if defined(SQLITE_BUILDING_FOR_COMDB2)
+    if( pLevel->regFilter ){
+      assert( pLoop->wsFlags & WHERE_AUTO_INDEX );
+      sqlite3VdbeAddOp4Int(v, OP_Filter, pLevel->regFilter, addrNxt,
+                           regBase, nEq);
+      VdbeCoverage(v);
+    }
+#endif /* defined(SQLITE_BUILDING_FOR_COMDB2) */
     if( pLoop->nSkip>0 && nConstraint==pLoop->nSkip ){
       /* The skip-scan logic inside the call to codeAllEqualityConstraints()
       ** above has already left the cursor sitting on the correct row,
@@ -0,0 +1,13 @@
+insert into TBL(id, i, s, ui, l, f, d, c, v, dt) values (1, 5, 5, 5, 5, 0.5, 0.5, 'abc', 'abc', '2020-01-01T000000.000 UTC')
+insert into TBL(id, i, s, ui, l, f, d, c, v, dt) values (2, -5, -5, 0, -5, -0.5, -0.5, 'ABC', 'ABC', '2019-06-01T000000.000 UTC')
+insert into TBL(id, i, s, ui, l, f, d, c, v, dt) values (3, 0, 0, 0, 0, 0.0, 0.0, '', '', '1970-01-01T000000.000 UTC')
+insert into TBL(id, i, s, ui, l, f, d, c, v, dt) values (4, 0, 0, 0, 0, -0.0, -0.0, 'abcdefg', 'abcdefgh', '2030-01-01T000000.000 UTC')
+insert into TBL(id, i, s, ui, l, f, d, c, v, dt) values (5, null, null, null, null, null, null, null, null, null)
+insert into TBL(id, i, s, ui, l, f, d, c, v, dt) values (6, 2147483647, 32767, 4294967295, 9223372036854775807, 3.4e38, 1.7e308, 'zzz', 'zzz', '2040-01-01T000000.000 UTC')
+insert into TBL(id, i, s, ui, l, f, d, c, v, dt) values (7, -2147483648, -32768, 0, -9223372036854775807, -3.4e38, -1.7e308, 'a', 'a', '1900-01-01T000000.000 UTC')
+insert into TBL(id, i, s, ui, l, f, d, c, v, dt) values (8, 1, 1, 1, 1, 0.1, 0.1, 'ab', 'ab', '2020-01-01T000000.001 UTC')
+insert into TBL(id, i, s, ui, l, f, d, c, v, dt) values (9, 2, 2, 2, 9007199254740993, 1.0, 1.0, 'abd', 'abd', null)
+insert into TBL(id, i, s, ui, l, f, d, c, v, dt) values (10, 3, null, 3, null, 2.5, 2.5, 'b', null, '2020-01-01T000000.000 UTC')
+insert into TBL(id, i, s, ui, l, f, d, c, v, dt) values (11, null, 4, null, 4, null, 4.0, null, 'x', null)
+insert into TBL(id, i, s, ui, l, f, d, c, v, dt) values (12, 5, -1, 5, 5, 5.0, 5.0, '5', '5', null)
+insert into TBL(id, i, s, ui, l, f, d, c, v, dt) select value + 100, value % 17 - 8, value % 5, value, value * 1000003, value / 7.0, value / 3.0, 'r' || (value % 9), 'v' || value, null from generate_series(1, 300)
@@ -0,0 +1,128 @@
+select id from TBL where i = 5
+select id from TBL where i <> 5
+select id from TBL where i != 5
+select id from TBL where i < 0
+select id from TBL where i <= 0
+select id from TBL where i > 0
+select id from TBL where i >= -3
+select id from TBL where 5 > i
+select id from TBL where -3 <= i
+select id from TBL where i is null
+select id from TBL where i is not null
+select id from TBL where i = 5.0
+select id from TBL where i = 5.5
+select id from TBL where i > 2.5
+select id from TBL where i < -2.5
+select id from TBL where i = '5'
+select id from TBL where i > '3'
+select id from TBL where i < 4294967296
+select id from TBL where i > -4294967296
+select id from TBL where i = 2147483647
+select id from TBL where i = -2147483648
+select id from TBL where s > 40000
+select id from TBL where s < -40000
+select id from TBL where s = -1
+select id from TBL where ui > -1
+select id from TBL where ui = 4294967295
+select id from TBL where ui < 1
+select id from TBL where ui = -5
+select id from TBL where l = 9223372036854775807
+select id from TBL where l <= -9223372036854775807
+select id from TBL where l = 9007199254740993
+select id from TBL where l > 9007199254740992.0
+select id from TBL where l = 5.0
+select id from TBL where f = 0.1
+select id from TBL where f = 0.5
+select id from TBL where f = 0
+select id from TBL where f = -0.0
+select id from TBL where f = 0.0
+select id from TBL where f < 0
+select id from TBL where f <= 0
+select id from TBL where f > 3e38
+select id from TBL where f = 1
+select id from TBL where f = 3.4e39
+select id from TBL where d = 0.1
+select id from TBL where d = 0
+select id from TBL where d = -0.0
+select id from TBL where d > -1e308
+select id from TBL where d < -1e308
+select id from TBL where d = 1
+select id from TBL where d = 1.0
+select id from TBL where d >= 2.5
+select id from TBL where d = 9007199254740993
+select id from TBL where c = 'abc'
+select id from TBL where c = 'ABC'
+select id from TBL where c <> 'abc'
+select id from TBL where c = 'abc' collate nocase
+select id from TBL where c collate nocase = 'abc'
+select id from TBL where c > 'ab'
+select id from TBL where c >= 'ab'
+select id from TBL where c < 'abd'
+select id from TBL where c <= 'a'
+select id from TBL where c = 'abcdefg'
+select id from TBL where c = 'abcdefgh'
+select id from TBL where c > 'abcdefgh'
+select id from TBL where c = ''
+select id from TBL where c > ''
+select id from TBL where c = 5
+select id from TBL where c > 5
+select id from TBL where c < 5
+select id from TBL where c is null
+select id from TBL where c is not null
+select id from TBL where v = 'abc'
+select id from TBL where v > 'abcdefg'
+select id from TBL where dt > '2020-01-01T000000.000 UTC'
+select id from TBL where dt is null
+select id from TBL where i > 0 and c = 'abc' and d is not null
+select id from TBL where i > 0 and i < 5 and s >= 1 and f > 0.2
+select id from TBL where (i > 0 or c = 'abc') and d > 0
+select id from TBL where not i > 0
+select id from TBL where i between -2 and 3
+select id from TBL where i in (1, 5, 7)
+select id from TBL where i = i
+select id from TBL where i = s
+select id from TBL where i > d
+select a.id, b.id from TBL a join TBL b on b.i = a.s where a.id < 20
+select a.id, b.id from TBL a join TBL b on b.c = a.c where a.id < 20
+select a.id, b.id from TBL a join TBL b on b.d > a.f where a.id < 13 and b.id < 13
+select a.id, b.id from TBL a left join TBL b on b.i = a.i and b.c = 'abc' where a.id < 20
+select a.id from TBL a where a.i = (select max(s) from TBL)
+select count(*), sum(i), min(c), max(d) from TBL where i >= 0
+select id, i, s, ui, l, f, d, c, v, dt from TBL where i < 3 and c >= 'a'
+select id from TBL where i = 2147483648
+select id from TBL where i < -2147483649
+select id from TBL where s = 32767
+select id from TBL where s >= -32768
+select id from TBL where s = 32768
+select id from TBL where ui = 0
+select id from TBL where ui <= 4294967296
+select id from TBL where l >= 9223372036854775807
+select id from TBL where l > -1
+select id from TBL where f = 0.25
+select id from TBL where f = 16777217
+select id from TBL where f < -0.25
+select id from TBL where f > -1e38
+select id from TBL where f = 2.5
+select id from TBL where f >= 2
+select id from TBL where d = 2.5
+select id from TBL where d > -0.5
+select id from TBL where d < -1e300
+select id from TBL where d <= 0.5
+select id from TBL where d = 9007199254740992
+select id from TBL where c = 'abcdef'
+select id from TBL where c >= 'abcdef'
+select id from TBL where c < 'abcdeg'
+select id from TBL where c = 'r1'
+select id from TBL where c > 'r'
+select id from TBL where c < 'A'
+@bind CDB2_INTEGER v 5;select id from TBL where i = @v
+@bind CDB2_INTEGER v 5;select id from TBL where ui >= @v
+@bind CDB2_INTEGER v -1;select id from TBL where ui > @v
+@bind CDB2_INTEGER v 4294967296;select id from TBL where i < @v
+@bind CDB2_REAL v 0.5;select id from TBL where f = @v
+@bind CDB2_REAL v 0.1;select id from TBL where f < @v
+@bind CDB2_REAL v -0.0;select id from TBL where d = @v
+@bind CDB2_REAL v 2.5;select id from TBL where i > @v
+@bind CDB2_CSTRING v abc;select id from TBL where c = @v
+@bind CDB2_CSTRING v abcdefgh;select id from TBL where c <= @v
+@bind CDB2_CSTRING v 5;select id from TBL where i = @v
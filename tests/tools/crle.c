@@ -331,9 +331,37 @@ static void test_repeat_rev()
     fprintf(stderr, "passed %s\n", __func__);
 }
 
+static void test_match_len()
+{
+    match_len_fn kernels[] = {
+        match_len_scalar,
+#if defined(__x86_64__) && defined(__GNUC__)
+        match_len_sse2,
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+        match_len_neon,
+#endif
+        match_len_best(),
+    };
+    uint8_t a[N], b[N];
+    memset(a, 0xdb, N);
+    memset(b, 0xdb, N);
+    for (unsigned n = 0; n <= 100; ++n) {
+        for (unsigned i = 0; i <= n; ++i) {
+            if (i < n)
+                b[i] = 0xbd;
+            for (unsigned k = 0; k < CNT(kernels); ++k)
+                assert(kernels[k](a, b, n) == i);
+            if (i < n)
+                b[i] = 0xdb;
+        }
+    }
+    fprintf(stderr, "passed %s\n", __func__);
+}
+
 int main(int argc, char *argv[])
 {
     test_varint();
+    test_match_len();
     test_repeat();
     test_repeat_rev();
     test_well_known();
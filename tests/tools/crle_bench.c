@@ -0,0 +1,138 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/* Times crle compress/decompress of a few record shapes with each of the
+ * run detection kernels.  Usage: crle_bench [iterations] */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#undef NDEBUG
+#include <assert.h>
+#include <comdb2rle.c> //need access to static funcs
+
+#define RECSZ 4096
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* mostly nulls: a wide row with few populated columns */
+static void fill_sparse(uint8_t *b, size_t n)
+{
+    memset(b, 0, n);
+    for (size_t i = 0; i < n; i += 97)
+        b[i] = 0x08;
+}
+
+/* repeated 9 byte int columns  */
+static void fill_ints(uint8_t *b, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        b[i] = p0[i % sizeof(p0)];
+}
+
+/* padded strings: runs of spaces between short random words */
+static void fill_strings(uint8_t *b, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        b[i] = (i % 64) < 12 ? 'a' + rand() % 26 : ' ';
+}
+
+/* random bytes: nothing to find, all scanning */
+static void fill_random(uint8_t *b, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        b[i] = rand();
+}
+
+static struct {
+    const char *name;
+    void (*fill)(uint8_t *, size_t);
+} shapes[] = {{"sparse", fill_sparse},
+              {"ints", fill_ints},
+              {"strings", fill_strings},
+              {"random", fill_random}};
+
+static struct {
+    const char *name;
+    match_len_fn fn;
+} kernels[] = {
+    {"scalar", match_len_scalar},
+#if defined(__x86_64__) && defined(__GNUC__)
+    {"sse2", match_len_sse2},
+    {"avx2", match_len_avx2},
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    {"neon", match_len_neon},
+#endif
+};
+
+int main(int argc, char *argv[])
+{
+    int iter = argc > 1 ? atoi(argv[1]) : 20000;
+    static uint8_t in[RECSZ], comp[RECSZ * 2], out[RECSZ];
+
+#if defined(__x86_64__) && defined(__GNUC__)
+    __builtin_cpu_init();
+    int have_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+    printf("%-8s %-8s %10s %10s %8s\n", "shape", "kernel", "comp MB/s",
+           "decomp MB/s", "ratio");
+    for (size_t s = 0; s < CNT(shapes); ++s) {
+        shapes[s].fill(in, sizeof(in));
+        for (size_t k = 0; k < CNT(kernels); ++k) {
+#if defined(__x86_64__) && defined(__GNUC__)
+            if (kernels[k].fn == match_len_avx2 && !have_avx2)
+                continue;
+#endif
+            match_len = kernels[k].fn;
+            Comdb2RLE c = {0};
+            double start = now_ms();
+            for (int i = 0; i < iter; ++i) {
+                c.in = in;
+                c.insz = sizeof(in);
+                c.out = comp;
+                c.outsz = sizeof(comp);
+                assert(compressComdb2RLE(&c) == 0);
+            }
+            double comp_ms = now_ms() - start;
+
+            Comdb2RLE d = {0};
+            start = now_ms();
+            for (int i = 0; i < iter; ++i) {
+                d.in = comp;
+                d.insz = c.outsz;
+                d.out = out;
+                d.outsz = sizeof(out);
+                assert(decompressComdb2RLE(&d) == 0);
+            }
+            double decomp_ms = now_ms() - start;
+            assert(d.outsz == sizeof(in) && memcmp(in, out, sizeof(in)) == 0);
+
+            double mb = (double)iter * sizeof(in) / (1024 * 1024);
+            printf("%-8s %-8s %10.1f %10.1f %8.2f\n", shapes[s].name,
+                   kernels[k].name, mb / (comp_ms / 1000),
+                   mb / (decomp_ms / 1000), (double)sizeof(in) / c.outsz);
+        }
+    }
+    return EXIT_SUCCESS;
+}
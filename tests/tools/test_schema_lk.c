@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "schema_lk.h"
+#include "comdb2_atomic.h"
+
+int gbl_disable_exit_on_thread_error;
+int gbl_throttle_sql_overload_dump_sec;
+
+void register_tunable(void *tunable)
+{
+}
+void thdpool_alarm_on_queing(int len)
+{
+}
+
+/* a pair of values only ever changed together under the write lock */
+static int pair_a, pair_b;
+static int stop;
+static uint32_t reads, writes, tries, bad;
+
+static void *rdlock_thd(void *arg)
+{
+    rdlock_schema_lk();
+    return NULL;
+}
+
+static void *unlock_thd(void *arg)
+{
+    unlock_schema_lk();
+    return NULL;
+}
+
+static void run_thd(void *(*fn)(void *))
+{
+    pthread_t t;
+    pthread_create(&t, NULL, fn, NULL);
+    pthread_join(t, NULL);
+}
+
+/* A read lock taken on one thread and let go on another, after which the
+ * taking thread writes: that unlock must let go of the write lock */
+static void test_cross_thread_release(void)
+{
+    run_thd(rdlock_thd);
+    run_thd(unlock_thd);
+
+    rdlock_schema_lk();
+    run_thd(unlock_thd);
+
+    wrlock_schema_lk();
+    unlock_schema_lk();
+
+    /* nothing holds it now, so readers and writers get it at once */
+    if (tryrdlock_schema_lk() != 0) {
+        fprintf(stderr, "tryrdlock failed after the write unlock\n");
+        exit(1);
+    }
+    unlock_schema_lk();
+    wrlock_schema_lk();
+    unlock_schema_lk();
+    printf("cross thread release ok\n");
+}
+
+static void *reader(void *arg)
+{
+    int nested = (intptr_t)arg % 2;
+    while (!ATOMIC_LOAD32(stop)) {
+        rdlock_schema_lk();
+        if (nested)
+            rdlock_schema_lk();
+        if (pair_a != pair_b)
+            ATOMIC_ADD32(bad, 1);
+        if (nested)
+            unlock_schema_lk();
+        unlock_schema_lk();
+        ATOMIC_ADD32(reads, 1);
+
+        if (tryrdlock_schema_lk() == 0) {
+            if (pair_a != pair_b)
+                ATOMIC_ADD32(bad, 1);
+            unlock_schema_lk();
+            ATOMIC_ADD32(tries, 1);
+        }
+    }
+    return NULL;
+}
+
+static void *writer(void *arg)
+{
+    while (!ATOMIC_LOAD32(stop)) {
+        wrlock_schema_lk();
+        pair_a++;
+        usleep(10);
+        pair_b++;
+        unlock_schema_lk();
+        ATOMIC_ADD32(writes, 1);
+        usleep(1000);
+    }
+    return NULL;
+}
+
+/* Writers get the lock while readers, some of them nested, keep at it, and
+ * no reader sees a writer halfway */
+static void test_writer_under_load(const char *mode)
+{
+    enum { NREADERS = 8, NWRITERS = 2 };
+    pthread_t r[NREADERS], w[NWRITERS];
+
+    stop = reads = writes = tries = bad = 0;
+    for (intptr_t i = 0; i < NREADERS; i++)
+        pthread_create(&r[i], NULL, reader, (void *)i);
+    for (int i = 0; i < NWRITERS; i++)
+        pthread_create(&w[i], NULL, writer, NULL);
+    sleep(3);
+    ATOMIC_ADD32(stop, 1);
+    for (int i = 0; i < NREADERS; i++)
+        pthread_join(r[i], NULL);
+    for (int i = 0; i < NWRITERS; i++)
+        pthread_join(w[i], NULL);
+
+    printf("%s: reads %u tryreads %u writes %u\n", mode, reads, tries, writes);
+    if (bad) {
+        fprintf(stderr, "%s: %u reads saw a write halfway\n", mode, bad);
+        exit(1);
+    }
+    if (reads == 0 || writes == 0) {
+        fprintf(stderr, "%s: no progress\n", mode);
+        exit(1);
+    }
+}
+
+int main()
+{
+    test_writer_under_load("rwlock");
+
+    gbl_schema_lk_sharded = 1;
+    test_cross_thread_release();
+    test_writer_under_load("sharded");
+
+    printf("Success\n");
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "thread_util.h"
+#include "thdpool.h"
+#include "comdb2_atomic.h"
+#include "mem.h"
+
+int gbl_disable_exit_on_thread_error;
+int gbl_throttle_sql_overload_dump_sec;
+
+void register_tunable(void *tunable)
+{
+}
+void thdpool_alarm_on_queing(int len)
+{
+}
+
+static uint32_t ran, freed, spawned, stop_producers;
+static struct thdpool *pool;
+
+typedef struct {
+    int depth;
+} item_t;
+
+/* Runs the item; some of them queue children of their own, which go on the
+ * worker's own deque */
+static void work_fn(struct thdpool *p, void *work, void *thddata, int op)
+{
+    item_t *item = work;
+    if (op == THD_FREE) {
+        ATOMIC_ADD32(freed, 1);
+        free(item);
+        return;
+    }
+    if (item->depth > 0) {
+        for (int i = 0; i < 2; i++) {
+            item_t *child = calloc(1, sizeof(item_t));
+            child->depth = item->depth - 1;
+            if (thdpool_enqueue(p, work_fn, child, 0, NULL,
+                                THDPOOL_FORCE_QUEUE) == 0)
+                ATOMIC_ADD32(spawned, 1);
+            else
+                free(child);
+        }
+    }
+    if (rand() % 8 == 0)
+        usleep(rand() % 200);
+    ATOMIC_ADD32(ran, 1);
+    free(item);
+}
+
+static void *producer(void *arg)
+{
+    while (!ATOMIC_LOAD32(stop_producers)) {
+        item_t *item = calloc(1, sizeof(item_t));
+        item->depth = rand() % 3;
+        if (thdpool_enqueue(pool, work_fn, item, 0, NULL,
+                            THDPOOL_FORCE_QUEUE) != 0) {
+            /* stopped */
+            free(item);
+            break;
+        }
+        ATOMIC_ADD32(spawned, 1);
+    }
+    return NULL;
+}
+
+static void wait_for_threads(void)
+{
+    while (thdpool_get_nthds(pool) + thdpool_get_nfreethds(pool) > 0)
+        usleep(10000);
+}
+
+static struct thdpool *make_pool(const char *name)
+{
+    struct thdpool *p = thdpool_create(name, 0);
+    assert(p);
+    thdpool_set_minthds(p, 0);
+    thdpool_set_maxthds(p, 4);
+    thdpool_set_linger(p, 0);
+    thdpool_set_longwaitms(p, 1000000);
+    thdpool_set_maxqueue(p, 1000);
+    thdpool_set_mem_size(p, 4 * 1024);
+    thdpool_set_work_stealing(p, 1);
+    return p;
+}
+
+/* Every item queued is run or freed exactly once */
+static void check(const char *test)
+{
+    printf("%s: spawned %u ran %u freed %u\n", test, spawned, ran, freed);
+    if (ran + freed != spawned) {
+        fprintf(stderr, "%s: %u items lost\n", test, spawned - ran - freed);
+        exit(1);
+    }
+}
+
+/* Producers and workers queue items while threads come and go */
+static void test_run_all(void)
+{
+    enum { NPRODUCERS = 4 };
+    pthread_t t[NPRODUCERS];
+
+    ran = freed = spawned = stop_producers = 0;
+    pool = make_pool("steal_run");
+    for (int i = 0; i < NPRODUCERS; i++)
+        pthread_create(&t[i], NULL, producer, NULL);
+    sleep(2);
+    ATOMIC_ADD32(stop_producers, 1);
+    for (int i = 0; i < NPRODUCERS; i++)
+        pthread_join(t[i], NULL);
+    wait_for_threads();
+    check("run all");
+    if (freed) {
+        fprintf(stderr, "run all: %u items freed unrun\n", freed);
+        exit(1);
+    }
+    thdpool_stop(pool);
+    thdpool_destroy(&pool);
+}
+
+/* The pool is stopped with items on the deques, and while producers still
+ * push: the workers run what is queued before they go, and destroy frees
+ * what a push got in after the last of them */
+static void test_stop(void)
+{
+    enum { NPRODUCERS = 4 };
+    pthread_t t[NPRODUCERS];
+
+    ran = freed = spawned = stop_producers = 0;
+    pool = make_pool("steal_stop");
+    for (int i = 0; i < NPRODUCERS; i++)
+        pthread_create(&t[i], NULL, producer, NULL);
+    usleep(500000);
+    thdpool_stop(pool);
+    usleep(100000);
+    ATOMIC_ADD32(stop_producers, 1);
+    for (int i = 0; i < NPRODUCERS; i++)
+        pthread_join(t[i], NULL);
+    wait_for_threads();
+    thdpool_destroy(&pool);
+    check("stop");
+}
+
+int main()
+{
+    comdb2ma_init(0, 0);
+    thread_util_init();
+
+    test_run_all();
+    test_stop();
+
+    printf("Success\n");
+    pthread_exit(NULL);
+}
@@ -0,0 +1,564 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/* cdb2_bench: micro-benchmarks of the storage layer.
+ *
+ * Unlike the rowlocks_bench / commit_bench message traps, this needs no
+ * running database: each benchmark gets its own private berkdb environment
+ * in a scratch directory, opened with only the subsystems it measures, so
+ * no commit ever goes through the replication or snapshot hooks of a live
+ * server.  Every benchmark runs at each of the requested thread counts and
+ * the results are written as one JSON document, to be kept and compared
+ * across releases. */
+
+#include "build/db_config.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "build/db_int.h"
+#include <crc32c.h>
+#include "locks_wrap.h"
+
+extern int comdb2ma_init(size_t init_sz, size_t max_cap);
+
+/* outside the range of the records berkdb and comdb2 define */
+#define BENCH_RECTYPE 20000
+#define BENCH_MAX_THREADS 256
+
+struct bench_opts {
+    int nthreads[32];
+    int nthreadcounts;
+    int nops;      /* per thread */
+    int recsz;     /* log record and btree data size */
+    int nkeys;     /* btree keys, lock objects per thread, mpool pages */
+    int nnext;     /* DB_NEXTs after each find */
+    int cachesz;   /* mpool bytes */
+    int logflush;  /* flush every log record */
+    const char *only;
+};
+
+struct bench;
+
+struct bench_thread {
+    struct bench *b;
+    int id;
+    unsigned int seed;
+    uint64_t *lat;
+    u_int32_t locker;
+    DBC *dbc;
+    void *buf;
+    int err;
+    pthread_t tid;
+};
+
+struct bench {
+    const char *name;
+    u_int32_t envflags;
+    int (*setup)(struct bench *);
+    int (*thread_init)(struct bench_thread *);
+    int (*op)(struct bench_thread *, int i);
+    void (*thread_done)(struct bench_thread *);
+    void (*teardown)(struct bench *);
+
+    const struct bench_opts *o;
+    char home[PATH_MAX];
+    DB_ENV *dbenv;
+    DB *dbp;
+    DB_MPOOLFILE *mpf;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* lock get/put: each thread locks its own objects, so this is the cost of
+   the lock region rather than of waiting */
+static int lock_thread_init(struct bench_thread *t)
+{
+    return t->b->dbenv->lock_id(t->b->dbenv, &t->locker);
+}
+
+static int lock_op(struct bench_thread *t, int i)
+{
+    DB_ENV *dbenv = t->b->dbenv;
+    char name[32];
+    DBT obj = {0};
+    DB_LOCK lock;
+    int rc;
+
+    obj.data = name;
+    obj.size = snprintf(name, sizeof(name), "bench%d.%d", t->id,
+                        i % t->b->o->nkeys);
+    if ((rc = dbenv->lock_get(dbenv, t->locker, 0, &obj, DB_LOCK_WRITE,
+                              &lock)) != 0)
+        return rc;
+    return dbenv->lock_put(dbenv, &lock);
+}
+
+static void lock_thread_done(struct bench_thread *t)
+{
+    t->b->dbenv->lock_id_free(t->b->dbenv, t->locker);
+}
+
+/* log put */
+static int log_thread_init(struct bench_thread *t)
+{
+    u_int32_t rectype = BENCH_RECTYPE;
+    if ((t->buf = calloc(1, t->b->o->recsz)) == NULL)
+        return ENOMEM;
+    memcpy(t->buf, &rectype, sizeof(rectype));
+    return 0;
+}
+
+static int log_op(struct bench_thread *t, int i)
+{
+    DBT dbt = {0};
+    DB_LSN lsn;
+
+    dbt.data = t->buf;
+    dbt.size = t->b->o->recsz;
+    return t->b->dbenv->log_put(t->b->dbenv, &lsn, &dbt,
+                                t->b->o->logflush ? DB_FLUSH : 0);
+}
+
+static void free_buf(struct bench_thread *t)
+{
+    free(t->buf);
+    t->buf = NULL;
+}
+
+/* txn begin/commit of a transaction that writes nothing */
+static int txn_op(struct bench_thread *t, int i)
+{
+    DB_TXN *txn;
+    int rc;
+
+    if ((rc = t->b->dbenv->txn_begin(t->b->dbenv, NULL, &txn, 0)) != 0)
+        return rc;
+    return txn->commit(txn, 0);
+}
+
+/* cursor find/next over a btree that fits in the cache */
+static void bench_key(unsigned char *k, unsigned int n)
+{
+    k[0] = n >> 24;
+    k[1] = n >> 16;
+    k[2] = n >> 8;
+    k[3] = n;
+}
+
+static int cursor_setup(struct bench *b)
+{
+    unsigned char k[4];
+    DBT key = {0}, data = {0};
+    void *buf;
+    int rc;
+
+    if ((rc = db_create(&b->dbp, b->dbenv, 0)) != 0)
+        return rc;
+    if ((rc = b->dbp->open(b->dbp, NULL, "bench.db", NULL, DB_BTREE,
+                           DB_CREATE | DB_THREAD, 0666)) != 0)
+        return rc;
+    if ((buf = calloc(1, b->o->recsz)) == NULL)
+        return ENOMEM;
+    key.data = k;
+    key.size = sizeof(k);
+    data.data = buf;
+    data.size = b->o->recsz;
+    for (int i = 0; i < b->o->nkeys && rc == 0; i++) {
+        bench_key(k, i);
+        rc = b->dbp->put(b->dbp, NULL, &key, &data, 0);
+    }
+    free(buf);
+    return rc;
+}
+
+static int cursor_thread_init(struct bench_thread *t)
+{
+    return t->b->dbp->cursor(t->b->dbp, NULL, &t->dbc, 0);
+}
+
+static int cursor_op(struct bench_thread *t, int i)
+{
+    unsigned char k[4];
+    DBT key = {0}, data = {0};
+    int rc;
+
+    bench_key(k, rand_r(&t->seed) % t->b->o->nkeys);
+    key.data = k;
+    key.size = sizeof(k);
+    key.ulen = sizeof(k);
+    key.flags = DB_DBT_USERMEM;
+    data.flags = DB_DBT_REALLOC;
+    data.data = t->buf;
+    rc = t->dbc->c_get(t->dbc, &key, &data, DB_SET_RANGE);
+    for (int n = 0; rc == 0 && n < t->b->o->nnext; n++)
+        rc = t->dbc->c_get(t->dbc, &key, &data, DB_NEXT);
+    t->buf = data.data;
+    return rc == DB_NOTFOUND ? 0 : rc;
+}
+
+static void cursor_thread_done(struct bench_thread *t)
+{
+    if (t->dbc)
+        t->dbc->c_close(t->dbc);
+    t->dbc = NULL;
+    free_buf(t);
+}
+
+static void close_dbp(struct bench *b)
+{
+    if (b->dbp)
+        b->dbp->close(b->dbp, DB_NOSYNC);
+    b->dbp = NULL;
+}
+
+/* mpool fget/fput of pages that are all in the cache */
+static int mpool_setup(struct bench *b)
+{
+    db_pgno_t pgno;
+    void *page;
+    int rc;
+
+    if ((rc = b->dbenv->memp_fcreate(b->dbenv, &b->mpf, 0)) != 0)
+        return rc;
+    if ((rc = b->mpf->open(b->mpf, "bench.mp", DB_CREATE, 0666, 4096)) != 0)
+        return rc;
+    for (int i = 0; i < b->o->nkeys; i++) {
+        pgno = i;
+        if ((rc = b->mpf->get(b->mpf, &pgno, DB_MPOOL_CREATE, &page)) != 0)
+            return rc;
+        if ((rc = b->mpf->put(b->mpf, page, DB_MPOOL_DIRTY)) != 0)
+            return rc;
+    }
+    return 0;
+}
+
+static int mpool_op(struct bench_thread *t, int i)
+{
+    db_pgno_t pgno = rand_r(&t->seed) % t->b->o->nkeys;
+    void *page;
+    int rc;
+
+    if ((rc = t->b->mpf->get(t->b->mpf, &pgno, 0, &page)) != 0)
+        return rc;
+    return t->b->mpf->put(t->b->mpf, page, 0);
+}
+
+static void close_mpf(struct bench *b)
+{
+    if (b->mpf)
+        b->mpf->close(b->mpf, 0);
+    b->mpf = NULL;
+}
+
+static struct bench benches[] = {
+    {"lock", DB_INIT_LOCK, NULL, lock_thread_init, lock_op, lock_thread_done,
+     NULL},
+    {"log", DB_INIT_LOG, NULL, log_thread_init, log_op, free_buf, NULL},
+    {"txn", DB_INIT_LOCK | DB_INIT_LOG | DB_INIT_MPOOL | DB_INIT_TXN, NULL,
+     NULL, txn_op, NULL, NULL},
+    {"cursor", DB_INIT_MPOOL, cursor_setup, cursor_thread_init, cursor_op,
+     cursor_thread_done, close_dbp},
+    {"mpool", DB_INIT_MPOOL, mpool_setup, NULL, mpool_op, NULL, close_mpf},
+};
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+static void *bench_thread(void *arg)
+{
+    struct bench_thread *t = arg;
+    struct bench *b = t->b;
+    uint64_t start;
+
+    if (b->thread_init && (t->err = b->thread_init(t)) != 0)
+        return NULL;
+    for (int i = 0; i < b->o->nops; i++) {
+        start = now_ns();
+        if ((t->err = b->op(t, i)) != 0)
+            break;
+        t->lat[i] = now_ns() - start;
+    }
+    if (b->thread_done)
+        b->thread_done(t);
+    return NULL;
+}
+
+static int cmp_u64(const void *p, const void *q)
+{
+    uint64_t l = *(const uint64_t *)p, r = *(const uint64_t *)q;
+    return l < r ? -1 : l > r;
+}
+
+static int open_env(struct bench *b, const char *scratch, int nthreads)
+{
+    int rc;
+
+    snprintf(b->home, sizeof(b->home), "%s/%s.%d", scratch, b->name,
+             nthreads);
+    if (mkdir(b->home, 0755) != 0) {
+        fprintf(stderr, "mkdir %s: %s\n", b->home, strerror(errno));
+        return -1;
+    }
+    if ((rc = db_env_create(&b->dbenv, 0)) != 0)
+        return rc;
+    b->dbenv->set_errfile(b->dbenv, stderr);
+    if ((rc = b->dbenv->set_cachesize(b->dbenv, 0, b->o->cachesz, 1)) != 0)
+        return rc;
+    return b->dbenv->open(b->dbenv, b->home,
+                          DB_CREATE | DB_PRIVATE | DB_THREAD | b->envflags,
+                          0666);
+}
+
+static void remove_dir(const char *dir)
+{
+    char path[PATH_MAX];
+    struct stat st;
+    struct dirent *d;
+    DIR *dh;
+
+    if ((dh = opendir(dir)) == NULL)
+        return;
+    while ((d = readdir(dh)) != NULL) {
+        if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0)
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, d->d_name);
+        if (lstat(path, &st) == 0 && S_ISDIR(st.st_mode))
+            remove_dir(path);
+        else
+            unlink(path);
+    }
+    closedir(dh);
+    rmdir(dir);
+}
+
+/* Run one benchmark at one thread count and print its JSON object */
+static int run_bench(FILE *out, struct bench *b, const char *scratch,
+                     int nthreads, int first)
+{
+    struct bench_thread *t;
+    uint64_t *lat, start, elapsed, sum = 0;
+    size_t nlat = (size_t)nthreads * b->o->nops;
+    int rc, err = 0;
+
+    fprintf(stderr, "%s: %d threads\n", b->name, nthreads);
+    if ((rc = open_env(b, scratch, nthreads)) != 0 ||
+        (b->setup && (rc = b->setup(b)) != 0)) {
+        fprintf(stderr, "%s: setup failed rc %d (%s)\n", b->name, rc,
+                db_strerror(rc));
+        err = 1;
+        goto done;
+    }
+
+    t = calloc(nthreads, sizeof(struct bench_thread));
+    lat = malloc(nlat * sizeof(uint64_t));
+    if (t == NULL || lat == NULL) {
+        free(t);
+        free(lat);
+        err = 1;
+        goto done;
+    }
+
+    start = now_ns();
+    for (int i = 0; i < nthreads; i++) {
+        t[i].b = b;
+        t[i].id = i;
+        t[i].seed = i + 1;
+        t[i].lat = lat + (size_t)i * b->o->nops;
+        Pthread_create(&t[i].tid, NULL, bench_thread, &t[i]);
+    }
+    for (int i = 0; i < nthreads; i++) {
+        Pthread_join(t[i].tid, NULL);
+        if (t[i].err) {
+            fprintf(stderr, "%s: thread %d failed rc %d (%s)\n", b->name, i,
+                    t[i].err, db_strerror(t[i].err));
+            err = 1;
+        }
+    }
+    elapsed = now_ns() - start;
+    free(t);
+
+    if (!err) {
+        qsort(lat, nlat, sizeof(uint64_t), cmp_u64);
+        for (size_t i = 0; i < nlat; i++)
+            sum += lat[i];
+        fprintf(out,
+                "%s    {\"name\": \"%s\", \"threads\": %d, \"ops\": %zu, "
+                "\"elapsed_ns\": %" PRIu64 ", \"ops_per_sec\": %.1f,\n"
+                "     \"latency_ns\": {\"min\": %" PRIu64 ", \"avg\": %" PRIu64
+                ", \"p50\": %" PRIu64 ", \"p90\": %" PRIu64 ", \"p99\": %" PRIu64
+                ", \"p999\": %" PRIu64 ", \"max\": %" PRIu64 "}}",
+                first ? "" : ",\n", b->name, nthreads, nlat, elapsed,
+                elapsed ? nlat * 1e9 / elapsed : 0.0, lat[0], sum / nlat,
+                lat[nlat / 2], lat[nlat * 90 / 100], lat[nlat * 99 / 100],
+                lat[nlat * 999 / 1000], lat[nlat - 1]);
+    }
+    free(lat);
+
+done:
+    if (b->teardown)
+        b->teardown(b);
+    if (b->dbenv)
+        b->dbenv->close(b->dbenv, 0);
+    b->dbenv = NULL;
+    return err ? -1 : 0;
+}
+
+static int cdb2_bench_usage(void)
+{
+    fprintf(stderr,
+            "usage: cdb2_bench [-b bench,...] [-t threads,...] [-n ops] "
+            "[-k keys] [-N nexts]\n"
+            "                  [-r recsz] [-c cachesz] [-d dir] [-o file] "
+            "[-F]\n"
+            "  -b  benchmarks to run: lock, log, txn, cursor, mpool (all)\n"
+            "  -t  thread counts to run each benchmark at (1,4,16)\n"
+            "  -n  operations per thread (100000)\n"
+            "  -k  btree keys, mpool pages and lock objects per thread "
+            "(10000)\n"
+            "  -N  DB_NEXTs after each cursor find (10)\n"
+            "  -r  log record and btree data size (128)\n"
+            "  -c  cache size in bytes (64MB)\n"
+            "  -d  directory for the scratch environments (/tmp)\n"
+            "  -o  write the JSON results here instead of stdout\n"
+            "  -F  flush the log on every log put\n");
+    return EXIT_FAILURE;
+}
+
+int tool_cdb2_bench_main(int argc, char *argv[])
+{
+    extern char *optarg;
+    struct bench_opts o = {.nthreads = {1, 4, 16},
+                           .nthreadcounts = 3,
+                           .nops = 100000,
+                           .recsz = 128,
+                           .nkeys = 10000,
+                           .nnext = 10,
+                           .cachesz = 64 * 1024 * 1024};
+    const char *dir = "/tmp", *outfile = NULL;
+    char scratch[PATH_MAX], host[256] = "";
+    int major, minor, patch;
+    int ch, first = 1, rc = 0;
+    FILE *out = stdout;
+    char *s, *tok;
+
+    crc32c_init(0);
+    comdb2ma_init(0, 0);
+    Pthread_key_create(&DBG_FREE_CURSOR, NULL);
+
+    while ((ch = getopt(argc, argv, "b:t:n:k:N:r:c:d:o:Fh")) != EOF) {
+        switch (ch) {
+        case 'b':
+            o.only = optarg;
+            break;
+        case 't':
+            o.nthreadcounts = 0;
+            s = strdup(optarg);
+            for (tok = strtok(s, ","); tok && o.nthreadcounts < 32;
+                 tok = strtok(NULL, ","))
+                o.nthreads[o.nthreadcounts++] = atoi(tok);
+            free(s);
+            break;
+        case 'n':
+            o.nops = atoi(optarg);
+            break;
+        case 'k':
+            o.nkeys = atoi(optarg);
+            break;
+        case 'N':
+            o.nnext = atoi(optarg);
+            break;
+        case 'r':
+            o.recsz = atoi(optarg);
+            break;
+        case 'c':
+            o.cachesz = atoi(optarg);
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        case 'o':
+            outfile = optarg;
+            break;
+        case 'F':
+            o.logflush = 1;
+            break;
+        default:
+            return cdb2_bench_usage();
+        }
+    }
+    if (o.nops <= 0 || o.nkeys <= 0 || o.nnext < 0 || o.cachesz <= 0 ||
+        o.recsz < (int)sizeof(u_int32_t) || o.nthreadcounts == 0)
+        return cdb2_bench_usage();
+    for (int i = 0; i < o.nthreadcounts; i++) {
+        if (o.nthreads[i] <= 0 || o.nthreads[i] > BENCH_MAX_THREADS)
+            return cdb2_bench_usage();
+    }
+
+    snprintf(scratch, sizeof(scratch), "%s/cdb2_bench.XXXXXX", dir);
+    if (mkdtemp(scratch) == NULL) {
+        fprintf(stderr, "mkdtemp %s: %s\n", scratch, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (outfile && (out = fopen(outfile, "w")) == NULL) {
+        fprintf(stderr, "%s: %s\n", outfile, strerror(errno));
+        remove_dir(scratch);
+        return EXIT_FAILURE;
+    }
+
+    gethostname(host, sizeof(host) - 1);
+    db_version(&major, &minor, &patch);
+    fprintf(out,
+            "{\"tool\": \"cdb2_bench\", \"berkdb\": \"%d.%d.%d\", "
+            "\"host\": \"%s\", \"time\": %ld,\n"
+            " \"ops_per_thread\": %d, \"keys\": %d, \"nexts\": %d, "
+            "\"recsz\": %d, \"cachesz\": %d, \"logflush\": %d,\n"
+            " \"results\": [\n",
+            major, minor, patch, host, (long)time(NULL), o.nops, o.nkeys,
+            o.nnext, o.recsz, o.cachesz, o.logflush);
+
+    for (int i = 0; i < (int)NBENCHES; i++) {
+        struct bench *b = &benches[i];
+        if (o.only && !strstr(o.only, b->name))
+            continue;
+        b->o = &o;
+        for (int j = 0; j < o.nthreadcounts; j++) {
+            if (run_bench(out, b, scratch, o.nthreads[j], first) == 0)
+                first = 0;
+            else
+                rc = EXIT_FAILURE;
+        }
+    }
+    fprintf(out, "\n ]}\n");
+
+    if (out != stdout)
+        fclose(out);
+    remove_dir(scratch);
+    return rc;
+}
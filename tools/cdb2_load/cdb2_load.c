@@ -87,7 +87,7 @@ tool_cdb2_load_main(argc, argv)
 	DB_ENV	*dbenv;
 	LDG ldg;
 	u_int32_t ldf;
-	int ch, existed, exitval, ret;
+	int ch, existed, exitval, ret, mb;
 	char **clist, **clp;
 
 	ldg.progname = "cdb2_load";
@@ -114,8 +114,23 @@ tool_cdb2_load_main(argc, argv)
 		return (EXIT_FAILURE);
 	}
 
-	while ((ch = getopt(argc, argv, "c:f:h:nP:Tt:V")) != EOF)
+	while ((ch = getopt(argc, argv, "C:c:f:h:nP:Tt:V")) != EOF)
 		switch (ch) {
+		case 'C':
+			/*
+			 * The default cache only holds a few pages, so a big
+			 * load rereads its interior pages from disk all the
+			 * time.  Let the caller size it.
+			 */
+			mb = atoi(optarg);
+			if (mb <= 0 || mb >= 4096) {
+				fprintf(stderr,
+				    "%s: cache size must be 1-4095 megabytes\n",
+				    ldg.progname);
+				return (EXIT_FAILURE);
+			}
+			ldg.cache = (u_int32_t)mb * MEGABYTE;
+			break;
 		case 'c':
 			*clp++ = optarg;
 			break;
@@ -1251,7 +1266,7 @@ static int
 cdb2_load_usage()
 {
 	(void)fprintf(stderr, "%s\n\t%s\n",
-	    "usage: cdb2_load [-nTV] [-c name=value] [-f file]",
+	    "usage: cdb2_load [-nTV] [-C megabytes] [-c name=value] [-f file]",
     "[-h home] [-P password] [-t btree | hash | recno | queue] db_file");
 	return (EXIT_FAILURE);
 }
@@ -34,23 +34,68 @@
 #include <list>
 #include <map>
 #include <algorithm>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include <unistd.h>
+#include <zlib.h>
 
 #include "assert.h"
 #include "cdb2api.h"
 #include "cson_amalgamation_core.h"
 
 static cdb2_hndl_tp *cdb2h = nullptr;
+static std::mutex sqltrack_lk;
 std::map<std::string, std::string> sqltrack;
+static std::mutex transactions_lk;
 std::map<std::string, std::list<cson_value*>> transactions;
 
+static const char *dbname;
+static const char *tier;
+static bool quiet = false;
+static bool per_connection = false;
+static bool report = false;
+static double speedup = 0; /* 0: as fast as possible */
+
+typedef std::chrono::steady_clock replay_clock;
+static replay_clock::time_point replay_start;
+static int64_t capture_start = -1; /* "time" of the first event, in us */
+
+/* Per fingerprint latencies.  Bucket i counts statements that took
+   [2^(i-1), 2^i) microseconds. */
+#define NBUCKETS 32
+struct fpstats {
+    int64_t count = 0;
+    int64_t errors = 0;
+    int64_t total_us = 0;
+    int64_t max_us = 0;
+    int64_t buckets[NBUCKETS] = {0};
+};
+static std::mutex stats_lk;
+static std::map<std::string, fpstats> stats;
+static int64_t max_lag_us = 0; /* furthest behind the capture's schedule */
+
 void replay(cdb2_hndl_tp *db, cson_value *val);
 
 static const char *usage_text = 
-    "Usage: cdb2sqlreplay [-f] dbname [FILE]\n"
+    "Usage: cdb2sqlreplay [options] dbname [FILE]\n"
+    "       cdb2sqlreplay -J [FILE]\n"
+    "\n"
+    "FILE is an eventlog, json or binary, and may be gzipped.\n"
     "\n"
     "Basic options:\n"
-    "  -f                Run the sql as fast as possible\n";
+    "  -f                Run the sql as fast as possible (default)\n"
+    "  -s N              Keep the original spacing between statements,\n"
+    "                    sped up N times (-s 1 for the original timing)\n"
+    "  -c                Replay each connection of the capture on its own\n"
+    "                    handle and thread, implies -q\n"
+    "  -q                Don't print statements, bindings or rows\n"
+    "  -r                Report latencies per fingerprint and throughput\n"
+    "  -t TIER           Connect to TIER (default: \"default\" if CDB2_CONFIG\n"
+    "                    is set, otherwise \"local\")\n"
+    "  -J                Don't replay, write the events to stdout as json\n";
 
 /* Start of functions */
 void usage() {
@@ -61,8 +106,12 @@ void usage() {
 
 void add_fingerprint(std::string fingerprint, std::string sql) {
     std::pair<std::string, std::string> v(fingerprint, sql);
-    sqltrack.insert(v);
-    std::cout << fingerprint << " -> " << sql << std::endl;
+    {
+        std::lock_guard<std::mutex> lk(sqltrack_lk);
+        sqltrack.insert(v);
+    }
+    if (!quiet)
+        std::cout << fingerprint << " -> " << sql << std::endl;
 }
 
 static bool get_ispropnull(cson_value *objval, const char *key) 
@@ -156,11 +205,13 @@ bool event_is_sql(cson_value *val) {
 void replay_transaction(cdb2_hndl_tp *db, std::list<cson_value*> &list) {
     cson_value *statement;
 
-    std::cout << "replay" << std::endl;
+    if (!quiet)
+        std::cout << "replay" << std::endl;
 
     auto it = list.begin();
     while (it != list.end()) {
-        std::cout << "replaying txn" << std::endl;
+        if (!quiet)
+            std::cout << "replaying txn" << std::endl;
         if (event_is_sql(*it))
             replay(db, *it);
         
@@ -173,16 +224,19 @@ void add_to_transaction(cdb2_hndl_tp *db, cson_value *val) {
     const char *s = get_strprop(val, "id");
     const char *type = get_strprop(val, "type");
 
+    std::lock_guard<std::mutex> lk(transactions_lk);
     auto i = transactions.find(s);
     if (i == transactions.end()) {
-        std::cout << "new transaction " << s << std::endl;
+        if (!quiet)
+            std::cout << "new transaction " << s << std::endl;
         std::list<cson_value*> statements;
         statements.push_back(val);
         transactions.insert(std::pair<std::string, std::list<cson_value*>>(s, statements));
     }
     else {
         auto &list = (*i).second;
-        std::cout << "add to existing transaction " << list.size() << " (" << event_is_txn(list.front()) <<  ") " << s << std::endl;
+        if (!quiet)
+            std::cout << "add to existing transaction " << list.size() << " (" << event_is_txn(list.front()) <<  ") " << s << std::endl;
         if (list.size() == 1 && event_is_txn(list.front())) {
             /* This is a single statement, and we just saw it's transaction.  We can 
                now replay the whole list. */
@@ -228,37 +282,44 @@ bool do_bindings(cdb2_hndl_tp *db, cson_value *event_val,
         int ret;
         if(get_ispropnull(bp, "value")) {
             /* bind null value as type INT for simplicity */
-            if ((ret = cdb2_bind_param(cdb2h, name, CDB2_INTEGER, NULL, 0)) != 0) {
+            if ((ret = cdb2_bind_param(db, name, CDB2_INTEGER, NULL, 0)) != 0) {
                 std::cerr << "error binding column " << name << ", ret=" << ret << std::endl;
                 return false;
             }
-            std::cout << "binding "<< type << " column " << name << " to NULL " << std::endl;
+            if (!quiet)
+                std::cout << "binding "<< type << " column " << name << " to NULL " << std::endl;
         }
         else if (strcmp(type, "largeint") == 0 || strcmp(type, "int") == 0 || strcmp(type, "smallint") == 0) {
-            int64_t *iv = new int64_t;
+            int64_t *iv = (int64_t *) malloc(sizeof(int64_t));
+            assert(iv != NULL);
+            blobs_vect.push_back((uint8_t *) iv);
             bool succ = get_intprop(bp, "value", iv);
             if (!succ) {
                 std::cerr << "error getting " << type << " value of bound parameter " << name << std::endl;
                 return false;
             }
-            if ((ret = cdb2_bind_param(cdb2h, name, CDB2_INTEGER, iv, sizeof(*iv))) != 0) {
+            if ((ret = cdb2_bind_param(db, name, CDB2_INTEGER, iv, sizeof(*iv))) != 0) {
                 std::cerr << "error binding column " << name << ", ret=" << ret << std::endl;
                 return false;
             }
-            std::cout << "binding "<< type << " column " << name << " to value " << *iv << std::endl;
+            if (!quiet)
+                std::cout << "binding "<< type << " column " << name << " to value " << *iv << std::endl;
         } 
         else if (strcmp(type, "float") == 0 || strcmp(type, "doublefloat") == 0) {
-            double *dv = new double;
+            double *dv = (double *) malloc(sizeof(double));
+            assert(dv != NULL);
+            blobs_vect.push_back((uint8_t *) dv);
             bool succ = get_doubleprop(bp, "value", dv);
             if (!succ) {
                 std::cerr << "error getting " << type << " value of bound parameter " << name << std::endl;
                 return false;
             }
-            if ((ret = cdb2_bind_param(cdb2h, name, CDB2_REAL, dv, sizeof(*dv))) != 0) {
+            if ((ret = cdb2_bind_param(db, name, CDB2_REAL, dv, sizeof(*dv))) != 0) {
                 std::cerr << "error binding column " << name << ", ret=" << ret << std::endl;
                 return false;
             }
-            std::cout << "binding "<< type << " column " << name << " to value " << *dv << std::endl;
+            if (!quiet)
+                std::cout << "binding "<< type << " column " << name << " to value " << *dv << std::endl;
         }
         else if (strcmp(type, "char") == 0 || strcmp(type, "datetime") == 0 ||
                  strcmp(type, "datetimeus") == 0 ||
@@ -271,11 +332,12 @@ bool do_bindings(cdb2_hndl_tp *db, cson_value *event_val,
                 std::cerr << "error getting " << type << " value of bound parameter " << name << std::endl;
                 return false;
             }
-            if ((ret = cdb2_bind_param(cdb2h, name, CDB2_CSTRING, strp, strlen(strp) )) != 0) {
+            if ((ret = cdb2_bind_param(db, name, CDB2_CSTRING, strp, strlen(strp) )) != 0) {
                 std::cerr << "error binding column " << name << ", ret=" << ret << std::endl;
                 return false;
             }
-            std::cout << "binding "<< type << " column " << name << " to value " << strp << std::endl;
+            if (!quiet)
+                std::cout << "binding "<< type << " column " << name << " to value " << strp << std::endl;
         }
         else if( strcmp(type, "byte") == 0 || strcmp(type, "blob") == 0) {
             const char *strp = get_strprop(bp, "value");
@@ -293,14 +355,15 @@ bool do_bindings(cdb2_hndl_tp *db, cson_value *event_val,
             fromhex(unexpanded, (const uint8_t *) strp + 2, slen); /* no x' */
             unexpanded[unexlen] = '\0';
 
-            if ((ret = cdb2_bind_param(cdb2h, name, CDB2_BLOB, unexpanded, unexlen)) != 0) {
+            if ((ret = cdb2_bind_param(db, name, CDB2_BLOB, unexpanded, unexlen)) != 0) {
                 std::cerr << "error binding column " << name << ", ret=" << ret << std::endl;
                 free(unexpanded);
                 return false;
             }
 
             blobs_vect.push_back(unexpanded);
-            std::cout << "binding "<< type << " column " << name << " to value " << strp << std::endl;
+            if (!quiet)
+                std::cout << "binding "<< type << " column " << name << " to value " << strp << std::endl;
         }
         else
             std::cout << "error binding unknown "<< type << " column " << name << std::endl;
@@ -448,20 +511,117 @@ inline void free_blobs(std::vector<uint8_t *> &blobs_vect) {
         free(*it);
 }
 
+static int64_t elapsed_us(replay_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               replay_clock::now() - since).count();
+}
+
+/* With -s, wait until the event is due: its offset from the first event
+   in the capture, divided by the speedup. */
+static void wait_until_due(cson_value *event_val) {
+    int64_t t;
+    if (speedup <= 0 || !get_intprop(event_val, "time", &t) ||
+        capture_start < 0)
+        return;
+
+    int64_t due = (int64_t)((t - capture_start) / speedup);
+    int64_t now = elapsed_us(replay_start);
+    if (due > now) {
+        std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+    } else if (report) {
+        std::lock_guard<std::mutex> lk(stats_lk);
+        if (now - due > max_lag_us)
+            max_lag_us = now - due;
+    }
+}
+
+static void record_latency(const char *fp, int64_t us, bool failed) {
+    if (!report)
+        return;
+    int b = 0;
+    while (b < NBUCKETS - 1 && (1LL << b) <= us)
+        b++;
+
+    std::lock_guard<std::mutex> lk(stats_lk);
+    fpstats &st = stats[fp ? fp : "unknown"];
+    st.count++;
+    if (failed)
+        st.errors++;
+    st.total_us += us;
+    if (us > st.max_us)
+        st.max_us = us;
+    st.buckets[b]++;
+}
+
+/* Upper bound of the bucket holding the given percentile */
+static int64_t percentile_us(const fpstats &st, double pct) {
+    int64_t want = (int64_t)(st.count * pct / 100.0 + 0.5), seen = 0;
+    for (int b = 0; b < NBUCKETS; b++) {
+        seen += st.buckets[b];
+        if (seen >= want && seen > 0)
+            return std::min((int64_t)1 << b, st.max_us);
+    }
+    return st.max_us;
+}
+
+static void print_report(int64_t wall_us) {
+    int64_t total = 0, errors = 0;
+
+    std::lock_guard<std::mutex> lk(stats_lk);
+    for (auto &i : stats) {
+        total += i.second.count;
+        errors += i.second.errors;
+    }
+    double secs = wall_us / 1000000.0;
+    printf("replayed %lld statements (%lld errors) in %.3f seconds, "
+           "%.1f statements/sec\n",
+           (long long)total, (long long)errors, secs,
+           secs > 0 ? total / secs : 0.0);
+    if (speedup > 0)
+        printf("speedup %gx, at most %lld us behind schedule\n", speedup,
+               (long long)max_lag_us);
+
+    for (auto &i : stats) {
+        const fpstats &st = i.second;
+        std::string sql;
+        {
+            std::lock_guard<std::mutex> slk(sqltrack_lk);
+            auto s = sqltrack.find(i.first);
+            if (s != sqltrack.end())
+                sql = s->second.substr(0, 60);
+        }
+        printf("\n%s %s\n", i.first.c_str(), sql.c_str());
+        printf("  count %lld errors %lld avg %lld p50 %lld p90 %lld p99 %lld "
+               "max %lld (us)\n",
+               (long long)st.count, (long long)st.errors,
+               (long long)(st.total_us / st.count),
+               (long long)percentile_us(st, 50), (long long)percentile_us(st, 90),
+               (long long)percentile_us(st, 99), (long long)st.max_us);
+        for (int b = 0; b < NBUCKETS; b++) {
+            if (st.buckets[b])
+                printf("  < %10lld us %lld\n", 1LL << b,
+                       (long long)st.buckets[b]);
+        }
+    }
+}
+
 void replay(cdb2_hndl_tp *db, cson_value *event_val) {
     const char *sql = get_strprop(event_val, "sql");
+    const char *fp = get_strprop(event_val, "fingerprint");
+    std::string tracked;
     if(sql == nullptr) {
-	    const char *fp = get_strprop(event_val, "fingerprint");
 	    if (fp == nullptr) {
 		    std::cerr << "No fingerprint logged?" << std::endl;
 		    return;
 	    }
+	    std::lock_guard<std::mutex> lk(sqltrack_lk);
 	    auto s = sqltrack.find(fp);
 	    if (s == sqltrack.end()) {
 		    std::cerr << "Unknown fingerprint? " << fp << std::endl;
 		    return;
 	    }
-	    sql = (*s).second.c_str();
+	    tracked = (*s).second;
+	    sql = tracked.c_str();
     }
 
     std::vector<uint8_t *> blobs_vect;
@@ -471,12 +631,17 @@ void replay(cdb2_hndl_tp *db, cson_value *event_val) {
         return;
     }
 
-    std::cout << sql << std::endl;
+    wait_until_due(event_val);
+
+    if (!quiet)
+        std::cout << sql << std::endl;
+    replay_clock::time_point start = replay_clock::now();
     int rc = cdb2_run_statement(db, sql);
     cdb2_clearbindings(db);
     free_blobs(blobs_vect);
 
     if (rc != CDB2_OK) {
+        record_latency(fp, elapsed_us(start), true);
         std::cerr << "run rc " << rc << ": " << cdb2_errstr(db) << std::endl;
         return;
     }
@@ -484,6 +649,8 @@ void replay(cdb2_hndl_tp *db, cson_value *event_val) {
     /* TODO: have switch to print or not results */
     int ncols = cdb2_numcolumns(db);
     while ((rc = cdb2_next_record(db)) == CDB2_OK) {
+        if (quiet)
+            continue;
         for (int col = 0; col < ncols; col++) {
             void *val = cdb2_column_value(db, col);
             if (val == NULL) {
@@ -497,6 +664,7 @@ void replay(cdb2_hndl_tp *db, cson_value *event_val) {
         }
         std::cout << std::endl;
     }
+    record_latency(fp, elapsed_us(start), rc != CDB2_OK_DONE);
     if (rc != CDB2_OK_DONE) {
         std::cerr << "next rc " << rc << ": " << cdb2_errstr(db) << std::endl;
         return;
@@ -595,79 +763,420 @@ void handle(cdb2_hndl_tp *db, const char *event, cson_value *event_val) {
         h->second(db, event_val);
 }
 
-void process_events(cdb2_hndl_tp *db, std::istream &in) {
-    std::string line;
-    int linenum = 0;
+/* With -c, every connection in the capture gets its own handle and thread,
+   so statements from one connection stay in order while connections run
+   concurrently, as they did when the capture was taken. */
+struct connection {
+    int64_t connid;
+    cdb2_hndl_tp *db = nullptr;
+    std::thread thr;
+    std::mutex lk;
+    std::condition_variable cv;
+    std::deque<std::pair<std::string, cson_value *>> events;
+    bool done = false;
+};
+static std::map<int64_t, connection *> connections;
+
+static void connection_thread(connection *c) {
+    int rc;
+    if ((rc = cdb2_open(&c->db, dbname, tier, 0)) != 0)
+        std::cerr << "cdb2_open() failed for connection " << c->connid << ": "
+                  << cdb2_errstr(c->db) << std::endl;
+
+    while (1) {
+        std::unique_lock<std::mutex> lk(c->lk);
+        c->cv.wait(lk, [c] { return c->done || !c->events.empty(); });
+        if (c->events.empty())
+            break;
+        auto ev = c->events.front();
+        c->events.pop_front();
+        lk.unlock();
+
+        if (rc == 0)
+            handle(c->db, ev.first.c_str(), ev.second);
+        else
+            cson_free_value(ev.second);
+    }
+    cdb2_close(c->db);
+}
+
+static void dispatch(cson_value *event_val, const char *type) {
+    int64_t connid = 0;
+    get_intprop(event_val, "connid", &connid);
+
+    connection *c;
+    auto i = connections.find(connid);
+    if (i == connections.end()) {
+        c = new connection;
+        c->connid = connid;
+        connections[connid] = c;
+        c->thr = std::thread(connection_thread, c);
+    } else {
+        c = i->second;
+    }
+
+    std::lock_guard<std::mutex> lk(c->lk);
+    c->events.push_back(std::make_pair(std::string(type), event_val));
+    c->cv.notify_one();
+}
 
-    while (std::getline(in, line)) {
-        int rc;
-        linenum++;
+static void finish_connections(void) {
+    for (auto &i : connections) {
+        connection *c = i.second;
+        {
+            std::lock_guard<std::mutex> lk(c->lk);
+            c->done = true;
+            c->cv.notify_one();
+        }
+        c->thr.join();
+        delete c;
+    }
+    connections.clear();
+}
+
+/* Don't read further ahead of the schedule than this, so a long capture
+   isn't all held in memory */
+#define READAHEAD_US 1000000
+
+static void process_event(cdb2_hndl_tp *db, cson_value *event_val) {
+    const char *type = get_strprop(event_val, "type");
+    if (type == nullptr) {
+        cson_free_value(event_val);
+        return;
+    }
+
+    int64_t t;
+    if (get_intprop(event_val, "time", &t)) {
+        if (capture_start < 0)
+            capture_start = t;
+        if (per_connection && speedup > 0) {
+            int64_t due = (int64_t)((t - capture_start) / speedup);
+            int64_t ahead = due - elapsed_us(replay_start) - READAHEAD_US;
+            if (ahead > 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(ahead));
+        }
+    }
+
+    /* newsql events are needed by every connection, and always come
+       before the statements that use them */
+    if (per_connection && strcmp(type, "newsql") != 0 &&
+        handlers.find(type) != handlers.end())
+        dispatch(event_val, type);
+    else
+        handle(db, type, event_val);
+}
+
+/* The binary eventlog format; see db/eventlog.c */
+#define EVENTLOG_BIN_MAGIC "CDB2EVLG"
+#define EVENTLOG_BIN_MAGICSZ 8
+#define EVENTLOG_BIN_VERSION 1
+#define EVENTLOG_BIN_MAXDEPTH 256
+
+struct bin_reader {
+    const unsigned char *p;
+    const unsigned char *end;
+};
+
+static bool bin_get(bin_reader &r, size_t n, const unsigned char **out) {
+    if ((size_t)(r.end - r.p) < n)
+        return false;
+    *out = r.p;
+    r.p += n;
+    return true;
+}
+
+static bool bin_u32(bin_reader &r, uint32_t *v) {
+    const unsigned char *b;
+    if (!bin_get(r, 4, &b))
+        return false;
+    *v = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+         ((uint32_t)b[2] << 8) | b[3];
+    return true;
+}
+
+static bool bin_u64(bin_reader &r, uint64_t *v) {
+    const unsigned char *b;
+    if (!bin_get(r, 8, &b))
+        return false;
+    *v = 0;
+    for (int i = 0; i < 8; i++)
+        *v = (*v << 8) | b[i];
+    return true;
+}
+
+static bool bin_bytes(bin_reader &r, std::string &s) {
+    uint32_t len;
+    const unsigned char *b;
+    if (!bin_u32(r, &len) || !bin_get(r, len, &b))
+        return false;
+    s.assign((const char *)b, len);
+    return true;
+}
+
+/* nullptr if the encoding is bad */
+static cson_value *bin_value(bin_reader &r, int depth) {
+    const unsigned char *tag;
+    uint32_t n;
+    uint64_t u;
+    std::string s;
+
+    if (depth > EVENTLOG_BIN_MAXDEPTH || !bin_get(r, 1, &tag))
+        return nullptr;
+    switch (*tag) {
+    case 'o': {
+        if (!bin_u32(r, &n))
+            return nullptr;
+        cson_value *v = cson_value_new_object();
+        cson_object *obj = cson_value_get_object(v);
+        for (uint32_t i = 0; i < n; i++) {
+            cson_value *e;
+            if (!bin_bytes(r, s) || (e = bin_value(r, depth + 1)) == nullptr) {
+                cson_value_free(v);
+                return nullptr;
+            }
+            cson_object_set(obj, s.c_str(), e);
+        }
+        return v;
+    }
+    case 'a': {
+        if (!bin_u32(r, &n))
+            return nullptr;
+        cson_value *v = cson_value_new_array();
+        cson_array *arr = cson_value_get_array(v);
+        for (uint32_t i = 0; i < n; i++) {
+            cson_value *e = bin_value(r, depth + 1);
+            if (e == nullptr) {
+                cson_value_free(v);
+                return nullptr;
+            }
+            cson_array_append(arr, e);
+        }
+        return v;
+    }
+    case 's':
+        if (!bin_bytes(r, s))
+            return nullptr;
+        return cson_value_new_string(s.data(), s.length());
+    case 'i':
+        if (!bin_u64(r, &u))
+            return nullptr;
+        return cson_value_new_integer((cson_int_t)(int64_t)u);
+    case 'd': {
+        double d;
+        if (!bin_u64(r, &u))
+            return nullptr;
+        memcpy(&d, &u, sizeof(d));
+        return cson_value_new_double(d);
+    }
+    case 't':
+        return cson_value_true();
+    case 'f':
+        return cson_value_false();
+    case 'n':
+        return cson_value_null();
+    default:
+        return nullptr;
+    }
+}
+
+static bool gzread_all(gzFile in, void *buf, unsigned int n) {
+    return gzread(in, buf, n) == (int)n;
+}
+
+/* Calls fn on every event in the log, json or binary, plain or gzipped,
+   and returns how many lines or records there were */
+template <typename F>
+static int read_events(gzFile in, F fn) {
+    char magic[EVENTLOG_BIN_MAGICSZ];
+    int nread = 0;
+    int n;
+
+    n = gzread(in, magic, sizeof(magic));
+    if (n == (int)sizeof(magic) &&
+        memcmp(magic, EVENTLOG_BIN_MAGIC, sizeof(magic)) == 0) {
+        unsigned char hdr[4];
+        std::vector<unsigned char> rec;
+
+        if (!gzread_all(in, hdr, sizeof(hdr))) {
+            std::cerr << "Truncated header" << std::endl;
+            return 0;
+        }
+        uint32_t version = ((uint32_t)hdr[0] << 24) | ((uint32_t)hdr[1] << 16) |
+                           ((uint32_t)hdr[2] << 8) | hdr[3];
+        if (version != EVENTLOG_BIN_VERSION) {
+            std::cerr << "Unsupported eventlog version " << version << std::endl;
+            return 0;
+        }
+        while (gzread_all(in, hdr, sizeof(hdr))) {
+            uint32_t len = ((uint32_t)hdr[0] << 24) | ((uint32_t)hdr[1] << 16) |
+                           ((uint32_t)hdr[2] << 8) | hdr[3];
+            nread++;
+            rec.resize(len);
+            if (len > 0 && !gzread_all(in, rec.data(), len)) {
+                std::cerr << "Truncated record " << nread << std::endl;
+                break;
+            }
+            bin_reader r = {rec.data(), rec.data() + len};
+            cson_value *event_val = bin_value(r, 0);
+            if (event_val == nullptr) {
+                std::cerr << "Malformed record " << nread << std::endl;
+                continue;
+            }
+            if (!cson_value_is_object(event_val)) {
+                std::cerr << "Not an object in record " << nread << std::endl;
+                cson_value_free(event_val);
+                continue;
+            }
+            fn(event_val);
+        }
+        return nread;
+    }
+
+    std::string line;
+    char buf[4096];
+    if (n > 0)
+        line.assign(magic, n);
+    while (true) {
+        size_t nl;
+        while ((nl = line.find('\n')) == std::string::npos) {
+            if (gzgets(in, buf, sizeof(buf)) == nullptr)
+                break;
+            line.append(buf);
+        }
+        if (nl == std::string::npos && line.empty())
+            break;
+        std::string json = line.substr(0, nl);
+        line.erase(0, nl == std::string::npos ? line.length() : nl + 1);
+        nread++;
 
         cson_value *event_val;
         cson_parse_info pinfo = cson_parse_info_empty_m;
 
-        rc = cson_parse_string(&event_val, line.c_str(), line.length(), &cson_parse_opt_empty, &pinfo);
+        int rc = cson_parse_string(&event_val, json.c_str(), json.length(), &cson_parse_opt_empty, &pinfo);
         if (rc) {
-            std::cerr << "Malformed input on line " << linenum << std::endl;
+            std::cerr << "Malformed input on line " << nread << std::endl;
             continue;
         }
         if (!cson_value_is_object(event_val)) {
-            std::cerr << "Not an object  on line " << linenum << std::endl;
+            std::cerr << "Not an object  on line " << nread << std::endl;
             continue;
         }
-        const char *type = get_strprop(event_val, "type");
-
-        if (type != nullptr)
-            handle(cdb2h, type, event_val);
-        else
-            cson_free_value(event_val);
+        fn(event_val);
     }
-    std::cout << "got " << linenum  << " lines" << std::endl;
+    return nread;
+}
+
+void process_events(cdb2_hndl_tp *db, gzFile in) {
+    int linenum = read_events(in, [db](cson_value *v) { process_event(db, v); });
+    finish_connections();
+    if (!quiet)
+        std::cout << "got " << linenum  << " lines" << std::endl;
+}
+
+/* -J: write the log out as json, one event per line, like the server does */
+static int convert_events(gzFile in) {
+    cson_output_opt opt = cson_output_opt_empty;
+    opt.indentation = 0;
+    opt.maxDepth = 4096;
+    opt.addNewline = 1;
+    opt.addSpaceAfterColon = 1;
+    opt.indentSingleMemberValues = 0;
+    opt.escapeForwardSlashes = 1;
+
+    int rc = 0;
+    read_events(in, [&](cson_value *v) {
+        if (cson_output_FILE(v, stdout, &opt))
+            rc = 1;
+        cson_value_free(v);
+    });
+    return rc;
 }
 
 int main(int argc, char **argv) {
-    char *dbname;
     char *filename = nullptr;
+    bool to_json = false;
+    gzFile in;
+    int c;
 
     init_handlers();
 
-    if (argc < 2) {
+    while ((c = getopt(argc, argv, "fs:cqrt:J")) != -1) {
+        switch (c) {
+        case 'f':
+            speedup = 0;
+            break;
+        case 's':
+            speedup = atof(optarg);
+            if (speedup <= 0)
+                usage();
+            break;
+        case 'c':
+            per_connection = true;
+            quiet = true;
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        case 'r':
+            report = true;
+            break;
+        case 't':
+            tier = optarg;
+            break;
+        case 'J':
+            to_json = true;
+            break;
+        default:
+            usage();
+        }
+    }
+
+    if (to_json) {
+        if (optind < argc)
+            filename = argv[optind];
+        in = filename ? gzopen(filename, "r") : gzdopen(0, "r");
+        if (in == nullptr) {
+            std::cerr << "Can't open " << (filename ? filename : "stdin") << ": " << strerror(errno) << std::endl;
+            return 1;
+        }
+        int rc = convert_events(in);
+        gzclose(in);
+        return rc;
+    }
+
+    if (optind >= argc) {
         usage();
     }
-    dbname = argv[1];
+    dbname = argv[optind];
 
-    if (argc >= 3)
-        filename = argv[2];
+    if (optind + 1 < argc)
+        filename = argv[optind + 1];
 
-    /* TODO: tier should be an option */
     int rc;
     char *conf = getenv("CDB2_CONFIG");
-    if (conf) {
+    if (conf)
         cdb2_set_comdb2db_config(conf);
-        rc = cdb2_open(&cdb2h, dbname, "default", 0);
-    }
-    else { 
-        rc = cdb2_open(&cdb2h, dbname, "local", 0);
-    }
+    if (tier == nullptr)
+        tier = conf ? "default" : "local";
+    rc = cdb2_open(&cdb2h, dbname, tier, 0);
 
     if (rc) {
         std::cerr << "cdb2_open() failed: " << cdb2_errstr(cdb2h) << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    if (filename == nullptr) {
-        process_events(cdb2h, std::cin);
+    /* gzread passes uncompressed input through as is */
+    in = filename ? gzopen(filename, "r") : gzdopen(0, "r");
+    if (in == nullptr) {
+        std::cerr << "Can't open " << (filename ? filename : "stdin") << ": " << strerror(errno) << std::endl;
+        return 1;
     }
-    else {
-        std::ifstream f;
-        f.open(filename);
-        if (!f.good()) {
-            std::cerr << "Can't open " << filename << ": " << strerror(errno) << std::endl;
-            return 1;
-        }
+    replay_start = replay_clock::now();
+    process_events(cdb2h, in);
+    gzclose(in);
 
-        process_events(cdb2h, f);
-    }
+    if (report)
+        print_report(elapsed_us(replay_start));
 
     // cdb2_close(cdb2h);
     return 0;
@@ -90,6 +90,10 @@ struct client {
 
     struct stats stats;
 
+    /* uid of the client process, for the ssl sessions it may have */
+    uid_t uid;
+    int have_uid;
+
     /* linked list of all clients */
     LINKC_T(struct client) linkv;
 };
@@ -133,6 +137,25 @@ static pthread_mutex_t gbl_port_hints_lock = PTHREAD_MUTEX_INITIALIZER;
 static hash_t *port_hints = NULL;
 static int num_port_hints = 0;
 
+/* SSL sessions clients have handed us for others of the same user to resume,
+   so a process new to a database doesn't have to do a full handshake */
+struct ssl_session_key {
+    uid_t uid;
+    char typestr[48];
+};
+
+struct ssl_session {
+    struct ssl_session_key key;
+    time_t expires;
+    int len;
+    LINKC_T(struct ssl_session) linkv;
+    unsigned char der[1];
+};
+
+static pthread_mutex_t ssl_sessions_lock = PTHREAD_MUTEX_INITIALIZER;
+static hash_t *ssl_sessions = NULL;
+static LISTC_T(struct ssl_session) ssl_session_list; /* oldest first */
+
 static int pthread_create_attrs(pthread_t *tid, int detachstate,
                                 size_t stacksize,
                                 void *(*start_routine)(void *), void *arg)
@@ -238,6 +261,102 @@ int recvall(int fd, void *bufp, int len)
     return 0;
 }
 
+static int sendall(int fd, const void *bufp, int len)
+{
+    const uint8_t *buf = (const uint8_t *)bufp;
+    int rc;
+
+    while (len > 0) {
+        rc = send(fd, buf, len, MSG_NOSIGNAL);
+        if (rc == -1) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            return -1;
+        }
+        buf += rc;
+        len -= rc;
+    }
+    return 0;
+}
+
+static void ssl_session_del(struct ssl_session *sess)
+{
+    hash_del(ssl_sessions, sess);
+    listc_rfl(&ssl_session_list, sess);
+    free(sess);
+}
+
+static void ssl_session_put(const struct client *clnt, const char *typestr,
+                            const void *der, int len, int timeout)
+{
+    struct ssl_session *sess, *old;
+
+    if (!clnt->have_uid || SSL_SESSIONS_MAX == 0 || timeout <= 0 ||
+        strlen(typestr) >= sizeof(sess->key.typestr))
+        return;
+    if ((sess = calloc(1, offsetof(struct ssl_session, der) + len)) == NULL)
+        return;
+    sess->key.uid = clnt->uid;
+    strcpy(sess->key.typestr, typestr);
+    sess->expires = time(NULL) + timeout;
+    sess->len = len;
+    memcpy(sess->der, der, len);
+
+    LOCK(&ssl_sessions_lock)
+    {
+        if ((old = hash_find(ssl_sessions, &sess->key)) != NULL)
+            ssl_session_del(old);
+        while (listc_size(&ssl_session_list) >= SSL_SESSIONS_MAX)
+            ssl_session_del(ssl_session_list.top);
+        hash_add(ssl_sessions, sess);
+        listc_abl(&ssl_session_list, sess);
+    }
+    UNLOCK(&ssl_sessions_lock);
+}
+
+/* Reply to a get with the session, if there is one for this user */
+static int ssl_session_get(const struct client *clnt, const char *typestr,
+                           struct sockpool_msg_vers0 *msg0)
+{
+    struct ssl_session_key key = {0};
+    struct ssl_session *sess;
+    unsigned char *der = NULL;
+    int rc, len = 0;
+
+    if (clnt->have_uid && strlen(typestr) < sizeof(key.typestr)) {
+        key.uid = clnt->uid;
+        strcpy(key.typestr, typestr);
+        LOCK(&ssl_sessions_lock)
+        {
+            if ((sess = hash_find(ssl_sessions, &key)) != NULL) {
+                if (sess->expires <= time(NULL)) {
+                    ssl_session_del(sess);
+                } else if ((der = malloc(sess->len)) != NULL) {
+                    memcpy(der, sess->der, sess->len);
+                    len = sess->len;
+                }
+            }
+        }
+        UNLOCK(&ssl_sessions_lock);
+    }
+
+    msg0->request = SOCKPOOL_SSL_SESSION_PUT;
+    msg0->dbnum = len;
+    rc = send_fd(clnt->fd, msg0, sizeof(*msg0), -1);
+    if (rc == PASSFD_SUCCESS && len > 0)
+        rc = sendall(clnt->fd, der, len) == 0 ? PASSFD_SUCCESS : -1;
+    free(der);
+    return rc;
+}
+
+static int count_ssl_sessions(void)
+{
+    int count;
+    LOCK(&ssl_sessions_lock) { count = listc_size(&ssl_session_list); }
+    UNLOCK(&ssl_sessions_lock);
+    return count;
+}
+
 enum fsql_request {
 #ifdef _LINUX_SOURCE
     FSQL_RESET = 1811939328
@@ -399,6 +518,15 @@ void *client_thd(void *voidarg)
     struct client clnt = {.fd = fd, .pid = hello.pid, .slot = hello.slot};
     bzero(&clnt.stats, sizeof(clnt.stats));
 
+#ifdef SO_PEERCRED
+    struct ucred cred;
+    socklen_t credlen = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) == 0) {
+        clnt.uid = cred.uid;
+        clnt.have_uid = 1;
+    }
+#endif
+
     rc = cdb2_get_progname_by_pid(clnt.pid, clnt.progname,
                                   sizeof(clnt.progname));
     if (rc != 0) {
@@ -661,6 +789,36 @@ void *client_thd(void *voidarg)
                        typestrbuf, newfd);
             }
 
+        } else if ((request == SOCKPOOL_SSL_SESSION_PUT ||
+                    request == SOCKPOOL_SSL_SESSION_GET) &&
+                   hello.protocol_version == 0) {
+            if (newfd != -1) {
+                syslog(LOG_NOTICE, "%s: unexpectedly received a socket\n",
+                       prefix);
+                close(newfd);
+                break;
+            }
+            if (request == SOCKPOOL_SSL_SESSION_GET) {
+                if (ssl_session_get(&clnt, typestr, &msg0) != PASSFD_SUCCESS) {
+                    syslog(LOG_NOTICE, "%s: error sending ssl session\n",
+                           prefix);
+                    break;
+                }
+                continue;
+            }
+            if (dbnum <= 0 || dbnum > SOCKPOOL_SSL_SESSION_MAX) {
+                syslog(LOG_NOTICE, "%s: invalid ssl session len %d\n", prefix,
+                       dbnum);
+                break;
+            }
+            void *der = malloc(dbnum);
+            if (der == NULL || recvall(fd, der, dbnum)) {
+                syslog(LOG_NOTICE, "%s: error reading ssl session\n", prefix);
+                free(der);
+                break;
+            }
+            ssl_session_put(&clnt, typestr, der, dbnum, timeout);
+            free(der);
         } else if (request == SOCKPOOL_FORGET_PORT) {
             LOCK(&gbl_port_hints_lock)
             {
@@ -832,6 +990,7 @@ static void do_stat(void)
            gbl_stats.fds_requested);
     syslog(LOG_INFO, "fds returned to clients   : %u\n",
            gbl_stats.fds_returned);
+    syslog(LOG_INFO, "ssl sessions kept         : %d\n", count_ssl_sessions());
     syslog(LOG_INFO, "---\n");
     socket_pool_dump_stats_ex(stdout, 0, 1, 0);
     syslog(LOG_INFO, "---\n");
@@ -1169,6 +1328,9 @@ int main(int argc, char *argv[])
     listc_init(&active_list, offsetof(struct db_number_info, linkv));
     listc_init(&client_list, offsetof(struct client, linkv));
     port_hints = hash_init_str(offsetof(struct port_hint, typestr));
+    ssl_sessions = hash_init_o(offsetof(struct ssl_session, key),
+                               sizeof(struct ssl_session_key));
+    listc_init(&ssl_session_list, offsetof(struct ssl_session, linkv));
 
     syslog(LOG_INFO, "Will listen on local domain socket %s\n", unix_bind_path);
 
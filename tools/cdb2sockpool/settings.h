@@ -44,3 +44,6 @@ BOOL_SETTING(EXIT_ON_PIPE_ERROR, 1,
              "exit and turn off paul bit if our pipe is deleted")
 
 BOOL_SETTING(UTIME_ON_PIPE, 1, "periodically update last access time on pipe")
+
+VALUE_SETTING(SSL_SESSIONS_MAX, 1024,
+              "max ssl sessions to keep for clients to resume (0 = none)")
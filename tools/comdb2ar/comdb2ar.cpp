@@ -35,6 +35,8 @@ const char *help_text[] = {
 "  Database mydb is serialised into tape archive format on to stdout.",
 "  -s   serialise support files only (lrl, csc2 etc, no data or log files)",
 "  -L   do not disable log file deletion (dangerous)",
+"  -j N -o prefix   write the data files in parallel to N further archives,",
+"                   prefix.1 to prefix.N; stdout keeps everything else",
 "",
 "To deserialise a db: comdb2ar.tsk [opts] x [/bb/bin /bb/data/mydb] < input",
 "To deserialise a db incrementally:",
@@ -60,6 +62,8 @@ const char *help_text[] = {
 "  -D           turn off directio",
 "  -E dbname    create replicant with dbname",
 "  -T type      override physrep type",
+"  -j N -o prefix  also read the data files from prefix.1 to prefix.N, in",
+"               parallel; N must match the serialising side",
 NULL
 };
 
@@ -115,6 +119,9 @@ int main(int argc, char *argv[])
     std::string new_db_name = "";
     std::string new_type = "default";
 
+    unsigned nstreams = 0;
+    std::string stream_prefix;
+
     // TODO: should really consider using comdb2file.c
     char *s = getenv("COMDB2_ROOT");
     std::string root;
@@ -127,7 +134,7 @@ int main(int argc, char *argv[])
     ss << root << "/bin/comdb2";
     std::string comdb2_task(ss.str());
 
-    while((c = getopt(argc, argv, "hsSLC:I:b:x:u:rRSkKfODE:T:")) != EOF) {
+    while((c = getopt(argc, argv, "hsSLC:I:b:x:u:rRSkKfODE:T:j:o:")) != EOF) {
         switch(c) {
             case 'O':
                 legacy_mode = true;
@@ -230,6 +237,14 @@ int main(int argc, char *argv[])
                 new_type = std::string(optarg);
                 break;
 
+            case 'j':
+                nstreams = std::atoi(optarg);
+                break;
+
+            case 'o':
+                stream_prefix = std::string(optarg);
+                break;
+
             case '?':
                 std::cerr << "Unrecognised option: -" << (char)c << std::endl;
                 usage();
@@ -251,6 +266,17 @@ int main(int argc, char *argv[])
         std::exit(2);
     }
 
+    if(nstreams > 0 && stream_prefix.empty()) {
+        std::cerr << "-j needs -o to name the data stream archives" << std::endl;
+        std::exit(2);
+    }
+
+    if(nstreams > 0 && (incr_gen || incr_create || incr_ex)) {
+        std::cerr << "Data streams are not supported in incremental mode"
+            << std::endl;
+        std::exit(2);
+    }
+
     for(const char *cp = argv[0]; *cp; ++cp) {
         switch(*cp) {
             case 'c':
@@ -307,7 +333,9 @@ int main(int argc, char *argv[])
                 incr_create,
                 incr_gen,
                 copy_physical,
-                incr_path
+                incr_path,
+                nstreams,
+                stream_prefix
             );
         } catch(std::exception& e) {
             std::cerr << e.what() << std::endl;
@@ -348,7 +376,9 @@ int main(int argc, char *argv[])
              is_disk_full,
              run_with_done_file,
              incr_ex,
-             dryrun
+             dryrun,
+             nstreams,
+             stream_prefix
            );
         } catch(std::exception& e) {
             std::cerr << e.what() << std::endl;
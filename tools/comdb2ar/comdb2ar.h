@@ -110,13 +110,18 @@ void serialise_database(
   bool incr_create,
   bool incr_gen,
   bool copy_physical,
-  const std::string& incr_path
+  const std::string& incr_path,
+  unsigned nstreams,
+  const std::string& stream_prefix
 );
 // Serialise a database into tape archive format and write it to stdout.
 // If support_only is true then only support files (lrl and schema) will
 // be serialised.  If disable_log_deletion and the database is running then
 // it will be advised to hold log file deletion until the backup is complete
 // (highly recommended!)
+// If nstreams is not 0 the data files are written in parallel to nstreams
+// further archives, stream_prefix.1 to stream_prefix.N; everything else,
+// including the log files, still goes to stdout.
 // If legacy_mode is enabled, old file format are not removed after restore
 
 
@@ -133,7 +138,9 @@ void deserialise_database(
   bool& is_disk_full,
   bool run_with_done_file,
   bool incr_mode,
-  bool dryrun
+  bool dryrun,
+  unsigned nstreams,
+  const std::string& stream_prefix
 );
 // Deserialise a database from serialised form received on stdin.
 // If lrldestdir and datadestdir are not NULL then the lrl and data files
@@ -145,6 +152,8 @@ void deserialise_database(
 // given by comdb2_task.  If the destination disk reaches or exceeds the
 // specified percent_full during the deserialisation then the operation is
 // halted.
+// If nstreams is not 0 then the data files are read from the archives
+// stream_prefix.1 to stream_prefix.N, in parallel with stdin.
 
 bool isDirectory(const std::string& file);
 
@@ -3,11 +3,13 @@
 #include "error.h"
 
 #include <iostream>
+#include <vector>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
 #include "chksum.h"
+#include "pgcomp.h"
 
 uint32_t myflip(uint32_t in)
 {
@@ -123,6 +125,20 @@ void verify_checksum(uint8_t *page, size_t pagesize, bool crypto, bool swapped,
 // Also call storeIncrData to store the LSN + Checksum in a file to be
 // compared against
 {
+    if (pgcomp_is_compressed(page)) {
+        // Stored compressed (page_compress): verify the page it holds
+        std::vector<uint8_t> inflated(page, page + pagesize);
+        std::vector<uint8_t> scratch(pagesize);
+        if (pgcomp_inflate(inflated.data(), pagesize, scratch.data()) != 0) {
+            *verify_cksum = 0;
+            *verify_bool = false;
+            return;
+        }
+        verify_checksum(inflated.data(), pagesize, crypto, swapped,
+                        verify_bool, verify_cksum);
+        return;
+    }
+
     PAGE *pagep = (PAGE *)page;
     uint8_t *chksum_ptr = page;
 
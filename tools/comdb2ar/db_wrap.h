@@ -32,5 +32,8 @@ void verify_checksum(uint8_t *page, size_t pagesize, bool crypto, bool swap,
 // Verify the checksum on a regular Berkeley DB page.  Returns true if
 // the checksum is correct, false otherwise
 
+uint32_t myflip(uint32_t in);
+// Byte swap a 32 bit value
+
 uint32_t calculate_checksum(uint8_t *page, size_t pagesize);
 #endif // INCLUDED_DB_WRAP
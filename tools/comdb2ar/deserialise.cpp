@@ -19,6 +19,7 @@
 #include <fstream>
 #include <vector>
 #include <memory>
+#include <thread>
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -111,7 +112,8 @@ static void process_manifest(
         std::map<std::string, FileInfo>& manifest_map,
         bool& run_full_recovery,
         std::string& origlrlname,
-        std::vector<std::string> &options
+        std::vector<std::string> &options,
+        unsigned& data_streams
         )
 // Decode the manifest into a map of files and their associated file info
 {
@@ -156,6 +158,8 @@ static void process_manifest(
                 while (ss >> tok) {
                     options.push_back(tok);
                 }
+            } else if (tok == "DataStreams") {
+                ss >> data_streams;
             } else {
                 std::clog << "Unknown directive '" << tok << "' on line "
                     << lineno << " of MANIFEST" << std::endl;
@@ -355,6 +359,266 @@ static bool check_dest_dir(const std::string& dir)
 
 #define write_size (1000*1024)
 
+static void check_disk_space(const std::string& datadestdir,
+        const std::string& filename, unsigned long long nbytes,
+        unsigned percent_full, bool& is_disk_full)
+// Throw if writing nbytes more of filename would fill the destination file
+// system past percent_full
+{
+    struct statvfs stfs;
+    if(statvfs(datadestdir.c_str(), &stfs) == -1) {
+        std::ostringstream ss;
+        ss << "Error running statvfs on " << datadestdir
+            << ": " << strerror(errno);
+        throw Error(ss);
+    }
+
+    fsblkcnt_t fsblocks = nbytes / stfs.f_bsize;
+    double percent_free = 100.00 * ((double)(stfs.f_bavail - fsblocks) / (double)stfs.f_blocks);
+    if(100.00 - percent_free >= percent_full) {
+        is_disk_full = true;
+        std::ostringstream ss;
+        ss << "Not enough space to deserialise " << filename
+            << " (" << nbytes << " bytes) - would leave only "
+            << percent_free << "% free space";
+        throw Error(ss);
+    }
+}
+
+struct DataStream {
+    std::string path;
+    int fd;
+    std::string error;
+    bool is_disk_full;
+
+    DataStream() : fd(-1), is_disk_full(false) {}
+};
+
+static void extract_data_stream(DataStream& ds,
+        const std::string& datadestdir,
+        const std::map<std::string, FileInfo>& manifest_map,
+        unsigned percent_full)
+// Extract one of the data stream archives written by a parallel serialise.
+// These only ever hold data files, which all go into the data directory.
+{
+    static const char zero_head[512] = {0};
+    std::vector<char> empty_page(65536, 0);
+
+    while(true) {
+        tar_block_header head;
+        if(readall(ds.fd, head.c, sizeof(head.c)) != sizeof(head.c)) {
+            std::ostringstream ss;
+            ss << "Error reading tar block header from " << ds.path << ": "
+                << errno << " " << strerror(errno);
+            throw Error(ss);
+        }
+        if(std::memcmp(head.c, zero_head, 512) == 0) {
+            break;
+        }
+
+        if(head.h.filename[sizeof(head.h.filename) - 1] != '\0') {
+            throw Error("Bad block: filename is not null terminated");
+        }
+        const std::string filename(head.h.filename);
+
+        unsigned long long filesize;
+        if(!read_octal_ull(head.h.size, sizeof(head.h.size), filesize)) {
+            throw Error("Bad block: bad size");
+        }
+        unsigned long long nblocks = (filesize + 511ULL) >> 9;
+
+        check_disk_space(datadestdir, filename, filesize, percent_full,
+                ds.is_disk_full);
+
+        size_t pagesize = 0;
+        bool sparse = false;
+        bool direct = false;
+        std::map<std::string, FileInfo>::const_iterator manifest_it =
+            manifest_map.find(filename);
+        if(manifest_it != manifest_map.end()) {
+            pagesize = manifest_it->second.get_pagesize();
+            sparse = manifest_it->second.get_sparse();
+            direct = manifest_it->second.get_type() == FileInfo::BERKDB_FILE;
+        }
+        if(pagesize == 0 || pagesize > empty_page.size()) {
+            pagesize = 4096;
+            sparse = false;
+        }
+        size_t bufsize = pagesize;
+        while((bufsize << 1) <= MAX_BUF_SIZE) {
+            bufsize <<= 1;
+        }
+
+        std::string outfilename(datadestdir + "/" + filename);
+        std::unique_ptr<fdostream> of_ptr = output_file(outfilename, false, direct);
+
+        uint8_t *buf;
+        if (posix_memalign((void**) &buf, 512, bufsize))
+            throw Error("Failed to allocate output buffer");
+        RIIA_malloc free_guard(buf);
+
+        unsigned long long bytesleft = filesize;
+        unsigned long long skipped_bytes = 0;
+        long long recheck_count = FS_PERIODIC_CHECK;
+        while(bytesleft > 0) {
+            unsigned long long readbytes = sparse ? pagesize : bufsize;
+            if(readbytes > bytesleft) {
+                readbytes = bytesleft;
+            }
+            if(readall(ds.fd, &buf[0], readbytes) != readbytes) {
+                std::ostringstream ss;
+                ss << "Error reading " << readbytes << " bytes for file "
+                    << filename << " from " << ds.path << " after "
+                    << (filesize - bytesleft) << " bytes:"
+                    << errno << " " << strerror(errno);
+                throw Error(ss);
+            }
+
+            // Leave holes for empty pages, but always write the last one so
+            // that the file comes out the right size
+            if(sparse && readbytes == pagesize && bytesleft > readbytes &&
+                    memcmp(&empty_page[0], &buf[0], pagesize) == 0) {
+                skipped_bytes += pagesize;
+            } else {
+                if(skipped_bytes) {
+                    if(of_ptr->skip(skipped_bytes)) {
+                        std::ostringstream ss;
+                        ss << "Error skipping " << filename << " after "
+                            << (filesize - bytesleft) << " bytes";
+                        throw Error(ss);
+                    }
+                    skipped_bytes = 0;
+                }
+                for(uint64_t off = 0; off < readbytes; off += write_size) {
+                    uint64_t lim = readbytes - off;
+                    if(lim > write_size) {
+                        lim = write_size;
+                    }
+                    if(!of_ptr->write((char*) &buf[off], lim)) {
+                        std::ostringstream ss;
+                        ss << "Error Writing " << filename << " after "
+                            << (filesize - bytesleft) << " bytes";
+                        throw Error(ss);
+                    }
+                }
+                recheck_count -= readbytes;
+            }
+            bytesleft -= readbytes;
+
+            if(recheck_count <= 0) {
+                check_disk_space(datadestdir, filename, bytesleft,
+                        percent_full, ds.is_disk_full);
+                recheck_count = FS_PERIODIC_CHECK;
+            }
+        }
+
+        unsigned long long padding_bytes = (nblocks << 9) - filesize;
+        if(padding_bytes) {
+            if(readall(ds.fd, &buf[0], padding_bytes) != padding_bytes) {
+                std::ostringstream ss;
+                ss << "Error reading padding after " << filename
+                    << ": " << errno << " " << strerror(errno);
+                throw Error(ss);
+            }
+        }
+        of_ptr.reset();
+
+        uid_t uid = (uid_t)strtol(head.h.uid, NULL, 8);
+        gid_t gid = (gid_t)strtol(head.h.gid, NULL, 8);
+        mode_t modes = (mode_t)strtol(head.h.mode, NULL, 8);
+        if (chown(outfilename.c_str(), uid, gid)==-1)
+            perror(outfilename.c_str());
+        if (chmod(outfilename.c_str(), modes)==-1)
+            perror(outfilename.c_str());
+
+        std::clog << "x " << filename << " size=" << filesize
+                  << " pagesize=" << pagesize
+                  << (sparse ? " SPARSE " : " not sparse ") << std::endl;
+    }
+}
+
+class DataStreamReaders {
+// Extracts the data stream archives alongside the main one, a thread per
+// stream.  The threads are always joined before this goes away.
+    std::vector<DataStream> m_streams;
+    std::vector<std::thread> m_threads;
+    std::string m_datadestdir;
+    std::map<std::string, FileInfo> m_manifest_map;
+    unsigned m_percent_full;
+
+    static void run(DataStreamReaders *self, DataStream *ds)
+    {
+        try {
+            extract_data_stream(*ds, self->m_datadestdir,
+                    self->m_manifest_map, self->m_percent_full);
+        } catch(std::exception& e) {
+            ds->error = e.what();
+        }
+    }
+
+public:
+    DataStreamReaders() : m_percent_full(0) {}
+
+    ~DataStreamReaders()
+    {
+        join();
+        for(size_t ii = 0; ii < m_streams.size(); ii++) {
+            if(m_streams[ii].fd != -1) {
+                close(m_streams[ii].fd);
+            }
+        }
+    }
+
+    void start(unsigned nstreams, const std::string& stream_prefix,
+            const std::string& datadestdir,
+            const std::map<std::string, FileInfo>& manifest_map,
+            unsigned percent_full)
+    {
+        m_datadestdir = datadestdir;
+        m_manifest_map = manifest_map;
+        m_percent_full = percent_full;
+        m_streams.resize(nstreams);
+
+        for(unsigned ii = 0; ii < nstreams; ii++) {
+            std::ostringstream ss;
+            ss << stream_prefix << "." << (ii + 1);
+            m_streams[ii].path = ss.str();
+            m_streams[ii].fd = open(m_streams[ii].path.c_str(), O_RDONLY);
+            if(m_streams[ii].fd == -1) {
+                std::ostringstream ss;
+                ss << "Cannot open data stream " << m_streams[ii].path
+                    << ": " << strerror(errno);
+                throw Error(ss);
+            }
+        }
+        for(unsigned ii = 0; ii < nstreams; ii++) {
+            m_threads.push_back(std::thread(run, this, &m_streams[ii]));
+        }
+    }
+
+    void join()
+    {
+        for(size_t ii = 0; ii < m_threads.size(); ii++) {
+            m_threads[ii].join();
+        }
+        m_threads.clear();
+    }
+
+    void finish(bool& is_disk_full)
+    // Wait for all the streams and throw the first error any of them hit
+    {
+        join();
+        for(size_t ii = 0; ii < m_streams.size(); ii++) {
+            if(m_streams[ii].is_disk_full) {
+                is_disk_full = true;
+            }
+            if(!m_streams[ii].error.empty()) {
+                throw Error(m_streams[ii].path + ": " + m_streams[ii].error);
+            }
+        }
+    }
+};
+
 void deserialise_database(
         const std::string *p_lrldestdir,
         const std::string *p_datadestdir,
@@ -368,7 +632,9 @@ void deserialise_database(
         bool& is_disk_full,
         bool run_with_done_file,
         bool incr_mode,
-        bool dryrun
+        bool dryrun,
+        unsigned nstreams,
+        const std::string& stream_prefix
 )
 // Deserialise a database from serialised from received on stdin.
 // If lrldestdir and datadestdir are not NULL then the lrl and data files
@@ -434,6 +700,10 @@ void deserialise_database(
     // The manifest map
     std::map<std::string, FileInfo> manifest_map;
 
+    // Number of data stream archives the manifest says there are
+    unsigned data_streams = 0;
+    DataStreamReaders stream_readers;
+
     if (run_with_done_file)
     {
        /* remove the DONE file before we start copying */
@@ -494,6 +764,19 @@ void deserialise_database(
             }
 
             inited_txn_dir = true;
+
+            // The manifest comes before the lrl, so by now we know whether
+            // the data files are in this archive or in separate streams
+            if(data_streams != nstreams) {
+                std::ostringstream ss;
+                ss << "Archive has " << data_streams << " data streams but "
+                    << nstreams << " were given";
+                throw Error(ss);
+            }
+            if(nstreams > 0) {
+                stream_readers.start(nstreams, stream_prefix, datadestdir,
+                        manifest_map, percent_full);
+            }
         }
 
         // Read the tar block header
@@ -879,7 +1162,8 @@ void deserialise_database(
 		perror(fullpath.c_str());
 
         if(is_manifest) {
-            process_manifest(text, manifest_map, run_full_recovery, origlrlname, options);
+            process_manifest(text, manifest_map, run_full_recovery, origlrlname,
+                    options, data_streams);
 
         } else if(is_lrl) {
 
@@ -929,6 +1213,8 @@ void deserialise_database(
         }
     }
 
+    stream_readers.finish(is_disk_full);
+
     // If we never inited the txn dir then we must never have had a valid lrl;
     // fail in this case.
     if(!inited_txn_dir) {
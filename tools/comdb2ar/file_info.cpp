@@ -2,6 +2,7 @@
 
 #include "comdb2ar.h"
 #include "error.h"
+#include "increment.h"
 
 #include <iostream>
 #include <sstream>
@@ -245,6 +246,11 @@ bool read_incr_FileInfo(const std::string& line, FileInfo& file,
             } else if(tok == "Deleted") {
                 continue;
 
+            } else if(tok == "PageRanges") {
+                if(!(ss >> tok)) return false;
+                if(tok != "[") return false;
+                if(!read_page_ranges(ss, incr_pages)) return false;
+
             } else if(tok == "Pages") {
                 if(!(ss >> tok)) return false;
                 if(tok != "[") return false;
@@ -8,6 +8,7 @@
 #include <string>
 #include <cerrno>
 #include <cstring>
+#include <cstdlib>
 
 void write_incr_manifest_entry(std::ostream& os, const FileInfo& file,
                                 const std::vector<uint32_t>& pages)
@@ -38,19 +39,12 @@ void write_incr_manifest_entry(std::ostream& os, const FileInfo& file,
         if (file.get_filesize())
             os << " FileSize " << file.get_filesize();
 
-        os << " Pages [ ";
-        std::clog << " Pages [ ";
-        for(size_t i = 0; i < pages.size(); ++i){
-            os << pages[i];
-            std::clog << pages[i];
-            if(i != pages.size() - 1){
-                os << " ";
-                std::clog << " ";
-            } else {
-                os << " ] ";
-                std::clog << " ] ";
-            }
-        }
+        os << " PageRanges [ ";
+        std::clog << " PageRanges [ ";
+        write_page_ranges(os, pages);
+        write_page_ranges(std::clog, pages);
+        os << " ] ";
+        std::clog << " ] ";
     }
 
     if(file.get_checksums()) {
@@ -69,6 +63,45 @@ void write_incr_manifest_entry(std::ostream& os, const FileInfo& file,
     return;
 }
 
+void write_page_ranges(std::ostream& os, const std::vector<uint32_t>& pages)
+// Write consecutive pages as one run, which keeps the manifest small when an
+// increment has whole ranges of changed pages
+{
+    size_t i = 0;
+    while(i < pages.size()){
+        size_t j = i;
+        while(j + 1 < pages.size() && pages[j + 1] == pages[j] + 1)
+            j++;
+        if(i != 0)
+            os << " ";
+        os << pages[i];
+        if(j != i)
+            os << "-" << pages[j];
+        i = j + 1;
+    }
+}
+
+bool read_page_ranges(std::istream& is, std::vector<uint32_t>& pages)
+{
+    std::string tok;
+    while(is >> tok){
+        if(tok == "]")
+            return true;
+
+        char *end;
+        errno = 0;
+        unsigned long first = strtoul(tok.c_str(), &end, 10);
+        unsigned long last = first;
+        if(*end == '-')
+            last = strtoul(end + 1, &end, 10);
+        if(errno != 0 || *end != '\0' || last < first)
+            return false;
+        for(unsigned long pg = first; pg <= last; ++pg)
+            pages.push_back(pg);
+    }
+    return false;
+}
+
 void write_del_manifest_entry(std::ostream& os, const std::string& incr_filename){
     std::string true_filename = incr_filename.substr(0, incr_filename.length() - 5);
     os << "File " << true_filename;
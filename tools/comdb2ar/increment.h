@@ -9,6 +9,7 @@
 
 
 #include "file_info.h"
+#include "glue.h"
 
 bool is_not_incr_file(std::string filename);
 // Determine whether a file is not .incr or .sha
@@ -24,10 +25,20 @@ bool compare_checksum(
     const std::string& incr_path,
     std::vector<uint32_t>& pages,
     ssize_t *data_size,
-    std::set<std::string>& incr_files
+    std::set<std::string>& incr_files,
+    const DB_LSN *since
 );
 // Compare a file's checksum and LSN with it's diff file to determine whether pages
-// have been changed
+// have been changed.  If since is not NULL then a page has changed if its LSN
+// is at or after since, and its checksum isn't looked at.
+
+bool read_incr_lsn(const std::string& incr_path, DB_LSN& lsn);
+// Read the recovery LSN saved by the previous backup, if there is one
+
+void write_incr_lsn(const std::string& incr_path,
+                    const std::string& recovery_options);
+// Save the recovery LSN from the database's recovery options for the next
+// increment, or remove the old one if the options don't have one
 
 void write_incr_manifest_entry(
     std::ostream& os,
@@ -36,6 +47,12 @@ void write_incr_manifest_entry(
 );
 // Write the manifest entry for a file that has been changed
 
+void write_page_ranges(std::ostream& os, const std::vector<uint32_t>& pages);
+// Write a sorted list of pages as runs, e.g. "3-7 12 20-21"
+
+bool read_page_ranges(std::istream& is, std::vector<uint32_t>& pages);
+// Read runs written by write_page_ranges up to a closing "]"
+
 void write_del_manifest_entry(std::ostream& os, const std::string& incr_filename);
 // Write the manifest entry for a file that has been deleted
 
@@ -24,6 +24,8 @@
 #include <utility>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <thread>
 
 #include <errno.h>
 #include <fcntl.h>
@@ -52,7 +54,7 @@ extern "C" {
 
 
 
-static void writepadding(size_t nbytes)
+static void writepadding(size_t nbytes, int outfd = 1)
 {
     static const char zeroes[1024] = {0};
     while(nbytes > 0) {
@@ -60,7 +62,7 @@ static void writepadding(size_t nbytes)
         if(num > sizeof(zeroes)) {
             num = sizeof(zeroes);
         }
-        if(writeall(1, zeroes, num) != num) {
+        if(writeall(outfd, zeroes, num) != num) {
             std::ostringstream ss;
             ss << "error writing zero padding: " << std::strerror(errno);
             throw Error(ss);
@@ -121,8 +123,9 @@ static void serialise_string(const std::string& filename,
 void *memalign(size_t boundary, size_t size);
 
 static void serialise_file(FileInfo& file, volatile iomap *iomap=NULL, const std::string altpath="",
-                            const std::string incr_path="", bool incr_create = false)
-// Serialise a single file, in tape archive format, onto stdout.  The input
+                            const std::string incr_path="", bool incr_create = false,
+                            int outfd = 1)
+// Serialise a single file, in tape archive format, onto outfd.  The input
 // filename is expected to be an absolute path.  The name recorded in the
 // tape archive will be relative to dbdir.  Input files outside of dbdir
 // (usually the lrl) will be recorded in the archive as having come from
@@ -200,7 +203,7 @@ reopen:
     head.set_attrs(st);
     head.set_checksum();
 
-    if(writeall(1, head.get().c, sizeof(tar_block_header))
+    if(writeall(outfd, head.get().c, sizeof(tar_block_header))
             != sizeof(tar_block_header)) {
         std::ostringstream ss;
         ss << "error writing tar block header: " << std::strerror(errno);
@@ -342,7 +345,7 @@ reopen:
             }
         }
 
-        ssize_t byteswritten = writeall(1, &pagebuf[0], bytesread);
+        ssize_t byteswritten = writeall(outfd, &pagebuf[0], bytesread);
         if(byteswritten != bytesread) {
             std::ostringstream ss;
             ss << "write error after " << bytesleft << "bytes: "
@@ -368,7 +371,7 @@ reopen:
     bytesleft = st.st_size & (512 - 1);
     bytesleft = 512 - bytesleft;
     if(bytesleft > 0 && bytesleft < 512) {
-        writepadding(bytesleft);
+        writepadding(bytesleft, outfd);
     }
 
     std::clog << "a " << filename << " size=" << st.st_size
@@ -484,6 +487,138 @@ static void serialise_log_files(
     }
 }
 
+struct DataStream {
+    std::string path;
+    int fd;
+    std::vector<FileInfo*> files;
+    unsigned long long bytes;
+    std::string error;
+
+    DataStream() : fd(-1), bytes(0) {}
+};
+
+static void serialise_data_stream(DataStream *ds, volatile iomap *iomap,
+        const std::string *incr_path, bool incr_create,
+        std::atomic<unsigned> *ndone)
+// Write one stream's share of the data files as a complete archive of its own
+{
+    try {
+        for(std::vector<FileInfo*>::iterator it = ds->files.begin();
+                it != ds->files.end();
+                ++it) {
+            serialise_file(**it, iomap, "", *incr_path, incr_create, ds->fd);
+        }
+        writepadding(2 * 512, ds->fd);
+    } catch(std::exception& e) {
+        ds->error = e.what();
+    }
+    ++*ndone;
+}
+
+static void serialise_data_streams(
+        std::list<FileInfo>& data_files,
+        unsigned nstreams,
+        const std::string& stream_prefix,
+        volatile iomap *iomap,
+        const std::string& incr_path,
+        bool incr_create,
+        const std::string& dbtxndir,
+        const std::string& dbdir,
+        long long& log_number,
+        LogHolder *log_holder)
+// Split the data files across nstreams archives, stream_prefix.1 to
+// stream_prefix.N, and write them all at once with a thread per stream.
+// Meanwhile the main archive on stdout picks up log files as they are
+// completed, the same as it does between data files when there is only one
+// stream.
+{
+    std::vector<DataStream> streams(nstreams);
+
+    // Biggest files first, each onto the stream that has the least so far
+    std::vector<std::pair<unsigned long long, FileInfo*> > bysize;
+    for(std::list<FileInfo>::iterator it = data_files.begin();
+            it != data_files.end();
+            ++it) {
+        struct stat st;
+        unsigned long long size = 0;
+        if(stat(it->get_filepath().c_str(), &st) == 0) {
+            size = st.st_size;
+        }
+        bysize.push_back(std::make_pair(size, &*it));
+    }
+    std::stable_sort(bysize.begin(), bysize.end(),
+            [](const std::pair<unsigned long long, FileInfo*>& a,
+               const std::pair<unsigned long long, FileInfo*>& b) {
+                return a.first > b.first;
+            });
+    for(size_t ii = 0; ii < bysize.size(); ii++) {
+        DataStream *least = &streams[0];
+        for(unsigned jj = 1; jj < nstreams; jj++) {
+            if(streams[jj].bytes < least->bytes) {
+                least = &streams[jj];
+            }
+        }
+        least->files.push_back(bysize[ii].second);
+        least->bytes += bysize[ii].first;
+    }
+
+    // Joins the writers and closes the streams however we leave
+    struct StreamGuard {
+        std::vector<DataStream>& m_streams;
+        std::vector<std::thread> m_threads;
+
+        StreamGuard(std::vector<DataStream>& streams) : m_streams(streams) {}
+        ~StreamGuard() {
+            for(size_t ii = 0; ii < m_threads.size(); ii++) {
+                m_threads[ii].join();
+            }
+            for(size_t ii = 0; ii < m_streams.size(); ii++) {
+                if(m_streams[ii].fd != -1) {
+                    close(m_streams[ii].fd);
+                }
+            }
+        }
+    } guard(streams);
+
+    for(unsigned ii = 0; ii < nstreams; ii++) {
+        std::ostringstream ss;
+        ss << stream_prefix << "." << (ii + 1);
+        streams[ii].path = ss.str();
+        streams[ii].fd = open(streams[ii].path.c_str(),
+                O_WRONLY | O_CREAT | O_TRUNC, 0664);
+        if(streams[ii].fd == -1) {
+            std::ostringstream ss;
+            ss << "cannot create data stream " << streams[ii].path << ": "
+                << std::strerror(errno);
+            throw Error(ss);
+        }
+        std::clog << "data stream " << streams[ii].path << ": "
+            << streams[ii].files.size() << " files, "
+            << streams[ii].bytes << " bytes" << std::endl;
+    }
+
+    std::atomic<unsigned> ndone(0);
+    for(unsigned ii = 0; ii < nstreams; ii++) {
+        guard.m_threads.push_back(std::thread(serialise_data_stream,
+                    &streams[ii], iomap, &incr_path, incr_create, &ndone));
+    }
+
+    while(ndone < nstreams) {
+        long long old_log_number(log_number);
+        serialise_log_files(dbtxndir, dbdir, log_number, true);
+        if(log_number != old_log_number && log_holder) {
+            log_holder->release_log(log_number - 1);
+        }
+        poll(0, 0, 1000);
+    }
+
+    for(unsigned ii = 0; ii < nstreams; ii++) {
+        if(!streams[ii].error.empty()) {
+            throw SerialiseError(streams[ii].path, streams[ii].error);
+        }
+    }
+}
+
 static void strip_cluster(const std::string& lrlpath,
         const std::string& lrldest)
 {
@@ -762,7 +897,9 @@ void serialise_database(
   bool incr_create,
   bool incr_gen,
   bool copy_physical,
-  const std::string& incr_path
+  const std::string& incr_path,
+  unsigned nstreams,
+  const std::string& stream_prefix
 )
 // Serialise a database into tape archive format and write it to stdout.
 // If support_only is true then only support files (lrl and schema) will
@@ -1161,6 +1298,9 @@ void serialise_database(
     // Construct a manifest which will give the page sizes of all the files
     std::ostringstream manifest;
 
+    // Where recovery of this backup will start, as reported by the database
+    std::string recovery_options;
+
     // Non-incremental mode or increment creation mode
     if(!incr_gen){
         manifest << "# Manifest for serialisation of " << dbname << std::endl;
@@ -1179,11 +1319,15 @@ void serialise_database(
                 write_manifest_entry(manifest, *it);
         }
 
+        if(nstreams > 0 && !support_files_only) {
+            manifest << "DataStreams " << nstreams << std::endl;
+        }
+
         // Find a recovery point after the copy, and record it in the manifest
         if (!support_files_only) {
             std::clog << "logdelete version " << log_holder->version() << std::endl;
             if (log_holder->version() >= 3) {
-                std::string recovery_options = log_holder->recovery_options();
+                recovery_options = log_holder->recovery_options();
                 if (!recovery_options.empty()) {
                     manifest << "Option " << recovery_options <<std::endl;
                 }
@@ -1198,6 +1342,11 @@ void serialise_database(
         manifest << "# Manifest for serialisation of increment produced on "
             << getDTString() << std::endl;
 
+        // Pages that have changed since the last backup started carry a
+        // later LSN.  Without a saved LSN, compare checksums instead.
+        DB_LSN since;
+        bool have_since = read_incr_lsn(incr_path, since);
+
 
         for(std::list<FileInfo>::iterator
                 it = data_files.begin();
@@ -1208,7 +1357,8 @@ void serialise_database(
             ssize_t data_size = 0;
 
             // Diff the page checksums for each file to find what has been changed
-            if(compare_checksum(*it, incr_path, pages_list, &data_size, incr_files)) {
+            if(compare_checksum(*it, incr_path, pages_list, &data_size,
+                        incr_files, have_since ? &since : NULL)) {
                 // If pages list is empty but compare_checksum returned true, it's a new file
                 if(pages_list.empty()){
                     new_files.push_back(*it);
@@ -1256,7 +1406,7 @@ void serialise_database(
         // Find a recovery point after the copy, and record it in the manifest
         std::clog << "logdelete version " << log_holder->version() << std::endl;
         if (log_holder->version() >= 3) {
-            std::string recovery_options = log_holder->recovery_options();
+            recovery_options = log_holder->recovery_options();
             if (!recovery_options.empty()) {
                 manifest << "Option " << recovery_options <<std::endl;
             }
@@ -1343,21 +1493,27 @@ void serialise_database(
         if(!support_files_only) {
 
             long long log_number(lowest_log);
-            for(std::list<FileInfo>::iterator
-                    it = data_files.begin();
-                    it != data_files.end();
-                    ++it) {
-
-                // First, serialise any complete log files that are in the .txn
-                // directory and notify the running database that they can now be
-                // archived.
-                long long old_log_number(log_number);
-                serialise_log_files(dbtxndir, dbdir, log_number, true);
-                if(log_number != old_log_number && log_holder.get()) {
-                    log_holder->release_log(log_number - 1);
-                }
+            if(nstreams > 0) {
+                serialise_data_streams(data_files, nstreams, stream_prefix,
+                        iom, incr_path, incr_create, dbtxndir, dbdir,
+                        log_number, log_holder.get());
+            } else {
+                for(std::list<FileInfo>::iterator
+                        it = data_files.begin();
+                        it != data_files.end();
+                        ++it) {
+
+                    // First, serialise any complete log files that are in the
+                    // .txn directory and notify the running database that
+                    // they can now be archived.
+                    long long old_log_number(log_number);
+                    serialise_log_files(dbtxndir, dbdir, log_number, true);
+                    if(log_number != old_log_number && log_holder.get()) {
+                        log_holder->release_log(log_number - 1);
+                    }
 
-                serialise_file(*it, iom, "", incr_path, incr_create);
+                    serialise_file(*it, iom, "", incr_path, incr_create);
+                }
             }
 
             // Serialise all remaining log files, including incomplete ones
@@ -1474,6 +1630,9 @@ void serialise_database(
         std::ofstream sha_file(sha_filename, std::ofstream::trunc);
 
         sha_file.write(sha.c_str(), 40);
+
+        // And where the next increment can start looking for changed pages
+        write_incr_lsn(incr_path, recovery_options);
     }
 
     // Release the database for log file deletion.
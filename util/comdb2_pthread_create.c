@@ -24,6 +24,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <limits.h>
+#include <string.h>
+#include <sched.h>
 #ifndef __APPLE__
 #include <malloc.h>
 #endif
@@ -313,3 +315,173 @@ int comdb2_pthread_create(pthread_t *thread, pthread_attr_t *attr,
 
     return rc;
 }
+
+char *gbl_sql_thread_cpus = NULL;
+char *gbl_commit_thread_cpus = NULL;
+char *gbl_rep_thread_cpus = NULL;
+char *gbl_net_thread_cpus = NULL;
+char *gbl_bdb_thread_cpus = NULL;
+
+static const char *thread_class_names[COMDB2_THR_CLASS_MAX] = {
+    "none", "sql", "commit", "replication", "net", "bdb"};
+
+const char *comdb2_thread_class_name(int cls)
+{
+    if (cls < 0 || cls >= COMDB2_THR_CLASS_MAX)
+        return "unknown";
+    return thread_class_names[cls];
+}
+
+static const char *thread_class_cpus(int cls)
+{
+    switch (cls) {
+    case COMDB2_THR_CLASS_SQL: return gbl_sql_thread_cpus;
+    case COMDB2_THR_CLASS_COMMIT: return gbl_commit_thread_cpus;
+    case COMDB2_THR_CLASS_REP: return gbl_rep_thread_cpus;
+    case COMDB2_THR_CLASS_NET: return gbl_net_thread_cpus;
+    case COMDB2_THR_CLASS_BDB: return gbl_bdb_thread_cpus;
+    default: return NULL;
+    }
+}
+
+#ifdef _LINUX_SOURCE
+
+#define NUMA_NODE_PATH "/sys/devices/system/node"
+#define MAX_NUMA_NODES 1024
+
+/* "0-3,8" */
+static int cpulist_parse(const char *list, cpu_set_t *set)
+{
+    const char *p = list;
+    char *end;
+    long lo, hi;
+
+    while (*p) {
+        lo = strtol(p, &end, 10);
+        if (end == p || lo < 0)
+            return -1;
+        hi = lo;
+        p = end;
+        if (*p == '-') {
+            hi = strtol(p + 1, &end, 10);
+            if (end == p + 1 || hi < lo)
+                return -1;
+            p = end;
+        }
+        if (hi >= CPU_SETSIZE)
+            return -1;
+        for (; lo <= hi; lo++)
+            CPU_SET(lo, set);
+        if (*p == ',')
+            p++;
+        else if (*p && *p != '\n')
+            return -1;
+        else
+            break;
+    }
+    return 0;
+}
+
+/* the kernel's cpulist for the node is in the same format */
+static int numa_node_cpus(int node, cpu_set_t *set)
+{
+    char path[PATH_MAX], buf[4096];
+    FILE *f;
+    int rc;
+
+    snprintf(path, sizeof(path), NUMA_NODE_PATH "/node%d/cpulist", node);
+    if ((f = fopen(path, "r")) == NULL)
+        return -1;
+    rc = fgets(buf, sizeof(buf), f) ? cpulist_parse(buf, set) : -1;
+    fclose(f);
+    return rc;
+}
+
+static int numa_local_cpus(cpu_set_t *set)
+{
+    int cpu, node;
+
+    if ((cpu = sched_getcpu()) < 0)
+        return -1;
+    for (node = 0; node < MAX_NUMA_NODES; node++) {
+        CPU_ZERO(set);
+        if (numa_node_cpus(node, set) != 0)
+            break;
+        if (CPU_ISSET(cpu, set))
+            return 0;
+    }
+    /* no numa information: the machine is one node */
+    CPU_ZERO(set);
+    return sched_getaffinity(0, sizeof(*set), set);
+}
+
+static int cpus_parse(const char *cpus, cpu_set_t *set)
+{
+    char *end;
+    long node;
+
+    CPU_ZERO(set);
+    if (strcmp(cpus, "local") == 0)
+        return numa_local_cpus(set);
+    if (strncmp(cpus, "node", 4) == 0) {
+        node = strtol(cpus + 4, &end, 10);
+        if (end == cpus + 4 || *end || node < 0)
+            return -1;
+        return numa_node_cpus(node, set);
+    }
+    return cpulist_parse(cpus, set);
+}
+
+int comdb2_cpus_verify(const char *cpus)
+{
+    cpu_set_t set, allowed;
+
+    if (cpus == NULL || *cpus == '\0' || strcmp(cpus, "local") == 0)
+        return 0;
+    if (cpus_parse(cpus, &set) != 0) {
+        logmsg(LOGMSG_ERROR, "Invalid cpu list '%s'\n", cpus);
+        return 1;
+    }
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        CPU_AND(&set, &set, &allowed);
+        if (CPU_COUNT(&set) == 0) {
+            logmsg(LOGMSG_ERROR, "None of cpus '%s' are available\n", cpus);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int comdb2_thread_set_affinity(int cls, const char *cpus)
+{
+    cpu_set_t set;
+    int rc;
+
+    if (cpus == NULL)
+        cpus = thread_class_cpus(cls);
+    if (cpus == NULL || *cpus == '\0')
+        return 0;
+    if (cpus_parse(cpus, &set) != 0) {
+        logmsg(LOGMSG_ERROR, "%s: invalid cpu list '%s' for %s thread\n",
+               __func__, cpus, comdb2_thread_class_name(cls));
+        return EINVAL;
+    }
+    if ((rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) != 0)
+        logmsg(LOGMSG_ERROR, "%s: can't bind %s thread to cpus '%s': %s\n",
+               __func__, comdb2_thread_class_name(cls), cpus, strerror(rc));
+    return rc;
+}
+
+#else
+
+int comdb2_cpus_verify(const char *cpus)
+{
+    return 0;
+}
+
+int comdb2_thread_set_affinity(int cls, const char *cpus)
+{
+    return 0;
+}
+
+#endif
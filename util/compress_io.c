@@ -0,0 +1,341 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/* Compressed framing for SBUF2.  Included from sbuf2.c like ssl_io.c, as it
+   needs the innards of struct sbuf2.  See compress_io.h for the format. */
+
+#include <arpa/inet.h>
+#include <lz4.h>
+#ifdef WITH_ZSTD
+#  include <zstd.h>
+#endif
+
+#if LZ4_VERSION_NUMBER < 10701
+#  define LZ4_compress_default LZ4_compress_limitedOutput
+#endif
+
+/* Large enough that a big result set is compressed in useful pieces. */
+#define COMPIO_BUFSZ (64 * 1024)
+/* Refuse frames bigger than this from the peer. */
+#define COMPIO_MAX_FRAME (16 * 1024 * 1024)
+#define COMPIO_HDRSZ (2 * sizeof(uint32_t))
+
+struct compio {
+    int algo;
+    int threshold;
+
+    /* outgoing frame */
+    char *wbuf;
+    int lwbuf;
+
+    /* incoming compressed payload */
+    char *zbuf;
+    int lzbuf;
+
+    /* decompressed payload not yet handed to the SBUF2 */
+    char *rbuf;
+    int lrbuf;
+    int rhd, rtl;
+
+#ifdef WITH_ZSTD
+    ZSTD_CCtx *cctx;
+    ZSTD_DCtx *dctx;
+#endif
+};
+
+int SBUF2_FUNC(compio_supported)(void)
+{
+#ifdef WITH_ZSTD
+    return COMPIO_LZ4 | COMPIO_ZSTD;
+#else
+    return COMPIO_LZ4;
+#endif
+}
+
+int SBUF2_FUNC(compio_choose)(int peer_algos)
+{
+    int common = peer_algos & compio_supported();
+    /* zstd compresses better for about the same cost to decompress */
+    if (common & COMPIO_ZSTD)
+        return COMPIO_ZSTD;
+    if (common & COMPIO_LZ4)
+        return COMPIO_LZ4;
+    return COMPIO_NONE;
+}
+
+const char *SBUF2_FUNC(compio_name)(int algo)
+{
+    switch (algo) {
+    case COMPIO_NONE:
+        return "none";
+    case COMPIO_LZ4:
+        return "lz4";
+    case COMPIO_ZSTD:
+        return "zstd";
+    default:
+        return "unknown";
+    }
+}
+
+int SBUF2_FUNC(compio_algo)(SBUF2 *sb)
+{
+    return (sb != NULL && sb->cmp != NULL) ? sb->cmp->algo : COMPIO_NONE;
+}
+
+void SBUF2_FUNC(compio_get_stats)(SBUF2 *sb, struct compio_stats *st)
+{
+    *st = sb->cmpstats;
+    st->algo = compio_algo(sb);
+}
+
+static int compio_pending(SBUF2 *sb)
+{
+    return sb->cmp ? sb->cmp->rhd - sb->cmp->rtl : 0;
+}
+
+static void compio_free(SBUF2 *sb)
+{
+    struct compio *c = sb->cmp;
+    if (c == NULL)
+        return;
+#ifdef WITH_ZSTD
+    if (c->cctx)
+        ZSTD_freeCCtx(c->cctx);
+    if (c->dctx)
+        ZSTD_freeDCtx(c->dctx);
+#endif
+    free(c->wbuf);
+    free(c->zbuf);
+    free(c->rbuf);
+    free(c);
+    sb->cmp = NULL;
+}
+
+/* Make sure *buf holds at least `need' bytes.  Contents are not kept. */
+static int compio_reserve(SBUF2 *sb, char **buf, int *lbuf, int need)
+{
+    if (*lbuf >= need)
+        return 0;
+    free(*buf);
+    *lbuf = 0;
+    if ((*buf = malloc(need)) == NULL)
+        return -1;
+    *lbuf = need;
+    return 0;
+}
+
+int SBUF2_FUNC(compio_start)(SBUF2 *sb, int algo, int threshold)
+{
+    struct compio *c;
+
+    if (sb == NULL || sb->cmp != NULL || !(algo & compio_supported()) ||
+        sb->rhd != sb->rtl || sb->whd != sb->wtl)
+        return -1;
+
+    /* the SBUF2 flushes whenever its buffer fills up, so that is the
+       largest piece we get to compress */
+    if (sb->lbuf < COMPIO_BUFSZ)
+        sbuf2setbufsize(sb, COMPIO_BUFSZ);
+
+    if ((c = calloc(1, sizeof(struct compio))) == NULL)
+        return -1;
+    c->algo = algo;
+    c->threshold = threshold;
+#ifdef WITH_ZSTD
+    if (algo == COMPIO_ZSTD &&
+        ((c->cctx = ZSTD_createCCtx()) == NULL ||
+         (c->dctx = ZSTD_createDCtx()) == NULL)) {
+        sb->cmp = c;
+        compio_free(sb);
+        return -1;
+    }
+#endif
+    sb->cmp = c;
+    return 0;
+}
+
+/* Write all of cc.  Return len, 0 if nothing could be written before the
+   timeout, or <0.  A frame that is cut short can't be resumed. */
+static int compio_write_all(SBUF2 *sb, const char *cc, int len)
+{
+    int rc, off = 0;
+    while (off < len) {
+        rc = sb->write(sb, cc + off, len - off);
+        if (rc <= 0)
+            return (off == 0) ? rc : -1;
+        off += rc;
+    }
+    return len;
+}
+
+/* Read exactly len bytes.  Same return values as compio_write_all. */
+static int compio_read_all(SBUF2 *sb, char *cc, int len)
+{
+    int rc, off = 0;
+    while (off < len) {
+        rc = sb->read(sb, cc + off, len - off);
+        if (rc <= 0)
+            return (off == 0) ? rc : -1;
+        off += rc;
+    }
+    return len;
+}
+
+static int compio_compress(struct compio *c, const char *in, int len,
+                           char *out, int outlen)
+{
+    switch (c->algo) {
+    case COMPIO_LZ4:
+        return LZ4_compress_default(in, out, len, outlen);
+#ifdef WITH_ZSTD
+    case COMPIO_ZSTD: {
+        size_t n = ZSTD_compressCCtx(c->cctx, out, outlen, in, len, 1);
+        return ZSTD_isError(n) ? -1 : (int)n;
+    }
+#endif
+    default:
+        return -1;
+    }
+}
+
+static int compio_decompress(struct compio *c, const char *in, int len,
+                             char *out, int outlen)
+{
+    switch (c->algo) {
+    case COMPIO_LZ4:
+        return LZ4_decompress_safe(in, out, len, outlen);
+#ifdef WITH_ZSTD
+    case COMPIO_ZSTD: {
+        size_t n = ZSTD_decompressDCtx(c->dctx, out, outlen, in, len);
+        return ZSTD_isError(n) ? -1 : (int)n;
+    }
+#endif
+    default:
+        return -1;
+    }
+}
+
+static int compio_bound(struct compio *c, int len)
+{
+#ifdef WITH_ZSTD
+    if (c->algo == COMPIO_ZSTD)
+        return ZSTD_compressBound(len);
+#endif
+    return LZ4_compressBound(len);
+}
+
+int SBUF2_FUNC(compio_write)(SBUF2 *sb, const char *cc, int len)
+{
+    struct compio *c = sb->cmp;
+    uint32_t hdr[2];
+    int rc, n = -1;
+
+    if (compio_reserve(sb, &c->wbuf, &c->lwbuf,
+                       COMPIO_HDRSZ + compio_bound(c, len)) != 0)
+        return -1;
+
+    if (len >= c->threshold)
+        n = compio_compress(c, cc, len, c->wbuf + COMPIO_HDRSZ,
+                            c->lwbuf - COMPIO_HDRSZ);
+    if (n > 0 && n < len) {
+        hdr[0] = htonl(n);
+        hdr[1] = htonl(len);
+    } else {
+        /* too small, or didn't shrink */
+        n = len;
+        memcpy(c->wbuf + COMPIO_HDRSZ, cc, len);
+        hdr[0] = htonl(len);
+        hdr[1] = 0;
+    }
+    memcpy(c->wbuf, hdr, COMPIO_HDRSZ);
+
+    rc = compio_write_all(sb, c->wbuf, COMPIO_HDRSZ + n);
+    if (rc <= 0)
+        return rc;
+    sb->cmpstats.raw_out += len;
+    sb->cmpstats.wire_out += rc;
+    return len;
+}
+
+int SBUF2_FUNC(compio_read)(SBUF2 *sb, char *cc, int len)
+{
+    struct compio *c = sb->cmp;
+    uint32_t hdr[2], wirelen, rawlen;
+    int rc;
+
+    if (c->rhd == c->rtl) {
+        rc = compio_read_all(sb, (char *)hdr, COMPIO_HDRSZ);
+        if (rc <= 0)
+            return rc;
+        wirelen = ntohl(hdr[0]);
+        rawlen = ntohl(hdr[1]);
+
+        if (wirelen == 0 && rawlen == 0) {
+            /* peer went back to plain bytes */
+            compio_free(sb);
+            return sb->read(sb, cc, len);
+        }
+        if (wirelen > COMPIO_MAX_FRAME || rawlen > COMPIO_MAX_FRAME) {
+            loge("%s: bad frame %u %u\n", __func__, wirelen, rawlen);
+            errno = EIO;
+            return -1;
+        }
+
+        c->rhd = c->rtl = 0;
+        if (rawlen == 0) {
+            if (compio_reserve(sb, &c->rbuf, &c->lrbuf, wirelen) != 0 ||
+                compio_read_all(sb, c->rbuf, wirelen) != (int)wirelen)
+                return -1;
+            c->rhd = wirelen;
+        } else {
+            if (compio_reserve(sb, &c->zbuf, &c->lzbuf, wirelen) != 0 ||
+                compio_reserve(sb, &c->rbuf, &c->lrbuf, rawlen) != 0 ||
+                compio_read_all(sb, c->zbuf, wirelen) != (int)wirelen)
+                return -1;
+            if (compio_decompress(c, c->zbuf, wirelen, c->rbuf, rawlen) !=
+                (int)rawlen) {
+                loge("%s: can't decompress %s frame %u %u\n", __func__,
+                     compio_name(c->algo), wirelen, rawlen);
+                errno = EIO;
+                return -1;
+            }
+            c->rhd = rawlen;
+        }
+        sb->cmpstats.wire_in += COMPIO_HDRSZ + wirelen;
+        sb->cmpstats.raw_in += c->rhd;
+    }
+
+    rc = c->rhd - c->rtl;
+    if (rc > len)
+        rc = len;
+    memcpy(cc, c->rbuf + c->rtl, rc);
+    c->rtl += rc;
+    return rc;
+}
+
+int SBUF2_FUNC(compio_close)(SBUF2 *sb, int reuse)
+{
+    uint32_t hdr[2] = {0, 0};
+    int rc = 0;
+
+    if (sb == NULL || sb->cmp == NULL)
+        return 0;
+    if (reuse && sb->fd >= 0 &&
+        compio_write_all(sb, (char *)hdr, COMPIO_HDRSZ) != COMPIO_HDRSZ)
+        rc = -1;
+    compio_free(sb);
+    return rc;
+}
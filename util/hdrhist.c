@@ -0,0 +1,190 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "hdrhist.h"
+#include "list.h"
+#include <locks_wrap.h>
+
+#include "mem_util.h"
+#include "mem_override.h"
+
+#define HDRHIST_LINEAR (1 << HDRHIST_LINEAR_BITS)
+#define HDRHIST_SUB (1 << HDRHIST_SUB_BITS)
+
+static int hdrhist_bucket(uint64_t value)
+{
+    int msb, shift;
+
+    if (value < HDRHIST_LINEAR)
+        return (int)value;
+    msb = 63 - __builtin_clzll(value);
+    if (msb >= HDRHIST_MAX_BITS)
+        return HDRHIST_NBUCKETS - 1;
+    /* keep the leading 1 and the next HDRHIST_SUB_BITS bits */
+    shift = msb - HDRHIST_SUB_BITS;
+    return HDRHIST_LINEAR + (msb - HDRHIST_LINEAR_BITS) * HDRHIST_SUB +
+           (int)((value >> shift) & (HDRHIST_SUB - 1));
+}
+
+/* largest value that lands in bucket b */
+static uint64_t hdrhist_bucket_top(int b)
+{
+    int msb, sub, shift;
+
+    if (b < HDRHIST_LINEAR)
+        return b;
+    msb = HDRHIST_LINEAR_BITS + (b - HDRHIST_LINEAR) / HDRHIST_SUB;
+    sub = (b - HDRHIST_LINEAR) % HDRHIST_SUB;
+    shift = msb - HDRHIST_SUB_BITS;
+    return ((uint64_t)(HDRHIST_SUB + sub + 1) << shift) - 1;
+}
+
+void hdrhist_init(struct hdrhist *h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+void hdrhist_record(struct hdrhist *h, uint64_t value)
+{
+    h->counts[hdrhist_bucket(value)]++;
+    h->count++;
+    h->sum += value;
+    if (value > h->max)
+        h->max = value;
+}
+
+void hdrhist_merge(struct hdrhist *dst, const struct hdrhist *src)
+{
+    for (int i = 0; i < HDRHIST_NBUCKETS; i++)
+        dst->counts[i] += src->counts[i];
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->max > dst->max)
+        dst->max = src->max;
+}
+
+uint64_t hdrhist_percentile(const struct hdrhist *h, double pct)
+{
+    uint64_t want, seen = 0, total = 0;
+    int i;
+
+    /* count may be a little off the buckets if a writer is running */
+    for (i = 0; i < HDRHIST_NBUCKETS; i++)
+        total += h->counts[i];
+    if (total == 0)
+        return 0;
+    want = (uint64_t)(total * pct / 100.0 + 0.5);
+    if (want == 0)
+        want = 1;
+    for (i = 0; i < HDRHIST_NBUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= want) {
+            uint64_t top = hdrhist_bucket_top(i);
+            return (top < h->max) ? top : h->max;
+        }
+    }
+    return h->max;
+}
+
+uint64_t hdrhist_mean(const struct hdrhist *h)
+{
+    return h->count ? h->sum / h->count : 0;
+}
+
+struct hdrhist_thd {
+    struct hdrhist_set *set;
+    LINKC_T(struct hdrhist_thd) lnk;
+    struct hdrhist h[];
+};
+
+struct hdrhist_set {
+    int nhists;
+    pthread_key_t key;
+    pthread_mutex_t lk;
+    LISTC_T(struct hdrhist_thd) thds;
+    struct hdrhist *exited; /* from threads that are gone */
+};
+
+static void hdrhist_thd_exit(void *arg)
+{
+    struct hdrhist_thd *t = arg;
+    struct hdrhist_set *s = t->set;
+
+    Pthread_mutex_lock(&s->lk);
+    listc_rfl(&s->thds, t);
+    for (int i = 0; i < s->nhists; i++)
+        hdrhist_merge(&s->exited[i], &t->h[i]);
+    Pthread_mutex_unlock(&s->lk);
+    free(t);
+}
+
+struct hdrhist_set *hdrhist_set_new(int nhists)
+{
+    struct hdrhist_set *s = calloc(1, sizeof(struct hdrhist_set));
+    if (s == NULL)
+        return NULL;
+    if ((s->exited = calloc(nhists, sizeof(struct hdrhist))) == NULL) {
+        free(s);
+        return NULL;
+    }
+    s->nhists = nhists;
+    Pthread_mutex_init(&s->lk, NULL);
+    Pthread_key_create(&s->key, hdrhist_thd_exit);
+    listc_init(&s->thds, offsetof(struct hdrhist_thd, lnk));
+    return s;
+}
+
+void hdrhist_set_record(struct hdrhist_set *s, int which, uint64_t value)
+{
+    struct hdrhist_thd *t;
+
+    if (s == NULL || which < 0 || which >= s->nhists)
+        return;
+    if ((t = pthread_getspecific(s->key)) == NULL) {
+        t = calloc(1, offsetof(struct hdrhist_thd, h) +
+                          s->nhists * sizeof(struct hdrhist));
+        if (t == NULL)
+            return;
+        t->set = s;
+        Pthread_mutex_lock(&s->lk);
+        listc_abl(&s->thds, t);
+        Pthread_mutex_unlock(&s->lk);
+        Pthread_setspecific(s->key, t);
+    }
+    hdrhist_record(&t->h[which], value);
+}
+
+void hdrhist_set_get(struct hdrhist_set *s, int which, struct hdrhist *out)
+{
+    struct hdrhist_thd *t;
+
+    hdrhist_init(out);
+    if (s == NULL || which < 0 || which >= s->nhists)
+        return;
+    /* the lock only keeps threads from going away under us */
+    Pthread_mutex_lock(&s->lk);
+    hdrhist_merge(out, &s->exited[which]);
+    LISTC_FOR_EACH(&s->thds, t, lnk)
+    {
+        hdrhist_merge(out, &t->h[which]);
+    }
+    Pthread_mutex_unlock(&s->lk);
+}
@@ -0,0 +1,65 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef INCLUDED_HDRHIST_H
+#define INCLUDED_HDRHIST_H
+
+#include <stdint.h>
+
+/* Log-linear latency histogram, in the style of HdrHistogram.  Values below
+   32 get a bucket each; every power of two above that is split into 16
+   buckets, so a reported percentile is within about 6% of the real one.
+   Values of 2^40 and up are counted in the last bucket. */
+
+#define HDRHIST_LINEAR_BITS 5
+#define HDRHIST_SUB_BITS 4
+#define HDRHIST_MAX_BITS 40
+#define HDRHIST_NBUCKETS                                                       \
+    ((1 << HDRHIST_LINEAR_BITS) +                                              \
+     (HDRHIST_MAX_BITS - HDRHIST_LINEAR_BITS) * (1 << HDRHIST_SUB_BITS))
+
+struct hdrhist {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t counts[HDRHIST_NBUCKETS];
+};
+
+void hdrhist_init(struct hdrhist *h);
+
+/* Not thread safe: one writer per histogram */
+void hdrhist_record(struct hdrhist *h, uint64_t value);
+
+/* Add src into dst */
+void hdrhist_merge(struct hdrhist *dst, const struct hdrhist *src);
+
+/* Highest value that falls in the same bucket as the given percentile
+   (0-100), or 0 if the histogram is empty */
+uint64_t hdrhist_percentile(const struct hdrhist *h, double pct);
+
+uint64_t hdrhist_mean(const struct hdrhist *h);
+
+/* A set of histograms that every thread records into privately.  Recording
+   takes no locks; readers merge all the threads' copies, which may be a
+   few values behind.  A thread's copy is folded into the set when the
+   thread exits. */
+struct hdrhist_set;
+
+struct hdrhist_set *hdrhist_set_new(int nhists);
+void hdrhist_set_record(struct hdrhist_set *s, int which, uint64_t value);
+void hdrhist_set_get(struct hdrhist_set *s, int which, struct hdrhist *out);
+
+#endif
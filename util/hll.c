@@ -0,0 +1,80 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "hll.h"
+
+void hll_init(struct hll *h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+void hll_add(struct hll *h, uint64_t hash)
+{
+    int ix = hash >> (64 - HLL_BITS);
+    uint64_t rest = hash << HLL_BITS;
+    /* position of the first 1 bit in what's left */
+    int rank = rest ? __builtin_clzll(rest) + 1 : 64 - HLL_BITS + 1;
+    if (rank > h->reg[ix])
+        h->reg[ix] = rank;
+}
+
+void hll_merge(struct hll *dst, const struct hll *src)
+{
+    for (int i = 0; i < HLL_NREGS; i++) {
+        if (src->reg[i] > dst->reg[i])
+            dst->reg[i] = src->reg[i];
+    }
+}
+
+double hll_estimate(const struct hll *h)
+{
+    const double m = HLL_NREGS;
+    const double alpha = 0.7213 / (1 + 1.079 / m);
+    double sum = 0, est;
+    int zeros = 0;
+
+    for (int i = 0; i < HLL_NREGS; i++) {
+        sum += ldexp(1.0, -h->reg[i]);
+        if (h->reg[i] == 0)
+            zeros++;
+    }
+    est = alpha * m * m / sum;
+    /* small counts: linear counting is much better */
+    if (est <= 2.5 * m && zeros > 0)
+        est = m * log(m / zeros);
+    return est;
+}
+
+uint64_t hll_hash(const void *buf, size_t len)
+{
+    /* FNV-1a, then the murmur3 finalizer to spread it over all 64 bits */
+    const unsigned char *p = buf;
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
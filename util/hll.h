@@ -0,0 +1,46 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef INCLUDED_HLL_H
+#define INCLUDED_HLL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* HyperLogLog distinct counter.  2^HLL_BITS one-byte registers give a
+   standard error of about 3%, whatever the number of values added. */
+
+#define HLL_BITS 10
+#define HLL_NREGS (1 << HLL_BITS)
+
+struct hll {
+    uint8_t reg[HLL_NREGS];
+};
+
+void hll_init(struct hll *h);
+
+/* hash should be a well mixed 64 bit hash of the value */
+void hll_add(struct hll *h, uint64_t hash);
+
+/* Add src into dst, giving the count of the union of both */
+void hll_merge(struct hll *dst, const struct hll *src);
+
+double hll_estimate(const struct hll *h);
+
+/* 64 bit hash of a buffer for hll_add */
+uint64_t hll_hash(const void *buf, size_t len);
+
+#endif
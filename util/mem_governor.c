@@ -0,0 +1,166 @@
+/*
+   Copyright 2024 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/* The tallies are atomics, as they move on every temptable row and sorter
+ * record; the lock is only taken by a statement waiting to be let in, and by
+ * a give-back that brings the server under budget while one is waiting.  A
+ * waiter also wakes every MEMGOV_ADMIT_POLL_MS on its own, so a missed
+ * wakeup costs no more than that.  What a thread's statement holds is kept
+ * in a thread local; memory given back on a thread other than the one that
+ * took it only brings that thread's tally down to 0. */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "comdb2_atomic.h"
+#include "locks_wrap.h"
+#include "mem_governor.h"
+
+int gbl_mem_budget_mb = 0;
+int gbl_mem_budget_temptable_mb = 0;
+int gbl_mem_budget_sorter_mb = 0;
+int gbl_mem_query_budget_mb = 0;
+int gbl_mem_admission_wait_ms = 5000;
+
+#define MEMGOV_ADMIT_POLL_MS 10
+
+static int64_t gov_used[MEMGOV_MAX];
+static int64_t gov_total;
+static int64_t gov_spills[MEMGOV_MAX];
+static int64_t gov_admission_waits;
+static int64_t gov_admission_timeouts;
+static int gov_waiters;
+
+static pthread_mutex_t gov_lk = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gov_cond = PTHREAD_COND_INITIALIZER;
+
+static __thread long long gov_query_used;
+
+static inline long long mb_to_bytes(int mb)
+{
+    return (long long)mb << 20;
+}
+
+static int subsys_budget_mb(enum memgov_subsys subsys)
+{
+    switch (subsys) {
+    case MEMGOV_TEMPTABLE:
+        return gbl_mem_budget_temptable_mb;
+    case MEMGOV_SORTER:
+        return gbl_mem_budget_sorter_mb;
+    default:
+        return 0;
+    }
+}
+
+static int server_over(void)
+{
+    int budget = gbl_mem_budget_mb;
+    return budget > 0 && ATOMIC_LOAD64(gov_total) > mb_to_bytes(budget);
+}
+
+void memgov_charge(enum memgov_subsys subsys, long long bytes)
+{
+    int64_t total;
+
+    if (bytes == 0 || subsys < 0 || subsys >= MEMGOV_MAX)
+        return;
+    ATOMIC_ADD64(gov_used[subsys], bytes);
+    total = ATOMIC_ADD64(gov_total, bytes);
+    if ((gov_query_used += bytes) < 0)
+        gov_query_used = 0;
+
+    if (bytes < 0 && ATOMIC_LOAD32(gov_waiters) > 0 &&
+        (gbl_mem_budget_mb <= 0 || total <= mb_to_bytes(gbl_mem_budget_mb))) {
+        Pthread_mutex_lock(&gov_lk);
+        Pthread_cond_broadcast(&gov_cond);
+        Pthread_mutex_unlock(&gov_lk);
+    }
+}
+
+int memgov_over(enum memgov_subsys subsys)
+{
+    int budget;
+
+    if (subsys < 0 || subsys >= MEMGOV_MAX)
+        return 0;
+    if (server_over())
+        return 1;
+    budget = subsys_budget_mb(subsys);
+    if (budget > 0 && ATOMIC_LOAD64(gov_used[subsys]) > mb_to_bytes(budget))
+        return 1;
+    budget = gbl_mem_query_budget_mb;
+    return budget > 0 && gov_query_used > mb_to_bytes(budget);
+}
+
+void memgov_spilled(enum memgov_subsys subsys)
+{
+    if (subsys >= 0 && subsys < MEMGOV_MAX)
+        ATOMIC_ADD64(gov_spills[subsys], 1);
+}
+
+void memgov_query_start(void)
+{
+    gov_query_used = 0;
+}
+
+int memgov_admit(void)
+{
+    struct timespec ts;
+    int waited = 0, timedout = 0;
+    int wait_ms = gbl_mem_admission_wait_ms;
+
+    if (!server_over())
+        return 0;
+
+    ATOMIC_ADD64(gov_admission_waits, 1);
+    Pthread_mutex_lock(&gov_lk);
+    ATOMIC_ADD32(gov_waiters, 1);
+    while (server_over()) {
+        if (waited >= wait_ms) {
+            timedout = 1;
+            break;
+        }
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += MEMGOV_ADMIT_POLL_MS * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&gov_cond, &gov_lk, &ts);
+        waited += MEMGOV_ADMIT_POLL_MS;
+    }
+    ATOMIC_ADD32(gov_waiters, -1);
+    Pthread_mutex_unlock(&gov_lk);
+
+    if (timedout)
+        ATOMIC_ADD64(gov_admission_timeouts, 1);
+    return timedout;
+}
+
+void memgov_get_stats(struct memgov_stats *out)
+{
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < MEMGOV_MAX; i++) {
+        out->used[i] = ATOMIC_LOAD64(gov_used[i]);
+        out->spills[i] = ATOMIC_LOAD64(gov_spills[i]);
+    }
+    out->total = ATOMIC_LOAD64(gov_total);
+    out->admission_waits = ATOMIC_LOAD64(gov_admission_waits);
+    out->admission_timeouts = ATOMIC_LOAD64(gov_admission_timeouts);
+}
@@ -0,0 +1,64 @@
+/*
+   Copyright 2024 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef INCLUDED_MEM_GOVERNOR_H
+#define INCLUDED_MEM_GOVERNOR_H
+
+/* Memory governor.  The subsystems that can move what they hold to disk
+   charge what they keep in memory here, and ask before growing whether they
+   should spill instead: when the server as a whole is over mem_budget_mb,
+   when the subsystem is over its own budget, or when the statement the
+   calling thread runs is over mem_query_budget_mb.  A budget of 0 is no
+   budget.  A new statement is held back for up to mem_admission_wait_ms
+   while the server is over its budget, rather than being let in to add to
+   it. */
+
+enum memgov_subsys { MEMGOV_TEMPTABLE, MEMGOV_SORTER, MEMGOV_MAX };
+
+extern int gbl_mem_budget_mb;
+extern int gbl_mem_budget_temptable_mb;
+extern int gbl_mem_budget_sorter_mb;
+extern int gbl_mem_query_budget_mb;
+extern int gbl_mem_admission_wait_ms;
+
+struct memgov_stats {
+    long long used[MEMGOV_MAX];
+    long long total;
+    long long spills[MEMGOV_MAX];
+    long long admission_waits;
+    long long admission_timeouts;
+};
+
+/* Add bytes, or give them back if negative, to what subsys holds in memory
+   and to what the calling thread's statement holds */
+void memgov_charge(enum memgov_subsys subsys, long long bytes);
+
+/* Whether subsys should spill what it holds rather than grow */
+int memgov_over(enum memgov_subsys subsys);
+
+/* Count a spill memgov_over asked for */
+void memgov_spilled(enum memgov_subsys subsys);
+
+/* The calling thread starts a new statement */
+void memgov_query_start(void);
+
+/* Wait while the server is over its budget.  Returns 0 once under, or 1 if
+   mem_admission_wait_ms went by first; the statement is let in either way. */
+int memgov_admit(void);
+
+void memgov_get_stats(struct memgov_stats *out);
+
+#endif
@@ -26,9 +26,11 @@
 #include <pthread.h>
 
 #include "plhash.h"
+#include "list.h"
 #include "object_pool.h"
 #include "logmsg.h"
 #include "locks_wrap.h"
+#include "comdb2_atomic.h"
 
 #include <mem_util.h>
 #include <mem_override.h>
@@ -39,13 +41,16 @@
 #define full(op) ((op)->nobjs == (op)->capacity)
 #define empty(op) ((op)->nobjs == 0)
 #define exhausted(op) ((op)->nactiveobjs == (op)->nobjs)
+/* idle objects in the pool itself; the ones in thread magazines are counted
+   in nactiveobjs, as they are out of it, and again in nmagobjs */
 #define nidles(op) ((op)->nobjs - (op)->nactiveobjs)
+#define nallidles(op) (nidles(op) + ATOMIC_LOAD32((op)->nmagobjs))
 #define idle_rate(op)                                                          \
-    (((op)->nobjs == 0) ? 0 : (nidles(op) * 100.0 / (op)->nobjs))
+    (((op)->nobjs == 0) ? 0 : (nallidles(op) * 100.0 / (op)->nobjs))
 #define idle_minus_1_rate(op)                                                  \
-    (((op)->nobjs == 0) ? 0 : ((nidles(op) - 1) * 100.0 / (op)->nobjs))
+    (((op)->nobjs == 0) ? 0 : ((nallidles(op) - 1) * 100.0 / (op)->nobjs))
 #define idle_plus_1_rate(op)                                                   \
-    (((op)->nobjs == 0) ? 0 : ((nidles(op) + 1) * 100.0 / (op)->nobjs))
+    (((op)->nobjs == 0) ? 0 : ((nallidles(op) + 1) * 100.0 / (op)->nobjs))
 
 #define reached_max_idle_criteria(op)                                          \
     (((op)->max_idle_ratio == OPT_DISABLE)                                     \
@@ -53,7 +58,7 @@
          : (idle_plus_1_rate(op) > (op)->max_idle_ratio))
 
 #define reached_max_idles(op)                                                  \
-    (((op)->max_idles != OPT_DISABLE) ? (nidles(op) >= (op)->max_idles) : 0)
+    (((op)->max_idles != OPT_DISABLE) ? (nallidles(op) >= (op)->max_idles) : 0)
 
 #define reached_min_idle_criteria(op)                                          \
     (((op)->min_idle_ratio == OPT_DISABLE)                                     \
@@ -61,7 +66,7 @@
          : (idle_minus_1_rate(op) < (op)->min_idle_ratio))
 
 #define reached_min_idles(op)                                                  \
-    (((op)->min_idles != OPT_DISABLE) ? (nidles(op) <= (op)->min_idles) : 0)
+    (((op)->min_idles != OPT_DISABLE) ? (nallidles(op) <= (op)->min_idles) : 0)
 
 #define eviction_disabled(op)                                                  \
     (op->evict_intv_ms == OPT_DISABLE && op->evict_ratio == OPT_DISABLE)
@@ -100,6 +105,45 @@ typedef struct pooled_object {
     pthread_t tid;
 } pooled_object;
 
+/*
+** Per-thread magazines (lifo only). A thread keeps up to mag_size idle
+** objects of its own, and lends them out and takes them back without the
+** pool's lock. It goes to the pool for more once its magazine is empty,
+** taking half a magazine along with the object it asked for, and hands
+** half of it back when it is full. An object the thread borrowed is
+** remembered in `lent', so that giving it back needs no lookup in the
+** history table; a return from another thread makes the pool forget it
+** there.
+**
+** The pool takes a magazine whole with an exchange while it holds its own
+** lock, as does the owner for the length of a borrow or return; whoever
+** finds it taken goes the locked way instead. The pool empties the
+** magazines into itself before an eviction run, before a resize, and
+** before it waits or creates an object for an exhausted borrower.
+*/
+#define OP_MAG_MAX 32
+#define OP_LENT_MAX 16
+#define OP_TLS_SLOTS 4
+
+struct objpool_mag {
+    int n;
+    pooled_object *recs[OP_MAG_MAX]; /* least recently returned first */
+};
+
+struct objpool_lent {
+    void *object;
+    pooled_object *rec; /* cleared by the pool if returned by another thd */
+};
+
+typedef struct objpool_thd {
+    pthread_t tid;
+    struct objpool_mag *mag; /* NULL while taken */
+    struct objpool_mag magbuf;
+    struct objpool_lent lent[OP_LENT_MAX];
+    int nextlent;
+    LINKC_T(struct objpool_thd) lnk;
+} objpool_thd;
+
 typedef struct comdb2_objpool {
     enum objpool_type type;
 
@@ -131,6 +175,7 @@ typedef struct comdb2_objpool {
     unsigned int nborrows;
     unsigned int nborrowwaits;
     unsigned int npeakborrowwaits;
+    unsigned int nmagobjs;
 
     /* conf */
     int capacity;
@@ -163,6 +208,14 @@ typedef struct comdb2_objpool {
     int out;
     void **objs;
 
+    /*
+    ** per-thread magazines
+    */
+    int mag_size;
+    unsigned long long id;
+    LISTC_T(struct objpool_thd) thds;
+    LINKC_T(struct comdb2_objpool) reglnk;
+
     size_t namesz;
     char name[1];
 } comdb2_objpool;
@@ -216,6 +269,32 @@ static void objpool_rand_clear(comdb2_objpool_t op);
 
 static void objpool_evict_all_int(comdb2_objpool_t op);
 
+/*****************************
+** per-thread magazine layer *
+******************************/
+static void objpool_registry_add(comdb2_objpool_t op);
+static int objpool_mag_borrow(comdb2_objpool_t op, void **objp);
+static int objpool_mag_return(comdb2_objpool_t op, void *obj);
+static void objpool_mag_borrowed(comdb2_objpool_t op, pooled_object *rec);
+static void objpool_mag_returned(comdb2_objpool_t op, pooled_object *rec);
+static int objpool_mag_drain_all(comdb2_objpool_t op);
+static void objpool_mag_free_all(comdb2_objpool_t op);
+static int opt_mag_size(comdb2_objpool_t op, int value);
+
+/* registry of live pools, for a thread exiting to know which of the pools
+   it has a magazine with are still there */
+static pthread_mutex_t objpool_reg_lk = PTHREAD_MUTEX_INITIALIZER;
+static LISTC_T(struct comdb2_objpool) objpool_reg;
+static unsigned long long objpool_next_id;
+static pthread_once_t objpool_once = PTHREAD_ONCE_INIT;
+static pthread_key_t objpool_key;
+
+static __thread struct {
+    comdb2_objpool_t op;
+    unsigned long long id;
+    objpool_thd *thd;
+} objpool_tls[OP_TLS_SLOTS];
+
 /*************************
 ** stats-display helpers *
 **************************/
@@ -281,12 +360,18 @@ int comdb2_objpool_clear(comdb2_objpool_t op)
 int comdb2_objpool_destroy(comdb2_objpool_t op)
 {
     {
+        /* thread exit looks the pool up under objpool_reg_lk */
+        Pthread_mutex_lock(&objpool_reg_lk);
         Pthread_mutex_lock(&op->data_mutex);
+        objpool_mag_drain_all(op);
         if (op->nactiveobjs > 0) {
             /* active objects out there, can't proceed */
             Pthread_mutex_unlock(&op->data_mutex);
+            Pthread_mutex_unlock(&objpool_reg_lk);
             return EBUSY;
         }
+        listc_rfl(&objpool_reg, op);
+        Pthread_mutex_unlock(&objpool_reg_lk);
 
         op->stopped = 1;
 
@@ -308,6 +393,7 @@ int comdb2_objpool_destroy(comdb2_objpool_t op)
 
         /* clear all objects in the pool */
         op->clear_impl(op);
+        objpool_mag_free_all(op);
 
         /* clear access history */
         hash_for(op->history, hash_elem_free_wrapper, NULL);
@@ -359,6 +445,9 @@ int comdb2_objpool_setopt(comdb2_objpool_t op,
         case OP_IDLE_TIME:
             rc = opt_idle_time_ms(op, value);
             break;
+        case OP_MAGAZINE_SIZE:
+            rc = opt_mag_size(op, value);
+            break;
         default:
             rc = EINVAL;
             break;
@@ -370,6 +459,8 @@ int comdb2_objpool_setopt(comdb2_objpool_t op,
 
 int comdb2_objpool_return(comdb2_objpool_t op, void *obj)
 {
+    if (objpool_mag_return(op, obj))
+        return 0;
     return objpool_return_int(op, obj);
 }
 
@@ -413,7 +504,11 @@ int comdb2_objpool_size(comdb2_objpool_t op) { return op->nobjs; }
 
 int comdb2_objpool_stats(comdb2_objpool_t op)
 {
+    unsigned int nmag, nactive;
+
     Pthread_mutex_lock(&op->data_mutex);
+    nmag = ATOMIC_LOAD32(op->nmagobjs);
+    nactive = op->nactiveobjs - nmag;
 
     /* status */
     logmsg(LOGMSG_USER, "Object pool [%s] stats\n", op->name);
@@ -421,17 +516,18 @@ int comdb2_objpool_stats(comdb2_objpool_t op)
     logmsg(LOGMSG_USER, "  Status               : %s\n",
            op->stopped ? "STOPPED" : "running");
     logmsg(LOGMSG_USER, "  Current load         : %.f%%\n",
-           (op->nobjs == 0) ? 0 : 100.0 * (op->nborrowwaits + op->nactiveobjs) /
+           (op->nobjs == 0) ? 0 : 100.0 * (op->nborrowwaits + nactive) /
                                       op->nobjs);
     logmsg(LOGMSG_USER, "  # total objects      : %u\n", op->nforcedobjs + op->nobjs);
     logmsg(LOGMSG_USER, "  # peak               : %u\n",
            op->npeakobjs == 0 ? op->nobjs : op->npeakobjs);
-    logmsg(LOGMSG_USER, "  # active             : %u\n", op->nactiveobjs + op->nforcedobjs);
-    logmsg(LOGMSG_USER, "  # idle               : %u\n", nidles(op));
+    logmsg(LOGMSG_USER, "  # active             : %u\n", nactive + op->nforcedobjs);
+    logmsg(LOGMSG_USER, "  # idle               : %u\n", nidles(op) + nmag);
+    logmsg(LOGMSG_USER, "  # idle in magazines  : %u\n", nmag);
     logmsg(LOGMSG_USER, "  # pooled objects     : %u\n", op->nobjs);
     logmsg(LOGMSG_USER, "  # unpooled objects   : %u\n", op->nforcedobjs);
-    logmsg(LOGMSG_USER, "  # returns            : %u\n", op->nreturns);
-    logmsg(LOGMSG_USER, "  # borrows            : %u\n", op->nborrows);
+    logmsg(LOGMSG_USER, "  # returns            : %u\n", ATOMIC_LOAD32(op->nreturns));
+    logmsg(LOGMSG_USER, "  # borrows            : %u\n", ATOMIC_LOAD32(op->nborrows));
     logmsg(LOGMSG_USER, "  # borrow waits       : %u\n", op->nborrowwaits);
     logmsg(LOGMSG_USER, "  # peak borrow waits  : %u\n", op->npeakborrowwaits);
     logmsg(LOGMSG_USER, "  Capacity             : %u\n", op->capacity);
@@ -472,6 +568,11 @@ int comdb2_objpool_stats(comdb2_objpool_t op)
     else
         logmsg(LOGMSG_USER, "  Max idle time        : %d ms\n", op->idle_time_ms);
 
+    if (op->mag_size == 0)
+        logmsg(LOGMSG_USER, "  Magazine size        : DISABLED\n");
+    else
+        logmsg(LOGMSG_USER, "  Magazine size        : %d\n", op->mag_size);
+
     Pthread_mutex_unlock(&op->data_mutex);
 
     return 0;
@@ -578,6 +679,11 @@ static int comdb2_objpool_create_int(comdb2_objpool_t *opp, const char *name,
     op->nborrows = 0;
     op->nborrowwaits = 0;
     op->npeakborrowwaits = 0;
+    op->nmagobjs = 0;
+
+    op->mag_size = (type == OP_LIFO) ? 4 : 0;
+    listc_init(&op->thds, offsetof(struct objpool_thd, lnk));
+    objpool_registry_add(op);
 
     OP_DBG(op, "object pool created");
     *opp = op;
@@ -613,6 +719,7 @@ static int object_create(comdb2_objpool_t op, void **objp)
         if (op->nobjs > op->npeakobjs)
             op->npeakobjs = op->nobjs;
         ++op->nactiveobjs;
+        objpool_mag_borrowed(op, rec);
         logmsg(LOGMSG_INFO, "created a pool %s object %p\n", op->name, *objp);
         OP_DBG(op, "create object done");
     } else {
@@ -696,9 +803,12 @@ static int objpool_return_int(comdb2_objpool_t op, void *obj)
     }
 
     rec = (pooled_object *)hash_find_readonly(op->history, &obj);
+    if (rec != NULL && rec->active)
+        objpool_mag_returned(op, rec);
+
     if (rec == NULL) {
         --op->nforcedobjs;
-        ++op->nreturns;
+        ATOMIC_ADD32(op->nreturns, 1);
         /* obj was forcefully-created, free it and return */
         rc = 0;
         if (op->del_fn != NULL)
@@ -721,7 +831,7 @@ static int objpool_return_int(comdb2_objpool_t op, void *obj)
         if (op->del_fn != NULL)
             rc = op->del_fn(obj, op->del_arg);
         --op->nactiveobjs;
-        ++op->nreturns;
+        ATOMIC_ADD32(op->nreturns, 1);
         --op->nobjs;
         logmsg(LOGMSG_INFO, "destroyed a pool %s object %p\n", op->name, obj);
         OP_DBG(op, "evicted due to max idle");
@@ -732,7 +842,7 @@ static int objpool_return_int(comdb2_objpool_t op, void *obj)
 
         op->put_impl(op, obj);
         --op->nactiveobjs;
-        ++op->nreturns;
+        ATOMIC_ADD32(op->nreturns, 1);
         OP_DBG(op, "returned to pool");
 
         if (op->evict_ratio != OPT_DISABLE &&
@@ -766,6 +876,9 @@ static int objpool_borrow_int(comdb2_objpool_t op, void **objp, long nanosecs,
     if (op->stopped)
         return EPERM;
 
+    if (objpool_mag_borrow(op, objp))
+        return 0;
+
     Pthread_mutex_lock(&op->data_mutex);
 
     if (op->stopped) {
@@ -775,6 +888,10 @@ static int objpool_borrow_int(comdb2_objpool_t op, void **objp, long nanosecs,
 
 retry:
 
+    /* idle objects in magazines are used before new ones are made */
+    if (exhausted(op) && ATOMIC_LOAD32(op->nmagobjs) != 0)
+        objpool_mag_drain_all(op);
+
     if (exhausted(op)) {
         if (!full(op)) {
             /*
@@ -784,7 +901,7 @@ retry:
             OP_DBG(op, "pool exhausted but not full");
             rc = object_create(op, objp);
             if (rc == 0)
-                ++op->nborrows;
+                ATOMIC_ADD32(op->nborrows, 1);
             Pthread_mutex_unlock(&op->data_mutex);
             return rc;
         }
@@ -800,7 +917,7 @@ retry:
                 ++op->nforcedobjs;
                 if (op->nforcedobjs + op->nobjs > op->npeakobjs)
                     op->npeakobjs = op->nforcedobjs + op->nobjs;
-                ++op->nborrows;
+                ATOMIC_ADD32(op->nborrows, 1);
             }
             logmsg(LOGMSG_INFO, "created a forced pool %s object %p (%d)\n",
                    op->name, *objp, rc);
@@ -842,11 +959,22 @@ retry:
              ** if pool is full and caller is willing to wait,
              ** make a condition wait on unexhausted
              */
-            ++op->nborrowwaits;
+            ATOMIC_ADD32(op->nborrowwaits, 1);
             OP_DBG(op, "pool exhausted and full, wait");
             if (op->nborrowwaits > op->npeakborrowwaits)
                 op->npeakborrowwaits = op->nborrowwaits;
 
+            /*
+            ** a magazine return that came in before it could see
+            ** the wait is in a magazine now; one that comes in
+            ** after drains its magazine and signals
+            */
+            if (ATOMIC_LOAD32(op->nmagobjs) != 0 &&
+                objpool_mag_drain_all(op) != 0) {
+                ATOMIC_ADD32(op->nborrowwaits, -1);
+                break;
+            }
+
             rc = 0;
             if (nanosecs < 0)
                 Pthread_cond_wait(&op->unexhausted, &op->data_mutex);
@@ -860,7 +988,7 @@ retry:
                 rc = pthread_cond_timedwait(&op->unexhausted, &op->data_mutex,
                                             &tm);
             }
-            --op->nborrowwaits;
+            ATOMIC_ADD32(op->nborrowwaits, -1);
             OP_DBG(op, "thr wake up");
 
             if (rc != 0) {
@@ -890,7 +1018,7 @@ retry:
                 OP_DBG(op, "pool exhausted but no longer full");
                 rc = object_create(op, objp);
                 if (rc == 0)
-                    ++op->nborrows;
+                    ATOMIC_ADD32(op->nborrows, 1);
                 Pthread_mutex_unlock(&op->data_mutex);
                 return rc;
             }
@@ -899,13 +1027,14 @@ retry:
 
     op->get_impl(op, objp);
     ++op->nactiveobjs;
-    ++op->nborrows;
+    ATOMIC_ADD32(op->nborrows, 1);
 
     /* update access history */
     rec = (pooled_object *)hash_find(op->history, objp);
     rec->active = 1;
     ++rec->nborrows;
     rec->tid = pthread_self();
+    objpool_mag_borrowed(op, rec);
 
     Pthread_mutex_unlock(&op->data_mutex);
 
@@ -937,6 +1066,8 @@ static void objpool_lifo_evict(comdb2_objpool_t op)
 
     Pthread_mutex_lock(&op->data_mutex);
 
+    objpool_mag_drain_all(op);
+
     clock_gettime(CLOCK_REALTIME, &tm);
 
     int nidles = nidles(op);
@@ -1129,6 +1260,8 @@ static void objpool_evict_all_int(comdb2_objpool_t op)
 
     Pthread_mutex_lock(&op->data_mutex);
 
+    objpool_mag_drain_all(op);
+
     int nidles = nidles(op);
 
     for (indx = 0; indx < nidles; ++indx) {
@@ -1168,6 +1301,8 @@ static int opt_capacity(comdb2_objpool_t op, int value)
        that can be copied to the new ring buffer */
     size_t nidleobjscpy;
 
+    objpool_mag_drain_all(op);
+
     if (value <= 0 || value < op->nactiveobjs)
         return EINVAL;
 
@@ -1341,4 +1476,385 @@ static const char *objpool_type_name(comdb2_objpool_t op)
     }
     return "UNKNOWN";
 }
+
+static void objpool_thd_exit(void *unused);
+
+static void objpool_init_once(void)
+{
+    listc_init(&objpool_reg, offsetof(struct comdb2_objpool, reglnk));
+    pthread_key_create(&objpool_key, objpool_thd_exit);
+}
+
+static void objpool_registry_add(comdb2_objpool_t op)
+{
+    pthread_once(&objpool_once, objpool_init_once);
+    Pthread_mutex_lock(&objpool_reg_lk);
+    op->id = ++objpool_next_id;
+    listc_abl(&objpool_reg, op);
+    Pthread_mutex_unlock(&objpool_reg_lk);
+}
+
+/* expects objpool_reg_lk held */
+static int objpool_registered(comdb2_objpool_t op, unsigned long long id)
+{
+    comdb2_objpool_t p;
+    LISTC_FOR_EACH(&objpool_reg, p, reglnk)
+    {
+        if (p == op && p->id == id)
+            return 1;
+    }
+    return 0;
+}
+
+static objpool_thd *objpool_thd_get(comdb2_objpool_t op)
+{
+    int i;
+    for (i = 0; i != OP_TLS_SLOTS; ++i) {
+        if (objpool_tls[i].op == op && objpool_tls[i].id == op->id)
+            return objpool_tls[i].thd;
+    }
+    return NULL;
+}
+
+/* expects data_mutex held */
+static objpool_thd *objpool_thd_create(comdb2_objpool_t op)
+{
+    objpool_thd *thd;
+    int i;
+
+    for (i = 0; i != OP_TLS_SLOTS && objpool_tls[i].op != NULL; ++i)
+        ;
+
+    /*
+    ** no free slot: reclaim the ones of pools destroyed since. the lock
+    ** order is objpool_reg_lk before data_mutex, so only try.
+    */
+    if (i == OP_TLS_SLOTS && pthread_mutex_trylock(&objpool_reg_lk) == 0) {
+        for (i = 0; i != OP_TLS_SLOTS; ++i) {
+            if (!objpool_registered(objpool_tls[i].op, objpool_tls[i].id))
+                objpool_tls[i].op = NULL;
+        }
+        Pthread_mutex_unlock(&objpool_reg_lk);
+        for (i = 0; i != OP_TLS_SLOTS && objpool_tls[i].op != NULL; ++i)
+            ;
+    }
+
+    if (i == OP_TLS_SLOTS)
+        return NULL;
+
+    thd = calloc(1, sizeof(objpool_thd));
+    if (thd == NULL)
+        return NULL;
+    thd->tid = pthread_self();
+    thd->mag = &thd->magbuf;
+    listc_abl(&op->thds, thd);
+
+    objpool_tls[i].op = op;
+    objpool_tls[i].id = op->id;
+    objpool_tls[i].thd = thd;
+
+    /* have objpool_thd_exit() run when the thread goes away */
+    pthread_setspecific(objpool_key, (void *)1);
+    return thd;
+}
+
+static int timespec_cmp(const struct timespec *a, const struct timespec *b)
+{
+    if (a->tv_sec != b->tv_sec)
+        return (a->tv_sec < b->tv_sec) ? -1 : 1;
+    if (a->tv_nsec != b->tv_nsec)
+        return (a->tv_nsec < b->tv_nsec) ? -1 : 1;
+    return 0;
+}
+
+/*
+** put an object back into the lifo by the time it was returned, so that
+** the oldest idle objects stay at the bottom where eviction looks for them
+*/
+static void objpool_lifo_put_sorted(comdb2_objpool_t op, pooled_object *rec)
+{
+    pooled_object *other;
+    int indx;
+
+    for (indx = op->in; indx > 0; --indx) {
+        other = (pooled_object *)hash_find(op->history, &op->objs[indx - 1]);
+        if (timespec_cmp(&other->tm, &rec->tm) <= 0)
+            break;
+    }
+
+    memmove(op->objs + indx + 1, op->objs + indx,
+            sizeof(void *) * (op->in - indx));
+    op->objs[indx] = rec->object;
+    op->out = op->in;
+    ++op->in;
+}
+
+/* move all but `keep' objects of thd's magazine into the pool.
+   expects data_mutex held */
+static int objpool_mag_drain(comdb2_objpool_t op, objpool_thd *thd, int keep)
+{
+    struct objpool_mag *mag;
+    int indx, n;
+
+    mag = XCHANGEPTR(thd->mag, NULL);
+    if (mag == NULL) /* the owner is in the middle of using it */
+        return 0;
+
+    n = mag->n - keep;
+    if (n > 0) {
+        for (indx = 0; indx != n; ++indx)
+            objpool_lifo_put_sorted(op, mag->recs[indx]);
+        memmove(mag->recs, mag->recs + n, sizeof(pooled_object *) * keep);
+        mag->n = keep;
+        op->nactiveobjs -= n;
+        ATOMIC_ADD32(op->nmagobjs, -n);
+    } else {
+        n = 0;
+    }
+
+    (void)XCHANGEPTR(thd->mag, mag);
+    return n;
+}
+
+/* expects data_mutex held */
+static int objpool_mag_drain_all(comdb2_objpool_t op)
+{
+    objpool_thd *thd;
+    int n = 0;
+
+    LISTC_FOR_EACH(&op->thds, thd, lnk)
+    {
+        n += objpool_mag_drain(op, thd, 0);
+    }
+
+    if (n != 0)
+        OP_DBG(op, "magazines drained");
+    return n;
+}
+
+/* expects data_mutex held and the magazines drained */
+static void objpool_mag_free_all(comdb2_objpool_t op)
+{
+    objpool_thd *thd, *tmp;
+    LISTC_FOR_EACH_SAFE(&op->thds, thd, tmp, lnk)
+    {
+        listc_rfl(&op->thds, thd);
+        free(thd);
+    }
+}
+
+static void objpool_lent_add(objpool_thd *thd, pooled_object *rec)
+{
+    struct objpool_lent *lent = &thd->lent[thd->nextlent];
+    thd->nextlent = (thd->nextlent + 1) % OP_LENT_MAX;
+    lent->object = rec->object;
+    (void)XCHANGEPTR(lent->rec, rec);
+}
+
+static pooled_object *objpool_lent_take(objpool_thd *thd, void *obj)
+{
+    pooled_object *rec;
+    int indx;
+
+    for (indx = 0; indx != OP_LENT_MAX; ++indx) {
+        if (thd->lent[indx].object != obj)
+            continue;
+        /* may have been cleared by a return from another thread */
+        rec = XCHANGEPTR(thd->lent[indx].rec, NULL);
+        if (rec != NULL && rec->object == obj)
+            return rec;
+    }
+    return NULL;
+}
+
+/* borrow from the calling thread's magazine. returns 1 if it did */
+static int objpool_mag_borrow(comdb2_objpool_t op, void **objp)
+{
+    struct objpool_mag *mag;
+    pooled_object *rec;
+    objpool_thd *thd;
+
+    if (op->mag_size == 0 || op->stopped || (thd = objpool_thd_get(op)) == NULL)
+        return 0;
+
+    mag = XCHANGEPTR(thd->mag, NULL);
+    if (mag == NULL) /* taken by the pool */
+        return 0;
+
+    if (mag->n == 0) {
+        (void)XCHANGEPTR(thd->mag, mag);
+        return 0;
+    }
+
+    rec = mag->recs[--mag->n];
+    ATOMIC_ADD32(op->nmagobjs, -1);
+    (void)XCHANGEPTR(thd->mag, mag);
+
+    rec->active = 1;
+    ++rec->nborrows;
+    rec->tid = thd->tid;
+    ATOMIC_ADD32(op->nborrows, 1);
+    objpool_lent_add(thd, rec);
+
+    *objp = rec->object;
+    OP_DBG(op, "borrowed from magazine");
+    return 1;
+}
+
+/* return to the calling thread's magazine. returns 1 if it did */
+static int objpool_mag_return(comdb2_objpool_t op, void *obj)
+{
+    struct objpool_mag *mag;
+    pooled_object *rec;
+    objpool_thd *thd;
+
+    if (op->mag_size == 0 || op->stopped || (thd = objpool_thd_get(op)) == NULL)
+        return 0;
+
+    /* leave it to the locked way to hand out, delete or signal eviction */
+    if (ATOMIC_LOAD32(op->nborrowwaits) != 0 ||
+        reached_max_idle_criteria(op) ||
+        (op->evict_ratio != OPT_DISABLE &&
+         idle_plus_1_rate(op) >= op->evict_ratio))
+        return 0;
+
+    rec = objpool_lent_take(thd, obj);
+    if (rec == NULL)
+        return 0;
+
+    mag = XCHANGEPTR(thd->mag, NULL);
+    if (mag == NULL || mag->n >= op->mag_size) {
+        if (mag != NULL)
+            (void)XCHANGEPTR(thd->mag, mag);
+        return 0;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &rec->tm);
+    ++rec->nreturns;
+    rec->active = 0;
+    mag->recs[mag->n++] = rec;
+    ATOMIC_ADD32(op->nmagobjs, 1);
+    (void)XCHANGEPTR(thd->mag, mag);
+    ATOMIC_ADD32(op->nreturns, 1);
+
+    /* a borrower started waiting and may not have seen the magazine */
+    if (ATOMIC_LOAD32(op->nborrowwaits) != 0) {
+        Pthread_mutex_lock(&op->data_mutex);
+        if (objpool_mag_drain(op, thd, 0) != 0)
+            Pthread_cond_broadcast(&op->unexhausted);
+        Pthread_mutex_unlock(&op->data_mutex);
+    }
+
+    OP_DBG(op, "returned to magazine");
+    return 1;
+}
+
+/*
+** an object was borrowed the locked way: remember it lent out, and fill the
+** magazine of the calling thread up to half from the pool. expects
+** data_mutex held
+*/
+static void objpool_mag_borrowed(comdb2_objpool_t op, pooled_object *rec)
+{
+    struct objpool_mag *mag;
+    objpool_thd *thd;
+    void *object;
+    int n;
+
+    if (op->mag_size == 0)
+        return;
+
+    thd = objpool_thd_get(op);
+    if (thd == NULL && (thd = objpool_thd_create(op)) == NULL)
+        return;
+
+    objpool_lent_add(thd, rec);
+
+    mag = XCHANGEPTR(thd->mag, NULL);
+    if (mag == NULL)
+        return;
+
+    n = min(op->mag_size / 2 - mag->n, (int)nidles(op));
+    if (n > 0) {
+        /* the most recently returned comes out of the pool first */
+        memmove(mag->recs + n, mag->recs, sizeof(pooled_object *) * mag->n);
+        mag->n += n;
+        while (n-- > 0) {
+            op->get_impl(op, &object);
+            mag->recs[n] = (pooled_object *)hash_find(op->history, &object);
+            ++op->nactiveobjs;
+            ATOMIC_ADD32(op->nmagobjs, 1);
+        }
+    }
+
+    (void)XCHANGEPTR(thd->mag, mag);
+}
+
+/*
+** an object is returned the locked way: forget it lent out, and make room
+** in the calling thread's magazine if it is full. expects data_mutex held
+*/
+static void objpool_mag_returned(comdb2_objpool_t op, pooled_object *rec)
+{
+    objpool_thd *thd;
+    int indx;
+
+    if (LISTC_TOP(&op->thds) == NULL)
+        return;
+
+    LISTC_FOR_EACH(&op->thds, thd, lnk)
+    {
+        if (!pthread_equal(thd->tid, rec->tid))
+            continue;
+        for (indx = 0; indx != OP_LENT_MAX; ++indx) {
+            pooled_object *expected = rec;
+            if (CASPTR(thd->lent[indx].rec, expected, NULL))
+                break;
+        }
+        break;
+    }
+
+    thd = objpool_thd_get(op);
+    if (thd != NULL && ATOMIC_LOADPTR(thd->mag) != NULL &&
+        thd->mag->n >= op->mag_size)
+        objpool_mag_drain(op, thd, op->mag_size / 2);
+}
+
+/*
+** thread-specific data destructor: give back what is in the magazines of
+** the exiting thread to the pools still there
+*/
+static void objpool_thd_exit(void *unused)
+{
+    comdb2_objpool_t op;
+    objpool_thd *thd;
+    int i;
+
+    Pthread_mutex_lock(&objpool_reg_lk);
+    for (i = 0; i != OP_TLS_SLOTS; ++i) {
+        op = objpool_tls[i].op;
+        thd = objpool_tls[i].thd;
+        objpool_tls[i].op = NULL;
+        if (op == NULL || !objpool_registered(op, objpool_tls[i].id))
+            continue;
+
+        Pthread_mutex_lock(&op->data_mutex);
+        objpool_mag_drain(op, thd, 0);
+        listc_rfl(&op->thds, thd);
+        if (op->nborrowwaits != 0)
+            Pthread_cond_broadcast(&op->unexhausted);
+        Pthread_mutex_unlock(&op->data_mutex);
+        free(thd);
+    }
+    Pthread_mutex_unlock(&objpool_reg_lk);
+}
+
+static int opt_mag_size(comdb2_objpool_t op, int value)
+{
+    if (op->type != OP_LIFO || value < 0 || value > OP_MAG_MAX)
+        return EINVAL;
+    objpool_mag_drain_all(op);
+    op->mag_size = value;
+    return 0;
+}
 // ^^^^^^static function impl
@@ -20,6 +20,9 @@
 #include <strings.h>
 #include <inttypes.h>
 #include <sys/types.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 /* DISABLE 'restrict' keyword usage pending further testing by Systems Group */
 #define restrict
@@ -35,7 +38,7 @@
 
 typedef void *hash_kfnd_t(hash_t *const h, const void *const restrict vkey);
 
-enum hash_scheme { HASH_BY_PRIMES, HASH_BY_POWER2 };
+enum hash_scheme { HASH_BY_PRIMES, HASH_BY_POWER2, HASH_OPEN };
 
 typedef struct hashent {
     struct hashent *next;
@@ -87,6 +90,11 @@ struct hash {
     hashmalloc_t *malloc_fn;
     hashfree_t *free_fn;
     enum hash_scheme scheme;
+    /* HASH_OPEN tables */
+    unsigned char *ctrl;   /* one byte per slot, see OPEN_EMPTY */
+    unsigned char **slots; /* objects */
+    unsigned int ngroups;  /* slots / OPEN_GROUP, a power of 2 */
+    unsigned int ntomb;    /* OPEN_DELETED slots */
 };
 
 enum { PRIME = 8388013 };
@@ -996,6 +1004,203 @@ static unsigned int hash_default_i4(const unsigned int *a,
 
 #define is_lockfree_query(h) 0
 
+/*
+ * Open addressing (HASH_OPEN).
+ *
+ * Objects are kept in a flat array of slots split into groups of
+ * OPEN_GROUP.  A parallel control array has one byte per slot: the low 7
+ * bits of the slot's hash, or OPEN_EMPTY / OPEN_DELETED.  A lookup picks a
+ * group from the rest of the hash, matches the 7 bits against the whole
+ * group's control bytes at once, and only calls the compare function on
+ * the matches, so a miss usually reads one cache line and no objects.
+ * The probe moves on to other groups only when the group is full, and
+ * stops at the first group with an empty slot.  Deletes leave OPEN_DELETED
+ * behind where a probe may have passed the slot; they are dropped when the
+ * table is rebuilt.
+ */
+enum { OPEN_GROUP = 16, OPEN_EMPTY = 0x80, OPEN_DELETED = 0xfe };
+
+/* the classic hash functions here are weak in the low bits */
+static inline unsigned int open_mix(unsigned int hh)
+{
+    hh ^= hh >> 16;
+    hh *= 0x85ebca6bU;
+    hh ^= hh >> 13;
+    hh *= 0xc2b2ae35U;
+    hh ^= hh >> 16;
+    return hh;
+}
+
+/* bit i set if control byte i of the group is c */
+static inline unsigned int open_match(const unsigned char *grp,
+                                      unsigned char c)
+{
+#ifdef __SSE2__
+    __m128i g = _mm_load_si128((const __m128i *)grp);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)c)));
+#else
+    unsigned int m = 0;
+    for (int i = 0; i < OPEN_GROUP; i++)
+        if (grp[i] == c)
+            m |= 1U << i;
+    return m;
+#endif
+}
+
+/* bit i set if slot i of the group is empty or deleted */
+static inline unsigned int open_match_free(const unsigned char *grp)
+{
+#ifdef __SSE2__
+    /* only OPEN_EMPTY and OPEN_DELETED have the top bit set */
+    return _mm_movemask_epi8(_mm_load_si128((const __m128i *)grp));
+#else
+    unsigned int m = 0;
+    for (int i = 0; i < OPEN_GROUP; i++)
+        if (grp[i] & 0x80)
+            m |= 1U << i;
+    return m;
+#endif
+}
+
+/* returns the slot holding key, or -1 */
+static long open_lookup(hash_t *const h, const void *const restrict key)
+{
+    const unsigned int hh = open_mix(HASH(h, key));
+    const unsigned char h2 = hh & 0x7f;
+    const unsigned int gmask = h->ngroups - 1;
+    unsigned int g = (hh >> 7) & gmask;
+    unsigned int nsteps;
+
+    if (h->ngroups == 0)
+        return -1;
+    for (nsteps = 0; nsteps < h->ngroups; nsteps++) {
+        const unsigned char *grp = h->ctrl + (size_t)g * OPEN_GROUP;
+        unsigned int m = open_match(grp, h2);
+        while (m) {
+            const size_t slot = (size_t)g * OPEN_GROUP + __builtin_ctz(m);
+            if (CMP(h, key, h->slots[slot] + h->keyoff) == 0) {
+                h->nsteps += nsteps;
+                if (h->maxsteps < nsteps)
+                    h->maxsteps = nsteps;
+                return slot;
+            }
+            m &= m - 1;
+        }
+        if (open_match(grp, OPEN_EMPTY))
+            break;
+        g = (g + nsteps + 1) & gmask; /* triangular, visits every group */
+    }
+    h->nsteps += nsteps;
+    if (h->maxsteps < nsteps)
+        h->maxsteps = nsteps;
+    return -1;
+}
+
+static void *open_hash_kfnd(hash_t *const h, const void *const restrict vkey)
+{
+    long slot = open_lookup(h, vkey);
+    if (slot < 0) {
+        h->nmisses++;
+        return 0;
+    }
+    h->nhits++;
+    return h->slots[slot];
+}
+
+/* place obj in the first free slot of its probe sequence; table must have
+ * room */
+static void open_place(hash_t *const h, unsigned char *obj)
+{
+    const unsigned int hh = open_mix(HASH(h, obj + h->keyoff));
+    const unsigned int gmask = h->ngroups - 1;
+    unsigned int g = (hh >> 7) & gmask;
+    unsigned int nsteps = 0;
+    unsigned int m;
+
+    while ((m = open_match_free(h->ctrl + (size_t)g * OPEN_GROUP)) == 0)
+        g = (g + ++nsteps) & gmask;
+    const size_t slot = (size_t)g * OPEN_GROUP + __builtin_ctz(m);
+    if (h->ctrl[slot] == OPEN_DELETED)
+        h->ntomb--;
+    h->ctrl[slot] = hh & 0x7f;
+    h->slots[slot] = obj;
+}
+
+/* rebuild with ngroups groups, dropping deleted slots */
+static int open_resize(hash_t *const h, unsigned int ngroups)
+{
+    unsigned char *oldctrl = h->ctrl;
+    unsigned char **oldslots = h->slots;
+    const size_t oldn = (size_t)h->ngroups * OPEN_GROUP;
+    const size_t n = (size_t)ngroups * OPEN_GROUP;
+    unsigned char *ctrl;
+    unsigned char **slots;
+
+    /* the control array is loaded a group at a time, so align it */
+    if ((ctrl = h->malloc_fn(n + OPEN_GROUP)) == 0)
+        return -1;
+    if ((slots = h->malloc_fn(n * sizeof(*slots))) == 0) {
+        h->free_fn(ctrl);
+        return -1;
+    }
+    h->ctrl = (unsigned char *)(((uintptr_t)ctrl + OPEN_GROUP) &
+                                ~(uintptr_t)(OPEN_GROUP - 1));
+    h->ctrl[-1] = h->ctrl - ctrl; /* to find the allocation again */
+    memset(h->ctrl, OPEN_EMPTY, n);
+    h->slots = slots;
+    h->ngroups = ngroups;
+    h->ntomb = 0;
+    for (size_t i = 0; i < oldn; i++)
+        if (!(oldctrl[i] & 0x80))
+            open_place(h, oldslots[i]);
+    if (oldctrl) {
+        h->free_fn(oldctrl - oldctrl[-1]);
+        h->free_fn(oldslots);
+    }
+    h->ngrow++;
+    return 0;
+}
+
+static int open_add(hash_t *const h, void *vobj)
+{
+    const size_t n = (size_t)h->ngroups * OPEN_GROUP;
+
+    /* keep at most 7/8 of the slots full or deleted */
+    if ((h->nents + h->ntomb + 1) * 8 > n * 7) {
+        unsigned int ngroups = h->ngroups;
+        /* grow if live entries fill half, else just drop tombstones; start
+         * about as big as a chained table does */
+        if ((h->nents + 1) * 2 > n)
+            ngroups = h->ngroups ? h->ngroups * 2 : 16;
+        if (open_resize(h, ngroups) != 0)
+            return -1;
+    }
+    open_place(h, vobj);
+    h->nadds++;
+    h->nents++;
+    return 0;
+}
+
+static int open_delk(hash_t *const h, const void *const key)
+{
+    long slot = open_lookup(h, key);
+    size_t g;
+
+    if (slot < 0)
+        return -1;
+    g = slot - slot % OPEN_GROUP;
+    /* a probe for another key went past this group only if it was full */
+    if (open_match(h->ctrl + g, OPEN_EMPTY)) {
+        h->ctrl[slot] = OPEN_EMPTY;
+    } else {
+        h->ctrl[slot] = OPEN_DELETED;
+        h->ntomb++;
+    }
+    h->ndels++;
+    h->nents--;
+    return 0;
+}
+
 /* enable stats for query steps and flipping found entry to head of chain.
  * or, disable stats and set query function to *_nofrills, which skips stats
  * and is always readonly (required when configuring lockfree query) */
@@ -1067,6 +1272,20 @@ static hash_t *hash_init_int(hashfunc_t *hashfunc, cmpfunc_t *cmpfunc,
     return h;
 }
 
+hash_t *hash_init_user_open(hashfunc_t *hashfunc, cmpfunc_t *cmpfunc,
+                            int keyoff, int keysz)
+{
+    return hash_init_int(hashfunc, cmpfunc, malloc, free, keyoff, keysz,
+                         open_hash_kfnd, HASH_OPEN);
+}
+
+/* hash_default_fixedwidth() costs more than the rest of a lookup here */
+hash_t *hash_init_open_o(int keyoff, int keylen)
+{
+    return hash_init_user_open((hashfunc_t *)jenkins_hashbig,
+                               (cmpfunc_t *)memcmp, keyoff, keylen);
+}
+
 hash_t *hash_setalloc_init_user(hashfunc_t *hashfunc, cmpfunc_t *cmpfunc,
                                 hashmalloc_t *hashmalloc, hashfree_t *hashfree,
                                 int keyoff, int keysz)
@@ -1159,6 +1378,16 @@ int hash_initsize(hash_t *h, unsigned int sz)
     if (sz == 0 || h->htab != STARTER_HTAB)
         return -1;
 
+    if (h->scheme == HASH_OPEN) {
+        /* room for sz entries at half full */
+        unsigned int ngroups = 1;
+        if (h->ngroups)
+            return -1;
+        while ((size_t)ngroups * OPEN_GROUP < (size_t)sz * 2)
+            ngroups <<= 1;
+        return open_resize(h, ngroups);
+    }
+
     if ((h->htab = h->malloc_fn(tsz)) != 0) {
         memset(h->htab, 0, tsz);
         h->htab->ntbl = sz;
@@ -1399,6 +1628,8 @@ int hash_add(hash_t *h, void *vobj)
     hashtable *restrict htab = h->htab;
     hashent *restrict he;
     hashent **tbl;
+    if (h->scheme == HASH_OPEN)
+        return open_add(h, vobj);
     if (h->nents >= htab->ntbl >> 1) {
         if ((htab = hash_inctbl(h)) == STARTER_HTAB)
             return -1; /*(failed to resize starter_htab)*/
@@ -1419,6 +1650,8 @@ int hash_add(hash_t *h, void *vobj)
 int hash_delk(hash_t *const h, const void *const key)
 {
     /* must be protected by mutex in threaded application */
+    if (h->scheme == HASH_OPEN)
+        return open_delk(h, key);
     hashtable *const restrict htab = h->htab;
     unsigned int nsteps = 0;
     const unsigned int hh = HASH(h, key);
@@ -1496,6 +1729,10 @@ void hash_clear(hash_t *const h)
             h_free(htab);
         }
     }
+    if (h->ngroups) {
+        memset(h->ctrl, OPEN_EMPTY, (size_t)h->ngroups * OPEN_GROUP);
+        h->ntomb = 0;
+    }
     h->delayed = 0;
     h->nents = 0;
     pool_clear(h->ents);
@@ -1511,6 +1748,10 @@ void hash_free(hash_t *const h)
     }
     if (h->htab != STARTER_HTAB)
         h_free(h->htab);
+    if (h->ctrl) {
+        h_free(h->ctrl - h->ctrl[-1]);
+        h_free(h->slots);
+    }
     pool_free(h->ents);
     memset(h, -1, sizeof(*h)); /* zap it */
     h_free(h);
@@ -1566,6 +1807,20 @@ void hash_dump_stats(hash_t *h, FILE *out, FILE *detail_out)
     int nused;
     char buf[160];
     hashent *he;
+    if (h->scheme == HASH_OPEN) {
+        logmsgf(LOGMSG_USER, out, "Key Size = %-10u      #Ents = %-10u\n",
+                h->keysz, h->nents);
+        logmsgf(LOGMSG_USER, out, "#Slots   = %-10u      #Tomb = %-10u\n",
+                h->ngroups * OPEN_GROUP, h->ntomb);
+        logmsgf(LOGMSG_USER, out, "#Steps   = %-10u   MaxSteps = %-10u\n",
+                h->nsteps, h->maxsteps);
+        logmsgf(LOGMSG_USER, out, "#Hits    = %-10u    #Misses = %-10u\n",
+                h->nhits, h->nmisses);
+        logmsgf(LOGMSG_USER, out, "#Adds    = %-10u      #Dels = %-10u\n",
+                h->nadds, h->ndels);
+        logmsgf(LOGMSG_USER, out, "#TBLgrow = %-10u\n", h->ngrow);
+        return;
+    }
     pool_info(h->ents, 0, &nused, 0);
     logmsgf(LOGMSG_USER, out, "Key Size = %-10u      #Ents = %-10u\n", h->keysz, h->nents);
     logmsgf(LOGMSG_USER, out, "#Table   = %-10u      #Used = %-10d\n", ntbl, nused);
@@ -1605,6 +1860,18 @@ int hash_for(hash_t *const h, hashforfunc_t *const func,
     hashent **const tbl = htab->tbl;
     const unsigned int ntbl = htab->ntbl;
 
+    if (h->scheme == HASH_OPEN) {
+        const size_t n = (size_t)h->ngroups * OPEN_GROUP;
+        /* func may delete the object it is given */
+        for (size_t i = 0; i < n; i++) {
+            if (h->ctrl[i] & 0x80)
+                continue;
+            if ((rc = (*func)(h->slots[i], arg)) != 0)
+                return rc;
+        }
+        return 0;
+    }
+
     for (ii = 0; ii < ntbl; ii++) {
         for (he = tbl[ii]; he; he = nhe) {
             nhe = he->next;
@@ -1625,6 +1892,16 @@ void *hash_first(hash_t *const h, void **const ent,
     const unsigned int ntbl = htab->ntbl;
     unsigned int ii;
 
+    if (h->scheme == HASH_OPEN) {
+        /* bkt is the slot returned last */
+        const size_t n = (size_t)h->ngroups * OPEN_GROUP;
+        for (ii = 0; ii < n && (h->ctrl[ii] & 0x80); ++ii)
+            ;
+        *bkt = ii;
+        *ent = 0;
+        return (ii < n) ? h->slots[ii] : 0;
+    }
+
     for (ii = 0; ii < ntbl && !(he = tbl[ii]); ++ii)
         ;
     *bkt = ii;
@@ -1639,6 +1916,14 @@ void *hash_next(hash_t *const h, void **const ent,
                 unsigned int *const restrict bkt)
 {
     hashent *restrict he = (hashent *)(*ent);
+    if (h->scheme == HASH_OPEN) {
+        const size_t n = (size_t)h->ngroups * OPEN_GROUP;
+        unsigned int ii;
+        for (ii = *bkt + 1; ii < n && (h->ctrl[ii] & 0x80); ++ii)
+            ;
+        *bkt = ii;
+        return (ii < n) ? h->slots[ii] : 0;
+    }
     if (!he) {
         hashtable *const htab = h->htab;
         hashent **const tbl = htab->tbl;
@@ -1665,7 +1950,8 @@ void hash_info2(hash_t *h, int *nhits, int *nmisses, int *nsteps, int *ntbl,
     if (nsteps)
         *nsteps = h->nsteps;
     if (ntbl)
-        *ntbl = h->htab->ntbl;
+        *ntbl = (h->scheme == HASH_OPEN) ? h->ngroups * OPEN_GROUP
+                                         : h->htab->ntbl;
     if (nents)
         *nents = h->nents;
     if (nadds)
@@ -1708,6 +1994,63 @@ static int cnt(void *obj, void *arg)
     return 0;
 }
 
+#include <sys/time.h>
+
+static double now(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* time adds, hits, misses and deletes of n objs, rounds times over;
+ * o[n..2n) are the misses.  Lookups go in a random order, as they do in
+ * the server. */
+static void bench(const char *name, hash_t *(*init)(int, int), int keylen,
+                  struct obj *o, int n, int rounds)
+{
+    double tadd = 0, thit = 0, tmiss = 0, tdel = 0, t;
+    int ii, rr, found = 0;
+    int *order = malloc(n * sizeof(int));
+    hash_t *h;
+
+    for (ii = 0; ii < n; ii++)
+        order[ii] = ii;
+    genkey_seed(n);
+    for (ii = n - 1; ii > 0; ii--) {
+        int jj = lrand48() % (ii + 1), tmp = order[ii];
+        order[ii] = order[jj];
+        order[jj] = tmp;
+    }
+    for (rr = 0; rr < rounds; rr++) {
+        h = init(4, keylen);
+        t = now();
+        for (ii = 0; ii < n; ii++)
+            hash_add(h, &o[ii]);
+        tadd += now() - t;
+        t = now();
+        for (ii = 0; ii < n; ii++)
+            found += hash_find(h, o[order[ii]].key) != 0;
+        thit += now() - t;
+        t = now();
+        for (ii = 0; ii < n; ii++)
+            found += hash_find(h, o[n + order[ii]].key) != 0;
+        tmiss += now() - t;
+        t = now();
+        for (ii = 0; ii < n; ii++)
+            hash_del(h, &o[order[ii]]);
+        tdel += now() - t;
+        hash_free(h);
+    }
+    t = 1e9 / ((double)n * rounds);
+    printf("%-8s keylen %2d n %8d ns/op add %6.1f hit %6.1f miss %6.1f "
+           "del %6.1f (found %d)\n",
+           name, keylen, n, tadd * t, thit * t, tmiss * t, tdel * t, found);
+    free(order);
+}
+
+static hash_t *init_i4(int keyoff, int keylen) { return hash_init_i4(keyoff); }
+
 int main(int argc, char *argv[])
 {
     enum { MAX = 5000000, ITER = 2 };
@@ -1785,6 +2128,26 @@ int main(int argc, char *argv[])
     printf("COUNTED %d ITEMS\n", ii);
     printf("FREE\n");
     hash_free(h);
+
+    /* chained vs open addressing, small to large tables, 16 byte keys
+     * and i4 keys; found should be n * rounds for each */
+    for (ii = 0; ii < 2 * MAX; ii++) {
+        genkey(&objs[ii].key[0], 16);
+        objs[ii].dat = ii;
+    }
+    for (kk = 1000; kk <= MAX; kk *= 70) {
+        bench("chained", hash_init_o, 16, objs, kk, MAX / kk);
+        bench("jenkins", hash_init_jenkins_o, 16, objs, kk, MAX / kk);
+        bench("open", hash_init_open_o, 16, objs, kk, MAX / kk);
+    }
+    for (ii = 0; ii < 2 * MAX; ii++) {
+        unsigned int k = ii * 2654435761U; /* distinct, scattered */
+        memcpy(objs[ii].key, &k, sizeof(k));
+    }
+    for (kk = 1000; kk <= MAX; kk *= 70) {
+        bench("i4", init_i4, 4, objs, kk, MAX / kk);
+        bench("open", hash_init_open_o, 4, objs, kk, MAX / kk);
+    }
     return 0;
 }
 #endif
@@ -86,9 +86,26 @@ struct sbuf2 {
     /* Server always supports SSL. */
     SSL *ssl;
     X509 *cert;
+    int want_ktls;
 #endif
+
+    struct compio *cmp;
+    struct compio_stats cmpstats;
 };
 
+/* read and write through the compressed framing if it is on */
+static inline int sbuf2_fill(SBUF2 *sb, char *cc, int len)
+{
+    return sb->cmp ? compio_read(sb, cc, len) : sb->read(sb, cc, len);
+}
+
+static inline int sbuf2_drain(SBUF2 *sb, const char *cc, int len)
+{
+    return sb->cmp ? compio_write(sb, cc, len) : sb->write(sb, cc, len);
+}
+
+static int compio_pending(SBUF2 *sb);
+
 int SBUF2_FUNC(sbuf2fileno)(SBUF2 *sb)
 {
     if (sb == NULL)
@@ -96,12 +113,28 @@ int SBUF2_FUNC(sbuf2fileno)(SBUF2 *sb)
     return sb->fd;
 }
 
+int SBUF2_FUNC(sbuf2pending)(SBUF2 *sb)
+{
+    int n;
+    if (sb == NULL)
+        return 0;
+    n = sb->rhd - sb->rtl;
+#if WITH_SSL
+    if (sb->ssl)
+        n += SSL_pending(sb->ssl);
+#endif
+    n += compio_pending(sb);
+    return n;
+}
+
 /*just free SBUF2.  don't flush or close fd*/
 int SBUF2_FUNC(sbuf2free)(SBUF2 *sb)
 {
     if (sb == 0)
         return -1;
 
+    /* Likewise for compression, which runs under SSL. */
+    compio_close(sb, 1);
 #if WITH_SSL
     /* Gracefully shutdown SSL to make the
        fd re-usable. */
@@ -145,6 +178,8 @@ int SBUF2_FUNC(sbuf2close)(SBUF2 *sb)
     if (!(sb->flags & SBUF2_NO_FLUSH))
         sbuf2flush(sb);
 
+    compio_close(sb, (sb->flags & SBUF2_NO_CLOSE_FD));
+
 #if WITH_SSL
     /* We need to send "close notify" alert
        before closing the underlying fd. */
@@ -175,14 +210,14 @@ int SBUF2_FUNC(sbuf2flush)(SBUF2 *sb)
         void *ssl;
 ssl_downgrade:
         ssl = sb->ssl;
-        rc = sb->write(sb, (char *)&sb->wbuf[sb->wtl], len);
+        rc = sbuf2_drain(sb, (char *)&sb->wbuf[sb->wtl], len);
         if (rc == 0 && sb->ssl != ssl) {
             /* Fall back to plaintext if client donates
                the socket to sockpool. */
             goto ssl_downgrade;
         }
 #else
-        rc = sb->write(sb, (char *)&sb->wbuf[sb->wtl], len);
+        rc = sbuf2_drain(sb, (char *)&sb->wbuf[sb->wtl], len);
 #endif
         if (rc <= 0)
             return -1 + rc;
@@ -259,6 +294,32 @@ int SBUF2_FUNC(sbuf2write)(char *ptr, int nbytes, SBUF2 *sb)
     }
     off = 0;
     left = nbytes;
+
+    /* more than fills the buffer: flush what's there and write the rest
+       straight from the caller's memory */
+    if (left >= sb->lbuf) {
+        if (sb->whd != sb->wtl && sbuf2flush(sb) < 0)
+            return written;
+        while (left > 0) {
+#if SBUF2_SERVER && WITH_SSL
+            void *ssl;
+ssl_downgrade:
+            ssl = sb->ssl;
+            rc = sbuf2_drain(sb, &ptr[off], left);
+            if (rc == 0 && sb->ssl != ssl)
+                goto ssl_downgrade;
+#else
+            rc = sbuf2_drain(sb, &ptr[off], left);
+#endif
+            if (rc <= 0)
+                return written;
+            off += rc;
+            left -= rc;
+            written += rc;
+        }
+        return nbytes;
+    }
+
     while (left > 0) {
         int towrite = 0;
 
@@ -344,11 +405,11 @@ int SBUF2_FUNC(sbuf2getc)(SBUF2 *sb)
         void *ssl;
 ssl_downgrade:
         ssl = sb->ssl;
-        rc = sb->read(sb, (char *)sb->rbuf, sb->lbuf - 1);
+        rc = sbuf2_fill(sb, (char *)sb->rbuf, sb->lbuf - 1);
         if (rc == 0 && sb->ssl != ssl)
             goto ssl_downgrade;
 #else
-        rc = sb->read(sb, (char *)sb->rbuf, sb->lbuf - 1);
+        rc = sbuf2_fill(sb, (char *)sb->rbuf, sb->lbuf - 1);
 #endif
         if (rc <= 0)
             return -1 + rc;
@@ -449,17 +510,22 @@ static int sbuf2fread_int(char *ptr, int size, int nitems,
         /* if still need more data */
         if (need > 0) {
             int rc;
+            /* the buffer is empty: read what wouldn't fit in it straight
+               into the caller's memory instead of copying it through */
+            int direct = need >= sb->lbuf - 1;
+            char *to = direct ? ptr + done : (char *)sb->rbuf;
+            int len = direct ? need : sb->lbuf - 1;
             sb->rtl = 0;
             sb->rhd = 0;
 #if SBUF2_SERVER && WITH_SSL
             void *ssl;
 ssl_downgrade:
             ssl = sb->ssl;
-            rc = sb->read(sb, (char *)sb->rbuf, sb->lbuf - 1);
+            rc = sbuf2_fill(sb, to, len);
             if (rc == 0 && sb->ssl != ssl)
                 goto ssl_downgrade;
 #else
-            rc = sb->read(sb, (char *)sb->rbuf, sb->lbuf - 1);
+            rc = sbuf2_fill(sb, to, len);
 #endif
             if (rc <= 0) {
                 if (rc == 0) { /* this is a timeout */
@@ -468,7 +534,12 @@ ssl_downgrade:
                 }
                 return (done / size);
             }
-            sb->rhd = rc;
+            if (direct) {
+                need -= rc;
+                done += rc;
+            } else {
+                sb->rhd = rc;
+            }
             continue;
         }
         break;
@@ -1051,3 +1122,5 @@ void SBUF2_FUNC(cleanup_peer_hash)()
       ssl_eprintln("SBUF2", "%s: " fmt, __func__, ##__VA_ARGS__)
 #  include "ssl_io.c"
 #endif
+
+#include "compress_io.c"
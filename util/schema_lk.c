@@ -15,15 +15,101 @@
  */
 
 #include <pthread.h>
+#include <errno.h>
+#include <time.h>
 #include <logmsg.h>
 #include <locks_wrap.h>
 #include <schema_lk.h>
+#include <epochlib.h>
+
+/* Set at startup, before the schema lock is first taken */
+int gbl_schema_lk_sharded = 0;
 
 static pthread_rwlock_t schema_lk = PTHREAD_RWLOCK_INITIALIZER;
 
+/*
+ * With schema_lk_sharded on, the schema lock is no rwlock: it is read on
+ * every prepare and table lookup and written by schema changes, so readers
+ * must not share a cache line.  Each reader counts itself in one of
+ * SCHEMA_LK_SLOTS padded counters picked per thread, and only looks at
+ * writer_active.  A writer sets writer_active and then sums the counters;
+ * seq_cst ordering on both sides means either the writer sees the reader
+ * or the reader sees the writer.  A reader that sees the writer backs out
+ * and waits; a writer that sees readers backs out and waits for a reader
+ * to let go.
+ *
+ * Like the default pthread rwlock, waiting writers do not stop new
+ * readers, so a thread may take the read lock again while holding it.  A
+ * read lock may be released by a thread other than the one that took it:
+ * only the sum of the counters matters, not what any one of them holds.
+ * As with the rwlock, unlock tells the two kinds of lock apart by the
+ * state of the lock: while a writer holds it, no reader can.
+ */
+#define SCHEMA_LK_SLOTS 64
+#define SCHEMA_LK_WAIT_MS 10
+
+static struct {
+    long count;
+    char pad[64 - sizeof(long)];
+} __attribute__((aligned(64))) readers[SCHEMA_LK_SLOTS];
+
+static int writer_active;  /* readers back out; set while draining too */
+static int writer_held;    /* the writer has drained the readers */
+static int writer_owned;   /* one writer at a time, under lk */
+static int writer_waiting; /* readers tell the writer as they let go */
+static pthread_mutex_t lk = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t wcond = PTHREAD_COND_INITIALIZER;
+
+void (*gbl_schema_lk_wait_fn)(const char *name, uint64_t wait_us);
+
+static int next_slot;
+static __thread int my_slot = -1;
+
+static inline long *reader_count(void)
+{
+    if (my_slot < 0)
+        my_slot = __atomic_fetch_add(&next_slot, 1, __ATOMIC_RELAXED) %
+                  SCHEMA_LK_SLOTS;
+    return &readers[my_slot].count;
+}
+
+/* returns 0 with the read lock held, or EBUSY if a writer is about */
+static inline int rdlock_try(long *cnt)
+{
+    __atomic_add_fetch(cnt, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&writer_active, __ATOMIC_SEQ_CST) == 0)
+        return 0;
+    __atomic_sub_fetch(cnt, 1, __ATOMIC_SEQ_CST);
+    return EBUSY;
+}
+
+static long readers_total(void)
+{
+    long total = 0;
+    for (int i = 0; i < SCHEMA_LK_SLOTS; i++)
+        total += __atomic_load_n(&readers[i].count, __ATOMIC_SEQ_CST);
+    return total;
+}
+
 inline void rdlock_schema_int(const char *file, const char *func, int line)
 {
-    Pthread_rwlock_rdlock(&schema_lk);
+    if (!gbl_schema_lk_sharded) {
+        Pthread_rwlock_rdlock(&schema_lk);
+    } else {
+        long *cnt = reader_count();
+        int64_t start = 0;
+        while (rdlock_try(cnt) != 0) {
+            if (start == 0)
+                start = comdb2_time_epochus();
+            Pthread_mutex_lock(&lk);
+            while (__atomic_load_n(&writer_active, __ATOMIC_SEQ_CST))
+                Pthread_cond_wait(&cond, &lk);
+            Pthread_mutex_unlock(&lk);
+        }
+        if (start && gbl_schema_lk_wait_fn)
+            gbl_schema_lk_wait_fn("schema_lk", comdb2_time_epochus() - start);
+    }
 #ifdef VERBOSE_SCHEMA_LK
     logmsg(LOGMSG_USER, "%p:RDLOCK %s:%d\n", (void *)pthread_self(), func,
            line);
@@ -32,7 +118,20 @@ inline void rdlock_schema_int(const char *file, const char *func, int line)
 
 inline int tryrdlock_schema_int(const char *file, const char *func, int line)
 {
-    int rc = pthread_rwlock_tryrdlock(&schema_lk);
+    int rc;
+
+    if (!gbl_schema_lk_sharded) {
+        rc = pthread_rwlock_tryrdlock(&schema_lk);
+    } else {
+        long *cnt = reader_count();
+        /* a writer draining the readers only has writer_active set while it
+         * holds lk, so past lk it is either held or backed out */
+        while ((rc = rdlock_try(cnt)) != 0 &&
+               !__atomic_load_n(&writer_held, __ATOMIC_SEQ_CST)) {
+            Pthread_mutex_lock(&lk);
+            Pthread_mutex_unlock(&lk);
+        }
+    }
 #ifdef VERBOSE_SCHEMA_LK
     logmsg(LOGMSG_USER, "%p:TRYRDLOCK RC:%d %s:%d\n", (void *)pthread_self(),
            rc, func, line);
@@ -46,12 +145,78 @@ inline void unlock_schema_int(const char *file, const char *func, int line)
     logmsg(LOGMSG_USER, "%p:UNLOCK %s:%d\n", (void *)pthread_self(), func,
            line);
 #endif
-    Pthread_rwlock_unlock(&schema_lk);
+    if (!gbl_schema_lk_sharded) {
+        Pthread_rwlock_unlock(&schema_lk);
+        return;
+    }
+    if (__atomic_load_n(&writer_held, __ATOMIC_SEQ_CST)) {
+        /* no reader holds the lock while the writer does */
+        Pthread_mutex_lock(&lk);
+        __atomic_store_n(&writer_held, 0, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&writer_active, 0, __ATOMIC_SEQ_CST);
+        writer_owned = 0;
+        Pthread_cond_broadcast(&cond);
+        Pthread_mutex_unlock(&lk);
+        return;
+    }
+    __atomic_sub_fetch(reader_count(), 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&writer_waiting, __ATOMIC_SEQ_CST)) {
+        Pthread_mutex_lock(&lk);
+        Pthread_cond_broadcast(&wcond);
+        Pthread_mutex_unlock(&lk);
+    }
+}
+
+static void wrlock_sharded(void)
+{
+    int64_t start = comdb2_time_epochus();
+    int waited = 0;
+
+    Pthread_mutex_lock(&lk);
+    while (writer_owned) {
+        waited = 1;
+        Pthread_cond_wait(&cond, &lk);
+    }
+    writer_owned = 1;
+
+    /* a reader letting go after writer_waiting is set takes lk to wake us,
+     * which it can only do once we wait, so no wakeup is lost; the timeout
+     * is only for readers that went by before it was set */
+    __atomic_store_n(&writer_waiting, 1, __ATOMIC_SEQ_CST);
+    while (1) {
+        struct timespec ts;
+
+        __atomic_store_n(&writer_active, 1, __ATOMIC_SEQ_CST);
+        if (readers_total() == 0) {
+            __atomic_store_n(&writer_held, 1, __ATOMIC_SEQ_CST);
+            break;
+        }
+        waited = 1;
+        /* let the readers in again, as one may be taking the lock again
+         * while it holds it, and wait for them to drain */
+        __atomic_store_n(&writer_active, 0, __ATOMIC_SEQ_CST);
+        Pthread_cond_broadcast(&cond);
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += SCHEMA_LK_WAIT_MS * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&wcond, &lk, &ts);
+    }
+    __atomic_store_n(&writer_waiting, 0, __ATOMIC_SEQ_CST);
+    Pthread_mutex_unlock(&lk);
+
+    if (waited && gbl_schema_lk_wait_fn)
+        gbl_schema_lk_wait_fn("schema_lk", comdb2_time_epochus() - start);
 }
 
 inline void wrlock_schema_int(const char *file, const char *func, int line)
 {
-    Pthread_rwlock_wrlock(&schema_lk);
+    if (!gbl_schema_lk_sharded)
+        Pthread_rwlock_wrlock(&schema_lk);
+    else
+        wrlock_sharded();
 #ifdef VERBOSE_SCHEMA_LK
     logmsg(LOGMSG_USER, "%p:WRLOCK %s:%d\n", (void *)pthread_self(), func,
            line);
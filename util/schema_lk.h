@@ -17,6 +17,7 @@
 #ifndef INCLUDED_SCHEMA_LK_H
 #define INCLUDED_SCHEMA_LK_H
 
+#include <stdint.h>
 #include <locks_wrap.h>
 
 #define rdlock_schema_lk() rdlock_schema_int(__FILE__, __func__, __LINE__)
@@ -31,4 +32,10 @@ void unlock_schema_int(const char *file, const char *func, int line);
 #define wrlock_schema_lk() wrlock_schema_int(__FILE__, __func__, __LINE__)
 void wrlock_schema_int(const char *file, const char *func, int line);
 
+/* schema lock that keeps readers off a shared cache line; see schema_lk.c */
+extern int gbl_schema_lk_sharded;
+
+/* if set, told of each wait for the schema lock and how long it was */
+extern void (*gbl_schema_lk_wait_fn)(const char *name, uint64_t wait_us);
+
 #endif
@@ -42,6 +42,22 @@ int SBUF2_FUNC(sslio_has_x509)(SBUF2 *sb)
     return (sb != NULL && sb->cert != NULL);
 }
 
+void SBUF2_FUNC(sslio_set_ktls)(SBUF2 *sb, int on)
+{
+    sb->want_ktls = on;
+}
+
+int SBUF2_FUNC(sslio_has_ktls)(SBUF2 *sb)
+{
+#if HAVE_KTLS
+    return (sb != NULL && sb->ssl != NULL &&
+            (BIO_get_ktls_send(SSL_get_wbio(sb->ssl)) ||
+             BIO_get_ktls_recv(SSL_get_rbio(sb->ssl))));
+#else
+    return 0;
+#endif
+}
+
 static int sslio_pollin(SBUF2 *sb)
 {
     int rc;
@@ -461,6 +477,11 @@ static int sslio_accept_or_connect(SBUF2 *sb, SSL_CTX *ctx,
     SSL_set_info_callback(sb->ssl, my_apps_ssl_info_callback);
 #endif
 
+#if HAVE_KTLS
+    if (sb->want_ktls)
+        SSL_set_options(sb->ssl, SSL_OP_ENABLE_KTLS);
+#endif
+
     if (sess != NULL)
         SSL_set_session(sb->ssl, sess);
 
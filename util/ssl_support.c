@@ -529,3 +529,62 @@ error:  if (myctx != NULL) {
 
     return rc;
 }
+
+#if SBUF2_SERVER
+int ssl_set_ticket_keys(SSL_CTX *ctx, const char *file, char *err, size_t n)
+{
+    unsigned char keys[80];
+    struct stat buf;
+    long need;
+    size_t got;
+    FILE *fp;
+    int rc;
+
+    need = SSL_CTX_get_tlsext_ticket_keys(ctx, NULL, 0);
+    if (need <= 0 || need > sizeof(keys)) {
+        ssl_sfeprint(err, n, my_ssl_eprintln,
+                     "Session ticket keys of %ld bytes are not supported.",
+                     need);
+        return EINVAL;
+    }
+
+    if (stat(file, &buf) != 0) {
+        rc = errno;
+        ssl_sfeprint(err, n, my_ssl_eprintln,
+                     "Failed to access ticket key file %s: %s.", file,
+                     strerror(rc));
+        return rc;
+    }
+
+    /* Anyone who can read the keys can read every resumed session. */
+    if (buf.st_mode & (S_IRWXG | S_IRWXO)) {
+        ssl_sfeprint(err, n, my_ssl_eprintln,
+                     "Permissions for ticket key file %s are too open.", file);
+        return EACCES;
+    }
+
+    if ((fp = fopen(file, "r")) == NULL) {
+        rc = errno;
+        ssl_sfeprint(err, n, my_ssl_eprintln,
+                     "Failed to open ticket key file %s: %s.", file,
+                     strerror(rc));
+        return rc;
+    }
+    got = fread(keys, 1, need, fp);
+    fclose(fp);
+
+    rc = 0;
+    if (got != need) {
+        ssl_sfeprint(err, n, my_ssl_eprintln,
+                     "Ticket key file %s has fewer than %ld bytes.", file,
+                     need);
+        rc = EINVAL;
+    } else if (SSL_CTX_set_tlsext_ticket_keys(ctx, keys, need) != 1) {
+        ssl_sfliberrprint(err, n, my_ssl_eprintln,
+                          "Failed to set session ticket keys");
+        rc = EINVAL;
+    }
+    OPENSSL_cleanse(keys, sizeof(keys));
+    return rc;
+}
+#endif
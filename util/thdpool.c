@@ -44,10 +44,9 @@
 #include "debug_switches.h"
 #include "logmsg.h"
 #include "comdb2_atomic.h"
-
-#ifdef MONITOR_STACK
+#include "plhash.h"
 #include "comdb2_pthread_create.h"
-#endif
+#include "wait_event.h"
 
 int gbl_random_thdpool_work_timeout = 0;
 
@@ -74,10 +73,44 @@ struct thd {
 
     int on_freelist;
 
+    /* index of this thread's own deque in work stealing mode */
+    unsigned home;
+
     LINKC_T(struct thd) thdlist_linkv;
     LINKC_T(struct thd) freelist_linkv;
 };
 
+/* Work stealing mode.  Each worker has a deque with its own lock; workers
+ * take their newest item first and steal the oldest item of another deque
+ * when theirs is empty.  Items are allocated from the deque's own pool so a
+ * push or pop never touches pool->mutex. */
+struct thdpool_deque {
+    pthread_mutex_t lk;
+    pool_t *pool;
+    LISTC_T(struct workitem) q;
+};
+
+/* A fair queueing class: queued work from one client, user or query shape.
+ * Classes live until the pool is destroyed so their counters accumulate. */
+#define THDPOOL_CLASS_KEYLEN 64
+struct thdpool_class {
+    char key[THDPOOL_CLASS_KEYLEN];
+    unsigned weight;  /* items served per round robin turn */
+    int deficit;      /* items left in the current turn */
+    int active;       /* on the pool's active list */
+    LISTC_T(struct workitem) queue;
+
+    unsigned num_enqueued;
+    unsigned num_dequeued;
+    unsigned num_timeout;
+    unsigned num_rejected;
+    unsigned max_wait_ms;
+    unsigned long long total_wait_ms;
+
+    LINKC_T(struct thdpool_class) lnk;
+    LINKC_T(struct thdpool_class) active_lnk;
+};
+
 struct thdpool {
     char *name;
 
@@ -152,8 +185,41 @@ struct thdpool {
     comdb2ma stack_alloc;
 #endif
     void (*queued_callback)(void*);
+
+    /* Fair queueing.  Queued items are on both the pool queue (arrival
+     * order) and their class queue; classes with work take turns. */
+    int fairq;
+    unsigned maxclasses;
+    unsigned num_rejected;
+    hash_t *classh;
+    LISTC_T(struct thdpool_class) classes;
+    LISTC_T(struct thdpool_class) active;
+
+    /* Work stealing.  The deques are allocated the first time work
+     * stealing is used and kept until the pool is destroyed, so the mode
+     * can be turned on and off at runtime.  Counters are atomic. */
+    int steal;
+    struct thdpool_deque *deques;
+    unsigned ndeques;
+    int nidle;   /* size of freelist, readable without the pool lock */
+    int nstealq; /* items on all deques */
+    unsigned stealrr;
+    unsigned num_steal_enqueued;
+    unsigned num_steal_dequeued;
+    unsigned num_steal_timeout;
+    unsigned num_stolen;
+
+    /* CPU affinity, taken by each thread as it starts: the pool's own cpu
+     * list if it has one, otherwise its class's.  cpus is protected by
+     * mutex. */
+    int affinity_class;
+    char *cpus;
 };
 
+static __thread struct thd *thd_self = NULL;
+
+static void deques_drain(struct thdpool *pool);
+
 pthread_mutex_t pool_list_lk = PTHREAD_MUTEX_INITIALIZER;
 LISTC_T(struct thdpool) threadpools;
 pthread_once_t init_pool_list_once = PTHREAD_ONCE_INIT;
@@ -171,6 +237,19 @@ static void init_pool_list(void)
     REGISTER_TUNABLE(buf, DESCR, TYPE, VAR_PTR, FLAGS, VALUE_FN, VERIFY_FN,    \
                      UPDATE_FN, DESTROY_FN)
 
+static int thdpool_cpus_verify(void *context, void *value)
+{
+    return comdb2_cpus_verify(value);
+}
+
+static int thdpool_cpus_update(void *context, void *value)
+{
+    comdb2_tunable *tunable = context;
+    struct thdpool *pool = (struct thdpool *)((char *)tunable->var -
+                                              offsetof(struct thdpool, cpus));
+    return thdpool_set_cpus(pool, value);
+}
+
 static void register_thdpool_tunables(char *name, struct thdpool *pool)
 {
     char buf[100];
@@ -208,6 +287,22 @@ static void register_thdpool_tunables(char *name, struct thdpool *pool)
     REGISTER_THDPOOL_TUNABLE(name, dump_on_full, "Dump status on full queue.",
                              TUNABLE_BOOLEAN, &pool->dump_on_full, NOARG, NULL,
                              NULL, NULL, NULL);
+    REGISTER_THDPOOL_TUNABLE(name, fairq,
+                             "Serve queued work round robin across classes.",
+                             TUNABLE_BOOLEAN, &pool->fairq, NOARG, NULL, NULL,
+                             NULL, NULL);
+    REGISTER_THDPOOL_TUNABLE(name, workstealing,
+                             "Queue work on per thread deques.",
+                             TUNABLE_BOOLEAN, &pool->steal, NOARG, NULL, NULL,
+                             NULL, NULL);
+    REGISTER_THDPOOL_TUNABLE(name, maxclasses,
+                             "Maximum number of fair queueing classes.",
+                             TUNABLE_INTEGER, &pool->maxclasses, 0, NULL,
+                             NULL, NULL, NULL);
+    REGISTER_THDPOOL_TUNABLE(name, cpus,
+                             "CPUs new threads of the pool are bound to.",
+                             TUNABLE_STRING, &pool->cpus, 0, NULL,
+                             thdpool_cpus_verify, thdpool_cpus_update, NULL);
     return;
 }
 
@@ -246,6 +341,10 @@ struct thdpool *thdpool_create(const char *name, size_t per_thread_data_sz)
     listc_init(&pool->thdlist, offsetof(struct thd, thdlist_linkv));
     listc_init(&pool->freelist, offsetof(struct thd, freelist_linkv));
     listc_init(&pool->queue, offsetof(struct workitem, linkv));
+    listc_init(&pool->classes, offsetof(struct thdpool_class, lnk));
+    listc_init(&pool->active, offsetof(struct thdpool_class, active_lnk));
+    pool->classh = hash_init_str(offsetof(struct thdpool_class, key));
+    pool->maxclasses = 256;
 
     Pthread_mutex_init(&pool->mutex, NULL);
     Pthread_attr_init(&pool->attrs);
@@ -290,8 +389,23 @@ void thdpool_destroy(struct thdpool **pool_p)
     Pthread_mutex_destroy(&pool->mutex);
     Pthread_attr_destroy(&pool->attrs);
 
+    struct thdpool_class *cls;
+    while ((cls = listc_rtl(&pool->classes)) != NULL)
+        free(cls);
+    hash_free(pool->classh);
+
+    if (pool->deques) {
+        deques_drain(pool);
+        for (unsigned i = 0; i < pool->ndeques; ++i) {
+            Pthread_mutex_destroy(&pool->deques[i].lk);
+            pool_free(pool->deques[i].pool);
+        }
+        free(pool->deques);
+    }
+
     free(pool->busy_hist);
     pool_free(pool->pool);
+    free(pool->cpus);
     free(pool->name);
     free(pool);
 }
@@ -306,6 +420,15 @@ void thdpool_foreach(struct thdpool *pool, thdpool_foreach_fn foreach_fn,
         {
             (foreach_fn)(pool, item, user);
         }
+        for (unsigned i = 0; pool->deques && i < pool->ndeques; ++i) {
+            struct thdpool_deque *dq = &pool->deques[i];
+            Pthread_mutex_lock(&dq->lk);
+            LISTC_FOR_EACH(&dq->q, item, linkv)
+            {
+                (foreach_fn)(pool, item, user);
+            }
+            Pthread_mutex_unlock(&dq->lk);
+        }
     }
     UNLOCK(&pool->mutex);
 }
@@ -385,6 +508,176 @@ void thdpool_set_dump_on_full(struct thdpool *pool, int onoff)
     pool->dump_on_full = onoff;
 }
 
+void thdpool_set_work_stealing(struct thdpool *pool, int onoff)
+{
+    pool->steal = onoff;
+}
+
+int thdpool_get_work_stealing(struct thdpool *pool)
+{
+    return pool->steal;
+}
+
+void thdpool_set_affinity_class(struct thdpool *pool, int cls)
+{
+    pool->affinity_class = cls;
+}
+
+int thdpool_set_cpus(struct thdpool *pool, const char *cpus)
+{
+    char *dup = NULL;
+
+    if (cpus && *cpus) {
+        if (comdb2_cpus_verify(cpus) != 0)
+            return EINVAL;
+        if ((dup = strdup(cpus)) == NULL)
+            return ENOMEM;
+    }
+    LOCK(&pool->mutex)
+    {
+        free(pool->cpus);
+        pool->cpus = dup;
+    }
+    UNLOCK(&pool->mutex);
+    return 0;
+}
+
+void thdpool_set_fairq(struct thdpool *pool, int onoff)
+{
+    pool->fairq = onoff;
+}
+
+int thdpool_get_fairq(struct thdpool *pool)
+{
+    return pool->fairq;
+}
+
+/* Find or create the class for key.  Once maxclasses is reached new keys
+ * share the default class.  Pool lock must be held. */
+static struct thdpool_class *get_class_ll(struct thdpool *pool, const char *key)
+{
+    struct thdpool_class *cls;
+    char k[THDPOOL_CLASS_KEYLEN] = {0};
+
+    if (key)
+        strncpy(k, key, sizeof(k) - 1);
+    if ((cls = hash_find_readonly(pool->classh, k)) != NULL)
+        return cls;
+    if (k[0] && listc_size(&pool->classes) >= pool->maxclasses)
+        return get_class_ll(pool, NULL);
+    if ((cls = calloc(1, sizeof(struct thdpool_class))) == NULL)
+        return NULL;
+    strcpy(cls->key, k);
+    cls->weight = 1;
+    listc_init(&cls->queue, offsetof(struct workitem, clslinkv));
+    hash_add(pool->classh, cls);
+    listc_abl(&pool->classes, cls);
+    return cls;
+}
+
+int thdpool_set_class_weight(struct thdpool *pool, const char *classkey,
+                             unsigned weight)
+{
+    struct thdpool_class *cls;
+
+    LOCK(&pool->mutex)
+    {
+        cls = get_class_ll(pool, classkey);
+        if (cls)
+            cls->weight = weight > 0 ? weight : 1;
+    }
+    UNLOCK(&pool->mutex);
+    return cls ? 0 : -1;
+}
+
+void thdpool_get_class_stats(struct thdpool *pool, int *nclasses,
+                             int *nrejected, int *maxwaitms)
+{
+    int now = comdb2_time_epochms();
+    *maxwaitms = 0;
+    LOCK(&pool->mutex)
+    {
+        struct thdpool_class *cls;
+        *nclasses = listc_size(&pool->classes);
+        *nrejected = pool->num_rejected;
+        LISTC_FOR_EACH(&pool->active, cls, active_lnk)
+        {
+            int waited = now - cls->queue.top->queue_time_ms;
+            if (waited > *maxwaitms)
+                *maxwaitms = waited;
+        }
+    }
+    UNLOCK(&pool->mutex);
+}
+
+/* Queue an item on its class.  Items go behind everything of equal or higher
+ * priority, so equal priority work stays in arrival order. */
+static void class_add_ll(struct thdpool *pool, struct thdpool_class *cls,
+                         struct workitem *item, int enqueue_front)
+{
+    struct workitem *prev;
+
+    if (enqueue_front) {
+        listc_atl(&cls->queue, item);
+    } else {
+        for (prev = cls->queue.bot;
+             prev && prev->priority < item->priority;
+             prev = prev->clslinkv.prev)
+            ;
+        if (prev)
+            listc_add_after(&cls->queue, item, prev);
+        else
+            listc_atl(&cls->queue, item);
+    }
+    item->cls = cls;
+    cls->num_enqueued++;
+    if (!cls->active) {
+        cls->active = 1;
+        cls->deficit = 0;
+        listc_abl(&pool->active, cls);
+    }
+}
+
+static void class_deactivate_ll(struct thdpool *pool, struct thdpool_class *cls)
+{
+    if (listc_size(&cls->queue) == 0 && cls->active) {
+        listc_rfl(&pool->active, cls);
+        cls->active = 0;
+        cls->deficit = 0;
+    }
+}
+
+/* Next queued item.  With fair queueing the class at the head of the active
+ * list runs up to weight items, then goes to the back (weighted round
+ * robin).  Otherwise, or for items queued before fairq was turned on, take
+ * the oldest item.  Pool lock must be held. */
+static struct workitem *queue_next_ll(struct thdpool *pool)
+{
+    struct thdpool_class *cls;
+    struct workitem *item;
+
+    if (pool->fairq && (cls = pool->active.top) != NULL) {
+        if (cls->deficit <= 0)
+            cls->deficit = cls->weight;
+        item = listc_rtl(&cls->queue);
+        listc_rfl(&pool->queue, item);
+        if (listc_size(&cls->queue) == 0) {
+            class_deactivate_ll(pool, cls);
+        } else if (--cls->deficit <= 0) {
+            listc_rfl(&pool->active, cls);
+            listc_abl(&pool->active, cls);
+        }
+        return item;
+    }
+
+    item = listc_rtl(&pool->queue);
+    if (item && item->cls) {
+        listc_rfl(&item->cls->queue, item);
+        class_deactivate_ll(pool, item->cls);
+    }
+    return item;
+}
+
 void thdpool_print_stats(FILE *fh, struct thdpool *pool)
 {
     LOCK(&pool->mutex)
@@ -401,9 +694,12 @@ void thdpool_print_stats(FILE *fh, struct thdpool *pool)
         logmsgf(LOGMSG_USER, fh, "  Num thread creates        : %u\n", pool->num_creates);
         logmsgf(LOGMSG_USER, fh, "  Num thread exits          : %u\n", pool->num_exits);
         logmsgf(LOGMSG_USER, fh, "  Work items done immediate : %u\n", pool->num_passed);
-        logmsgf(LOGMSG_USER, fh, "  Num work items enqueued   : %u\n", pool->num_enqueued);
-        logmsgf(LOGMSG_USER, fh, "  Num work items dequeued   : %u\n", pool->num_dequeued);
-        logmsgf(LOGMSG_USER, fh, "  Num work items timeout    : %u\n", pool->num_timeout);
+        logmsgf(LOGMSG_USER, fh, "  Num work items enqueued   : %u\n",
+                thdpool_get_enqueued(pool));
+        logmsgf(LOGMSG_USER, fh, "  Num work items dequeued   : %u\n",
+                thdpool_get_dequeued(pool));
+        logmsgf(LOGMSG_USER, fh, "  Num work items timeout    : %u\n",
+                thdpool_get_timeouts(pool));
         logmsgf(LOGMSG_USER, fh, "  Num work items completed  : %u\n", pool->num_completed);
         logmsgf(LOGMSG_USER, fh, "  Num failed dispatches     : %u\n",
                 pool->num_failed_dispatches);
@@ -414,7 +710,7 @@ void thdpool_print_stats(FILE *fh, struct thdpool *pool)
         logmsgf(LOGMSG_USER, fh, "  Work queue peak size      : %u\n", pool->peakqueue);
         logmsgf(LOGMSG_USER, fh, "  Work queue maximum size   : %u\n", pool->maxqueue);
         logmsgf(LOGMSG_USER, fh, "  Work queue current size   : %u\n",
-                listc_size(&pool->queue));
+                thdpool_get_nqueuedworks(pool));
         logmsgf(LOGMSG_USER, fh, "  Long wait alarm threshold : %u ms\n", pool->longwaitms);
         logmsgf(LOGMSG_USER, fh, "  Thread linger time        : %u seconds\n",
                 pool->lingersecs);
@@ -428,6 +724,42 @@ void thdpool_print_stats(FILE *fh, struct thdpool *pool)
                 pool->exit_on_create_fail ? "yes" : "no");
         logmsgf(LOGMSG_USER, fh, "  Dump on queue full        : %s\n",
                 pool->dump_on_full ? "yes" : "no");
+        logmsgf(LOGMSG_USER, fh, "  Fair queueing             : %s\n",
+                pool->fairq ? "yes" : "no");
+        logmsgf(LOGMSG_USER, fh, "  Work stealing             : %s\n",
+                pool->steal ? "yes" : "no");
+        logmsgf(LOGMSG_USER, fh, "  CPU affinity              : %s (%s)\n",
+                pool->cpus ? pool->cpus : "none",
+                comdb2_thread_class_name(pool->affinity_class));
+        if (pool->deques) {
+            logmsgf(LOGMSG_USER, fh, "  Work stealing deques      : %u\n",
+                    pool->ndeques);
+            logmsgf(LOGMSG_USER, fh, "  Num work items on deques  : %d\n",
+                    ATOMIC_LOAD32(pool->nstealq));
+            logmsgf(LOGMSG_USER, fh, "  Num work items stolen     : %u\n",
+                    ATOMIC_LOAD32(pool->num_stolen));
+        }
+        if (listc_size(&pool->classes) > 0) {
+            struct thdpool_class *cls;
+            logmsgf(LOGMSG_USER, fh, "  Num admission rejects     : %u\n",
+                    pool->num_rejected);
+            logmsgf(LOGMSG_USER, fh,
+                    "  %-20s %6s %6s %10s %10s %8s %8s %10s %8s\n", "Class",
+                    "weight", "queued", "enqueued", "dequeued", "timeout",
+                    "rejected", "avgwaitms", "maxwait");
+            LISTC_FOR_EACH(&pool->classes, cls, lnk)
+            {
+                logmsgf(LOGMSG_USER, fh,
+                        "  %-20.20s %6u %6d %10u %10u %8u %8u %10llu %8u\n",
+                        cls->key[0] ? cls->key : "(default)", cls->weight,
+                        listc_size(&cls->queue), cls->num_enqueued,
+                        cls->num_dequeued, cls->num_timeout, cls->num_rejected,
+                        cls->num_dequeued
+                            ? cls->total_wait_ms / cls->num_dequeued
+                            : 0ULL,
+                        cls->max_wait_ms);
+            }
+        }
         for (ii = 0; ii < pool->busy_hist_len; ii++) {
             if ((ii & 3) == 0) {
                 logmsgf(LOGMSG_USER, fh, "  Busy threads histogram    : ");
@@ -556,6 +888,44 @@ void thdpool_process_message(struct thdpool *pool, char *line, int lline,
             logmsg(LOGMSG_USER, "%s won't dump status on full queue\n", pool->name);
         }
 
+    } else if (tokcmp(tok, ltok, "fairq") == 0) {
+        tok = segtok(line, lline, &st, &ltok);
+        if (ltok == 0)
+            return;
+        if (tokcmp(tok, ltok, "on") == 0) {
+            thdpool_set_fairq(pool, 1);
+            logmsg(LOGMSG_USER, "%s will queue work by class\n", pool->name);
+        } else if (tokcmp(tok, ltok, "off") == 0) {
+            thdpool_set_fairq(pool, 0);
+            logmsg(LOGMSG_USER, "%s will queue work in arrival order\n",
+                   pool->name);
+        }
+    } else if (tokcmp(tok, ltok, "classweight") == 0) {
+        char key[THDPOOL_CLASS_KEYLEN];
+        tok = segtok(line, lline, &st, &ltok);
+        if (ltok == 0 || ltok >= sizeof(key))
+            return;
+        tokcpy(tok, ltok, key);
+        tok = segtok(line, lline, &st, &ltok);
+        if (ltok == 0)
+            return;
+        if (thdpool_set_class_weight(pool, key, toknum(tok, ltok)) == 0)
+            logmsg(LOGMSG_USER, "Pool [%s] class %s weight set to %d\n",
+                   pool->name, key, toknum(tok, ltok));
+        else
+            logmsg(LOGMSG_USER, "Pool [%s] can't add class %s\n", pool->name,
+                   key);
+    } else if (tokcmp(tok, ltok, "cpus") == 0) {
+        char cpus[256];
+        tok = segtok(line, lline, &st, &ltok);
+        if (ltok == 0 || ltok >= sizeof(cpus))
+            return;
+        tokcpy(tok, ltok, cpus);
+        if (tokcmp(tok, ltok, "none") == 0)
+            cpus[0] = '\0';
+        if (thdpool_set_cpus(pool, cpus) == 0)
+            logmsg(LOGMSG_USER, "Pool [%s] new threads bound to cpus %s\n",
+                   pool->name, cpus[0] ? cpus : "of its class");
     } else if (tokcmp(tok, ltok, "help") == 0) {
         logmsg(LOGMSG_USER, "Pool [%s] commands:-\n", pool->name);
         logmsg(LOGMSG_USER, "  stop      -            stop all threads\n");
@@ -570,6 +940,9 @@ void thdpool_process_message(struct thdpool *pool, char *line, int lline,
         logmsg(LOGMSG_USER, "  maxagems #-            set maximum age in ms for in-queue time\n");
         logmsg(LOGMSG_USER, "  exit_on_error on/off - enable/disable exit on thread errors \n");
         logmsg(LOGMSG_USER, "  dump_on_full on/off -  enable/disable dumping status on full queue\n");
+        logmsg(LOGMSG_USER, "  fairq on/off -         enable/disable round robin queueing by class\n");
+        logmsg(LOGMSG_USER, "  classweight key # -    set the round robin weight of a class\n");
+        logmsg(LOGMSG_USER, "  cpus list/none -       bind new threads to a cpu list\n");
     }
 }
 
@@ -593,6 +966,170 @@ void thdpool_resume(struct thdpool *pool)
     UNLOCK(&pool->mutex);
 }
 
+static void steal_kick_fn(struct thdpool *pool, void *work, void *thddata,
+                          int op)
+{
+}
+
+/* Allocate the deques, one per thread up to maxt.  Pool lock must be held. */
+static int deques_init_ll(struct thdpool *pool)
+{
+    struct thdpool_deque *dqs;
+    unsigned n = pool->maxnthd > 0 ? pool->maxnthd : 16;
+
+    if (n > 64)
+        n = 64;
+    if ((dqs = calloc(n, sizeof(struct thdpool_deque))) == NULL)
+        return -1;
+    for (unsigned i = 0; i < n; ++i) {
+        Pthread_mutex_init(&dqs[i].lk, NULL);
+        dqs[i].pool = pool_init(sizeof(struct workitem), 0);
+        listc_init(&dqs[i].q, offsetof(struct workitem, linkv));
+    }
+    pool->ndeques = n;
+    (void)XCHANGEPTR(pool->deques, dqs);
+    return 0;
+}
+
+/* Free the items left on the deques without running them, as timed out
+ * items are.  Only a push that raced with the last worker exiting of a
+ * stopped pool leaves one behind; that worker runs everything else. */
+static void deques_drain(struct thdpool *pool)
+{
+    for (unsigned i = 0; i < pool->ndeques; ++i) {
+        struct thdpool_deque *dq = &pool->deques[i];
+        struct workitem *item, work;
+
+        Pthread_mutex_lock(&dq->lk);
+        while ((item = listc_rtl(&dq->q)) != NULL) {
+            memcpy(&work, item, sizeof(work));
+            pool_relablk(dq->pool, item);
+            Pthread_mutex_unlock(&dq->lk);
+
+            ATOMIC_ADD32(pool->nstealq, -1);
+            if (pool->dque_fn)
+                pool->dque_fn(pool, &work, 1);
+            free(work.persistent_info);
+            work.work_fn(pool, work.work, NULL, THD_FREE);
+
+            Pthread_mutex_lock(&dq->lk);
+        }
+        Pthread_mutex_unlock(&dq->lk);
+    }
+}
+
+/* Push work on a deque without taking the pool lock: the caller's own deque
+ * if it is one of our workers, otherwise the next one round robin.  Returns
+ * non-zero if the item should take the regular path instead. */
+static int deque_push(struct thdpool *pool, thdpool_work_fn work_fn,
+                      void *work, char *persistent_info, int force_queue)
+{
+    struct thdpool_deque *dq;
+    struct workitem *item;
+    struct thd *me = thd_self;
+    unsigned idx;
+
+    if (!force_queue && ATOMIC_LOAD32(pool->nstealq) >= pool->maxqueue)
+        return -1;
+
+    if (me && me->pool == pool)
+        idx = me->home % pool->ndeques;
+    else
+        idx = ATOMIC_ADD32(pool->stealrr, 1) % pool->ndeques;
+    dq = &pool->deques[idx];
+
+    Pthread_mutex_lock(&dq->lk);
+    if ((item = pool_getablk(dq->pool)) == NULL) {
+        Pthread_mutex_unlock(&dq->lk);
+        return -1;
+    }
+    memset(item, 0, sizeof(*item));
+    item->work = work;
+    item->work_fn = work_fn;
+    item->persistent_info = persistent_info;
+    item->queue_time_ms = comdb2_time_epochms();
+    item->available = 1;
+    listc_abl(&dq->q, item);
+    Pthread_mutex_unlock(&dq->lk);
+
+    ATOMIC_ADD32(pool->nstealq, 1);
+    ATOMIC_ADD32(pool->num_steal_enqueued, 1);
+    if (pool->queued_callback)
+        pool->queued_callback(work);
+
+    /* Workers put themselves on the freelist before a last look at the
+     * deques, so either they see this item or we see them idle. */
+    if (ATOMIC_LOAD32(pool->nidle) > 0 || ATOMIC_LOAD32(pool->thdlist.count) == 0) {
+        struct thd *thd = NULL;
+        LOCK(&pool->mutex)
+        {
+            if ((thd = listc_rtl(&pool->freelist)) != NULL) {
+                thd->on_freelist = 0;
+                ATOMIC_ADD32(pool->nidle, -1);
+                Pthread_cond_signal(&thd->cond);
+            }
+        }
+        UNLOCK(&pool->mutex);
+        /* every worker exited after we checked: start one, it will find
+         * this item once its no-op is done */
+        if (!thd && ATOMIC_LOAD32(pool->thdlist.count) == 0)
+            thdpool_enqueue(pool, steal_kick_fn, NULL, 1, NULL,
+                            THDPOOL_FORCE_DISPATCH);
+    }
+    return 0;
+}
+
+/* Take work from our own deque, newest first, or else steal the oldest item
+ * from another.  Expired items are freed as in get_work_ll.  Returns 0 if
+ * every deque is empty. */
+static int deque_pop(struct thdpool *pool, struct thd *thd,
+                     struct workitem *work)
+{
+    while (ATOMIC_LOAD32(pool->nstealq) > 0) {
+        struct workitem *item = NULL;
+        unsigned i;
+
+        for (i = 0; i < pool->ndeques; ++i) {
+            struct thdpool_deque *dq =
+                &pool->deques[(thd->home + i) % pool->ndeques];
+            if (ATOMIC_LOAD32(dq->q.count) == 0)
+                continue;
+            Pthread_mutex_lock(&dq->lk);
+            item = i == 0 ? listc_rbl(&dq->q) : listc_rtl(&dq->q);
+            if (item) {
+                memcpy(work, item, sizeof(*work));
+                pool_relablk(dq->pool, item);
+            }
+            Pthread_mutex_unlock(&dq->lk);
+            if (item)
+                break;
+        }
+        if (!item)
+            return 0;
+        ATOMIC_ADD32(pool->nstealq, -1);
+        if (i > 0)
+            ATOMIC_ADD32(pool->num_stolen, 1);
+
+        if (pool->maxqueueagems > 0 &&
+            comdb2_time_epochms() - work->queue_time_ms > pool->maxqueueagems) {
+            if (pool->dque_fn)
+                pool->dque_fn(pool, work, 1);
+            if (work->persistent_info) {
+                free(work->persistent_info);
+                work->persistent_info = NULL;
+            }
+            work->work_fn(pool, work->work, NULL, THD_FREE);
+            ATOMIC_ADD32(pool->num_steal_timeout, 1);
+            continue;
+        }
+        if (pool->dque_fn)
+            pool->dque_fn(pool, work, 0);
+        ATOMIC_ADD32(pool->num_steal_dequeued, 1);
+        return 1;
+    }
+    return 0;
+}
+
 /* Get the next item of work for this thread to do.  Returns 0 if there
  * is no work. */
 static int get_work_ll(struct thd *thd, struct workitem *work)
@@ -603,7 +1140,7 @@ static int get_work_ll(struct thd *thd, struct workitem *work)
         return 1;
     } else {
         struct workitem *next;
-        while ((next = listc_rtl(&thd->pool->queue)) != NULL) {
+        while ((next = queue_next_ll(thd->pool)) != NULL) {
             int force_timeout = 0;
             if ((thd->pool->maxqueueagems > 0) &&
                 gbl_random_thdpool_work_timeout &&
@@ -623,11 +1160,22 @@ static int get_work_ll(struct thd *thd, struct workitem *work)
                     next->persistent_info = NULL;
                 }
                 thd->work.work_fn(thd->pool, next->work, NULL, THD_FREE);
+                if (next->cls)
+                    next->cls->num_timeout++;
                 pool_relablk(thd->pool->pool, next);
                 thd->pool->num_timeout++;
                 continue;
             }
 
+            if (next->cls) {
+                unsigned waited = comdb2_time_epochms() - next->queue_time_ms;
+                next->cls->num_dequeued++;
+                next->cls->total_wait_ms += waited;
+                if (waited > next->cls->max_wait_ms)
+                    next->cls->max_wait_ms = waited;
+                next->cls = NULL;
+            }
+
             if (thd->pool->dque_fn)
                 thd->pool->dque_fn(thd->pool, next, 0);
             memcpy(work, next, sizeof(*work));
@@ -635,6 +1183,8 @@ static int get_work_ll(struct thd *thd, struct workitem *work)
             thd->pool->num_dequeued++;
             return 1;
         }
+        if (thd->pool->deques)
+            return deque_pop(thd->pool, thd, work);
         return 0;
     }
 }
@@ -645,6 +1195,7 @@ static void *thdpool_thd(void *voidarg)
     struct thd *thd = voidarg;
     struct thdpool *pool = thd->pool;
     void *thddata = NULL;
+    char *cpus;
 
     thdpool_thdinit_fn init_fn;
     thdpool_thddelt_fn delt_fn;
@@ -654,6 +1205,14 @@ static void *thdpool_thd(void *voidarg)
     THREAD_TYPE(pool->name);
     thd->archtid = getarchtid();
 
+    LOCK(&pool->mutex)
+    {
+        cpus = pool->cpus ? strdup(pool->cpus) : NULL;
+    }
+    UNLOCK(&pool->mutex);
+    comdb2_thread_set_affinity(pool->affinity_class, cpus);
+    free(cpus);
+
     if (pool->per_thread_data_sz > 0) {
         thddata = alloca(pool->per_thread_data_sz);
         assert(thddata != NULL);
@@ -665,10 +1224,24 @@ static void *thdpool_thd(void *voidarg)
         init_fn(pool, thddata);
     thread_memcreate(pool->mem_sz);
     struct workitem work = {0};
+    thd_self = thd;
 
     while (1) {
         int diffms;
 
+        /* Work stealing: run deque items without the pool lock while the
+         * shared queue is empty. */
+        memset(&work, 0, sizeof(struct workitem));
+        if (ATOMIC_LOADPTR(pool->deques) && !pool->stopped &&
+            ATOMIC_LOAD32(pool->queue.count) == 0 &&
+            deque_pop(pool, thd, &work)) {
+            if (work.persistent_info) {
+                LOCK(&pool->mutex) { thd->persistent_info = work.persistent_info; }
+                UNLOCK(&pool->mutex);
+            }
+            goto run;
+        }
+
         LOCK(&pool->mutex)
         {
             struct timespec timeout;
@@ -706,8 +1279,22 @@ static void *thdpool_thd(void *voidarg)
                 if (pool->stopped || thr_exit) {
                     /* Thread exiting - remove from pools lists */
                     listc_rfl(&pool->thdlist, thd);
-                    if (thd->on_freelist)
+                    if (thd->on_freelist) {
                         listc_rfl(&pool->freelist, thd);
+                        thd->on_freelist = 0;
+                        ATOMIC_ADD32(pool->nidle, -1);
+                    }
+                    /* an item may have been pushed on a deque since we
+                     * looked; whoever pushed it saw us and not an empty
+                     * pool, so stay for it.  A stopped pool runs what it
+                     * has queued before its threads go, deques included. */
+                    __sync_synchronize();
+                    if (pool->deques && ATOMIC_LOAD32(pool->nstealq) > 0) {
+                        listc_atl(&pool->thdlist, thd);
+                        thr_exit = 0;
+                        ts = NULL;
+                        continue;
+                    }
                     pool->num_exits++;
                     errUNLOCK(&pool->mutex);
 
@@ -722,6 +1309,10 @@ static void *thdpool_thd(void *voidarg)
                 if (!thd->on_freelist) {
                     listc_atl(&pool->freelist, thd);
                     thd->on_freelist = 1;
+                    ATOMIC_ADD32(pool->nidle, 1);
+                    /* last look before sleeping, see deque_push */
+                    if (pool->deques && ATOMIC_LOAD32(pool->nstealq) > 0)
+                        continue;
                 }
                 if (ts) {
                     rc = pthread_cond_timedwait(&thd->cond, &pool->mutex, ts);
@@ -749,10 +1340,18 @@ static void *thdpool_thd(void *voidarg)
              * current work in progress, obtained from get_work_ll, while
              * still holding the pool lock. */
 
+            /* If we found deque work ourselves we are still on the freelist. */
+            if (thd->on_freelist) {
+                listc_rfl(&pool->freelist, thd);
+                thd->on_freelist = 0;
+                ATOMIC_ADD32(pool->nidle, -1);
+            }
+
             thd->persistent_info = work.persistent_info;
         }
         UNLOCK(&pool->mutex);
 
+    run:
         diffms = comdb2_time_epochms() - work.queue_time_ms;
         if (diffms > pool->longwaitms) {
             logmsg(LOGMSG_WARN, "%s(%s): long wait %d ms\n", __func__, pool->name,
@@ -767,14 +1366,16 @@ static void *thdpool_thd(void *voidarg)
          * else.  this should make it as accurate as possible
          * from the perspective of other threads that may need
          * to examine it. */
-        LOCK(&pool->mutex) {
-            thd->persistent_info = NULL;
-            if (work.persistent_info != NULL) {
-                free(work.persistent_info);
-                work.persistent_info = NULL;
+        if (work.persistent_info != NULL || !pool->deques) {
+            LOCK(&pool->mutex) {
+                thd->persistent_info = NULL;
+                if (work.persistent_info != NULL) {
+                    free(work.persistent_info);
+                    work.persistent_info = NULL;
+                }
             }
+            UNLOCK(&pool->mutex);
         }
-        UNLOCK(&pool->mutex);
 
         /* might this is set at a certain point by work_fn */
         thread_util_donework();
@@ -814,6 +1415,15 @@ thread_exit:
 
 int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
                     int queue_override, char *persistent_info, uint32_t flags)
+{
+    return thdpool_enqueue_class(pool, work_fn, work, queue_override,
+                                 persistent_info, flags, NULL, 0);
+}
+
+int thdpool_enqueue_class(struct thdpool *pool, thdpool_work_fn work_fn,
+                          void *work, int queue_override,
+                          char *persistent_info, uint32_t flags,
+                          const char *classkey, int priority)
 {
     static time_t last_dump = 0;
     int enqueue_front = (flags & THDPOOL_ENQUEUE_FRONT);
@@ -825,10 +1435,22 @@ int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
 
     time_t crt_dump;
 
+    /* Work stealing needs no pool lock when the item would have to wait for
+     * a busy thread anyway: the pool is at maxt, or we are one of its
+     * workers and will get to it ourselves. */
+    if (pool->steal && pool->deques && !pool->fairq && !pool->stopped &&
+        !enqueue_front && !force_dispatch &&
+        ((thd_self && thd_self->pool == pool) ||
+         (pool->maxnthd > 0 && ATOMIC_LOAD32(pool->thdlist.count) >=
+                                   pool->maxnthd + pool->nwaitthd)) &&
+        deque_push(pool, work_fn, work, persistent_info, force_queue) == 0)
+        return 0;
+
     LOCK(&pool->mutex)
     {
         struct thd *thd;
         struct workitem *item = NULL;
+        struct thdpool_class *cls = NULL;
         unsigned nbusy;
 
         if (pool->stopped) {
@@ -839,6 +1461,9 @@ int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
             return -1;
         }
 
+        if (pool->steal && !pool->deques && deques_init_ll(pool) != 0)
+            pool->steal = 0;
+
         /* Keep our histogram of how often n threads were busy when we entered
          * enqueue. */
         nbusy = listc_size(&pool->thdlist) - listc_size(&pool->freelist);
@@ -873,6 +1498,7 @@ int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
         if (thd) {
             assert(thd->on_freelist);
             thd->on_freelist = 0;
+            ATOMIC_ADD32(pool->nidle, -1);
         }
         if (!thd &&
             (force_dispatch || pool->maxnthd == 0 ||
@@ -890,6 +1516,7 @@ int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
 
             Pthread_cond_init(&thd->cond, NULL);
             thd->pool = pool;
+            thd->home = pool->num_creates;
             listc_atl(&pool->thdlist, thd);
 
 #ifdef MONITOR_STACK
@@ -926,7 +1553,9 @@ int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
         if (thd == NULL && pool->wait) {
 
             pool->waiting_for_thread = 1;
+            uint64_t wait = wait_event_begin(WAIT_EVENT_THDPOOL);
             Pthread_cond_wait(&pool->wait_for_thread, &pool->mutex);
+            wait_event_end(wait);
             pool->waiting_for_thread = 0;
 
             goto again;
@@ -1006,6 +1635,22 @@ int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
                     return -1;
                 }
             }
+            /* Admission control: if the next item for this class has already
+             * waited past maxagems the class isn't keeping up, and anything
+             * queued behind it would only time out. */
+            if (pool->fairq && (cls = get_class_ll(pool, classkey)) != NULL &&
+                !force_queue && pool->maxqueueagems > 0 &&
+                listc_size(&cls->queue) > 0 &&
+                comdb2_time_epochms() - cls->queue.top->queue_time_ms >
+                    pool->maxqueueagems) {
+                cls->num_rejected++;
+                pool->num_rejected++;
+                pool->num_failed_dispatches++;
+                errUNLOCK(&pool->mutex);
+                logmsg(LOGMSG_DEBUG, "%s(%s): class %s is over maxagems\n",
+                       __func__, pool->name, cls->key);
+                return -1;
+            }
             item = pool_getablk(pool->pool);
             if (!item) {
                 pool->num_failed_dispatches++;
@@ -1033,6 +1678,10 @@ int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
         item->persistent_info = persistent_info;
         item->queue_time_ms = comdb2_time_epochms();
         item->available = 1;
+        item->priority = priority;
+        item->cls = NULL;
+        if (cls)
+            class_add_ll(pool, cls, item, enqueue_front);
 
         /* Now wake up the thread with work to do. */
         if (!thd) {
@@ -1105,17 +1754,17 @@ int thdpool_get_passed(struct thdpool *pool)
 
 int thdpool_get_enqueued(struct thdpool *pool)
 {
-    return pool->num_enqueued;
+    return pool->num_enqueued + ATOMIC_LOAD32(pool->num_steal_enqueued);
 }
 
 int thdpool_get_dequeued(struct thdpool *pool)
 {
-    return pool->num_dequeued;
+    return pool->num_dequeued + ATOMIC_LOAD32(pool->num_steal_dequeued);
 }
 
 int thdpool_get_timeouts(struct thdpool *pool)
 {
-    return pool->num_timeout;
+    return pool->num_timeout + ATOMIC_LOAD32(pool->num_steal_timeout);
 }
 
 int thdpool_get_failed_dispatches(struct thdpool *pool)
@@ -1145,7 +1794,7 @@ int thdpool_get_maxqueue(struct thdpool *pool)
 
 int thdpool_get_nqueuedworks(struct thdpool *pool)
 {
-    return listc_size(&pool->queue);
+    return listc_size(&pool->queue) + ATOMIC_LOAD32(pool->nstealq);
 }
 
 int thdpool_get_longwaitms(struct thdpool *pool)
@@ -1202,7 +1851,7 @@ struct thdpool *thdpool_next_pool(struct thdpool *pool)
 
 int thdpool_get_queue_depth(struct thdpool *pool)
 {
-    return pool->queue.count;
+    return pool->queue.count + ATOMIC_LOAD32(pool->nstealq);
 }
 
 void thdpool_set_queued_callback(struct thdpool *pool, void(*callback)(void*)) 
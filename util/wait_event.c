@@ -0,0 +1,294 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include <epochlib.h>
+
+#include "wait_event.h"
+#include "list.h"
+#include "plhash.h"
+#include "logmsg.h"
+#include <locks_wrap.h>
+
+#include "mem_util.h"
+#include "mem_override.h"
+
+int gbl_wait_event_sample_ms = 0;
+
+/* waits can nest (a page read while waiting on a lock, say); deeper ones
+   are timed but not sampled */
+#define WAIT_EVENT_DEPTH 4
+/* most (query, event) pairs the sampler keeps */
+#define WAIT_EVENT_MAX_QUERIES 10000
+#define WAIT_EVENT_TOP 20
+
+struct wait_thd {
+    int event; /* what the sampler sees */
+    int depth;
+    int stack[WAIT_EVENT_DEPTH];
+    uint64_t query; /* leading bytes of the query fingerprint */
+    uint64_t count[WAIT_EVENT_MAX];
+    uint64_t total_us[WAIT_EVENT_MAX];
+    LINKC_T(struct wait_thd) lnk;
+};
+
+struct wait_query_key {
+    uint64_t query;
+    int32_t event;
+    int32_t pad;
+};
+
+struct wait_query {
+    struct wait_query_key key;
+    uint64_t samples;
+};
+
+static pthread_once_t wait_once = PTHREAD_ONCE_INIT;
+static pthread_key_t wait_key;
+static pthread_mutex_t wait_lk = PTHREAD_MUTEX_INITIALIZER;
+static LISTC_T(struct wait_thd) wait_thds;
+/* from threads that have exited */
+static uint64_t exited_count[WAIT_EVENT_MAX];
+static uint64_t exited_total_us[WAIT_EVENT_MAX];
+/* sampler's counts, under wait_lk */
+static uint64_t samples[WAIT_EVENT_MAX];
+static hash_t *wait_queries;
+
+static __thread struct wait_thd *wait_me;
+
+static const char *wait_event_names[WAIT_EVENT_MAX] = {
+    "none",        "lock",       "page_read",   "page_write",
+    "log_flush",   "replication", "net_send",   "thdpool"};
+
+const char *wait_event_name(int event)
+{
+    return (event >= 0 && event < WAIT_EVENT_MAX) ? wait_event_names[event]
+                                                  : "unknown";
+}
+
+static void wait_thd_exit(void *arg)
+{
+    struct wait_thd *t = arg;
+
+    Pthread_mutex_lock(&wait_lk);
+    listc_rfl(&wait_thds, t);
+    for (int i = 0; i < WAIT_EVENT_MAX; i++) {
+        exited_count[i] += t->count[i];
+        exited_total_us[i] += t->total_us[i];
+    }
+    Pthread_mutex_unlock(&wait_lk);
+    free(t);
+}
+
+static void wait_sample(void)
+{
+    struct wait_thd *t;
+    struct wait_query_key key;
+    struct wait_query *q;
+
+    Pthread_mutex_lock(&wait_lk);
+    LISTC_FOR_EACH(&wait_thds, t, lnk)
+    {
+        int event = t->event;
+        if (event <= WAIT_EVENT_NONE || event >= WAIT_EVENT_MAX)
+            continue;
+        samples[event]++;
+
+        memset(&key, 0, sizeof(key));
+        key.query = t->query;
+        key.event = event;
+        if (key.query == 0)
+            continue;
+        if ((q = hash_find(wait_queries, &key)) == NULL) {
+            if (hash_get_num_entries(wait_queries) >= WAIT_EVENT_MAX_QUERIES)
+                continue;
+            if ((q = calloc(1, sizeof(struct wait_query))) == NULL)
+                continue;
+            q->key = key;
+            hash_add(wait_queries, q);
+        }
+        q->samples++;
+    }
+    Pthread_mutex_unlock(&wait_lk);
+}
+
+static void *wait_sampler(void *arg)
+{
+    while (1) {
+        int ms = gbl_wait_event_sample_ms;
+        if (ms <= 0) {
+            sleep(1);
+            continue;
+        }
+        usleep(ms * 1000);
+        wait_sample();
+    }
+    return NULL;
+}
+
+static void wait_event_init(void)
+{
+    pthread_t tid;
+    pthread_attr_t attr;
+
+    listc_init(&wait_thds, offsetof(struct wait_thd, lnk));
+    wait_queries = hash_init(sizeof(struct wait_query_key));
+    Pthread_key_create(&wait_key, wait_thd_exit);
+
+    Pthread_attr_init(&attr);
+    Pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&tid, &attr, wait_sampler, NULL) != 0)
+        logmsg(LOGMSG_ERROR, "%s: can't create wait event sampler\n",
+               __func__);
+    Pthread_attr_destroy(&attr);
+}
+
+static struct wait_thd *wait_thd_get(void)
+{
+    struct wait_thd *t = wait_me;
+    if (t)
+        return t;
+
+    pthread_once(&wait_once, wait_event_init);
+    if ((t = calloc(1, sizeof(struct wait_thd))) == NULL)
+        return NULL;
+    Pthread_mutex_lock(&wait_lk);
+    listc_abl(&wait_thds, t);
+    Pthread_mutex_unlock(&wait_lk);
+    Pthread_setspecific(wait_key, t);
+    wait_me = t;
+    return t;
+}
+
+uint64_t wait_event_begin(int event)
+{
+    struct wait_thd *t;
+
+    if (!gbl_wait_event_sample_ms || (t = wait_thd_get()) == NULL)
+        return 0;
+    if (t->depth < WAIT_EVENT_DEPTH)
+        t->stack[t->depth] = event;
+    if (t->depth++ == 0)
+        t->event = event;
+    return comdb2_time_epochus() | 1; /* never 0 */
+}
+
+void wait_event_end(uint64_t token)
+{
+    struct wait_thd *t = wait_me;
+    int event;
+
+    if (token == 0 || t == NULL || t->depth == 0)
+        return;
+    t->depth--;
+    event = (t->depth < WAIT_EVENT_DEPTH) ? t->stack[t->depth]
+                                          : WAIT_EVENT_NONE;
+    t->count[event]++;
+    t->total_us[event] += comdb2_time_epochus() - token;
+    if (t->depth == 0)
+        t->event = WAIT_EVENT_NONE;
+}
+
+void wait_event_set_query(const unsigned char *fingerprint, int len)
+{
+    struct wait_thd *t;
+    uint64_t query = 0;
+
+    if (fingerprint == NULL) {
+        if (wait_me)
+            wait_me->query = 0;
+        return;
+    }
+    if (!gbl_wait_event_sample_ms || (t = wait_thd_get()) == NULL)
+        return;
+    memcpy(&query, fingerprint, len < sizeof(query) ? len : sizeof(query));
+    t->query = query;
+}
+
+static int wait_query_cmp(const void *a, const void *b)
+{
+    const struct wait_query *qa = *(struct wait_query **)a;
+    const struct wait_query *qb = *(struct wait_query **)b;
+    if (qa->samples != qb->samples)
+        return (qa->samples < qb->samples) ? 1 : -1;
+    return 0;
+}
+
+static int wait_query_collect(void *obj, void *arg)
+{
+    struct wait_query ***pp = arg;
+    *(*pp)++ = obj;
+    return 0;
+}
+
+void wait_event_report(void)
+{
+    uint64_t count[WAIT_EVENT_MAX], total_us[WAIT_EVENT_MAX];
+    struct wait_query **all = NULL, **end;
+    struct wait_thd *t;
+    int nqueries = 0;
+
+    if (wait_queries == NULL) {
+        logmsg(LOGMSG_USER, "wait events: none recorded, "
+                            "wait_event_sample_ms is %d\n",
+               gbl_wait_event_sample_ms);
+        return;
+    }
+
+    Pthread_mutex_lock(&wait_lk);
+    memcpy(count, exited_count, sizeof(count));
+    memcpy(total_us, exited_total_us, sizeof(total_us));
+    LISTC_FOR_EACH(&wait_thds, t, lnk)
+    {
+        for (int i = 0; i < WAIT_EVENT_MAX; i++) {
+            count[i] += t->count[i];
+            total_us[i] += t->total_us[i];
+        }
+    }
+    logmsg(LOGMSG_USER, "wait events (sampled every %d ms):\n",
+           gbl_wait_event_sample_ms);
+    logmsg(LOGMSG_USER, "  %-12s %12s %16s %12s\n", "event", "waits",
+           "total us", "samples");
+    for (int i = WAIT_EVENT_NONE + 1; i < WAIT_EVENT_MAX; i++) {
+        logmsg(LOGMSG_USER,
+               "  %-12s %12" PRIu64 " %16" PRIu64 " %12" PRIu64 "\n",
+               wait_event_name(i), count[i], total_us[i], samples[i]);
+    }
+
+    nqueries = hash_get_num_entries(wait_queries);
+    if (nqueries > 0 && (all = malloc(nqueries * sizeof(*all))) != NULL) {
+        end = all;
+        hash_for(wait_queries, wait_query_collect, &end);
+        qsort(all, nqueries, sizeof(*all), wait_query_cmp);
+        logmsg(LOGMSG_USER, "top waiters (fingerprint prefix):\n");
+        for (int i = 0; i < nqueries && i < WAIT_EVENT_TOP; i++) {
+            const unsigned char *fp = (unsigned char *)&all[i]->key.query;
+            logmsg(LOGMSG_USER,
+                   "  %02x%02x%02x%02x%02x%02x%02x%02x %-12s %12" PRIu64
+                   "\n",
+                   fp[0], fp[1], fp[2], fp[3], fp[4], fp[5], fp[6], fp[7],
+                   wait_event_name(all[i]->key.event), all[i]->samples);
+        }
+        free(all);
+    }
+    Pthread_mutex_unlock(&wait_lk);
+}
@@ -0,0 +1,56 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+#ifndef INCLUDED_WAIT_EVENT_H
+#define INCLUDED_WAIT_EVENT_H
+
+#include <stdint.h>
+
+/* Wait events.  A thread that is about to block marks what it is waiting
+   for with wait_event_begin() and clears it with wait_event_end().  The
+   thread's own counters get the exact count and time of every wait, and a
+   sampler thread looks at what every thread is waiting on every
+   wait_event_sample_ms, charging each sample to the query the thread is
+   running.  All of it is off when wait_event_sample_ms is 0. */
+
+enum {
+    WAIT_EVENT_NONE,
+    WAIT_EVENT_LOCK,       /* berkdb lock */
+    WAIT_EVENT_PAGE_READ,  /* mpool reading a page */
+    WAIT_EVENT_PAGE_WRITE, /* mpool writing a page */
+    WAIT_EVENT_LOG_FLUSH,  /* log fsync */
+    WAIT_EVENT_REPLICATION, /* replicants applying a commit */
+    WAIT_EVENT_NET_SEND,   /* sending to another node */
+    WAIT_EVENT_THDPOOL,    /* waiting for a pool thread */
+    WAIT_EVENT_MAX
+};
+
+extern int gbl_wait_event_sample_ms;
+
+/* Returns a token for wait_event_end() */
+uint64_t wait_event_begin(int event);
+void wait_event_end(uint64_t token);
+
+/* Charge this thread's samples to the query with this fingerprint; NULL
+   once the query is done */
+void wait_event_set_query(const unsigned char *fingerprint, int len);
+
+const char *wait_event_name(int event);
+
+/* Totals and the queries with the most samples, to LOGMSG_USER */
+void wait_event_report(void);
+
+#endif